@@ -0,0 +1,422 @@
+/**
+ * @file retrieval_bench.cpp
+ * @brief Micro-benchmarks of the retrieval hot paths on the fixed corpora in bench/corpus
+ *
+ * Each case runs its operation repeatedly for at least --min-time-ms and reports the
+ * median and p99 time per operation, and throughput where the input has a size. Cases
+ * cover chunking, PDF/DOCX/HTML parsing, FAISS upserts and searches, embedding JSON
+ * (de)serialization, the rate limiter and SSE frame writes. Semantic chunking needs an
+ * embedding model and only runs with --model.
+ *
+ * --output writes the results as JSON; a later run given that file as --baseline
+ * flags every case whose median got slower by more than --max-regression and exits
+ * with status 2, so the suite can gate changes in CI.
+ */
+
+#include "kolosal/auth/rate_limiter.hpp"
+#include "kolosal/faiss_client.hpp"
+#include "kolosal/logger.hpp"
+#include "kolosal/models/embedding_request_model.hpp"
+#include "kolosal/models/embedding_response_model.hpp"
+#include "kolosal/node_manager.h"
+#include "kolosal/retrieval/chunking_types.hpp"
+#include "kolosal/retrieval/parse_docx.hpp"
+#include "kolosal/retrieval/parse_html.hpp"
+#include "kolosal/retrieval/parse_pdf.hpp"
+#include "kolosal/server_api.hpp"
+#include "kolosal/utils.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <json.hpp>
+
+#ifndef KOLOSAL_BENCH_CORPUS_DIR
+#define KOLOSAL_BENCH_CORPUS_DIR "bench/corpus"
+#endif
+
+using json = nlohmann::json;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+struct Case {
+    std::string name;
+    size_t bytes = 0;        // Input bytes per call, for MB/s (0 = not reported)
+    size_t unitsPerCall = 1; // Operations one call performs; times are reported per operation
+    std::function<void()> call;
+};
+
+struct Result {
+    std::string name;
+    size_t iterations = 0;
+    double medianNs = 0;
+    double p99Ns = 0;
+    double mbPerSec = 0;
+};
+
+std::string readFile(const std::filesystem::path &path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) throw std::runtime_error("cannot open " + path.string());
+    std::ostringstream out;
+    out << in.rdbuf();
+    return out.str();
+}
+
+Result runCase(const Case &c, double minTimeMs) {
+    c.call();  // Warm-up, also surfaces failures before anything is timed
+
+    std::vector<double> samples;
+    const auto started = Clock::now();
+    while (samples.size() < 5 ||
+           std::chrono::duration<double, std::milli>(Clock::now() - started).count() < minTimeMs) {
+        const auto begin = Clock::now();
+        c.call();
+        samples.push_back(std::chrono::duration<double, std::nano>(Clock::now() - begin).count() / c.unitsPerCall);
+    }
+    std::sort(samples.begin(), samples.end());
+
+    Result r;
+    r.name = c.name;
+    r.iterations = samples.size() * c.unitsPerCall;
+    r.medianNs = samples[samples.size() / 2];
+    r.p99Ns = samples[std::min(samples.size() - 1, samples.size() * 99 / 100)];
+    if (c.bytes > 0 && r.medianNs > 0) {
+        r.mbPerSec = (static_cast<double>(c.bytes) / c.unitsPerCall) / (r.medianNs / 1e9) / (1024.0 * 1024.0);
+    }
+    return r;
+}
+
+std::string formatNs(double ns) {
+    char buf[32];
+    if (ns >= 1e9) std::snprintf(buf, sizeof(buf), "%.2f s", ns / 1e9);
+    else if (ns >= 1e6) std::snprintf(buf, sizeof(buf), "%.2f ms", ns / 1e6);
+    else if (ns >= 1e3) std::snprintf(buf, sizeof(buf), "%.2f us", ns / 1e3);
+    else std::snprintf(buf, sizeof(buf), "%.0f ns", ns);
+    return buf;
+}
+
+std::vector<float> randomVector(std::mt19937 &rng, int dims) {
+    std::normal_distribution<float> dist(0.0f, 1.0f);
+    std::vector<float> v(dims);
+    for (auto &x : v) x = dist(rng);
+    return v;
+}
+
+// The sentences of the text corpus, as realistic embedding inputs
+std::vector<std::string> sentences(const std::string &text, size_t count) {
+    std::vector<std::string> out;
+    size_t start = 0;
+    while (out.size() < count && start < text.size()) {
+        size_t end = text.find(". ", start);
+        if (end == std::string::npos) end = text.size();
+        std::string s = text.substr(start, end - start + 1);
+        s.erase(0, s.find_first_not_of(" \n"));
+        if (!s.empty()) out.push_back(std::move(s));
+        start = end + 2;
+    }
+    return out;
+}
+
+void addChunkingCases(std::vector<Case> &cases, const std::string &text) {
+    auto service = std::make_shared<kolosal::retrieval::ChunkingService>();
+    cases.push_back({"chunking.generate_base_chunks", text.size(), 1, [service, &text] {
+        auto chunks = service->generateBaseChunks(text, 128, 16);
+        if (chunks.empty()) throw std::runtime_error("no chunks");
+    }});
+}
+
+void addSemanticChunkCase(std::vector<Case> &cases, const std::string &text, const std::string &modelId) {
+    auto service = std::make_shared<kolosal::retrieval::ChunkingService>();
+    cases.push_back({"chunking.semantic_chunk", text.size(), 1, [service, &text, modelId] {
+        auto chunks = service->semanticChunk(text, modelId, 128, 16, 512, 0.7f).get();
+        if (chunks.empty()) throw std::runtime_error("no chunks");
+    }});
+}
+
+void addParserCases(std::vector<Case> &cases, const std::string &pdf, const std::string &docx, const std::string &html) {
+    cases.push_back({"parse.pdf", pdf.size(), 1, [&pdf] {
+        auto result = retrieval::DocumentParser::parse_pdf_from_bytes(
+            reinterpret_cast<const unsigned char *>(pdf.data()), pdf.size());
+        if (!result.success) throw std::runtime_error(result.error_message);
+    }});
+    cases.push_back({"parse.docx", docx.size(), 1, [&docx] {
+        auto text = retrieval::DOCXParser::parse_docx_from_bytes(
+            reinterpret_cast<const unsigned char *>(docx.data()), docx.size());
+        if (text.empty()) throw std::runtime_error("no text extracted");
+    }});
+    auto parser = std::make_shared<retrieval::HtmlParser>();
+    cases.push_back({"parse.html", html.size(), 1, [parser, &html] {
+        auto result = parser->parseHtmlSync(html);
+        if (!result.success) throw std::runtime_error(result.error_message);
+    }});
+}
+
+void addEmbeddingJsonCases(std::vector<Case> &cases, const std::string &text) {
+    constexpr int kDims = 1024;
+    constexpr int kEmbeddings = 32;
+    std::mt19937 rng(42);
+    auto response = std::make_shared<kolosal::EmbeddingResponse>();
+    response->model = "bench-embedder";
+    for (int i = 0; i < kEmbeddings; ++i) response->addEmbedding(randomVector(rng, kDims), i);
+    response->setUsage(kEmbeddings * 64);
+    auto serialized = std::make_shared<std::string>(response->to_json().dump());
+
+    cases.push_back({"embedding_json.response_serialize", serialized->size(), 1, [response] {
+        auto body = response->to_json().dump();
+        if (body.empty()) throw std::runtime_error("empty body");
+    }});
+    cases.push_back({"embedding_json.response_parse", serialized->size(), 1, [serialized] {
+        kolosal::EmbeddingResponse parsed;
+        parsed.from_json(json::parse(*serialized));
+        if (parsed.data.size() != kEmbeddings) throw std::runtime_error("lost embeddings");
+    }});
+
+    json request = {{"model", "bench-embedder"}, {"input", sentences(text, 64)}};
+    auto body = std::make_shared<std::string>(request.dump());
+    cases.push_back({"embedding_json.request_parse", body->size(), 1, [body] {
+        kolosal::EmbeddingRequest parsed;
+        parsed.parse(*body);
+        if (!parsed.hasMultipleInputs()) throw std::runtime_error("lost inputs");
+    }});
+}
+
+void addRateLimiterCase(std::vector<Case> &cases) {
+    constexpr size_t kClients = 4096;
+    constexpr size_t kChecks = 1024;
+    kolosal::auth::RateLimiter::Config config(static_cast<size_t>(1) << 30, std::chrono::seconds(60));
+    auto limiter = std::make_shared<kolosal::auth::RateLimiter>(config);
+    auto clients = std::make_shared<std::vector<std::string>>();
+    for (size_t i = 0; i < kClients; ++i) {
+        clients->push_back("10.0." + std::to_string(i / 256) + "." + std::to_string(i % 256));
+    }
+    auto next = std::make_shared<size_t>(0);
+    cases.push_back({"rate_limiter.check", 0, kChecks, [limiter, clients, next] {
+        for (size_t i = 0; i < kChecks; ++i) {
+            auto result = limiter->checkRateLimit((*clients)[(*next)++ % kClients]);
+            if (!result.allowed) throw std::runtime_error("request denied");
+        }
+    }});
+}
+
+#ifndef _WIN32
+// Frames go into a socket pair whose other end a thread keeps draining
+struct StreamSink {
+    int fds[2] = {-1, -1};
+    std::atomic<bool> stop{false};
+    std::thread drain;
+
+    StreamSink() {
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) throw std::runtime_error("socketpair failed");
+        drain = std::thread([this] {
+            char buf[65536];
+            while (!stop.load()) {
+                if (read(fds[1], buf, sizeof(buf)) <= 0) break;
+            }
+        });
+    }
+    ~StreamSink() {
+        stop = true;
+        shutdown(fds[0], SHUT_RDWR);
+        close(fds[0]);
+        drain.join();
+        close(fds[1]);
+    }
+};
+
+void addStreamChunkCase(std::vector<Case> &cases) {
+    constexpr size_t kFrames = 256;
+    auto sink = std::make_shared<StreamSink>();
+    auto frame = std::make_shared<std::string>(
+        "data: {\"id\":\"chatcmpl-bench\",\"object\":\"chat.completion.chunk\",\"choices\":[{\"index\":0,"
+        "\"delta\":{\"content\":\" token\"},\"finish_reason\":null}]}\n\n");
+    cases.push_back({"stream.send_stream_chunk", frame->size() * kFrames, kFrames, [sink, frame] {
+        for (size_t i = 0; i < kFrames; ++i) {
+            send_stream_chunk(sink->fds[0], StreamChunk(*frame));
+        }
+        if (kolosal::http_internal::g_write_failed) throw std::runtime_error("write failed");
+    }});
+}
+#endif
+
+#ifdef USE_FAISS
+void addFaissCases(std::vector<Case> &cases, const std::filesystem::path &indexDir) {
+    constexpr int kDims = 384;
+    constexpr size_t kSearchPoints = 20000;
+    constexpr size_t kUpsertBatch = 64;
+
+    kolosal::FaissClient::Config config;
+    config.indexPath = indexDir.string();
+    config.dimensions = kDims;
+    config.indexType = "Flat";
+    auto client = std::make_shared<kolosal::FaissClient>(config);
+    client->createCollection("search", kDims, "IP").get();
+    client->createCollection("upsert", kDims, "IP").get();
+
+    std::mt19937 rng(7);
+    std::vector<kolosal::FaissPoint> batch;
+    for (size_t i = 0; i < kSearchPoints; ++i) {
+        batch.push_back({"p" + std::to_string(i), randomVector(rng, kDims), {{"text", "chunk " + std::to_string(i)}}});
+        if (batch.size() == 1000 || i + 1 == kSearchPoints) {
+            if (!client->upsertPoints("search", batch).get().success) throw std::runtime_error("FAISS upsert failed");
+            batch.clear();
+        }
+    }
+
+    auto queries = std::make_shared<std::vector<std::vector<float>>>();
+    for (int i = 0; i < 64; ++i) queries->push_back(randomVector(rng, kDims));
+    auto nextQuery = std::make_shared<size_t>(0);
+    cases.push_back({"faiss.search", 0, 1, [client, queries, nextQuery] {
+        auto result = client->search("search", (*queries)[(*nextQuery)++ % queries->size()], 10).get();
+        if (!result.success) throw std::runtime_error(result.error_message);
+    }});
+
+    auto nextId = std::make_shared<size_t>(0);
+    auto upsertRng = std::make_shared<std::mt19937>(11);
+    cases.push_back({"faiss.upsert_points", 0, kUpsertBatch, [client, nextId, upsertRng] {
+        std::vector<kolosal::FaissPoint> points;
+        for (size_t i = 0; i < kUpsertBatch; ++i) {
+            points.push_back({"u" + std::to_string((*nextId)++), randomVector(*upsertRng, kDims), {{"text", "new chunk"}}});
+        }
+        auto result = client->upsertPoints("upsert", points).get();
+        if (!result.success) throw std::runtime_error(result.error_message);
+    }});
+}
+#endif
+
+void printUsage() {
+    std::cerr << "Usage: retrieval_bench [options]\n"
+              << "  --corpus-dir <dir>        fixed corpora (default " << KOLOSAL_BENCH_CORPUS_DIR << ")\n"
+              << "  --filter <text>           only run cases whose name contains text\n"
+              << "  --min-time-ms <ms>        minimum timed run per case (default 500)\n"
+              << "  --model <path.gguf>       embedding model for chunking.semantic_chunk\n"
+              << "  --output <file>           write the results as JSON\n"
+              << "  --baseline <file>         compare with an earlier --output; exit 2 on regressions\n"
+              << "  --max-regression <ratio>  allowed median slowdown against the baseline (default 0.10)\n";
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    std::filesystem::path corpusDir = KOLOSAL_BENCH_CORPUS_DIR;
+    std::string filter, modelPath, outputFile, baselineFile;
+    double minTimeMs = 500.0;
+    double maxRegression = 0.10;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (arg == "--corpus-dir" && hasValue) corpusDir = argv[++i];
+        else if (arg == "--filter" && hasValue) filter = argv[++i];
+        else if (arg == "--min-time-ms" && hasValue) minTimeMs = std::stod(argv[++i]);
+        else if (arg == "--model" && hasValue) modelPath = argv[++i];
+        else if (arg == "--output" && hasValue) outputFile = argv[++i];
+        else if (arg == "--baseline" && hasValue) baselineFile = argv[++i];
+        else if (arg == "--max-regression" && hasValue) maxRegression = std::stod(argv[++i]);
+        else {
+            printUsage();
+            return arg == "--help" || arg == "-h" ? 0 : 1;
+        }
+    }
+
+    ServerLogger::instance().setQuietMode(true);
+
+    std::string text, pdf, docx, html;
+    try {
+        text = readFile(corpusDir / "corpus.txt");
+        pdf = readFile(corpusDir / "corpus.pdf");
+        docx = readFile(corpusDir / "corpus.docx");
+        html = readFile(corpusDir / "corpus.html");
+    } catch (const std::exception &ex) {
+        std::cerr << "Error: " << ex.what() << " (set --corpus-dir)\n";
+        return 1;
+    }
+
+    const auto scratch = std::filesystem::temp_directory_path() /
+                         ("kolosal-retrieval-bench-" + std::to_string(Clock::now().time_since_epoch().count()));
+    std::vector<Case> cases;
+    try {
+        addChunkingCases(cases, text);
+        addParserCases(cases, pdf, docx, html);
+        addEmbeddingJsonCases(cases, text);
+        addRateLimiterCase(cases);
+#ifndef _WIN32
+        addStreamChunkCase(cases);
+#endif
+#ifdef USE_FAISS
+        addFaissCases(cases, scratch / "faiss");
+#endif
+        if (!modelPath.empty()) {
+            // Semantic chunking embeds through the server's engines
+            auto &server = kolosal::ServerAPI::instance();
+            if (!server.init("0", "127.0.0.1") ||
+                !server.getNodeManager().addEmbeddingEngine("bench-embedder", modelPath.c_str(), LoadingParameters())) {
+                std::cerr << "Error: cannot load " << modelPath << "\n";
+                return 1;
+            }
+            addSemanticChunkCase(cases, text, "bench-embedder");
+        }
+    } catch (const std::exception &ex) {
+        std::cerr << "Error: setting up the cases failed: " << ex.what() << "\n";
+        return 1;
+    }
+
+    std::map<std::string, double> baseline;
+    if (!baselineFile.empty()) {
+        try {
+            for (const auto &entry : json::parse(readFile(baselineFile)).at("results")) {
+                baseline[entry.at("name").get<std::string>()] = entry.at("median_ns").get<double>();
+            }
+        } catch (const std::exception &ex) {
+            std::cerr << "Error: baseline " << baselineFile << ": " << ex.what() << "\n";
+            return 1;
+        }
+    }
+
+    std::printf("%-36s %12s %12s %12s %10s %s\n", "case", "ops", "median/op", "p99/op", "MB/s", baselineFile.empty() ? "" : "vs baseline");
+    json results = json::array();
+    int status = 0;
+    for (const auto &c : cases) {
+        if (!filter.empty() && c.name.find(filter) == std::string::npos) continue;
+        Result r;
+        try {
+            r = runCase(c, minTimeMs);
+        } catch (const std::exception &ex) {
+            std::printf("%-36s skipped: %s\n", c.name.c_str(), ex.what());
+            continue;
+        }
+
+        std::string versus;
+        if (auto it = baseline.find(r.name); it != baseline.end() && it->second > 0) {
+            const double change = r.medianNs / it->second - 1.0;
+            char buf[48];
+            std::snprintf(buf, sizeof(buf), "%+.1f%%%s", change * 100.0, change > maxRegression ? " REGRESSED" : "");
+            versus = buf;
+            if (change > maxRegression) status = 2;
+        }
+        std::printf("%-36s %12zu %12s %12s %10s %s\n", r.name.c_str(), r.iterations, formatNs(r.medianNs).c_str(),
+                    formatNs(r.p99Ns).c_str(), r.mbPerSec > 0 ? std::to_string(static_cast<long long>(r.mbPerSec)).c_str() : "-",
+                    versus.c_str());
+        std::fflush(stdout);
+        results.push_back({{"name", r.name}, {"iterations", r.iterations}, {"median_ns", r.medianNs},
+                           {"p99_ns", r.p99Ns}, {"mb_per_s", r.mbPerSec}});
+    }
+
+    if (!outputFile.empty()) {
+        std::ofstream out(outputFile);
+        out << json{{"results", results}}.dump(2) << "\n";
+    }
+    std::error_code ec;
+    std::filesystem::remove_all(scratch, ec);
+    return status;
+}
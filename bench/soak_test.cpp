@@ -0,0 +1,428 @@
+/**
+ * @file soak_test.cpp
+ * @brief Soak test: drives mixed traffic at a running server and fails if memory or handles keep growing
+ *
+ * Client threads send a weighted mix of requests for --duration: health and model listing,
+ * chat completions with and without streaming, streams the client abandons after the first
+ * chunk, and embeddings. Requests a model is needed for are skipped unless --chat-model or
+ * --embedding-model name one. Every --sample-interval seconds /metrics is scraped and the
+ * tracked series are summed over their labels.
+ *
+ * Samples taken in the first --warmup seconds are ignored, so caches and pools can fill.
+ * For every tracked metric a least-squares line is fitted through the remaining samples and
+ * its slope, per hour, is compared with the metric's limit. Resident memory, heap in use,
+ * open descriptors, engine live jobs and rate limiter buckets are tracked by default, and
+ * --limit adds metrics or changes their limits. Any slope over its limit fails the run
+ * with status 2.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <json.hpp>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+using SocketType = SOCKET;
+static const SocketType kInvalidSocket = INVALID_SOCKET;
+static void closeSocket(SocketType s) { closesocket(s); }
+#else
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+using SocketType = int;
+static const SocketType kInvalidSocket = -1;
+static void closeSocket(SocketType s) { close(s); }
+#endif
+
+using json = nlohmann::json;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+struct SoakConfig {
+    std::string url = "http://127.0.0.1:8080";
+    std::string apiKey;
+    std::string chatModel;
+    std::string embeddingModel;
+    std::string output;
+    int concurrency = 8;
+    double durationSec = 3600;
+    double sampleIntervalSec = 10;
+    double warmupSec = 300;
+    int maxTokens = 32;
+    int timeoutSec = 120;
+    uint64_t seed = 42;
+    // Metric name -> largest allowed growth per hour
+    std::map<std::string, double> limits = {
+        {"process_resident_memory_bytes", 64.0 * 1024 * 1024},
+        {"kolosal_heap_in_use_bytes", 32.0 * 1024 * 1024},
+        {"process_open_fds", 16},
+        {"kolosal_engine_live_jobs", 16},
+        {"kolosal_rate_limiter_buckets", 16},
+    };
+};
+
+enum class Kind { Health, Models, Chat, ChatStream, ChatAbort, Embeddings, Count };
+
+const char *kindName(Kind kind) {
+    switch (kind) {
+    case Kind::Health: return "health";
+    case Kind::Models: return "models";
+    case Kind::Chat: return "chat";
+    case Kind::ChatStream: return "chat_stream";
+    case Kind::ChatAbort: return "chat_abort";
+    case Kind::Embeddings: return "embeddings";
+    default: return "?";
+    }
+}
+
+class HttpClient {
+public:
+    explicit HttpClient(const SoakConfig &config) : config_(config) {
+        std::string rest = config.url;
+        if (rest.rfind("http://", 0) == 0) rest = rest.substr(7);
+        const size_t slash = rest.find('/');
+        basePath_ = slash == std::string::npos ? "" : rest.substr(slash);
+        while (!basePath_.empty() && basePath_.back() == '/') basePath_.pop_back();
+        std::string hostPort = rest.substr(0, slash);
+        const size_t colon = hostPort.rfind(':');
+        host_ = colon == std::string::npos ? hostPort : hostPort.substr(0, colon);
+        port_ = colon == std::string::npos ? "80" : hostPort.substr(colon + 1);
+    }
+
+    // Sends one request and reads the response until the server closes the connection.
+    // With abortAfterFirstChunk the connection is dropped as soon as any body bytes arrive,
+    // the way a client that goes away mid-stream would. Returns the status, 0 on I/O failure.
+    int request(const std::string &method, const std::string &path, const std::string &payload,
+                std::string *body = nullptr, bool abortAfterFirstChunk = false) const {
+        std::string head = method + " " + basePath_ + path + " HTTP/1.1\r\nHost: " + host_ + ":" + port_ +
+                           "\r\nConnection: close\r\n";
+        if (!payload.empty())
+            head += "Content-Type: application/json\r\nContent-Length: " + std::to_string(payload.size()) + "\r\n";
+        if (!config_.apiKey.empty()) head += "Authorization: Bearer " + config_.apiKey + "\r\n";
+        head += "\r\n";
+
+        SocketType sock = connectTo();
+        if (sock == kInvalidSocket) return 0;
+        if (!sendAll(sock, head + payload)) {
+            closeSocket(sock);
+            return 0;
+        }
+
+        std::string raw;
+        size_t headerEnd = std::string::npos;
+        char buffer[16384];
+        while (true) {
+            const int n = recv(sock, buffer, sizeof(buffer), 0);
+            if (n <= 0) break;
+            raw.append(buffer, n);
+            if (headerEnd == std::string::npos) headerEnd = raw.find("\r\n\r\n");
+            if (abortAfterFirstChunk && headerEnd != std::string::npos && raw.size() > headerEnd + 4) break;
+        }
+        closeSocket(sock);
+
+        if (raw.size() < 12 || raw.compare(0, 5, "HTTP/") != 0) return 0;
+        if (body && headerEnd != std::string::npos) *body = raw.substr(headerEnd + 4);
+        return std::atoi(raw.c_str() + 9);
+    }
+
+private:
+    SocketType connectTo() const {
+        addrinfo hints{}, *info = nullptr;
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        if (getaddrinfo(host_.c_str(), port_.c_str(), &hints, &info) != 0) return kInvalidSocket;
+        SocketType sock = kInvalidSocket;
+        for (addrinfo *p = info; p; p = p->ai_next) {
+            sock = socket(p->ai_family, p->ai_socktype, p->ai_protocol);
+            if (sock == kInvalidSocket) continue;
+            if (connect(sock, p->ai_addr, static_cast<int>(p->ai_addrlen)) == 0) break;
+            closeSocket(sock);
+            sock = kInvalidSocket;
+        }
+        freeaddrinfo(info);
+        if (sock != kInvalidSocket) {
+#ifdef _WIN32
+            DWORD timeout = config_.timeoutSec * 1000;
+            setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char *>(&timeout), sizeof(timeout));
+#else
+            timeval timeout{config_.timeoutSec, 0};
+            setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+#endif
+        }
+        return sock;
+    }
+
+    static bool sendAll(SocketType sock, const std::string &data) {
+        size_t sent = 0;
+        while (sent < data.size()) {
+            const int n = send(sock, data.data() + sent, static_cast<int>(data.size() - sent), 0);
+            if (n <= 0) return false;
+            sent += n;
+        }
+        return true;
+    }
+
+    const SoakConfig &config_;
+    std::string host_, port_, basePath_;
+};
+
+// Sum of every series of each tracked metric in a Prometheus text exposition
+std::map<std::string, double> parseMetrics(const std::string &text, const std::map<std::string, double> &tracked) {
+    std::map<std::string, double> values;
+    std::istringstream in(text);
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        const size_t nameEnd = line.find_first_of("{ ");
+        if (nameEnd == std::string::npos) continue;
+        const std::string name = line.substr(0, nameEnd);
+        if (!tracked.count(name)) continue;
+        const size_t valueStart = line.rfind(' ');
+        values[name] += std::strtod(line.c_str() + valueStart + 1, nullptr);
+    }
+    return values;
+}
+
+struct Sample {
+    double atSec;
+    std::map<std::string, double> values;
+};
+
+// Least-squares slope of value over time, in units per second
+double slope(const std::vector<std::pair<double, double>> &points) {
+    if (points.size() < 2) return 0;
+    double meanX = 0, meanY = 0;
+    for (const auto &[x, y] : points) { meanX += x; meanY += y; }
+    meanX /= points.size();
+    meanY /= points.size();
+    double num = 0, den = 0;
+    for (const auto &[x, y] : points) {
+        num += (x - meanX) * (y - meanY);
+        den += (x - meanX) * (x - meanX);
+    }
+    return den > 0 ? num / den : 0;
+}
+
+std::string randomWords(std::mt19937_64 &rng, int count) {
+    static const char *const kWords[] = {"river", "stone", "cloud", "lamp", "garden", "signal", "copper", "orbit",
+                                         "window", "harbor", "ledger", "meadow", "quartz", "timber", "velvet", "summit"};
+    std::string out;
+    for (int i = 0; i < count; ++i) {
+        if (i) out += ' ';
+        out += kWords[rng() % (sizeof(kWords) / sizeof(kWords[0]))];
+    }
+    return out;
+}
+
+std::vector<Kind> buildMix(const SoakConfig &config) {
+    // Weights per request kind; the mix leans on the paths that allocate per request
+    std::vector<Kind> mix = {Kind::Health, Kind::Models};
+    if (!config.chatModel.empty())
+        mix.insert(mix.end(), {Kind::Chat, Kind::Chat, Kind::ChatStream, Kind::ChatStream, Kind::ChatStream, Kind::ChatAbort});
+    if (!config.embeddingModel.empty())
+        mix.insert(mix.end(), {Kind::Embeddings, Kind::Embeddings, Kind::Embeddings});
+    return mix;
+}
+
+int sendOne(const HttpClient &client, const SoakConfig &config, Kind kind, std::mt19937_64 &rng) {
+    switch (kind) {
+    case Kind::Health:
+        return client.request("GET", "/health", "");
+    case Kind::Models:
+        return client.request("GET", "/v1/models", "");
+    case Kind::Chat:
+    case Kind::ChatStream:
+    case Kind::ChatAbort: {
+        json body = {
+            {"model", config.chatModel},
+            {"messages", json::array({{{"role", "user"}, {"content", randomWords(rng, 16 + rng() % 240)}}})},
+            {"max_tokens", config.maxTokens},
+            {"stream", kind != Kind::Chat}};
+        return client.request("POST", "/v1/chat/completions", body.dump(), nullptr, kind == Kind::ChatAbort);
+    }
+    case Kind::Embeddings: {
+        json inputs = json::array();
+        for (int i = 0, n = 1 + static_cast<int>(rng() % 8); i < n; ++i) inputs.push_back(randomWords(rng, 8 + rng() % 120));
+        json body = {{"model", config.embeddingModel}, {"input", inputs}};
+        return client.request("POST", "/v1/embeddings", body.dump());
+    }
+    default:
+        return 0;
+    }
+}
+
+void printUsage(const char *argv0) {
+    std::cerr << "Usage: " << argv0 << " [--url http://host:port] [options]\n\n"
+              << "Traffic:\n"
+              << "  --chat-model ID         model for chat requests (omit to skip them)\n"
+              << "  --embedding-model ID    model for embedding requests (omit to skip them)\n"
+              << "  --concurrency N         client threads (default 8)\n"
+              << "  --duration S            length of the run in seconds (default 3600)\n"
+              << "  --max-tokens N          max_tokens per chat request (default 32)\n"
+              << "  --api-key KEY           sent as a Bearer token\n"
+              << "  --timeout S             per-request receive timeout in seconds (default 120)\n"
+              << "  --seed N                prompt seed (default 42)\n"
+              << "Growth check:\n"
+              << "  --sample-interval S     seconds between /metrics scrapes (default 10)\n"
+              << "  --warmup S              leading seconds left out of the fit (default 300)\n"
+              << "  --limit NAME=PER_HOUR   largest allowed growth of a metric per hour; repeatable,\n"
+              << "                          adds NAME to the tracked metrics or overrides its default\n"
+              << "  --output FILE           write the samples and fitted slopes as JSON\n";
+}
+
+bool parseArgs(int argc, char **argv, SoakConfig &config) {
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        auto value = [&]() -> const char * {
+            if (i + 1 >= argc) throw std::invalid_argument(arg + " needs a value");
+            return argv[++i];
+        };
+        if (arg == "--url") config.url = value();
+        else if (arg == "--api-key") config.apiKey = value();
+        else if (arg == "--chat-model") config.chatModel = value();
+        else if (arg == "--embedding-model") config.embeddingModel = value();
+        else if (arg == "--output") config.output = value();
+        else if (arg == "--concurrency") config.concurrency = std::stoi(value());
+        else if (arg == "--duration") config.durationSec = std::stod(value());
+        else if (arg == "--sample-interval") config.sampleIntervalSec = std::stod(value());
+        else if (arg == "--warmup") config.warmupSec = std::stod(value());
+        else if (arg == "--max-tokens") config.maxTokens = std::stoi(value());
+        else if (arg == "--timeout") config.timeoutSec = std::stoi(value());
+        else if (arg == "--seed") config.seed = std::stoull(value());
+        else if (arg == "--limit") {
+            const std::string spec = value();
+            const size_t eq = spec.find('=');
+            if (eq == std::string::npos || eq == 0) throw std::invalid_argument("--limit needs NAME=PER_HOUR");
+            config.limits[spec.substr(0, eq)] = std::stod(spec.substr(eq + 1));
+        }
+        else if (arg == "--help" || arg == "-h") return false;
+        else throw std::invalid_argument("unknown option " + arg);
+    }
+    if (config.concurrency < 1 || config.durationSec <= 0 || config.sampleIntervalSec <= 0 || config.warmupSec < 0)
+        throw std::invalid_argument("--concurrency, --duration and --sample-interval must be positive, --warmup non-negative");
+    if (config.durationSec - config.warmupSec < 2 * config.sampleIntervalSec)
+        throw std::invalid_argument("--duration must leave at least two samples after --warmup");
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    SoakConfig config;
+    try {
+        if (!parseArgs(argc, argv, config)) { printUsage(argv[0]); return 64; }
+    } catch (const std::exception &e) {
+        std::cerr << "[SOAK] " << e.what() << "\n\n";
+        printUsage(argv[0]);
+        return 64;
+    }
+
+#ifdef _WIN32
+    WSADATA wsaData;
+    WSAStartup(MAKEWORD(2, 2), &wsaData);
+#endif
+
+    HttpClient client(config);
+    std::string metricsText;
+    if (client.request("GET", "/metrics", "", &metricsText) != 200) {
+        std::cerr << "[SOAK] GET " << config.url << "/metrics failed; is the server up with features.metrics on?\n";
+        return 65;
+    }
+
+    const std::vector<Kind> mix = buildMix(config);
+    std::atomic<bool> stop{false};
+    std::atomic<uint64_t> sent[static_cast<int>(Kind::Count)] = {};
+    std::atomic<uint64_t> failed[static_cast<int>(Kind::Count)] = {};
+
+    std::cerr << "[SOAK] " << config.concurrency << " clients for " << config.durationSec << " s against " << config.url
+              << (config.chatModel.empty() ? "" : ", chat " + config.chatModel)
+              << (config.embeddingModel.empty() ? "" : ", embeddings " + config.embeddingModel) << "\n";
+
+    std::vector<std::thread> workers;
+    for (int w = 0; w < config.concurrency; ++w) {
+        workers.emplace_back([&, w] {
+            std::mt19937_64 rng(config.seed + w);
+            while (!stop.load(std::memory_order_relaxed)) {
+                const Kind kind = mix[rng() % mix.size()];
+                const int status = sendOne(client, config, kind, rng);
+                sent[static_cast<int>(kind)].fetch_add(1, std::memory_order_relaxed);
+                // Abandoned streams only need the response to have started
+                if (status != 200) failed[static_cast<int>(kind)].fetch_add(1, std::memory_order_relaxed);
+            }
+        });
+    }
+
+    std::vector<Sample> samples;
+    const auto start = Clock::now();
+    const auto end = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(config.durationSec));
+    for (auto next = start; next <= end;
+         next += std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(config.sampleIntervalSec))) {
+        std::this_thread::sleep_until(next);
+        std::string text;
+        if (client.request("GET", "/metrics", "", &text) != 200) {
+            std::cerr << "[SOAK] Scrape failed at " << std::chrono::duration<double>(Clock::now() - start).count() << " s\n";
+            continue;
+        }
+        Sample sample{std::chrono::duration<double>(Clock::now() - start).count(), parseMetrics(text, config.limits)};
+        std::cerr << "[SOAK] t=" << static_cast<long>(sample.atSec) << "s";
+        for (const auto &[name, value] : sample.values) std::cerr << ' ' << name << '=' << static_cast<long long>(value);
+        std::cerr << "\n";
+        samples.push_back(std::move(sample));
+    }
+    stop = true;
+    for (auto &worker : workers) worker.join();
+
+    json report = {{"duration_s", config.durationSec}, {"warmup_s", config.warmupSec}, {"requests", json::object()},
+                   {"metrics", json::object()}};
+    for (int k = 0; k < static_cast<int>(Kind::Count); ++k) {
+        if (sent[k] == 0) continue;
+        report["requests"][kindName(static_cast<Kind>(k))] = {{"sent", sent[k].load()}, {"failed", failed[k].load()}};
+    }
+
+    bool leaking = false;
+    for (const auto &[name, limit] : config.limits) {
+        std::vector<std::pair<double, double>> points;
+        json series = json::array();
+        for (const auto &sample : samples) {
+            auto it = sample.values.find(name);
+            if (it == sample.values.end()) continue;
+            series.push_back({sample.atSec, it->second});
+            if (sample.atSec >= config.warmupSec) points.emplace_back(sample.atSec, it->second);
+        }
+        if (points.size() < 2) {
+            std::cerr << "[SOAK] " << name << ": not exported, skipped\n";
+            continue;
+        }
+        const double perHour = slope(points) * 3600;
+        const bool over = perHour > limit;
+        leaking |= over;
+        std::cerr << "[SOAK] " << name << ": " << perHour << "/h (limit " << limit << "/h)" << (over ? "  GROWING" : "") << "\n";
+        report["metrics"][name] = {{"slope_per_hour", perHour}, {"limit_per_hour", limit}, {"ok", !over}, {"samples", series}};
+    }
+    report["ok"] = !leaking;
+
+    if (!config.output.empty()) {
+        std::ofstream out(config.output);
+        out << report.dump(2) << "\n";
+    }
+    std::cout << report.dump(2) << std::endl;
+    return leaking ? 2 : 0;
+}
@@ -0,0 +1,489 @@
+/**
+ * @file traffic_replay.cpp
+ * @brief Replays captured production traffic at a running server and compares latency with a baseline
+ *
+ * Reads the gzip-compressed NDJSON written by logging.traffic_capture (several files, such as
+ * the captures of all nodes, are merged by timestamp) and re-issues every request at its
+ * original pace, scaled by --speed; --speed 0 sends them back to back, as fast as
+ * --concurrency connections allow. Requests whose body was not captured (uploads, bodies
+ * over max_body_kb) are skipped. Anonymized bodies keep their shape and word lengths, so
+ * prompt sizes, shared prefixes, streaming and embedding batch sizes match the original mix.
+ *
+ * For every route the report gives the replayed latency and time to first byte percentiles,
+ * the captured server-side latency and how many responses changed status. --output saves it;
+ * --baseline compares it with a saved report of another build. A route whose p50 or p99
+ * latency grew by more than --max-regression (a fraction; or, with --speed 0, a throughput
+ * drop that large) fails the run with status 2. The report also gives how late requests left
+ * (schedule lag), so a saturated client is not mistaken for a slow server.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <json.hpp>
+#include <zlib.h>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+using SocketType = SOCKET;
+static const SocketType kInvalidSocket = INVALID_SOCKET;
+static void closeSocket(SocketType s) { closesocket(s); }
+#else
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+using SocketType = int;
+static const SocketType kInvalidSocket = -1;
+static void closeSocket(SocketType s) { close(s); }
+#endif
+
+using json = nlohmann::json;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+struct ReplayConfig {
+    std::string url = "http://127.0.0.1:8080";
+    std::string apiKey;
+    std::vector<std::string> files;
+    std::vector<std::string> routes;   // Replay only these route patterns (empty = all)
+    double speed = 1.0;                // 2 = twice the captured rate; 0 = back to back
+    int concurrency = 64;
+    size_t limit = 0;                  // Most requests replayed (0 = all)
+    int timeoutSec = 300;
+    std::string output;
+    std::string baseline;
+    double maxRegression = 0.10;      // Fraction
+};
+
+struct Request {
+    uint64_t tsUs = 0;
+    std::string method;
+    std::string path;
+    std::string route;
+    std::string contentType;
+    std::string body;
+    int capturedStatus = 0;
+    double capturedMs = 0;
+};
+
+struct Outcome {
+    int status = 0;
+    double latencyMs = 0;
+    double ttfbMs = 0;
+    double lagMs = 0;                  // How long after its due time the request left
+};
+
+class HttpClient {
+public:
+    explicit HttpClient(const ReplayConfig &config) : config_(config) {
+        std::string rest = config.url;
+        if (rest.rfind("http://", 0) == 0) rest = rest.substr(7);
+        const size_t slash = rest.find('/');
+        basePath_ = slash == std::string::npos ? "" : rest.substr(slash);
+        while (!basePath_.empty() && basePath_.back() == '/') basePath_.pop_back();
+        std::string hostPort = rest.substr(0, slash);
+        const size_t colon = hostPort.rfind(':');
+        host_ = colon == std::string::npos ? hostPort : hostPort.substr(0, colon);
+        port_ = colon == std::string::npos ? "80" : hostPort.substr(colon + 1);
+    }
+
+    // Sends one request and reads the response until the server closes the connection,
+    // noting when the first body byte arrived. The status is 0 on I/O failure.
+    Outcome request(const Request &request) const {
+        Outcome outcome;
+        const auto start = Clock::now();
+        std::string head = request.method + " " + basePath_ + request.path + " HTTP/1.1\r\nHost: " + host_ + ":" +
+                           port_ + "\r\nConnection: close\r\n";
+        if (!request.body.empty() || request.method == "POST" || request.method == "PUT") {
+            head += "Content-Type: " + (request.contentType.empty() ? std::string("application/json") : request.contentType) +
+                    "\r\nContent-Length: " + std::to_string(request.body.size()) + "\r\n";
+        }
+        if (!config_.apiKey.empty()) head += "Authorization: Bearer " + config_.apiKey + "\r\n";
+        head += "\r\n";
+
+        SocketType sock = connectTo();
+        if (sock == kInvalidSocket || !sendAll(sock, head + request.body)) {
+            if (sock != kInvalidSocket) closeSocket(sock);
+            outcome.latencyMs = elapsedMs(start);
+            return outcome;
+        }
+
+        std::string raw;
+        size_t headerEnd = std::string::npos;
+        char buffer[16384];
+        while (true) {
+            const int n = recv(sock, buffer, sizeof(buffer), 0);
+            if (n <= 0) break;
+            raw.append(buffer, n);
+            if (headerEnd == std::string::npos) {
+                headerEnd = raw.find("\r\n\r\n");
+                if (headerEnd != std::string::npos && raw.size() > headerEnd + 4) outcome.ttfbMs = elapsedMs(start);
+            } else if (outcome.ttfbMs == 0) {
+                outcome.ttfbMs = elapsedMs(start);
+            }
+            // Only the status line is kept; bodies such as long streams are counted, not stored
+            if (headerEnd != std::string::npos) raw.resize(std::min<size_t>(raw.size(), 16));
+        }
+        closeSocket(sock);
+        outcome.latencyMs = elapsedMs(start);
+        if (outcome.ttfbMs == 0) outcome.ttfbMs = outcome.latencyMs;
+        if (raw.size() >= 12 && raw.compare(0, 5, "HTTP/") == 0) outcome.status = std::atoi(raw.c_str() + 9);
+        return outcome;
+    }
+
+private:
+    static double elapsedMs(Clock::time_point since) {
+        return std::chrono::duration<double, std::milli>(Clock::now() - since).count();
+    }
+
+    SocketType connectTo() const {
+        addrinfo hints{}, *info = nullptr;
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        if (getaddrinfo(host_.c_str(), port_.c_str(), &hints, &info) != 0) return kInvalidSocket;
+        SocketType sock = kInvalidSocket;
+        for (addrinfo *p = info; p; p = p->ai_next) {
+            sock = socket(p->ai_family, p->ai_socktype, p->ai_protocol);
+            if (sock == kInvalidSocket) continue;
+            if (connect(sock, p->ai_addr, static_cast<int>(p->ai_addrlen)) == 0) break;
+            closeSocket(sock);
+            sock = kInvalidSocket;
+        }
+        freeaddrinfo(info);
+        if (sock != kInvalidSocket) {
+#ifdef _WIN32
+            DWORD timeout = config_.timeoutSec * 1000;
+            setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char *>(&timeout), sizeof(timeout));
+#else
+            timeval timeout{config_.timeoutSec, 0};
+            setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+#endif
+        }
+        return sock;
+    }
+
+    static bool sendAll(SocketType sock, const std::string &data) {
+        size_t sent = 0;
+        while (sent < data.size()) {
+            const int n = send(sock, data.data() + sent, static_cast<int>(data.size() - sent), 0);
+            if (n <= 0) return false;
+            sent += n;
+        }
+        return true;
+    }
+
+    const ReplayConfig &config_;
+    std::string host_, port_, basePath_;
+};
+
+// Replayable records of a capture file; the rest are counted in skipped by reason
+bool readCapture(const std::string &file, const ReplayConfig &config, std::vector<Request> &requests,
+                 std::map<std::string, uint64_t> &skipped) {
+    gzFile in = gzopen(file.c_str(), "rb");
+    if (!in) return false;
+    std::string pending;
+    char buffer[1 << 16];
+    auto parseLine = [&](const std::string &line) {
+        if (line.empty()) return;
+        const json record = json::parse(line, nullptr, false);
+        if (!record.is_object()) {
+            ++skipped["unreadable"];
+            return;
+        }
+        Request request;
+        request.route = record.value("route", std::string());
+        if (!config.routes.empty() && std::find(config.routes.begin(), config.routes.end(), request.route) == config.routes.end()) {
+            ++skipped["route filtered"];
+            return;
+        }
+        if (record.contains("body")) {
+            request.body = record["body"].dump();
+        } else if (record.value("bytes_in", static_cast<uint64_t>(0)) > 0) {
+            ++skipped["body not captured"];
+            return;
+        }
+        request.tsUs = record.value("ts_us", static_cast<uint64_t>(0));
+        request.method = record.value("method", std::string("GET"));
+        request.path = record.value("path", std::string("/"));
+        request.contentType = record.value("content_type", std::string());
+        request.capturedStatus = record.value("status", 0);
+        request.capturedMs = record.value("latency_us", 0.0) / 1000.0;
+        requests.push_back(std::move(request));
+    };
+    int n = 0;
+    while ((n = gzread(in, buffer, sizeof(buffer))) > 0) {
+        pending.append(buffer, static_cast<size_t>(n));
+        size_t start = 0, newline;
+        while ((newline = pending.find('\n', start)) != std::string::npos) {
+            parseLine(pending.substr(start, newline - start));
+            start = newline + 1;
+        }
+        pending.erase(0, start);
+    }
+    // A capture cut off mid-write ends in a partial line, which is dropped
+    if (!pending.empty()) ++skipped["unreadable"];
+    gzclose(in);
+    return n == 0;
+}
+
+double percentile(std::vector<double> values, double p) {
+    if (values.empty()) return 0;
+    std::sort(values.begin(), values.end());
+    const size_t rank = static_cast<size_t>(p / 100.0 * (values.size() - 1) + 0.5);
+    return values[std::min(rank, values.size() - 1)];
+}
+
+json distribution(const std::vector<double> &values) {
+    return {{"p50", percentile(values, 50)}, {"p90", percentile(values, 90)}, {"p99", percentile(values, 99)},
+            {"max", values.empty() ? 0.0 : *std::max_element(values.begin(), values.end())}};
+}
+
+// Percent change from baseline to current; positive is worse for latency
+double change(double baseline, double current) {
+    return baseline > 0 ? (current - baseline) / baseline * 100.0 : 0;
+}
+
+void printUsage(const char *argv0) {
+    std::cerr << "Usage: " << argv0 << " [options] <capture.ndjson.gz>...\n\n"
+              << "Replay:\n"
+              << "  --url http://host:port   server to replay against (default http://127.0.0.1:8080)\n"
+              << "  --api-key KEY            sent as a Bearer token with every request\n"
+              << "  --speed F                pace relative to the capture (default 1; 0 = back to back)\n"
+              << "  --concurrency N          most requests in flight (default 64)\n"
+              << "  --route PATTERN          replay only this route, e.g. /v1/chat/completions; repeatable\n"
+              << "  --limit N                replay at most N requests\n"
+              << "  --timeout S              per-request receive timeout in seconds (default 300)\n"
+              << "Comparison:\n"
+              << "  --output FILE            save the report as JSON\n"
+              << "  --baseline FILE          report of an earlier replay to compare with\n"
+              << "  --max-regression F       largest allowed p50/p99 latency increase or throughput drop\n"
+              << "                           against the baseline, as a fraction (default 0.10)\n";
+}
+
+bool parseArgs(int argc, char **argv, ReplayConfig &config) {
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        auto value = [&]() -> const char * {
+            if (i + 1 >= argc) throw std::invalid_argument(arg + " needs a value");
+            return argv[++i];
+        };
+        if (arg == "--url") config.url = value();
+        else if (arg == "--api-key") config.apiKey = value();
+        else if (arg == "--speed") config.speed = std::stod(value());
+        else if (arg == "--concurrency") config.concurrency = std::stoi(value());
+        else if (arg == "--route") config.routes.push_back(value());
+        else if (arg == "--limit") config.limit = std::stoull(value());
+        else if (arg == "--timeout") config.timeoutSec = std::stoi(value());
+        else if (arg == "--output") config.output = value();
+        else if (arg == "--baseline") config.baseline = value();
+        else if (arg == "--max-regression") config.maxRegression = std::stod(value());
+        else if (arg == "--help" || arg == "-h") return false;
+        else if (arg.rfind("--", 0) == 0) throw std::invalid_argument("unknown option " + arg);
+        else config.files.push_back(arg);
+    }
+    if (config.files.empty()) throw std::invalid_argument("no capture file given");
+    if (config.speed < 0 || config.concurrency < 1 || config.timeoutSec < 1)
+        throw std::invalid_argument("--speed must not be negative, --concurrency and --timeout must be positive");
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    ReplayConfig config;
+    try {
+        if (!parseArgs(argc, argv, config)) { printUsage(argv[0]); return 64; }
+    } catch (const std::exception &e) {
+        std::cerr << "[REPLAY] " << e.what() << "\n\n";
+        printUsage(argv[0]);
+        return 64;
+    }
+
+    std::vector<Request> requests;
+    std::map<std::string, uint64_t> skipped;
+    for (const auto &file : config.files) {
+        if (!readCapture(file, config, requests, skipped)) {
+            std::cerr << "[REPLAY] Cannot read capture " << file << "\n";
+            return 65;
+        }
+    }
+    std::stable_sort(requests.begin(), requests.end(), [](const Request &a, const Request &b) { return a.tsUs < b.tsUs; });
+    if (config.limit > 0 && requests.size() > config.limit) requests.resize(config.limit);
+    if (requests.empty()) {
+        std::cerr << "[REPLAY] Nothing to replay\n";
+        return 65;
+    }
+    const double capturedSpanSec = (requests.back().tsUs - requests.front().tsUs) / 1e6;
+
+#ifdef _WIN32
+    WSADATA wsaData;
+    WSAStartup(MAKEWORD(2, 2), &wsaData);
+#endif
+
+    std::cerr << "[REPLAY] " << requests.size() << " requests spanning " << capturedSpanSec << " s against " << config.url
+              << (config.speed > 0 ? " at " + std::to_string(config.speed) + "x" : std::string(" back to back")) << "\n";
+
+    // The dispatcher hands each request to a connection thread at its due time
+    HttpClient client(config);
+    std::vector<Outcome> outcomes(requests.size());
+    std::deque<std::pair<size_t, Clock::time_point>> queue;
+    std::mutex mutex;
+    std::condition_variable ready, freed;
+    bool done = false;
+    int busy = 0;
+    std::atomic<size_t> completed{0};
+
+    std::vector<std::thread> workers;
+    for (int w = 0; w < config.concurrency; ++w) {
+        workers.emplace_back([&] {
+            while (true) {
+                std::pair<size_t, Clock::time_point> job;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    ready.wait(lock, [&] { return done || !queue.empty(); });
+                    if (queue.empty()) return;
+                    job = queue.front();
+                    queue.pop_front();
+                    ++busy;
+                }
+                const double lagMs = std::chrono::duration<double, std::milli>(Clock::now() - job.second).count();
+                outcomes[job.first] = client.request(requests[job.first]);
+                outcomes[job.first].lagMs = std::max(lagMs, 0.0);
+                const size_t finished = completed.fetch_add(1) + 1;
+                if (finished % 1000 == 0) std::cerr << "[REPLAY] " << finished << "/" << requests.size() << "\n";
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    --busy;
+                }
+                freed.notify_one();
+            }
+        });
+    }
+
+    const auto start = Clock::now();
+    for (size_t i = 0; i < requests.size(); ++i) {
+        Clock::time_point due = start;
+        if (config.speed > 0) {
+            due += std::chrono::duration_cast<Clock::duration>(
+                std::chrono::duration<double>((requests[i].tsUs - requests.front().tsUs) / 1e6 / config.speed));
+            std::this_thread::sleep_until(due);
+        } else {
+            // Back to back: the next request leaves as soon as a connection is free
+            std::unique_lock<std::mutex> lock(mutex);
+            freed.wait(lock, [&] { return busy + static_cast<int>(queue.size()) < config.concurrency; });
+            due = Clock::now();
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            queue.emplace_back(i, due);
+        }
+        ready.notify_one();
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        done = true;
+    }
+    ready.notify_all();
+    for (auto &worker : workers) worker.join();
+    const double wallSec = std::chrono::duration<double>(Clock::now() - start).count();
+
+    struct RouteSamples {
+        std::vector<double> latency, ttfb, captured;
+        uint64_t failed = 0, statusChanged = 0;
+    };
+    std::map<std::string, RouteSamples> byRoute;
+    std::vector<double> lags;
+    uint64_t failed = 0;
+    for (size_t i = 0; i < requests.size(); ++i) {
+        RouteSamples &samples = byRoute[requests[i].route.empty() ? "other" : requests[i].route];
+        samples.latency.push_back(outcomes[i].latencyMs);
+        samples.ttfb.push_back(outcomes[i].ttfbMs);
+        samples.captured.push_back(requests[i].capturedMs);
+        lags.push_back(outcomes[i].lagMs);
+        if (outcomes[i].status == 0 || outcomes[i].status >= 500) {
+            ++samples.failed;
+            ++failed;
+        }
+        if (outcomes[i].status != requests[i].capturedStatus) ++samples.statusChanged;
+    }
+
+    json report = {
+        {"url", config.url},
+        {"speed", config.speed},
+        {"requests", requests.size()},
+        {"failed", failed},
+        {"skipped", skipped},
+        {"wall_s", wallSec},
+        {"throughput_rps", wallSec > 0 ? requests.size() / wallSec : 0.0},
+        {"captured_rps", capturedSpanSec > 0 ? requests.size() / capturedSpanSec : 0.0},
+        {"schedule_lag_ms", distribution(lags)},
+        {"routes", json::object()}};
+    for (const auto &[route, samples] : byRoute) {
+        report["routes"][route] = {
+            {"requests", samples.latency.size()},
+            {"failed", samples.failed},
+            {"status_changed", samples.statusChanged},
+            {"latency_ms", distribution(samples.latency)},
+            {"ttfb_ms", distribution(samples.ttfb)},
+            {"captured_latency_ms", distribution(samples.captured)}};
+        std::cerr << "[REPLAY] " << route << ": " << samples.latency.size() << " requests, p50 "
+                  << percentile(samples.latency, 50) << " ms, p99 " << percentile(samples.latency, 99) << " ms (captured p50 "
+                  << percentile(samples.captured, 50) << " ms), " << samples.failed << " failed\n";
+    }
+    if (percentile(lags, 99) > 100)
+        std::cerr << "[REPLAY] p99 schedule lag is " << percentile(lags, 99)
+                  << " ms; raise --concurrency or the client is part of what is measured\n";
+
+    bool regressed = false;
+    if (!config.baseline.empty()) {
+        std::ifstream in(config.baseline);
+        const json baseline = json::parse(in, nullptr, false);
+        if (!baseline.is_object()) {
+            std::cerr << "[REPLAY] Cannot read baseline " << config.baseline << "\n";
+            return 65;
+        }
+        json comparison = {{"routes", json::object()}};
+        const double throughputChange = -change(baseline.value("throughput_rps", 0.0), report["throughput_rps"].get<double>());
+        comparison["throughput_drop_pct"] = throughputChange;
+        // Back-to-back runs measure throughput; paced runs send at the capture's rate whatever the server does
+        if (config.speed == 0 && baseline.value("speed", 1.0) == 0 && throughputChange > config.maxRegression * 100) {
+            regressed = true;
+            std::cerr << "[REPLAY] Throughput dropped " << throughputChange << "%  REGRESSION\n";
+        }
+        for (auto &[route, current] : report["routes"].items()) {
+            if (!baseline.contains("routes") || !baseline["routes"].contains(route)) continue;
+            const json &before = baseline["routes"][route];
+            const double p50 = change(before["latency_ms"].value("p50", 0.0), current["latency_ms"]["p50"].get<double>());
+            const double p99 = change(before["latency_ms"].value("p99", 0.0), current["latency_ms"]["p99"].get<double>());
+            const bool over = p50 > config.maxRegression * 100 || p99 > config.maxRegression * 100;
+            regressed |= over;
+            comparison["routes"][route] = {{"p50_change_pct", p50}, {"p99_change_pct", p99}, {"ok", !over}};
+            std::cerr << "[REPLAY] " << route << ": p50 " << (p50 >= 0 ? "+" : "") << p50 << "%, p99 " << (p99 >= 0 ? "+" : "")
+                      << p99 << "%" << (over ? "  REGRESSION" : "") << "\n";
+        }
+        comparison["ok"] = !regressed;
+        report["comparison"] = comparison;
+    }
+
+    if (!config.output.empty()) {
+        std::ofstream out(config.output);
+        out << report.dump(2) << "\n";
+    }
+    std::cout << report.dump(2) << std::endl;
+    return regressed ? 2 : 0;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "export.hpp"
+#include "server_config.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <istream>
+#include <string>
+
+namespace kolosal {
+namespace access_log {
+
+    /**
+     * @brief One request as written to the access log.
+     *
+     * The API key itself is never stored: apiKeyHash is the first 8 bytes of its
+     * SHA-256, computed on the writer thread, so records of one tenant can be grouped.
+     */
+    struct AccessRecord {
+        uint64_t timestampUs = 0;       // Unix time the request started, microseconds
+        uint32_t latencyUs = 0;         // Until the handler returned
+        uint16_t status = 0;
+        std::string method;
+        std::string route;              // Pattern that selected the handler, never the raw path
+        std::string model;              // Empty unless the request ran inference
+        uint64_t bytesIn = 0;           // Request body
+        uint64_t bytesOut = 0;          // Everything written to the socket, headers included
+        uint32_t promptTokens = 0;
+        uint32_t completionTokens = 0;
+        uint64_t apiKeyHash = 0;        // 0 when no key was presented
+        std::string clientIp;
+        std::string traceId;
+    };
+
+    // Starts the writer; records go to config.file in config.format
+    KOLOSAL_SERVER_API void start(const AccessLogConfig& config);
+    // Writes queued records and closes the file
+    KOLOSAL_SERVER_API void stop();
+    KOLOSAL_SERVER_API bool enabled();
+
+    // Clears the usage noted for the request handled on the current thread
+    KOLOSAL_SERVER_API void begin_request();
+    // Called by inference routes once usage is known; summed if a request runs several jobs
+    KOLOSAL_SERVER_API void record_usage(const std::string& model, size_t promptTokens, size_t completionTokens);
+    // Adds the thread's usage to the record and queues it if sampled. The apiKey is hashed
+    // off the request path. Cheap when the log is off or the request is not sampled.
+    KOLOSAL_SERVER_API void finish_request(AccessRecord&& record, std::string apiKey);
+
+    KOLOSAL_SERVER_API std::string to_json(const AccessRecord& record);
+    // Reads a binary log written by this server, calling onRecord for each record until it
+    // returns false. Returns false if the stream is not an access log or ends mid-record.
+    KOLOSAL_SERVER_API bool read_binary(std::istream& in, const std::function<bool(const AccessRecord&)>& onRecord);
+
+} // namespace access_log
+} // namespace kolosal
@@ -9,6 +9,7 @@
  */
 
 #include "auth/rate_limiter.hpp"
+#include "auth/token_quota.hpp"
 #include "auth/cors_handler.hpp"
 #include "auth/auth_middleware.hpp"
 
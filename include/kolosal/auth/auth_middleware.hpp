@@ -2,6 +2,8 @@
 
 #include "../export.hpp"
 #include "rate_limiter.hpp"
+#include "token_quota.hpp"
+#include "tenant_shares.hpp"
 #include "cors_handler.hpp"
 #include <string>
 #include <map>
@@ -190,6 +192,39 @@ namespace kolosal
             RateLimiter &getRateLimiter();
             const RateLimiter &getRateLimiter() const;
 
+            /**
+             * @brief Get direct access to the inference token quotas
+             * @return Reference to the token quota
+             */
+            TokenQuota &getTokenQuota();
+            const TokenQuota &getTokenQuota() const;
+
+            /**
+             * @brief Update the inference token quota configuration
+             * @param config New token quota configuration
+             */
+            void updateTokenQuotaConfig(const TokenQuota::Config &config);
+
+            /**
+             * @brief Get direct access to the tenant scheduling shares
+             * @return Reference to the tenant shares
+             */
+            TenantShares &getTenantShares();
+            const TenantShares &getTenantShares() const;
+
+            /**
+             * @brief Update the tenant scheduling configuration
+             * @param config New tenant scheduling configuration
+             */
+            void updateTenantSharesConfig(const TenantShares::Config &config);
+
+            /**
+             * @brief Read the API key presented with a request
+             * @param headers Request headers
+             * @return The key without any Bearer prefix, or empty if none was sent
+             */
+            std::string extractApiKey(const std::map<std::string, std::string> &headers) const;
+
             /**
              * @brief Get direct access to the CORS handler
              * @return Reference to the CORS handler
@@ -245,6 +280,7 @@ namespace kolosal
              */
             bool validateApiKeyAuth(const RequestInfo& requestInfo) const;
 
+
             /**
              * @brief Constant-time comparison helper to mitigate timing attacks.
              * @param a First string
@@ -253,37 +289,14 @@ namespace kolosal
              */
             static bool constantTimeEqual(const std::string &a, const std::string &b);
 
-            /**
-             * @brief Simple cache for header lookups to improve performance
-             */
-            struct HeaderCache {
-                std::unordered_map<std::string, std::string> cache;
-                std::chrono::steady_clock::time_point lastClear;
-                static constexpr size_t MAX_CACHE_SIZE = 1000;
-                static constexpr auto CACHE_TTL = std::chrono::minutes(5);
-                HeaderCache() : lastClear(std::chrono::steady_clock::now()) {}
-                
-                void clear() {
-                    cache.clear();
-                    lastClear = std::chrono::steady_clock::now();
-                }
-                
-                bool shouldClear() const {
-                    auto now = std::chrono::steady_clock::now();
-                    return cache.size() > MAX_CACHE_SIZE || 
-                           (now - lastClear) > CACHE_TTL;
-                }
-            };
-            
 #pragma warning(push)
 #pragma warning(disable: 4251)
             std::unique_ptr<RateLimiter> rateLimiter_;
+            std::unique_ptr<TokenQuota> tokenQuota_;
+            std::unique_ptr<TenantShares> tenantShares_;
             std::unique_ptr<CorsHandler> corsHandler_;
 #pragma warning(pop)
             ApiKeyConfig apiKeyConfig_;
-            mutable HeaderCache headerCache_;
-            // Mutex protecting header cache (getHeaderValue can be called concurrently)
-            mutable std::mutex headerCacheMutex_;
         };
 
     } // namespace auth
@@ -4,8 +4,15 @@
 #include <string>
 #include <unordered_map>
 #include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <array>
 #include <chrono>
-#include <deque>
+#include <cstdint>
+#include <utility>
+#include <vector>
 
 namespace kolosal
 {
@@ -13,10 +20,18 @@ namespace kolosal
     {
 
         /**
-         * @brief Rate limiter implementation using sliding window algorithm
+         * @brief Rate limiter implementation using the generic cell rate algorithm (GCRA)
          *
-         * This class provides rate limiting functionality by tracking request timestamps
-         * for each client IP address using a sliding window approach.
+         * Each client is a token bucket stored as a single theoretical arrival time, so
+         * memory per client is constant regardless of request rate. Buckets are spread
+         * over independently locked shards and updated with a compare-and-swap, so
+         * requests from different clients never serialize on one mutex. Idle buckets
+         * are expired by a background thread instead of on the request path.
+         *
+         * In a cluster, each node publishes how many requests it admitted per bucket
+         * (sharedUsage()) and charges what its peers admitted (chargeRemote()) to a
+         * second arrival time per key, which the local check adds to its own. Limits
+         * are then global to within one poll interval, with no network on the request path.
          */
         class KOLOSAL_SERVER_API RateLimiter
         {
@@ -26,9 +41,10 @@ namespace kolosal
              */
             struct Config
             {
-                size_t maxRequests = 100;            // Maximum requests allowed
+                size_t maxRequests = 100;            // Maximum requests allowed per client IP
                 std::chrono::seconds windowSize{60}; // Time window in seconds
                 bool enabled = true;                 // Whether rate limiting is enabled
+                size_t apiKeyMaxRequests = 0;        // Maximum requests per API key in the window (0 = no per-key limit)
 
                 Config() = default;
                 Config(size_t max_req, std::chrono::seconds window)
@@ -43,7 +59,8 @@ namespace kolosal
                 bool allowed = true;               // Whether request is allowed
                 size_t requestsUsed = 0;           // Number of requests used in current window
                 size_t requestsRemaining = 0;      // Number of requests remaining
-                std::chrono::seconds resetTime{0}; // Time until window resets
+                std::chrono::seconds resetTime{0}; // Time until the bucket refills (or until retry when denied)
+                size_t limit = 0;                  // Limit of the bucket that decided the result
 
                 RateLimitResult() = default;
                 RateLimitResult(bool allow, size_t used, size_t remaining, std::chrono::seconds reset)
@@ -52,15 +69,50 @@ namespace kolosal
 
         private:
             /**
-             * @brief Request tracking data for a client
+             * @brief Token bucket for one client, stored as its theoretical arrival time
+             */
+            struct Bucket
+            {
+                std::atomic<int64_t> tat{0};       // Nanoseconds on the steady clock
+                std::atomic<uint64_t> admitted{0}; // Requests admitted that peers are told about
+            };
+
+            /**
+             * @brief One independently locked slice of the bucket table
+             */
+            struct alignas(64) Shard
+            {
+                mutable std::shared_mutex mutex;
+                std::unordered_map<std::string, Bucket> buckets;
+            };
+
+            static constexpr size_t SHARD_COUNT = 64;
+            using ShardTable = std::array<Shard, SHARD_COUNT>;
+
+            /**
+             * @brief Requests the other nodes of a cluster admitted, as an arrival time per key hash
+             */
+            struct alignas(64) RemoteShard
+            {
+                mutable std::shared_mutex mutex;
+                std::unordered_map<uint64_t, std::atomic<int64_t>> tats;
+            };
+            using RemoteTable = std::array<RemoteShard, SHARD_COUNT>;
+
+        public:
+            /**
+             * @brief Admitted request counts published to the other nodes of a cluster
+             *
+             * Keys are hashed, so neither client IPs nor API keys leave the node. A count
+             * only grows while its bucket lives; a smaller one than last time means the
+             * bucket expired and started over.
              */
-            struct ClientData
+            struct SharedUsage
             {
-                std::deque<std::chrono::steady_clock::time_point> requests;
-                std::chrono::steady_clock::time_point lastCleanup;
+                std::vector<std::pair<uint64_t, uint64_t>> clients; // Key hash, requests admitted
+                std::vector<std::pair<uint64_t, uint64_t>> apiKeys;
+            };
 
-                ClientData() : lastCleanup(std::chrono::steady_clock::now()) {}
-            };        public:
             /**
              * @brief Default constructor with default configuration
              */
@@ -72,12 +124,42 @@ namespace kolosal
              */
             explicit RateLimiter(const Config &config);
 
+            /**
+             * @brief Stops the background expiry thread
+             */
+            ~RateLimiter();
+
+            RateLimiter(const RateLimiter &) = delete;
+            RateLimiter &operator=(const RateLimiter &) = delete;
+
             /**
              * @brief Check if a request from the given client IP is allowed
              * @param clientIP The client's IP address
+             * @param apiKey API key presented with the request; empty skips the per-key bucket
+             * @param shared Whether the request is published to cluster peers; false for one a
+             *        peer forwarded, which that peer already counted
              * @return RateLimitResult containing the decision and rate limit information
              */
-            RateLimitResult checkRateLimit(const std::string &clientIP);
+            RateLimitResult checkRateLimit(const std::string &clientIP, const std::string &apiKey = "",
+                                           bool shared = true);
+
+            /**
+             * @brief Start or stop counting what cluster peers admitted against the limits here
+             */
+            void setSharing(bool enabled);
+            bool isSharing() const { return sharing_.load(std::memory_order_relaxed); }
+
+            /**
+             * @brief Requests admitted here per live bucket, for the cluster peers
+             */
+            SharedUsage sharedUsage() const;
+
+            /**
+             * @brief Charge requests a peer admitted since its last report
+             * @param apiKey Whether keyHash names an API key bucket rather than a client IP
+             * @param keyHash Hash from the peer's sharedUsage()
+             */
+            void chargeRemote(bool apiKey, uint64_t keyHash, uint64_t requests);
 
             /**
              * @brief Update the rate limiter configuration
@@ -91,6 +173,11 @@ namespace kolosal
              */
             Config getConfig() const;
 
+            /**
+             * @brief Whether rate limiting is enabled, without taking any lock
+             */
+            bool isEnabled() const { return enabled_.load(std::memory_order_relaxed); }
+
             /**
              * @brief Clear all rate limit data for a specific client
              * @param clientIP The client's IP address
@@ -108,27 +195,83 @@ namespace kolosal
              */
             std::unordered_map<std::string, size_t> getStatistics() const;
 
+            /**
+             * @brief Get current per-API-key statistics
+             * @return Map of masked API key to number of requests in current window
+             */
+            std::unordered_map<std::string, size_t> getApiKeyStatistics() const;
+
+            /**
+             * @brief Number of client and API key buckets currently held
+             * @return Buckets not yet expired by the background thread
+             */
+            size_t bucketCount() const;
+
         private:
             /**
-             * @brief Clean up old requests outside the current window
-             * @param data Client data to clean up
+             * @brief Limits derived from the configuration, in steady clock nanoseconds
+             */
+            struct Limits
+            {
+                int64_t emission;  // Interval between requests at the sustained rate
+                int64_t tolerance; // How far the arrival time may run ahead of now (the window)
+            };
+
+            static int64_t nowNanos();
+            static uint64_t keyHash(const std::string &key);
+            static Limits makeLimits(size_t maxRequests, int64_t windowNanos);
+            static Shard &shardFor(ShardTable &table, const std::string &key);
+            static const Shard &shardFor(const ShardTable &table, const std::string &key);
+
+            /**
+             * @brief Take one token from the bucket for key, creating it if needed
+             * @param remote Peers' usage to add to the bucket's, or null when not sharing
+             */
+            RateLimitResult consume(ShardTable &table, const RemoteTable *remote, const std::string &key,
+                                    size_t limit, const Limits &limits, int64_t now, bool shared);
+
+            /**
+             * @brief Return a token taken by consume() when another bucket denied the request
              */
-            void cleanupOldRequests(ClientData &data);
+            void refund(ShardTable &table, const std::string &key, const Limits &limits, int64_t now, bool shared);
 
             /**
-             * @brief Periodic cleanup to prevent memory leaks
+             * @brief How far peers' requests put a key's arrival time ahead of now
              */
-            void performPeriodicCleanup();
+            static int64_t remoteBacklog(const RemoteTable &table, uint64_t hash, int64_t now);
+            static void collectUsage(const ShardTable &table, int64_t now, std::vector<std::pair<uint64_t, uint64_t>> &out);
+
+            static void collectStatistics(const ShardTable &table, int64_t emission, int64_t now, bool maskKeys,
+                                          std::unordered_map<std::string, size_t> &stats);
 
-            mutable std::mutex mutex_;
+            /**
+             * @brief Background loop removing buckets that have fully refilled
+             */
+            void expiryLoop();
+            size_t expireIdle(ShardTable &table, int64_t now);
+            static size_t expireIdle(RemoteTable &table, int64_t now);
+
+            mutable std::mutex mutex_; // Guards config_ and the expiry thread state
 #pragma warning(push)
 #pragma warning(disable: 4251)
             Config config_;
-            std::unordered_map<std::string, ClientData> clients_;
-            std::chrono::steady_clock::time_point lastGlobalCleanup_;
+            std::atomic<bool> enabled_{true};
+            std::atomic<size_t> maxRequests_{0};
+            std::atomic<size_t> apiKeyMaxRequests_{0};
+            std::atomic<int64_t> windowNanos_{0};
+
+            ShardTable clients_;
+            ShardTable apiKeys_;
+            std::atomic<bool> sharing_{false};
+            RemoteTable remoteClients_;
+            RemoteTable remoteApiKeys_;
+
+            std::condition_variable expiryCv_;
+            bool stopping_ = false;
+            std::thread expiryThread_;
 
-            // Global cleanup interval (clean up inactive clients every hour)
-            static constexpr std::chrono::minutes GLOBAL_CLEANUP_INTERVAL{60};
+            // How often idle buckets are expired in the background
+            static constexpr std::chrono::seconds EXPIRY_INTERVAL{30};
 #pragma warning(pop)
         };
 
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "../export.hpp"
+#include <string>
+#include <map>
+#include <shared_mutex>
+#include <atomic>
+
+namespace kolosal
+{
+    namespace auth
+    {
+
+        /**
+         * @brief Per-tenant weights and slot caps for the engines' fair scheduler
+         *
+         * A tenant is the API key sent with a request, or the client IP when there is
+         * none (see TokenQuota::subjectFor). While enabled, every completion job carries
+         * its tenant, weight and slot cap into the engine. There a freed slot goes to the
+         * waiting tenant holding the fewest slots for its weight, and each decode step's
+         * prompt tokens are split between tenants in proportion to their weights. Without
+         * it all jobs share one queue in arrival order.
+         */
+        class KOLOSAL_SERVER_API TenantShares
+        {
+        public:
+            struct Share
+            {
+                float weight = 1.0f; // Relative to the other tenants with work on the same engine
+                int maxSlots = 0;    // Slots of one replica the tenant may hold at once (0 = no cap)
+            };
+
+            /**
+             * @brief Configuration for tenant scheduling
+             */
+            struct Config
+            {
+                bool enabled = false;                   // Whether jobs are scheduled per tenant
+                Share defaults;                         // Tenants without an entry, client IPs included
+                std::map<std::string, Share> apiKeys;   // Per API key
+
+                Config() = default;
+            };
+
+            TenantShares() = default;
+            explicit TenantShares(const Config &config) { updateConfig(config); }
+
+            TenantShares(const TenantShares &) = delete;
+            TenantShares &operator=(const TenantShares &) = delete;
+
+            /**
+             * @brief Share of a tenant
+             * @param subject Tenant, from TokenQuota::subjectFor()
+             */
+            Share lookup(const std::string &subject) const;
+
+            /**
+             * @brief Tag completion parameters with their tenant's share; no-op while disabled
+             * @param subject Tenant, from TokenQuota::subjectFor()
+             * @param params CompletionParameters or ChatCompletionParameters
+             */
+            template <typename Params>
+            void assign(const std::string &subject, Params &params) const
+            {
+                if (!isEnabled())
+                    return;
+                const Share share = lookup(subject);
+                params.tenant = subject;
+                params.tenantWeight = share.weight;
+                params.tenantMaxSlots = share.maxSlots;
+            }
+
+            void updateConfig(const Config &config);
+            Config getConfig() const;
+            bool isEnabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+        private:
+            mutable std::shared_mutex mutex_;
+#pragma warning(push)
+#pragma warning(disable: 4251)
+            Config config_;
+            std::atomic<bool> enabled_{false};
+#pragma warning(pop)
+        };
+
+    } // namespace auth
+} // namespace kolosal
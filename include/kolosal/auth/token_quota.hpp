@@ -0,0 +1,194 @@
+#pragma once
+
+#include "../export.hpp"
+#include <string>
+#include <map>
+#include <unordered_map>
+#include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <array>
+#include <chrono>
+#include <cstdint>
+
+namespace kolosal
+{
+    namespace auth
+    {
+
+        /**
+         * @brief Per-tenant quotas on inference tokens (prompt + generated) per minute
+         *
+         * A tenant is the API key sent with a request, or the client IP when there is
+         * none. Each tenant has a bucket for all models and, for models with their own
+         * limit, a bucket per model. A request reserves an estimate of its cost before it
+         * is submitted to an engine and is settled with the real token counts afterwards,
+         * so an underestimate turns into debt that delays the tenant's next requests.
+         * Buckets use the same cost-weighted GCRA state as the request rate limiter.
+         */
+        class KOLOSAL_SERVER_API TokenQuota
+        {
+        public:
+            /**
+             * @brief Configuration for token quotas
+             */
+            struct Config
+            {
+                bool enabled = false;                                // Whether token quotas are enforced
+                size_t tokensPerMinute = 0;                          // Per tenant across all models (0 = unlimited)
+                std::map<std::string, size_t> modelTokensPerMinute; // Per tenant for one model
+
+                Config() = default;
+            };
+
+            /**
+             * @brief Tokens reserved for one request by reserve()
+             */
+            struct Reservation
+            {
+                bool allowed = true;                  // Whether the request may run
+                std::string subject;                  // Tenant the tokens are charged to
+                std::string model;                    // Model the tokens are charged to
+                size_t reserved = 0;                  // Estimated tokens taken from the buckets
+                size_t tenantLimit = 0;               // Tenant bucket charged (0 = none)
+                size_t modelLimit = 0;                // Model bucket charged (0 = none)
+                size_t limit = 0;                     // Limit of the bucket that decided the result
+                size_t remaining = 0;                 // Tokens left in that bucket
+                std::chrono::seconds retryAfter{0};   // When denied, how long until the estimate fits
+                std::string scope;                    // "tenant" or "model" when denied
+            };
+
+        private:
+            struct Bucket
+            {
+                std::atomic<int64_t> tat{0}; // Theoretical arrival time, steady clock nanoseconds
+            };
+
+            struct alignas(64) Shard
+            {
+                mutable std::shared_mutex mutex;
+                std::unordered_map<std::string, Bucket> buckets;
+            };
+
+            static constexpr size_t SHARD_COUNT = 32;
+            using ShardTable = std::array<Shard, SHARD_COUNT>;
+
+        public:
+            TokenQuota();
+            explicit TokenQuota(const Config &config);
+            ~TokenQuota();
+
+            TokenQuota(const TokenQuota &) = delete;
+            TokenQuota &operator=(const TokenQuota &) = delete;
+
+            /**
+             * @brief Tenant name for a request: its API key, else its client IP
+             */
+            static std::string subjectFor(const std::string &apiKey, const std::string &clientIP)
+            {
+                return apiKey.empty() ? "ip:" + clientIP : "key:" + apiKey;
+            }
+
+            /**
+             * @brief Reserve the estimated cost of a request before running it
+             * @param subject Tenant, from subjectFor()
+             * @param model Model the request runs on
+             * @param estimatedTokens Estimated prompt plus generated tokens
+             * @return The reservation; pass it to settle() once the request is done
+             */
+            Reservation reserve(const std::string &subject, const std::string &model, size_t estimatedTokens);
+
+            /**
+             * @brief Replace a reservation with the tokens the request actually used
+             * @param reservation Result of reserve()
+             * @param actualTokens Prompt plus generated tokens (0 if the request never ran)
+             */
+            void settle(const Reservation &reservation, size_t actualTokens);
+
+            void updateConfig(const Config &config);
+            Config getConfig() const;
+            bool isEnabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+            /**
+             * @brief Tokens charged in the last minute per tenant, keyed "subject" or "subject model"
+             *
+             * API keys are masked.
+             */
+            std::unordered_map<std::string, size_t> getStatistics() const;
+
+            void clearAll();
+
+            /**
+             * @brief Rough token estimate for text that has not been tokenized yet
+             */
+            static size_t estimateTokens(const std::string &text)
+            {
+                return (text.size() + 3) / 4;
+            }
+
+        private:
+            static int64_t nowNanos();
+            static int64_t emissionFor(size_t tokensPerMinute);
+            static Shard &shardFor(ShardTable &table, const std::string &key);
+
+            bool take(const std::string &key, size_t limit, size_t cost, int64_t now,
+                      size_t &remaining, std::chrono::seconds &retryAfter);
+            void adjust(const std::string &key, size_t limit, int64_t deltaTokens);
+            size_t modelLimit(const std::string &model) const;
+
+            void expiryLoop();
+
+            mutable std::mutex mutex_; // Guards config_ and the expiry thread state
+#pragma warning(push)
+#pragma warning(disable: 4251)
+            Config config_;
+            std::atomic<bool> enabled_{false};
+            std::atomic<size_t> tokensPerMinute_{0};
+            mutable std::shared_mutex modelLimitsMutex_;
+            std::map<std::string, size_t> modelLimits_;
+
+            ShardTable buckets_;
+
+            std::condition_variable expiryCv_;
+            bool stopping_ = false;
+            std::thread expiryThread_;
+
+            static constexpr std::chrono::seconds WINDOW{60};
+            static constexpr std::chrono::seconds EXPIRY_INTERVAL{30};
+#pragma warning(pop)
+        };
+
+        /**
+         * @brief Settles a TokenQuota reservation when it goes out of scope
+         *
+         * Routes record the prompt and generated tokens as they learn them; whatever was
+         * recorded is charged on destruction, so failed or abandoned requests only pay for
+         * the work that was actually done. The same figures go to the access log.
+         */
+        class KOLOSAL_SERVER_API TokenQuotaCharge
+        {
+        public:
+            TokenQuotaCharge(TokenQuota &quota, TokenQuota::Reservation reservation)
+                : quota_(quota), reservation_(std::move(reservation)) {}
+            ~TokenQuotaCharge();
+
+            TokenQuotaCharge(const TokenQuotaCharge &) = delete;
+            TokenQuotaCharge &operator=(const TokenQuotaCharge &) = delete;
+
+            void setPromptTokens(size_t tokens) { promptTokens_ = tokens; }
+            void addGeneratedTokens(size_t tokens) { generatedTokens_ += tokens; }
+
+        private:
+            TokenQuota &quota_;
+#pragma warning(push)
+#pragma warning(disable: 4251)
+            TokenQuota::Reservation reservation_;
+#pragma warning(pop)
+            size_t promptTokens_ = 0;
+            size_t generatedTokens_ = 0;
+        };
+
+    } // namespace auth
+} // namespace kolosal
@@ -0,0 +1,188 @@
+#pragma once
+
+#include "export.hpp"
+#include "server_config.hpp"
+#include <json.hpp>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace kolosal
+{
+
+/**
+ * @brief Files and batches of the OpenAI-compatible Batch API
+ *
+ * Input files are uploaded through /v1/files as JSONL, one request per line
+ * ({"custom_id", "method", "url", "body"}), and run by /v1/batches. A single
+ * worker runs the queued batches in order. Each batch's requests are sorted
+ * by model and prompt, so requests sharing a prefix run back to back and
+ * reuse its KV cache. They are submitted at the lowest priority, and only
+ * while the engine has a slot left beyond BatchConfig::reserved_slots, so a
+ * batch fills the capacity interactive traffic leaves and yields it back as
+ * soon as that traffic returns.
+ *
+ * Results go to an output file (successes) and an error file (failures),
+ * which become downloadable files when the batch ends. Files and batch state
+ * are kept in BatchConfig::directory; a batch interrupted by a restart
+ * resumes, skipping the requests whose result is already written.
+ *
+ * Files and batches belong to the tenant that uploaded or created them
+ * (auth::TokenQuota::subjectFor), and every lookup is scoped to it: another
+ * tenant's file or batch reads as missing. A batch's output files belong to
+ * the batch's owner. Each request is charged to the owner's token quota as it
+ * starts, and a batch whose owner is out of quota waits for it to refill.
+ *
+ * Thread-safe.
+ */
+class KOLOSAL_SERVER_API BatchManager
+{
+public:
+    struct File
+    {
+        std::string id;
+        std::string filename;
+        std::string purpose;            // "batch" for inputs, "batch_output" for results
+        int64_t bytes = 0;
+        int64_t created_at = 0;
+        std::string owner;              // Uploading tenant; kept on disk, never in responses
+
+        nlohmann::json toJson() const;
+    };
+
+    struct Batch
+    {
+        std::string id;
+        std::string endpoint;           // "/v1/chat/completions" or "/v1/completions"
+        std::string input_file_id;
+        std::string completion_window = "24h";
+        std::string status = "validating";
+        std::string output_file_id;
+        std::string error_file_id;
+        std::string error;              // Why the batch failed, if it did
+        int total = 0;
+        int completed = 0;
+        int failed = 0;
+        int64_t created_at = 0;
+        int64_t in_progress_at = 0;
+        int64_t expires_at = 0;
+        int64_t finalizing_at = 0;
+        int64_t completed_at = 0;
+        int64_t failed_at = 0;
+        int64_t expired_at = 0;
+        int64_t cancelling_at = 0;
+        int64_t cancelled_at = 0;
+        nlohmann::json metadata;
+        std::string owner;              // Creating tenant; kept on disk, never in responses
+
+        nlohmann::json toJson() const;
+        static Batch fromJson(const nlohmann::json& j);
+    };
+
+    static BatchManager& instance();
+
+    /**
+     * @brief Load the files and batches kept in the directory and start the worker
+     *
+     * Batches that were running when the server stopped are queued again.
+     */
+    void start(const BatchConfig& config);
+
+    /**
+     * @brief Stop the worker; a running batch stops its jobs and resumes on the next start
+     */
+    void stop();
+
+    bool enabled() const;
+    size_t maxFileBytes() const;
+
+    /**
+     * @brief Path an upload can be written to before addFile() takes it over
+     */
+    std::string stagingPath() const;
+
+    /**
+     * @brief Register an uploaded file; the file at @p path is moved into the store
+     * @param owner Uploading tenant (auth::TokenQuota::subjectFor)
+     * @throws std::runtime_error if it cannot be stored
+     */
+    File addFile(const std::string& owner, const std::string& path, const std::string& filename, const std::string& purpose);
+
+    std::optional<File> getFile(const std::string& owner, const std::string& id) const;
+    std::vector<File> listFiles(const std::string& owner, const std::string& purpose) const;
+
+    /**
+     * @brief Path of a file's content, or "" if the owner has no such file
+     */
+    std::string filePath(const std::string& owner, const std::string& id) const;
+
+    /**
+     * @brief Delete a file; files used by a batch that has not ended cannot be deleted
+     * @throws std::invalid_argument if the file is in use
+     */
+    bool deleteFile(const std::string& owner, const std::string& id);
+
+    /**
+     * @brief Queue a batch over one of the owner's uploaded input files
+     * @throws std::invalid_argument for an unknown file, endpoint or completion window
+     */
+    Batch createBatch(const std::string& owner, const std::string& input_file_id, const std::string& endpoint,
+                      const std::string& completion_window, const nlohmann::json& metadata);
+
+    std::optional<Batch> getBatch(const std::string& owner, const std::string& id) const;
+
+    /**
+     * @brief The owner's batches newest first, starting after the batch @p after (if given)
+     */
+    std::vector<Batch> listBatches(const std::string& owner, const std::string& after, size_t limit) const;
+
+    /**
+     * @brief Cancel a batch; in-flight requests are stopped and finished results kept
+     */
+    std::optional<Batch> cancelBatch(const std::string& owner, const std::string& id);
+
+    ~BatchManager();
+
+private:
+    struct Item;
+
+    BatchManager() = default;
+    BatchManager(const BatchManager&) = delete;
+    BatchManager& operator=(const BatchManager&) = delete;
+
+    void load();
+    std::optional<Batch> storedBatch(const std::string& id) const;
+    void run();
+    void process(const std::string& batchId);
+    void finish(Batch& batch, const std::string& status);
+    void persistLocked(const Batch& batch) const;
+    void writeFileMetaLocked(const File& file) const;
+    void update(const Batch& batch);
+    bool cancelRequested(const std::string& batchId) const;
+
+    std::string metaPath(const std::string& id) const;
+    std::string outputPath(const std::string& batchId) const;
+    std::string errorPath(const std::string& batchId) const;
+
+#pragma warning(push)
+#pragma warning(disable: 4251)
+    BatchConfig config_;
+    mutable std::mutex mutex_;
+    std::map<std::string, File> files_;
+    std::map<std::string, Batch> batches_;
+    std::deque<std::string> queue_;
+    std::condition_variable cv_;
+    std::thread worker_;
+#pragma warning(pop)
+    bool started_ = false;
+    bool stopping_ = false;
+};
+
+} // namespace kolosal
@@ -0,0 +1,187 @@
+#pragma once
+
+#include "export.hpp"
+#include "server_config.hpp"
+#include "routes/route_interface.hpp"
+#include <json.hpp>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace kolosal
+{
+
+namespace auth
+{
+    class RateLimiter;
+}
+
+/**
+ * @brief Routes completion requests across the nodes of a kolosal cluster
+ *
+ * Every node publishes its state at /v1/cluster/state: the models it has
+ * loaded with their load, and a summary of the routing keys it served
+ * recently (whose KV it likely still holds). Each node polls its peers'
+ * state, so any node can take a request and send it where its cache is.
+ *
+ * A request's routing key is its X-Session-Id header or session_id field or,
+ * without either, the start of its prompt (the messages up to the first user turn), so turns of
+ * one conversation and requests sharing a system prompt get the same key.
+ * Among the nodes with the model loaded, the request goes to one that
+ * advertises the key, else to the key's owner on a consistent hash ring. A
+ * node over its share of the load (load_factor times the mean, with no free
+ * slot) is passed over for the next one on the ring, so a hot key spills
+ * instead of queueing. Forwarded requests are proxied by the route that
+ * received them and carry X-Kolosal-Forwarded, which the next node always
+ * serves itself. A draining node (see DrainManager) takes no new requests and
+ * its peers stop routing to it.
+ *
+ * With share_rate_limits, the state also carries how many requests this node
+ * admitted per (hashed) client IP and API key, and each poll charges what the
+ * peers admitted since the last one to the local RateLimiter, so a client
+ * spreading requests over N nodes gets its limit once rather than N times.
+ *
+ * Thread-safe.
+ */
+class KOLOSAL_SERVER_API ClusterRouter
+{
+public:
+    struct ModelLoad
+    {
+        int active_jobs = 0;
+        int slots_total = 0;
+        int slots_in_use = 0;
+        int64_t pending_tokens = 0;
+    };
+
+    enum class Reason { Only, Affinity, Hash, Fallback };
+
+    struct Stats
+    {
+        uint64_t routed[2][4] = {};     // [local, peer][Reason]
+        uint64_t proxy_errors = 0;      // Peers that failed before answering; served locally instead
+        size_t live_nodes = 0;          // This node included
+    };
+
+    static ClusterRouter& instance();
+
+    /**
+     * @brief Start polling the peers
+     */
+    void start(const ClusterConfig& config);
+    void stop();
+    bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Send a completion request to the node that should serve it
+     *
+     * Called by the completion routes with the parsed body before any local
+     * work. Returns true if a peer answered the request; false means this node
+     * serves it (a peer that fails before answering is skipped).
+     */
+    bool forward(SocketType sock, const RequestContext& request, const nlohmann::json& body);
+
+    /**
+     * @brief Stop routing requests to this node and tell the peers to do the same
+     */
+    void setDraining(bool draining);
+    bool draining() const { return draining_.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Exchange rate limit usage with the peers through @p limiter; null stops it
+     *
+     * The limiter must outlive the exchange, so the server clears it before it goes.
+     */
+    void shareRateLimits(auth::RateLimiter* limiter);
+
+    /**
+     * @brief URL of the live node that should take over a session while this one drains
+     * @param sessionKey The engine's session key (a request's session_id)
+     * @return Empty when no other live node has @p model loaded
+     */
+    std::string handoffTarget(const std::string& model, const std::string& sessionKey) const;
+
+    /**
+     * @brief Advertise a session handed over by a draining peer, so its next turn comes here
+     */
+    void adopt(const std::string& model, const std::string& sessionKey);
+
+    /**
+     * @brief State this node publishes to its peers
+     */
+    nlohmann::json localState() const;
+
+    /**
+     * @brief Every known node with its models, load and freshness
+     */
+    nlohmann::json nodes() const;
+
+    Stats stats() const;
+
+    ~ClusterRouter();
+
+private:
+    struct Node
+    {
+        std::string url;
+        std::string node_id;
+        std::map<std::string, ModelLoad> models;
+        std::unordered_set<uint64_t> prefixes;
+        std::map<uint64_t, uint64_t> admitted[2];   // Requests last reported per key hash: [client IP, API key]
+        std::chrono::steady_clock::time_point last_seen{};
+        int routed_since_poll = 0;      // Requests sent since its load was last read
+        bool self = false;              // The peer list names this node
+        bool draining = false;          // Takes no new requests
+    };
+
+    struct Target
+    {
+        bool local = true;
+        std::string node_id;
+        std::string url;
+    };
+
+    ClusterRouter() = default;
+    ClusterRouter(const ClusterRouter&) = delete;
+    ClusterRouter& operator=(const ClusterRouter&) = delete;
+
+    std::string routingKey(const RequestContext& request, const nlohmann::json& body) const;
+    Target route(const std::string& model, uint64_t keyHash);
+    void remember(uint64_t keyHash);
+    bool proxy(SocketType sock, const RequestContext& request, const Target& target);
+    std::map<std::string, ModelLoad> localModels() const;
+    void rebuildRingLocked();
+    void chargePeerUsageLocked(Node& peer, const nlohmann::json& usage);
+    void run();
+    void poll();
+
+    std::atomic<bool> enabled_{false};
+    std::atomic<bool> draining_{false};
+
+#pragma warning(push)
+#pragma warning(disable: 4251)
+    ClusterConfig config_;
+    std::string node_id_;
+    mutable std::mutex mutex_;
+    std::vector<Node> peers_;
+    std::vector<std::pair<uint64_t, std::string>> ring_;   // Sorted points, owner node id
+    std::unordered_set<uint64_t> recent_;                  // Keys served here, advertised to peers
+    std::deque<uint64_t> recent_order_;
+    auth::RateLimiter* rate_limiter_ = nullptr;
+    Stats stats_;
+    std::condition_variable cv_;
+    std::thread poller_;
+#pragma warning(pop)
+    bool stopping_ = false;
+};
+
+} // namespace kolosal
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "export.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace kolosal {
+
+    /**
+     * @brief What a config reload changed.
+     */
+    struct ConfigReloadResult {
+        bool ok = false;
+        std::string error;                          // Why nothing was applied, when !ok
+        std::string configFile;
+        std::vector<std::string> addedModels;
+        std::vector<std::string> removedModels;
+        std::vector<std::string> updatedModels;     // Swapped next to the running engine
+        std::vector<std::string> unchangedModels;   // Not touched, caches stay warm
+        bool inferenceEnginesReconfigured = false;
+        std::vector<std::string> applied;           // Settings now in effect, e.g. "auth.rate_limit"
+        std::vector<std::string> restartRequired;   // Changed settings read only at startup
+    };
+
+    /**
+     * @brief Re-reads the config file and applies the difference to the running server.
+     *
+     * Only models whose entry changed are touched: new ones are loaded (or registered for
+     * lazy loading), removed ones unloaded, and changed ones swapped while the old engine
+     * keeps serving. Auth, rate limit, CORS, token quota and log settings apply at once;
+     * anything else that changed is reported as needing a restart. Model loads run in the
+     * background and show up as startup states in /health.
+     */
+    class KOLOSAL_SERVER_API ConfigReloader {
+    public:
+        static ConfigReloader& instance();
+
+        // Reloads the file the server was started with. Reloads never overlap.
+        ConfigReloadResult reload();
+
+        // Reloads whenever the file's modification time changes, checked every interval
+        void startWatching(std::chrono::seconds interval);
+        // Stops the watcher and waits for model changes still being applied
+        void stop();
+
+        ~ConfigReloader();
+
+    private:
+        ConfigReloader() = default;
+        ConfigReloader(const ConfigReloader&) = delete;
+        ConfigReloader& operator=(const ConfigReloader&) = delete;
+
+        void watch(std::chrono::seconds interval);
+
+#pragma warning(push)
+#pragma warning(disable: 4251)
+        std::mutex reloadMutex_;                    // Held for a whole reload
+        std::thread applier_;                       // Loads and unloads models of the last reload
+        std::mutex watchMutex_;
+        std::condition_variable watchCv_;
+        std::thread watcher_;
+        std::filesystem::file_time_type lastSeen_{};
+#pragma warning(pop)
+        bool stopping_ = false;
+    };
+
+} // namespace kolosal
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "export.hpp"
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace kolosal
+{
+
+/**
+ * @brief Sampling CPU profiler for the running process
+ *
+ * record() arms a SIGPROF interval timer. The kernel then interrupts whichever
+ * thread is on a CPU when the timer fires, so every thread is sampled in
+ * proportion to the CPU it burns: decode loops, I/O threads and worker pools
+ * alike. Idle threads do not appear. The signal handler only stores the
+ * thread id and its return addresses in a buffer sized up front. It takes no
+ * locks and allocates nothing.
+ *
+ * Only one profile runs at a time. Profiling needs Linux with glibc. Another
+ * SIGPROF user in the process, such as gperftools, would be disturbed while a
+ * profile runs.
+ */
+class KOLOSAL_SERVER_API CpuProfiler
+{
+public:
+    struct Stack
+    {
+        int threadId = 0;
+        std::vector<uintptr_t> frames;  // Return addresses, innermost first
+        size_t count = 0;               // Samples that hit this thread and stack
+    };
+
+    struct Profile
+    {
+        std::chrono::microseconds period{0};
+        std::chrono::milliseconds duration{0};
+        std::vector<Stack> stacks;
+        std::map<int, std::string> threadNames;  // Of the threads still alive at the end
+        size_t samples = 0;
+        size_t dropped = 0;                      // Samples beyond the buffer
+
+        // Folded stacks, one "thread;outer;...;inner count" line per distinct stack, for
+        // flamegraph.pl, speedscope or inferno. Symbols come from dladdr(), so functions
+        // that are not exported show as module+offset.
+        std::string collapsed() const;
+
+        // The gperftools CPU profile format with the process's memory map appended, for
+        // `pprof <binary> cpu.prof`; pprof symbolizes from the binaries
+        std::string pprof() const;
+    };
+
+    static CpuProfiler& instance();
+
+    static bool supported();
+
+    /**
+     * @brief Sample all threads @p frequency times per CPU-second for @p duration
+     *
+     * Blocks for the duration. Returns nothing when another profile is already
+     * running; throws std::runtime_error when profiling is unsupported or the
+     * timer cannot be armed.
+     */
+    std::optional<Profile> record(std::chrono::milliseconds duration, int frequency);
+
+    /**
+     * @brief Name the calling thread, so profiles can tell thread pools apart
+     *
+     * Linux keeps 15 characters. Never call it on the main thread, whose name is the
+     * process name.
+     */
+    static void nameThread(const char* name);
+
+private:
+    CpuProfiler() = default;
+    CpuProfiler(const CpuProfiler&) = delete;
+    CpuProfiler& operator=(const CpuProfiler&) = delete;
+
+#pragma warning(push)
+#pragma warning(disable: 4251)
+    std::mutex mutex_;  // Held for the length of a profile
+#pragma warning(pop)
+};
+
+} // namespace kolosal
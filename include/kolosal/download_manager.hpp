@@ -9,11 +9,37 @@
 #include <memory>
 #include <future>
 #include <chrono>
+#include <vector>
+#include <condition_variable>
+#include <atomic>
+
+namespace kolosal {
+    struct DownloadConfig;
+
+    // Order in which queued downloads are started. A High download (a model an incoming request is
+    // waiting for) also preempts a running Low one (a background or startup prefetch), which is
+    // requeued and later resumes from its partial file.
+    enum class DownloadPriority { Low = 0, Normal = 1, High = 2 };
+
+    inline const char* downloadPriorityName(DownloadPriority priority) {
+        switch (priority) {
+            case DownloadPriority::Low: return "low";
+            case DownloadPriority::High: return "high";
+            default: return "normal";
+        }
+    }
+
+    inline bool parseDownloadPriority(const std::string& name, DownloadPriority& priority) {
+        if (name == "low") { priority = DownloadPriority::Low; return true; }
+        if (name == "normal") { priority = DownloadPriority::Normal; return true; }
+        if (name == "high") { priority = DownloadPriority::High; return true; }
+        return false;
+    }
 
-namespace kolosal {    // Structure to hold engine creation parameters
+    // Structure to hold engine creation parameters
     struct EngineCreationParams {
         std::string model_id;
-        std::string model_type = "llm";  // "llm" or "embedding" - preserve embedding support
+        std::string model_type = "llm";  // "llm", "embedding" or "rerank"
         bool load_immediately;         // Whether to load immediately when download completes (vs register for lazy loading)
         int main_gpu_id;
         LoadingParameters loading_params;
@@ -24,7 +50,7 @@ namespace kolosal {    // Structure to hold engine creation parameters
         // Validation method to ensure parameters are valid
         bool isValid() const {
             if (model_id.empty()) return false;
-            if (model_type != "llm" && model_type != "embedding") return false;
+            if (model_type != "llm" && model_type != "embedding" && model_type != "rerank") return false;
             if (main_gpu_id < -1) return false; // -1 is valid (auto-detect)
             return true;
         }
@@ -42,10 +68,24 @@ namespace kolosal {    // Structure to hold engine creation parameters
         std::string local_path;
         size_t total_bytes;
         size_t downloaded_bytes;
-        double percentage;        std::string status; // "downloading", "completed", "failed", "cancelled", "creating_engine", "paused"
+        double percentage;        std::string status; // "queued", "downloading", "completed", "failed", "cancelled", "creating_engine", "paused"
         std::string error_message;
         std::chrono::system_clock::time_point start_time;
         std::chrono::system_clock::time_point end_time;
+
+        // Current aggregate throughput over all connections, smoothed across progress reports
+        double bytes_per_second;
+        size_t last_sample_bytes;
+        std::chrono::steady_clock::time_point last_sample_time;
+        std::chrono::steady_clock::time_point last_published;  // Last byte count pushed to progress observers
+
+        // SHA-256 the file must match (empty: HuggingFace's published digest if any) and the digest it had
+        std::string expected_sha256;
+        std::string sha256;
+
+        // Scheduling: queued downloads start by priority, then in the order they were requested
+        DownloadPriority priority;
+        unsigned long long sequence;
         
         // Engine creation parameters (if this download is for engine creation)
         std::unique_ptr<EngineCreationParams> engine_params;
@@ -54,23 +94,56 @@ namespace kolosal {    // Structure to hold engine creation parameters
         volatile bool cancelled;
         
         // Pause flag for download control
-        volatile bool paused;        DownloadProgress() : total_bytes(0), downloaded_bytes(0), percentage(0.0), status("downloading"), cancelled(false), paused(false) {}
+        volatile bool paused;
+
+        // Set with cancelled when a higher priority download takes this one's slot; it is requeued, not failed
+        volatile bool preempted;        DownloadProgress() : total_bytes(0), downloaded_bytes(0), percentage(0.0), status("queued"), bytes_per_second(0.0), last_sample_bytes(0),
+                             priority(DownloadPriority::Normal), sequence(0), cancelled(false), paused(false), preempted(false) {}
         
         DownloadProgress(const std::string& id, const std::string& download_url, const std::string& path)
             : model_id(id), url(download_url), local_path(path), total_bytes(0), 
-              downloaded_bytes(0), percentage(0.0), status("downloading"),
-              start_time(std::chrono::system_clock::now()), cancelled(false), paused(false) {}
-    };    // Download manager class to handle concurrent downloads and track progress
+              downloaded_bytes(0), percentage(0.0), status("queued"),
+              start_time(std::chrono::system_clock::now()), bytes_per_second(0.0), last_sample_bytes(0),
+              priority(DownloadPriority::Normal), sequence(0), cancelled(false), paused(false), preempted(false) {}
+    };
+
+    // State of one download as pushed to progress observers, copied out of its DownloadProgress
+    struct DownloadUpdate {
+        std::string model_id;
+        std::string status;
+        std::string error_message;
+        size_t total_bytes = 0;
+        size_t downloaded_bytes = 0;
+        double percentage = 0.0;
+        double bytes_per_second = 0.0;
+        DownloadPriority priority = DownloadPriority::Normal;
+        bool removed = false;           // The record was cleaned up
+        unsigned long long version = 0; // Position in the update feed
+    };
+
+    // Download manager class to handle concurrent downloads and track progress
     class KOLOSAL_SERVER_API DownloadManager {
     public:
         static DownloadManager& getInstance();
 
-        // Start a new download (non-blocking)
-        bool startDownload(const std::string& model_id, const std::string& url, const std::string& local_path);
+        // Apply the concurrency limit, bandwidth caps, connection count and fleet sources from the server config
+        void configure(const DownloadConfig& config);
 
-        // Start a new download with engine creation parameters (non-blocking)
+        // Queue a new download (non-blocking); it starts once a slot is free
+        bool startDownload(const std::string& model_id, const std::string& url, const std::string& local_path,
+                           const std::string& expected_sha256 = "",
+                           DownloadPriority priority = DownloadPriority::Normal);
+
+        // Queue a new download with engine creation parameters (non-blocking)
         bool startDownloadWithEngine(const std::string& model_id, const std::string& url, 
-                                   const std::string& local_path, const EngineCreationParams& engine_params);
+                                   const std::string& local_path, const EngineCreationParams& engine_params,
+                                   const std::string& expected_sha256 = "",
+                                   DownloadPriority priority = DownloadPriority::Normal);
+
+        // Download at High priority and block until the file is in place. Joins (and raises the
+        // priority of) a download already queued or running for the same model and path.
+        bool downloadAndWait(const std::string& model_id, const std::string& url, const std::string& local_path,
+                             std::string& error_message);
 
         // Get download progress for a specific model
         std::shared_ptr<DownloadProgress> getDownloadProgress(const std::string& model_id);
@@ -95,7 +168,15 @@ namespace kolosal {    // Structure to hold engine creation parameters
         std::map<std::string, std::shared_ptr<DownloadProgress>> getAllActiveDownloads();
 
         // Clean up completed/failed downloads older than specified minutes
-        void cleanupOldDownloads(int minutes = 60);        /**
+        void cleanupOldDownloads(int minutes = 60);
+
+        // Wait up to timeout for downloads to change after version `since`, then return the latest
+        // state of each one that did and advance `since`. Observers only take the feed's lock, so
+        // they never contend with the downloads for the manager's.
+        std::vector<DownloadUpdate> waitForUpdates(unsigned long long& since, std::chrono::milliseconds timeout);
+
+        // Shortest interval between byte-count updates pushed to observers
+        std::chrono::milliseconds progressInterval() const;        /**
          * @brief Load a model at startup, using DownloadManager for URLs
          * 
          * This method is specifically designed for startup model loading.
@@ -104,17 +185,21 @@ namespace kolosal {    // Structure to hold engine creation parameters
          * 
          * @param model_id The unique identifier for the model
          * @param model_path The path or URL to the model
-         * @param model_type The type of model ("llm" or "embedding")
+         * @param model_type The type of model ("llm", "embedding" or "rerank")
          * @param load_params Loading parameters for the model
          * @param main_gpu_id The main GPU ID to use
          * @param load_immediately Whether to load immediately or register for lazy loading
          * @param inference_engine Inference engine to use (llama-cpu, llama-cuda, llama-vulkan, etc.)
+         * @param expected_sha256 SHA-256 a downloaded model must match (empty: none, or HuggingFace's published digest)
+         * @param priority Scheduling priority of the download; startup downloads default to Low
          * @return True if the model was successfully processed, false otherwise
          */
         bool loadModelAtStartup(const std::string& model_id, const std::string& model_path, 
                                const std::string& model_type, const LoadingParameters& load_params, 
                                int main_gpu_id, bool load_immediately,
-                               const std::string& inference_engine = "llama-cpu");
+                               const std::string& inference_engine = "llama-cpu",
+                               const std::string& expected_sha256 = "",
+                               DownloadPriority priority = DownloadPriority::Low);
 
     private:
         DownloadManager() = default;
@@ -128,9 +213,39 @@ namespace kolosal {    // Structure to hold engine creation parameters
 #pragma warning(disable: 4251)
         std::map<std::string, std::shared_ptr<DownloadProgress>> downloads_;
         std::map<std::string, std::future<void>> download_futures_;
+        std::vector<std::future<void>> retired_futures_;  // Replaced while their thread was still finishing
+        std::vector<std::shared_ptr<DownloadProgress>> queue_;
+        std::vector<std::shared_ptr<DownloadProgress>> running_;
+#pragma warning(pop)
+        mutable std::mutex downloads_mutex_;
+        std::condition_variable downloads_cv_;  // Notified whenever a download leaves the queued/running states
+        int max_concurrent_ = 2;
+        int connections_ = 0;
+        unsigned long long next_sequence_ = 0;
+
+        // Update feed for progress observers (lock order: downloads_mutex_, then feed_mutex_)
+#pragma warning(push)
+#pragma warning(disable: 4251)
+        std::map<std::string, DownloadUpdate> feed_;
+        std::atomic<int> progress_interval_ms_{500};
 #pragma warning(pop)
-        mutable std::mutex downloads_mutex_;        // Internal method to perform the actual download
-        void performDownload(std::shared_ptr<DownloadProgress> progress);
+        mutable std::mutex feed_mutex_;
+        std::condition_variable feed_cv_;
+        unsigned long long feed_version_ = 0;
+
+        // Push the download's current state to observers, called with downloads_mutex_ held
+        void publishLocked(const DownloadProgress& progress, bool removed = false);
+
+        // Scheduling, all called with downloads_mutex_ held
+        void enqueueLocked(std::shared_ptr<DownloadProgress> progress);
+        void dispatchLocked();
+        void retireFutureLocked(const std::string& model_id);
+
+        // Give up the download's slot (idempotent), requeueing it if it was preempted
+        void releaseSlot(std::shared_ptr<DownloadProgress> progress);
+
+        // Internal method to perform the actual download
+        void performDownload(std::shared_ptr<DownloadProgress> progress, int connections);
         
         // Internal method to create engine after successful download
         void createEngineAfterDownload(std::shared_ptr<DownloadProgress> progress);
@@ -2,6 +2,7 @@
 
 #include "export.hpp"
 #include <string>
+#include <vector>
 #include <functional>
 
 namespace kolosal {
@@ -16,12 +17,21 @@ namespace kolosal {
         std::string error_message;
         std::string local_path;
         size_t total_bytes;
+        std::string sha256; // Hex digest of the file when it was hashed during or after the download
 
         DownloadResult() : success(false), total_bytes(0) {}
         DownloadResult(bool success, const std::string& error = "", const std::string& path = "", size_t bytes = 0)
             : success(success), error_message(error), local_path(path), total_bytes(bytes) {}
     };
 
+    // Places a download is looked for before its origin URL, so a fleet fetches each model over the WAN once
+    struct DownloadSources {
+        std::vector<std::string> peers;   // Base URLs of kolosal servers sharing their models under /v1/model-files/
+        std::vector<std::string> mirrors; // Base URLs of HTTP mirrors holding files as <base>/<file name>
+        std::string cache_dir;            // Shared directory (e.g. a network mount) of downloaded models
+        std::string peer_api_key;         // Sent as X-API-Key to peers that require authentication
+    };
+
     /**
      * Check if a string is a valid HTTP/HTTPS URL
      * @param url The URL string to validate
@@ -115,12 +125,20 @@ namespace kolosal {
     );
 
     /**
-     * Download a file from a URL to a local path with cancellation and resume support
+     * Download a file from a URL to a local path with cancellation and resume support.
+     * Files of 64 MB and more are fetched over several concurrent range requests into a preallocated
+     * "<local_path>.part" file whose per-segment progress is kept in "<local_path>.part.segments";
+     * the file is renamed to local_path once every segment has finished.
+     * The file is hashed with SHA-256 as it is written and checked against expected_sha256, or the
+     * digest HuggingFace publishes for LFS files when none is given. A mismatching file is deleted.
+     * Hashed files are recorded in the directory's manifest, so a verified file is not read again.
      * @param url The URL to download from
      * @param local_path The local path to save the file to
-     * @param progress_callback Optional callback for progress updates
+     * @param progress_callback Optional callback for progress updates (aggregated over all segments)
      * @param cancelled Pointer to cancellation flag
      * @param resume Whether to attempt to resume if partial file exists
+     * @param connections Maximum concurrent connections (0 = default of 8, 1 = single stream)
+     * @param expected_sha256 Optional hex SHA-256 the file must match
      * @return DownloadResult containing success status and details
      */
     KOLOSAL_SERVER_API DownloadResult download_file_with_cancellation_and_resume(
@@ -128,9 +146,70 @@ namespace kolosal {
         const std::string& local_path,
         DownloadProgressCallback progress_callback,
         volatile bool* cancelled,
-        bool resume = true
+        bool resume = true,
+        int connections = 0,
+        const std::string& expected_sha256 = ""
     );
 
+    /**
+     * Look up the SHA-256 a host publishes for a file (HuggingFace LFS X-Linked-Etag)
+     * @param url The download URL
+     * @return Lower-case hex digest, or an empty string if none is published
+     */
+    KOLOSAL_SERVER_API std::string get_published_sha256(const std::string& url);
+
+    /**
+     * Check the manifest beside a file for an entry matching its current size and modification time
+     * @param local_path The downloaded file
+     * @param expected_sha256 Digest the entry must carry (empty accepts any recorded digest)
+     * @return true if the file was hashed after its last change and matches
+     */
+    KOLOSAL_SERVER_API bool is_download_verified(const std::string& local_path, const std::string& expected_sha256 = "");
+
+    /**
+     * Record a file's digest in the manifest (".kolosal-manifest.json") of its directory
+     * @param local_path The downloaded file
+     * @param url Where the file came from
+     * @param sha256 Hex digest of the file
+     * @param verified Whether the digest was checked against a published or user-supplied one
+     * @return true if the manifest was written
+     */
+    KOLOSAL_SERVER_API bool record_download_manifest(const std::string& local_path, const std::string& url,
+                                                     const std::string& sha256, bool verified);
+
+    /**
+     * Look up a file's manifest entry, if it is current (same size and modification time as when hashed)
+     * @param local_path The downloaded file
+     * @param sha256 Receives the recorded hex digest
+     * @param url Receives the URL the file was downloaded from
+     * @return true if the entry exists and still describes the file
+     */
+    KOLOSAL_SERVER_API bool find_download_manifest_entry(const std::string& local_path, std::string& sha256, std::string& url);
+
+    /**
+     * Set where downloads are looked for before their origin: a shared cache directory first, then the
+     * peer or mirror that answers fastest. Files from any of them are checked against the expected
+     * SHA-256 (or the digest a peer advertises) before they are used, and origin downloads are
+     * copied into the cache directory for the rest of the fleet.
+     * @param sources Peers, mirrors and cache directory; empty fields are skipped
+     */
+    KOLOSAL_SERVER_API void set_download_sources(const DownloadSources& sources);
+
+    /**
+     * Set the bandwidth caps applied to transfers started from now on (0 = unlimited)
+     * @param total_bytes_per_second Cap shared by every download in the process
+     * @param per_download_bytes_per_second Cap for each download, split across its connections
+     */
+    KOLOSAL_SERVER_API void set_download_bandwidth_limits(size_t total_bytes_per_second,
+                                                          size_t per_download_bytes_per_second);
+
+    /**
+     * Number of model download connections transferring right now (one per segment of a
+     * segmented download); each holds a curl receive buffer
+     * @return Connections inside curl_easy_perform()
+     */
+    KOLOSAL_SERVER_API size_t active_download_transfers();
+
     /**
      * Get the directory containing the current executable
      * @return Path to the executable directory
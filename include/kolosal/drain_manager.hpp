@@ -0,0 +1,148 @@
+#pragma once
+
+#include "export.hpp"
+#include "server_config.hpp"
+#include "utils.hpp"
+#include "inference_interface.h"
+#include <json.hpp>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace kolosal
+{
+
+/**
+ * @brief Takes a cluster node out of service without losing its work
+ *
+ * POST /v1/cluster/drain starts a drain. The node stops taking new
+ * completions (they are answered 503 with Retry-After and the peers stop
+ * routing here) and running generations get drain_grace_seconds to finish.
+ * Those still running after that are suspended: the completion route that
+ * serves one sends the job's KV state to POST /v1/internal/resume on a peer
+ * and relays the rest of the output to its client, which sees one
+ * uninterrupted response. Once nothing runs (or drain_timeout_seconds
+ * passed), the warm sessions are exported and handed to the node the hash
+ * ring now assigns each session key to (POST /v1/internal/sessions), which
+ * advertises the key so the conversation's next turn goes there.
+ *
+ * Both internal requests carry a JSON header, a newline and the state in
+ * RemotePrefill::encode()'s layout (absent for a generation that had not
+ * decoded its prompt yet).
+ *
+ * Thread-safe.
+ */
+class KOLOSAL_SERVER_API DrainManager
+{
+public:
+    enum class State { Serving, Draining, Migrating, Drained };
+
+    struct Stats
+    {
+        uint64_t drains = 0;                // Drains started
+        uint64_t generations_moved = 0;     // Running generations finished on a peer
+        uint64_t generations_failed = 0;    // Suspended generations no peer could continue
+        uint64_t sessions_moved = 0;        // Warm sessions handed to a peer
+        uint64_t sessions_failed = 0;       // Warm sessions dropped: no peer took them
+    };
+
+    // Receives a resumed generation's output; returning false abandons it (the client went away)
+    using OutputHandler = std::function<bool(const std::string& text, const std::vector<int32_t>& tokens)>;
+
+    static DrainManager& instance();
+
+    void configure(const ClusterConfig& config);
+
+    /**
+     * @brief Start draining in the background
+     * @return False if the node is already draining or cluster routing is off
+     */
+    bool start();
+
+    /**
+     * @brief Take requests again; sessions already handed over stay with their new node
+     */
+    void cancel();
+
+    State state() const { return state_.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief True from start() until cancel(); new completions are refused
+     */
+    bool draining() const { return state() != State::Serving; }
+
+    /**
+     * @brief True once running generations should be suspended and resumed on a peer
+     */
+    bool migrating() const
+    {
+        const State current = state();
+        return current == State::Migrating || current == State::Drained;
+    }
+
+    /**
+     * @brief 503 for a completion that reached this node while it drains
+     */
+    void sendDraining(SocketType sock) const;
+
+    /**
+     * @brief Finish a suspended generation on a peer
+     * @param model The model the request named
+     * @param body The request as the client sent it
+     * @param state The job's KV state (getJobKvState()); nullptr if it had not decoded its prompt
+     * @param generated Tokens the job generated here, already sent to the client
+     * @param maxNewTokens The job's output limit (0 or less: none)
+     * @return False if the generation could not be continued; the output then ends where it stopped
+     */
+    bool resume(const std::string& model, const std::string& body, std::shared_ptr<const KvSequenceState> state,
+                size_t generated, int maxNewTokens, const OutputHandler& onOutput);
+
+    /**
+     * @brief Drain progress, served at GET /v1/cluster/drain
+     */
+    nlohmann::json status() const;
+
+    Stats stats() const;
+
+    void stop();
+
+    ~DrainManager();
+
+private:
+    DrainManager() = default;
+    DrainManager(const DrainManager&) = delete;
+    DrainManager& operator=(const DrainManager&) = delete;
+
+    void run();
+    bool waitIdle(std::chrono::steady_clock::time_point deadline);
+    void moveSessions();
+    bool post(const std::string& url, const std::string& body, const std::function<size_t(const char*, size_t)>& onData,
+              long& status);
+
+    std::atomic<State> state_{State::Serving};
+
+#pragma warning(push)
+#pragma warning(disable: 4251)
+    ClusterConfig config_;
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::thread worker_;
+    std::chrono::steady_clock::time_point started_{};
+#pragma warning(pop)
+    bool cancelled_ = false;
+
+    std::atomic<uint64_t> drains_{0};
+    std::atomic<uint64_t> generations_moved_{0};
+    std::atomic<uint64_t> generations_failed_{0};
+    std::atomic<uint64_t> sessions_moved_{0};
+    std::atomic<uint64_t> sessions_failed_{0};
+};
+
+} // namespace kolosal
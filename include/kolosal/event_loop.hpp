@@ -0,0 +1,73 @@
+#pragma once
+
+#include "export.hpp"
+
+#include <memory>
+#include <vector>
+
+#ifdef _WIN32
+#include <winsock2.h>
+using SocketType = SOCKET;
+#else
+#include <sys/socket.h>
+#include <unistd.h>
+using SocketType = int;
+#endif
+
+namespace kolosal {
+
+    /**
+     * @brief Readiness-notification poller used by the server's I/O threads.
+     *
+     * Wraps epoll on Linux, kqueue on macOS/BSD and WSAPoll on Windows behind a
+     * single interface. Sockets are registered for read readiness in one-shot
+     * mode: once an event has been delivered for a socket it stays disarmed until
+     * rearm() is called, so a connection is never processed by two threads at once.
+     *
+     * add/rearm/remove/wait must be called from the owning I/O thread; wakeup()
+     * may be called from any thread to interrupt a blocking wait().
+     */
+    class KOLOSAL_SERVER_API EventLoop {
+    public:
+        struct Event {
+            void* userData = nullptr;   // Pointer supplied at registration
+            bool  readable = false;     // Data (or EOF) is available to read
+            bool  hangup   = false;     // Peer closed or socket error
+        };
+
+        EventLoop();
+        ~EventLoop();
+
+        EventLoop(const EventLoop&) = delete;
+        EventLoop& operator=(const EventLoop&) = delete;
+
+        // True if the underlying poller was created successfully
+        bool valid() const;
+
+        // Register a socket for one-shot read readiness
+        bool add(SocketType sock, void* userData);
+
+        // Re-enable a socket after its event has been consumed
+        bool rearm(SocketType sock, void* userData);
+
+        // Stop watching a socket (does not close it)
+        void remove(SocketType sock);
+
+        // Wait up to timeoutMs for events; returns the number of events written to `events`
+        int wait(std::vector<Event>& events, int timeoutMs);
+
+        // Interrupt a concurrent wait() from another thread
+        void wakeup();
+
+        // Name of the active backend ("epoll", "kqueue", "wsapoll")
+        static const char* backendName();
+
+    private:
+        struct Impl;
+#pragma warning(push)
+#pragma warning(disable: 4251)
+        std::unique_ptr<Impl> pImpl;
+#pragma warning(pop)
+    };
+
+} // namespace kolosal
@@ -1,6 +1,9 @@
 #pragma once
 
 #include "export.hpp"
+#include <cstdint>
+#include <functional>
+#include <istream>
 #include <string>
 #include <vector>
 #include <unordered_map>
@@ -38,11 +41,73 @@ struct FaissResult
     nlohmann::json response_data;
 };
 
+/**
+ * @brief Per-query search knobs; 0 keeps the collection's tuned default
+ */
+struct FaissSearchParams
+{
+    int nprobe = 0;     // IVF lists to visit
+    int efSearch = 0;   // HNSW candidate list size
+    nlohmann::json filter;  // Qdrant-style payload filter applied inside the index search; null = none
+    std::vector<std::string> fields;    // Payload keys returned with each hit; empty = all
+};
+
 /**
  * @brief FAISS-based vector database client
  * 
  * This client provides thread-safe operations for interacting with FAISS
  * vector database. All operations return futures for non-blocking execution.
+ *
+ * Mutations are appended to a per-collection write-ahead log (<collection>.wal)
+ * and acknowledged once it is fsynced; the index and metadata files are only
+ * rewritten by background checkpoints, and the log is replayed on load.
+ *
+ * Every collection has its own index (type, metric and dimensions), files,
+ * write-ahead log and locks, so a small collection's queries never scan or wait
+ * on a large one. Collections load on first use and can be unloaded on their own.
+ *
+ * Searches, getPoints and scrollPoints only take a shared lock, so they run
+ * concurrently with each other and never wait on the WAL. New vectors go to a
+ * small flat delta index that every search also scans; a background thread
+ * merges it into the main index in bounded batches.
+ *
+ * Deletes only tombstone a vector in the main index, which searches skip with
+ * an id selector; a background rebuild compacts them away once they make up
+ * tombstoneCompactRatio of it.
+ *
+ * A collection's main index starts out Flat. Once it holds enough vectors
+ * for its target type (IVF, IVFPQ, HNSW, HNSWSQ8, SQ8, SQfp16, IVFSQ8,
+ * IVFSQfp16 or Auto), a background
+ * thread trains the target index on a sample and fills it. It then tunes
+ * nprobe/efSearch to the recall target and swaps the new index in.
+ *
+ * DiskIVFPQ collections keep only IVF-PQ codes in memory and write the
+ * full-precision vectors to <collection>.vectors; a search takes
+ * diskRerankFactor x limit candidates from the codes and re-scores them with
+ * the exact vectors read back in one batch, so RAM stays bounded by the code
+ * size while results keep full-precision scores. With exactRerank, every
+ * quantized type (IVFPQ, HNSWSQ8 and the SQ types) is served the same way.
+ *
+ * With mmapIndex, an IVF index file is mapped rather than read at load, so a
+ * large collection is searchable at once and its inverted lists fault in on
+ * demand. A background thread warms the lists recent queries probed first,
+ * then the rest, and finally swaps in an in-memory copy; merges, rebuilds
+ * and checkpoints wait for that, with new vectors staying in the delta.
+ *
+ * With useGPU (and a FAISS built with GPU support), Flat, IVF and IVFPQ main
+ * indexes are mirrored onto the GPUs: on one device, split across several
+ * (shard) or copied to each (replica). The CPU index stays the master; vectors
+ * merged since the last copy are searched on the CPU, and a background thread
+ * re-copies the index once gpuSyncPoints of them piled up. Filtered searches,
+ * per-query nprobe/efSearch and any GPU failure fall back to the CPU index.
+ *
+ * A collection can be copied to another server while it takes writes:
+ * exportSnapshot streams its last checkpoint plus the WAL records since, and
+ * the copy then follows the source by applying readChanges output. Change
+ * stream positions are byte offsets into the WAL records written since the
+ * collection loaded; a checkpoint keeps the previous log as <collection>.wal.prev,
+ * so a replica may fall up to one checkpoint interval behind before it needs
+ * a new snapshot.
  */
 class KOLOSAL_SERVER_API FaissClient
 {
@@ -52,15 +117,47 @@ public:
      */
     struct Config
     {
-        std::string indexType = "Flat";
+        /**
+         * @brief Per-collection overrides; empty or zero fields fall back to the defaults below
+         */
+        struct CollectionConfig
+        {
+            std::string indexType;
+            std::string metricType;
+            int dimensions = 0;     // 0 = taken from the first vectors the collection sees
+            int nlist = 0;
+            int nprobe = 0;
+            int efSearch = 0;
+            std::string gpuMode;    // single, shard, replica or off; empty = the client-wide gpuMode
+            std::string textCompression;    // dict or off; empty = the client-wide textCompression
+        };
+
+        std::string indexType = "Flat";     // Flat, IVF, IVFPQ, HNSW, HNSWSQ8, SQ8, SQfp16, IVFSQ8, IVFSQfp16, DiskIVFPQ or Auto
         std::string indexPath = "./data/faiss_index";
         int dimensions = 1536;
         bool normalizeVectors = true;
         int nlist = 100;
         int nprobe = 10;
         bool useGPU = false;
-        int gpuDevice = 0;
+        int gpuDevice = 0;                  // Device of single mode when gpuDevices is empty
+        std::string gpuMode = "single";     // single, shard (split across GPUs) or replica (full copy per GPU)
+        std::vector<int> gpuDevices;        // GPUs for shard/replica mode; empty = all visible
+        int gpuSyncPoints = 65536;          // Re-copy the GPU index once this many vectors were merged since
         std::string metricType = "IP"; // L2 or IP (Inner Product)
+        int walSyncMs = 10;                 // fsync the write-ahead log this often; 0 = after every mutation
+        int checkpointIntervalSec = 300;    // Rewrite the index and drop the WAL this often (0 = size only)
+        int checkpointWalMB = 256;          // ...or once the WAL grows past this size (0 = interval only)
+        int deltaMergePoints = 4096;        // Merge the insert buffer into the main index at this size
+        std::string autoIndexType = "IVFPQ";    // What an Auto collection grows into
+        int autoIndexThreshold = 100000;        // Live vectors at which an Auto collection is rebuilt
+        float recallTarget = 0.95f;             // recall@10 that nprobe/efSearch are tuned to after a rebuild
+        int efSearch = 64;                      // Default HNSW efSearch until tuned
+        float tombstoneCompactRatio = 0.2f;     // Rebuild once this share of the main index is deleted vectors
+        bool mmapIndex = true;                  // Map IVF inverted lists from the index file at load, read them in later
+        int diskRerankFactor = 4;               // DiskIVFPQ: candidates per result re-scored from the vectors file
+        bool exactRerank = false;               // Keep the vectors of every quantized type on disk and re-score with them
+        std::string textCompression = "off";    // "dict": deflate long payload strings with a dictionary trained per collection
+        std::unordered_map<std::string, CollectionConfig> collections;
     };
     
     /**
@@ -74,6 +171,22 @@ public:
      */
     ~FaissClient();
     
+    /**
+     * @brief FAISS index_factory description a collection's main index is built from
+     * @param index_type Flat, IVF, IVFPQ, HNSW, HNSWSQ8, SQ8, SQfp16, IVFSQ8 or IVFSQfp16
+     *                   (DiskIVFPQ routes through IVFPQ)
+     * @param dimensions Vector dimensions
+     * @param nlist Inverted lists of IVF types
+     * @return The description; "Flat" for anything else
+     */
+    static std::string indexFactoryString(const std::string& index_type, int dimensions, int nlist);
+
+    /**
+     * @brief Approximate memory held by the loaded collections
+     * @return One object per collection with its index, delta buffer and payload sizes
+     */
+    nlohmann::json memoryUsage() const;
+    
     // Delete copy constructor and assignment operator
     FaissClient(const FaissClient&) = delete;
     FaissClient& operator=(const FaissClient&) = delete;
@@ -92,7 +205,7 @@ public:
      * @brief Create a collection if it doesn't exist (initialize index)
      * @param collection_name Name of the collection (used for file path)
      * @param vector_size Size of the vectors (embedding dimensions)
-     * @param distance Distance metric (L2, IP)
+     * @param distance Distance metric (L2, IP) for a new collection; an existing one keeps its own
      * @return Future with result of collection creation
      */
     std::future<FaissResult> createCollection(
@@ -108,6 +221,13 @@ public:
      */
     std::future<FaissResult> collectionExists(const std::string& collection_name);
     
+    /**
+     * @brief Checkpoint a loaded collection and release its index from memory
+     * @param collection_name Name of the collection
+     * @return Future with result (404 if the collection is not loaded)
+     */
+    std::future<FaissResult> unloadCollection(const std::string& collection_name);
+    
     /**
      * @brief Upsert points (insert or update) into collection
      * @param collection_name Name of the collection
@@ -147,28 +267,111 @@ public:
      * @param query_vector Vector to search for
      * @param limit Maximum number of results
      * @param score_threshold Minimum score threshold
+     * @param params Per-query nprobe/efSearch overrides and payload filter
      * @return Future with search results
      */
     std::future<FaissResult> search(
         const std::string& collection_name,
         const std::vector<float>& query_vector,
         int limit = 10,
-        float score_threshold = 0.0f
+        float score_threshold = 0.0f,
+        const FaissSearchParams& params = {}
+    );
+    
+    /**
+     * @brief Search for several query vectors in one FAISS call
+     * @param collection_name Name of the collection
+     * @param query_vectors Vectors to search for
+     * @param limit Maximum number of results per query
+     * @param score_threshold Minimum score threshold
+     * @param params Per-query nprobe/efSearch overrides and payload filter, applied to every query
+     * @return Future with one result list per query, in query order
+     */
+    std::future<FaissResult> searchBatch(
+        const std::string& collection_name,
+        const std::vector<std::vector<float>>& query_vectors,
+        int limit = 10,
+        float score_threshold = 0.0f,
+        const FaissSearchParams& params = {}
     );
     
     /**
      * @brief Scroll through all points in a collection (for listing)
      * @param collection_name Name of the collection
      * @param limit Maximum number of points to retrieve per request
-     * @param offset Offset for pagination
+     * @param offset Cursor returned as next_page_offset by the previous page ("" = first page)
+     * @param with_payload Include each point's payload; listings of ids leave it out
+     * @param filter Payload filter in Qdrant syntax; null walks every point
      * @return Future with points data
      */
     std::future<FaissResult> scrollPoints(
         const std::string& collection_name,
         int limit = 1000,
-        const std::string& offset = ""
+        const std::string& offset = "",
+        bool with_payload = true,
+        const nlohmann::json& filter = nullptr
     );
 
+    /**
+     * @brief Write a point-in-time snapshot of a collection, on the calling thread
+     *
+     * The checkpoint files, the vectors file and the synced WAL are hard-linked
+     * under the collection's lock and streamed after it is released, so writers
+     * only wait for the links.
+     * @param collection_name Name of the collection
+     * @param sink Receives the archive piece by piece; returning false stops the export
+     * @return Result whose response_data holds the collection, the epoch and the change
+     *         stream position the snapshot ends at (409 before the first checkpoint)
+     */
+    FaissResult exportSnapshot(
+        const std::string& collection_name,
+        const std::function<bool(const char*, size_t)>& sink
+    );
+
+    /**
+     * @brief Replace a collection with a snapshot written by exportSnapshot, on the calling thread
+     *
+     * Every file is staged and checked against its checksum before the collection is
+     * touched; it is then unloaded, its files swapped and loaded again. Requests in
+     * between are refused with 409.
+     * @param collection_name Name of the collection to replace
+     * @param in The archive
+     * @return Result whose response_data holds the source's epoch and position, from which
+     *         readChanges on the source continues
+     */
+    FaissResult importSnapshot(const std::string& collection_name, std::istream& in);
+
+    /**
+     * @brief WAL records on disk after a change stream position, on the calling thread
+     * @param collection_name Name of the collection
+     * @param epoch Epoch of the position, from a snapshot or an earlier call
+     * @param position Position to continue from
+     * @param max_bytes Records that would go past this wait for the next call; at least one is returned
+     * @param records Receives the records, framed as in the WAL
+     * @return Result whose response_data holds the epoch, the position after the records
+     *         and the end of the stream; 410 if the position belongs to another load of the
+     *         collection or was checkpointed away
+     */
+    FaissResult readChanges(
+        const std::string& collection_name,
+        const std::string& epoch,
+        uint64_t position,
+        size_t max_bytes,
+        std::string& records
+    );
+
+    /**
+     * @brief Apply records from readChanges on a replica, keeping the source's internal ids
+     *
+     * Applying a record twice changes nothing, so a batch that failed part way can
+     * be applied again from the same position.
+     * @param collection_name Name of the collection
+     * @param records Records as readChanges returned them
+     * @return Future with result; response_data["changes"] lists every upsert (id, payload)
+     *         and delete (id) in order
+     */
+    std::future<FaissResult> applyChanges(const std::string& collection_name, std::string records);
+
 private:
     class Impl;
     std::unique_ptr<Impl> pImpl;
@@ -0,0 +1,252 @@
+#pragma once
+
+#include "export.hpp"
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <json.hpp>
+
+namespace kolosal
+{
+
+/**
+ * @brief External ids and payloads of one FAISS collection, keyed by internal id
+ *
+ * Checkpointed points live in a memory-mapped <collection>.points file and are
+ * only decoded when a lookup touches them, so loading a collection costs one
+ * mmap instead of parsing every payload, and checkpointed points take no heap
+ * memory. Points changed since the last checkpoint are kept in a small
+ * in-memory overlay that shadows the file until the next write().
+ *
+ * File layout, in host byte order like the WAL:
+ *   header   magic, version, count, ids table offset, hash table offset,
+ *            dictionary offset, dictionary length (version 2)
+ *   dict     text compression dictionary, if one was trained
+ *   records  [u32 id length][id][u32 payload length][CBOR payload] per point
+ *   ids      count x {i64 internal id, u64 record offset}, sorted by internal id
+ *   hashes   count x {u64 FNV-1a of the id, u64 ids table slot}, sorted by hash
+ *
+ * With text compression on, top-level string values of 64 bytes or more are
+ * stored as CBOR byte strings: the raw deflate of the text against a preset
+ * dictionary, after its u32 length. The dictionary holds the 32 KB of text
+ * most shared between points, picked from a sample of the collection by the
+ * first write() that finds enough of it; every point is compressed then, and
+ * later ones as they are put(). Values are inflated only when a lookup
+ * returns them, so search hits cost one inflate per returned field.
+ *
+ * Payload filters are answered from per-field inverted indexes, built the
+ * first time a filter names the field and kept current by put() and erase().
+ *
+ * Not thread-safe except for concurrent const calls; the owning collection
+ * serializes writers through its locks.
+ */
+class KOLOSAL_SERVER_API FaissPointStore
+{
+public:
+    using Payload = std::unordered_map<std::string, nlohmann::json>;
+
+    FaissPointStore();
+    ~FaissPointStore();
+
+    FaissPointStore(const FaissPointStore&) = delete;
+    FaissPointStore& operator=(const FaissPointStore&) = delete;
+
+    /**
+     * @brief Map a points file; a missing file opens an empty store
+     * @param path File written by write()
+     * @param error Set when the file exists but cannot be mapped or is malformed
+     * @return True on success
+     */
+    bool open(const std::filesystem::path& path, std::string& error);
+
+    /**
+     * @brief Unmap the file and drop the overlay
+     */
+    void close();
+
+    /**
+     * @brief Number of live points
+     */
+    size_t size() const;
+
+    /**
+     * @brief Points changed or removed since the file was mapped
+     */
+    size_t pendingChanges() const;
+
+    /**
+     * @brief Approximate memory held by the store
+     * @param mapped_bytes Set to the size of the mapped points file
+     * @return Heap bytes of the overlay and the payload field indexes
+     */
+    size_t memoryUsage(size_t& mapped_bytes) const;
+
+    /**
+     * @brief Look up the internal id of an external id
+     * @return False if the point does not exist
+     */
+    bool find(const std::string& id, int64_t& internal_id) const;
+
+    /**
+     * @brief Whether an internal id belongs to a live point
+     */
+    bool contains(int64_t internal_id) const;
+
+    /**
+     * @brief External id of a live point
+     * @return False if the internal id is not live
+     */
+    bool externalId(int64_t internal_id, std::string& id) const;
+
+    /**
+     * @brief Decoded payload of a live point
+     * @return False if the internal id is not live
+     */
+    bool payload(int64_t internal_id, nlohmann::json& payload) const;
+
+    /**
+     * @brief Payload of a live point limited to some top-level keys
+     *
+     * Values of the other keys are skipped in the stored CBOR without being decoded.
+     * @param fields Keys to return; empty returns the whole payload
+     * @return False if the internal id is not live
+     */
+    bool payload(int64_t internal_id, const std::vector<std::string>& fields, nlohmann::json& payload) const;
+
+    /**
+     * @brief Insert or replace a point; a previous internal id of the same external id is dropped
+     */
+    void put(const std::string& id, int64_t internal_id, const Payload& payload);
+
+    /**
+     * @brief Remove a point
+     * @param internal_id Set to the removed point's internal id
+     * @return False if the point does not exist
+     */
+    bool erase(const std::string& id, int64_t& internal_id);
+
+    /**
+     * @brief Visit live points in ascending internal id order until fn returns false
+     * @param from Smallest internal id to visit; earlier points are skipped by binary search
+     */
+    void forEach(const std::function<bool(int64_t, const std::string&)>& fn,
+                 int64_t from = std::numeric_limits<int64_t>::min()) const;
+
+    /**
+     * @brief Mark the points matching a payload filter
+     *
+     * Filters use Qdrant's syntax: must, should and must_not lists whose
+     * conditions are nested filters, {"key", "match": {"value"|"any"|"except"}}
+     * or {"key", "range": {"gt"|"gte"|"lt"|"lte"}}. Dotted keys reach nested
+     * fields, and an array field matches if any of its elements does.
+     * @param filter Filter object
+     * @param id_limit Bitmap size in ids; every live internal id is below it
+     * @param bitmap Set to one bit per internal id, in faiss::IDSelectorBitmap layout
+     * @param error Set if the filter is malformed
+     * @return False if the filter is malformed
+     */
+    bool select(const nlohmann::json& filter, int64_t id_limit, std::vector<uint8_t>& bitmap, std::string& error) const;
+
+    /**
+     * @brief Write every live point to a new points file
+     *
+     * Records of checkpointed points are copied without decoding them, except
+     * by the write() that trains the dictionary, which re-encodes them all.
+     * @return False with error set if the file could not be written
+     */
+    bool write(const std::filesystem::path& path, std::string& error) const;
+
+    /**
+     * @brief Rename a file produced by write() over the mapped one and map it
+     *
+     * The overlay is cleared only once the new file is mapped; on failure the
+     * store keeps serving the old file and the overlay.
+     */
+    bool replace(const std::filesystem::path& written, const std::filesystem::path& target, std::string& error);
+
+    /**
+     * @brief Compress long strings of the points put from now on (see above); off by default
+     */
+    void setTextCompression(bool enabled) { compress_ = enabled; }
+
+    /**
+     * @brief Size of the trained dictionary, 0 before one is trained
+     */
+    size_t dictionaryBytes() const { return dictionary_.size(); }
+
+    /**
+     * @brief Process-wide text compression counters, for /metrics
+     */
+    struct CompressionStats
+    {
+        uint64_t raw_bytes = 0;         // Strings compressed, before
+        uint64_t stored_bytes = 0;      // ...and after, length prefix included
+        uint64_t inflations = 0;        // Values decompressed for lookups
+        double inflate_seconds = 0.0;   // Time spent decompressing them
+        uint64_t dictionaries = 0;      // Dictionaries trained
+    };
+    static CompressionStats compressionStats();
+
+private:
+    struct Entry
+    {
+        std::string id;
+        std::string payload;    // CBOR
+    };
+
+    // One record of the mapped file; views point into the mapping
+    struct Record
+    {
+        std::string_view bytes;
+        std::string_view id;
+        std::string_view payload;
+    };
+
+    // Points holding one value of a field; keyed by the value's JSON text
+    struct Posting
+    {
+        nlohmann::json value;
+        std::unordered_set<int64_t> ids;
+    };
+    using FieldIndex = std::unordered_map<std::string, Posting>;
+
+    class MappedFile;
+
+    bool baseFind(const std::string& id, int64_t& internal_id) const;
+    bool baseSlot(int64_t internal_id, uint64_t& slot) const;
+    bool baseRecord(uint64_t slot, Record& record) const;
+    int64_t baseInternalId(uint64_t slot) const;
+    bool baseLive(int64_t internal_id) const;
+    void dropLive(int64_t internal_id);
+    const FieldIndex& fieldIndexLocked(const std::string& key) const;
+    void indexPointLocked(int64_t internal_id, const nlohmann::json& payload, bool add) const;
+    bool selectFilterLocked(const nlohmann::json& filter, std::vector<uint8_t>& bitmap, std::string& error) const;
+    bool selectConditionLocked(const nlohmann::json& condition, std::vector<uint8_t>& bitmap, std::string& error) const;
+    std::vector<std::string> trainingSample() const;
+
+    std::unique_ptr<MappedFile> file_;
+    uint64_t base_count_ = 0;
+    uint64_t ids_offset_ = 0;
+    uint64_t hashes_offset_ = 0;
+
+    std::unordered_map<int64_t, Entry> overlay_;            // Points written since the file was mapped
+    std::unordered_map<std::string, int64_t> overlay_ids_;
+    std::unordered_set<int64_t> removed_;                   // Mapped points deleted or replaced since
+
+    bool compress_ = false;
+    std::string dictionary_;                                // Of the mapped file; empty = none trained
+
+    // Inverted indexes of the payload fields filters have used; readers build them under field_mutex_
+    mutable std::mutex field_mutex_;
+    mutable std::unordered_map<std::string, FieldIndex> fields_;
+};
+
+} // namespace kolosal
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "export.hpp"
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+namespace kolosal
+{
+
+/**
+ * @brief Full-precision vectors of a disk-tier FAISS collection, in <collection>.vectors
+ *
+ * The in-memory index of a disk-tier collection only keeps compressed codes
+ * for routing; the exact vectors live here and are read back to re-score the
+ * candidates a search found. Every internal id owns a fixed-size slot, so a
+ * vector is written with one positioned write and read back with one
+ * positioned read, and nothing in memory grows with the collection.
+ * Internal ids are never reused: the slots of deleted points are simply
+ * never read again.
+ *
+ * File layout, in host byte order like the WAL:
+ *   header   magic, version, dimensions (kHeaderBytes in all)
+ *   slots    dimensions x f32 per internal id, slot i at kHeaderBytes + i * slot size
+ *
+ * Reads of one search are batched: readahead is requested for every slot
+ * first, so the device works on all of them at once, before the blocking
+ * reads run in file order.
+ *
+ * write() must be serialized by the caller; read() is safe to call from
+ * several threads at once, and alongside write() for slots it is not writing.
+ */
+class KOLOSAL_SERVER_API FaissVectorFile
+{
+public:
+    static constexpr uint64_t kHeaderBytes = 64;
+
+    FaissVectorFile();
+    ~FaissVectorFile();
+
+    FaissVectorFile(const FaissVectorFile&) = delete;
+    FaissVectorFile& operator=(const FaissVectorFile&) = delete;
+
+    /**
+     * @brief Open the vectors file, creating it if it does not exist
+     * @param path File to open
+     * @param dimensions Floats per vector; must match an existing file
+     * @param created Set when the file did not exist before
+     * @param error Set when the file cannot be opened or belongs to other dimensions
+     * @return True on success
+     */
+    bool open(const std::filesystem::path& path, int dimensions, bool& created, std::string& error);
+
+    void close();
+
+    bool isOpen() const;
+
+    /**
+     * @brief Store the vectors of count internal ids, row-major
+     */
+    bool write(const int64_t* ids, const float* vectors, size_t count, std::string& error);
+
+    /**
+     * @brief Read the vectors of count internal ids into out (count x dimensions)
+     * @return False if any slot could not be read in full
+     */
+    bool read(const int64_t* ids, size_t count, float* out) const;
+
+    /**
+     * @brief Flush written vectors to stable storage
+     */
+    bool sync(std::string& error);
+
+private:
+    uint64_t slotOffset(int64_t id) const;
+
+#ifdef _WIN32
+    void* handle_ = nullptr;
+#else
+    int fd_ = -1;
+#endif
+    int dimensions_ = 0;
+};
+
+} // namespace kolosal
@@ -4,34 +4,103 @@
 /**
  * @file gpu_detection.hpp
  * @brief GPU detection utilities for determining hardware acceleration capabilities
- * 
+ *
  * This header provides functionality to detect available GPU hardware and determine
- * whether Vulkan-based inference acceleration should be used by default.
- * 
+ * whether Vulkan-based inference acceleration should be used by default, and a
+ * telemetry service reporting per-device memory, utilization and temperature.
+ *
  * Note: On Apple systems (macOS), GPU detection is not needed as Metal acceleration
  * is the preferred default and does not require discrete GPU detection.
  */
 
+#include "export.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
 namespace kolosal {
 
+/**
+ * @brief One GPU as last sampled. Fields that could not be read stay at 0 / -1.
+ */
+struct GpuDevice {
+    int index = 0;                  // PCI bus order, which the CUDA and Vulkan backends normally follow
+    std::string name;
+    std::string vendor;             // "nvidia", "amd" or "intel"
+    std::string source;             // "nvml" or "sysfs"
+    uint64_t totalMemoryBytes = 0;
+    uint64_t freeMemoryBytes = 0;
+    int utilizationPercent = -1;
+    int temperatureC = -1;
+    int computeCapability = 0;      // NVIDIA only: major * 10 + minor (e.g. 86 for sm_86)
+};
+
+/**
+ * @brief Native, cached GPU inventory with a background sampler for the live figures.
+ *
+ * Devices are found once, through NVML (loaded at runtime, so machines without the
+ * NVIDIA driver are unaffected) and, on Linux, the DRM entries in sysfs; no external
+ * commands are run. start() then refreshes free memory, utilization and temperature
+ * on a fixed interval so readers never wait on a driver call.
+ */
+class KOLOSAL_SERVER_API GpuTelemetry {
+public:
+    static GpuTelemetry& instance();
+
+    // Last sample; the first call detects the devices
+    std::vector<GpuDevice> devices();
+
+    // Indexes of the devices with known memory, most free memory first
+    std::vector<int> devicesByFreeMemory();
+
+    void start(std::chrono::seconds interval);
+    void stop();
+
+    ~GpuTelemetry();
+
+private:
+    GpuTelemetry() = default;
+    GpuTelemetry(const GpuTelemetry&) = delete;
+    GpuTelemetry& operator=(const GpuTelemetry&) = delete;
+
+    void detect();
+    void sample();
+    void run(std::chrono::seconds interval);
+
+#pragma warning(push)
+#pragma warning(disable: 4251)
+    std::once_flag detectOnce_;
+    std::mutex mutex_;
+    std::vector<GpuDevice> devices_;
+    std::condition_variable cv_;
+    std::thread sampler_;
+#pragma warning(pop)
+    bool stopping_ = false;
+};
+
 /**
  * @brief Detects if the system has a dedicated GPU that supports Vulkan acceleration
- * 
+ *
  * This function detects the presence of dedicated GPUs from NVIDIA, AMD, or ATI that
- * are capable of Vulkan acceleration.
- * 
- * On Windows systems, it uses Windows Management Instrumentation (WMI) to query
- * video controllers and check their properties.
- * 
- * On Linux systems, it uses multiple detection methods:
+ * are capable of Vulkan acceleration. The result is computed once and cached.
+ *
+ * Devices found by GpuTelemetry count first. Otherwise, on Windows systems, it uses
+ * Windows Management Instrumentation (WMI) to query video controllers.
+ *
+ * On Linux systems, it falls back to:
  * - Checks loaded kernel modules (/proc/modules)
- * - Examines DRM devices in /sys/class/drm/
- * - Uses lspci command to list PCI devices
- * - Checks for Vulkan support via vulkaninfo or library presence
- * 
+ * - Examines PCI display controllers in /sys/bus/pci/devices
+ * - Checks that the Vulkan loader can be opened
+ *
  * On Apple systems (macOS), this function is not typically used as Metal
  * acceleration is preferred and does not require discrete GPU detection.
- * 
+ *
  * @return true if a dedicated GPU is detected, false otherwise
  */
 bool hasVulkanCapableGPU();
@@ -0,0 +1,56 @@
+#ifndef KOLOSAL_HARDWARE_FEATURES_HPP
+#define KOLOSAL_HARDWARE_FEATURES_HPP
+
+/**
+ * @file hardware_features.hpp
+ * @brief Instruction sets and GPU backends available on this host
+ *
+ * Used to pick, among several builds of an inference engine, the fastest one
+ * the machine can run (see InferenceEngineConfig::variants).
+ */
+
+#include "export.hpp"
+
+#include <set>
+#include <string>
+#include <vector>
+
+namespace kolosal {
+
+/**
+ * @brief Feature tags of the host, detected once
+ *
+ * CPU tags come from CPUID on x86 (checked against what the OS saves on
+ * context switches, so AVX-512 disabled by the kernel does not count) and
+ * from the auxiliary vector on ARM Linux:
+ *   x86: sse42, avx, f16c, fma, avx2, avx512 (= avx512f), avx512bw, avx512vl,
+ *        avx512vnni, avx512bf16, avxvnni
+ *   ARM: neon, dotprod, i8mm, sve
+ * Backend tags come from the GPUs found by GpuTelemetry:
+ *   cuda, cuda-smXY (an NVIDIA GPU of compute capability X.Y or newer),
+ *   rocm, vulkan, metal
+ * "cpu" is always present. Tags are matched case-insensitively.
+ */
+class KOLOSAL_SERVER_API HardwareFeatures {
+public:
+    static const HardwareFeatures& host();
+
+    bool supports(const std::string& tag) const;
+    bool supportsAll(const std::vector<std::string>& tags) const;
+
+    // Detected tags, for logs; cuda-smXY appears once, at the best compute capability
+    std::vector<std::string> tags() const;
+
+private:
+    HardwareFeatures();
+
+#pragma warning(push)
+#pragma warning(disable: 4251)
+    std::set<std::string> tags_;
+#pragma warning(pop)
+    int cudaComputeCapability_ = 0;     // Best NVIDIA GPU, major * 10 + minor
+};
+
+} // namespace kolosal
+
+#endif // KOLOSAL_HARDWARE_FEATURES_HPP
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "export.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace kolosal
+{
+
+/**
+ * @brief Engine and startup state for health checks, sampled in the background
+ *
+ * Reading engine states takes NodeManager locks that model loads and
+ * inference hold, so under load a probe that asks directly queues behind
+ * them. A sampler thread reads the states on a fixed interval instead and
+ * publishes an immutable snapshot; readers only swap a shared_ptr and never
+ * wait on NodeManager.
+ *
+ * probe() answers liveness and readiness checks from the snapshot. The
+ * server calls it on its I/O threads, ahead of the worker pool, so probes get
+ * their answer in microseconds however busy the handlers are.
+ *
+ * Thread-safe.
+ */
+class KOLOSAL_SERVER_API HealthMonitor
+{
+public:
+    struct Engine
+    {
+        std::string id;
+        bool loaded = false;
+        std::string startupState;   // Empty unless the engine was configured to load at startup
+    };
+
+    struct Snapshot
+    {
+        std::chrono::system_clock::time_point taken;
+        std::vector<Engine> engines;
+        std::vector<std::pair<std::string, std::string>> startupModels;  // Model id and state
+        size_t loadedEngines = 0;
+        size_t startupPending = 0;  // Startup models still pending or loading
+        std::string readyBody;      // Readiness probe answers, rendered once per sample
+        std::string notReadyBody;
+        std::string drainingBody;
+    };
+
+    static HealthMonitor& instance();
+
+    /**
+     * @brief Sample now and then every @p interval until stop()
+     */
+    void start(std::chrono::milliseconds interval);
+    void stop();
+
+    /**
+     * @brief Take a sample now, e.g. right after the startup models finished loading
+     */
+    void refresh();
+
+    /**
+     * @brief Latest sample; taken on the spot if the sampler has not run yet
+     */
+    std::shared_ptr<const Snapshot> snapshot();
+
+    /**
+     * @brief Answer GET /livez or /readyz; false for any other path
+     *
+     * Liveness is 200 while the process serves requests at all. Readiness is
+     * 200 once the startup models are loaded and 503 while they are not or the
+     * node drains.
+     */
+    bool probe(std::string_view path, int& status, std::string& body);
+
+private:
+    HealthMonitor() = default;
+    ~HealthMonitor();
+    HealthMonitor(const HealthMonitor&) = delete;
+    HealthMonitor& operator=(const HealthMonitor&) = delete;
+
+    void run(std::chrono::milliseconds interval);
+
+#pragma warning(push)
+#pragma warning(disable: 4251)
+    std::shared_ptr<const Snapshot> snapshot_;  // Accessed with std::atomic_load/atomic_store
+    std::mutex mutex_;                          // Sampler lifecycle only
+    std::condition_variable cv_;
+    std::thread sampler_;
+#pragma warning(pop)
+    bool stopping_ = false;
+};
+
+} // namespace kolosal
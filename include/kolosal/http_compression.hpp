@@ -0,0 +1,58 @@
+#pragma once
+
+#include "export.hpp"
+
+#include <cstddef>
+#include <string>
+
+namespace kolosal {
+namespace http_internal {
+
+    enum class ContentCoding {
+        Identity,
+        Gzip,
+        Deflate     // zlib-wrapped, which is what HTTP calls "deflate"
+    };
+
+    // Pick the coding for an Accept-Encoding header value (q-values and "*" honoured, gzip
+    // preferred on a tie). Identity when neither gzip nor deflate is acceptable.
+    KOLOSAL_SERVER_API ContentCoding negotiate_coding(const std::string& acceptEncoding);
+
+    // Coding of a request body from its Content-Encoding header value. False for codings
+    // that cannot be decoded (anything but gzip, deflate and identity, or several stacked).
+    KOLOSAL_SERVER_API bool parse_content_coding(const std::string& contentEncoding, ContentCoding& coding);
+
+    // Per-thread setting for the response being handled, set by the server from the request.
+    // Level is the zlib level (1-9, 0 disables); bodies under minBytes are sent as they are.
+    // Also abandons a compressed stream the previous handler left unfinished.
+    KOLOSAL_SERVER_API void set_response_coding(ContentCoding coding, int level, size_t minBytes);
+
+    // Compress a whole response body with the current thread's coding. Returns the compressed
+    // bytes (valid until the next call on this thread) and sets encoding to the
+    // Content-Encoding value, or returns nullptr if the body should go out uncompressed:
+    // no coding negotiated, body too small, content type not worth compressing, or no gain.
+    KOLOSAL_SERVER_API const std::string* compress_response(const std::string& body,
+                                                             const std::string& contentType,
+                                                             const char** encoding);
+
+    // Whether a response of this content type is worth compressing (text, JSON, JS, XML)
+    KOLOSAL_SERVER_API bool is_compressible(const std::string& contentType);
+
+    // Gzip a whole buffer once, e.g. to keep a precompressed copy of a static file. Empty if
+    // compression fails or does not make the data smaller.
+    KOLOSAL_SERVER_API std::string gzip_compress(const std::string& data, int level);
+
+    // Start compressing a chunked stream of the given content type. Returns the
+    // Content-Encoding value, or nullptr if the stream goes out uncompressed.
+    KOLOSAL_SERVER_API const char* begin_stream_compression(const std::string& contentType);
+
+    // True while a stream started by begin_stream_compression() is open on this thread
+    KOLOSAL_SERVER_API bool stream_compressed();
+
+    // Compress one stream frame. flush makes everything so far decodable by the client
+    // (a sync flush); finish ends the compressed stream. Returns the bytes to send as the
+    // chunk payload (possibly empty), valid until the next call on this thread.
+    KOLOSAL_SERVER_API const std::string& compress_stream_frame(const std::string& data, bool flush, bool finish);
+
+} // namespace http_internal
+} // namespace kolosal
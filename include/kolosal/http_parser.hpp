@@ -0,0 +1,139 @@
+#pragma once
+
+#include "export.hpp"
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace kolosal {
+
+    /**
+     * @brief Incremental HTTP/1.1 request parser over a connection's receive buffer.
+     *
+     * parse() is called each time bytes are appended to the buffer and resumes
+     * where the previous call stopped, so a request arriving in many small reads
+     * is scanned once rather than from the start on every read. Nothing is
+     * copied: the request line and header fields are recorded as offsets and
+     * handed out as string_views into the buffer.
+     *
+     * Bodies framed by Content-Length are left where they are. Chunked bodies
+     * are decoded in place as their chunks arrive: the data of each chunk is
+     * moved down over the framing, so the decoded body ends up contiguous right
+     * behind the headers and the buffer never holds more than the raw request.
+     *
+     * Violations of the size limits and framing that could be used to smuggle
+     * requests (obsolete line folding, whitespace before a colon, conflicting
+     * Content-Length, Content-Length together with Transfer-Encoding) fail the
+     * parse with the status code to answer with.
+     *
+     * Not thread-safe; it belongs to whichever thread owns the connection.
+     */
+    class KOLOSAL_SERVER_API HttpRequestParser {
+    public:
+        struct Limits {
+            size_t maxHeaderBytes = 16384;  // Request line and header fields together
+            size_t maxHeaderCount = 100;
+            size_t maxBodyBytes = 0;        // Decoded body (0 = unlimited)
+        };
+
+        enum class Status {
+            Incomplete,         // Needs more bytes
+            HeadersComplete,    // Request line and headers are in; call parse() again for the body
+            Complete,           // The whole request is in
+            Error               // See errorStatus() and error()
+        };
+
+        HttpRequestParser() = default;
+        explicit HttpRequestParser(const Limits& limits) : limits_(limits) {}
+
+        void setLimits(const Limits& limits) { limits_ = limits; }
+
+        // Forget the current request; the next parse() starts a new one at offset 0.
+        // Keeps the header table's capacity for the connection's next request.
+        void reset();
+
+        /**
+         * Parse what was appended to buffer since the last call. Bytes before the
+         * current position must not change in between, except by erasing a
+         * finished request (followed by reset()). Chunked bodies are rewritten in
+         * place, hence the non-const buffer.
+         */
+        Status parse(std::string& buffer);
+
+        bool headersComplete() const { return state_ > State::Headers; }
+        bool complete() const { return state_ == State::Done; }
+
+        // Valid once the headers are complete, until the buffer is next modified
+        std::string_view method() const { return view(method_); }
+        std::string_view target() const { return view(target_); }
+        int minorVersion() const { return minorVersion_; }
+        size_t headerCount() const { return headers_.size(); }
+        std::string_view headerName(size_t i) const { return view(headers_[i].name); }
+        std::string_view headerValue(size_t i) const { return view(headers_[i].value); }
+
+        // Value of the first field with this name (compared case-insensitively), or empty
+        std::string_view header(std::string_view name) const;
+
+        bool chunked() const { return chunked_; }
+        size_t contentLength() const { return contentLength_; }   // Declared length; 0 when chunked
+
+        // Offset of the body in the buffer, i.e. the length of the head
+        size_t bodyOffset() const { return bodyOffset_; }
+        // Body bytes available contiguously at bodyOffset() (decoded, for chunked bodies)
+        size_t bodyLength() const;
+        // Offset just past the request on the wire; what follows is a pipelined request
+        size_t messageEnd() const;
+
+        int errorStatus() const { return errorStatus_; }    // 400, 413, 431, 501 or 505
+        const std::string& error() const { return error_; }
+
+    private:
+        enum class State { RequestLine, Headers, Body, ChunkSize, ChunkData, ChunkDataEnd, Trailers, Done, Failed };
+
+        struct Span {
+            size_t offset = 0;
+            size_t length = 0;
+        };
+
+        struct Field {
+            Span name;
+            Span value;
+        };
+
+        std::string_view view(Span span) const {
+            return buffer_ ? std::string_view(buffer_->data() + span.offset, span.length) : std::string_view();
+        }
+
+        Status fail(int status, const char* message);
+        bool nextLine(std::string_view data, size_t& lineEnd, size_t& next);
+        bool parseRequestLine(std::string_view line, size_t offset);
+        bool parseHeaderLine(std::string_view line, size_t offset);
+        Status finishHeaders();
+
+        Limits limits_;
+        const std::string* buffer_ = nullptr;
+        State state_ = State::RequestLine;
+        size_t pos_ = 0;            // Raw bytes consumed so far
+        size_t start_ = 0;          // Start of the request line (leading empty lines are skipped)
+        size_t scan_ = 0;           // Where the search for the current line's end resumes
+        Span method_;
+        Span target_;
+        int minorVersion_ = 1;
+#pragma warning(push)
+#pragma warning(disable: 4251)
+        std::vector<Field> headers_;
+        std::string error_;
+#pragma warning(pop)
+        bool chunked_ = false;
+        bool hasContentLength_ = false;
+        size_t contentLength_ = 0;
+        size_t bodyOffset_ = 0;
+        size_t decoded_ = 0;        // Chunked: body bytes decoded so far
+        size_t chunkLeft_ = 0;      // Chunked: bytes of the current chunk still to come
+        size_t trailerBytes_ = 0;
+        int errorStatus_ = 0;
+    };
+
+} // namespace kolosal
@@ -105,6 +105,9 @@ public:
 
     /**
      * @brief Configure available inference engines from config
+     *
+     * Engines that list variants (builds tagged by instruction set or GPU
+     * backend) get the fastest one this host can run.
      * @param engines Vector of inference engine configurations
      * @return True if engines were configured successfully
      */
@@ -191,6 +194,15 @@ private:
      */
     bool loadLibrary(const std::string& library_path, const std::string& engine_name);
 
+    /**
+     * @brief Pick the library to load for an engine
+     *
+     * With variants configured, the first one whose features the host has
+     * (see HardwareFeatures) and whose file exists; otherwise, or when none
+     * qualifies, the engine's library_path.
+     */
+    static std::string selectLibrary(const InferenceEngineConfig& engine);
+
     /**
      * @brief Unload a library
      * @param engine_name Name of the engine to unload
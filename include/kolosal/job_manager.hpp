@@ -0,0 +1,160 @@
+#pragma once
+
+#include "export.hpp"
+#include "server_config.hpp"
+#include "auth/token_quota.hpp"
+#include <json.hpp>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace kolosal
+{
+
+/**
+ * @brief Asynchronous completion jobs (/v1/jobs)
+ *
+ * A job is one chat or text completion request run in the background: submit()
+ * returns its ID at once, and the client fetches the result later or has it
+ * posted to a webhook when the job ends, so a long generation holds neither a
+ * connection nor a handler thread. One worker starts queued jobs in order while
+ * fewer than JobsConfig::max_running run, and collects the finished ones. Their
+ * engine jobs are released as soon as the result is read, so waiting results
+ * live here rather than in the engine's job table.
+ *
+ * A job belongs to the tenant that submitted it (auth::TokenQuota::subjectFor);
+ * every lookup is scoped to that tenant, so another tenant's job reads as missing.
+ * Its tokens are charged to that tenant's quota from submission until it ends,
+ * and it runs under the tenant's share of the slots (auth::TenantShares).
+ *
+ * An ended job and its result are kept for JobsConfig::result_ttl_seconds, then
+ * dropped. Jobs are kept in memory only and do not survive a restart. Webhooks
+ * are delivered by a thread of their own, so a slow receiver never holds up the
+ * jobs.
+ *
+ * Thread-safe.
+ */
+class KOLOSAL_SERVER_API JobManager
+{
+public:
+    struct Job
+    {
+        std::string id;
+        std::string endpoint;           // "/v1/chat/completions" or "/v1/completions"
+        std::string model;
+        std::string status = "queued";  // queued, in_progress, completed, failed, cancelled
+        nlohmann::json result;          // Response body, once completed
+        int error_status = 0;           // HTTP status the request would have failed with
+        std::string error;
+        std::string webhook_url;
+        std::string webhook_status;     // "pending", "delivered" or "failed"; empty without a webhook
+        int webhook_attempts = 0;
+        int64_t created_at = 0;
+        int64_t started_at = 0;
+        int64_t ended_at = 0;
+        int64_t expires_at = 0;         // When an ended job is dropped
+        nlohmann::json metadata;
+        std::string owner;              // Submitting tenant; holds the API key, so never serialized
+
+        /**
+         * @param withResult Include the response body (left out of listings)
+         */
+        nlohmann::json toJson(bool withResult = true) const;
+    };
+
+    static JobManager& instance();
+
+    /**
+     * @brief Start the worker and the webhook sender
+     */
+    void start(const JobsConfig& config);
+
+    /**
+     * @brief Stop both threads; running jobs are stopped and every job is dropped
+     */
+    void stop();
+
+    bool enabled() const;
+
+    /**
+     * @brief Queue a completion request
+     * @param owner Submitting tenant (auth::TokenQuota::subjectFor)
+     * @param body Request body, as for the synchronous endpoint; streaming is refused
+     * @param webhookUrl http(s) URL the ended job is posted to, or empty
+     * @param charge Quota reserved for the request, settled when the job ends (or dropped if it never runs)
+     * @param promptTokens Prompt estimate the charge starts from until the real count is known
+     * @throws std::invalid_argument for an unknown endpoint, an invalid body or webhook URL
+     * @throws std::length_error when JobsConfig::max_queued jobs are already waiting
+     */
+    Job submit(const std::string& owner, const std::string& endpoint, const nlohmann::json& body,
+               const std::string& webhookUrl, const nlohmann::json& metadata,
+               std::unique_ptr<auth::TokenQuotaCharge> charge, size_t promptTokens);
+
+    std::optional<Job> get(const std::string& owner, const std::string& id) const;
+
+    /**
+     * @brief The owner's jobs newest first, starting after the job @p after (if given)
+     */
+    std::vector<Job> list(const std::string& owner, const std::string& after, size_t limit) const;
+
+    /**
+     * @brief Cancel a job that has not ended; a running one is stopped by the worker
+     */
+    std::optional<Job> cancel(const std::string& owner, const std::string& id);
+
+    /**
+     * @brief Drop a job and its result before its time runs out
+     * @throws std::invalid_argument if the job has not ended
+     */
+    bool remove(const std::string& owner, const std::string& id);
+
+    ~JobManager();
+
+private:
+    struct Running;
+
+    struct Queued
+    {
+        nlohmann::json body;
+        std::unique_ptr<auth::TokenQuotaCharge> charge;
+        size_t promptTokens = 0;
+    };
+
+    JobManager() = default;
+    JobManager(const JobManager&) = delete;
+    JobManager& operator=(const JobManager&) = delete;
+
+    void run();
+    bool startQueued(std::vector<Running>& running);
+    bool collect(std::vector<Running>& running);
+    void finishLocked(Job& job, const std::string& status);
+    void expireLocked(int64_t now);
+    void deliverWebhooks();
+    bool post(const Job& job, std::string& error) const;
+
+#pragma warning(push)
+#pragma warning(disable: 4251)
+    JobsConfig config_;
+    mutable std::mutex mutex_;
+    std::map<std::string, Job> jobs_;
+    std::map<std::string, Queued> requests_;   // Bodies of the queued jobs and the quota they hold
+    std::deque<std::string> queue_;
+    std::multimap<std::chrono::steady_clock::time_point, std::string> webhooks_;   // Deliveries by when they are due
+    std::condition_variable cv_;
+    std::condition_variable webhookCv_;
+    std::thread worker_;
+    std::thread webhookSender_;
+#pragma warning(pop)
+    bool started_ = false;
+    bool stopping_ = false;
+};
+
+} // namespace kolosal
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "export.hpp"
+#include "inference_interface.h"
+#include "retrieval/retrieve_types.hpp"
+
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace kolosal {
+
+    class NodeManager;
+    class WorkerPool;
+    namespace retrieval { class DocumentService; }
+
+    /**
+     * @brief Typed in-process access to the engines and the document store.
+     *
+     * For applications that link the server library: requests go straight to
+     * the NodeManager's engines and the DocumentService, with no socket, HTTP
+     * or JSON in between. Parameters and results are the engine's own types.
+     *
+     * Every call returns a future. Generation can also stream: the callback
+     * gets each CompletionDelta as the engine hands it over, by reference, on
+     * the thread waiting for that job. Returning false from it stops the job.
+     * The future still gets the full result.
+     *
+     * Failures reach the future as LocalClient::Error. The HTTP layer's
+     * authentication, rate limits and token quotas do not apply; admission
+     * control (engine capacity) does.
+     *
+     * Thread-safe. Waiting happens on the client's own threads, at most
+     * maxConcurrent at once; calls beyond that queue.
+     */
+    class KOLOSAL_SERVER_API LocalClient {
+    public:
+        class KOLOSAL_SERVER_API Error : public std::runtime_error {
+        public:
+            // code as in the HTTP API: "model_not_found", "model_overloaded", "job_failed", "service_error"
+            Error(std::string code, const std::string& message)
+                : std::runtime_error(message), code_(std::move(code)) {}
+            const std::string& code() const { return code_; }
+
+        private:
+#pragma warning(push)
+#pragma warning(disable: 4251)
+            std::string code_;
+#pragma warning(pop)
+        };
+
+        // Return false to stop generating
+        using StreamCallback = std::function<bool(const CompletionDelta& delta)>;
+
+        // Engines of ServerAPI::instance(), which must have been initialized
+        explicit LocalClient(size_t maxConcurrent = 64);
+        LocalClient(NodeManager& nodeManager, size_t maxConcurrent = 64);
+        ~LocalClient();     // Waits for calls in flight
+
+        LocalClient(const LocalClient&) = delete;
+        LocalClient& operator=(const LocalClient&) = delete;
+
+        std::future<CompletionResult> chat(const std::string& model, ChatCompletionParameters params,
+                                           StreamCallback onDelta = nullptr);
+        std::future<CompletionResult> complete(const std::string& model, CompletionParameters params,
+                                               StreamCallback onDelta = nullptr);
+
+        // One result per input, in order; a failed input has hasError set
+        std::future<std::vector<EmbeddingResult>> embed(const std::string& model, std::vector<std::string> inputs,
+                                                        bool normalize = true);
+
+        // Uses the server's database configuration; the store is connected on first use
+        std::future<retrieval::RetrieveResponse> retrieve(const retrieval::RetrieveRequest& request);
+
+    private:
+        std::shared_ptr<IInferenceEngine> engineFor(const std::string& model);
+        retrieval::DocumentService& documents();
+
+        template <typename R, typename F>
+        std::future<R> run(F&& fn);
+
+        NodeManager& nodeManager_;
+#pragma warning(push)
+#pragma warning(disable: 4251)
+        std::unique_ptr<WorkerPool> pool_;
+        std::mutex documentsMutex_;
+        std::unique_ptr<retrieval::DocumentService> documents_;
+#pragma warning(pop)
+    };
+
+} // namespace kolosal
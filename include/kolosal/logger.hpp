@@ -8,6 +8,13 @@
 #include <mutex>
 #include <memory>
 #include <iostream>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <cstdarg>
+#include <cstdint>
 
 enum class LogLevel {
 	SERVER_ERROR,
@@ -16,12 +23,34 @@ enum class LogLevel {
 	SERVER_DEBUG
 };
 
+// What a message is about, so whole groups of routine messages can be muted by
+// configuration without looking at their text
+enum class LogCategory {
+	General,
+	Connection,     // Sockets accepted and closed; muted in quiet mode
+	Request,        // Per-request progress; muted in quiet mode or without show_request_details
+	Count
+};
+
+// Lowest-priority level compiled in (0 = errors only ... 3 = debug). Calls made through
+// the KOLOSAL_LOG_* macros below a level are removed at compile time, arguments and all.
+#ifndef KOLOSAL_MIN_LOG_LEVEL
+#define KOLOSAL_MIN_LOG_LEVEL 3
+#endif
+
 struct LogEntry {
 	LogLevel level;
 	std::string timestamp;
 	std::string message;
+	uint64_t id = 0;                              // Increases by one per entry, for cursors
+	std::chrono::system_clock::time_point time;
 };
 
+using LogFilter = std::function<bool(const LogEntry&)>;
+
+// Logging is asynchronous: callers check the level, format their message and push it
+// into a fixed-size lock-free ring; a background thread formats timestamps, writes
+// batches to the console and log file, and keeps a bounded history for /logs.
 class KOLOSAL_SERVER_API ServerLogger {
 public:
 	static ServerLogger& instance();
@@ -33,6 +62,11 @@ public:
 
 	// Set minimum log level
 	void setLevel(LogLevel level);
+
+	// True if messages at this level and category are kept; checked before any formatting
+	bool isEnabled(LogLevel level, LogCategory category = LogCategory::General) const {
+		return static_cast<int>(level) <= categoryLevel[static_cast<int>(category)].load(std::memory_order_relaxed);
+	}
 	
 	// Configure quiet mode settings
 	void setQuietMode(bool enabled);
@@ -41,6 +75,17 @@ public:
 	// Set log file path
 	bool setLogFile(const std::string& filePath);
 
+	// Number of entries kept for getLogs(); older ones are discarded
+	void setHistoryCapacity(size_t capacity);
+
+	// Block until everything logged so far has been written out
+	void flush();
+
+	// Log a message in a category; prefer the KOLOSAL_LOG_* macros, which skip the call
+	// and the evaluation of its arguments when the message would not be kept
+	void write(LogLevel level, LogCategory category, const std::string& message);
+	void write(LogLevel level, LogCategory category, const char* format, ...);
+
 	// Log methods
 	void error(const std::string& message);
 	void warning(const std::string& message);
@@ -62,34 +107,108 @@ public:
 	static void logInfo(const char* format, ...);
 	static void logDebug(const char* format, ...);
 
-	// Get stored logs
-	const std::vector<LogEntry>& getLogs() const;
+	// Snapshot of the most recent entries, oldest first
+	std::vector<LogEntry> getLogs() const;
+
+	// Up to maxCount entries newer than cursor that pass filter, oldest first. cursor is
+	// advanced to the last entry examined, so it can be passed back to continue.
+	std::vector<LogEntry> getLogsAfter(uint64_t& cursor, size_t maxCount, const LogFilter& filter = nullptr) const;
+
+	// The newest maxCount entries older than cursor (0 = from the newest) that pass filter,
+	// oldest first. cursor is moved back to the oldest entry examined.
+	std::vector<LogEntry> getLogsBefore(uint64_t& cursor, size_t maxCount, const LogFilter& filter = nullptr) const;
+
+	// Wait until an entry newer than cursor is in the history; false on timeout
+	bool waitForLogs(uint64_t cursor, std::chrono::milliseconds timeout) const;
+
+	// Id of the oldest entry still held (entries before it were discarded) and of the newest
+	uint64_t oldestLogId() const;
+	uint64_t newestLogId() const;
+
+	// Approximate bytes held by the write ring and by the /logs history, and the history's length
+	void memoryUsage(size_t& ringBytes, size_t& historyBytes, size_t& historyEntries) const;
 
 private:
 	// Private constructor for singleton
 	ServerLogger();
 	~ServerLogger();
 
+	// One cell of the ring; sequence tells producers and the writer whose turn it is
+	struct Slot {
+		std::atomic<size_t> sequence{0};
+		LogLevel level = LogLevel::SERVER_INFO;
+		std::chrono::system_clock::time_point time;
+		std::string message;
+	};
+
 	void log(LogLevel level, const std::string& message);
+	void logFormatted(LogLevel level, LogCategory category, const char* format, va_list args);
+	void updateCategoryLevels();
+
+	bool tryEnqueue(LogLevel level, std::chrono::system_clock::time_point time, std::string& message);
+	void writerLoop();
+	size_t drain();
 
 	std::string formatString(const char* format, va_list args);
 
 	// Get string representation of log level
-	std::string levelToString(LogLevel level);
+	static const char* levelToString(LogLevel level);
 
-	// Get current timestamp
-	std::string getCurrentTimestamp();
+	static std::string formatTimestamp(std::chrono::system_clock::time_point time);
+
+	static constexpr size_t RING_CAPACITY = 8192;     // Power of two
+	static constexpr size_t WRITE_BATCH = 256;        // Entries written per console/file flush
+	static constexpr size_t DEFAULT_HISTORY = 10000;
+
+	std::atomic<int> minLevel;
+	std::atomic<bool> quietMode;
+	std::atomic<bool> showRequestDetails;
+	// Per category, the lowest-priority level kept: minLevel capped by the category's
+	// settings, so isEnabled() is a single load
+	std::atomic<int> categoryLevel[static_cast<int>(LogCategory::Count)];
 
-	LogLevel minLevel;
 #pragma warning(push)
 #pragma warning(disable: 4251)
-	std::vector<LogEntry> logs;
+	std::unique_ptr<Slot[]> ring;
+	std::atomic<size_t> enqueuePos{0};
+	size_t dequeuePos = 0;                  // Writer thread only
+	std::atomic<size_t> writtenPos{0};      // Entries fully written, for flush()
+	std::atomic<size_t> dropped{0};         // Debug/info entries dropped while the ring was full
+	std::atomic<bool> writerSleeping{false};
+
+	std::mutex wakeMutex;
+	std::condition_variable wakeCv;         // Wakes the writer
+	std::condition_variable flushedCv;      // Signalled after each written batch
+	bool stopping = false;
+	std::thread writer;
+
+	mutable std::mutex historyMutex;
+	mutable std::condition_variable historyCv;  // Signalled when entries are added
+	std::vector<LogEntry> history;
+	size_t historyStart = 0;
+	uint64_t lastId = 0;
+	size_t historyCapacity = DEFAULT_HISTORY;
+
+	std::mutex fileMutex;
 	std::ofstream logFile;
 	std::string logFilePath;
 #pragma warning(pop)
-	std::mutex logMutex;
-	
-	// Quiet mode settings
-	bool quietMode;
-	bool showRequestDetails;
-};
\ No newline at end of file
+};
+
+// Logging macros for hot paths. The level and category are checked before the
+// arguments are evaluated, so a disabled message costs one comparison; below
+// KOLOSAL_MIN_LOG_LEVEL the call is discarded at compile time.
+#define KOLOSAL_LOG(level, category, ...) \
+	do { \
+		if constexpr (static_cast<int>(level) <= KOLOSAL_MIN_LOG_LEVEL) { \
+			if (::ServerLogger::instance().isEnabled(level, category)) \
+				::ServerLogger::instance().write(level, category, __VA_ARGS__); \
+		} \
+	} while (0)
+
+#define KOLOSAL_LOG_ERROR(...)          KOLOSAL_LOG(::LogLevel::SERVER_ERROR, ::LogCategory::General, __VA_ARGS__)
+#define KOLOSAL_LOG_WARNING(...)        KOLOSAL_LOG(::LogLevel::SERVER_WARNING, ::LogCategory::General, __VA_ARGS__)
+#define KOLOSAL_LOG_INFO(...)           KOLOSAL_LOG(::LogLevel::SERVER_INFO, ::LogCategory::General, __VA_ARGS__)
+#define KOLOSAL_LOG_DEBUG(...)          KOLOSAL_LOG(::LogLevel::SERVER_DEBUG, ::LogCategory::General, __VA_ARGS__)
+#define KOLOSAL_LOG_REQUEST_INFO(...)   KOLOSAL_LOG(::LogLevel::SERVER_INFO, ::LogCategory::Request, __VA_ARGS__)
+#define KOLOSAL_LOG_REQUEST_DEBUG(...)  KOLOSAL_LOG(::LogLevel::SERVER_DEBUG, ::LogCategory::Request, __VA_ARGS__)
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "export.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <json.hpp>
+
+namespace kolosal {
+
+    class NodeManager;
+
+    /**
+     * @brief Figures from the allocator malloc resolves to; -1 where it does not report one.
+     */
+    struct AllocatorStats {
+        std::string name;           // system (glibc or the platform's), mimalloc or jemalloc
+        int64_t allocated = -1;     // Handed out and not yet freed: the live heap
+        int64_t resident = -1;      // Physical memory the allocator holds
+        int64_t committed = -1;     // Mapped from the OS, free or not
+    };
+
+    /**
+     * @brief Physical memory of the process; -1 where the platform does not report it.
+     */
+    struct ProcessMemory {
+        int64_t resident = -1;
+        int64_t peakResident = -1;
+    };
+
+    /**
+     * @brief Where the server's memory goes, served as JSON at /debug/memory.
+     *
+     * Engines, the logger, downloads and the caches are read at report time. Subsystems owned
+     * by a route, such as the document service's vector store, add a source while they live.
+     */
+    class KOLOSAL_SERVER_API MemoryReport {
+    public:
+        using Source = std::function<nlohmann::json()>;
+
+        static MemoryReport& instance();
+
+        // Adds a named section to the report; the returned id removes it again
+        uint64_t addSource(const std::string& name, Source source);
+        void removeSource(uint64_t id);
+
+        // Name of the allocator linked in (KOLOSAL_ALLOCATOR at build time)
+        static const char* allocatorName();
+        static AllocatorStats allocatorStats();
+        static ProcessMemory processMemory();
+        // Hands freed memory the allocator still holds back to the OS
+        static void releaseFreeMemory();
+
+        nlohmann::json render(const NodeManager& nodeManager) const;
+
+    private:
+        MemoryReport() = default;
+        MemoryReport(const MemoryReport&) = delete;
+        MemoryReport& operator=(const MemoryReport&) = delete;
+
+#pragma warning(push)
+#pragma warning(disable: 4251)
+        mutable std::mutex mutex_;
+        std::map<uint64_t, std::pair<std::string, Source>> sources_;
+#pragma warning(pop)
+        uint64_t nextId_ = 1;
+    };
+
+} // namespace kolosal
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "export.hpp"
+#include "inference_interface.h"
+
+#include <atomic>
+#include <initializer_list>
+#include <map>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace kolosal {
+
+    class NodeManager;
+    namespace auth { class RateLimiter; }
+
+    /**
+     * @brief Fixed-bucket histogram that any thread can record into without locking.
+     */
+    class KOLOSAL_SERVER_API Histogram {
+    public:
+        explicit Histogram(std::initializer_list<double> bounds);
+
+        void observe(double value);
+        HistogramSnapshot snapshot() const;
+
+    private:
+#pragma warning(push)
+#pragma warning(disable: 4251)
+        const std::vector<double> bounds_;
+        std::vector<std::atomic<uint64_t>> counts_;     // One per bound plus +Inf
+#pragma warning(pop)
+        std::atomic<uint64_t> count_{0};
+        std::atomic<uint64_t> sumMicros_{0};            // Sum in millionths, kept as an integer counter
+    };
+
+    /**
+     * @brief Process-wide request and model-load metrics, rendered for Prometheus.
+     *
+     * The server records every routed request here once metrics are enabled; engine
+     * figures (jobs, slots, KV usage, decode batches, TTFT/TPOT) are pulled from the
+     * NodeManager at scrape time, so nothing on the decode path waits on a scrape.
+     */
+    class KOLOSAL_SERVER_API Metrics {
+    public:
+        static Metrics& instance();
+
+        void enable() { enabled_.store(true, std::memory_order_relaxed); }
+        bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+        // route is the pattern that selected the handler, so paths with ids share one series
+        void observeRequest(const std::string& route, const std::string& method, int status, double seconds);
+        void observeModelLoad(const std::string& engineId, double seconds);
+        // Request arena bytes used by one request; overflowed when it outgrew the retained buffer
+        void observeRequestArena(size_t bytes, bool overflowed);
+
+        // Prometheus text exposition format, version 0.0.4. Process memory, open descriptors and
+        // the rate limiter's bucket table are included so a soak run can watch them for growth.
+        std::string render(const NodeManager& nodeManager, const auth::RateLimiter* rateLimiter = nullptr) const;
+
+    private:
+        Metrics();
+        Metrics(const Metrics&) = delete;
+        Metrics& operator=(const Metrics&) = delete;
+
+        struct RouteSeries {
+            Histogram latency;
+            std::atomic<uint64_t> byStatusClass[5] = {};  // 1xx .. 5xx
+            RouteSeries();
+        };
+
+        std::atomic<bool> enabled_{false};
+        Histogram arenaKiB_;
+        std::atomic<uint64_t> arenaHighWater_{0};
+        std::atomic<uint64_t> arenaOverflows_{0};
+#pragma warning(push)
+#pragma warning(disable: 4251)
+        mutable std::shared_mutex mutex_;
+        std::map<std::pair<std::string, std::string>, std::unique_ptr<RouteSeries>> routes_;  // (route, method)
+        std::map<std::string, std::unique_ptr<Histogram>> modelLoads_;
+#pragma warning(pop)
+    };
+
+} // namespace kolosal
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "export.hpp"
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+
+namespace kolosal
+{
+
+/**
+ * @brief Process-wide catalog of model files: validation results and GGUF header metadata
+ *
+ * A local file is described once per size and modification time. Its GGUF header
+ * (architecture, context length, layer and head counts, tensor bytes) is parsed on the
+ * first lookup and recorded in ".kolosal-catalog.json" beside the file, so later lookups,
+ * in this process or the next, need no more than a stat. A URL that answered its HEAD
+ * request is trusted for a few minutes instead of being checked again on every register.
+ *
+ * Thread-safe.
+ */
+class KOLOSAL_SERVER_API ModelCatalog
+{
+public:
+    struct ModelInfo
+    {
+        std::string path;
+        uint64_t file_size = 0;
+        long long mtime = 0;
+        bool gguf = false;              // The GGUF header was read; the fields below are set
+        std::string architecture;       // general.architecture, e.g. "llama"
+        std::string name;               // general.name
+        uint32_t file_type = 0;         // general.file_type (quantization)
+        uint32_t context_length = 0;    // Context the model was trained for
+        uint32_t embedding_length = 0;
+        uint32_t block_count = 0;
+        uint32_t head_count = 0;
+        uint32_t head_count_kv = 0;
+        uint64_t tensor_count = 0;
+        uint64_t tensor_bytes = 0;      // Weights, everything after the header
+    };
+
+    static ModelCatalog& instance();
+
+    /**
+     * @brief Whether a local model file or URL can be used, from the catalog when it is current
+     * @param error Receives why not
+     */
+    bool validate(const std::string& path, std::string& error);
+
+    /**
+     * @brief Description of a local file: cached while its size and modification time hold,
+     * otherwise read from the sidecar or the file's header. Empty if the file is missing.
+     */
+    std::optional<ModelInfo> describe(const std::string& path);
+
+    /**
+     * @brief Cached description of a file, without touching it
+     */
+    std::optional<ModelInfo> peek(const std::string& path) const;
+
+private:
+    ModelCatalog() = default;
+    ModelCatalog(const ModelCatalog&) = delete;
+    ModelCatalog& operator=(const ModelCatalog&) = delete;
+
+    static bool readHeader(const std::string& path, ModelInfo& info);
+    static bool readSidecar(ModelInfo& info);
+    static void writeSidecar(const ModelInfo& info);
+
+    mutable std::mutex mutex_;
+#pragma warning(push)
+#pragma warning(disable: 4251)
+    std::map<std::string, ModelInfo> files_;
+    std::map<std::string, std::chrono::steady_clock::time_point> urls_;  // When each URL last answered
+#pragma warning(pop)
+};
+
+} // namespace kolosal
@@ -2,6 +2,7 @@
 
 #include "../export.hpp"
 #include "model_interface.hpp"
+#include <cctype>
 #include <string>
 #include <optional>
 #include <json.hpp>
@@ -28,7 +29,9 @@ public:
     // Previously this was hard-coded to "llama-cpu", which prevented honoring a user-updated
     // default (e.g. PUT /engines setting llama-vulkan) when the client omitted inference_engine.
     std::string inference_engine; // Inference engine to use (llama-cpu, llama-cuda, llama-vulkan, etc.)
-    std::string model_type = "llm";    // Model type: "llm" or "embedding"
+    std::string model_type = "llm";    // Model type: "llm", "embedding" or "rerank"
+    std::string sha256;                // Optional SHA-256 a downloaded model must match
+    std::string priority = "normal";   // Download priority for URL models: "low", "normal" or "high"
     
     // Loading parameters (nested object)
     struct LoadingParametersModel {
@@ -36,29 +39,115 @@ public:
         int n_keep = 2048;
         bool use_mlock = true;
         bool use_mmap = true;
+        bool prefetch_weights = false; // read the mapped weights into the page cache in parallel on load
+        std::string huge_pages = "off"; // off, thp, 2m or 1g (Linux)
+        int repack_cache_mb = 0; // CPU weights kept loaded, repacked, after unload (0 = off)
         bool cont_batching = true;
         bool warmup = false;
         int n_parallel = 1;
+        int n_replicas = 1;           // data-parallel engine copies (one per GPU / core set)
+        int embedding_contexts = 1;   // embedding / rerank contexts decoding side by side
+        int embedding_batch_window_us = 0; // idle embedding context waits this long for more inputs (0 = off)
+        int n_prefix_cache = 2; // KV sequences kept for shared prompt prefixes (0 disables)
+        std::string prefix_cache_dir;      // prefix cache saved here at unload, restored after load (empty = off)
+        int prefix_cache_save_seconds = 0; // also save while serving this often (0 = only at unload)
+        int chunk_cache_mb = 0;      // host RAM for precomputed document-chunk KV (0 = off)
+        int preempt_swap_mb = 512;   // host RAM for KV of jobs paused for higher priorities (0 = no preemption)
+        int kv_block_tokens = 0;     // paged KV block size (0 = off)
+        int max_seq_ctx = 0;         // context one sequence may grow to (0 = n_ctx)
+        int max_queued_jobs = 0;     // jobs waiting for a slot before new ones get 503 (0 = unlimited)
+        int max_queued_tokens = 0;   // pending tokens before new requests get 503 (0 = unlimited)
+        int profile_steps = 0;       // decode steps kept for the profile endpoint (0 = off)
         int n_gpu_layers = 100;
         int split_mode = 1; // 0=none,1=layer,2=row
         int n_batch = 2048;
         int n_ubatch = 512;
-        std::vector<float> tensor_split; // optional fractions summing to <=1.0
+        int n_step_tokens = 0;       // per decode step, 0 = n_batch
+        float prefill_share = 0.5f;  // cap on prompt tokens per step while generating
+        float slo_ttft_ms = 0.0f;    // p95 latency targets steering the batch controller (0 = none)
+        float slo_tpot_ms = 0.0f;
+        std::string draft_model_path; // optional speculative draft model (same vocabulary)
+        int n_draft = 8;
+        bool prompt_lookup = false;   // draft from n-gram matches in the prompt and output
+        int n_threads = 0;            // 0 = automatic
+        std::string cpu_cores;        // e.g. "0-15"; empty = least used cores
+        int numa_node = -1;
+        std::string cache_type_k = "f16"; // KV cache element types, or "auto" (see fit_vram)
+        std::string cache_type_v = "f16";
+        bool fit_vram = false;        // size n_ctx / n_gpu_layers to the free VRAM at load time
+        std::string moe_offload = "off"; // MoE expert tensors in host memory: off, all or auto
+        bool autotune = false;        // benchmark threads and batch sizes at load, cached per model and host
+        std::string autotune_cache;   // empty = <temp>/kolosal-autotune.json
+        int kv_host_cache_mb = 512;   // host RAM tier for sessions evicted from warm slots
+        int kv_disk_cache_mb = 0;     // disk tier behind it (0 = disabled)
+        std::string kv_disk_cache_dir;
+        std::vector<float> tensor_split; // optional fractions summing to <=1.0; planned from free VRAM when empty
+
+        // LoRA adapters requests select by name on top of this base model
+        struct LoraAdapterModel {
+            std::string name;
+            std::string path;
+            float scale = 1.0f;
+        };
+        std::vector<LoraAdapterModel> lora_adapters;
+        int lora_max_loaded = 0;      // adapters kept in memory at once (0 = all)
         
         nlohmann::json to_json() const {
+            nlohmann::json adapters = nlohmann::json::array();
+            for (const auto &adapter : lora_adapters) {
+                adapters.push_back({{"name", adapter.name}, {"path", adapter.path}, {"scale", adapter.scale}});
+            }
+
             return nlohmann::json {
                 {"n_ctx", n_ctx},
                 {"n_keep", n_keep},
                 {"use_mlock", use_mlock},
                 {"use_mmap", use_mmap},
+                {"prefetch_weights", prefetch_weights},
+                {"huge_pages", huge_pages},
+                {"repack_cache_mb", repack_cache_mb},
                 {"cont_batching", cont_batching},
                 {"warmup", warmup},
                 {"n_parallel", n_parallel},
+                {"n_replicas", n_replicas},
+                {"embedding_contexts", embedding_contexts},
+                {"embedding_batch_window_us", embedding_batch_window_us},
+                {"n_prefix_cache", n_prefix_cache},
+                {"prefix_cache_dir", prefix_cache_dir},
+                {"prefix_cache_save_seconds", prefix_cache_save_seconds},
+                {"chunk_cache_mb", chunk_cache_mb},
+                {"preempt_swap_mb", preempt_swap_mb},
+                {"kv_block_tokens", kv_block_tokens},
+                {"max_seq_ctx", max_seq_ctx},
+                {"max_queued_jobs", max_queued_jobs},
+                {"max_queued_tokens", max_queued_tokens},
+                {"profile_steps", profile_steps},
                 {"n_gpu_layers", n_gpu_layers},
                 {"split_mode", split_mode},
                 {"n_batch", n_batch},
                 {"n_ubatch", n_ubatch},
-                {"tensor_split", tensor_split}
+                {"n_step_tokens", n_step_tokens},
+                {"prefill_share", prefill_share},
+                {"slo_ttft_ms", slo_ttft_ms},
+                {"slo_tpot_ms", slo_tpot_ms},
+                {"draft_model_path", draft_model_path},
+                {"n_draft", n_draft},
+                {"prompt_lookup", prompt_lookup},
+                {"n_threads", n_threads},
+                {"cpu_cores", cpu_cores},
+                {"numa_node", numa_node},
+                {"cache_type_k", cache_type_k},
+                {"cache_type_v", cache_type_v},
+                {"fit_vram", fit_vram},
+                {"moe_offload", moe_offload},
+                {"autotune", autotune},
+                {"autotune_cache", autotune_cache},
+                {"kv_host_cache_mb", kv_host_cache_mb},
+                {"kv_disk_cache_mb", kv_disk_cache_mb},
+                {"kv_disk_cache_dir", kv_disk_cache_dir},
+                {"tensor_split", tensor_split},
+                {"lora_adapters", adapters},
+                {"lora_max_loaded", lora_max_loaded}
             };
         }
         
@@ -91,6 +180,27 @@ public:
                 use_mmap = j["use_mmap"].get<bool>();
             }
             
+            if (j.contains("prefetch_weights") && !j["prefetch_weights"].is_null()) {
+                if (!j["prefetch_weights"].is_boolean()) {
+                    throw std::runtime_error("prefetch_weights must be a boolean");
+                }
+                prefetch_weights = j["prefetch_weights"].get<bool>();
+            }
+            
+            if (j.contains("huge_pages") && !j["huge_pages"].is_null()) {
+                if (!j["huge_pages"].is_string()) {
+                    throw std::runtime_error("huge_pages must be a string");
+                }
+                huge_pages = j["huge_pages"].get<std::string>();
+            }
+
+            if (j.contains("repack_cache_mb") && !j["repack_cache_mb"].is_null()) {
+                if (!j["repack_cache_mb"].is_number_integer()) {
+                    throw std::runtime_error("repack_cache_mb must be an integer");
+                }
+                repack_cache_mb = j["repack_cache_mb"].get<int>();
+            }
+            
             if (j.contains("cont_batching") && !j["cont_batching"].is_null()) {
                 if (!j["cont_batching"].is_boolean()) {
                     throw std::runtime_error("cont_batching must be a boolean");
@@ -111,6 +221,97 @@ public:
                 }
                 n_parallel = j["n_parallel"].get<int>();
             }
+
+            if (j.contains("n_replicas") && !j["n_replicas"].is_null()) {
+                if (!j["n_replicas"].is_number_integer()) {
+                    throw std::runtime_error("n_replicas must be an integer");
+                }
+                n_replicas = j["n_replicas"].get<int>();
+            }
+
+            if (j.contains("embedding_contexts") && !j["embedding_contexts"].is_null()) {
+                if (!j["embedding_contexts"].is_number_integer()) {
+                    throw std::runtime_error("embedding_contexts must be an integer");
+                }
+                embedding_contexts = j["embedding_contexts"].get<int>();
+            }
+
+            if (j.contains("embedding_batch_window_us") && !j["embedding_batch_window_us"].is_null()) {
+                if (!j["embedding_batch_window_us"].is_number_integer()) {
+                    throw std::runtime_error("embedding_batch_window_us must be an integer");
+                }
+                embedding_batch_window_us = j["embedding_batch_window_us"].get<int>();
+            }
+
+            if (j.contains("n_prefix_cache") && !j["n_prefix_cache"].is_null()) {
+                if (!j["n_prefix_cache"].is_number_integer()) {
+                    throw std::runtime_error("n_prefix_cache must be an integer");
+                }
+                n_prefix_cache = j["n_prefix_cache"].get<int>();
+            }
+
+            if (j.contains("prefix_cache_dir") && !j["prefix_cache_dir"].is_null()) {
+                if (!j["prefix_cache_dir"].is_string()) {
+                    throw std::runtime_error("prefix_cache_dir must be a string");
+                }
+                prefix_cache_dir = j["prefix_cache_dir"].get<std::string>();
+            }
+
+            if (j.contains("prefix_cache_save_seconds") && !j["prefix_cache_save_seconds"].is_null()) {
+                if (!j["prefix_cache_save_seconds"].is_number_integer()) {
+                    throw std::runtime_error("prefix_cache_save_seconds must be an integer");
+                }
+                prefix_cache_save_seconds = j["prefix_cache_save_seconds"].get<int>();
+            }
+
+            if (j.contains("chunk_cache_mb") && !j["chunk_cache_mb"].is_null()) {
+                if (!j["chunk_cache_mb"].is_number_integer()) {
+                    throw std::runtime_error("chunk_cache_mb must be an integer");
+                }
+                chunk_cache_mb = j["chunk_cache_mb"].get<int>();
+            }
+
+            if (j.contains("preempt_swap_mb") && !j["preempt_swap_mb"].is_null()) {
+                if (!j["preempt_swap_mb"].is_number_integer()) {
+                    throw std::runtime_error("preempt_swap_mb must be an integer");
+                }
+                preempt_swap_mb = j["preempt_swap_mb"].get<int>();
+            }
+
+            if (j.contains("kv_block_tokens") && !j["kv_block_tokens"].is_null()) {
+                if (!j["kv_block_tokens"].is_number_integer()) {
+                    throw std::runtime_error("kv_block_tokens must be an integer");
+                }
+                kv_block_tokens = j["kv_block_tokens"].get<int>();
+            }
+
+            if (j.contains("max_seq_ctx") && !j["max_seq_ctx"].is_null()) {
+                if (!j["max_seq_ctx"].is_number_integer()) {
+                    throw std::runtime_error("max_seq_ctx must be an integer");
+                }
+                max_seq_ctx = j["max_seq_ctx"].get<int>();
+            }
+
+            if (j.contains("max_queued_jobs") && !j["max_queued_jobs"].is_null()) {
+                if (!j["max_queued_jobs"].is_number_integer()) {
+                    throw std::runtime_error("max_queued_jobs must be an integer");
+                }
+                max_queued_jobs = j["max_queued_jobs"].get<int>();
+            }
+
+            if (j.contains("max_queued_tokens") && !j["max_queued_tokens"].is_null()) {
+                if (!j["max_queued_tokens"].is_number_integer()) {
+                    throw std::runtime_error("max_queued_tokens must be an integer");
+                }
+                max_queued_tokens = j["max_queued_tokens"].get<int>();
+            }
+
+            if (j.contains("profile_steps") && !j["profile_steps"].is_null()) {
+                if (!j["profile_steps"].is_number_integer()) {
+                    throw std::runtime_error("profile_steps must be an integer");
+                }
+                profile_steps = j["profile_steps"].get<int>();
+            }
             
             if (j.contains("n_gpu_layers") && !j["n_gpu_layers"].is_null()) {
                 if (!j["n_gpu_layers"].is_number_integer()) {
@@ -133,6 +334,139 @@ public:
                 n_ubatch = j["n_ubatch"].get<int>();
             }
 
+            if (j.contains("n_step_tokens") && !j["n_step_tokens"].is_null()) {
+                if (!j["n_step_tokens"].is_number_integer()) {
+                    throw std::runtime_error("n_step_tokens must be an integer");
+                }
+                n_step_tokens = j["n_step_tokens"].get<int>();
+            }
+
+            if (j.contains("prefill_share") && !j["prefill_share"].is_null()) {
+                if (!j["prefill_share"].is_number()) {
+                    throw std::runtime_error("prefill_share must be a number");
+                }
+                prefill_share = j["prefill_share"].get<float>();
+            }
+
+            if (j.contains("slo_ttft_ms") && !j["slo_ttft_ms"].is_null()) {
+                if (!j["slo_ttft_ms"].is_number()) {
+                    throw std::runtime_error("slo_ttft_ms must be a number");
+                }
+                slo_ttft_ms = j["slo_ttft_ms"].get<float>();
+            }
+
+            if (j.contains("slo_tpot_ms") && !j["slo_tpot_ms"].is_null()) {
+                if (!j["slo_tpot_ms"].is_number()) {
+                    throw std::runtime_error("slo_tpot_ms must be a number");
+                }
+                slo_tpot_ms = j["slo_tpot_ms"].get<float>();
+            }
+
+            if (j.contains("draft_model_path") && !j["draft_model_path"].is_null()) {
+                if (!j["draft_model_path"].is_string()) {
+                    throw std::runtime_error("draft_model_path must be a string");
+                }
+                draft_model_path = j["draft_model_path"].get<std::string>();
+            }
+
+            if (j.contains("n_draft") && !j["n_draft"].is_null()) {
+                if (!j["n_draft"].is_number_integer()) {
+                    throw std::runtime_error("n_draft must be an integer");
+                }
+                n_draft = j["n_draft"].get<int>();
+            }
+
+            if (j.contains("prompt_lookup") && !j["prompt_lookup"].is_null()) {
+                if (!j["prompt_lookup"].is_boolean()) {
+                    throw std::runtime_error("prompt_lookup must be a boolean");
+                }
+                prompt_lookup = j["prompt_lookup"].get<bool>();
+            }
+
+            if (j.contains("n_threads") && !j["n_threads"].is_null()) {
+                if (!j["n_threads"].is_number_integer()) {
+                    throw std::runtime_error("n_threads must be an integer");
+                }
+                n_threads = j["n_threads"].get<int>();
+            }
+
+            if (j.contains("cpu_cores") && !j["cpu_cores"].is_null()) {
+                if (!j["cpu_cores"].is_string()) {
+                    throw std::runtime_error("cpu_cores must be a string");
+                }
+                cpu_cores = j["cpu_cores"].get<std::string>();
+            }
+
+            if (j.contains("numa_node") && !j["numa_node"].is_null()) {
+                if (!j["numa_node"].is_number_integer()) {
+                    throw std::runtime_error("numa_node must be an integer");
+                }
+                numa_node = j["numa_node"].get<int>();
+            }
+
+            if (j.contains("cache_type_k") && !j["cache_type_k"].is_null()) {
+                if (!j["cache_type_k"].is_string()) {
+                    throw std::runtime_error("cache_type_k must be a string");
+                }
+                cache_type_k = j["cache_type_k"].get<std::string>();
+            }
+
+            if (j.contains("cache_type_v") && !j["cache_type_v"].is_null()) {
+                if (!j["cache_type_v"].is_string()) {
+                    throw std::runtime_error("cache_type_v must be a string");
+                }
+                cache_type_v = j["cache_type_v"].get<std::string>();
+            }
+
+            if (j.contains("fit_vram") && !j["fit_vram"].is_null()) {
+                if (!j["fit_vram"].is_boolean()) {
+                    throw std::runtime_error("fit_vram must be a boolean");
+                }
+                fit_vram = j["fit_vram"].get<bool>();
+            }
+
+            if (j.contains("moe_offload") && !j["moe_offload"].is_null()) {
+                if (!j["moe_offload"].is_string()) {
+                    throw std::runtime_error("moe_offload must be a string");
+                }
+                moe_offload = j["moe_offload"].get<std::string>();
+            }
+
+            if (j.contains("autotune") && !j["autotune"].is_null()) {
+                if (!j["autotune"].is_boolean()) {
+                    throw std::runtime_error("autotune must be a boolean");
+                }
+                autotune = j["autotune"].get<bool>();
+            }
+
+            if (j.contains("autotune_cache") && !j["autotune_cache"].is_null()) {
+                if (!j["autotune_cache"].is_string()) {
+                    throw std::runtime_error("autotune_cache must be a string");
+                }
+                autotune_cache = j["autotune_cache"].get<std::string>();
+            }
+
+            if (j.contains("kv_host_cache_mb") && !j["kv_host_cache_mb"].is_null()) {
+                if (!j["kv_host_cache_mb"].is_number_integer()) {
+                    throw std::runtime_error("kv_host_cache_mb must be an integer");
+                }
+                kv_host_cache_mb = j["kv_host_cache_mb"].get<int>();
+            }
+
+            if (j.contains("kv_disk_cache_mb") && !j["kv_disk_cache_mb"].is_null()) {
+                if (!j["kv_disk_cache_mb"].is_number_integer()) {
+                    throw std::runtime_error("kv_disk_cache_mb must be an integer");
+                }
+                kv_disk_cache_mb = j["kv_disk_cache_mb"].get<int>();
+            }
+
+            if (j.contains("kv_disk_cache_dir") && !j["kv_disk_cache_dir"].is_null()) {
+                if (!j["kv_disk_cache_dir"].is_string()) {
+                    throw std::runtime_error("kv_disk_cache_dir must be a string");
+                }
+                kv_disk_cache_dir = j["kv_disk_cache_dir"].get<std::string>();
+            }
+
             if (j.contains("split_mode") && !j["split_mode"].is_null()) {
                 if (!j["split_mode"].is_number_integer()) {
                     throw std::runtime_error("split_mode must be an integer");
@@ -155,6 +489,36 @@ public:
                     }
                 }
             }
+
+            if (j.contains("lora_adapters") && !j["lora_adapters"].is_null()) {
+                if (!j["lora_adapters"].is_array()) {
+                    throw std::runtime_error("lora_adapters must be an array of {name, path, scale} objects");
+                }
+                lora_adapters.clear();
+                for (const auto &item : j["lora_adapters"]) {
+                    if (!item.is_object() || !item.contains("name") || !item["name"].is_string()
+                        || !item.contains("path") || !item["path"].is_string()) {
+                        throw std::runtime_error("lora_adapters entries need string name and path fields");
+                    }
+                    LoraAdapterModel adapter;
+                    adapter.name = item["name"].get<std::string>();
+                    adapter.path = item["path"].get<std::string>();
+                    if (item.contains("scale") && !item["scale"].is_null()) {
+                        if (!item["scale"].is_number()) {
+                            throw std::runtime_error("lora_adapters scale must be a number");
+                        }
+                        adapter.scale = item["scale"].get<float>();
+                    }
+                    lora_adapters.push_back(adapter);
+                }
+            }
+
+            if (j.contains("lora_max_loaded") && !j["lora_max_loaded"].is_null()) {
+                if (!j["lora_max_loaded"].is_number_integer()) {
+                    throw std::runtime_error("lora_max_loaded must be an integer");
+                }
+                lora_max_loaded = j["lora_max_loaded"].get<int>();
+            }
         }
     } loading_parameters;
 
@@ -184,10 +548,87 @@ public:
             return false;
         }
 
+        if (loading_parameters.n_step_tokens < 0 || loading_parameters.n_step_tokens > loading_parameters.n_batch) {
+            return false;
+        }
+
+        if (loading_parameters.prefill_share <= 0.0f || loading_parameters.prefill_share > 1.0f) {
+            return false;
+        }
+
+        if (loading_parameters.slo_ttft_ms < 0.0f || loading_parameters.slo_tpot_ms < 0.0f) {
+            return false;
+        }
+
+        if (loading_parameters.n_draft < 0 || loading_parameters.n_draft > 64) {
+            return false;
+        }
+
+        if (loading_parameters.kv_host_cache_mb < 0 || loading_parameters.kv_disk_cache_mb < 0) {
+            return false;
+        }
+
+        if (loading_parameters.preempt_swap_mb < 0) {
+            return false;
+        }
+
+        if (loading_parameters.kv_block_tokens < 0 || loading_parameters.max_seq_ctx < 0) {
+            return false;
+        }
+
+        if (loading_parameters.n_threads < 0 || loading_parameters.numa_node < -1) {
+            return false;
+        }
+
+        for (const std::string* type : { &loading_parameters.cache_type_k, &loading_parameters.cache_type_v }) {
+            if (*type != "f32" && *type != "f16" && *type != "bf16" && *type != "q8_0" && *type != "q5_1"
+                && *type != "q5_0" && *type != "q4_1" && *type != "q4_0" && *type != "auto") {
+                return false;
+            }
+        }
+
+        if (loading_parameters.huge_pages != "off" && loading_parameters.huge_pages != "thp"
+            && loading_parameters.huge_pages != "2m" && loading_parameters.huge_pages != "1g") {
+            return false;
+        }
+
+        if (loading_parameters.repack_cache_mb < 0) {
+            return false;
+        }
+
+        if (loading_parameters.moe_offload != "off" && loading_parameters.moe_offload != "all"
+            && loading_parameters.moe_offload != "auto") {
+            return false;
+        }
+
         if (loading_parameters.n_parallel <= 0 || loading_parameters.n_parallel > 16) {
             return false;
         }
 
+        if (loading_parameters.n_replicas <= 0 || loading_parameters.n_replicas > 16) {
+            return false;
+        }
+
+        if (loading_parameters.embedding_contexts <= 0 || loading_parameters.embedding_contexts > 16) {
+            return false;
+        }
+
+        if (loading_parameters.embedding_batch_window_us < 0 || loading_parameters.embedding_batch_window_us > 100000) {
+            return false;
+        }
+
+        if (loading_parameters.n_prefix_cache < 0 || loading_parameters.n_prefix_cache > 16) {
+            return false;
+        }
+
+        if (loading_parameters.max_queued_jobs < 0 || loading_parameters.max_queued_tokens < 0) {
+            return false;
+        }
+
+        if (loading_parameters.profile_steps < 0 || loading_parameters.profile_steps > 100000) {
+            return false;
+        }
+
         if (loading_parameters.n_gpu_layers < 0 || loading_parameters.n_gpu_layers > 1000) {
             return false;
         }
@@ -208,6 +649,21 @@ public:
             return false;
         }
 
+        if (loading_parameters.lora_max_loaded < 0) {
+            return false;
+        }
+        for (size_t i = 0; i < loading_parameters.lora_adapters.size(); ++i) {
+            const auto &adapter = loading_parameters.lora_adapters[i];
+            if (adapter.name.empty() || adapter.path.empty()) {
+                return false;
+            }
+            for (size_t k = 0; k < i; ++k) {
+                if (loading_parameters.lora_adapters[k].name == adapter.name) {
+                    return false;
+                }
+            }
+        }
+
         return true;
     }
 
@@ -259,12 +715,36 @@ public:
                 throw std::runtime_error("model_type must be a string");
             }
             std::string type = j["model_type"].get<std::string>();
-            if (type != "llm" && type != "embedding") {
-                throw std::runtime_error("model_type must be either 'llm' or 'embedding'");
+            if (type != "llm" && type != "embedding" && type != "rerank") {
+                throw std::runtime_error("model_type must be 'llm', 'embedding' or 'rerank'");
             }
             model_type = type;
         }
 
+        if (j.contains("sha256") && !j["sha256"].is_null()) {
+            if (!j["sha256"].is_string()) {
+                throw std::runtime_error("sha256 must be a string");
+            }
+            j.at("sha256").get_to(sha256);
+            bool is_hex = sha256.size() == 64;
+            for (char c : sha256) {
+                is_hex = is_hex && std::isxdigit(static_cast<unsigned char>(c));
+            }
+            if (!is_hex) {
+                throw std::runtime_error("sha256 must be a 64 character hex string");
+            }
+        }
+
+        if (j.contains("priority") && !j["priority"].is_null()) {
+            if (!j["priority"].is_string()) {
+                throw std::runtime_error("priority must be a string");
+            }
+            j.at("priority").get_to(priority);
+            if (priority != "low" && priority != "normal" && priority != "high") {
+                throw std::runtime_error("priority must be 'low', 'normal' or 'high'");
+            }
+        }
+
         // Parse loading parameters if present
         if (j.contains("loading_parameters") && !j["loading_parameters"].is_null()) {
             if (!j["loading_parameters"].is_object()) {
@@ -284,6 +764,10 @@ public:
             {"model_type", model_type},
             {"loading_parameters", loading_parameters.to_json()}
         };
+        if (!sha256.empty()) {
+            j["sha256"] = sha256;
+        }
+        j["priority"] = priority;
 
         return j;
     }
@@ -6,6 +6,7 @@
 #include <string>
 #include <vector>
 #include <optional>
+#include <variant>
 #include <json.hpp>
 
 class KOLOSAL_SERVER_API ChatCompletionRequest : public IModel {
@@ -20,7 +21,11 @@ public:
     std::optional<double> presence_penalty;
     std::optional<double> frequency_penalty;
     std::optional<std::string> user;
+    std::optional<std::string> session_id;  // Keeps this conversation's KV warm between turns
     std::optional<int> seed;
+    std::optional<std::variant<std::string, std::vector<std::string>>> stop;
+    std::optional<bool> prompt_lookup;      // Prompt-lookup speculative decoding, overrides the model setting
+    std::optional<std::string> lora_adapter; // LoRA adapter registered with the model; omitted = base model
 
     bool validate() const override {
         if (model.empty() || messages.empty()) {
@@ -118,12 +123,46 @@ public:
             user = j["user"].get<std::string>();
         }
 
+        if (j.contains("session_id") && !j["session_id"].is_null()) {
+            if (!j["session_id"].is_string()) {
+                throw std::runtime_error("Session_id must be a string");
+            }
+            session_id = j["session_id"].get<std::string>();
+        }
+
         if (j.contains("seed") && !j["seed"].is_null()) {
             if (!j["seed"].is_number_integer()) {
                 throw std::runtime_error("Seed must be an integer");
             }
             seed = j["seed"].get<int>();
         }
+
+        if (j.contains("stop") && !j["stop"].is_null()) {
+            auto& s = j["stop"];
+            if (s.is_string()) {
+                stop = s.get<std::string>();
+            }
+            else if (s.is_array()) {
+                stop = s.get<std::vector<std::string>>();
+            }
+            else {
+                throw std::runtime_error("Stop must be a string or array of strings");
+            }
+        }
+
+        if (j.contains("prompt_lookup") && !j["prompt_lookup"].is_null()) {
+            if (!j["prompt_lookup"].is_boolean()) {
+                throw std::runtime_error("Prompt_lookup must be a boolean");
+            }
+            prompt_lookup = j["prompt_lookup"].get<bool>();
+        }
+
+        if (j.contains("lora_adapter") && !j["lora_adapter"].is_null()) {
+            if (!j["lora_adapter"].is_string()) {
+                throw std::runtime_error("Lora_adapter must be a string");
+            }
+            lora_adapter = j["lora_adapter"].get<std::string>();
+        }
     }
 
     nlohmann::json to_json() const override {
@@ -157,10 +196,31 @@ public:
             j["user"] = user.value();
         }
 
+        if (session_id.has_value()) {
+            j["session_id"] = session_id.value();
+        }
+
         if (seed.has_value()) {
             j["seed"] = seed.value();
         }
 
+        if (stop.has_value()) {
+            if (std::holds_alternative<std::string>(*stop)) {
+                j["stop"] = std::get<std::string>(*stop);
+            }
+            else if (std::holds_alternative<std::vector<std::string>>(*stop)) {
+                j["stop"] = std::get<std::vector<std::string>>(*stop);
+            }
+        }
+
+        if (prompt_lookup.has_value()) {
+            j["prompt_lookup"] = prompt_lookup.value();
+        }
+
+        if (lora_adapter.has_value()) {
+            j["lora_adapter"] = lora_adapter.value();
+        }
+
         return j;
     }
 };
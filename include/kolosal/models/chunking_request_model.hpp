@@ -4,6 +4,7 @@
 #include "model_interface.hpp"
 #include <json.hpp>
 #include <string>
+#include <vector>
 
 namespace kolosal
 {
@@ -16,11 +17,20 @@ namespace kolosal
 class ChunkingRequest : public IModel
 {
 public:
+    // Most texts one request may carry
+    static constexpr size_t kMaxTexts = 256;
+
     // Model name to use for embeddings (required)
     std::string model_name;
     
-    // Text to be chunked (required)
+    // Text to be chunked (required unless texts is given)
     std::string text;
+
+    // Several texts chunked concurrently, answered per text (optional)
+    std::vector<std::string> texts;
+
+    // Emit chunks as NDJSON/SSE records as each text finishes (optional, default false)
+    bool stream = false;
     
     // Base chunk size in tokens (optional, default 128)
     int chunk_size = 128;
@@ -27,6 +27,8 @@ public:
     std::optional<std::variant<std::string, std::vector<std::string>>> stop;
     std::optional<std::string> user;
     std::optional<int> seed;
+    std::optional<bool> prompt_lookup;      // Prompt-lookup speculative decoding, overrides the model setting
+    std::optional<std::string> lora_adapter; // LoRA adapter registered with the model; omitted = base model
 
     bool validate() const override {
         if (model.empty()) {
@@ -185,6 +187,20 @@ public:
             }
             seed = j["seed"].get<int>();
         }
+
+        if (j.contains("prompt_lookup") && !j["prompt_lookup"].is_null()) {
+            if (!j["prompt_lookup"].is_boolean()) {
+                throw std::runtime_error("Prompt_lookup must be a boolean");
+            }
+            prompt_lookup = j["prompt_lookup"].get<bool>();
+        }
+
+        if (j.contains("lora_adapter") && !j["lora_adapter"].is_null()) {
+            if (!j["lora_adapter"].is_string()) {
+                throw std::runtime_error("Lora_adapter must be a string");
+            }
+            lora_adapter = j["lora_adapter"].get<std::string>();
+        }
     }
 
     nlohmann::json to_json() const override {
@@ -253,6 +269,14 @@ public:
             j["seed"] = seed.value();
         }
 
+        if (prompt_lookup.has_value()) {
+            j["prompt_lookup"] = prompt_lookup.value();
+        }
+
+        if (lora_adapter.has_value()) {
+            j["lora_adapter"] = lora_adapter.value();
+        }
+
         return j;
     }
 };
\ No newline at end of file
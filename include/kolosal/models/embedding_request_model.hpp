@@ -3,6 +3,7 @@
 
 #include "model_interface.hpp"
 #include <json.hpp>
+#include <istream>
 #include <string>
 #include <variant>
 #include <vector>
@@ -25,15 +26,20 @@ public:
     // Model identifier (required)
     std::string model;
     
-    // Encoding format (optional, defaults to "float")
+    // Encoding format (optional, defaults to "float"): "float", or "base64", "float16"
+    // and "int8" for base64-packed float32, float16 and int8 values
     std::string encoding_format = "float";
     
-    // Number of dimensions to return (optional)
+    // Number of dimensions to return (optional); longer embeddings are truncated
+    // and renormalised, as for Matryoshka models
     int dimensions = -1; // -1 means use model default
     
     // User identifier for tracking (optional)
     std::string user;
 
+    // Answer with one NDJSON line per embedding as it is ready, instead of one JSON document
+    bool stream = false;
+
     /**
      * @brief Default constructor
      */
@@ -62,12 +68,31 @@ public:
      */
     void from_json(const nlohmann::json& j) override;
 
+    /**
+     * @brief Populates the request from the JSON text without building a DOM
+     * 
+     * Equivalent to from_json(json::parse(body)), but input strings are moved
+     * into the request as the parser produces them.
+     * 
+     * @param body Request body, complete or still arriving
+     * @throws nlohmann::json::parse_error if the body is not valid JSON
+     * @throws std::runtime_error if a field is missing or has the wrong type
+     */
+    void parse(const std::string& body);
+    void parse(std::istream& body);
+
     /**
      * @brief Gets the input as a vector of strings
      * @return Vector of input strings
      */
     std::vector<std::string> getInputTexts() const;
 
+    /**
+     * @brief Moves the input out as a vector of strings, leaving the request without input
+     * @return Vector of input strings
+     */
+    std::vector<std::string> takeInputTexts();
+
     /**
      * @brief Checks if the request has multiple inputs
      * @return true if multiple inputs, false if single input
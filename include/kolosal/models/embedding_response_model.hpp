@@ -20,13 +20,15 @@ struct EmbeddingData
 
     /**
      * @brief Converts embedding data to JSON
+     * @param encoding_format "float" for a JSON array, or "base64", "float16" or "int8"
+     *        for a base64 string of little-endian float32, float16 or int8 values
      * @return JSON representation
      */
-    nlohmann::json to_json() const;
+    nlohmann::json to_json(const std::string& encoding_format = "float") const;
 
     /**
      * @brief Populates embedding data from JSON
-     * @param j JSON object to parse
+     * @param j JSON object to parse (a string embedding is read as base64 float32)
      */
     void from_json(const nlohmann::json& j);
 };
@@ -65,6 +67,7 @@ public:
     std::vector<EmbeddingData> data;
     std::string model;
     EmbeddingUsage usage;
+    std::string encoding_format = "float";  // How to_json() writes each embedding
 
     /**
      * @brief Default constructor
@@ -99,7 +102,7 @@ public:
      * @param embedding Vector of floats representing the embedding
      * @param index Index of this embedding in the batch
      */
-    void addEmbedding(const std::vector<float>& embedding, int index);
+    void addEmbedding(std::vector<float> embedding, int index);
 
     /**
      * @brief Sets the usage statistics
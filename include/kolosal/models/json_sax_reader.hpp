@@ -0,0 +1,95 @@
+#ifndef KOLOSAL_JSON_SAX_READER_HPP
+#define KOLOSAL_JSON_SAX_READER_HPP
+
+#include "../export.hpp"
+#include <json.hpp>
+#include <initializer_list>
+#include <istream>
+#include <string>
+#include <vector>
+
+namespace kolosal
+{
+
+/**
+ * @brief Base for request models filled straight from the JSON text
+ *
+ * Runs nlohmann's SAX parser so that large bodies (embedding inputs, documents
+ * to ingest) never become a JSON DOM. Before each value the subclass decides,
+ * in collect(), whether it reads the value's events itself or wants it
+ * collected into a json (small fields, metadata). It can also skip the value
+ * (discard()). Strings reach onString() by reference, so they can be moved
+ * into the model instead of copied.
+ *
+ * The position of the current value is given by the containers around it.
+ * depth() is 0 for the root, and atPath() compares member keys, with "[]"
+ * standing for an array element.
+ */
+class KOLOSAL_SERVER_API JsonSaxReader : public nlohmann::json_sax<nlohmann::json>
+{
+public:
+    using json = nlohmann::json;
+
+    virtual ~JsonSaxReader() = default;
+
+    /**
+     * @brief Parses a complete document
+     * @throws json::parse_error if the text is not valid JSON
+     * @throws std::runtime_error if the subclass rejects the content
+     */
+    void parse(const std::string& text);
+    void parse(std::istream& in);
+
+    bool null() override;
+    bool boolean(bool val) override;
+    bool number_integer(number_integer_t val) override;
+    bool number_unsigned(number_unsigned_t val) override;
+    bool number_float(number_float_t val, const string_t& s) override;
+    bool string(string_t& val) override;
+    bool binary(binary_t& val) override;
+    bool start_object(std::size_t elements) override;
+    bool key(string_t& val) override;
+    bool end_object() override;
+    bool start_array(std::size_t elements) override;
+    bool end_array() override;
+    bool parse_error(std::size_t position, const std::string& last_token, const nlohmann::detail::exception& ex) override;
+
+protected:
+    // Where the value starting at the current position goes: nullptr to get its
+    // events, a json to have it collected (onCollected() follows), or discard()
+    virtual json* collect() = 0;
+    virtual void onString(std::string& value) = 0;
+    virtual void onScalar(json&& value) = 0;     // Numbers, booleans and null
+    virtual void onStart(bool array) = 0;
+    virtual void onEnd(bool array) = 0;          // Position is that of the container again
+    virtual void onCollected() {}
+
+    json* discard() { return &discarded_; }
+
+    size_t depth() const { return frames_.size(); }
+    const std::string& keyAt(size_t level) const { return frames_[level].key; }
+    bool atPath(std::initializer_list<const char*> path) const;
+
+private:
+    struct Frame
+    {
+        bool array;
+        std::string key;    // Member being read, for objects
+    };
+
+    bool value(json&& v);
+    bool beginContainer(bool array);
+    bool endContainer(bool array);
+    void finishCollecting();
+
+    std::vector<Frame> frames_;
+    json* target_ = nullptr;        // Set while a value is being collected
+    std::vector<json*> building_;   // Open containers of the collected value
+    std::string buildingKey_;
+    size_t skipping_ = 0;           // Open containers of a discarded value
+    json discarded_;
+};
+
+} // namespace kolosal
+
+#endif // KOLOSAL_JSON_SAX_READER_HPP
@@ -0,0 +1,67 @@
+#ifndef KOLOSAL_RERANK_REQUEST_MODEL_HPP
+#define KOLOSAL_RERANK_REQUEST_MODEL_HPP
+
+#include "model_interface.hpp"
+#include <json.hpp>
+#include <string>
+#include <vector>
+
+namespace kolosal
+{
+
+/**
+ * @brief Model for rerank request
+ *
+ * This model represents the request body for the /v1/rerank endpoint, in the
+ * shape used by Cohere and Jina rerank APIs.
+ */
+class RerankRequest : public IModel
+{
+public:
+    // Reranker model identifier (required)
+    std::string model;
+
+    // Query the documents are scored against (required)
+    std::string query;
+
+    // Documents to score; strings or objects with a "text" field (required)
+    std::vector<std::string> documents;
+
+    // Number of best documents to return (optional, -1 returns all)
+    int top_n = -1;
+
+    // Include the document text in each result (optional)
+    bool return_documents = true;
+
+    /**
+     * @brief Default constructor
+     */
+    RerankRequest() = default;
+
+    /**
+     * @brief Virtual destructor
+     */
+    virtual ~RerankRequest() = default;
+
+    /**
+     * @brief Validates the rerank request
+     * @return true if valid, false otherwise
+     */
+    bool validate() const override;
+
+    /**
+     * @brief Converts the request to JSON
+     * @return JSON representation
+     */
+    nlohmann::json to_json() const override;
+
+    /**
+     * @brief Populates the request from JSON
+     * @param j JSON object to parse
+     */
+    void from_json(const nlohmann::json& j) override;
+};
+
+} // namespace kolosal
+
+#endif // KOLOSAL_RERANK_REQUEST_MODEL_HPP
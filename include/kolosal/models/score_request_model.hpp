@@ -0,0 +1,67 @@
+#ifndef KOLOSAL_SCORE_REQUEST_MODEL_HPP
+#define KOLOSAL_SCORE_REQUEST_MODEL_HPP
+
+#include "model_interface.hpp"
+#include <json.hpp>
+#include <string>
+#include <vector>
+
+namespace kolosal
+{
+
+/**
+ * @brief Model for score request
+ *
+ * This model represents the request body for the /v1/score endpoint: prompt and
+ * continuation pairs whose log-likelihood is computed without generating.
+ */
+class ScoreRequest : public IModel
+{
+public:
+    struct Pair
+    {
+        std::string prompt;
+        std::string continuation;
+    };
+
+    // Language model identifier (required)
+    std::string model;
+
+    // Pairs to score; objects with "prompt" and "continuation" strings (required)
+    std::vector<Pair> pairs;
+
+    // Likeliest alternatives to return for each continuation token (optional, 0 to 20)
+    int top_logprobs = 0;
+
+    /**
+     * @brief Default constructor
+     */
+    ScoreRequest() = default;
+
+    /**
+     * @brief Virtual destructor
+     */
+    virtual ~ScoreRequest() = default;
+
+    /**
+     * @brief Validates the score request
+     * @return true if valid, false otherwise
+     */
+    bool validate() const override;
+
+    /**
+     * @brief Converts the request to JSON
+     * @return JSON representation
+     */
+    nlohmann::json to_json() const override;
+
+    /**
+     * @brief Populates the request from JSON
+     * @param j JSON object to parse
+     */
+    void from_json(const nlohmann::json& j) override;
+};
+
+} // namespace kolosal
+
+#endif // KOLOSAL_SCORE_REQUEST_MODEL_HPP
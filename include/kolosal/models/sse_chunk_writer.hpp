@@ -0,0 +1,65 @@
+#pragma once
+
+#include "../export.hpp"
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <string_view>
+
+namespace kolosal
+{
+
+/**
+ * @brief Appends text to out as the contents of a JSON string
+ *
+ * Escapes like nlohmann's dump(): quote, backslash and control characters,
+ * with everything else copied as is. Invalid UTF-8 becomes U+FFFD instead of
+ * throwing, since a stream must not fail on one bad byte.
+ */
+KOLOSAL_SERVER_API void appendJsonEscaped(std::string& out, std::string_view text);
+
+/**
+ * @brief Server-sent event serializer for streamed completion chunks
+ *
+ * Produces the same events as ChatCompletionChunk / CompletionChunk
+ * to_json().dump(), without building a JSON tree per token. The fields that
+ * are fixed for the whole stream (id, model, created, object, fingerprint)
+ * are rendered once. Each event then only escapes the delta text into a
+ * buffer that is reused from one event to the next.
+ *
+ * One writer per stream; not thread-safe.
+ */
+class KOLOSAL_SERVER_API SseChunkWriter
+{
+public:
+    enum class Format
+    {
+        ChatCompletion,     // "chat.completion.chunk" with choices[].delta.content
+        TextCompletion      // "text_completion" with choices[].text
+    };
+
+    SseChunkWriter(Format format, const std::string& id, const std::string& model,
+                   int64_t created = static_cast<int64_t>(std::time(nullptr)));
+
+    /**
+     * @brief Event carrying text generated for one choice
+     * @return "data: {...}\n\n", valid until the next call on this writer
+     */
+    const std::string& text(size_t index, std::string_view text);
+
+    /**
+     * @brief Closing event of one choice
+     * @return "data: {...}\n\n", valid until the next call on this writer
+     */
+    const std::string& finish(size_t index, std::string_view reason = "stop");
+
+private:
+    void begin();
+    const std::string& end();
+
+    Format format_;
+    std::string suffix_;    // Fields after "choices", through the closing "}\n\n"
+    std::string buffer_;
+};
+
+} // namespace kolosal
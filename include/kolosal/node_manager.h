@@ -4,12 +4,15 @@
 #include "export.hpp"
 #include "inference_interface.h"
 #include "inference_loader.hpp"
+#include "model_catalog.hpp"
 #include <vector>
 #include <memory>
 #include <string>
 #include <mutex>
 #include <shared_mutex>
 #include <unordered_map>
+#include <map>
+#include <optional>
 #include <chrono>
 #include <thread>
 #include <atomic>
@@ -83,7 +86,22 @@ public:
      * @param mainGpuId The main GPU ID to use for this engine.
      * @return True if the engine was loaded successfully, false otherwise.
      */
-    bool addEmbeddingEngine(const std::string& engineId, const char* modelPath, const LoadingParameters& loadParams, int mainGpuId = 0);    /**
+    bool addEmbeddingEngine(const std::string& engineId, const char* modelPath, const LoadingParameters& loadParams, int mainGpuId = 0);
+
+    /**
+     * @brief Loads a cross-encoder reranker with the given model and parameters.
+     * The model is loaded with rank pooling and scores query-document pairs through
+     * IInferenceEngine::rerank().
+     * 
+     * @param engineId A unique identifier for this engine.
+     * @param modelPath Path to the reranker model file.
+     * @param loadParams Parameters for loading the model.
+     * @param mainGpuId The main GPU ID to use for this engine.
+     * @return True if the engine was loaded successfully, false otherwise.
+     */
+    bool addRerankEngine(const std::string& engineId, const char* modelPath, const LoadingParameters& loadParams, int mainGpuId = 0);
+
+    /**
      * @brief Registers a model for lazy loading without immediately loading it.
      * The model will be validated but not loaded until first access.
      * 
@@ -120,6 +138,17 @@ public:
      */
     bool registerEmbeddingEngine(const std::string& engineId, const char* modelPath, const LoadingParameters& loadParams, int mainGpuId = 0);
 
+    /**
+     * @brief Registers a reranker model for lazy loading without immediately loading it.
+     * 
+     * @param engineId A unique identifier for this engine.
+     * @param modelPath Path to the reranker model file.
+     * @param loadParams Parameters for loading the model.
+     * @param mainGpuId The main GPU ID to use for this engine.
+     * @return True if the model was validated and registered successfully, false otherwise.
+     */
+    bool registerRerankEngine(const std::string& engineId, const char* modelPath, const LoadingParameters& loadParams, int mainGpuId = 0);
+
     /**
      * @brief Retrieves a pointer to an inference engine by its ID.
      * If the engine was unloaded due to inactivity, it will attempt to reload it.
@@ -130,6 +159,45 @@ public:
      */
     std::shared_ptr<IInferenceEngine> getEngine(const std::string& engineId);
 
+    /**
+     * @brief Outcome of admission control for a request.
+     */
+    struct Admission {
+        bool rejected = false;       // Every replica is over max_queued_jobs / max_queued_tokens or its SLO admission limit
+        int retryAfterSeconds = 0;   // Suggested Retry-After when rejected
+    };
+
+    /**
+     * @brief getEngine() for request handlers, with admission control.
+     * When the engine's queue limits are exceeded the request is not admitted:
+     * returns nullptr with admission.rejected set, so the caller can answer
+     * 503 right away instead of queueing work the client may give up on.
+     *
+     * @param engineId The ID of the engine to retrieve.
+     * @param admission Receives the admission decision.
+     * @return The replica to submit to, or nullptr if not found, not loadable or rejected.
+     */
+    std::shared_ptr<IInferenceEngine> getEngine(const std::string& engineId, Admission& admission);
+
+    /**
+     * @brief getEngine() with admission control and context-length-aware routing.
+     * When engineId is a model alias, its variants are tried from the smallest context
+     * that holds contextTokens up; if none is large enough, the largest one serves the
+     * request. A variant over its queue limits passes the request on to the next.
+     *
+     * @param engineId Engine ID or model alias.
+     * @param admission Receives the admission decision.
+     * @param contextTokens Estimated prompt plus new tokens of the request (0 = unknown).
+     */
+    std::shared_ptr<IInferenceEngine> getEngine(const std::string& engineId, Admission& admission, int contextTokens);
+
+    /**
+     * @brief Replaces the model aliases: each maps a model name clients send to engine
+     * variants of the same model that differ in context length (and so in memory and speed).
+     */
+    void setModelAliases(const std::map<std::string, std::vector<std::string>>& aliases);
+    std::map<std::string, std::vector<std::string>> getModelAliases() const;
+
     /**
      * @brief Checks if an engine exists and its load status without loading it.
      * This method does not trigger loading of lazy models and does not update activity time.
@@ -140,19 +208,61 @@ public:
      */
     std::pair<bool, bool> getEngineStatus(const std::string& engineId) const;
 
+    /**
+     * @brief Whether an unloaded engine is hibernating: its weights are held in host RAM,
+     * so the next request reloads it without reading the model from disk.
+     *
+     * @param engineId The ID of the engine to check.
+     */
+    bool isEngineHibernated(const std::string& engineId) const;
+
+    /**
+     * @brief Load progress of an engine without triggering a load.
+     *
+     * @param engineId The ID of the engine to check.
+     * @return 1 when loaded, 0..1 while a reload is running, 0 when unloaded, -1 if not found.
+     */
+    float getEngineLoadProgress(const std::string& engineId) const;
+
     /**
      * @brief Removes and unloads an inference engine by its ID.
      * 
      * @param engineId The ID of the engine to remove.
      * @return True if the engine was removed successfully, false otherwise.
      */
-    bool removeEngine(const std::string& engineId);    /**
+    bool removeEngine(const std::string& engineId);
+
+    /**
+     * @brief Replaces the model behind an existing engine ID without downtime.
+     *
+     * The new model is loaded next to the current one; once it is ready new requests are
+     * routed to it while the old engine finishes its active jobs and is then freed.
+     *
+     * @param engineId The ID of the engine to swap.
+     * @param modelPath Path or URL of the new model.
+     * @param loadParams Loading parameters for the new model.
+     * @param mainGpuId The main GPU ID for the new model.
+     * @param engineType Inference engine for the new model; empty keeps the current one.
+     * @param drainTimeout How long to wait for the old engine's jobs before freeing it anyway.
+     * @return True if the new model is serving, false if it failed to load (the old one keeps serving).
+     */
+    bool swapEngine(const std::string& engineId, const char* modelPath, const LoadingParameters& loadParams,
+                    int mainGpuId, const std::string& engineType = "",
+                    std::chrono::seconds drainTimeout = std::chrono::seconds(300));
+
+    /**
      * @brief Lists the IDs of all currently managed engines.
      * 
      * @return A vector of strings containing the engine IDs.
      */
     std::vector<std::string> listEngineIds() const;
 
+    /**
+     * @brief Cataloged metadata of an engine's model file (architecture, context length, size),
+     * without touching the file. Empty for engines whose model is not a cataloged local file.
+     */
+    std::optional<ModelCatalog::ModelInfo> getModelInfo(const std::string& engineId) const;
+
     /**
      * @brief Gets the list of available model IDs (alias for listEngineIds for OpenAI compatibility).
      * 
@@ -191,6 +301,82 @@ public:
      */
     bool reconfigureEngines(const std::vector<InferenceEngineConfig>& engines);
 
+    /**
+     * @brief Stops engine changes made on the calling thread from being saved to the config file.
+     *
+     * Set while a reloaded config is applied: the file already describes the result, and
+     * rewriting it would drop the user's formatting and comments.
+     *
+     * @param suspend True to skip the writes, false to resume them
+     */
+    static void suspendConfigWrites(bool suspend);
+
+    /**
+     * @brief Records the startup state of a configured model.
+     *
+     * Startup models load in the background while the server already accepts
+     * requests; states are "pending", "loading", "ready", "registered" (lazy),
+     * "downloading" and "failed".
+     */
+    void setStartupState(const std::string& engineId, const std::string& state);
+
+    /**
+     * @brief Startup state of every configured model, keyed by model ID.
+     */
+    std::map<std::string, std::string> getStartupStates() const;
+
+    /**
+     * @brief Load and routing counters of one replica of a loaded engine.
+     */
+    struct ReplicaStats {
+        std::string engineId;
+        int index = 0;               // 0 is the primary engine
+        int mainGpuId = 0;
+        EngineLoad load;
+        uint64_t routedRequests = 0; // getEngine() calls dispatched to this replica
+        size_t liveJobs = 0;         // Jobs the engine holds, finished ones not yet released included
+        DecodeStats decode;          // Decode-loop counters, slot and KV usage
+        KvCacheStats kvCache;        // Host RAM and disk tiers of spilled conversations
+    };
+
+    /**
+     * @brief Per-replica load of every loaded engine, without triggering lazy loads.
+     * 
+     * @return One entry per replica, grouped by engine ID
+     */
+    std::vector<ReplicaStats> getReplicaStats() const;
+
+    /**
+     * @brief Recent decode steps of each replica of an engine, without triggering a lazy load.
+     * 
+     * @param engineId The engine ID
+     * @return One entry per replica, empty when the engine is unknown or not loaded
+     */
+    std::vector<std::vector<DecodeStepSample>> getStepProfiles(const std::string &engineId) const;
+
+    /**
+     * @brief Every replica of a loaded engine, without triggering a lazy load or counting a request.
+     * 
+     * @param engineId The engine ID
+     * @return The primary engine first, empty when the engine is unknown or not loaded
+     */
+    std::vector<std::shared_ptr<IInferenceEngine>> getLoadedReplicas(const std::string &engineId) const;
+
+    /**
+     * @brief Admission limits and rejection count of one engine.
+     */
+    struct AdmissionStats {
+        std::string engineId;
+        int maxQueuedJobs = 0;       // 0 = unlimited
+        int maxQueuedTokens = 0;     // 0 = unlimited
+        uint64_t rejectedRequests = 0;
+    };
+
+    /**
+     * @brief Admission limits and rejections of every registered engine.
+     */
+    std::vector<AdmissionStats> getAdmissionStats() const;
+
 private:
     /**
      * @brief Saves a model configuration to the config file
@@ -217,53 +403,138 @@ private:
 
     enum class ModelType {
         LLM,
-        EMBEDDING
+        EMBEDDING,
+        RERANK          // Cross-encoder on the embedding service
+    };
+
+    static const char* modelTypeName(ModelType type);
+
+    // Calls the IInferenceEngine load method matching the model type
+    static bool loadModelOfType(IInferenceEngine& engine, ModelType type, const std::string& modelPath,
+                                const LoadingParameters& loadParams, int mainGpuId);
+
+    // Shared by the embedding and rerank variants of addEngine / registerEngine
+    bool addEncoderEngine(const std::string& engineId, const char* modelPath, const LoadingParameters& loadParams, int mainGpuId, ModelType type);
+    bool registerEncoderEngine(const std::string& engineId, const char* modelPath, const LoadingParameters& loadParams, int mainGpuId, ModelType type);
+
+    // A model file held in host RAM while its engine hibernates (defined in node_manager.cpp)
+    struct WeightPin;
+
+    /**
+     * @brief What a request needs from a loaded engine: its replicas and the limits they
+     * are picked under. Never modified once published, so the request path reads it
+     * without engineMutex; a change of engine, replicas or parameters publishes a new one.
+     */
+    struct ServingSet {
+        ServingSet(std::vector<std::shared_ptr<IInferenceEngine>> replicaList, const LoadingParameters& params)
+            : engines(std::move(replicaList)), limits(params), routed(engines.size()) {}
+
+        std::vector<std::shared_ptr<IInferenceEngine>> engines; // `engine`, then the replicas
+        LoadingParameters limits;
+        mutable std::vector<std::atomic<uint64_t>> routed;       // Requests sent to each replica
     };
 
     struct EngineRecord {
+        using Ticks = std::chrono::steady_clock::rep;
+
         std::shared_ptr<IInferenceEngine> engine;
+        std::vector<std::shared_ptr<IInferenceEngine>> replicas; // Extra copies behind the same ID; `engine` is replica 0
+        std::shared_ptr<const ServingSet> serving;               // Null unless loaded; std::atomic_load / publishServing()
+        std::atomic<uint64_t> rejectedRequests{0};               // Turned away by admission control
         std::string modelPath;
         std::string engineType;  // "cpu", "cuda", "vulkan"
         LoadingParameters loadParams;
         int mainGpuId;
-        std::chrono::steady_clock::time_point lastActivityTime;
+        std::atomic<Ticks> lastActivityTicks;                    // Steady clock; see lastActivity() / touch()
         std::atomic<bool> isLoaded{false};
         std::atomic<bool> isLoading{false};
+        std::atomic<bool> isHibernated{false};     // Unloaded for inactivity with its weights kept in host RAM
+        std::shared_ptr<WeightPin> weightPin;      // Those weights while hibernating (guarded by engineMutex)
         std::atomic<bool> markedForRemoval{false};
         std::atomic<bool> isEmbeddingModel{false}; // Track if this is an embedding model
+        std::atomic<bool> isRerankModel{false};    // Reranker; isEmbeddingModel is set too
+        std::atomic<bool> isSwapping{false};       // A hot swap is loading the replacement model
+        IInferenceEngine* loadingEngine = nullptr; // Instance being reloaded, for progress (guarded by engineMutex)
         mutable std::mutex engineMutex;
         std::condition_variable loadingCv;
+
+        // Requests in the current and previous rate window; drive memory eviction (fewest
+        // requests first) and background preloading. Requests count into windowRequests
+        // without a lock; the windows roll over under engineMutex (requestRate())
+        std::atomic<uint32_t> windowRequests{0};
+        uint32_t prevWindowRequests = 0;
+        std::atomic<Ticks> windowStartTicks{0};
+        bool evictedForMemory = false;
         
-        EngineRecord() : engineType(getPlatformDefaultInferenceEngine()), mainGpuId(0), lastActivityTime(std::chrono::steady_clock::now()) {}
+        EngineRecord() : engineType(getPlatformDefaultInferenceEngine()), mainGpuId(0),
+                         lastActivityTicks(std::chrono::steady_clock::now().time_since_epoch().count()) {}
         
+        ModelType modelType() const {
+            return isRerankModel.load() ? ModelType::RERANK : isEmbeddingModel.load() ? ModelType::EMBEDDING : ModelType::LLM;
+        }
+
+        std::chrono::steady_clock::time_point lastActivity() const {
+            return std::chrono::steady_clock::time_point(std::chrono::steady_clock::duration(lastActivityTicks.load()));
+        }
+        void touch(std::chrono::steady_clock::time_point now) {
+            lastActivityTicks.store(now.time_since_epoch().count());
+        }
+        std::chrono::steady_clock::time_point windowStart() const {
+            return std::chrono::steady_clock::time_point(std::chrono::steady_clock::duration(windowStartTicks.load()));
+        }
+
         EngineRecord(const EngineRecord&) = delete;
         EngineRecord& operator=(const EngineRecord&) = delete;
         
         EngineRecord(EngineRecord&& other) noexcept 
             : engine(std::move(other.engine))
+            , replicas(std::move(other.replicas))
+            , serving(std::atomic_load(&other.serving))
+            , rejectedRequests(other.rejectedRequests.load())
             , modelPath(std::move(other.modelPath))
             , engineType(std::move(other.engineType))
             , loadParams(other.loadParams)
             , mainGpuId(other.mainGpuId)
-            , lastActivityTime(other.lastActivityTime)
+            , lastActivityTicks(other.lastActivityTicks.load())
             , isLoaded(other.isLoaded.load())
             , isLoading(other.isLoading.load())
+            , isHibernated(other.isHibernated.load())
+            , weightPin(std::move(other.weightPin))
             , markedForRemoval(other.markedForRemoval.load())
             , isEmbeddingModel(other.isEmbeddingModel.load())
+            , isRerankModel(other.isRerankModel.load())
+            , isSwapping(other.isSwapping.load())
+            , loadingEngine(other.loadingEngine)
+            , windowRequests(other.windowRequests.load())
+            , prevWindowRequests(other.prevWindowRequests)
+            , windowStartTicks(other.windowStartTicks.load())
+            , evictedForMemory(other.evictedForMemory)
         {}
         
         EngineRecord& operator=(EngineRecord&& other) noexcept {
             if (this != &other) {
                 engine = std::move(other.engine);
+                replicas = std::move(other.replicas);
+                std::atomic_store(&serving, std::atomic_load(&other.serving));
+                rejectedRequests.store(other.rejectedRequests.load());
                 modelPath = std::move(other.modelPath);
                 engineType = std::move(other.engineType);
                 loadParams = other.loadParams;
                 mainGpuId = other.mainGpuId;
-                lastActivityTime = other.lastActivityTime;
+                lastActivityTicks.store(other.lastActivityTicks.load());
                 isLoaded.store(other.isLoaded.load());
                 isLoading.store(other.isLoading.load());
+                isHibernated.store(other.isHibernated.load());
+                weightPin = std::move(other.weightPin);
                 markedForRemoval.store(other.markedForRemoval.load());
                 isEmbeddingModel.store(other.isEmbeddingModel.load());
+                isRerankModel.store(other.isRerankModel.load());
+                isSwapping.store(other.isSwapping.load());
+                loadingEngine = other.loadingEngine;
+                windowRequests.store(other.windowRequests.load());
+                prevWindowRequests = other.prevWindowRequests;
+                windowStartTicks.store(other.windowStartTicks.load());
+                evictedForMemory = other.evictedForMemory;
             }
             return *this;
         }
@@ -271,15 +542,28 @@ private:
 
 #pragma warning(push)
 #pragma warning(disable: 4251)
-    std::unordered_map<std::string, std::shared_ptr<EngineRecord>> engines_;
+    using EngineMap = std::unordered_map<std::string, std::shared_ptr<EngineRecord>>;
+    EngineMap engines_;
     mutable std::shared_mutex engineMapMutex_;
+    // Copy of engines_ republished after every change (publishEnginesLocked()), so request
+    // lookups (findEngine()) read it with std::atomic_load and never take engineMapMutex_
+    std::shared_ptr<const EngineMap> publishedEngines_ = std::make_shared<const EngineMap>();
+
+    std::map<std::string, std::string> startupStates_;
+    mutable std::mutex startupMutex_;
+
+    std::map<std::string, std::vector<std::string>> modelAliases_;
+    mutable std::shared_mutex aliasMutex_;
 
     // Dynamic inference loader for plugin management
     std::unique_ptr<InferenceLoader> inferenceLoader_;
 
     std::thread autoscalingThread_;
     std::atomic<bool> stopAutoscaling_{false};
+    std::thread preloadThread_;
+    std::atomic<bool> preloadRunning_{false};
     std::condition_variable autoscalingCv_;
+    std::atomic<uint64_t> hibernatedBytes_{0}; // Model files held in host RAM by hibernating engines
 #pragma warning(pop)
     mutable std::mutex autoscalingMutex_;
 #pragma warning(push)
@@ -287,6 +571,103 @@ private:
     std::chrono::seconds idleTimeout_;
 #pragma warning(pop)
 
+    /**
+     * @brief Loading parameters and GPU of one replica.
+     * GPU replicas each run whole on their own device (main GPU + index, no split).
+     */
+    static LoadingParameters replicaLoadParams(const LoadingParameters& loadParams, const std::string& engineType);
+    static int replicaGpuId(int mainGpuId, const std::string& engineType, int index);
+
+    /**
+     * @brief Creates and loads replicas 1..n_replicas-1 of an engine.
+     * Replicas that fail to load are skipped with a warning.
+     */
+    std::vector<std::shared_ptr<IInferenceEngine>> loadReplicas(const std::string& engineId, const std::string& modelPath,
+                                                                const std::string& engineType, const LoadingParameters& loadParams,
+                                                                int mainGpuId, ModelType type);
+
+    /**
+     * @brief Unloads the extra replicas of an engine (engineMutex held).
+     */
+    static void unloadReplicas(const std::string& engineId, EngineRecord& record);
+
+    /**
+     * @brief Picks the replica of a serving set for the next request; needs no lock.
+     * Prefers replicas with a free slot, then the fewest pending tokens. With an
+     * admission, returns nullptr if even that replica is over its queue limits.
+     */
+    static std::shared_ptr<IInferenceEngine> pickReplica(EngineRecord& record, const ServingSet& serving,
+                                                         Admission* admission = nullptr);
+
+    /**
+     * @brief Republishes the serving set of a record from its engine, replicas and loading
+     * parameters (engineMutex held, or the record not yet shared). Null unless loaded.
+     */
+    static void publishServing(EngineRecord& record);
+
+    /**
+     * @brief Takes an idle engine off the request path before it is unloaded (engineMutex held).
+     * Returns false, leaving it published, if a request arrived after quietSince meanwhile.
+     */
+    static bool withdrawServing(EngineRecord& record, std::chrono::steady_clock::time_point quietSince);
+
+    /**
+     * @brief Republishes engines_ for findEngine() (engineMapMutex_ held exclusively).
+     */
+    void publishEnginesLocked();
+
+    /**
+     * @brief Record of an engine from the published map, without locking; null if unknown.
+     */
+    std::shared_ptr<EngineRecord> findEngine(const std::string& engineId) const;
+
+    /**
+     * @brief getEngine() implementation; preloads pass countRequest = false so they
+     * do not show up as traffic or in the replica routing counters.
+     */
+    std::shared_ptr<IInferenceEngine> acquireEngine(const std::string& engineId, bool countRequest,
+                                                    Admission* admission = nullptr);
+
+    /**
+     * @brief Engines to try for a request: engineId itself, or for an alias the variants
+     * whose context holds contextTokens, smallest first, else the largest variant alone.
+     */
+    std::vector<std::string> routeCandidates(const std::string& engineId, int contextTokens) const;
+
+    /**
+     * @brief Rolls the rate windows forward and returns requests per window.
+     */
+    static double requestRate(EngineRecord& record, std::chrono::steady_clock::time_point now);
+
+    /**
+     * @brief Estimated memory held by a loaded engine (weights of every replica).
+     */
+    static uint64_t estimatedFootprint(const EngineRecord& record);
+
+    /**
+     * @brief Unloads an idle engine (engineMutex held). With hibernate_memory_mb, its model
+     * file is kept in host RAM so the next reload does not read it from disk.
+     */
+    void hibernateEngine(const std::string& engineId, EngineRecord& record);
+
+    /**
+     * @brief Lets go of the weights a hibernating engine holds in host RAM (engineMutex held).
+     */
+    void endHibernation(EngineRecord& record);
+
+    /**
+     * @brief Evicts idle, least requested engines while over the memory budget or
+     * short of free system memory. Hibernating engines give up their host RAM first.
+     */
+    void enforceMemoryBudget(const std::vector<std::pair<std::string, std::shared_ptr<EngineRecord>>>& snapshot,
+                             std::chrono::steady_clock::time_point now);
+
+    /**
+     * @brief Starts a background reload of the busiest evicted engine that fits the budget.
+     */
+    void schedulePreload(const std::vector<std::pair<std::string, std::shared_ptr<EngineRecord>>>& snapshot,
+                         std::chrono::steady_clock::time_point now);
+
     /**
      * @brief The main loop for the autoscaling thread.
      * Periodically checks for idle engines and unloads them.
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "export.hpp"
+#include <chrono>
 #include <string>
 #include <vector>
 #include <unordered_map>
@@ -46,6 +47,14 @@ struct QdrantResult
  * 
  * This client provides thread-safe, async operations for interacting with Qdrant
  * vector database. All operations return futures for non-blocking execution.
+ * Requests are multiplexed by one curl_multi handle: up to maxConnections run
+ * concurrently over pooled keep-alive connections, and the rest wait in order.
+ *
+ * With hedge on, a search still unanswered after the p95 latency of recent searches is
+ * sent again to the next of the replicas (or to host again when there are none) while a
+ * connection is free; the first answer completes it and the other transfer is dropped.
+ * Searches with a deadline fail with status 504 once it passes instead of waiting out
+ * the timeout.
  */
 class KOLOSAL_SERVER_API QdrantClient
 {
@@ -59,9 +68,13 @@ public:
         int port = 6333;
         std::string apiKey = "";
         int timeout = 30;
-        int maxConnections = 10;
+        int maxConnections = 10;       // Requests in flight at once, each on its own kept-alive connection
         int connectionTimeout = 5;
         bool useHttps = false;
+        bool http2 = false;            // Multiplex requests over HTTP/2 (h2c with prior knowledge without TLS)
+        std::vector<std::string> replicas; // Other nodes serving the same collections, "host:port" or a URL
+        bool hedge = false;            // Send slow searches a second time, see above
+        int hedgeMinDelayMs = 10;      // Never hedge a search sooner than this
     };
     
     /**
@@ -148,26 +161,61 @@ public:
      * @param query_vector Vector to search for
      * @param limit Maximum number of results
      * @param score_threshold Minimum score threshold
+     * @param hnsw_ef HNSW candidate list size for this query (0 = collection default)
+     * @param filter Qdrant payload filter (null = none)
+     * @param payload_fields Payload keys returned with each hit (empty = all)
+     * @param deadline Fail with status 504 if unanswered by then (default = no deadline)
      * @return Future with search results
      */
     std::future<QdrantResult> search(
         const std::string& collection_name,
         const std::vector<float>& query_vector,
         int limit = 10,
-        float score_threshold = 0.0f
+        float score_threshold = 0.0f,
+        int hnsw_ef = 0,
+        const nlohmann::json& filter = nullptr,
+        const std::vector<std::string>& payload_fields = {},
+        std::chrono::steady_clock::time_point deadline = {}
+    );
+    
+    /**
+     * @brief Search for several query vectors in one /points/search/batch request
+     * @param collection_name Name of the collection
+     * @param query_vectors Vectors to search for
+     * @param limit Maximum number of results per query
+     * @param score_threshold Minimum score threshold
+     * @param hnsw_ef HNSW candidate list size for every query (0 = collection default)
+     * @param filter Qdrant payload filter applied to every query (null = none)
+     * @param payload_fields Payload keys returned with each hit (empty = all)
+     * @param deadline Fail with status 504 if unanswered by then (default = no deadline)
+     * @return Future with one result list per query, in query order
+     */
+    std::future<QdrantResult> searchBatch(
+        const std::string& collection_name,
+        const std::vector<std::vector<float>>& query_vectors,
+        int limit = 10,
+        float score_threshold = 0.0f,
+        int hnsw_ef = 0,
+        const nlohmann::json& filter = nullptr,
+        const std::vector<std::string>& payload_fields = {},
+        std::chrono::steady_clock::time_point deadline = {}
     );
     
     /**
      * @brief Scroll through all points in a collection (for listing)
      * @param collection_name Name of the collection
      * @param limit Maximum number of points to retrieve per request
-     * @param offset Offset for pagination
+     * @param offset Cursor returned as next_page_offset by the previous page ("" = first page)
+     * @param with_payload Include each point's payload; listings of ids leave it out
+     * @param filter Payload filter in Qdrant syntax; null walks every point
      * @return Future with points data
      */
     std::future<QdrantResult> scrollPoints(
         const std::string& collection_name,
         int limit = 1000,
-        const std::string& offset = ""
+        const std::string& offset = "",
+        bool with_payload = true,
+        const nlohmann::json& filter = nullptr
     );
 
 private:
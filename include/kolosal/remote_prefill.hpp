@@ -0,0 +1,90 @@
+#pragma once
+
+#include "export.hpp"
+#include "server_config.hpp"
+#include "inference_interface.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace kolosal
+{
+
+/**
+ * @brief Client side of disaggregated prefill, used by decode nodes
+ *
+ * A completion whose prompt is long enough is sent to a prefill node
+ * (POST /v1/internal/prefill with the original request body), which decodes
+ * the prompt and answers with the sequence's KV state. The decode node then
+ * submits the job with CompletionParameters::kvState and only decodes the
+ * last prompt token, so long prompts never take decode steps away from the
+ * generations running here. Any failure falls back to a local prefill.
+ *
+ * The state travels as application/octet-stream in the layout of encode():
+ * "KVS1", the token count (uint32), the tokens (int32) and the raw state.
+ * Numbers are in host byte order; prefill and decode nodes must share the
+ * architecture and load the same model file.
+ *
+ * Thread-safe.
+ */
+class KOLOSAL_SERVER_API RemotePrefill
+{
+public:
+    struct Stats
+    {
+        uint64_t transfers = 0;         // States received and handed to the engine
+        uint64_t failures = 0;          // Prefills that failed; decoded locally instead
+        uint64_t bytes = 0;             // State bytes received
+    };
+
+    static RemotePrefill& instance();
+
+    void configure(const DisaggregationConfig& config);
+
+    /**
+     * @brief True on a decode node; prefill nodes and combined nodes decode their own prompts
+     */
+    bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief KV state of a request's prompt computed by a prefill node
+     * @param body The request as the client sent it
+     * @param promptTokens Estimated prompt length; shorter than min_prompt_tokens is decoded locally
+     * @return The state, or nullptr to decode the prompt locally
+     */
+    std::shared_ptr<const KvSequenceState> fetch(const std::string& body, size_t promptTokens);
+
+    static std::string encode(const KvSequenceState& state);
+
+    /**
+     * @brief Parse encode()'s layout; @p data is consumed so the state is not copied
+     */
+    static std::shared_ptr<KvSequenceState> decode(std::vector<uint8_t>& data);
+
+    Stats stats() const;
+
+private:
+    RemotePrefill() = default;
+    RemotePrefill(const RemotePrefill&) = delete;
+    RemotePrefill& operator=(const RemotePrefill&) = delete;
+
+    std::atomic<bool> enabled_{false};
+
+#pragma warning(push)
+#pragma warning(disable: 4251)
+    mutable std::mutex mutex_;
+    DisaggregationConfig config_;
+    std::vector<std::chrono::steady_clock::time_point> down_until_;    // Per prefill node
+    size_t next_ = 0;
+#pragma warning(pop)
+
+    std::atomic<uint64_t> transfers_{0};
+    std::atomic<uint64_t> failures_{0};
+    std::atomic<uint64_t> bytes_{0};
+};
+
+} // namespace kolosal
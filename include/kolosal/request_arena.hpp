@@ -0,0 +1,50 @@
+#pragma once
+
+#include "export.hpp"
+
+#include <cstddef>
+#include <memory_resource>
+
+namespace kolosal {
+
+    /**
+     * @brief Request-lifetime memory for the thread handling a request.
+     *
+     * While a Scope is open, resource() is a monotonic arena: allocations are
+     * bumps into a buffer the thread keeps between requests, deallocation is a
+     * no-op, and everything goes away at once when the Scope closes. The buffer
+     * is sized from the largest request the thread has served (up to a cap),
+     * so a steady workload stops allocating for it after warm-up; a request
+     * that needs more spills to the heap for the rest of its lifetime.
+     *
+     * Outside a Scope, resource() is the default new/delete resource, so code
+     * that uses it also works off the request path. Memory taken from it must
+     * not outlive the request: nothing may keep it past the handler's return.
+     *
+     * Scopes nest (the inner one is a no-op). When metrics are enabled, each
+     * outermost Scope reports the bytes it used and whether it overflowed.
+     */
+    class KOLOSAL_SERVER_API RequestArena {
+    public:
+        class KOLOSAL_SERVER_API Scope {
+        public:
+            Scope();
+            ~Scope();
+
+            Scope(const Scope&) = delete;
+            Scope& operator=(const Scope&) = delete;
+
+        private:
+            bool outermost_;
+        };
+
+        static std::pmr::memory_resource* resource();
+
+        // Bytes handed out by the current Scope so far, 0 outside one
+        static size_t used();
+
+        // Largest buffer kept between requests; bigger requests overflow to the heap
+        static constexpr size_t kMaxRetainedBytes = 1 << 20;
+    };
+
+} // namespace kolosal
@@ -0,0 +1,109 @@
+#pragma once
+
+#include "export.hpp"
+#include "http_compression.hpp"
+
+#include <cstdio>
+#include <istream>
+#include <memory>
+#include <string>
+
+#ifdef _WIN32
+#include <winsock2.h>
+using SocketType = SOCKET;
+#else
+#include <sys/socket.h>
+#include <unistd.h>
+using SocketType = int;
+#endif
+
+namespace kolosal {
+
+    /**
+     * @brief Request body that is still arriving while the handler runs.
+     *
+     * Large uploads (see ServerOptions::streamBodyBytes) to routes that opt in
+     * through IRoute::streamsBody() are dispatched as soon as their headers are
+     * in. The handler then pulls the body from the socket, either in chunks
+     * (read(), or stream() for parsers that take a std::istream) or by having
+     * it written to a temporary file (spillToFile()) first. Either way the
+     * server never holds the whole body in memory, and parsing can start
+     * before the upload finishes.
+     *
+     * A body sent with Content-Encoding gzip or deflate is inflated as it is
+     * read (see decode()), so the handler sees the plain bytes while only the
+     * compressed ones cross the socket.
+     *
+     * Not thread-safe; it belongs to the thread handling the request.
+     */
+    class KOLOSAL_SERVER_API RequestBody {
+    public:
+        // prefix: body bytes that arrived together with the headers;
+        // length: the request's Content-Length
+        RequestBody(SocketType sock, std::string prefix, size_t length);
+        ~RequestBody();    // Removes the spill file, if any
+
+        RequestBody(const RequestBody&) = delete;
+        RequestBody& operator=(const RequestBody&) = delete;
+
+        // Bytes on the wire: the compressed size when decoding
+        size_t size() const { return length_; }
+        size_t consumed() const { return inflater_ ? received_ : consumed_; }
+
+        // Inflate the body as it is read, failing once more than maxDecoded bytes
+        // (0 = unlimited) came out. Must be called before anything is read.
+        void decode(http_internal::ContentCoding coding, size_t maxDecoded);
+
+        // False once the client stopped sending (closed or timed out) before the body was
+        // complete, or a compressed body turned out corrupt or too large
+        bool ok() const { return !failed_; }
+
+        // Why the body could not be read, and the status to answer with (413 for a
+        // decompressed body over the limit, 400 otherwise)
+        std::string error() const;
+        int errorStatus() const { return tooLarge_ ? 413 : 400; }
+
+        // Copy up to max bytes into dst; returns 0 at the end of the body or on failure
+        size_t read(char* dst, size_t max);
+
+        // Remaining body as a stream, e.g. for nlohmann::json::parse
+        std::istream& stream();
+
+        // Receive the rest of the body into a temporary file that later reads come from.
+        // Must be called before anything is read. Returns the path, or "" on failure.
+        const std::string& spillToFile();
+        const std::string& filePath() const { return filePath_; }
+
+        // Read and drop what the handler left unread so the connection can serve its
+        // next request. Gives up (returns false) if more than limit bytes are left.
+        bool discardRemaining(size_t limit);
+
+    private:
+        class StreamBuf;
+        class Inflater;
+
+        size_t receive(char* dst, size_t max);
+        size_t inflate(char* dst, size_t max);
+
+        SocketType sock_;
+        size_t length_;
+        size_t consumed_ = 0;
+        size_t received_ = 0;     // Bytes taken from the socket (prefix included)
+        bool failed_ = false;
+        bool corrupt_ = false;
+        bool tooLarge_ = false;
+        size_t maxDecoded_ = 0;
+        size_t fileSize_ = 0;     // Bytes in the spill file
+#pragma warning(push)
+#pragma warning(disable: 4251)
+        std::string prefix_;
+        size_t prefixPos_ = 0;
+        std::string filePath_;
+        std::FILE* file_ = nullptr;
+        std::unique_ptr<Inflater> inflater_;
+        std::unique_ptr<StreamBuf> streamBuf_;
+        std::unique_ptr<std::istream> stream_;
+#pragma warning(pop)
+    };
+
+} // namespace kolosal
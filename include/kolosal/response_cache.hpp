@@ -0,0 +1,125 @@
+#pragma once
+
+#include "export.hpp"
+#include "server_config.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace kolosal
+{
+
+/**
+ * @brief Process-wide cache of deterministic completion responses
+ *
+ * Used by the OpenAI-compatible completion routes for requests whose output is
+ * fixed by their inputs: greedy sampling (temperature 0) or an explicit seed.
+ * Entries are keyed by the model id and a canonical serialization of
+ * everything that shapes the output (prompt or messages, sampling parameters,
+ * grammar and schema, stop sequences, candidate count, adapter), built by the
+ * caller. A hit is answered without touching the engine; streamed responses
+ * keep their pieces so a hit can be replayed chunk by chunk.
+ *
+ * Entries expire after a TTL and the whole cache is an LRU bounded by bytes.
+ * Swapping or removing a model invalidates its entries, and a response that
+ * was generated by the model being replaced is not stored.
+ *
+ * Thread-safe.
+ */
+class KOLOSAL_SERVER_API ResponseCache
+{
+public:
+    struct Response
+    {
+        // Output of each choice in order, as the pieces it was streamed in (one piece if it was not)
+        std::vector<std::vector<std::string>> choices;
+        int prompt_tokens = 0;
+        int completion_tokens = 0;  // Across every candidate generated, as billed originally
+    };
+
+    struct Stats
+    {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;     // Dropped to stay within budget
+        uint64_t expirations = 0;   // Found past their TTL
+        size_t entries = 0;
+        size_t bytes = 0;
+    };
+
+    static ResponseCache& instance();
+
+    /**
+     * @brief Apply the configuration and drop every entry
+     */
+    void configure(const ResponseCacheConfig& config);
+
+    bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Generation of a model's entries; read before generating and pass it to put()
+     */
+    uint64_t generation(const std::string& model_id) const;
+
+    /**
+     * @brief Cached response to a request, or nullptr on a miss
+     */
+    std::shared_ptr<const Response> get(const std::string& model_id, const std::string& request);
+
+    /**
+     * @brief Remember a response; ignored if the model was invalidated since @p generation or the entry is too large
+     */
+    void put(const std::string& model_id, const std::string& request, uint64_t generation, Response response);
+
+    /**
+     * @brief Drop a model's entries, called when the engine behind the id changes or goes away
+     */
+    void invalidateModel(const std::string& model_id);
+
+    Stats stats() const;
+
+private:
+    struct Entry
+    {
+        std::string key;
+        std::string model_id;
+        std::shared_ptr<const Response> response;
+        std::chrono::steady_clock::time_point expires;
+        size_t bytes = 0;
+    };
+
+    ResponseCache() = default;
+    ResponseCache(const ResponseCache&) = delete;
+    ResponseCache& operator=(const ResponseCache&) = delete;
+
+    static std::string makeKey(const std::string& model_id, const std::string& request);
+    void eraseLocked(std::list<Entry>::iterator it);
+
+    std::atomic<bool> enabled_{false};
+
+#pragma warning(push)
+#pragma warning(disable: 4251)
+    mutable std::mutex mutex_;
+    std::list<Entry> lru_;              // Most recently used first
+    std::unordered_map<std::string, std::list<Entry>::iterator> entries_;
+    std::unordered_map<std::string, uint64_t> generations_;
+    uint64_t next_generation_ = 0;
+    size_t bytes_ = 0;
+    size_t memory_limit_ = 128ULL * 1024 * 1024;
+    size_t entry_limit_ = 256ULL * 1024;
+    std::chrono::seconds ttl_{600};
+#pragma warning(pop)
+
+    std::atomic<uint64_t> hits_{0};
+    std::atomic<uint64_t> misses_{0};
+    std::atomic<uint64_t> evictions_{0};
+    std::atomic<uint64_t> expirations_{0};
+};
+
+} // namespace kolosal
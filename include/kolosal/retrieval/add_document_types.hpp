@@ -2,6 +2,9 @@
 
 #include "../export.hpp"
 #include <json.hpp>
+#include <chrono>
+#include <cstdint>
+#include <istream>
 #include <string>
 #include <vector>
 #include <unordered_map>
@@ -50,6 +53,12 @@ struct KOLOSAL_SERVER_API AddDocumentsRequest
 {
     std::vector<Document> documents;
     std::string collection_name = "documents"; // Always set to "documents"
+    bool async = false; // Run as a background job; the endpoint answers 202 with a job ID
+    // "update": documents are chunks of the sources named by metadata[source_field]. Chunks whose
+    // text and metadata are already stored for that source are kept as they are, only new or
+    // changed ones are embedded, and stored chunks the request no longer has are deleted
+    std::string mode = "add";
+    std::string source_field = "source";
     
     /**
      * @brief Populates request from JSON
@@ -57,6 +66,20 @@ struct KOLOSAL_SERVER_API AddDocumentsRequest
      */
     void from_json(const nlohmann::json& j);
     
+    /**
+     * @brief Populates request from the JSON text without building a DOM
+     * 
+     * Equivalent to from_json(json::parse(body)), but document texts are moved
+     * into the request as the parser produces them, so a large upload is held
+     * once rather than as text, DOM and copies.
+     * 
+     * @param body Request body, complete or still arriving
+     * @throws nlohmann::json::parse_error if the body is not valid JSON
+     * @throws std::runtime_error if a field is missing or has the wrong type
+     */
+    void parse(const std::string& body);
+    void parse(std::istream& body);
+    
     /**
      * @brief Validates the request
      * @return true if valid, false otherwise
@@ -73,6 +96,8 @@ struct DocumentResult
 {
     std::string id;
     bool success = false;
+    bool unchanged = false; // Update mode: the stored chunk was kept, nothing was embedded
+    bool duplicate = false; // Near-duplicate of the stored chunk in id; nothing was embedded or stored
     std::string error = "";
     
     /**
@@ -94,6 +119,11 @@ struct KOLOSAL_SERVER_API AddDocumentsResponse
     int successful_count = 0;
     int failed_count = 0;
     std::string collection_name;
+    bool update = false;        // Answer to an update; adds the counts below
+    int unchanged_count = 0;    // Chunks already stored, counted in successful_count too
+    int removed_count = 0;      // Stored chunks of the updated sources that were deleted
+    bool dedup = false;         // Near-duplicate detection ran; adds duplicate_count
+    int duplicate_count = 0;    // Documents skipped as near-duplicates, counted in successful_count too
     
     /**
      * @brief Adds a successful document result
@@ -101,6 +131,18 @@ struct KOLOSAL_SERVER_API AddDocumentsResponse
      */
     void addSuccess(const std::string& document_id);
     
+    /**
+     * @brief Adds the result of a chunk an update found already stored
+     * @param document_id ID of the stored chunk
+     */
+    void addUnchanged(const std::string& document_id);
+    
+    /**
+     * @brief Adds the result of a document skipped as a near-duplicate
+     * @param document_id ID of the stored chunk it duplicates
+     */
+    void addDuplicate(const std::string& document_id);
+    
     /**
      * @brief Adds a failed document result
      * @param error Error message
@@ -120,6 +162,94 @@ struct KOLOSAL_SERVER_API AddDocumentsResponse
     bool validate() const;
 };
 
+/**
+ * @brief Progress of an asynchronous add_documents job
+ * 
+ * Counters advance as each batch leaves the pipeline, so a poll shows how far
+ * the job got even if it is later cancelled. Per-document results are filled
+ * in once the job has finished.
+ */
+struct KOLOSAL_SERVER_API IngestionJobStatus
+{
+    std::string job_id;
+    std::string status = "queued";  // queued, running, completed, cancelled or failed
+    size_t total = 0;
+    size_t processed = 0;  // Documents indexed or failed so far
+    size_t succeeded = 0;
+    size_t failed = 0;
+    std::string error;
+    std::chrono::system_clock::time_point created_at;
+    std::chrono::system_clock::time_point started_at;
+    std::chrono::system_clock::time_point finished_at;
+    AddDocumentsResponse response;  // Per-document results, in request order
+    
+    /**
+     * @brief Whether the job has stopped for good
+     */
+    bool finished() const;
+    
+    /**
+     * @brief Converts the status to JSON
+     * @param include_results Add the per-document results of a finished job
+     * @return JSON representation
+     */
+    nlohmann::json to_json(bool include_results = true) const;
+};
+
+/**
+ * @brief Documents that bring their own vectors, one frame of an /import_vectors body
+ */
+struct KOLOSAL_SERVER_API VectorImportBatch
+{
+    std::vector<std::string> ids;   // One per document; "" gets a generated ID
+    std::vector<Document> documents;
+    std::vector<float> vectors;     // Row-major, dimensions floats per document
+    size_t dimensions = 0;
+};
+
+/**
+ * @brief Reads the frames of an /import_vectors body
+ * 
+ * The body is a sequence of frames, each one batch: a little-endian uint32 row
+ * count and uint32 payload length, that many bytes of NDJSON with one
+ * {"id", "text", "metadata"} object per row ("id" optional), then the row-major
+ * rows x dimensions matrix of little-endian fp32 or fp16 values. The matrix is
+ * read straight into the batch; no vector goes through JSON.
+ */
+class KOLOSAL_SERVER_API VectorImportReader
+{
+public:
+    static constexpr uint32_t kMaxRows = 65536;
+    static constexpr uint32_t kMaxPayloadBytes = 256u << 20;
+    static constexpr size_t kMaxDimensions = 65536;
+    
+    /**
+     * @param body Request body, complete or still arriving
+     * @param dtype "f32" or "f16"
+     * @throws std::invalid_argument for an unknown dtype or dimensions out of range
+     */
+    VectorImportReader(std::istream& body, size_t dimensions, const std::string& dtype);
+    
+    /**
+     * @brief Reads the next frame into batch
+     * @return False at the end of the body
+     * @throws std::runtime_error for a truncated or malformed frame
+     */
+    bool next(VectorImportBatch& batch);
+    
+    /**
+     * @brief Rows read so far, in all frames
+     */
+    size_t rows() const { return rows_; }
+    
+private:
+    std::istream& body_;
+    size_t dimensions_;
+    bool half_;
+    size_t rows_ = 0;
+    std::vector<uint16_t> halves_;  // fp16 matrix before it is widened
+};
+
 /**
  * @brief Error response data type for add_documents endpoint
  * 
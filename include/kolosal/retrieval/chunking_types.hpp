@@ -1,11 +1,12 @@
 #ifndef KOLOSAL_CHUNKING_TYPES_HPP
 #define KOLOSAL_CHUNKING_TYPES_HPP
 
+#include <cstddef>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <memory>
 #include <future>
-#include <mutex>
 
 namespace kolosal
 {
@@ -16,6 +17,30 @@ class InferenceEngine;
 namespace retrieval
 {
 
+/**
+ * @brief A word of the source text, as a byte range
+ */
+struct TokenSpan
+{
+    size_t offset = 0;
+    size_t length = 0;
+};
+
+/**
+ * @brief A chunk as a range of tokens and the source bytes they cover
+ *
+ * Chunks reference the original text instead of owning copies, so
+ * overlapping windows share their tokens; materializeChunk builds the
+ * chunk string when one is needed.
+ */
+struct ChunkSpan
+{
+    size_t first_token = 0;     // Inclusive
+    size_t last_token = 0;      // Exclusive
+    size_t begin = 0;           // Byte offset of the first token
+    size_t end = 0;             // Byte offset just past the last token
+};
+
 /**
  * @brief Service for text chunking operations
  * 
@@ -38,6 +63,23 @@ public:
     /**
      * @brief Generates base chunks from text using sliding window approach
      * 
+     * Works on token spans into the text, so the only allocations are the
+     * span vector and the returned chunk strings.
+     * 
+     * @param text Input text to chunk
+     * @param chunk_size Number of words per chunk
+     * @param overlap Number of words to overlap between chunks
+     * @return Vector of text chunks
+     */
+    std::vector<std::string> generateBaseChunks(
+        const std::string& text,
+        int chunk_size,
+        int overlap
+    ) const;
+
+    /**
+     * @brief Generates base chunks from pre-tokenized text
+     * 
      * @param text Input text to chunk
      * @param tokens Vector of tokens from the text
      * @param chunk_size Number of tokens per chunk
@@ -51,6 +93,34 @@ public:
         int overlap
     ) const;
 
+    /**
+     * @brief Computes the sliding-window chunk ranges over a token span list
+     * 
+     * @param tokens Token spans, usually from splitWordSpans
+     * @param chunk_size Number of tokens per chunk
+     * @param overlap Number of tokens to overlap between chunks
+     * @return Chunk ranges in order
+     */
+    std::vector<ChunkSpan> generateChunkSpans(
+        const std::vector<TokenSpan>& tokens,
+        int chunk_size,
+        int overlap
+    ) const;
+
+    /**
+     * @brief Builds the text of a chunk, joining its tokens with single spaces
+     * 
+     * @param text Source text the spans point into
+     * @param tokens Token spans of the text
+     * @param chunk Chunk range to materialize
+     * @return Chunk text
+     */
+    static std::string materializeChunk(
+        std::string_view text,
+        const std::vector<TokenSpan>& tokens,
+        const ChunkSpan& chunk
+    );
+
     /**
      * @brief Performs semantic chunking using embeddings
      * 
@@ -95,6 +165,21 @@ public:
         const std::string& model_name
     );
 
+    /**
+     * @brief Computes embeddings for several texts in one engine submission
+     * 
+     * Cached texts are skipped; the rest go to the engine as a single batch,
+     * and any input the batch fails on is retried through computeEmbedding.
+     * 
+     * @param texts Texts to embed
+     * @param model_name Name of the embedding model
+     * @return Future containing one embedding per text, in order
+     */
+    std::future<std::vector<std::vector<float>>> computeEmbeddings(
+        const std::vector<std::string>& texts,
+        const std::string& model_name
+    );
+
     /**
      * @brief Computes cosine similarity between two embedding vectors
      * 
@@ -112,6 +197,18 @@ public:
      */
     static int estimateTokenCount(const std::string& text);
 
+    /**
+     * @brief Counts tokens with the model's own tokenizer
+     * 
+     * Runs against the engine's vocabulary without taking a decode slot, and
+     * falls back to estimateTokenCount when no model is named or loaded.
+     * 
+     * @param texts Texts to count
+     * @param model_name Model whose tokenizer to use
+     * @return One count per text, in order
+     */
+    std::vector<int> countTokens(const std::vector<std::string>& texts, const std::string& model_name) const;
+
     /**
      * @brief Reconstructs text from tokens
      * 
@@ -120,13 +217,30 @@ public:
      */
     static std::string reconstructText(const std::vector<std::string>& tokens);
 
+    /**
+     * @brief Splits text into whitespace-separated words
+     * 
+     * Shared by chunking and the lexical index so that chunk boundaries and
+     * keyword terms agree on what a word is.
+     * 
+     * @param text Input text
+     * @return Words in order of appearance
+     */
+    static std::vector<std::string> splitWords(const std::string& text);
+
+    /**
+     * @brief Locates whitespace-separated words without copying them
+     * 
+     * Same boundaries as splitWords.
+     * 
+     * @param text Input text
+     * @return Byte ranges of the words in order of appearance
+     */
+    static std::vector<TokenSpan> splitWordSpans(std::string_view text);
+
 private:
     // Internal helper methods
     void validateChunkingParameters(int chunk_size, int overlap, int max_tokens, float similarity_threshold) const;
-    std::vector<std::string> extractTokenSubset(const std::vector<std::string>& tokens, int start, int end) const;
-    
-    // Mutex for serializing embedding requests
-    mutable std::mutex embedding_mutex_;
 };
 
 } // namespace retrieval
@@ -19,8 +19,10 @@ namespace retrieval
 struct KOLOSAL_SERVER_API ListDocumentsResponse
 {
     std::vector<std::string> document_ids;
-    int total_count = 0;
+    int total_count = 0;            // IDs in this response
     std::string collection_name;
+    bool paged = false;             // Answer to a limit/cursor request; adds next_cursor
+    std::string next_cursor;        // Cursor of the next page, empty after the last
     
     /**
      * @brief Converts response to JSON
@@ -6,6 +6,9 @@
 #include "remove_document_types.hpp"
 #include "../qdrant_client.hpp"
 #include "../server_config.hpp"
+#include <cstdint>
+#include <functional>
+#include <istream>
 #include <memory>
 #include <future>
 #include <string>
@@ -19,6 +22,26 @@ namespace kolosal
 namespace retrieval
 {
 
+/**
+ * @brief One page of a document listing
+ */
+struct DocumentPage
+{
+    std::vector<std::string> ids;
+    std::string next_cursor;    // Pass to the next listDocumentsPage call; empty after the last page
+};
+
+/**
+ * @brief Outcome of a replication call
+ */
+struct ReplicationResult
+{
+    bool success = false;
+    int status = 200;           // HTTP status to answer with
+    std::string error;
+    nlohmann::json info;        // Epoch and change stream position, and what else the call reports
+};
+
 /**
  * @brief Service for managing document operations
  * 
@@ -47,6 +70,11 @@ public:
     DocumentService(DocumentService&&) noexcept;
     DocumentService& operator=(DocumentService&&) noexcept;
     
+    /**
+     * @brief The server config's database section, with Qdrant defaults filled in where unset
+     */
+    static DatabaseConfig serverDatabaseConfig();
+
     /**
      * @brief Initialize the service (test connections, create collections)
      * @return Future with result of initialization
@@ -55,10 +83,50 @@ public:
     
     /**
      * @brief Add documents to the vector database
-     * @param request Documents to add
+     * @param request Documents to add; pass an rvalue to hand the texts over without a copy
      * @return Future with response containing results
      */
-    std::future<AddDocumentsResponse> addDocuments(const AddDocumentsRequest& request);
+    std::future<AddDocumentsResponse> addDocuments(AddDocumentsRequest request);
+    
+    /**
+     * @brief Store documents whose vectors were computed elsewhere, without embedding them
+     * 
+     * The batch is written with one upsert; the keyword and near-duplicate indexes
+     * learn its texts as they do for addDocuments.
+     * @param batch Documents and their vectors; pass an rvalue to hand them over without a copy
+     * @return Future with per-document results, in batch order
+     */
+    std::future<AddDocumentsResponse> importVectors(VectorImportBatch batch);
+    
+    /**
+     * @brief Queue documents for ingestion in the background
+     * 
+     * Jobs run one at a time through the same pipeline as addDocuments, and
+     * hold each embedding batch back briefly while the embedding model is
+     * serving other requests.
+     * @param request Documents to add; pass an rvalue to hand the texts over without a copy
+     * @return ID of the job
+     */
+    std::string submitAddDocumentsJob(AddDocumentsRequest request);
+    
+    /**
+     * @brief Current state of an ingestion job
+     * @param job_id ID returned by submitAddDocumentsJob
+     * @return Status, or nullopt if the job is unknown or has been pruned
+     */
+    std::optional<IngestionJobStatus> getIngestionJob(const std::string& job_id) const;
+    
+    /**
+     * @brief All known ingestion jobs, oldest first, without per-document results
+     */
+    std::vector<IngestionJobStatus> listIngestionJobs() const;
+    
+    /**
+     * @brief Stop a queued or running job; batches already written stay indexed
+     * @param job_id ID returned by submitAddDocumentsJob
+     * @return False if the job is unknown or already finished
+     */
+    bool cancelIngestionJob(const std::string& job_id);
     
     /**
      * @brief Remove documents from the vector database
@@ -90,19 +158,65 @@ public:
     
     /**
      * @brief List all document IDs in the collection
+     *
+     * Holds every ID in memory; large collections should be walked with listDocumentsPage.
      * @param collection_name Collection name (optional, uses default if empty)
      * @return Future with list of document IDs
      */
     std::future<std::vector<std::string>> listDocuments(const std::string& collection_name = "");
+
+    /**
+     * @brief One page of document IDs, without their payloads
+     * @param limit Most IDs to return
+     * @param cursor next_cursor of the previous page ("" = first page)
+     * @param collection_name Collection name (optional, uses default if empty)
+     * @return Future with the page; throws std::invalid_argument for a cursor the backend rejects
+     */
+    std::future<DocumentPage> listDocumentsPage(size_t limit, const std::string& cursor = "",
+                                                const std::string& collection_name = "");
     
     /**
      * @brief Get full document information by IDs
+     *
+     * Each ID is a direct lookup in the backend; results follow the order of ids.
      * @param ids Document IDs to retrieve
      * @param collection_name Collection name (optional, uses default if empty)
      * @return Future with document information response
      */
     std::future<std::vector<std::pair<std::string, std::optional<std::pair<std::string, std::unordered_map<std::string, nlohmann::json>>>>>> getDocumentsInfo(const std::vector<std::string>& ids, const std::string& collection_name = "");
 
+    /**
+     * @brief Stream a point-in-time snapshot of the "documents" collection, on the calling thread
+     * @param sink Receives the archive piece by piece; returning false stops the export
+     * @return Result whose info holds the epoch and change stream position the snapshot ends at
+     */
+    ReplicationResult exportSnapshot(const std::function<bool(const char*, size_t)>& sink);
+
+    /**
+     * @brief Replace the "documents" collection with a snapshot from another server
+     *
+     * The keyword and near-duplicate indexes are rebuilt from the restored documents.
+     * @param in Archive written by exportSnapshot
+     * @return Result whose info holds the source's epoch and position
+     */
+    ReplicationResult importSnapshot(std::istream& in);
+
+    /**
+     * @brief Write-ahead log records of the "documents" collection after a change stream position
+     * @param epoch Epoch of the position
+     * @param position Position to continue from
+     * @param max_bytes Most bytes of records to return (at least one record is returned)
+     * @param records Receives the records
+     * @return Result whose info holds the epoch, the next position and the end of the stream;
+     *         status 410 when the position can no longer be served and a new snapshot is needed
+     */
+    ReplicationResult readChanges(const std::string& epoch, uint64_t position, size_t max_bytes, std::string& records);
+
+    /**
+     * @brief Where following database.replication.source stands; null when not following
+     */
+    nlohmann::json replicationStatus() const;
+
 private:
     class Impl;
     std::unique_ptr<Impl> pImpl;
@@ -0,0 +1,140 @@
+#pragma once
+
+#include "../export.hpp"
+#include "../server_config.hpp"
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace kolosal
+{
+namespace retrieval
+{
+
+/**
+ * @brief Process-wide cache of embeddings keyed by model and input text
+ *
+ * Sits in front of the inference engines for every embedding caller
+ * (/v1/embeddings, document ingestion and retrieval, semantic chunking), so
+ * re-ingested chunks, overlapping chunking windows and repeated queries are
+ * embedded once. Entries are keyed by a 128-bit hash of the model id, the
+ * normalize flag and the exact input bytes; the text is not normalized first
+ * because a whitespace or case change is a different input to the model.
+ *
+ * The memory tier is an LRU bounded by bytes. The optional disk tier is an
+ * append-only file of (key, vector) records indexed in memory by offset, so
+ * embeddings survive a restart without being loaded eagerly; a memory miss
+ * that hits disk is promoted. When the file outgrows its budget it is
+ * rewritten with the entries currently in memory.
+ *
+ * Thread-safe.
+ */
+class KOLOSAL_SERVER_API EmbeddingCache
+{
+public:
+    struct Stats
+    {
+        uint64_t hits = 0;          // Served from memory
+        uint64_t disk_hits = 0;     // Served from the disk tier
+        uint64_t misses = 0;
+        uint64_t evictions = 0;     // Dropped from memory to stay within budget
+        size_t entries = 0;
+        size_t memory_bytes = 0;
+        size_t disk_entries = 0;
+        size_t disk_bytes = 0;
+    };
+
+    static EmbeddingCache& instance();
+
+    /**
+     * @brief Apply the configuration, opening (and indexing) the disk tier if one is set
+     *
+     * Clears the memory tier. Called once at startup; until then the cache
+     * runs with the defaults and no disk tier.
+     */
+    void configure(const DatabaseConfig::EmbeddingCacheConfig& config);
+
+    bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Cached embedding of a text, or nullopt on a miss
+     */
+    std::optional<std::vector<float>> get(const std::string& model_id, const std::string& text, bool normalize = true);
+
+    /**
+     * @brief Remember an embedding; empty vectors are ignored
+     */
+    void put(const std::string& model_id, const std::string& text, bool normalize, const std::vector<float>& embedding);
+
+    Stats stats() const;
+
+private:
+    struct Key
+    {
+        uint64_t high = 0;
+        uint64_t low = 0;
+        bool operator==(const Key& other) const { return high == other.high && low == other.low; }
+    };
+
+    struct KeyHash
+    {
+        size_t operator()(const Key& key) const { return static_cast<size_t>(key.high ^ (key.low * 0x9E3779B97F4A7C15ULL)); }
+    };
+
+    struct Entry
+    {
+        Key key;
+        std::vector<float> embedding;
+    };
+
+    struct DiskRecord
+    {
+        uint64_t offset = 0;        // Of the vector data
+        uint32_t dimensions = 0;
+    };
+
+    EmbeddingCache() = default;
+    EmbeddingCache(const EmbeddingCache&) = delete;
+    EmbeddingCache& operator=(const EmbeddingCache&) = delete;
+
+    static Key makeKey(const std::string& model_id, const std::string& text, bool normalize);
+    static size_t entryBytes(const Entry& entry);
+
+    void insertLocked(const Key& key, std::vector<float> embedding);
+    std::optional<std::vector<float>> readDisk(const Key& key);
+    void appendDisk(const Key& key, const std::vector<float>& embedding);
+    void openDiskLocked();
+    void compactDiskLocked();
+
+    std::atomic<bool> enabled_{true};
+
+#pragma warning(push)
+#pragma warning(disable: 4251)
+    mutable std::mutex mutex_;          // Memory tier
+    std::list<Entry> lru_;              // Most recently used first
+    std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> entries_;
+    size_t memory_bytes_ = 0;
+    size_t memory_limit_ = 256ULL * 1024 * 1024;
+
+    mutable std::mutex disk_mutex_;     // Disk tier; taken before mutex_ when both are held
+    std::string disk_path_;
+    std::fstream disk_;
+    std::unordered_map<Key, DiskRecord, KeyHash> disk_index_;
+    uint64_t disk_bytes_ = 0;
+    uint64_t disk_limit_ = 0;
+#pragma warning(pop)
+
+    std::atomic<uint64_t> hits_{0};
+    std::atomic<uint64_t> disk_hits_{0};
+    std::atomic<uint64_t> misses_{0};
+    std::atomic<uint64_t> evictions_{0};
+};
+
+} // namespace retrieval
+} // namespace kolosal
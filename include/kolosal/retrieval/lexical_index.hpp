@@ -0,0 +1,156 @@
+#pragma once
+
+#include "../export.hpp"
+#include <cstdint>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace kolosal
+{
+namespace retrieval
+{
+
+/**
+ * @brief In-memory BM25 inverted index over document text
+ *
+ * Documents are numbered in insertion order, so every posting list is sorted
+ * by construction and new postings are appended. Lists are stored in blocks
+ * of kBlockSize postings, varint-encoded as doc number deltas and term
+ * frequencies, with each block's last doc number, highest term frequency and
+ * shortest document length kept uncompressed beside it. Those give a BM25
+ * upper bound per block, which search() uses for block-max WAND: blocks that
+ * cannot lift a document into the current top k are skipped undecoded.
+ *
+ * Removed and replaced documents are only marked dead, and document
+ * frequencies keep counting them until enough have piled up to compact the
+ * lists, as Lucene does between merges.
+ *
+ * The index is not persisted. The vector store is the source of truth, and
+ * the owner refills the index from it with beginLoad(), load() and endLoad().
+ *
+ * Thread-safe: searches share a lock, updates take it exclusively.
+ */
+class KOLOSAL_SERVER_API LexicalIndex
+{
+public:
+    struct Hit
+    {
+        std::string id;
+        float score = 0.0f;
+    };
+
+    explicit LexicalIndex(float k1 = 1.2f, float b = 0.75f);
+
+    /**
+     * @brief Lowercased search terms of a text
+     *
+     * Words come from ChunkingService::splitWords with surrounding punctuation
+     * trimmed. A word with inner punctuation such as "ABC-123" or "v2.1" is
+     * kept whole and also split into its alphanumeric parts, so both the exact
+     * code and its pieces match.
+     */
+    static std::vector<std::string> analyze(const std::string& text);
+
+    /**
+     * @brief Index a document, replacing any earlier text under the same id
+     */
+    void add(const std::string& id, const std::string& text);
+
+    /**
+     * @brief Drop a document
+     * @return False if it was not indexed
+     */
+    bool remove(const std::string& id);
+
+    /**
+     * @brief Start refilling the index from the vector store
+     *
+     * Until endLoad(), load() skips ids that add() or remove() touched since,
+     * so a document changed during the load keeps its newer state.
+     */
+    void beginLoad();
+
+    /**
+     * @brief Index a document read back from the vector store
+     */
+    void load(const std::string& id, const std::string& text);
+
+    /**
+     * @brief Finish a load
+     * @return Number of documents removed while it ran; the store may have
+     *         shifted its pages under them, so a caller can run another pass
+     */
+    size_t endLoad();
+
+    /**
+     * @brief Whether a load has completed
+     */
+    bool ready() const;
+
+    /**
+     * @brief Number of live documents
+     */
+    size_t size() const;
+
+    /**
+     * @brief Top documents for a query by BM25, best first
+     */
+    std::vector<Hit> search(const std::string& query, int k) const;
+
+private:
+    static constexpr size_t kBlockSize = 128;
+
+    struct Block
+    {
+        uint32_t last_doc = 0;
+        uint32_t max_tf = 0;
+        uint32_t min_length = 0;
+        uint32_t offset = 0;    // Into PostingList::bytes
+        uint32_t count = 0;
+    };
+
+    struct PostingList
+    {
+        std::vector<uint8_t> bytes;
+        std::vector<Block> blocks;
+        std::vector<std::pair<uint32_t, uint32_t>> tail;    // (doc, tf) not yet filling a block
+        uint32_t tail_max_tf = 0;
+        uint32_t tail_min_length = UINT32_MAX;
+        uint32_t doc_freq = 0;
+        uint32_t max_tf = 0;
+        uint32_t min_length = UINT32_MAX;
+    };
+
+    class Cursor;
+
+    void addLocked(const std::string& id, const std::string& text);
+    bool removeLocked(const std::string& id);
+    void compactLocked();
+    static void append(PostingList& list, uint32_t doc, uint32_t tf, uint32_t length);
+    static void flushTail(PostingList& list);
+    static void decodeBlock(const PostingList& list, size_t block, std::vector<std::pair<uint32_t, uint32_t>>& out);
+    float weight(uint32_t tf, uint32_t length) const;
+
+    float k1_;
+    float b_;
+
+    mutable std::shared_mutex mutex_;
+    std::unordered_map<std::string, uint32_t> terms_;
+    std::vector<PostingList> postings_;
+    std::vector<std::string> doc_ids_;          // By doc number; empty once the document is dead
+    std::vector<uint32_t> doc_lengths_;
+    std::unordered_map<std::string, uint32_t> docs_;
+    size_t live_docs_ = 0;
+    uint64_t live_length_ = 0;
+
+    bool ready_ = false;
+    bool loading_ = false;
+    std::unordered_set<std::string> touched_;   // Ids add() or remove() changed during a load
+    size_t removed_during_load_ = 0;
+};
+
+} // namespace retrieval
+} // namespace kolosal
@@ -0,0 +1,128 @@
+#pragma once
+
+#include "../export.hpp"
+#include <cstdint>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace kolosal
+{
+namespace retrieval
+{
+
+/**
+ * @brief MinHash signatures of stored chunks, bucketed for LSH lookup
+ *
+ * A text's signature is the minimum of num_hashes independent hash functions
+ * over its word shingles (runs of shingle_words lowercased words), so the
+ * share of positions two signatures agree on estimates the Jaccard
+ * similarity of their shingle sets. Signatures are cut into bands whose rows
+ * are hashed into buckets; texts sharing any band bucket are candidates, and
+ * a candidate counts as a duplicate once its estimated similarity reaches the
+ * threshold. The band shape is picked so the LSH curve rises well below the
+ * threshold, missing few true duplicates while keeping candidates rare.
+ *
+ * Each chunk costs its signature (4 bytes per hash) plus one bucket entry per
+ * band. Like LexicalIndex, the index is not persisted: the owner refills it
+ * from the vector store with beginLoad(), load() and endLoad().
+ *
+ * Thread-safe: lookups share a lock, updates take it exclusively.
+ */
+class KOLOSAL_SERVER_API NearDuplicateIndex
+{
+public:
+    using Signature = std::vector<uint32_t>;
+
+    struct Match
+    {
+        std::string id;
+        double similarity = 0.0;    // Estimated Jaccard similarity
+    };
+
+    explicit NearDuplicateIndex(double threshold = 0.9, int shingle_words = 5, int num_hashes = 128);
+
+    /**
+     * @brief MinHash signature of a text; empty if it has no words
+     */
+    Signature signature(const std::string& text) const;
+
+    /**
+     * @brief Estimated Jaccard similarity of two signatures of this index
+     */
+    double similarity(const Signature& a, const Signature& b) const;
+
+    /**
+     * @brief Most similar indexed chunk at or above the threshold
+     * @return False if there is none
+     */
+    bool find(const Signature& signature, Match& match) const;
+
+    /**
+     * @brief Index a chunk's signature, replacing any earlier one under the same id
+     */
+    void add(const std::string& id, const Signature& signature);
+
+    /**
+     * @brief Drop a chunk
+     * @return False if it was not indexed
+     */
+    bool remove(const std::string& id);
+
+    /**
+     * @brief Start refilling the index from the vector store
+     *
+     * Until endLoad(), load() skips ids that add() or remove() touched since.
+     */
+    void beginLoad();
+
+    /**
+     * @brief Index a chunk read back from the vector store
+     */
+    void load(const std::string& id, const std::string& text);
+
+    /**
+     * @brief Finish a load
+     * @return Number of chunks removed while it ran
+     */
+    size_t endLoad();
+
+    /**
+     * @brief Number of indexed chunks
+     */
+    size_t size() const;
+
+    /**
+     * @brief Approximate bytes held by signatures and buckets
+     */
+    size_t memoryBytes() const;
+
+private:
+    uint64_t bandKey(const uint32_t* signature, int band) const;
+    void addLocked(const std::string& id, const Signature& signature);
+    bool removeLocked(const std::string& id);
+
+    double threshold_;
+    int shingle_words_;
+    int num_hashes_;
+    int bands_;
+    int rows_;
+    std::vector<uint64_t> seeds_;
+
+    mutable std::shared_mutex mutex_;
+    std::vector<uint32_t> signatures_;                          // num_hashes_ per slot
+    std::vector<std::string> slot_ids_;                         // Empty for a free slot
+    std::vector<uint32_t> free_slots_;
+    std::unordered_map<std::string, uint32_t> slots_;
+    std::unordered_map<uint64_t, std::vector<uint32_t>> buckets_;
+    size_t bucket_entries_ = 0;
+
+    bool loading_ = false;
+    std::unordered_set<std::string> touched_;
+    size_t removed_during_load_ = 0;
+};
+
+} // namespace retrieval
+} // namespace kolosal
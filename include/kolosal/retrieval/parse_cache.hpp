@@ -0,0 +1,106 @@
+#pragma once
+
+#include "../export.hpp"
+#include "../server_config.hpp"
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace kolosal
+{
+namespace retrieval
+{
+
+/**
+ * @brief On-disk cache of document parse results keyed by content
+ *
+ * /parse_pdf and /parse_docx look the upload up here before decoding it, so a
+ * file that was parsed before is answered from disk instead of being decoded
+ * and parsed again. Keys are a 128-bit hash of the document type, the parse
+ * options and the encoded payload exactly as received.
+ *
+ * Each result is a file named after its key in the cache directory. The
+ * directory is bounded by bytes with least-recently-used eviction; recency is
+ * kept in the file modification times, so the order survives a restart.
+ *
+ * Thread-safe.
+ */
+class KOLOSAL_SERVER_API ParseCache
+{
+public:
+    struct Stats
+    {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+        size_t entries = 0;
+        size_t bytes = 0;
+    };
+
+    static ParseCache& instance();
+
+    /**
+     * @brief Apply the configuration, indexing the results already in the directory
+     *
+     * The cache stays off until configured with a directory.
+     */
+    void configure(const DatabaseConfig::ParseCacheConfig& config);
+
+    bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Key of a document: its type, the options that change the result, and its bytes
+     */
+    static std::string makeKey(const std::string& type, const std::string& options, std::string_view content);
+
+    /**
+     * @brief Cached result for a key, or nullopt on a miss
+     */
+    std::optional<std::string> get(const std::string& key);
+
+    /**
+     * @brief Store a result, evicting the least recently used ones beyond the budget
+     */
+    void put(const std::string& key, const std::string& result);
+
+    Stats stats() const;
+
+private:
+    struct Entry
+    {
+        std::string key;
+        uint64_t bytes = 0;
+    };
+
+    ParseCache() = default;
+    ParseCache(const ParseCache&) = delete;
+    ParseCache& operator=(const ParseCache&) = delete;
+
+    std::string pathFor(const std::string& key) const;
+    void touchLocked(const std::string& key, uint64_t bytes);
+    void evictLocked();
+
+    std::atomic<bool> enabled_{false};
+
+#pragma warning(push)
+#pragma warning(disable: 4251)
+    mutable std::mutex mutex_;
+    std::string directory_;
+    std::list<Entry> lru_;              // Most recently used first
+    std::unordered_map<std::string, std::list<Entry>::iterator> entries_;
+    uint64_t bytes_ = 0;
+    uint64_t limit_ = 0;
+#pragma warning(pop)
+
+    std::atomic<uint64_t> hits_{0};
+    std::atomic<uint64_t> misses_{0};
+    std::atomic<uint64_t> evictions_{0};
+};
+
+} // namespace retrieval
+} // namespace kolosal
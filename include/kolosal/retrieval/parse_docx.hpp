@@ -1,6 +1,7 @@
 #pragma once
 
 #include "../export.hpp"
+#include <functional>
 #include <future>
 #include <mutex>
 #include <string>
@@ -10,18 +11,22 @@
 #include <regex>
 #include <stdexcept>
 #include <cstring>
-#include <pugixml.hpp>
 
 namespace retrieval
 {
+    // Receives each paragraph, already formatted as Markdown, as soon as it has been inflated and read
+    using ParagraphCallback = std::function<void(const std::string &paragraph)>;
+
     class DOCXParser
     {
     public:
-        // Synchronous parsing
-        static std::string parse_docx(const std::string &file_path);
+        // Synchronous parsing; word/document.xml is streamed, never held in memory whole
+        static std::string parse_docx(const std::string &file_path,
+                                      ParagraphCallback paragraph_cb = nullptr);
 
         // Parse from memory buffer
-        static std::string parse_docx_from_bytes(const unsigned char *data, size_t size);
+        static std::string parse_docx_from_bytes(const unsigned char *data, size_t size,
+                                                 ParagraphCallback paragraph_cb = nullptr);
 
         // Asynchronous parsing
         static std::future<std::string> parse_docx_async(const std::string &file_path);
@@ -36,10 +41,12 @@ namespace retrieval
 
     private:
         // Thread-safe parsing methods
-        static std::string parse_docx_internal(const std::string &file_path);
+        static std::string parse_docx_internal(const std::string &file_path,
+                                               ParagraphCallback paragraph_cb = nullptr);
 
         // Memory-based parsing methods
-        static std::string parse_docx_from_bytes_internal(const unsigned char *data, size_t size);
+        static std::string parse_docx_from_bytes_internal(const unsigned char *data, size_t size,
+                                                          ParagraphCallback paragraph_cb = nullptr);
 
         // Utility functions
         static bool file_exists(const std::string &file_path);
@@ -2,6 +2,7 @@
 
 #include "../export.hpp"
 #include <string>
+#include <string_view>
 #include <future>
 #include <memory>
 #include <functional>
@@ -27,6 +28,93 @@ namespace retrieval
 
     using HtmlProgressCallback = std::function<void(size_t current_element, size_t total_elements)>;
 
+    // Receives converted text as it is produced; pieces concatenate to the full result
+    using HtmlTextCallback = std::function<void(std::string_view text)>;
+
+    struct HtmlExtractOptions
+    {
+        bool markdown = true;           // Headings, emphasis, links, lists and tables as Markdown; plain text otherwise
+        bool skip_boilerplate = true;   // Drop navigation, sidebars, footers and page headers
+    };
+
+    /**
+     * Single-pass HTML to Markdown converter that accepts the document in pieces
+     *
+     * Tags are tokenized as they arrive and entities decoded in place; script, style
+     * and similar elements are dropped, and with skip_boilerplate so are nav, aside,
+     * footer and page-level header blocks. Text is handed to the callback after each
+     * feed(), or collected and returned by finish() when there is none. Usable directly
+     * as a libcurl write callback so a page is converted while it downloads:
+     *
+     *     curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, HtmlTextExtractor::curlWrite);
+     *     curl_easy_setopt(curl, CURLOPT_WRITEDATA, &extractor);
+     */
+    class KOLOSAL_SERVER_API HtmlTextExtractor
+    {
+    public:
+        explicit HtmlTextExtractor(HtmlExtractOptions options = HtmlExtractOptions(), HtmlTextCallback on_text = nullptr);
+        ~HtmlTextExtractor();
+
+        /**
+         * Consume the next piece of the document; tags and entities may span pieces
+         */
+        void feed(const char *data, size_t size);
+
+        /**
+         * End of document: flush what is left and return the collected text (empty when streaming to a callback)
+         */
+        std::string finish();
+
+        size_t elementsProcessed() const { return elements_; }
+
+        static size_t curlWrite(char *data, size_t size, size_t nmemb, void *extractor);
+
+    private:
+        struct ListState
+        {
+            bool ordered = false;
+            int next = 1;
+        };
+
+        size_t consume(const char *data, size_t size, bool final);
+        size_t consumeTag(const char *data, size_t size, bool final);
+        size_t consumeEntity(const char *data, size_t size, bool final);
+        void startTag(std::string_view name, std::string_view attributes, bool self_closing);
+        void endTag(std::string_view name);
+
+        void text(const char *data, size_t size);
+        void open(std::string_view markup);
+        void close(std::string_view markup);
+        void breakLine(int count);
+        void flush();
+        void writePrefix();
+        bool emitting() const { return skip_depth_ == 0 && raw_tag_.empty(); }
+
+#pragma warning(push)
+#pragma warning(disable: 4251)
+        HtmlExtractOptions options_;
+        HtmlTextCallback on_text_;
+        std::string pending_;               // Unconsumed input: an incomplete tag, entity or end marker
+        std::string out_;
+        std::string raw_tag_;               // Inside script, style, ...: skip to its end tag
+        bool in_comment_ = false;
+        std::string skip_tag_;              // Boilerplate or non-content element being dropped
+        int skip_depth_ = 0;
+        int content_depth_ = 0;             // Open article/main elements; headers inside them are kept
+        int pre_depth_ = 0;
+        std::vector<std::string> links_;    // href of each open <a>, empty when it has none
+        std::vector<ListState> lists_;
+        int quote_depth_ = 0;
+        int line_quote_depth_ = 0;          // Quote depth the current output line started with
+        bool pre_fresh_ = false;            // A newline right after <pre> is not content
+        int pending_newlines_ = 0;
+        bool pending_space_ = false;
+        bool at_start_ = true;              // At a line start or just after opening markup
+        bool written_ = false;
+        size_t elements_ = 0;
+#pragma warning(pop)
+    };
+
     class KOLOSAL_SERVER_API HtmlParser
     {
     public:
@@ -63,10 +151,6 @@ namespace retrieval
         void cancel();
 
     private:
-        std::string convertHtmlToMarkdown(const std::string& html);
-        std::string cleanupMarkdown(const std::string& markdown);
-        std::string decodeHtmlEntities(const std::string& html);
-        
         mutable std::mutex busy_mutex_;
         // Use pointers to avoid DLL export issues with std::atomic
         std::unique_ptr<std::atomic<bool>> is_busy_;
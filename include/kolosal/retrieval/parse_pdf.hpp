@@ -35,20 +35,25 @@ namespace retrieval
 
     using ProgressCallback = std::function<void(size_t current_page, size_t total_pages)>;
 
+    // Receives each page's text in page order as soon as it and every earlier page are extracted
+    using PageCallback = std::function<void(size_t page_index, const std::string &page_text)>;
+
     class DocumentParser
     {
     public:
-        // Synchronous parsing
+        // Synchronous parsing; Fast extraction spreads page ranges over a bounded set of threads
         static ParseResult parse_pdf(const std::string &file_path,
                                      PDFParseMethod method = PDFParseMethod::Fast,
                                      const std::string &language = "eng",
-                                     ProgressCallback progress_cb = nullptr);
+                                     ProgressCallback progress_cb = nullptr,
+                                     PageCallback page_cb = nullptr);
 
         // Parse from memory buffer
         static ParseResult parse_pdf_from_bytes(const unsigned char *data, size_t size,
                                                 PDFParseMethod method = PDFParseMethod::Fast,
                                                 const std::string &language = "eng",
-                                                ProgressCallback progress_cb = nullptr);
+                                                ProgressCallback progress_cb = nullptr,
+                                                PageCallback page_cb = nullptr);
 
         // Asynchronous parsing
         static std::future<ParseResult> parse_pdf_async(const std::string &file_path,
@@ -70,7 +75,8 @@ namespace retrieval
     private:
         // Thread-safe parsing methods
         static ParseResult parse_pdf_fast(const std::string &file_path,
-                                          ProgressCallback progress_cb = nullptr);
+                                          ProgressCallback progress_cb = nullptr,
+                                          PageCallback page_cb = nullptr);
 
         static ParseResult parse_pdf_ocr(const std::string &file_path,
                                          const std::string &language,
@@ -81,7 +87,8 @@ namespace retrieval
 
         // Memory-based parsing methods
         static ParseResult parse_pdf_fast_from_bytes(const unsigned char *data, size_t size,
-                                                     ProgressCallback progress_cb = nullptr);
+                                                     ProgressCallback progress_cb = nullptr,
+                                                     PageCallback page_cb = nullptr);
 
         static ParseResult parse_pdf_ocr_from_bytes(const unsigned char *data, size_t size,
                                                     const std::string &language,
@@ -90,6 +97,17 @@ namespace retrieval
         static ParseResult parse_pdf_visual_from_bytes(const unsigned char *data, size_t size,
                                                        ProgressCallback progress_cb = nullptr);
 
+        // Extracts every page of a loaded PDF, in parallel page ranges when it is large enough
+        static ParseResult extract_pages(const char *data, size_t size,
+                                         ProgressCallback progress_cb,
+                                         PageCallback page_cb);
+
+        // Rasterizes every page and runs it through pooled Tesseract engines on parallel
+        // threads; pages are cached individually in the parse cache (parse_pdf_ocr.cpp)
+        static ParseResult ocr_pages(const char *data, size_t size,
+                                     const std::string &language,
+                                     ProgressCallback progress_cb);
+
         // Utility functions
         static std::string extract_text_from_page(const PoDoFo::PdfMemDocument& doc, int page_num);
         static bool file_exists(const std::string &file_path);
@@ -2,6 +2,7 @@
 
 #include "../export.hpp"
 #include <json.hpp>
+#include <stdexcept>
 #include <string>
 #include <vector>
 #include <unordered_map>
@@ -22,6 +23,14 @@ struct KOLOSAL_SERVER_API RetrieveRequest
     int k = 10;  // Number of top similar documents to return
     std::string collection_name = "";  // Optional, uses default if empty
     float score_threshold = 0.0f;  // Minimum similarity score threshold
+    nlohmann::json filter;  // Optional payload filter in Qdrant syntax, applied inside the vector search
+    std::string search_mode = "vector";  // "vector", "keyword" (BM25 only) or "hybrid" (both, fused)
+    std::string fusion = "rrf";  // How hybrid merges the two rankings: "rrf" or "weighted"
+    float keyword_weight = 0.5f;  // Share of the fused score given to the keyword ranking
+    std::string rerank_model = "";  // Optional reranker model ID; candidates are rescored by it
+    int rerank_candidates = 0;  // Candidates handed to the reranker; 0 = 4 * k
+    std::vector<std::string> fields;  // Payload fields returned ("text" or metadata keys); empty = all
+    int deadline_ms = 0;  // Fail instead of answering later than this after the request was taken; 0 = none
     
     /**
      * @brief Populates request from JSON
@@ -36,6 +45,28 @@ struct KOLOSAL_SERVER_API RetrieveRequest
     bool validate() const;
 };
 
+/**
+ * @brief Thrown by a retrieval that ran out of its deadline_ms; answered with 504
+ */
+class KOLOSAL_SERVER_API DeadlineExceeded : public std::runtime_error
+{
+public:
+    using std::runtime_error::runtime_error;
+};
+
+/**
+ * @brief Evaluates a Qdrant-syntax payload filter against one payload
+ * 
+ * Matches the semantics the vector stores apply inside their searches, for
+ * results that come from elsewhere (keyword hits of a hybrid search).
+ * 
+ * @param filter Filter object with must, should and must_not conditions
+ * @param payload Document payload
+ * @return true if the payload passes the filter
+ * @throws std::runtime_error if the filter is malformed
+ */
+KOLOSAL_SERVER_API bool payloadMatchesFilter(const nlohmann::json& filter, const nlohmann::json& payload);
+
 /**
  * @brief Single retrieved document result
  * 
@@ -68,12 +99,16 @@ struct KOLOSAL_SERVER_API RetrieveResponse
     std::string collection_name;
     float score_threshold = 0.0f;
     int total_found = 0;
+    double embed_ms = 0.0;   // Query embedding
+    double search_ms = 0.0;  // Vector and keyword search, fusion included
+    double rerank_ms = 0.0;  // Reranker pass, 0 without rerank_model
     
     /**
      * @brief Adds a retrieved document result
      * @param document Retrieved document
      */
     void addDocument(const RetrievedDocument& document);
+    void addDocument(RetrievedDocument&& document);
     
     /**
      * @brief Converts response to JSON
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "export.hpp"
+#include "routes/route_interface.hpp"
+
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace kolosal {
+
+    /**
+     * @brief Method + path-segment trie over the registered routes.
+     *
+     * Built once as routes are added, from the patterns each route declares.
+     * A lookup walks the request path one segment at a time and returns the
+     * few routes that can possibly accept it, in registration order, so the
+     * server no longer asks every route (and every route's regexes) about
+     * every request. Routes that declare no patterns are always candidates.
+     * The final decision stays with IRoute::match(). Each candidate carries
+     * the {name} segments captured by the pattern that selected it.
+     */
+    class KOLOSAL_SERVER_API RouteTable {
+    public:
+        RouteTable();
+        ~RouteTable();
+
+        RouteTable(const RouteTable&) = delete;
+        RouteTable& operator=(const RouteTable&) = delete;
+
+        struct Match {
+            IRoute* route;
+            std::map<std::string, std::string> params;
+            std::string pattern;                   // Pattern path that selected the route ("" = unpatterned)
+        };
+
+        void add(IRoute* route);
+
+        // Candidate routes for a request, in the order they were added
+        std::vector<Match> lookup(const std::string& method, const std::string& path) const;
+
+    private:
+        struct Entry {
+            size_t order;
+            IRoute* route;
+            std::vector<std::string> paramNames;   // {name} segments of the pattern, in path order
+            std::string pattern;
+        };
+
+        struct Found {
+            const Entry* entry;
+            std::vector<std::string> values;       // Segments captured by those names
+        };
+
+        struct Node {
+            std::unordered_map<std::string, std::unique_ptr<Node>> children;
+            std::unique_ptr<Node> param;                                // {name} segment
+            std::unordered_map<std::string, std::vector<Entry>> routes; // By method, "*" = any
+            std::unordered_map<std::string, std::vector<Entry>> rest;   // Trailing * below this node
+        };
+
+        void insert(const RoutePattern& pattern, Entry entry);
+        static void collect(const std::unordered_map<std::string, std::vector<Entry>>& byMethod,
+                            const std::string& method, const std::vector<std::string>& values,
+                            std::vector<Found>& out);
+
+#pragma warning(push)
+#pragma warning(disable: 4251)
+        std::unique_ptr<Node> root_;
+        std::vector<Entry> unpatterned_;
+#pragma warning(pop)
+        size_t count_ = 0;
+    };
+
+} // namespace kolosal
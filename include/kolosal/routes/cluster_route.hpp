@@ -0,0 +1,22 @@
+#ifndef KOLOSAL_CLUSTER_ROUTE_HPP
+#define KOLOSAL_CLUSTER_ROUTE_HPP
+
+#include "route_interface.hpp"
+#include <string>
+
+namespace kolosal {
+
+    // Cluster membership endpoints, registered by ServerAPI::enableCluster(). GET /v1/cluster/state is
+    // what peers poll: this node's loaded models, their load and the routing keys it served recently.
+    // GET /v1/cluster/nodes shows every node as this one sees it. POST /v1/cluster/drain takes this node
+    // out of service (see DrainManager), GET shows the drain's progress and DELETE cancels it.
+    class ClusterRoute : public IRoute {
+    public:
+        bool match(const std::string& method, const std::string& path) override;
+        std::vector<RoutePattern> patterns() const override;
+        void handle(SocketType sock, const RequestContext& request) override;
+    };
+
+} // namespace kolosal
+
+#endif // KOLOSAL_CLUSTER_ROUTE_HPP
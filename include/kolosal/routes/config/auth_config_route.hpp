@@ -11,7 +11,8 @@ public:
     ~AuthConfigRoute() override = default;
 
     bool match(const std::string& method, const std::string& path) override;
-    void handle(SocketType sock, const std::string& body) override;
+    std::vector<RoutePattern> patterns() const override;
+    void handle(SocketType sock, const RequestContext& request) override;
 
 private:
     void handleGetConfig(SocketType sock);
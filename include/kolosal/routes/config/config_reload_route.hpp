@@ -0,0 +1,16 @@
+#pragma once
+
+#include "../route_interface.hpp"
+#include "../../export.hpp"
+
+namespace kolosal {
+
+// POST /v1/config/reload: re-reads the config file and applies what changed
+class KOLOSAL_SERVER_API ConfigReloadRoute : public IRoute {
+public:
+    bool match(const std::string& method, const std::string& path) override;
+    std::vector<RoutePattern> patterns() const override;
+    void handle(SocketType sock, const RequestContext& request) override;
+};
+
+} // namespace kolosal
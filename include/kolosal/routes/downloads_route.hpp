@@ -9,12 +9,10 @@ namespace kolosal {
     class DownloadsRoute : public IRoute {
     public:
         bool match(const std::string& method, const std::string& path) override;
-        void handle(SocketType sock, const std::string& body) override;
+        std::vector<RoutePattern> patterns() const override;
+        void handle(SocketType sock, const RequestContext& request) override;
         
     private:
-        // Store the matched path to extract model ID later
-        mutable std::string matched_path_;
-        
         // Extract model ID from path like /downloads/{model_id}
         std::string extractModelId(const std::string& path);
         
@@ -23,6 +21,9 @@ namespace kolosal {
         
         // Handle all downloads status request (GET)
         void handleAllDownloads(SocketType sock);
+
+        // Push progress as server-sent events until the client goes away (GET /downloads/events)
+        void handleProgressStream(SocketType sock, const RequestContext& request, const std::string& query);
         
         // Handle cancel single download (DELETE/POST)
         void handleCancelDownload(SocketType sock, const std::string& model_id);
@@ -28,18 +28,16 @@ namespace kolosal
          * @return True if this route should handle the request
          */
         bool match(const std::string &method, const std::string &path) override;
+        std::vector<RoutePattern> patterns() const override;
 
         /**
          * @brief Handle the inference engines request
          * @param sock Socket to send response to
-         * @param body Request body (used for POST requests to add engines)
+         * @param request Request method and body (the body is used for POST and PUT)
          */
-        void handle(SocketType sock, const std::string &body) override;
+        void handle(SocketType sock, const RequestContext &request) override;
 
     private:
-        // Store the matched method to determine operation in handle()
-        mutable std::string matched_method_;
-        
         /**
          * @brief Handle GET request to list available inference engines
          * @param sock Socket to send response to
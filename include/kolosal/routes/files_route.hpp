@@ -0,0 +1,36 @@
+#ifndef KOLOSAL_FILES_ROUTE_HPP
+#define KOLOSAL_FILES_ROUTE_HPP
+
+#include "route_interface.hpp"
+#include "../export.hpp"
+#include <string>
+#include <vector>
+
+namespace kolosal
+{
+
+/**
+ * @brief Route handler for the OpenAI-compatible Files API
+ *
+ * Uploads batch input files (POST /v1/files, multipart/form-data with "file"
+ * and purpose "batch"), lists and describes them, serves their content (which
+ * is how batch results are downloaded) and deletes them. Files are kept by
+ * BatchManager.
+ */
+class KOLOSAL_SERVER_API FilesRoute : public IRoute
+{
+public:
+    bool match(const std::string& method, const std::string& path) override;
+    std::vector<RoutePattern> patterns() const override;
+    void handle(SocketType sock, const RequestContext& request) override;
+
+    // Batch inputs can be hundreds of MB, so large uploads are written out as they arrive
+    bool streamsBody() const override { return true; }
+
+private:
+    void handleUpload(SocketType sock, const RequestContext& request);
+};
+
+} // namespace kolosal
+
+#endif // KOLOSAL_FILES_ROUTE_HPP
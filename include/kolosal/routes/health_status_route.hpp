@@ -8,10 +8,8 @@ namespace kolosal {
     class HealthStatusRoute : public IRoute {
     public:
         bool match(const std::string& method, const std::string& path) override;
-        void handle(SocketType sock, const std::string& body) override;
-    
-    private:
-        std::string current_method_;
+        std::vector<RoutePattern> patterns() const override;
+        void handle(SocketType sock, const RequestContext& request) override;
     };
 
 } // namespace kolosal
@@ -0,0 +1,31 @@
+#ifndef KOLOSAL_BATCHES_ROUTE_HPP
+#define KOLOSAL_BATCHES_ROUTE_HPP
+
+#include "../route_interface.hpp"
+#include "../../export.hpp"
+#include <string>
+#include <vector>
+
+namespace kolosal
+{
+
+/**
+ * @brief Route handler for the OpenAI-compatible Batch API
+ *
+ * Creates, lists, describes and cancels batches (/v1/batches) of chat or
+ * text completion requests read from a file uploaded through /v1/files.
+ * Batches run in the background on BatchManager, using the engine capacity
+ * interactive requests leave.
+ */
+class KOLOSAL_SERVER_API BatchesRoute : public IRoute
+{
+public:
+    bool match(const std::string& method, const std::string& path) override;
+    std::vector<RoutePattern> patterns() const override;
+    const char* capacityClass() const override { return "chat"; }
+    void handle(SocketType sock, const RequestContext& request) override;
+};
+
+} // namespace kolosal
+
+#endif // KOLOSAL_BATCHES_ROUTE_HPP
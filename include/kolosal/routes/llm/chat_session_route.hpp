@@ -0,0 +1,48 @@
+#ifndef KOLOSAL_CHAT_SESSION_ROUTE_HPP
+#define KOLOSAL_CHAT_SESSION_ROUTE_HPP
+
+#include "../route_interface.hpp"
+#include "../../export.hpp"
+#include <atomic>
+#include <string>
+#include <vector>
+
+namespace kolosal
+{
+
+/**
+ * @brief WebSocket chat sessions (GET /v1/chat/sessions, upgraded)
+ *
+ * One connection carries a conversation's turns without a new HTTP request
+ * each time. Client messages are JSON text frames:
+ *   {"type": "chat", "id": "t1", "request": {<chat completion body>}}
+ *   {"type": "cancel", "id": "t1"}
+ * and the server answers with
+ *   {"type": "session", "session_id": ...}          once, after the upgrade
+ *   {"type": "delta", "id": "t1", "text": ...}       as soon as tokens decode
+ *   {"type": "done", "id": "t1", "finish_reason": "stop" | "cancelled", "usage": {...}}
+ *   {"type": "error", "id": "t1", "code": ..., "message": ...}
+ *
+ * Several requests, told apart by id, may run at once on one connection;
+ * cancel stops the job in the engine. Turns without their own session_id
+ * run under the connection's session key (?session_id=... or a generated
+ * one), so consecutive turns land on the slot that holds the conversation's
+ * KV cache. Authentication, token quotas and admission control apply per
+ * request as on /v1/chat/completions.
+ */
+class KOLOSAL_SERVER_API ChatSessionRoute : public IRoute
+{
+public:
+    bool match(const std::string& method, const std::string& path) override;
+    std::vector<RoutePattern> patterns() const override;
+    const char* capacityClass() const override { return "chat"; }
+    void handle(SocketType sock, const RequestContext& request) override;
+    void stop() override;
+
+private:
+    std::atomic<bool> stopping_{false};
+};
+
+} // namespace kolosal
+
+#endif // KOLOSAL_CHAT_SESSION_ROUTE_HPP
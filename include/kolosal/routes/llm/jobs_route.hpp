@@ -0,0 +1,29 @@
+#ifndef KOLOSAL_JOBS_ROUTE_HPP
+#define KOLOSAL_JOBS_ROUTE_HPP
+
+#include "../route_interface.hpp"
+#include "../../export.hpp"
+#include <string>
+#include <vector>
+
+namespace kolosal
+{
+
+/**
+ * @brief Route handler for asynchronous completion jobs (/v1/jobs)
+ *
+ * Submits a chat or text completion request to run in the background and
+ * answers 202 with the job at once; lists, describes (with the result once it
+ * is done), cancels and deletes jobs. Jobs run on JobManager.
+ */
+class KOLOSAL_SERVER_API JobsRoute : public IRoute
+{
+public:
+    bool match(const std::string& method, const std::string& path) override;
+    std::vector<RoutePattern> patterns() const override;
+    void handle(SocketType sock, const RequestContext& request) override;
+};
+
+} // namespace kolosal
+
+#endif // KOLOSAL_JOBS_ROUTE_HPP
@@ -0,0 +1,36 @@
+#ifndef KOLOSAL_MIGRATION_ROUTE_HPP
+#define KOLOSAL_MIGRATION_ROUTE_HPP
+
+#include "../route_interface.hpp"
+#include "../../export.hpp"
+#include <string>
+#include <vector>
+
+namespace kolosal
+{
+
+/**
+ * @brief Receiving side of a peer's drain (see DrainManager)
+ *
+ * Registered by ServerAPI::enableCluster(). POST /v1/internal/sessions takes a
+ * warm session ({"model","key"} header) into the engine's KV cache and
+ * advertises its key. POST /v1/internal/resume continues a suspended
+ * generation ({"model","request","max_tokens"} header) from its KV state and
+ * streams the output as server-sent events: {"text","tokens"} per delta,
+ * then {"finished":true} or {"error":...}, then [DONE].
+ */
+class KOLOSAL_SERVER_API MigrationRoute : public IRoute
+{
+public:
+    bool match(const std::string& method, const std::string& path) override;
+    std::vector<RoutePattern> patterns() const override;
+    void handle(SocketType sock, const RequestContext& request) override;
+
+private:
+    void importSession(SocketType sock, const std::string& header, std::vector<uint8_t>& state);
+    void resumeGeneration(SocketType sock, const std::string& header, std::vector<uint8_t>& state);
+};
+
+} // namespace kolosal
+
+#endif // KOLOSAL_MIGRATION_ROUTE_HPP
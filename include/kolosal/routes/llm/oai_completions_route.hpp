@@ -23,12 +23,14 @@ namespace kolosal {
         ~OaiCompletionsRoute();
         
         bool match(const std::string& method, const std::string& path) override;
-        void handle(SocketType sock, const std::string& body) override;
+        std::vector<RoutePattern> patterns() const override;
+        const char* capacityClass() const override { return "chat"; }
+        void handle(SocketType sock, const RequestContext& request) override;
         
     private:
         // Specific handlers for different completion types
-        void handleTextCompletion(SocketType sock, const std::string& body);
-        void handleChatCompletion(SocketType sock, const std::string& body);
+        void handleTextCompletion(SocketType sock, const std::string& body, const std::string& subject);
+        void handleChatCompletion(SocketType sock, const std::string& body, const std::string& subject);
         
         // Path determination
         bool isTextCompletionPath(const std::string& path);
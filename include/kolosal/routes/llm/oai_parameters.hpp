@@ -0,0 +1,65 @@
+#pragma once
+
+#include "../../models/chat_request_model.hpp"
+#include "../../models/completion_request_model.hpp"
+#include "inference_interface.h"
+#include <json.hpp>
+#include <string>
+#include <vector>
+
+namespace kolosal {
+
+    /**
+     * @brief Inference parameters of an OpenAI-style chat completion request
+     *
+     * Maps the parsed request and the extension fields read from its raw body
+     * (grammar, jsonSchema, response_format, allow_context_shift, n_discard).
+     * Shared by /v1/chat/completions and the lines of a /v1/batches input file.
+     */
+    ChatCompletionParameters buildChatCompletionParameters(const ChatCompletionRequest &request, const nlohmann::json &body);
+
+    /**
+     * @brief Inference parameters of an OpenAI-style text completion request
+     *
+     * A prompt given as an array is joined with newlines.
+     */
+    CompletionParameters buildCompletionParameters(const CompletionRequest &request, const nlohmann::json &body);
+
+    /**
+     * @brief Prompt size before tokenization, for token quota admission; settled with the real count later
+     */
+    size_t estimatePromptTokens(const ChatCompletionParameters &params);
+    size_t estimatePromptTokens(const CompletionParameters &params);
+
+    /**
+     * @brief Token quota estimate of a request body: its prompt plus max_tokens for every candidate
+     *
+     * The same figure the synchronous routes reserve, for requests run in the background.
+     * @throws std::invalid_argument if the body does not validate
+     */
+    struct RequestEstimate
+    {
+        size_t promptTokens = 0;
+        size_t totalTokens = 0;
+    };
+    RequestEstimate estimateRequestTokens(bool chat, const nlohmann::json &body, int candidates);
+
+    /**
+     * @brief Submit a non-streaming chat or text completion request body as @p candidates jobs
+     *
+     * Shared by the requests that run in the background (/v1/batches, /v1/jobs).
+     * @param tenant Tenant the jobs are scheduled as (see auth::TenantShares), or empty for none
+     * @throws std::invalid_argument if the body does not validate
+     * @return One job ID per candidate; empty if the engine refused any (those it took are released)
+     */
+    std::vector<int> submitCompletionJobs(IInferenceEngine &engine, bool chat, const nlohmann::json &body,
+                                          int candidates, int priority, const std::string &tenant = std::string());
+
+    /**
+     * @brief OpenAI response body for finished jobs, one choice per result
+     * @param firstJobId Names the response, as the synchronous routes do
+     */
+    nlohmann::json completionResponseBody(bool chat, const std::string &model, int firstJobId,
+                                          const std::vector<CompletionResult> &results);
+
+} // namespace kolosal
@@ -0,0 +1,32 @@
+#ifndef KOLOSAL_PREFILL_ROUTE_HPP
+#define KOLOSAL_PREFILL_ROUTE_HPP
+
+#include "../route_interface.hpp"
+#include "../../export.hpp"
+#include <string>
+#include <vector>
+
+namespace kolosal
+{
+
+/**
+ * @brief Prefill endpoint of a disaggregated deployment (POST /v1/internal/prefill)
+ *
+ * Registered on prefill nodes by ServerAPI::enableDisaggregation(). Takes an
+ * OpenAI chat or text completion request as a decode node received it, decodes
+ * only its prompt and answers with the sequence's KV state in
+ * RemotePrefill::encode()'s layout (application/octet-stream). Nothing is
+ * generated here; the decode node samples every output token.
+ */
+class KOLOSAL_SERVER_API PrefillRoute : public IRoute
+{
+public:
+    bool match(const std::string& method, const std::string& path) override;
+    std::vector<RoutePattern> patterns() const override;
+    const char* capacityClass() const override { return "chat"; }
+    void handle(SocketType sock, const RequestContext& request) override;
+};
+
+} // namespace kolosal
+
+#endif // KOLOSAL_PREFILL_ROUTE_HPP
@@ -0,0 +1,64 @@
+#ifndef KOLOSAL_SCORE_ROUTE_HPP
+#define KOLOSAL_SCORE_ROUTE_HPP
+
+#include "../route_interface.hpp"
+#include "../../export.hpp"
+#include <string>
+#include <vector>
+
+namespace kolosal
+{
+
+/**
+ * @brief Route handler for score requests
+ *
+ * This route implements the /v1/score endpoint: the log-likelihood of each
+ * continuation given its prompt, token by token, for evaluation harnesses and
+ * candidate ranking. Nothing is generated; the engine decodes the pairs side by
+ * side and keeps logits only where a continuation token is predicted.
+ */
+class KOLOSAL_SERVER_API ScoreRoute : public IRoute
+{
+public:
+    /**
+     * @brief Checks if this route matches the request
+     * @param method HTTP method
+     * @param path Request path
+     * @return true if route matches, false otherwise
+     */
+    bool match(const std::string& method, const std::string& path) override;
+
+    /**
+     * @brief Method and path templates for the server's routing table
+     */
+    std::vector<RoutePattern> patterns() const override;
+    const char* capacityClass() const override { return "chat"; }
+
+    /**
+     * @brief Handles the score request
+     * @param sock Socket for the connection
+     * @param context Method, path, headers and body of the request
+     */
+    void handle(SocketType sock, const RequestContext& context) override;
+
+private:
+    /**
+     * @brief Sends an error response
+     * @param sock Socket connection
+     * @param status_code HTTP status code
+     * @param error_message Error message
+     * @param error_type Error type (default: "invalid_request_error")
+     * @param param Parameter that caused the error (default: empty)
+     */
+    void sendErrorResponse(
+        SocketType sock,
+        int status_code,
+        const std::string& error_message,
+        const std::string& error_type = "invalid_request_error",
+        const std::string& param = ""
+    );
+};
+
+} // namespace kolosal
+
+#endif // KOLOSAL_SCORE_ROUTE_HPP
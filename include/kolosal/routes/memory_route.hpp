@@ -0,0 +1,19 @@
+#ifndef KOLOSAL_MEMORY_ROUTE_HPP
+#define KOLOSAL_MEMORY_ROUTE_HPP
+
+#include "route_interface.hpp"
+
+namespace kolosal {
+
+    // Memory report at /debug/memory; POST /debug/memory/release first hands free allocator
+    // memory back to the OS. Registered with /metrics by ServerAPI::enableMetrics()
+    class MemoryRoute : public IRoute {
+    public:
+        bool match(const std::string& method, const std::string& path) override;
+        std::vector<RoutePattern> patterns() const override;
+        void handle(SocketType sock, const RequestContext& request) override;
+    };
+
+} // namespace kolosal
+
+#endif // KOLOSAL_MEMORY_ROUTE_HPP
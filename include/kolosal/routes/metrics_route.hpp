@@ -0,0 +1,18 @@
+#ifndef KOLOSAL_METRICS_ROUTE_HPP
+#define KOLOSAL_METRICS_ROUTE_HPP
+
+#include "route_interface.hpp"
+
+namespace kolosal {
+
+    // Prometheus scrape endpoint, registered by ServerAPI::enableMetrics()
+    class MetricsRoute : public IRoute {
+    public:
+        bool match(const std::string& method, const std::string& path) override;
+        std::vector<RoutePattern> patterns() const override;
+        void handle(SocketType sock, const RequestContext& request) override;
+    };
+
+} // namespace kolosal
+
+#endif // KOLOSAL_METRICS_ROUTE_HPP
@@ -0,0 +1,22 @@
+#ifndef KOLOSAL_MODEL_FILES_ROUTE_HPP
+#define KOLOSAL_MODEL_FILES_ROUTE_HPP
+
+#include "route_interface.hpp"
+#include <string>
+
+namespace kolosal {
+
+    // Serves this server's downloaded models to peer servers (GET/HEAD /v1/model-files/{name}, with
+    // byte ranges), registered by ServerAPI::enableModelSharing(). Only files whose download manifest
+    // entry is current are offered; their digest and origin URL go out as X-Kolosal-Sha256 and
+    // X-Kolosal-Source-Url so a peer can tell it is the file it wants.
+    class ModelFilesRoute : public IRoute {
+    public:
+        bool match(const std::string& method, const std::string& path) override;
+        std::vector<RoutePattern> patterns() const override;
+        void handle(SocketType sock, const RequestContext& request) override;
+    };
+
+} // namespace kolosal
+
+#endif // KOLOSAL_MODEL_FILES_ROUTE_HPP
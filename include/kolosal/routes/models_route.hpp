@@ -14,8 +14,10 @@ namespace kolosal
      * - GET /models, /v1/models - List all models (including embedding models)
      * - POST /models, /v1/models - Add a new model (supports both LLM and embedding models)
      * - GET /models/{id}, /v1/models/{id} - Get model status
+     * - PUT /models/{id}, /v1/models/{id} - Hot-swap the model behind an ID without downtime
      * - DELETE /models/{id}, /v1/models/{id} - Remove a model
      * - GET /models/{id}/status, /v1/models/{id}/status - Get detailed model status
+     * - GET /models/{id}/profile, /v1/models/{id}/profile - Recent decode steps (when profile_steps is set)
      */
     class KOLOSAL_SERVER_API ModelsRoute : public IRoute
     {
@@ -24,19 +26,18 @@ namespace kolosal
         ~ModelsRoute() override;
 
         bool match(const std::string &method, const std::string &path) override;
-        void handle(SocketType sock, const std::string &body) override;
+        std::vector<RoutePattern> patterns() const override;
+        void handle(SocketType sock, const RequestContext &request) override;
 
     private:
-        // Store the matched path and method to determine operation in handle()
-        mutable std::string matched_path_;
-        mutable std::string matched_method_;
-        
         // Handler methods for different operations
         void handleListModels(SocketType sock, const std::string &body);
         void handleAddModel(SocketType sock, const std::string &body);
         void handleGetModel(SocketType sock, const std::string &body, const std::string &modelId);
+        void handleSwapModel(SocketType sock, const std::string &body, const std::string &modelId);
         void handleRemoveModel(SocketType sock, const std::string &body, const std::string &modelId);
         void handleModelStatus(SocketType sock, const std::string &body, const std::string &modelId);
+        void handleModelProfile(SocketType sock, const std::string &modelId);
 
         // Helper methods
         std::string extractModelIdFromPath(const std::string &path);
@@ -46,6 +47,7 @@ namespace kolosal
         const std::regex modelsPattern_;
         const std::regex modelIdPattern_;
         const std::regex modelStatusPattern_;
+        const std::regex modelProfilePattern_;
     };
 
 } // namespace kolosal
@@ -0,0 +1,25 @@
+#ifndef KOLOSAL_PROFILE_ROUTE_HPP
+#define KOLOSAL_PROFILE_ROUTE_HPP
+
+#include "route_interface.hpp"
+
+namespace kolosal {
+
+    // On-demand profiling of the live process. POST /debug/profile samples the CPU of
+    // every thread for a while and returns folded stacks or a pprof profile; POST
+    // /debug/profile/timeline records a model's decode loop step by step. Registered
+    // with /metrics by ServerAPI::enableMetrics()
+    class ProfileRoute : public IRoute {
+    public:
+        bool match(const std::string& method, const std::string& path) override;
+        std::vector<RoutePattern> patterns() const override;
+        void handle(SocketType sock, const RequestContext& request) override;
+
+    private:
+        void handleCpuProfile(SocketType sock, const RequestContext& request);
+        void handleTimeline(SocketType sock, const RequestContext& request);
+    };
+
+} // namespace kolosal
+
+#endif // KOLOSAL_PROFILE_ROUTE_HPP
@@ -4,10 +4,11 @@
 #include "../route_interface.hpp"
 #include "../../export.hpp"
 #include "../../retrieval/chunking_types.hpp"
+#include "../../models/chunking_request_model.hpp"
+#include "../../models/chunking_response_model.hpp"
 #include <string>
 #include <memory>
 #include <atomic>
-#include <mutex>
 
 namespace kolosal
 {
@@ -40,14 +41,39 @@ public:
      */
     bool match(const std::string& method, const std::string& path) override;
 
+    /**
+     * @brief Method and path templates for the server's routing table
+     */
+    std::vector<RoutePattern> patterns() const override;
+    const char* capacityClass() const override { return "retrieval"; }
+
     /**
      * @brief Handles the chunking request
      * @param sock Socket for the connection
-     * @param body Request body JSON
+     * @param context Method, path, headers and body of the request
      */
-    void handle(SocketType sock, const std::string& body) override;
+    void handle(SocketType sock, const RequestContext& context) override;
 
 private:
+    /**
+     * @brief Chunks one text and counts the tokens of it and its chunks
+     * @param request Chunking parameters
+     * @param text Text to chunk
+     * @return Response for the text; throws if chunking fails
+     */
+    ChunkingResponse chunkText(const ChunkingRequest& request, const std::string& text);
+
+    /**
+     * @brief Chunks several texts concurrently on the task executor
+     * @param sock Socket for the connection
+     * @param context The request, for its Accept header
+     * @param request Chunking parameters with texts (or the single text) to chunk
+     * @param requestId Id used in logs
+     * @param stream Emit each text's chunks as NDJSON/SSE records as soon as the text is done
+     */
+    void handleBatch(SocketType sock, const RequestContext& context, ChunkingRequest& request,
+                     const std::string& requestId, bool stream);
+
     /**
      * @brief Processes regular chunking request
      * @param request Chunking request parameters
@@ -90,13 +116,6 @@ private:
         const std::string& param = ""
     );
 
-    /**
-     * @brief Estimates token count for text
-     * @param text Input text
-     * @return Estimated token count
-     */
-    int estimateTokenCount(const std::string& text) const;
-
     /**
      * @brief Validates that the model can be used for chunking
      * @param model_name Name of the model to validate
@@ -113,8 +132,6 @@ private:
     // Private members
     std::unique_ptr<retrieval::ChunkingService> chunking_service_;
     std::atomic<uint64_t> request_counter_;
-    std::mutex service_mutex_;
-    std::string current_method_;
 };
 
 } // namespace kolosal
@@ -15,11 +15,20 @@ namespace kolosal
  * @brief Combined route handler for document operations
  * 
  * This route implements multiple document endpoints:
- * - POST /add_documents - Add documents to vector database
+ * - POST /add_documents - Add documents to vector database ("async": true queues a job)
+ * - POST /import_vectors - Add documents with precomputed vectors, from binary frames
+ * - GET /add_documents/jobs - List ingestion jobs
+ * - GET /add_documents/jobs/{id} - Ingestion job progress (?stream=true for server-sent events)
+ * - DELETE /add_documents/jobs/{id} - Cancel an ingestion job
  * - POST /remove_documents - Remove documents by IDs
  * - GET /list_documents - List all document IDs
  * - POST /info_documents - Get full document information by IDs
  * - POST /retrieve - Retrieve documents using vector similarity search
+ * - POST /rag - Retrieve, assemble a prompt from the results and generate an answer in one request
+ * - GET /replication/snapshot - Stream a snapshot of the documents collection
+ * - POST /replication/snapshot - Replace the documents collection with a snapshot
+ * - GET /replication/changes - Change stream records after a position, for replicas
+ * - GET /replication/status - Whether this server is a replica, and how far behind its source
  * 
  * All implementations are fully async and thread-safe.
  */
@@ -44,48 +53,141 @@ public:
      */
     bool match(const std::string& method, const std::string& path) override;
 
+    /**
+     * @brief Method and path templates for the server's routing table
+     */
+    std::vector<RoutePattern> patterns() const override;
+    const char* capacityClass() const override { return "retrieval"; }
+
+    /**
+     * @brief Large /add_documents, /import_vectors and snapshot uploads are read while they arrive
+     */
+    bool streamsBody() const override { return true; }
+
     /**
      * @brief Handles the document request based on the endpoint
      * @param sock Socket for the connection
-     * @param body Request body JSON
+     * @param request Method, path, headers and body of the request
      */
-    void handle(SocketType sock, const std::string& body) override;
+    void handle(SocketType sock, const RequestContext& request) override;
 
 private:
     /**
      * @brief Handles add documents request
      * @param sock Socket for the connection
-     * @param body Request body JSON
+     * @param body Request body, when the server buffered it
+     * @param bodyStream Request body still arriving, for large uploads (nullptr otherwise)
+     */
+    void handleAddDocuments(SocketType sock, const std::string& body, RequestBody* bodyStream);
+
+    /**
+     * @brief Handles a bulk import of documents that bring their own vectors
+     * 
+     * Reads the body as VectorImportReader frames (?dimensions=N, ?dtype=f32|f16)
+     * and hands each to DocumentService::importVectors while the next is read,
+     * so memory holds about two frames whatever the body size.
+     * @param sock Socket for the connection
+     * @param request Method, path, headers and body of the request
+     */
+    void handleImportVectors(SocketType sock, const RequestContext& request);
+
+    /**
+     * @brief Streams a snapshot of the documents collection as it is read from disk
+     * @param sock Socket for the connection
+     */
+    void handleExportSnapshot(SocketType sock);
+
+    /**
+     * @brief Replaces the documents collection with an uploaded snapshot
+     * @param sock Socket for the connection
+     * @param request Method, path, headers and body of the request
+     */
+    void handleImportSnapshot(SocketType sock, const RequestContext& request);
+
+    /**
+     * @brief Sends change stream records after ?epoch=&position= (at most ?max_bytes=)
+     *
+     * The body is the raw records; X-Replication-Position holds where the next
+     * request continues and X-Replication-End where the stream currently ends.
+     * Answers 410 when the position is gone and the replica needs a new snapshot.
+     * @param sock Socket for the connection
+     * @param request Method, path, headers and body of the request
+     */
+    void handleChanges(SocketType sock, const RequestContext& request);
+
+    /**
+     * @brief Reports the replication role and, on a replica, its progress
+     * @param sock Socket for the connection
      */
-    void handleAddDocuments(SocketType sock, const std::string& body);
+    void handleReplicationStatus(SocketType sock);
+
+    /**
+     * @brief Lists asynchronous ingestion jobs
+     * @param sock Socket for the connection
+     */
+    void handleListIngestionJobs(SocketType sock);
+
+    /**
+     * @brief Reports an ingestion job's progress, once or as a server-sent event stream
+     * @param sock Socket for the connection
+     * @param job_id Job to report
+     * @param stream Keep the connection open and send an event on every change until the job finishes
+     */
+    void handleIngestionJob(SocketType sock, const std::string& job_id, bool stream);
+
+    /**
+     * @brief Cancels an ingestion job
+     * @param sock Socket for the connection
+     * @param job_id Job to cancel
+     */
+    void handleCancelIngestionJob(SocketType sock, const std::string& job_id);
 
     /**
      * @brief Handles remove documents request
      * @param sock Socket for the connection
-     * @param body Request body JSON
+     * @param request Method, path, headers and body of the request
      */
     void handleRemoveDocuments(SocketType sock, const std::string& body);
 
     /**
      * @brief Handles list documents request
+     *
+     * With limit or cursor in the query string one page is returned; otherwise every ID is
+     * streamed page by page, as chunked JSON or, for format=ndjson, one line per ID.
      * @param sock Socket for the connection
+     * @param request Method, path, headers and body of the request
      */
-    void handleListDocuments(SocketType sock);
+    void handleListDocuments(SocketType sock, const RequestContext& request);
 
     /**
      * @brief Handles documents info request
      * @param sock Socket for the connection
-     * @param body Request body JSON
+     * @param request Method, path, headers and body of the request
      */
     void handleDocumentsInfo(SocketType sock, const std::string& body);
 
     /**
      * @brief Handles retrieve documents request (vector similarity search)
      * @param sock Socket for the connection
-     * @param body Request body JSON
+     * @param request Method, path, headers and body of the request
      */
     void handleRetrieve(SocketType sock, const std::string& body);
 
+    /**
+     * @brief Handles a retrieval-augmented generation request
+     * 
+     * Retrieves like /retrieve, places the documents in the system message in a
+     * fixed order (by ID, so the same documents always give the same prompt and
+     * reuse the model's prefix cache), then runs a chat completion with the query
+     * as the last user message. Streams chat.completion.chunk events when
+     * "stream" is set. Each stage's latency is reported under "timings".
+     * 
+     * @param sock Socket for the connection
+     * @param body Retrieve fields plus "model", optional "system", "messages" and sampling fields
+     * @param subject Tenant charged for the generated tokens
+     */
+    void handleRag(SocketType sock, const std::string& body, const std::string& subject);
+
     /**
      * @brief Handles OPTIONS requests for CORS preflight
      * @param sock Socket for the connection
@@ -112,9 +214,7 @@ private:
 
     static std::atomic<long long> request_counter_;
     std::unique_ptr<kolosal::retrieval::DocumentService> document_service_;
-    std::mutex service_mutex_;
-    std::string current_endpoint_;
-    std::string current_method_;
+    std::mutex service_mutex_;  // Guards the lazy creation of document_service_
 };
 
 } // namespace kolosal
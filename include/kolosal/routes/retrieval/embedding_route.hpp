@@ -8,12 +8,13 @@
 #include <future>
 #include <vector>
 #include <atomic>
-#include <mutex>
 
 namespace kolosal
 {
 
 class CompletionMonitor;
+class EmbeddingRequest;
+class EmbeddingResponse;
 
 /**
  * @brief Route handler for embedding requests
@@ -21,6 +22,15 @@ class CompletionMonitor;
  * This route implements the /v1/embeddings endpoint following the OpenAI embeddings API.
  * It supports both single text and batch text embedding requests.
  * The implementation is fully async and thread-safe.
+ *
+ * Clients on the Unix socket listener can send an X-Kolosal-Shm-Ring header
+ * naming a ShmRing; the vectors are then copied into it as float32 and the
+ * response only says where.
+ *
+ * With "stream": true (or Accept: application/x-ndjson) the inputs are embedded
+ * a chunk at a time and each embedding goes out as an NDJSON line, tagged with
+ * its index, once its chunk is done, so neither the server nor the client holds
+ * the whole batch.
  */
 class KOLOSAL_SERVER_API EmbeddingRoute : public IRoute
 {
@@ -43,12 +53,23 @@ public:
      */
     bool match(const std::string& method, const std::string& path) override;
 
+    /**
+     * @brief Method and path templates for the server's routing table
+     */
+    std::vector<RoutePattern> patterns() const override;
+    const char* capacityClass() const override { return "embeddings"; }
+
+    /**
+     * @brief Large embedding batches are parsed while they arrive
+     */
+    bool streamsBody() const override { return true; }
+
     /**
      * @brief Handles the embedding request
      * @param sock Socket for the connection
-     * @param body Request body JSON
+     * @param context Method, path, headers and body of the request
      */
-    void handle(SocketType sock, const std::string& body) override;
+    void handle(SocketType sock, const RequestContext& context) override;
 
 private:
     /**
@@ -65,11 +86,11 @@ private:
     );
 
     /**
-     * @brief Processes multiple embedding requests in parallel
+     * @brief Processes multiple embedding requests as a single engine batch
      * @param input_texts Vector of texts to embed
      * @param model Model name
      * @param request_id Base request ID for monitoring
-     * @return Vector of futures containing embedding vectors
+     * @return Vector of already-resolved futures containing embedding vectors
      */
     std::vector<std::future<std::vector<float>>> processEmbeddingsBatch(
         const std::vector<std::string>& input_texts,
@@ -78,7 +99,7 @@ private:
     );
 
     /**
-     * @brief Estimates the number of tokens in a text string
+     * @brief Estimates the number of tokens in a text string when the model cannot count them
      * @param text Input text
      * @return Estimated token count
      */
@@ -107,14 +128,27 @@ private:
         const std::string& param = ""
     );
 
+    /**
+     * @brief Writes the embeddings into a client's shared-memory ring and answers with their location
+     * @param ringName Name from the X-Kolosal-Shm-Ring header
+     */
+    void sendToRing(SocketType sock, const RequestContext& context, const std::string& ringName,
+                    const EmbeddingResponse& response);
+
+    /**
+     * @brief Embeds the inputs a chunk at a time and streams each chunk as NDJSON lines
+     *
+     * The next chunk is embedded while the previous one is sent. Failures after the
+     * 200 header went out are reported as an "error" line.
+     */
+    void streamEmbeddings(SocketType sock, const EmbeddingRequest& request, std::vector<std::string> inputTexts,
+                          int promptTokens, const std::string& requestId);
+
     // Thread-safe monitoring
     CompletionMonitor* monitor_;
     
     // Request counter for unique IDs
     std::atomic<uint64_t> request_counter_;
-    
-    // Mutex for thread safety
-    mutable std::mutex route_mutex_;
 };
 
 } // namespace kolosal
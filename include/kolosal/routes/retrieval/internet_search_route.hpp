@@ -3,16 +3,24 @@
 
 #include "../route_interface.hpp"
 #include "../../server_config.hpp"
+#include <chrono>
+#include <functional>
 #include <future>
+#include <list>
 #include <memory>
 #include <mutex>
 #include <queue>
+#include <unordered_map>
 #include <condition_variable>
 #include <atomic>
 #include <thread>
 
 namespace kolosal {
 
+    namespace retrieval {
+        class ChunkingService;
+    }
+
     struct SearchRequest {
         std::string query;
         std::string engines;
@@ -22,6 +30,14 @@ namespace kolosal {
         int results = 20;
         bool safe_search = true;
         int timeout = 30;
+
+        // Fetch the top result pages and return their text along with the results
+        int fetch_pages = 0;            // 0 = search only
+        int fetch_timeout = 10;         // Seconds per page
+        int chunk_size = 0;             // Split each page's text into chunks of this many words (0 = whole text)
+        int overlap = 0;
+        std::string embedding_model;    // Embed the chunks with this model (requires chunk_size)
+        bool stream = false;            // Server-sent events, one per page as it completes
         
         SearchRequest() = default;
     };
@@ -35,12 +51,23 @@ namespace kolosal {
         SearchResult() = default;
     };
 
+    struct FetchedPage {
+        std::string url;
+        std::string title;
+        bool success = false;
+        int status_code = 0;
+        std::string text;
+        std::string error_message;
+        double elapsed_ms = 0.0;
+    };
+
     struct HttpSearchRequest {
         std::string url;
         std::string method = "GET";
         std::map<std::string, std::string> headers;
         std::string body;
         int timeout = 30;
+        std::string cache_key;      // Normalized request, for coalescing and the result cache
         std::shared_ptr<std::promise<SearchResult>> promise;
     };
 
@@ -51,15 +78,35 @@ namespace kolosal {
         std::condition_variable queue_cv_;
         std::queue<std::shared_ptr<HttpSearchRequest>> request_queue_;
         std::atomic<bool> shutdown_{false};
+        std::once_flag workers_started_;    // Workers start with the first search, not at startup
         std::vector<std::thread> worker_threads_;
+        std::unique_ptr<retrieval::ChunkingService> chunking_service_;
+
+        // Successful results by normalized request, most recently used first
+        struct CachedSearch {
+            std::string key;
+            std::string body;
+            std::chrono::steady_clock::time_point expires;
+        };
+        std::mutex cache_mutex_;    // Taken before queue_mutex_ when both are held
+        std::list<CachedSearch> cache_lru_;
+        std::unordered_map<std::string, std::list<CachedSearch>::iterator> cache_;
+        // Requests on their way to SearXNG; identical ones arriving meanwhile share the result
+        std::unordered_map<std::string, std::shared_future<SearchResult>> in_flight_;
         
         void startWorkerThreads();
         void stopWorkerThreads();
         void workerLoop();
         std::future<SearchResult> makeHttpRequest(const std::string& url, 
                                                   const std::map<std::string, std::string>& headers = {},
-                                                  int timeout = 30);
+                                                  int timeout = 30,
+                                                  const std::string& cache_key = "");
+        void completeRequest(const std::string& cache_key, const SearchResult& result);
         std::string buildSearchUrl(const SearchRequest& request);
+        std::string cacheKey(const SearchRequest& request);
+        void handleFetchPages(SocketType sock, const SearchRequest& request, const std::string& search_body);
+        static void fetchPages(std::vector<FetchedPage>& pages, int timeout_seconds,
+                               const std::function<void(FetchedPage&)>& on_complete);
         SearchRequest parseRequestBody(const std::string& body);
         std::string validateRequest(const SearchRequest& request);
         
@@ -71,7 +118,9 @@ namespace kolosal {
         ~InternetSearchRoute();
         
         bool match(const std::string& method, const std::string& path) override;
-        void handle(SocketType sock, const std::string& body) override;
+        std::vector<RoutePattern> patterns() const override;
+        const char* capacityClass() const override { return "retrieval"; }
+        void handle(SocketType sock, const RequestContext& request) override;
     };
 
 } // namespace kolosal
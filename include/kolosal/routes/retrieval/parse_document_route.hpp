@@ -2,9 +2,9 @@
 #define KOLOSAL_PARSE_DOCUMENT_ROUTE_HPP
 
 #include "../route_interface.hpp"
+#include "../../request_body.hpp"
 #include <json.hpp>
 #include <string>
-#include <mutex>
 #include <thread>
 
 namespace kolosal
@@ -13,26 +13,33 @@ namespace kolosal
     {
     public:
         bool match(const std::string &method, const std::string &path) override;
-        void handle(SocketType sock, const std::string &body) override;
+        std::vector<RoutePattern> patterns() const override;
+        const char* capacityClass() const override { return "parsing"; }
+        void handle(SocketType sock, const RequestContext &request) override;
+        // Base64 documents can be hundreds of MB, so large uploads are parsed as they arrive
+        bool streamsBody() const override { return true; }
 
     private:
+        static constexpr size_t kMaxBatchFiles = 256;
+
         enum class DocumentType {
             PDF,
             DOCX,
             HTML
         };
 
-        // Thread-local storage for current path
-        static thread_local std::string current_path_;
-        mutable std::mutex path_mutex_;
-
         DocumentType getDocumentType(const std::string &path);
         std::string getDataKey(DocumentType type);
         std::string getLogPrefix(DocumentType type);
         void sendJsonResponse(SocketType sock, const nlohmann::json &response, int status_code = 200);
         bool parseRequest(const std::string &body, nlohmann::json &request, SocketType sock);
-        bool validateDocumentData(const nlohmann::json &request, const std::string &data_key, SocketType sock);
-        std::vector<unsigned char> decodeBase64Data(const std::string &base64_data, SocketType sock);
+        bool parseStreamedRequest(RequestBody &body, nlohmann::json &request, SocketType sock);
+        bool validateDocumentData(const nlohmann::json &request, const std::string &data_key, nlohmann::json &error_response);
+        std::vector<unsigned char> decodeBase64Data(const std::string &base64_data, nlohmann::json &error_response);
+        // Parses one document into its response body; returns the status it is answered with
+        int parseDocument(DocumentType type, nlohmann::json &payload, nlohmann::json &response);
+        // "files": [...] requests; documents are parsed concurrently and can be streamed as records
+        void handleBatch(SocketType sock, const RequestContext &request, DocumentType type, nlohmann::json &payload);
         void sendOptionsResponse(SocketType sock, const std::string &endpoint_name, const std::string &description);
     };
 
@@ -0,0 +1,136 @@
+#ifndef KOLOSAL_RECORD_STREAM_HPP
+#define KOLOSAL_RECORD_STREAM_HPP
+
+#include "../route_interface.hpp"
+#include "../../utils.hpp"
+#include <json.hpp>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+
+namespace kolosal
+{
+
+/**
+ * @brief Results that tasks on the TaskExecutor hand back as they finish
+ *
+ * Held by a shared_ptr so tasks still running after the handler gave up
+ * (the client went away) have somewhere to put their result.
+ */
+template <typename T>
+class CompletionQueue
+{
+public:
+    void push(T value)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            items_.push_back(std::move(value));
+        }
+        ready_.notify_one();
+    }
+
+    // Waits for the next finished result
+    T pop()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        ready_.wait(lock, [this]() { return !items_.empty(); });
+        T value = std::move(items_.front());
+        items_.pop_front();
+        return value;
+    }
+
+    // Next finished result, if one is waiting
+    bool tryPop(T& value)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (items_.empty())
+        {
+            return false;
+        }
+        value = std::move(items_.front());
+        items_.pop_front();
+        return true;
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable ready_;
+    std::deque<T> items_;
+};
+
+/**
+ * @brief Streamed response of JSON records, one written as soon as each is ready
+ *
+ * NDJSON by default, or server-sent events when the client accepts
+ * text/event-stream. Must be used from the handler's own thread, which owns
+ * the response state of the connection.
+ */
+class RecordStream
+{
+public:
+    // Whether the client asked for records: "stream": true in the body, or an NDJSON or SSE Accept header
+    static bool requested(const RequestContext& context, const nlohmann::json& body)
+    {
+        if (body.is_object() && body.contains("stream") && body["stream"].is_boolean())
+        {
+            return body["stream"].get<bool>();
+        }
+        auto accept = context.headers.find("accept");
+        return accept != context.headers.end() &&
+               (accept->second.find("application/x-ndjson") != std::string::npos ||
+                accept->second.find("text/event-stream") != std::string::npos);
+    }
+
+    RecordStream(SocketType sock, const RequestContext& context)
+        : sock_(sock)
+    {
+        auto accept = context.headers.find("accept");
+        sse_ = accept != context.headers.end() && accept->second.find("text/event-stream") != std::string::npos;
+        begin_streaming_response(sock_, 200, {
+            {"Content-Type", sse_ ? "text/event-stream" : "application/x-ndjson"},
+            {"Access-Control-Allow-Origin", "*"},
+            {"Access-Control-Allow-Methods", "POST, OPTIONS"},
+            {"Access-Control-Allow-Headers", "Content-Type, Authorization, X-API-Key"}
+        });
+    }
+
+    // Sends a record at once; false once the client has gone away
+    bool send(const nlohmann::json& record)
+    {
+        if (closed_)
+        {
+            return false;
+        }
+        if (client_disconnected(sock_))
+        {
+            closed_ = true;
+            return false;
+        }
+        send_stream_chunk(sock_, StreamChunk(frame(record), false));
+        return true;
+    }
+
+    // Sends the last record and ends the response
+    void finish(const nlohmann::json& record)
+    {
+        send_stream_chunk(sock_, StreamChunk(closed_ ? std::string() : frame(record), true));
+        closed_ = true;
+    }
+
+private:
+    std::string frame(const nlohmann::json& record) const
+    {
+        return sse_ ? "data: " + record.dump() + "\n\n" : record.dump() + "\n";
+    }
+
+    SocketType sock_;
+    bool sse_ = false;
+    bool closed_ = false;
+};
+
+} // namespace kolosal
+
+#endif // KOLOSAL_RECORD_STREAM_HPP
@@ -0,0 +1,63 @@
+#ifndef KOLOSAL_RERANK_ROUTE_HPP
+#define KOLOSAL_RERANK_ROUTE_HPP
+
+#include "../route_interface.hpp"
+#include "../../export.hpp"
+#include <string>
+#include <vector>
+
+namespace kolosal
+{
+
+/**
+ * @brief Route handler for rerank requests
+ *
+ * This route implements the /v1/rerank endpoint: documents are scored against a
+ * query by a cross-encoder loaded with model_type "rerank". All query-document
+ * pairs go to the engine as one batch, and only the top_n best are sorted.
+ */
+class KOLOSAL_SERVER_API RerankRoute : public IRoute
+{
+public:
+    /**
+     * @brief Checks if this route matches the request
+     * @param method HTTP method
+     * @param path Request path
+     * @return true if route matches, false otherwise
+     */
+    bool match(const std::string& method, const std::string& path) override;
+
+    /**
+     * @brief Method and path templates for the server's routing table
+     */
+    std::vector<RoutePattern> patterns() const override;
+    const char* capacityClass() const override { return "embeddings"; }
+
+    /**
+     * @brief Handles the rerank request
+     * @param sock Socket for the connection
+     * @param context Method, path, headers and body of the request
+     */
+    void handle(SocketType sock, const RequestContext& context) override;
+
+private:
+    /**
+     * @brief Sends an error response
+     * @param sock Socket connection
+     * @param status_code HTTP status code
+     * @param error_message Error message
+     * @param error_type Error type (default: "invalid_request_error")
+     * @param param Parameter that caused the error (default: empty)
+     */
+    void sendErrorResponse(
+        SocketType sock,
+        int status_code,
+        const std::string& error_message,
+        const std::string& error_type = "invalid_request_error",
+        const std::string& param = ""
+    );
+};
+
+} // namespace kolosal
+
+#endif // KOLOSAL_RERANK_ROUTE_HPP
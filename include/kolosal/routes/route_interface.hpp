@@ -2,7 +2,9 @@
 
 #include "../export.hpp"
 
+#include <map>
 #include <string>
+#include <vector>
 
 #ifdef _WIN32
 #include <winsock2.h>
@@ -13,12 +15,56 @@ using SocketType = SOCKET;
 using SocketType = int;
 #endif
 
+// A method and path template a route answers to, used to build the server's routing table.
+// Segments written as {name} match any single segment; a trailing * matches the rest of the
+// path. Method "*" matches every method.
+struct RoutePattern {
+    std::string method;
+    std::string path;
+};
+
+namespace kolosal { class RequestBody; }
+
+// Everything a handler needs about one request. Routes are shared by every connection
+// thread, so per-request data travels here instead of in route members.
+struct RequestContext {
+    const std::string& method;
+    const std::string& path;                            // Includes the query string, if any
+    const std::map<std::string, std::string>& headers;  // Lowercase names
+    std::map<std::string, std::string> params;          // {name} segments of the matched pattern
+    const std::string& body;                            // Owned by the connection, valid during handle()
+    kolosal::RequestBody* bodyStream = nullptr;         // Set instead of body for large uploads to routes
+                                                        // whose streamsBody() is true; see request_body.hpp
+    std::string clientIP;                               // Peer address of the connection
+    bool unixSocket = false;                            // Arrived on the Unix domain socket listener, so the
+                                                        // client is on this host (see ShmRing)
+
+    // Value of a {name} path segment, or "" if the pattern had none
+    std::string param(const std::string& name) const {
+        auto it = params.find(name);
+        return it != params.end() ? it->second : std::string();
+    }
+};
+
 class KOLOSAL_SERVER_API IRoute {
 public:
-    // Returns true if this route should handle the given method and path.
+    // Returns true if this route should handle the given method and path. Must not
+    // keep anything about the request; handle() gets it again through the context.
     virtual bool match(const std::string& method,
         const std::string& path) = 0;
-    // Handle the request. The body contains the payload (if any).
-    virtual void handle(SocketType sock, const std::string& body) = 0;
+    // Requests this route may accept. match() is only called for requests that fit one of
+    // them; a route returning none is asked about every request.
+    virtual std::vector<RoutePattern> patterns() const { return {}; }
+    // True if handle() can consume a large body while it is still arriving (through
+    // RequestContext::bodyStream) instead of having the server buffer all of it.
+    virtual bool streamsBody() const { return false; }
+    // Which of the server's capacity partitions (ServerOptions::classBulkheads) the route's
+    // requests are handled in: "chat", "embeddings", "retrieval", "parsing" or "admin".
+    virtual const char* capacityClass() const { return "admin"; }
+    // Handle the request. May run on several threads at once.
+    virtual void handle(SocketType sock, const RequestContext& request) = 0;
+    // Called once when the server stops, before it waits for in-flight handlers. Routes whose
+    // handlers keep a connection open indefinitely (e.g. WebSocket sessions) end them here.
+    virtual void stop() {}
     virtual ~IRoute() {}
 };
\ No newline at end of file
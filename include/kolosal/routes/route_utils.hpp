@@ -0,0 +1,58 @@
+#pragma once
+
+#include "route_interface.hpp"
+#include "../utils.hpp"
+#include "../server_api.hpp"
+#include "../auth/auth_middleware.hpp"
+
+#include <json.hpp>
+#include <string>
+
+namespace kolosal {
+
+// Sends an OpenAI-style error body: {"error": {"message", "type", "param", "code"}}
+inline void send_error_response(SocketType sock, int status, const std::string& message,
+                                const std::string& type = "invalid_request_error") {
+    nlohmann::json jError = {{"error", {{"message", message}, {"type", type}, {"param", nullptr}, {"code", nullptr}}}};
+    send_response(sock, status, jError.dump());
+}
+
+// 429 for a request that would take its tenant over a token quota
+inline void send_quota_exceeded(SocketType sock, const auth::TokenQuota::Reservation& reservation) {
+    const std::string message = reservation.scope == "model"
+                                    ? "Token quota for model '" + reservation.model + "' exceeded, retry later"
+                                    : "Token quota exceeded, retry later";
+    nlohmann::json jError = {{"error", {{"message", message}, {"type", "rate_limit_exceeded"}, {"param", nullptr}, {"code", "token_quota_exceeded"}}}};
+    send_response(sock, 429, jError.dump(),
+                  {{"Content-Type", "application/json"},
+                   {"Retry-After", std::to_string(reservation.retryAfter.count())},
+                   {"X-RateLimit-Limit-Tokens", std::to_string(reservation.limit)}});
+}
+
+// Tenant a request acts for: its API key, or its client IP without one (see auth::TokenQuota::subjectFor)
+inline std::string request_subject(const RequestContext& request) {
+    return auth::TokenQuota::subjectFor(ServerAPI::instance().getAuthMiddleware().extractApiKey(request.headers),
+                                        request.clientIP);
+}
+
+// The path of a request target without its query string
+inline std::string strip_query(const std::string& path) {
+    return path.substr(0, path.find('?'));
+}
+
+// Raw value of a query string parameter (not percent-decoded), or "" if it is absent
+inline std::string query_param(const std::string& path, const std::string& name) {
+    size_t pos = path.find('?');
+    while (pos != std::string::npos) {
+        ++pos;
+        const size_t end = path.find('&', pos);
+        if (path.compare(pos, name.size(), name) == 0 && pos + name.size() < path.size() && path[pos + name.size()] == '=') {
+            const size_t value = pos + name.size() + 1;
+            return path.substr(value, end == std::string::npos ? std::string::npos : end - value);
+        }
+        pos = end;
+    }
+    return std::string();
+}
+
+} // namespace kolosal
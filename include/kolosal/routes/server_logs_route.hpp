@@ -11,6 +11,7 @@ namespace kolosal
     {
     public:
         bool match(const std::string &method, const std::string &path) override;
-        void handle(SocketType sock, const std::string &body) override;
+        std::vector<RoutePattern> patterns() const override;
+        void handle(SocketType sock, const RequestContext &request) override;
     };
 } // namespace kolosal
@@ -3,24 +3,54 @@
 
 #include "route_interface.hpp"
 
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+
 namespace kolosal {
 
     class UIRoute : public IRoute {
     public:
+        // The dashboard and playground files are loaded into memory by the first UI request
+        UIRoute();
+
         bool match(const std::string& method, const std::string& path) override;
-        void handle(SocketType sock, const std::string& body) override;
-    
+        std::vector<RoutePattern> patterns() const override;
+        void handle(SocketType sock, const RequestContext& request) override;
+
     private:
-        std::string current_method_;
-        std::string current_path_;
-        
+        // A static file held in memory with everything needed to answer for it
+        struct StaticAsset {
+            std::string content;
+            std::string gzip;                       // Precompressed variant, empty if not worth it
+            std::string etag;                       // Strong, quoted; the gzip variant appends "-gz"
+            std::string contentType;
+            std::string cacheControl;
+            std::filesystem::path fullPath;
+            std::filesystem::file_time_type modified;
+            uintmax_t size = 0;
+            mutable std::atomic<int64_t> recheckAfterMs{0};  // Steady clock; disk is not looked at before
+        };
+
         // Helper methods
-        std::string getContentType(const std::string& filePath);
-        std::string readStaticFile(const std::string& relativePath);
-        void serveStaticFile(SocketType sock, const std::string& filePath, const std::string& contentType);
+        static std::string resolveFile(const std::string& path);
+        static std::string getContentType(const std::string& filePath);
+        static std::filesystem::path staticPath(const std::string& relativePath);
+        static std::shared_ptr<const StaticAsset> loadAsset(const std::filesystem::path& fullPath);
+        void preload();
+        std::shared_ptr<const StaticAsset> getAsset(const std::string& relativePath);
+        void serveStaticFile(SocketType sock, const RequestContext& request, const std::string& filePath);
         void serve404(SocketType sock);
+
+        std::once_flag preloadOnce_;
+        std::shared_mutex cacheMutex_;
+        std::unordered_map<std::string, std::shared_ptr<const StaticAsset>> cache_;
     };
 
 } // namespace kolosal
 
-#endif // KOLOSAL_UI_ROUTES_HPP
\ No newline at end of file
+#endif // KOLOSAL_UI_ROUTES_HPP
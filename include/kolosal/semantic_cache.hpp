@@ -0,0 +1,135 @@
+#pragma once
+
+#include "export.hpp"
+#include "response_cache.hpp"
+#include "server_config.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace kolosal
+{
+
+/**
+ * @brief Process-wide cache of chat answers, looked up by meaning rather than exact text
+ *
+ * Complements ResponseCache for questions that are paraphrases of each other.
+ * The caller embeds the final user message (normalized, so inner product is
+ * cosine similarity) and passes a context key covering everything else that
+ * shapes the answer: the earlier messages, system prompt included, and the
+ * generation parameters. Answers are grouped by model and a SHA-256 of that
+ * context, each group searched through its own small flat inner-product FAISS
+ * index (a plain scan without FAISS), and the nearest one at or above the
+ * threshold is a hit.
+ *
+ * The cache holds at most max_entries answers, least recently used dropped
+ * first, and they expire with response_cache.ttl_seconds. Swapping or removing
+ * a model invalidates its answers the way ResponseCache does.
+ *
+ * Thread-safe.
+ */
+class KOLOSAL_SERVER_API SemanticCache
+{
+public:
+    struct Stats
+    {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;     // Dropped to stay within max_entries
+        uint64_t expirations = 0;   // Found past their TTL
+        size_t entries = 0;
+        size_t bytes = 0;
+    };
+
+    static SemanticCache& instance();
+
+    /**
+     * @brief Apply the configuration and drop every entry
+     */
+    void configure(const ResponseCacheConfig& config);
+
+    bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Embedding engine the caller encodes messages with
+     */
+    std::string embeddingModel() const;
+
+    /**
+     * @brief Generation of a model's entries; read before generating and pass it to put()
+     */
+    uint64_t generation(const std::string& model_id) const;
+
+    /**
+     * @brief Stored answer nearest to a message in the same context, or nullptr below the threshold
+     * @param similarity Set to the hit's cosine similarity
+     */
+    std::shared_ptr<const ResponseCache::Response> get(const std::string& model_id, const std::string& context,
+                                                       const std::vector<float>& embedding, float* similarity = nullptr);
+
+    /**
+     * @brief Remember an answer; ignored if the model was invalidated since @p generation or the entry is too large
+     */
+    void put(const std::string& model_id, const std::string& context, uint64_t generation,
+             std::vector<float> embedding, ResponseCache::Response response);
+
+    /**
+     * @brief Drop a model's entries, called when the engine behind the id changes or goes away
+     */
+    void invalidateModel(const std::string& model_id);
+
+    Stats stats() const;
+
+private:
+    class Group;
+
+    struct Entry
+    {
+        uint64_t id = 0;
+        std::string group;
+        std::string model_id;
+        std::shared_ptr<const ResponseCache::Response> response;
+        std::chrono::steady_clock::time_point expires;
+        size_t bytes = 0;
+    };
+
+    SemanticCache();
+    ~SemanticCache();
+    SemanticCache(const SemanticCache&) = delete;
+    SemanticCache& operator=(const SemanticCache&) = delete;
+
+    static std::string groupKey(const std::string& model_id, const std::string& context);
+    void eraseLocked(std::list<Entry>::iterator it);
+
+    std::atomic<bool> enabled_{false};
+
+#pragma warning(push)
+#pragma warning(disable: 4251)
+    mutable std::mutex mutex_;
+    std::string embedding_model_;
+    float threshold_ = 0.95f;
+    size_t max_entries_ = 10000;
+    size_t entry_limit_ = 256ULL * 1024;
+    std::chrono::seconds ttl_{600};
+    std::list<Entry> lru_;              // Most recently used first
+    std::unordered_map<uint64_t, std::list<Entry>::iterator> entries_;
+    std::unordered_map<std::string, std::unique_ptr<Group>> groups_;
+    std::unordered_map<std::string, uint64_t> generations_;
+    uint64_t next_generation_ = 0;
+    uint64_t next_id_ = 0;
+    size_t bytes_ = 0;
+#pragma warning(pop)
+
+    std::atomic<uint64_t> hits_{0};
+    std::atomic<uint64_t> misses_{0};
+    std::atomic<uint64_t> evictions_{0};
+    std::atomic<uint64_t> expirations_{0};
+};
+
+} // namespace kolosal
@@ -1,13 +1,20 @@
 #pragma once
 
 #include "routes/route_interface.hpp"
+#include "route_table.hpp"
 #include "auth/auth_middleware.hpp"
+#include "tls.hpp"
 #include "export.hpp"
 
+#include <functional>
+#include <map>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <memory>
 #include <atomic>
+#include <mutex>
+#include <condition_variable>
 
 #ifdef _WIN32
 #include <winsock2.h>
@@ -20,31 +27,161 @@ using SocketType = int;
 
 namespace kolosal {
 
+    class WorkerPool;
+
+    /**
+     * @brief Handler threads set aside for one class of requests or one model
+     */
+    struct BulkheadOptions {
+        int maxConcurrent = 1;              // Requests handled at once, each on a thread of the partition
+        int maxQueued = 0;                  // Requests waiting beyond those before new ones get 503 (0 = unbounded)
+    };
+
+    /**
+     * @brief Tuning knobs for the connection layer.
+     *
+     * Connections are multiplexed over a small set of I/O threads driven by
+     * EventLoop; completed requests are handed to an elastic WorkerPool that
+     * runs the (blocking) route handlers.
+     */
+    struct ServerOptions {
+        int ioThreads = 0;                  // Event-loop threads (0 = auto)
+        int acceptThreads = 0;              // Accepting threads, each on its own SO_REUSEPORT listener on Linux (0 = one per I/O thread on Linux, else 1)
+        int drainTimeoutSeconds = 30;       // How long drain() waits for in-flight requests
+        int minWorkerThreads = 0;           // Handler threads kept alive (0 = auto)
+        int maxWorkerThreads = 512;         // Upper bound on concurrent handlers
+        int requestTimeoutSeconds = 30;     // Drop connections that stall while sending a request
+        int keepAliveTimeoutSeconds = 5;    // Close persistent connections idle for this long (0 disables keep-alive)
+        int maxKeepAliveRequests = 100;     // Requests served on one connection before it is closed
+        size_t maxHeaderBytes = 16384;      // Reject requests whose request line and headers exceed this size (431)
+        size_t maxHeaderCount = 100;        // Reject requests with more header fields than this (431)
+        size_t maxBodyBytes = 1ull << 30;   // Reject buffered bodies larger than this (413; 0 = unlimited); streamed bodies are exempt
+        size_t streamBodyBytes = 8u << 20;  // Bodies this large are streamed to routes that support it (0 = always buffer)
+        size_t maxDecodedBodyBytes = 4ull << 30;  // Limit on a gzip/deflate request body once inflated (413; 0 = unlimited)
+        int compressionLevel = 1;           // gzip/deflate level for clients that accept it (0 disables)
+        size_t compressionMinBytes = 1024;  // Smaller responses are sent uncompressed
+        std::string unixSocketPath;         // Also listen on this Unix domain socket (empty = TCP only; POSIX)
+        std::string probePort;              // Also answer probes on this port, from a dedicated thread (empty = off)
+        TlsOptions tls;                     // HTTPS on the TCP listener when tls.certFile is set
+        std::map<std::string, BulkheadOptions> classBulkheads;  // By IRoute::capacityClass(); others use the shared pool
+        std::map<std::string, BulkheadOptions> modelBulkheads;  // By the body's "model" field, ahead of the class
+    };
+
+    /**
+     * @brief Answers a liveness or readiness probe without a handler thread
+     *
+     * Called on the I/O threads with the request path (query string removed),
+     * so it must not block. Returns false if the path is not a probe.
+     */
+    using ProbeResponder = std::function<bool(std::string_view path, int& status, std::string& body)>;
+
     class KOLOSAL_SERVER_API Server {    public:
-        explicit Server(const std::string& port, const std::string& host = "0.0.0.0");
+        explicit Server(const std::string& port, const std::string& host = "0.0.0.0",
+                        const ServerOptions& options = ServerOptions());
         ~Server();
 
         bool init();
         void addRoute(std::unique_ptr<IRoute> route);
+
+        /**
+         * @brief Answer probe paths on the I/O threads, ahead of the worker pool; set before run()
+         *
+         * GET and HEAD requests the responder recognizes skip authentication and
+         * the handlers, so they are answered however busy those are. TLS
+         * connections go the usual way. The probe port, if configured, answers
+         * nothing else.
+         */
+        void setProbeResponder(ProbeResponder responder) { probeResponder_ = std::move(responder); }
         void run();
         void stop(); // New method to stop the server
 
+        /**
+         * @brief Stop accepting and wait for in-flight requests, up to drainTimeoutSeconds
+         *
+         * Idle persistent connections are closed and no response offers keep-alive.
+         * Call stop() afterwards.
+         */
+        void drain();
+
+        /**
+         * @brief Start a new server process that inherits the listening sockets (POSIX)
+         *
+         * Runs @p args (the command line this process was started with, resolved
+         * through PATH) with the sockets' descriptors in KOLOSAL_LISTEN_FDS and
+         * this process's id in KOLOSAL_UPGRADE_PARENT. Both processes accept on
+         * the same sockets until the new one calls releasePredecessor().
+         * @return The new process's id, or -1 on failure
+         */
+        long spawnSuccessor(const std::vector<std::string>& args);
+
+        /**
+         * @brief Ask the process this one took the sockets over from to drain and exit
+         *
+         * Does nothing unless the sockets were inherited; called once this process
+         * is ready to serve, models loaded.
+         */
+        void releasePredecessor();
+
         // Authentication middleware access
         auth::AuthMiddleware& getAuthMiddleware() { return *authMiddleware_; }
         const auth::AuthMiddleware& getAuthMiddleware() const { return *authMiddleware_; }
 
     private:
+        struct Connection;
+        struct IoThread;
+        struct Bulkhead;
+
+        void ioLoop(IoThread& io);
+        void readConnection(IoThread& io, const std::shared_ptr<Connection>& conn);
+        bool advanceHandshake(IoThread& io, const std::shared_ptr<Connection>& conn);
+        void processBuffer(IoThread& io, const std::shared_ptr<Connection>& conn, bool peerClosed);
+        void closeConnection(IoThread& io, const std::shared_ptr<Connection>& conn);
+        void handleConnection(const std::shared_ptr<Connection>& conn);
+        bool handleRequest(const std::shared_ptr<Connection>& conn, bool keepAlive);
+        void dispatch(IoThread& io, const std::shared_ptr<Connection>& conn);
+        bool listenUnix();
+        bool listenTcp();
+        bool listenProbe();
+        bool answerProbe(IoThread& io, const std::shared_ptr<Connection>& conn);
+        size_t acceptorCount() const;
+        bool adoptInheritedSockets();
+        void acceptLoop(SocketType listenSock, bool withUnix, IoThread* pinned);
+        IRoute* findRoute(const std::string& method, const std::string& path);
+        Bulkhead* bulkheadFor(const std::shared_ptr<Connection>& conn);
+        size_t handlersInFlight() const;
+
 #pragma warning(push)
 #pragma warning(disable: 4251)
         std::string port;
         std::string host;
+        ServerOptions options_;
 #pragma warning(pop)
-        SocketType listen_sock;
+        SocketType unix_sock;   // Unix domain socket listener, if options_.unixSocketPath is set
 #pragma warning(push)
 #pragma warning(disable: 4251)
+        std::vector<SocketType> listenSocks_;   // TCP listeners; one per acceptor with SO_REUSEPORT
+        SocketType probeSock_{};                // Probe port listener, valid while probeListening_
+        bool probeListening_ = false;
+        std::unique_ptr<IoThread> probeIo_;     // Serves only the probe port's connections
+        ProbeResponder probeResponder_;
+        std::atomic<bool> accepting_{false};    // Cleared by drain() to stop the acceptors
+        std::atomic<bool> draining_{false};
+        std::atomic<size_t> nextIo_{0};         // Round-robin over I/O threads across acceptors
+        size_t activeAcceptors_ = 0;            // Guarded by lifecycleMutex_
+        bool handedOver_ = false;               // A successor shares the sockets; keep the Unix socket file
+        long upgradeParent_ = 0;                // Process the sockets were inherited from
         std::vector<std::unique_ptr<IRoute>> routes;
+        RouteTable routeTable_; // Built from routes as they are added; read-only once the server runs
         std::atomic<bool> running; // Control flag for server loop
         std::unique_ptr<auth::AuthMiddleware> authMiddleware_; // Authentication middleware
+        std::vector<std::unique_ptr<IoThread>> ioThreads_;
+        std::unique_ptr<WorkerPool> workers_;
+        std::map<std::string, std::unique_ptr<Bulkhead>> classBulkheads_;   // Built from options_ by run()
+        std::map<std::string, std::unique_ptr<Bulkhead>> modelBulkheads_;
+        std::unique_ptr<TlsContext> tls_;   // Set when options_.tls has a certificate
+        std::mutex lifecycleMutex_;
+        std::condition_variable lifecycleCv_;
+        bool loopActive_ = false;
 #pragma warning(pop)
     };
 
@@ -3,6 +3,7 @@
 #include <string>
 #include <memory>
 #include <chrono>
+#include <vector>
 
 #include "export.hpp"
 #include "server_config.hpp"
@@ -30,10 +31,22 @@ namespace kolosal
         ServerAPI &operator=(ServerAPI &&) = delete;        // Initialize and start server
         bool init(const std::string &port, const std::string &host = "0.0.0.0", std::chrono::seconds idleTimeout = std::chrono::seconds(300));
         void shutdown();
+
+        // Zero-downtime binary upgrade: the old process starts the new one on its listening
+        // sockets, the new one releases the old once it is ready, and the old drains and exits
+        bool upgrade(const std::vector<std::string> &args);
+        void releasePredecessor();
+        void drain();
         
         // Feature management
         void enableMetrics();
         void enableSearch(const SearchConfig& config);
+        void enableTracing(const TracingConfig& config);
+        void enableAccessLog(const AccessLogConfig& config);
+        void enableTrafficCapture(const TrafficCaptureConfig& config);
+        void enableModelSharing();
+        void enableCluster(const ClusterConfig& config);
+        void enableDisaggregation(const DisaggregationConfig& config);
 
         // NodeManager access
         NodeManager &getNodeManager();
@@ -2,9 +2,12 @@
 
 #include <string>
 #include <vector>
+#include <map>
 #include <chrono>
 #include "export.hpp"
 #include "auth/rate_limiter.hpp"
+#include "auth/token_quota.hpp"
+#include "auth/tenant_shares.hpp"
 #include "auth/cors_handler.hpp"
 #include "inference.h"
 
@@ -16,23 +19,33 @@ namespace kolosal {
 struct ModelConfig {
     std::string id;                    // Unique identifier for the model
     std::string path;                  // Path to the model file
-    std::string type = "llm";          // Model type: "llm" or "embedding"
+    std::string type = "llm";          // Model type: "llm", "embedding" or "rerank"
     LoadingParameters loadParams;      // Model loading parameters
     int mainGpuId = 0;                // GPU ID to use for this model
     bool loadImmediately = true;      // Whether to load immediately (true) vs lazy load on first use (false)
     std::string inferenceEngine = ""; // Inference engine to use (empty = use default from config)
+    std::string sha256;               // SHA-256 a downloaded model must match (empty = HuggingFace's published digest, if any)
     
     ModelConfig() = default;
     ModelConfig(const std::string& modelId, const std::string& modelPath, bool load = true)
         : id(modelId), path(modelPath), loadImmediately(load) {}
 };
 
+/**
+ * @brief One build of an inference engine, usable where the host has all its features
+ */
+struct InferenceEngineVariant {
+    std::string library_path;
+    std::vector<std::string> features; // HardwareFeatures tags, e.g. "avx512", "cuda-sm80", "vulkan"
+};
+
 /**
  * @brief Configuration for an inference engine
  */
 struct InferenceEngineConfig {
     std::string name;                  // Engine name (e.g., "llama-cpu", "llama-cuda")
-    std::string library_path;          // Path to the shared library
+    std::string library_path;          // Path to the shared library; the fallback when variants are listed
+    std::vector<InferenceEngineVariant> variants;  // Fastest first; the loader takes the first the host supports
     std::string version = "1.0.0";     // Engine version
     std::string description;           // Human-readable description
     bool load_on_startup = true;       // Whether to load the engine at server startup
@@ -48,6 +61,12 @@ struct InferenceEngineConfig {
 struct AuthConfig {
     // Rate limiting configuration
     auth::RateLimiter::Config rateLimiter;
+
+    // Inference token quotas per API key (or client IP) and per model
+    auth::TokenQuota::Config tokenQuota;
+
+    // Weighted fair sharing of engine slots and step tokens between API keys (or client IPs)
+    auth::TenantShares::Config tenantScheduling;
     
     // CORS configuration
     auth::CorsHandler::Config cors;
@@ -89,10 +108,14 @@ struct DatabaseConfig {
         int maxConnections = 10;
         int connectionTimeout = 5;
         int embeddingBatchSize = 5;
+        bool http2 = false; // Multiplex requests over HTTP/2 (h2c prior knowledge without TLS)
+        std::vector<std::string> replicas; // Other nodes serving the same collections ("host:port"), used by hedged searches
+        bool hedge = false; // Resend a search still unanswered after the recent p95 latency, keeping the first answer
+        int hedgeMinDelayMs = 10; // Never hedge a search sooner than this
     } qdrant;
     
     struct FaissConfig {
-        std::string indexType = "Flat"; // Index type: Flat, IVF, HNSW
+        std::string indexType = "Flat"; // Index type: Flat, IVF, IVFPQ, HNSW, HNSWSQ8, SQ8, SQfp16, IVFSQ8, IVFSQfp16, DiskIVFPQ or Auto
         std::string indexPath = "./data/faiss_index"; // Path to store index
         int dimensions = 1536; // Default embedding dimensions
         bool normalizeVectors = true; // Normalize vectors before storing
@@ -100,8 +123,102 @@ struct DatabaseConfig {
         int nprobe = 10; // Number of clusters to search for IVF index
         bool useGPU = false; // Use GPU acceleration if available
         int gpuDevice = 0; // GPU device ID
+        std::string gpuMode = "single"; // single, shard (split across GPUs) or replica (full copy per GPU)
+        std::vector<int> gpuDevices; // GPUs used by shard/replica mode (empty = all visible)
+        int gpuSyncPoints = 65536; // Merged vectors that trigger a re-copy of the index to the GPUs
         std::string metricType = "IP"; // Distance metric: L2, IP (Inner Product)
+        int walSyncMs = 10; // fsync batching window for the write-ahead log (0 = every mutation)
+        int checkpointIntervalSec = 300; // Seconds between index checkpoints (0 = size only)
+        int checkpointWalMB = 256; // WAL size that forces a checkpoint (0 = interval only)
+        int deltaMergePoints = 4096; // Buffered inserts that trigger a background merge into the main index
+        std::string autoIndexType = "IVFPQ"; // Index an Auto collection is rebuilt into once it grows
+        int autoIndexThreshold = 100000; // Live vectors at which an Auto collection leaves Flat
+        float recallTarget = 0.95f; // recall@10 that nprobe/efSearch are tuned to after a rebuild
+        int efSearch = 64; // Default HNSW efSearch until tuned
+        float tombstoneCompactRatio = 0.2f; // Share of deleted vectors in the main index that triggers a compaction rebuild
+        bool mmapIndex = true; // Map IVF index files at load so collections are searchable at once; read into memory in the background
+        int diskRerankFactor = 4; // DiskIVFPQ: candidates per result re-scored with the full vectors from disk
+        bool exactRerank = false; // Quantized types (IVFPQ, HNSWSQ8, SQ*) also keep full vectors on disk and re-score from them
+        std::string textCompression = "off"; // "dict": long payload strings deflated with a dictionary trained on the collection
+
+        // Per-collection index settings; empty or zero fields inherit the defaults above
+        struct CollectionConfig {
+            std::string indexType;
+            std::string metricType;
+            int dimensions = 0;
+            int nlist = 0;
+            int nprobe = 0;
+            int efSearch = 0;
+            std::string gpuMode; // single, shard, replica or off
+            std::string textCompression; // dict or off
+        };
+        std::map<std::string, CollectionConfig> collections;
     } faiss;
+
+    // Backends a collection is split over by document ID, all of vectorDatabase's type; empty = one backend.
+    // Each shard takes the faiss/qdrant settings above with its own location.
+    struct ShardConfig {
+        std::string indexPath; // FAISS: directory of this shard (empty = <faiss.indexPath>/shard-<n>)
+        std::string host; // Qdrant: server of this shard (empty = qdrant.host)
+        int port = 0; // Qdrant: 0 = qdrant.port
+        std::string apiKey; // Qdrant: empty = qdrant.apiKey
+        std::vector<std::string> replicas; // Qdrant: nodes holding copies of this shard ("host:port") for hedged searches
+    };
+    std::vector<ShardConfig> shards;
+
+    // BM25 index of document text for keyword and hybrid retrieval; rebuilt from the vector store at startup
+    struct LexicalConfig {
+        bool enabled = true;
+        float k1 = 1.2f; // Term frequency saturation
+        float b = 0.75f; // Document length normalization (0 = none, 1 = full)
+    } lexical;
+    
+    // Document ingestion pipeline: embedding batches flow to vector store writes through bounded queues
+    struct IngestionConfig {
+        int embedWorkers = 2; // Embedding batches in flight at once
+        int upsertWorkers = 1; // Concurrent vector store writes; each coalesces every batch waiting for it
+        int queueDepth = 4; // Batches buffered between stages before the previous stage waits
+        int backgroundYieldMs = 2000; // Longest an async job's batch waits for the embedding model to go idle (0 = never waits)
+
+        // Near-duplicate chunks are not embedded or stored again; their result names the stored chunk
+        struct DedupConfig {
+            bool enabled = false;
+            double threshold = 0.9; // Estimated Jaccard similarity of word shingles that counts as a duplicate
+            int shingleWords = 5; // Words per shingle
+            int numHashes = 128; // MinHash signature length; longer estimates closer at 4 bytes per chunk each
+        } dedup;
+    } ingestion;
+    
+    // Cache of embeddings by model and exact input text, shared by /v1/embeddings, chunking and documents
+    struct EmbeddingCacheConfig {
+        bool enabled = true;
+        int memoryMb = 256; // In-memory LRU budget
+        std::string path = ""; // Append-only file that keeps embeddings across restarts (empty = memory only)
+        int diskMb = 2048; // File size that triggers rewriting it with the in-memory entries (0 = unbounded)
+    } embeddingCache;
+
+    // Parse results of /parse_pdf and /parse_docx, keyed by the uploaded bytes
+    struct ParseCacheConfig {
+        bool enabled = true;
+        std::string path = ""; // Directory of cached results (empty = off)
+        int diskMb = 1024; // Least recently used results are deleted beyond this
+    } parseCache;
+
+    // Document chunks whose KV a chat model precomputes, so prompts quoting them skip their
+    // prefill; the model needs load_params.chunk_cache_mb
+    struct ChunkKvConfig {
+        std::string model = ""; // Chat model the chunks are precomputed on (empty = off)
+        bool onIngest = false; // Precompute every chunk as it is indexed
+        int minRetrievals = 1; // Precompute a chunk once /retrieve has returned it this often (0 = never)
+    } chunkKv;
+
+    // Keep the FAISS "documents" collection a read-only copy of another server's: load its
+    // snapshot, then apply its write-ahead log as it grows
+    struct ReplicationConfig {
+        std::string source = ""; // Base URL of the server to follow, e.g. http://primary:8080 (empty = off)
+        std::string apiKey = ""; // Sent to the source as X-API-Key
+        int pollMs = 500; // Pause between change requests once caught up
+    } replication;
     
     DatabaseConfig() = default;
 };
@@ -120,10 +237,191 @@ struct SearchConfig {
     std::string default_format = "json";      // Default output format (json, xml, csv)
     std::string default_language = "en";      // Default search language
     std::string default_category = "general"; // Default search category
+    int cache_ttl_seconds = 60;               // How long a result is served from memory (0 = no caching)
+    int cache_max_entries = 1024;             // Least recently used results are dropped beyond this
     
     SearchConfig() = default;
 };
 
+/**
+ * @brief Model download scheduling configuration
+ */
+struct DownloadConfig {
+    int max_concurrent = 2;                     // Downloads running at once; the rest wait in priority order
+    long long max_bytes_per_second = 0;         // Cap shared by all downloads (0 = unlimited)
+    long long per_download_bytes_per_second = 0; // Cap for each download (0 = unlimited)
+    int connections = 0;                        // Range connections per download (0 = default of 8)
+    int progress_interval_ms = 500;             // Fastest rate progress streams push byte counts at
+
+    // Fleet distribution: look for a model here before its origin URL
+    std::vector<std::string> peers;             // Base URLs of kolosal servers sharing their models
+    std::vector<std::string> mirrors;           // Base URLs of HTTP mirrors laid out as <base>/<file name>
+    std::string cache_dir;                      // Shared directory (e.g. a network mount) of downloaded models
+    std::string peer_api_key;                   // X-API-Key sent to peers that require one
+    bool serve_to_peers = false;                // Serve this server's downloaded models under /v1/model-files/
+    
+    DownloadConfig() = default;
+};
+
+/**
+ * @brief HTTPS on the TCP listener (the Unix socket stays plain)
+ */
+struct TlsConfig {
+    bool enabled = false;
+    std::string cert_file = "";                // PEM certificate chain
+    std::string key_file = "";                 // PEM private key
+    bool kernel_offload = true;                // Linux kTLS: the kernel encrypts responses, sendfile() included
+    bool session_tickets = true;               // Stateless resumption for returning clients
+    int session_cache_size = 20480;            // Sessions kept for resumption by session ID (0 = none)
+    int session_timeout_seconds = 7200;        // How long a session can be resumed
+
+    TlsConfig() = default;
+};
+
+/**
+ * @brief Request tracing configuration
+ */
+struct TracingConfig {
+    bool enabled = false;                      // Propagate trace context and record spans
+    double sample_rate = 0.01;                 // Share of requests without a sampled traceparent that are traced
+    std::string file = "";                     // JSON trace file, one OTLP export request per line (empty = none)
+    std::string otlp_endpoint = "";            // OTLP/HTTP JSON collector, e.g. http://localhost:4318 (empty = none)
+    std::string service_name = "kolosal-server";
+    bool server_timing = false;                // Report per-stage durations in a Server-Timing response header
+    
+    TracingConfig() = default;
+};
+
+/**
+ * @brief Cache of deterministic completion responses
+ */
+struct ResponseCacheConfig {
+    bool enabled = false;                      // Serve repeated greedy or seeded completions from memory
+    int ttl_seconds = 600;                     // Entries older than this are misses (0 = no expiry)
+    int memory_mb = 128;                       // LRU budget across all models
+    int max_entry_kb = 256;                    // Larger responses are not cached
+
+    // Chat completions whose final user message is a paraphrase of a recent one, in the same
+    // context, get the stored answer: the message is embedded and matched by cosine similarity
+    struct SemanticConfig {
+        bool enabled = false;
+        std::string embedding_model = "";      // Embedding engine that encodes the messages
+        float threshold = 0.95f;               // Lowest cosine similarity served from the cache
+        int max_entries = 10000;               // Answers kept across all models; least recently used go first
+    } semantic;
+
+    ResponseCacheConfig() = default;
+};
+
+/**
+ * @brief OpenAI-compatible Batch API (/v1/files, /v1/batches)
+ */
+struct BatchConfig {
+    bool enabled = true;
+    std::string directory = "batches";         // Uploaded files, batch state and result files
+    int max_file_mb = 1024;                    // Largest file accepted by /v1/files
+    int reserved_slots = 1;                    // Engine slots batches leave free for interactive requests
+    int max_in_flight = 64;                    // Most batch jobs queued on one engine at a time
+
+    BatchConfig() = default;
+};
+
+/**
+ * @brief Asynchronous completion jobs (/v1/jobs), run by JobManager
+ */
+struct JobsConfig {
+    bool enabled = true;
+    int max_running = 8;                       // Jobs generating at once; the rest wait in order
+    int max_queued = 1000;                     // Waiting jobs beyond which submissions get 429
+    int result_ttl_seconds = 3600;             // How long an ended job and its result are kept
+    std::string webhook_secret;                // Signs webhook deliveries (X-Kolosal-Signature); empty = unsigned
+    int webhook_timeout_seconds = 10;          // Longest one delivery attempt may take
+    int webhook_retries = 3;                   // Further attempts after a failed delivery, with growing delays
+
+    JobsConfig() = default;
+};
+
+/**
+ * @brief Handler threads set aside for one class of requests or one model
+ *
+ * Requests in a partition run on a pool of their own, so a surge of slow ones
+ * (document parsing, large ingestions) cannot take the threads other classes need.
+ * Requests not in any partition share the server's worker pool.
+ */
+struct BulkheadConfig {
+    struct Limit {
+        int max_concurrent = 0;                // Requests handled at once, each on its own thread
+        int max_queued = 0;                    // Requests waiting beyond those before new ones get 503 (0 = unbounded)
+    };
+    std::map<std::string, Limit> classes;      // By route: chat, embeddings, retrieval, parsing, admin
+    std::map<std::string, Limit> models;       // By the request body's "model"; takes precedence over the class
+
+    BulkheadConfig() = default;
+};
+
+/**
+ * @brief Cache-aware routing of completion requests across several kolosal servers
+ */
+struct ClusterConfig {
+    bool enabled = false;
+    std::string node_id;                       // Name of this node; defaults to advertise_url
+    std::string advertise_url;                 // Base URL peers use to reach this node
+    std::vector<std::string> peers;            // Base URLs of the other nodes (this node's own URL is skipped)
+    std::string api_key;                       // X-API-Key sent when polling peers that require one
+    int heartbeat_ms = 1000;                   // How often each peer's state is polled
+    int stale_after_ms = 5000;                 // A peer not heard from for this long takes no requests
+    int prefix_chars = 2048;                   // Prompt characters hashed into the routing key
+    int virtual_nodes = 64;                    // Points per node on the hash ring
+    double load_factor = 1.25;                 // A node takes a key only while under this multiple of the mean load
+    int proxy_timeout_seconds = 600;           // Longest a proxied request may take
+    int drain_grace_seconds = 10;              // A draining node lets running generations finish this long before moving them
+    int drain_timeout_seconds = 120;           // Longest a drain waits for moved generations to complete
+    bool share_rate_limits = true;             // Requests the peers admitted count against the rate limits here
+
+    ClusterConfig() = default;
+};
+
+/**
+ * @brief Disaggregated prefill/decode: long prompts are decoded on dedicated prefill nodes
+ */
+struct DisaggregationConfig {
+    std::string role = "combined";             // "combined", "prefill" (serves /v1/internal/prefill) or "decode"
+    std::vector<std::string> prefill_nodes;    // Base URLs of the prefill nodes a decode node uses
+    int min_prompt_tokens = 1024;              // Shorter prompts are decoded locally
+    std::string api_key;                       // X-API-Key sent to prefill nodes that require one
+    int timeout_seconds = 120;                 // Longest a remote prefill may take before decoding locally
+
+    DisaggregationConfig() = default;
+};
+
+/**
+ * @brief Structured access log, enabled by ServerConfig::enableAccessLog
+ */
+struct AccessLogConfig {
+    std::string file = "access.log";           // Records are appended here and rotated by size
+    std::string format = "ndjson";             // "ndjson" (one JSON object per line) or "binary"
+    double sample_rate = 1.0;                  // Share of successful requests that are recorded
+    bool always_log_errors = true;             // Requests answered with 4xx/5xx bypass sampling
+    int max_file_mb = 100;                     // Rotate once the file grows past this (0 = never)
+    int max_files = 5;                         // Rotated files kept as file.1 .. file.N
+
+    AccessLogConfig() = default;
+};
+
+/**
+ * @brief Sampled capture of requests, bodies included, for replay against another build
+ */
+struct TrafficCaptureConfig {
+    bool enabled = false;
+    std::string file = "traffic.ndjson.gz";    // gzip-compressed NDJSON, appended to
+    double sample_rate = 0.01;                 // Share of requests captured
+    bool anonymize = true;                     // Replace the words of body strings with same-length stand-ins
+    int max_body_kb = 256;                     // Larger bodies are captured by size only
+    int max_file_mb = 1024;                    // Capture stops once the file grows past this (0 = never)
+
+    TrafficCaptureConfig() = default;
+};
+
 /**
  * @brief Server startup configuration
  */
@@ -149,9 +447,36 @@ struct KOLOSAL_SERVER_API ServerConfig {    // Basic server settings
 #pragma warning(push)
 #pragma warning(disable: 4251)
     std::chrono::seconds idleTimeout{300}; // Model idle timeout
+#pragma warning(pop)
+    int ioThreads = 0;                // Connection event-loop threads (0 = auto)
+    int acceptThreads = 0;            // Accepting threads, each with its own SO_REUSEPORT listener on Linux (0 = one per I/O thread on Linux, else 1)
+    int upgradeDrainTimeout = 30;     // Seconds a process handing over to a new binary waits for in-flight requests
+    int healthPort = 0;               // Also answer /livez and /readyz on this port, from a dedicated thread (0 = main port only)
+    int workerThreads = 0;            // Request handler threads kept warm (0 = auto)
+    int maxWorkerThreads = 512;       // Upper bound on concurrently handled requests
+    int keepAliveTimeout = 5;         // Seconds an idle persistent connection is kept open (0 = disabled)
+    int maxKeepAliveRequests = 100;   // Requests served per connection before closing it
+    int modelMemoryBudgetMb = 0;      // Total size of loaded model weights before least used models are evicted (0 = unlimited)
+    int minFreeMemoryMb = 512;        // Evict least used models while free system RAM is below this (0 = disabled)
+    bool preloadModels = true;        // Reload evicted models in the background while they still get traffic
+    int hibernateMemoryMb = 0;        // Host RAM for the weights of models unloaded for inactivity, so they wake without a disk read (0 = disabled)
+    int startupLoadConcurrency = 0;   // Models loaded in parallel at startup (0 = auto); one at a time per GPU
+    int streamBodyThresholdMb = 8;    // Request bodies this large are streamed to routes that support it (0 = always buffer)
+    int maxBodyMb = 1024;             // Larger buffered request bodies are rejected with 413 (0 = unlimited)
+    int maxDecompressedBodyMb = 4096; // Limit on a gzip/deflate request body once inflated, streamed or not (413; 0 = unlimited)
+    int compressionLevel = 1;         // gzip/deflate level 1-9 for responses to clients that accept it (0 disables)
+    int compressionMinBytes = 1024;   // Responses smaller than this are sent uncompressed
+    int gpuSampleIntervalSeconds = 5; // How often GPU free memory, load and temperature are read (0 = at startup only)
+    int configWatchIntervalSeconds = 0; // How often the config file is checked for changes to hot reload (0 = disabled)
+#pragma warning(push)
+#pragma warning(disable: 4251)
+    std::string unixSocket;           // Also accept connections on this Unix domain socket path (empty = TCP only)
     
     // Models to load at startup
     std::vector<ModelConfig> models;
+
+    // Model names served by the variant whose context fits each request (alias -> model IDs)
+    std::map<std::string, std::vector<std::string>> modelAliases;
     
     // Inference engines to make available
     std::vector<InferenceEngineConfig> inferenceEngines;
@@ -168,6 +493,35 @@ struct KOLOSAL_SERVER_API ServerConfig {    // Basic server settings
     
     // Internet search configuration
     SearchConfig search;
+
+    // HTTPS termination
+    TlsConfig tls;
+
+    // Request tracing configuration
+    TracingConfig tracing;
+    AccessLogConfig accessLog;
+    TrafficCaptureConfig trafficCapture;
+
+    // Deterministic completion cache
+    ResponseCacheConfig responseCache;
+
+    // Offline batches run on the capacity interactive traffic leaves
+    BatchConfig batch;
+
+    // Completion requests run in the background, fetched later or posted to a webhook
+    JobsConfig jobs;
+
+    // Handler capacity partitioned by request class and model
+    BulkheadConfig bulkheads;
+
+    // Multi-node routing by session and prompt prefix
+    ClusterConfig cluster;
+
+    // Prompt ingestion on dedicated prefill nodes
+    DisaggregationConfig disaggregation;
+
+    // Model download scheduling
+    DownloadConfig downloads;
     
     // Feature flags
     bool enableHealthCheck = true;
@@ -216,6 +570,12 @@ struct KOLOSAL_SERVER_API ServerConfig {    // Basic server settings
      * @return True if configuration was saved successfully
      */
     bool saveToFile(const std::string& configFile) const;
+
+    /**
+     * @brief The configuration as saveToFile() would write it
+     * @return YAML document; throws if it cannot be emitted
+     */
+    std::string toYaml() const;
     
     /**
      * @brief Save current configuration to the currently loaded config file
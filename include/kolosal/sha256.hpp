@@ -0,0 +1,43 @@
+#pragma once
+
+#include "export.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace kolosal {
+
+    // Incremental SHA-256 (FIPS 180-4), fed as data arrives so large downloads are
+    // hashed without a second pass over the file.
+    class KOLOSAL_SERVER_API Sha256 {
+    public:
+        Sha256();
+
+        void update(const void* data, size_t size);
+
+        // Lower-case hex digest; the hasher must be reset() before it is fed again
+        std::string hexDigest();
+
+        void reset();
+
+        // Bytes fed since the last reset
+        uint64_t size() const { return length_; }
+
+        // Hash a whole file, reading it in large blocks. Empty string if it cannot be read.
+        static std::string hashFile(const std::string& path);
+
+        // True for a 64 character hex string
+        static bool isHexDigest(const std::string& value);
+
+        // HMAC-SHA256 (RFC 2104) of message under key, as lower-case hex
+        static std::string hmacHex(const std::string& key, const std::string& message);
+
+    private:
+        uint32_t state_[8];
+        uint8_t buffer_[64];
+        size_t buffered_;
+        uint64_t length_;
+    };
+
+} // namespace kolosal
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "export.hpp"
+#include "vector_database.hpp"
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace kolosal
+{
+
+/**
+ * @brief One logical vector database split over several backends by point id
+ *
+ * Every point lives on exactly one shard, picked by a stable hash of its id,
+ * so writes, deletes and lookups only touch the shards that own the ids.
+ * Searches go to every shard at once and their ranked hits are merged into
+ * one top-k list by score. Collections exist on every shard.
+ *
+ * Shard calls are started on the calling thread and the returned futures
+ * collect their results when waited on, so the shards work in parallel. The
+ * shard of a point depends on the shard count: changing the number of shards
+ * of an existing store needs the documents re-added.
+ */
+class KOLOSAL_SERVER_API ShardedVectorDatabase : public IVectorDatabase
+{
+public:
+    explicit ShardedVectorDatabase(std::vector<std::unique_ptr<IVectorDatabase>> shards);
+
+    size_t shardCount() const { return shards_.size(); }
+
+    // Shard that owns a point id
+    size_t shardFor(const std::string& point_id) const;
+
+    std::future<VectorResult> testConnection() override;
+    std::future<VectorResult> createCollection(const std::string& collection_name, int vector_size, const std::string& distance) override;
+    std::future<VectorResult> collectionExists(const std::string& collection_name) override;
+    std::future<VectorResult> upsertPoints(const std::string& collection_name, const std::vector<VectorPoint>& points) override;
+    std::future<VectorResult> deletePoints(const std::string& collection_name, const std::vector<std::string>& point_ids) override;
+    std::future<VectorResult> getPoints(const std::string& collection_name, const std::vector<std::string>& point_ids) override;
+    std::future<VectorResult> search(const std::string& collection_name, const std::vector<float>& query_vector, int limit, float score_threshold, const VectorSearchParams& params) override;
+    std::future<VectorResult> searchBatch(const std::string& collection_name, const std::vector<std::vector<float>>& query_vectors, int limit, float score_threshold, const VectorSearchParams& params) override;
+    // Walks the shards one after another; offsets are "<shard>:<shard offset>"
+    std::future<VectorResult> scrollPoints(const std::string& collection_name, int limit, const std::string& offset, bool with_payload, const nlohmann::json& filter) override;
+    nlohmann::json memoryUsage() const override;
+
+private:
+#pragma warning(push)
+#pragma warning(disable: 4251)
+    std::vector<std::unique_ptr<IVectorDatabase>> shards_;
+#pragma warning(pop)
+};
+
+} // namespace kolosal
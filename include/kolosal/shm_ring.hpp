@@ -0,0 +1,76 @@
+#pragma once
+
+#include "export.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace kolosal {
+
+    /**
+     * @brief Shared-memory ring a co-located client reads bulk results from.
+     *
+     * The client creates a POSIX shared-memory object (shm_open) and lays it
+     * out as below, then names it in a request sent over the server's Unix
+     * domain socket. Instead of encoding the payload (e.g. embedding vectors)
+     * into the HTTP response, the server copies the raw bytes into the ring.
+     * The JSON response then only says where they are.
+     *
+     * Layout, little-endian, fields at fixed offsets:
+     *   0   char[8]  magic "KLSHMRG1"
+     *   8   uint32   version (1)
+     *   12  uint32   reserved
+     *   16  uint64   capacity: data bytes, a multiple of 64, following the 64-byte header
+     *   24  uint64   head: bytes produced so far, advanced by the server
+     *   32  uint64   tail: bytes consumed so far, advanced by the client
+     *   40  reserved up to 64
+     * head and tail only grow; a record starts at data offset (position % capacity),
+     * 64-byte aligned, and never wraps. After reading a record the client stores
+     * its end into tail, which frees the space. Records are written in order,
+     * so a client should keep one request per ring in flight.
+     *
+     * POSIX only; attach() fails on Windows.
+     */
+    class KOLOSAL_SERVER_API ShmRing {
+    public:
+        static constexpr size_t kHeaderBytes = 64;
+
+        struct Placement {
+            uint64_t offset = 0;    // Of the record, from the start of the shared-memory object
+            uint64_t bytes = 0;
+            uint64_t end = 0;       // Value for the client to store into tail once it has read the record
+        };
+
+        // The ring for name (e.g. "/myapp-embeddings"), mapped once and then reused.
+        // nullptr, with the reason in error, if it does not exist or is not a ring.
+        static std::shared_ptr<ShmRing> attach(const std::string& name, std::string& error);
+
+        ~ShmRing();
+
+        ShmRing(const ShmRing&) = delete;
+        ShmRing& operator=(const ShmRing&) = delete;
+
+        uint64_t capacity() const { return capacity_; }
+
+        // Copies the parts back to back into one record. False if the record is larger
+        // than the ring, or the client has not freed enough of it yet.
+        bool write(const std::vector<std::pair<const void*, size_t>>& parts, Placement& placed);
+
+    private:
+        ShmRing() = default;
+
+        void* base_ = nullptr;
+        size_t mappedBytes_ = 0;
+        uint64_t capacity_ = 0;
+#pragma warning(push)
+#pragma warning(disable: 4251)
+        std::mutex writeMutex_;     // Requests on several connections may name the same ring
+#pragma warning(pop)
+    };
+
+} // namespace kolosal
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "export.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace kolosal {
+
+    /**
+     * @brief Fixed-size executor for background work in the retrieval code.
+     *
+     * Replaces free-running std::async fan-out, which created one thread per
+     * call so a single large ingestion could spawn thousands of threads and
+     * starve the inference threads. Tasks are queued for a bounded set of
+     * workers; when the queue is full, or when submit() is called from one of
+     * the workers themselves, the task runs inline on the calling thread.
+     * Running inline gives natural backpressure and keeps nested fan-out
+     * (a task that waits on sub-tasks) from deadlocking the pool.
+     */
+    class KOLOSAL_SERVER_API TaskExecutor {
+    public:
+        struct Stats {
+            size_t   threads   = 0;
+            size_t   busy      = 0;
+            size_t   queued    = 0;
+            size_t   maxQueued = 0;
+            uint64_t completed = 0;    // Tasks finished by the workers
+            uint64_t ranInline = 0;    // Tasks run on the caller because of backpressure or nesting
+        };
+
+        TaskExecutor(size_t threads, size_t maxQueued);
+        ~TaskExecutor();
+
+        TaskExecutor(const TaskExecutor&) = delete;
+        TaskExecutor& operator=(const TaskExecutor&) = delete;
+
+        // Process-wide executor shared by document ingestion, parsing, chunking and vector DB calls
+        static TaskExecutor& instance();
+
+        // Run fn on the pool (or inline, see above); exceptions are delivered through the future
+        template <typename F>
+        auto submit(F&& fn) -> std::future<std::invoke_result_t<std::decay_t<F>>>
+        {
+            using R = std::invoke_result_t<std::decay_t<F>>;
+            auto task = std::make_shared<std::packaged_task<R()>>(std::forward<F>(fn));
+            std::future<R> result = task->get_future();
+            if (!tryEnqueue([task]() { (*task)(); }))
+            {
+                ranInline_.fetch_add(1, std::memory_order_relaxed);
+                (*task)();
+            }
+            return result;
+        }
+
+        // Stop accepting tasks, drain the queue and join all workers
+        void shutdown();
+
+        Stats stats() const;
+
+        // True on the executor's own worker threads
+        static bool onWorkerThread();
+
+    private:
+        bool tryEnqueue(std::function<void()> task);
+        void workerLoop();
+
+#pragma warning(push)
+#pragma warning(disable: 4251)
+        std::vector<std::thread> threads_;
+        std::deque<std::function<void()>> tasks_;
+        mutable std::mutex mutex_;
+        std::condition_variable cv_;
+        std::atomic<uint64_t> completed_{0};
+        std::atomic<uint64_t> ranInline_{0};
+#pragma warning(pop)
+        size_t maxQueued_;
+        size_t busy_ = 0;
+        bool stop_ = false;
+    };
+
+} // namespace kolosal
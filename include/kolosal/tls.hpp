@@ -0,0 +1,109 @@
+#pragma once
+
+#include "export.hpp"
+#include "utils.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+
+struct ssl_ctx_st;
+struct ssl_st;
+
+namespace kolosal {
+
+    /**
+     * @brief TLS termination for the TCP listener; an empty certificate keeps it plain HTTP.
+     */
+    struct TlsOptions {
+        std::string certFile;               // PEM certificate chain
+        std::string keyFile;                // PEM private key
+        bool kernelOffload = true;          // Let the kernel encrypt records (Linux kTLS) where it can
+        bool sessionTickets = true;         // Stateless resumption through session tickets
+        int sessionCacheSize = 20480;       // Sessions kept for resumption by session ID (0 = no cache)
+        int sessionTimeoutSeconds = 7200;   // How long a session can be resumed
+    };
+
+    /**
+     * @brief Handshake and offload counters since the server started.
+     */
+    struct TlsStats {
+        uint64_t handshakes = 0;            // Completed handshakes
+        uint64_t resumed = 0;               // Of which resumed a previous session
+        uint64_t failed = 0;                // Handshakes that failed or were abandoned
+        uint64_t kernelSend = 0;            // Connections whose sent records the kernel encrypts
+        uint64_t kernelRecv = 0;            // Connections whose received records the kernel decrypts
+    };
+
+    /**
+     * @brief TLS state of one accepted connection.
+     *
+     * Registered with http_internal::SecureChannels once the handshake is done, so the
+     * response helpers and body readers go through it. With kTLS on the send side the
+     * kernel encrypts, and responses (sendfile() included) are written to the socket directly.
+     */
+    class KOLOSAL_SERVER_API TlsConnection : public http_internal::SecureChannel {
+    public:
+        enum class Step { Done, WantRead, WantWrite, Failed };
+
+        TlsConnection(ssl_st* ssl, SocketType sock);
+        ~TlsConnection() override;
+
+        // Advances the handshake on a non-blocking socket
+        Step handshake();
+        bool resumed() const;
+        bool kernelRecv() const { return kernelRecv_; }
+        std::string error() const { return error_; }
+
+        bool kernelSend() const override { return kernelSend_; }
+        bool write(http_internal::IoSlice* slices, size_t count) override;
+        long read(char* data, size_t size) override;
+        bool hasBuffered() const override;
+        // Sends close_notify without waiting for the peer's
+        void shutdown() override;
+
+    private:
+        TlsConnection(const TlsConnection&) = delete;
+        TlsConnection& operator=(const TlsConnection&) = delete;
+
+        // An SSL object is not safe for concurrent use; reads and writes may come from different threads
+#pragma warning(push)
+#pragma warning(disable: 4251)
+        mutable std::mutex mutex_;
+        std::string error_;
+#pragma warning(pop)
+        ssl_st* ssl_;
+        SocketType sock_;
+        bool kernelSend_ = false;
+        bool kernelRecv_ = false;
+    };
+
+    /**
+     * @brief Certificate, key and session cache shared by every TLS connection of a listener.
+     */
+    class KOLOSAL_SERVER_API TlsContext {
+    public:
+        // Loads the certificate and key; throws std::runtime_error with OpenSSL's reason
+        explicit TlsContext(const TlsOptions& options);
+        ~TlsContext();
+
+        // TLS state for a freshly accepted socket, handshake not yet started
+        std::unique_ptr<TlsConnection> accept(SocketType sock) const;
+
+        // Whether the server was built with OpenSSL
+        static bool available();
+        static TlsStats stats();
+
+        // Counted by the server as handshakes finish
+        static void recordHandshake(const TlsConnection& connection);
+        static void recordFailure();
+
+    private:
+        TlsContext(const TlsContext&) = delete;
+        TlsContext& operator=(const TlsContext&) = delete;
+
+        ssl_ctx_st* ctx_ = nullptr;
+    };
+
+} // namespace kolosal
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "export.hpp"
+#include "server_config.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+struct JobTiming;
+
+namespace kolosal {
+namespace tracing {
+
+    /**
+     * @brief W3C trace context of the request handled on the current thread.
+     *
+     * Every request gets a trace id (echoed as X-Request-Id) once tracing is started;
+     * spans are only recorded for sampled requests, so unsampled ones cost a random
+     * id and a few thread-local reads.
+     */
+    struct TraceContext {
+        std::string traceId;    // 32 lowercase hex digits, empty when tracing is off
+        std::string spanId;     // 16 hex digits of the span new children attach to
+        bool sampled = false;
+        bool timed = false;     // Stage durations are collected for a Server-Timing header
+    };
+
+    enum class SpanKind {
+        Internal = 1,
+        Server = 2
+    };
+
+    // Starts the exporter; spans go to config.file and/or config.otlp_endpoint
+    KOLOSAL_SERVER_API void start(const TracingConfig& config);
+    // Flushes queued spans and stops the exporter
+    KOLOSAL_SERVER_API void stop();
+    KOLOSAL_SERVER_API bool enabled();
+
+    // Whether requests report their stage durations in a Server-Timing response header.
+    // Independent of start(): timings are kept per request and never exported.
+    KOLOSAL_SERVER_API void set_server_timing(bool enabled);
+
+    // Records a stage of the current request for Server-Timing; @p name must be a literal.
+    // A stage recorded twice keeps the longer duration, since repeats (one inference job
+    // per candidate) run side by side.
+    KOLOSAL_SERVER_API void add_timing(const char* name, double ms);
+    // Server-Timing value for the stages the current request has finished so far, plus
+    // its total time up to now; empty unless the request is timed
+    KOLOSAL_SERVER_API std::string server_timing();
+
+    // Sets the thread's context for a new request from its traceparent header (may be null).
+    // A valid parent's sampled flag is followed; requests without one are sampled at sample_rate.
+    KOLOSAL_SERVER_API const TraceContext& begin_request(const std::string* traceparent);
+    // Clears the thread's context once the response is written
+    KOLOSAL_SERVER_API void end_request();
+    KOLOSAL_SERVER_API const TraceContext& current();
+
+    // begin_request() for the lifetime of a request handler
+    class RequestScope {
+    public:
+        explicit RequestScope(const std::string* traceparent) : context_(begin_request(traceparent)) {}
+        ~RequestScope() { end_request(); }
+
+        RequestScope(const RequestScope&) = delete;
+        RequestScope& operator=(const RequestScope&) = delete;
+
+        const TraceContext& context() const { return context_; }
+
+    private:
+        const TraceContext& context_;
+    };
+
+    /**
+     * @brief A timed operation, child of the current context and current itself while alive.
+     *
+     * Does nothing for unsampled requests, except that Internal spans of timed requests
+     * also report their duration under @p name (a literal) in Server-Timing. Ends when
+     * destroyed.
+     */
+    class KOLOSAL_SERVER_API Span {
+    public:
+        explicit Span(const char* name, SpanKind kind = SpanKind::Internal);
+        ~Span();
+
+        Span(const Span&) = delete;
+        Span& operator=(const Span&) = delete;
+
+        bool recording() const { return data_ != nullptr; }
+        void setAttribute(const char* key, const std::string& value);
+        void setAttribute(const char* key, int64_t value);
+        void setError(const std::string& message);
+
+    private:
+        struct Data;
+        Data* data_ = nullptr;
+        const char* timingName_ = nullptr;
+        std::chrono::steady_clock::time_point timingStart_;
+    };
+
+    // Records the queue, prefill and decode phases of a finished inference job as children
+    // of the current span, and as Server-Timing stages, from the timestamps the engine
+    // kept on the job
+    KOLOSAL_SERVER_API void record_job(const JobTiming& timing, int jobId);
+
+} // namespace tracing
+} // namespace kolosal
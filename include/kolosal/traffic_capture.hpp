@@ -0,0 +1,48 @@
+#pragma once
+
+#include "export.hpp"
+#include "server_config.hpp"
+
+#include <cstdint>
+#include <string>
+
+namespace kolosal {
+namespace traffic_capture {
+
+    /**
+     * @brief One request as written to the capture file, for replay with bench/traffic_replay.
+     *
+     * Like the access log, the API key is stored only as the first 8 bytes of its SHA-256.
+     * The body is kept when it is JSON no larger than TrafficCaptureConfig::max_body_kb;
+     * with anonymize on, every string value in it (apart from structural fields such as
+     * "model" and "role") has each word replaced by a keyed hash of the same length, so
+     * prompt lengths and shared prefixes survive while the text does not.
+     */
+    struct CaptureRecord {
+        uint64_t timestampUs = 0;       // Unix time the request started, microseconds
+        uint32_t latencyUs = 0;         // Until the handler returned
+        uint16_t status = 0;
+        std::string method;
+        std::string path;               // As requested, query string included
+        std::string route;              // Pattern that selected the handler
+        uint64_t bytesIn = 0;           // Request body, before any Content-Encoding was removed
+        uint64_t bytesOut = 0;          // Everything written to the socket, headers included
+        std::string contentType;
+        uint64_t apiKeyHash = 0;        // 0 when no key was presented
+    };
+
+    // Starts the writer; records are appended to config.file as gzip-compressed NDJSON
+    KOLOSAL_SERVER_API void start(const TrafficCaptureConfig& config);
+    // Writes queued records and closes the file
+    KOLOSAL_SERVER_API void stop();
+    KOLOSAL_SERVER_API bool enabled();
+
+    // Queues the record if sampled. The body is copied only then, and parsed, anonymized
+    // and the apiKey hashed on the writer thread. body is null when the route streamed it.
+    KOLOSAL_SERVER_API void finish_request(CaptureRecord&& record, const std::string* body, std::string apiKey);
+
+    // Rewrites every word of text as a same-length pseudo-word derived from it and key
+    KOLOSAL_SERVER_API std::string anonymize_text(const std::string& text, uint64_t key);
+
+} // namespace traffic_capture
+} // namespace kolosal
@@ -1,20 +1,39 @@
 #pragma once
 
 #include "export.hpp"
+#include "http_compression.hpp"
+#include "request_arena.hpp"
 
 #include <string>
 #include <sstream>
 #include <iomanip>
 #include <map>
+#include <memory_resource>
+#include <string_view>
 #include <cstring>
-#include <map>
+#include <cstdio>
+#include <cstdint>
+#include <fstream>
+#include <vector>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
 
 #ifdef _WIN32
 #include <winsock2.h>
 using SocketType = SOCKET;
 #else
 #include <sys/socket.h>
+#include <sys/uio.h>
+#include <poll.h>
 #include <unistd.h>
+#include <cerrno>
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/sendfile.h>
+#endif
 using SocketType = int;
 #endif
 
@@ -31,9 +50,12 @@ struct StreamChunk {
 // Get standard status text for HTTP status code
 inline std::string get_status_text(int status_code) {
     switch (status_code) {
+    case 101: return "Switching Protocols";
     case 200: return "OK";
     case 201: return "Created";
     case 204: return "No Content";
+    case 206: return "Partial Content";
+    case 304: return "Not Modified";
     case 400: return "Bad Request";
     case 401: return "Unauthorized";
     case 403: return "Forbidden";
@@ -41,12 +63,16 @@ inline std::string get_status_text(int status_code) {
     case 405: return "Method Not Allowed";
     case 409: return "Conflict";
     case 413: return "Payload Too Large";
+    case 416: return "Range Not Satisfiable";
     case 422: return "Unprocessable Entity";
+    case 426: return "Upgrade Required";
     case 429: return "Too Many Requests";
+    case 431: return "Request Header Fields Too Large";
     case 500: return "Internal Server Error";
     case 501: return "Not Implemented";
     case 502: return "Bad Gateway";
     case 503: return "Service Unavailable";
+    case 505: return "HTTP Version Not Supported";
     default:  return "Error";
     }
 }
@@ -54,47 +80,326 @@ inline std::string get_status_text(int status_code) {
 // Thread-local default headers to apply to all responses within a request handling thread
 namespace kolosal {
 namespace http_internal {
-    inline thread_local std::map<std::string, std::string> g_default_response_headers;
+    // Points at the server's per-request header map rather than copying it; the server
+    // clears it before that map goes away
+    inline thread_local const std::map<std::string, std::string>* g_default_response_headers = nullptr;
 
     inline void set_default_response_headers(const std::map<std::string, std::string>& headers) {
-        g_default_response_headers = headers; // replace per request
+        g_default_response_headers = &headers; // replace per request
     }
 
     inline void clear_default_response_headers() {
-        g_default_response_headers.clear();
+        g_default_response_headers = nullptr;
+    }
+
+    inline const std::map<std::string, std::string>& default_response_headers() {
+        static const std::map<std::string, std::string> kNone;
+        return g_default_response_headers ? *g_default_response_headers : kNone;
+    }
+
+    // Per-request connection reuse tracking. The server enables keep-alive before
+    // dispatching a request; the response helpers record whether the response was
+    // delimited (Content-Length or a finished chunked stream) so the socket can be
+    // reused. Routes that write raw bytes never touch this, so their sockets close.
+    inline thread_local bool g_keep_alive = false;
+    inline thread_local int g_delimited_responses = 0;
+    inline thread_local bool g_stream_open = false;
+    inline thread_local bool g_write_failed = false;
+    inline thread_local int g_response_status = 0;  // First status line written, for request metrics
+    inline thread_local uint64_t g_response_bytes = 0;  // Bytes written to the socket, for the access log
+
+    // Produces the Server-Timing value for the response being written; set by the server
+    // while it handles a request that reports its timings
+    inline thread_local std::string (*g_server_timing)() = nullptr;
+
+    // Stream frames queued by send_stream_chunk(..., false), written with the next flushed frame
+    inline thread_local std::string g_stream_pending;
+
+    inline void begin_response_tracking(bool keepAlive) {
+        g_keep_alive = keepAlive;
+        g_delimited_responses = 0;
+        g_stream_open = false;
+        g_write_failed = false;
+        g_response_status = 0;
+        g_response_bytes = 0;
+        g_stream_pending.clear();
+    }
+
+    inline bool response_allows_reuse() {
+        return g_keep_alive && g_delimited_responses == 1 && !g_stream_open && !g_write_failed;
+    }
+
+    inline const char* connection_header_value() {
+        return g_keep_alive ? "keep-alive" : "close";
+    }
+
+    // One piece of a gathered write; the bytes are not copied
+    struct IoSlice {
+        const char* data;
+        size_t size;
+    };
+
+    // How long a write may wait for the peer to drain its receive window
+    constexpr int kSendWaitMs = 30000;
+
+    // TLS of a connection whose records are at least partly handled in user space. When the
+    // kernel encrypts the send side (kTLS), responses are written to the socket directly, which
+    // keeps gathered writes and sendfile(); otherwise they go through write()
+    class SecureChannel {
+    public:
+        virtual ~SecureChannel() = default;
+        virtual bool kernelSend() const = 0;
+        // Writes every byte of the slices as TLS records; false if the peer went away
+        virtual bool write(IoSlice* slices, size_t count) = 0;
+        // Decrypted bytes with recv() semantics: > 0 read, 0 the peer closed, < 0 failed or timed out
+        virtual long read(char* data, size_t size) = 0;
+        // Decrypted bytes already taken off the socket, which poll() cannot see
+        virtual bool hasBuffered() const = 0;
+        // Tells the peer the connection is closing, just before the socket is
+        virtual void shutdown() = 0;
+    };
+
+    // Channels of the open TLS sockets. Lookups cost one relaxed load while there are none
+    class SecureChannels {
+    public:
+        static SecureChannels& instance() {
+            static SecureChannels channels;
+            return channels;
+        }
+
+        void add(SocketType sock, std::shared_ptr<SecureChannel> channel) {
+            std::unique_lock<std::shared_mutex> lock(mutex_);
+            if (channels_.insert_or_assign(sock, std::move(channel)).second) count_.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        std::shared_ptr<SecureChannel> remove(SocketType sock) {
+            if (count_.load(std::memory_order_relaxed) == 0) return nullptr;
+            std::unique_lock<std::shared_mutex> lock(mutex_);
+            auto it = channels_.find(sock);
+            if (it == channels_.end()) return nullptr;
+            std::shared_ptr<SecureChannel> channel = std::move(it->second);
+            channels_.erase(it);
+            count_.fetch_sub(1, std::memory_order_relaxed);
+            return channel;
+        }
+
+        std::shared_ptr<SecureChannel> find(SocketType sock) const {
+            if (count_.load(std::memory_order_relaxed) == 0) return nullptr;
+            std::shared_lock<std::shared_mutex> lock(mutex_);
+            auto it = channels_.find(sock);
+            return it == channels_.end() ? nullptr : it->second;
+        }
+
+    private:
+        mutable std::shared_mutex mutex_;
+        std::unordered_map<SocketType, std::shared_ptr<SecureChannel>> channels_;
+        std::atomic<size_t> count_{0};
+    };
+
+    // recv() on a connection, decrypted first when it is TLS
+    inline long socket_recv(SocketType sock, char* data, size_t size) {
+        if (auto channel = SecureChannels::instance().find(sock)) return channel->read(data, size);
+        return static_cast<long>(recv(sock, data, static_cast<int>(size), 0));
+    }
+
+    // Whether bytes written straight to the socket reach the client as they are: plain TCP, or kTLS
+    inline bool writes_bypass_tls(SocketType sock) {
+        auto channel = SecureChannels::instance().find(sock);
+        return !channel || channel->kernelSend();
+    }
+
+    // Write every byte of the slices with one gathered syscall per pass (writev-style
+    // sendmsg, or WSASend on Windows). Short writes resume where they stopped, and
+    // EAGAIN on a non-blocking socket waits for writability. Returns false, and marks
+    // the connection as not reusable, if the peer went away or stopped reading.
+    inline bool send_all(SocketType sock, IoSlice* slices, size_t count) {
+        if (auto channel = SecureChannels::instance().find(sock); channel && !channel->kernelSend()) {
+            uint64_t total = 0;
+            for (size_t i = 0; i < count; ++i) total += slices[i].size;
+            if (!channel->write(slices, count)) {
+                g_write_failed = true;
+                return false;
+            }
+            g_response_bytes += total;
+            return true;
+        }
+
+        size_t first = 0;
+        while (first < count && slices[first].size == 0) ++first;
+
+        while (first < count) {
+            constexpr size_t kMaxSlices = 16;
+            const size_t batch = (count - first) < kMaxSlices ? (count - first) : kMaxSlices;
+#ifdef _WIN32
+            WSABUF bufs[kMaxSlices];
+            for (size_t i = 0; i < batch; ++i) {
+                bufs[i].buf = const_cast<char*>(slices[first + i].data);
+                bufs[i].len = static_cast<ULONG>(slices[first + i].size);
+            }
+            DWORD sentBytes = 0;
+            if (WSASend(sock, bufs, static_cast<DWORD>(batch), &sentBytes, 0, nullptr, nullptr) == SOCKET_ERROR) {
+                if (WSAGetLastError() == WSAEWOULDBLOCK) {
+                    WSAPOLLFD pfd{sock, POLLWRNORM, 0};
+                    if (WSAPoll(&pfd, 1, kSendWaitMs) > 0) continue;
+                }
+                g_write_failed = true;
+                return false;
+            }
+            size_t sent = sentBytes;
+#else
+            struct iovec iov[kMaxSlices];
+            for (size_t i = 0; i < batch; ++i) {
+                iov[i].iov_base = const_cast<char*>(slices[first + i].data);
+                iov[i].iov_len = slices[first + i].size;
+            }
+            struct msghdr msg{};
+            msg.msg_iov = iov;
+            msg.msg_iovlen = batch;
+#ifdef MSG_NOSIGNAL
+            const int flags = MSG_NOSIGNAL;   // A closed peer returns EPIPE instead of killing the process
+#else
+            const int flags = 0;
+#endif
+            ssize_t n = sendmsg(sock, &msg, flags);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    struct pollfd pfd{sock, POLLOUT, 0};
+                    if (poll(&pfd, 1, kSendWaitMs) > 0) continue;
+                }
+                g_write_failed = true;
+                return false;
+            }
+            size_t sent = static_cast<size_t>(n);
+#endif
+            g_response_bytes += sent;
+            // Skip what went out; a partially written slice is trimmed in place
+            while (first < count && sent >= slices[first].size) {
+                sent -= slices[first].size;
+                ++first;
+            }
+            if (first < count) {
+                slices[first].data += sent;
+                slices[first].size -= sent;
+                while (first < count && slices[first].size == 0) ++first;
+            }
+        }
+        return true;
+    }
+
+    // Raw bytes a route assembled itself, encrypted when the connection is TLS
+    inline bool send_all(SocketType sock, const std::string& data) {
+        IoSlice slice{data.data(), data.size()};
+        return send_all(sock, &slice, 1);
+    }
+
+    // Per-thread scratch space for response headers, reused across responses
+    inline std::string& header_buffer() {
+        thread_local std::string buffer;
+        buffer.clear();
+        return buffer;
+    }
+
+    inline void append_header(std::string& out, const std::string& name, const std::string& value) {
+        out.append(name).append(": ").append(value).append("\r\n");
+    }
+
+    // Stages finished before the head goes out; for streams that is up to the first token
+    inline void append_server_timing(std::string& out) {
+        if (!g_server_timing) return;
+        const std::string value = g_server_timing();
+        if (!value.empty()) append_header(out, "Server-Timing", value);
+    }
+
+    inline const std::string* find_header(const std::map<std::string, std::string>& headers,
+                                          const char* name, const char* lowerName) {
+        auto it = headers.find(name);
+        if (it == headers.end()) it = headers.find(lowerName);
+        return it == headers.end() ? nullptr : &it->second;
     }
 }
 }
 
-// Regular response helper with support for custom headers
+// Whether the client has gone away: a write on this thread failed, or the peer closed or
+// reset the connection. Non-blocking; bytes of a pipelined next request do not count.
+// Routes waiting on long-running work call this to cancel it when nobody is listening.
+inline bool client_disconnected(SocketType sock) {
+    if (kolosal::http_internal::g_write_failed) return true;
+    char probe;
+#ifdef _WIN32
+    fd_set readable;
+    FD_ZERO(&readable);
+    FD_SET(sock, &readable);
+    timeval noWait{0, 0};
+    int ready = select(0, &readable, nullptr, nullptr, &noWait);
+    if (ready <= 0) return ready < 0;
+    // Readable, so the peek does not block
+    return recv(sock, &probe, 1, MSG_PEEK) <= 0;
+#else
+    struct pollfd pfd{sock, POLLIN, 0};
+    int ready = poll(&pfd, 1, 0);
+    if (ready <= 0) return false;
+    if (pfd.revents & (POLLERR | POLLNVAL)) return true;
+    ssize_t n = recv(sock, &probe, 1, MSG_PEEK | MSG_DONTWAIT);
+    if (n > 0) return false;
+    return n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR);
+#endif
+}
+
+// Regular response helper with support for custom headers. The head and the body
+// go out in one gathered write, so the body is never copied.
 inline KOLOSAL_SERVER_API void send_response(
     SocketType sock,
     int status_code,
     const std::string& body,
     const std::map<std::string, std::string>& headers = { {"Content-Type", "application/json"} }) {
 
-    std::ostringstream response;
-    response << "HTTP/1.1 " << status_code << " " << get_status_text(status_code) << "\r\n";
-    response << "Content-Length: " << body.size() << "\r\n";
-    response << "Connection: close\r\n";
+    using kolosal::http_internal::find_header;
 
-    // Merge thread-local defaults with provided headers (provided overrides defaults)
-    std::map<std::string, std::string> merged = kolosal::http_internal::g_default_response_headers;
-    for (const auto& [name, value] : headers) {
-        merged[name] = value;
+    // Compress with the coding negotiated for this request, unless the caller already encoded it
+    const std::string* payload = &body;
+    const char* encoding = nullptr;
+    if (!find_header(headers, "Content-Encoding", "content-encoding")) {
+        const std::string* type = find_header(headers, "Content-Type", "content-type");
+        if (!type) type = find_header(kolosal::http_internal::default_response_headers(), "Content-Type", "content-type");
+        if (type) {
+            if (const std::string* compressed = kolosal::http_internal::compress_response(body, *type, &encoding)) {
+                payload = compressed;
+            }
+        }
     }
 
-    // Add all headers
-    for (const auto& [name, value] : merged) {
-        response << name << ": " << value << "\r\n";
+    std::string& head = kolosal::http_internal::header_buffer();
+    head.append("HTTP/1.1 ").append(std::to_string(status_code)).append(" ")
+        .append(get_status_text(status_code)).append("\r\n");
+    head.append("Content-Length: ").append(std::to_string(payload->size())).append("\r\n");
+    if (encoding) {
+        head.append("Content-Encoding: ").append(encoding).append("\r\n");
+        head.append("Vary: Accept-Encoding\r\n");
+    }
+    head.append("Connection: ").append(kolosal::http_internal::connection_header_value()).append("\r\n");
+    ++kolosal::http_internal::g_delimited_responses;
+    if (kolosal::http_internal::g_response_status == 0) kolosal::http_internal::g_response_status = status_code;
+
+    // Thread-local defaults first, skipping any the caller overrides
+    for (const auto& [name, value] : kolosal::http_internal::default_response_headers()) {
+        if (headers.find(name) == headers.end()) {
+            kolosal::http_internal::append_header(head, name, value);
+        }
+    }
+    for (const auto& [name, value] : headers) {
+        kolosal::http_internal::append_header(head, name, value);
     }
+    kolosal::http_internal::append_server_timing(head);
 
     // End of headers
-    response << "\r\n";
-    // Add body
-    response << body;
+    head.append("\r\n");
 
-    send(sock, response.str().c_str(), static_cast<int>(response.str().size()), 0);
+    kolosal::http_internal::IoSlice slices[] = {
+        {head.data(), head.size()},
+        {payload->data(), payload->size()}
+    };
+    kolosal::http_internal::send_all(sock, slices, 2);
 }
 
 // Function to start a streaming response with SSE support
@@ -103,76 +408,217 @@ inline KOLOSAL_SERVER_API void begin_streaming_response(
     int status_code,
     const std::map<std::string, std::string>& headers = {}) {
 
-    std::ostringstream headerStream;
-    headerStream << "HTTP/1.1 " << status_code << " " << get_status_text(status_code) << "\r\n";
+    // Everything here lives for this call only, so it comes from the request arena
+    std::pmr::memory_resource* memory = kolosal::RequestArena::resource();
+    std::pmr::string head(memory);
+    head.reserve(512);
+    auto line = [&head](std::string_view name, std::string_view value) {
+        head.append(name).append(": ").append(value).append("\r\n");
+    };
+
+    head.append("HTTP/1.1 ").append(std::to_string(status_code)).append(" ")
+        .append(get_status_text(status_code)).append("\r\n");
 
     // Default headers for streaming
-    headerStream << "Transfer-Encoding: chunked\r\n";
-    headerStream << "Connection: keep-alive\r\n";
-    headerStream << "Cache-Control: no-cache\r\n";
-    // Merge thread-local defaults with provided headers (provided overrides defaults)
-    std::map<std::string, std::string> merged = kolosal::http_internal::g_default_response_headers;
+    line("Transfer-Encoding", "chunked");
+    line("Connection", kolosal::http_internal::connection_header_value());
+    ++kolosal::http_internal::g_delimited_responses;
+    kolosal::http_internal::g_stream_open = true;
+    if (kolosal::http_internal::g_response_status == 0) kolosal::http_internal::g_response_status = status_code;
+    line("Cache-Control", "no-cache");
+    // Merge thread-local defaults with provided headers (provided overrides defaults).
+    // Both maps outlive this call, so the merge only refers to their strings.
+    std::pmr::map<std::string_view, const std::string*> merged(memory);
+    for (const auto& kv : kolosal::http_internal::default_response_headers()) {
+        merged[kv.first] = &kv.second;
+    }
     for (const auto& kv : headers) {
-        merged[kv.first] = kv.second;
+        merged[kv.first] = &kv.second;
     }
+    auto findMerged = [&merged](std::string_view name, std::string_view lowerName) -> const std::string* {
+        auto it = merged.find(name);
+        if (it == merged.end()) it = merged.find(lowerName);
+        return it == merged.end() ? nullptr : it->second;
+    };
 
     // CORS headers: only add permissive defaults if caller did not supply any CORS header
-    bool hasOrigin = false;
-    for (const auto &kv : merged) {
-        if (kv.first == "Access-Control-Allow-Origin" || kv.first == "access-control-allow-origin") { hasOrigin = true; break; }
-    }
-    if (!hasOrigin) {
-        headerStream << "Access-Control-Allow-Origin: *\r\n";
-        headerStream << "Access-Control-Allow-Methods: GET, POST, PUT, DELETE, OPTIONS\r\n";
-        headerStream << "Access-Control-Allow-Headers: Content-Type, Authorization, X-Requested-With, X-API-Key\r\n";
+    if (!findMerged("Access-Control-Allow-Origin", "access-control-allow-origin")) {
+        line("Access-Control-Allow-Origin", "*");
+        line("Access-Control-Allow-Methods", "GET, POST, PUT, DELETE, OPTIONS");
+        line("Access-Control-Allow-Headers", "Content-Type, Authorization, X-Requested-With, X-API-Key");
     }
-    headerStream << "X-Content-Type-Options: nosniff\r\n";
-    headerStream << "X-Frame-Options: DENY\r\n";
-    headerStream << "X-XSS-Protection: 1; mode=block\r\n";
-
-    // Add SSE headers if not present in custom headers
-    bool hasContentType = false;
+    line("X-Content-Type-Options", "nosniff");
+    line("X-Frame-Options", "DENY");
+    line("X-XSS-Protection", "1; mode=block");
 
     // Add all headers
     for (const auto& [name, value] : merged) {
-        headerStream << name << ": " << value << "\r\n";
-        if (name == "Content-Type" || name == "content-type") {
-            hasContentType = true;
-        }
+        line(name, *value);
     }
 
     // Default to text/plain for streaming if no Content-Type provided
     // This is important for OpenAI API compatibility with streaming responses
-    if (!hasContentType) {
-        headerStream << "Content-Type: text/plain; charset=utf-8\r\n";
+    static const std::string kDefaultStreamType = "text/plain; charset=utf-8";
+    const std::string* contentType = findMerged("Content-Type", "content-type");
+    if (!contentType) {
+        contentType = &kDefaultStreamType;
+        line("Content-Type", kDefaultStreamType);
+    }
+
+    // Frames are compressed as they are sent, each flushed so the client can decode it at once
+    if (!findMerged("Content-Encoding", "content-encoding")) {
+        if (const char* encoding = kolosal::http_internal::begin_stream_compression(*contentType)) {
+            line("Content-Encoding", encoding);
+            line("Vary", "Accept-Encoding");
+        }
+    }
+    if (kolosal::http_internal::g_server_timing) {
+        const std::string timing = kolosal::http_internal::g_server_timing();
+        if (!timing.empty()) line("Server-Timing", timing);
     }
 
     // End of headers
-    headerStream << "\r\n";
+    head.append("\r\n");
 
-    std::string headerString = headerStream.str();
-    send(sock, headerString.c_str(), static_cast<int>(headerString.size()), 0);
+    kolosal::http_internal::IoSlice slices[] = {{head.data(), head.size()}};
+    kolosal::http_internal::send_all(sock, slices, 1);
 }
 
-// Function to send a single stream chunk - modified to handle SSE format better
-inline KOLOSAL_SERVER_API void send_stream_chunk(SocketType sock, const StreamChunk& chunk) {
-    // Only send non-empty chunks
-    if (!chunk.data.empty()) {
-        // Format the chunk according to HTTP chunked encoding
-        std::stringstream ss;
-        ss << std::hex << chunk.data.size();
-        std::string hex_length = ss.str();
+// Send one chunk of a chunked (SSE) stream. The size line, payload and trailing CRLF
+// are gathered into a single write, together with any frames queued before it and,
+// for the final chunk, the terminating zero-length chunk. Pass flush = false for a
+// frame that is immediately followed by another (e.g. "[DONE]" before the end of the
+// stream) to queue it and save a syscall; the next flushed chunk carries it.
+// On a compressed stream a queued frame is only fed to the compressor, and the
+// next flushed chunk sync-flushes both.
+inline KOLOSAL_SERVER_API void send_stream_chunk(SocketType sock, const StreamChunk& chunk, bool flush = true) {
+    using kolosal::http_internal::g_stream_pending;
+    static const char kCrlf[] = "\r\n";
+    static const char kEndChunk[] = "0\r\n\r\n";
 
-        std::string chunk_header = hex_length + "\r\n";
-        std::string chunk_data = chunk.data + "\r\n";
+    const std::string* payload = &chunk.data;
+    if (kolosal::http_internal::stream_compressed()) {
+        payload = &kolosal::http_internal::compress_stream_frame(chunk.data, flush, chunk.isComplete);
+    }
+
+    char sizeLine[24];
+    int sizeLen = 0;
+    if (!payload->empty()) {
+        sizeLen = std::snprintf(sizeLine, sizeof(sizeLine), "%zx\r\n", payload->size());
+    }
 
-        send(sock, chunk_header.c_str(), static_cast<int>(chunk_header.size()), 0);
-        send(sock, chunk_data.c_str(), static_cast<int>(chunk_data.size()), 0);
+    if (!flush && !chunk.isComplete) {
+        if (sizeLen > 0) {
+            g_stream_pending.append(sizeLine, static_cast<size_t>(sizeLen));
+            g_stream_pending.append(*payload).append(kCrlf, 2);
+        }
+        return;
     }
 
-    // If this is the final chunk, send the terminating empty chunk
+    kolosal::http_internal::IoSlice slices[5];
+    size_t count = 0;
+    if (!g_stream_pending.empty()) {
+        slices[count++] = {g_stream_pending.data(), g_stream_pending.size()};
+    }
+    if (sizeLen > 0) {
+        slices[count++] = {sizeLine, static_cast<size_t>(sizeLen)};
+        slices[count++] = {payload->data(), payload->size()};
+        slices[count++] = {kCrlf, 2};
+    }
     if (chunk.isComplete) {
-        const char* end_chunk = "0\r\n\r\n";
-        send(sock, end_chunk, static_cast<int>(strlen(end_chunk)), 0);
+        slices[count++] = {kEndChunk, sizeof(kEndChunk) - 1};
+        kolosal::http_internal::g_stream_open = false;
     }
-}
\ No newline at end of file
+
+    if (count > 0) {
+        kolosal::http_internal::send_all(sock, slices, count);
+    }
+    g_stream_pending.clear();   // Keeps its capacity for the next frames
+}
+
+// Send `length` bytes of a file starting at `offset` as the response body, without reading the
+// file into memory: sendfile() on Linux, 1 MB reads elsewhere. Responses are never compressed.
+// With sendBody false only the headers go out (HEAD). Returns false if the file could not be
+// read or the client went away.
+inline KOLOSAL_SERVER_API bool send_file_response(
+    SocketType sock,
+    int status_code,
+    const std::string& path,
+    std::uint64_t offset,
+    std::uint64_t length,
+    const std::map<std::string, std::string>& headers,
+    bool sendBody = true) {
+
+    std::string& head = kolosal::http_internal::header_buffer();
+    head.append("HTTP/1.1 ").append(std::to_string(status_code)).append(" ")
+        .append(get_status_text(status_code)).append("\r\n");
+    head.append("Content-Length: ").append(std::to_string(length)).append("\r\n");
+    head.append("Connection: ").append(kolosal::http_internal::connection_header_value()).append("\r\n");
+    ++kolosal::http_internal::g_delimited_responses;
+    if (kolosal::http_internal::g_response_status == 0) kolosal::http_internal::g_response_status = status_code;
+    for (const auto& [name, value] : kolosal::http_internal::default_response_headers()) {
+        if (headers.find(name) == headers.end()) {
+            kolosal::http_internal::append_header(head, name, value);
+        }
+    }
+    for (const auto& [name, value] : headers) {
+        kolosal::http_internal::append_header(head, name, value);
+    }
+    kolosal::http_internal::append_server_timing(head);
+    head.append("\r\n");
+
+    kolosal::http_internal::IoSlice headSlice[] = {{head.data(), head.size()}};
+    if (!kolosal::http_internal::send_all(sock, headSlice, 1)) return false;
+    if (!sendBody || length == 0) return true;
+
+#ifdef __linux__
+    // TLS encrypted in user space needs the bytes in memory; under kTLS the kernel encrypts sendfile()
+    if (kolosal::http_internal::writes_bypass_tls(sock)) {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            kolosal::http_internal::g_write_failed = true;
+            return false;
+        }
+        off_t position = static_cast<off_t>(offset);
+        std::uint64_t remaining = length;
+        while (remaining > 0) {
+            const size_t step = remaining < (std::uint64_t(1) << 30) ? static_cast<size_t>(remaining) : (size_t(1) << 30);
+            ssize_t n = ::sendfile(sock, fd, &position, step);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    struct pollfd pfd{sock, POLLOUT, 0};
+                    if (poll(&pfd, 1, kolosal::http_internal::kSendWaitMs) > 0) continue;
+                }
+                break;
+            }
+            if (n == 0) break;  // The file shrank underneath us
+            remaining -= static_cast<std::uint64_t>(n);
+        }
+        ::close(fd);
+        if (remaining > 0) {
+            kolosal::http_internal::g_write_failed = true;
+            return false;
+        }
+        return true;
+    }
+#endif
+    std::ifstream file(path, std::ios::binary);
+    if (!file || !file.seekg(static_cast<std::streamoff>(offset))) {
+        kolosal::http_internal::g_write_failed = true;
+        return false;
+    }
+    std::vector<char> buffer(1 << 20);
+    std::uint64_t remaining = length;
+    while (remaining > 0) {
+        const size_t step = remaining < buffer.size() ? static_cast<size_t>(remaining) : buffer.size();
+        if (!file.read(buffer.data(), static_cast<std::streamsize>(step))) {
+            kolosal::http_internal::g_write_failed = true;
+            return false;
+        }
+        kolosal::http_internal::IoSlice slice[] = {{buffer.data(), step}};
+        if (!kolosal::http_internal::send_all(sock, slice, 1)) return false;
+        remaining -= step;
+    }
+    return true;
+}
@@ -2,9 +2,14 @@
 
 #include "export.hpp"
 #include "qdrant_client.hpp"
+#include "task_executor.hpp"
 #ifdef USE_FAISS
 #include "faiss_client.hpp"
 #endif
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <istream>
 #include <memory>
 #include <future>
 #include <string>
@@ -83,34 +88,52 @@ struct VectorResult
     nlohmann::json response_data;
     
     // Create from Qdrant result
-    static VectorResult fromQdrantResult(const QdrantResult& qresult)
+    // Taken by value so a result that is no longer needed hands over its points without a copy
+    static VectorResult fromQdrantResult(QdrantResult qresult)
     {
         VectorResult result;
         result.success = qresult.success;
-        result.error_message = qresult.error_message;
+        result.error_message = std::move(qresult.error_message);
         result.status_code = qresult.status_code;
-        result.successful_ids = qresult.successful_ids;
-        result.failed_ids = qresult.failed_ids;
-        result.response_data = qresult.response_data;
+        result.successful_ids = std::move(qresult.successful_ids);
+        result.failed_ids = std::move(qresult.failed_ids);
+        result.response_data = std::move(qresult.response_data);
         return result;
     }
     
 #ifdef USE_FAISS    
     // Create from FAISS result
-    static VectorResult fromFaissResult(const FaissResult& fresult)
+    static VectorResult fromFaissResult(FaissResult fresult)
     {
         VectorResult result;
         result.success = fresult.success;
-        result.error_message = fresult.error_message;
+        result.error_message = std::move(fresult.error_message);
         result.status_code = fresult.status_code;
-        result.successful_ids = fresult.successful_ids;
-        result.failed_ids = fresult.failed_ids;
-        result.response_data = fresult.response_data;
+        result.successful_ids = std::move(fresult.successful_ids);
+        result.failed_ids = std::move(fresult.failed_ids);
+        result.response_data = std::move(fresult.response_data);
         return result;
     }
 #endif
 };
 
+/**
+ * @brief Per-query search knobs; 0 keeps the backend's default
+ */
+struct VectorSearchParams
+{
+    int nprobe = 0;     // FAISS IVF lists to visit
+    int efSearch = 0;   // HNSW candidate list size (FAISS efSearch, Qdrant hnsw_ef)
+    nlohmann::json filter;  // Qdrant filter syntax; FAISS compiles it to an id selector. null = none
+    std::vector<std::string> fields;    // Payload keys returned with each hit; empty = all
+    std::chrono::steady_clock::time_point deadline;    // Fail with status 504 once passed; the epoch = none
+
+    bool expired() const
+    {
+        return deadline != std::chrono::steady_clock::time_point{} && std::chrono::steady_clock::now() >= deadline;
+    }
+};
+
 /**
  * @brief Abstract vector database client interface
  */
@@ -125,8 +148,53 @@ public:
     virtual std::future<VectorResult> upsertPoints(const std::string& collection_name, const std::vector<VectorPoint>& points) = 0;
     virtual std::future<VectorResult> deletePoints(const std::string& collection_name, const std::vector<std::string>& point_ids) = 0;
     virtual std::future<VectorResult> getPoints(const std::string& collection_name, const std::vector<std::string>& point_ids) = 0;
-    virtual std::future<VectorResult> search(const std::string& collection_name, const std::vector<float>& query_vector, int limit = 10, float score_threshold = 0.0f) = 0;
-    virtual std::future<VectorResult> scrollPoints(const std::string& collection_name, int limit = 1000, const std::string& offset = "") = 0;
+    virtual std::future<VectorResult> search(const std::string& collection_name, const std::vector<float>& query_vector, int limit = 10, float score_threshold = 0.0f, const VectorSearchParams& params = {}) = 0;
+    // Searches all query vectors in one backend call; response_data["result"] holds one hit list per query
+    virtual std::future<VectorResult> searchBatch(const std::string& collection_name, const std::vector<std::vector<float>>& query_vectors, int limit = 10, float score_threshold = 0.0f, const VectorSearchParams& params = {}) = 0;
+    // One page of points in a stable order; response_data["next_page_offset"] is the cursor of the next page, absent at the end.
+    // Listings that only need ids pass with_payload = false; a filter (Qdrant syntax, null = none) restricts the points walked
+    virtual std::future<VectorResult> scrollPoints(const std::string& collection_name, int limit = 1000, const std::string& offset = "", bool with_payload = true, const nlohmann::json& filter = nullptr) = 0;
+    // Memory the backend holds in this process, for /debug/memory; null for remote backends
+    virtual nlohmann::json memoryUsage() const { return nullptr; }
+
+    // Replication of a collection to another server (see FaissClient). Only a single FAISS
+    // backend keeps the write-ahead log it streams; the others answer 501.
+    virtual VectorResult exportSnapshot(const std::string& collection_name, const std::function<bool(const char*, size_t)>& sink)
+    {
+        return replicationUnsupported();
+    }
+    virtual VectorResult importSnapshot(const std::string& collection_name, std::istream& in)
+    {
+        return replicationUnsupported();
+    }
+    virtual VectorResult readChanges(const std::string& collection_name, const std::string& epoch, uint64_t position, size_t max_bytes, std::string& records)
+    {
+        return replicationUnsupported();
+    }
+    virtual std::future<VectorResult> applyChanges(const std::string& collection_name, std::string records)
+    {
+        std::promise<VectorResult> unsupported;
+        unsupported.set_value(replicationUnsupported());
+        return unsupported.get_future();
+    }
+
+protected:
+    // What a search whose VectorSearchParams::deadline passed before it could start returns
+    static VectorResult deadlineExceeded()
+    {
+        VectorResult result;
+        result.error_message = "Deadline exceeded";
+        result.status_code = 504;
+        return result;
+    }
+
+    static VectorResult replicationUnsupported()
+    {
+        VectorResult result;
+        result.error_message = "Replication needs a single FAISS vector store";
+        result.status_code = 501;
+        return result;
+    }
 };
 
 /**
@@ -145,70 +213,78 @@ public:
     
     std::future<VectorResult> testConnection() override
     {
-        return std::async(std::launch::async, [this]() {
+        return TaskExecutor::instance().submit([this]() {
             auto result = client_->testConnection().get();
-            return VectorResult::fromQdrantResult(result);
+            return VectorResult::fromQdrantResult(std::move(result));
         });
     }
     
     std::future<VectorResult> createCollection(const std::string& collection_name, int vector_size, const std::string& distance) override
     {
-        return std::async(std::launch::async, [this, collection_name, vector_size, distance]() {
+        return TaskExecutor::instance().submit([this, collection_name, vector_size, distance]() {
             auto result = client_->createCollection(collection_name, vector_size, distance).get();
-            return VectorResult::fromQdrantResult(result);
+            return VectorResult::fromQdrantResult(std::move(result));
         });
     }
     
     std::future<VectorResult> collectionExists(const std::string& collection_name) override
     {
-        return std::async(std::launch::async, [this, collection_name]() {
+        return TaskExecutor::instance().submit([this, collection_name]() {
             auto result = client_->collectionExists(collection_name).get();
-            return VectorResult::fromQdrantResult(result);
+            return VectorResult::fromQdrantResult(std::move(result));
         });
     }
     
     std::future<VectorResult> upsertPoints(const std::string& collection_name, const std::vector<VectorPoint>& points) override
     {
-        return std::async(std::launch::async, [this, collection_name, points]() {
+        return TaskExecutor::instance().submit([this, collection_name, points]() {
             std::vector<QdrantPoint> qpoints;
             for (const auto& point : points)
             {
                 qpoints.push_back(point.toQdrantPoint());
             }
             auto result = client_->upsertPoints(collection_name, qpoints).get();
-            return VectorResult::fromQdrantResult(result);
+            return VectorResult::fromQdrantResult(std::move(result));
         });
     }
     
     std::future<VectorResult> deletePoints(const std::string& collection_name, const std::vector<std::string>& point_ids) override
     {
-        return std::async(std::launch::async, [this, collection_name, point_ids]() {
+        return TaskExecutor::instance().submit([this, collection_name, point_ids]() {
             auto result = client_->deletePoints(collection_name, point_ids).get();
-            return VectorResult::fromQdrantResult(result);
+            return VectorResult::fromQdrantResult(std::move(result));
         });
     }
     
     std::future<VectorResult> getPoints(const std::string& collection_name, const std::vector<std::string>& point_ids) override
     {
-        return std::async(std::launch::async, [this, collection_name, point_ids]() {
+        return TaskExecutor::instance().submit([this, collection_name, point_ids]() {
             auto result = client_->getPoints(collection_name, point_ids).get();
-            return VectorResult::fromQdrantResult(result);
+            return VectorResult::fromQdrantResult(std::move(result));
         });
     }
     
-    std::future<VectorResult> search(const std::string& collection_name, const std::vector<float>& query_vector, int limit, float score_threshold) override
+    std::future<VectorResult> search(const std::string& collection_name, const std::vector<float>& query_vector, int limit, float score_threshold, const VectorSearchParams& params) override
     {
-        return std::async(std::launch::async, [this, collection_name, query_vector, limit, score_threshold]() {
-            auto result = client_->search(collection_name, query_vector, limit, score_threshold).get();
-            return VectorResult::fromQdrantResult(result);
+        return TaskExecutor::instance().submit([this, collection_name, query_vector, limit, score_threshold, params]() {
+            auto result = client_->search(collection_name, query_vector, limit, score_threshold, params.efSearch, params.filter, params.fields, params.deadline).get();
+            return VectorResult::fromQdrantResult(std::move(result));
         });
     }
     
-    std::future<VectorResult> scrollPoints(const std::string& collection_name, int limit, const std::string& offset) override
+    std::future<VectorResult> searchBatch(const std::string& collection_name, const std::vector<std::vector<float>>& query_vectors, int limit, float score_threshold, const VectorSearchParams& params) override
     {
-        return std::async(std::launch::async, [this, collection_name, limit, offset]() {
-            auto result = client_->scrollPoints(collection_name, limit, offset).get();
-            return VectorResult::fromQdrantResult(result);
+        return TaskExecutor::instance().submit([this, collection_name, query_vectors, limit, score_threshold, params]() {
+            auto result = client_->searchBatch(collection_name, query_vectors, limit, score_threshold, params.efSearch, params.filter, params.fields, params.deadline).get();
+            return VectorResult::fromQdrantResult(std::move(result));
+        });
+    }
+    
+    std::future<VectorResult> scrollPoints(const std::string& collection_name, int limit, const std::string& offset, bool with_payload, const nlohmann::json& filter) override
+    {
+        return TaskExecutor::instance().submit([this, collection_name, limit, offset, with_payload, filter]() {
+            auto result = client_->scrollPoints(collection_name, limit, offset, with_payload, filter).get();
+            return VectorResult::fromQdrantResult(std::move(result));
         });
     }
 };
@@ -230,70 +306,115 @@ public:
     
     std::future<VectorResult> testConnection() override
     {
-        return std::async(std::launch::async, [this]() {
+        return TaskExecutor::instance().submit([this]() {
             auto result = client_->testConnection().get();
-            return VectorResult::fromFaissResult(result);
+            return VectorResult::fromFaissResult(std::move(result));
         });
     }
     
     std::future<VectorResult> createCollection(const std::string& collection_name, int vector_size, const std::string& distance) override
     {
-        return std::async(std::launch::async, [this, collection_name, vector_size, distance]() {
+        return TaskExecutor::instance().submit([this, collection_name, vector_size, distance]() {
             auto result = client_->createCollection(collection_name, vector_size, distance).get();
-            return VectorResult::fromFaissResult(result);
+            return VectorResult::fromFaissResult(std::move(result));
         });
     }
     
     std::future<VectorResult> collectionExists(const std::string& collection_name) override
     {
-        return std::async(std::launch::async, [this, collection_name]() {
+        return TaskExecutor::instance().submit([this, collection_name]() {
             auto result = client_->collectionExists(collection_name).get();
-            return VectorResult::fromFaissResult(result);
+            return VectorResult::fromFaissResult(std::move(result));
         });
     }
     
     std::future<VectorResult> upsertPoints(const std::string& collection_name, const std::vector<VectorPoint>& points) override
     {
-        return std::async(std::launch::async, [this, collection_name, points]() {
+        return TaskExecutor::instance().submit([this, collection_name, points]() {
             std::vector<FaissPoint> fpoints;
             for (const auto& point : points)
             {
                 fpoints.push_back(point.toFaissPoint());
             }
             auto result = client_->upsertPoints(collection_name, fpoints).get();
-            return VectorResult::fromFaissResult(result);
+            return VectorResult::fromFaissResult(std::move(result));
         });
     }
     
     std::future<VectorResult> deletePoints(const std::string& collection_name, const std::vector<std::string>& point_ids) override
     {
-        return std::async(std::launch::async, [this, collection_name, point_ids]() {
+        return TaskExecutor::instance().submit([this, collection_name, point_ids]() {
             auto result = client_->deletePoints(collection_name, point_ids).get();
-            return VectorResult::fromFaissResult(result);
+            return VectorResult::fromFaissResult(std::move(result));
         });
     }
     
     std::future<VectorResult> getPoints(const std::string& collection_name, const std::vector<std::string>& point_ids) override
     {
-        return std::async(std::launch::async, [this, collection_name, point_ids]() {
+        return TaskExecutor::instance().submit([this, collection_name, point_ids]() {
             auto result = client_->getPoints(collection_name, point_ids).get();
-            return VectorResult::fromFaissResult(result);
+            return VectorResult::fromFaissResult(std::move(result));
+        });
+    }
+    
+    std::future<VectorResult> search(const std::string& collection_name, const std::vector<float>& query_vector, int limit, float score_threshold, const VectorSearchParams& params) override
+    {
+        return TaskExecutor::instance().submit([this, collection_name, query_vector, limit, score_threshold, params]() {
+            // A local search is not interrupted, only skipped when it queued past the deadline
+            if (params.expired())
+            {
+                return deadlineExceeded();
+            }
+            auto result = client_->search(collection_name, query_vector, limit, score_threshold, {params.nprobe, params.efSearch, params.filter, params.fields}).get();
+            return VectorResult::fromFaissResult(std::move(result));
         });
     }
     
-    std::future<VectorResult> search(const std::string& collection_name, const std::vector<float>& query_vector, int limit, float score_threshold) override
+    std::future<VectorResult> searchBatch(const std::string& collection_name, const std::vector<std::vector<float>>& query_vectors, int limit, float score_threshold, const VectorSearchParams& params) override
     {
-        return std::async(std::launch::async, [this, collection_name, query_vector, limit, score_threshold]() {
-            auto result = client_->search(collection_name, query_vector, limit, score_threshold).get();
-            return VectorResult::fromFaissResult(result);
+        return TaskExecutor::instance().submit([this, collection_name, query_vectors, limit, score_threshold, params]() {
+            if (params.expired())
+            {
+                return deadlineExceeded();
+            }
+            auto result = client_->searchBatch(collection_name, query_vectors, limit, score_threshold, {params.nprobe, params.efSearch, params.filter, params.fields}).get();
+            return VectorResult::fromFaissResult(std::move(result));
         });
     }
     
-    std::future<VectorResult> scrollPoints(const std::string& collection_name, int limit, const std::string& offset) override
+    std::future<VectorResult> scrollPoints(const std::string& collection_name, int limit, const std::string& offset, bool with_payload, const nlohmann::json& filter) override
+    {
+        return TaskExecutor::instance().submit([this, collection_name, limit, offset, with_payload, filter]() {
+            auto result = client_->scrollPoints(collection_name, limit, offset, with_payload, filter).get();
+            return VectorResult::fromFaissResult(std::move(result));
+        });
+    }
+
+    nlohmann::json memoryUsage() const override
+    {
+        return {{"collections", client_->memoryUsage()}};
+    }
+
+    VectorResult exportSnapshot(const std::string& collection_name, const std::function<bool(const char*, size_t)>& sink) override
+    {
+        return VectorResult::fromFaissResult(client_->exportSnapshot(collection_name, sink));
+    }
+
+    VectorResult importSnapshot(const std::string& collection_name, std::istream& in) override
+    {
+        return VectorResult::fromFaissResult(client_->importSnapshot(collection_name, in));
+    }
+
+    VectorResult readChanges(const std::string& collection_name, const std::string& epoch, uint64_t position, size_t max_bytes, std::string& records) override
+    {
+        return VectorResult::fromFaissResult(client_->readChanges(collection_name, epoch, position, max_bytes, records));
+    }
+
+    std::future<VectorResult> applyChanges(const std::string& collection_name, std::string records) override
     {
-        return std::async(std::launch::async, [this, collection_name, limit, offset]() {
-            auto result = client_->scrollPoints(collection_name, limit, offset).get();
-            return VectorResult::fromFaissResult(result);
+        return TaskExecutor::instance().submit([this, collection_name, records = std::move(records)]() mutable {
+            auto result = client_->applyChanges(collection_name, std::move(records)).get();
+            return VectorResult::fromFaissResult(std::move(result));
         });
     }
 };
@@ -324,6 +445,10 @@ public:
                 if (config.contains("timeout")) qconfig.timeout = config["timeout"];
                 if (config.contains("maxConnections")) qconfig.maxConnections = config["maxConnections"];
                 if (config.contains("connectionTimeout")) qconfig.connectionTimeout = config["connectionTimeout"];
+                if (config.contains("http2")) qconfig.http2 = config["http2"];
+                if (config.contains("replicas")) qconfig.replicas = config["replicas"].get<std::vector<std::string>>();
+                if (config.contains("hedge")) qconfig.hedge = config["hedge"];
+                if (config.contains("hedgeMinDelayMs")) qconfig.hedgeMinDelayMs = config["hedgeMinDelayMs"];
                 
                 return std::make_unique<QdrantVectorDatabase>(qconfig);
             }
@@ -340,7 +465,39 @@ public:
                 if (config.contains("nprobe")) fconfig.nprobe = config["nprobe"];
                 if (config.contains("useGPU")) fconfig.useGPU = config["useGPU"];
                 if (config.contains("gpuDevice")) fconfig.gpuDevice = config["gpuDevice"];
+                if (config.contains("gpuMode")) fconfig.gpuMode = config["gpuMode"];
+                if (config.contains("gpuDevices")) fconfig.gpuDevices = config["gpuDevices"].get<std::vector<int>>();
+                if (config.contains("gpuSyncPoints")) fconfig.gpuSyncPoints = config["gpuSyncPoints"];
                 if (config.contains("metricType")) fconfig.metricType = config["metricType"];
+                if (config.contains("walSyncMs")) fconfig.walSyncMs = config["walSyncMs"];
+                if (config.contains("checkpointIntervalSec")) fconfig.checkpointIntervalSec = config["checkpointIntervalSec"];
+                if (config.contains("checkpointWalMB")) fconfig.checkpointWalMB = config["checkpointWalMB"];
+                if (config.contains("deltaMergePoints")) fconfig.deltaMergePoints = config["deltaMergePoints"];
+                if (config.contains("autoIndexType")) fconfig.autoIndexType = config["autoIndexType"];
+                if (config.contains("autoIndexThreshold")) fconfig.autoIndexThreshold = config["autoIndexThreshold"];
+                if (config.contains("recallTarget")) fconfig.recallTarget = config["recallTarget"];
+                if (config.contains("efSearch")) fconfig.efSearch = config["efSearch"];
+                if (config.contains("tombstoneCompactRatio")) fconfig.tombstoneCompactRatio = config["tombstoneCompactRatio"];
+                if (config.contains("mmapIndex")) fconfig.mmapIndex = config["mmapIndex"];
+                if (config.contains("diskRerankFactor")) fconfig.diskRerankFactor = config["diskRerankFactor"];
+                if (config.contains("exactRerank")) fconfig.exactRerank = config["exactRerank"];
+                if (config.contains("textCompression")) fconfig.textCompression = config["textCompression"];
+                if (config.contains("collections"))
+                {
+                    for (const auto& item : config["collections"].items())
+                    {
+                        FaissClient::Config::CollectionConfig collection;
+                        collection.indexType = item.value().value("indexType", "");
+                        collection.metricType = item.value().value("metricType", "");
+                        collection.dimensions = item.value().value("dimensions", 0);
+                        collection.nlist = item.value().value("nlist", 0);
+                        collection.nprobe = item.value().value("nprobe", 0);
+                        collection.efSearch = item.value().value("efSearch", 0);
+                        collection.gpuMode = item.value().value("gpuMode", "");
+                        collection.textCompression = item.value().value("textCompression", "");
+                        fconfig.collections[item.key()] = collection;
+                    }
+                }
                 
                 return std::make_unique<FaissVectorDatabase>(fconfig);
             }
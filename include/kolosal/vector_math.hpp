@@ -0,0 +1,41 @@
+#pragma once
+
+#include "export.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace kolosal {
+namespace vecmath {
+
+    // Float vector kernels shared by chunking, the vector stores and the embedding routes.
+    // The widest variant the host runs (AVX-512, AVX2+FMA+F16C, then SSE2 or NEON) is
+    // picked on first use from HardwareFeatures, so one binary serves every CPU.
+
+    KOLOSAL_SERVER_API float dot(const float* a, const float* b, size_t n);
+
+    KOLOSAL_SERVER_API float norm(const float* v, size_t n);
+
+    // Euclidean norm of each of count row-major rows of dims floats
+    KOLOSAL_SERVER_API void norms(const float* rows, size_t count, size_t dims, float* out);
+
+    // Scales v to unit length and returns its former norm; a zero vector is left as is
+    KOLOSAL_SERVER_API float normalize(float* v, size_t n);
+
+    // Cosine similarity, 0 when either vector is zero
+    KOLOSAL_SERVER_API float cosine(const float* a, const float* b, size_t n);
+
+    // IEEE 754 binary16, rounded to nearest even
+    KOLOSAL_SERVER_API void toHalf(const float* in, size_t n, uint16_t* out);
+
+    // Widens binary16 values to float, exactly
+    KOLOSAL_SERVER_API void fromHalf(const uint16_t* in, size_t n, float* out);
+
+    // Maps [-1, 1] onto [-127, 127], rounding halves away from zero; values outside are clamped
+    KOLOSAL_SERVER_API void toInt8(const float* in, size_t n, int8_t* out);
+
+    // Name of the selected variant, for logs
+    KOLOSAL_SERVER_API const char* isa();
+
+} // namespace vecmath
+} // namespace kolosal
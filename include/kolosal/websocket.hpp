@@ -0,0 +1,89 @@
+#pragma once
+
+#include "export.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+
+#ifdef _WIN32
+#include <winsock2.h>
+using SocketType = SOCKET;
+#else
+#include <sys/socket.h>
+#include <unistd.h>
+using SocketType = int;
+#endif
+
+namespace kolosal {
+
+    /**
+     * @brief Server side of a WebSocket connection (RFC 6455) upgraded from an HTTP request.
+     *
+     * A route that wants a long-lived, bidirectional session calls upgrade()
+     * from handle() and then keeps the connection for as long as the session
+     * lasts; the server closes the socket once handle() returns. Messages
+     * are whole: fragmented messages are reassembled and control frames are
+     * dealt with inside receive() (pings answered, a close echoed). Extensions
+     * such as permessage-deflate are not negotiated.
+     *
+     * Not thread-safe; it belongs to the thread running the handler.
+     */
+    class KOLOSAL_SERVER_API WebSocket {
+    public:
+        enum class Status { Message, Timeout, Closed };
+
+        // Close codes used by the server
+        static constexpr uint16_t kNormalClosure = 1000;
+        static constexpr uint16_t kGoingAway = 1001;
+        static constexpr uint16_t kProtocolError = 1002;
+        static constexpr uint16_t kUnsupportedData = 1003;
+        static constexpr uint16_t kMessageTooBig = 1009;
+
+        // Answers the opening handshake of an upgrade request with 101 Switching Protocols.
+        // A request that is not a valid version 13 upgrade gets a 400 or 426 instead and
+        // false is returned.
+        static bool upgrade(SocketType sock, const std::map<std::string, std::string>& headers);
+
+        explicit WebSocket(SocketType sock, size_t maxMessageBytes = 16u << 20);
+
+        WebSocket(const WebSocket&) = delete;
+        WebSocket& operator=(const WebSocket&) = delete;
+
+        // Waits up to timeoutMs (0 only checks) for the next text or binary message.
+        // Closed once the peer closed the session, broke the protocol or went away.
+        Status receive(std::string& message, int timeoutMs);
+
+        bool sendText(std::string_view text);
+        bool ping();
+
+        // Starts the closing handshake; nothing is sent afterwards
+        void close(uint16_t code, std::string_view reason = {});
+
+        bool isOpen() const { return open_; }
+
+        // Last time anything, pongs included, arrived from the peer
+        std::chrono::steady_clock::time_point lastReceived() const { return lastReceived_; }
+
+    private:
+        enum class Parse { NeedMore, Message, Failed };
+
+        Parse parseFrame(std::string& message);
+        bool sendFrame(uint8_t opcode, std::string_view payload);
+
+        SocketType sock_;
+        size_t maxMessageBytes_;
+        bool open_ = true;
+        uint8_t messageOpcode_ = 0;     // Opcode of the fragmented message being reassembled
+#pragma warning(push)
+#pragma warning(disable: 4251)
+        std::string buffer_;            // Received bytes not parsed yet
+        std::string fragments_;         // Payload of the fragmented message so far
+        std::chrono::steady_clock::time_point lastReceived_;
+#pragma warning(pop)
+    };
+
+} // namespace kolosal
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "export.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace kolosal {
+
+    /**
+     * @brief Elastic thread pool for blocking request handlers.
+     *
+     * Keeps `minThreads` workers alive and grows on demand up to `maxThreads`
+     * when every worker is busy (route handlers block on inference and on
+     * socket writes, so a fixed-size pool would stall behind long streams).
+     * Threads above the minimum exit after `idleTimeout` without work.
+     * Tasks submitted while the pool is at its maximum are queued.
+     */
+    class KOLOSAL_SERVER_API WorkerPool {
+    public:
+        WorkerPool(size_t minThreads, size_t maxThreads,
+                   std::chrono::seconds idleTimeout = std::chrono::seconds(30));
+        ~WorkerPool();
+
+        WorkerPool(const WorkerPool&) = delete;
+        WorkerPool& operator=(const WorkerPool&) = delete;
+
+        // Queue a task; returns false if the pool has been shut down
+        bool submit(std::function<void()> task);
+
+        // Stop accepting tasks, drain the queue and join all workers
+        void shutdown();
+
+        size_t threadCount() const;
+        size_t busyCount() const;
+        size_t queuedCount() const;
+
+    private:
+        void workerLoop();
+        void spawnWorkerLocked();
+        void reapFinishedLocked();
+
+#pragma warning(push)
+#pragma warning(disable: 4251)
+        std::unordered_map<std::thread::id, std::thread> threads_;
+        std::vector<std::thread> finished_;     // Retired workers waiting to be joined
+        std::deque<std::function<void()>> tasks_;
+        mutable std::mutex mutex_;
+        std::condition_variable cv_;
+        std::chrono::seconds idleTimeout_;
+#pragma warning(pop)
+        size_t minThreads_;
+        size_t maxThreads_;
+        size_t idle_ = 0;
+        size_t busy_ = 0;
+        bool stop_ = false;
+    };
+
+} // namespace kolosal
@@ -3,4 +3,5 @@
 #pragma once
 
 #include "kolosal/server_api.hpp"
-#include "kolosal/logger.hpp"
\ No newline at end of file
+#include "kolosal/logger.hpp"
+#include "kolosal/local_client.hpp"
\ No newline at end of file
@@ -0,0 +1,526 @@
+/**
+ * @file embedding_bench.cpp
+ * @brief Embedding benchmark: sweeps engine and client settings against one GGUF and recommends load_params
+ *
+ * Every combination of --n-batch, --n-ubatch and --n-parallel is loaded once with
+ * loadEmbeddingModel(). Each load then runs every combination of --input-len distribution,
+ * --concurrency (client threads) and --request-batch (inputs per submitEmbeddingBatch call).
+ * A fixed number of seeded inputs is embedded for each combination. The report lists
+ * embeddings/s, tokens/s, p50/p90/p95/p99 request latency, and resident memory after load
+ * for every setting.
+ *
+ * The recommendation is the engine setting with the best worst-case throughput over the
+ * workloads, among the settings whose p99 stays under --slo-p99-ms. Settings within 2% of
+ * each other go to the one with less memory. It is printed as a load_params block for config.yaml.
+ */
+
+#include "inference.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <json.hpp>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#elif defined(__linux__)
+#include <unistd.h>
+#endif
+
+using json = nlohmann::json;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+double msBetween(Clock::time_point from, Clock::time_point to) {
+    return std::chrono::duration<double, std::milli>(to - from).count();
+}
+
+// "fixed:N", "uniform:MIN:MAX", "normal:MEAN:STDDEV" or "exponential:MEAN"
+struct LengthDistribution {
+    std::string kind = "fixed";
+    double a = 128;
+    double b = 0;
+
+    static bool parse(const std::string &spec, LengthDistribution &out) {
+        std::vector<std::string> parts;
+        size_t start = 0;
+        while (true) {
+            size_t colon = spec.find(':', start);
+            parts.push_back(spec.substr(start, colon - start));
+            if (colon == std::string::npos) break;
+            start = colon + 1;
+        }
+        try {
+            if (parts.size() == 1) { out = {"fixed", std::stod(parts[0]), 0}; return out.a >= 1; }
+            if (parts[0] == "fixed" && parts.size() == 2) { out = {"fixed", std::stod(parts[1]), 0}; return out.a >= 1; }
+            if (parts[0] == "exponential" && parts.size() == 2) { out = {"exponential", std::stod(parts[1]), 0}; return out.a > 0; }
+            if ((parts[0] == "uniform" || parts[0] == "normal") && parts.size() == 3) {
+                out = {parts[0], std::stod(parts[1]), std::stod(parts[2])};
+                return out.kind == "uniform" ? (out.a >= 1 && out.b >= out.a) : (out.a >= 1 && out.b >= 0);
+            }
+        } catch (const std::exception &) {
+        }
+        return false;
+    }
+
+    int sample(std::mt19937_64 &rng) const {
+        double value = a;
+        if (kind == "uniform") value = std::uniform_real_distribution<double>(a, b + 1)(rng);
+        else if (kind == "normal") value = std::normal_distribution<double>(a, b)(rng);
+        else if (kind == "exponential") value = std::exponential_distribution<double>(1.0 / a)(rng);
+        return std::max(1, static_cast<int>(value));
+    }
+
+    // Upper end of the lengths, for sizing the context
+    int longest() const {
+        if (kind == "uniform") return static_cast<int>(b);
+        if (kind == "normal") return static_cast<int>(a + 3 * b);
+        if (kind == "exponential") return static_cast<int>(a * 4);
+        return static_cast<int>(a);
+    }
+
+    std::string spec() const {
+        std::ostringstream out;
+        out << kind << ':' << a;
+        if (kind == "uniform" || kind == "normal") out << ':' << b;
+        return out.str();
+    }
+};
+
+struct BenchConfig {
+    std::string modelPath;
+    std::string output;
+    std::string yamlOutput;
+    int inputs = 512;                   // Embedded per setting
+    int warmup = 8;
+    uint64_t seed = 42;
+    double sloP99Ms = 0.0;              // 0 = no constraint
+    // Swept; every combination runs
+    std::vector<int> nBatch{512, 2048};
+    std::vector<int> nUbatch{512};
+    std::vector<int> nParallel{1, 4, 8};
+    std::vector<int> concurrency{1, 8, 32};
+    std::vector<int> requestBatch{1, 16};
+    std::vector<LengthDistribution> inputLen{{"uniform", 16, 128}, {"uniform", 256, 512}};
+    // Fixed
+    int nCtx = 0;                       // 0 = n_parallel * n_ubatch
+    int nGpuLayers = 100;
+    int nThreads = 0;
+};
+
+struct EngineSetting {
+    int nBatch = 0;
+    int nUbatch = 0;
+    int nParallel = 0;
+    int nCtx = 0;
+};
+
+struct Workload {
+    const LengthDistribution *inputLen = nullptr;
+    int concurrency = 1;
+    int requestBatch = 1;
+};
+
+struct WorkloadResult {
+    double durationSec = 0;
+    int embedded = 0;
+    int failed = 0;
+    long long tokens = 0;
+    std::vector<double> latencyMs;      // One per request
+    std::string firstError;
+};
+
+// Inputs are built from a fixed vocabulary so a seed reproduces them exactly
+const char *const kWords[] = {
+    "the", "model", "server", "request", "token", "cache", "batch", "decode", "prompt", "latency",
+    "river", "mountain", "engine", "signal", "window", "garden", "silver", "market", "history", "question",
+    "answer", "system", "memory", "thread", "network", "planet", "ocean", "forest", "library", "journey",
+    "light", "shadow", "number", "letter", "method", "result", "value", "summary", "detail", "pattern"};
+constexpr size_t kWordCount = sizeof(kWords) / sizeof(kWords[0]);
+
+std::vector<std::string> makeInputs(const LengthDistribution &lengths, int count, uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    std::uniform_int_distribution<size_t> pick(0, kWordCount - 1);
+    std::vector<std::string> inputs(count);
+    for (auto &input : inputs) {
+        const int words = lengths.sample(rng);
+        for (int i = 0; i < words; ++i) {
+            if (i) input.push_back(' ');
+            input += kWords[pick(rng)];
+        }
+    }
+    return inputs;
+}
+
+// Resident set size in bytes, or -1 where it cannot be read
+long long residentBytes() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return static_cast<long long>(counters.WorkingSetSize);
+    return -1;
+#elif defined(__linux__)
+    std::ifstream statm("/proc/self/statm");
+    long long pages = 0, resident = 0;
+    if (!(statm >> pages >> resident)) return -1;
+    return resident * sysconf(_SC_PAGESIZE);
+#else
+    return -1;
+#endif
+}
+
+// Client threads take requests of requestBatch inputs off a shared cursor until the inputs run out
+WorkloadResult runWorkload(InferenceEngine &engine, const std::vector<std::string> &inputs, const Workload &workload) {
+    const size_t requests = (inputs.size() + workload.requestBatch - 1) / workload.requestBatch;
+    std::atomic<size_t> next{0};
+    std::vector<WorkloadResult> perThread(std::max(1, workload.concurrency));
+
+    const auto start = Clock::now();
+    std::vector<std::thread> clients;
+    for (size_t t = 0; t < perThread.size(); ++t) {
+        clients.emplace_back([&, t] {
+            WorkloadResult &mine = perThread[t];
+            while (true) {
+                const size_t request = next.fetch_add(1);
+                if (request >= requests) return;
+                const size_t first = request * workload.requestBatch;
+                const size_t last = std::min(inputs.size(), first + workload.requestBatch);
+                std::vector<EmbeddingParameters> params(last - first);
+                for (size_t i = first; i < last; ++i) params[i - first].input = inputs[i];
+
+                const auto sent = Clock::now();
+                const std::vector<EmbeddingResult> results = engine.submitEmbeddingBatch(params);
+                mine.latencyMs.push_back(msBetween(sent, Clock::now()));
+                if (results.size() != params.size()) {
+                    mine.failed += static_cast<int>(params.size());
+                    if (mine.firstError.empty()) mine.firstError = "batch submission failed";
+                    continue;
+                }
+                for (const auto &result : results) {
+                    if (result.hasError || result.embedding.empty()) {
+                        ++mine.failed;
+                        if (mine.firstError.empty()) mine.firstError = result.errorMessage;
+                        continue;
+                    }
+                    ++mine.embedded;
+                    mine.tokens += result.tokens_count;
+                }
+            }
+        });
+    }
+    for (auto &client : clients) client.join();
+
+    WorkloadResult total;
+    total.durationSec = std::chrono::duration<double>(Clock::now() - start).count();
+    for (auto &part : perThread) {
+        total.embedded += part.embedded;
+        total.failed += part.failed;
+        total.tokens += part.tokens;
+        total.latencyMs.insert(total.latencyMs.end(), part.latencyMs.begin(), part.latencyMs.end());
+        if (total.firstError.empty()) total.firstError = part.firstError;
+    }
+    return total;
+}
+
+double percentile(const std::vector<double> &sorted, double p) {
+    if (sorted.empty()) return 0.0;
+    const double rank = p / 100.0 * (sorted.size() - 1);
+    const size_t lo = static_cast<size_t>(rank);
+    const size_t hi = std::min(lo + 1, sorted.size() - 1);
+    return sorted[lo] + (sorted[hi] - sorted[lo]) * (rank - lo);
+}
+
+json summarize(std::vector<double> values) {
+    if (values.empty()) return json{{"count", 0}};
+    std::sort(values.begin(), values.end());
+    double sum = 0;
+    for (double v : values) sum += v;
+    return {
+        {"count", values.size()},
+        {"mean", sum / values.size()},
+        {"min", values.front()},
+        {"p50", percentile(values, 50)},
+        {"p90", percentile(values, 90)},
+        {"p95", percentile(values, 95)},
+        {"p99", percentile(values, 99)},
+        {"max", values.back()}};
+}
+
+std::string loadParamsYaml(const EngineSetting &setting, const BenchConfig &config) {
+    std::ostringstream out;
+    out << "load_params:\n"
+        << "  n_ctx: " << setting.nCtx << "\n"
+        << "  n_parallel: " << setting.nParallel << "\n"
+        << "  n_batch: " << setting.nBatch << "\n"
+        << "  n_ubatch: " << setting.nUbatch << "\n"
+        << "  n_gpu_layers: " << config.nGpuLayers << "\n";
+    if (config.nThreads > 0) out << "  n_threads: " << config.nThreads << "\n";
+    return out.str();
+}
+
+void printUsage(const char *argv0) {
+    std::cerr << "Usage: " << argv0 << " --model <embedding.gguf> [options]\n\n"
+              << "Swept (comma-separated lists, every combination runs):\n"
+              << "  --n-batch LIST        engine n_batch (default 512,2048)\n"
+              << "  --n-ubatch LIST       engine n_ubatch, the most tokens one input can have (default 512)\n"
+              << "  --n-parallel LIST     engine sequences per micro-batch (default 1,4,8)\n"
+              << "  --concurrency LIST    client threads submitting at once (default 1,8,32)\n"
+              << "  --request-batch LIST  inputs per request (default 1,16)\n"
+              << "  --input-len DIST      input length in words; repeat for several (default uniform:16:128\n"
+              << "                        and uniform:256:512). DIST is N, fixed:N, uniform:MIN:MAX,\n"
+              << "                        normal:MEAN:STDDEV or exponential:MEAN\n"
+              << "Workload:\n"
+              << "  --inputs N            inputs embedded per setting (default 512)\n"
+              << "  --warmup N            untimed inputs embedded after each load (default 8)\n"
+              << "  --seed N              input seed (default 42)\n"
+              << "  --slo-p99-ms MS       p99 request latency the recommendation must meet (default none)\n"
+              << "  --json FILE           also write the report to FILE\n"
+              << "  --yaml FILE           write the recommended load_params block to FILE\n"
+              << "Engine:\n"
+              << "  --n-ctx N             context size (default n_parallel * n_ubatch)\n"
+              << "  --n-gpu-layers N --n-threads N\n";
+}
+
+std::vector<int> parseList(const std::string &arg, const std::string &text) {
+    std::vector<int> values;
+    std::stringstream in(text);
+    std::string item;
+    while (std::getline(in, item, ',')) {
+        const int value = std::stoi(item);
+        if (value < 1) throw std::invalid_argument(arg + " values must be positive");
+        values.push_back(value);
+    }
+    if (values.empty()) throw std::invalid_argument(arg + " needs at least one value");
+    return values;
+}
+
+bool parseArgs(int argc, char **argv, BenchConfig &config) {
+    bool defaultLengths = true;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        auto value = [&]() -> const char * {
+            if (i + 1 >= argc) throw std::invalid_argument(arg + " needs a value");
+            return argv[++i];
+        };
+        if (arg == "--model") config.modelPath = value();
+        else if (arg == "--json") config.output = value();
+        else if (arg == "--yaml") config.yamlOutput = value();
+        else if (arg == "--n-batch") config.nBatch = parseList(arg, value());
+        else if (arg == "--n-ubatch") config.nUbatch = parseList(arg, value());
+        else if (arg == "--n-parallel") config.nParallel = parseList(arg, value());
+        else if (arg == "--concurrency") config.concurrency = parseList(arg, value());
+        else if (arg == "--request-batch") config.requestBatch = parseList(arg, value());
+        else if (arg == "--input-len") {
+            const std::string spec = value();
+            LengthDistribution lengths;
+            if (!LengthDistribution::parse(spec, lengths)) throw std::invalid_argument("bad length distribution '" + spec + "'");
+            if (defaultLengths) config.inputLen.clear();
+            defaultLengths = false;
+            config.inputLen.push_back(lengths);
+        }
+        else if (arg == "--inputs") config.inputs = std::stoi(value());
+        else if (arg == "--warmup") config.warmup = std::stoi(value());
+        else if (arg == "--seed") config.seed = std::stoull(value());
+        else if (arg == "--slo-p99-ms") config.sloP99Ms = std::stod(value());
+        else if (arg == "--n-ctx") config.nCtx = std::stoi(value());
+        else if (arg == "--n-gpu-layers") config.nGpuLayers = std::stoi(value());
+        else if (arg == "--n-threads") config.nThreads = std::stoi(value());
+        else if (arg == "--help" || arg == "-h") return false;
+        else throw std::invalid_argument("unknown option " + arg);
+    }
+    if (config.modelPath.empty()) throw std::invalid_argument("--model is required");
+    if (config.inputs < 1 || config.warmup < 0 || config.nCtx < 0)
+        throw std::invalid_argument("--inputs must be positive, --warmup and --n-ctx non-negative");
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    BenchConfig config;
+    try {
+        if (!parseArgs(argc, argv, config)) { printUsage(argv[0]); return 64; }
+    } catch (const std::exception &e) {
+        std::cerr << "[BENCH] " << e.what() << "\n\n";
+        printUsage(argv[0]);
+        return 64;
+    }
+
+    // The same inputs for every engine setting, so settings compare on equal work
+    std::vector<std::vector<std::string>> inputSets;
+    int longestInput = 0;
+    for (size_t i = 0; i < config.inputLen.size(); ++i) {
+        inputSets.push_back(makeInputs(config.inputLen[i], config.inputs, config.seed + i));
+        longestInput = std::max(longestInput, config.inputLen[i].longest());
+    }
+    const auto warmupInputs = makeInputs(LengthDistribution{"fixed", 32, 0}, config.warmup, config.seed + 0x5bd1e995);
+
+    json settings = json::array();
+    int best = -1;
+    double bestScore = 0;
+    long long bestMemory = 0;
+    std::vector<EngineSetting> tried;
+    int failedSettings = 0;
+
+    for (int nBatch : config.nBatch) {
+        for (int nUbatch : config.nUbatch) {
+            for (int nParallel : config.nParallel) {
+                EngineSetting setting{nBatch, nUbatch, nParallel,
+                                      config.nCtx > 0 ? config.nCtx : nParallel * nUbatch};
+                json entry = {{"n_batch", nBatch}, {"n_ubatch", nUbatch}, {"n_parallel", nParallel}, {"n_ctx", setting.nCtx}};
+                if (nUbatch > nBatch) {
+                    entry["skipped"] = "n_ubatch larger than n_batch";
+                    settings.push_back(entry);
+                    continue;
+                }
+
+                LoadingParameters lp;
+                lp.n_ctx = setting.nCtx;
+                lp.n_parallel = nParallel;
+                lp.n_batch = nBatch;
+                lp.n_ubatch = nUbatch;
+                lp.n_gpu_layers = config.nGpuLayers;
+                lp.n_threads = config.nThreads;
+
+                std::cerr << "[BENCH] Loading n_batch=" << nBatch << " n_ubatch=" << nUbatch
+                          << " n_parallel=" << nParallel << " n_ctx=" << setting.nCtx << "\n";
+                const long long before = residentBytes();
+                auto engine = std::make_unique<InferenceEngine>();
+                if (!engine->loadEmbeddingModel(config.modelPath.c_str(), lp)) {
+                    entry["error"] = "load failed";
+                    settings.push_back(entry);
+                    ++failedSettings;
+                    continue;
+                }
+                const long long loaded = residentBytes();
+                if (before >= 0 && loaded >= 0) {
+                    entry["resident_mb"] = loaded / (1024.0 * 1024.0);
+                    entry["load_resident_delta_mb"] = (loaded - before) / (1024.0 * 1024.0);
+                }
+
+                if (!warmupInputs.empty()) {
+                    std::vector<EmbeddingParameters> warm(warmupInputs.size());
+                    for (size_t i = 0; i < warm.size(); ++i) warm[i].input = warmupInputs[i];
+                    engine->submitEmbeddingBatch(warm);
+                }
+
+                // Scored by the slowest workload, so one setting cannot win on short inputs alone
+                double worstThroughput = -1;
+                double worstP99 = 0;
+                bool anyFailed = false;
+                json workloads = json::array();
+                for (size_t l = 0; l < config.inputLen.size(); ++l) {
+                    for (int concurrency : config.concurrency) {
+                        for (int requestBatch : config.requestBatch) {
+                            Workload workload{&config.inputLen[l], concurrency, requestBatch};
+                            WorkloadResult result = runWorkload(*engine, inputSets[l], workload);
+                            const double seconds = std::max(result.durationSec, 1e-9);
+                            std::vector<double> sorted = result.latencyMs;
+                            std::sort(sorted.begin(), sorted.end());
+                            const double p99 = percentile(sorted, 99);
+                            const double throughput = result.embedded / seconds;
+
+                            json w = {
+                                {"input_words", config.inputLen[l].spec()},
+                                {"concurrency", concurrency},
+                                {"request_batch", requestBatch},
+                                {"duration_s", result.durationSec},
+                                {"embedded", result.embedded},
+                                {"failed", result.failed},
+                                {"embeddings_per_s", throughput},
+                                {"tokens_per_s", result.tokens / seconds},
+                                {"tokens_per_input", result.embedded ? static_cast<double>(result.tokens) / result.embedded : 0.0},
+                                {"latency_ms", summarize(std::move(result.latencyMs))}};
+                            if (!result.firstError.empty()) w["error"] = result.firstError;
+                            workloads.push_back(std::move(w));
+
+                            anyFailed |= result.failed > 0;
+                            worstThroughput = worstThroughput < 0 ? throughput : std::min(worstThroughput, throughput);
+                            worstP99 = std::max(worstP99, p99);
+                            std::cerr << "[BENCH]   " << config.inputLen[l].spec() << " x" << concurrency
+                                      << " batch " << requestBatch << ": " << throughput << " emb/s, p99 " << p99 << " ms\n";
+                        }
+                    }
+                }
+                const long long peak = residentBytes();
+                if (peak >= 0) entry["resident_after_runs_mb"] = peak / (1024.0 * 1024.0);
+                entry["workloads"] = std::move(workloads);
+                entry["worst_embeddings_per_s"] = worstThroughput;
+                entry["worst_p99_ms"] = worstP99;
+                // Inputs beyond n_ubatch tokens are truncated by the engine, so such a setting is not comparable
+                if (nUbatch < longestInput) entry["note"] = "inputs may exceed n_ubatch tokens and be truncated";
+
+                const bool meetsSlo = config.sloP99Ms <= 0 || worstP99 <= config.sloP99Ms;
+                const long long memory = loaded >= 0 ? loaded : 0;
+                if (!anyFailed && meetsSlo &&
+                    (best < 0 || worstThroughput > bestScore * 1.02 ||
+                     (worstThroughput >= bestScore * 0.98 && memory < bestMemory))) {
+                    best = static_cast<int>(tried.size());
+                    bestScore = worstThroughput;
+                    bestMemory = memory;
+                }
+                if (anyFailed) ++failedSettings;
+                tried.push_back(setting);
+                settings.push_back(std::move(entry));
+
+                engine->unloadModel();
+            }
+        }
+    }
+
+    json report = {
+        {"model", config.modelPath},
+        {"config", {
+            {"inputs", config.inputs},
+            {"seed", config.seed},
+            {"slo_p99_ms", config.sloP99Ms},
+            {"n_gpu_layers", config.nGpuLayers},
+            {"n_threads", config.nThreads}}},
+        {"settings", std::move(settings)}};
+    int status = failedSettings == 0 ? 0 : 1;
+    if (best >= 0) {
+        const EngineSetting &winner = tried[best];
+        const std::string yaml = loadParamsYaml(winner, config);
+        report["recommended"] = {
+            {"n_ctx", winner.nCtx}, {"n_parallel", winner.nParallel},
+            {"n_batch", winner.nBatch}, {"n_ubatch", winner.nUbatch},
+            {"worst_embeddings_per_s", bestScore}};
+        report["recommended_yaml"] = yaml;
+        std::cerr << "[BENCH] Recommended settings for config.yaml:\n" << yaml;
+        if (!config.yamlOutput.empty()) {
+            std::ofstream out(config.yamlOutput);
+            out << yaml;
+            if (!out) {
+                std::cerr << "[BENCH] Could not write " << config.yamlOutput << "\n";
+                status = 66;
+            }
+        }
+    } else {
+        std::cerr << "[BENCH] No setting ran without errors" << (config.sloP99Ms > 0 ? " within the p99 SLO" : "") << "\n";
+        status = 1;
+    }
+
+    std::cout << report.dump(2) << std::endl;
+    if (!config.output.empty()) {
+        std::ofstream out(config.output);
+        out << report.dump(2) << '\n';
+        if (!out) {
+            std::cerr << "[BENCH] Could not write " << config.output << "\n";
+            return 66;
+        }
+    }
+    return status;
+}
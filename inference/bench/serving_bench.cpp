@@ -0,0 +1,739 @@
+/**
+ * @file serving_bench.cpp
+ * @brief Serving benchmark: replays a synthetic workload and reports latency and throughput as JSON
+ *
+ * The workload runs either against an in-process InferenceEngine (--model) or a running
+ * kolosal-server over HTTP (--url, POST /v1/completions). Arrivals follow a Poisson process
+ * at --rate requests per second (0 sends everything at once), bounded by --concurrency
+ * requests in flight. Prompt and output lengths are drawn from the configured distributions,
+ * and --shared-prefix makes that fraction of every prompt a common prefix so prefix reuse
+ * can be measured. The same --seed replays the same workload.
+ *
+ * The report holds p50/p90/p95/p99 TTFT, TPOT and end-to-end latency, request and token
+ * throughput, and goodput (requests per second meeting --slo-ttft-ms and --slo-tpot-ms).
+ */
+
+#include "inference.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cctype>
+#include <cmath>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <json.hpp>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+using SocketType = SOCKET;
+static const SocketType kInvalidSocket = INVALID_SOCKET;
+static void closeSocket(SocketType s) { closesocket(s); }
+#else
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+using SocketType = int;
+static const SocketType kInvalidSocket = -1;
+static void closeSocket(SocketType s) { close(s); }
+#endif
+
+using json = nlohmann::json;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+double msBetween(Clock::time_point from, Clock::time_point to) {
+    return std::chrono::duration<double, std::milli>(to - from).count();
+}
+
+// "fixed:N", "uniform:MIN:MAX", "normal:MEAN:STDDEV" or "exponential:MEAN"
+struct LengthDistribution {
+    std::string kind = "fixed";
+    double a = 128;
+    double b = 0;
+
+    static bool parse(const std::string &spec, LengthDistribution &out) {
+        std::vector<std::string> parts;
+        size_t start = 0;
+        while (true) {
+            size_t colon = spec.find(':', start);
+            parts.push_back(spec.substr(start, colon - start));
+            if (colon == std::string::npos) break;
+            start = colon + 1;
+        }
+        try {
+            if (parts.size() == 1) { out = {"fixed", std::stod(parts[0]), 0}; return out.a >= 1; }
+            if (parts[0] == "fixed" && parts.size() == 2) { out = {"fixed", std::stod(parts[1]), 0}; return out.a >= 1; }
+            if (parts[0] == "exponential" && parts.size() == 2) { out = {"exponential", std::stod(parts[1]), 0}; return out.a > 0; }
+            if ((parts[0] == "uniform" || parts[0] == "normal") && parts.size() == 3) {
+                out = {parts[0], std::stod(parts[1]), std::stod(parts[2])};
+                return out.kind == "uniform" ? (out.a >= 1 && out.b >= out.a) : (out.a >= 1 && out.b >= 0);
+            }
+        } catch (const std::exception &) {
+        }
+        return false;
+    }
+
+    int sample(std::mt19937_64 &rng) const {
+        double value = a;
+        if (kind == "uniform") value = std::uniform_real_distribution<double>(a, b + 1)(rng);
+        else if (kind == "normal") value = std::normal_distribution<double>(a, b)(rng);
+        else if (kind == "exponential") value = std::exponential_distribution<double>(1.0 / a)(rng);
+        return std::max(1, static_cast<int>(value));
+    }
+
+    json toJson() const {
+        json j = {{"kind", kind}};
+        if (kind == "uniform") { j["min"] = a; j["max"] = b; }
+        else if (kind == "normal") { j["mean"] = a; j["stddev"] = b; }
+        else j[kind == "fixed" ? "value" : "mean"] = a;
+        return j;
+    }
+};
+
+struct BenchConfig {
+    std::string modelPath;              // In-process engine
+    std::string url;                    // HTTP server
+    std::string modelId;
+    std::string apiKey;
+    std::string output;
+    int requests = 100;
+    int warmup = 2;
+    double rate = 0.0;                  // Requests per second, 0 = all at once
+    int concurrency = 16;
+    bool stream = true;
+    uint64_t seed = 42;
+    LengthDistribution promptLen{"fixed", 256, 0};   // In words, roughly one token each
+    LengthDistribution outputLen{"fixed", 128, 0};   // max_tokens; generation may stop earlier
+    double sharedPrefix = 0.0;
+    double sloTtftMs = 0.0;             // 0 = no constraint
+    double sloTpotMs = 0.0;
+    int timeoutSec = 600;
+    // Engine loading
+    int nCtx = 4096;
+    int nParallel = 4;
+    int nBatch = 512;
+    int nUbatch = 512;
+    int nGpuLayers = 100;
+};
+
+struct PlannedRequest {
+    double arrivalSec = 0.0;
+    std::string prompt;
+    int promptWords = 0;
+    int maxTokens = 0;
+    int seed = 0;
+};
+
+struct RequestResult {
+    bool ok = false;
+    std::string error;
+    double ttftMs = -1;     // < 0 when not measured
+    double tpotMs = -1;
+    double e2eMs = 0;
+    int promptTokens = -1;  // < 0 when the backend does not report it
+    int outputTokens = 0;
+};
+
+// Prompts are built from a fixed vocabulary so a seed reproduces them exactly
+const char *const kWords[] = {
+    "the", "model", "server", "request", "token", "cache", "batch", "decode", "prompt", "latency",
+    "river", "mountain", "engine", "signal", "window", "garden", "silver", "market", "history", "question",
+    "answer", "system", "memory", "thread", "network", "planet", "ocean", "forest", "library", "journey",
+    "light", "shadow", "number", "letter", "method", "result", "value", "summary", "detail", "pattern"};
+constexpr size_t kWordCount = sizeof(kWords) / sizeof(kWords[0]);
+
+std::string randomWords(std::mt19937_64 &rng, int count) {
+    std::string out;
+    std::uniform_int_distribution<size_t> pick(0, kWordCount - 1);
+    for (int i = 0; i < count; ++i) {
+        if (i) out.push_back(' ');
+        out += kWords[pick(rng)];
+    }
+    return out;
+}
+
+std::vector<PlannedRequest> planWorkload(const BenchConfig &config, int count, uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    std::vector<PlannedRequest> plan(count);
+    for (auto &request : plan) {
+        request.promptWords = config.promptLen.sample(rng);
+        request.maxTokens = config.outputLen.sample(rng);
+    }
+
+    // The shared part of each prompt is a prefix of one common text
+    int longest = 0;
+    for (const auto &request : plan) longest = std::max(longest, request.promptWords);
+    std::mt19937_64 prefixRng(seed ^ 0x9e3779b97f4a7c15ULL);
+    std::vector<std::string> prefixWords;
+    for (int i = 0; i < longest; ++i) prefixWords.push_back(kWords[prefixRng() % kWordCount]);
+
+    std::exponential_distribution<double> gap(config.rate > 0 ? config.rate : 1.0);
+    double clock = 0.0;
+    for (size_t i = 0; i < plan.size(); ++i) {
+        auto &request = plan[i];
+        const int shared = static_cast<int>(std::lround(request.promptWords * config.sharedPrefix));
+        std::string prompt;
+        for (int w = 0; w < shared; ++w) {
+            if (w) prompt.push_back(' ');
+            prompt += prefixWords[w];
+        }
+        if (request.promptWords > shared) {
+            if (!prompt.empty()) prompt.push_back(' ');
+            prompt += randomWords(rng, request.promptWords - shared);
+        }
+        request.prompt = std::move(prompt);
+        request.seed = static_cast<int>((seed + i) & 0x7fffffff);
+        if (config.rate > 0 && i > 0) clock += gap(rng);
+        request.arrivalSec = clock;
+    }
+    return plan;
+}
+
+class Backend {
+public:
+    virtual ~Backend() = default;
+    virtual RequestResult run(const PlannedRequest &request, bool stream) = 0;
+};
+
+class EngineBackend : public Backend {
+public:
+    explicit EngineBackend(InferenceEngine &engine) : engine_(engine) {}
+
+    RequestResult run(const PlannedRequest &request, bool stream) override {
+        RequestResult result;
+        CompletionParameters params;
+        params.prompt = request.prompt;
+        params.maxNewTokens = request.maxTokens;
+        params.randomSeed = request.seed;
+        params.temperature = 0.8f;
+        params.topP = 0.9f;
+        params.streaming = stream;
+
+        const auto start = Clock::now();
+        const int jobId = engine_.submitCompletionsJob(params);
+        if (jobId < 0) {
+            result.error = "job submission failed";
+            return result;
+        }
+
+        if (stream) {
+            Clock::time_point firstToken{}, lastToken{};
+            CompletionDelta delta;
+            while (engine_.waitForJobOutput(jobId, delta, 1000)) {
+                if (delta.hasError) { result.error = delta.errorMessage; break; }
+                if (!delta.tokens.empty()) {
+                    lastToken = Clock::now();
+                    if (result.outputTokens == 0) firstToken = lastToken;
+                    result.outputTokens += static_cast<int>(delta.tokens.size());
+                }
+                if (delta.finished) break;
+            }
+            result.e2eMs = msBetween(start, Clock::now());
+            if (result.outputTokens > 0) result.ttftMs = msBetween(start, firstToken);
+            if (result.outputTokens > 1) result.tpotMs = msBetween(firstToken, lastToken) / (result.outputTokens - 1);
+        } else {
+            engine_.waitForJob(jobId);
+            result.e2eMs = msBetween(start, Clock::now());
+        }
+
+        if (result.error.empty() && engine_.hasJobError(jobId)) result.error = engine_.getJobError(jobId);
+        const CompletionResult finalResult = engine_.getJobResult(jobId);
+        result.promptTokens = finalResult.prompt_token_count;
+        if (!stream) {
+            result.outputTokens = static_cast<int>(finalResult.tokens.size());
+            result.ttftMs = finalResult.ttft;
+            if (result.outputTokens > 1) result.tpotMs = (result.e2eMs - result.ttftMs) / (result.outputTokens - 1);
+        }
+        engine_.releaseJob(jobId);
+        result.ok = result.error.empty();
+        return result;
+    }
+
+private:
+    InferenceEngine &engine_;
+};
+
+// Minimal HTTP/1.1 client: one connection per request, Content-Length or chunked bodies
+class HttpBackend : public Backend {
+public:
+    HttpBackend(const BenchConfig &config) : config_(config) {
+        std::string rest = config.url;
+        if (rest.rfind("http://", 0) == 0) rest = rest.substr(7);
+        const size_t slash = rest.find('/');
+        basePath_ = slash == std::string::npos ? "" : rest.substr(slash);
+        while (!basePath_.empty() && basePath_.back() == '/') basePath_.pop_back();
+        std::string hostPort = rest.substr(0, slash);
+        const size_t colon = hostPort.rfind(':');
+        host_ = colon == std::string::npos ? hostPort : hostPort.substr(0, colon);
+        port_ = colon == std::string::npos ? "80" : hostPort.substr(colon + 1);
+    }
+
+    RequestResult run(const PlannedRequest &request, bool stream) override {
+        RequestResult result;
+        json body = {
+            {"model", config_.modelId},
+            {"prompt", request.prompt},
+            {"max_tokens", request.maxTokens},
+            {"temperature", 0.8},
+            {"top_p", 0.9},
+            {"seed", request.seed},
+            {"stream", stream}};
+        const std::string payload = body.dump();
+        std::string head = "POST " + basePath_ + "/v1/completions HTTP/1.1\r\nHost: " + host_ + ":" + port_ +
+                           "\r\nContent-Type: application/json\r\nAccept: " +
+                           (stream ? "text/event-stream" : "application/json") +
+                           "\r\nConnection: close\r\nContent-Length: " + std::to_string(payload.size()) + "\r\n";
+        if (!config_.apiKey.empty()) head += "Authorization: Bearer " + config_.apiKey + "\r\n";
+        head += "\r\n";
+
+        const auto start = Clock::now();
+        SocketType sock = connectTo();
+        if (sock == kInvalidSocket) {
+            result.error = "connect to " + host_ + ":" + port_ + " failed";
+            return result;
+        }
+        const std::string message = head + payload;
+        if (!sendAll(sock, message)) {
+            closeSocket(sock);
+            result.error = "send failed";
+            return result;
+        }
+
+        Clock::time_point firstToken{}, lastToken{};
+        std::string raw, decoded, lineBuffer;
+        bool headersDone = false, chunked = false, bodyDone = false;
+        long contentLength = -1;
+        int status = 0;
+        ChunkDecoder chunks;
+
+        auto onBody = [&](const std::string &data) {
+            if (!stream) { decoded += data; return; }
+            lineBuffer += data;
+            size_t eol;
+            while ((eol = lineBuffer.find('\n')) != std::string::npos) {
+                std::string line = lineBuffer.substr(0, eol);
+                lineBuffer.erase(0, eol + 1);
+                if (!line.empty() && line.back() == '\r') line.pop_back();
+                if (line.rfind("data:", 0) != 0) continue;
+                std::string data = line.substr(line[5] == ' ' ? 6 : 5);
+                if (data == "[DONE]") { bodyDone = true; continue; }
+                json chunk = json::parse(data, nullptr, false);
+                if (chunk.is_discarded()) continue;
+                if (chunk.contains("error")) { result.error = chunk["error"].dump(); continue; }
+                if (chunk.contains("choices") && !chunk["choices"].empty() &&
+                    !chunk["choices"][0].value("text", std::string()).empty()) {
+                    lastToken = Clock::now();
+                    if (result.outputTokens == 0) firstToken = lastToken;
+                    ++result.outputTokens;   // one SSE chunk per generated token
+                }
+                if (chunk.contains("usage") && chunk["usage"].is_object())
+                    result.promptTokens = chunk["usage"].value("prompt_tokens", result.promptTokens);
+            }
+        };
+
+        char buffer[16384];
+        while (!bodyDone) {
+            const int n = recv(sock, buffer, sizeof(buffer), 0);
+            if (n <= 0) break;
+            if (!headersDone) {
+                raw.append(buffer, n);
+                const size_t end = raw.find("\r\n\r\n");
+                if (end == std::string::npos) continue;
+                headersDone = true;
+                std::string headers = raw.substr(0, end);
+                std::string rest = raw.substr(end + 4);
+                raw.clear();
+                if (headers.size() > 12) status = std::atoi(headers.c_str() + 9);
+                for (auto &c : headers) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+                chunked = headers.find("transfer-encoding: chunked") != std::string::npos;
+                const size_t cl = headers.find("content-length:");
+                if (cl != std::string::npos) contentLength = std::atol(headers.c_str() + cl + 15);
+                if (!rest.empty()) {
+                    if (chunked) bodyDone |= chunks.feed(rest, onBody);
+                    else { contentLength -= static_cast<long>(rest.size()); onBody(rest); }
+                }
+            } else if (chunked) {
+                bodyDone |= chunks.feed(std::string(buffer, n), onBody);
+            } else {
+                contentLength -= n;
+                onBody(std::string(buffer, n));
+            }
+            if (!chunked && contentLength == 0) bodyDone = true;
+        }
+        closeSocket(sock);
+        result.e2eMs = msBetween(start, Clock::now());
+
+        if (status != 200) {
+            result.error = "HTTP " + std::to_string(status) + (decoded.empty() ? "" : ": " + decoded.substr(0, 200));
+            return result;
+        }
+        if (stream) {
+            if (result.outputTokens > 0) result.ttftMs = msBetween(start, firstToken);
+            if (result.outputTokens > 1) result.tpotMs = msBetween(firstToken, lastToken) / (result.outputTokens - 1);
+        } else {
+            json response = json::parse(decoded, nullptr, false);
+            if (response.is_discarded()) {
+                result.error = "invalid JSON response";
+                return result;
+            }
+            if (response.contains("usage") && response["usage"].is_object()) {
+                result.outputTokens = response["usage"].value("completion_tokens", 0);
+                result.promptTokens = response["usage"].value("prompt_tokens", -1);
+            }
+            // The first token arrives with the whole response
+            result.ttftMs = result.e2eMs;
+        }
+        result.ok = result.error.empty();
+        return result;
+    }
+
+private:
+    struct ChunkDecoder {
+        std::string pending;
+        long remaining = -1;   // Bytes left in the current chunk plus its CRLF, -1 while reading a size line
+
+        // Returns true after the terminating zero-length chunk
+        template <typename Sink>
+        bool feed(const std::string &data, Sink &sink) {
+            pending += data;
+            while (true) {
+                if (remaining < 0) {
+                    const size_t eol = pending.find("\r\n");
+                    if (eol == std::string::npos) return false;
+                    const long size = std::strtol(pending.c_str(), nullptr, 16);
+                    pending.erase(0, eol + 2);
+                    if (size == 0) return true;
+                    remaining = size + 2;
+                }
+                if (pending.size() < static_cast<size_t>(remaining)) return false;
+                sink(pending.substr(0, remaining - 2));
+                pending.erase(0, remaining);
+                remaining = -1;
+            }
+        }
+    };
+
+    SocketType connectTo() const {
+        addrinfo hints{}, *info = nullptr;
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        if (getaddrinfo(host_.c_str(), port_.c_str(), &hints, &info) != 0) return kInvalidSocket;
+        SocketType sock = kInvalidSocket;
+        for (addrinfo *p = info; p; p = p->ai_next) {
+            sock = socket(p->ai_family, p->ai_socktype, p->ai_protocol);
+            if (sock == kInvalidSocket) continue;
+            if (connect(sock, p->ai_addr, static_cast<int>(p->ai_addrlen)) == 0) break;
+            closeSocket(sock);
+            sock = kInvalidSocket;
+        }
+        freeaddrinfo(info);
+        if (sock != kInvalidSocket) {
+#ifdef _WIN32
+            DWORD timeout = config_.timeoutSec * 1000;
+            setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char *>(&timeout), sizeof(timeout));
+#else
+            timeval timeout{config_.timeoutSec, 0};
+            setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+#endif
+        }
+        return sock;
+    }
+
+    static bool sendAll(SocketType sock, const std::string &data) {
+        size_t sent = 0;
+        while (sent < data.size()) {
+            const int n = send(sock, data.data() + sent, static_cast<int>(data.size() - sent), 0);
+            if (n <= 0) return false;
+            sent += n;
+        }
+        return true;
+    }
+
+    const BenchConfig &config_;
+    std::string host_, port_, basePath_;
+};
+
+// Dispatches the plan at its arrival times onto a fixed pool of client threads
+std::vector<RequestResult> runWorkload(Backend &backend, const std::vector<PlannedRequest> &plan,
+                                       const BenchConfig &config, double &durationSec) {
+    std::vector<RequestResult> results(plan.size());
+    std::deque<size_t> ready;
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool dispatched = false;
+
+    const auto start = Clock::now();
+    std::vector<std::thread> workers;
+    for (int w = 0; w < std::max(1, config.concurrency); ++w) {
+        workers.emplace_back([&] {
+            while (true) {
+                size_t index;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    cv.wait(lock, [&] { return !ready.empty() || dispatched; });
+                    if (ready.empty()) return;
+                    index = ready.front();
+                    ready.pop_front();
+                }
+                results[index] = backend.run(plan[index], config.stream);
+            }
+        });
+    }
+
+    for (size_t i = 0; i < plan.size(); ++i) {
+        std::this_thread::sleep_until(start + std::chrono::duration_cast<Clock::duration>(
+                                                  std::chrono::duration<double>(plan[i].arrivalSec)));
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ready.push_back(i);
+        }
+        cv.notify_one();
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        dispatched = true;
+    }
+    cv.notify_all();
+    for (auto &worker : workers) worker.join();
+
+    durationSec = std::chrono::duration<double>(Clock::now() - start).count();
+    return results;
+}
+
+json summarize(std::vector<double> values) {
+    if (values.empty()) return json{{"count", 0}};
+    std::sort(values.begin(), values.end());
+    auto percentile = [&](double p) {
+        const double rank = p / 100.0 * (values.size() - 1);
+        const size_t lo = static_cast<size_t>(rank);
+        const size_t hi = std::min(lo + 1, values.size() - 1);
+        return values[lo] + (values[hi] - values[lo]) * (rank - lo);
+    };
+    double sum = 0;
+    for (double v : values) sum += v;
+    return {
+        {"count", values.size()},
+        {"mean", sum / values.size()},
+        {"min", values.front()},
+        {"p50", percentile(50)},
+        {"p90", percentile(90)},
+        {"p95", percentile(95)},
+        {"p99", percentile(99)},
+        {"max", values.back()}};
+}
+
+json buildReport(const BenchConfig &config, const std::vector<RequestResult> &results, double durationSec) {
+    std::vector<double> ttft, tpot, e2e, outputTokens, promptTokens;
+    json errors = json::array();
+    int completed = 0, failed = 0, good = 0;
+    long long totalOutput = 0, totalPrompt = 0;
+    for (const auto &r : results) {
+        if (!r.ok) {
+            ++failed;
+            if (errors.size() < 10) errors.push_back(r.error);
+            continue;
+        }
+        ++completed;
+        e2e.push_back(r.e2eMs);
+        outputTokens.push_back(r.outputTokens);
+        totalOutput += r.outputTokens;
+        if (r.ttftMs >= 0) ttft.push_back(r.ttftMs);
+        if (r.tpotMs >= 0) tpot.push_back(r.tpotMs);
+        if (r.promptTokens >= 0) {
+            promptTokens.push_back(r.promptTokens);
+            totalPrompt += r.promptTokens;
+        }
+        const bool ttftOk = config.sloTtftMs <= 0 || (r.ttftMs >= 0 && r.ttftMs <= config.sloTtftMs);
+        const bool tpotOk = config.sloTpotMs <= 0 || r.tpotMs < 0 || r.tpotMs <= config.sloTpotMs;
+        if (ttftOk && tpotOk) ++good;
+    }
+
+    const double seconds = std::max(durationSec, 1e-9);
+    json report = {
+        {"backend", config.url.empty() ? "engine" : "http"},
+        {"target", config.url.empty() ? config.modelPath : config.url},
+        {"config", {
+            {"requests", config.requests},
+            {"rate", config.rate},
+            {"concurrency", config.concurrency},
+            {"stream", config.stream},
+            {"seed", config.seed},
+            {"prompt_words", config.promptLen.toJson()},
+            {"max_tokens", config.outputLen.toJson()},
+            {"shared_prefix", config.sharedPrefix}}},
+        {"duration_s", durationSec},
+        {"completed", completed},
+        {"failed", failed},
+        {"request_throughput", completed / seconds},
+        {"output_token_throughput", totalOutput / seconds},
+        {"goodput", {
+            {"slo_ttft_ms", config.sloTtftMs},
+            {"slo_tpot_ms", config.sloTpotMs},
+            {"requests_per_s", good / seconds},
+            {"fraction", results.empty() ? 0.0 : static_cast<double>(good) / results.size()}}},
+        {"ttft_ms", summarize(ttft)},
+        {"tpot_ms", summarize(tpot)},
+        {"e2e_ms", summarize(e2e)},
+        {"output_tokens", summarize(outputTokens)}};
+    if (!promptTokens.empty()) {
+        report["prompt_tokens"] = summarize(promptTokens);
+        report["total_token_throughput"] = (totalPrompt + totalOutput) / seconds;
+    }
+    if (!config.url.empty() && !config.stream) report["note"] = "non-streaming HTTP: TTFT equals end-to-end latency";
+    if (!errors.empty()) report["errors"] = errors;
+    return report;
+}
+
+void printUsage(const char *argv0) {
+    std::cerr << "Usage:\n"
+              << "  " << argv0 << " --model <model.gguf> [options]         benchmark the in-process engine\n"
+              << "  " << argv0 << " --url http://host:port --model-id <id> [options]   benchmark a running server\n\n"
+              << "Workload:\n"
+              << "  --requests N          timed requests (default 100)\n"
+              << "  --warmup N            untimed requests sent first, one at a time (default 2)\n"
+              << "  --rate R              Poisson arrival rate in requests/s, 0 = all at once (default 0)\n"
+              << "  --concurrency N       maximum requests in flight (default 16)\n"
+              << "  --prompt-len DIST     prompt length in words (default fixed:256)\n"
+              << "  --output-len DIST     max_tokens per request (default fixed:128)\n"
+              << "                        DIST is N, fixed:N, uniform:MIN:MAX, normal:MEAN:STDDEV or exponential:MEAN\n"
+              << "  --shared-prefix F     fraction of each prompt shared across requests, 0..1 (default 0)\n"
+              << "  --no-stream           wait for whole responses instead of streaming\n"
+              << "  --seed N              workload seed (default 42)\n"
+              << "  --slo-ttft-ms MS      TTFT bound for goodput (default none)\n"
+              << "  --slo-tpot-ms MS      TPOT bound for goodput (default none)\n"
+              << "  --json FILE           also write the report to FILE\n"
+              << "HTTP:\n"
+              << "  --api-key KEY         sent as a Bearer token\n"
+              << "  --timeout S           per-request receive timeout in seconds (default 600)\n"
+              << "Engine:\n"
+              << "  --n-ctx N --n-parallel N --n-batch N --n-ubatch N --n-gpu-layers N\n";
+}
+
+bool parseArgs(int argc, char **argv, BenchConfig &config) {
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        auto value = [&]() -> const char * {
+            if (i + 1 >= argc) throw std::invalid_argument(arg + " needs a value");
+            return argv[++i];
+        };
+        auto lengths = [&](LengthDistribution &out) {
+            const std::string spec = value();
+            if (!LengthDistribution::parse(spec, out)) throw std::invalid_argument("bad length distribution '" + spec + "'");
+        };
+        if (arg == "--model") config.modelPath = value();
+        else if (arg == "--url") config.url = value();
+        else if (arg == "--model-id") config.modelId = value();
+        else if (arg == "--api-key") config.apiKey = value();
+        else if (arg == "--json") config.output = value();
+        else if (arg == "--requests") config.requests = std::stoi(value());
+        else if (arg == "--warmup") config.warmup = std::stoi(value());
+        else if (arg == "--rate") config.rate = std::stod(value());
+        else if (arg == "--concurrency") config.concurrency = std::stoi(value());
+        else if (arg == "--prompt-len") lengths(config.promptLen);
+        else if (arg == "--output-len") lengths(config.outputLen);
+        else if (arg == "--shared-prefix") config.sharedPrefix = std::stod(value());
+        else if (arg == "--no-stream") config.stream = false;
+        else if (arg == "--seed") config.seed = std::stoull(value());
+        else if (arg == "--slo-ttft-ms") config.sloTtftMs = std::stod(value());
+        else if (arg == "--slo-tpot-ms") config.sloTpotMs = std::stod(value());
+        else if (arg == "--timeout") config.timeoutSec = std::stoi(value());
+        else if (arg == "--n-ctx") config.nCtx = std::stoi(value());
+        else if (arg == "--n-parallel") config.nParallel = std::stoi(value());
+        else if (arg == "--n-batch") config.nBatch = std::stoi(value());
+        else if (arg == "--n-ubatch") config.nUbatch = std::stoi(value());
+        else if (arg == "--n-gpu-layers") config.nGpuLayers = std::stoi(value());
+        else if (arg == "--help" || arg == "-h") return false;
+        else throw std::invalid_argument("unknown option " + arg);
+    }
+    if (config.modelPath.empty() == config.url.empty())
+        throw std::invalid_argument("give exactly one of --model or --url");
+    if (!config.url.empty() && config.modelId.empty())
+        throw std::invalid_argument("--url needs --model-id");
+    if (config.requests < 1 || config.concurrency < 1 || config.rate < 0 || config.warmup < 0)
+        throw std::invalid_argument("--requests and --concurrency must be positive, --rate and --warmup non-negative");
+    if (config.sharedPrefix < 0 || config.sharedPrefix > 1)
+        throw std::invalid_argument("--shared-prefix must be between 0 and 1");
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    BenchConfig config;
+    try {
+        if (!parseArgs(argc, argv, config)) { printUsage(argv[0]); return 64; }
+    } catch (const std::exception &e) {
+        std::cerr << "[BENCH] " << e.what() << "\n\n";
+        printUsage(argv[0]);
+        return 64;
+    }
+
+#ifdef _WIN32
+    WSADATA wsaData;
+    WSAStartup(MAKEWORD(2, 2), &wsaData);
+#endif
+
+    std::unique_ptr<InferenceEngine> engine;
+    std::unique_ptr<Backend> backend;
+    if (!config.modelPath.empty()) {
+        engine = std::make_unique<InferenceEngine>();
+        LoadingParameters lp;
+        lp.n_ctx = config.nCtx;
+        lp.n_parallel = config.nParallel;
+        lp.n_batch = config.nBatch;
+        lp.n_ubatch = config.nUbatch;
+        lp.n_gpu_layers = config.nGpuLayers;
+        std::cerr << "[BENCH] Loading " << config.modelPath << "\n";
+        if (!engine->loadModel(config.modelPath.c_str(), lp)) {
+            std::cerr << "[BENCH] Failed to load model\n";
+            return 65;
+        }
+        backend = std::make_unique<EngineBackend>(*engine);
+    } else {
+        backend = std::make_unique<HttpBackend>(config);
+    }
+
+    // Warm-up requests use a different seed so they never prime the timed prompts' prefixes
+    for (const auto &request : planWorkload(config, config.warmup, config.seed + 0x5bd1e995)) {
+        RequestResult r = backend->run(request, config.stream);
+        if (!r.ok) std::cerr << "[BENCH] Warm-up request failed: " << r.error << "\n";
+    }
+
+    const auto plan = planWorkload(config, config.requests, config.seed);
+    std::cerr << "[BENCH] Running " << plan.size() << " requests"
+              << (config.rate > 0 ? " at " + std::to_string(config.rate) + " req/s" : " at once")
+              << ", concurrency " << config.concurrency << (config.stream ? ", streaming" : "") << "\n";
+    double durationSec = 0;
+    const auto results = runWorkload(*backend, plan, config, durationSec);
+    const json report = buildReport(config, results, durationSec);
+
+    std::cout << report.dump(2) << std::endl;
+    if (!config.output.empty()) {
+        std::ofstream out(config.output);
+        out << report.dump(2) << '\n';
+        if (!out) {
+            std::cerr << "[BENCH] Could not write " << config.output << "\n";
+            return 66;
+        }
+    }
+
+#ifdef _WIN32
+    WSACleanup();
+#endif
+    return report["failed"].get<int>() == 0 ? 0 : 1;
+}
@@ -79,11 +79,11 @@
  * // Submit chat completion job
  * int chatJobId = engine.submitChatCompletionsJob(chatParams);
  * 
- * // For streaming, poll for results
- * while (!engine.isJobFinished(chatJobId)) {
- *     CompletionResult partialResult = engine.getJobResult(chatJobId);
- *     std::cout << partialResult.text;  // Print incremental text
- *     std::this_thread::sleep_for(std::chrono::milliseconds(100));
+ * // For streaming, wait for each new piece of output as it is decoded
+ * CompletionDelta delta;
+ * while (engine.waitForJobOutput(chatJobId, delta)) {
+ *     std::cout << delta.text;  // Print incremental text
+ *     if (delta.finished) break;
  * }
  * 
  * // Get final result
@@ -162,8 +162,57 @@
 // Job Management Structure
 // =============================================================================
 
+// A sequence's KV state and its tokens, as the session caches keep them in memory
+using SessionSnapshot = KvSequenceState;
+
+/**
+ * @brief Aho-Corasick automaton over a job's stop sequences.
+ *
+ * Generated text is fed one token piece at a time, so a stop sequence split across
+ * tokens is still found without rescanning the output.
+ */
+class StopSequenceMatcher {
+public:
+    StopSequenceMatcher() = default;
+    explicit StopSequenceMatcher(const std::vector<std::string>& stops);
+
+    bool empty() const { return nodes_.size() <= 1; }
+
+    /**
+     * @brief Feeds the next piece of output.
+     * @return Bytes to cut from the end of everything fed so far to drop the earliest
+     *         stop sequence completed in this piece, or std::string::npos if none was.
+     */
+    size_t feed(const std::string& piece);
+
+    // Trailing bytes fed so far that could still be the start of a stop sequence
+    size_t partialBytes() const { return nodes_.empty() ? 0 : nodes_[state_].depth; }
+
+private:
+    struct Node {
+        std::vector<std::pair<unsigned char, int>> next;
+        int    fail  = 0;
+        size_t depth = 0;
+        size_t match = 0;   // Longest stop sequence ending here, 0 = none
+    };
+
+    int step(int state, unsigned char c) const;
+
+    std::vector<Node> nodes_;
+    int               state_ = 0;
+};
+
+/**
+ * @brief Prompt-lookup drafting: finds the most recent earlier occurrence of the last n
+ * tokens (max_ngram down to min_ngram) and returns up to n_max tokens that followed it.
+ * Empty when no suffix repeats.
+ */
+std::vector<llama_token> lookupNgramDraft(const std::vector<llama_token>& tokens, int min_ngram, int max_ngram, int n_max);
+
 /**
  * @brief Represents a single inference job with all its state and resources.
+ *
+ * Jobs are pooled per engine; recycle() must return every field to its initial value.
  */
 struct Job {
     // Job identification
@@ -178,11 +227,29 @@ struct Job {
     std::vector<int32_t>    generatedTokens;
     std::string             generatedText;
     std::vector<float>      embedding;        // For embedding jobs
+
+    // Output not yet handed to the waitForJobOutput() consumer; only filled once
+    // a consumer has subscribed so non-streaming jobs do not keep a second copy
+    bool                    outputSubscribed = false;
+    std::vector<int32_t>    pendingTokens;
+    std::string             pendingText;
+
+    // Stop sequences; output that may still begin one is held back from readers until it
+    // either completes (and is cut off) or diverges
+    StopSequenceMatcher     stopMatcher;
+    size_t                  publishedTextBytes = 0;  // Prefix of generatedText readers may see
+    double                  logprob = 0.0;           // Sum of the output tokens' log-probabilities (params.scoreOutput)
+
+    // Candidate of an n > 1 request: copies this job's prompt KV once it is decoded
+    // instead of decoding the prompt itself
+    std::weak_ptr<Job>      forkFrom;
+    int                     forkFromId = -1;         // jobId forkFrom had; a recycled Job no longer matches
     int                     embedding_token_count = 0; // Number of tokens processed for embedding
     
     // Job state
     bool                    isFinished      = false;
     bool                    hasError        = false;
+    bool                    suspended       = false;   // Ended by suspendJob(); the output continues elsewhere
     std::string             errorMessage;
     
     // Performance metrics
@@ -193,10 +260,15 @@ struct Job {
     // Timing tracking
     std::chrono::steady_clock::time_point start_time;
     std::chrono::steady_clock::time_point first_token_time;
+    std::chrono::steady_clock::time_point last_token_time;
+    JobTiming               timing;    // Guarded by mtx once the job reaches the decode thread
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max(); // Scheduling deadline (max = none)
+    std::chrono::steady_clock::time_point reclaim_at;  // Set by the job sweeper once finished; epoch = not yet
     bool                    first_token_generated = false;
     
     // Atomic flags for thread-safe operations
     std::atomic<bool>       cancelRequested{false};
+    std::atomic<bool>       suspendRequested{false};  // Cancelled for migration; set together with cancelRequested
     std::atomic<bool>       session_load_attempted{false};
       // Job parameters
     CompletionParameters    params;
@@ -204,20 +276,57 @@ struct Job {
     
     // Processing state
     bool                    isDecodingPrompt            = true;
+    bool                    isPromptPrepared            = false;  // Session load / tokenization / prefix reuse done
+    bool                    isContextShifted            = false;  // KV was trimmed, prompt cells no longer at their original positions
     int                     n_past                      = 0;
     int                     n_remain                    = 0;
     int                     i_prompt                    = 0;
     int                     n_prompt                    = 0;
     int                     batch_pos                   = 0;
     size_t                  n_matching_session_tokens   = 0;
+    int                     promptCutTokens             = 0;      // Dropped after the first n_keep prompt tokens by context shifting
     
     // Token management
     std::vector<llama_token> session_tokens;
     std::vector<llama_token> embd_inp;
+    std::vector<llama_token> prompt_tokens; // Prompt tokenized at submission, moved into embd_inp at prompt setup
+    std::vector<llama_token> warm_tokens;   // Tokens already in the KV of a reused warm slot (consumed at prompt setup)
     std::string              path_session;
+    std::string              evicted_key;       // Conversation whose warm slot this job reclaimed; spilled at prompt setup
+    std::vector<llama_token> evicted_tokens;
+    std::shared_ptr<const SessionSnapshot> session_snapshot; // Session prefetched at submission, consumed by loadSession
+    std::shared_ptr<const SessionSnapshot> kv_export;        // KV left by a prefillOnly or suspended job for getJobKvState()
+    std::shared_ptr<const SessionSnapshot> swapped;          // KV of a job paused without a slot for a higher-priority one
+
+    // Cached document chunks found in the prompt at prompt setup, in prompt order; each covers
+    // the chunk's tokens but its first and last, starting at prompt index `begin`
+    struct ChunkSplice {
+        int                                    begin = 0;
+        std::shared_ptr<const SessionSnapshot> chunk;
+    };
+    std::vector<ChunkSplice> chunkSplices;
+    
+    // Speculative decoding
+    std::vector<llama_token> draft;                     // Drafts submitted with the current batch
+    std::vector<int>         draftIdxs;                 // Batch indices of the pending token and its drafts
+    std::vector<llama_token> draftKvTokens;             // Tokens held in the draft model's KV for seqId
+    bool                     draftKvSynced      = false;
+    int                      draftTokenCount    = 0;    // Drafts verified by the target model
+    int                      draftAcceptedCount = 0;    // Drafts the target model accepted
+    bool                     drafts             = false;  // Decoded speculatively (draft model or prompt lookup)
+    bool                     promptLookup       = false;  // Drafts come from n-gram matches in its own tokens first
+
+    // Tokens whose logits the job samples next (the pending token and its drafts), decoded again
+    // when a step with another LoRA adapter or a resume after preemption lost those logits
+    std::vector<llama_token> logitTokens;
+    uint64_t                 logitsStep         = 0;    // Decode step the logits came from
     
     // Sampling interface
     struct common_sampler*   smpl           = nullptr;
+    std::string              samplerKey;    // Settings smpl was built with; finished samplers are pooled under it
+
+    // Reset for reuse by another request; containers keep their capacity
+    void recycle();
     
     // Destructor - cleanup resources
     ~Job() {
@@ -243,6 +352,7 @@ public:
     explicit InferenceEngine();    // Model management
     bool loadModel(const char* modelPath, const LoadingParameters lParams, const int mainGpuId = -1);
     bool loadEmbeddingModel(const char* modelPath, const LoadingParameters lParams, const int mainGpuId = -1);
+    bool loadRerankModel(const char* modelPath, const LoadingParameters lParams, const int mainGpuId = -1);
     bool unloadModel();
 
     // Job submission
@@ -258,6 +368,22 @@ public:
      */
     int submitChatCompletionsJob(const ChatCompletionParameters& params);
 
+    /**
+     * @brief Submits n candidates of one completion that share a single prompt prefill.
+     * @param params The parameters for the completion job; candidate i uses randomSeed + i.
+     * @param n The number of candidates.
+     * @return One job ID per candidate.
+     */
+    std::vector<int> submitCompletionsJobs(const CompletionParameters& params, int n);
+
+    /**
+     * @brief Submits n candidates of one chat completion that share a single prompt prefill.
+     * @param params The parameters for the chat completion job; candidate i uses randomSeed + i.
+     * @param n The number of candidates.
+     * @return One job ID per candidate.
+     */
+    std::vector<int> submitChatCompletionsJobs(const ChatCompletionParameters& params, int n);
+
     /**
      * @brief Submits an embedding job and returns the job ID.
      * @param params The parameters for the embedding job.
@@ -265,6 +391,46 @@ public:
      */
     int submitEmbeddingJob(const EmbeddingParameters& params);
 
+    /**
+     * @brief Embeds several inputs in shared batches and waits for all of them.
+     * @param params The parameters for each input.
+     * @return One result per input, in input order.
+     */
+    std::vector<EmbeddingResult> submitEmbeddingBatch(const std::vector<EmbeddingParameters>& params);
+
+    /**
+     * @brief Scores documents against a query with a reranker model.
+     * @param query The query text.
+     * @param documents The documents to score.
+     * @param topK How many of the best documents to return (<= 0 for all).
+     * @return The best documents, most relevant first.
+     */
+    std::vector<RerankResult> rerank(const std::string& query, const std::vector<std::string>& documents, int topK = -1);
+
+    /**
+     * @brief Scores continuations after their prompts, without generating.
+     * @param requests The prompt-continuation pairs.
+     * @param topLogprobs How many likeliest alternatives to return per continuation token.
+     * @return The log-likelihood of each continuation, in request order.
+     */
+    std::vector<ScoringResult> score(const std::vector<ScoringRequest>& requests, int topLogprobs = 0);
+
+    /**
+     * @brief Tokenizes text with the model vocabulary, without a decode slot.
+     * @param text The text to tokenize.
+     * @param addSpecial Whether to add BOS/EOS as for a prompt.
+     * @return The token ids.
+     */
+    std::vector<int32_t> tokenize(const std::string& text, bool addSpecial = true);
+
+    /**
+     * @brief Counts tokens for several texts, caching counts by text hash.
+     * @param texts The texts to count.
+     * @param addSpecial Whether to count BOS/EOS as for a prompt.
+     * @return One count per text, in input order.
+     */
+    std::vector<int> countTokens(const std::vector<std::string>& texts, bool addSpecial = true);
+
     // Job control
     /**
      * @brief Stops a job.
@@ -272,11 +438,19 @@ public:
      */
     void stopJob(int job_id);
 
+    /**
+     * @brief Stops a job so another engine can continue it.
+     * @param job_id The ID of the job to suspend.
+     */
+    void suspendJob(int job_id);
+
     /**
      * @brief Waits for a job to finish.
      * @param job_id The ID of the job to wait for.
+     * @param timeoutMs Maximum time to wait in milliseconds (-1 waits until it finishes).
+     * @return true if the job has finished, false on timeout.
      */
-    void waitForJob(int job_id);
+    bool waitForJob(int job_id, int timeoutMs = -1);
 
     // Job status and results
     /**
@@ -292,6 +466,23 @@ public:
      */
     CompletionResult getJobResult(int job_id);
 
+    /**
+     * @brief Waits for output generated since the previous call.
+     * @param job_id The ID of the job.
+     * @param delta Receives the newly generated tokens and text.
+     * @param timeoutMs Maximum time to wait in milliseconds (-1 waits indefinitely).
+     * @return False if the job ID is unknown.
+     */
+    bool waitForJobOutput(int job_id, CompletionDelta& delta, int timeoutMs = -1);
+
+    /**
+     * @brief Gets the output generated after the given cursor and advances it.
+     * @param job_id The ID of the job.
+     * @param cursor The caller's position in the job output.
+     * @return The newly generated tokens and text.
+     */
+    CompletionDelta getJobResultSince(int job_id, JobOutputCursor& cursor);
+
     /**
      * @brief Gets the result of an embedding job.
      * @param job_id The ID of the embedding job to get the result for.
@@ -314,12 +505,100 @@ public:
      */
     std::string getJobError(int job_id);
 
+    /**
+     * @brief Takes the KV state a finished prefillOnly or suspended job left behind.
+     * @param job_id The ID of the job.
+     * @return The state, or nullptr if there is none; it can be taken once.
+     */
+    std::shared_ptr<const KvSequenceState> getJobKvState(int job_id);
+
     /**
      * @brief Checks if there are any active jobs currently running.
      * @return True if there are active jobs, false otherwise.
      */
     bool hasActiveJobs();
 
+    /**
+     * @brief Returns counters and sizes of the tiered KV session cache.
+     * @return Zeroed stats for engines without session caching.
+     */
+    KvCacheStats getKvCacheStats();
+
+    /**
+     * @brief Returns the huge pages requested at load and how much memory they back right now.
+     * @return requested "off" and zero sizes when huge pages were not requested.
+     */
+    HugePageStats getHugePageStats();
+
+    /**
+     * @brief Takes every conversation's KV out of the engine.
+     * @return Session key and state of each warm or spilled conversation.
+     */
+    std::vector<std::pair<std::string, std::shared_ptr<const KvSequenceState>>> exportSessions();
+
+    /**
+     * @brief Adopts a conversation exported by another engine of the same model.
+     * @param key The conversation's session key.
+     * @param state Its KV state.
+     * @return False if there is nowhere to keep it.
+     */
+    bool importSession(const std::string& key, std::shared_ptr<const KvSequenceState> state);
+
+    /**
+     * @brief Precomputes a document chunk's KV so prompts quoting it skip its prefill.
+     * @param text The chunk's text.
+     * @return False if the chunk cache is off or the chunk cannot be cached.
+     */
+    bool precomputeChunk(const std::string& text);
+
+    /**
+     * @brief Returns decode-loop counters, latency histograms and slot/KV usage.
+     * @return Zeroed stats when no model is loaded.
+     */
+    DecodeStats getDecodeStats();
+
+    /**
+     * @brief Returns the most recent decode steps when step profiling is enabled.
+     * @return Oldest first; empty when profile_steps is 0 or no model is loaded.
+     */
+    std::vector<DecodeStepSample> getStepProfile();
+
+    /**
+     * @brief Records every decode step with its per-job batch composition until endStepCapture().
+     * @param maxSteps Steps kept at most.
+     */
+    void beginStepCapture(size_t maxSteps);
+
+    /**
+     * @brief Ends the step capture and returns its steps.
+     * @return Oldest first; empty when no capture ran or no model is loaded.
+     */
+    std::vector<DecodeStepSample> endStepCapture();
+
+    /**
+     * @brief Drops a job and its results, cancelling it if still running.
+     * @param job_id The ID of the job to release.
+     */
+    void releaseJob(int job_id);
+
+    /**
+     * @brief Returns the number of jobs the engine still holds.
+     * @return Running jobs plus finished jobs not yet released or reclaimed.
+     */
+    size_t liveJobCount();
+
+    /**
+     * @brief Returns the engine's outstanding work.
+     * @return Active jobs and their remaining prompt and generation tokens.
+     */
+    EngineLoad getLoad();
+
+    /**
+     * @brief Returns how far a load running on another thread has got.
+     * @return 0..1; 1 once the model is loaded, 0 when none is.
+     */
+    float getLoadProgress();
+
     /**
      * @brief Destructor for the InferenceEngine.
      */
@@ -328,6 +607,7 @@ public:
 private:
     struct Impl;
     std::unique_ptr<Impl> pimpl;
+    std::atomic<float> loadProgress{ 0.0f };   // Written by the loading thread before pimpl exists
 };
 
 // =============================================================================
@@ -25,7 +25,10 @@
  * @date 2025
  */
 
+#include <cstdint>
+#include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
 // =============================================================================
@@ -58,6 +61,9 @@
 struct EmbeddingParameters {
     // Input text to embed
     std::string input;
+
+    // With a reranker model: the document scored against input, which is then the query
+    std::string document;
     
     // Normalize the embeddings
     bool normalize = true;
@@ -75,6 +81,8 @@ struct EmbeddingParameters {
 struct EmbeddingResult {
     std::vector<float> embedding;    // Embedding vector
     int                tokens_count; // Number of tokens processed
+    bool               hasError = false;  // Set per input by submitEmbeddingBatch()
+    std::string        errorMessage;
     
     /**
      * @brief Default constructor.
@@ -82,6 +90,53 @@ struct EmbeddingResult {
     EmbeddingResult() : tokens_count(0) {}
 };
 
+/**
+ * @brief Relevance of one document to a query, from a reranker model.
+ */
+struct RerankResult {
+    int   index = -1;   // Position of the document in the request
+    float score = 0.0f; // Reranker logit; higher is more relevant
+};
+
+/**
+ * @brief A continuation to score after a prompt, without generating.
+ */
+struct ScoringRequest {
+    std::string prompt;         // Conditioning text; special tokens are parsed and BOS added as for a completion
+    std::string continuation;   // Text whose tokens are scored, appended to the prompt as is
+};
+
+/**
+ * @brief Log-probability of one token under the model.
+ */
+struct TokenLogprob {
+    int32_t                   token = -1;
+    std::string               text;             // Token piece
+    float                     logprob = 0.0f;   // Natural log of its probability
+    std::vector<TokenLogprob> top;              // Likeliest tokens at its position, most likely first
+};
+
+/**
+ * @brief Log-likelihood of a continuation given its prompt.
+ */
+struct ScoringResult {
+    std::vector<TokenLogprob> tokens;           // One per continuation token
+    double                    logprob = 0.0;    // Sum over the continuation tokens
+    bool                      greedy = true;    // Every continuation token was the likeliest at its position
+    int                       prompt_tokens = 0;
+};
+
+/**
+ * @brief KV state of one sequence and the tokens it holds.
+ *
+ * Produced by a prefillOnly job and handed to another engine loaded with the
+ * same model file, which resumes from it instead of decoding the prompt.
+ */
+struct KvSequenceState {
+    std::vector<int32_t> tokens;    // Tokens the state covers, from position 0
+    std::vector<uint8_t> state;     // llama_state_seq_get_data() of the sequence
+};
+
 /**
  * @brief Parameters for a completion job.
  */
@@ -108,10 +163,50 @@ struct CompletionParameters {
     // Context shifting parameters
     int         n_discard       = 0;  // Number of tokens to discard during context shift (0 = default to n_left/2)
     bool        allow_context_shift = false;  // Allow automatic context shifting when prompt exceeds context window
+    int         maxContext      = 0;  // Context this sequence may grow to, capped by LoadingParameters::max_seq_ctx (0 = that cap)
     
     // Cache and session management
     std::string kvCacheFilePath = "";
     int         seqId           = -1;
+    std::string sessionKey      = "";  // Conversation key; keeps the slot's KV warm in memory between turns
+
+    // Scheduling
+    int         priority        = 0;   // Higher values are scheduled first
+    int         deadlineMs      = 0;   // Soft latency target from submission; earlier deadlines go first (0 = none)
+
+    // Weighted fair sharing of slots and prompt tokens between tenants; jobs without a tenant share one
+    std::string tenant          = "";
+    float       tenantWeight    = 1.0f;  // Share relative to the other tenants with work on the engine
+    int         tenantMaxSlots  = 0;     // Slots the tenant may hold at once (0 = no cap)
+
+    // Generation ends as soon as the output contains one of these; the match is not returned
+    std::vector<std::string> stop;
+
+    // Sum each output token's log-probability into CompletionResult::logprob (ranks best_of candidates)
+    bool        scoreOutput     = false;
+
+    // Draft continuations by matching the output's last n-gram against the prompt and earlier
+    // output: 1 = on, 0 = off, -1 = the model's prompt_lookup setting
+    int         promptLookup    = -1;
+
+    // LoRA adapter to generate with, by its LoadingParameters::lora_adapters name (empty = base model)
+    std::string loraAdapter     = "";
+
+    // Disaggregated serving: end once the prompt is decoded, keeping its KV state for
+    // getJobKvState() instead of generating
+    bool        prefillOnly     = false;
+
+    // KV state of this prompt computed by a prefillOnly job on another engine of the same
+    // model; the job resumes from it and only decodes the tokens it does not cover
+    std::shared_ptr<const KvSequenceState> kvState;
+
+    // Live migration: generate after kvState's tokens (the prompt and the output a suspended
+    // job produced elsewhere) instead of after the prompt
+    bool        resumeFromKvState = false;
+
+    // Tokens of prompt when the engine already has them (a chat rendered through its template
+    // segment cache); null to tokenize prompt
+    std::shared_ptr<const std::vector<int32_t>> promptTokens;
 
     bool isValid() const;
 };
@@ -158,10 +253,46 @@ struct ChatCompletionParameters {
     // Context shifting parameters
     int         n_discard       = 0;  // Number of tokens to discard during context shift (0 = default to n_left/2)
     bool        allow_context_shift = false;  // Allow automatic context shifting when prompt exceeds context window
+    int         maxContext      = 0;  // Context this sequence may grow to, capped by LoadingParameters::max_seq_ctx (0 = that cap)
     
     // Cache and session management
     std::string kvCacheFilePath = "";
     int         seqId           = -1;
+    std::string sessionKey      = "";  // Conversation key; keeps the slot's KV warm in memory between turns
+
+    // Scheduling
+    int         priority        = 0;   // Higher values are scheduled first
+    int         deadlineMs      = 0;   // Soft latency target from submission; earlier deadlines go first (0 = none)
+
+    // Weighted fair sharing of slots and prompt tokens between tenants; jobs without a tenant share one
+    std::string tenant          = "";
+    float       tenantWeight    = 1.0f;  // Share relative to the other tenants with work on the engine
+    int         tenantMaxSlots  = 0;     // Slots the tenant may hold at once (0 = no cap)
+
+    // Generation ends as soon as the output contains one of these; the match is not returned
+    std::vector<std::string> stop;
+
+    // Sum each output token's log-probability into CompletionResult::logprob (ranks best_of candidates)
+    bool        scoreOutput     = false;
+
+    // Draft continuations by matching the output's last n-gram against the prompt and earlier
+    // output: 1 = on, 0 = off, -1 = the model's prompt_lookup setting
+    int         promptLookup    = -1;
+
+    // LoRA adapter to generate with, by its LoadingParameters::lora_adapters name (empty = base model)
+    std::string loraAdapter     = "";
+
+    // Disaggregated serving: end once the prompt is decoded, keeping its KV state for
+    // getJobKvState() instead of generating
+    bool        prefillOnly     = false;
+
+    // KV state of this prompt computed by a prefillOnly job on another engine of the same
+    // model; the job resumes from it and only decodes the tokens it does not cover
+    std::shared_ptr<const KvSequenceState> kvState;
+
+    // Live migration: generate after kvState's tokens (the prompt and the output a suspended
+    // job produced elsewhere) instead of after the prompt
+    bool        resumeFromKvState = false;
     
     // Tool usage parameters
     std::string tools           = "";
@@ -170,6 +301,29 @@ struct ChatCompletionParameters {
     bool isValid() const;
 };
 
+/**
+ * @brief Where a completion job spent its time, in milliseconds.
+ *
+ * Decode steps are shared by every job in the batch, so prefill_ms and decode_ms are the
+ * wall time of the llama_decode() calls the job took part in, not its share of them.
+ */
+struct JobTiming {
+    float queue_ms     = 0.0f;  // Waiting for a worker thread and then for a free slot
+    float tokenize_ms  = 0.0f;  // Prompt tokenization and context-size checks
+    float grammar_ms   = 0.0f;  // Building the sampler, including grammar / JSON schema compilation
+    float session_ms   = 0.0f;  // Restoring KV from a session file, tier cache or warm slot
+    float prefill_ms   = 0.0f;  // llama_decode() calls that ingested this job's prompt
+    float decode_ms    = 0.0f;  // llama_decode() calls that produced this job's tokens
+    float sample_ms    = 0.0f;  // Sampling, grammar constraints and draft verification included
+    int   decode_steps = 0;     // Decode steps the job took part in
+
+    // Phase boundaries, steady_clock microseconds (0 = not reached), for request tracing
+    int64_t submitted_us   = 0;  // Job submitted to the engine
+    int64_t scheduled_us   = 0;  // Slot acquired, job handed to the decode loop
+    int64_t first_token_us = 0;  // First token generated
+    int64_t last_token_us  = 0;  // Most recent token generated
+};
+
 /**
  * @brief Result of a completion job.
  */
@@ -179,11 +333,162 @@ struct CompletionResult {
     float                tps;       // Tokens per second
     float                ttft;      // Time to first token (milliseconds)
     int                  prompt_token_count; // Number of prompt tokens processed
+    int                  draft_token_count;     // Speculative drafts verified by the target model
+    int                  draft_accepted_count;  // Speculative drafts accepted by the target model
+    float                draft_acceptance_rate; // draft_accepted_count / draft_token_count (0 without drafts)
+    JobTiming            timing;                // Per-phase latency breakdown
+    double               logprob;               // Sum of the output tokens' log-probabilities (CompletionParameters::scoreOutput)
+    bool                 suspended = false;     // Stopped by suspendJob(); the output continues elsewhere
     
     /**
      * @brief Default constructor.
      */
-    CompletionResult() : tps(0.0f), ttft(0.0f), prompt_token_count(0) {}
+    CompletionResult() : tps(0.0f), ttft(0.0f), prompt_token_count(0),
+        draft_token_count(0), draft_accepted_count(0), draft_acceptance_rate(0.0f), logprob(0.0) {}
+};
+
+/**
+ * @brief Output produced by a job since the previous waitForJobOutput() call.
+ */
+struct CompletionDelta {
+    std::vector<int32_t> tokens;            // Token IDs generated since the last call
+    std::string          text;              // Text generated since the last call
+    float                tps      = 0.0f;   // Tokens per second so far
+    float                ttft     = 0.0f;   // Time to first token (milliseconds)
+    int                  prompt_token_count = 0;
+    bool                 finished = false;  // No further output will follow
+    bool                 suspended = false; // Stopped by suspendJob(); the output continues elsewhere
+    bool                 hasError = false;
+    std::string          errorMessage;
+};
+
+/**
+ * @brief Position in a job's output, advanced by getJobResultSince().
+ */
+struct JobOutputCursor {
+    size_t tokens    = 0;   // Tokens already consumed
+    size_t textBytes = 0;   // Bytes of generated text already consumed
+};
+
+/**
+ * @brief Counters of the tiered KV session cache (warm slot -> host RAM -> disk).
+ */
+struct KvCacheStats {
+    uint64_t slot_hits    = 0;  // Turns whose conversation was still in a warm slot
+    uint64_t host_hits    = 0;  // Turns restored from the host RAM tier
+    uint64_t disk_hits    = 0;  // Turns restored from the disk tier
+    uint64_t misses       = 0;  // Turns with a session key found in no tier
+    uint64_t spills       = 0;  // Conversations moved out of a slot into the tiers
+    uint64_t host_bytes   = 0;
+    uint64_t disk_bytes   = 0;
+    uint64_t host_entries = 0;
+    uint64_t disk_entries = 0;
+};
+
+/**
+ * @brief Outstanding work of an engine, used to route requests between replicas.
+ */
+struct EngineLoad {
+    int     active_jobs    = 0;  // Submitted jobs not yet finished
+    int64_t pending_tokens = 0;  // Prompt tokens still to ingest plus tokens still to generate
+    int     admit_jobs     = 0;  // Jobs the SLO controller admits, running plus queued (0 = no limit)
+};
+
+/**
+ * @brief Bucketed distribution of an engine measurement.
+ */
+struct HistogramSnapshot {
+    std::vector<double>   bounds;      // Upper bucket bounds, ascending
+    std::vector<uint64_t> counts;      // Observations per bucket (not cumulative); last one is +Inf
+    uint64_t              count = 0;
+    double                sum   = 0.0;
+};
+
+/**
+ * @brief Decode-loop counters of an engine, exported as metrics.
+ */
+struct DecodeStats {
+    uint64_t          decode_calls     = 0;  // llama_decode() calls
+    uint64_t          decode_tokens    = 0;  // Tokens submitted across those calls
+    HistogramSnapshot batch_tokens;          // Tokens per llama_decode() call
+    uint64_t          prompt_tokens    = 0;  // Prompt tokens ingested
+    uint64_t          chunk_tokens     = 0;  // Prompt tokens spliced from the document-chunk cache instead of decoded
+    uint64_t          generated_tokens = 0;  // Tokens sampled
+    uint64_t          draft_tokens     = 0;  // Speculative drafts verified by the model
+    uint64_t          draft_accepted   = 0;  // Drafts the model accepted
+    HistogramSnapshot ttft_ms;               // Time to first token
+    HistogramSnapshot tpot_ms;               // Time between consecutive generated tokens
+    uint64_t          embedding_inputs = 0;  // Inputs embedded
+    uint64_t          embedding_tokens = 0;  // Tokens of those inputs
+    uint64_t          preemptions      = 0;  // Jobs paused so a higher-priority job got their slot
+    int               swapped_jobs     = 0;  // Paused jobs whose KV waits in host RAM for a slot
+    uint64_t          swapped_bytes    = 0;  // KV state those jobs hold
+    int               slots_total      = 0;  // Sequences available to jobs
+    int               slots_in_use     = 0;  // Sequences held by running jobs
+    int64_t           kv_cells_used    = 0;  // KV cells held by all sequences at the last decode
+    int64_t           kv_cells_total   = 0;  // Context size
+    int               kv_blocks_total  = 0;  // Paged KV blocks (LoadingParameters::kv_block_tokens; 0 when off)
+    int               kv_blocks_used   = 0;  // Of which held by sequences
+    uint64_t          kv_bytes         = 0;  // KV cache buffers of the whole context
+    uint64_t          weight_bytes     = 0;  // Model tensors, memory-mapped or loaded
+
+    // SLO controller (LoadingParameters::slo_ttft_ms / slo_tpot_ms); all 0 while it is off
+    double            slo_ttft_p95_ms    = 0.0;  // p95 time to first token over its last window
+    double            slo_tpot_p95_ms    = 0.0;  // p95 time per output token over its last window
+    int               slo_prefill_tokens = 0;    // Prompt tokens a step may take while generations run
+    int               slo_max_active     = 0;    // Slots allowed to decode at once
+    int               slo_admit_jobs     = 0;    // Jobs admitted, running plus queued (0 = no limit)
+    uint64_t          slo_adjustments    = 0;    // Windows after which a setting changed
+};
+
+/**
+ * @brief What LoadingParameters::huge_pages obtained, measured from the process mappings.
+ */
+struct HugePageStats {
+    std::string requested;              // LoadingParameters::huge_pages
+    std::string weights;                // Backing of the mapped weights: hugetlbfs-2m, hugetlbfs-1g, thp or none
+    uint64_t    weight_bytes      = 0;  // Resident part of the mapped model file
+    uint64_t    weight_huge_bytes = 0;  // Of which on huge pages
+    uint64_t    buffer_bytes      = 0;  // Resident memory allocated on load: KV, compute buffers, unmapped weights
+    uint64_t    buffer_huge_bytes = 0;  // Of which on huge pages
+};
+
+/**
+ * @brief A job's share of one decode step's batch.
+ */
+struct DecodeStepJob {
+    int  job_id  = 0;
+    int  tokens  = 0;       // Tokens the job put into the batch
+    bool prefill = false;   // Prompt tokens rather than generated ones
+};
+
+/**
+ * @brief One decode-loop step, recorded when LoadingParameters::profile_steps is set
+ *        or while a step capture runs.
+ */
+struct DecodeStepSample {
+    int64_t start_us        = 0;     // Step start, microseconds since the engine was loaded
+    int     batch_tokens    = 0;     // Tokens submitted to llama_decode()
+    int     prompt_tokens   = 0;     // Of which prompt tokens
+    int     generating_jobs = 0;     // Jobs that sampled a token this step
+    int     prefill_jobs    = 0;     // Jobs that fed prompt tokens this step
+    float   schedule_ms     = 0.0f;  // Scheduling, sampling and batch assembly before the decode
+    float   decode_ms       = 0.0f;  // llama_decode() wall time
+    std::vector<DecodeStepJob> jobs; // Batch composition; only filled by step captures
+};
+
+/**
+ * @brief A LoRA adapter served on top of an engine's base model.
+ */
+struct LoraAdapterInfo {
+    std::string name;           // Selects the adapter through CompletionParameters::loraAdapter
+    std::string path;           // GGUF adapter file
+    float       scale = 1.0f;   // Adapter strength
+
+    bool operator==(const LoraAdapterInfo& other) const {
+        return name == other.name && path == other.path && scale == other.scale;
+    }
+    bool operator!=(const LoraAdapterInfo& other) const { return !(*this == other); }
 };
 
 /**
@@ -197,20 +502,88 @@ struct LoadingParameters {
     // Memory optimization
     bool use_mlock          = true;    // Lock memory pages
     bool use_mmap           = true;    // Use memory mapping
+    bool prefetch_weights   = false;   // Read the mapped GGUF into the page cache in parallel while loading
+    // Huge pages for the weights and the KV / compute buffers (Linux): off, thp (transparent huge pages),
+    // 2m or 1g (mapped weights copied into a hugetlbfs mount of that page size, THP for the buffers).
+    // Falls back to smaller pages when the kernel or the reserved pool cannot provide them
+    std::string huge_pages  = "off";
+    int  repack_cache_mb    = 0;       // CPU weights stay loaded in their repacked layout after unload, up to this many MB (0 = off)
     
     // Processing settings
     bool cont_batching      = true;    // Enable continuous batching
-    bool warmup             = false;   // Perform warmup
+    bool warmup             = false;   // Run a warmup decode before the engine reports loaded
     int  n_parallel         = 1;       // Parallel sequences
+    int  n_replicas         = 1;       // Data-parallel engine copies behind one model id (one per GPU / core set)
+    int  embedding_contexts = 1;       // Embedding / rerank engines: contexts decoding side by side, each with its share of n_threads
+    int  embedding_batch_window_us = 0; // Embedding / rerank engines: how long an idle context waits for more inputs to batch (0 = off)
+    int  n_prefix_cache     = 2;       // KV sequences kept for shared prompt prefixes (0 disables)
+    std::string prefix_cache_dir;      // Prefix cache saved here at unload and restored after load (empty = not persisted)
+    int  prefix_cache_save_seconds = 0; // Also save a changed prefix cache this often while serving (0 = only at unload)
+    int  chunk_cache_mb     = 0;       // Host RAM for document-chunk KV precomputed by precomputeChunk() (0 disables)
+    int  preempt_swap_mb    = 512;     // Host RAM for the KV of jobs paused for higher-priority ones (0 disables preemption)
+
+    // Admission control, per replica; requests beyond these limits are rejected with 503
+    int  max_queued_jobs    = 0;       // Jobs allowed to wait for a free slot (0 = unlimited)
+    int  max_queued_tokens  = 0;       // Pending prompt + generation tokens (0 = unlimited)
+
+    // Diagnostics
+    int  profile_steps      = 0;       // Decode steps kept for getStepProfile() (0 disables step profiling)
     
     // Hardware acceleration
     int  n_gpu_layers       = 100;     // Number of GPU layers
     int  split_mode         = 1;       // llama_split_mode (0=none,1=layer,2=row)
-    std::vector<float> tensor_split;   // Optional explicit tensor split fractions (size <= 128)
+    std::vector<float> tensor_split;   // Optional explicit tensor split fractions (size <= 128); planned from free VRAM when empty
     
+    // CPU threads, shared with other engines through the process-wide backend manager
+    int  n_threads          = 0;       // Decode threads (0 = one per pinned core, or up to 16)
+    std::string cpu_cores;             // Cores to pin to, e.g. "0-15,32" (empty = least used cores)
+    int  numa_node          = -1;      // Pin to this NUMA node's cores when cpu_cores is empty (-1 = any)
+
     // Batch processing
     int  n_batch            = 2048;    // Batch size
     int  n_ubatch           = 512;     // Micro-batch size
+
+    // KV cache element types: f32, f16, bf16, q8_0, q5_1, q5_0, q4_1, q4_0 or auto.
+    // Quantized V caches need flash attention; auto means f16 unless fit_vram quantizes it
+    std::string cache_type_k = "f16";
+    std::string cache_type_v = "f16";
+    bool fit_vram           = false;   // Shrink n_ctx / n_gpu_layers (and quantize auto caches) to fit free VRAM
+    // Expert FFN tensors of mixture-of-experts models kept in host memory while attention and
+    // shared weights stay on the GPU: off, all, or auto (as many layers' experts as fit stay on the GPU)
+    std::string moe_offload = "off";
+
+    // Load-time tuning: benchmark thread counts and batch sizes on this host and use the fastest.
+    // Results are cached per model file and hardware, so only the first load pays for it
+    bool autotune           = false;
+    std::string autotune_cache;        // Cache file (empty = <temp>/kolosal-autotune.json)
+
+    // Chunked prefill
+    int   n_step_tokens     = 0;       // Token budget per decode step, prompt and generation combined (0 = n_batch)
+    float prefill_share     = 0.5f;    // Max share of a step prompt ingestion may take while generations are running
+
+    // Latency targets for the p95 of generative requests. When set, a feedback controller tunes the
+    // prompt tokens per step, the sequences decoding at once and the jobs admitted at runtime
+    float slo_ttft_ms       = 0.0f;    // Time to first token (0 = no target)
+    float slo_tpot_ms       = 0.0f;    // Time per output token (0 = no target)
+
+    // Paged KV: sequences take the shared cache in blocks as they grow instead of sharing it first
+    // come, first served, and jobs wait for a slot until the blocks of their prompt are free
+    int  kv_block_tokens    = 0;       // Block size in tokens (0 = off)
+    int  max_seq_ctx        = 0;       // Context one sequence may grow to before it is shifted (0 = n_ctx)
+
+    // Speculative decoding
+    std::string draft_model_path;      // Optional small draft model sharing the target's vocabulary
+    int  n_draft            = 8;       // Max draft tokens verified per target forward pass
+    bool prompt_lookup      = false;   // Draft from n-gram matches in the prompt and output, no draft model needed
+
+    // Tiered session cache: conversations evicted from warm slots spill to host RAM, then disk
+    int  kv_host_cache_mb   = 512;     // Host RAM budget for spilled sessions (0 disables the tier)
+    int  kv_disk_cache_mb   = 0;       // Disk budget for spilled sessions (0 disables the tier)
+    std::string kv_disk_cache_dir;     // Spill directory (empty = <temp>/kolosal-kv)
+
+    // Multi-LoRA serving: adapters requests pick by name, loaded on first use
+    std::vector<LoraAdapterInfo> lora_adapters;
+    int  lora_max_loaded    = 0;       // Adapters kept in memory at once, least recently used freed first (0 = all)
 };
 
 // =============================================================================
@@ -257,6 +630,18 @@ public:
                                    const LoadingParameters lParams, 
                                    const int mainGpuId = -1) = 0;
 
+    /**
+     * @brief Loads a cross-encoder reranker model (rank pooling) from a GGUF file.
+     * @param modelPath Path to the GGUF reranker model file
+     * @param lParams Loading parameters configuration
+     * @param mainGpuId Primary GPU ID (-1 for auto-select)
+     * @return true if the reranker loaded successfully, false otherwise
+     * @note The model runs on the embedding service; use rerank() to score documents.
+     */
+    virtual bool loadRerankModel(const char* modelPath, 
+                                const LoadingParameters lParams, 
+                                const int mainGpuId = -1) = 0;
+
     /**
      * @brief Unloads the currently loaded model.
      * @return true if model unloaded successfully, false otherwise
@@ -278,6 +663,27 @@ public:
      */
     virtual int submitChatCompletionsJob(const ChatCompletionParameters& params) = 0;
 
+    /**
+     * @brief Submits n candidate completions of the same prompt.
+     * @param params Completion parameters; candidate i samples with randomSeed + i
+     * @param n Number of candidates
+     * @return One job ID per candidate, in order (empty if submission failed)
+     * @note The prompt is decoded once: the other candidates copy the first one's KV
+     *       cells and then generate in the same decode batches. Only the first candidate
+     *       keeps kvCacheFilePath / sessionKey. Candidates that cannot share the prefill
+     *       (no free slot in time, or a KV cache that is not unified) decode it themselves.
+     */
+    virtual std::vector<int> submitCompletionsJobs(const CompletionParameters& params, int n) = 0;
+
+    /**
+     * @brief Submits n candidate chat completions of the same conversation.
+     * @param params Chat completion parameters; candidate i samples with randomSeed + i
+     * @param n Number of candidates
+     * @return One job ID per candidate, in order (empty if submission failed)
+     * @note Shares one prompt prefill the same way as submitCompletionsJobs().
+     */
+    virtual std::vector<int> submitChatCompletionsJobs(const ChatCompletionParameters& params, int n) = 0;
+
     /**
      * @brief Submits an embedding job.
      * @param params Embedding parameters
@@ -285,6 +691,59 @@ public:
      */
     virtual int submitEmbeddingJob(const EmbeddingParameters& params) = 0;
 
+    /**
+     * @brief Embeds several inputs together and blocks until all are done.
+     * @param params One set of embedding parameters per input
+     * @return One result per input, in the same order; failed inputs have hasError set
+     * @note Inputs are packed into shared decode batches (one sequence per input),
+     *       so this is much cheaper than submitting and waiting on each input separately.
+     */
+    virtual std::vector<EmbeddingResult> submitEmbeddingBatch(const std::vector<EmbeddingParameters>& params) = 0;
+
+    /**
+     * @brief Scores documents against a query with a reranker model and blocks until done.
+     * @param query Query text
+     * @param documents Documents to score
+     * @param topK Number of best documents to return (<= 0 returns all)
+     * @return The topK best documents, most relevant first
+     * @throws std::runtime_error if the model is not a reranker or a pair fails to score
+     * @note Every query-document pair is one input of a submitEmbeddingBatch() batch; only
+     *       the topK best are sorted.
+     */
+    virtual std::vector<RerankResult> rerank(const std::string& query, const std::vector<std::string>& documents, int topK = -1) = 0;
+
+    /**
+     * @brief Scores continuations after their prompts with a language model and blocks until done.
+     * @param requests Prompt-continuation pairs
+     * @param topLogprobs Likeliest alternatives to return for each continuation token (0 for none)
+     * @return One result per request, in order
+     * @throws std::runtime_error if the model cannot score, a pair does not fit the context or fails to decode
+     * @note Nothing is sampled: each pair is decoded once, its prompt and continuation together,
+     *       with logits kept only at the continuation's positions. Pairs are decoded side by side
+     *       in the free slots, between the running jobs' decode steps.
+     */
+    virtual std::vector<ScoringResult> score(const std::vector<ScoringRequest>& requests, int topLogprobs = 0) = 0;
+
+    /**
+     * @brief Tokenizes text with the loaded model's vocabulary.
+     * @param text Text to tokenize
+     * @param addSpecial Add BOS/EOS the way a prompt would get them
+     * @return Token ids (empty when no model is loaded)
+     * @note Runs on the calling thread against the vocabulary alone, so it needs no
+     *       decode slot and never queues behind running jobs.
+     */
+    virtual std::vector<int32_t> tokenize(const std::string& text, bool addSpecial = true) = 0;
+
+    /**
+     * @brief Counts the tokens of several texts.
+     * @param texts Texts to count
+     * @param addSpecial Count BOS/EOS the way a prompt would get them
+     * @return One count per text, in order; -1 for every text when no model is loaded
+     * @note Counts are cached by text hash, so budgeting the same chunks or prompts
+     *       repeatedly costs a lookup after the first call.
+     */
+    virtual std::vector<int> countTokens(const std::vector<std::string>& texts, bool addSpecial = true) = 0;
+
     // Job control
     /**
      * @brief Stops a running job.
@@ -292,11 +751,22 @@ public:
      */
     virtual void stopJob(int job_id) = 0;
 
+    /**
+     * @brief Stops a running job so another engine can continue it.
+     * @param job_id ID of the job to suspend
+     * @note The job finishes with CompletionResult::suspended set. One that was generating
+     *       keeps the KV state of its prompt and output for getJobKvState(); submitting that
+     *       with resumeFromKvState continues the output on an engine of the same model.
+     */
+    virtual void suspendJob(int job_id) = 0;
+
     /**
      * @brief Waits for a job to complete.
      * @param job_id ID of the job to wait for
+     * @param timeoutMs Maximum time to wait in milliseconds (-1 waits until it finishes)
+     * @return true if the job has finished (or is unknown), false on timeout
      */
-    virtual void waitForJob(int job_id) = 0;
+    virtual bool waitForJob(int job_id, int timeoutMs = -1) = 0;
 
     // Job status and results
     /**
@@ -314,6 +784,27 @@ public:
      */
     virtual CompletionResult getJobResult(int job_id) = 0;
 
+    /**
+     * @brief Blocks until a job produces new output, finishes, or the timeout expires.
+     * @param job_id ID of the job
+     * @param delta Receives only the tokens/text generated since the previous call
+     * @param timeoutMs Maximum time to wait in milliseconds (-1 waits indefinitely)
+     * @return false if the job ID is unknown, true otherwise (delta may be empty on timeout)
+     * @note Output is handed out exactly once, so each job should have a single consumer.
+     *       This replaces polling getJobResult(), which copies the whole result every time.
+     */
+    virtual bool waitForJobOutput(int job_id, CompletionDelta& delta, int timeoutMs = -1) = 0;
+
+    /**
+     * @brief Retrieves only the output appended after a caller-held cursor.
+     * @param job_id ID of the job
+     * @param cursor Position already consumed; advanced past the returned output
+     * @return Delta with the new tokens/text (finished is set once the job is done)
+     * @note Non-blocking and safe for any number of readers, each with its own cursor.
+     *       Cost is proportional to the new output rather than the whole result.
+     */
+    virtual CompletionDelta getJobResultSince(int job_id, JobOutputCursor& cursor) = 0;
+
     /**
      * @brief Retrieves the embedding result of a job.
      * @param job_id ID of the job
@@ -335,11 +826,110 @@ public:
      * @param job_id ID of the job
      * @return Error message string (empty if no error)
      */
-    virtual std::string getJobError(int job_id) = 0;    /**
+    virtual std::string getJobError(int job_id) = 0;
+
+    /**
+     * @brief Takes the KV state a finished prefillOnly or suspended job left behind.
+     * @param job_id ID of the job
+     * @return The state, or nullptr if the job is unknown, failed or was neither prefillOnly nor suspended
+     * @note The state can be taken once; it is dropped when the job is released.
+     */
+    virtual std::shared_ptr<const KvSequenceState> getJobKvState(int job_id) = 0;
+
+    /**
      * @brief Checks if there are any active jobs currently running.
      * @return True if there are active jobs, false otherwise
      */
     virtual bool hasActiveJobs() = 0;
+
+    /**
+     * @brief Releases a job once its result has been consumed.
+     * @param job_id ID of the job; later lookups with this ID fail
+     * @note A job that is still running is cancelled. Finished jobs that are never
+     *       released are reclaimed automatically a few minutes after they finish.
+     */
+    virtual void releaseJob(int job_id) = 0;
+
+    /**
+     * @brief Number of jobs currently held by the engine.
+     * @return Running jobs plus finished jobs not yet released or reclaimed
+     */
+    virtual size_t liveJobCount() = 0;
+
+    /**
+     * @brief Snapshot of the engine's outstanding work.
+     * @return Active jobs and the tokens they still have to process
+     */
+    virtual EngineLoad getLoad() = 0;
+
+    /**
+     * @brief Counters and sizes of the tiered KV session cache.
+     * @return Hit/miss counters and per-tier usage (all zero when there is no cache)
+     */
+    virtual KvCacheStats getKvCacheStats() = 0;
+
+    /**
+     * @brief Huge pages requested for the weights and buffers, and how much of them is backed by huge pages.
+     * @return Measured now, so pages khugepaged collapsed after the load are included
+     */
+    virtual HugePageStats getHugePageStats() = 0;
+
+    /**
+     * @brief Takes every conversation's KV out of the engine: warm slots and the session tiers.
+     * @return Session key and state of each conversation; the engine no longer holds them
+     * @note Used to move a draining node's conversations to another node.
+     */
+    virtual std::vector<std::pair<std::string, std::shared_ptr<const KvSequenceState>>> exportSessions() = 0;
+
+    /**
+     * @brief Adopts a conversation exported by an engine of the same model.
+     * @param key Session key the conversation's next turn will use
+     * @param state Its KV state
+     * @return false if there is no free slot nor session tier to keep it in
+     */
+    virtual bool importSession(const std::string& key, std::shared_ptr<const KvSequenceState> state) = 0;
+
+    /**
+     * @brief Decodes a document chunk on its own and keeps its KV for prompts that quote it.
+     * @param text Chunk text, as it will appear in prompts
+     * @return false if the chunk cache is off (LoadingParameters::chunk_cache_mb) or the chunk
+     *         is too short or too long to cache
+     * @note A prompt containing the chunk's tokens gets its cells spliced in at their position
+     *       instead of prefilling them. The chunk attended only to itself, so the output can
+     *       differ slightly from a full prefill.
+     */
+    virtual bool precomputeChunk(const std::string& text) = 0;
+
+    /**
+     * @brief Counters and distributions of the decode loop.
+     * @return Batch, latency, slot and KV usage figures (all zero before a model is loaded)
+     */
+    virtual DecodeStats getDecodeStats() = 0;
+
+    /**
+     * @brief Most recent decode steps, oldest first.
+     * @return Up to LoadingParameters::profile_steps samples (empty when step profiling is off)
+     */
+    virtual std::vector<DecodeStepSample> getStepProfile() = 0;
+
+    /**
+     * @brief Start recording every decode step with its batch composition, whatever
+     *        profile_steps is. Restarts a capture already running.
+     * @param maxSteps Steps kept; the capture stops growing beyond them
+     */
+    virtual void beginStepCapture(size_t maxSteps) = 0;
+
+    /**
+     * @brief End the capture started by beginStepCapture().
+     * @return The captured steps, oldest first (empty if none ran or no model is loaded)
+     */
+    virtual std::vector<DecodeStepSample> endStepCapture() = 0;
+
+    /**
+     * @brief Progress of a loadModel() / loadEmbeddingModel() call in flight.
+     * @return 0..1 across weight prefetch, weight loading and warmup; 1 once loaded
+     */
+    virtual float getLoadProgress() = 0;
 };
 
 // =============================================================================
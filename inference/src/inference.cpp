@@ -2,6 +2,8 @@
 #include <stdexcept>
 #include <iostream>
 #include <queue>
+#include <deque>
+#include <list>
 #include <set>
 #include <cstdint>
 #include <thread>
@@ -10,17 +12,34 @@
 #include <type_traits>
 #include <fstream>
 #include <cstring>
+#include <cerrno>
+#include <cctype>
 #include <chrono>
 #include <map>
 #include <sstream>
 #include <iomanip>
 #include <algorithm>
+#include <cmath>
 #include <initializer_list>
+#include <shared_mutex>
+#include <array>
+#include <unordered_map>
+#include <unordered_set>
+#include <limits>
+#include <mutex>
+#ifdef __linux__
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/vfs.h>
+#endif
 #ifdef USE_VULKAN
 #include <vulkan/vulkan.h>
 #endif
 
 #include "llama.h"
+#include "gguf.h"
 #include "common.h"
 #include "sampling.h"
 #include "inference.h"
@@ -28,6 +47,10 @@
 #include <nlohmann/json.hpp>
 #include "json-schema-to-grammar.h"
 
+#ifdef INFERENCE_USE_ZLIB
+#include <zlib.h>
+#endif
+
 // Avoid Windows macro conflicts with std::min/std::max
 #ifdef max
 #undef max
@@ -204,6 +227,12 @@ bool CompletionParameters::isValid() const
 		return false;
 	}
 
+	if (maxContext < 0)
+	{
+		std::cerr << "[INFERENCE] [ERROR] maxContext is negative: " << maxContext << std::endl;
+		return false;
+	}
+
 	if (temperature < 0.0f)
 	{
 		std::cerr << "[INFERENCE] [ERROR] temperature is negative: " << temperature << std::endl;
@@ -270,6 +299,12 @@ bool ChatCompletionParameters::isValid() const
 		return false;
 	}
 
+	if (maxContext < 0)
+	{
+		std::cerr << "[INFERENCE] [ERROR] maxContext is negative: " << maxContext << std::endl;
+		return false;
+	}
+
 	if (temperature < 0.0f)
 	{
 		std::cerr << "[INFERENCE] [ERROR] temperature is negative: " << temperature << std::endl;
@@ -342,902 +377,4283 @@ bool EmbeddingParameters::isValid() const
 	return true;
 }
 
-// Anonymous namespace to encapsulate internal classes
-namespace
+StopSequenceMatcher::StopSequenceMatcher(const std::vector<std::string>& stops)
 {
-	// Manages KV sequence IDs (slots) for llama context
-	class SlotManager {
-	public:
-		SlotManager(llama_context * ctx, int n_parallel)
-			: ctx(ctx), max_slots(n_parallel) {
-			for (int i = 0; i < max_slots; ++i) free_slots.push(i);
+	nodes_.emplace_back();
+	for (const auto& stop : stops)
+	{
+		if (stop.empty()) continue;
+		int node = 0;
+		for (unsigned char c : stop)
+		{
+			auto& next = nodes_[node].next;
+			auto it = std::find_if(next.begin(), next.end(), [c](const auto& edge) { return edge.first == c; });
+			if (it != next.end())
+			{
+				node = it->second;
+				continue;
+			}
+			const int child = static_cast<int>(nodes_.size());
+			next.emplace_back(c, child);
+			nodes_.emplace_back();
+			nodes_[child].depth = nodes_[node].depth + 1;
+			node = child;
 		}
-		int allocate() {
-			std::unique_lock<std::mutex> lock(mtx);
-			cv.wait(lock, [&]{ return !free_slots.empty() || terminated; });
-			if (terminated) return -1;
-			int id = free_slots.front(); free_slots.pop(); in_use.insert(id); return id;
+		nodes_[node].match = stop.size();
+	}
+
+	// Breadth-first, so every failure link points at an already finished node
+	std::deque<int> queue;
+	for (const auto& edge : nodes_[0].next) queue.push_back(edge.second);
+	while (!queue.empty())
+	{
+		const int node = queue.front();
+		queue.pop_front();
+		for (const auto& [c, child] : nodes_[node].next)
+		{
+			nodes_[child].fail = node == 0 ? 0 : step(nodes_[node].fail, c);
+			nodes_[child].match = std::max(nodes_[child].match, nodes_[nodes_[child].fail].match);
+			queue.push_back(child);
 		}
-		void release(int id) {
-			if (id < 0) return;
-			if (ctx) {
-				// remove all KV entries for this sequence id
-				auto * mem = llama_get_memory(ctx);
-				// use range [0, -1) to ensure full wipe across backends (CUDA may no-op on [-1, -1])
-				llama_memory_seq_rm(mem, id, /*p0=*/0, /*p1=*/-1);
-			}
-			std::lock_guard<std::mutex> lock(mtx);
-			if (in_use.erase(id)) { free_slots.push(id); cv.notify_one(); }
+	}
+}
+
+int StopSequenceMatcher::step(int state, unsigned char c) const
+{
+	for (;;)
+	{
+		for (const auto& edge : nodes_[state].next)
+		{
+			if (edge.first == c) return edge.second;
 		}
-		void shutdown() { std::lock_guard<std::mutex> lock(mtx); terminated = true; cv.notify_all(); }
-		int capacity() const { return max_slots; }
-	private:
-		llama_context * ctx;
-		int max_slots;
-		std::queue<int> free_slots;
-		std::set<int>   in_use;
-		std::mutex mtx; std::condition_variable cv; bool terminated=false;
-	};
+		if (state == 0) return 0;
+		state = nodes_[state].fail;
+	}
+}
 
-	static void llama_log_callback_null(ggml_log_level level, const char* text, void* user_data)
+size_t StopSequenceMatcher::feed(const std::string& piece)
+{
+	if (empty()) return std::string::npos;
+	for (size_t i = 0; i < piece.size(); ++i)
 	{
-		(void)level;
-		(void)text;
-		(void)user_data;
+		state_ = step(state_, static_cast<unsigned char>(piece[i]));
+		if (nodes_[state_].match > 0)
+		{
+			return (piece.size() - i - 1) + nodes_[state_].match;
+		}
 	}
+	return std::string::npos;
+}
 
-	class Tokenizer
+std::vector<llama_token> lookupNgramDraft(const std::vector<llama_token>& tokens, int min_ngram, int max_ngram, int n_max)
+{
+	std::vector<llama_token> draft;
+	const int size = static_cast<int>(tokens.size());
+	if (n_max <= 0 || min_ngram <= 0) return draft;
+
+	for (int n = std::min(max_ngram, size - 1); n >= min_ngram; --n)
 	{
+		const llama_token * suffix = tokens.data() + size - n;
+		// newest occurrence first: recent context predicts the continuation best
+		for (int i = size - n - 1; i >= 0; --i)
+		{
+			if (tokens[i + n - 1] != suffix[n - 1] || !std::equal(suffix, suffix + n - 1, tokens.begin() + i))
+			{
+				continue;
+			}
+			const int end = std::min(size, i + n + n_max);
+			draft.assign(tokens.begin() + i + n, tokens.begin() + end);
+			return draft;
+		}
+	}
+	return draft;
+}
+
+void Job::recycle()
+{
+	std::lock_guard<std::mutex> lock(mtx);
+	if (smpl) {
+		common_sampler_free(smpl);
+		smpl = nullptr;
+	}
+	samplerKey.clear();
+
+	generatedTokens.clear();
+	generatedText.clear();
+	embedding.clear();
+	outputSubscribed = false;
+	pendingTokens.clear();
+	pendingText.clear();
+	stopMatcher = StopSequenceMatcher();
+	publishedTextBytes = 0;
+	logprob = 0.0;
+	forkFrom.reset();
+	forkFromId = -1;
+	embedding_token_count = 0;
+
+	isFinished = false;
+	hasError = false;
+	suspended = false;
+	errorMessage.clear();
+	tps = 0.0f;
+	tts = 0.0f;
+	ttft = 0.0f;
+	start_time = {};
+	first_token_time = {};
+	last_token_time = {};
+	timing = JobTiming();
+	deadline = std::chrono::steady_clock::time_point::max();
+	reclaim_at = {};
+	first_token_generated = false;
+	cancelRequested.store(false);
+	suspendRequested.store(false);
+	session_load_attempted.store(false);
+	params = CompletionParameters();
+	params_embedding = EmbeddingParameters();
+
+	isDecodingPrompt = true;
+	isPromptPrepared = false;
+	isContextShifted = false;
+	n_past = 0;
+	n_remain = 0;
+	i_prompt = 0;
+	n_prompt = 0;
+	batch_pos = 0;
+	n_matching_session_tokens = 0;
+	promptCutTokens = 0;
+
+	session_tokens.clear();
+	embd_inp.clear();
+	prompt_tokens.clear();
+	warm_tokens.clear();
+	path_session.clear();
+	evicted_key.clear();
+	evicted_tokens.clear();
+	session_snapshot.reset();
+	kv_export.reset();
+	swapped.reset();
+	chunkSplices.clear();
+
+	draft.clear();
+	draftIdxs.clear();
+	draftKvTokens.clear();
+	draftKvSynced = false;
+	draftTokenCount = 0;
+	draftAcceptedCount = 0;
+	drafts = false;
+	promptLookup = false;
+
+	logitTokens.clear();
+	logitsStep = 0;
+}
+
+// Anonymous namespace to encapsulate internal classes
+namespace
+{
+	// Process-wide owner of the ggml backend and of the CPU threadpools the engines decode on.
+	// Every engine leases a pool pinned to its own cores: without a core list it gets the cores
+	// the fewest other pools are pinned to, so an LLM, an embedding model and a reranker loaded
+	// side by side split the machine instead of each running a full set of threads on every core.
+	class BackendManager {
 	public:
-		// New constructor takes shared pointers to model and context
-		Tokenizer(llama_model* shared_model, llama_context* shared_context, common_params& params);
-		~Tokenizer();
+		static BackendManager& instance()
+		{
+			static BackendManager manager;
+			return manager;
+		}
 
-		std::vector<int32_t>	tokenize(const std::string& text, bool add_bos = true);
-		std::string				detokenize(const std::vector<int32_t>& tokens);
-		std::string				decode(const int32_t& token);
-		std::string				applyTemplate(std::vector<common_chat_msg>& messages);
+		// The backend is initialized by the first engine and freed with the last one
+		void acquireBackend(ggml_numa_strategy numa)
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			if (backend_refs++ == 0) {
+				llama_backend_init();
+				llama_numa_init(numa);
+			}
+		}
 
-		const	llama_vocab		*getVocab()		const { return vocab; }
-				llama_model		*getModel()		const { return tokenizer_model; }
-				llama_context	*getContext()	const { return tokenizer_context; }
+		void releaseBackend()
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			if (backend_refs > 0 && --backend_refs == 0) {
+				llama_backend_free();
+			}
+		}
 
-		bool shouldAddBos() const { return add_bos; }
+		// `cores` pins the pool to exactly those cores; when empty the least-leased cores are chosen
+		ggml_threadpool* acquireThreadpool(int n_threads, std::vector<int> cores)
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			const int n_cores = std::max(1u, std::thread::hardware_concurrency());
+			if (cores.empty()) {
+				std::vector<int> order(n_cores);
+				for (int i = 0; i < n_cores; ++i) order[i] = i;
+				std::stable_sort(order.begin(), order.end(), [this](int a, int b) { return leasesOn(a) < leasesOn(b); });
+				order.resize(std::min(n_threads, n_cores));
+				std::sort(order.begin(), order.end());
+				cores = std::move(order);
+			}
+
+			ggml_threadpool_params tpp;
+			ggml_threadpool_params_init(&tpp, n_threads);
+			tpp.prio = GGML_SCHED_PRIO_NORMAL;
+			for (int core : cores) {
+				if (core >= 0 && core < GGML_MAX_N_THREADS) tpp.cpumask[core] = true;
+			}
+			ggml_threadpool* pool = ggml_threadpool_new(&tpp);
+			if (pool) {
+				for (int core : cores) ++core_leases[core];
+				pools[pool] = std::move(cores);
+			}
+			return pool;
+		}
+
+		void releaseThreadpool(ggml_threadpool* pool)
+		{
+			if (!pool) return;
+			{
+				std::lock_guard<std::mutex> lock(mtx);
+				auto it = pools.find(pool);
+				if (it != pools.end()) {
+					for (int core : it->second) {
+						if (--core_leases[core] == 0) core_leases.erase(core);
+					}
+					pools.erase(it);
+				}
+			}
+			ggml_threadpool_free(pool);
+		}
 
 	private:
-		const	llama_vocab		*vocab;
-				llama_model		*tokenizer_model;
-				llama_context	*tokenizer_context;
+		BackendManager() = default;
 
-		common_chat_templates_ptr chat_templates;
-		bool					  add_bos;
+		int leasesOn(int core) const
+		{
+			auto it = core_leases.find(core);
+			return it == core_leases.end() ? 0 : it->second;
+		}
+
+		std::mutex												mtx;
+		int														backend_refs = 0;
+		std::unordered_map<int, int>							core_leases;
+		std::unordered_map<ggml_threadpool*, std::vector<int>>	pools;
 	};
 
-	Tokenizer::Tokenizer(llama_model* shared_model, llama_context* shared_context, common_params& params)
-		: tokenizer_model(shared_model)
-		, tokenizer_context(shared_context)
-		, add_bos(false)
+	// Huge pages for the weights and llama.cpp's KV / compute buffers. llama.cpp allocates those
+	// itself, so they are found afterwards in /proc/self/maps: the model file's mapping, and the
+	// anonymous regions that appeared while the model and its context were created
+	struct AddressRange {
+		uintptr_t	start	= 0;
+		uintptr_t	end		= 0;
+	};
+
+	struct MappedRegion {
+		AddressRange	range;
+		bool			writable	= false;
+		std::string		path;			// Empty for anonymous memory
+	};
+
+	constexpr uintptr_t kHugePageSize = 2ull << 20;
+	// Anonymous regions below this are thread stacks and allocator arenas, not tensor buffers
+	constexpr uintptr_t kMinBufferRegion = 16ull << 20;
+
+	std::vector<MappedRegion> readMappings()
 	{
-#ifdef DEBUG
-		std::cout << "[INFERENCE] Initializing Tokenizer with shared model and context." << std::endl;
+		std::vector<MappedRegion> regions;
+#ifdef __linux__
+		std::ifstream maps("/proc/self/maps");
+		std::string line;
+		while (std::getline(maps, line)) {
+			// "7f2c4a000000-7f2c4c000000 rw-p 00000000 00:00 0    /path/of/file"
+			std::istringstream in(line);
+			std::string range, perms, offset, device, inode, path;
+			in >> range >> perms >> offset >> device >> inode;
+			std::getline(in >> std::ws, path);
+			const size_t dash = range.find('-');
+			if (dash == std::string::npos || perms.size() < 2) continue;
+			MappedRegion region;
+			region.range.start	= static_cast<uintptr_t>(std::stoull(range.substr(0, dash), nullptr, 16));
+			region.range.end	= static_cast<uintptr_t>(std::stoull(range.substr(dash + 1), nullptr, 16));
+			region.writable		= perms[1] == 'w';
+			region.path			= std::move(path);
+			regions.push_back(std::move(region));
+		}
 #endif
-		vocab = llama_model_get_vocab(tokenizer_model);
-		add_bos = llama_vocab_get_add_bos(vocab);
+		return regions;
+	}
 
-		chat_templates = common_chat_templates_init(tokenizer_model, params.chat_template);
-		try {
-			const std::map<std::string, std::string> empty_kwargs{};
-			common_chat_format_example(chat_templates.get(), params.use_jinja, empty_kwargs);
+	// Writable anonymous memory in `after` that was not mapped in `before`, in large regions only
+	std::vector<AddressRange> newBufferRanges(const std::vector<MappedRegion>& before, const std::vector<MappedRegion>& after)
+	{
+		std::vector<AddressRange> old;
+		for (const auto& region : before) {
+			if (region.path.empty()) old.push_back(region.range);
 		}
-		catch (const std::exception& e) {
-			std::cerr << "[INFERENCE] [ERROR] Failed to format chat templates: " << e.what() << std::endl;
-			chat_templates = common_chat_templates_init(tokenizer_model, "chatml");
+
+		std::vector<AddressRange> ranges;
+		for (const auto& region : after) {
+			if (!region.path.empty() || !region.writable) continue;
+			// Regions grown into a neighbouring one are merged by the kernel; keep only the new part
+			std::vector<AddressRange> pieces{ region.range };
+			for (const auto& taken : old) {
+				std::vector<AddressRange> rest;
+				for (const auto& piece : pieces) {
+					if (taken.end <= piece.start || taken.start >= piece.end) {
+						rest.push_back(piece);
+						continue;
+					}
+					if (piece.start < taken.start) rest.push_back({ piece.start, taken.start });
+					if (taken.end < piece.end) rest.push_back({ taken.end, piece.end });
+				}
+				pieces = std::move(rest);
+			}
+			for (const auto& piece : pieces) {
+				if (piece.end - piece.start >= kMinBufferRegion) ranges.push_back(piece);
+			}
 		}
+		return ranges;
 	}
 
-	Tokenizer::~Tokenizer()
+	// Whether the kernel hands out transparent huge pages on request (enabled: always or madvise)
+	bool transparentHugePagesAvailable()
 	{
+#ifdef __linux__
+		std::ifstream enabled("/sys/kernel/mm/transparent_hugepage/enabled");
+		std::string modes;
+		return std::getline(enabled, modes) && modes.find("[never]") == std::string::npos;
+#else
+		return false;
+#endif
 	}
 
-	std::vector<int32_t> Tokenizer::tokenize(const std::string& text, bool /*add_bos_token*/)
+	// Asks for THP on the 2 MiB aligned part of a range and collapses the pages already faulted in,
+	// which llama.cpp has done for the KV cache by clearing it. MADV_COLLAPSE needs Linux 6.1; on
+	// older kernels khugepaged collapses the range in the background instead
+	void adviseHugePages(const AddressRange& range)
 	{
-		std::vector<llama_token> tokens = common_tokenize(tokenizer_context, text.c_str(), true, true);
-		return std::vector<int32_t>(tokens.begin(), tokens.end());
+#ifdef __linux__
+		const uintptr_t start	= (range.start + kHugePageSize - 1) & ~(kHugePageSize - 1);
+		const uintptr_t end		= range.end & ~(kHugePageSize - 1);
+		if (end <= start) return;
+		void* addr = reinterpret_cast<void*>(start);
+		if (::madvise(addr, end - start, MADV_HUGEPAGE) != 0) return;
+#ifndef MADV_COLLAPSE
+		constexpr int MADV_COLLAPSE = 25;
+#endif
+		::madvise(addr, end - start, MADV_COLLAPSE);
+#else
+		(void)range;
+#endif
 	}
 
-	std::string Tokenizer::detokenize(const std::vector<int32_t>& tokens)
+	// Mount point of a writable hugetlbfs whose pages are `pageSize` bytes; empty when there is none
+	std::string hugetlbfsMount(uint64_t pageSize)
 	{
-		std::ostringstream tokensStream;
-		for (const auto& token : tokens)
-		{
-			tokensStream << decode(token);
+#ifdef __linux__
+		std::ifstream mounts("/proc/mounts");
+		std::string line;
+		while (std::getline(mounts, line)) {
+			std::istringstream in(line);
+			std::string device, dir, type;
+			in >> device >> dir >> type;
+			if (type != "hugetlbfs") continue;
+			struct statfs info {};
+			if (::statfs(dir.c_str(), &info) == 0 && static_cast<uint64_t>(info.f_bsize) == pageSize
+				&& ::access(dir.c_str(), W_OK) == 0) {
+				return dir;
+			}
 		}
-		return tokensStream.str();
-	}
-
-	std::string Tokenizer::decode(const int32_t& token)
-	{
-		return common_token_to_piece(tokenizer_context, token);
+#else
+		(void)pageSize;
+#endif
+		return {};
 	}
 
-	std::string Tokenizer::applyTemplate(std::vector<common_chat_msg>& messages)
+	// Copies a GGUF into hugetlbfs so that mapping it is backed by explicit huge pages. hugetlbfs
+	// has no write(), so the copy is filled through a mapping, and its pages are reserved first
+	// so that a pool too small fails here instead of raising SIGBUS on a later page fault.
+	// Returns the copy's path, or empty with `error` set
+	std::string copyToHugetlbfs(const std::filesystem::path& source, const std::string& mount, uint64_t pageSize,
+		std::string& error)
 	{
-		common_chat_templates_inputs inputs;
-		inputs.messages = messages;
+#ifdef __linux__
+		std::error_code ec;
+		const uint64_t size = std::filesystem::file_size(source, ec);
+		if (ec || size == 0) {
+			error = "cannot read the size of " + source.string();
+			return {};
+		}
+		const uint64_t length = (size + pageSize - 1) / pageSize * pageSize;
+
+		static std::atomic<uint64_t> copies{ 0 };
+		const std::string path = mount + "/kolosal-" + std::to_string(::getpid()) + "-" + std::to_string(copies++) + ".gguf";
+		const int fd = ::open(path.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+		if (fd < 0) {
+			error = "cannot create " + path + ": " + std::strerror(errno);
+			return {};
+		}
+		auto fail = [&](const std::string& what) {
+			error = what + ": " + std::strerror(errno);
+			::close(fd);
+			::unlink(path.c_str());
+			return std::string();
+		};
+		if (::fallocate(fd, 0, 0, static_cast<off_t>(length)) != 0) {
+			return fail("cannot reserve " + std::to_string(length >> 20) + " MiB of huge pages");
+		}
+		void* data = ::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if (data == MAP_FAILED) {
+			return fail("cannot map " + path);
+		}
 
-		return common_chat_templates_apply(chat_templates.get(), inputs).prompt;
+		constexpr uint64_t kChunk = 64ull << 20;
+		std::ifstream in(source, std::ios::binary);
+		uint64_t copied = 0;
+		while (in && copied < size) {
+			in.read(static_cast<char*>(data) + copied, static_cast<std::streamsize>(std::min(kChunk, size - copied)));
+			copied += static_cast<uint64_t>(in.gcount());
+		}
+		::munmap(data, length);
+		if (copied != size) {
+			return fail("cannot read " + source.string());
+		}
+		::close(fd);
+		return path;
+#else
+		(void)source; (void)mount; (void)pageSize;
+		error = "hugetlbfs is only available on Linux";
+		return {};
+#endif
 	}
 
-	// InferenceService Interface (Internal Use Only)
-	class InferenceService
-	{
-	public:
-		virtual ~InferenceService() {}
-		virtual void start() = 0;
-		virtual void stop() = 0;
-		virtual void submitJob(const CompletionParameters &params, std::shared_ptr<Job> job) = 0;
-		virtual void complete(const CompletionParameters &params, std::shared_ptr<Job> job) = 0;
-		virtual void embed(const EmbeddingParameters &params, std::shared_ptr<Job> job) = 0;
-		virtual CompletionParameters formatChat(const ChatCompletionParameters &params) = 0;
+	struct HugePageUsage {
+		uint64_t bytes	= 0;	// Resident
+		uint64_t huge	= 0;	// Of which on huge pages
 	};
-	// LlamaInferenceService (CPU Implementation)
-	class LlamaInferenceService : public InferenceService
-	{
-	private:
-		// Data members moved before constructor to satisfy MSVC name lookup in mem-initializers
-		std::shared_ptr<Tokenizer>			tokenizer;
-		struct llama_model*					model;
-		struct llama_context*				context;
-		std::mutex							mtx;
-		std::condition_variable				cv;
-		common_params						g_params;
-		ggml_threadpool*					threadpool;
-		llama_batch							batch;
-		std::vector<std::shared_ptr<Job>>	jobs;
-		std::atomic<bool>					should_terminate{ false };
-		std::thread							inferenceThread;
 
-		const int n_batch;
-		const int n_keep;
-		const int n_ctx;
-		SlotManager slotManager;
+	// Resident and huge page backed memory of the mappings of `file` and of those inside `ranges`
+	void measureHugePages(const std::string& file, const std::vector<AddressRange>& ranges,
+		HugePageUsage& weights, HugePageUsage& buffers)
+	{
+#ifdef __linux__
+		std::ifstream smaps("/proc/self/smaps");
+		std::string line;
+		HugePageUsage* current = nullptr;
+		while (std::getline(smaps, line)) {
+			const size_t colon = line.find(':');
+			const size_t space = line.find(' ');
+			// A mapping header: "start-end perms offset device inode [path]"
+			if (colon == std::string::npos || (space != std::string::npos && space < colon)) {
+				current = nullptr;
+				const size_t dash = line.find('-');
+				if (dash == std::string::npos || space == std::string::npos) continue;
+				if (!file.empty() && line.find(file) != std::string::npos) {
+					current = &weights;
+					continue;
+				}
+				const uintptr_t start	= static_cast<uintptr_t>(std::stoull(line.substr(0, dash), nullptr, 16));
+				const uintptr_t end		= static_cast<uintptr_t>(std::stoull(line.substr(dash + 1, space - dash - 1), nullptr, 16));
+				for (const auto& range : ranges) {
+					if (start >= range.start && end <= range.end) {
+						current = &buffers;
+						break;
+					}
+				}
+				continue;
+			}
+			if (!current) continue;
+
+			const std::string key = line.substr(0, colon);
+			const bool resident	= key == "Rss";
+			const bool huge		= key == "AnonHugePages" || key == "FilePmdMapped" || key == "ShmemPmdMapped";
+			// hugetlbfs pages are not part of Rss
+			const bool hugetlb	= key == "Private_Hugetlb" || key == "Shared_Hugetlb";
+			if (!resident && !huge && !hugetlb) continue;
+			const uint64_t bytes = std::strtoull(line.c_str() + colon + 1, nullptr, 10) * 1024;
+			if (resident || hugetlb) current->bytes += bytes;
+			if (huge || hugetlb) current->huge += bytes;
+		}
+#else
+		(void)file; (void)ranges; (void)weights; (void)buffers;
+#endif
+	}
 
+	// Weights shared by every engine that opens the same GGUF with the same placement. Each
+	// engine gets its own llama_context on top of the shared llama_model, so replicas and
+	// differently configured engines over one file map and upload the weights only once.
+	// Host-resident weights opened with a retain budget outlive their last engine: the CPU
+	// backend repacks quantized tensors at load, and a reload that finds them here skips both
+	// the read and the repack.
+	class ModelStore {
 	public:
-		LlamaInferenceService(std::shared_ptr<Tokenizer> tokenizer, llama_model* model, llama_context* context, 
-			common_params params, ggml_threadpool* threadpool)
-			: tokenizer(std::move(tokenizer)), model(model), context(context), g_params(params), threadpool(threadpool),
-			n_batch(params.n_batch), n_keep(params.n_keep), n_ctx(llama_n_ctx(context)), slotManager(context, params.n_parallel)
+		static ModelStore& instance()
 		{
-#ifdef DEBUG
-			std::cout << "Initializing batch with size of: " << g_params.n_batch << std::endl;
-#endif
-			// initialize for multi-sequence decoding
-			batch = llama_batch_init(params.n_ctx, 0, params.n_parallel);
-
-			inferenceThread = std::thread(&LlamaInferenceService::start, this);
+			static ModelStore store;
+			return store;
 		}
 
-		~LlamaInferenceService()
+		// Loads (or reuses) the model for params.model.path and creates a context on it. Returns
+		// null when the weights cannot be loaded; `ctx` is null when only the context failed, and
+		// the model must still be handed back through release(). With `hugetlbPageSize`, mapped
+		// weights are loaded from a copy on hugetlbfs pages of that size when one can be made.
+		// With `retainBytes`, host-resident weights are kept after release() within that budget
+		llama_model* open(common_params& params, llama_context*& ctx, uint64_t hugetlbPageSize = 0, uint64_t retainBytes = 0)
 		{
-			stop();
-			slotManager.shutdown();
+			ctx = nullptr;
+			if (!params.use_mmap) hugetlbPageSize = 0;
+			const std::string key = keyFor(params) + "|hugetlb=" + std::to_string(hugetlbPageSize);
 
-			// Wait for the inference thread to finish before cleaning up resources
-			if (inferenceThread.joinable()) {
-				inferenceThread.join();
+			// Engines opening the same key wait for the first load instead of loading twice
+			std::shared_ptr<std::mutex> keyLock;
+			{
+				std::lock_guard<std::mutex> lock(mtx);
+				auto& slot = loading[key];
+				if (!slot) slot = std::make_shared<std::mutex>();
+				keyLock = slot;
 			}
+			std::lock_guard<std::mutex> loadLock(*keyLock);
 
-			// Clean up all remaining jobs to prevent accessing freed resources
+			llama_model* model = nullptr;
+			bool repacked = false;
 			{
 				std::lock_guard<std::mutex> lock(mtx);
-				for (auto& job : jobs) {
-					if (job) { // Null check for safety
-						std::lock_guard<std::mutex> jobLock(job->mtx);
-						if (!job->isFinished) {
-							job->hasError = true;
-							job->errorMessage = "Service is shutting down";
-							job->isFinished = true;
-							job->cv.notify_all();
-						}
-						if (job->seqId >= 0) { slotManager.release(job->seqId); job->seqId = -1; }
-						if (job->smpl) {
-							common_sampler_free(job->smpl);
-							job->smpl = nullptr;
-						}
+				auto it = models.find(key);
+				if (it != models.end()) {
+					model = it->second.model;
+					if (it->second.refs++ == 0) {
+						retained.remove(key);
+						retainedBytes -= llama_model_size(model);
+						repacked = true;
 					}
+					it->second.retainBytes = retainBytes;
 				}
-				jobs.clear();
+			}
+			if (model) {
+				std::cout << "[INFERENCE] Reusing " << (repacked ? "retained repacked" : "loaded") << " weights of "
+					<< params.model.path << std::endl;
+				ctx = llama_init_from_model(model, common_context_params_to_llama(params));
+				return model;
 			}
 
-			// Safe cleanup of llama resources
-			if (context) {
-				llama_free(context);
-				context = nullptr;
-			}
-			if (model) {
-				llama_model_free(model);
-				model = nullptr;
+			// The copy is unlinked once mapped, so its pages go back to the pool with the mapping
+			const std::string source = params.model.path;
+			std::error_code ec;
+			const std::filesystem::path canonical = std::filesystem::weakly_canonical(source, ec);
+			std::string mapped = ec ? source : canonical.string();
+			if (hugetlbPageSize > 0) {
+				std::string error;
+				const std::string mount = hugetlbfsMount(hugetlbPageSize);
+				const std::string copy = mount.empty() ? std::string() : copyToHugetlbfs(source, mount, hugetlbPageSize, error);
+				if (!copy.empty()) {
+					params.model.path = copy;
+					mapped = copy;
+				}
+				else {
+					std::cerr << "[INFERENCE] [WARNING] Weights of " << source << " stay on regular pages: "
+						<< (mount.empty() ? "no writable hugetlbfs mount with " + std::to_string(hugetlbPageSize >> 20) + " MiB pages" : error)
+						<< std::endl;
+				}
 			}
-			llama_batch_free(batch);
 
-			if (threadpool) {
-				ggml_threadpool_free(threadpool);
-				threadpool = nullptr;
+			auto init = common_init_from_params(params);
+			if (params.model.path != source) {
+				std::filesystem::remove(mapped, ec);
+				params.model.path = source;
+			}
+			model	= init.model.release();
+			ctx		= init.context.release();
+			if (model) {
+				std::lock_guard<std::mutex> lock(mtx);
+				models[key] = { model, 1, mapped, retainBytes, params.n_gpu_layers == 0 || !llama_supports_gpu_offload() };
+				keys[model] = key;
 			}
+			return model;
 		}
 
-		void stop() override
+		// The file the model's weights are mapped from: the GGUF, or its copy on hugetlbfs
+		std::string mappedFile(const llama_model* model)
 		{
-			should_terminate = true;
-			// Wake up the inference thread if it's waiting
-			cv.notify_all();
+			std::lock_guard<std::mutex> lock(mtx);
+			auto owner = keys.find(const_cast<llama_model*>(model));
+			return owner == keys.end() ? std::string() : models[owner->second].mapped;
 		}
 
-		void start() override
+		void release(llama_model* model)
 		{
-			while (!should_terminate)
+			if (!model) return;
+			std::vector<llama_model*> freed{ model };
+			uint64_t kept = 0;
 			{
-				std::vector<std::shared_ptr<Job>> current_jobs;
-				{
-					std::unique_lock<std::mutex> lock(mtx);
-					if (jobs.empty()) {
-						cv.wait(lock, [this] { return !jobs.empty() || should_terminate; });
+				std::lock_guard<std::mutex> lock(mtx);
+				auto owner = keys.find(model);
+				if (owner != keys.end()) {
+					auto it = models.find(owner->second);
+					if (--it->second.refs > 0) return;
+
+					const uint64_t size = llama_model_size(model);
+					if (it->second.host && size <= it->second.retainBytes) {
+						// Keep it, and make room by freeing the weights unused the longest
+						retained.push_front(owner->second);
+						retainedBytes += size;
+						kept = size;
+						freed.clear();
+						while (retainedBytes > it->second.retainBytes) {
+							auto victim = models.find(retained.back());
+							retained.pop_back();
+							retainedBytes -= llama_model_size(victim->second.model);
+							freed.push_back(victim->second.model);
+							keys.erase(victim->second.model);
+							models.erase(victim);
+						}
+					}
+					else {
+						models.erase(it);
+						keys.erase(owner);
 					}
-					if (should_terminate) break;
-					current_jobs = jobs; // Copy jobs to process without holding the lock
 				}
+			}
+			if (kept > 0) {
+				std::cout << "[INFERENCE] Keeping " << (kept >> 20) << " MiB of unloaded weights in memory for the next load ("
+					<< freed.size() << " older set(s) freed)" << std::endl;
+			}
+			for (llama_model* unused : freed) {
+				llama_model_free(unused);
+			}
+		}
 
-				// Check for shutdown again after acquiring jobs
-				if (should_terminate) break;
 
-				bool batch_has_tokens = false;
+	private:
+		struct Entry {
+			llama_model*	model;
+			int				refs;
+			std::string		mapped;
+			uint64_t		retainBytes;	// Budget to stay loaded in once refs reaches 0
+			bool			host;			// Weights live in host memory
+		};
+
+		ModelStore() = default;
+
+		// Everything that decides where and how the weights are loaded
+		static std::string keyFor(const common_params& params)
+		{
+			std::error_code ec;
+			std::filesystem::path path = std::filesystem::weakly_canonical(params.model.path, ec);
+			if (ec) path = params.model.path;
+			// The file's size and timestamp, so retained weights of a replaced file are not reused
+			const uintmax_t size = std::filesystem::file_size(path, ec);
+			const auto mtime = ec ? 0 : std::filesystem::last_write_time(path, ec).time_since_epoch().count();
+			std::ostringstream key;
+			key << path.string() << "|size=" << (ec ? 0 : size) << "|mtime=" << mtime
+				<< "|ngl=" << params.n_gpu_layers << "|split=" << static_cast<int>(params.split_mode)
+				<< "|main=" << params.main_gpu << "|mmap=" << params.use_mmap << "|mlock=" << params.use_mlock << "|ts=";
+			for (float f : params.tensor_split) {
+				if (f != 0.0f) key << f << ",";
+			}
+			key << "|ot=";
+			for (const auto& o : params.tensor_buft_overrides) {
+				if (o.pattern) key << o.pattern << "=" << ggml_backend_buft_name(o.buft) << ";";
+			}
+			return key.str();
+		}
 
-				// determine fair per-job prompt quota for this decode step
-				int active_jobs = 0;
-				for (auto &job : current_jobs) {
-					std::lock_guard<std::mutex> jl(job->mtx);
-					if (!job->isFinished && !job->hasError) {
-						active_jobs++;
-					}
+		std::mutex													mtx;
+		std::unordered_map<std::string, Entry>						models;
+		std::unordered_map<llama_model*, std::string>				keys;
+		std::unordered_map<std::string, std::shared_ptr<std::mutex>>	loading;
+		std::list<std::string>										retained;		// Unused weights, most recently released first
+		uint64_t													retainedBytes = 0;
+	};
+
+	// Parses a core list such as "0-15,32,34-35"
+	bool parseCoreList(const std::string& spec, std::vector<int>& cores)
+	{
+		std::stringstream ss(spec);
+		std::string part;
+		while (std::getline(ss, part, ',')) {
+			part.erase(std::remove_if(part.begin(), part.end(), [](unsigned char c) { return std::isspace(c); }), part.end());
+			if (part.empty()) continue;
+			const size_t dash = part.find('-');
+			try {
+				size_t used = 0;
+				const int first = std::stoi(part.substr(0, dash), &used);
+				if (used != (dash == std::string::npos ? part.size() : dash)) return false;
+				int last = first;
+				if (dash != std::string::npos) {
+					const std::string tail = part.substr(dash + 1);
+					last = std::stoi(tail, &used);
+					if (used != tail.size()) return false;
 				}
-				// avoid divide-by-zero; ensure at least 1 token per job
-				const int per_job_quota = std::max(1, g_params.n_batch / std::max(1, active_jobs));
+				if (first < 0 || last < first || last >= GGML_MAX_N_THREADS) return false;
+				for (int c = first; c <= last; ++c) cores.push_back(c);
+			}
+			catch (const std::exception&) {
+				return false;
+			}
+		}
+		std::sort(cores.begin(), cores.end());
+		cores.erase(std::unique(cores.begin(), cores.end()), cores.end());
+		return !cores.empty();
+	}
 
-				for (auto job : current_jobs)
-				{
-					// Check for shutdown in the job processing loop
-					if (should_terminate) break;
+	// Cores of a NUMA node, read from sysfs; empty where the node or sysfs is unavailable
+	std::vector<int> numaNodeCores(int node)
+	{
+		std::vector<int> cores;
+#ifdef __linux__
+		std::ifstream list("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+		std::string spec;
+		if (list && std::getline(list, spec)) {
+			parseCoreList(spec, cores);
+		}
+#else
+		(void)node;
+#endif
+		return cores;
+	}
 
-					std::lock_guard<std::mutex> jobLock(job->mtx);
+	// Pulls a model file into the page cache with parallel sequential reads, so that mapping it
+	// does not fault the weights in one page at a time on the first requests. Reports progress
+	// between `from` and `to`
+	void prefetchFile(const std::filesystem::path& path, std::atomic<float>* progress, float from, float to)
+	{
+		std::error_code ec;
+		const uint64_t size = std::filesystem::file_size(path, ec);
+		if (ec || size == 0) return;
 
-					if (job->isFinished || job->hasError)
-						continue;
+#ifdef __linux__
+		{
+			const int fd = ::open(path.c_str(), O_RDONLY);
+			if (fd >= 0) {
+				::posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+				::close(fd);
+			}
+		}
+#endif
 
-					if (checkCancellation(job) || (job->n_remain <= 0 && job->params.maxNewTokens != 0)) {
-						saveSession(job);
-						if (job->smpl) {
-							common_sampler_free(job->smpl);
-							job->smpl = nullptr;
-						}
-						if (job->seqId >= 0) { slotManager.release(job->seqId); job->seqId = -1; }
-						job->isFinished = true;
-						job->cv.notify_all();
-						continue;
-					}
+		constexpr uint64_t kChunk = 8ull << 20;
+		const uint64_t chunks = (size + kChunk - 1) / kChunk;
+		const unsigned int threads = static_cast<unsigned int>(std::min<uint64_t>(
+			chunks, std::clamp(std::thread::hardware_concurrency(), 1u, 8u)));
+
+		std::atomic<uint64_t> nextChunk{ 0 };
+		std::atomic<uint64_t> doneChunks{ 0 };
+		auto reader = [&]() {
+			std::ifstream in(path, std::ios::binary);
+			std::vector<char> buffer(kChunk);
+			for (uint64_t c = nextChunk++; in && c < chunks; c = nextChunk++) {
+				in.seekg(static_cast<std::streamoff>(c * kChunk));
+				in.read(buffer.data(), static_cast<std::streamsize>(std::min(kChunk, size - c * kChunk)));
+				const uint64_t done = ++doneChunks;
+				if (progress) progress->store(from + (to - from) * static_cast<float>(done) / chunks);
+			}
+		};
 
-					if (!ensureContextCapacity(job))
-					{
-						if (job->smpl) {
-							common_sampler_free(job->smpl);
-							job->smpl = nullptr;
-						}
-						if (job->seqId >= 0) { slotManager.release(job->seqId); job->seqId = -1; }
-						job->hasError = true;
-						job->isFinished = true;
-						job->errorMessage = "Context overflow even after trimming.";
-						job->cv.notify_all();
-						continue;
-					}
+		std::vector<std::thread> workers;
+		for (unsigned int i = 1; i < threads; ++i) workers.emplace_back(reader);
+		reader();
+		for (auto& t : workers) t.join();
+	}
 
-					if (!job->isDecodingPrompt) {
-						// respect overall batch limit and internal capacity
-						int capacity_remaining = n_ctx - batch.n_tokens;
-						if (capacity_remaining <= 0 || batch.n_tokens >= g_params.n_batch) {
-							break;
-						}
+	// Decodes a couple of tokens so that weights, kernels and compute buffers are touched
+	// before the first real request arrives, then leaves the KV cache empty
+	void warmupContext(llama_context* ctx, const llama_model* model, int n_batch)
+	{
+		const llama_vocab* vocab = llama_model_get_vocab(model);
+		std::vector<llama_token> tokens;
+		if (llama_vocab_bos(vocab) != LLAMA_TOKEN_NULL) tokens.push_back(llama_vocab_bos(vocab));
+		if (llama_vocab_eos(vocab) != LLAMA_TOKEN_NULL) tokens.push_back(llama_vocab_eos(vocab));
+		if (tokens.empty()) tokens.push_back(0);
+		const int n_tokens = std::min(static_cast<int>(tokens.size()), std::max(1, n_batch));
+
+		if (llama_model_has_encoder(model)) {
+			llama_encode(ctx, llama_batch_get_one(tokens.data(), n_tokens));
+		}
+		else {
+			llama_decode(ctx, llama_batch_get_one(tokens.data(), n_tokens));
+		}
+		llama_memory_clear(llama_get_memory(ctx), true);
+		llama_synchronize(ctx);
+		llama_perf_context_reset(ctx);
+	}
 
-						if (!sampleNextToken(job)) {
-							saveSession(job);
-							if (job->smpl) {
-								common_sampler_free(job->smpl);
-								job->smpl = nullptr;
-							}
-							if (job->seqId >= 0) { slotManager.release(job->seqId); job->seqId = -1; }
-							job->isFinished = true;
-							job->cv.notify_all();
-							continue;
-						}
+	// Fixed-bucket histogram the decode thread records into while metrics readers snapshot it
+	class AtomicHistogram {
+	public:
+		explicit AtomicHistogram(std::initializer_list<double> bounds)
+			: bounds(bounds), counts(this->bounds.size() + 1) {}
 
-						job->n_past += 1;
-						batch_has_tokens = true;
-					}
-					else {
-						if (!loadSession(job)) {
-							if (job->smpl) {
-								common_sampler_free(job->smpl);
-								job->smpl = nullptr;
-							}
-							if (job->seqId >= 0) { slotManager.release(job->seqId); job->seqId = -1; }
-							job->hasError = true;
-							job->isFinished = true;
-							job->errorMessage = "Failed to load sessions";
-							job->cv.notify_all();
-							continue;
-						}
+		void observe(double value)
+		{
+			const size_t bucket = std::lower_bound(bounds.begin(), bounds.end(), value) - bounds.begin();
+			counts[bucket].fetch_add(1, std::memory_order_relaxed);
+			count.fetch_add(1, std::memory_order_relaxed);
+			// micro-units keep the sum an integer counter
+			sum.fetch_add(static_cast<uint64_t>(std::max(0.0, value) * 1e3), std::memory_order_relaxed);
+		}
 
-						if (!getInputTokens(job)) {
-							if (job->smpl) {
-								common_sampler_free(job->smpl);
-								job->smpl = nullptr;
-							}
-							if (job->seqId >= 0) { slotManager.release(job->seqId); job->seqId = -1; }
-							job->hasError = true;
-							job->isFinished = true;
-							job->errorMessage = "Failed to tokenize input";
-							job->cv.notify_all();
-							continue;
-						}
+		HistogramSnapshot snapshot() const
+		{
+			HistogramSnapshot result;
+			result.bounds = bounds;
+			result.counts.reserve(counts.size());
+			for (const auto& bucket : counts) result.counts.push_back(bucket.load(std::memory_order_relaxed));
+			result.count = count.load(std::memory_order_relaxed);
+			result.sum = static_cast<double>(sum.load(std::memory_order_relaxed)) / 1e3;
+			return result;
+		}
 
-						if (!ensureNonEmptyInput(job)) {
-							if (job->smpl) {
-								common_sampler_free(job->smpl);
-								job->smpl = nullptr;
-							}
-							if (job->seqId >= 0) { slotManager.release(job->seqId); job->seqId = -1; }
-							job->hasError = true;
-							job->isFinished = true;
-							job->errorMessage = "Failed to ensure input content";
-							job->cv.notify_all();
-							continue;
-						}
-						
-						job->n_matching_session_tokens = matchSessionTokens(job);
-						job->n_past = static_cast<int>(job->n_matching_session_tokens);
-						job->i_prompt = static_cast<int>(job->n_matching_session_tokens);
-						job->n_prompt = static_cast<int>(job->embd_inp.size());
+	private:
+		const std::vector<double>			bounds;
+		std::vector<std::atomic<uint64_t>>	counts;
+		std::atomic<uint64_t>				count{ 0 };
+		std::atomic<uint64_t>				sum{ 0 };
+	};
 
-						int remaining_prompt_tokens = job->n_prompt - job->i_prompt;
-						// respect overall batch limit and internal capacity
-						int capacity_remaining = n_ctx - batch.n_tokens;
-						int available_batch_space = std::min(g_params.n_batch - batch.n_tokens, capacity_remaining);
+	// Decode-loop counters shared by both inference services
+	struct DecodeCounters {
+		std::atomic<uint64_t>	decode_calls{ 0 };
+		std::atomic<uint64_t>	decode_tokens{ 0 };
+		std::atomic<uint64_t>	prompt_tokens{ 0 };
+		std::atomic<uint64_t>	chunk_tokens{ 0 };
+		std::atomic<uint64_t>	generated_tokens{ 0 };
+		std::atomic<uint64_t>	draft_tokens{ 0 };
+		std::atomic<uint64_t>	draft_accepted{ 0 };
+		std::atomic<uint64_t>	embedding_inputs{ 0 };
+		std::atomic<uint64_t>	embedding_tokens{ 0 };
+		std::atomic<uint64_t>	preemptions{ 0 };
+		std::atomic<int>		swapped_jobs{ 0 };
+		std::atomic<uint64_t>	swapped_bytes{ 0 };
+		std::atomic<int64_t>	kv_cells_used{ 0 };
+		AtomicHistogram			batch_tokens{ 1, 2, 4, 8, 16, 32, 64, 128, 256, 512, 1024, 2048 };
+		AtomicHistogram			ttft_ms{ 10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000, 30000 };
+		AtomicHistogram			tpot_ms{ 5, 10, 20, 30, 50, 75, 100, 150, 250, 500, 1000 };
+
+		void recordDecode(int n_tokens)
+		{
+			decode_calls.fetch_add(1, std::memory_order_relaxed);
+			decode_tokens.fetch_add(static_cast<uint64_t>(n_tokens), std::memory_order_relaxed);
+			batch_tokens.observe(n_tokens);
+		}
 
-						if (available_batch_space <= 0) {
-							break;
-						}
+		DecodeStats snapshot() const
+		{
+			DecodeStats stats;
+			stats.decode_calls = decode_calls.load(std::memory_order_relaxed);
+			stats.decode_tokens = decode_tokens.load(std::memory_order_relaxed);
+			stats.batch_tokens = batch_tokens.snapshot();
+			stats.prompt_tokens = prompt_tokens.load(std::memory_order_relaxed);
+			stats.chunk_tokens = chunk_tokens.load(std::memory_order_relaxed);
+			stats.generated_tokens = generated_tokens.load(std::memory_order_relaxed);
+			stats.draft_tokens = draft_tokens.load(std::memory_order_relaxed);
+			stats.draft_accepted = draft_accepted.load(std::memory_order_relaxed);
+			stats.ttft_ms = ttft_ms.snapshot();
+			stats.tpot_ms = tpot_ms.snapshot();
+			stats.embedding_inputs = embedding_inputs.load(std::memory_order_relaxed);
+			stats.embedding_tokens = embedding_tokens.load(std::memory_order_relaxed);
+			stats.preemptions = preemptions.load(std::memory_order_relaxed);
+			stats.swapped_jobs = swapped_jobs.load(std::memory_order_relaxed);
+			stats.swapped_bytes = swapped_bytes.load(std::memory_order_relaxed);
+			stats.kv_cells_used = kv_cells_used.load(std::memory_order_relaxed);
+			return stats;
+		}
+	};
 
-						// fair-share: each job contributes up to per_job_quota tokens per decode step
-						int tokens_to_process = std::min(remaining_prompt_tokens, std::min(available_batch_space, per_job_quota));
+	float millisecondsSince(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
 
-						for (int i = 0; i < tokens_to_process; ++i) {
-							llama_token token = job->embd_inp[job->i_prompt];
-							common_batch_add(batch, token, job->i_prompt, { job->seqId }, false);
-							if (job->i_prompt == job->n_prompt - 1)
-							{
-								batch.logits[batch.n_tokens - 1] = true;
-								job->batch_pos = batch.n_tokens - 1;
-							}
+	int64_t steadyMicros(std::chrono::steady_clock::time_point at)
+	{
+		return std::chrono::duration_cast<std::chrono::microseconds>(at.time_since_epoch()).count();
+	}
 
-							common_sampler_accept(job->smpl, token, false);
-							job->session_tokens.push_back(token);
-							++(job->i_prompt);
-							++(job->n_past);
-							batch_has_tokens = true;
-						}
+	// Ring of the most recent decode steps; a capacity of 0 records nothing. A capture
+	// additionally keeps every step, with its batch composition, until it is ended.
+	class StepProfiler {
+	public:
+		explicit StepProfiler(int capacity)
+			: capacity(static_cast<size_t>(std::max(0, capacity))), origin(std::chrono::steady_clock::now()) {}
 
-						if (job->i_prompt >= job->n_prompt) {
-							job->isDecodingPrompt = false;
-						}
+		bool enabled() const { return capacity > 0 || capturing(); }
+		bool capturing() const { return capture_on.load(std::memory_order_relaxed); }
 
-						// ensure capacity even during prompt ingestion
-						if (!ensureContextCapacity(job)) {
-							if (job->smpl) {
-								common_sampler_free(job->smpl);
-								job->smpl = nullptr;
-							}
-							if (job->seqId >= 0) { slotManager.release(job->seqId); job->seqId = -1; }
-							job->hasError = true;
-							job->isFinished = true;
-							job->errorMessage = "Context overflow even after trimming.";
-							job->cv.notify_all();
-							continue;
-						}
-					}
-				}
+		void record(std::chrono::steady_clock::time_point start, DecodeStepSample sample)
+		{
+			sample.start_us = std::chrono::duration_cast<std::chrono::microseconds>(start - origin).count();
+			std::lock_guard<std::mutex> lock(mtx);
+			if (capture_on.load(std::memory_order_relaxed) && captured.size() < capture_limit) {
+				captured.push_back(sample);
+			}
+			if (capacity == 0) return;
+			sample.jobs.clear();
+			if (steps.size() < capacity) {
+				steps.push_back(std::move(sample));
+			}
+			else {
+				steps[next] = std::move(sample);
+			}
+			next = (next + 1) % capacity;
+		}
 
-				if (batch_has_tokens && !should_terminate && context)
-				{
-					if (llama_decode(context, batch))
-					{
-						for (auto job : current_jobs)
-						{
-							std::lock_guard<std::mutex> jobLock(job->mtx);
-							if (!job->isFinished) {
-								job->hasError = true;
-								job->errorMessage = "Could not decode next token";
-								job->isFinished = true;
-								if (job->seqId >= 0) { slotManager.release(job->seqId); job->seqId = -1; }
-								job->cv.notify_all();
-							}
-						}
-					}
+		void beginCapture(size_t maxSteps)
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			captured.clear();
+			captured.reserve(std::min<size_t>(maxSteps, 65536));
+			capture_limit = maxSteps;
+			capture_on.store(true, std::memory_order_relaxed);
+		}
 
-					common_batch_clear(batch);
+		std::vector<DecodeStepSample> endCapture()
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			capture_on.store(false, std::memory_order_relaxed);
+			return std::move(captured);
+		}
+
+		std::vector<DecodeStepSample> snapshot()
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			if (steps.size() < capacity) return steps;
+			std::vector<DecodeStepSample> ordered(steps.begin() + next, steps.end());
+			ordered.insert(ordered.end(), steps.begin(), steps.begin() + next);
+			return ordered;
+		}
+
+	private:
+		const size_t							capacity;
+		const std::chrono::steady_clock::time_point	origin;
+		std::vector<DecodeStepSample>			steps;
+		size_t									next = 0;
+		std::atomic<bool>						capture_on{ false };
+		std::vector<DecodeStepSample>			captured;
+		size_t									capture_limit = 0;
+		std::mutex								mtx;
+	};
+
+	// Feedback controller keeping the p95 time to first token and time per output token of a
+	// generative engine under their targets. At the end of each window it compares the p95 of
+	// the latencies measured in the window with the targets and moves three settings: the prompt
+	// tokens a step may take while generations run, the slots that decode at once and the jobs the
+	// engine admits. A missed target cuts multiplicatively and headroom on both grows additively,
+	// so throughput settles just inside the SLO. Observations and updates come from the decode
+	// thread; the settings are read from any thread.
+	class SloController {
+	public:
+		SloController(float ttft_target_ms, float tpot_target_ms, int step_tokens, int prefill_tokens, int slots)
+			: ttft_target(std::max(0.0f, ttft_target_ms)), tpot_target(std::max(0.0f, tpot_target_ms)),
+			max_prefill(std::max(1, step_tokens)), min_prefill(std::min(kMinPrefill, std::max(1, step_tokens))),
+			slots(std::max(1, slots)), window_start(std::chrono::steady_clock::now())
+		{
+			prefill.store(std::clamp(prefill_tokens, 1, max_prefill), std::memory_order_relaxed);
+			max_active.store(this->slots, std::memory_order_relaxed);
+		}
+
+		bool enabled() const { return ttft_target > 0.0 || tpot_target > 0.0; }
+
+		void observeTtft(double ms) { if (enabled() && ttft.size() < kMaxSamples) ttft.push_back(ms); }
+		void observeTpot(double ms) { if (enabled() && tpot.size() < kMaxSamples) tpot.push_back(ms); }
+
+		// Called once per decode step with the slots in use and the jobs waiting for one; true
+		// when the window closed and the settings changed
+		bool update(int in_use, int waiting)
+		{
+			if (!enabled()) return false;
+			const auto now = std::chrono::steady_clock::now();
+			const auto elapsed = now - window_start;
+			if (elapsed < kWindow || (ttft.size() + tpot.size() < kMinSamples && elapsed < kMaxWindow)) return false;
+			window_start = now;
+			// An idle window says nothing about the settings
+			if (ttft.empty() && tpot.empty()) return false;
+
+			const double ttft_p95 = p95(ttft);
+			const double tpot_p95 = p95(tpot);
+			ttft.clear();
+			tpot.clear();
+			last_ttft_p95.store(std::max(0.0, ttft_p95), std::memory_order_relaxed);
+			last_tpot_p95.store(std::max(0.0, tpot_p95), std::memory_order_relaxed);
+
+			// No sample of a measure counts as within its target
+			const bool ttft_over = ttft_target > 0.0 && ttft_p95 > ttft_target;
+			const bool tpot_over = tpot_target > 0.0 && tpot_p95 > tpot_target;
+			const bool ttft_room = ttft_target <= 0.0 || ttft_p95 < kHeadroom * ttft_target;
+			const bool tpot_room = tpot_target <= 0.0 || tpot_p95 < kHeadroom * tpot_target;
+
+			int next_prefill = prefill.load(std::memory_order_relaxed);
+			int next_active = max_active.load(std::memory_order_relaxed);
+			int next_admit = admit.load(std::memory_order_relaxed);
+			if (tpot_over) {
+				// Generations share their steps with prompt chunks first, then with each other
+				if (next_prefill > min_prefill) {
+					next_prefill = std::max(min_prefill, static_cast<int>(next_prefill * kCut));
+				}
+				else {
+					next_active = std::max(1, static_cast<int>(next_active * kCut));
 				}
 			}
-			
-			// Ensure all remaining jobs are properly cleaned up when exiting
-			{
-				std::lock_guard<std::mutex> lock(mtx);
-				for (auto& job : jobs) {
-					std::lock_guard<std::mutex> jobLock(job->mtx);
-					if (!job->isFinished) {
-						job->hasError = true;
-						job->errorMessage = "Service is shutting down";
-						job->isFinished = true;
-						if (job->seqId >= 0) { slotManager.release(job->seqId); job->seqId = -1; }
-						job->cv.notify_all();
-					}
+			if (ttft_over) {
+				if (!tpot_over && waiting > 0 && next_active < slots) {
+					// Prompts wait for a slot the controller holds back
+					++next_active;
+				}
+				else if (!tpot_over && next_prefill < max_prefill) {
+					next_prefill = std::min(max_prefill, static_cast<int>(next_prefill / kCut) + 1);
+				}
+				else {
+					// The engine cannot ingest faster without slowing generations: take fewer jobs
+					const int admitted = next_admit > 0 ? next_admit : in_use + waiting;
+					next_admit = std::max(next_active, static_cast<int>(admitted * kCut));
 				}
 			}
+			if (!ttft_over && !tpot_over && ttft_room && tpot_room) {
+				if (next_admit > 0) {
+					next_admit += std::max(1, next_admit / 4);
+					if (next_admit >= slots * kAdmitCeiling) next_admit = 0;
+				}
+				next_active = std::min(slots, next_active + 1);
+				next_prefill = std::min(max_prefill, next_prefill + std::max(1, max_prefill / 8));
+			}
+
+			const bool changed = next_prefill != prefill.load(std::memory_order_relaxed) ||
+				next_active != max_active.load(std::memory_order_relaxed) || next_admit != admit.load(std::memory_order_relaxed);
+			prefill.store(next_prefill, std::memory_order_relaxed);
+			max_active.store(next_active, std::memory_order_relaxed);
+			admit.store(next_admit, std::memory_order_relaxed);
+			if (changed) adjustments.fetch_add(1, std::memory_order_relaxed);
+			return changed;
 		}
 
-		void submitJob(const CompletionParameters& params, std::shared_ptr<Job> job) override
+		int prefillTokens() const { return prefill.load(std::memory_order_relaxed); }
+		int maxActive() const { return max_active.load(std::memory_order_relaxed); }
+		int admitJobs() const { return admit.load(std::memory_order_relaxed); }
+
+		void fill(DecodeStats& stats) const
 		{
-#ifdef DEBUG
-			std::cout << "[INFERENCE] Submitting job with prompt: \n" << params.prompt << std::endl;
-#endif
+			if (!enabled()) return;
+			stats.slo_ttft_p95_ms = last_ttft_p95.load(std::memory_order_relaxed);
+			stats.slo_tpot_p95_ms = last_tpot_p95.load(std::memory_order_relaxed);
+			stats.slo_prefill_tokens = prefillTokens();
+			stats.slo_max_active = maxActive();
+			stats.slo_admit_jobs = admitJobs();
+			stats.slo_adjustments = adjustments.load(std::memory_order_relaxed);
+		}
 
-			// Make a mutable copy for potential context shifting
-			CompletionParameters mutable_params = params;
-			
-			if (!validateParameters(mutable_params, job)) {
-				return;
-			}
+	private:
+		static constexpr auto	kWindow = std::chrono::seconds(2);
+		static constexpr auto	kMaxWindow = std::chrono::seconds(10);	// Closes a window short of kMinSamples
+		static constexpr size_t	kMinSamples = 32;
+		static constexpr size_t	kMaxSamples = 8192;
+		static constexpr int	kMinPrefill = 32;
+		static constexpr int	kAdmitCeiling = 8;		// Admission limits this many times the slots are lifted
+		static constexpr double	kHeadroom = 0.8;		// Settings only grow while both p95 values are below this share
+		static constexpr double	kCut = 0.7;
+
+		// -1 when there is no sample
+		static double p95(std::vector<double>& samples)
+		{
+			if (samples.empty()) return -1.0;
+			auto rank = samples.begin() + static_cast<std::ptrdiff_t>((samples.size() - 1) * 95 / 100);
+			std::nth_element(samples.begin(), rank, samples.end());
+			return *rank;
+		}
 
-			job->params = mutable_params;
+		const double							ttft_target;
+		const double							tpot_target;
+		const int								max_prefill;
+		const int								min_prefill;
+		const int								slots;
+		std::chrono::steady_clock::time_point	window_start;
+		std::vector<double>						ttft;
+		std::vector<double>						tpot;
+		std::atomic<int>						prefill{ 0 };
+		std::atomic<int>						max_active{ 0 };
+		std::atomic<int>						admit{ 0 };
+		std::atomic<double>						last_ttft_p95{ 0.0 };
+		std::atomic<double>						last_tpot_p95{ 0.0 };
+		std::atomic<uint64_t>					adjustments{ 0 };
+	};
 
-			job->smpl = initializeSampler(mutable_params, job);
-			if (!job->smpl) {
-				return;
+	// Who a slot is for; callers without a tenant share one
+	struct SlotShare {
+		std::string tenant;
+		float       weight    = 1.0f;
+		int         max_slots = 0;	// Slots the tenant may hold at once (0 = no cap)
+		int         priority  = 0;	// CompletionParameters::priority; higher waiters are served first
+		int         cells     = 0;	// KV cells the slot comes with under paged KV (see setBlockPool)
+	};
+
+	// Manages KV sequence IDs (slots) for llama context
+	// Hands out KV sequence ids to jobs. A slot released with a session key stays "warm":
+	// its KV and the tokens it holds are kept so the next turn of that conversation only
+	// decodes the new suffix. Cold slots are handed out first; warm slots of other
+	// conversations are reclaimed least recently used first. When callers wait, a freed
+	// slot goes to the highest priority waiting; among equals to the tenant holding the
+	// fewest slots for its weight, and within a tenant to its longest waiting caller.
+	// With paged KV a slot also holds blocks of cells, taken from a shared pool as its
+	// sequence grows, and a caller waits until the blocks it asks for are free as well.
+	class SlotManager {
+	public:
+		SlotManager(llama_context * ctx, int n_parallel)
+			: ctx(ctx), max_slots(n_parallel), active_limit(n_parallel) {
+			for (int i = 0; i < max_slots; ++i) free_slots.push(i);
+		}
+		// Conversation whose warm slot was reclaimed by allocate(); its KV is still in place
+		struct Evicted {
+			std::string              key;
+			std::vector<llama_token> tokens;
+		};
+		// Called on the decode thread (from trimWarm) right before a warm slot is wiped
+		using EvictHandler = std::function<void(int id, const std::string & key, std::vector<llama_token> tokens)>;
+
+		void setEvictHandler(EvictHandler handler) { on_evict = std::move(handler); }
+
+		int allocate() {
+			std::vector<llama_token> unused;
+			return allocate(std::string(), unused);
+		}
+		// Returned by allocate() when `cancelled` was raised while waiting for a slot
+		static constexpr int kCancelled = -2;
+
+		// Prefers the warm slot of `key`; warm_tokens receives the tokens already in its KV.
+		// When another conversation's slot is reclaimed it is described in `evicted` (if given)
+		// and left for the caller to save and wipe
+		int allocate(const std::string & key, std::vector<llama_token> & warm_tokens, Evicted * evicted = nullptr,
+					 const std::atomic<bool> * cancelled = nullptr, const SlotShare & share = SlotShare()) {
+			std::unique_lock<std::mutex> lock(mtx);
+			Tenant & mine = tenants[share.tenant];
+			mine.weight = share.weight > 0.0f ? share.weight : 1.0f;
+			mine.max_slots = std::max(0, share.max_slots);
+			const Ticket ticket(-share.priority, ++next_ticket);
+			mine.queue.emplace(ticket, share.cells);
+			auto ready = [&]{
+				if (terminated) return true;
+				if (!slotAvailableLocked() || blocksFor(share.cells) > free_blocks) return false;
+				return nextTenantLocked() == &mine && mine.queue.begin()->first == ticket;
+			};
+			++waiting;
+			if (!cancelled) {
+				cv.wait(lock, ready);
+			}
+			else {
+				// Nothing signals this cv on cancellation, so waiters poll the flag
+				while (!cancelled->load() && !cv.wait_for(lock, std::chrono::milliseconds(100), ready)) {}
+			}
+			--waiting;
+			mine.queue.erase(ticket);
+			if ((cancelled && cancelled->load()) || terminated) {
+				// Callers queued behind this one may be next in line now
+				if (mine.held == 0 && mine.queue.empty()) tenants.erase(share.tenant);
+				cv.notify_all();
+				return cancelled && cancelled->load() ? kCancelled : -1;
 			}
 
-			{
-				std::lock_guard<std::mutex> jobLock(job->mtx);
-				job->generatedTokens.clear();
-				job->generatedText.clear();
+			const int id = takeSlotLocked(key, warm_tokens, evicted);
+			++mine.held;
+			owner[id] = share.tenant;
+			reserveLocked(id, share.cells);
+			// Another waiter may take a slot that is still free
+			if (!free_slots.empty() || !warm.empty()) cv.notify_all();
+			return id;
+		}
+		// Returned by urgentPriority() when no caller waits for a slot to be freed
+		static constexpr int kNoneWaiting = std::numeric_limits<int>::min();
+
+		// Priority of the caller next in line when it waits only because every slot, or the KV
+		// blocks it needs, are taken; kNoneWaiting when nobody waits, it can go ahead, or the
+		// next tenant waits for its cap
+		int urgentPriority() {
+			std::lock_guard<std::mutex> lock(mtx);
+			const Tenant * next = terminated ? nullptr : nextTenantLocked();
+			if (!next) return kNoneWaiting;
+			const bool no_slot = free_slots.empty() && warm.empty();
+			if (!no_slot && blocksFor(next->queue.begin()->second) <= free_blocks) return kNoneWaiting;
+			return -next->queue.begin()->first.first;
+		}
+		// A slot for a preempted job to resume in, without waiting; -1 while none is free, a
+		// caller of higher priority waits, or the tenant is at its cap. A reclaimed warm slot
+		// is described in `evicted` and left for the caller to save and wipe
+		int resume(const SlotShare & share, Evicted & evicted) {
+			std::lock_guard<std::mutex> lock(mtx);
+			if (terminated || !slotAvailableLocked() || blocksFor(share.cells) > free_blocks) return -1;
+			const Tenant * next = nextTenantLocked();
+			if (next && -next->queue.begin()->first.first > share.priority) return -1;
+			Tenant & mine = tenants[share.tenant];
+			mine.weight = share.weight > 0.0f ? share.weight : 1.0f;
+			mine.max_slots = std::max(0, share.max_slots);
+			if (mine.max_slots > 0 && mine.held >= mine.max_slots) return -1;
+			std::vector<llama_token> unused;
+			const int id = takeSlotLocked(std::string(), unused, &evicted);
+			++mine.held;
+			owner[id] = share.tenant;
+			reserveLocked(id, share.cells);
+			return id;
+		}
+		// Paged KV: slots in use hold their sequence's cells in blocks of `tokens`, `count` of
+		// which make up the pool. Off (every slot may grow to the whole context) until called
+		void setBlockPool(int tokens, int count) {
+			std::lock_guard<std::mutex> lock(mtx);
+			block_tokens = std::max(0, tokens);
+			total_blocks = free_blocks = block_tokens > 0 ? std::max(0, count) : 0;
+		}
+		// Grows the blocks of slot `id` toward `cells` as far as the pool allows; returns the
+		// cells they cover (any number without paged KV)
+		int reserve(int id, int cells) {
+			std::lock_guard<std::mutex> lock(mtx);
+			return reserveLocked(id, cells);
+		}
+		int blocksTotal() { std::lock_guard<std::mutex> lock(mtx); return total_blocks; }
+		int blocksUsed() { std::lock_guard<std::mutex> lock(mtx); return total_blocks - free_blocks; }
+		void release(int id) {
+			if (id < 0) return;
+			if (ctx) {
+				// remove all KV entries for this sequence id
+				auto * mem = llama_get_memory(ctx);
+				// use range [0, -1) to ensure full wipe across backends (CUDA may no-op on [-1, -1])
+				llama_memory_seq_rm(mem, id, /*p0=*/0, /*p1=*/-1);
 			}
+			std::lock_guard<std::mutex> lock(mtx);
+			if (in_use.erase(id)) { releaseOwnerLocked(id); releaseBlocksLocked(id); free_slots.push(id); cv.notify_all(); }
+		}
+		// Keep the KV of `id` for the next job with the same key; `tokens` must mirror its cells
+		void release(int id, const std::string & key, std::vector<llama_token> tokens) {
+			if (id < 0) return;
+			if (key.empty() || tokens.empty()) { release(id); return; }
 
-			// Acquire a managed seq slot; block if busy
-			const int slot_id = slotManager.allocate();
-			if (slot_id < 0) {
-				std::lock_guard<std::mutex> jobLock(job->mtx);
-				job->hasError = true;
-				job->errorMessage = "Service is shutting down";
-				job->cv.notify_all();
-				return;
+			std::lock_guard<std::mutex> lock(mtx);
+			if (!in_use.erase(id)) return;
+			releaseOwnerLocked(id);
+			releaseBlocksLocked(id);
+
+			// a newer turn of the same conversation supersedes the slot parked earlier
+			auto previous = warm_by_key.find(key);
+			if (previous != warm_by_key.end()) {
+				wipeLocked(previous->second);
 			}
-			job->seqId = slot_id;
-			// defensive: ensure the slot's KV is empty before use (CUDA can be strict)
-			if (context) {
-				auto * mem = llama_get_memory(context);
-				llama_memory_seq_rm(mem, job->seqId, /*p0=*/0, /*p1=*/-1);
+			warm[id] = { key, std::move(tokens), ++clock };
+			warm_by_key[key] = id;
+			cv.notify_all();
+		}
+		// Turn warm slots cold, least recently used first, until at most `budget` cells are held
+		void trimWarm(size_t budget) {
+			std::lock_guard<std::mutex> lock(mtx);
+			size_t held = 0;
+			for (const auto & entry : warm) held += entry.second.tokens.size();
+			while (held > budget && !warm.empty()) {
+				auto victim = warm.begin();
+				for (auto it = warm.begin(); it != warm.end(); ++it) {
+					if (it->second.lastUsed < victim->second.lastUsed) victim = it;
+				}
+				held -= victim->second.tokens.size();
+				if (on_evict) {
+					on_evict(victim->first, victim->second.key, std::move(victim->second.tokens));
+				}
+				wipeLocked(victim->first);
 			}
-			job->path_session				= params.kvCacheFilePath;
-			job->n_remain					= params.maxNewTokens;
-			job->isDecodingPrompt			= true;
-			job->isFinished					= false;
+		}
+		// Turn every warm slot cold, handing each conversation to `take` right before its KV is wiped
+		void drainWarm(const EvictHandler & take) {
+			std::lock_guard<std::mutex> lock(mtx);
+			while (!warm.empty()) {
+				auto victim = warm.begin();
+				take(victim->first, victim->second.key, std::move(victim->second.tokens));
+				wipeLocked(victim->first);
+			}
+			cv.notify_all();
+		}
+		// A free slot without waiting or reclaiming a warm one; -1 if there is none
+		int tryAllocate() {
+			std::lock_guard<std::mutex> lock(mtx);
+			if (terminated || free_slots.empty()) return -1;
+			const int id = free_slots.front(); free_slots.pop();
+			in_use.insert(id);
+			++tenants[std::string()].held;
+			owner[id] = std::string();
+			return id;
+		}
+		size_t warmTokens() {
+			std::lock_guard<std::mutex> lock(mtx);
+			size_t held = 0;
+			for (const auto & entry : warm) held += entry.second.tokens.size();
+			return held;
+		}
+		void shutdown() { std::lock_guard<std::mutex> lock(mtx); terminated = true; cv.notify_all(); }
+		int capacity() const { return max_slots; }
+		int inUse() { std::lock_guard<std::mutex> lock(mtx); return static_cast<int>(in_use.size()); }
+		int waitingJobs() { std::lock_guard<std::mutex> lock(mtx); return waiting; }
+		// Slots allocate() hands out at once; jobs holding one beyond a lowered limit keep it
+		void setActiveLimit(int limit) {
+			std::lock_guard<std::mutex> lock(mtx);
+			active_limit = std::max(1, std::min(limit, max_slots));
+			cv.notify_all();
+		}
+	private:
+		struct WarmSlot {
+			std::string              key;
+			std::vector<llama_token> tokens;
+			uint64_t                 lastUsed;
+		};
+		// Negated priority, then arrival order: the first ticket of a set is served first
+		using Ticket = std::pair<int, uint64_t>;
+		struct Tenant {
+			float                 weight    = 1.0f;
+			int                   max_slots = 0;
+			int                   held      = 0;
+			std::map<Ticket, int> queue;	// Its callers waiting in allocate(), with the cells they ask for
+		};
+
+		bool slotAvailableLocked() const {
+			return static_cast<int>(in_use.size()) < active_limit && (!free_slots.empty() || !warm.empty());
+		}
 
-			{
-				std::lock_guard<std::mutex> lock(mtx);
-				jobs.push_back(job);
+		// The waiting tenant next in line: the one with the highest priority waiter, then the
+		// fewest slots held for its weight among those under their cap, then the one waiting
+		// longest; null when every waiter is at its cap
+		const Tenant * nextTenantLocked() const {
+			const Tenant * best = nullptr;
+			double best_load = 0.0;
+			for (const auto & entry : tenants) {
+				const Tenant & tenant = entry.second;
+				if (tenant.queue.empty() || (tenant.max_slots > 0 && tenant.held >= tenant.max_slots)) continue;
+				const double load = tenant.held / static_cast<double>(tenant.weight);
+				const Ticket & first = tenant.queue.begin()->first;
+				const Ticket & best_first = best ? best->queue.begin()->first : first;
+				if (!best || first.first < best_first.first
+					|| (first.first == best_first.first
+						&& (load < best_load || (load == best_load && first.second < best_first.second)))) {
+					best = &tenant;
+					best_load = load;
+				}
 			}
+			return best;
+		}
 
-			cv.notify_one();
+		// Takes the warm slot of `key`, else a cold one, else reclaims the least recently used
+		// conversation (described in `evicted`, its KV left for the caller to wipe)
+		int takeSlotLocked(const std::string & key, std::vector<llama_token> & warm_tokens, Evicted * evicted) {
+			int id = -1;
+			auto byKey = key.empty() ? warm_by_key.end() : warm_by_key.find(key);
+			if (byKey != warm_by_key.end()) {
+				id = byKey->second;
+				warm_tokens = std::move(warm[id].tokens);
+				warm_by_key.erase(byKey);
+				warm.erase(id);
+			}
+			else if (!free_slots.empty()) {
+				id = free_slots.front(); free_slots.pop();
+			}
+			else {
+				auto victim = warm.begin();
+				for (auto it = warm.begin(); it != warm.end(); ++it) {
+					if (it->second.lastUsed < victim->second.lastUsed) victim = it;
+				}
+				id = victim->first;
+				if (evicted) {
+					evicted->key = victim->second.key;
+					evicted->tokens = std::move(victim->second.tokens);
+				}
+				warm_by_key.erase(victim->second.key);
+				warm.erase(victim);
+			}
+			in_use.insert(id);
+			return id;
 		}
 
-		void complete(const CompletionParameters& params, std::shared_ptr<Job> job) override
-		{
-#ifdef DEBUG
-			std::cout << "[INFERENCE] Submitting job with sequence ID: " << params.seqId << std::endl;
-#endif
+		// Blocks covering `cells`; the whole pool at most, so a sequence never waits for more
+		int blocksFor(int cells) const {
+			if (block_tokens <= 0 || cells <= 0) return 0;
+			return std::min(total_blocks, (cells + block_tokens - 1) / block_tokens);
+		}
 
-			submitJob(params, job);
+		int reserveLocked(int id, int cells) {
+			if (block_tokens <= 0) return std::numeric_limits<int>::max();
+			int & held = blocks[id];
+			const int grow = std::min(blocksFor(cells) - held, free_blocks);
+			if (grow > 0) {
+				held += grow;
+				free_blocks -= grow;
+			}
+			return held * block_tokens;
+		}
 
-			{
-				std::unique_lock<std::mutex> lock(job->mtx);
-				job->cv.wait(lock, [&job] { return job->isFinished; });
+		void releaseBlocksLocked(int id) {
+			auto it = blocks.find(id);
+			if (it == blocks.end()) return;
+			free_blocks += it->second;
+			blocks.erase(it);
+		}
+
+		void releaseOwnerLocked(int id) {
+			auto it = owner.find(id);
+			if (it == owner.end()) return;
+			auto tenant = tenants.find(it->second);
+			if (tenant != tenants.end() && --tenant->second.held <= 0 && tenant->second.queue.empty()) {
+				tenants.erase(tenant);
 			}
+			owner.erase(it);
 		}
 
-		void embed(const EmbeddingParameters & /*params*/, std::shared_ptr<Job> job) override
+		void wipeLocked(int id) {
+			if (ctx) {
+				llama_memory_seq_rm(llama_get_memory(ctx), id, /*p0=*/0, /*p1=*/-1);
+			}
+			auto it = warm.find(id);
+			if (it != warm.end()) {
+				warm_by_key.erase(it->second.key);
+				warm.erase(it);
+			}
+			free_slots.push(id);
+		}
+
+		llama_context * ctx;
+		int max_slots;
+		int active_limit;	// setActiveLimit()
+		int waiting = 0;	// Callers blocked in allocate()
+		std::unordered_map<std::string, Tenant> tenants;	// With slots held or callers waiting
+		std::map<int, std::string>           owner;	// Tenant of each slot in use
+		uint64_t next_ticket = 0;
+		int block_tokens = 0;	// setBlockPool(); 0 without paged KV
+		int total_blocks = 0;
+		int free_blocks  = 0;
+		std::map<int, int>                   blocks;	// Blocks held by each slot in use
+		std::queue<int> free_slots;
+		std::set<int>   in_use;
+		std::map<int, WarmSlot>              warm;
+		std::map<std::string, int>           warm_by_key;
+		EvictHandler                         on_evict;
+		uint64_t clock = 0;
+		std::mutex mtx; std::condition_variable cv; bool terminated=false;
+	};
+
+	// Samplers outlive their jobs: a finished unconstrained job's sampler is reset and handed
+	// to the next job built with the same settings, which skips creating the chain and its
+	// vocabulary-sized candidate buffer. Constrained settings keep a never-sampled template
+	// instead, so a new sampler clones the parsed grammar rather than parsing it again, and a
+	// JSON schema is converted to GBNF once per schema text. Keys are the grammar plus the settings baked into
+	// a sampler (temperature, top-p, seed); the least recently used key is evicted first.
+	class SamplerPool {
+	public:
+		SamplerPool(size_t capacity, size_t max_idle)
+			: capacity(std::max<size_t>(1, capacity)), max_idle(max_idle) {}
+
+		~SamplerPool()
 		{
-			// This service handles only text/chat completion; embeddings are delegated to EmbeddingInferenceService
-			std::lock_guard<std::mutex> jobLock(job->mtx);
-			job->hasError = true;
-			job->errorMessage = "Embedding is not supported by this model/service";
-			job->isFinished = true;
-			job->cv.notify_all();
+			for (auto& entry : samplers) freeEntry(entry.second);
 		}
 
-		CompletionParameters formatChat(const ChatCompletionParameters& params) override
+		// GBNF for a JSON schema; throws what json_schema_to_grammar() throws
+		std::string schemaGrammar(const std::string& schema_text)
 		{
-			if (!params.isValid())
 			{
-				throw std::runtime_error("[INFERENCE] [CHATCOMPLETE] [ERROR] Invalid chat completion parameters\n");
+				std::lock_guard<std::mutex> lock(mtx);
+				auto it = grammars.find(schema_text);
+				if (it != grammars.end()) {
+					it->second.last_used = ++clock;
+					return it->second.gbnf;
+				}
 			}
-
-			// Format the chat messages into a single prompt
-			std::vector<common_chat_msg> messages;
-			for (const auto& msg : params.messages)
-			{
-				messages.push_back(common_chat_msg{ msg.role, msg.content });
+			std::string gbnf = json_schema_to_grammar(nlohmann::ordered_json::parse(schema_text), /*force_gbnf=*/true);
+			std::lock_guard<std::mutex> lock(mtx);
+			if (grammars.size() >= capacity) {
+				grammars.erase(std::min_element(grammars.begin(), grammars.end(),
+					[](const auto& a, const auto& b) { return a.second.last_used < b.second.last_used; }));
 			}
+			grammars[schema_text] = { gbnf, ++clock };
+			return gbnf;
+		}
 
-			std::string formatted;
+		// Written into the caller's string so a recycled job reuses its buffer
+		static void makeKey(const common_params_sampling& sparams, std::string& key)
+		{
+			key.assign(sparams.grammar);
+			key += '\0';
+			key += std::to_string(sparams.temp);
+			key += '\0';
+			key += std::to_string(sparams.top_p);
+			key += '\0';
+			key += std::to_string(sparams.seed);
+		}
 
-			formatted = tokenizer->applyTemplate(messages);
-			
-			CompletionParameters completionParams{
-				formatted.c_str(),
-				params.randomSeed,
-				params.maxNewTokens,
-				params.minLength,
-				params.temperature,
-				params.topP,
-				/*grammar*/ "",
-				/*jsonSchema*/ "",
-				params.streaming,
-				params.n_discard,
-				params.allow_context_shift,
-				params.kvCacheFilePath,
-				params.seqId
-			};
-			// Carry over grammar or jsonSchema
-			completionParams.grammar = params.grammar;
-			completionParams.jsonSchema = params.jsonSchema;
+		// A sampler in the state common_sampler_init(model, sparams) returns; null if the grammar is invalid
+		common_sampler* acquire(const llama_model* model, const common_params_sampling& sparams, const std::string& key)
+		{
+			std::unique_lock<std::mutex> lock(mtx);
+			auto it = samplers.find(key);
+			if (it != samplers.end()) {
+				Entry& entry = it->second;
+				entry.last_used = ++clock;
+				if (!entry.idle.empty()) {
+					common_sampler* sampler = entry.idle.back();
+					entry.idle.pop_back();
+					--n_idle;
+					lock.unlock();
+					common_sampler_reset(sampler);
+					return sampler;
+				}
+				if (entry.templ) {
+					return common_sampler_clone(entry.templ);
+				}
+			}
+			lock.unlock();
 
-			return completionParams;
+			if (sparams.grammar.empty()) {
+				return common_sampler_init(model, sparams);
+			}
+			common_sampler* templ = common_sampler_init(model, sparams);
+			if (!templ) return nullptr;
+			common_sampler* sampler = common_sampler_clone(templ);
+
+			lock.lock();
+			Entry& entry = entryLocked(key);
+			if (!entry.templ) {
+				entry.templ = templ;
+				templ = nullptr;
+			}
+			lock.unlock();
+			if (templ) common_sampler_free(templ);
+			return sampler;
+		}
+
+		// Takes back a job's sampler; freed when the pool already holds max_idle. Resetting a
+		// grammar sampler parses its grammar again, so constrained ones are always freed and
+		// their successors cloned from the template instead
+		void release(const std::string& key, common_sampler* sampler)
+		{
+			if (!sampler) return;
+			const bool constrained = key.empty() || key[0] != '\0';
+			if (!constrained) {
+				std::lock_guard<std::mutex> lock(mtx);
+				if (n_idle < max_idle) {
+					entryLocked(key).idle.push_back(sampler);
+					++n_idle;
+					return;
+				}
+			}
+			common_sampler_free(sampler);
 		}
 
 	private:
+		struct GrammarEntry { std::string gbnf; uint64_t last_used = 0; };
+		struct Entry {
+			common_sampler*					templ = nullptr;	// never sampled; cloned for constrained jobs
+			std::vector<common_sampler*>	idle;
+			uint64_t						last_used = 0;
+		};
+
+		Entry& entryLocked(const std::string& key)
+		{
+			auto it = samplers.find(key);
+			if (it == samplers.end()) {
+				if (samplers.size() >= capacity) {
+					auto oldest = std::min_element(samplers.begin(), samplers.end(),
+						[](const auto& a, const auto& b) { return a.second.last_used < b.second.last_used; });
+					n_idle -= oldest->second.idle.size();
+					freeEntry(oldest->second);
+					samplers.erase(oldest);
+				}
+				it = samplers.emplace(key, Entry()).first;
+			}
+			it->second.last_used = ++clock;
+			return it->second;
+		}
 
+		static void freeEntry(Entry& entry)
+		{
+			if (entry.templ) common_sampler_free(entry.templ);
+			for (common_sampler* sampler : entry.idle) common_sampler_free(sampler);
+			entry.templ = nullptr;
+			entry.idle.clear();
+		}
 
-#ifdef DEBUG
-		void printLogits(llama_context* ctx, size_t maxLogits = 10) {
-			// Get the logits after decoding
-			float* logits = llama_get_logits_ith(ctx, -1);
+		const size_t									capacity;
+		const size_t									max_idle;
+		std::mutex										mtx;
+		std::unordered_map<std::string, GrammarEntry>	grammars;
+		std::unordered_map<std::string, Entry>			samplers;
+		size_t											n_idle = 0;
+		uint64_t										clock = 0;
+	};
 
-			// Get vocabulary size (number of logits)
-			const int n_vocab = llama_vocab_n_tokens(tokenizer->getVocab());
+	// LoRA adapters registered with an engine. An adapter is read into memory the first time a
+	// step decodes with it and stays there, up to max_loaded at once; beyond that the least
+	// recently used one is freed. llama.cpp applies adapters to a whole context, so apply()
+	// switches the one every following decode uses.
+	// The name set is fixed at construction (has() is safe from any thread); everything else
+	// runs on the decode thread, and clear() must run before the model is released
+	class LoraAdapterCache {
+	public:
+		LoraAdapterCache(llama_model * model, const std::vector<LoraAdapterInfo>& adapters, int max_loaded)
+			: model(model), max_loaded(max_loaded > 0 ? static_cast<size_t>(max_loaded) : adapters.size())
+		{
+			for (const auto& info : adapters) {
+				entries.emplace(info.name, Entry{ info.path, info.scale });
+			}
+		}
 
-			std::cout << "\n----- Logits after decoding -----\n";
+		~LoraAdapterCache() { clear(); }
 
-			// Calculate some statistics
-			float min_logit = std::numeric_limits<float>::max();
-			float max_logit = std::numeric_limits<float>::lowest();
-			float sum_logit = 0.0f;
+		bool enabled() const { return !entries.empty(); }
+		bool has(const std::string& name) const { return entries.count(name) > 0; }
+		const std::string& current() const { return applied; }
 
-			for (int i = 0; i < n_vocab; i++) {
-				min_logit = std::min(min_logit, logits[i]);
-				max_logit = std::max(max_logit, logits[i]);
-				sum_logit += logits[i];
+		// Make `name` (empty = base model) the context's adapter, loading it first when needed
+		bool apply(llama_context * ctx, const std::string& name)
+		{
+			if (name == applied) return true;
+			if (name.empty()) {
+				llama_clear_adapter_lora(ctx);
+				applied.clear();
+				return true;
 			}
 
-			float mean_logit = sum_logit / n_vocab;
+			auto it = entries.find(name);
+			if (it == entries.end()) return false;
+			Entry& entry = it->second;
+			if (!entry.adapter) {
+				// detach the current adapter first so it can make room as well
+				llama_clear_adapter_lora(ctx);
+				applied.clear();
+				evictFor(name);
+				entry.adapter = llama_adapter_lora_init(model, entry.path.c_str());
+				if (!entry.adapter) {
+					std::cerr << "[INFERENCE] [ERROR] Failed to load LoRA adapter '" << name << "' from " << entry.path << std::endl;
+					return false;
+				}
+				++n_loaded;
+			}
+			entry.last_used = ++clock;
 
-			std::cout << "Vocab size: " << n_vocab << std::endl;
-			std::cout << "Min logit: " << min_logit << std::endl;
-			std::cout << "Max logit: " << max_logit << std::endl;
-			std::cout << "Mean logit: " << mean_logit << std::endl;
+			llama_clear_adapter_lora(ctx);
+			if (llama_set_adapter_lora(ctx, entry.adapter, entry.scale) != 0) {
+				applied.clear();
+				return false;
+			}
+			applied = name;
+			return true;
+		}
 
-			// Create vector of (token, logit) pairs for sorting
-			std::vector<std::pair<int, float>> token_logits;
-			for (int i = 0; i < n_vocab; i++) {
-				token_logits.push_back({ i, logits[i] });
+		void clear()
+		{
+			for (auto& [name, entry] : entries) {
+				if (entry.adapter) llama_adapter_lora_free(entry.adapter);
+				entry.adapter = nullptr;
 			}
+			n_loaded = 0;
+			applied.clear();
+		}
 
-			// Sort by logit value in descending order
-			std::sort(token_logits.begin(), token_logits.end(),
-				[](const auto& a, const auto& b) { return a.second > b.second; });
+	private:
+		struct Entry {
+			std::string				path;
+			float					scale = 1.0f;
+			llama_adapter_lora *	adapter = nullptr;
+			uint64_t				last_used = 0;
+		};
+
+		// Free least recently used adapters until `incoming` fits (none is applied by then)
+		void evictFor(const std::string& incoming)
+		{
+			while (n_loaded >= max_loaded) {
+				Entry * oldest = nullptr;
+				for (auto& [name, entry] : entries) {
+					if (!entry.adapter || name == incoming) continue;
+					if (!oldest || entry.last_used < oldest->last_used) oldest = &entry;
+				}
+				if (!oldest) return;
+				llama_adapter_lora_free(oldest->adapter);
+				oldest->adapter = nullptr;
+				--n_loaded;
+			}
+		}
 
-			// Print top N tokens with highest logits
-			std::cout << "\nTop " << maxLogits << " tokens:\n";
-			std::cout << "|--------|------------|---------------------------------|\n";
-			std::cout << "| Token  â Logit      â Text                            â\n";
-			std::cout << "|--------|------------|---------------------------------|\n";
+		llama_model *							model;
+		const size_t							max_loaded;
+		std::unordered_map<std::string, Entry>	entries;
+		std::string								applied;
+		size_t									n_loaded = 0;
+		uint64_t								clock = 0;
+	};
 
-			for (size_t i = 0; i < std::min(maxLogits, token_logits.size()); i++) {
-				int token_id = token_logits[i].first;
-				float token_logit = token_logits[i].second;
+	// Decode-loop settings from LoadingParameters that common_params has no field for
+	struct DecodeOptions {
+		int   prefix_cache_slots = 0;     // sequences reserved for the prompt-prefix cache
+		int   step_tokens        = 0;     // tokens per decode step (0 = n_batch)
+		float prefill_share      = 0.5f;  // share of a step prompts may take while generations run
+		float slo_ttft_ms        = 0.0f;  // p95 targets steering the SloController (0 = none)
+		float slo_tpot_ms        = 0.0f;
+		int   profile_steps      = 0;     // decode steps kept by the step profiler (0 = off)
+
+		// Speculative decoding; the service takes ownership of the draft model and context
+		llama_model *   draft_model   = nullptr;
+		llama_context * draft_context = nullptr;
+		int             n_draft       = 0;     // max draft tokens verified per target pass
+		bool            prompt_lookup = false; // draft from n-gram matches in the job's own tokens by default
+
+		// LoRA adapters requests may select, and how many stay loaded at once (0 = all)
+		std::vector<LoraAdapterInfo> lora_adapters;
+		int                          lora_max_loaded = 0;
+
+		// Tiers for conversations evicted from warm slots (0 disables a tier)
+		size_t                host_cache_bytes = 0;
+		size_t                disk_cache_bytes = 0;
+		std::filesystem::path disk_cache_dir;
+
+		// Prefix cache persisted across loads (empty dir disables); the tag names the model it belongs to
+		std::filesystem::path prefix_cache_dir;
+		std::string           prefix_cache_tag;
+		int                   prefix_cache_save_seconds = 0;
+
+		// Host RAM for precomputed document chunks (0 disables); one more sequence is reserved to splice them
+		size_t                chunk_cache_bytes = 0;
+
+		// Host RAM for the KV of jobs paused for higher-priority ones (0 disables preemption)
+		size_t                preempt_swap_bytes = 0;
+
+		// Paged KV: block size in tokens (0 = off) and the context one sequence may grow to (0 = n_ctx)
+		int                   kv_block_tokens = 0;
+		int                   max_seq_ctx     = 0;
+
+		// Sequences after the job slots that jobs are never handed
+		int reservedSeqs() const { return prefix_cache_slots + (chunk_cache_bytes > 0 ? 1 : 0); }
+	};
 
-				// Get the token text (you'll need to adapt this based on your tokenizer implementation)
-				std::string token_text = tokenizer->decode(token_id);
+	// Decoded prompt prefixes parked in reserved KV sequences (ids after the job slots).
+	// A job whose prompt starts with a cached prefix copies those cells into its own
+	// sequence with llama_memory_seq_cp instead of decoding them again, which needs a
+	// unified KV cache. Entries are matched by longest common token prefix and evicted
+	// least recently used first. Only touched from the decode thread.
+	class PrefixCache {
+	public:
+		PrefixCache(llama_context * ctx, int first_seq, int n_entries, size_t min_tokens)
+			: ctx(ctx), min_tokens(std::max<size_t>(min_tokens, 1)) {
+			for (int i = 0; i < n_entries; ++i) entries.push_back({ first_seq + i, {}, 0 });
+		}
 
-				// Escape special characters for display
-				std::string escaped_text = "";
-				for (char c : token_text) {
-					if (c == '\n') escaped_text += "\\n";
-					else if (c == '\r') escaped_text += "\\r";
-					else if (c == '\t') escaped_text += "\\t";
-					else if (c < 32 || c > 126) escaped_text += "Â·";
-					else escaped_text += c;
-				}
+		bool enabled() const { return ctx != nullptr && !entries.empty(); }
 
-				// Truncate if too long
-				if (escaped_text.length() > 31) {
-					escaped_text = escaped_text.substr(0, 28) + "...";
-				}
-
-				std::cout << "| " << std::setw(6) << token_id << " | "
-					<< std::setw(10) << std::fixed << std::setprecision(6) << token_logit << " | "
-					<< std::left << std::setw(31) << escaped_text << " |\n";
+		// Copy the longest cached prefix of `tokens` (capped at max_len) into dst_seq; returns its length
+		size_t restore(const std::vector<llama_token> & tokens, int dst_seq, size_t max_len) {
+			Entry * best = nullptr;
+			size_t best_len = 0;
+			for (auto & e : entries) {
+				const size_t n = commonPrefix(e.tokens, tokens);
+				if (n > best_len) { best = &e; best_len = n; }
 			}
+			best_len = std::min(best_len, max_len);
+			if (!best || best_len < min_tokens) return 0;
 
-			std::cout << "|--------|------------|---------------------------------|\n";
+			llama_memory_seq_cp(llama_get_memory(ctx), best->seq, dst_seq, 0, static_cast<llama_pos>(best_len));
+			best->lastUsed = ++clock;
+			return best_len;
 		}
-#endif
 
-		// Helper function to save long context to a file
-		std::string saveLongContextToFile(const std::string& prompt, int prompt_token_count, int job_id) {
-			try {
-				// Create directory if it doesn't exist
-				std::filesystem::path overflow_dir = "overflow_contexts";
-				if (!std::filesystem::exists(overflow_dir)) {
-					std::filesystem::create_directories(overflow_dir);
-				}
-				
-				// Generate filename with timestamp and job ID
-				auto now = std::chrono::system_clock::now();
-				auto timestamp = std::chrono::system_clock::to_time_t(now);
-				std::stringstream filename;
-				filename << "overflow_contexts/context_job" << job_id 
-						 << "_" << timestamp << "_" << prompt_token_count << "tokens.txt";
-				
-				// Write prompt to file
-				std::ofstream outfile(filename.str());
-				if (!outfile.is_open()) {
-					return "";
+		// Park tokens[0, n) decoded in src_seq; extends an entry it continues, otherwise replaces the LRU one
+		void store(const std::vector<llama_token> & tokens, size_t n, int src_seq) {
+			if (n < min_tokens || n > tokens.size()) return;
+
+			Entry * target = nullptr;
+			for (auto & e : entries) {
+				const size_t common = commonPrefix(e.tokens, tokens, n);
+				if (common == n) { e.lastUsed = ++clock; return; }	// already covered
+				if (!e.tokens.empty() && common == e.tokens.size()) { target = &e; break; }
+			}
+			if (!target) {
+				for (auto & e : entries) {
+					if (!target || e.lastUsed < target->lastUsed) target = &e;
 				}
-				
-				outfile << "=== Long Context Overflow ===" << std::endl;
-				outfile << "Job ID: " << job_id << std::endl;
-				outfile << "Timestamp: " << std::ctime(&timestamp);
-				outfile << "Token Count: " << prompt_token_count << std::endl;
-				outfile << "Context Window: " << n_ctx << std::endl;
-				outfile << "================================" << std::endl << std::endl;
-				outfile << prompt;
-				outfile.close();
-				
-				// Return filename (caller will log if needed)
-				return filename.str();
-			} catch (const std::exception& e) {
-				std::cerr << "[INFERENCE] [ERROR] Failed to save long context: " << e.what() << std::endl;
-				return "";
 			}
+
+			auto * mem = llama_get_memory(ctx);
+			llama_memory_seq_rm(mem, target->seq, /*p0=*/0, /*p1=*/-1);
+			llama_memory_seq_cp(mem, src_seq, target->seq, 0, static_cast<llama_pos>(n));
+			target->tokens.assign(tokens.begin(), tokens.begin() + n);
+			target->lastUsed = ++clock;
+			++changes;
 		}
 
-		// Helper function to truncate tokens using StreamingLLM pattern
-		// Keeps n_keep initial tokens + recent tokens, discards middle
-		std::string truncateContextTokens(const std::vector<llama_token>& tokens, int target_size, int job_id) {
-			if (static_cast<int>(tokens.size()) <= target_size) {
-				// No truncation needed
-				return tokenizer->detokenize(tokens);
-			}
-			
-			// Calculate how many recent tokens to keep
-			// Reserve space for n_keep initial tokens and generation
-			int keep_initial = n_keep;
-			int keep_recent = target_size - keep_initial;
-			
-			if (keep_recent <= 0) {
-				// Fallback: just keep the first target_size tokens
-				std::vector<llama_token> truncated(tokens.begin(), tokens.begin() + target_size);
-				std::cerr << "[INFERENCE] [INFO] Context truncated from " << tokens.size() 
-						  << " to " << target_size << " tokens (first tokens only)" << std::endl;
-				return tokenizer->detokenize(truncated);
+		// Load a prefix saved by an earlier run into a free (else the least recently used) entry;
+		// false when the state does not fit this context
+		bool load(const SessionSnapshot & snapshot) {
+			if (snapshot.tokens.size() < min_tokens) return false;
+
+			Entry * target = nullptr;
+			for (auto & e : entries) {
+				if (!target || e.lastUsed < target->lastUsed) target = &e;
 			}
-			
-			// StreamingLLM pattern: keep initial + recent
-			std::vector<llama_token> truncated;
-			truncated.reserve(keep_initial + keep_recent);
-			
-			// Add initial tokens (attention sinks)
-			truncated.insert(truncated.end(), tokens.begin(), tokens.begin() + keep_initial);
-			
-			// Add recent tokens
-			int recent_start = tokens.size() - keep_recent;
-			truncated.insert(truncated.end(), tokens.begin() + recent_start, tokens.end());
-			
-			int discarded = tokens.size() - truncated.size();
-			std::cerr << "[INFERENCE] [INFO] Context automatically shifted: kept " << keep_initial 
-					  << " initial + " << keep_recent << " recent tokens, discarded " 
-					  << discarded << " middle tokens (total: " << tokens.size() 
-					  << " -> " << truncated.size() << ")" << std::endl;
-			
-			return tokenizer->detokenize(truncated);
+			if (!target) return false;
+
+			llama_memory_seq_rm(llama_get_memory(ctx), target->seq, /*p0=*/0, /*p1=*/-1);
+			target->tokens.clear();
+			target->lastUsed = 0;
+			if (llama_state_seq_set_data(ctx, snapshot.state.data(), snapshot.state.size(), target->seq) == 0) return false;
+			target->tokens = snapshot.tokens;
+			target->lastUsed = ++clock;
+			++changes;
+			return true;
 		}
 
-		bool validateParameters(CompletionParameters& params, std::shared_ptr<Job> job) {
-			if (!params.isValid()) {
-				std::lock_guard<std::mutex> jobLock(job->mtx);
-				job->hasError = true;
-				job->errorMessage = "Invalid completion parameters";
-				job->cv.notify_all();
-				return false;
+		// Sequence and tokens of every filled entry, most recently used first
+		std::vector<std::pair<int, std::vector<llama_token>>> cached() const {
+			std::vector<const Entry *> filled;
+			for (const auto & e : entries) {
+				if (!e.tokens.empty()) filled.push_back(&e);
 			}
-			
-			// Tokenize the prompt to check size before processing
-			if (!params.prompt.empty()) {
-				std::vector<llama_token> temp_tokens = tokenizer->tokenize(params.prompt, tokenizer->shouldAddBos());
-				int prompt_token_count = static_cast<int>(temp_tokens.size());
-				int generation_tokens = params.maxNewTokens > 0 ? params.maxNewTokens : 512; // Default estimate
-				int total_required = prompt_token_count + generation_tokens;
-				
-#ifdef DEBUG
-				// Save every prompt to file for logging/debugging (DEBUG builds only)
-				std::string saved_file = saveLongContextToFile(params.prompt, prompt_token_count, job->jobId);
-				if (!saved_file.empty()) {
-					std::cerr << "[INFERENCE] [INFO] Prompt saved (" << prompt_token_count 
-							  << " tokens) to: " << saved_file << std::endl;
+			std::sort(filled.begin(), filled.end(), [](const Entry * a, const Entry * b) { return a->lastUsed > b->lastUsed; });
+			std::vector<std::pair<int, std::vector<llama_token>>> out;
+			for (const Entry * e : filled) out.emplace_back(e->seq, e->tokens);
+			return out;
+		}
+
+		size_t capacity() const { return entries.size(); }
+
+		// Advances whenever an entry is stored, replaced or evicted
+		uint64_t version() const { return changes; }
+
+		// Evict least recently used entries until at most `budget` cells stay pinned
+		void trim(size_t budget) {
+			while (pinnedTokens() > budget) {
+				Entry * victim = nullptr;
+				for (auto & e : entries) {
+					if (!e.tokens.empty() && (!victim || e.lastUsed < victim->lastUsed)) victim = &e;
 				}
-#endif
-				
-				// Check if prompt alone exceeds context
-				if (prompt_token_count >= n_ctx) {
-					// If context shifting is allowed, truncate the prompt
-					if (params.allow_context_shift) {
-						// Calculate target size conservatively
-						// Account for potential KV cache state from slot reuse in test environments
-						// Use ~40% of context for prompt to leave room for generation + cached state
-						int target_prompt_tokens = (n_ctx * 2) / 5;  // 40% of context
-						
-						if (target_prompt_tokens < 256) {
-							// Context window too small for shifting
-							std::lock_guard<std::mutex> jobLock(job->mtx);
-							job->hasError = true;
-							job->errorMessage = "Context window too small for automatic shifting";
-							job->isFinished = true;
-							job->cv.notify_all();
-							return false;
-						}
-						
-						// Truncate using StreamingLLM pattern
-						params.prompt = truncateContextTokens(temp_tokens, target_prompt_tokens, job->jobId);
-						
-						std::cerr << "[INFERENCE] [INFO] Context shift enabled. Original prompt: " 
-								  << prompt_token_count << " tokens, truncated to ~" << target_prompt_tokens 
-								  << " to fit " << n_ctx << " context window" << std::endl;
-						
-						// Re-tokenize to verify
-						temp_tokens = tokenizer->tokenize(params.prompt, tokenizer->shouldAddBos());
-						prompt_token_count = static_cast<int>(temp_tokens.size());
-						total_required = prompt_token_count + generation_tokens;
-					} else {
-						// Context shifting not enabled
-						std::lock_guard<std::mutex> jobLock(job->mtx);
-						job->hasError = true;
-						job->errorMessage = "Prompt too long for context window. Prompt tokens: " + 
-										   std::to_string(prompt_token_count) + 
-										   ", Context size: " + std::to_string(n_ctx) + 
-										   ". Please reduce prompt length or enable allow_context_shift.";
-						job->isFinished = true;
-						job->cv.notify_all();
-						std::cerr << "[INFERENCE] [ERROR] " << job->errorMessage << std::endl;
-						return false;
+				if (!victim) break;
+				llama_memory_seq_rm(llama_get_memory(ctx), victim->seq, /*p0=*/0, /*p1=*/-1);
+				victim->tokens.clear();
+				victim->lastUsed = 0;
+				++changes;
+			}
+		}
+
+		size_t pinnedTokens() const {
+			size_t total = 0;
+			for (const auto & e : entries) total += e.tokens.size();
+			return total;
+		}
+
+	private:
+		struct Entry {
+			int                      seq;
+			std::vector<llama_token> tokens;
+			uint64_t                 lastUsed;
+		};
+
+		static size_t commonPrefix(const std::vector<llama_token> & a, const std::vector<llama_token> & b,
+			size_t limit = SIZE_MAX) {
+			const size_t n = std::min({ a.size(), b.size(), limit });
+			size_t i = 0;
+			while (i < n && a[i] == b[i]) ++i;
+			return i;
+		}
+
+		llama_context *    ctx;
+		size_t             min_tokens;
+		std::vector<Entry> entries;
+		uint64_t           clock = 0;
+		uint64_t           changes = 0;
+	};
+
+	// Document chunks decoded on their own by precomputeChunk(), kept as host-RAM KV snapshots
+	// whose cells sit at positions 0..n-1. A prompt is searched for each chunk's tokens without
+	// the first and last, which may merge with the surrounding text when the prompt is
+	// tokenized; that interior is what gets spliced. Entries are indexed by a hash of their
+	// first kKeyTokens interior tokens and evicted least recently used first beyond the byte
+	// budget. Only touched from the decode thread.
+	class ChunkKvCache {
+	public:
+		static constexpr size_t kKeyTokens = 8;
+		static constexpr size_t kMinTokens = kKeyTokens + 8;	// shorter chunks decode faster than they splice
+
+		explicit ChunkKvCache(size_t budget) : budget(budget) {}
+
+		bool enabled() const { return budget > 0; }
+
+		bool contains(const std::vector<llama_token> & tokens) const {
+			if (tokens.size() < kMinTokens) return false;
+			const auto range = index.equal_range(key(tokens.data() + 1));
+			for (auto it = range.first; it != range.second; ++it) {
+				if ((*it->second)->tokens == tokens) return true;
+			}
+			return false;
+		}
+
+		// Keep a chunk, evicting the least recently used ones to stay within the budget
+		void put(std::shared_ptr<const SessionSnapshot> chunk) {
+			const size_t size = chunk->state.size();
+			if (chunk->tokens.size() < kMinTokens || size > budget) return;
+			while (!lru.empty() && bytes + size > budget) evict(std::prev(lru.end()));
+			lru.push_front(std::move(chunk));
+			index.emplace(key(lru.front()->tokens.data() + 1), lru.begin());
+			bytes += size;
+		}
+
+		// Cached chunks whose interior appears in tokens[from, to), left to right without
+		// overlapping; the longest wins where several start at the same token
+		std::vector<Job::ChunkSplice> find(const std::vector<llama_token> & tokens, size_t from, size_t to) {
+			std::vector<Job::ChunkSplice> found;
+			to = std::min(to, tokens.size());
+			for (size_t i = from; i + kKeyTokens <= to;) {
+				const auto range = index.equal_range(key(tokens.data() + i));
+				Entries::iterator best = lru.end();
+				size_t best_len = 0;
+				for (auto it = range.first; it != range.second; ++it) {
+					const auto & chunk = (*it->second)->tokens;
+					const size_t len = chunk.size() - 2;
+					if (len > best_len && i + len <= to && std::equal(chunk.begin() + 1, chunk.end() - 1, tokens.begin() + i)) {
+						best = it->second;
+						best_len = len;
 					}
 				}
-				
-				// Check if prompt + generation would exceed context (accounting for n_keep)
-				if (total_required > n_ctx - n_keep) {
-					if (params.allow_context_shift && prompt_token_count < n_ctx) {
-						// Reduce generation tokens to fit
-						int available_for_generation = n_ctx - prompt_token_count - n_keep;
-						if (available_for_generation > 0) {
-							std::cerr << "[INFERENCE] [INFO] Adjusting maxNewTokens from " 
-									  << params.maxNewTokens << " to " << available_for_generation 
-									  << " to fit context window" << std::endl;
-							params.maxNewTokens = available_for_generation;
-						} else {
-							// Need to truncate prompt further
-							int target_prompt_tokens = n_ctx - params.maxNewTokens - n_keep;
-							params.prompt = truncateContextTokens(temp_tokens, target_prompt_tokens, job->jobId);
-						}
-					} else {
-						// Prompt + generation exceeds context
-						std::lock_guard<std::mutex> jobLock(job->mtx);
-						job->hasError = true;
-						job->errorMessage = "Prompt + generation tokens (" + std::to_string(total_required) + 
-										   ") exceed context window (" + std::to_string(n_ctx) + 
-										   "). Prompt: " + std::to_string(prompt_token_count) + 
-										   " tokens, Requested generation: " + std::to_string(generation_tokens) + 
-										   " tokens. Please reduce prompt or maxNewTokens, or enable allow_context_shift.";
-						job->isFinished = true;
-						job->cv.notify_all();
-						std::cerr << "[INFERENCE] [ERROR] " << job->errorMessage << std::endl;
-						return false;
-					}
+				if (best == lru.end()) {
+					++i;
+					continue;
 				}
-				
-				// Warn if getting close to limit (>80% usage)
-				if (total_required > (n_ctx * 0.8)) {
-					std::cerr << "[INFERENCE] [WARNING] High context usage: " << total_required 
-							  << " / " << n_ctx << " tokens (" 
-							  << (total_required * 100 / n_ctx) << "%). Generation may be limited." << std::endl;
+				lru.splice(lru.begin(), lru, best);
+				found.push_back({ static_cast<int>(i), *best });
+				i += best_len;
+			}
+			return found;
+		}
+
+		size_t entries() const { return lru.size(); }
+		size_t usedBytes() const { return bytes; }
+
+	private:
+		using Entries = std::list<std::shared_ptr<const SessionSnapshot>>;
+
+		// FNV-1a over kKeyTokens token ids
+		static uint64_t key(const llama_token * tokens) {
+			uint64_t h = 14695981039346656037ull;
+			for (size_t i = 0; i < kKeyTokens; ++i) {
+				h = (h ^ static_cast<uint32_t>(tokens[i])) * 1099511628211ull;
+			}
+			return h;
+		}
+
+		void evict(Entries::iterator it) {
+			const auto range = index.equal_range(key((*it)->tokens.data() + 1));
+			for (auto entry = range.first; entry != range.second; ++entry) {
+				if (entry->second == it) {
+					index.erase(entry);
+					break;
 				}
 			}
-			
-			return true;
+			bytes -= (*it)->state.size();
+			lru.erase(it);
 		}
 
-		common_sampler* initializeSampler(const CompletionParameters& params, std::shared_ptr<Job> job) {
-			auto sparams = g_params.sampling;
-			sparams.top_p = params.topP;
-			sparams.temp = params.temperature;
-			sparams.seed = params.randomSeed;
-			// sparams.top_k = params.topK;
-			sparams.no_perf = false;
+		size_t                                                budget;
+		size_t                                                bytes = 0;
+		Entries                                               lru;	// most recently used first
+		std::unordered_multimap<uint64_t, Entries::iterator>  index;
+	};
 
-			// Handle grammar or JSON schema -> grammar
-			try {
-				if (!params.jsonSchema.empty()) {
-					auto schema = nlohmann::ordered_json::parse(params.jsonSchema);
-					std::string gbnf = json_schema_to_grammar(schema, /*force_gbnf=*/true);
-					sparams.grammar = gbnf; // copies string into sampling params
-				} else if (!params.grammar.empty()) {
-					sparams.grammar = params.grammar;
+	// Token ids of chat template segments, the text each message adds to the rendered history.
+	// A segment is keyed by a hash chained over the role and content of every message up to its
+	// last one, so it is only reused after the same history and earlier turns come out as the
+	// same tokens each time, in line with the KV they left in a warm slot or the prefix cache.
+	// A segment usually covers one message; a long history seen for the first time is split
+	// only into its last kMaxSplit messages, the rest forming one segment. Least recently used
+	// segments are evicted beyond kMaxTokens. Shared by the submitting threads.
+	class ChatSegmentCache {
+	public:
+		static constexpr size_t kMaxSplit = 16;
+		static constexpr size_t kMaxTokens = 1u << 20;
+
+		struct Segment {
+			size_t                   first = 0;		// First message it renders
+			std::string              text;
+			std::vector<llama_token> tokens;
+		};
+
+		// Key of the segment ending at each message: FNV-1a over its role and content, seeded
+		// with the previous message's key
+		static std::vector<uint64_t> chain(const std::vector<common_chat_msg> & messages) {
+			std::vector<uint64_t> keys;
+			keys.reserve(messages.size());
+			uint64_t h = 14695981039346656037ull;
+			const auto mix = [&h](const std::string & text) {
+				for (unsigned char c : text) h = (h ^ c) * 1099511628211ull;
+				h = (h ^ 0x1fu) * 1099511628211ull;
+			};
+			for (const auto & message : messages) {
+				mix(message.role);
+				mix(message.content);
+				keys.push_back(h);
+			}
+			return keys;
+		}
+
+		// The segment ending at the message of `key` and starting at message `first`, if cached
+		std::shared_ptr<const Segment> find(uint64_t key, size_t first) {
+			std::lock_guard<std::mutex> lock(mtx);
+			auto it = index.find(key);
+			if (it == index.end() || it->second->second->first != first) return nullptr;
+			lru.splice(lru.begin(), lru, it->second);
+			return it->second->second;
+		}
+
+		void put(uint64_t key, std::shared_ptr<const Segment> segment) {
+			if (segment->tokens.size() > kMaxTokens) return;
+			std::lock_guard<std::mutex> lock(mtx);
+			auto it = index.find(key);
+			if (it != index.end()) evict(it->second);
+			while (!lru.empty() && tokens + segment->tokens.size() > kMaxTokens) evict(std::prev(lru.end()));
+			tokens += segment->tokens.size();
+			lru.emplace_front(key, std::move(segment));
+			index[key] = lru.begin();
+		}
+
+	private:
+		using Entries = std::list<std::pair<uint64_t, std::shared_ptr<const Segment>>>;
+
+		void evict(Entries::iterator it) {
+			tokens -= it->second->tokens.size();
+			index.erase(it->first);
+			lru.erase(it);
+		}
+
+		std::mutex                                      mtx;
+		size_t                                          tokens = 0;
+		Entries                                         lru;	// most recently used first
+		std::unordered_map<uint64_t, Entries::iterator> index;
+	};
+
+	// Content-addressed store of the blocks session files are made of. A sequence state is cut
+	// at content-defined boundaries (a gear rolling hash), so the KV rows of a prompt prefix
+	// that many sessions share land in the same blocks although their offsets in each state
+	// differ. Each block is kept once, deflated when zlib is available, in a .kv-blocks
+	// directory beside the session files, which then hold only their tokens and block hashes.
+	// Recently read blocks stay decompressed in memory for the next session that shares them.
+	class SessionBlocks {
+	public:
+		struct Hash {
+			uint64_t hi = 0;
+			uint64_t lo = 0;
+			bool operator==(const Hash& other) const { return hi == other.hi && lo == other.lo; }
+		};
+		struct Ref {
+			Hash		hash;
+			uint64_t	bytes = 0;
+		};
+
+		static constexpr uint32_t kManifestMagic   = 0x4D42564Bu;	// "KVBM"
+		static constexpr uint32_t kManifestVersion = 1;
+
+		static std::filesystem::path directoryFor(const std::string& path)
+		{
+			const std::filesystem::path parent = std::filesystem::path(path).parent_path();
+			return (parent.empty() ? std::filesystem::path(".") : parent) / ".kv-blocks";
+		}
+
+		// Splits data into blocks and writes the ones dir does not hold yet
+		static bool put(const std::filesystem::path& dir, const std::vector<uint8_t>& data, std::vector<Ref>& refs)
+		{
+			std::error_code ec;
+			std::filesystem::create_directories(dir, ec);
+			if (ec) return false;
+			for (size_t begin = 0; begin < data.size();) {
+				const size_t end = boundary(data, begin);
+				const Ref ref{ hashOf(data.data() + begin, end - begin), end - begin };
+				if (!writeBlock(dir, ref, data.data() + begin)) return false;
+				refs.push_back(ref);
+				begin = end;
+			}
+			return true;
+		}
+
+		// Reassembles a state from its blocks
+		bool get(const std::filesystem::path& dir, const std::vector<Ref>& refs, std::vector<uint8_t>& data)
+		{
+			uint64_t total = 0;
+			for (const auto& ref : refs) total += ref.bytes;
+			data.clear();
+			data.reserve(static_cast<size_t>(total));
+			for (const auto& ref : refs) {
+				std::shared_ptr<const std::vector<uint8_t>> block = cached(ref.hash);
+				if (!block) {
+					block = readBlock(dir, ref);
+					if (!block) return false;
+					remember(ref.hash, block);
 				}
-			} catch (const std::exception &e) {
-				std::lock_guard<std::mutex> jobLock(job->mtx);
-				job->hasError = true;
-				job->errorMessage = std::string("Failed to prepare grammar: ") + e.what();
-				job->cv.notify_all();
-				return nullptr;
+				data.insert(data.end(), block->begin(), block->end());
 			}
+			return true;
+		}
 
-			common_sampler* sampler = common_sampler_init(model, sparams);
-			if (!sampler) {
-				std::lock_guard<std::mutex> jobLock(job->mtx);
-				job->hasError = true;
-				job->errorMessage = "Could not initialize sampler";
-				job->cv.notify_all();
-				return nullptr;
+		// Tokens and block list of a session file; false if path is not one
+		static bool readManifest(const std::filesystem::path& path, std::vector<llama_token>* tokens, std::vector<Ref>& refs)
+		{
+			std::ifstream in(path, std::ios::binary | std::ios::ate);
+			if (!in) return false;
+			const uint64_t size = static_cast<uint64_t>(in.tellg());
+			in.seekg(0);
+			uint32_t header[4] = {};
+			if (!in.read(reinterpret_cast<char*>(header), sizeof(header)) || header[0] != kManifestMagic ||
+				header[1] != kManifestVersion ||
+				size != sizeof(header) + uint64_t(header[2]) * sizeof(llama_token) + uint64_t(header[3]) * 3 * sizeof(uint64_t)) {
+				return false;
 			}
-			return sampler;
+			if (tokens) {
+				tokens->resize(header[2]);
+				in.read(reinterpret_cast<char*>(tokens->data()), static_cast<std::streamsize>(header[2] * sizeof(llama_token)));
+			}
+			else {
+				in.seekg(static_cast<std::streamoff>(header[2]) * sizeof(llama_token), std::ios::cur);
+			}
+			refs.resize(header[3]);
+			for (auto& ref : refs) {
+				uint64_t fields[3];
+				if (!in.read(reinterpret_cast<char*>(fields), sizeof(fields)) || fields[2] == 0 || fields[2] > kMaxBlock) return false;
+				ref = { { fields[0], fields[1] }, fields[2] };
+			}
+			return static_cast<bool>(in);
 		}
 
-		bool loadSession(std::shared_ptr<Job> job) {
-			if (!job->path_session.empty()) {
-				// Use the logical session id from params for file-backed sessions
-				const int session_seq = job->params.seqId;
-				if (!load_kv_cache(job->path_session, job->session_tokens, session_seq)) {
-					std::cerr << "[INFERENCE] [ERROR] Failed to load KV cache from: " 
-							  << job->path_session << std::endl;
-					return false;
+		static bool writeManifest(std::ostream& out, const std::vector<llama_token>& tokens, const std::vector<Ref>& refs)
+		{
+			const uint32_t header[4] = { kManifestMagic, kManifestVersion,
+				static_cast<uint32_t>(tokens.size()), static_cast<uint32_t>(refs.size()) };
+			out.write(reinterpret_cast<const char*>(header), sizeof(header));
+			out.write(reinterpret_cast<const char*>(tokens.data()), static_cast<std::streamsize>(tokens.size() * sizeof(llama_token)));
+			for (const auto& ref : refs) {
+				const uint64_t fields[3] = { ref.hash.hi, ref.hash.lo, ref.bytes };
+				out.write(reinterpret_cast<const char*>(fields), sizeof(fields));
+			}
+			return static_cast<bool>(out);
+		}
+
+		// Deletes the blocks in dir that no session file beside it references any more. Blocks
+		// younger than kSweepGrace stay: another process may still be writing their session.
+		static void sweep(const std::filesystem::path& dir)
+		{
+			std::unordered_set<std::string> live;
+			std::error_code ec;
+			for (std::filesystem::directory_iterator it(dir.parent_path(), ec), end; !ec && it != end; it.increment(ec)) {
+				std::vector<Ref> refs;
+				if (it->is_regular_file(ec) && readManifest(it->path(), nullptr, refs)) {
+					for (const auto& ref : refs) live.insert(fileName(ref.hash));
 				}
-				
-				// CRITICAL FIX: After loading session, validate against new prompt size
-				if (!job->params.prompt.empty()) {
-					// Estimate new prompt token count
-					std::vector<llama_token> temp_prompt_tokens = tokenizer->tokenize(
-						job->params.prompt, tokenizer->shouldAddBos());
-					int session_token_count = static_cast<int>(job->session_tokens.size());
-					int new_prompt_tokens = static_cast<int>(temp_prompt_tokens.size());
-					int total_tokens = session_token_count + new_prompt_tokens;
-					
-					if (total_tokens >= n_ctx) {
-						// Save the combined context to a file
-						std::stringstream combined_context;
-						combined_context << "=== Session Context ===" << std::endl;
+			}
+			if (ec) return;		// An unreadable directory could hide live sessions
+
+			const auto now = std::filesystem::file_time_type::clock::now();
+			size_t removed = 0;
+			for (std::filesystem::directory_iterator it(dir, ec), end; !ec && it != end; it.increment(ec)) {
+				const std::string name = it->path().filename().string();
+				if (live.count(name)) continue;
+				std::error_code file_ec;
+				const auto written = std::filesystem::last_write_time(it->path(), file_ec);
+				if (!file_ec && now - written > kSweepGrace && std::filesystem::remove(it->path(), file_ec)) ++removed;
+			}
+			if (removed > 0) {
+				std::cerr << "[KV] Removed " << removed << " unreferenced session blocks from " << dir.string() << std::endl;
+			}
+		}
+
+	private:
+		static constexpr size_t   kMinBlock      = 64 * 1024;
+		static constexpr size_t   kMaxBlock      = 1024 * 1024;
+		static constexpr int      kBoundaryBits  = 18;		// ~256 KiB blocks on average
+		static constexpr uint32_t kBlockMagic    = 0x4B42564Bu;	// "KVBK"
+		static constexpr uint32_t kRaw           = 0;
+		static constexpr uint32_t kDeflate       = 1;
+		static constexpr size_t   kCacheBytes    = 64ull << 20;
+		static constexpr auto     kSweepGrace    = std::chrono::minutes(10);
+
+		struct HashKey {
+			size_t operator()(const Hash& hash) const { return static_cast<size_t>(hash.hi ^ hash.lo); }
+		};
+		using Cached = std::list<std::pair<Hash, std::shared_ptr<const std::vector<uint8_t>>>>;
+
+		// Fixed pseudo-random table, the same in every build, so boundaries stay stable across restarts
+		static const std::array<uint64_t, 256>& gear()
+		{
+			static const std::array<uint64_t, 256> table = [] {
+				std::array<uint64_t, 256> values{};
+				uint64_t state = 0x9e3779b97f4a7c15ull;
+				for (auto& value : values) {
+					uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+					z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+					z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+					value = z ^ (z >> 31);
+				}
+				return values;
+			}();
+			return table;
+		}
+
+		// End of the block starting at begin: the first position past kMinBlock where the top
+		// bits of the rolling hash of the last 64 bytes are zero, or kMaxBlock
+		static size_t boundary(const std::vector<uint8_t>& data, size_t begin)
+		{
+			const auto& table = gear();
+			const size_t end = std::min(data.size(), begin + kMaxBlock);
+			uint64_t h = 0;
+			for (size_t i = std::min(end, begin + kMinBlock); i < end; ++i) {
+				h = (h << 1) + table[data[i]];
+				if ((h >> (64 - kBoundaryBits)) == 0) return i + 1;
+			}
+			return end;
+		}
+
+		static uint64_t mix(uint64_t x)
+		{
+			x ^= x >> 33;
+			x *= 0xff51afd7ed558ccdull;
+			x ^= x >> 33;
+			x *= 0xc4ceb9fe1a85ec53ull;
+			return x ^ (x >> 33);
+		}
+
+		// 128 bits from two independently mixed lanes; a collision would splice in foreign KV
+		static Hash hashOf(const uint8_t* data, size_t size)
+		{
+			uint64_t hi = 0x243f6a8885a308d3ull ^ size;
+			uint64_t lo = 0x13198a2e03707344ull;
+			for (size_t i = 0; i < size; i += 8) {
+				uint64_t word = 0;
+				std::memcpy(&word, data + i, std::min<size_t>(8, size - i));
+				hi = mix(hi ^ word);
+				lo = (lo ^ (word * 0x87c37b91114253d5ull));
+				lo = ((lo << 31) | (lo >> 33)) * 0x4cf5ad432745937full;
+			}
+			return { hi, mix(lo ^ size) };
+		}
+
+		static std::string fileName(const Hash& hash)
+		{
+			char name[40];
+			std::snprintf(name, sizeof(name), "%016llx%016llx.blk",
+				static_cast<unsigned long long>(hash.hi), static_cast<unsigned long long>(hash.lo));
+			return name;
+		}
+
+		static bool writeBlock(const std::filesystem::path& dir, const Ref& ref, const uint8_t* data)
+		{
+			const std::filesystem::path file = dir / fileName(ref.hash);
+			std::error_code ec;
+			if (std::filesystem::exists(file, ec)) {
+				// Already stored by another session; refresh it so a sweep sees it in use
+				std::filesystem::last_write_time(file, std::filesystem::file_time_type::clock::now(), ec);
+				return true;
+			}
+
+			uint32_t codec = kRaw;
+			const uint8_t* body = data;
+			size_t body_size = static_cast<size_t>(ref.bytes);
+#ifdef INFERENCE_USE_ZLIB
+			uLongf packed_size = compressBound(static_cast<uLong>(ref.bytes));
+			std::vector<uint8_t> packed(packed_size);
+			if (compress2(packed.data(), &packed_size, data, static_cast<uLong>(ref.bytes), Z_BEST_SPEED) == Z_OK &&
+				packed_size < ref.bytes) {
+				codec = kDeflate;
+				body = packed.data();
+				body_size = packed_size;
+			}
+#endif
+			// Unique temporary name: several engines may store the same block at once
+			const std::filesystem::path tmp = file.string() + "." +
+				std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+			{
+				std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+				const uint32_t header[2] = { kBlockMagic, codec };
+				out.write(reinterpret_cast<const char*>(header), sizeof(header));
+				out.write(reinterpret_cast<const char*>(&ref.bytes), sizeof(ref.bytes));
+				out.write(reinterpret_cast<const char*>(body), static_cast<std::streamsize>(body_size));
+				if (!out) {
+					out.close();
+					std::filesystem::remove(tmp, ec);
+					return false;
+				}
+			}
+			std::filesystem::rename(tmp, file, ec);
+			if (ec) {
+				std::filesystem::remove(tmp, ec);
+				return std::filesystem::exists(file, ec);
+			}
+			return true;
+		}
+
+		static std::shared_ptr<const std::vector<uint8_t>> readBlock(const std::filesystem::path& dir, const Ref& ref)
+		{
+			std::ifstream in(dir / fileName(ref.hash), std::ios::binary | std::ios::ate);
+			if (!in) return nullptr;
+			const std::streamoff size = in.tellg();
+			in.seekg(0);
+			uint32_t header[2] = {};
+			uint64_t bytes = 0;
+			constexpr std::streamoff kHeaderBytes = sizeof(header) + sizeof(bytes);
+			if (size < kHeaderBytes || !in.read(reinterpret_cast<char*>(header), sizeof(header)) ||
+				!in.read(reinterpret_cast<char*>(&bytes), sizeof(bytes)) || header[0] != kBlockMagic || bytes != ref.bytes) {
+				return nullptr;
+			}
+			std::vector<uint8_t> body(static_cast<size_t>(size - kHeaderBytes));
+			if (!in.read(reinterpret_cast<char*>(body.data()), static_cast<std::streamsize>(body.size()))) return nullptr;
+
+			auto block = std::make_shared<std::vector<uint8_t>>();
+			if (header[1] == kRaw) {
+				*block = std::move(body);
+			}
+#ifdef INFERENCE_USE_ZLIB
+			else if (header[1] == kDeflate) {
+				block->resize(static_cast<size_t>(bytes));
+				uLongf unpacked = static_cast<uLongf>(bytes);
+				if (uncompress(block->data(), &unpacked, body.data(), static_cast<uLong>(body.size())) != Z_OK) return nullptr;
+			}
+#endif
+			else {
+				return nullptr;
+			}
+			if (block->size() != ref.bytes || !(hashOf(block->data(), block->size()) == ref.hash)) return nullptr;
+			return block;
+		}
+
+		std::shared_ptr<const std::vector<uint8_t>> cached(const Hash& hash)
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			auto it = index.find(hash);
+			if (it == index.end()) return nullptr;
+			lru.splice(lru.begin(), lru, it->second);
+			return it->second->second;
+		}
+
+		void remember(const Hash& hash, std::shared_ptr<const std::vector<uint8_t>> block)
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			if (index.count(hash) || block->size() > kCacheBytes) return;
+			cache_bytes += block->size();
+			lru.emplace_front(hash, std::move(block));
+			index[hash] = lru.begin();
+			while (cache_bytes > kCacheBytes) {
+				cache_bytes -= lru.back().second->size();
+				index.erase(lru.back().first);
+				lru.pop_back();
+			}
+		}
+
+		std::mutex									mtx;
+		Cached										lru;	// most recently used first
+		std::unordered_map<Hash, Cached::iterator, HashKey> index;
+		size_t										cache_bytes = 0;
+	};
+
+	// Persists kvCacheFilePath sessions on a background thread. The decode loop only
+	// copies the sequence state into memory; loads are read on the submitting thread
+	// and see snapshots that are still waiting to be written. Files hold the tokens and
+	// the SessionBlocks their state is stored in; files of the plain llama format still load.
+	class SessionStore {
+	public:
+		SessionStore() : writer(&SessionStore::run, this) {}
+
+		~SessionStore()
+		{
+			{
+				std::lock_guard<std::mutex> lock(mtx);
+				stopping = true;
+			}
+			cv.notify_all();
+			if (writer.joinable()) writer.join();
+		}
+
+		// Replaces any write for the same path that has not started yet
+		void save(const std::string& path, std::shared_ptr<const SessionSnapshot> snapshot)
+		{
+			{
+				std::lock_guard<std::mutex> lock(mtx);
+				auto it = pending.find(path);
+				if (it == pending.end() || it->second.queued == false) {
+					queue.push_back(path);
+				}
+				pending[path] = { std::move(snapshot), true, false };
+			}
+			cv.notify_one();
+		}
+
+		// Drops the file at path together with any write still pending for it
+		void discard(const std::string& path)
+		{
+			{
+				std::lock_guard<std::mutex> lock(mtx);
+				markDirtyLocked(path);
+				auto it = pending.find(path);
+				if (it != pending.end()) {
+					if (!it->second.queued) {
+						it->second.discarded = true;	// being written; the writer removes it afterwards
+						return;
+					}
+					queue.erase(std::remove(queue.begin(), queue.end(), path), queue.end());
+					pending.erase(it);
+				}
+			}
+			std::error_code ec;
+			std::filesystem::remove(path, ec);
+		}
+
+		// Latest state for path, nullptr when there is none or the file is unusable
+		std::shared_ptr<const SessionSnapshot> load(const std::string& path)
+		{
+			{
+				std::lock_guard<std::mutex> lock(mtx);
+				auto it = pending.find(path);
+				if (it != pending.end()) return it->second.snapshot;
+			}
+			return readFile(path);
+		}
+
+	private:
+		// Replaced or removed session files after which their block directory is swept
+		static constexpr int kSweepEvery = 64;
+
+		struct Pending {
+			std::shared_ptr<const SessionSnapshot>	snapshot;
+			bool									queued = false;	// false while being written
+			bool									discarded = false;
+		};
+
+		// Counts a session file whose blocks may have lost their last reference
+		void markDirtyLocked(const std::string& path)
+		{
+			const std::string dir = SessionBlocks::directoryFor(path).string();
+			if (++dirty[dir] >= kSweepEvery) {
+				dirty.erase(dir);
+				sweeps.push_back(dir);
+				cv.notify_one();
+			}
+		}
+
+		void run()
+		{
+			std::unique_lock<std::mutex> lock(mtx);
+			while (true) {
+				cv.wait(lock, [this] { return stopping || !queue.empty() || !sweeps.empty(); });
+				if (queue.empty()) {
+					if (stopping) return;	// all writes drained; sweeps can wait for the next start
+					const std::string dir = std::move(sweeps.front());
+					sweeps.pop_front();
+					lock.unlock();
+					SessionBlocks::sweep(dir);
+					lock.lock();
+					continue;
+				}
+
+				const std::string path = std::move(queue.front());
+				queue.pop_front();
+				auto& entry = pending[path];
+				entry.queued = false;
+				std::shared_ptr<const SessionSnapshot> snapshot = entry.snapshot;
+				lock.unlock();
+
+				writeFile(path, *snapshot);
+
+				lock.lock();
+				markDirtyLocked(path);
+				auto it = pending.find(path);
+				if (it != pending.end() && it->second.snapshot == snapshot && !it->second.queued) {
+					if (it->second.discarded) {
+						std::error_code ec;
+						std::filesystem::remove(path, ec);
+					}
+					pending.erase(it);
+				}
+			}
+		}
+
+		static void writeFile(const std::string& path, const SessionSnapshot& snapshot)
+		{
+			// Blocks first, so a session file never names a block that is not there yet
+			std::vector<SessionBlocks::Ref> refs;
+			if (!SessionBlocks::put(SessionBlocks::directoryFor(path), snapshot.state, refs)) {
+				std::cerr << "[KV] ERROR: Failed to store the blocks of session file " << path << std::endl;
+				return;
+			}
+
+			// Write next to the target and rename so readers never see a partial file
+			const std::string tmp = path + ".tmp";
+			{
+				std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+				if (!SessionBlocks::writeManifest(out, snapshot.tokens, refs)) {
+					std::cerr << "[KV] ERROR: Failed to write session file " << path << std::endl;
+					out.close();
+					std::error_code ec;
+					std::filesystem::remove(tmp, ec);
+					return;
+				}
+			}
+			std::error_code ec;
+			std::filesystem::rename(tmp, path, ec);
+			if (ec) {
+				std::cerr << "[KV] ERROR: Failed to replace session file " << path << ": " << ec.message() << std::endl;
+				std::filesystem::remove(tmp, ec);
+			}
+		}
+
+		std::shared_ptr<const SessionSnapshot> readFile(const std::string& path)
+		{
+			std::vector<SessionBlocks::Ref> refs;
+			auto stored = std::make_shared<SessionSnapshot>();
+			if (SessionBlocks::readManifest(path, &stored->tokens, refs)) {
+				if (!blocks.get(SessionBlocks::directoryFor(path), refs, stored->state)) {
+					std::cerr << "[KV] WARNING: Session file " << path << " refers to missing or damaged blocks" << std::endl;
+					return nullptr;
+				}
+				return stored;
+			}
+
+			// Written before sessions were split into blocks
+			std::ifstream in(path, std::ios::binary | std::ios::ate);
+			if (!in) return nullptr;
+			const std::streamoff size = in.tellg();
+			in.seekg(0);
+
+			uint32_t header[3] = {};
+			if (size < static_cast<std::streamoff>(sizeof(header)) || !in.read(reinterpret_cast<char*>(header), sizeof(header)) ||
+				header[0] != LLAMA_STATE_SEQ_MAGIC || header[1] != LLAMA_STATE_SEQ_VERSION) {
+				return nullptr;
+			}
+
+			const std::streamoff token_bytes = static_cast<std::streamoff>(header[2]) * sizeof(llama_token);
+			if (token_bytes > size - static_cast<std::streamoff>(sizeof(header))) return nullptr;
+
+			auto snapshot = std::make_shared<SessionSnapshot>();
+			snapshot->tokens.resize(header[2]);
+			snapshot->state.resize(static_cast<size_t>(size - static_cast<std::streamoff>(sizeof(header)) - token_bytes));
+			in.read(reinterpret_cast<char*>(snapshot->tokens.data()), token_bytes);
+			in.read(reinterpret_cast<char*>(snapshot->state.data()), static_cast<std::streamsize>(snapshot->state.size()));
+			if (!in) return nullptr;
+			return snapshot;
+		}
+
+		std::mutex								mtx;
+		std::condition_variable					cv;
+		std::deque<std::string>					queue;
+		std::unordered_map<std::string, Pending> pending;
+		std::unordered_map<std::string, int>	dirty;		// per block directory
+		std::deque<std::string>					sweeps;
+		bool									stopping = false;
+		SessionBlocks							blocks;
+		std::thread								writer;
+	};
+
+	// Conversations evicted from warm slots, kept as sequence state snapshots in host RAM
+	// and, once that budget is used up, in spill files written through the SessionStore.
+	// Each tier evicts least recently stored first; taking an entry removes it.
+	class SessionTierCache {
+	public:
+		SessionTierCache(SessionStore& store, size_t host_budget, size_t disk_budget, std::filesystem::path disk_dir)
+			: store(store), host_budget(host_budget), disk_budget(disk_budget), disk_dir(std::move(disk_dir))
+		{
+			if (this->disk_budget > 0) {
+				std::error_code ec;
+				std::filesystem::create_directories(this->disk_dir, ec);
+				if (ec) {
+					std::cerr << "[INFERENCE] [WARNING] Cannot create KV spill directory " << this->disk_dir.string()
+							  << ": " << ec.message() << ". Disk tier disabled." << std::endl;
+					this->disk_budget = 0;
+				}
+			}
+			// Unique per cache so several engines can share one spill directory
+			file_prefix = "session-" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()) + "-";
+		}
+
+		~SessionTierCache()
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			for (const auto& entry : disk) store.discard(entry.second.path);
+		}
+
+		bool enabled() const { return host_budget > 0 || disk_budget > 0; }
+
+		void put(const std::string& key, std::shared_ptr<const SessionSnapshot> snapshot)
+		{
+			const size_t bytes = snapshotBytes(*snapshot);
+			std::lock_guard<std::mutex> lock(mtx);
+			eraseLocked(key);
+			++counters.spills;
+			if (bytes <= host_budget) {
+				host[key] = { std::move(snapshot), bytes, ++clock };
+				host_bytes += bytes;
+				while (host_bytes > host_budget) demoteLocked();
+			}
+			else {
+				storeOnDiskLocked(key, std::move(snapshot), bytes, ++clock);
+			}
+		}
+
+		// Reads spill files on the calling thread; meant for the submitting thread, not the decode loop
+		std::shared_ptr<const SessionSnapshot> take(const std::string& key)
+		{
+			std::string path;
+			{
+				std::lock_guard<std::mutex> lock(mtx);
+				auto h = host.find(key);
+				if (h != host.end()) {
+					auto snapshot = std::move(h->second.snapshot);
+					host_bytes -= h->second.bytes;
+					host.erase(h);
+					++counters.host_hits;
+					return snapshot;
+				}
+				auto d = disk.find(key);
+				if (d == disk.end()) {
+					++counters.misses;
+					return nullptr;
+				}
+				path = d->second.path;
+				disk_bytes -= d->second.bytes;
+				disk.erase(d);
+			}
+
+			auto snapshot = store.load(path);
+			store.discard(path);
+
+			std::lock_guard<std::mutex> lock(mtx);
+			++(snapshot ? counters.disk_hits : counters.misses);
+			return snapshot;
+		}
+
+		// Empties both tiers; spill files are read on the calling thread
+		std::vector<std::pair<std::string, std::shared_ptr<const SessionSnapshot>>> takeAll()
+		{
+			std::vector<std::pair<std::string, std::shared_ptr<const SessionSnapshot>>> sessions;
+			std::vector<std::pair<std::string, std::string>> spilled;
+			{
+				std::lock_guard<std::mutex> lock(mtx);
+				for (auto& entry : host) sessions.emplace_back(entry.first, std::move(entry.second.snapshot));
+				for (const auto& entry : disk) spilled.emplace_back(entry.first, entry.second.path);
+				host.clear();
+				disk.clear();
+				host_bytes = 0;
+				disk_bytes = 0;
+			}
+			for (const auto& [key, path] : spilled) {
+				if (auto snapshot = store.load(path)) sessions.emplace_back(key, std::move(snapshot));
+				store.discard(path);
+			}
+			return sessions;
+		}
+
+		void recordSlotHit()
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			++counters.slot_hits;
+		}
+
+		KvCacheStats stats() const
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			KvCacheStats result = counters;
+			result.host_bytes   = host_bytes;
+			result.disk_bytes   = disk_bytes;
+			result.host_entries = host.size();
+			result.disk_entries = disk.size();
+			return result;
+		}
+
+	private:
+		struct HostEntry {
+			std::shared_ptr<const SessionSnapshot>	snapshot;
+			size_t									bytes;
+			uint64_t								stored;
+		};
+		struct DiskEntry {
+			std::string	path;
+			size_t		bytes;
+			uint64_t	stored;
+		};
+
+		static size_t snapshotBytes(const SessionSnapshot& snapshot)
+		{
+			return snapshot.state.size() + snapshot.tokens.size() * sizeof(llama_token);
+		}
+
+		void eraseLocked(const std::string& key)
+		{
+			auto h = host.find(key);
+			if (h != host.end()) {
+				host_bytes -= h->second.bytes;
+				host.erase(h);
+			}
+			auto d = disk.find(key);
+			if (d != disk.end()) {
+				disk_bytes -= d->second.bytes;
+				store.discard(d->second.path);
+				disk.erase(d);
+			}
+		}
+
+		// Moves the oldest host entry to disk, or drops it without a disk tier
+		void demoteLocked()
+		{
+			auto victim = host.begin();
+			for (auto it = host.begin(); it != host.end(); ++it) {
+				if (it->second.stored < victim->second.stored) victim = it;
+			}
+			host_bytes -= victim->second.bytes;
+			storeOnDiskLocked(victim->first, std::move(victim->second.snapshot), victim->second.bytes, victim->second.stored);
+			host.erase(victim);
+		}
+
+		void storeOnDiskLocked(const std::string& key, std::shared_ptr<const SessionSnapshot> snapshot, size_t bytes, uint64_t stored)
+		{
+			if (bytes > disk_budget) return;
+			const std::string path = (disk_dir / (file_prefix + std::to_string(++file_counter) + ".kv")).string();
+			store.save(path, std::move(snapshot));
+			disk[key] = { path, bytes, stored };
+			disk_bytes += bytes;
+
+			while (disk_bytes > disk_budget) {
+				auto victim = disk.begin();
+				for (auto it = disk.begin(); it != disk.end(); ++it) {
+					if (it->second.stored < victim->second.stored) victim = it;
+				}
+				disk_bytes -= victim->second.bytes;
+				store.discard(victim->second.path);
+				disk.erase(victim);
+			}
+		}
+
+		SessionStore&								store;
+		size_t										host_budget;
+		size_t										disk_budget;
+		std::filesystem::path						disk_dir;
+		std::string									file_prefix;
+		uint64_t									file_counter = 0;
+		uint64_t									clock = 0;
+		std::unordered_map<std::string, HostEntry>	host;
+		std::unordered_map<std::string, DiskEntry>	disk;
+		size_t										host_bytes = 0;
+		size_t										disk_bytes = 0;
+		KvCacheStats								counters;
+		mutable std::mutex							mtx;
+	};
+
+	static void llama_log_callback_null(ggml_log_level level, const char* text, void* user_data)
+	{
+		(void)level;
+		(void)text;
+		(void)user_data;
+	}
+
+	class Tokenizer
+	{
+	public:
+		// New constructor takes shared pointers to model and context
+		Tokenizer(llama_model* shared_model, llama_context* shared_context, common_params& params);
+		~Tokenizer();
+
+		std::vector<int32_t>	tokenize(const std::string& text, bool add_bos = true);
+		std::string				detokenize(const std::vector<int32_t>& tokens);
+		std::string				decode(const int32_t& token);
+		std::string				applyTemplate(std::vector<common_chat_msg>& messages, bool addGenerationPrompt = true);
+
+		const	llama_vocab		*getVocab()		const { return vocab; }
+				llama_model		*getModel()		const { return tokenizer_model; }
+				llama_context	*getContext()	const { return tokenizer_context; }
+
+		bool shouldAddBos() const { return add_bos; }
+
+	private:
+		const	llama_vocab		*vocab;
+				llama_model		*tokenizer_model;
+				llama_context	*tokenizer_context;
+
+		common_chat_templates_ptr chat_templates;
+		bool					  add_bos;
+	};
+
+	Tokenizer::Tokenizer(llama_model* shared_model, llama_context* shared_context, common_params& params)
+		: tokenizer_model(shared_model)
+		, tokenizer_context(shared_context)
+		, add_bos(false)
+	{
+#ifdef DEBUG
+		std::cout << "[INFERENCE] Initializing Tokenizer with shared model and context." << std::endl;
+#endif
+		vocab = llama_model_get_vocab(tokenizer_model);
+		add_bos = llama_vocab_get_add_bos(vocab);
+
+		chat_templates = common_chat_templates_init(tokenizer_model, params.chat_template);
+		try {
+			const std::map<std::string, std::string> empty_kwargs{};
+			common_chat_format_example(chat_templates.get(), params.use_jinja, empty_kwargs);
+		}
+		catch (const std::exception& e) {
+			std::cerr << "[INFERENCE] [ERROR] Failed to format chat templates: " << e.what() << std::endl;
+			chat_templates = common_chat_templates_init(tokenizer_model, "chatml");
+		}
+	}
+
+	Tokenizer::~Tokenizer()
+	{
+	}
+
+	std::vector<int32_t> Tokenizer::tokenize(const std::string& text, bool /*add_bos_token*/)
+	{
+		std::vector<llama_token> tokens = common_tokenize(tokenizer_context, text.c_str(), true, true);
+		return std::vector<int32_t>(tokens.begin(), tokens.end());
+	}
+
+	std::string Tokenizer::detokenize(const std::vector<int32_t>& tokens)
+	{
+		std::ostringstream tokensStream;
+		for (const auto& token : tokens)
+		{
+			tokensStream << decode(token);
+		}
+		return tokensStream.str();
+	}
+
+	std::string Tokenizer::decode(const int32_t& token)
+	{
+		return common_token_to_piece(tokenizer_context, token);
+	}
+
+	std::string Tokenizer::applyTemplate(std::vector<common_chat_msg>& messages, bool addGenerationPrompt)
+	{
+		common_chat_templates_inputs inputs;
+		inputs.messages = messages;
+		inputs.add_generation_prompt = addGenerationPrompt;
+
+		return common_chat_templates_apply(chat_templates.get(), inputs).prompt;
+	}
+
+	// InferenceService Interface (Internal Use Only)
+	class InferenceService
+	{
+	public:
+		virtual ~InferenceService() {}
+		virtual void start() = 0;
+		virtual void stop() = 0;
+		virtual void submitJob(const CompletionParameters &params, std::shared_ptr<Job> job) = 0;
+		virtual void complete(const CompletionParameters &params, std::shared_ptr<Job> job) = 0;
+		virtual void embed(const EmbeddingParameters &params, std::shared_ptr<Job> job) = 0;
+		virtual void embedBatch(const std::vector<EmbeddingParameters> &params, const std::vector<std::shared_ptr<Job>> &jobs)
+		{
+			for (size_t i = 0; i < params.size(); ++i)
+				embed(params[i], jobs[i]);
+		}
+		virtual CompletionParameters formatChat(const ChatCompletionParameters &params) = 0;
+		virtual KvCacheStats kvCacheStats() const { return KvCacheStats(); }
+		virtual DecodeStats decodeStats() { return counters.snapshot(); }
+		virtual std::vector<DecodeStepSample> stepProfile() { return {}; }
+		virtual void beginStepCapture(size_t /*maxSteps*/) {}
+		virtual std::vector<DecodeStepSample> endStepCapture() { return {}; }
+		virtual std::vector<std::pair<std::string, std::shared_ptr<const SessionSnapshot>>> exportSessions() { return {}; }
+		virtual bool importSession(const std::string& /*key*/, std::shared_ptr<const SessionSnapshot> /*snapshot*/) { return false; }
+		virtual bool precomputeChunk(const std::string& /*text*/) { return false; }
+		virtual std::vector<ScoringResult> score(const std::vector<ScoringRequest>& /*requests*/, int /*topLogprobs*/)
+		{
+			throw std::runtime_error("Model cannot score continuations");
+		}
+		virtual int admissionLimit() const { return 0; }
+
+	protected:
+		DecodeCounters counters;
+	};
+
+	// Size of the KV cache buffers llama.cpp allocates for a context: K and V rows of every layer
+	// for each of its n_ctx cells, at the configured cache types
+	uint64_t kvCacheBytes(const llama_model* model, const common_params& params, int n_ctx)
+	{
+		const int64_t n_embd_kv = llama_model_n_embd(model) / std::max(1, llama_model_n_head(model)) *
+			std::max(1, llama_model_n_head_kv(model));
+		return static_cast<uint64_t>(n_ctx) * static_cast<uint64_t>(std::max(0, llama_model_n_layer(model))) *
+			(ggml_row_size(params.cache_type_k, n_embd_kv) + ggml_row_size(params.cache_type_v, n_embd_kv));
+	}
+
+	// LlamaInferenceService (CPU Implementation)
+	class LlamaInferenceService : public InferenceService
+	{
+	private:
+		// Data members moved before constructor to satisfy MSVC name lookup in mem-initializers
+		std::shared_ptr<Tokenizer>			tokenizer;
+		struct llama_model*					model;
+		struct llama_context*				context;
+		std::mutex							mtx;
+		std::condition_variable				cv;
+		common_params						g_params;
+		ggml_threadpool*					threadpool;
+		llama_batch							batch;
+		std::vector<std::shared_ptr<Job>>	jobs;
+		std::vector<std::function<void()>>	decode_tasks;	// Run between steps by runOnDecodeThread() (guarded by mtx)
+		std::atomic<bool>					should_terminate{ false };
+		std::thread							inferenceThread;
+
+		const int n_batch;
+		const int n_keep;
+		const int n_ctx;
+		const int step_tokens;
+		const float prefill_share;
+		const size_t preempt_swap_bytes;	// swapJobs(); 0 when preemption is off
+		const int block_tokens;			// Paged KV block size; 0 when every sequence may take any free cell
+		const int max_seq_ctx;			// Context one sequence may grow to, at most n_ctx
+		bool kv_short = false;			// Decode thread: a sequence found no free block in the last step
+		SloController slo;
+		SlotManager slotManager;
+		PrefixCache prefixCache;
+		ChunkKvCache chunkCache;
+		const int chunkSeq;		// Chunks are restored here, shifted into place, then moved to the job (-1 when off)
+		SessionStore sessionStore;
+		SessionTierCache tierCache;
+		SamplerPool samplerPool;
+		ChatSegmentCache chatSegments;
+		StepProfiler profiler;
+
+		// Prefix cache saved across loads (prefixCacheDir empty when not persisted)
+		const std::filesystem::path			prefixCacheDir;
+		const std::string					prefixCacheTag;
+		const std::chrono::seconds			prefixSaveInterval;
+		std::chrono::steady_clock::time_point lastPrefixSave;
+		uint64_t							savedPrefixVersion = 0;	// Decode thread only
+		std::atomic<bool>					prefixRestored{ false };
+		std::thread							prefixRestoreThread;
+
+		// Speculative decoding (draft_context is null when disabled)
+		llama_model*						draft_model;
+		llama_context*						draft_context;
+		llama_batch							draft_batch{};
+		const int							n_draft;
+		const bool							prompt_lookup;
+		static constexpr float				kDraftMinConfidence = 0.75f;
+		static constexpr int				kLookupMaxNgram = 4;
+		static constexpr int				kLookupMinNgram = 2;
+
+		// Multi-LoRA: the adapter the last step decoded with and for how many steps in a row
+		LoraAdapterCache					loras;
+		std::string							step_lora;
+		int									lora_steps = 0;
+		uint64_t							decode_step = 0;	// Successful llama_decode() calls
+		static constexpr int				kLoraStepQuantum = 4;
+
+	public:
+		// params.n_parallel counts every sequence of the context; after the job slots come the
+		// prefix_cache_slots holding the shared prompt-prefix cache, then the chunk splicing
+		// sequence when the chunk cache is on. Jobs are never handed the reserved ones
+		LlamaInferenceService(std::shared_ptr<Tokenizer> tokenizer, llama_model* model, llama_context* context, 
+			common_params params, ggml_threadpool* threadpool, const DecodeOptions& options = DecodeOptions())
+			: tokenizer(std::move(tokenizer)), model(model), context(context), g_params(params), threadpool(threadpool),
+			n_batch(params.n_batch), n_keep(params.n_keep), n_ctx(llama_n_ctx(context)),
+			step_tokens(options.step_tokens > 0 ? std::min(options.step_tokens, params.n_batch) : params.n_batch),
+			prefill_share(std::clamp(options.prefill_share, 0.0f, 1.0f)),
+			preempt_swap_bytes(options.preempt_swap_bytes),
+			block_tokens(std::max(0, std::min(options.kv_block_tokens, n_ctx))),
+			max_seq_ctx(block_tokens > 0
+				? std::max(block_tokens, std::min(options.max_seq_ctx > 0 ? options.max_seq_ctx : n_ctx, n_ctx / block_tokens * block_tokens))
+				: (options.max_seq_ctx > 0 ? std::min(options.max_seq_ctx, n_ctx) : n_ctx)),
+			slo(options.slo_ttft_ms, options.slo_tpot_ms, step_tokens, static_cast<int>(step_tokens * prefill_share),
+				params.n_parallel - options.reservedSeqs()),
+			slotManager(context, params.n_parallel - options.reservedSeqs()),
+			prefixCache(context, params.n_parallel - options.reservedSeqs(), options.prefix_cache_slots, /*min_tokens=*/32),
+			chunkCache(options.chunk_cache_bytes),
+			chunkSeq(chunkCache.enabled() ? params.n_parallel - 1 : -1),
+			tierCache(sessionStore, options.host_cache_bytes, options.disk_cache_bytes, options.disk_cache_dir),
+			samplerPool(/*capacity=*/64, /*max_idle=*/static_cast<size_t>(std::max(1, params.n_parallel)) * 2),
+			profiler(options.profile_steps),
+			prefixCacheDir(prefixCache.enabled() ? options.prefix_cache_dir : std::filesystem::path()),
+			prefixCacheTag(options.prefix_cache_tag),
+			prefixSaveInterval(std::max(0, options.prefix_cache_save_seconds)),
+			lastPrefixSave(std::chrono::steady_clock::now()),
+			draft_model(options.draft_model), draft_context(options.draft_context),
+			n_draft(std::max(0, options.n_draft)), prompt_lookup(options.prompt_lookup),
+			loras(model, options.lora_adapters, options.lora_max_loaded)
+		{
+#ifdef DEBUG
+			std::cout << "Initializing batch with size of: " << g_params.n_batch << std::endl;
+#endif
+			// initialize for multi-sequence decoding
+			batch = llama_batch_init(params.n_ctx, 0, params.n_parallel);
+			if (draft_context) {
+				draft_batch = llama_batch_init(params.n_batch, 0, 1);
+			}
+			if (block_tokens > 0) {
+				slotManager.setBlockPool(block_tokens, n_ctx / block_tokens);
+			}
+			if (tierCache.enabled()) {
+				slotManager.setEvictHandler([this](int id, const std::string& key, std::vector<llama_token> tokens) {
+					spillSession(id, key, std::move(tokens));
+				});
+			}
+
+			inferenceThread = std::thread(&LlamaInferenceService::start, this);
+
+			// The saved prefixes are read and loaded while the engine already serves
+			if (!prefixCacheDir.empty()) {
+				prefixRestoreThread = std::thread(&LlamaInferenceService::restorePrefixCache, this);
+			}
+		}
+
+		~LlamaInferenceService()
+		{
+			stop();
+			slotManager.shutdown();
+
+			// Wait for the inference thread to finish before cleaning up resources
+			if (inferenceThread.joinable()) {
+				inferenceThread.join();
+			}
+			if (prefixRestoreThread.joinable()) {
+				prefixRestoreThread.join();
+			}
+
+			// The decode thread is gone, so the prefix sequences can be read from here; an
+			// unfinished restore would overwrite the saved cache with a partial one
+			if (!prefixCacheDir.empty() && prefixRestored.load()) {
+				savePrefixCache();
+			}
+
+			// Clean up all remaining jobs to prevent accessing freed resources
+			{
+				std::lock_guard<std::mutex> lock(mtx);
+				for (auto& job : jobs) {
+					if (job) { // Null check for safety
+						std::lock_guard<std::mutex> jobLock(job->mtx);
+						if (!job->isFinished) {
+							job->hasError = true;
+							job->errorMessage = "Service is shutting down";
+							job->isFinished = true;
+							job->cv.notify_all();
+						}
+						if (job->seqId >= 0) { slotManager.release(job->seqId); job->seqId = -1; }
+						releaseSampler(job);
+					}
+				}
+				jobs.clear();
+			}
+
+			// Safe cleanup of llama resources
+			if (draft_context) {
+				llama_batch_free(draft_batch);
+				llama_free(draft_context);
+				draft_context = nullptr;
+			}
+			if (draft_model) {
+				ModelStore::instance().release(draft_model);
+				draft_model = nullptr;
+			}
+			if (context) {
+				llama_free(context);
+				context = nullptr;
+			}
+			loras.clear();
+			if (model) {
+				ModelStore::instance().release(model);
+				model = nullptr;
+			}
+			llama_batch_free(batch);
+
+			if (threadpool) {
+				BackendManager::instance().releaseThreadpool(threadpool);
+				threadpool = nullptr;
+			}
+		}
+
+		void stop() override
+		{
+			should_terminate = true;
+			// Wake up the inference thread if it's waiting
+			cv.notify_all();
+		}
+
+		void start() override
+		{
+#ifdef __linux__
+			// Tells the decode loop apart from the server's threads in CPU profiles
+			pthread_setname_np(pthread_self(), "kolosal-decode");
+#endif
+			while (!should_terminate)
+			{
+				std::vector<std::shared_ptr<Job>> current_jobs;
+				std::vector<std::function<void()>> tasks;
+				{
+					std::unique_lock<std::mutex> lock(mtx);
+					if (jobs.empty() && decode_tasks.empty()) {
+						// Idle pools sleep instead of polling, leaving the cores to other engines
+						ggml_threadpool_pause(threadpool);
+						cv.wait(lock, [this] { return !jobs.empty() || !decode_tasks.empty() || should_terminate; });
+						ggml_threadpool_resume(threadpool);
+					}
+					if (should_terminate) break;
+					current_jobs = jobs; // Copy jobs to process without holding the lock
+					tasks.swap(decode_tasks);
+				}
+				for (auto &task : tasks) task();
+
+				// Check for shutdown again after acquiring jobs
+				if (should_terminate) break;
+				if (current_jobs.empty()) continue;
+
+				if (prefixSaveInterval.count() > 0 && prefixRestored.load() && prefixCache.version() != savedPrefixVersion &&
+					std::chrono::steady_clock::now() - lastPrefixSave >= prefixSaveInterval) {
+					savePrefixCache();
+				}
+
+				bool batch_has_tokens = false;
+				const auto step_start = std::chrono::steady_clock::now();
+				std::vector<std::pair<std::shared_ptr<Job>, bool>> step_jobs;	// Jobs in this step's batch, true = prefill
+
+				if (preempt_swap_bytes > 0) {
+					swapJobs(current_jobs);
+				}
+
+				// an adapter applies to the whole context, so a step only batches the jobs that
+				// use the same one; the others wait for their adapter's turn
+				if (loras.enabled()) {
+					chooseStepAdapter(current_jobs);
+					if (!loras.apply(context, step_lora)) {
+						failAdapterJobs(current_jobs, step_lora);
+						continue;
+					}
+				}
+
+				// Schedule running generations before prompt ingestion so a long prefill never
+				// pushes their next token out of the batch; within each phase higher priority
+				// and then earlier deadline go first, ties keep submission order
+				int decoding_jobs = 0;
+				int prefill_jobs = 0;
+				std::unordered_map<std::string, std::pair<float, int>> prefill_tenants;	// Weight and prompt jobs of each tenant
+				size_t active_cells = 0;
+				std::vector<std::pair<bool, std::shared_ptr<Job>>> schedule;
+				for (auto &job : current_jobs) {
+					std::lock_guard<std::mutex> jl(job->mtx);
+					if (!job->isFinished && !job->hasError) {
+						if (job->params.loraAdapter == step_lora && !job->swapped) {
+							(job->isDecodingPrompt ? prefill_jobs : decoding_jobs)++;
+							if (job->isDecodingPrompt) {
+								auto &tenant = prefill_tenants[job->params.tenant];
+								tenant.first = job->params.tenantWeight > 0.0f ? job->params.tenantWeight : 1.0f;
+								++tenant.second;
+							}
+						}
+						active_cells += static_cast<size_t>(std::max(job->n_past, job->n_prompt) + std::max(job->n_remain, 0));
+					}
+					schedule.emplace_back(!job->isDecodingPrompt, job);
+				}
+				std::stable_sort(schedule.begin(), schedule.end(), [](const auto &a, const auto &b) {
+					if (a.first != b.first) return a.first;
+					if (a.second->params.priority != b.second->params.priority) return a.second->params.priority > b.second->params.priority;
+					return a.second->deadline < b.second->deadline;
+				});
+				current_jobs.clear();
+				for (auto &entry : schedule) current_jobs.push_back(std::move(entry.second));
+
+				// the SLO controller retunes the prefill cap and the slots decoding at once
+				if (slo.enabled() && slo.update(slotManager.inUse(), slotManager.waitingJobs())) {
+					slotManager.setActiveLimit(slo.maxActive());
+				}
+
+				// chunked prefill: prompts get what the generation tokens leave of the step budget,
+				// and while generations are running at most the prefill cap (prefill_share of it,
+				// unless the SLO controller moved it) so a large prompt cannot stretch their time
+				// per output token; at least 1 prompt token keeps moving
+				int prefill_budget = step_tokens - decoding_jobs;
+				if (decoding_jobs > 0) {
+					prefill_budget = std::min(prefill_budget, slo.prefillTokens());
+				}
+				prefill_budget = std::max(1, prefill_budget);
+				int prefill_used = 0;
+				int decoding_pending = decoding_jobs;
+
+				// fair per-job prompt quota; avoid divide-by-zero and ensure at least 1 token per job.
+				// With several tenants prompting, each gets a share of the budget by weight that its
+				// jobs split evenly
+				const int per_job_quota = std::max(1, prefill_budget / std::max(1, prefill_jobs));
+				std::unordered_map<std::string, int> tenant_quota;
+				if (prefill_tenants.size() > 1) {
+					float total_weight = 0.0f;
+					for (const auto &tenant : prefill_tenants) total_weight += tenant.second.first;
+					for (const auto &tenant : prefill_tenants) {
+						tenant_quota[tenant.first] = std::max(1, static_cast<int>(
+							prefill_budget * (tenant.second.first / total_weight) / std::max(1, tenant.second.second)));
+					}
+				}
+
+				// warm conversations and cached prefixes only keep the KV cells of the shared
+				// buffer that the running jobs are not projected to need; with paged KV those are
+				// the blocks the sequences hold
+				if (block_tokens > 0) {
+					active_cells = static_cast<size_t>(slotManager.blocksUsed()) * static_cast<size_t>(block_tokens);
+				}
+				bool blocks_short = false;
+				if (g_params.kv_unified) {
+					const size_t reserved = active_cells + static_cast<size_t>(g_params.n_batch);
+					const size_t budget = reserved < static_cast<size_t>(n_ctx) ? static_cast<size_t>(n_ctx) - reserved : 0;
+					slotManager.trimWarm(budget);
+					if (prefixCache.enabled()) {
+						prefixCache.trim(budget - std::min(budget, slotManager.warmTokens()));
+					}
+				}
+
+				for (auto job : current_jobs)
+				{
+					// Check for shutdown in the job processing loop
+					if (should_terminate) break;
+
+					std::lock_guard<std::mutex> jobLock(job->mtx);
+
+					if (job->isFinished || job->hasError)
+						continue;
+
+					// paused for a more urgent job; swapJobs() resumes it
+					if (job->swapped) {
+						if (checkCancellation(job) || job->suspendRequested.load()) {
+							dropSwapped(job);
+							releaseSampler(job);
+							job->suspended = job->suspendRequested.load();
+							job->isFinished = true;
+							job->cv.notify_all();
+						}
+						continue;
+					}
+
+					if (job->suspendRequested.load()) {
+						suspendRunningJob(job);
+						continue;
+					}
+
+					if (checkCancellation(job) || (job->n_remain <= 0 && job->params.maxNewTokens != 0)) {
+						saveSession(job);
+						cachePromptPrefix(job);
+						releaseSampler(job);
+						releaseFinishedSlot(job);
+						job->isFinished = true;
+						job->cv.notify_all();
+						continue;
+					}
+
+					if (job->params.loraAdapter != step_lora) {
+						continue;
+					}
+
+					if (!ensureContextCapacity(job))
+					{
+						releaseSampler(job);
+						if (job->seqId >= 0) { slotManager.release(job->seqId); job->seqId = -1; }
+						job->hasError = true;
+						job->isFinished = true;
+						job->errorMessage = "Context overflow even after trimming.";
+						job->cv.notify_all();
+						continue;
+					}
+
+					if (!job->isDecodingPrompt) {
+						// respect overall batch limit and internal capacity
+						int capacity_remaining = n_ctx - batch.n_tokens;
+						if (capacity_remaining <= 0 || batch.n_tokens >= step_tokens) {
+							break;
+						}
+
+						// drafts never take the batch space still owed to the generations scheduled after this one
+						--decoding_pending;
+
+						// disaggregated prefill: the decoded prompt goes to another engine instead of being sampled
+						if (job->params.prefillOnly) {
+							exportPromptState(job);
+							cachePromptPrefix(job);
+							releaseSampler(job);
+							releaseFinishedSlot(job);
+							job->isFinished = true;
+							job->cv.notify_all();
+							continue;
+						}
+
+						// another adapter's step, a precomputed chunk, a scoring pass or a preemption lost the logits it samples from
+						if (job->logitsStep != decode_step && !job->logitTokens.empty()) {
+							if (batch.n_tokens + static_cast<int>(job->logitTokens.size()) > step_tokens) {
+								break;
+							}
+							if (!replayLogits(job)) {
+								releaseSampler(job);
+								if (job->seqId >= 0) { slotManager.release(job->seqId); job->seqId = -1; }
+								job->hasError = true;
+								job->isFinished = true;
+								job->errorMessage = "Could not resume after its logits were overwritten";
+								job->cv.notify_all();
+								continue;
+							}
+							batch_has_tokens = true;
+							step_jobs.emplace_back(job, false);
+							continue;
+						}
+
+						// paged KV: the next token needs a cell in the sequence's blocks, drafts take what is left
+						if (growSequence(job, 1 + (job->drafts ? n_draft : 0)) < 1) {
+							blocks_short = true;
+							continue;
+						}
+
+						const auto sample_start = std::chrono::steady_clock::now();
+						const bool sampled = job->drafts ? sampleWithDraft(job, std::max(0, decoding_pending), jobLock)
+							: sampleNextToken(job, jobLock);
+						job->timing.sample_ms += millisecondsSince(sample_start);
+						if (!sampled) {
+							saveSession(job);
+							cachePromptPrefix(job);
+							releaseSampler(job);
+							releaseFinishedSlot(job);
+							job->isFinished = true;
+							job->cv.notify_all();
+							continue;
+						}
+
+						job->n_past += 1;
+						batch_has_tokens = true;
+						step_jobs.emplace_back(job, false);
+					}
+					else {
+						// candidates of an n > 1 request wait for the first one's prompt, then copy its KV
+						if (awaitsPromptFork(job, current_jobs)) {
+							continue;
+						}
+
+						// session load, tokenization and prefix reuse only run on the first prompt step
+						if (!job->isPromptPrepared) {
+							const auto prepare_start = std::chrono::steady_clock::now();
+							spillEvictedSession(job);
+							restoreSpilledSession(job);
+
+							if (!loadSession(job)) {
+								releaseSampler(job);
+								if (job->seqId >= 0) { slotManager.release(job->seqId); job->seqId = -1; }
+								job->hasError = true;
+								job->isFinished = true;
+								job->errorMessage = "Failed to load sessions";
+								job->cv.notify_all();
+								continue;
+							}
+
+							if (!getInputTokens(job)) {
+								releaseSampler(job);
+								if (job->seqId >= 0) { slotManager.release(job->seqId); job->seqId = -1; }
+								job->hasError = true;
+								job->isFinished = true;
+								job->errorMessage = "Failed to tokenize input";
+								job->cv.notify_all();
+								continue;
+							}
+
+							if (!ensureNonEmptyInput(job)) {
+								releaseSampler(job);
+								if (job->seqId >= 0) { slotManager.release(job->seqId); job->seqId = -1; }
+								job->hasError = true;
+								job->isFinished = true;
+								job->errorMessage = "Failed to ensure input content";
+								job->cv.notify_all();
+								continue;
+							}
+						
+							job->n_matching_session_tokens = job->warm_tokens.empty() ? matchSessionTokens(job) : reuseWarmSlot(job);
+							job->n_past = static_cast<int>(job->n_matching_session_tokens);
+							job->i_prompt = static_cast<int>(job->n_matching_session_tokens);
+							job->n_prompt = static_cast<int>(job->embd_inp.size());
+
+							if (job->n_matching_session_tokens == 0) {
+								restorePromptPrefix(job);
+							}
+							planChunkSplices(job);
+							job->isPromptPrepared = true;
+							job->timing.session_ms += millisecondsSince(prepare_start);
+						}
+
+						int remaining_prompt_tokens = job->n_prompt - job->i_prompt;
+						// respect overall batch limit and internal capacity
+						int capacity_remaining = n_ctx - batch.n_tokens;
+						int available_batch_space = std::min({ step_tokens - batch.n_tokens, capacity_remaining, prefill_budget - prefill_used });
+
+						if (available_batch_space <= 0) {
+							break;
+						}
+
+						// fair-share: each job contributes up to its quota of tokens per decode step
+						const auto quota = tenant_quota.find(job->params.tenant);
+						const int job_quota = quota != tenant_quota.end() ? quota->second : per_job_quota;
+						int tokens_to_process = std::min(remaining_prompt_tokens, std::min(available_batch_space, job_quota));
+						tokens_to_process = growSequence(job, tokens_to_process);
+						if (tokens_to_process <= 0) {
+							blocks_short = true;
+							continue;
+						}
+						const int fed = feedPromptTokens(job, tokens_to_process);
+						if (fed > 0) {
+							prefill_used += fed;
+							batch_has_tokens = true;
+							step_jobs.emplace_back(job, true);
+						}
+
+						// ensure capacity even during prompt ingestion
+						if (!ensureContextCapacity(job)) {
+							releaseSampler(job);
+							if (job->seqId >= 0) { slotManager.release(job->seqId); job->seqId = -1; }
+							job->hasError = true;
+							job->isFinished = true;
+							job->errorMessage = "Context overflow even after trimming.";
+							job->cv.notify_all();
+							continue;
+						}
+					}
+				}
+
+				// hand the prefill budget the fair shares left unused to prompts in schedule order,
+				// keeping clear of the context limit (trimming is left to the next step)
+				for (auto job : current_jobs)
+				{
+					const int space = std::min({ step_tokens, n_ctx }) - batch.n_tokens;
+					if (should_terminate || space <= 0 || prefill_used >= prefill_budget) break;
+
+					std::lock_guard<std::mutex> jobLock(job->mtx);
+					if (job->isFinished || job->hasError || job->swapped || !job->isDecodingPrompt || !job->isPromptPrepared
+						|| job->params.loraAdapter != step_lora)
+						continue;
+
+					const int tokens_to_process = growSequence(job, std::min({ job->n_prompt - job->i_prompt, space,
+						prefill_budget - prefill_used, contextLimit(job->params) - 1 - job->n_past }));
+					const int fed = feedPromptTokens(job, tokens_to_process);
+					if (fed > 0) {
+						prefill_used += fed;
+						batch_has_tokens = true;
+						if (std::none_of(step_jobs.begin(), step_jobs.end(), [&job](const auto &entry) { return entry.first == job; })) {
+							step_jobs.emplace_back(job, true);
+						}
+					}
+				}
+
+				// paged KV: when no sequence could grow, the least urgent one gives up its blocks
+				kv_short = blocks_short;
+				if (blocks_short && !batch_has_tokens && !should_terminate) {
+					relieveBlockPressure(current_jobs);
+				}
+
+				if (batch_has_tokens && !should_terminate && context)
+				{
+					counters.recordDecode(batch.n_tokens);
+					const auto decode_start = std::chrono::steady_clock::now();
+					if (llama_decode(context, batch))
+					{
+						for (auto job : current_jobs)
+						{
+							std::lock_guard<std::mutex> jobLock(job->mtx);
+							if (!job->isFinished) {
+								job->hasError = true;
+								job->errorMessage = "Could not decode next token";
+								job->isFinished = true;
+								dropSwapped(job);
+								if (job->seqId >= 0) { slotManager.release(job->seqId); job->seqId = -1; }
+								job->cv.notify_all();
+							}
+						}
+					}
+					else {
+						counters.kv_cells_used.store(usedCells(), std::memory_order_relaxed);
+
+						const float decode_ms = millisecondsSince(decode_start);
+						++decode_step;
+						for (const auto &[job, prefill] : step_jobs) {
+							std::lock_guard<std::mutex> jobLock(job->mtx);
+							(prefill ? job->timing.prefill_ms : job->timing.decode_ms) += decode_ms;
+							++job->timing.decode_steps;
+							recordLogitTokens(job);
+						}
+						// hand a prompt that just finished to its waiting candidates while its logits are current
+						for (const auto &[job, prefill] : step_jobs) {
+							if (prefill) forkPrompt(job, current_jobs);
+						}
+						if (profiler.enabled()) {
+							DecodeStepSample sample;
+							sample.batch_tokens = batch.n_tokens;
+							sample.prompt_tokens = prefill_used;
+							sample.prefill_jobs = static_cast<int>(std::count_if(step_jobs.begin(), step_jobs.end(),
+								[](const auto &entry) { return entry.second; }));
+							sample.generating_jobs = static_cast<int>(step_jobs.size()) - sample.prefill_jobs;
+							sample.schedule_ms = std::chrono::duration<float, std::milli>(decode_start - step_start).count();
+							sample.decode_ms = decode_ms;
+							if (profiler.capturing()) {
+								// Batch composition: each job's tokens, found by its sequence id
+								std::unordered_map<llama_seq_id, int> seq_tokens;
+								for (int i = 0; i < batch.n_tokens; ++i) ++seq_tokens[batch.seq_id[i][0]];
+								sample.jobs.reserve(step_jobs.size());
+								for (const auto &[job, prefill] : step_jobs) {
+									auto it = seq_tokens.find(job->seqId);
+									sample.jobs.push_back({ job->jobId, it != seq_tokens.end() ? it->second : 0, prefill });
+								}
+							}
+							profiler.record(step_start, std::move(sample));
+						}
+					}
+
+					common_batch_clear(batch);
+				}
+			}
+			
+			// Callers of runOnDecodeThread() still wait for their tasks
+			std::vector<std::function<void()>> tasks;
+			{
+				std::lock_guard<std::mutex> lock(mtx);
+				tasks.swap(decode_tasks);
+			}
+			for (auto &task : tasks) task();
+
+			// Ensure all remaining jobs are properly cleaned up when exiting
+			{
+				std::lock_guard<std::mutex> lock(mtx);
+				for (auto& job : jobs) {
+					std::lock_guard<std::mutex> jobLock(job->mtx);
+					if (!job->isFinished) {
+						job->hasError = true;
+						job->errorMessage = "Service is shutting down";
+						job->isFinished = true;
+						if (job->seqId >= 0) { slotManager.release(job->seqId); job->seqId = -1; }
+						job->cv.notify_all();
+					}
+				}
+			}
+		}
+
+		void submitJob(const CompletionParameters& params, std::shared_ptr<Job> job) override
+		{
+#ifdef DEBUG
+			std::cout << "[INFERENCE] Submitting job with prompt: \n" << params.prompt << std::endl;
+#endif
+
+			// Make a mutable copy for potential context shifting
+			CompletionParameters mutable_params = params;
+			JobTiming timing;
+			timing.queue_ms = millisecondsSince(job->start_time);
+			timing.submitted_us = steadyMicros(job->start_time);
+			
+			auto phase_start = std::chrono::steady_clock::now();
+			if (!validateParameters(mutable_params, job)) {
+				return;
+			}
+			timing.tokenize_ms = millisecondsSince(phase_start);
+
+			// a migrated job continues after its earlier output rather than after the prompt
+			if (mutable_params.resumeFromKvState && mutable_params.kvState) {
+				job->prompt_tokens = mutable_params.kvState->tokens;
+			}
+
+			// a conversation's KV is only reused under the adapter that computed it
+			if (!mutable_params.loraAdapter.empty() && !mutable_params.sessionKey.empty()) {
+				mutable_params.sessionKey += "\x1flora:" + mutable_params.loraAdapter;
+			}
+			job->params = mutable_params;
+
+			phase_start = std::chrono::steady_clock::now();
+			job->smpl = initializeSampler(mutable_params, job);
+			if (!job->smpl) {
+				return;
+			}
+			timing.grammar_ms = millisecondsSince(phase_start);
+
+			{
+				std::lock_guard<std::mutex> jobLock(job->mtx);
+				job->generatedTokens.clear();
+				// pooled jobs keep this capacity, so later requests append without reallocating
+				job->generatedTokens.reserve(static_cast<size_t>(mutable_params.maxNewTokens > 0 ? std::min(mutable_params.maxNewTokens, n_ctx) : n_ctx));
+				job->generatedText.clear();
+				job->pendingTokens.clear();
+				job->pendingText.clear();
+				job->stopMatcher = StopSequenceMatcher(mutable_params.stop);
+				job->publishedTextBytes = 0;
+				job->logprob = 0.0;
+			}
+
+			// Read a file-backed session before waiting for a slot so the decode thread only
+			// restores it from memory
+			job->session_snapshot = params.kvCacheFilePath.empty() ? nullptr : sessionStore.load(params.kvCacheFilePath);
+
+			// Acquire a managed seq slot; block if busy. Conversations with a session key get
+			// their previous slot back when it is still warm (file-backed sessions manage their own)
+			job->warm_tokens.clear();
+			const std::string sessionKey = params.kvCacheFilePath.empty() ? mutable_params.sessionKey : std::string();
+			SlotManager::Evicted evicted;
+			phase_start = std::chrono::steady_clock::now();
+			const int slot_id = slotManager.allocate(sessionKey, job->warm_tokens, tierCache.enabled() ? &evicted : nullptr,
+													 &job->cancelRequested, { params.tenant, params.tenantWeight, params.tenantMaxSlots, params.priority,
+														 std::min(contextLimit(mutable_params), static_cast<int>(job->prompt_tokens.size()) + 1) });
+			if (slot_id == SlotManager::kCancelled) {
+				// Stopped (e.g. the client disconnected) while queued; never takes a slot
+				std::lock_guard<std::mutex> jobLock(job->mtx);
+				releaseSampler(job);
+				job->suspended = job->suspendRequested.load();
+				job->isFinished = true;
+				job->cv.notify_all();
+				return;
+			}
+			if (slot_id < 0) {
+				std::lock_guard<std::mutex> jobLock(job->mtx);
+				job->hasError = true;
+				job->errorMessage = "Service is shutting down";
+				job->cv.notify_all();
+				return;
+			}
+			timing.queue_ms += millisecondsSince(phase_start);
+			timing.scheduled_us = steadyMicros(std::chrono::steady_clock::now());
+			job->seqId = slot_id;
+			job->evicted_key = std::move(evicted.key);
+			job->evicted_tokens = std::move(evicted.tokens);
+
+			// A conversation not found in a warm slot may have been spilled to a lower tier
+			if (!sessionKey.empty() && tierCache.enabled()) {
+				if (job->warm_tokens.empty()) {
+					job->session_snapshot = tierCache.take(sessionKey);
+				}
+				else {
+					tierCache.recordSlotHit();
+				}
+			}
+
+			// Prompt KV computed by a prefill engine; a warm slot of the conversation is as good
+			if (params.kvState && params.kvCacheFilePath.empty() && job->warm_tokens.empty() && !job->session_snapshot) {
+				job->session_snapshot = params.kvState;
+			}
+			job->params.kvState.reset();
+
+			// defensive: ensure the slot's KV is empty before use (CUDA can be strict); a reclaimed
+			// slot is saved and wiped on the decode thread instead
+			if (context && job->warm_tokens.empty() && job->evicted_tokens.empty()) {
+				auto * mem = llama_get_memory(context);
+				llama_memory_seq_rm(mem, job->seqId, /*p0=*/0, /*p1=*/-1);
+			}
+			job->path_session				= params.kvCacheFilePath;
+			job->n_remain					= params.maxNewTokens;
+			job->isDecodingPrompt			= true;
+			job->isPromptPrepared			= false;
+			job->isContextShifted			= false;
+			job->isFinished					= false;
+			job->draft.clear();
+			job->draftIdxs.clear();
+			job->draftKvTokens.clear();
+			job->draftKvSynced				= false;
+			job->draftTokenCount			= 0;
+			job->draftAcceptedCount			= 0;
+			job->promptLookup				= n_draft > 0 && (params.promptLookup < 0 ? prompt_lookup : params.promptLookup > 0);
+			job->drafts						= job->promptLookup || (n_draft > 0 && draft_context);
+			job->deadline					= params.deadlineMs > 0
+				? std::chrono::steady_clock::now() + std::chrono::milliseconds(params.deadlineMs)
+				: std::chrono::steady_clock::time_point::max();
+			{
+				std::lock_guard<std::mutex> jobLock(job->mtx);
+				job->timing = timing;
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(mtx);
+				jobs.push_back(job);
+			}
+
+			cv.notify_one();
+		}
+
+		void complete(const CompletionParameters& params, std::shared_ptr<Job> job) override
+		{
+#ifdef DEBUG
+			std::cout << "[INFERENCE] Submitting job with sequence ID: " << params.seqId << std::endl;
+#endif
+
+			submitJob(params, job);
+
+			{
+				std::unique_lock<std::mutex> lock(job->mtx);
+				job->cv.wait(lock, [&job] { return job->isFinished; });
+			}
+		}
+
+		void embed(const EmbeddingParameters & /*params*/, std::shared_ptr<Job> job) override
+		{
+			// This service handles only text/chat completion; embeddings are delegated to EmbeddingInferenceService
+			std::lock_guard<std::mutex> jobLock(job->mtx);
+			job->hasError = true;
+			job->errorMessage = "Embedding is not supported by this model/service";
+			job->isFinished = true;
+			job->cv.notify_all();
+		}
+
+		CompletionParameters formatChat(const ChatCompletionParameters& params) override
+		{
+			if (!params.isValid())
+			{
+				throw std::runtime_error("[INFERENCE] [CHATCOMPLETE] [ERROR] Invalid chat completion parameters\n");
+			}
+
+			// Format the chat messages into a single prompt
+			std::vector<common_chat_msg> messages;
+			for (const auto& msg : params.messages)
+			{
+				messages.push_back(common_chat_msg{ msg.role, msg.content });
+			}
+
+			std::string formatted;
+
+			formatted = tokenizer->applyTemplate(messages);
+			std::shared_ptr<const std::vector<int32_t>> promptTokens = chatPromptTokens(messages, formatted);
+			
+			CompletionParameters completionParams{
+				formatted.c_str(),
+				params.randomSeed,
+				params.maxNewTokens,
+				params.minLength,
+				params.temperature,
+				params.topP,
+				/*grammar*/ "",
+				/*jsonSchema*/ "",
+				params.streaming,
+				params.n_discard,
+				params.allow_context_shift,
+				params.kvCacheFilePath,
+				params.seqId,
+				params.sessionKey,
+				params.priority,
+				params.deadlineMs
+			};
+			// Carry over grammar or jsonSchema
+			completionParams.grammar = params.grammar;
+			completionParams.jsonSchema = params.jsonSchema;
+			completionParams.stop = params.stop;
+			completionParams.scoreOutput = params.scoreOutput;
+			completionParams.promptLookup = params.promptLookup;
+			completionParams.loraAdapter = params.loraAdapter;
+			completionParams.tenant = params.tenant;
+			completionParams.tenantWeight = params.tenantWeight;
+			completionParams.tenantMaxSlots = params.tenantMaxSlots;
+			completionParams.maxContext = params.maxContext;
+			completionParams.prefillOnly = params.prefillOnly;
+			completionParams.kvState = params.kvState;
+			completionParams.resumeFromKvState = params.resumeFromKvState;
+			completionParams.promptTokens = std::move(promptTokens);
+
+			return completionParams;
+		}
+
+		KvCacheStats kvCacheStats() const override
+		{
+			return tierCache.stats();
+		}
+
+		std::vector<std::pair<std::string, std::shared_ptr<const SessionSnapshot>>> exportSessions() override
+		{
+			std::vector<std::pair<std::string, std::shared_ptr<const SessionSnapshot>>> sessions;
+			runOnDecodeThread([this, &sessions] {
+				slotManager.drainWarm([this, &sessions](int id, const std::string& key, std::vector<llama_token> tokens) {
+					if (auto snapshot = snapshotSequence(id, std::move(tokens))) {
+						sessions.emplace_back(key, std::move(snapshot));
+					}
+				});
+			});
+			for (auto& session : tierCache.takeAll()) {
+				sessions.push_back(std::move(session));
+			}
+			return sessions;
+		}
+
+		// A free slot takes the conversation warm; without one it goes to the session tiers
+		bool importSession(const std::string& key, std::shared_ptr<const SessionSnapshot> snapshot) override
+		{
+			if (key.empty() || !snapshot || snapshot->tokens.empty()) return false;
+
+			const int id = slotManager.tryAllocate();
+			if (id >= 0) {
+				bool restored = false;
+				const bool ran = runOnDecodeThread([this, id, &key, &snapshot, &restored] {
+					restored = llama_state_seq_set_data(context, snapshot->state.data(), snapshot->state.size(), id) != 0;
+					if (restored) {
+						slotManager.release(id, key, snapshot->tokens);
+					}
+					else {
+						slotManager.release(id);
+					}
+				});
+				if (!ran) {
+					slotManager.release(id);
+					return false;
+				}
+				if (restored) return true;
+			}
+
+			if (!tierCache.enabled()) return false;
+			tierCache.put(key, std::move(snapshot));
+			return true;
+		}
+
+		// Decodes the chunk alone between two steps and keeps its KV for planChunkSplices()
+		bool precomputeChunk(const std::string& text) override
+		{
+			if (!chunkCache.enabled()) return false;
+
+			const std::vector<llama_token> tokens = common_tokenize(tokenizer->getContext(), text, /*add_special=*/false, /*parse_special=*/false);
+			if (tokens.size() < ChunkKvCache::kMinTokens || tokens.size() > static_cast<size_t>(n_ctx / 4)) return false;
+
+			bool cached = false;
+			const bool ran = runOnDecodeThread([this, &tokens, &cached] {
+				if (!chunkCache.contains(tokens)) {
+					if (auto chunk = decodeChunk(tokens)) chunkCache.put(std::move(chunk));
+				}
+				cached = chunkCache.contains(tokens);
+			});
+			return ran && cached;
+		}
+
+		// A prompt-continuation pair of score(), tokenized
+		struct ScoringPair {
+			std::vector<llama_token>	tokens;			// Prompt, then continuation
+			int							n_prompt = 0;
+		};
+		// Progress of score() through a round of pairs decoded side by side
+		struct ScoringPass {
+			std::vector<int>	seqs;		// Slot of each pair in the round
+			size_t				first = 0;	// Pair in seqs[0]
+			size_t				item = 0;	// Next pair to feed, relative to first
+			int					pos = 0;	// Its next position
+		};
+
+		// Decodes the pairs side by side in as many free slots as there are, n_batch tokens
+		// between two steps at a time, so the running jobs keep generating meanwhile
+		std::vector<ScoringResult> score(const std::vector<ScoringRequest>& requests, int topLogprobs) override
+		{
+			std::vector<ScoringPair> pairs(requests.size());
+			std::vector<ScoringResult> results(requests.size());
+			for (size_t i = 0; i < requests.size(); ++i) {
+				pairs[i].tokens = tokenizer->tokenize(requests[i].prompt, tokenizer->shouldAddBos());
+				const std::vector<llama_token> continuation = common_tokenize(tokenizer->getContext(), requests[i].continuation,
+					/*add_special=*/false, /*parse_special=*/false);
+				if (pairs[i].tokens.empty() || continuation.empty()) {
+					throw std::runtime_error("Pair " + std::to_string(i) + " has an empty prompt or continuation");
+				}
+				pairs[i].n_prompt = static_cast<int>(pairs[i].tokens.size());
+				pairs[i].tokens.insert(pairs[i].tokens.end(), continuation.begin(), continuation.end());
+				if (static_cast<int>(pairs[i].tokens.size()) > max_seq_ctx) {
+					throw std::runtime_error("Pair " + std::to_string(i) + " has " + std::to_string(pairs[i].tokens.size())
+						+ " tokens, more than the " + std::to_string(max_seq_ctx) + " a sequence may hold");
+				}
+				results[i].prompt_tokens = pairs[i].n_prompt;
+			}
+			const int top_k = std::max(0, std::min(topLogprobs, llama_vocab_n_tokens(tokenizer->getVocab())));
+
+			for (size_t next = 0; next < pairs.size();) {
+				// One slot is waited for like any job; the rest of the round takes what is free
+				ScoringPass pass;
+				pass.first = next;
+				std::vector<llama_token> unused;
+				SlotManager::Evicted evicted;
+				const int first_seq = slotManager.allocate(std::string(), unused, tierCache.enabled() ? &evicted : nullptr, nullptr,
+					{ std::string(), 1.0f, 0, 0, static_cast<int>(pairs[next].tokens.size()) });
+				if (first_seq < 0) throw std::runtime_error("Service is shutting down");
+				pass.seqs.push_back(first_seq);
+				while (next + pass.seqs.size() < pairs.size()) {
+					const int cells = static_cast<int>(pairs[next + pass.seqs.size()].tokens.size());
+					const int id = slotManager.tryAllocate();
+					if (id < 0) break;
+					if (slotManager.reserve(id, cells) < cells) {
+						slotManager.release(id);
+						break;
+					}
+					pass.seqs.push_back(id);
+				}
+				next += pass.seqs.size();
+
+				bool decoded = true;
+				bool ran = runOnDecodeThread([this, &pass, &evicted] {
+					if (tierCache.enabled()) spillSession(pass.seqs[0], evicted.key, std::move(evicted.tokens));
+					for (int seq : pass.seqs) llama_memory_seq_rm(llama_get_memory(context), seq, /*p0=*/0, /*p1=*/-1);
+				});
+				while (ran && decoded && pass.item < pass.seqs.size()) {
+					ran = runOnDecodeThread([this, &pairs, &pass, top_k, &results, &decoded] {
+						decoded = scoreStep(pairs, pass, top_k, results);
+					});
+				}
+				const bool released = ran && runOnDecodeThread([this, &pass] {
+					for (int seq : pass.seqs) slotManager.release(seq);
+				});
+				if (!released) {
+					for (int seq : pass.seqs) slotManager.release(seq);
+				}
+				if (!ran) throw std::runtime_error("Service is shutting down");
+				if (!decoded) throw std::runtime_error("Failed to decode pairs " + std::to_string(pass.first) + " to " + std::to_string(next - 1));
+			}
+			return results;
+		}
+
+		// Runs fn on the decode thread between two steps and waits for it; false once the
+		// service is stopping
+		bool runOnDecodeThread(const std::function<void()>& fn)
+		{
+			std::promise<void> done;
+			std::future<void> finished = done.get_future();
+			{
+				std::lock_guard<std::mutex> lock(mtx);
+				if (should_terminate) return false;
+				decode_tasks.push_back([&fn, &done] { fn(); done.set_value(); });
+			}
+			cv.notify_one();
+			finished.wait();
+			return true;
+		}
+
+		DecodeStats decodeStats() override
+		{
+			DecodeStats stats = counters.snapshot();
+			stats.slots_total = slotManager.capacity();
+			stats.slots_in_use = slotManager.inUse();
+			stats.kv_cells_total = n_ctx;
+			stats.kv_blocks_total = slotManager.blocksTotal();
+			stats.kv_blocks_used = slotManager.blocksUsed();
+			stats.kv_bytes = kvCacheBytes(model, g_params, n_ctx);
+			stats.weight_bytes = llama_model_size(model);
+			slo.fill(stats);
+			return stats;
+		}
+
+		int admissionLimit() const override
+		{
+			return slo.admitJobs();
+		}
+
+		std::vector<DecodeStepSample> stepProfile() override
+		{
+			return profiler.snapshot();
+		}
+
+		void beginStepCapture(size_t maxSteps) override
+		{
+			profiler.beginCapture(maxSteps);
+		}
+
+		std::vector<DecodeStepSample> endStepCapture() override
+		{
+			return profiler.endCapture();
+		}
+
+	private:
+
+
+#ifdef DEBUG
+		void printLogits(llama_context* ctx, size_t maxLogits = 10) {
+			// Get the logits after decoding
+			float* logits = llama_get_logits_ith(ctx, -1);
+
+			// Get vocabulary size (number of logits)
+			const int n_vocab = llama_vocab_n_tokens(tokenizer->getVocab());
+
+			std::cout << "\n----- Logits after decoding -----\n";
+
+			// Calculate some statistics
+			float min_logit = std::numeric_limits<float>::max();
+			float max_logit = std::numeric_limits<float>::lowest();
+			float sum_logit = 0.0f;
+
+			for (int i = 0; i < n_vocab; i++) {
+				min_logit = std::min(min_logit, logits[i]);
+				max_logit = std::max(max_logit, logits[i]);
+				sum_logit += logits[i];
+			}
+
+			float mean_logit = sum_logit / n_vocab;
+
+			std::cout << "Vocab size: " << n_vocab << std::endl;
+			std::cout << "Min logit: " << min_logit << std::endl;
+			std::cout << "Max logit: " << max_logit << std::endl;
+			std::cout << "Mean logit: " << mean_logit << std::endl;
+
+			// Create vector of (token, logit) pairs for sorting
+			std::vector<std::pair<int, float>> token_logits;
+			for (int i = 0; i < n_vocab; i++) {
+				token_logits.push_back({ i, logits[i] });
+			}
+
+			// Sort by logit value in descending order
+			std::sort(token_logits.begin(), token_logits.end(),
+				[](const auto& a, const auto& b) { return a.second > b.second; });
+
+			// Print top N tokens with highest logits
+			std::cout << "\nTop " << maxLogits << " tokens:\n";
+			std::cout << "|--------|------------|---------------------------------|\n";
+			std::cout << "| Token  â Logit      â Text                            â\n";
+			std::cout << "|--------|------------|---------------------------------|\n";
+
+			for (size_t i = 0; i < std::min(maxLogits, token_logits.size()); i++) {
+				int token_id = token_logits[i].first;
+				float token_logit = token_logits[i].second;
+
+				// Get the token text (you'll need to adapt this based on your tokenizer implementation)
+				std::string token_text = tokenizer->decode(token_id);
+
+				// Escape special characters for display
+				std::string escaped_text = "";
+				for (char c : token_text) {
+					if (c == '\n') escaped_text += "\\n";
+					else if (c == '\r') escaped_text += "\\r";
+					else if (c == '\t') escaped_text += "\\t";
+					else if (c < 32 || c > 126) escaped_text += "Â·";
+					else escaped_text += c;
+				}
+
+				// Truncate if too long
+				if (escaped_text.length() > 31) {
+					escaped_text = escaped_text.substr(0, 28) + "...";
+				}
+
+				std::cout << "| " << std::setw(6) << token_id << " | "
+					<< std::setw(10) << std::fixed << std::setprecision(6) << token_logit << " | "
+					<< std::left << std::setw(31) << escaped_text << " |\n";
+			}
+
+			std::cout << "|--------|------------|---------------------------------|\n";
+		}
+#endif
+
+		// Helper function to save long context to a file
+		std::string saveLongContextToFile(const std::string& prompt, int prompt_token_count, int job_id) {
+			try {
+				// Create directory if it doesn't exist
+				std::filesystem::path overflow_dir = "overflow_contexts";
+				if (!std::filesystem::exists(overflow_dir)) {
+					std::filesystem::create_directories(overflow_dir);
+				}
+				
+				// Generate filename with timestamp and job ID
+				auto now = std::chrono::system_clock::now();
+				auto timestamp = std::chrono::system_clock::to_time_t(now);
+				std::stringstream filename;
+				filename << "overflow_contexts/context_job" << job_id 
+						 << "_" << timestamp << "_" << prompt_token_count << "tokens.txt";
+				
+				// Write prompt to file
+				std::ofstream outfile(filename.str());
+				if (!outfile.is_open()) {
+					return "";
+				}
+				
+				outfile << "=== Long Context Overflow ===" << std::endl;
+				outfile << "Job ID: " << job_id << std::endl;
+				outfile << "Timestamp: " << std::ctime(&timestamp);
+				outfile << "Token Count: " << prompt_token_count << std::endl;
+				outfile << "Context Window: " << n_ctx << std::endl;
+				outfile << "================================" << std::endl << std::endl;
+				outfile << prompt;
+				outfile.close();
+				
+				// Return filename (caller will log if needed)
+				return filename.str();
+			} catch (const std::exception& e) {
+				std::cerr << "[INFERENCE] [ERROR] Failed to save long context: " << e.what() << std::endl;
+				return "";
+			}
+		}
+
+		// StreamingLLM-style truncation on the token array: keeps the n_keep initial tokens
+		// (attention sinks) and the most recent ones, dropping the middle. Returns how many
+		// tokens were dropped right after the first n_keep; a cached copy of the full prompt
+		// can drop the same range in KV (0 when only the first tokens could be kept)
+		int truncateContextTokens(std::vector<llama_token>& tokens, int target_size) {
+			target_size = std::max(1, target_size);
+			const int size = static_cast<int>(tokens.size());
+			if (size <= target_size) {
+				return 0;
+			}
+
+			const int keep_recent = target_size - n_keep;
+			if (keep_recent <= 0) {
+				tokens.resize(target_size);
+				std::cerr << "[INFERENCE] [INFO] Context truncated from " << size
+						  << " to " << target_size << " tokens (first tokens only)" << std::endl;
+				return 0;
+			}
+
+			const int discarded = size - target_size;
+			tokens.erase(tokens.begin() + n_keep, tokens.begin() + n_keep + discarded);
+			std::cerr << "[INFERENCE] [INFO] Context automatically shifted: kept " << n_keep
+					  << " initial + " << keep_recent << " recent tokens, discarded "
+					  << discarded << " middle tokens (total: " << size
+					  << " -> " << tokens.size() << ")" << std::endl;
+			return discarded;
+		}
+
+		bool validateParameters(CompletionParameters& params, std::shared_ptr<Job> job) {
+			if (!params.isValid()) {
+				std::lock_guard<std::mutex> jobLock(job->mtx);
+				job->hasError = true;
+				job->errorMessage = "Invalid completion parameters";
+				job->cv.notify_all();
+				return false;
+			}
+
+			if (!params.loraAdapter.empty() && !loras.has(params.loraAdapter)) {
+				std::lock_guard<std::mutex> jobLock(job->mtx);
+				job->hasError = true;
+				job->errorMessage = "Unknown LoRA adapter '" + params.loraAdapter + "'";
+				job->cv.notify_all();
+				return false;
+			}
+			
+			// Tokenize the prompt to check size before processing; the tokens are kept on the
+			// job so the decode thread never tokenizes (this runs on the submitting thread)
+			job->prompt_tokens.clear();
+			job->promptCutTokens = 0;
+			const int ctx_limit = contextLimit(params);
+			if (!params.prompt.empty()) {
+				std::vector<llama_token> temp_tokens = params.promptTokens
+					? std::vector<llama_token>(params.promptTokens->begin(), params.promptTokens->end())
+					: tokenizer->tokenize(params.prompt, tokenizer->shouldAddBos());
+				int prompt_token_count = static_cast<int>(temp_tokens.size());
+				int generation_tokens = params.maxNewTokens > 0 ? params.maxNewTokens : 512; // Default estimate
+				int total_required = prompt_token_count + generation_tokens;
+				
+#ifdef DEBUG
+				// Save every prompt to file for logging/debugging (DEBUG builds only)
+				std::string saved_file = saveLongContextToFile(params.prompt, prompt_token_count, job->jobId);
+				if (!saved_file.empty()) {
+					std::cerr << "[INFERENCE] [INFO] Prompt saved (" << prompt_token_count 
+							  << " tokens) to: " << saved_file << std::endl;
+				}
+#endif
+				
+				// Check if prompt alone exceeds context
+				if (prompt_token_count >= ctx_limit) {
+					// If context shifting is allowed, truncate the prompt
+					if (params.allow_context_shift) {
+						// Calculate target size conservatively
+						// Account for potential KV cache state from slot reuse in test environments
+						// Use ~40% of context for prompt to leave room for generation + cached state
+						int target_prompt_tokens = (ctx_limit * 2) / 5;  // 40% of context
+						
+						if (target_prompt_tokens < 256) {
+							// Context window too small for shifting
+							std::lock_guard<std::mutex> jobLock(job->mtx);
+							job->hasError = true;
+							job->errorMessage = "Context window too small for automatic shifting";
+							job->isFinished = true;
+							job->cv.notify_all();
+							return false;
+						}
+						
+						// Truncate using StreamingLLM pattern; the tokens are kept as they are, so
+						// boundaries cannot change and a cached full prompt can be shifted in KV
+						job->promptCutTokens += truncateContextTokens(temp_tokens, target_prompt_tokens);
+						
+						std::cerr << "[INFERENCE] [INFO] Context shift enabled. Original prompt: " 
+								  << prompt_token_count << " tokens, truncated to " << temp_tokens.size()
+								  << " to fit " << ctx_limit << " context window" << std::endl;
+						
+						prompt_token_count = static_cast<int>(temp_tokens.size());
+						total_required = prompt_token_count + generation_tokens;
+					} else {
+						// Context shifting not enabled
+						std::lock_guard<std::mutex> jobLock(job->mtx);
+						job->hasError = true;
+						job->errorMessage = "Prompt too long for context window. Prompt tokens: " + 
+										   std::to_string(prompt_token_count) + 
+										   ", Context size: " + std::to_string(ctx_limit) + 
+										   ". Please reduce prompt length or enable allow_context_shift.";
+						job->isFinished = true;
+						job->cv.notify_all();
+						std::cerr << "[INFERENCE] [ERROR] " << job->errorMessage << std::endl;
+						return false;
+					}
+				}
+				
+				// Check if prompt + generation would exceed context (accounting for n_keep)
+				if (total_required > ctx_limit - n_keep) {
+					if (params.allow_context_shift && prompt_token_count < ctx_limit) {
+						// Reduce generation tokens to fit
+						int available_for_generation = ctx_limit - prompt_token_count - n_keep;
+						if (available_for_generation > 0) {
+							std::cerr << "[INFERENCE] [INFO] Adjusting maxNewTokens from " 
+									  << params.maxNewTokens << " to " << available_for_generation 
+									  << " to fit context window" << std::endl;
+							params.maxNewTokens = available_for_generation;
+						} else {
+							// Need to truncate prompt further
+							int target_prompt_tokens = ctx_limit - params.maxNewTokens - n_keep;
+							job->promptCutTokens += truncateContextTokens(temp_tokens, target_prompt_tokens);
+						}
+					} else {
+						// Prompt + generation exceeds context
+						std::lock_guard<std::mutex> jobLock(job->mtx);
+						job->hasError = true;
+						job->errorMessage = "Prompt + generation tokens (" + std::to_string(total_required) + 
+										   ") exceed context window (" + std::to_string(ctx_limit) + 
+										   "). Prompt: " + std::to_string(prompt_token_count) + 
+										   " tokens, Requested generation: " + std::to_string(generation_tokens) + 
+										   " tokens. Please reduce prompt or maxNewTokens, or enable allow_context_shift.";
+						job->isFinished = true;
+						job->cv.notify_all();
+						std::cerr << "[INFERENCE] [ERROR] " << job->errorMessage << std::endl;
+						return false;
+					}
+				}
+				
+				// Warn if getting close to limit (>80% usage)
+				if (total_required > (ctx_limit * 0.8)) {
+					std::cerr << "[INFERENCE] [WARNING] High context usage: " << total_required 
+							  << " / " << ctx_limit << " tokens (" 
+							  << (total_required * 100 / ctx_limit) << "%). Generation may be limited." << std::endl;
+				}
+
+				job->prompt_tokens = std::move(temp_tokens);
+			}
+			
+			return true;
+		}
+
+		common_sampler* initializeSampler(const CompletionParameters& params, std::shared_ptr<Job> job) {
+			auto sparams = g_params.sampling;
+			sparams.top_p = params.topP;
+			sparams.temp = params.temperature;
+			sparams.seed = params.randomSeed;
+			// sparams.top_k = params.topK;
+			sparams.no_perf = false;
+
+			// Handle grammar or JSON schema -> grammar
+			try {
+				if (!params.jsonSchema.empty()) {
+					sparams.grammar = samplerPool.schemaGrammar(params.jsonSchema);
+				} else if (!params.grammar.empty()) {
+					sparams.grammar = params.grammar;
+				}
+			} catch (const std::exception &e) {
+				std::lock_guard<std::mutex> jobLock(job->mtx);
+				job->hasError = true;
+				job->errorMessage = std::string("Failed to prepare grammar: ") + e.what();
+				job->cv.notify_all();
+				return nullptr;
+			}
+
+			SamplerPool::makeKey(sparams, job->samplerKey);
+			common_sampler* sampler = samplerPool.acquire(model, sparams, job->samplerKey);
+			if (!sampler) {
+				std::lock_guard<std::mutex> jobLock(job->mtx);
+				job->hasError = true;
+				job->errorMessage = "Could not initialize sampler";
+				job->cv.notify_all();
+				return nullptr;
+			}
+			return sampler;
+		}
+
+		// Hand the job's sampler back to the pool for the next job with the same settings
+		void releaseSampler(const std::shared_ptr<Job>& job) {
+			samplerPool.release(job->samplerKey, job->smpl);
+			job->smpl = nullptr;
+		}
+
+		bool loadSession(std::shared_ptr<Job> job) {
+			if (!job->path_session.empty()) {
+				// Use the logical session id from params for file-backed sessions
+				const int session_seq = job->params.seqId;
+				if (!load_kv_cache(job->path_session, std::move(job->session_snapshot), job->session_tokens, session_seq)) {
+					std::cerr << "[INFERENCE] [ERROR] Failed to load KV cache from: " 
+							  << job->path_session << std::endl;
+					return false;
+				}
+				
+				// CRITICAL FIX: After loading session, validate against new prompt size
+				if (!job->params.prompt.empty()) {
+					int session_token_count = static_cast<int>(job->session_tokens.size());
+					int new_prompt_tokens = static_cast<int>(job->prompt_tokens.size());
+					int total_tokens = session_token_count + new_prompt_tokens;
+					
+					if (total_tokens >= n_ctx) {
+						// Save the combined context to a file
+						std::stringstream combined_context;
+						combined_context << "=== Session Context ===" << std::endl;
 						combined_context << tokenizer->detokenize(job->session_tokens) << std::endl;
 						combined_context << std::endl << "=== New Prompt ===" << std::endl;
 						combined_context << job->params.prompt << std::endl;
@@ -1260,771 +4676,2726 @@ namespace
 									  << ") exceed context (" << n_ctx << "). "
 									  << "Please reduce prompt or start new session." << std::endl;
 						}
-						return false;
-					}
-					
-					// Warn if combined usage is high
-					if (total_tokens > (n_ctx * 0.75)) {
-						std::cerr << "[INFERENCE] [WARNING] High context usage after session load: " 
-								  << total_tokens << "/" << n_ctx << " tokens ("
-								  << (total_tokens * 100 / n_ctx) << "%). "
-								  << "Limited room for generation." << std::endl;
+						return false;
+					}
+					
+					// Warn if combined usage is high
+					if (total_tokens > (n_ctx * 0.75)) {
+						std::cerr << "[INFERENCE] [WARNING] High context usage after session load: " 
+								  << total_tokens << "/" << n_ctx << " tokens ("
+								  << (total_tokens * 100 / n_ctx) << "%). "
+								  << "Limited room for generation." << std::endl;
+					}
+				}
+			}
+			return true;
+		}
+
+		bool getInputTokens(std::shared_ptr<Job> job) {
+			// The prompt was tokenized at submission
+			if (job->session_tokens.empty() || !job->params.prompt.empty()) {
+				job->embd_inp = std::move(job->prompt_tokens);
+				job->prompt_tokens.clear();
+			}
+			else {
+				job->embd_inp = job->session_tokens;
+			}
+			
+			// CRITICAL FIX: Validate token count before processing
+			// Calculate available context considering session tokens and generation needs
+			int session_token_count = static_cast<int>(job->session_tokens.size());
+			int available_ctx = n_ctx - session_token_count;
+			int required_tokens = static_cast<int>(job->embd_inp.size());
+			int generation_tokens = job->params.maxNewTokens > 0 ? job->params.maxNewTokens : 512; // Default estimate
+			
+			if (required_tokens > available_ctx) {
+				std::cerr << "[INFERENCE] [ERROR] Input token count (" << required_tokens 
+						  << ") exceeds available context (" << available_ctx 
+						  << "). Session tokens: " << session_token_count
+						  << ", Total context: " << n_ctx << std::endl;
+				return false;
+			}
+			
+			// Warn if there's insufficient room for generation
+			if (required_tokens + generation_tokens > n_ctx - n_keep) {
+				std::cerr << "[INFERENCE] [WARNING] Input tokens (" << required_tokens 
+						  << ") + requested generation (" << generation_tokens 
+						  << ") may exceed context window (" << n_ctx 
+						  << "). Generation may be truncated." << std::endl;
+			}
+			
+			return true;
+		}
+
+		bool ensureNonEmptyInput(std::shared_ptr<Job> job) {
+			if (job->embd_inp.empty()) {
+				if (tokenizer->shouldAddBos()) {
+					job->embd_inp.push_back(llama_vocab_bos(llama_model_get_vocab(tokenizer->getModel())));
+				}
+				else {
+					return false;
+				}
+			}
+			return true;
+		}
+
+		bool checkCancellation(std::shared_ptr<Job> job) {
+			return job->cancelRequested.load();
+		}
+
+		// Context a job's sequence may grow to
+		int contextLimit(const CompletionParameters& params) const {
+			return params.maxContext > 0 ? std::min(params.maxContext, max_seq_ctx) : max_seq_ctx;
+		}
+
+		// How many of `tokens` more cells the job's sequence can take, with paged KV only as many
+		// as its blocks cover once grown as far as the pool allows
+		int growSequence(const std::shared_ptr<Job>& job, int tokens) {
+			if (block_tokens <= 0 || tokens <= 0) return tokens;
+			const int covered = slotManager.reserve(job->seqId, job->n_past + tokens);
+			return std::max(0, std::min(tokens, covered - job->n_past));
+		}
+
+		bool ensureContextCapacity(std::shared_ptr<Job> job) {
+			const int limit = contextLimit(job->params);
+			if (job->n_past + 1 > limit) {
+#ifdef DEBUG
+				std::cout << "[INFERENCE] Context capacity check: n_past=" << job->n_past 
+						  << ", limit=" << limit << ", attempting trim..." << std::endl;
+#endif
+				// Pass n_discard from job params (0 means use default n_left/2)
+				kv_cache_seq_ltrim(context, n_keep, job->session_tokens, job->n_past, job->seqId, job->params.n_discard);
+				job->isContextShifted = true;
+				
+				// IMPROVED: Better error reporting after trim attempt
+				if (job->n_past + 1 > limit) {
+					std::cerr << "[INFERENCE] [ERROR] Context overflow: Cannot fit tokens even after trimming. "
+							  << "n_past=" << job->n_past << ", limit=" << limit 
+							  << ", n_keep=" << n_keep << ". "
+							  << "Context budget exhausted. Consider reducing prompt or maxNewTokens." 
+							  << std::endl;
+					return false;
+				}
+#ifdef DEBUG
+				std::cout << "[INFERENCE] Trim successful. New n_past=" << job->n_past << std::endl;
+#endif
+			}
+			return true;
+		}
+
+		// Copies the sequence state into memory; the file is written by sessionStore
+		void saveSession(std::shared_ptr<Job> job) {
+			if (!job->path_session.empty()) {
+				// Use the logical session id from params for file-backed sessions
+				const int session_seq = job->params.seqId;
+				auto snapshot = std::make_shared<SessionSnapshot>();
+				snapshot->tokens = job->session_tokens;
+				snapshot->state.resize(llama_state_seq_get_size(context, session_seq));
+				const size_t written = llama_state_seq_get_data(context, snapshot->state.data(), snapshot->state.size(), session_seq);
+				if (written == 0) {
+					std::cerr << "[KV] ERROR: Failed to copy session state for " << job->path_session << std::endl;
+					return;
+				}
+				snapshot->state.resize(written);
+				sessionStore.save(job->path_session, std::move(snapshot));
+			}
+		}
+
+		// Reuse the longest cached prompt prefix instead of decoding it; at least the last
+		// prompt token is always decoded so its logits are available for sampling. The cache
+		// only holds base-model KV, which a job with a LoRA adapter cannot use
+		void restorePromptPrefix(std::shared_ptr<Job> job) {
+			if (!prefixCache.enabled() || !job->path_session.empty() || !job->params.loraAdapter.empty() || job->n_prompt < 2) return;
+
+			const size_t reused = prefixCache.restore(job->embd_inp, job->seqId, static_cast<size_t>(job->n_prompt - 1));
+			if (reused == 0) return;
+
+			for (size_t i = 0; i < reused; ++i) {
+				common_sampler_accept(job->smpl, job->embd_inp[i], false);
+			}
+			job->session_tokens.assign(job->embd_inp.begin(), job->embd_inp.begin() + reused);
+			job->n_past = static_cast<int>(reused);
+			job->i_prompt = static_cast<int>(reused);
+#ifdef DEBUG
+			std::cout << "[INFERENCE] [KV] Reused " << reused << "/" << job->n_prompt
+					  << " prompt tokens from the prefix cache" << std::endl;
+#endif
+		}
+
+		// Find the cached document chunks in the part of the prompt still to decode; the last
+		// prompt token is always decoded. The chunks hold base-model KV, like the prefix cache
+		void planChunkSplices(std::shared_ptr<Job> job) {
+			job->chunkSplices.clear();
+			if (!chunkCache.enabled() || !job->params.loraAdapter.empty() || job->n_prompt < 2) return;
+
+			job->chunkSplices = chunkCache.find(job->embd_inp, static_cast<size_t>(job->i_prompt), static_cast<size_t>(job->n_prompt - 1));
+#ifdef DEBUG
+			if (!job->chunkSplices.empty()) {
+				std::cout << "[INFERENCE] [KV] " << job->chunkSplices.size() << " cached document chunk(s) found in a "
+						  << job->n_prompt << "-token prompt" << std::endl;
+			}
+#endif
+		}
+
+		// Put a cached chunk's cells into the job's sequence in place of decoding its tokens: the
+		// state is restored into the chunk sequence, its edge tokens dropped, the rest shifted to
+		// where the prompt has it (llama_memory_seq_add re-rotates the keys at the next decode)
+		// and the cells handed to the job. False, leaving the tokens to decode, if the state does
+		// not fit the KV cache
+		bool spliceChunk(std::shared_ptr<Job> job, const Job::ChunkSplice& splice) {
+			const SessionSnapshot & chunk = *splice.chunk;
+			const llama_pos end = static_cast<llama_pos>(chunk.tokens.size()) - 1;
+			const llama_pos n = end - 1;
+			auto * mem = llama_get_memory(context);
+
+			const bool restored = llama_state_seq_set_data(context, chunk.state.data(), chunk.state.size(), chunkSeq) != 0;
+			if (restored) {
+				llama_memory_seq_rm(mem, chunkSeq, /*p0=*/0, /*p1=*/1);
+				llama_memory_seq_rm(mem, chunkSeq, end, /*p1=*/-1);
+				llama_memory_seq_add(mem, chunkSeq, 1, end, static_cast<llama_pos>(splice.begin) - 1);
+				llama_memory_seq_cp(mem, chunkSeq, job->seqId, static_cast<llama_pos>(splice.begin), static_cast<llama_pos>(splice.begin) + n);
+			}
+			llama_memory_seq_rm(mem, chunkSeq, /*p0=*/0, /*p1=*/-1);
+			if (!restored) return false;
+
+			for (llama_pos i = 0; i < n; ++i) {
+				const llama_token token = job->embd_inp[job->i_prompt];
+				common_sampler_accept(job->smpl, token, false);
+				job->session_tokens.push_back(token);
+				++(job->i_prompt);
+				++(job->n_past);
+			}
+			counters.chunk_tokens.fetch_add(static_cast<uint64_t>(n), std::memory_order_relaxed);
+			return true;
+		}
+
+		// True while a candidate of an n > 1 request should wait for its first candidate's
+		// prompt. It stops waiting (and decodes the prompt itself) once sharing is no longer
+		// possible: the first candidate is gone, already generating, or not in this decode loop
+		bool awaitsPromptFork(const std::shared_ptr<Job>& job, const std::vector<std::shared_ptr<Job>>& current_jobs) {
+			if (job->isPromptPrepared) return false;
+			std::shared_ptr<Job> leader = job->forkFrom.lock();
+			if (!leader) return false;
+
+			if (g_params.kv_unified && std::find(current_jobs.begin(), current_jobs.end(), leader) != current_jobs.end()) {
+				std::lock_guard<std::mutex> leaderLock(leader->mtx);
+				// the prompt's last tokens may be in this step's batch; forkPrompt runs once they are decoded
+				const bool pending = leader->isDecodingPrompt || (leader->n_past == leader->n_prompt && leader->generatedTokens.empty());
+				if (pending && leader->jobId == job->forkFromId && !leader->isFinished && !leader->hasError) return true;
+			}
+			job->forkFrom.reset();
+			return false;
+		}
+
+		// Copy the just decoded prompt of `leader` into the sequences of the candidates waiting
+		// for it; they sample their first token from the same logits in the next step
+		void forkPrompt(const std::shared_ptr<Job>& leader, const std::vector<std::shared_ptr<Job>>& current_jobs) {
+			std::lock_guard<std::mutex> leaderLock(leader->mtx);
+			if (leader->isDecodingPrompt || leader->isFinished || leader->hasError || leader->seqId < 0) return;
+
+			auto * mem = llama_get_memory(context);
+			for (const auto &job : current_jobs) {
+				if (job == leader) continue;
+				std::lock_guard<std::mutex> jobLock(job->mtx);
+				if (job->forkFrom.lock() != leader || job->forkFromId != leader->jobId || job->isPromptPrepared || job->isFinished || job->hasError || job->seqId < 0) {
+					continue;
+				}
+
+				spillEvictedSession(job);
+				llama_memory_seq_rm(mem, job->seqId, /*p0=*/0, /*p1=*/-1);
+				llama_memory_seq_cp(mem, leader->seqId, job->seqId, /*p0=*/0, /*p1=*/-1);
+
+				job->embd_inp = leader->embd_inp;
+				job->prompt_tokens.clear();
+				for (llama_token token : job->embd_inp) {
+					common_sampler_accept(job->smpl, token, false);
+				}
+				job->session_tokens = leader->session_tokens;
+				job->n_prompt = leader->n_prompt;
+				job->i_prompt = leader->i_prompt;
+				job->n_past = leader->n_past;
+				job->batch_pos = leader->batch_pos;
+				job->isContextShifted = leader->isContextShifted;
+				job->isPromptPrepared = true;
+				job->isDecodingPrompt = false;
+				job->logitTokens = leader->logitTokens;
+				job->logitsStep = leader->logitsStep;
+				job->forkFrom.reset();
+			}
+		}
+
+		// Pick the adapter this step decodes with (step_lora). The previous step's adapter keeps
+		// the batch while its jobs have work, for at most kLoraStepQuantum steps in a row once
+		// jobs with other adapters are waiting; then the next adapter by name takes over
+		void chooseStepAdapter(const std::vector<std::shared_ptr<Job>>& current_jobs) {
+			std::set<std::string> waiting;
+			for (const auto &job : current_jobs) {
+				std::lock_guard<std::mutex> jl(job->mtx);
+				if (!job->isFinished && !job->hasError && !job->swapped) waiting.insert(job->params.loraAdapter);
+			}
+			if (waiting.empty()) return;
+
+			if (waiting.count(step_lora) && (waiting.size() == 1 || lora_steps < kLoraStepQuantum)) {
+				lora_steps = waiting.size() == 1 ? 1 : lora_steps + 1;
+				return;
+			}
+			auto next = waiting.upper_bound(step_lora);
+			step_lora = next != waiting.end() ? *next : *waiting.begin();
+			lora_steps = 1;
+		}
+
+		// The adapter could not be loaded; its jobs end with an error instead of waiting forever
+		void failAdapterJobs(const std::vector<std::shared_ptr<Job>>& current_jobs, const std::string& adapter) {
+			for (const auto &job : current_jobs) {
+				std::lock_guard<std::mutex> jobLock(job->mtx);
+				if (job->isFinished || job->params.loraAdapter != adapter) continue;
+				dropSwapped(job);
+				releaseSampler(job);
+				if (job->seqId >= 0) { slotManager.release(job->seqId); job->seqId = -1; }
+				job->hasError = true;
+				job->isFinished = true;
+				job->errorMessage = "Failed to load LoRA adapter '" + adapter + "'";
+				job->cv.notify_all();
+			}
+		}
+
+		// After a decode, remember which tokens produced the logits the job samples next. Decodes
+		// besides the regular steps (another adapter's step, a precomputed chunk, a scoring pass)
+		// can overwrite them, and a preempted job resumes without them; it then decodes its logit
+		// tokens again
+		void recordLogitTokens(const std::shared_ptr<Job>& job) {
+			job->logitTokens.clear();
+			if (job->isDecodingPrompt) return;
+			if (job->draftIdxs.empty()) {
+				job->logitTokens.push_back(batch.token[job->batch_pos]);
+			}
+			else {
+				for (int idx : job->draftIdxs) job->logitTokens.push_back(batch.token[idx]);
+			}
+			job->logitsStep = decode_step;
+		}
+
+		// Decode the job's logit tokens again, in place: they are the last ones in its KV
+		bool replayLogits(const std::shared_ptr<Job>& job) {
+			const int n = static_cast<int>(job->logitTokens.size());
+			const llama_pos first = static_cast<llama_pos>(job->n_past - n);
+			if (first < 0 || !llama_memory_seq_rm(llama_get_memory(context), job->seqId, first, /*p1=*/-1)) {
+				return false;
+			}
+
+			const bool drafting = !job->draftIdxs.empty();
+			job->draftIdxs.clear();
+			for (int i = 0; i < n; ++i) {
+				common_batch_add(batch, job->logitTokens[i], first + i, { job->seqId }, true);
+				if (drafting) job->draftIdxs.push_back(batch.n_tokens - 1);
+			}
+			job->batch_pos = batch.n_tokens - n;
+			return true;
+		}
+
+		// Add up to max_tokens of the job's pending prompt to the batch; returns how many were added.
+		// Cached chunks on the way are spliced in and take no batch space
+		int feedPromptTokens(std::shared_ptr<Job> job, int max_tokens) {
+			// the planned positions no longer hold once the KV was shifted
+			if (job->isContextShifted) job->chunkSplices.clear();
+
+			int added = 0;
+			for (; added < max_tokens && job->i_prompt < job->n_prompt; ++added) {
+				while (!job->chunkSplices.empty() && job->chunkSplices.front().begin == job->i_prompt) {
+					spliceChunk(job, job->chunkSplices.front());
+					job->chunkSplices.erase(job->chunkSplices.begin());
+				}
+
+				llama_token token = job->embd_inp[job->i_prompt];
+				common_batch_add(batch, token, job->i_prompt, { job->seqId }, false);
+				if (job->i_prompt == job->n_prompt - 1)
+				{
+					batch.logits[batch.n_tokens - 1] = true;
+					job->batch_pos = batch.n_tokens - 1;
+				}
+
+				common_sampler_accept(job->smpl, token, false);
+				job->session_tokens.push_back(token);
+				++(job->i_prompt);
+				++(job->n_past);
+			}
+
+			if (job->i_prompt >= job->n_prompt) {
+				job->isDecodingPrompt = false;
+			}
+			counters.prompt_tokens.fetch_add(static_cast<uint64_t>(added), std::memory_order_relaxed);
+			return added;
+		}
+
+		// Keep the part of a warm slot's KV the new prompt starts with and drop the rest;
+		// at least the last prompt token is left to decode so its logits are available
+		size_t reuseWarmSlot(std::shared_ptr<Job> job) {
+			std::vector<llama_token> warm_tokens;
+			warm_tokens.swap(job->warm_tokens);
+			shiftWarmSlot(job, warm_tokens);
+
+			const size_t limit = std::min(warm_tokens.size(), job->embd_inp.size() - 1);
+			size_t n_reused = 0;
+			while (n_reused < limit && warm_tokens[n_reused] == job->embd_inp[n_reused]) {
+				++n_reused;
+			}
+
+			llama_memory_seq_rm(llama_get_memory(context), job->seqId, static_cast<llama_pos>(n_reused), /*p1=*/-1);
+			for (size_t i = 0; i < n_reused; ++i) {
+				common_sampler_accept(job->smpl, job->embd_inp[i], false);
+			}
+			job->session_tokens.assign(job->embd_inp.begin(), job->embd_inp.begin() + n_reused);
+#ifdef DEBUG
+			std::cout << "[INFERENCE] [KV] Warm slot " << job->seqId << " reused " << n_reused << "/"
+					  << job->embd_inp.size() << " prompt tokens" << std::endl;
+#endif
+			return n_reused;
+		}
+
+		// A prompt cut by context shifting no longer starts with the conversation cached in its
+		// warm slot. When the slot's tokens after the first n_keep reappear further into the
+		// prompt, drop the tokens in between from the KV and shift the rest down, as
+		// kv_cache_seq_ltrim does mid-generation, instead of decoding them again. The cut is
+		// searched for rather than taken from promptCutTokens, since the slot may hold a turn
+		// that was already cut itself
+		void shiftWarmSlot(std::shared_ptr<Job> job, std::vector<llama_token>& warm_tokens) {
+			const size_t begin = static_cast<size_t>(std::max(0, n_keep));
+			if (job->promptCutTokens <= 0 || warm_tokens.size() <= begin + 1 || job->embd_inp.size() <= begin + 1
+				|| llama_model_is_recurrent(model)
+				|| !std::equal(warm_tokens.begin(), warm_tokens.begin() + begin, job->embd_inp.begin())) {
+				return;
+			}
+
+			// longest run of cached tokens continuing the kept head (offset by the cut), the
+			// last prompt token excluded
+			const size_t prompt_left = job->embd_inp.size() - 1 - begin;
+			size_t cut = 0;
+			size_t n_match = 0;
+			for (size_t c = 0; begin + c < warm_tokens.size(); ++c) {
+				const size_t possible = std::min(warm_tokens.size() - begin - c, prompt_left);
+				if (possible <= n_match) break;
+				size_t m = 0;
+				while (m < possible && warm_tokens[begin + c + m] == job->embd_inp[begin + m]) ++m;
+				if (m > n_match) {
+					n_match = m;
+					cut = c;
+				}
+			}
+			// cut == 0: the slot continues the head unshifted, the prefix match takes it as is
+			if (cut == 0 || n_match == 0) {
+				return;
+			}
+
+			auto * mem = llama_get_memory(context);
+			llama_memory_seq_rm(mem, job->seqId, static_cast<llama_pos>(begin), static_cast<llama_pos>(begin + cut));
+			llama_memory_seq_add(mem, job->seqId, static_cast<llama_pos>(begin + cut), /*p1=*/-1, -static_cast<llama_pos>(cut));
+			warm_tokens.erase(warm_tokens.begin() + begin, warm_tokens.begin() + begin + cut);
+			job->isContextShifted = true;
+#ifdef DEBUG
+			std::cout << "[INFERENCE] [KV] Warm slot " << job->seqId << " shifted by " << cut
+					  << " tokens, " << begin + n_match << " cached tokens reused" << std::endl;
+#endif
+		}
+
+		// KV of `tokens` decoded alone from position 0 with the base model, read out of the chunk
+		// sequence, which is left empty (decode thread only). The running jobs' logits are
+		// overwritten, so they decode their logit tokens again (see recordLogitTokens())
+		std::shared_ptr<SessionSnapshot> decodeChunk(const std::vector<llama_token>& tokens) {
+			if (loras.enabled() && !loras.apply(context, "")) return nullptr;
+
+			llama_batch chunk_batch = llama_batch_init(n_batch, 0, 1);
+			bool decoded = true;
+			for (size_t i = 0; decoded && i < tokens.size(); i += static_cast<size_t>(n_batch)) {
+				common_batch_clear(chunk_batch);
+				const size_t end = std::min(tokens.size(), i + static_cast<size_t>(n_batch));
+				for (size_t j = i; j < end; ++j) {
+					common_batch_add(chunk_batch, tokens[j], static_cast<llama_pos>(j), { chunkSeq }, false);
+				}
+				counters.recordDecode(chunk_batch.n_tokens);
+				decoded = llama_decode(context, chunk_batch) == 0;
+				++decode_step;
+			}
+			llama_batch_free(chunk_batch);
+
+			std::shared_ptr<SessionSnapshot> chunk = decoded ? snapshotSequence(chunkSeq, tokens) : nullptr;
+			llama_memory_seq_rm(llama_get_memory(context), chunkSeq, /*p0=*/0, /*p1=*/-1);
+			return chunk;
+		}
+
+		// KV state of slot `seq`, whose cells hold `tokens`; nullptr if it cannot be read (decode thread only)
+		std::shared_ptr<SessionSnapshot> snapshotSequence(int seq, std::vector<llama_token> tokens) {
+			auto snapshot = std::make_shared<SessionSnapshot>();
+			snapshot->tokens = std::move(tokens);
+			snapshot->state.resize(llama_state_seq_get_size(context, seq));
+			const size_t written = llama_state_seq_get_data(context, snapshot->state.data(), snapshot->state.size(), seq);
+			if (written == 0) return nullptr;
+			snapshot->state.resize(written);
+			return snapshot;
+		}
+
+		std::string prefixCachePath(size_t index) const {
+			return (prefixCacheDir / ("prefix-" + prefixCacheTag + "-" + std::to_string(index) + ".bin")).string();
+		}
+
+		// Snapshots the prefix cache, most recently used entry first, and hands the files to the
+		// session store's writer (decode thread, or after it stopped)
+		void savePrefixCache() {
+			const auto cached = prefixCache.cached();
+			for (size_t i = 0; i < prefixCache.capacity(); ++i) {
+				std::shared_ptr<SessionSnapshot> snapshot = i < cached.size() ? snapshotSequence(cached[i].first, cached[i].second) : nullptr;
+				if (snapshot) {
+					sessionStore.save(prefixCachePath(i), std::move(snapshot));
+				}
+				else {
+					sessionStore.discard(prefixCachePath(i));
+				}
+			}
+			savedPrefixVersion = prefixCache.version();
+			lastPrefixSave = std::chrono::steady_clock::now();
+		}
+
+		// Reads the prefixes an earlier load saved and loads them between decode steps
+		void restorePrefixCache() {
+			std::error_code ec;
+			std::filesystem::create_directories(prefixCacheDir, ec);
+
+			std::vector<std::shared_ptr<const SessionSnapshot>> saved;
+			for (size_t i = 0; i < prefixCache.capacity(); ++i) {
+				if (auto snapshot = sessionStore.load(prefixCachePath(i))) saved.push_back(std::move(snapshot));
+			}
+
+			size_t restored = 0;
+			size_t tokens = 0;
+			const bool ran = runOnDecodeThread([this, &saved, &restored, &tokens] {
+				// least recently used first, so the most recent prefix is evicted last
+				for (auto it = saved.rbegin(); it != saved.rend(); ++it) {
+					if (prefixCache.load(**it)) {
+						++restored;
+						tokens += (*it)->tokens.size();
+					}
+				}
+				savedPrefixVersion = prefixCache.version();
+			});
+			if (!ran) return;
+			prefixRestored = true;
+			if (restored > 0) {
+				std::cout << "[INFERENCE] [KV] Restored " << restored << " cached prompt prefix(es), "
+					<< tokens << " tokens, from " << prefixCacheDir.string() << std::endl;
+			}
+		}
+
+		// Copies a conversation's KV out of slot `seq` into the tier cache (decode thread only)
+		void spillSession(int seq, const std::string& key, std::vector<llama_token> tokens) {
+			if (key.empty() || tokens.empty()) return;
+
+			if (auto snapshot = snapshotSequence(seq, std::move(tokens))) {
+				tierCache.put(key, std::move(snapshot));
+			}
+		}
+
+		// The warm slot this job reclaimed at submission still holds another conversation
+		void spillEvictedSession(std::shared_ptr<Job> job) {
+			if (job->evicted_tokens.empty()) return;
+			spillSession(job->seqId, job->evicted_key, std::move(job->evicted_tokens));
+			job->evicted_key.clear();
+			job->evicted_tokens.clear();
+			llama_memory_seq_rm(llama_get_memory(context), job->seqId, /*p0=*/0, /*p1=*/-1);
+		}
+
+		// Puts a conversation taken from the tier cache back into the job's slot; from there
+		// it is reused exactly like a warm slot
+		void restoreSpilledSession(std::shared_ptr<Job> job) {
+			if (!job->path_session.empty() || !job->session_snapshot) return;
+
+			std::shared_ptr<const SessionSnapshot> snapshot = std::move(job->session_snapshot);
+			job->session_snapshot.reset();
+			if (llama_state_seq_set_data(context, snapshot->state.data(), snapshot->state.size(), job->seqId) == 0) {
+				llama_memory_seq_rm(llama_get_memory(context), job->seqId, /*p0=*/0, /*p1=*/-1);
+				return;
+			}
+			job->warm_tokens = snapshot->tokens;
+		}
+
+		// Keeps the KV state of a prefillOnly job's decoded prompt for getJobKvState() (decode thread only)
+		void exportPromptState(std::shared_ptr<Job> job) {
+			if (job->isContextShifted || job->n_past != static_cast<int>(job->embd_inp.size())) {
+				job->hasError = true;
+				job->errorMessage = "The prompt was shifted to fit the context; its KV state cannot be transferred";
+				return;
+			}
+
+			job->kv_export = snapshotSequence(job->seqId, job->embd_inp);
+			if (!job->kv_export) {
+				job->hasError = true;
+				job->errorMessage = "Failed to read the prompt's KV state";
+			}
+		}
+
+		// Preemption, once per step: paused jobs resume, most urgent first, in slots no caller of
+		// higher priority waits for. Then, while such a caller still finds every slot taken, the
+		// lowest-priority running job below it (the latest submitted among equals, which loses
+		// the least) is paused: its KV is copied to host RAM and its slot freed for the caller
+		void swapJobs(const std::vector<std::shared_ptr<Job>>& current_jobs) {
+			std::vector<std::shared_ptr<Job>> paused;
+			for (const auto &job : current_jobs) {
+				std::lock_guard<std::mutex> jl(job->mtx);
+				if (job->swapped && !job->isFinished && !job->hasError) paused.push_back(job);
+			}
+			std::stable_sort(paused.begin(), paused.end(), [](const auto &a, const auto &b) {
+				return a->params.priority > b->params.priority;
+			});
+			// paged KV: running jobs are still short of blocks, a resumed one would only add to it
+			if (kv_short) paused.clear();
+			for (const auto &job : paused) {
+				std::lock_guard<std::mutex> jl(job->mtx);
+				SlotManager::Evicted evicted;
+				const int id = slotManager.resume({ job->params.tenant, job->params.tenantWeight, job->params.tenantMaxSlots,
+					job->params.priority, job->n_past + 1 }, evicted);
+				if (id < 0) break;
+
+				auto * mem = llama_get_memory(context);
+				if (tierCache.enabled()) spillSession(id, evicted.key, std::move(evicted.tokens));
+				llama_memory_seq_rm(mem, id, /*p0=*/0, /*p1=*/-1);
+				if (llama_state_seq_set_data(context, job->swapped->state.data(), job->swapped->state.size(), id) == 0) {
+					// the KV buffer is full; it retries once a running job has freed cells
+					slotManager.release(id);
+					if (slotManager.inUse() > 0) break;
+					dropSwapped(job);
+					releaseSampler(job);
+					job->hasError = true;
+					job->isFinished = true;
+					job->errorMessage = "Could not restore the KV state of a preempted job";
+					job->cv.notify_all();
+					continue;
+				}
+				dropSwapped(job);
+				job->seqId = id;
+				job->draftKvSynced = false;
+				// the logits it samples next were lost with the slot; the next step decodes them again
+				job->logitsStep = 0;
+			}
+
+			const int urgent = slotManager.urgentPriority();
+			if (urgent == SlotManager::kNoneWaiting) return;
+			std::shared_ptr<Job> victim = pickVictim(current_jobs, urgent);
+			if (!victim) return;
+			std::lock_guard<std::mutex> jl(victim->mtx);
+			if (!swapOut(victim)) return;
+#ifdef DEBUG
+			std::cout << "[INFERENCE] Preempted job " << victim->jobId << " (priority " << victim->params.priority
+				<< ") for a waiting job of priority " << urgent << std::endl;
+#endif
+		}
+
+		// The running job of lowest priority below `below`, the latest submitted among equals
+		std::shared_ptr<Job> pickVictim(const std::vector<std::shared_ptr<Job>>& current_jobs, int below) {
+			std::shared_ptr<Job> victim;
+			for (const auto &job : current_jobs) {
+				std::lock_guard<std::mutex> jl(job->mtx);
+				if (job->isFinished || job->hasError || job->swapped || job->seqId < 0 || !job->isPromptPrepared
+					|| job->params.prefillOnly || job->params.priority >= below) {
+					continue;
+				}
+				if (!victim || job->params.priority <= victim->params.priority) victim = job;
+			}
+			return victim;
+		}
+
+		// Moves a running job's KV to host RAM and frees its slot, within the swap budget.
+		// The caller holds the job's lock
+		bool swapOut(const std::shared_ptr<Job>& job) {
+			const size_t held = counters.swapped_bytes.load(std::memory_order_relaxed);
+			if (held + llama_state_seq_get_size(context, job->seqId) > preempt_swap_bytes) return false;
+			std::shared_ptr<SessionSnapshot> snapshot = snapshotSequence(job->seqId, {});
+			if (!snapshot) return false;
+			slotManager.release(job->seqId);
+			job->seqId = -1;
+			counters.swapped_jobs.fetch_add(1, std::memory_order_relaxed);
+			counters.swapped_bytes.fetch_add(snapshot->state.size(), std::memory_order_relaxed);
+			counters.preemptions.fetch_add(1, std::memory_order_relaxed);
+			job->swapped = std::move(snapshot);
+			return true;
+		}
+
+		// Paged KV with no block left for any running sequence: the least urgent job moves to host
+		// RAM, or ends when it cannot, and its blocks go to the others
+		void relieveBlockPressure(const std::vector<std::shared_ptr<Job>>& current_jobs) {
+			std::shared_ptr<Job> victim = pickVictim(current_jobs, std::numeric_limits<int>::max());
+			if (!victim) return;
+			std::lock_guard<std::mutex> jl(victim->mtx);
+			if (preempt_swap_bytes > 0 && swapOut(victim)) return;
+			releaseSampler(victim);
+			slotManager.release(victim->seqId);
+			victim->seqId = -1;
+			victim->hasError = true;
+			victim->isFinished = true;
+			victim->errorMessage = "KV cache is full";
+			victim->cv.notify_all();
+		}
+
+		// Forgets the KV a paused job holds in host RAM
+		void dropSwapped(const std::shared_ptr<Job>& job) {
+			if (!job->swapped) return;
+			counters.swapped_jobs.fetch_sub(1, std::memory_order_relaxed);
+			counters.swapped_bytes.fetch_sub(job->swapped->state.size(), std::memory_order_relaxed);
+			job->swapped.reset();
+		}
+
+		// Ends a job suspended for migration. One that was generating leaves the KV of its prompt
+		// and output for getJobKvState(); its slot is not kept warm, the conversation moves on
+		void suspendRunningJob(std::shared_ptr<Job> job) {
+			if (!job->isDecodingPrompt && !job->isContextShifted && job->seqId >= 0 && !job->generatedTokens.empty()) {
+				std::vector<llama_token> tokens = job->embd_inp;
+				tokens.insert(tokens.end(), job->generatedTokens.begin(), job->generatedTokens.end());
+				if (tokens.size() <= static_cast<size_t>(job->n_past)) {
+					// drafts not verified yet are not part of the output
+					llama_memory_seq_rm(llama_get_memory(context), job->seqId, static_cast<llama_pos>(tokens.size()), /*p1=*/-1);
+					job->kv_export = snapshotSequence(job->seqId, std::move(tokens));
+				}
+			}
+			releaseSampler(job);
+			if (job->seqId >= 0) { slotManager.release(job->seqId); job->seqId = -1; }
+			job->suspended = true;
+			job->isFinished = true;
+			job->cv.notify_all();
+		}
+
+		// Successful jobs with a session key leave their KV in place for the next turn
+		void releaseFinishedSlot(std::shared_ptr<Job> job) {
+			if (job->seqId < 0) return;
+			if (!job->params.sessionKey.empty() && job->path_session.empty() && !job->hasError) {
+				slotManager.release(job->seqId, job->params.sessionKey, std::move(job->session_tokens));
+				job->session_tokens.clear();
+			}
+			else {
+				slotManager.release(job->seqId);
+			}
+			job->seqId = -1;
+		}
+
+		// Park the job's decoded prompt in the prefix cache before its slot is wiped (base model only)
+		void cachePromptPrefix(std::shared_ptr<Job> job) {
+			if (!prefixCache.enabled() || job->seqId < 0 || job->isDecodingPrompt || job->isContextShifted
+				|| !job->path_session.empty() || !job->params.loraAdapter.empty() || job->hasError) {
+				return;
+			}
+			prefixCache.store(job->embd_inp, static_cast<size_t>(job->n_prompt), job->seqId);
+		}
+
+		bool sampleNextToken(std::shared_ptr<Job> job, const std::lock_guard<std::mutex>& jobLock) {
+			llama_token id = common_sampler_sample(job->smpl, context, job->batch_pos);
+			common_sampler_accept(job->smpl, id, false);
+			if (job->params.scoreOutput) {
+				job->logprob += tokenLogProb(job->batch_pos, id);
+			}
+
+			if (isEndOfGeneration(id)) {
+				return false; // Stop generation
+			}
+
+			if (!recordToken(job, id, jobLock)) {
+				return false; // Stop sequence generated
+			}
+			common_batch_add(batch, id, job->n_past, { job->seqId }, true);
+
+			if (tracksSessionTokens(job)) {
+				job->session_tokens.push_back(id);
+			}
+
+			job->batch_pos = batch.n_tokens - 1;
+
+			return true;
+		}
+
+		// Speculative counterpart of sampleNextToken. Verifies the drafts submitted with the
+		// previous batch against the target logits, emits every accepted token, then submits
+		// the next token together with up to n_draft new drafts so one target pass checks them all.
+		// Drafts come from n-gram lookup when the job enables it, else (or when lookup finds
+		// nothing) from the draft model
+		bool sampleWithDraft(std::shared_ptr<Job> job, int reserved_tokens, const std::lock_guard<std::mutex>& jobLock) {
+			std::vector<llama_token> accepted;
+			// the logits each accepted token was sampled from
+			std::vector<int> logit_idxs;
+			if (job->params.scoreOutput) {
+				logit_idxs = job->draftIdxs.empty() ? std::vector<int>{ job->batch_pos } : job->draftIdxs;
+			}
+			if (!job->draftIdxs.empty()) {
+				accepted = common_sampler_sample_and_accept_n(job->smpl, context, job->draftIdxs, job->draft);
+				const int n_accepted = static_cast<int>(accepted.size()) - 1;
+				job->draftTokenCount += static_cast<int>(job->draft.size());
+				job->draftAcceptedCount += n_accepted;
+				counters.draft_tokens.fetch_add(job->draft.size(), std::memory_order_relaxed);
+				counters.draft_accepted.fetch_add(static_cast<uint64_t>(n_accepted), std::memory_order_relaxed);
+				rollbackDrafts(job, static_cast<int>(job->draft.size()) - n_accepted);
+				job->draft.clear();
+				job->draftIdxs.clear();
+			}
+			else {
+				accepted.push_back(common_sampler_sample(job->smpl, context, job->batch_pos));
+				common_sampler_accept(job->smpl, accepted.back(), false);
+			}
+
+			// accepted drafts are already in the KV; only the last token still has to be decoded
+			for (size_t i = 0; i < accepted.size(); ++i) {
+				if (i < logit_idxs.size()) {
+					job->logprob += tokenLogProb(logit_idxs[i], accepted[i]);
+				}
+				if (isEndOfGeneration(accepted[i]) || !recordToken(job, accepted[i], jobLock)) {
+					rollbackDrafts(job, static_cast<int>(accepted.size() - 1 - i));
+					return false; // Stop generation
+				}
+			}
+
+			const llama_token id = accepted.back();
+			common_batch_add(batch, id, job->n_past, { job->seqId }, true);
+			job->draftIdxs.push_back(batch.n_tokens - 1);
+			job->batch_pos = batch.n_tokens - 1;
+			if (tracksSessionTokens(job)) {
+				job->session_tokens.push_back(id);
+			}
+
+			// every draft may be accepted and the verifying pass adds one more token
+			int n_draft_max = std::min({ n_draft, step_tokens - batch.n_tokens - reserved_tokens,
+				std::min(contextLimit(job->params), slotManager.reserve(job->seqId, 0)) - job->n_past - 2 });
+			if (job->params.maxNewTokens != 0) {
+				n_draft_max = std::min(n_draft_max, job->n_remain - 1);
+			}
+			if (n_draft_max <= 0 || job->isContextShifted) {
+				return true;
+			}
+
+			if (job->promptLookup) {
+				job->draft = generateLookupDraft(job, n_draft_max);
+			}
+			if (job->draft.empty() && draft_context) {
+				job->draft = generateDraft(job, n_draft_max);
+			}
+			for (size_t i = 0; i < job->draft.size(); ++i) {
+				common_batch_add(batch, job->draft[i], job->n_past + 1 + static_cast<int>(i), { job->seqId }, true);
+				job->draftIdxs.push_back(batch.n_tokens - 1);
+				if (tracksSessionTokens(job)) {
+					job->session_tokens.push_back(job->draft[i]);
+				}
+			}
+			job->n_past += static_cast<int>(job->draft.size());
+			return true;
+		}
+
+		// Propose the tokens that followed the most recent earlier occurrence of the job's last
+		// n-gram (longest n first) in its prompt and output. Costs no model pass; copied spans
+		// such as quoted context or edited code are accepted in runs
+		std::vector<llama_token> generateLookupDraft(const std::shared_ptr<Job>& job, int n_max) const {
+			std::vector<llama_token> history(job->embd_inp);
+			history.insert(history.end(), job->generatedTokens.begin(), job->generatedTokens.end());
+			return lookupNgramDraft(history, kLookupMinNgram, kLookupMaxNgram, n_max);
+		}
+
+		// Greedily extend the job's tokens with the draft model, whose KV for the job's sequence
+		// is brought in line with the prompt and accepted output first
+		std::vector<llama_token> generateDraft(std::shared_ptr<Job> job, int n_max) {
+			std::vector<llama_token> drafted;
+
+			std::vector<llama_token> history(job->embd_inp);
+			history.insert(history.end(), job->generatedTokens.begin(), job->generatedTokens.end());
+			if (history.empty() || history.size() + n_max > static_cast<size_t>(llama_n_ctx(draft_context))) {
+				return drafted;
+			}
+
+			auto * mem = llama_get_memory(draft_context);
+			if (!job->draftKvSynced) {
+				// the slot may still hold another job's draft state
+				llama_memory_seq_rm(mem, job->seqId, /*p0=*/0, /*p1=*/-1);
+				job->draftKvTokens.clear();
+				job->draftKvSynced = true;
+			}
+
+			size_t keep = 0;
+			while (keep < job->draftKvTokens.size() && keep + 1 < history.size() && job->draftKvTokens[keep] == history[keep]) {
+				++keep;
+			}
+			llama_memory_seq_rm(mem, job->seqId, static_cast<llama_pos>(keep), /*p1=*/-1);
+			job->draftKvTokens.resize(keep);
+
+			const size_t chunk = static_cast<size_t>(std::max(1, n_batch));
+			for (size_t i = keep; i < history.size();) {
+				common_batch_clear(draft_batch);
+				const size_t end = std::min(history.size(), i + chunk);
+				for (; i < end; ++i) {
+					common_batch_add(draft_batch, history[i], static_cast<llama_pos>(i), { job->seqId }, i + 1 == history.size());
+				}
+				if (llama_decode(draft_context, draft_batch)) {
+					job->draftKvSynced = false;
+					return drafted;
+				}
+			}
+			job->draftKvTokens = history;
+
+			const int n_vocab = llama_vocab_n_tokens(tokenizer->getVocab());
+			int logits_idx = draft_batch.n_tokens - 1;
+			for (int i = 0; i < n_max; ++i) {
+				float confidence = 0.0f;
+				const llama_token token = greedyDraftToken(llama_get_logits_ith(draft_context, logits_idx), confidence);
+				// unlikely drafts mostly get rejected and only cost verification work
+				if (token < 0 || token >= n_vocab || confidence < kDraftMinConfidence) {
+					break;
+				}
+				drafted.push_back(token);
+				if (i + 1 == n_max) {
+					break;
+				}
+
+				common_batch_clear(draft_batch);
+				common_batch_add(draft_batch, token, static_cast<llama_pos>(history.size() + i), { job->seqId }, true);
+				if (llama_decode(draft_context, draft_batch)) {
+					job->draftKvSynced = false;
+					break;
+				}
+				job->draftKvTokens.push_back(token);
+				logits_idx = 0;
+			}
+			return drafted;
+		}
+
+		// Argmax of the draft logits together with its softmax probability
+		llama_token greedyDraftToken(const float * logits, float & probability) const {
+			if (!logits) return -1;
+			const int n_vocab = llama_vocab_n_tokens(llama_model_get_vocab(draft_model));
+			int best = 0;
+			for (int i = 1; i < n_vocab; ++i) {
+				if (logits[i] > logits[best]) best = i;
+			}
+			double sum = 0.0;
+			for (int i = 0; i < n_vocab; ++i) {
+				sum += std::exp(static_cast<double>(logits[i] - logits[best]));
+			}
+			probability = static_cast<float>(1.0 / sum);
+			return best;
+		}
+
+		// Drop the last n tokens of the job's sequence from the target KV
+		void rollbackDrafts(std::shared_ptr<Job> job, int n) {
+			if (n <= 0) return;
+			job->n_past -= n;
+			llama_memory_seq_rm(llama_get_memory(context), job->seqId, static_cast<llama_pos>(job->n_past), /*p1=*/-1);
+			if (tracksSessionTokens(job) && job->session_tokens.size() > static_cast<size_t>(job->n_past)) {
+				job->session_tokens.resize(job->n_past);
+			}
+		}
+
+		// KV cells held by every sequence of the context: running jobs, warm slots and the prefix cache
+		int64_t usedCells() const {
+			llama_memory_t mem = llama_get_memory(context);
+			int64_t used = 0;
+			for (int seq = 0; seq < g_params.n_parallel; ++seq) {
+				const llama_pos min = llama_memory_seq_pos_min(mem, seq);
+				if (min >= 0) used += llama_memory_seq_pos_max(mem, seq) - min + 1;
+			}
+			return used;
+		}
+
+		// Tokens of `formatted`, the rendered chat, assembled from its messages' segments: cached
+		// ones are reused, new ones are cut out of their history rendered without the generation
+		// prompt and tokenized alone, and only the generation prompt is always tokenized. Where
+		// the template renders a history differently once more messages follow (some drop the
+		// reasoning of earlier turns), the rest of the chat is tokenized as one piece
+		std::shared_ptr<const std::vector<int32_t>> chatPromptTokens(const std::vector<common_chat_msg>& messages, const std::string& formatted) {
+			const std::vector<uint64_t> keys = ChatSegmentCache::chain(messages);
+			auto tokens = std::make_shared<std::vector<int32_t>>();
+			size_t offset = 0;	// Characters of `formatted` covered by segments
+			size_t next = 0;	// First message they do not cover
+			const auto append = [&](const ChatSegmentCache::Segment& segment, size_t last) {
+				tokens->insert(tokens->end(), segment.tokens.begin(), segment.tokens.end());
+				offset += segment.text.size();
+				next = last + 1;
+			};
+
+			while (next < messages.size()) {
+				std::shared_ptr<const ChatSegmentCache::Segment> segment;
+				size_t last = next;
+				for (; last < messages.size(); ++last) {
+					if ((segment = chatSegments.find(keys[last], next))) break;
+				}
+				if (!segment || formatted.compare(offset, segment->text.size(), segment->text) != 0) break;
+				append(*segment, last);
+			}
+
+			// the first messages of a long new history make one segment
+			const size_t split = messages.size() - std::min(messages.size() - next, ChatSegmentCache::kMaxSplit);
+			for (size_t last = split > next ? split - 1 : next; last < messages.size(); ++last) {
+				std::vector<common_chat_msg> history(messages.begin(), messages.begin() + last + 1);
+				const std::string rendered = tokenizer->applyTemplate(history, /*addGenerationPrompt=*/false);
+				if (rendered.size() < offset || rendered.compare(0, offset, formatted, 0, offset) != 0
+					|| formatted.compare(offset, rendered.size() - offset, rendered, offset, std::string::npos) != 0) {
+					break;
+				}
+				auto segment = std::make_shared<ChatSegmentCache::Segment>();
+				segment->first = next;
+				segment->text = rendered.substr(offset);
+				segment->tokens = common_tokenize(tokenizer->getContext(), segment->text, /*add_special=*/next == 0, /*parse_special=*/true);
+				append(*segment, last);
+				chatSegments.put(keys[last], std::move(segment));
+			}
+
+			const std::vector<llama_token> rest = common_tokenize(tokenizer->getContext(), formatted.substr(offset),
+				/*add_special=*/next == 0, /*parse_special=*/true);
+			tokens->insert(tokens->end(), rest.begin(), rest.end());
+			return tokens;
+		}
+
+		// Log-probability of `id` under the model's logits at batch index idx, before any sampler transforms
+		double tokenLogProb(int idx, llama_token id) const {
+			const float * logits = llama_get_logits_ith(context, idx);
+			const int n_vocab = llama_vocab_n_tokens(tokenizer->getVocab());
+			if (!logits || id < 0 || id >= n_vocab) return 0.0;
+			const float max = *std::max_element(logits, logits + n_vocab);
+			double sum = 0.0;
+			for (int i = 0; i < n_vocab; ++i) {
+				sum += std::exp(static_cast<double>(logits[i] - max));
+			}
+			return static_cast<double>(logits[id] - max) - std::log(sum);
+		}
+
+		// tokenLogProb() of `id`, with the `top_k` likeliest tokens at idx taken through a bounded
+		// min-heap rather than sorting the vocabulary. Clears `greedy` when `id` is not the likeliest
+		TokenLogprob scoreToken(int idx, llama_token id, int top_k, bool& greedy) const {
+			TokenLogprob scored;
+			scored.token = id;
+			scored.text = common_token_to_piece(tokenizer->getContext(), id);
+			const float * logits = llama_get_logits_ith(context, idx);
+			const int n_vocab = llama_vocab_n_tokens(tokenizer->getVocab());
+			if (!logits || id < 0 || id >= n_vocab) {
+				greedy = false;
+				return scored;
+			}
+			const float max = *std::max_element(logits, logits + n_vocab);
+			double sum = 0.0;
+			for (int i = 0; i < n_vocab; ++i) {
+				sum += std::exp(static_cast<double>(logits[i] - max));
+			}
+			const double log_norm = static_cast<double>(max) + std::log(sum);
+			scored.logprob = static_cast<float>(logits[id] - log_norm);
+			if (logits[id] < max) greedy = false;
+
+			std::vector<std::pair<float, llama_token>> heap;
+			heap.reserve(top_k);
+			const auto later = [](const std::pair<float, llama_token>& a, const std::pair<float, llama_token>& b) { return a.first > b.first; };
+			for (llama_token i = 0; top_k > 0 && i < n_vocab; ++i) {
+				if (static_cast<int>(heap.size()) < top_k) {
+					heap.emplace_back(logits[i], i);
+					std::push_heap(heap.begin(), heap.end(), later);
+				}
+				else if (logits[i] > heap.front().first) {
+					std::pop_heap(heap.begin(), heap.end(), later);
+					heap.back() = { logits[i], i };
+					std::push_heap(heap.begin(), heap.end(), later);
+				}
+			}
+			std::sort_heap(heap.begin(), heap.end(), later);
+			for (const auto& [logit, token] : heap) {
+				TokenLogprob alternative;
+				alternative.token = token;
+				alternative.text = common_token_to_piece(tokenizer->getContext(), token);
+				alternative.logprob = static_cast<float>(logit - log_norm);
+				scored.top.push_back(std::move(alternative));
+			}
+			return scored;
+		}
+
+		// Feeds the next n_batch tokens of a scoring round and scores the continuation tokens
+		// they predict; false when the batch fails to decode (decode thread only). The running
+		// jobs' logits are overwritten, so they decode their logit tokens again
+		bool scoreStep(const std::vector<ScoringPair>& pairs, ScoringPass& pass, int top_k, std::vector<ScoringResult>& results) {
+			if (loras.enabled() && !loras.apply(context, "")) return false;
+
+			struct Scored { int idx; size_t pair; int pos; };
+			std::vector<Scored> scored;
+			llama_batch score_batch = llama_batch_init(n_batch, 0, 1);
+			while (pass.item < pass.seqs.size() && score_batch.n_tokens < n_batch) {
+				const ScoringPair& pair = pairs[pass.first + pass.item];
+				// logits only where the next token is a continuation token; the last one predicts nothing
+				const bool logits = pass.pos >= pair.n_prompt - 1;
+				if (logits) scored.push_back({ score_batch.n_tokens, pass.first + pass.item, pass.pos });
+				common_batch_add(score_batch, pair.tokens[pass.pos], static_cast<llama_pos>(pass.pos), { pass.seqs[pass.item] }, logits);
+				if (++pass.pos == static_cast<int>(pair.tokens.size()) - 1) {
+					++pass.item;
+					pass.pos = 0;
+				}
+			}
+			counters.recordDecode(score_batch.n_tokens);
+			const bool decoded = llama_decode(context, score_batch) == 0;
+			++decode_step;
+			llama_batch_free(score_batch);
+			if (!decoded) return false;
+
+			for (const Scored& s : scored) {
+				ScoringResult& result = results[s.pair];
+				TokenLogprob token = scoreToken(s.idx, pairs[s.pair].tokens[s.pos + 1], top_k, result.greedy);
+				result.logprob += token.logprob;
+				result.tokens.push_back(std::move(token));
+			}
+			return true;
+		}
+
+		bool isEndOfGeneration(llama_token id) {
+			return llama_vocab_is_eog(tokenizer->getVocab(), id) || id == llama_vocab_eos(tokenizer->getVocab());
+		}
+
+		// session_tokens mirrors the sequence's KV only for file-backed and keyed sessions
+		bool tracksSessionTokens(const std::shared_ptr<Job>& job) const {
+			return !job->path_session.empty() || !job->params.sessionKey.empty();
+		}
+
+		// Append a generated token to the job's output and wake up its readers. Returns false
+		// once the output ends in one of the job's stop sequences, which is cut off.
+		// jobLock is the caller's hold on job->mtx, which readers take to swap out pendingText
+		bool recordToken(std::shared_ptr<Job> job, llama_token id, const std::lock_guard<std::mutex>& /*jobLock*/) {
+			const auto data = llama_perf_context(context);
+			const std::string token_str = tokenizer->decode(id);
+			bool stopped = false;
+			{
+				// Record first token timing if this is the first generated token
+				if (job->generatedTokens.empty()) {
+					job->first_token_time = std::chrono::steady_clock::now();
+					job->first_token_generated = true;
+					job->timing.first_token_us = steadyMicros(job->first_token_time);
+					
+					// Calculate TTFT in milliseconds
+					auto duration = std::chrono::duration_cast<std::chrono::microseconds>(
+						job->first_token_time - job->start_time
+					);
+					job->ttft = static_cast<float>(duration.count()) / 1000.0f;
+					counters.ttft_ms.observe(job->ttft);
+					slo.observeTtft(job->ttft);
+					
+#ifdef DEBUG
+					std::cout << "[INFERENCE] First token generated. TTFT: " << job->ttft << " ms" << std::endl;
+#endif
+				}
+				else {
+					const double gap_ms = std::chrono::duration<double, std::milli>(
+						std::chrono::steady_clock::now() - job->last_token_time).count();
+					counters.tpot_ms.observe(gap_ms);
+					slo.observeTpot(gap_ms);
+				}
+				job->last_token_time = std::chrono::steady_clock::now();
+				job->timing.last_token_us = steadyMicros(job->last_token_time);
+				counters.generated_tokens.fetch_add(1, std::memory_order_relaxed);
+				job->generatedTokens.push_back(id);
+				job->generatedText += token_str;
+				const size_t cut = job->stopMatcher.feed(token_str);
+				if (cut != std::string::npos) {
+					job->generatedText.resize(job->generatedText.size() - cut);
+					stopped = true;
+				}
+				// a partial stop sequence is only shown once the output moves past it
+				const size_t publishable = stopped ? job->generatedText.size()
+					: job->generatedText.size() - job->stopMatcher.partialBytes();
+				if (job->outputSubscribed) {
+					job->pendingTokens.push_back(id);
+					job->pendingText.append(job->generatedText, job->publishedTextBytes, publishable - job->publishedTextBytes);
+				}
+				job->publishedTextBytes = publishable;
+				if (draft_context && job->generatedTokens.size() > 1) {
+					// target evals include rejected drafts, so measure the emitted rate instead
+					const auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - job->first_token_time).count();
+					job->tps = elapsed > 0.0 ? static_cast<float>((job->generatedTokens.size() - 1) / elapsed) : job->tps;
+				}
+				else {
+					job->tps = static_cast<float>(1e3 / data.t_eval_ms * data.n_eval);
+				}
+				job->cv.notify_all();
+			}
+
+			job->n_remain -= 1;
+			return !stopped;
+		}
+
+		// Restores a session prefetched at submission into seq_id
+		bool load_kv_cache(const std::string& path, std::shared_ptr<const SessionSnapshot> snapshot,
+			std::vector<llama_token>& session_tokens, const int seq_id)
+		{
+			if (!path.empty())
+			{
+				if (!snapshot)
+				{
+					std::error_code ec;
+					if (!std::filesystem::exists(path, ec))
+					{
+						// file doesn't exist => no old cache
+						printf("[KV] session file does not exist, will create.\n");
+					}
+					else if (std::filesystem::is_empty(path, ec))
+					{
+						// file is empty => treat as brand-new
+						printf("[KV] session file is empty, new session.\n");
+					}
+					else
+					{
+						// Unreadable or foreign format - delete the corrupt file and start a new one
+						printf("[KV] ERROR: Failed to load session file, deleting corrupt file and creating a new one.\n");
+						std::filesystem::remove(path, ec);
+					}
+					session_tokens.clear();
+					return true;
+				}
+				else
+				{
+					if (llama_state_seq_set_data(context, snapshot->state.data(), snapshot->state.size(), seq_id) == 0)
+					{
+						// Loading failed - delete the corrupt file and create a new one
+						printf("[KV] ERROR: Failed to load session file, deleting corrupt file and creating a new one.\n");
+						std::error_code ec;
+						std::filesystem::remove(path, ec);
+
+						// Clear any partial data
+						llama_memory_seq_rm(llama_get_memory(context), seq_id, 0, -1);
+						session_tokens.clear();
+
+						// Return true to continue with a new cache instead of failing
+						return true;
+					}
+
+					session_tokens = snapshot->tokens;
+
+#ifdef DEBUG
+					printf("[INFERENCE] [KV] loaded session with prompt size: %d tokens\n", (int)session_tokens.size());
+					printf("[INFERENCE] [KV] tokens decoded: %s\n", tokenizer->detokenize(session_tokens).c_str());
+#endif
+
+					// CRITICAL FIX: Validate that loaded session doesn't consume entire context
+					int loaded_token_count = static_cast<int>(session_tokens.size());
+					int remaining_ctx = n_ctx - loaded_token_count;
+					
+					if (loaded_token_count >= n_ctx) {
+						std::cerr << "[INFERENCE] [ERROR] Loaded session tokens (" << loaded_token_count 
+								  << ") exceed or equal context size (" << n_ctx 
+								  << "). No room for new input. Please start a new session." << std::endl;
+						session_tokens.clear();
+						return false;
+					}
+					
+					// Warn if session uses significant portion of context (>60%)
+					if (loaded_token_count > (n_ctx * 0.6)) {
+						std::cerr << "[INFERENCE] [WARNING] Session uses " << loaded_token_count 
+								  << " tokens (" << (loaded_token_count * 100 / n_ctx) 
+								  << "% of context). Limited space for new input (" 
+								  << remaining_ctx << " tokens available)." << std::endl;
+					}
+					
+					return true;
+				}
+			}
+			return true;
+		}
+
+		size_t matchSessionTokens(std::shared_ptr<Job> job)
+		{
+			size_t n_matching_session_tokens = 0;
+
+			if (!job->session_tokens.empty()) {
+				const size_t n_preserve = g_params.n_keep;
+
+				if (job->embd_inp.size() < n_preserve) {
+					for (size_t i = 0; i < job->embd_inp.size() && i < job->session_tokens.size(); i++) {
+						if (job->embd_inp[i] != job->session_tokens[i])
+							break;
+						n_matching_session_tokens++;
+					}
+				}
+				else {
+					// First, check the preserved prefix.
+					bool prefix_matches = true;
+					for (size_t i = 0; i < n_preserve; i++) {
+						if (job->embd_inp[i] != job->session_tokens[i]) {
+							prefix_matches = false;
+							break;
+						}
+					}
+					if (!prefix_matches) {
+						// Fallback to simple matching from the beginning.
+						for (size_t i = 0; i < job->embd_inp.size() && i < job->session_tokens.size(); i++) {
+							if (job->embd_inp[i] != job->session_tokens[i])
+								break;
+							n_matching_session_tokens++;
+						}
+					}
+					else {
+						// The preserved prefix matches.
+						// Compute the expected gap (i.e. the number of tokens that were dropped during shifting).
+						size_t gap = (job->embd_inp.size() > job->session_tokens.size())
+							? job->embd_inp.size() - job->session_tokens.size()
+							: 0;
+						// Check the shifted suffix.
+						bool shifted_matches = true;
+						size_t shifted_tokens = job->session_tokens.size() > n_preserve ? job->session_tokens.size() - n_preserve : 0;
+						for (size_t i = 0; i < shifted_tokens; i++) {
+							size_t prompt_index = n_preserve + gap + i;
+							if (prompt_index >= job->embd_inp.size() || job->embd_inp[prompt_index] != job->session_tokens[n_preserve + i]) {
+								shifted_matches = false;
+								break;
+							}
+						}
+						if (shifted_matches) {
+							// We can reuse the whole session_tokens.
+							n_matching_session_tokens = job->session_tokens.size();
+#ifdef DEBUG
+							std::cout << "[INFERENCE] [KV] Matched preserved prefix and shifted suffix." << std::endl;
+#endif
+						}
+						else {
+							// If shifted part doesn't match, fall back to matching as much as possible.
+							for (size_t i = 0; i < job->embd_inp.size() && i < job->session_tokens.size(); i++) {
+								if (job->embd_inp[i] != job->session_tokens[i])
+									break;
+								n_matching_session_tokens++;
+							}
+						}
 					}
 				}
+
+#ifdef DEBUG
+				if (n_matching_session_tokens == job->embd_inp.size()) {
+					std::cout << "[INFERENCE] Session file has an exact match for the prompt." << std::endl;
+				}
+				else if (n_matching_session_tokens < (job->embd_inp.size() / 2)) {
+					std::cout << "[INFERENCE] Session file has low similarity to prompt ("
+						<< n_matching_session_tokens << " / " << job->embd_inp.size()
+						<< "); will mostly be re-evaluated." << std::endl;
+				}
+				else {
+					std::cout << "[INFERENCE] Session file matches "
+						<< n_matching_session_tokens << " / "
+						<< job->embd_inp.size() << " tokens of prompt." << std::endl;
+				}
+#endif
+
+				if (job->session_tokens.size() > job->embd_inp.size() && n_matching_session_tokens > 0)
+				{
+#ifdef DEBUG
+					std::cout << "[INFERENCE] [KV] Reevalueating the last token" << std::endl;
+#endif
+					--n_matching_session_tokens; // always force to re-evaluate the last token
+				}
+
+#ifdef DEBUG
+				printf("[INFERENCE] [KV] removed %d tokens from the cache\n", (int)(job->session_tokens.size() - n_matching_session_tokens));
+#endif
+
+				// Remove any "future" tokens that don’t match
+				// i.e. we only keep the portion that matched
+				auto * mem = llama_get_memory(context);
+				llama_memory_seq_rm(mem, job->seqId, static_cast<llama_pos>(n_matching_session_tokens), -1 /*up to end*/);
+				job->session_tokens.resize(n_matching_session_tokens);
+
+#ifdef DEBUG
+				printf("[INFERENCE] [KV] tokens decoded: %s\n", tokenizer->detokenize(job->session_tokens).c_str());
+#endif
 			}
-			return true;
+
+			return n_matching_session_tokens;
 		}
 
-		bool getInputTokens(std::shared_ptr<Job> job) {
-			if (job->session_tokens.empty() || !job->params.prompt.empty()) {
-				job->embd_inp = tokenizer->tokenize(job->params.prompt, tokenizer->shouldAddBos());
-			}
-			else {
-				job->embd_inp = job->session_tokens;
+		void kv_cache_seq_ltrim(llama_context* context, int n_keep, std::vector<llama_token>& session_tokens, int& n_past, const int id, int n_discard_param = 0) {
+			if (n_past <= n_keep) {
+				return;
 			}
+
+			// TODO: When multimodal support is added (mctx/mtmd), add check here:
+			// if (mctx != nullptr) {
+			//     std::cerr << "[INFERENCE] [WARNING] Context shifting is not supported with multimodal models" << std::endl;
+			//     return;
+			// }
+
+			int n_left = n_past - n_keep;
+			// Use provided n_discard if > 0, otherwise default to n_left / 2
+			int n_discard = (n_discard_param > 0) ? n_discard_param : (n_left / 2);
 			
-			// CRITICAL FIX: Validate token count before processing
-			// Calculate available context considering session tokens and generation needs
-			int session_token_count = static_cast<int>(job->session_tokens.size());
-			int available_ctx = n_ctx - session_token_count;
-			int required_tokens = static_cast<int>(job->embd_inp.size());
-			int generation_tokens = job->params.maxNewTokens > 0 ? job->params.maxNewTokens : 512; // Default estimate
-			
-			if (required_tokens > available_ctx) {
-				std::cerr << "[INFERENCE] [ERROR] Input token count (" << required_tokens 
-						  << ") exceeds available context (" << available_ctx 
-						  << "). Session tokens: " << session_token_count
-						  << ", Total context: " << n_ctx << std::endl;
-				return false;
+			// Ensure n_discard doesn't exceed available tokens
+			if (n_discard > n_left) {
+				n_discard = n_left;
 			}
 			
-			// Warn if there's insufficient room for generation
-			if (required_tokens + generation_tokens > n_ctx - n_keep) {
-				std::cerr << "[INFERENCE] [WARNING] Input tokens (" << required_tokens 
-						  << ") + requested generation (" << generation_tokens 
-						  << ") may exceed context window (" << n_ctx 
-						  << "). Generation may be truncated." << std::endl;
+			if (n_discard <= 0) {
+				return;
 			}
-			
-			return true;
-		}
 
-		bool ensureNonEmptyInput(std::shared_ptr<Job> job) {
-			if (job->embd_inp.empty()) {
-				if (tokenizer->shouldAddBos()) {
-					job->embd_inp.push_back(llama_vocab_bos(llama_model_get_vocab(tokenizer->getModel())));
-				}
-				else {
-					return false;
-				}
-			}
-			return true;
-		}
+#if DEBUG
+			std::cout << "\n\nContext full, shifting: n_past = " << n_past
+				<< ", n_left = " << n_left
+				<< ", n_keep = " << n_keep
+				<< ", n_discard = " << n_discard 
+				<< " (param=" << n_discard_param << ")" << std::endl << std::endl;
+#endif
 
-		bool checkCancellation(std::shared_ptr<Job> job) {
-			return job->cancelRequested.load();
-		}
+			auto * mem = llama_get_memory(context);
+			llama_memory_seq_rm(mem, id, n_keep, n_keep + n_discard);
+			llama_memory_seq_add(mem, id, n_keep + n_discard, n_past, -n_discard);
 
-		bool ensureContextCapacity(std::shared_ptr<Job> job) {
-			if (job->n_past + 1 > n_ctx) {
-#ifdef DEBUG
-				std::cout << "[INFERENCE] Context capacity check: n_past=" << job->n_past 
-						  << ", n_ctx=" << n_ctx << ", attempting trim..." << std::endl;
-#endif
-				// Pass n_discard from job params (0 means use default n_left/2)
-				kv_cache_seq_ltrim(context, n_keep, job->session_tokens, job->n_past, job->seqId, job->params.n_discard);
+			n_past -= n_discard;
+
+			// Improved token management using vector operations
+			if (!session_tokens.empty() && session_tokens.size() >= (size_t)(n_keep + n_discard)) {
+				std::vector<llama_token> new_tokens;
+				new_tokens.reserve(session_tokens.size() - n_discard);
 				
-				// IMPROVED: Better error reporting after trim attempt
-				if (job->n_past + 1 > n_ctx) {
-					std::cerr << "[INFERENCE] [ERROR] Context overflow: Cannot fit tokens even after trimming. "
-							  << "n_past=" << job->n_past << ", n_ctx=" << n_ctx 
-							  << ", n_keep=" << n_keep << ". "
-							  << "Context budget exhausted. Consider reducing prompt or maxNewTokens." 
-							  << std::endl;
-					return false;
-				}
+				// Copy tokens before n_keep
+				new_tokens.insert(new_tokens.end(), 
+					session_tokens.begin(), 
+					session_tokens.begin() + n_keep);
+				
+				// Copy tokens after the discarded range
+				new_tokens.insert(new_tokens.end(), 
+					session_tokens.begin() + n_keep + n_discard, 
+					session_tokens.end());
+				
+				session_tokens = std::move(new_tokens);
+			}
+		}
+	};
+	// EmbeddingInferenceService (Optimized for Embedding Models)
+	//
+	// Decodes on one or more lanes: contexts over the shared weights, each with its own CPU
+	// threadpool and decode thread. A lane takes queued jobs no other lane has taken, a few
+	// passes' worth at a time when there are several, so the lanes split a large batch
+	// between them. One context's threads stop scaling long before a many-core CPU runs out
+	// of cores on short inputs; several smaller ones keep it busy.
+	//
+	// With a batch window, an idle lane woken by fewer jobs than it has sequences waits up
+	// to that long for more before decoding, so a stream of single-input queries shares
+	// passes instead of each taking one to itself.
+	class EmbeddingInferenceService : public InferenceService
+	{
+	public:
+		struct LaneContext {
+			llama_context	*context;
+			ggml_threadpool	*threadpool;
+		};
+
+		EmbeddingInferenceService(std::shared_ptr<Tokenizer> tokenizer, llama_model *model,
+								 const std::vector<LaneContext> &contexts, common_params params,
+								 std::chrono::microseconds batchWindow = std::chrono::microseconds(0))
+			: tokenizer(std::move(tokenizer)), model(model), g_params(params),
+			  n_batch(params.n_batch), n_ctx(llama_n_ctx(contexts.front().context)), batch_window(batchWindow),
+			  embeddings_enabled(true)
+		{
 #ifdef DEBUG
-				std::cout << "[INFERENCE] Trim successful. New n_past=" << job->n_past << std::endl;
+			std::cout << "[INFERENCE] [EMBEDDING] Initializing EmbeddingInferenceService with batch size: " << g_params.n_batch
+					  << " on " << contexts.size() << " context(s)" << std::endl;
 #endif
+
+			for (const auto &lane_context : contexts)
+			{
+				auto lane = std::make_unique<Lane>();
+				lane->context = lane_context.context;
+				lane->threadpool = lane_context.threadpool;
+				// Always enable embeddings for this service
+				llama_set_embeddings(lane->context, true);
+				lane->batch = llama_batch_init(params.n_ctx, 0, params.n_parallel);
+				lanes.push_back(std::move(lane));
 			}
-			return true;
+
+			start();
 		}
 
-		void saveSession(std::shared_ptr<Job> job) {
-			if (!job->path_session.empty()) {
-				// Use the logical session id from params for file-backed sessions
-				const int session_seq = job->params.seqId;
-				llama_state_seq_save_file(context, job->path_session.c_str(), session_seq, job->session_tokens.data(), job->session_tokens.size());
+		~EmbeddingInferenceService()
+		{
+			stop();
+
+			// Wait for any remaining jobs to complete
+			auto timeout = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+			while (std::chrono::steady_clock::now() < timeout)
+			{
+				{
+					std::lock_guard<std::mutex> lock(mtx);
+					if (jobs.empty())
+						break;
+				}
+				std::this_thread::sleep_for(std::chrono::milliseconds(100));
+			}
+
+			// Clean up in proper order
+			for (auto &lane : lanes)
+			{
+				if (lane->thread.joinable())
+					lane->thread.join();
+				llama_detach_threadpool(lane->context);
+				llama_batch_free(lane->batch);
+				llama_free(lane->context);
+				BackendManager::instance().releaseThreadpool(lane->threadpool);
 			}
+			ModelStore::instance().release(model);
 		}
 
-		bool sampleNextToken(std::shared_ptr<Job> job) {
-			llama_token id = common_sampler_sample(job->smpl, context, job->batch_pos);
-			common_sampler_accept(job->smpl, id, false);
+		void stop() override
+		{
+			should_terminate = true;
+			cv.notify_all();
+		}
 
-			if (llama_vocab_is_eog(tokenizer->getVocab(), id) || id == llama_vocab_eos(tokenizer->getVocab())) {
-				return false; // Stop generation
-			}
+		// One decode thread per lane
+		void start() override
+		{
+			for (auto &lane : lanes)
+				lane->thread = std::thread(&EmbeddingInferenceService::run, this, std::ref(*lane));
+		}
 
-			common_batch_add(batch, id, job->n_past, { job->seqId }, true);
+		void submitJob(const CompletionParameters &params, std::shared_ptr<Job> job) override
+		{
+			// Not supported for embedding service
+			std::lock_guard<std::mutex> jobLock(job->mtx);
+			job->hasError = true;
+			job->errorMessage = "Text completion not supported by embedding service";
+			job->cv.notify_all();
+		}
 
-			const auto data = llama_perf_context(context);
-			const std::string token_str = tokenizer->decode(id);
-			{
-				// Record first token timing if this is the first generated token
-				if (job->generatedTokens.empty()) {
-					job->first_token_time = std::chrono::steady_clock::now();
-					job->first_token_generated = true;
-					
-					// Calculate TTFT in milliseconds
-					auto duration = std::chrono::duration_cast<std::chrono::microseconds>(
-						job->first_token_time - job->start_time
-					);
-					job->ttft = static_cast<float>(duration.count()) / 1000.0f;
-					
+		void complete(const CompletionParameters &params, std::shared_ptr<Job> job) override
+		{
+			// Not supported for embedding service
+			submitJob(params, job);
+		}
+
+		void embed(const EmbeddingParameters &params, std::shared_ptr<Job> job) override
+		{
 #ifdef DEBUG
-					std::cout << "[INFERENCE] First token generated. TTFT: " << job->ttft << " ms" << std::endl;
+			std::cout << "[INFERENCE] [EMBEDDING] Submitting embedding job" << std::endl;
 #endif
-				}
-				job->generatedTokens.push_back(id);
-				job->generatedText += token_str;
-				job->tps = static_cast<float>(1e3 / data.t_eval_ms * data.n_eval);
+
+			if (!params.isValid())
+			{
+				std::lock_guard<std::mutex> jobLock(job->mtx);
+				job->hasError = true;
+				job->errorMessage = "Invalid embedding parameters";
 				job->cv.notify_all();
+				return;
 			}
 
-			if (!job->path_session.empty()) {
-				job->session_tokens.push_back(id);
+			job->params_embedding = params;
+
+			{
+				std::lock_guard<std::mutex> lock(mtx);
+				jobs.push_back(job);
 			}
 
-			job->n_remain -= 1;
-			job->batch_pos = batch.n_tokens - 1;
-
-			return true;
+			cv.notify_one();
 		}
 
-		bool load_kv_cache(const std::string& path, std::vector<llama_token>& session_tokens, const int jobId)
+		void embedBatch(const std::vector<EmbeddingParameters> &params, const std::vector<std::shared_ptr<Job>> &batchJobs) override
 		{
-			if (!path.empty())
+			std::vector<std::shared_ptr<Job>> accepted;
+			accepted.reserve(batchJobs.size());
+			for (size_t i = 0; i < params.size(); ++i)
 			{
-				// Attempt to load
-				if (!std::filesystem::exists(path))
-				{
-					// file doesn't exist => no old cache
-					printf("[KV] session file does not exist, will create.\n");
-					return true;
-				}
-				else if (std::filesystem::is_empty(path))
+				if (!params[i].isValid())
 				{
-					// file is empty => treat as brand-new
-					printf("[KV] session file is empty, new session.\n");
-					return true;
+					failJob(batchJobs[i], "Invalid embedding parameters");
+					continue;
 				}
-				else
-				{
-					// The file exists and is not empty
-					session_tokens.resize(g_params.n_ctx);  // allocate buffer
-					size_t n_token_count_out = 0;
-
-					bool load_success = llama_state_seq_load_file(
-						context,
-						path.c_str(),
-						jobId,
-						session_tokens.data(),
-						session_tokens.capacity(),
-						&n_token_count_out
-					);
+				batchJobs[i]->params_embedding = params[i];
+				accepted.push_back(batchJobs[i]);
+			}
 
-					if (!load_success)
-					{
-						// Loading failed - delete the corrupt file and create a new one
-						printf("[KV] ERROR: Failed to load session file, deleting corrupt file and creating a new one.\n");
-						try {
-							std::filesystem::remove(path);
-						}
-						catch (const std::filesystem::filesystem_error& e) {
-							printf("[KV] WARNING: Could not delete corrupt session file: %s\n", e.what());
-						}
+			// Queue the whole batch at once so the lanes pack it into as few decodes as possible
+			{
+				std::lock_guard<std::mutex> lock(mtx);
+				jobs.insert(jobs.end(), accepted.begin(), accepted.end());
+			}
 
-						// Clear any partial data
-						session_tokens.clear();
+			cv.notify_all();
+		}
 
-						// Return true to continue with a new cache instead of failing
-						return true;
-					}
+		CompletionParameters formatChat(const ChatCompletionParameters &params) override
+		{
+			// Not supported for embedding service
+			throw std::runtime_error("Chat completion not supported by embedding service");
+		}
 
-					// The llama_state_load_file call gives us how many tokens were in that old session
-					session_tokens.resize(n_token_count_out);
+		DecodeStats decodeStats() override
+		{
+			DecodeStats stats = counters.snapshot();
+			stats.weight_bytes = llama_model_size(model);
+			return stats;
+		}
 
-#ifdef DEBUG
-					printf("[INFERENCE] [KV] loaded session with prompt size: %d tokens\n", (int)session_tokens.size());
-					printf("[INFERENCE] [KV] tokens decoded: %s\n", tokenizer->detokenize(session_tokens).c_str());
-#endif
+	private:
+		std::shared_ptr<Tokenizer> tokenizer;
+		struct llama_model *model;
+		std::mutex mtx;
+		std::condition_variable cv;
+		common_params g_params;
+		std::vector<std::shared_ptr<Job>> jobs;
+		std::unordered_set<const Job*> admitted;	// jobs in the queue a lane has taken (guarded by mtx)
+		std::atomic<bool> should_terminate{false};
+		std::atomic<bool> embeddings_enabled{true};
 
-					// CRITICAL FIX: Validate that loaded session doesn't consume entire context
-					int loaded_token_count = static_cast<int>(session_tokens.size());
-					int remaining_ctx = n_ctx - loaded_token_count;
-					
-					if (loaded_token_count >= n_ctx) {
-						std::cerr << "[INFERENCE] [ERROR] Loaded session tokens (" << loaded_token_count 
-								  << ") exceed or equal context size (" << n_ctx 
-								  << "). No room for new input. Please start a new session." << std::endl;
-						session_tokens.clear();
-						return false;
+		const int n_batch;
+		const int n_ctx;
+		const std::chrono::microseconds batch_window;	// 0 = decode what is queued right away
+
+		// An input taken into the scheduler. Inputs of last-token pooled (causal) models may
+		// be longer than a micro-batch and are then fed over several passes, their sequence
+		// keeping its KV in between
+		struct EmbeddingInput {
+			std::shared_ptr<Job>		job;
+			std::vector<llama_token>	tokens;
+			size_t						fed = 0;	// tokens already decoded
+			llama_seq_id				seq = -1;	// sequence holding its KV, -1 before the first pass
+			bool						done = false;
+		};
+
+		struct Lane {
+			llama_context				*context = nullptr;
+			ggml_threadpool				*threadpool = nullptr;
+			llama_batch					batch{};
+			std::vector<EmbeddingInput>	inputs;		// its decode thread only
+			std::vector<llama_seq_id>	free_seqs;
+			std::thread					thread;
+		};
+		std::vector<std::unique_ptr<Lane>>	lanes;
+
+		void run(Lane& lane)
+		{
+#ifdef __linux__
+			// Tells the embedding loop apart from the server's threads in CPU profiles
+			pthread_setname_np(pthread_self(), "kolosal-embed");
+#endif
+			while (!should_terminate)
+			{
+				std::vector<std::shared_ptr<Job>> taken;
+				{
+					std::unique_lock<std::mutex> lock(mtx);
+					if (lane.inputs.empty() && admitted.size() == jobs.size())
+					{
+						ggml_threadpool_pause(lane.threadpool);
+						cv.wait(lock, [this] { return admitted.size() < jobs.size() || should_terminate; });
+						ggml_threadpool_resume(lane.threadpool);
 					}
-					
-					// Warn if session uses significant portion of context (>60%)
-					if (loaded_token_count > (n_ctx * 0.6)) {
-						std::cerr << "[INFERENCE] [WARNING] Session uses " << loaded_token_count 
-								  << " tokens (" << (loaded_token_count * 100 / n_ctx) 
-								  << "% of context). Limited space for new input (" 
-								  << remaining_ctx << " tokens available)." << std::endl;
+					if (should_terminate)
+						break;
+					if (batch_window.count() > 0 && lane.inputs.empty())
+					{
+						// Let more queries join this pass, up to one per sequence
+						const size_t fill = std::max(1, static_cast<int>(llama_n_seq_max(lane.context)));
+						cv.wait_for(lock, batch_window, [this, fill] {
+							return jobs.size() - admitted.size() >= fill || should_terminate;
+						});
+						if (should_terminate)
+							break;
 					}
-					
-					return true;
+					taken = takeJobs(lane);
 				}
+
+				// One micro-batch per iteration; jobs queued meanwhile join the next one
+				admitInputs(lane, taken);
+				decodeNextBatch(lane);
+
+				std::lock_guard<std::mutex> lock(mtx);
+				jobs.erase(std::remove_if(jobs.begin(), jobs.end(),
+					[this](const std::shared_ptr<Job>& job) {
+						std::lock_guard<std::mutex> jobLock(job->mtx);
+						if (!job->isFinished && !job->hasError)
+							return false;
+						admitted.erase(job.get());
+						return true;
+					}), jobs.end());
 			}
-			return true;
 		}
 
-		size_t matchSessionTokens(std::shared_ptr<Job> job)
+		// Queued jobs no lane has taken yet (mtx held). A single lane takes them all; with
+		// several, one takes enough to fill its sequences twice over and leaves the rest to
+		// the others
+		std::vector<std::shared_ptr<Job>> takeJobs(const Lane& lane)
 		{
-			size_t n_matching_session_tokens = 0;
+			const size_t n_seq_max = std::max(1, static_cast<int>(llama_n_seq_max(lane.context)));
+			size_t room = lanes.size() == 1 ? jobs.size()
+				: 2 * n_seq_max - std::min(2 * n_seq_max, lane.inputs.size());
+			std::vector<std::shared_ptr<Job>> taken;
+			for (const auto& job : jobs)
+			{
+				if (room == 0)
+					break;
+				if (!admitted.insert(job.get()).second)
+					continue;
+				taken.push_back(job);
+				--room;
+			}
+			// wake an idle lane for what is left
+			if (admitted.size() < jobs.size())
+				cv.notify_one();
+			return taken;
+		}
 
-			if (!job->session_tokens.empty()) {
-				const size_t n_preserve = g_params.n_keep;
+		static void failJob(const std::shared_ptr<Job>& job, const std::string& message)
+		{
+			std::lock_guard<std::mutex> jobLock(job->mtx);
+			job->hasError = true;
+			job->errorMessage = message;
+			job->isFinished = true;
+			job->cv.notify_all();
+		}
 
-				if (job->embd_inp.size() < n_preserve) {
-					for (size_t i = 0; i < job->embd_inp.size() && i < job->session_tokens.size(); i++) {
-						if (job->embd_inp[i] != job->session_tokens[i])
-							break;
-						n_matching_session_tokens++;
-					}
+		bool splitsLongInputs(const Lane& lane) const
+		{
+			return llama_pooling_type(lane.context) == LLAMA_POOLING_TYPE_LAST;
+		}
+
+		// Tokenize the jobs the lane took and queue them for its next passes
+		void admitInputs(Lane& lane, const std::vector<std::shared_ptr<Job>>& taken)
+		{
+			const llama_vocab *vocab = llama_model_get_vocab(model);
+			const int n_seq_max = std::max(1, static_cast<int>(llama_n_seq_max(lane.context)));
+			const int n_ubatch = std::min(n_batch, static_cast<int>(llama_n_ubatch(lane.context)));
+			// A sequence's KV has to fit in its share of the context; unless the pooling allows
+			// splitting, the whole input also has to fit in one micro-batch
+			const int per_seq = std::max(1, n_ctx / n_seq_max - 4);
+			const int max_tokens = splitsLongInputs(lane) ? per_seq : std::min(n_ubatch, per_seq);
+
+			for (const auto& job : taken)
+			{
+				std::string input;
+				std::string document;
+				{
+					std::lock_guard<std::mutex> jobLock(job->mtx);
+					if (job->isFinished || job->hasError)
+						continue;
+					input = job->params_embedding.input;
+					document = job->params_embedding.document;
 				}
-				else {
-					// First, check the preserved prefix.
-					bool prefix_matches = true;
-					for (size_t i = 0; i < n_preserve; i++) {
-						if (job->embd_inp[i] != job->session_tokens[i]) {
-							prefix_matches = false;
-							break;
+
+				try
+				{
+					std::vector<llama_token> tokens;
+					if (!document.empty())
+					{
+						if (llama_pooling_type(lane.context) != LLAMA_POOLING_TYPE_RANK)
+						{
+							failJob(job, "Model is not a reranker; query-document pairs need rank pooling");
+							continue;
 						}
+						tokens = rerankTokens(input, document, max_tokens);
 					}
-					if (!prefix_matches) {
-						// Fallback to simple matching from the beginning.
-						for (size_t i = 0; i < job->embd_inp.size() && i < job->session_tokens.size(); i++) {
-							if (job->embd_inp[i] != job->session_tokens[i])
-								break;
-							n_matching_session_tokens++;
-						}
+					else
+					{
+						tokens = common_tokenize(lane.context, input, llama_vocab_get_add_bos(vocab), false);
 					}
-					else {
-						// The preserved prefix matches.
-						// Compute the expected gap (i.e. the number of tokens that were dropped during shifting).
-						size_t gap = (job->embd_inp.size() > job->session_tokens.size())
-							? job->embd_inp.size() - job->session_tokens.size()
-							: 0;
-						// Check the shifted suffix.
-						bool shifted_matches = true;
-						size_t shifted_tokens = job->session_tokens.size() > n_preserve ? job->session_tokens.size() - n_preserve : 0;
-						for (size_t i = 0; i < shifted_tokens; i++) {
-							size_t prompt_index = n_preserve + gap + i;
-							if (prompt_index >= job->embd_inp.size() || job->embd_inp[prompt_index] != job->session_tokens[n_preserve + i]) {
-								shifted_matches = false;
-								break;
-							}
-						}
-						if (shifted_matches) {
-							// We can reuse the whole session_tokens.
-							n_matching_session_tokens = job->session_tokens.size();
-#ifdef DEBUG
-							std::cout << "[INFERENCE] [KV] Matched preserved prefix and shifted suffix." << std::endl;
-#endif
-						}
-						else {
-							// If shifted part doesn't match, fall back to matching as much as possible.
-							for (size_t i = 0; i < job->embd_inp.size() && i < job->session_tokens.size(); i++) {
-								if (job->embd_inp[i] != job->session_tokens[i])
-									break;
-								n_matching_session_tokens++;
-							}
-						}
+					if (tokens.empty())
+					{
+						failJob(job, "Input text resulted in empty tokens");
+						continue;
+					}
+					if (static_cast<int>(tokens.size()) > max_tokens)
+					{
+						tokens.resize(max_tokens);
 					}
-				}
 
-#ifdef DEBUG
-				if (n_matching_session_tokens == job->embd_inp.size()) {
-					std::cout << "[INFERENCE] Session file has an exact match for the prompt." << std::endl;
+					{
+						// store token count for result usage
+						std::lock_guard<std::mutex> jobLock(job->mtx);
+						job->embedding_token_count = static_cast<int>(tokens.size());
+					}
+					EmbeddingInput entry;
+					entry.job = job;
+					entry.tokens = std::move(tokens);
+					lane.inputs.push_back(std::move(entry));
 				}
-				else if (n_matching_session_tokens < (job->embd_inp.size() / 2)) {
-					std::cout << "[INFERENCE] Session file has low similarity to prompt ("
-						<< n_matching_session_tokens << " / " << job->embd_inp.size()
-						<< "); will mostly be re-evaluated." << std::endl;
+				catch (const std::exception& e)
+				{
+					failJob(job, std::string("Tokenization failed: ") + e.what());
 				}
-				else {
-					std::cout << "[INFERENCE] Session file matches "
-						<< n_matching_session_tokens << " / "
-						<< job->embd_inp.size() << " tokens of prompt." << std::endl;
+			}
+		}
+
+		// Cross-encoder input: [BOS] query [EOS] [SEP] document [EOS]. The document is cut,
+		// never the query, when the pair is longer than max_tokens
+		std::vector<llama_token> rerankTokens(const std::string& query, const std::string& document, int max_tokens) const
+		{
+			const llama_vocab *vocab = llama_model_get_vocab(model);
+			std::vector<llama_token> q = common_tokenize(vocab, query, false, false);
+			std::vector<llama_token> d = common_tokenize(vocab, document, false, false);
+
+			const bool add_bos = llama_vocab_get_add_bos(vocab);
+			const bool add_eos = llama_vocab_get_add_eos(vocab);
+			const bool add_sep = llama_vocab_get_add_sep(vocab);
+			const int specials = int(add_bos) + 2 * int(add_eos) + int(add_sep);
+			const int room = max_tokens - specials - static_cast<int>(q.size());
+			if (room < static_cast<int>(d.size()))
+			{
+				d.resize(std::max(0, room));
+			}
+
+			std::vector<llama_token> tokens;
+			tokens.reserve(q.size() + d.size() + specials);
+			if (add_bos) tokens.push_back(llama_vocab_bos(vocab));
+			tokens.insert(tokens.end(), q.begin(), q.end());
+			if (add_eos) tokens.push_back(llama_vocab_eos(vocab));
+			if (add_sep) tokens.push_back(llama_vocab_sep(vocab));
+			tokens.insert(tokens.end(), d.begin(), d.end());
+			if (add_eos) tokens.push_back(llama_vocab_eos(vocab));
+			return tokens;
+		}
+
+		// Fill one micro-batch of at most n_ubatch tokens and decode it. Split inputs continue
+		// first; the others go longest first into whatever space is left (first-fit decreasing),
+		// so short inputs fill the gaps long ones leave instead of waiting behind them
+		void decodeNextBatch(Lane& lane)
+		{
+			if (lane.inputs.empty())
+				return;
+
+			const int n_seq_max = std::max(1, static_cast<int>(llama_n_seq_max(lane.context)));
+			const int n_ubatch = std::min(n_batch, static_cast<int>(llama_n_ubatch(lane.context)));
+			const bool split = splitsLongInputs(lane);
+			auto *mem = llama_get_memory(lane.context);
+
+			if (lane.free_seqs.size() + std::count_if(lane.inputs.begin(), lane.inputs.end(), [](const EmbeddingInput& in) { return in.seq >= 0; })
+				!= static_cast<size_t>(n_seq_max))
+			{
+				// first pass, or state lost after a failure: start from an empty cache
+				llama_memory_clear(mem, /*data=*/true);
+				lane.free_seqs.clear();
+				for (int seq = n_seq_max - 1; seq >= 0; --seq) lane.free_seqs.push_back(seq);
+				for (auto& in : lane.inputs) { in.seq = -1; in.fed = 0; }
+			}
+
+			std::vector<size_t> order(lane.inputs.size());
+			for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+			std::stable_sort(order.begin(), order.end(), [&lane](size_t a, size_t b) {
+				const bool a_running = lane.inputs[a].seq >= 0;
+				const bool b_running = lane.inputs[b].seq >= 0;
+				if (a_running != b_running) return a_running;
+				return lane.inputs[a].tokens.size() - lane.inputs[a].fed > lane.inputs[b].tokens.size() - lane.inputs[b].fed;
+			});
+
+			common_batch_clear(lane.batch);
+			std::vector<size_t>	in_batch;	// indices into lane.inputs
+			std::vector<int>	last_pos;	// batch index of each one's last token this pass
+			for (size_t idx : order)
+			{
+				EmbeddingInput& in = lane.inputs[idx];
+				const int room = n_ubatch - lane.batch.n_tokens;
+				if (room <= 0)
+					break;
+				if (in.seq < 0 && lane.free_seqs.empty())
+					continue;
+
+				const int remaining = static_cast<int>(in.tokens.size() - in.fed);
+				int take = remaining;
+				if (remaining > room)
+				{
+					// only pooling over the last token survives a split; others wait for a pass with room
+					if (!split)
+						continue;
+					take = room;
 				}
-#endif
 
-				if (job->session_tokens.size() > job->embd_inp.size() && n_matching_session_tokens > 0)
+				if (in.seq < 0)
 				{
-#ifdef DEBUG
-					std::cout << "[INFERENCE] [KV] Reevalueating the last token" << std::endl;
-#endif
-					--n_matching_session_tokens; // always force to re-evaluate the last token
+					in.seq = lane.free_seqs.back();
+					lane.free_seqs.pop_back();
 				}
+				for (int i = 0; i < take; ++i)
+				{
+					const size_t pos = in.fed + static_cast<size_t>(i);
+					common_batch_add(lane.batch, in.tokens[pos], static_cast<llama_pos>(pos), { in.seq }, i + 1 == take);
+				}
+				in.fed += static_cast<size_t>(take);
+				in_batch.push_back(idx);
+				last_pos.push_back(lane.batch.n_tokens - 1);
+			}
 
-#ifdef DEBUG
-				printf("[INFERENCE] [KV] removed %d tokens from the cache\n", (int)(job->session_tokens.size() - n_matching_session_tokens));
-#endif
+			if (lane.batch.n_tokens == 0)
+			{
+				// nothing fits a micro-batch any more (e.g. n_ubatch shrank); fail rather than spin
+				for (auto& in : lane.inputs) failJob(in.job, "Input does not fit in a micro-batch");
+				releaseInputs(lane);
+				return;
+			}
 
-				// Remove any "future" tokens that don’t match
-				// i.e. we only keep the portion that matched
-				auto * mem = llama_get_memory(context);
-				llama_memory_seq_rm(mem, job->seqId, static_cast<llama_pos>(n_matching_session_tokens), -1 /*up to end*/);
-				job->session_tokens.resize(n_matching_session_tokens);
+			counters.recordDecode(lane.batch.n_tokens);
+			if (llama_decode(lane.context, lane.batch) != 0)
+			{
+				for (size_t idx : in_batch)
+				{
+					failJob(lane.inputs[idx].job, "Failed to decode embedding batch");
+					lane.inputs[idx].done = true;
+				}
+				releaseInputs(lane);
+				return;
+			}
+			counters.embedding_tokens.fetch_add(static_cast<uint64_t>(lane.batch.n_tokens), std::memory_order_relaxed);
 
-#ifdef DEBUG
-				printf("[INFERENCE] [KV] tokens decoded: %s\n", tokenizer->detokenize(job->session_tokens).c_str());
-#endif
+			for (size_t k = 0; k < in_batch.size(); ++k)
+			{
+				EmbeddingInput& in = lane.inputs[in_batch[k]];
+				if (in.fed < in.tokens.size())
+					continue;
+				extractEmbedding(lane, in, last_pos[k]);
+				in.done = true;
+				counters.embedding_inputs.fetch_add(1, std::memory_order_relaxed);
+			}
+			releaseInputs(lane);
+		}
+
+		// Drop finished inputs and free their sequences
+		void releaseInputs(Lane& lane)
+		{
+			auto *mem = llama_get_memory(lane.context);
+			for (auto& in : lane.inputs)
+			{
+				if (!in.done)
+				{
+					std::lock_guard<std::mutex> jobLock(in.job->mtx);
+					in.done = in.job->isFinished || in.job->hasError;
+				}
+				if (in.done && in.seq >= 0)
+				{
+					llama_memory_seq_rm(mem, in.seq, /*p0=*/-1, /*p1=*/-1);
+					lane.free_seqs.push_back(in.seq);
+				}
 			}
-
-			return n_matching_session_tokens;
+			lane.inputs.erase(std::remove_if(lane.inputs.begin(), lane.inputs.end(), [](const EmbeddingInput& in) { return in.done; }), lane.inputs.end());
 		}
 
-		void kv_cache_seq_ltrim(llama_context* context, int n_keep, std::vector<llama_token>& session_tokens, int& n_past, const int id, int n_discard_param = 0) {
-			if (n_past <= n_keep) {
-				return;
-			}
+		void extractEmbedding(const Lane& lane, EmbeddingInput& in, int last_pos)
+		{
+			const int n_embd = llama_model_n_embd(model);
+			const enum llama_pooling_type pooling_type = llama_pooling_type(lane.context);
+			auto& job = in.job;
 
-			// TODO: When multimodal support is added (mctx/mtmd), add check here:
-			// if (mctx != nullptr) {
-			//     std::cerr << "[INFERENCE] [WARNING] Context shifting is not supported with multimodal models" << std::endl;
-			//     return;
-			// }
+			try
+			{
+				bool normalize;
+				{
+					std::lock_guard<std::mutex> jobLock(job->mtx);
+					normalize = job->params_embedding.normalize;
+				}
 
-			int n_left = n_past - n_keep;
-			// Use provided n_discard if > 0, otherwise default to n_left / 2
-			int n_discard = (n_discard_param > 0) ? n_discard_param : (n_left / 2);
-			
-			// Ensure n_discard doesn't exceed available tokens
-			if (n_discard > n_left) {
-				n_discard = n_left;
-			}
-			
-			if (n_discard <= 0) {
-				return;
-			}
+				float* embd = pooling_type == LLAMA_POOLING_TYPE_NONE
+					? llama_get_embeddings_ith(lane.context, last_pos)
+					: llama_get_embeddings_seq(lane.context, in.seq);
 
-#if DEBUG
-			std::cout << "\n\nContext full, shifting: n_past = " << n_past
-				<< ", n_left = " << n_left
-				<< ", n_keep = " << n_keep
-				<< ", n_discard = " << n_discard 
-				<< " (param=" << n_discard_param << ")" << std::endl << std::endl;
-#endif
+				if (!embd)
+				{
+					failJob(job, "Failed to get embeddings from model");
+					return;
+				}
 
-			auto * mem = llama_get_memory(context);
-			llama_memory_seq_rm(mem, id, n_keep, n_keep + n_discard);
-			llama_memory_seq_add(mem, id, n_keep + n_discard, n_past, -n_discard);
+				// Copy and normalize embedding; a reranker's output is a single relevance score
+				const bool rank = pooling_type == LLAMA_POOLING_TYPE_RANK;
+				std::vector<float> embedding(embd, embd + (rank ? 1 : n_embd));
+				
+				if (normalize && !rank)
+				{
+					float norm = 0.0f;
+					for (float val : embedding)
+					{
+						norm += val * val;
+					}
+					norm = std::sqrt(norm);
+					
+					if (norm > 1e-8f)
+					{
+						for (float& val : embedding)
+						{
+							val /= norm;
+						}
+					}
+				}
 
-			n_past -= n_discard;
+				{
+					std::lock_guard<std::mutex> jobLock(job->mtx);
+					job->embedding = std::move(embedding);
+					job->isFinished = true;
+					job->cv.notify_all();
+				}
 
-			// Improved token management using vector operations
-			if (!session_tokens.empty() && session_tokens.size() >= (size_t)(n_keep + n_discard)) {
-				std::vector<llama_token> new_tokens;
-				new_tokens.reserve(session_tokens.size() - n_discard);
-				
-				// Copy tokens before n_keep
-				new_tokens.insert(new_tokens.end(), 
-					session_tokens.begin(), 
-					session_tokens.begin() + n_keep);
-				
-				// Copy tokens after the discarded range
-				new_tokens.insert(new_tokens.end(), 
-					session_tokens.begin() + n_keep + n_discard, 
-					session_tokens.end());
-				
-				session_tokens = std::move(new_tokens);
+#ifdef DEBUG
+				std::cout << "[INFERENCE] [EMBEDDING] Generated " << n_embd << "-dimensional embedding for sequence " << in.seq << std::endl;
+#endif
+			}
+			catch (const std::exception& e)
+			{
+				failJob(job, std::string("Embedding extraction failed: ") + e.what());
 			}
 		}
 	};
-	// EmbeddingInferenceService (Optimized for Embedding Models)
-	class EmbeddingInferenceService : public InferenceService
+
+	// Job table split into independently locked shards. Status and streaming
+	// lookups from many polling clients take a shared lock on one shard only,
+	// so they neither serialize on each other nor block job submission.
+	class JobRegistry
 	{
 	public:
-		EmbeddingInferenceService(std::shared_ptr<Tokenizer> tokenizer, llama_model *model, llama_context *context,
-								 common_params params, ggml_threadpool *threadpool)
-			: tokenizer(std::move(tokenizer)), model(model), context(context), g_params(params), threadpool(threadpool),
-			  n_batch(params.n_batch), n_ctx(llama_n_ctx(context)), embeddings_enabled(true)
+		void insert(int id, std::shared_ptr<Job> job)
 		{
-#ifdef DEBUG
-			std::cout << "[INFERENCE] [EMBEDDING] Initializing EmbeddingInferenceService with batch size: " << g_params.n_batch << std::endl;
-#endif
-
-			// Always enable embeddings for this service
-			llama_set_embeddings(context, true);
-
-			batch = llama_batch_init(params.n_ctx, 0, params.n_parallel);
+			Shard& s = shard(id);
+			std::unique_lock<std::shared_mutex> lock(s.mtx);
+			s.jobs[id] = std::move(job);
+		}
 
-			std::thread inferenceThread(&EmbeddingInferenceService::start, this);
-			inferenceThread.detach();
+		// Returns nullptr when the id is unknown
+		std::shared_ptr<Job> find(int id) const
+		{
+			const Shard& s = shard(id);
+			std::shared_lock<std::shared_mutex> lock(s.mtx);
+			auto it = s.jobs.find(id);
+			return it != s.jobs.end() ? it->second : nullptr;
 		}
 
-		~EmbeddingInferenceService()
+		void erase(int id)
 		{
-			stop();
+			Shard& s = shard(id);
+			std::unique_lock<std::shared_mutex> lock(s.mtx);
+			s.jobs.erase(id);
+		}
 
-			// Wait for any remaining jobs to complete
-			auto timeout = std::chrono::steady_clock::now() + std::chrono::seconds(10);
-			while (std::chrono::steady_clock::now() < timeout)
+		template <typename Pred>
+		bool any(Pred&& pred) const
+		{
+			for (const Shard& s : shards)
 			{
+				std::shared_lock<std::shared_mutex> lock(s.mtx);
+				for (const auto& entry : s.jobs)
 				{
-					std::lock_guard<std::mutex> lock(mtx);
-					if (jobs.empty())
-						break;
+					if (pred(entry.second))
+						return true;
 				}
-				std::this_thread::sleep_for(std::chrono::milliseconds(100));
 			}
-
-			// Clean up in proper order
-			llama_detach_threadpool(context);
-			llama_batch_free(batch);
-			llama_free(context);
-			llama_model_free(model);
-			ggml_threadpool_free(threadpool);
+			return false;
 		}
 
-		void stop() override
+		// Calls fn on every job under its shard's shared lock
+		template <typename Fn>
+		void forEach(Fn&& fn) const
 		{
-			should_terminate = true;
-			cv.notify_all();
+			for (const Shard& s : shards)
+			{
+				std::shared_lock<std::shared_mutex> lock(s.mtx);
+				for (const auto& entry : s.jobs)
+				{
+					fn(entry.second);
+				}
+			}
 		}
 
-		void start() override
+		// Removes every job for which pred (called under the shard lock) returns true
+		template <typename Pred>
+		size_t eraseIf(Pred&& pred)
 		{
-			while (!should_terminate)
+			size_t erased = 0;
+			for (Shard& s : shards)
 			{
-				std::vector<std::shared_ptr<Job>> current_jobs;
+				std::unique_lock<std::shared_mutex> lock(s.mtx);
+				for (auto it = s.jobs.begin(); it != s.jobs.end();)
 				{
-					std::unique_lock<std::mutex> lock(mtx);
-					if (jobs.empty())
+					if (pred(it->second))
 					{
-						cv.wait(lock, [this] { return !jobs.empty() || should_terminate; });
+						it = s.jobs.erase(it);
+						++erased;
+					}
+					else
+					{
+						++it;
 					}
-					if (should_terminate)
-						break;
-					current_jobs = jobs;
 				}
-
-				// Process embedding jobs in batches for efficiency
-				processBatchEmbeddings(current_jobs);
 			}
+			return erased;
 		}
 
-		void submitJob(const CompletionParameters &params, std::shared_ptr<Job> job) override
+		size_t size() const
 		{
-			// Not supported for embedding service
-			std::lock_guard<std::mutex> jobLock(job->mtx);
-			job->hasError = true;
-			job->errorMessage = "Text completion not supported by embedding service";
-			job->cv.notify_all();
+			size_t n = 0;
+			for (const Shard& s : shards)
+			{
+				std::shared_lock<std::shared_mutex> lock(s.mtx);
+				n += s.jobs.size();
+			}
+			return n;
 		}
 
-		void complete(const CompletionParameters &params, std::shared_ptr<Job> job) override
+		void clear()
 		{
-			// Not supported for embedding service
-			submitJob(params, job);
+			for (Shard& s : shards)
+			{
+				std::unique_lock<std::shared_mutex> lock(s.mtx);
+				s.jobs.clear();
+			}
 		}
 
-		void embed(const EmbeddingParameters &params, std::shared_ptr<Job> job) override
+	private:
+		static constexpr size_t kShards = 16;
+
+		// Padded to a cache line so neighbouring shard locks do not false-share
+		struct alignas(64) Shard
 		{
-#ifdef DEBUG
-			std::cout << "[INFERENCE] [EMBEDDING] Submitting embedding job" << std::endl;
-#endif
+			mutable std::shared_mutex mtx;
+			std::unordered_map<int, std::shared_ptr<Job>> jobs;
+		};
 
-			if (!params.isValid())
-			{
-				std::lock_guard<std::mutex> jobLock(job->mtx);
-				job->hasError = true;
-				job->errorMessage = "Invalid embedding parameters";
-				job->cv.notify_all();
-				return;
-			}
+		Shard& shard(int id) { return shards[static_cast<unsigned>(id) % kShards]; }
+		const Shard& shard(int id) const { return shards[static_cast<unsigned>(id) % kShards]; }
 
-			job->params_embedding = params;
+		std::array<Shard, kShards> shards;
+	};
+
+	// Job objects handed out again once nothing but the pool refers to them, so their token
+	// buffers and strings keep the capacity earlier requests grew them to. A job is reusable
+	// after it has left the registry, the submission queue and the decode loop.
+	class JobPool
+	{
+	public:
+		explicit JobPool(size_t capacity) : capacity(capacity) { jobs.reserve(capacity); }
 
+		std::shared_ptr<Job> acquire(int jobId)
+		{
+			std::shared_ptr<Job> job;
 			{
 				std::lock_guard<std::mutex> lock(mtx);
-				jobs.push_back(job);
+				for (size_t i = 0; i < jobs.size() && !job; ++i) {
+					const size_t idx = (next + i) % jobs.size();
+					// only the pool holds it, so no other thread can obtain it again
+					if (jobs[idx].use_count() == 1) {
+						job = jobs[idx];
+						next = idx + 1;
+					}
+				}
 			}
 
-			cv.notify_one();
+			if (job) {
+				job->recycle();
+			}
+			else {
+				job = std::make_shared<Job>();
+				std::lock_guard<std::mutex> lock(mtx);
+				if (jobs.size() < capacity) jobs.push_back(job);
+			}
+			std::lock_guard<std::mutex> jobLock(job->mtx);
+			job->jobId = jobId;
+			return job;
 		}
 
-		CompletionParameters formatChat(const ChatCompletionParameters &params) override
-		{
-			// Not supported for embedding service
-			throw std::runtime_error("Chat completion not supported by embedding service");
+	private:
+		const size_t						capacity;
+		std::mutex							mtx;
+		std::vector<std::shared_ptr<Job>>	jobs;
+		size_t								next = 0;
+	};
+
+	// KV cache element types accepted by LoadingParameters::cache_type_k / cache_type_v
+	bool parseCacheType(const std::string& name, ggml_type& type)
+	{
+		static const std::pair<const char*, ggml_type> kTypes[] = {
+			{ "f32",  GGML_TYPE_F32  }, { "f16",  GGML_TYPE_F16  }, { "bf16", GGML_TYPE_BF16 },
+			{ "q8_0", GGML_TYPE_Q8_0 }, { "q5_1", GGML_TYPE_Q5_1 }, { "q5_0", GGML_TYPE_Q5_0 },
+			{ "q4_1", GGML_TYPE_Q4_1 }, { "q4_0", GGML_TYPE_Q4_0 },
+		};
+		for (const auto& entry : kTypes) {
+			if (name == entry.first) {
+				type = entry.second;
+				return true;
+			}
 		}
+		return false;
+	}
 
-	private:
-		std::shared_ptr<Tokenizer> tokenizer;
-		struct llama_model *model;
-		struct llama_context *context;
-		std::mutex mtx;
-		std::condition_variable cv;
-		common_params g_params;
-		ggml_threadpool *threadpool;
-		llama_batch batch;
-		std::vector<std::shared_ptr<Job>> jobs;
-		std::atomic<bool> should_terminate{false};
-		std::atomic<bool> embeddings_enabled{true};
+	struct MemoryPlan {
+		int			n_ctx;
+		int			n_gpu_layers;
+		ggml_type	type_k;
+		ggml_type	type_v;
+	};
 
-		const int n_batch;
-		const int n_ctx;
+	// Free memory summed over the backend's GPU devices; 0 when there are none
+	size_t freeDeviceMemory()
+	{
+		size_t total_free = 0;
+		for (size_t i = 0; i < ggml_backend_dev_count(); ++i) {
+			ggml_backend_dev_t dev = ggml_backend_dev_get(i);
+			if (ggml_backend_dev_type(dev) != GGML_BACKEND_DEVICE_TYPE_GPU) continue;
+			size_t free = 0, total = 0;
+			ggml_backend_dev_memory(dev, &free, &total);
+			total_free += free;
+		}
+		return total_free;
+	}
 
-		void processBatchEmbeddings(std::vector<std::shared_ptr<Job>>& current_jobs)
-		{
-			std::vector<std::shared_ptr<Job>> embedding_jobs;
-			
-			// Filter embedding jobs
-			for (auto& job : current_jobs)
-			{
-				std::lock_guard<std::mutex> jobLock(job->mtx);
-				if (!job->isFinished && !job->hasError)
-				{
-					embedding_jobs.push_back(job);
-				}
+	// Shrinks `plan` until the weights, KV cache and compute buffers fit in `free_bytes` of device
+	// memory. In order of preference: keep every layer and the full context, quantize the KV cache
+	// types left on "auto" to q8_0 and then q4_0, shorten the context down to 1024 tokens per
+	// sequence, and finally offload fewer layers. Sizes are estimated from the GGUF hyperparameters
+	// and file size, so the plan keeps a margin instead of packing the device to the last byte.
+	MemoryPlan fitToDeviceMemory(const std::filesystem::path& modelPath, MemoryPlan plan, int n_seq, int n_ubatch,
+		bool auto_k, bool auto_v, size_t free_bytes)
+	{
+		llama_model_params mparams = llama_model_default_params();
+		mparams.vocab_only = true;
+		llama_model* meta = llama_model_load_from_file(modelPath.string().c_str(), mparams);
+		if (!meta) return plan;
+
+		const int64_t n_layer	= std::max(1, llama_model_n_layer(meta));
+		const int64_t n_embd	= llama_model_n_embd(meta);
+		const int64_t n_head	= std::max(1, llama_model_n_head(meta));
+		const int64_t n_head_kv	= std::max(1, llama_model_n_head_kv(meta));
+		const int64_t n_vocab	= llama_vocab_n_tokens(llama_model_get_vocab(meta));
+		llama_model_free(meta);
+
+		std::error_code ec;
+		const double weights	= static_cast<double>(std::filesystem::file_size(modelPath, ec));
+		if (ec) return plan;
+		const double per_layer	= weights / static_cast<double>(n_layer + 1);	// counting the output layer
+		const double compute	= static_cast<double>(n_ubatch) * static_cast<double>(n_vocab + 4 * n_embd) * sizeof(float);
+		const double budget		= static_cast<double>(free_bytes) * 0.95 - compute;
+		const int64_t n_embd_kv	= n_embd / n_head * n_head_kv;
+
+		auto kvPerToken = [&](ggml_type k, ggml_type v) {
+			return static_cast<double>(n_layer) * static_cast<double>(ggml_row_size(k, n_embd_kv) + ggml_row_size(v, n_embd_kv));
+		};
+		auto cost = [&](double ctx, int layers, ggml_type k, ggml_type v) {
+			const double kv_share = static_cast<double>(std::min<int64_t>(layers, n_layer)) / static_cast<double>(n_layer);
+			return layers * per_layer + ctx * kvPerToken(k, v) * kv_share;
+		};
+
+		plan.n_gpu_layers = static_cast<int>(std::min<int64_t>(std::max(0, plan.n_gpu_layers), n_layer + 1));
+
+		std::vector<std::pair<ggml_type, ggml_type>> candidates{ { plan.type_k, plan.type_v } };
+		if (auto_k || auto_v) {
+			for (ggml_type q : { GGML_TYPE_Q8_0, GGML_TYPE_Q4_0 }) {
+				candidates.emplace_back(auto_k ? q : plan.type_k, auto_v ? q : plan.type_v);
 			}
+		}
+		for (const auto& types : candidates) {
+			plan.type_k = types.first;
+			plan.type_v = types.second;
+			if (cost(plan.n_ctx, plan.n_gpu_layers, plan.type_k, plan.type_v) <= budget) return plan;
+		}
 
-			if (embedding_jobs.empty())
-			{
-				return;
-			}
+		const int min_ctx = std::min(plan.n_ctx, 1024 * std::max(1, n_seq));
+		const double kv_on_device = kvPerToken(plan.type_k, plan.type_v)
+			* static_cast<double>(std::min<int64_t>(plan.n_gpu_layers, n_layer)) / static_cast<double>(n_layer);
+		const double room = budget - plan.n_gpu_layers * per_layer;
+		if (kv_on_device > 0.0 && room >= min_ctx * kv_on_device) {
+			const int fitted = static_cast<int>(std::min<double>(room / kv_on_device, plan.n_ctx));
+			plan.n_ctx = std::max(min_ctx, fitted / 256 * 256);
+			return plan;
+		}
 
-			try
-			{
-				// Process embeddings in batch for efficiency
-				processBatch(embedding_jobs);
-			}
-			catch (const std::exception& e)
-			{
-				// Mark all jobs as failed
-				for (auto& job : embedding_jobs)
-				{
-					std::lock_guard<std::mutex> jobLock(job->mtx);
-					job->hasError = true;
-					job->errorMessage = std::string("Batch embedding failed: ") + e.what();
-					job->isFinished = true;
-					job->cv.notify_all();
-				}
-			}
+		plan.n_ctx = min_ctx;
+		const double layer_cost = per_layer + plan.n_ctx * kvPerToken(plan.type_k, plan.type_v) / static_cast<double>(n_layer);
+		plan.n_gpu_layers = static_cast<int>(std::clamp<double>(budget / layer_cost, 0.0, plan.n_gpu_layers));
+		return plan;
+	}
 
-			// Remove completed jobs
-			{
-				std::lock_guard<std::mutex> lock(mtx);
-				jobs.erase(std::remove_if(jobs.begin(), jobs.end(),
-					[](const std::shared_ptr<Job>& job) {
-						std::lock_guard<std::mutex> jobLock(job->mtx);
-						return job->isFinished || job->hasError;
-					}), jobs.end());
+	// Bytes of weights per repeating layer ("blk.N.*"), plus the output head as a final entry,
+	// read from the GGUF tensor table without loading any data
+	std::vector<double> layerWeightBytes(const std::filesystem::path& modelPath, int64_t n_layer)
+	{
+		std::vector<double> layers(static_cast<size_t>(n_layer) + 1, 0.0);
+		gguf_init_params gparams{ /*no_alloc =*/ true, /*ctx =*/ nullptr };
+		gguf_context* gctx = gguf_init_from_file(modelPath.string().c_str(), gparams);
+		if (!gctx) return {};
+
+		for (int64_t i = 0; i < gguf_get_n_tensors(gctx); ++i) {
+			const char* name = gguf_get_tensor_name(gctx, i);
+			const double bytes = static_cast<double>(gguf_get_tensor_size(gctx, i));
+			if (std::strncmp(name, "blk.", 4) == 0) {
+				const long il = std::strtol(name + 4, nullptr, 10);
+				if (il >= 0 && il < n_layer) layers[static_cast<size_t>(il)] += bytes;
+			}
+			else if (std::strncmp(name, "output", 6) == 0) {
+				layers.back() += bytes;	// output.weight and output_norm; token_embd stays on the host
 			}
 		}
+		gguf_free(gctx);
+		return layers;
+	}
 
-		void processBatch(std::vector<std::shared_ptr<Job>>& embedding_jobs)
-		{
-			// Clear batch and KV cache
-			common_batch_clear(batch);
-			auto * mem = llama_get_memory(context);
-			llama_memory_clear(mem, /*data=*/true);
-
-			std::vector<std::vector<llama_token>> all_tokens;
-			std::vector<int> job_indices;
+	// Where LoadingParameters::moe_offload puts the routed experts of a mixture-of-experts model
+	struct ExpertPlan {
+		std::string	pattern;		// Regex of the expert tensors kept in host memory (empty: none)
+		int			n_layer = 0;
+		int			hostLayers = 0;
+		double		hostBytes = 0.0;
+		double		expertBytes = 0.0;	// Of every layer; 0 for a dense model
+	};
 
-			// Tokenize all inputs
-			for (size_t i = 0; i < embedding_jobs.size(); ++i)
-			{
-				auto& job = embedding_jobs[i];
-				
-				try
-				{
-					std::string input;
-					bool normalize = true;
-					{
-						std::lock_guard<std::mutex> jobLock(job->mtx);
-						input = job->params_embedding.input;
-						normalize = job->params_embedding.normalize;
-					}
+	// Plans expert placement from the GGUF tensor table. Routed experts ("blk.N.ffn_*_exps") are
+	// read a few at a time per token, so they cost little on the CPU, while attention, norms and
+	// shared experts ("_shexp") run for every token and stay on the GPU. `fill` keeps the experts
+	// of as many layers as fit in `free_bytes` on the GPU, after the other weights, the KV cache
+	// and a compute buffer, from the last layer down (as whole layers are offloaded); otherwise
+	// every layer's experts move. A dense model gets an empty plan
+	ExpertPlan planExpertOffload(const std::filesystem::path& modelPath, const common_params& params, bool fill, size_t free_bytes)
+	{
+		ExpertPlan plan;
+		llama_model_params mparams = llama_model_default_params();
+		mparams.vocab_only = true;
+		llama_model* meta = llama_model_load_from_file(modelPath.string().c_str(), mparams);
+		if (!meta) return plan;
+		const int64_t n_layer	= std::max(1, llama_model_n_layer(meta));
+		const int64_t n_embd	= llama_model_n_embd(meta);
+		const int64_t n_head	= std::max(1, llama_model_n_head(meta));
+		const int64_t n_head_kv	= std::max(1, llama_model_n_head_kv(meta));
+		const int64_t n_vocab	= llama_vocab_n_tokens(llama_model_get_vocab(meta));
+		llama_model_free(meta);
+
+		gguf_init_params gparams{ /*no_alloc =*/ true, /*ctx =*/ nullptr };
+		gguf_context* gctx = gguf_init_from_file(modelPath.string().c_str(), gparams);
+		if (!gctx) return plan;
+		std::vector<double> experts(static_cast<size_t>(n_layer), 0.0);
+		double dense = 0.0;
+		for (int64_t i = 0; i < gguf_get_n_tensors(gctx); ++i) {
+			const char* name = gguf_get_tensor_name(gctx, i);
+			const double bytes = static_cast<double>(gguf_get_tensor_size(gctx, i));
+			const long il = std::strncmp(name, "blk.", 4) == 0 ? std::strtol(name + 4, nullptr, 10) : -1;
+			if (il >= 0 && il < n_layer && std::strstr(name, ".ffn_") && std::strstr(name, "_exps")) {
+				experts[static_cast<size_t>(il)] += bytes;
+			}
+			else if (std::strncmp(name, "token_embd", 10) != 0) {
+				dense += bytes;		// token_embd stays on the host
+			}
+		}
+		gguf_free(gctx);
+
+		plan.n_layer = static_cast<int>(n_layer);
+		std::vector<int> hostLayers;
+		double room = 0.0;
+		if (fill) {
+			const int64_t n_embd_kv	= n_embd / n_head * n_head_kv;
+			const double kv			= static_cast<double>(params.n_ctx) * static_cast<double>(n_layer) *
+				static_cast<double>(ggml_row_size(params.cache_type_k, n_embd_kv) + ggml_row_size(params.cache_type_v, n_embd_kv));
+			const double compute	= static_cast<double>(params.n_ubatch) * static_cast<double>(n_vocab + 4 * n_embd) * sizeof(float);
+			room = static_cast<double>(free_bytes) * 0.95 - compute - kv - dense;
+		}
+		for (int64_t il = n_layer - 1; il >= 0; --il) {
+			const double bytes = experts[static_cast<size_t>(il)];
+			if (bytes <= 0.0) continue;
+			plan.expertBytes += bytes;
+			if (bytes <= room) {
+				room -= bytes;
+				continue;
+			}
+			hostLayers.push_back(static_cast<int>(il));
+			plan.hostBytes += bytes;
+		}
+		if (hostLayers.empty()) return plan;
 
-					// Tokenize input
-					std::vector<llama_token> tokens = common_tokenize(context, input, 
-						llama_vocab_get_add_bos(llama_model_get_vocab(model)), false);
-					
-					if (tokens.empty())
-					{
-						std::lock_guard<std::mutex> jobLock(job->mtx);
-						job->hasError = true;
-						job->errorMessage = "Input text resulted in empty tokens";
-						job->isFinished = true;
-						job->cv.notify_all();
-						continue;
-					}
+		plan.hostLayers = static_cast<int>(hostLayers.size());
+		std::string layers;
+		for (auto it = hostLayers.rbegin(); it != hostLayers.rend(); ++it) {
+			layers += (layers.empty() ? "" : "|") + std::to_string(*it);
+		}
+		plan.pattern = "^blk\\.(" + layers + ")\\.ffn_(up|down|gate|gate_up)_exps";
+		return plan;
+	}
 
-					// Check token limit
-					const int max_tokens = std::min(n_ctx / static_cast<int>(embedding_jobs.size()) - 4, 512);
-					if (static_cast<int>(tokens.size()) > max_tokens)
-					{
-						tokens.resize(max_tokens);
-					}
+	// Splits a model over the GPUs by what each can hold once its share of the KV cache and a
+	// compute buffer are set aside, instead of llama.cpp's default of splitting by free memory
+	// alone. Layer split: layers are handed out in order so each device's share of the total
+	// (weights plus KV) matches its share of the usable memory; uneven layers and the large
+	// output head are accounted for. Row split: rows are divided by usable memory, after the
+	// main GPU, which keeps the whole KV cache, has set it aside. With main_gpu < 0 the device
+	// with the most free memory becomes the main GPU. Leaves params untouched on one GPU.
+	void planGpuSplit(const std::filesystem::path& modelPath, common_params& params, bool autoMainGpu)
+	{
+		std::vector<size_t> freeBytes;
+		for (size_t i = 0; i < ggml_backend_dev_count(); ++i) {
+			ggml_backend_dev_t dev = ggml_backend_dev_get(i);
+			if (ggml_backend_dev_type(dev) != GGML_BACKEND_DEVICE_TYPE_GPU) continue;
+			size_t free = 0, total = 0;
+			ggml_backend_dev_memory(dev, &free, &total);
+			freeBytes.push_back(free);
+		}
+		if (freeBytes.empty()) return;
 
-					{
-						// store token count for result usage
-						std::lock_guard<std::mutex> jobLock(job->mtx);
-						job->embedding_token_count = static_cast<int>(tokens.size());
-					}
-					all_tokens.push_back(tokens);
-					job_indices.push_back(static_cast<int>(i));
+		if (autoMainGpu) {
+			params.main_gpu = static_cast<int>(std::max_element(freeBytes.begin(), freeBytes.end()) - freeBytes.begin());
+		}
+		const size_t n_dev = std::min<size_t>(freeBytes.size(), 128);
+		if (n_dev < 2 || params.split_mode == LLAMA_SPLIT_MODE_NONE || params.n_gpu_layers <= 0) return;
+
+		llama_model_params mparams = llama_model_default_params();
+		mparams.vocab_only = true;
+		llama_model* meta = llama_model_load_from_file(modelPath.string().c_str(), mparams);
+		if (!meta) return;
+		const int64_t n_layer	= std::max(1, llama_model_n_layer(meta));
+		const int64_t n_embd	= llama_model_n_embd(meta);
+		const int64_t n_head	= std::max(1, llama_model_n_head(meta));
+		const int64_t n_head_kv	= std::max(1, llama_model_n_head_kv(meta));
+		const int64_t n_vocab	= llama_vocab_n_tokens(llama_model_get_vocab(meta));
+		llama_model_free(meta);
+
+		std::vector<double> layers = layerWeightBytes(modelPath, n_layer);
+		if (layers.empty()) return;
+
+		const int64_t n_embd_kv		= n_embd / n_head * n_head_kv;
+		const double kv_per_layer	= static_cast<double>(params.n_ctx) *
+			static_cast<double>(ggml_row_size(params.cache_type_k, n_embd_kv) + ggml_row_size(params.cache_type_v, n_embd_kv));
+		const double compute		= static_cast<double>(params.n_ubatch) * static_cast<double>(4 * n_embd) * sizeof(float);
+		const double logits			= static_cast<double>(params.n_ubatch) * static_cast<double>(n_vocab) * sizeof(float);
+
+		std::vector<double> usable(n_dev);
+		for (size_t d = 0; d < n_dev; ++d) {
+			usable[d] = std::max(0.0, static_cast<double>(freeBytes[d]) * 0.95 - compute);
+		}
 
-				}
-				catch (const std::exception& e)
-				{
-					std::lock_guard<std::mutex> jobLock(job->mtx);
-					job->hasError = true;
-					job->errorMessage = std::string("Tokenization failed: ") + e.what();
-					job->isFinished = true;
-					job->cv.notify_all();
-				}
+		std::vector<float> split(n_dev, 0.0f);
+		if (params.split_mode == LLAMA_SPLIT_MODE_ROW) {
+			double kv_total = kv_per_layer * static_cast<double>(n_layer);
+			const size_t main = static_cast<size_t>(std::clamp<int>(params.main_gpu, 0, static_cast<int>(n_dev) - 1));
+			usable[main] = std::max(0.0, usable[main] - kv_total - logits);
+			for (size_t d = 0; d < n_dev; ++d) split[d] = static_cast<float>(usable[d]);
+		}
+		else {
+			// Only offloaded layers are placed; the last ones are the ones offloaded first
+			const size_t offloaded = std::min<size_t>(static_cast<size_t>(params.n_gpu_layers), layers.size());
+			std::vector<double> cost(layers.end() - offloaded, layers.end());
+			for (size_t i = 0; i < cost.size(); ++i) {
+				const bool output = (layers.size() - offloaded + i) == layers.size() - 1;
+				cost[i] += output ? logits : kv_per_layer;
 			}
 
-			if (all_tokens.empty())
-			{
-				return;
+			double total_cost = 0.0, total_usable = 0.0;
+			for (double c : cost) total_cost += c;
+			for (double u : usable) total_usable += u;
+			if (total_usable <= 0.0) return;
+
+			// A layer goes to the device whose cumulative share covers the layer's midpoint
+			double before = 0.0, target = 0.0;
+			size_t d = 0;
+			target = total_cost * usable[0] / total_usable;
+			for (double c : cost) {
+				while (d + 1 < n_dev && before + c / 2 > target) {
+					++d;
+					target += total_cost * usable[d] / total_usable;
+				}
+				split[d] += 1.0f;
+				before += c;
 			}
+		}
 
-			// Add tokens to batch with different sequence IDs
-			for (size_t seq = 0; seq < all_tokens.size(); ++seq)
-			{
-				const auto& tokens = all_tokens[seq];
-				for (size_t i = 0; i < tokens.size(); ++i)
-				{
-					if (batch.n_tokens >= n_batch)
-					{
-						break; // Batch is full
-					}
+		float sum = 0.0f;
+		for (float f : split) sum += f;
+		if (sum <= 0.0f) return;
+		std::cout << "[INFERENCE] Planned " << (params.split_mode == LLAMA_SPLIT_MODE_ROW ? "row" : "layer")
+			<< " split from free VRAM (main GPU " << params.main_gpu << "):";
+		for (size_t d = 0; d < n_dev; ++d) {
+			params.tensor_split[d] = split[d] / sum;
+			std::cout << " " << std::fixed << std::setprecision(2) << params.tensor_split[d]
+				<< " (" << (freeBytes[d] >> 20) << " MiB free)";
+		}
+		std::cout << std::defaultfloat << std::endl;
+	}
 
-					batch.token[batch.n_tokens] = tokens[i];
-					batch.pos[batch.n_tokens] = static_cast<llama_pos>(i);
-					batch.n_seq_id[batch.n_tokens] = 1;
-					batch.seq_id[batch.n_tokens][0] = static_cast<llama_seq_id>(seq);
-					// Set logits for the last token of each sequence
-					batch.logits[batch.n_tokens] = (i == tokens.size() - 1) ? true : false;
-					batch.n_tokens++;
-				}
-			}
+	// Load-time tuning of the decode thread count and the batch sizes. Results are kept in a JSON
+	// file keyed by model and hardware, so a later load on the same host skips the benchmarks
+	struct TunedSettings {
+		int		n_threads	= 0;
+		int		n_batch		= 0;
+		int		n_ubatch	= 0;
+	};
 
-			// Decode the batch
-			if (llama_decode(context, batch) != 0)
-			{
-				throw std::runtime_error("Failed to decode embedding batch");
-			}
+	// Tuning stops trying further candidates after this long and keeps the best so far
+	constexpr double kAutotuneBudgetSeconds = 120.0;
 
-			// Extract embeddings for each sequence
-			const int n_embd = llama_model_n_embd(model);
-			const enum llama_pooling_type pooling_type = llama_pooling_type(context);
+	// Engines tune one at a time: concurrent benchmarks would measure each other, and a replica
+	// loading behind the first one finds its result in the cache
+	std::mutex& autotuneMutex()
+	{
+		static std::mutex mtx;
+		return mtx;
+	}
 
-			for (size_t seq = 0; seq < job_indices.size(); ++seq)
-			{
-				auto& job = embedding_jobs[job_indices[seq]];
-				
-				try
-				{
-					bool normalize;
-					{
-						std::lock_guard<std::mutex> jobLock(job->mtx);
-						normalize = job->params_embedding.normalize;
-					}
+	// Identity of a GGUF without reading all of it: its size and FNV-1a of its first and last MiB
+	std::string modelFingerprint(const std::filesystem::path& path)
+	{
+		constexpr uint64_t kSpan = 1ull << 20;
+		std::error_code ec;
+		const uint64_t size = std::filesystem::file_size(path, ec);
+		if (ec) return path.filename().string();
+
+		uint64_t h = 14695981039346656037ull;
+		auto mix = [&h](const std::vector<char>& bytes) {
+			for (char c : bytes) h = (h ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+		};
+		std::ifstream in(path, std::ios::binary);
+		std::vector<char> bytes(static_cast<size_t>(std::min(size, kSpan)));
+		in.read(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+		mix(bytes);
+		if (size > 2 * kSpan) {
+			in.seekg(static_cast<std::streamoff>(size - kSpan));
+			in.read(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+			mix(bytes);
+		}
+		std::ostringstream out;
+		out << std::hex << std::setw(16) << std::setfill('0') << h << std::dec << '-' << size;
+		return out.str();
+	}
 
-					float* embd = nullptr;
-					
-					if (pooling_type == LLAMA_POOLING_TYPE_NONE)
-					{
-						// Find the last token position for this sequence
-						int last_token_pos = -1;
-						for (int i = 0; i < batch.n_tokens; ++i)
-						{
-							if (batch.seq_id[i][0] == static_cast<llama_seq_id>(seq) && batch.logits[i])
-							{
-								last_token_pos = i;
-								break;
-							}
-						}
-						
-						if (last_token_pos >= 0)
-						{
-							embd = llama_get_embeddings_ith(context, last_token_pos);
-						}
-					}
-					else
-					{
-						embd = llama_get_embeddings_seq(context, static_cast<llama_seq_id>(seq));
-					}
+	// Everything the measurements depend on: model, CPU, cores, GPUs and weight placement
+	std::string autotuneKey(const std::filesystem::path& modelPath, const common_params& params,
+		size_t pinnedCores, int explicitThreads, bool embedding)
+	{
+		std::string cpu = "unknown";
+#ifdef __linux__
+		std::ifstream cpuinfo("/proc/cpuinfo");
+		std::string line;
+		while (std::getline(cpuinfo, line)) {
+			if (line.rfind("model name", 0) == 0) {
+				const size_t colon = line.find(':');
+				if (colon != std::string::npos) cpu = line.substr(line.find_first_not_of(" \t", colon + 1));
+				break;
+			}
+		}
+#endif
+		std::ostringstream key;
+		key << modelFingerprint(modelPath) << (embedding ? "|embedding" : "")
+			<< "|cpu=" << cpu << "|hw=" << std::thread::hardware_concurrency() << "|cores=" << pinnedCores
+			<< "|threads=" << explicitThreads << "|ngl=" << params.n_gpu_layers
+			<< "|split=" << static_cast<int>(params.split_mode) << "|main=" << params.main_gpu << "|gpus=";
+		for (size_t i = 0; i < ggml_backend_dev_count(); ++i) {
+			ggml_backend_dev_t dev = ggml_backend_dev_get(i);
+			if (ggml_backend_dev_type(dev) == GGML_BACKEND_DEVICE_TYPE_GPU) key << ggml_backend_dev_description(dev) << ";";
+		}
+		return key.str();
+	}
 
-					if (!embd)
-					{
-						std::lock_guard<std::mutex> jobLock(job->mtx);
-						job->hasError = true;
-						job->errorMessage = "Failed to get embeddings from model";
-						job->isFinished = true;
-						job->cv.notify_all();
-						continue;
-					}
+	bool readTunedSettings(const std::filesystem::path& file, const std::string& key, TunedSettings& out)
+	{
+		std::ifstream in(file);
+		if (!in) return false;
+		const nlohmann::json cache = nlohmann::json::parse(in, nullptr, false);
+		if (!cache.is_object() || !cache.contains(key) || !cache[key].is_object()) return false;
+		const auto& entry = cache[key];
+		out.n_threads	= entry.value("n_threads", 0);
+		out.n_batch		= entry.value("n_batch", 0);
+		out.n_ubatch	= entry.value("n_ubatch", 0);
+		return out.n_threads > 0 && out.n_ubatch > 0 && out.n_batch >= out.n_ubatch;
+	}
 
-					// Copy and normalize embedding
-					std::vector<float> embedding(embd, embd + n_embd);
-					
-					if (normalize)
-					{
-						float norm = 0.0f;
-						for (float val : embedding)
-						{
-							norm += val * val;
-						}
-						norm = std::sqrt(norm);
-						
-						if (norm > 1e-8f)
-						{
-							for (float& val : embedding)
-							{
-								val /= norm;
-							}
-						}
-					}
+	// Read-modify-write through a temporary file, so another process never reads half a cache
+	void writeTunedSettings(const std::filesystem::path& file, const std::string& key, const TunedSettings& tuned,
+		const std::string& modelName)
+	{
+		nlohmann::json cache = nlohmann::json::object();
+		{
+			std::ifstream in(file);
+			if (in) {
+				cache = nlohmann::json::parse(in, nullptr, false);
+				if (!cache.is_object()) cache = nlohmann::json::object();
+			}
+		}
+		cache[key] = {
+			{ "model", modelName },
+			{ "n_threads", tuned.n_threads },
+			{ "n_batch", tuned.n_batch },
+			{ "n_ubatch", tuned.n_ubatch },
+			{ "tuned_at", static_cast<int64_t>(std::chrono::duration_cast<std::chrono::seconds>(
+				std::chrono::system_clock::now().time_since_epoch()).count()) } };
+
+		std::error_code ec;
+		if (file.has_parent_path()) std::filesystem::create_directories(file.parent_path(), ec);
+		const std::filesystem::path temp = file.string() + ".tmp" + std::to_string(static_cast<long long>(
+			std::hash<std::thread::id>{}(std::this_thread::get_id()) & 0xffff));
+		{
+			std::ofstream out(temp, std::ios::trunc);
+			out << cache.dump(2) << '\n';
+			if (!out) {
+				std::cerr << "[INFERENCE] [WARNING] Cannot write the autotune cache " << file << std::endl;
+				return;
+			}
+		}
+		std::filesystem::rename(temp, file, ec);
+		if (ec) {
+			std::filesystem::remove(temp, ec);
+			std::cerr << "[INFERENCE] [WARNING] Cannot write the autotune cache " << file << std::endl;
+		}
+	}
 
-					{
-						std::lock_guard<std::mutex> jobLock(job->mtx);
-						job->embedding = embedding;
-						job->isFinished = true;
-						job->cv.notify_all();
-					}
+	struct PassTiming {
+		double	prefill_s	= -1.0;
+		double	decode_s	= -1.0;	// Per generated token
+	};
 
-#ifdef DEBUG
-					std::cout << "[INFERENCE] [EMBEDDING] Generated " << n_embd << "-dimensional embedding for sequence " << seq << std::endl;
-#endif
+	// Prefills `n_prompt` synthetic tokens in chunks of `chunk`, then decodes `n_gen` tokens one at
+	// a time, on an empty sequence 0. Negative times mean a forward pass failed
+	PassTiming timeForwardPasses(llama_context* ctx, const llama_model* model, int n_prompt, int chunk, int n_gen)
+	{
+		using clock = std::chrono::steady_clock;
+		const int n_vocab = std::max(1, llama_vocab_n_tokens(llama_model_get_vocab(model)));
+		const bool encoder = llama_model_has_encoder(model);
+		chunk = std::max(1, std::min(chunk, n_prompt));
+		llama_batch batch = llama_batch_init(chunk, 0, 1);
+		PassTiming timing;
+
+		auto pass = [&](int pos, int count) {
+			common_batch_clear(batch);
+			for (int i = 0; i < count; ++i) {
+				const llama_token token = static_cast<llama_token>((static_cast<int64_t>(pos + i) * 7919 + 13) % n_vocab);
+				common_batch_add(batch, token, pos + i, { 0 }, i + 1 == count);
+			}
+			return (encoder ? llama_encode(ctx, batch) : llama_decode(ctx, batch)) == 0;
+		};
+
+		llama_memory_clear(llama_get_memory(ctx), true);
+		auto start = clock::now();
+		bool ok = true;
+		for (int pos = 0; ok && pos < n_prompt; pos += chunk) {
+			ok = pass(pos, std::min(chunk, n_prompt - pos));
+		}
+		llama_synchronize(ctx);
+		if (ok) timing.prefill_s = std::chrono::duration<double>(clock::now() - start).count();
+
+		if (ok && n_gen > 0 && !encoder) {
+			start = clock::now();
+			for (int i = 0; ok && i < n_gen; ++i) ok = pass(n_prompt + i, 1);
+			llama_synchronize(ctx);
+			if (ok) timing.decode_s = std::chrono::duration<double>(clock::now() - start).count() / n_gen;
+		}
+		llama_batch_free(batch);
+		llama_memory_clear(llama_get_memory(ctx), true);
+		return timing;
+	}
 
+	// Candidates that come within this factor of the best are as good; the cheaper one is kept
+	constexpr double kAutotuneTolerance = 1.03;
+
+	// Benchmarks on `ctx` (the engine's context, still without a threadpool) and on short-lived
+	// contexts over the same weights. Threads: the fewest that reach the best time for a typical
+	// request (a 512-token prompt and 128 generated tokens). n_ubatch: the smallest with the best
+	// prefill throughput, which also keeps the compute buffers small. n_batch: the smallest multiple
+	// of it that loses no prefill throughput, so a long prompt's chunks hold running generations
+	// back as little as possible. Embedding models keep their batch sizes, which bound input length.
+	// `maxUbatch` (0 = none) caps n_ubatch, e.g. where fit_vram sized the compute buffers for it
+	TunedSettings autotuneEngine(llama_model* model, llama_context* ctx, const common_params& params,
+		const std::vector<int>& cores, bool tuneThreads, bool generative, int maxUbatch)
+	{
+		const auto started = std::chrono::steady_clock::now();
+		auto overBudget = [&]() {
+			return std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count() > kAutotuneBudgetSeconds;
+		};
+		// Without a unified KV cache each sequence gets an equal share of the context
+		const int n_ctx = static_cast<int>(llama_n_ctx(ctx)) / std::max(1, static_cast<int>(llama_n_seq_max(ctx)));
+
+		TunedSettings tuned;
+		tuned.n_threads	= params.cpuparams.n_threads;
+		tuned.n_batch	= params.n_batch;
+		tuned.n_ubatch	= params.n_ubatch;
+
+		auto withThreads = [&](llama_context* target, int n_threads, auto&& measure) {
+			ggml_threadpool* pool = BackendManager::instance().acquireThreadpool(n_threads, cores);
+			if (!pool) return false;
+			llama_attach_threadpool(target, pool, nullptr);
+			llama_set_n_threads(target, n_threads, n_threads);
+			measure();
+			llama_detach_threadpool(target);
+			BackendManager::instance().releaseThreadpool(pool);
+			return true;
+		};
+
+		if (tuneThreads) {
+			const int maxThreads = cores.empty()
+				? static_cast<int>(std::max(1u, std::thread::hardware_concurrency()))
+				: static_cast<int>(cores.size());
+			std::set<int> candidates{ tuned.n_threads };
+			for (int quarter = 1; quarter <= 4; ++quarter) candidates.insert(std::max(1, maxThreads * quarter / 4));
+
+			const int n_prompt = std::max(1, std::min({ 256, params.n_ubatch, n_ctx - 64 }));
+			const int n_gen = generative ? 16 : 0;
+			double best = std::numeric_limits<double>::max();
+			std::vector<std::pair<int, double>> scores;
+			for (int n_threads : candidates) {
+				if (overBudget()) break;
+				PassTiming timing;
+				withThreads(ctx, n_threads, [&]() {
+					timeForwardPasses(ctx, model, std::min(n_prompt, 32), n_prompt, 0);	// first touch of the pool
+					timing = timeForwardPasses(ctx, model, n_prompt, n_prompt, n_gen);
+				});
+				if (timing.prefill_s < 0 || (generative && timing.decode_s < 0)) continue;
+				const double score = timing.prefill_s * 512.0 / n_prompt + (generative ? timing.decode_s * 128.0 : 0.0);
+				std::cout << "[INFERENCE] Autotune: " << n_threads << " threads, " << std::fixed << std::setprecision(1)
+					<< n_prompt / timing.prefill_s << " prompt tok/s"
+					<< (generative ? ", " + std::to_string(static_cast<int>(1.0 / timing.decode_s)) + " gen tok/s" : std::string())
+					<< std::defaultfloat << std::endl;
+				scores.emplace_back(n_threads, score);
+				best = std::min(best, score);
+			}
+			for (const auto& [n_threads, score] : scores) {
+				if (score <= best * kAutotuneTolerance) {
+					tuned.n_threads = n_threads;
+					break;
 				}
-				catch (const std::exception& e)
-				{
-					std::lock_guard<std::mutex> jobLock(job->mtx);
-					job->hasError = true;
-					job->errorMessage = std::string("Embedding extraction failed: ") + e.what();
-					job->isFinished = true;
-					job->cv.notify_all();
+			}
+		}
+
+		if (!generative) return tuned;
+
+		// Short-lived single-sequence contexts with the candidate batch sizes
+		auto trialContext = [&](int n_batch, int n_ubatch) {
+			common_params trial = params;
+			trial.n_ctx			= n_batch + 64;
+			trial.n_batch		= n_batch;
+			trial.n_ubatch		= n_ubatch;
+			trial.n_parallel	= 1;
+			trial.kv_unified	= false;
+			trial.cpuparams.n_threads = tuned.n_threads;
+			return llama_init_from_model(model, common_context_params_to_llama(trial));
+		};
+
+		const int maxBatch = std::min(std::max(4096, params.n_batch), llama_model_n_ctx_train(model));
+		std::vector<std::pair<int, double>> ubatchRates;
+		double bestRate = 0.0;
+		for (int n_ubatch = 128; n_ubatch <= maxBatch; n_ubatch *= 2) {
+			if (overBudget() || (maxUbatch > 0 && n_ubatch > maxUbatch)) break;
+			llama_context* trial = trialContext(n_ubatch, n_ubatch);
+			if (!trial) break;
+			double seconds = -1.0;
+			withThreads(trial, tuned.n_threads, [&]() {
+				timeForwardPasses(trial, model, n_ubatch, n_ubatch, 0);
+				for (int rep = 0; rep < 2; ++rep) {
+					const double s = timeForwardPasses(trial, model, n_ubatch, n_ubatch, 0).prefill_s;
+					if (s > 0 && (seconds < 0 || s < seconds)) seconds = s;
 				}
+			});
+			llama_free(trial);
+			if (seconds <= 0) continue;
+			const double rate = n_ubatch / seconds;
+			std::cout << "[INFERENCE] Autotune: n_ubatch " << n_ubatch << ", " << std::fixed << std::setprecision(1)
+				<< rate << " prompt tok/s" << std::defaultfloat << std::endl;
+			ubatchRates.emplace_back(n_ubatch, rate);
+			bestRate = std::max(bestRate, rate);
+		}
+		for (const auto& [n_ubatch, rate] : ubatchRates) {
+			if (rate * kAutotuneTolerance >= bestRate) {
+				tuned.n_ubatch = n_ubatch;
+				break;
 			}
 		}
-	};
+		tuned.n_batch = std::max(tuned.n_batch, tuned.n_ubatch);
+
+		// One context holds the largest step; smaller steps are just smaller decode calls on it
+		const int largest = std::min(maxBatch, tuned.n_ubatch * 8);
+		if (overBudget() || largest <= tuned.n_ubatch) return tuned;
+		llama_context* trial = trialContext(largest, tuned.n_ubatch);
+		if (!trial) return tuned;
+		std::vector<std::pair<int, double>> stepTimes;
+		double bestTime = std::numeric_limits<double>::max();
+		withThreads(trial, tuned.n_threads, [&]() {
+			timeForwardPasses(trial, model, tuned.n_ubatch, tuned.n_ubatch, 0);
+			for (int n_batch = tuned.n_ubatch; n_batch <= largest && !overBudget(); n_batch *= 2) {
+				const double seconds = timeForwardPasses(trial, model, largest, n_batch, 0).prefill_s;
+				if (seconds <= 0) continue;
+				stepTimes.emplace_back(n_batch, seconds);
+				bestTime = std::min(bestTime, seconds);
+			}
+		});
+		llama_free(trial);
+		for (const auto& [n_batch, seconds] : stepTimes) {
+			if (seconds <= bestTime * kAutotuneTolerance) {
+				tuned.n_batch = n_batch;
+				break;
+			}
+		}
+		return tuned;
+	}
 } // namespace
 
 // Define the Impl struct for the PIMPL pattern
@@ -2034,20 +7405,39 @@ struct InferenceEngine::Impl
 
 	// Job management members
 	std::atomic<int> nextJobId{ 0 };
-	std::unordered_map<int, std::shared_ptr<Job>> jobs;
-	std::mutex jobsMutex;
+	JobRegistry jobs;
+	JobPool jobPool{ 64 };
+
+	// Finished jobs nobody released are dropped this long after they finish
+	static constexpr std::chrono::minutes kFinishedJobTtl{ 5 };
+	static constexpr std::chrono::seconds kJobSweepInterval{ 30 };
+	std::atomic<int64_t> lastJobSweep{ 0 };
 
 	ThreadPool threadPool;
 
-	Impl(const char *modelPath, LoadingParameters lParams, const int mainGpuId = 0, bool isEmbeddingModel = false);
+	// Vocabulary access for tokenize()/countTokens(); shared with the inference service
+	std::shared_ptr<Tokenizer> tokenizer;
+
+	// Token counts by text hash; dropped wholesale once full
+	static constexpr size_t kTokenCountCacheEntries = 65536;
+	std::mutex tokenCountMutex;
+	std::unordered_map<uint64_t, int> tokenCounts;
+
+	// Huge pages requested at load, and where the memory they were applied to lives
+	std::string hugePagesRequested = "off";
+	std::string hugePageWeights = "none";
+	std::string weightsFile;
+	std::vector<AddressRange> bufferRanges;
+
+	Impl(const char *modelPath, LoadingParameters lParams, const int mainGpuId = 0, bool isEmbeddingModel = false,
+		std::atomic<float> *loadProgress = nullptr, bool isRerankModel = false);
 	~Impl();
 
 	// Inline method implementations to avoid scope resolution issues
 	int submitCompletionsJob(const CompletionParameters &params) {
 		int jobId = nextJobId++;
 
-		auto job = std::make_shared<Job>();
-		job->jobId = jobId;
+		auto job = jobPool.acquire(jobId);
 		job->seqId = params.seqId;
 		job->start_time = std::chrono::steady_clock::now();
 
@@ -2068,10 +7458,8 @@ struct InferenceEngine::Impl
 			return -1;
 		}
 
-		{
-			std::lock_guard<std::mutex> lock(jobsMutex);
-			jobs.emplace(jobId, job);
-		}
+		jobs.insert(jobId, job);
+		reclaimFinishedJobs();
 
 		return jobId;
 	}
@@ -2079,8 +7467,7 @@ struct InferenceEngine::Impl
 	int submitChatCompletionsJob(const ChatCompletionParameters &params) {
 		int jobId = nextJobId++;
 
-		auto job = std::make_shared<Job>();
-		job->jobId = jobId;
+		auto job = jobPool.acquire(jobId);
 		job->seqId = params.seqId;
 		job->start_time = std::chrono::steady_clock::now();
 
@@ -2109,19 +7496,80 @@ struct InferenceEngine::Impl
 			return -1;
 		}
 
-		{
-			std::lock_guard<std::mutex> lock(jobsMutex);
-			jobs.emplace(jobId, job);
-		}
+		jobs.insert(jobId, job);
+		reclaimFinishedJobs();
 
 		return jobId;
 	}
 
+	// Candidate i samples with randomSeed + i; all but the first wait to copy its prompt KV
+	std::vector<int> submitCompletionsJobs(const CompletionParameters &params, int n) {
+		std::vector<int> jobIds;
+		std::shared_ptr<Job> leader;
+		for (int i = 0; i < n; ++i) {
+			CompletionParameters candidate = params;
+			candidate.randomSeed = params.randomSeed + i;
+			if (i > 0) {
+				// a conversation's session belongs to one continuation
+				candidate.kvCacheFilePath.clear();
+				candidate.sessionKey.clear();
+				candidate.seqId = -1;
+			}
+
+			auto job = jobPool.acquire(nextJobId++);
+			job->seqId = candidate.seqId;
+			job->start_time = std::chrono::steady_clock::now();
+			if (leader) {
+				job->forkFrom = leader;
+				job->forkFromId = leader->jobId;
+			}
+			else {
+				leader = job;
+			}
+
+			try {
+				threadPool.enqueue([this, candidate, job]() {
+					try {
+						this->inferenceService->complete(candidate, job);
+					}
+					catch (const std::exception& e) {
+						std::lock_guard<std::mutex> lock(job->mtx);
+						job->hasError = true;
+						job->errorMessage = e.what();
+					}
+				});
+			}
+			catch (const std::exception& e) {
+				std::cerr << "[INFERENCE] [ERROR] [submitCompletionsJobs] " << e.what() << std::endl;
+				for (int jobId : jobIds) releaseJob(jobId);
+				return {};
+			}
+
+			jobs.insert(job->jobId, job);
+			jobIds.push_back(job->jobId);
+		}
+		reclaimFinishedJobs();
+
+		return jobIds;
+	}
+
+	std::vector<int> submitChatCompletionsJobs(const ChatCompletionParameters &params, int n) {
+		// the template is applied once, on the caller's thread
+		CompletionParameters formatted;
+		try {
+			formatted = this->inferenceService->formatChat(params);
+		}
+		catch (const std::exception& e) {
+			std::cerr << "[INFERENCE] [ERROR] [submitChatCompletionsJobs] " << e.what() << std::endl;
+			return {};
+		}
+		return submitCompletionsJobs(formatted, n);
+	}
+
 	int submitEmbeddingJob(const EmbeddingParameters &params) {
 		int jobId = nextJobId++;
 
-		auto job = std::make_shared<Job>();
-		job->jobId = jobId;
+		auto job = jobPool.acquire(jobId);
 		job->seqId = params.seqId;
 
 #ifdef DEBUG
@@ -2149,25 +7597,170 @@ struct InferenceEngine::Impl
 			return -1;
 		}
 
-		{
-			std::lock_guard<std::mutex> lock(jobsMutex);
-			jobs.emplace(jobId, job);
-		}
+		jobs.insert(jobId, job);
+		reclaimFinishedJobs();
 
 		return jobId;
 	}
 
+	std::vector<int32_t> tokenize(const std::string &text, bool addSpecial) {
+		if (!tokenizer) return {};
+		std::vector<llama_token> tokens = common_tokenize(tokenizer->getVocab(), text, addSpecial, true);
+		return std::vector<int32_t>(tokens.begin(), tokens.end());
+	}
+
+	std::vector<int> countTokens(const std::vector<std::string> &texts, bool addSpecial);
+
+	std::vector<EmbeddingResult> submitEmbeddingBatch(const std::vector<EmbeddingParameters> &params) {
+		// Batch jobs are owned by this call and never enter the job registry
+		std::vector<std::shared_ptr<Job>> batchJobs;
+		batchJobs.reserve(params.size());
+		for (const auto& p : params) {
+			auto job = jobPool.acquire(nextJobId++);
+			job->seqId = p.seqId;
+			batchJobs.push_back(job);
+		}
+
+		try {
+			inferenceService->embedBatch(params, batchJobs);
+		}
+		catch (const std::exception& e) {
+			std::cerr << "[INFERENCE] [ERROR] [submitEmbeddingBatch] " << e.what() << std::endl;
+			for (auto& job : batchJobs) {
+				std::lock_guard<std::mutex> lock(job->mtx);
+				job->hasError = true;
+				job->errorMessage = e.what();
+			}
+		}
+
+		std::vector<EmbeddingResult> results(batchJobs.size());
+		for (size_t i = 0; i < batchJobs.size(); ++i) {
+			auto& job = batchJobs[i];
+			std::unique_lock<std::mutex> jobLock(job->mtx);
+			job->cv.wait(jobLock, [&job]() { return job->isFinished || job->hasError; });
+			results[i].embedding	= std::move(job->embedding);
+			results[i].tokens_count	= job->embedding_token_count;
+			results[i].hasError		= job->hasError;
+			results[i].errorMessage	= job->errorMessage;
+		}
+
+		return results;
+	}
+
+	std::vector<RerankResult> rerank(const std::string &query, const std::vector<std::string> &documents, int topK) {
+		std::vector<EmbeddingParameters> params(documents.size());
+		for (size_t i = 0; i < documents.size(); ++i) {
+			params[i].input		= query;
+			params[i].document	= documents[i];
+			params[i].normalize	= false;
+		}
+
+		std::vector<EmbeddingResult> scored = submitEmbeddingBatch(params);
+		std::vector<RerankResult> results(scored.size());
+		for (size_t i = 0; i < scored.size(); ++i) {
+			if (scored[i].hasError || scored[i].embedding.empty()) {
+				throw std::runtime_error("Failed to score document " + std::to_string(i) + ": " + scored[i].errorMessage);
+			}
+			results[i].index = static_cast<int>(i);
+			results[i].score = scored[i].embedding[0];
+		}
+
+		// Only the returned head needs ordering
+		const size_t k = topK > 0 ? std::min(results.size(), static_cast<size_t>(topK)) : results.size();
+		std::partial_sort(results.begin(), results.begin() + k, results.end(),
+			[](const RerankResult &a, const RerankResult &b) { return a.score > b.score; });
+		results.resize(k);
+		return results;
+	}
+
 	void stopJob(int job_id);
+	void suspendJob(int job_id);
 	bool isJobFinished(int job_id);
 	CompletionResult getJobResult(int job_id);
+	bool waitForJobOutput(int job_id, CompletionDelta& delta, int timeoutMs);
+	CompletionDelta getJobResultSince(int job_id, JobOutputCursor& cursor);
 	EmbeddingResult getEmbeddingResult(int job_id);
-	void waitForJob(int job_id);
+	bool waitForJob(int job_id, int timeoutMs);
 	bool hasJobError(int job_id);
 	std::string getJobError(int job_id);
+	std::shared_ptr<const KvSequenceState> getJobKvState(int job_id);
 	bool hasActiveJobs();
+	KvCacheStats getKvCacheStats() const { return inferenceService ? inferenceService->kvCacheStats() : KvCacheStats(); }
+
+	// Advises THP for the weights mapping (unless it is on hugetlbfs) and the buffers created on
+	// load, then logs what was obtained. Other engines loading at the same time may have their
+	// buffers counted here too; advising them is harmless
+	void applyHugePages(const llama_model* model, const std::vector<MappedRegion>& before, uint64_t hugetlbPageSize, bool mapped)
+	{
+		const bool thp = transparentHugePagesAvailable();
+		if (!thp) {
+			std::cerr << "[INFERENCE] [WARNING] Transparent huge pages are disabled (/sys/kernel/mm/transparent_hugepage/enabled)"
+				<< std::endl;
+		}
+
+		const std::vector<MappedRegion> after = readMappings();
+		bufferRanges = newBufferRanges(before, after);
+		weightsFile = mapped ? ModelStore::instance().mappedFile(model) : std::string();
+		const bool onHugetlbfs = hugetlbPageSize > 0 && weightsFile.rfind(hugetlbfsMount(hugetlbPageSize) + "/", 0) == 0;
+
+		if (thp) {
+			for (const auto& range : bufferRanges) adviseHugePages(range);
+			if (!weightsFile.empty() && !onHugetlbfs) {
+				for (const auto& region : after) {
+					if (region.path == weightsFile) adviseHugePages(region.range);
+				}
+			}
+		}
+		hugePageWeights = onHugetlbfs ? (hugetlbPageSize == (1ull << 30) ? "hugetlbfs-1g" : "hugetlbfs-2m")
+			: thp && !weightsFile.empty() ? "thp" : "none";
+
+		const HugePageStats stats = getHugePageStats();
+		std::cout << "[INFERENCE] Huge pages (" << hugePagesRequested << "): weights " << hugePageWeights << ", "
+			<< (stats.weight_huge_bytes >> 20) << " of " << (stats.weight_bytes >> 20) << " MiB; buffers "
+			<< (stats.buffer_huge_bytes >> 20) << " of " << (stats.buffer_bytes >> 20) << " MiB" << std::endl;
+	}
+
+	HugePageStats getHugePageStats() const
+	{
+		HugePageStats stats;
+		stats.requested = hugePagesRequested;
+		stats.weights = hugePageWeights;
+		if (hugePagesRequested == "off") return stats;
+		HugePageUsage weights, buffers;
+		measureHugePages(weightsFile, bufferRanges, weights, buffers);
+		stats.weight_bytes		= weights.bytes;
+		stats.weight_huge_bytes	= weights.huge;
+		stats.buffer_bytes		= buffers.bytes;
+		stats.buffer_huge_bytes	= buffers.huge;
+		return stats;
+	}
+
+	std::vector<std::pair<std::string, std::shared_ptr<const KvSequenceState>>> exportSessions()
+	{
+		return inferenceService ? inferenceService->exportSessions() : std::vector<std::pair<std::string, std::shared_ptr<const KvSequenceState>>>();
+	}
+	bool importSession(const std::string& key, std::shared_ptr<const KvSequenceState> state)
+	{
+		return inferenceService && inferenceService->importSession(key, std::move(state));
+	}
+	bool precomputeChunk(const std::string& text) { return inferenceService && inferenceService->precomputeChunk(text); }
+
+	std::vector<ScoringResult> score(const std::vector<ScoringRequest>& requests, int topLogprobs) {
+		if (!inferenceService) throw std::runtime_error("Model not loaded");
+		return inferenceService->score(requests, topLogprobs);
+	}
+	DecodeStats getDecodeStats() { return inferenceService ? inferenceService->decodeStats() : DecodeStats(); }
+	std::vector<DecodeStepSample> getStepProfile() { return inferenceService ? inferenceService->stepProfile() : std::vector<DecodeStepSample>(); }
+	void beginStepCapture(size_t maxSteps) { if (inferenceService) inferenceService->beginStepCapture(maxSteps); }
+	std::vector<DecodeStepSample> endStepCapture() { return inferenceService ? inferenceService->endStepCapture() : std::vector<DecodeStepSample>(); }
+	void releaseJob(int job_id);
+	size_t liveJobCount();
+	EngineLoad getLoad();
+	void reclaimFinishedJobs();
 };
 
-InferenceEngine::Impl::Impl(const char *modelPath, const LoadingParameters lParams, const int mainGpuId, bool isEmbeddingModel)
+InferenceEngine::Impl::Impl(const char *modelPath, const LoadingParameters lParams, const int mainGpuId, bool isEmbeddingModel,
+	std::atomic<float> *loadProgress, bool isRerankModel)
 	: threadPool(lParams.n_parallel)
 {
 #ifndef DEBUG
@@ -2187,7 +7780,24 @@ InferenceEngine::Impl::Impl(const char *modelPath, const LoadingParameters lPara
 		throw std::runtime_error("[INFERENCE] [ERROR] Invalid model file extension. Expected .gguf, got: " + tokenizer_model_path.extension().string());
 	}
 
-	unsigned int inferenceThreads = 16;
+	// Cores this engine decodes on: an explicit list, a NUMA node, or a share picked by the backend manager
+	std::vector<int> engineCores;
+	if (!lParams.cpu_cores.empty() && !parseCoreList(lParams.cpu_cores, engineCores)) {
+		throw std::runtime_error("[INFERENCE] [ERROR] Invalid cpu_cores: " + lParams.cpu_cores);
+	}
+	if (engineCores.empty() && lParams.numa_node >= 0) {
+		engineCores = numaNodeCores(lParams.numa_node);
+		if (engineCores.empty()) {
+			std::cerr << "[INFERENCE] [WARNING] NUMA node " << lParams.numa_node
+					  << " not found, threads are not bound to it" << std::endl;
+		}
+	}
+
+	unsigned int inferenceThreads = lParams.n_threads > 0
+		? static_cast<unsigned int>(lParams.n_threads)
+		: !engineCores.empty()
+			? static_cast<unsigned int>(engineCores.size())
+			: std::min(16u, std::max(1u, std::thread::hardware_concurrency()));
 
 #ifdef DEBUG
 	std::cout << "[INFERENCE] Inference threads: " << inferenceThreads << std::endl;
@@ -2203,7 +7813,7 @@ InferenceEngine::Impl::Impl(const char *modelPath, const LoadingParameters lPara
 	params.use_mlock					= lParams.use_mlock;
 	params.use_mmap						= lParams.use_mmap;
 	params.cont_batching				= lParams.cont_batching;
-	params.warmup						= lParams.warmup;
+	params.warmup						= false;	// done below on the engine's own threadpool, also for reused weights
 	params.cpuparams.n_threads			= inferenceThreads;
 	params.n_parallel					= lParams.n_parallel;
 	params.n_batch						= lParams.n_batch;
@@ -2213,39 +7823,226 @@ InferenceEngine::Impl::Impl(const char *modelPath, const LoadingParameters lPara
 	params.compute_ppl					= false;
 	params.use_jinja					= true;
 	params.swa_full						= true;
+	if (isRerankModel)
+	{
+		// Cross-encoders score a pair through their classification head
+		params.embedding				= true;
+		params.pooling_type				= LLAMA_POOLING_TYPE_RANK;
+	}
+
+	// Extra sequences for the shared prompt-prefix cache and chunk splicing; copying cells between
+	// sequences requires them to live in one unified KV buffer
+	DecodeOptions decodeOptions;
+	decodeOptions.prefix_cache_slots	= isEmbeddingModel ? 0 : std::max(0, lParams.n_prefix_cache);
+	decodeOptions.step_tokens			= lParams.n_step_tokens;
+	decodeOptions.prefill_share			= lParams.prefill_share;
+	decodeOptions.slo_ttft_ms			= lParams.slo_ttft_ms;
+	decodeOptions.slo_tpot_ms			= lParams.slo_tpot_ms;
+	decodeOptions.profile_steps			= lParams.profile_steps;
+	decodeOptions.host_cache_bytes		= static_cast<size_t>(std::max(0, lParams.kv_host_cache_mb)) << 20;
+	decodeOptions.disk_cache_bytes		= static_cast<size_t>(std::max(0, lParams.kv_disk_cache_mb)) << 20;
+	decodeOptions.disk_cache_dir		= lParams.kv_disk_cache_dir.empty()
+		? std::filesystem::temp_directory_path() / "kolosal-kv"
+		: std::filesystem::path(lParams.kv_disk_cache_dir);
+	decodeOptions.prefix_cache_dir		= lParams.prefix_cache_dir;
+	decodeOptions.prefix_cache_save_seconds = lParams.prefix_cache_save_seconds;
+	decodeOptions.chunk_cache_bytes		= isEmbeddingModel ? 0 : static_cast<size_t>(std::max(0, lParams.chunk_cache_mb)) << 20;
+	decodeOptions.preempt_swap_bytes	= static_cast<size_t>(std::max(0, lParams.preempt_swap_mb)) << 20;
+	decodeOptions.kv_block_tokens		= isEmbeddingModel ? 0 : lParams.kv_block_tokens;
+	decodeOptions.max_seq_ctx			= lParams.max_seq_ctx;
+	if (decodeOptions.reservedSeqs() > 0) {
+		params.n_parallel				= lParams.n_parallel + decodeOptions.reservedSeqs();
+		params.kv_unified				= true;
+	}
+	// blocks are handed out of one shared buffer; split per sequence, each would get n_ctx / n_parallel
+	if (decodeOptions.kv_block_tokens > 0) {
+		params.kv_unified				= true;
+	}
+	// "auto" stays f16 unless fit_vram is allowed to quantize it
+	const bool autoCacheK = lParams.cache_type_k == "auto";
+	const bool autoCacheV = lParams.cache_type_v == "auto";
+	if (!autoCacheK && !parseCacheType(lParams.cache_type_k, params.cache_type_k)) {
+		throw std::runtime_error("[INFERENCE] [ERROR] Unsupported cache_type_k: " + lParams.cache_type_k);
+	}
+	if (!autoCacheV && !parseCacheType(lParams.cache_type_v, params.cache_type_v)) {
+		throw std::runtime_error("[INFERENCE] [ERROR] Unsupported cache_type_v: " + lParams.cache_type_v);
+	}
+	if (autoCacheK) params.cache_type_k = GGML_TYPE_F16;
+	if (autoCacheV) params.cache_type_v = GGML_TYPE_F16;
+
+	// Adapters are read on first use, so a bad name or path is reported now rather than per request
+	if (!isEmbeddingModel) {
+		std::unordered_set<std::string> loraNames;
+		for (const auto& adapter : lParams.lora_adapters) {
+			if (adapter.name.empty() || !loraNames.insert(adapter.name).second) {
+				throw std::runtime_error("[INFERENCE] [ERROR] LoRA adapter names must be unique and non-empty: '" + adapter.name + "'");
+			}
+			if (!std::filesystem::exists(adapter.path)) {
+				throw std::runtime_error("[INFERENCE] [ERROR] LoRA adapter '" + adapter.name + "' not found: " + adapter.path);
+			}
+		}
+		decodeOptions.lora_adapters		= lParams.lora_adapters;
+		decodeOptions.lora_max_loaded	= lParams.lora_max_loaded;
+	}
+
 #if defined(USE_CUDA) || defined(USE_VULKAN)
 	std::cout << "[INFERENCE] Using CUDA or Vulkan" << std::endl;
 
 	params.n_gpu_layers = lParams.n_gpu_layers;
+	params.split_mode	= static_cast<llama_split_mode>(lParams.split_mode);
+	if (mainGpuId >= 0) params.main_gpu = mainGpuId;
+	for (size_t i = 0; i < lParams.tensor_split.size() && i < 128; ++i) {
+		params.tensor_split[i] = lParams.tensor_split[i];
+	}
 #endif
 
 	// Note: flash_attn removed in newest llama.cpp (now automatic)
 
 #ifdef DEBUG
-	std::cout << "[INFERENCE] Using main GPU ID: " << params.main_gpu << std::endl;
+	std::cout << "[INFERENCE] Using main GPU ID: " << params.main_gpu << std::endl;
+#endif
+
+	BackendManager::instance().acquireBackend(params.numa);
+
+#if defined(USE_CUDA) || defined(USE_VULKAN)
+	// Replicas are spread over GPUs by id; wrap around when there are more replicas than GPUs
+	{
+		int gpuCount = 0;
+		for (size_t i = 0; i < ggml_backend_dev_count(); ++i) {
+			if (ggml_backend_dev_type(ggml_backend_dev_get(i)) == GGML_BACKEND_DEVICE_TYPE_GPU) ++gpuCount;
+		}
+		if (gpuCount > 0) params.main_gpu %= gpuCount;
+	}
+#endif
+
+#if defined(USE_CUDA) || defined(USE_VULKAN)
+	// MoE models: every layer goes to the GPU with its routed experts in host memory, which beats
+	// leaving whole layers on the CPU. The pattern must outlive the load
+	ExpertPlan expertPlan;
+	if (lParams.moe_offload == "all" || lParams.moe_offload == "auto") {
+		const size_t freeVram = lParams.moe_offload == "auto" ? freeDeviceMemory() : 0;
+		if (lParams.moe_offload == "all" || freeVram > 0) {
+			expertPlan = planExpertOffload(tokenizer_model_path, params, lParams.moe_offload == "auto", freeVram);
+		}
+		if (!expertPlan.pattern.empty()) {
+			params.n_gpu_layers = std::max(params.n_gpu_layers, expertPlan.n_layer + 1);
+			params.tensor_buft_overrides.push_back({ expertPlan.pattern.c_str(), ggml_backend_cpu_buffer_type() });
+			params.tensor_buft_overrides.push_back({ nullptr, nullptr });
+			std::cout << "[INFERENCE] Experts of " << expertPlan.hostLayers << "/" << expertPlan.n_layer
+				<< " layers stay in host memory (" << static_cast<size_t>(expertPlan.hostBytes / (1 << 20)) << " MiB), "
+				<< "all other weights on the GPU" << std::endl;
+		}
+		else if (expertPlan.n_layer > 0) {
+			std::cout << "[INFERENCE] moe_offload: " << (expertPlan.expertBytes > 0.0
+				? "every expert fits in VRAM, nothing to move" : "not a mixture-of-experts model, ignored") << std::endl;
+		}
+	}
+
+	if (lParams.fit_vram && !expertPlan.pattern.empty()) {
+		std::cout << "[INFERENCE] fit_vram skipped: moe_offload already planned the device memory" << std::endl;
+	}
+	else if (lParams.fit_vram) {
+		const size_t freeVram = freeDeviceMemory();
+		if (freeVram > 0) {
+			MemoryPlan plan{ params.n_ctx, params.n_gpu_layers, params.cache_type_k, params.cache_type_v };
+			plan = fitToDeviceMemory(tokenizer_model_path, plan, params.n_parallel, params.n_ubatch,
+				autoCacheK, autoCacheV, freeVram);
+			params.n_ctx		= plan.n_ctx;
+			params.n_gpu_layers	= plan.n_gpu_layers;
+			params.cache_type_k	= plan.type_k;
+			params.cache_type_v	= plan.type_v;
+			std::cout << "[INFERENCE] Fitted to " << (freeVram >> 20) << " MiB free VRAM: n_ctx=" << params.n_ctx
+				<< ", n_gpu_layers=" << params.n_gpu_layers
+				<< ", cache_type_k=" << ggml_type_name(params.cache_type_k)
+				<< ", cache_type_v=" << ggml_type_name(params.cache_type_v) << std::endl;
+		}
+	}
+
+	// An explicit tensor_split is used as given; otherwise it is planned from the devices' free memory
+	if (lParams.tensor_split.empty()) {
+		planGpuSplit(tokenizer_model_path, params, mainGpuId < 0);
+	}
+#endif
+
+	// Settings tuned by an earlier load on this host apply before the context is created; without
+	// them, tuning runs once the weights are loaded and the lock is held until its result is stored
+	std::unique_lock<std::mutex> autotuneLock;
+	std::filesystem::path autotuneFile;
+	std::string autotuneCacheKey;
+	auto applyTuned = [&](const TunedSettings& tuned) {
+		if (lParams.n_threads <= 0) inferenceThreads = static_cast<unsigned int>(tuned.n_threads);
+		if (!isEmbeddingModel) {
+			params.n_batch	= tuned.n_batch;
+			params.n_ubatch	= tuned.n_ubatch;
+		}
+		params.cpuparams.n_threads = static_cast<int>(inferenceThreads);
+		std::cout << "[INFERENCE] Tuned for this host: n_threads=" << inferenceThreads
+			<< ", n_batch=" << params.n_batch << ", n_ubatch=" << params.n_ubatch << std::endl;
+	};
+	if (lParams.autotune) {
+		autotuneLock = std::unique_lock<std::mutex>(autotuneMutex());
+		autotuneFile = lParams.autotune_cache.empty()
+			? std::filesystem::temp_directory_path() / "kolosal-autotune.json"
+			: std::filesystem::path(lParams.autotune_cache);
+		autotuneCacheKey = autotuneKey(tokenizer_model_path, params, engineCores.size(), lParams.n_threads, isEmbeddingModel);
+		TunedSettings cached;
+		if (readTunedSettings(autotuneFile, autotuneCacheKey, cached)) {
+			applyTuned(cached);
+			autotuneLock.unlock();
+		}
+	}
+
+#ifdef DEBUG
+	std::cout << "[INFERENCE] Loading model from " << tokenizer_model_path << std::endl;
 #endif
 
-	llama_backend_init();
-	llama_numa_init(params.numa);
+	// Progress: prefetch up to 40%, weight loading up to 90%, warmup the rest
+	const float loadStart = lParams.use_mmap && lParams.prefetch_weights ? 0.4f : 0.0f;
+	if (loadStart > 0.0f) {
+		prefetchFile(tokenizer_model_path, loadProgress, 0.0f, loadStart);
+	}
+	struct LoadProgress { std::atomic<float>* out; float from; } loadRange{ loadProgress, loadStart };
+	if (loadProgress) {
+		params.load_progress_callback = [](float progress, void* user) {
+			auto* range = static_cast<LoadProgress*>(user);
+			range->out->store(range->from + (0.9f - range->from) * progress);
+			return true;
+		};
+		params.load_progress_callback_user_data = &loadRange;
+	}
 
-#ifdef DEBUG
-	std::cout << "[INFERENCE] Loading model from " << tokenizer_model_path << std::endl;
+	// 2m / 1g put mapped weights on hugetlbfs; every mode advises THP for what llama.cpp allocates
+	uint64_t hugetlbPageSize = 0;
+	std::vector<MappedRegion> mappingsBefore;
+	if (lParams.huge_pages == "thp" || lParams.huge_pages == "2m" || lParams.huge_pages == "1g") {
+#ifdef __linux__
+		hugePagesRequested = lParams.huge_pages;
+		hugetlbPageSize = lParams.huge_pages == "2m" ? (2ull << 20) : lParams.huge_pages == "1g" ? (1ull << 30) : 0;
+		mappingsBefore = readMappings();
+#else
+		std::cerr << "[INFERENCE] [WARNING] huge_pages is only supported on Linux, using regular pages" << std::endl;
 #endif
+	}
+	else if (lParams.huge_pages != "off") {
+		std::cerr << "[INFERENCE] [WARNING] Unknown huge_pages mode '" << lParams.huge_pages
+			<< "', using regular pages" << std::endl;
+	}
 
-	// common_init_from_params returns common_init_result with model/context as unique_ptr members
-	auto llama_init = common_init_from_params(params);
-	// Release ownership from unique_ptrs - we'll manage the lifetime manually
-	// Using .release() transfers ownership to us and prevents auto-deletion when llama_init goes out of scope
-	llama_model		*model	= llama_init.model.release();
-	llama_context	*ctx	= llama_init.context.release();
+	// Weights already loaded by another engine with the same placement are reused; the model
+	// is handed back through ModelStore::release() by whoever ends up owning it
+	llama_context	*ctx	= nullptr;
+	llama_model		*model	= ModelStore::instance().open(params, ctx, hugetlbPageSize,
+		static_cast<uint64_t>(std::max(0, lParams.repack_cache_mb)) << 20);
 
 	// Validate model and context initialization
 	if (!model) {
+		BackendManager::instance().releaseBackend();
 		throw std::runtime_error("[INFERENCE] [ERROR] Failed to load model - model is null");
 	}
 	
 	if (!ctx) {
-		llama_model_free(model);
+		ModelStore::instance().release(model);
+		BackendManager::instance().releaseBackend();
 		throw std::runtime_error("[INFERENCE] [ERROR] Failed to create context - context is null");
 	}
 	
@@ -2257,7 +8054,8 @@ InferenceEngine::Impl::Impl(const char *modelPath, const LoadingParameters lPara
 	
 	if (n_vocab <= 0 || n_embd <= 0 || n_ctx_train <= 0) {
 		llama_free(ctx);
-		llama_model_free(model);
+		ModelStore::instance().release(model);
+		BackendManager::instance().releaseBackend();
 		throw std::runtime_error("[INFERENCE] [ERROR] Invalid model dimensions - vocab:" + 
 			std::to_string(n_vocab) + " embd:" + std::to_string(n_embd) + 
 			" ctx_train:" + std::to_string(n_ctx_train));
@@ -2271,25 +8069,137 @@ InferenceEngine::Impl::Impl(const char *modelPath, const LoadingParameters lPara
 		// Note: This might require recreating the context with adjusted parameters
 	}
 
+	if (autotuneLock.owns_lock()) {
+		std::cout << "[INFERENCE] Autotuning " << tokenizer_model_path.filename().string()
+			<< " for this host (cached in " << autotuneFile.string() << ")" << std::endl;
+		const int configuredBatch = params.n_batch, configuredUbatch = params.n_ubatch;
+		const TunedSettings tuned = autotuneEngine(model, ctx, params, engineCores, lParams.n_threads <= 0, !isEmbeddingModel,
+			lParams.fit_vram ? params.n_ubatch : 0);
+		applyTuned(tuned);
+		llama_set_n_threads(ctx, params.cpuparams.n_threads, params.cpuparams.n_threads);
+
+		// The batch sizes are fixed when a context is created
+		if (params.n_batch != configuredBatch || params.n_ubatch != configuredUbatch) {
+			llama_free(ctx);
+			ctx = llama_init_from_model(model, common_context_params_to_llama(params));
+			if (!ctx) {
+				std::cerr << "[INFERENCE] [WARNING] Cannot create a context with the tuned batch sizes, keeping the configured ones" << std::endl;
+				params.n_batch	= configuredBatch;
+				params.n_ubatch	= configuredUbatch;
+				ctx = llama_init_from_model(model, common_context_params_to_llama(params));
+			}
+			if (!ctx) {
+				ModelStore::instance().release(model);
+				BackendManager::instance().releaseBackend();
+				throw std::runtime_error("[INFERENCE] [ERROR] Failed to create context - context is null");
+			}
+		}
+		writeTunedSettings(autotuneFile, autotuneCacheKey,
+			TunedSettings{ static_cast<int>(inferenceThreads), params.n_batch, params.n_ubatch },
+			tokenizer_model_path.filename().string());
+		autotuneLock.unlock();
+	}
+
+	if (hugePagesRequested != "off") {
+		applyHugePages(model, mappingsBefore, hugetlbPageSize, params.use_mmap);
+	}
+
+	// Recurrent state cannot be copied or shifted for a partial range, so the reserved sequences stay unused
+	if (decodeOptions.reservedSeqs() > 0 && llama_model_is_recurrent(model)) {
+		decodeOptions.prefix_cache_slots = 0;
+		decodeOptions.chunk_cache_bytes = 0;
+		params.n_parallel = lParams.n_parallel;
+	}
+
 #ifdef DEBUG
 	std::cout << "[INFERENCE] Model validation successful - vocab:" << n_vocab 
 		<< " embd:" << n_embd << " ctx_train:" << n_ctx_train << std::endl;
 #endif
 
-	struct ggml_threadpool_params threadpool_params;
-	ggml_threadpool_params_init(&threadpool_params, inferenceThreads);
-	threadpool_params.prio = GGML_SCHED_PRIO_NORMAL;
 	set_process_priority(GGML_SCHED_PRIO_NORMAL);
-	struct ggml_threadpool* threadpool = ggml_threadpool_new(&threadpool_params);
+
+	// An embedding engine may decode on several contexts, each with its share of the threads and pinned cores
+	const int lanes = isEmbeddingModel ? std::clamp(lParams.embedding_contexts, 1, static_cast<int>(std::max(1u, inferenceThreads))) : 1;
+	const int laneThreads = static_cast<int>(std::max(1u, inferenceThreads / static_cast<unsigned int>(lanes)));
+	const auto laneCores = [&engineCores, lanes](int lane) {
+		const size_t per = engineCores.size() / static_cast<size_t>(lanes);
+		return per == 0 ? engineCores
+			: std::vector<int>(engineCores.begin() + lane * per, engineCores.begin() + (lane + 1) * per);
+	};
+	if (lanes > 1) {
+		llama_set_n_threads(ctx, laneThreads, laneThreads);
+		std::cout << "[INFERENCE] Embedding contexts: " << lanes << " with " << laneThreads << " threads each" << std::endl;
+	}
+	struct ggml_threadpool* threadpool = BackendManager::instance().acquireThreadpool(lanes > 1 ? laneThreads : inferenceThreads,
+		lanes > 1 ? laneCores(0) : engineCores);
+	if (!threadpool) {
+		llama_free(ctx);
+		ModelStore::instance().release(model);
+		BackendManager::instance().releaseBackend();
+		throw std::runtime_error("[INFERENCE] [ERROR] Failed to create CPU threadpool.");
+	}
 	llama_attach_threadpool(ctx, threadpool, nullptr);
+	if (loadProgress) loadProgress->store(0.9f);
+
+	if (lParams.warmup) {
+		warmupContext(ctx, model, params.n_batch);
+	}
+
+	// Rejected drafts are dropped from the KV by position, which recurrent state does not support
+	decodeOptions.n_draft		= llama_model_is_recurrent(model) ? 0 : lParams.n_draft;
+	decodeOptions.prompt_lookup	= lParams.prompt_lookup;
+
+	// Saved prefixes only fit the weights that computed them: name them after the model file and its size
+	if (!lParams.prefix_cache_dir.empty()) {
+		const std::string identity = std::filesystem::path(modelPath).filename().string() + '\0'
+			+ std::to_string(llama_model_size(model)) + '\0' + std::to_string(llama_model_n_params(model));
+		std::ostringstream tag;
+		tag << std::hex << std::hash<std::string>{}(identity);
+		decodeOptions.prefix_cache_tag = tag.str();
+	}
+
+	// Optional draft model for speculative decoding; it must share the target's vocabulary
+	if (!isEmbeddingModel && !lParams.draft_model_path.empty()) {
+		common_params draftParams = params;
+		draftParams.model.path = lParams.draft_model_path;
+		draftParams.n_parallel = lParams.n_parallel;
+		draftParams.kv_unified = true;
+		draftParams.load_progress_callback = nullptr;
+
+		llama_context	*draftCtx	= nullptr;
+		llama_model		*draftModel	= ModelStore::instance().open(draftParams, draftCtx);
+
+		const llama_vocab *draftVocab = draftModel ? llama_model_get_vocab(draftModel) : nullptr;
+		if (!draftModel || !draftCtx) {
+			std::cerr << "[INFERENCE] [WARNING] Failed to load draft model " << lParams.draft_model_path
+				<< ", speculative decoding disabled" << std::endl;
+		}
+		else if (llama_vocab_type(draftVocab) != llama_vocab_type(vocab)
+			|| std::abs(llama_vocab_n_tokens(draftVocab) - n_vocab) > 128
+			|| llama_vocab_bos(draftVocab) != llama_vocab_bos(vocab)
+			|| llama_vocab_eos(draftVocab) != llama_vocab_eos(vocab)) {
+			std::cerr << "[INFERENCE] [WARNING] Draft model " << lParams.draft_model_path
+				<< " does not share the target vocabulary, speculative decoding disabled" << std::endl;
+		}
+		else {
+			llama_attach_threadpool(draftCtx, threadpool, nullptr);
+			decodeOptions.draft_model	= draftModel;
+			decodeOptions.draft_context	= draftCtx;
+			draftModel	= nullptr;
+			draftCtx	= nullptr;
+		}
+		if (draftCtx) llama_free(draftCtx);
+		if (draftModel) ModelStore::instance().release(draftModel);
+	}
 
 	// Create the tokenizer
 	auto tokenizer = std::make_shared<Tokenizer>(model, ctx, params);
 	if (!tokenizer)
 	{
-		ggml_threadpool_free(threadpool);
+		BackendManager::instance().releaseThreadpool(threadpool);
 		llama_free(ctx);
-		llama_model_free(model);
+		ModelStore::instance().release(model);
+		BackendManager::instance().releaseBackend();
 		throw std::runtime_error("[INFERENCE] [ERROR] Failed to create tokenizer.");
 	}
 	// Create the inference service
@@ -2299,34 +8209,104 @@ InferenceEngine::Impl::Impl(const char *modelPath, const LoadingParameters lPara
 		{
 			// For embedding models, use the specialized embedding service
 			params.embedding = true;
-			inferenceService = std::make_unique<EmbeddingInferenceService>(tokenizer, model, ctx, params, threadpool);
+			std::vector<EmbeddingInferenceService::LaneContext> contexts{ { ctx, threadpool } };
+			for (int lane = 1; lane < lanes; ++lane) {
+				llama_context *laneCtx = llama_init_from_model(model, common_context_params_to_llama(params));
+				ggml_threadpool *lanePool = laneCtx ? BackendManager::instance().acquireThreadpool(laneThreads, laneCores(lane)) : nullptr;
+				if (!lanePool) {
+					if (laneCtx) llama_free(laneCtx);
+					std::cerr << "[INFERENCE] [WARNING] Could not create embedding context " << lane + 1 << " of " << lanes
+						<< ", decoding on " << contexts.size() << std::endl;
+					break;
+				}
+				llama_set_n_threads(laneCtx, laneThreads, laneThreads);
+				llama_attach_threadpool(laneCtx, lanePool, nullptr);
+				if (lParams.warmup) {
+					warmupContext(laneCtx, model, params.n_batch);
+				}
+				contexts.push_back({ laneCtx, lanePool });
+			}
+			inferenceService = std::make_unique<EmbeddingInferenceService>(tokenizer, model, contexts, params,
+				std::chrono::microseconds(lParams.embedding_batch_window_us));
 		}
 		else
 		{
 			// For LLM models, use the regular inference service
-			inferenceService = std::make_unique<LlamaInferenceService>(tokenizer, model, ctx, params, threadpool);
+			inferenceService = std::make_unique<LlamaInferenceService>(tokenizer, model, ctx, params, threadpool, decodeOptions);
 		}
 	}
 	catch (const std::exception &e)
 	{
-		ggml_threadpool_free(threadpool);
+		if (decodeOptions.draft_context) llama_free(decodeOptions.draft_context);
+		if (decodeOptions.draft_model) ModelStore::instance().release(decodeOptions.draft_model);
+		BackendManager::instance().releaseThreadpool(threadpool);
 		llama_free(ctx);
-		llama_model_free(model);
+		ModelStore::instance().release(model);
+		BackendManager::instance().releaseBackend();
 		throw std::runtime_error("[INFERENCE] [ERROR] Failed to create inference service: " + std::string(e.what()));
 	}
+	this->tokenizer = std::move(tokenizer);
 }
 
-void InferenceEngine::Impl::stopJob(int job_id)
+std::vector<int> InferenceEngine::Impl::countTokens(const std::vector<std::string> &texts, bool addSpecial)
 {
-	std::shared_ptr<Job> jobToStop;
+	std::vector<int> counts(texts.size(), -1);
+	if (!tokenizer)
+	{
+		return counts;
+	}
 
+	auto keyOf = [addSpecial](const std::string &text) {
+		uint64_t key = static_cast<uint64_t>(std::hash<std::string>{}(text));
+		key ^= (static_cast<uint64_t>(text.size()) << 1 | (addSpecial ? 1u : 0u)) * 0x9E3779B97F4A7C15ULL;
+		return key;
+	};
+
+	std::vector<size_t> misses;
 	{
-		std::lock_guard<std::mutex> lock(jobsMutex);
-		auto it = jobs.find(job_id);
-		if (it == jobs.end()) {
-			return;  // Job not found
+		std::lock_guard<std::mutex> lock(tokenCountMutex);
+		for (size_t i = 0; i < texts.size(); ++i)
+		{
+			auto it = tokenCounts.find(keyOf(texts[i]));
+			if (it != tokenCounts.end())
+				counts[i] = it->second;
+			else
+				misses.push_back(i);
 		}
-		jobToStop = it->second;
+	}
+	if (misses.empty())
+	{
+		return counts;
+	}
+
+	// With no output buffer llama_tokenize returns minus the token count, so nothing is allocated
+	const llama_vocab *vocab = tokenizer->getVocab();
+	for (size_t i : misses)
+	{
+		const std::string &text = texts[i];
+		const int32_t n = llama_tokenize(vocab, text.data(), static_cast<int32_t>(text.size()), nullptr, 0, addSpecial, true);
+		counts[i] = n == std::numeric_limits<int32_t>::min() ? -1 : std::abs(n);
+	}
+
+	std::lock_guard<std::mutex> lock(tokenCountMutex);
+	if (tokenCounts.size() + misses.size() > kTokenCountCacheEntries)
+	{
+		tokenCounts.clear();
+	}
+	for (size_t i : misses)
+	{
+		if (counts[i] >= 0)
+			tokenCounts[keyOf(texts[i])] = counts[i];
+	}
+	return counts;
+}
+
+void InferenceEngine::Impl::stopJob(int job_id)
+{
+	std::shared_ptr<Job> jobToStop = jobs.find(job_id);
+	if (!jobToStop)
+	{
+		return;  // Job not found
 	}
 
 	jobToStop->cancelRequested.store(true);
@@ -2337,19 +8317,26 @@ void InferenceEngine::Impl::stopJob(int job_id)
 	}
 }
 
-bool InferenceEngine::Impl::isJobFinished(int job_id)
+void InferenceEngine::Impl::suspendJob(int job_id)
 {
-	std::shared_ptr<Job> job;
+	std::shared_ptr<Job> jobToSuspend = jobs.find(job_id);
+	if (!jobToSuspend)
+	{
+		return;
+	}
+
+	// The decode loop sees suspendRequested before it acts on the cancellation
+	jobToSuspend->suspendRequested.store(true);
+	stopJob(job_id);
+}
 
+bool InferenceEngine::Impl::isJobFinished(int job_id)
+{
+	std::shared_ptr<Job> job = jobs.find(job_id);
+	if (!job)
 	{
-		std::lock_guard<std::mutex> lock(jobsMutex);
-		auto it = jobs.find(job_id);
-		if (it == jobs.end())
-		{
-			std::cerr << "[INFERENCE] [ERROR] [isJobFinished] Invalid job ID: " << job_id << "\n" << std::endl;
-			return true;
-		}
-		job = it->second;
+		std::cerr << "[INFERENCE] [ERROR] [isJobFinished] Invalid job ID: " << job_id << "\n" << std::endl;
+		return true;
 	}
 
 	std::lock_guard<std::mutex> jobLock(job->mtx);
@@ -2363,22 +8350,16 @@ bool InferenceEngine::Impl::isJobFinished(int job_id)
 
 CompletionResult InferenceEngine::Impl::getJobResult(int job_id)
 {
-	std::shared_ptr<Job> job;
-
+	std::shared_ptr<Job> job = jobs.find(job_id);
+	if (!job)
 	{
-		std::lock_guard<std::mutex> lock(jobsMutex);
-		auto it = jobs.find(job_id);
-		if (it == jobs.end()) 
-		{
-			std::cerr << "[INFERENCE] [ERROR] [getJobResult] Invalid job ID " << job_id << "\n" << std::endl;
-			CompletionResult result;
-			result.tokens = {};
-			result.text = "";
-			result.tps = 0.0F;
-			result.ttft = 0.0F;
-			return result;
-		}
-		job = it->second;
+		std::cerr << "[INFERENCE] [ERROR] [getJobResult] Invalid job ID " << job_id << "\n" << std::endl;
+		CompletionResult result;
+		result.tokens = {};
+		result.text = "";
+		result.tps = 0.0F;
+		result.ttft = 0.0F;
+		return result;
 	}
 
 	std::lock_guard<std::mutex> jobLock(job->mtx);
@@ -2388,25 +8369,114 @@ CompletionResult InferenceEngine::Impl::getJobResult(int job_id)
 	result.tps = job->tps;
 	result.ttft = job->ttft;
 	result.prompt_token_count = job->n_prompt;
+	result.draft_token_count = job->draftTokenCount;
+	result.draft_accepted_count = job->draftAcceptedCount;
+	result.draft_acceptance_rate = job->draftTokenCount > 0
+		? static_cast<float>(job->draftAcceptedCount) / static_cast<float>(job->draftTokenCount)
+		: 0.0f;
+	result.timing = job->timing;
+	result.logprob = job->logprob;
+	result.suspended = job->suspended;
 	return result;
 }
 
-EmbeddingResult InferenceEngine::Impl::getEmbeddingResult(int job_id)
+bool InferenceEngine::Impl::waitForJobOutput(int job_id, CompletionDelta& delta, int timeoutMs)
 {
-	std::shared_ptr<Job> job;
+	std::shared_ptr<Job> job = jobs.find(job_id);
+	if (!job)
+	{
+		std::cerr << "[INFERENCE] [ERROR] [waitForJobOutput] Invalid job ID " << job_id << "\n" << std::endl;
+		return false;
+	}
+
+	std::unique_lock<std::mutex> jobLock(job->mtx);
 
+	// First call: everything generated so far becomes pending, later tokens are queued as they arrive
+	if (!job->outputSubscribed)
 	{
-		std::lock_guard<std::mutex> lock(jobsMutex);
-		auto it = jobs.find(job_id);
-		if (it == jobs.end())
-		{
-			std::cerr << "[INFERENCE] [ERROR] [getEmbeddingResult] Invalid job ID " << job_id << "\n"
-					  << std::endl;
-			EmbeddingResult result;
-			result.embedding = {};
-			return result;
-		}
-		job = it->second;
+		job->outputSubscribed = true;
+		job->pendingTokens = job->generatedTokens;
+		job->pendingText = job->generatedText.substr(0, job->publishedTextBytes);
+	}
+
+	auto ready = [&job]() { return !job->pendingText.empty() || !job->pendingTokens.empty() || job->isFinished || job->hasError; };
+	if (timeoutMs < 0)
+	{
+		job->cv.wait(jobLock, ready);
+	}
+	else
+	{
+		job->cv.wait_for(jobLock, std::chrono::milliseconds(timeoutMs), ready);
+	}
+
+	// Text held back for a possible stop sequence is final once the job is
+	if ((job->isFinished || job->hasError) && job->publishedTextBytes < job->generatedText.size())
+	{
+		job->pendingText.append(job->generatedText, job->publishedTextBytes, std::string::npos);
+		job->publishedTextBytes = job->generatedText.size();
+	}
+
+	delta.tokens.clear();
+	delta.text.clear();
+	delta.tokens.swap(job->pendingTokens);
+	delta.text.swap(job->pendingText);
+	delta.tps = job->tps;
+	delta.ttft = job->ttft;
+	delta.prompt_token_count = job->n_prompt;
+	delta.finished = job->isFinished || job->hasError;
+	delta.suspended = job->suspended;
+	delta.hasError = job->hasError;
+	delta.errorMessage = job->hasError ? job->errorMessage : std::string();
+	return true;
+}
+
+CompletionDelta InferenceEngine::Impl::getJobResultSince(int job_id, JobOutputCursor& cursor)
+{
+	std::shared_ptr<Job> job = jobs.find(job_id);
+	CompletionDelta delta;
+	if (!job)
+	{
+		std::cerr << "[INFERENCE] [ERROR] [getJobResultSince] Invalid job ID " << job_id << "\n" << std::endl;
+		delta.finished = true;
+		delta.hasError = true;
+		delta.errorMessage = "Invalid job ID";
+		return delta;
+	}
+
+	std::lock_guard<std::mutex> jobLock(job->mtx);
+
+	// Output is reset if the job restarts; never read past what exists, nor into
+	// text still held back for a possible stop sequence
+	const bool done = job->isFinished || job->hasError;
+	const size_t textEnd = done ? job->generatedText.size() : std::min(job->publishedTextBytes, job->generatedText.size());
+	cursor.tokens = std::min(cursor.tokens, job->generatedTokens.size());
+	cursor.textBytes = std::min(cursor.textBytes, textEnd);
+
+	delta.tokens.assign(job->generatedTokens.begin() + static_cast<std::ptrdiff_t>(cursor.tokens), job->generatedTokens.end());
+	delta.text.assign(job->generatedText, cursor.textBytes, textEnd - cursor.textBytes);
+	cursor.tokens = job->generatedTokens.size();
+	cursor.textBytes = textEnd;
+
+	delta.tps = job->tps;
+	delta.ttft = job->ttft;
+	delta.prompt_token_count = job->n_prompt;
+	delta.finished = done;
+	delta.suspended = job->suspended;
+	delta.hasError = job->hasError;
+	delta.errorMessage = job->hasError ? job->errorMessage : std::string();
+	return delta;
+}
+
+EmbeddingResult InferenceEngine::Impl::getEmbeddingResult(int job_id)
+{
+	std::shared_ptr<Job> job = jobs.find(job_id);
+	if (!job)
+	{
+		std::cerr << "[INFERENCE] [ERROR] [getEmbeddingResult] Invalid job ID " << job_id << "\n"
+				  << std::endl;
+		EmbeddingResult result;
+		result.embedding = {};
+		return result;
 	}
 
 	std::lock_guard<std::mutex> jobLock(job->mtx);
@@ -2415,46 +8485,37 @@ EmbeddingResult InferenceEngine::Impl::getEmbeddingResult(int job_id)
 	result.tokens_count = job->embedding_token_count;
 	
 	// Clean up the job after getting the result
-	{
-		std::lock_guard<std::mutex> lock(jobsMutex);
-		jobs.erase(job_id);
-	}
+	jobs.erase(job_id);
 	
 	return result;
 }
 
-void InferenceEngine::Impl::waitForJob(int job_id)
+bool InferenceEngine::Impl::waitForJob(int job_id, int timeoutMs)
 {
-	std::shared_ptr<Job> job;
-
+	std::shared_ptr<Job> job = jobs.find(job_id);
+	if (!job)
 	{
-		std::lock_guard<std::mutex> lock(jobsMutex);
-		auto it = jobs.find(job_id);
-		if (it == jobs.end()) 
-		{
-			std::cerr << "[INFERENCE] [ERROR] [waitForJob] Invalid job ID " << job_id << "\n";
-			return;
-		}
-		job = it->second;
+		std::cerr << "[INFERENCE] [ERROR] [waitForJob] Invalid job ID " << job_id << "\n";
+		return true;
 	}
 
 	std::unique_lock<std::mutex> jobLock(job->mtx);
-	job->cv.wait(jobLock, [&job]() { return job->isFinished || job->hasError; });
+	auto done = [&job]() { return job->isFinished || job->hasError; };
+	if (timeoutMs < 0)
+	{
+		job->cv.wait(jobLock, done);
+		return true;
+	}
+	return job->cv.wait_for(jobLock, std::chrono::milliseconds(timeoutMs), done);
 }
 
 bool InferenceEngine::Impl::hasJobError(int job_id)
 {
-	std::shared_ptr<Job> job;
-
+	std::shared_ptr<Job> job = jobs.find(job_id);
+	if (!job)
 	{
-		std::lock_guard<std::mutex> lock(jobsMutex);
-		auto it = jobs.find(job_id);
-		if (it == jobs.end()) 
-		{
-			std::cerr << "[INFERENCE] [ERROR] [hasJobError] Invalid job ID " << job_id << "\n" << std::endl;
-			return false;
-		}
-		job = it->second;
+		std::cerr << "[INFERENCE] [ERROR] [hasJobError] Invalid job ID " << job_id << "\n" << std::endl;
+		return false;
 	}
 
 	std::lock_guard<std::mutex> jobLock(job->mtx);
@@ -2463,44 +8524,121 @@ bool InferenceEngine::Impl::hasJobError(int job_id)
 
 std::string InferenceEngine::Impl::getJobError(int job_id)
 {
-	std::shared_ptr<Job> job;
-
+	std::shared_ptr<Job> job = jobs.find(job_id);
+	if (!job)
 	{
-		std::lock_guard<std::mutex> lock(jobsMutex);
-		auto it = jobs.find(job_id);
-		if (it == jobs.end()) 
-		{
-			std::cerr << "[INFERENCE] [ERROR] [getJobError] Invalid job ID " << job_id << "\n" << std::endl;
-			return "";
-		}
-		job = it->second;
+		std::cerr << "[INFERENCE] [ERROR] [getJobError] Invalid job ID " << job_id << "\n" << std::endl;
+		return "";
 	}
 
 	std::lock_guard<std::mutex> jobLock(job->mtx);
 	return job->errorMessage;
 }
 
+std::shared_ptr<const KvSequenceState> InferenceEngine::Impl::getJobKvState(int job_id)
+{
+	std::shared_ptr<Job> job = jobs.find(job_id);
+	if (!job)
+	{
+		std::cerr << "[INFERENCE] [ERROR] [getJobKvState] Invalid job ID " << job_id << "\n" << std::endl;
+		return nullptr;
+	}
+
+	std::lock_guard<std::mutex> jobLock(job->mtx);
+	std::shared_ptr<const KvSequenceState> state = std::move(job->kv_export);
+	job->kv_export.reset();
+	return state;
+}
+
 bool InferenceEngine::Impl::hasActiveJobs()
 {
-	std::lock_guard<std::mutex> lock(jobsMutex);
-	
-	for (const auto& [jobId, job] : jobs) {
+	// Polled periodically by the node manager, so idle engines still get swept
+	reclaimFinishedJobs();
+
+	return jobs.any([](const std::shared_ptr<Job>& job) {
 		std::lock_guard<std::mutex> jobLock(job->mtx);
-		if (!job->isFinished && !job->hasError) {
-			return true;
-		}
+		return !job->isFinished && !job->hasError;
+	});
+}
+
+void InferenceEngine::Impl::releaseJob(int job_id)
+{
+	std::shared_ptr<Job> job = jobs.find(job_id);
+	if (!job)
+	{
+		return;
 	}
-	
-	return false;
+
+	// Nobody can read the output any more, so do not keep generating it
+	job->cancelRequested.store(true);
+	{
+		std::lock_guard<std::mutex> jobLock(job->mtx);
+		job->cv.notify_all();
+	}
+
+	jobs.erase(job_id);
+}
+
+size_t InferenceEngine::Impl::liveJobCount()
+{
+	return jobs.size();
+}
+
+EngineLoad InferenceEngine::Impl::getLoad()
+{
+	EngineLoad load;
+	jobs.forEach([&load](const std::shared_ptr<Job>& job) {
+		std::lock_guard<std::mutex> jobLock(job->mtx);
+		if (job->isFinished || job->hasError) return;
+		++load.active_jobs;
+		const size_t prompt_left = job->isPromptPrepared
+			? job->embd_inp.size() - std::min<size_t>(job->embd_inp.size(), static_cast<size_t>(std::max(0, job->i_prompt)))
+			: job->prompt_tokens.size();
+		load.pending_tokens += static_cast<int64_t>(prompt_left) + std::max(0, job->n_remain);
+	});
+	load.admit_jobs = inferenceService ? inferenceService->admissionLimit() : 0;
+	return load;
+}
+
+void InferenceEngine::Impl::reclaimFinishedJobs()
+{
+	const auto now = std::chrono::steady_clock::now();
+	const int64_t nowSec = std::chrono::duration_cast<std::chrono::seconds>(now.time_since_epoch()).count();
+
+	// Rate limited; only one caller sweeps per interval
+	int64_t last = lastJobSweep.load();
+	if (nowSec - last < kJobSweepInterval.count() || !lastJobSweep.compare_exchange_strong(last, nowSec))
+	{
+		return;
+	}
+
+	// The first sweep that sees a job finished starts its TTL, a later one drops it
+	size_t reclaimed = jobs.eraseIf([now](const std::shared_ptr<Job>& job) {
+		std::lock_guard<std::mutex> jobLock(job->mtx);
+		if (!job->isFinished && !job->hasError)
+			return false;
+		if (job->reclaim_at == std::chrono::steady_clock::time_point{})
+		{
+			job->reclaim_at = now + kFinishedJobTtl;
+			return false;
+		}
+		return now >= job->reclaim_at;
+	});
+
+#ifdef DEBUG
+	std::cout << "[INFERENCE] Reclaimed " << reclaimed << " finished jobs, " << jobs.size() << " live" << std::endl;
+#else
+	(void)reclaimed;
+#endif
 }
 
 InferenceEngine::Impl::~Impl()
 {
 	threadPool.shutdown();
 	jobs.clear();
-	llama_backend_free();
-
+	tokenizer.reset();
 	inferenceService.reset();
+	BackendManager::instance().releaseBackend();
 }
 
 INFERENCE_API InferenceEngine::InferenceEngine()
@@ -2514,15 +8652,18 @@ INFERENCE_API bool InferenceEngine::loadModel(const char* modelPath, const Loadi
 	std::cout << "[INFERENCE] Loading LLM model from " << modelPath << std::endl;
 #endif
 	this->pimpl.reset();
+	this->loadProgress.store(0.0f);
 
 	try
 	{
-		this->pimpl = std::make_unique<Impl>(modelPath, lParams, mainGpuId, false);
+		this->pimpl = std::make_unique<Impl>(modelPath, lParams, mainGpuId, false, &this->loadProgress);
 	}
 	catch (const std::exception& e) {
 		std::cerr << "[INFERENCE] [ERROR] Could not load model from: " << modelPath << "\nError: " << e.what() << "\n" << std::endl;
+		this->loadProgress.store(0.0f);
 		return false;
 	}
+	this->loadProgress.store(1.0f);
 	return true;
 }
 
@@ -2532,17 +8673,40 @@ INFERENCE_API bool InferenceEngine::loadEmbeddingModel(const char *modelPath, co
 	std::cout << "[INFERENCE] Loading embedding model from " << modelPath << std::endl;
 #endif
 	this->pimpl.reset();
+	this->loadProgress.store(0.0f);
 
 	try
 	{
-		this->pimpl = std::make_unique<Impl>(modelPath, lParams, mainGpuId, true);
+		this->pimpl = std::make_unique<Impl>(modelPath, lParams, mainGpuId, true, &this->loadProgress);
 	}
 	catch (const std::exception &e)
 	{
 		std::cerr << "[INFERENCE] [ERROR] Could not load embedding model from: " << modelPath << "\nError: " << e.what() << "\n"
 				  << std::endl;
+		this->loadProgress.store(0.0f);
+		return false;
+	}
+	this->loadProgress.store(1.0f);
+	return true;
+}
+
+INFERENCE_API bool InferenceEngine::loadRerankModel(const char *modelPath, const LoadingParameters lParams, const int mainGpuId)
+{
+	this->pimpl.reset();
+	this->loadProgress.store(0.0f);
+
+	try
+	{
+		this->pimpl = std::make_unique<Impl>(modelPath, lParams, mainGpuId, true, &this->loadProgress, true);
+	}
+	catch (const std::exception &e)
+	{
+		std::cerr << "[INFERENCE] [ERROR] Could not load reranker model from: " << modelPath << "\nError: " << e.what() << "\n"
+				  << std::endl;
+		this->loadProgress.store(0.0f);
 		return false;
 	}
+	this->loadProgress.store(1.0f);
 	return true;
 }
 
@@ -2555,6 +8719,7 @@ INFERENCE_API bool InferenceEngine::unloadModel()
 	}
 
 	this->pimpl.reset();
+	this->loadProgress.store(0.0f);
 	return true;
 }
 
@@ -2576,6 +8741,16 @@ INFERENCE_API int InferenceEngine::submitChatCompletionsJob(const ChatCompletion
 	return pimpl->submitChatCompletionsJob(params);
 }
 
+INFERENCE_API std::vector<int> InferenceEngine::submitCompletionsJobs(const CompletionParameters& params, int n)
+{
+	return pimpl->submitCompletionsJobs(params, n);
+}
+
+INFERENCE_API std::vector<int> InferenceEngine::submitChatCompletionsJobs(const ChatCompletionParameters& params, int n)
+{
+	return pimpl->submitChatCompletionsJobs(params, n);
+}
+
 INFERENCE_API int InferenceEngine::submitEmbeddingJob(const EmbeddingParameters &params)
 {
 #ifdef DEBUG
@@ -2585,11 +8760,49 @@ INFERENCE_API int InferenceEngine::submitEmbeddingJob(const EmbeddingParameters
 	return pimpl->submitEmbeddingJob(params);
 }
 
+INFERENCE_API std::vector<EmbeddingResult> InferenceEngine::submitEmbeddingBatch(const std::vector<EmbeddingParameters> &params)
+{
+	return pimpl->submitEmbeddingBatch(params);
+}
+
+INFERENCE_API std::vector<RerankResult> InferenceEngine::rerank(const std::string &query, const std::vector<std::string> &documents, int topK)
+{
+	if (!pimpl)
+	{
+		throw std::runtime_error("Model not loaded");
+	}
+	return pimpl->rerank(query, documents, topK);
+}
+
+INFERENCE_API std::vector<ScoringResult> InferenceEngine::score(const std::vector<ScoringRequest> &requests, int topLogprobs)
+{
+	if (!pimpl)
+	{
+		throw std::runtime_error("Model not loaded");
+	}
+	return pimpl->score(requests, topLogprobs);
+}
+
+INFERENCE_API std::vector<int32_t> InferenceEngine::tokenize(const std::string &text, bool addSpecial)
+{
+	return pimpl ? pimpl->tokenize(text, addSpecial) : std::vector<int32_t>();
+}
+
+INFERENCE_API std::vector<int> InferenceEngine::countTokens(const std::vector<std::string> &texts, bool addSpecial)
+{
+	return pimpl ? pimpl->countTokens(texts, addSpecial) : std::vector<int>(texts.size(), -1);
+}
+
 INFERENCE_API void InferenceEngine::stopJob(int job_id)
 {
 	pimpl->stopJob(job_id);
 }
 
+INFERENCE_API void InferenceEngine::suspendJob(int job_id)
+{
+	pimpl->suspendJob(job_id);
+}
+
 INFERENCE_API bool InferenceEngine::isJobFinished(int job_id)
 {
 	return pimpl->isJobFinished(job_id);
@@ -2600,14 +8813,24 @@ INFERENCE_API CompletionResult InferenceEngine::getJobResult(int job_id)
 	return pimpl->getJobResult(job_id);
 }
 
+INFERENCE_API bool InferenceEngine::waitForJobOutput(int job_id, CompletionDelta& delta, int timeoutMs)
+{
+	return pimpl->waitForJobOutput(job_id, delta, timeoutMs);
+}
+
+INFERENCE_API CompletionDelta InferenceEngine::getJobResultSince(int job_id, JobOutputCursor& cursor)
+{
+	return pimpl->getJobResultSince(job_id, cursor);
+}
+
 INFERENCE_API EmbeddingResult InferenceEngine::getEmbeddingResult(int job_id)
 {
 	return pimpl->getEmbeddingResult(job_id);
 }
 
-INFERENCE_API void InferenceEngine::waitForJob(int job_id)
+INFERENCE_API bool InferenceEngine::waitForJob(int job_id, int timeoutMs)
 {
-	pimpl->waitForJob(job_id);
+	return pimpl->waitForJob(job_id, timeoutMs);
 }
 
 INFERENCE_API bool InferenceEngine::hasJobError(int job_id)
@@ -2620,11 +8843,81 @@ INFERENCE_API std::string InferenceEngine::getJobError(int job_id)
 	return pimpl->getJobError(job_id);
 }
 
+INFERENCE_API std::shared_ptr<const KvSequenceState> InferenceEngine::getJobKvState(int job_id)
+{
+	return pimpl->getJobKvState(job_id);
+}
+
 INFERENCE_API bool InferenceEngine::hasActiveJobs()
 {
 	return pimpl->hasActiveJobs();
 }
 
+INFERENCE_API KvCacheStats InferenceEngine::getKvCacheStats()
+{
+	return pimpl->getKvCacheStats();
+}
+
+INFERENCE_API HugePageStats InferenceEngine::getHugePageStats()
+{
+	return pimpl->getHugePageStats();
+}
+
+INFERENCE_API std::vector<std::pair<std::string, std::shared_ptr<const KvSequenceState>>> InferenceEngine::exportSessions()
+{
+	return pimpl->exportSessions();
+}
+
+INFERENCE_API bool InferenceEngine::importSession(const std::string& key, std::shared_ptr<const KvSequenceState> state)
+{
+	return pimpl->importSession(key, std::move(state));
+}
+
+INFERENCE_API bool InferenceEngine::precomputeChunk(const std::string& text)
+{
+	return pimpl->precomputeChunk(text);
+}
+
+INFERENCE_API DecodeStats InferenceEngine::getDecodeStats()
+{
+	return pimpl ? pimpl->getDecodeStats() : DecodeStats();
+}
+
+INFERENCE_API std::vector<DecodeStepSample> InferenceEngine::getStepProfile()
+{
+	return pimpl ? pimpl->getStepProfile() : std::vector<DecodeStepSample>();
+}
+
+INFERENCE_API void InferenceEngine::beginStepCapture(size_t maxSteps)
+{
+	if (pimpl) pimpl->beginStepCapture(maxSteps);
+}
+
+INFERENCE_API std::vector<DecodeStepSample> InferenceEngine::endStepCapture()
+{
+	return pimpl ? pimpl->endStepCapture() : std::vector<DecodeStepSample>();
+}
+
+INFERENCE_API void InferenceEngine::releaseJob(int job_id)
+{
+	pimpl->releaseJob(job_id);
+}
+
+INFERENCE_API size_t InferenceEngine::liveJobCount()
+{
+	return pimpl->liveJobCount();
+}
+
+INFERENCE_API EngineLoad InferenceEngine::getLoad()
+{
+	return pimpl ? pimpl->getLoad() : EngineLoad();
+}
+
+INFERENCE_API float InferenceEngine::getLoadProgress()
+{
+	return loadProgress.load();
+}
+
 INFERENCE_API InferenceEngine::~InferenceEngine() = default;
 
 extern "C" INFERENCE_API IInferenceEngine* createInferenceEngine()
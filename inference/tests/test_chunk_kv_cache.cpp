@@ -0,0 +1,56 @@
+#include "test_common.h"
+
+// Precomputes a document chunk, then serves a RAG-style prompt quoting it: the
+// chunk's KV must be spliced in instead of prefilled, and the answer must stay
+// close to the one a cold engine gives for the same prompt.
+int main(int argc, char **argv) {
+    if (argc < 2) { std::cerr << "Usage: " << argv[0] << " <model.gguf>\n"; return 64; }
+    const char *model = argv[1];
+
+    std::string document = "Kolosal Server is an inference server for large language models.";
+    for (int i = 0; i < 10; ++i) {
+        document += " Fact " + std::to_string(i + 1) + ": the office in city number " + std::to_string(i + 1)
+                  + " opens at " + std::to_string(7 + i % 3) + " in the morning.";
+    }
+    CompletionParameters p;
+    p.prompt = "Use the document to answer.\nDocument:\n" + document + "\nQuestion: When does the office in city number 4 open?\nAnswer:";
+    p.maxNewTokens = 8; p.temperature = 0.0f;
+
+    LoadingParameters lp; lp.n_ctx = 1024; lp.n_keep = 512; lp.n_parallel = 1; lp.n_batch = 256; lp.n_ubatch = 64; lp.n_gpu_layers = 100;
+    lp.n_prefix_cache = 0;
+
+    CompletionResult cold;
+    {
+        InferenceEngine engine;
+        if (!engine.loadModel(model, lp)) { std::cerr << "[TEST] Failed to load model\n"; return 65; }
+        if (engine.precomputeChunk(document)) { std::cerr << "[TEST] FAIL chunk cached with chunk_cache_mb = 0\n"; return 67; }
+        int job = engine.submitCompletionsJob(p);
+        if (job < 0 || !wait_for_completion(engine, job, 30000)) { std::cerr << "[TEST] cold job failed\n"; return 66; }
+        cold = engine.getJobResult(job);
+        engine.releaseJob(job);
+    }
+
+    lp.chunk_cache_mb = 64;
+    InferenceEngine engine;
+    if (!engine.loadModel(model, lp)) { std::cerr << "[TEST] Failed to load model\n"; return 65; }
+    if (!engine.precomputeChunk(document)) { std::cerr << "[TEST] FAIL chunk not cached\n"; return 67; }
+    if (!engine.precomputeChunk(document)) { std::cerr << "[TEST] FAIL cached chunk refused the second time\n"; return 67; }
+
+    int job = engine.submitCompletionsJob(p);
+    if (job < 0 || !wait_for_completion(engine, job, 30000)) { std::cerr << "[TEST] spliced job failed\n"; return 66; }
+    auto spliced = engine.getJobResult(job);
+    engine.releaseJob(job);
+
+    const auto stats = engine.getDecodeStats();
+    std::cout << "[TEST] spliced tokens=" << stats.chunk_tokens << " cold prefill=" << cold.timing.prefill_ms
+              << "ms spliced prefill=" << spliced.timing.prefill_ms << "ms\n";
+    if (stats.chunk_tokens == 0) { std::cerr << "[TEST] FAIL the cached chunk was not spliced into the prompt\n"; return 68; }
+    if (spliced.text.empty()) { std::cerr << "[TEST] FAIL no output after splicing\n"; return 69; }
+    if (spliced.text != cold.text) {
+        // the chunk never attended to the instruction before it
+        std::cout << "[TEST] WARN spliced output differs: '" << cold.text << "' vs '" << spliced.text << "'\n";
+    }
+
+    std::cout << "[TEST] OK chunk KV cache\n";
+    return 0;
+}
@@ -11,18 +11,18 @@ int main(int argc, char **argv) {
     CompletionParameters p; p.prompt = prompt; p.maxNewTokens = 32; p.temperature = 0.7f; p.topP = 0.9f; p.streaming = true; p.seqId = 0;
     int job = engine.submitCompletionsJob(p);
     if (job < 0) { std::cerr << "[TEST] submit failed\n"; return 66; }
-    // Stream partial output as it is generated
-    size_t printed = 0;
+    // Stream partial output as it is generated, fetching only what is new each time
+    JobOutputCursor cursor;
+    std::string streamed;
     auto start = std::chrono::steady_clock::now();
     const int timeout_ms = 20000;
-    while (!engine.isJobFinished(job)) {
-        if (engine.hasJobError(job)) { std::cerr << "[TEST] job error: " << engine.getJobError(job) << "\n"; return 67; }
-        auto partial = engine.getJobResult(job);
-        if (partial.text.size() > printed) {
-            std::cout << partial.text.substr(printed);
-            std::cout.flush();
-            printed = partial.text.size();
-        }
+    while (true) {
+        auto delta = engine.getJobResultSince(job, cursor);
+        if (delta.hasError) { std::cerr << "[TEST] job error: " << delta.errorMessage << "\n"; return 67; }
+        std::cout << delta.text;
+        std::cout.flush();
+        streamed += delta.text;
+        if (delta.finished) break;
         if (std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count() > timeout_ms) {
             std::cerr << "\n[TEST] Timeout waiting for streaming result" << std::endl;
             return 67;
@@ -32,9 +32,14 @@ int main(int argc, char **argv) {
 
     // Final result and assertions
     auto r = engine.getJobResult(job);
-    if (r.text.size() > printed) { std::cout << r.text.substr(printed); std::cout.flush(); }
     std::cout << "\n";
     if (r.tokens.empty()) { std::cerr << "[TEST] no tokens generated\n"; return 68; }
+    if (streamed != r.text || cursor.tokens != r.tokens.size()) { std::cerr << "[TEST] incremental output does not match final result\n"; return 69; }
+
+    // Released jobs are dropped from the engine
+    engine.releaseJob(job);
+    if (engine.liveJobCount() != 0 || !engine.isJobFinished(job)) { std::cerr << "[TEST] released job still held\n"; return 70; }
+
     std::cout << "[TEST] OK basic completion tokens=" << r.tokens.size() << " ttft=" << r.ttft << " tps=" << r.tps << "\n";
     std::cout << "[TEST] Result: " << r.text << "\n";
     return 0;
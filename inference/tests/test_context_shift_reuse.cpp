@@ -0,0 +1,45 @@
+#include "test_common.h"
+#include <sstream>
+
+// A keyed conversation grows past the context window. The second turn's prompt is cut
+// in the middle by context shifting; the cached first turn is shifted in KV to match
+// instead of being decoded again, and generation must still succeed.
+static std::string numbered_lines(int from, int to) {
+    std::ostringstream os;
+    for (int i = from; i < to; ++i) os << "Line " << i << ": the value is " << (i * 7) % 100 << ".\n";
+    return os.str();
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) { std::cerr << "Usage: " << argv[0] << " <model.gguf>\n"; return 64; }
+
+    InferenceEngine engine;
+    LoadingParameters lp; lp.n_ctx = 1024; lp.n_keep = 32; lp.n_parallel = 1; lp.n_batch = 256; lp.n_ubatch = 64; lp.n_gpu_layers = 100;
+    if (!engine.loadModel(argv[1], lp)) { std::cerr << "[TEST] Failed to load model\n"; return 65; }
+
+    CompletionParameters turn1; turn1.maxNewTokens = 8; turn1.temperature = 0.0f; turn1.topP = 1.0f;
+    turn1.sessionKey = "shifted"; turn1.allow_context_shift = true;
+    turn1.prompt = "Read the table and answer.\n" + numbered_lines(0, 50) + "Question: what is the value on line 3?\nAnswer:";
+    const int turn1_tokens = static_cast<int>(engine.tokenize(turn1.prompt, true).size());
+    if (turn1_tokens + turn1.maxNewTokens > lp.n_ctx - lp.n_keep) { std::cerr << "[TEST] first turn must fit the context\n"; return 66; }
+
+    int job = engine.submitCompletionsJob(turn1);
+    if (job < 0 || !wait_for_completion(engine, job, 60000)) { std::cerr << "[TEST] turn 1 failed: " << engine.getJobError(job) << "\n"; return 67; }
+    auto r1 = engine.getJobResult(job);
+    engine.releaseJob(job);
+
+    CompletionParameters turn2 = turn1;
+    turn2.prompt = turn1.prompt + r1.text + "\n" + numbered_lines(50, 110) + "Question: what is the value on line 109?\nAnswer:";
+    const int turn2_tokens = static_cast<int>(engine.tokenize(turn2.prompt, true).size());
+    if (turn2_tokens < lp.n_ctx) { std::cerr << "[TEST] second turn must exceed the context\n"; return 66; }
+
+    job = engine.submitCompletionsJob(turn2);
+    if (job < 0 || !wait_for_completion(engine, job, 60000)) { std::cerr << "[TEST] turn 2 failed: " << engine.getJobError(job) << "\n"; return 68; }
+    auto r2 = engine.getJobResult(job);
+    if (r2.tokens.empty()) { std::cerr << "[TEST] no tokens generated after the shift\n"; return 69; }
+
+    std::cout << "[TEST] turn1 tokens=" << turn1_tokens << " prefill=" << r1.timing.prefill_ms << "ms; turn2 tokens="
+              << turn2_tokens << " prefill=" << r2.timing.prefill_ms << "ms\n";
+    std::cout << "[TEST] OK context shift reuse: " << r2.text << "\n";
+    return 0;
+}
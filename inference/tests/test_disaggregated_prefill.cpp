@@ -0,0 +1,45 @@
+#include "test_common.h"
+
+// Disaggregated serving: one engine decodes a prompt with prefillOnly and hands its KV state
+// to a second engine of the same model, which must generate what it would have generated
+// after decoding the prompt itself, while decoding only the last prompt token.
+int main(int argc, char **argv) {
+    if (argc < 2) { std::cerr << "Usage: " << argv[0] << " <model.gguf>\n"; return 64; }
+    const char *model = argv[1];
+
+    InferenceEngine prefill; if (!load_test_model(prefill, model)) { std::cerr << "[TEST] prefill load fail\n"; return 65; }
+    InferenceEngine decode; if (!load_test_model(decode, model)) { std::cerr << "[TEST] decode load fail\n"; return 65; }
+
+    CompletionParameters params; params.maxNewTokens = 24; params.temperature = 0.0f; params.topP = 1.0f;
+    params.prompt = "A short history of the printing press: Johannes Gutenberg, a goldsmith from Mainz, "
+                    "developed movable metal type around 1440. Within decades presses spread across Europe, and";
+
+    // Reference: the decode engine on its own
+    int ref = decode.submitCompletionsJob(params);
+    if (!wait_for_completion(decode, ref, 30000)) { std::cerr << "[TEST] reference failed: " << decode.getJobError(ref) << "\n"; return 66; }
+    const CompletionResult expected = decode.getJobResult(ref);
+    decode.releaseJob(ref);
+
+    CompletionParameters prefillParams = params; prefillParams.prefillOnly = true;
+    int pj = prefill.submitCompletionsJob(prefillParams);
+    if (!wait_for_completion(prefill, pj, 30000)) { std::cerr << "[TEST] prefill failed: " << prefill.getJobError(pj) << "\n"; return 67; }
+    if (!prefill.getJobResult(pj).tokens.empty()) { std::cerr << "[TEST] prefillOnly job generated tokens\n"; return 68; }
+    std::shared_ptr<const KvSequenceState> state = prefill.getJobKvState(pj);
+    if (!state || state->tokens.empty() || state->state.empty()) { std::cerr << "[TEST] no KV state exported\n"; return 69; }
+    if (prefill.getJobKvState(pj)) { std::cerr << "[TEST] KV state handed out twice\n"; return 70; }
+    prefill.releaseJob(pj);
+
+    CompletionParameters resumed = params; resumed.kvState = state;
+    int dj = decode.submitCompletionsJob(resumed);
+    if (!wait_for_completion(decode, dj, 30000)) { std::cerr << "[TEST] resumed job failed: " << decode.getJobError(dj) << "\n"; return 71; }
+    const CompletionResult got = decode.getJobResult(dj);
+    decode.releaseJob(dj);
+
+    if (got.text != expected.text) {
+        std::cerr << "[TEST] resumed output differs\n  expected: " << expected.text << "\n  got:      " << got.text << "\n";
+        return 72;
+    }
+    std::cout << "[TEST] state=" << state->state.size() << " bytes for " << state->tokens.size() << " tokens, resumed prefill_ms=" << got.timing.prefill_ms << "\n";
+    std::cout << "[TEST] OK disaggregated prefill\n";
+    return 0;
+}
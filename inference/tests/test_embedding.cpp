@@ -12,5 +12,36 @@ int main(int argc, char **argv) {
     if (engine.hasJobError(job)) { std::cerr << "[TEST] embedding job error: " << engine.getJobError(job) << "\n"; return 67; }
     auto res = engine.getEmbeddingResult(job);
     if (res.embedding.empty()) { std::cerr << "[TEST] empty embedding\n"; return 68; }
-    std::cout << "[TEST] OK embedding size=" << res.embedding.size() << "\n"; return 0;
+
+    // Batched submission must match the single-input result for the same text
+    std::vector<EmbeddingParameters> batch(3);
+    batch[0].input = ep.input; batch[1].input = "Embeddings map text to vectors"; batch[2].input = "Another short sentence";
+    auto results = engine.submitEmbeddingBatch(batch);
+    if (results.size() != batch.size()) { std::cerr << "[TEST] batch returned " << results.size() << " results\n"; return 69; }
+    for (size_t i = 0; i < results.size(); ++i) {
+        if (results[i].hasError || results[i].embedding.size() != res.embedding.size()) {
+            std::cerr << "[TEST] batch item " << i << " failed: " << results[i].errorMessage << "\n"; return 70;
+        }
+    }
+    float dot = 0.0f;
+    for (size_t i = 0; i < res.embedding.size(); ++i) dot += res.embedding[i] * results[0].embedding[i];
+    if (dot < 0.99f) { std::cerr << "[TEST] batch embedding differs from single (cos=" << dot << ")\n"; return 71; }
+
+    // Mixed lengths are packed longest first; each result must still match its own single run
+    std::string longText;
+    for (int i = 0; i < 40; ++i) longText += "Sentence " + std::to_string(i) + " of a long paragraph about vectors. ";
+    std::vector<EmbeddingParameters> mixed(4);
+    mixed[0].input = "short"; mixed[1].input = longText; mixed[2].input = ep.input; mixed[3].input = longText.substr(0, 200);
+    auto mixedResults = engine.submitEmbeddingBatch(mixed);
+    if (mixedResults.size() != mixed.size()) { std::cerr << "[TEST] mixed batch returned " << mixedResults.size() << " results\n"; return 72; }
+    for (size_t i = 0; i < mixedResults.size(); ++i) {
+        if (mixedResults[i].hasError || mixedResults[i].embedding.size() != res.embedding.size()) {
+            std::cerr << "[TEST] mixed item " << i << " failed: " << mixedResults[i].errorMessage << "\n"; return 73;
+        }
+    }
+    dot = 0.0f;
+    for (size_t i = 0; i < res.embedding.size(); ++i) dot += res.embedding[i] * mixedResults[2].embedding[i];
+    if (dot < 0.99f) { std::cerr << "[TEST] mixed batch embedding differs from single (cos=" << dot << ")\n"; return 74; }
+
+    std::cout << "[TEST] OK embedding size=" << res.embedding.size() << " batch=" << results.size() << "\n"; return 0;
 }
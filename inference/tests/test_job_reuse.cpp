@@ -0,0 +1,35 @@
+#include "test_common.h"
+
+// Runs many short jobs one after another, releasing each, so later jobs get recycled
+// Job objects and pooled samplers. A greedy prompt must give the same output every
+// time, and settings of one job (stop sequences) must not leak into the next.
+int main(int argc, char **argv) {
+    if (argc < 2) { std::cerr << "Usage: " << argv[0] << " <model.gguf>\n"; return 64; }
+
+    InferenceEngine engine;
+    if (!load_test_model(engine, argv[1])) { std::cerr << "[TEST] Failed to load model\n"; return 65; }
+
+    CompletionParameters p; p.prompt = "Count: one, two, three,"; p.maxNewTokens = 12; p.temperature = 0.0f; p.topP = 1.0f; p.seqId = 0;
+    CompletionParameters stopped = p; stopped.stop = { "," };
+
+    std::string reference;
+    for (int i = 0; i < 40; ++i) {
+        const bool withStop = i % 2 == 1;
+        int job = engine.submitCompletionsJob(withStop ? stopped : p);
+        if (job < 0) { std::cerr << "[TEST] submit failed\n"; return 66; }
+        if (!wait_for_completion(engine, job, 30000)) { std::cerr << "[TEST] job failed: " << engine.getJobError(job) << "\n"; return 67; }
+        auto r = engine.getJobResult(job);
+        engine.releaseJob(job);
+
+        if (withStop) {
+            if (r.text.find(',') != std::string::npos) { std::cerr << "[TEST] stop sequence ignored: " << r.text << "\n"; return 68; }
+            continue;
+        }
+        if (r.tokens.empty()) { std::cerr << "[TEST] no tokens generated\n"; return 69; }
+        if (i == 0) reference = r.text;
+        else if (r.text != reference) { std::cerr << "[TEST] run " << i << " differs: '" << r.text << "' vs '" << reference << "'\n"; return 70; }
+    }
+
+    std::cout << "[TEST] OK job reuse text='" << reference << "'\n";
+    return 0;
+}
@@ -26,6 +26,15 @@ int main(int argc, char **argv) {
     // Heuristic validation: must contain keys and braces
     if (r.text.find("name") == std::string::npos || r.text.find("age") == std::string::npos || r.text.find("{") == std::string::npos) {
         std::cerr << "[TEST] structured JSON not detected in output: " << r.text << "\n"; return 68; }
+
+    // The same schema again is served from the compiled grammar cache and must sample identically
+    int again = engine.submitCompletionsJob(p);
+    if (again < 0) { std::cerr << "[TEST] submit failed\n"; return 66; }
+    engine.waitForJob(again);
+    if (engine.hasJobError(again)) { std::cerr << "[TEST] job error: " << engine.getJobError(again) << "\n"; return 67; }
+    auto r2 = engine.getJobResult(again);
+    if (r2.text != r.text) { std::cerr << "[TEST] cached grammar changed the output: " << r2.text << "\n"; return 69; }
+    std::cout << "[TEST] grammar_ms first=" << r.timing.grammar_ms << " cached=" << r2.timing.grammar_ms << "\n";
     std::cout << "[TEST] OK json schema output: " << r.text << "\n";
     return 0;
 }
@@ -0,0 +1,39 @@
+#include "test_common.h"
+
+// Serves one base model with a LoRA adapter registered twice: "full" at scale 1 and "off"
+// at scale 0. Greedy jobs on the base model, "off" and "full" run side by side, so the
+// decode loop has to alternate adapters; "off" must match the base output exactly.
+int main(int argc, char **argv) {
+    if (argc < 3) { std::cerr << "Usage: " << argv[0] << " <model.gguf> <lora.gguf>\n"; return 64; }
+
+    InferenceEngine engine;
+    LoadingParameters lp; lp.n_ctx = 1024; lp.n_keep = 512; lp.n_parallel = 4; lp.n_batch = 256; lp.n_ubatch = 64; lp.n_gpu_layers = 100;
+    lp.lora_adapters = { { "full", argv[2], 1.0f }, { "off", argv[2], 0.0f } };
+    lp.lora_max_loaded = 1;
+    if (!engine.loadModel(argv[1], lp)) { std::cerr << "[TEST] Failed to load model\n"; return 65; }
+
+    CompletionParameters p; p.prompt = "The three primary colors are"; p.maxNewTokens = 32; p.temperature = 0.0f; p.topP = 1.0f;
+    CompletionParameters off = p; off.loraAdapter = "off";
+    CompletionParameters full = p; full.loraAdapter = "full";
+
+    const int baseJob = engine.submitCompletionsJob(p);
+    const int offJob = engine.submitCompletionsJob(off);
+    const int fullJob = engine.submitCompletionsJob(full);
+    for (int job : { baseJob, offJob, fullJob }) {
+        if (job < 0) { std::cerr << "[TEST] submit failed\n"; return 66; }
+        if (!wait_for_completion(engine, job, 60000)) { std::cerr << "[TEST] job failed: " << engine.getJobError(job) << "\n"; return 67; }
+    }
+
+    auto base = engine.getJobResult(baseJob);
+    auto offResult = engine.getJobResult(offJob);
+    auto fullResult = engine.getJobResult(fullJob);
+    if (base.tokens.empty() || fullResult.tokens.empty()) { std::cerr << "[TEST] no tokens generated\n"; return 68; }
+    if (offResult.tokens != base.tokens) { std::cerr << "[TEST] scale 0 adapter diverged from the base model\n"; return 69; }
+
+    CompletionParameters unknown = p; unknown.loraAdapter = "missing";
+    const int unknownJob = engine.submitCompletionsJob(unknown);
+    if (unknownJob >= 0 && wait_for_completion(engine, unknownJob, 10000)) { std::cerr << "[TEST] unknown adapter accepted\n"; return 70; }
+
+    std::cout << "[TEST] OK multi-lora base=\"" << base.text << "\" full=\"" << fullResult.text << "\"\n";
+    return 0;
+}
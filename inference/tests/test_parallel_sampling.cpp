@@ -0,0 +1,37 @@
+#include "test_common.h"
+#include <set>
+
+// Submits three candidates of one prompt. All must complete with the same prompt size;
+// the candidates after the first should copy its decoded prompt instead of prefilling it.
+int main(int argc, char **argv) {
+    if (argc < 2) { std::cerr << "Usage: " << argv[0] << " <model.gguf>\n"; return 64; }
+
+    InferenceEngine engine;
+    if (!load_test_model(engine, argv[1], /*n_parallel=*/4)) { std::cerr << "[TEST] Failed to load model\n"; return 65; }
+
+    CompletionParameters p; p.prompt = "Write one sentence about the sea:"; p.maxNewTokens = 24; p.temperature = 0.9f; p.topP = 0.95f;
+    p.scoreOutput = true;
+    std::vector<int> jobs = engine.submitCompletionsJobs(p, 3);
+    if (jobs.size() != 3) { std::cerr << "[TEST] submit returned " << jobs.size() << " jobs\n"; return 66; }
+
+    std::set<std::string> texts;
+    int shared = 0;
+    int prompt_tokens = -1;
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        if (!wait_for_completion(engine, jobs[i], 60000)) { std::cerr << "[TEST] candidate " << i << " failed: " << engine.getJobError(jobs[i]) << "\n"; return 67; }
+        auto r = engine.getJobResult(jobs[i]);
+        if (r.tokens.empty()) { std::cerr << "[TEST] candidate " << i << " generated no tokens\n"; return 68; }
+        if (prompt_tokens >= 0 && r.prompt_token_count != prompt_tokens) { std::cerr << "[TEST] candidate " << i << " saw a different prompt\n"; return 69; }
+        if (r.logprob > 0.0) { std::cerr << "[TEST] candidate " << i << " has a positive log-probability\n"; return 70; }
+        prompt_tokens = r.prompt_token_count;
+        if (i > 0 && r.timing.prefill_ms == 0.0f) ++shared;
+        texts.insert(r.text);
+        std::cout << "[TEST] candidate " << i << " prefill=" << r.timing.prefill_ms << "ms logprob=" << r.logprob << " text=" << r.text << "\n";
+        engine.releaseJob(jobs[i]);
+    }
+
+    if (shared == 0) std::cout << "[TEST] WARN no candidate shared the first one's prefill\n";
+    if (texts.size() == 1) std::cout << "[TEST] WARN all candidates produced the same text\n";
+    std::cout << "[TEST] OK parallel sampling shared=" << shared << " distinct=" << texts.size() << "\n";
+    return 0;
+}
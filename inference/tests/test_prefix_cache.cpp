@@ -0,0 +1,38 @@
+#include "test_common.h"
+#include <cstdlib>
+
+// Runs two prompts that share a long system prefix. The second job should pick
+// the prefix up from the shared KV cache, so both must succeed and the second
+// one should reach its first token faster.
+int main(int argc, char **argv) {
+    if (argc < 2) { std::cerr << "Usage: " << argv[0] << " <model.gguf>\n"; return 64; }
+    const char *model = argv[1];
+
+    InferenceEngine engine;
+    if (!load_test_model(engine, model)) { std::cerr << "[TEST] Failed to load model\n"; return 65; }
+
+    std::string system = "You are a helpful assistant. Answer briefly and precisely.\n";
+    for (int i = 0; i < 12; ++i) {
+        system += "Rule " + std::to_string(i + 1) + ": keep the answer factual, polite and on topic.\n";
+    }
+
+    float ttft[2] = { 0.0f, 0.0f };
+    const char *questions[2] = { "Question: What is the capital of France?\nAnswer:",
+                                 "Question: What is the capital of Italy?\nAnswer:" };
+    for (int i = 0; i < 2; ++i) {
+        CompletionParameters p; p.prompt = system + questions[i]; p.maxNewTokens = 8; p.temperature = 0.1f; p.seqId = 0;
+        int job = engine.submitCompletionsJob(p);
+        if (job < 0) { std::cerr << "[TEST] submit failed\n"; return 66; }
+        if (!wait_for_completion(engine, job, 30000)) { std::cerr << "[TEST] job " << i << " failed: " << engine.getJobError(job) << "\n"; return 67; }
+        auto r = engine.getJobResult(job);
+        if (r.tokens.empty()) { std::cerr << "[TEST] job " << i << " generated no tokens\n"; return 68; }
+        ttft[i] = r.ttft;
+        std::cout << "[TEST] job " << i << " prompt_tokens=" << r.prompt_token_count << " ttft=" << r.ttft << "ms text=" << r.text << "\n";
+    }
+
+    if (ttft[1] >= ttft[0]) {
+        std::cout << "[TEST] WARN second job was not faster (" << ttft[1] << "ms >= " << ttft[0] << "ms)\n";
+    }
+    std::cout << "[TEST] OK prefix cache\n";
+    return 0;
+}
@@ -0,0 +1,62 @@
+#include "test_common.h"
+#include <filesystem>
+
+// Serves a prompt with a long shared prefix, unloads the engine and checks the
+// prefix cache was saved to prefix_cache_dir. A second engine restores it in the
+// background after loading and must produce the same greedy output, reaching
+// it with less prefill than the cold run.
+int main(int argc, char **argv) {
+    if (argc < 2) { std::cerr << "Usage: " << argv[0] << " <model.gguf>\n"; return 64; }
+    const char *model = argv[1];
+
+    const std::filesystem::path dir = std::filesystem::temp_directory_path() / "kolosal-test-prefix-cache";
+    std::filesystem::remove_all(dir);
+
+    LoadingParameters lp; lp.n_ctx = 1024; lp.n_keep = 512; lp.n_parallel = 1; lp.n_batch = 256; lp.n_ubatch = 64; lp.n_gpu_layers = 100;
+    lp.prefix_cache_dir = dir.string();
+
+    std::string system = "You are a helpful assistant. Answer briefly and precisely.\n";
+    for (int i = 0; i < 12; ++i) {
+        system += "Rule " + std::to_string(i + 1) + ": keep the answer factual, polite and on topic.\n";
+    }
+    CompletionParameters p; p.prompt = system + "Question: What is the capital of France?\nAnswer:"; p.maxNewTokens = 8; p.temperature = 0.0f;
+
+    CompletionResult cold;
+    {
+        InferenceEngine engine;
+        if (!engine.loadModel(model, lp)) { std::cerr << "[TEST] Failed to load model\n"; return 65; }
+        int job = engine.submitCompletionsJob(p);
+        if (job < 0 || !wait_for_completion(engine, job, 30000)) { std::cerr << "[TEST] cold job failed\n"; return 66; }
+        cold = engine.getJobResult(job);
+        engine.releaseJob(job);
+        engine.unloadModel();
+    }
+
+    size_t files = 0;
+    for (const auto &entry : std::filesystem::directory_iterator(dir)) {
+        if (entry.path().extension() == ".bin") ++files;
+    }
+    if (files == 0) { std::cerr << "[TEST] FAIL no prefix cache file in " << dir << "\n"; return 67; }
+
+    InferenceEngine engine;
+    if (!engine.loadModel(model, lp)) { std::cerr << "[TEST] Failed to reload model\n"; return 65; }
+    std::this_thread::sleep_for(std::chrono::seconds(2));   // the restore runs in the background
+    int job = engine.submitCompletionsJob(p);
+    if (job < 0 || !wait_for_completion(engine, job, 30000)) { std::cerr << "[TEST] warm job failed\n"; return 66; }
+    auto warm = engine.getJobResult(job);
+    engine.releaseJob(job);
+
+    std::cout << "[TEST] files=" << files << " cold prefill=" << cold.timing.prefill_ms << "ms warm prefill="
+              << warm.timing.prefill_ms << "ms\n";
+    if (warm.text != cold.text) {
+        std::cerr << "[TEST] FAIL restored prefix changed the output: '" << cold.text << "' vs '" << warm.text << "'\n";
+        return 68;
+    }
+    if (warm.timing.prefill_ms >= cold.timing.prefill_ms) {
+        std::cout << "[TEST] WARN restored run was not faster to prefill\n";
+    }
+
+    std::filesystem::remove_all(dir);
+    std::cout << "[TEST] OK prefix cache persistence\n";
+    return 0;
+}
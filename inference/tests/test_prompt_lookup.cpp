@@ -0,0 +1,41 @@
+#include "test_common.h"
+
+// Loads a model with prompt-lookup drafting and asks it to copy a passage from the
+// prompt. Drafts must be verified without a draft model, and a request that turns
+// lookup off must not draft.
+int main(int argc, char **argv) {
+    if (argc < 2) { std::cerr << "Usage: " << argv[0] << " <model.gguf>\n"; return 64; }
+
+    InferenceEngine engine;
+    LoadingParameters lp; lp.n_ctx = 1024; lp.n_keep = 512; lp.n_parallel = 1; lp.n_batch = 256; lp.n_ubatch = 64; lp.n_gpu_layers = 100;
+    lp.prompt_lookup = true; lp.n_draft = 8;
+    if (!engine.loadModel(argv[1], lp)) { std::cerr << "[TEST] Failed to load model\n"; return 65; }
+
+    CompletionParameters p;
+    p.prompt = "Text: The quick brown fox jumps over the lazy dog near the quiet river bank.\n"
+               "Copy the text exactly.\nCopy: The quick brown fox";
+    p.maxNewTokens = 32; p.temperature = 0.0f; p.topP = 1.0f; p.seqId = 0;
+    int job = engine.submitCompletionsJob(p);
+    if (job < 0) { std::cerr << "[TEST] submit failed\n"; return 66; }
+    if (!wait_for_completion(engine, job, 60000)) { std::cerr << "[TEST] job failed: " << engine.getJobError(job) << "\n"; return 67; }
+    auto r = engine.getJobResult(job);
+    if (r.tokens.empty()) { std::cerr << "[TEST] no tokens generated\n"; return 68; }
+    if (static_cast<int>(r.tokens.size()) > p.maxNewTokens) { std::cerr << "[TEST] generated more than maxNewTokens\n"; return 69; }
+    if (r.draft_token_count <= 0) { std::cerr << "[TEST] no lookup drafts were verified\n"; return 70; }
+
+    p.promptLookup = 0;
+    int plain = engine.submitCompletionsJob(p);
+    if (plain < 0) { std::cerr << "[TEST] submit failed\n"; return 66; }
+    if (!wait_for_completion(engine, plain, 60000)) { std::cerr << "[TEST] job failed: " << engine.getJobError(plain) << "\n"; return 67; }
+    auto q = engine.getJobResult(plain);
+    if (q.draft_token_count != 0) { std::cerr << "[TEST] drafted with prompt lookup off\n"; return 71; }
+    if (q.text != r.text) {
+        // verification batches differ in shape, which can flip near-tied greedy picks
+        std::cout << "[TEST] WARN greedy output differs: '" << r.text << "' vs '" << q.text << "'\n";
+    }
+
+    std::cout << r.text << "\n";
+    std::cout << "[TEST] OK prompt lookup tokens=" << r.tokens.size() << " drafts=" << r.draft_token_count
+              << " accepted=" << r.draft_accepted_count << " rate=" << r.draft_acceptance_rate << " tps=" << r.tps << "\n";
+    return 0;
+}
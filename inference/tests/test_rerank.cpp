@@ -0,0 +1,33 @@
+#include "test_common.h"
+
+int main(int argc, char **argv) {
+    if (argc < 2) { std::cerr << "Usage: " << argv[0] << " <reranker-model.gguf>\n"; return 64; }
+    InferenceEngine engine;
+    LoadingParameters lp; lp.n_ctx = 2048; lp.n_parallel = 4; lp.n_batch = 512; lp.n_ubatch = 512; lp.n_gpu_layers = 100;
+    if (!engine.loadRerankModel(argv[1], lp)) { std::cerr << "[TEST] load fail\n"; return 65; }
+
+    const std::string query = "What is the capital of France?";
+    std::vector<std::string> docs = {
+        "Bananas are rich in potassium.",
+        "Paris is the capital and largest city of France.",
+        "The stock market closed higher today.",
+        "France borders Spain, Italy and Germany.",
+    };
+
+    std::vector<RerankResult> all;
+    try { all = engine.rerank(query, docs); }
+    catch (const std::exception &e) { std::cerr << "[TEST] rerank failed: " << e.what() << "\n"; return 66; }
+    if (all.size() != docs.size()) { std::cerr << "[TEST] rerank returned " << all.size() << " results\n"; return 67; }
+    for (size_t i = 1; i < all.size(); ++i) {
+        if (all[i - 1].score < all[i].score) { std::cerr << "[TEST] results not sorted\n"; return 68; }
+    }
+    if (all[0].index != 1) { std::cerr << "[TEST] best document is " << all[0].index << ", expected 1\n"; return 69; }
+
+    // top-k returns the same head without sorting the tail
+    auto top = engine.rerank(query, docs, 2);
+    if (top.size() != 2 || top[0].index != all[0].index || top[1].index != all[1].index) {
+        std::cerr << "[TEST] top-2 differs from the full ranking\n"; return 70;
+    }
+
+    std::cout << "[TEST] OK rerank best=" << all[0].index << " score=" << all[0].score << "\n"; return 0;
+}
@@ -0,0 +1,71 @@
+#include "test_common.h"
+
+// Live migration: a generation suspended on one engine continues on a second engine of the same
+// model from the exported KV state, and the two parts together must match an uninterrupted run.
+// Conversations parked in warm slots move the same way through exportSessions/importSession.
+int main(int argc, char **argv) {
+    if (argc < 2) { std::cerr << "Usage: " << argv[0] << " <model.gguf>\n"; return 64; }
+    const char *model = argv[1];
+
+    InferenceEngine source; if (!load_test_model(source, model)) { std::cerr << "[TEST] source load fail\n"; return 65; }
+    InferenceEngine target; if (!load_test_model(target, model)) { std::cerr << "[TEST] target load fail\n"; return 65; }
+
+    CompletionParameters params; params.maxNewTokens = 32; params.temperature = 0.0f; params.topP = 1.0f;
+    params.prompt = "The three primary colors of light are red, green and blue. Mixing all of them gives";
+
+    int ref = target.submitCompletionsJob(params);
+    if (!wait_for_completion(target, ref, 30000)) { std::cerr << "[TEST] reference failed: " << target.getJobError(ref) << "\n"; return 66; }
+    const CompletionResult expected = target.getJobResult(ref);
+    target.releaseJob(ref);
+    if (expected.tokens.size() < 12) { std::cerr << "[TEST] reference too short to suspend midway\n"; return 66; }
+
+    // Suspend after a few tokens
+    CompletionParameters streamed = params; streamed.streaming = true;
+    int sj = source.submitCompletionsJob(streamed);
+    size_t seen = 0; CompletionDelta delta;
+    while (seen < 6 && source.waitForJobOutput(sj, delta, 5000) && !delta.finished) seen += delta.tokens.size();
+    source.suspendJob(sj);
+    if (!source.waitForJob(sj, 30000)) { std::cerr << "[TEST] suspended job did not finish\n"; return 67; }
+    const CompletionResult first = source.getJobResult(sj);
+    if (!first.suspended) { std::cerr << "[TEST] job not marked suspended\n"; return 68; }
+    std::shared_ptr<const KvSequenceState> state = source.getJobKvState(sj);
+    source.releaseJob(sj);
+    if (!state || state->tokens.size() != static_cast<size_t>(first.prompt_token_count) + first.tokens.size()) {
+        std::cerr << "[TEST] suspended job left no KV state of its prompt and output\n"; return 69;
+    }
+
+    CompletionParameters resumed = params;
+    resumed.kvState = state; resumed.resumeFromKvState = true;
+    resumed.maxNewTokens = params.maxNewTokens - static_cast<int>(first.tokens.size());
+    int rj = target.submitCompletionsJob(resumed);
+    if (!wait_for_completion(target, rj, 30000)) { std::cerr << "[TEST] resumed job failed: " << target.getJobError(rj) << "\n"; return 70; }
+    const CompletionResult rest = target.getJobResult(rj);
+    target.releaseJob(rj);
+    if (first.text + rest.text != expected.text) {
+        std::cerr << "[TEST] migrated output differs\n  expected: " << expected.text << "\n  got:      " << first.text << "|" << rest.text << "\n";
+        return 71;
+    }
+
+    // A warm conversation moves to the other engine
+    ChatCompletionParameters chat; chat.maxNewTokens = 8; chat.temperature = 0.0f; chat.topP = 1.0f;
+    chat.sessionKey = "migrated-conversation";
+    chat.messages = { {"user", "Name a planet."} };
+    int cj = source.submitChatCompletionsJob(chat);
+    if (!wait_for_completion(source, cj, 30000)) { std::cerr << "[TEST] chat failed: " << source.getJobError(cj) << "\n"; return 72; }
+    source.releaseJob(cj);
+
+    auto sessions = source.exportSessions();
+    if (sessions.size() != 1 || sessions[0].first != chat.sessionKey || !sessions[0].second) {
+        std::cerr << "[TEST] expected one exported session, got " << sessions.size() << "\n"; return 73;
+    }
+    if (!source.exportSessions().empty()) { std::cerr << "[TEST] session still held after export\n"; return 74; }
+    if (!target.importSession(sessions[0].first, sessions[0].second)) { std::cerr << "[TEST] import refused\n"; return 75; }
+    auto adopted = target.exportSessions();
+    if (adopted.size() != 1 || adopted[0].first != chat.sessionKey || adopted[0].second->tokens != sessions[0].second->tokens) {
+        std::cerr << "[TEST] imported session not held by the target\n"; return 76;
+    }
+
+    std::cout << "[TEST] suspended after " << first.tokens.size() << " tokens, state=" << state->state.size() << " bytes\n";
+    std::cout << "[TEST] OK session migration\n";
+    return 0;
+}
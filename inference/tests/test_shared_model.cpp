@@ -0,0 +1,32 @@
+#include "test_common.h"
+
+// Loads the same model into two engines with different context sizes; both share
+// one set of weights and must keep working after the other one is unloaded.
+static bool complete(InferenceEngine &engine, const char *tag) {
+    CompletionParameters p; p.prompt = "The capital of France is"; p.maxNewTokens = 16; p.temperature = 0.0f; p.seqId = 0;
+    int job = engine.submitCompletionsJob(p);
+    if (job < 0 || !wait_for_completion(engine, job, 60000)) {
+        std::cerr << "[TEST] " << tag << " job failed: " << (job < 0 ? "submit" : engine.getJobError(job)) << "\n";
+        return false;
+    }
+    auto r = engine.getJobResult(job);
+    engine.releaseJob(job);
+    if (r.tokens.empty()) { std::cerr << "[TEST] " << tag << " generated no tokens\n"; return false; }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) { std::cerr << "Usage: " << argv[0] << " <model.gguf>\n"; return 64; }
+
+    InferenceEngine a, b;
+    if (!load_test_model(a, argv[1])) { std::cerr << "[TEST] Failed to load first engine\n"; return 65; }
+    LoadingParameters lp; lp.n_ctx = 2048; lp.n_keep = 512; lp.n_parallel = 2; lp.n_batch = 256; lp.n_ubatch = 64; lp.n_gpu_layers = 100;
+    if (!b.loadModel(argv[1], lp)) { std::cerr << "[TEST] Failed to load second engine\n"; return 66; }
+
+    if (!complete(a, "first") || !complete(b, "second")) return 67;
+    if (!a.unloadModel()) { std::cerr << "[TEST] unload failed\n"; return 68; }
+    if (!complete(b, "second after unload")) return 69;
+
+    std::cout << "[TEST] OK shared model\n";
+    return 0;
+}
@@ -0,0 +1,27 @@
+#include "test_common.h"
+
+// Loads a target model with a draft model attached and checks that greedy
+// speculative decoding produces output and reports draft acceptance.
+int main(int argc, char **argv) {
+    if (argc < 3) { std::cerr << "Usage: " << argv[0] << " <model.gguf> <draft.gguf>\n"; return 64; }
+
+    InferenceEngine engine;
+    LoadingParameters lp; lp.n_ctx = 1024; lp.n_keep = 512; lp.n_parallel = 1; lp.n_batch = 256; lp.n_ubatch = 64; lp.n_gpu_layers = 100;
+    lp.draft_model_path = argv[2]; lp.n_draft = 8;
+    if (!engine.loadModel(argv[1], lp)) { std::cerr << "[TEST] Failed to load model\n"; return 65; }
+
+    CompletionParameters p; p.prompt = "def fibonacci(n):\n    \"\"\"Return the n-th Fibonacci number.\"\"\"\n"; p.maxNewTokens = 64; p.temperature = 0.0f; p.topP = 1.0f; p.seqId = 0;
+    int job = engine.submitCompletionsJob(p);
+    if (job < 0) { std::cerr << "[TEST] submit failed\n"; return 66; }
+    if (!wait_for_completion(engine, job, 60000)) { std::cerr << "[TEST] job failed: " << engine.getJobError(job) << "\n"; return 67; }
+
+    auto r = engine.getJobResult(job);
+    if (r.tokens.empty()) { std::cerr << "[TEST] no tokens generated\n"; return 68; }
+    if (static_cast<int>(r.tokens.size()) > p.maxNewTokens) { std::cerr << "[TEST] generated more than maxNewTokens\n"; return 69; }
+    if (r.draft_token_count <= 0) { std::cerr << "[TEST] no drafts were verified\n"; return 70; }
+
+    std::cout << r.text << "\n";
+    std::cout << "[TEST] OK speculative tokens=" << r.tokens.size() << " drafts=" << r.draft_token_count
+              << " accepted=" << r.draft_accepted_count << " rate=" << r.draft_acceptance_rate << " tps=" << r.tps << "\n";
+    return 0;
+}
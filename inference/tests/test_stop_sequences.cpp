@@ -0,0 +1,36 @@
+#include "test_common.h"
+
+// Generates a comma separated list with "," as a stop sequence. The engine must end the
+// job at the first comma, return the text before it, and stream exactly that text.
+int main(int argc, char **argv) {
+    if (argc < 2) { std::cerr << "Usage: " << argv[0] << " <model.gguf>\n"; return 64; }
+
+    InferenceEngine engine;
+    if (!load_test_model(engine, argv[1])) { std::cerr << "[TEST] Failed to load model\n"; return 65; }
+
+    CompletionParameters p; p.prompt = "Fruits: apple, banana, cherry,"; p.maxNewTokens = 64; p.temperature = 0.0f; p.topP = 1.0f; p.seqId = 0;
+    p.stop = { ",", "\n\n" };
+    int job = engine.submitCompletionsJob(p);
+    if (job < 0) { std::cerr << "[TEST] submit failed\n"; return 66; }
+
+    std::string streamed;
+    CompletionDelta delta;
+    while (engine.waitForJobOutput(job, delta, 30000)) {
+        streamed += delta.text;
+        if (delta.finished) break;
+    }
+    if (engine.hasJobError(job)) { std::cerr << "[TEST] job failed: " << engine.getJobError(job) << "\n"; return 67; }
+
+    auto r = engine.getJobResult(job);
+    if (r.tokens.empty()) { std::cerr << "[TEST] no tokens generated\n"; return 68; }
+    if (r.text.find(',') != std::string::npos || r.text.find("\n\n") != std::string::npos) {
+        std::cerr << "[TEST] stop sequence returned in output: " << r.text << "\n"; return 69;
+    }
+    if (streamed != r.text) { std::cerr << "[TEST] streamed text differs: '" << streamed << "' vs '" << r.text << "'\n"; return 70; }
+    if (static_cast<int>(r.tokens.size()) >= p.maxNewTokens) {
+        std::cout << "[TEST] WARN generation ran to maxNewTokens, no stop sequence was produced\n";
+    }
+
+    std::cout << "[TEST] OK stop sequences tokens=" << r.tokens.size() << " text='" << r.text << "'\n";
+    return 0;
+}
@@ -0,0 +1,48 @@
+#include "test_common.h"
+#include <cstdlib>
+
+// Verifies that waitForJobOutput() hands out every token exactly once and that
+// the concatenated deltas match the final result.
+int main(int argc, char **argv) {
+    if (argc < 3) { std::cerr << "Usage: " << argv[0] << " <model.gguf> <prompt>\n"; return 64; }
+    const char *model = argv[1]; std::string prompt = argv[2];
+
+    InferenceEngine engine;
+    if (!load_test_model(engine, model)) { std::cerr << "[TEST] Failed to load model\n"; return 65; }
+
+    CompletionParameters p; p.prompt = prompt; p.maxNewTokens = 32; p.temperature = 0.7f; p.topP = 0.9f; p.streaming = true; p.seqId = 0;
+    int job = engine.submitCompletionsJob(p);
+    if (job < 0) { std::cerr << "[TEST] submit failed\n"; return 66; }
+
+    std::string streamedText;
+    std::vector<int32_t> streamedTokens;
+    int deltas = 0;
+    auto start = std::chrono::steady_clock::now();
+    const int timeout_ms = 20000;
+
+    CompletionDelta delta;
+    while (engine.waitForJobOutput(job, delta, 500)) {
+        if (delta.hasError) { std::cerr << "[TEST] job error: " << delta.errorMessage << "\n"; return 67; }
+        if (!delta.text.empty()) {
+            std::cout << delta.text;
+            std::cout.flush();
+            ++deltas;
+        }
+        streamedText += delta.text;
+        streamedTokens.insert(streamedTokens.end(), delta.tokens.begin(), delta.tokens.end());
+        if (delta.finished) break;
+        if (std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count() > timeout_ms) {
+            std::cerr << "\n[TEST] Timeout waiting for streaming result" << std::endl;
+            return 67;
+        }
+    }
+    std::cout << "\n";
+
+    auto r = engine.getJobResult(job);
+    if (r.tokens.empty()) { std::cerr << "[TEST] no tokens generated\n"; return 68; }
+    if (streamedText != r.text) { std::cerr << "[TEST] streamed text does not match final result\n"; return 69; }
+    if (streamedTokens != r.tokens) { std::cerr << "[TEST] streamed tokens do not match final result\n"; return 70; }
+
+    std::cout << "[TEST] OK streaming deltas=" << deltas << " tokens=" << r.tokens.size() << "\n";
+    return 0;
+}
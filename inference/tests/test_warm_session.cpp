@@ -0,0 +1,44 @@
+#include "test_common.h"
+
+// Two chat turns sharing a sessionKey with another conversation in between.
+// The second turn of the keyed conversation should get its warm slot back and
+// only decode the new suffix, without any kvCacheFilePath file.
+static bool run_chat(InferenceEngine &engine, const ChatCompletionParameters &params, CompletionResult &out) {
+    int job = engine.submitChatCompletionsJob(params);
+    if (job < 0) { std::cerr << "[TEST] submit failed\n"; return false; }
+    if (!wait_for_completion(engine, job, 30000)) { std::cerr << "[TEST] job failed: " << engine.getJobError(job) << "\n"; return false; }
+    out = engine.getJobResult(job);
+    return !out.tokens.empty();
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) { std::cerr << "Usage: " << argv[0] << " <model.gguf>\n"; return 64; }
+    const char *model = argv[1];
+
+    InferenceEngine engine; if (!load_test_model(engine, model, /*n_parallel=*/2)) { std::cerr << "[TEST] load fail\n"; return 65; }
+
+    ChatCompletionParameters turn1; turn1.maxNewTokens = 16; turn1.temperature = 0.0f; turn1.topP = 1.0f; turn1.sessionKey = "conversation-a";
+    turn1.messages.push_back({"system", "You are a concise assistant. Keep every answer to one short sentence."});
+    turn1.messages.push_back({"user", "Remember the keyword ZEBRA-ALPHA. Just say OK."});
+
+    CompletionResult r1;
+    if (!run_chat(engine, turn1, r1)) return 66;
+
+    // Unrelated conversation in between must not steal the warm slot while a cold one is free
+    ChatCompletionParameters other; other.maxNewTokens = 8; other.temperature = 0.0f; other.topP = 1.0f; other.sessionKey = "conversation-b";
+    other.messages.push_back({"user", "Say hello."});
+    CompletionResult rOther;
+    if (!run_chat(engine, other, rOther)) return 67;
+
+    ChatCompletionParameters turn2 = turn1;
+    turn2.messages.push_back({"assistant", r1.text});
+    turn2.messages.push_back({"user", "What was the keyword?"});
+
+    CompletionResult r2;
+    if (!run_chat(engine, turn2, r2)) return 68;
+
+    std::cout << "[TEST] turn1 ttft=" << r1.ttft << "ms turn2 ttft=" << r2.ttft << "ms\n";
+    std::cout << "[TEST] turn2: " << r2.text << "\n";
+    std::cout << "[TEST] OK warm session\n";
+    return 0;
+}
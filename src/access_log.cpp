@@ -0,0 +1,461 @@
+#include "kolosal/access_log.hpp"
+#include "kolosal/logger.hpp"
+#include "kolosal/sha256.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <json.hpp>
+
+using json = nlohmann::json;
+
+namespace kolosal
+{
+    namespace access_log
+    {
+
+        namespace
+        {
+            constexpr size_t kBatchRecords = 1024;     // Write as soon as this many records are queued
+            constexpr size_t kMaxQueuedRecords = 65536; // Beyond this records are dropped rather than stall requests
+            constexpr auto kFlushInterval = std::chrono::seconds(1);
+
+            // Binary files start with this magic and a format version byte
+            constexpr char kMagic[4] = {'K', 'A', 'C', 'L'};
+            constexpr uint8_t kVersion = 1;
+
+            struct PendingRecord
+            {
+                AccessRecord record;
+                std::string apiKey;
+            };
+
+            struct Usage
+            {
+                std::string model;
+                uint64_t promptTokens = 0;
+                uint64_t completionTokens = 0;
+            };
+
+            thread_local Usage t_usage;
+
+            double uniform()
+            {
+                thread_local std::mt19937_64 engine(std::random_device{}() ^
+                                                    std::hash<std::thread::id>{}(std::this_thread::get_id()));
+                return std::uniform_real_distribution<double>(0.0, 1.0)(engine);
+            }
+
+            uint64_t hashApiKey(const std::string &apiKey)
+            {
+                if (apiKey.empty())
+                    return 0;
+                Sha256 sha;
+                sha.update(apiKey.data(), apiKey.size());
+                return std::stoull(sha.hexDigest().substr(0, 16), nullptr, 16);
+            }
+
+            std::string hex64(uint64_t value)
+            {
+                static const char kDigits[] = "0123456789abcdef";
+                std::string out(16, '0');
+                for (int i = 15; i >= 0; --i, value >>= 4)
+                    out[i] = kDigits[value & 0xf];
+                return out;
+            }
+
+            // LEB128: small numbers, which most fields are, take one or two bytes
+            void putVarint(std::string &out, uint64_t value)
+            {
+                while (value >= 0x80)
+                {
+                    out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+                    value >>= 7;
+                }
+                out.push_back(static_cast<char>(value));
+            }
+
+            void putString(std::string &out, const std::string &value)
+            {
+                putVarint(out, value.size());
+                out.append(value);
+            }
+
+            bool getVarint(const std::string &in, size_t &pos, uint64_t &value)
+            {
+                value = 0;
+                for (int shift = 0; shift < 64 && pos < in.size(); shift += 7)
+                {
+                    const uint8_t byte = static_cast<uint8_t>(in[pos++]);
+                    value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+                    if (!(byte & 0x80))
+                        return true;
+                }
+                return false;
+            }
+
+            bool getString(const std::string &in, size_t &pos, std::string &value)
+            {
+                uint64_t size = 0;
+                if (!getVarint(in, pos, size) || size > in.size() - pos)
+                    return false;
+                value.assign(in, pos, static_cast<size_t>(size));
+                pos += static_cast<size_t>(size);
+                return true;
+            }
+
+            // Record layout: varint payload length, then the payload fields in declaration
+            // order; integers as varints, the key hash as 8 little-endian bytes, strings length-prefixed
+            void encodeBinary(std::string &out, const AccessRecord &record)
+            {
+                std::string payload;
+                payload.reserve(64 + record.route.size() + record.model.size() + record.clientIp.size() + record.traceId.size());
+                putVarint(payload, record.timestampUs);
+                putVarint(payload, record.latencyUs);
+                putVarint(payload, record.status);
+                putString(payload, record.method);
+                putString(payload, record.route);
+                putString(payload, record.model);
+                putVarint(payload, record.bytesIn);
+                putVarint(payload, record.bytesOut);
+                putVarint(payload, record.promptTokens);
+                putVarint(payload, record.completionTokens);
+                for (int i = 0; i < 8; ++i)
+                    payload.push_back(static_cast<char>((record.apiKeyHash >> (8 * i)) & 0xff));
+                putString(payload, record.clientIp);
+                putString(payload, record.traceId);
+
+                putVarint(out, payload.size());
+                out.append(payload);
+            }
+
+            bool decodeBinary(const std::string &payload, AccessRecord &record)
+            {
+                size_t pos = 0;
+                uint64_t value = 0;
+                if (!getVarint(payload, pos, record.timestampUs))
+                    return false;
+                if (!getVarint(payload, pos, value))
+                    return false;
+                record.latencyUs = static_cast<uint32_t>(value);
+                if (!getVarint(payload, pos, value))
+                    return false;
+                record.status = static_cast<uint16_t>(value);
+                if (!getString(payload, pos, record.method) || !getString(payload, pos, record.route) ||
+                    !getString(payload, pos, record.model))
+                    return false;
+                if (!getVarint(payload, pos, record.bytesIn) || !getVarint(payload, pos, record.bytesOut))
+                    return false;
+                if (!getVarint(payload, pos, value))
+                    return false;
+                record.promptTokens = static_cast<uint32_t>(value);
+                if (!getVarint(payload, pos, value))
+                    return false;
+                record.completionTokens = static_cast<uint32_t>(value);
+                if (payload.size() - pos < 8)
+                    return false;
+                record.apiKeyHash = 0;
+                for (int i = 0; i < 8; ++i)
+                    record.apiKeyHash |= static_cast<uint64_t>(static_cast<uint8_t>(payload[pos++])) << (8 * i);
+                return getString(payload, pos, record.clientIp) && getString(payload, pos, record.traceId);
+            }
+
+            // Batches sampled records on a background thread; one write per batch
+            class Writer
+            {
+            public:
+                static Writer &instance()
+                {
+                    static Writer writer;
+                    return writer;
+                }
+
+                void start(const AccessLogConfig &config)
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    if (running_.load())
+                        return;
+                    config_ = config;
+                    binary_ = config_.format == "binary";
+                    if (!open())
+                        return;
+                    stopping_ = false;
+                    running_.store(true);
+                    worker_ = std::thread(&Writer::run, this);
+                }
+
+                void stop()
+                {
+                    {
+                        std::lock_guard<std::mutex> lock(mutex_);
+                        if (!running_.load())
+                            return;
+                        running_.store(false);
+                        stopping_ = true;
+                    }
+                    cv_.notify_all();
+                    if (worker_.joinable())
+                        worker_.join();
+                    if (file_.is_open())
+                        file_.close();
+                }
+
+                bool running() const { return running_.load(std::memory_order_relaxed); }
+
+                bool sampled(int status) const
+                {
+                    if (status >= 400 && config_.always_log_errors)
+                        return true;
+                    return config_.sample_rate >= 1.0 || (config_.sample_rate > 0.0 && uniform() < config_.sample_rate);
+                }
+
+                void submit(PendingRecord &&record)
+                {
+                    bool notify = false;
+                    {
+                        std::lock_guard<std::mutex> lock(mutex_);
+                        if (queue_.size() >= kMaxQueuedRecords)
+                        {
+                            ++dropped_;
+                            return;
+                        }
+                        queue_.push_back(std::move(record));
+                        notify = queue_.size() >= kBatchRecords;
+                    }
+                    if (notify)
+                        cv_.notify_one();
+                }
+
+            private:
+                bool open()
+                {
+                    file_.open(config_.file, std::ios::app | std::ios::binary);
+                    if (!file_)
+                    {
+                        KOLOSAL_LOG_WARNING("Could not open access log %s", config_.file.c_str());
+                        return false;
+                    }
+                    std::error_code ec;
+                    size_ = std::filesystem::exists(config_.file, ec) ? std::filesystem::file_size(config_.file, ec) : 0;
+                    if (ec)
+                        size_ = 0;
+                    if (binary_ && size_ == 0)
+                    {
+                        file_.write(kMagic, sizeof(kMagic));
+                        file_.put(static_cast<char>(kVersion));
+                        size_ = sizeof(kMagic) + 1;
+                    }
+                    return true;
+                }
+
+                // file -> file.1 -> file.2 ...; the oldest beyond max_files is removed
+                void rotate()
+                {
+                    file_.close();
+                    std::error_code ec;
+                    const std::string &base = config_.file;
+                    if (config_.max_files <= 0)
+                    {
+                        std::filesystem::remove(base, ec);
+                    }
+                    else
+                    {
+                        std::filesystem::remove(base + "." + std::to_string(config_.max_files), ec);
+                        for (int i = config_.max_files - 1; i >= 1; --i)
+                            std::filesystem::rename(base + "." + std::to_string(i), base + "." + std::to_string(i + 1), ec);
+                        std::filesystem::rename(base, base + ".1", ec);
+                    }
+                    if (!open())
+                        KOLOSAL_LOG_WARNING("Access log rotation failed, records are being discarded");
+                }
+
+                void run()
+                {
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    while (true)
+                    {
+                        cv_.wait_for(lock, kFlushInterval, [this]
+                                     { return stopping_ || queue_.size() >= kBatchRecords; });
+                        std::vector<PendingRecord> batch(std::make_move_iterator(queue_.begin()),
+                                                         std::make_move_iterator(queue_.end()));
+                        queue_.clear();
+                        const uint64_t dropped = std::exchange(dropped_, 0);
+                        const bool last = stopping_;
+                        lock.unlock();
+
+                        if (dropped > 0)
+                            KOLOSAL_LOG_WARNING("Access log dropped %llu records, writer is falling behind",
+                                                     static_cast<unsigned long long>(dropped));
+                        if (!batch.empty())
+                            writeBatch(batch);
+
+                        lock.lock();
+                        if (last)
+                            break;
+                    }
+                }
+
+                void writeBatch(std::vector<PendingRecord> &batch)
+                {
+                    const uint64_t maxSize = static_cast<uint64_t>(std::max(config_.max_file_mb, 0)) * 1024 * 1024;
+                    std::string buffer;
+                    buffer.reserve(batch.size() * (binary_ ? 96 : 320));
+                    for (auto &pending : batch)
+                    {
+                        pending.record.apiKeyHash = hashApiKey(pending.apiKey);
+                        if (binary_)
+                        {
+                            encodeBinary(buffer, pending.record);
+                        }
+                        else
+                        {
+                            buffer += to_json(pending.record);
+                            buffer += '\n';
+                        }
+                        // A large batch may cross the size limit; rotate where it does
+                        if (maxSize > 0 && size_ + buffer.size() >= maxSize)
+                        {
+                            write(buffer);
+                            rotate();
+                        }
+                    }
+                    write(buffer);
+                }
+
+                void write(std::string &buffer)
+                {
+                    if (file_.is_open() && !buffer.empty())
+                    {
+                        file_.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+                        file_.flush();
+                        size_ += buffer.size();
+                    }
+                    buffer.clear();
+                }
+
+                AccessLogConfig config_;
+                bool binary_ = false;
+                std::ofstream file_;
+                uint64_t size_ = 0;
+                std::atomic<bool> running_{false};
+                bool stopping_ = false;
+                std::deque<PendingRecord> queue_;
+                uint64_t dropped_ = 0;
+                std::mutex mutex_;
+                std::condition_variable cv_;
+                std::thread worker_;
+            };
+        } // namespace
+
+        void start(const AccessLogConfig &config)
+        {
+            Writer::instance().start(config);
+        }
+
+        void stop()
+        {
+            Writer::instance().stop();
+        }
+
+        bool enabled()
+        {
+            return Writer::instance().running();
+        }
+
+        void begin_request()
+        {
+            t_usage.model.clear();
+            t_usage.promptTokens = 0;
+            t_usage.completionTokens = 0;
+        }
+
+        void record_usage(const std::string &model, size_t promptTokens, size_t completionTokens)
+        {
+            if (!enabled())
+                return;
+            t_usage.model = model;
+            t_usage.promptTokens += promptTokens;
+            t_usage.completionTokens += completionTokens;
+        }
+
+        void finish_request(AccessRecord &&record, std::string apiKey)
+        {
+            Writer &writer = Writer::instance();
+            if (!writer.running() || !writer.sampled(record.status))
+                return;
+            record.model = t_usage.model;
+            record.promptTokens = static_cast<uint32_t>(std::min<uint64_t>(t_usage.promptTokens, UINT32_MAX));
+            record.completionTokens = static_cast<uint32_t>(std::min<uint64_t>(t_usage.completionTokens, UINT32_MAX));
+            writer.submit(PendingRecord{std::move(record), std::move(apiKey)});
+        }
+
+        std::string to_json(const AccessRecord &record)
+        {
+            json j = {
+                {"ts_us", record.timestampUs},
+                {"latency_us", record.latencyUs},
+                {"status", record.status},
+                {"method", record.method},
+                {"route", record.route},
+                {"bytes_in", record.bytesIn},
+                {"bytes_out", record.bytesOut},
+                {"client_ip", record.clientIp}};
+            if (!record.model.empty())
+            {
+                j["model"] = record.model;
+                j["prompt_tokens"] = record.promptTokens;
+                j["completion_tokens"] = record.completionTokens;
+            }
+            if (record.apiKeyHash != 0)
+                j["api_key_hash"] = hex64(record.apiKeyHash);
+            if (!record.traceId.empty())
+                j["trace_id"] = record.traceId;
+            return j.dump(-1, ' ', false, json::error_handler_t::replace);
+        }
+
+        bool read_binary(std::istream &in, const std::function<bool(const AccessRecord &)> &onRecord)
+        {
+            char header[sizeof(kMagic) + 1];
+            if (!in.read(header, sizeof(header)) || !std::equal(kMagic, kMagic + sizeof(kMagic), header) ||
+                static_cast<uint8_t>(header[sizeof(kMagic)]) != kVersion)
+                return false;
+
+            std::string payload;
+            while (true)
+            {
+                uint64_t size = 0;
+                int shift = 0;
+                int c = in.get();
+                if (c == std::char_traits<char>::eof())
+                    return true;
+                while (true)
+                {
+                    size |= static_cast<uint64_t>(c & 0x7f) << shift;
+                    if (!(c & 0x80))
+                        break;
+                    shift += 7;
+                    c = in.get();
+                    if (c == std::char_traits<char>::eof() || shift >= 64)
+                        return false;
+                }
+
+                payload.resize(static_cast<size_t>(size));
+                AccessRecord record;
+                if (!in.read(&payload[0], static_cast<std::streamsize>(size)) || !decodeBinary(payload, record))
+                    return false;
+                if (!onRecord(record))
+                    return true;
+            }
+        }
+
+    } // namespace access_log
+} // namespace kolosal
@@ -0,0 +1,163 @@
+// Converts access logs written by kolosal-server into NDJSON or CSV for analysis.
+//
+//   kolosal-access-log [--format ndjson|csv] <access.log> [more files...]
+//
+// Binary and NDJSON logs are both accepted; rotated files can be passed together.
+
+#include "kolosal/access_log.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <json.hpp>
+
+using json = nlohmann::json;
+using kolosal::access_log::AccessRecord;
+
+namespace
+{
+    void printUsage()
+    {
+        std::cerr << "Usage: kolosal-access-log [--format ndjson|csv] <file>...\n"
+                  << "Converts binary or NDJSON access logs to NDJSON (default) or CSV on stdout.\n";
+    }
+
+    std::string csvField(const std::string &value)
+    {
+        if (value.find_first_of(",\"\n") == std::string::npos)
+            return value;
+        std::string quoted = "\"";
+        for (char c : value)
+        {
+            if (c == '"')
+                quoted += '"';
+            quoted += c;
+        }
+        return quoted + "\"";
+    }
+
+    void writeCsvHeader()
+    {
+        std::cout << "ts_us,latency_us,status,method,route,model,bytes_in,bytes_out,"
+                     "prompt_tokens,completion_tokens,api_key_hash,client_ip,trace_id\n";
+    }
+
+    void writeCsv(const json &j)
+    {
+        auto field = [&j](const char *name) -> std::string
+        {
+            auto it = j.find(name);
+            if (it == j.end() || it->is_null())
+                return "";
+            return it->is_string() ? csvField(it->get<std::string>()) : it->dump();
+        };
+        std::cout << field("ts_us") << ',' << field("latency_us") << ',' << field("status") << ','
+                  << field("method") << ',' << field("route") << ',' << field("model") << ','
+                  << field("bytes_in") << ',' << field("bytes_out") << ',' << field("prompt_tokens") << ','
+                  << field("completion_tokens") << ',' << field("api_key_hash") << ','
+                  << field("client_ip") << ',' << field("trace_id") << '\n';
+    }
+
+    bool isBinaryLog(std::istream &in)
+    {
+        char magic[4] = {};
+        in.read(magic, sizeof(magic));
+        in.clear();
+        in.seekg(0);
+        return std::memcmp(magic, "KACL", sizeof(magic)) == 0;
+    }
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    bool csv = false;
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--format" && i + 1 < argc)
+        {
+            std::string format = argv[++i];
+            if (format != "ndjson" && format != "csv")
+            {
+                printUsage();
+                return 1;
+            }
+            csv = format == "csv";
+        }
+        else if (arg == "--help" || arg == "-h")
+        {
+            printUsage();
+            return 0;
+        }
+        else
+        {
+            files.push_back(arg);
+        }
+    }
+    if (files.empty())
+    {
+        printUsage();
+        return 1;
+    }
+
+    std::ios::sync_with_stdio(false);
+    if (csv)
+        writeCsvHeader();
+
+    auto emit = [csv](const json &j)
+    {
+        if (csv)
+            writeCsv(j);
+        else
+            std::cout << j.dump() << '\n';
+    };
+
+    int status = 0;
+    for (const auto &path : files)
+    {
+        std::ifstream in(path, std::ios::binary);
+        if (!in)
+        {
+            std::cerr << "Cannot open " << path << std::endl;
+            status = 1;
+            continue;
+        }
+
+        if (isBinaryLog(in))
+        {
+            const bool complete = kolosal::access_log::read_binary(in, [&](const AccessRecord &record)
+                                                                   {
+                emit(json::parse(kolosal::access_log::to_json(record)));
+                return true; });
+            if (!complete)
+            {
+                // The newest file may end mid-record while the server is writing it
+                std::cerr << path << ": truncated or corrupt record, stopped reading" << std::endl;
+                status = 1;
+            }
+            continue;
+        }
+
+        std::string line;
+        size_t lineNumber = 0;
+        while (std::getline(in, line))
+        {
+            ++lineNumber;
+            if (line.empty())
+                continue;
+            try
+            {
+                emit(json::parse(line));
+            }
+            catch (const json::parse_error &)
+            {
+                std::cerr << path << ":" << lineNumber << ": not a JSON record, skipped" << std::endl;
+                status = 1;
+            }
+        }
+    }
+    return status;
+}
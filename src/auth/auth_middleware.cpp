@@ -9,29 +9,35 @@ namespace kolosal
 
         AuthMiddleware::AuthMiddleware()
             : rateLimiter_(std::make_unique<RateLimiter>()),
+              tokenQuota_(std::make_unique<TokenQuota>()),
+              tenantShares_(std::make_unique<TenantShares>()),
               corsHandler_(std::make_unique<CorsHandler>()),
               apiKeyConfig_()
         {
-            ServerLogger::logInfo("Authentication middleware initialized with default configuration");
+            KOLOSAL_LOG_INFO("Authentication middleware initialized with default configuration");
         }
 
         AuthMiddleware::AuthMiddleware(const RateLimiter::Config &rateLimiterConfig)
             : rateLimiter_(std::make_unique<RateLimiter>(rateLimiterConfig)),
+              tokenQuota_(std::make_unique<TokenQuota>()),
+              tenantShares_(std::make_unique<TenantShares>()),
               corsHandler_(std::make_unique<CorsHandler>()),
               apiKeyConfig_()
         {
-            ServerLogger::logInfo("Authentication middleware initialized with custom rate limiter config");
+            KOLOSAL_LOG_INFO("Authentication middleware initialized with custom rate limiter config");
         }
 
         AuthMiddleware::AuthMiddleware(const RateLimiter::Config &rateLimiterConfig,
                                        const CorsHandler::Config &corsConfig,
                                        const ApiKeyConfig &apiKeyConfig)
             : rateLimiter_(std::make_unique<RateLimiter>(rateLimiterConfig)),
+              tokenQuota_(std::make_unique<TokenQuota>()),
+              tenantShares_(std::make_unique<TenantShares>()),
               corsHandler_(std::make_unique<CorsHandler>(corsConfig)),
               apiKeyConfig_(apiKeyConfig)
         {
 
-            ServerLogger::logInfo("Authentication middleware initialized with API key auth: %s",
+            KOLOSAL_LOG_INFO("Authentication middleware initialized with API key auth: %s",
                                   apiKeyConfig_.enabled ? "enabled" : "disabled");
         }
 
@@ -41,22 +47,22 @@ namespace kolosal
             
             // Fast path: if all auth features are disabled, allow immediately
             if (!corsHandler_->getConfig().enabled && 
-                !rateLimiter_->getConfig().enabled && 
+                !rateLimiter_->isEnabled() && 
                 !apiKeyConfig_.enabled) {
                 return result; // Default result allows the request
             }
             
-            ServerLogger::logDebug("Auth middleware processing request: %s %s from %s",
+            KOLOSAL_LOG_REQUEST_DEBUG("Auth middleware processing request: %s %s from %s",
                                   requestInfo.method.c_str(), requestInfo.path.c_str(), requestInfo.clientIP.c_str());
 
             // Process CORS first
             std::string origin = getHeaderValue(requestInfo.headers, "origin");
             std::string requestHeaders = getHeaderValue(requestInfo.headers, "access-control-request-headers");
             std::string requestMethod = getHeaderValue(requestInfo.headers, "access-control-request-method");
-            ServerLogger::logDebug("CORS headers - Origin: %s, Request-Headers: %s, Request-Method: %s",
+            KOLOSAL_LOG_REQUEST_DEBUG("CORS headers - Origin: %s, Request-Headers: %s, Request-Method: %s",
                                   origin.c_str(), requestHeaders.c_str(), requestMethod.c_str());
             auto corsResult = corsHandler_->processCors(requestInfo.method, origin, requestHeaders, requestMethod);
-            ServerLogger::logDebug("CORS result - IsValid: %s, IsPreflight: %s",
+            KOLOSAL_LOG_REQUEST_DEBUG("CORS result - IsValid: %s, IsPreflight: %s",
                                   corsResult.isValid ? "true" : "false",
                                   corsResult.isPreflight ? "true" : "false");
 
@@ -65,7 +71,7 @@ namespace kolosal
                 result.allowed = false;
                 result.statusCode = 403;
                 result.reason = "CORS policy violation";
-                ServerLogger::logWarning("CORS policy violation for request from %s to %s %s",
+                KOLOSAL_LOG_WARNING("CORS policy violation for request from %s to %s %s",
                                          requestInfo.clientIP.c_str(), requestInfo.method.c_str(), requestInfo.path.c_str());
                 return result;
             }
@@ -77,7 +83,7 @@ namespace kolosal
             if (corsResult.isPreflight)
             {
                 result.statusCode = 204; // No Content for successful preflight
-                ServerLogger::logDebug("CORS preflight request approved for %s", requestInfo.clientIP.c_str());
+                KOLOSAL_LOG_REQUEST_DEBUG("CORS preflight request approved for %s", requestInfo.clientIP.c_str());
                 return result;
             }
 
@@ -88,13 +94,15 @@ namespace kolosal
                 result.statusCode = 401; // Unauthorized
                 result.reason = "Invalid or missing API key";
                 result.headers["WWW-Authenticate"] = "ApiKey realm=\"kolosal\"";
-                ServerLogger::logWarning("API key authentication failed for request from %s to %s %s",
+                KOLOSAL_LOG_WARNING("API key authentication failed for request from %s to %s %s",
                                          requestInfo.clientIP.c_str(), requestInfo.method.c_str(), requestInfo.path.c_str());
                 return result;
             }
-            // Process rate limiting
-            auto rateLimitResult = rateLimiter_->checkRateLimit(requestInfo.clientIP);
-            ServerLogger::logDebug("Rate limit result - Allowed: %s, Used: %zu, Remaining: %zu",
+            // Process rate limiting; a request forwarded by a cluster peer was already reported by that peer
+            const bool forwarded = !getHeaderValue(requestInfo.headers, "X-Kolosal-Forwarded").empty();
+            auto rateLimitResult = rateLimiter_->checkRateLimit(requestInfo.clientIP, extractApiKey(requestInfo.headers),
+                                                                !forwarded);
+            KOLOSAL_LOG_REQUEST_DEBUG("Rate limit result - Allowed: %s, Used: %zu, Remaining: %zu",
                                   rateLimitResult.allowed ? "true" : "false",
                                   rateLimitResult.requestsUsed, rateLimitResult.requestsRemaining);
 
@@ -104,7 +112,7 @@ namespace kolosal
                 result.statusCode = 429; // Too Many Requests
                 result.reason = "Rate limit exceeded";
 
-                auto limit = rateLimiter_->getConfig().maxRequests;
+                auto limit = rateLimitResult.limit;
                 auto resetSeconds = rateLimitResult.resetTime.count();
                 result.headers["RateLimit-Limit"] = std::to_string(limit);
                 result.headers["RateLimit-Remaining"] = "0";
@@ -115,13 +123,13 @@ namespace kolosal
                 result.headers["X-Rate-Limit-Reset"] = std::to_string(resetSeconds);
                 result.headers["Retry-After"] = std::to_string(resetSeconds);
 
-                ServerLogger::logWarning("Rate limit exceeded for client %s - %zu requests used",
+                KOLOSAL_LOG_WARNING("Rate limit exceeded for client %s - %zu requests used",
                                          requestInfo.clientIP.c_str(), rateLimitResult.requestsUsed);
                 return result;
             }
 
             // Add rate limit information to response headers
-            auto limit = rateLimiter_->getConfig().maxRequests;
+            auto limit = rateLimitResult.limit;
             auto resetSeconds = rateLimitResult.resetTime.count();
             result.headers["RateLimit-Limit"] = std::to_string(limit);
             result.headers["RateLimit-Remaining"] = std::to_string(rateLimitResult.requestsRemaining);
@@ -135,13 +143,13 @@ namespace kolosal
             result.rateLimitUsed = rateLimitResult.requestsUsed;
             result.rateLimitRemaining = rateLimitResult.requestsRemaining;
             result.rateLimitReset = rateLimitResult.resetTime;
-            ServerLogger::logDebug("Request approved for client %s - Rate limit: %zu/%zu, CORS origin: %s",
+            KOLOSAL_LOG_REQUEST_DEBUG("Request approved for client %s - Rate limit: %zu/%zu, CORS origin: %s",
                                    requestInfo.clientIP.c_str(),
                                    rateLimitResult.requestsUsed,
-                                   rateLimiter_->getConfig().maxRequests,
+                                   rateLimitResult.limit,
                                    origin.empty() ? "none" : origin.c_str());
 
-            ServerLogger::logDebug("Auth middleware completed - Request allowed: %s", result.allowed ? "true" : "false");
+            KOLOSAL_LOG_REQUEST_DEBUG("Auth middleware completed - Request allowed: %s", result.allowed ? "true" : "false");
 
             return result;
         }
@@ -159,7 +167,7 @@ namespace kolosal
         void AuthMiddleware::updateApiKeyConfig(const ApiKeyConfig &config)
         {
             apiKeyConfig_ = config;
-            ServerLogger::logInfo("API key configuration updated - Enabled: %s, Required: %s, Keys count: %zu",
+            KOLOSAL_LOG_INFO("API key configuration updated - Enabled: %s, Required: %s, Keys count: %zu",
                                   config.enabled ? "true" : "false",
                                   config.required ? "true" : "false",
                                   config.validKeys.size());
@@ -220,6 +228,36 @@ namespace kolosal
             return *rateLimiter_;
         }
 
+        TokenQuota &AuthMiddleware::getTokenQuota()
+        {
+            return *tokenQuota_;
+        }
+
+        const TokenQuota &AuthMiddleware::getTokenQuota() const
+        {
+            return *tokenQuota_;
+        }
+
+        void AuthMiddleware::updateTokenQuotaConfig(const TokenQuota::Config &config)
+        {
+            tokenQuota_->updateConfig(config);
+        }
+
+        TenantShares &AuthMiddleware::getTenantShares()
+        {
+            return *tenantShares_;
+        }
+
+        const TenantShares &AuthMiddleware::getTenantShares() const
+        {
+            return *tenantShares_;
+        }
+
+        void AuthMiddleware::updateTenantSharesConfig(const TenantShares::Config &config)
+        {
+            tenantShares_->updateConfig(config);
+        }
+
         CorsHandler &AuthMiddleware::getCorsHandler()
         {
             return *corsHandler_;
@@ -251,7 +289,7 @@ namespace kolosal
             if (!apiKey.empty())
             {
                 apiKeyConfig_.validKeys.insert(apiKey);
-                ServerLogger::logInfo("API key added (total: %zu keys)", apiKeyConfig_.validKeys.size());
+                KOLOSAL_LOG_INFO("API key added (total: %zu keys)", apiKeyConfig_.validKeys.size());
             }
         }
 
@@ -261,31 +299,19 @@ namespace kolosal
             if (it != apiKeyConfig_.validKeys.end())
             {
                 apiKeyConfig_.validKeys.erase(it);
-                ServerLogger::logInfo("API key removed (total: %zu keys)", apiKeyConfig_.validKeys.size());
+                KOLOSAL_LOG_INFO("API key removed (total: %zu keys)", apiKeyConfig_.validKeys.size());
             }
         }
 
         void AuthMiddleware::clearApiKeys()
         {
             apiKeyConfig_.validKeys.clear();
-            ServerLogger::logInfo("All API keys cleared");
+            KOLOSAL_LOG_INFO("All API keys cleared");
         }
 
         std::string AuthMiddleware::getHeaderValue(const std::map<std::string, std::string> &headers,
                                                    const std::string &name) const
         {
-            {
-                std::lock_guard<std::mutex> lock(headerCacheMutex_);
-                if (headerCache_.shouldClear()) {
-                    headerCache_.clear();
-                }
-                std::string cacheKey = name + ":" + std::to_string(headers.size());
-                auto cacheIt = headerCache_.cache.find(cacheKey);
-                if (cacheIt != headerCache_.cache.end()) {
-                    return cacheIt->second;
-                }
-            }
-            
             std::string result;
             
             // Try exact match first (common case optimization)
@@ -305,15 +331,6 @@ namespace kolosal
                 }
             }
             
-            // Cache the result for future use
-            {
-                std::lock_guard<std::mutex> lock(headerCacheMutex_);
-                std::string cacheKey = name + ":" + std::to_string(headers.size());
-                if (headerCache_.cache.size() < HeaderCache::MAX_CACHE_SIZE) {
-                    headerCache_.cache[cacheKey] = result;
-                }
-            }
-
             return result;
         }
 
@@ -333,24 +350,14 @@ namespace kolosal
                 return true;
             }
 
-            // Get the API key from the configured header
-            std::string apiKey = getHeaderValue(requestInfo.headers, apiKeyConfig_.headerName);
-
-            // Handle Bearer token format if using Authorization header
-            if (apiKeyConfig_.headerName == "Authorization" || apiKeyConfig_.headerName == "authorization")
-            {
-                if (apiKey.length() > 7 && apiKey.compare(0, 7, "Bearer ") == 0)
-                {
-                    apiKey = apiKey.substr(7);
-                }
-            }
+            std::string apiKey = extractApiKey(requestInfo.headers);
 
             // Validate the API key
             bool isValid = validateApiKey(apiKey);
 
             if (!isValid)
             {
-                ServerLogger::logWarning("API key authentication failed for %s %s from %s - Key: %s",
+                KOLOSAL_LOG_WARNING("API key authentication failed for %s %s from %s - Key: %s",
                                          requestInfo.method.c_str(), requestInfo.path.c_str(), requestInfo.clientIP.c_str(),
                                          apiKey.empty() ? "(missing)" : "(invalid)");
             }
@@ -358,6 +365,22 @@ namespace kolosal
             return isValid;
         }
 
+        std::string AuthMiddleware::extractApiKey(const std::map<std::string, std::string> &headers) const
+        {
+            // Get the API key from the configured header
+            std::string apiKey = getHeaderValue(headers, apiKeyConfig_.headerName);
+
+            // Handle Bearer token format if using Authorization header
+            if (apiKeyConfig_.headerName == "Authorization" || apiKeyConfig_.headerName == "authorization")
+            {
+                if (apiKey.length() > 7 && apiKey.compare(0, 7, "Bearer ") == 0)
+                {
+                    apiKey = apiKey.substr(7);
+                }
+            }
+            return apiKey;
+        }
+
         bool AuthMiddleware::constantTimeEqual(const std::string &a, const std::string &b)
         {
             if (a.size() != b.size()) return false;
@@ -33,7 +33,7 @@ namespace kolosal
             // Check if origin is allowed
             if (!origin.empty() && !isOriginAllowed(origin))
             {
-                ServerLogger::logWarning("CORS: Origin not allowed: %s", origin.c_str());
+                KOLOSAL_LOG_WARNING("CORS: Origin not allowed: %s", origin.c_str());
                 result.isValid = false;
                 return result;
             }
@@ -62,7 +62,7 @@ namespace kolosal
                 // Check if the requested method is allowed
                 if (!isMethodAllowed(requestMethod))
                 {
-                    ServerLogger::logWarning("CORS: Method not allowed in preflight: %s", requestMethod.c_str());
+                    KOLOSAL_LOG_WARNING("CORS: Method not allowed in preflight: %s", requestMethod.c_str());
                     result.isValid = false;
                     return result;
                 }
@@ -70,7 +70,7 @@ namespace kolosal
                 // Check if the requested headers are allowed
                 if (!requestHeaders.empty() && !areHeadersAllowed(requestHeaders))
                 {
-                    ServerLogger::logWarning("CORS: Headers not allowed in preflight: %s", requestHeaders.c_str());
+                    KOLOSAL_LOG_WARNING("CORS: Headers not allowed in preflight: %s", requestHeaders.c_str());
                     result.isValid = false;
                     return result;
                 }
@@ -80,7 +80,7 @@ namespace kolosal
                 result.headers["Access-Control-Allow-Headers"] = vectorToString(config_.allowedHeaders);
                 result.headers["Access-Control-Max-Age"] = std::to_string(config_.maxAge);
 
-                ServerLogger::logDebug("CORS: Preflight request approved for origin: %s, method: %s",
+                KOLOSAL_LOG_REQUEST_DEBUG("CORS: Preflight request approved for origin: %s, method: %s",
                                        origin.c_str(), requestMethod.c_str());
             }
             else
@@ -88,12 +88,12 @@ namespace kolosal
                 // Handle actual request
                 if (!isMethodAllowed(method))
                 {
-                    ServerLogger::logWarning("CORS: Method not allowed: %s", method.c_str());
+                    KOLOSAL_LOG_WARNING("CORS: Method not allowed: %s", method.c_str());
                     result.isValid = false;
                     return result;
                 }
 
-                ServerLogger::logDebug("CORS: Request approved for origin: %s, method: %s",
+                KOLOSAL_LOG_REQUEST_DEBUG("CORS: Request approved for origin: %s, method: %s",
                                        origin.c_str(), method.c_str());
             }
 
@@ -140,7 +140,7 @@ namespace kolosal
                 allowedHeadersSet_.insert(lowerHeader);
             }
 
-            ServerLogger::logInfo("CORS configuration updated - Enabled: %s, Origins: %zu, Methods: %zu, Headers: %zu",
+            KOLOSAL_LOG_INFO("CORS configuration updated - Enabled: %s, Origins: %zu, Methods: %zu, Headers: %zu",
                                   config_.enabled ? "true" : "false",
                                   config_.allowedOrigins.size(),
                                   config_.allowedMethods.size(),
@@ -159,7 +159,7 @@ namespace kolosal
             {
                 config_.allowedOrigins.push_back(origin);
                 allowedOriginsSet_.insert(origin);
-                ServerLogger::logInfo("CORS: Added allowed origin: %s", origin.c_str());
+                KOLOSAL_LOG_INFO("CORS: Added allowed origin: %s", origin.c_str());
             }
         }
 
@@ -170,7 +170,7 @@ namespace kolosal
             {
                 config_.allowedOrigins.erase(it);
                 allowedOriginsSet_.erase(origin);
-                ServerLogger::logInfo("CORS: Removed allowed origin: %s", origin.c_str());
+                KOLOSAL_LOG_INFO("CORS: Removed allowed origin: %s", origin.c_str());
             }
         }
 
@@ -210,7 +210,7 @@ namespace kolosal
                 
                 if (allowedHeadersSet_.count(lowerHeader) == 0)
                 {
-                    ServerLogger::logDebug("CORS: Header not allowed: %s", header.c_str());
+                    KOLOSAL_LOG_REQUEST_DEBUG("CORS: Header not allowed: %s", header.c_str());
                     return false;
                 }
             }
@@ -1,96 +1,259 @@
 #include "kolosal/auth/rate_limiter.hpp"
 #include "kolosal/logger.hpp"
 #include <algorithm>
+#include <functional>
 
 namespace kolosal
-{    namespace auth
+{
+    namespace auth
     {
 
+        namespace
+        {
+            constexpr int64_t NANOS_PER_SECOND = 1000000000LL;
+
+            std::chrono::seconds ceilSeconds(int64_t nanos)
+            {
+                if (nanos <= 0)
+                    return std::chrono::seconds(0);
+                return std::chrono::seconds((nanos + NANOS_PER_SECOND - 1) / NANOS_PER_SECOND);
+            }
+
+            // Requests still counted against a bucket whose arrival time is tat
+            size_t inFlight(int64_t tat, int64_t emission, int64_t now)
+            {
+                if (tat <= now || emission <= 0)
+                    return 0;
+                return static_cast<size_t>((tat - now + emission - 1) / emission);
+            }
+
+            // Statistics never expose a full API key
+            std::string maskKey(const std::string &key)
+            {
+                if (key.size() <= 8)
+                    return std::string(key.size(), '*');
+                return key.substr(0, 4) + "..." + key.substr(key.size() - 4);
+            }
+        }
+
         RateLimiter::RateLimiter()
-            : config_(), lastGlobalCleanup_(std::chrono::steady_clock::now())
+            : RateLimiter(Config())
         {
-            ServerLogger::logInfo("Rate limiter initialized with default config - Max requests: %zu, Window: %lld seconds, Enabled: %s",
-                                  config_.maxRequests, config_.windowSize.count(), config_.enabled ? "true" : "false");
         }
 
         RateLimiter::RateLimiter(const Config &config)
-            : config_(config), lastGlobalCleanup_(std::chrono::steady_clock::now())
+            : config_(config)
         {
-            ServerLogger::logInfo("Rate limiter initialized - Max requests: %zu, Window: %lld seconds, Enabled: %s",
-                                  config_.maxRequests, config_.windowSize.count(), config_.enabled ? "true" : "false");
+            enabled_.store(config_.enabled);
+            maxRequests_.store(config_.maxRequests);
+            apiKeyMaxRequests_.store(config_.apiKeyMaxRequests);
+            windowNanos_.store(std::chrono::duration_cast<std::chrono::nanoseconds>(config_.windowSize).count());
+            expiryThread_ = std::thread(&RateLimiter::expiryLoop, this);
+
+            KOLOSAL_LOG_INFO("Rate limiter initialized - Max requests: %zu, Window: %lld seconds, Per-key max: %zu, Enabled: %s",
+                                  config_.maxRequests, static_cast<long long>(config_.windowSize.count()),
+                                  config_.apiKeyMaxRequests, config_.enabled ? "true" : "false");
         }
 
-        RateLimiter::RateLimitResult RateLimiter::checkRateLimit(const std::string &clientIP)
+        RateLimiter::~RateLimiter()
         {
-            std::lock_guard<std::mutex> lock(mutex_);
-
-            // If rate limiting is disabled, allow all requests
-            if (!config_.enabled)
             {
-                return RateLimitResult{true, 0, config_.maxRequests, config_.windowSize};
+                std::lock_guard<std::mutex> lock(mutex_);
+                stopping_ = true;
             }
-
-            // Perform periodic cleanup only occasionally to reduce overhead
-            auto now = std::chrono::steady_clock::now();
-            if (now - lastGlobalCleanup_ > GLOBAL_CLEANUP_INTERVAL)
+            expiryCv_.notify_all();
+            if (expiryThread_.joinable())
             {
-                performPeriodicCleanup();
+                expiryThread_.join();
             }
+        }
+
+        int64_t RateLimiter::nowNanos()
+        {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       std::chrono::steady_clock::now().time_since_epoch())
+                .count();
+        }
+
+        RateLimiter::Limits RateLimiter::makeLimits(size_t maxRequests, int64_t windowNanos)
+        {
+            Limits limits;
+            limits.tolerance = std::max<int64_t>(windowNanos, 1);
+            limits.emission = std::max<int64_t>(limits.tolerance / static_cast<int64_t>(std::max<size_t>(maxRequests, 1)), 1);
+            return limits;
+        }
+
+        RateLimiter::Shard &RateLimiter::shardFor(ShardTable &table, const std::string &key)
+        {
+            return table[std::hash<std::string>{}(key) % SHARD_COUNT];
+        }
 
-            // Get or create client data
-            auto &clientData = clients_[clientIP];
+        const RateLimiter::Shard &RateLimiter::shardFor(const ShardTable &table, const std::string &key)
+        {
+            return table[std::hash<std::string>{}(key) % SHARD_COUNT];
+        }
 
-            // Clean up old requests for this client only if it hasn't been cleaned recently
-            if (now - clientData.lastCleanup > std::chrono::seconds(10))
+        uint64_t RateLimiter::keyHash(const std::string &key)
+        {
+            // FNV-1a: std::hash is not guaranteed to agree between the nodes of a cluster
+            uint64_t hash = 14695981039346656037ULL;
+            for (unsigned char c : key)
             {
-                cleanupOldRequests(clientData);
+                hash ^= c;
+                hash *= 1099511628211ULL;
             }
+            return hash;
+        }
+
+        int64_t RateLimiter::remoteBacklog(const RemoteTable &table, uint64_t hash, int64_t now)
+        {
+            const RemoteShard &shard = table[hash % SHARD_COUNT];
+            std::shared_lock<std::shared_mutex> lock(shard.mutex);
+            auto it = shard.tats.find(hash);
+            if (it == shard.tats.end())
+                return 0;
+            return std::max<int64_t>(it->second.load(std::memory_order_relaxed) - now, 0);
+        }
+
+        RateLimiter::RateLimitResult RateLimiter::consume(ShardTable &table, const RemoteTable *remote,
+                                                          const std::string &key, size_t limit,
+                                                          const Limits &limits, int64_t now, bool shared)
+        {
+            RateLimitResult result;
+            result.limit = limit;
 
-            size_t currentRequests = clientData.requests.size();
+            // Peers' requests count as if they had arrived here, without moving the local arrival time
+            const int64_t backlog = remote ? remoteBacklog(*remote, keyHash(key), now) : 0;
 
-            // Check if we've exceeded the rate limit
-            if (currentRequests >= config_.maxRequests)
+            auto take = [&](Bucket &bucket)
             {
-                // Calculate when the window will reset (when the oldest request expires)
-                auto oldestRequest = clientData.requests.front();
-                auto resetTime = std::chrono::duration_cast<std::chrono::seconds>(
-                    (oldestRequest + config_.windowSize) - now);
-
-                ServerLogger::logWarning("Rate limit exceeded for client %s - Requests: %zu/%zu",
-                                         clientIP.c_str(), currentRequests, config_.maxRequests);
+                int64_t tat = bucket.tat.load(std::memory_order_relaxed);
+                while (true)
+                {
+                    const int64_t newTat = std::max(tat, now) + limits.emission;
+                    const int64_t combined = newTat + backlog;
+                    if (combined - now > limits.tolerance)
+                    {
+                        // The request fits once the arrival time falls back inside the window
+                        result.allowed = false;
+                        result.requestsUsed = limit;
+                        result.requestsRemaining = 0;
+                        result.resetTime = std::max(ceilSeconds(combined - limits.tolerance - now), std::chrono::seconds(1));
+                        return;
+                    }
+                    if (bucket.tat.compare_exchange_weak(tat, newTat, std::memory_order_relaxed))
+                    {
+                        if (shared)
+                            bucket.admitted.fetch_add(1, std::memory_order_relaxed);
+                        const size_t used = std::min(inFlight(combined, limits.emission, now), limit);
+                        result.allowed = true;
+                        result.requestsUsed = used;
+                        result.requestsRemaining = limit - used;
+                        result.resetTime = ceilSeconds(combined - now);
+                        return;
+                    }
+                }
+            };
 
-                return RateLimitResult{false, currentRequests, 0, resetTime};
+            Shard &shard = shardFor(table, key);
+            {
+                std::shared_lock<std::shared_mutex> lock(shard.mutex);
+                auto it = shard.buckets.find(key);
+                if (it != shard.buckets.end())
+                {
+                    take(it->second);
+                    return result;
+                }
             }
 
-            // Allow the request and record it
-            clientData.requests.push_back(now);
-            size_t remaining = config_.maxRequests - (currentRequests + 1);
+            std::unique_lock<std::shared_mutex> lock(shard.mutex);
+            take(shard.buckets.try_emplace(key).first->second);
+            return result;
+        }
+
+        void RateLimiter::refund(ShardTable &table, const std::string &key, const Limits &limits, int64_t now,
+                                 bool shared)
+        {
+            Shard &shard = shardFor(table, key);
+            std::shared_lock<std::shared_mutex> lock(shard.mutex);
+            auto it = shard.buckets.find(key);
+            if (it == shard.buckets.end())
+                return;
 
-            // Calculate reset time (end of current window)
-            auto windowStart = now - config_.windowSize;
-            auto resetTime = config_.windowSize;
-            if (!clientData.requests.empty())
+            if (shared)
             {
-                auto oldestInWindow = clientData.requests.front();
-                if (oldestInWindow > windowStart)
+                uint64_t admitted = it->second.admitted.load(std::memory_order_relaxed);
+                while (admitted > 0 &&
+                       !it->second.admitted.compare_exchange_weak(admitted, admitted - 1, std::memory_order_relaxed))
                 {
-                    resetTime = std::chrono::duration_cast<std::chrono::seconds>(
-                        (oldestInWindow + config_.windowSize) - now);
                 }
             }
 
-            ServerLogger::logDebug("Rate limit check passed for client %s - Requests: %zu/%zu, Remaining: %zu",
-                                   clientIP.c_str(), currentRequests + 1, config_.maxRequests, remaining);
+            int64_t tat = it->second.tat.load(std::memory_order_relaxed);
+            while (tat > now &&
+                   !it->second.tat.compare_exchange_weak(tat, std::max(tat - limits.emission, now), std::memory_order_relaxed))
+            {
+            }
+        }
+
+        RateLimiter::RateLimitResult RateLimiter::checkRateLimit(const std::string &clientIP, const std::string &apiKey,
+                                                                 bool shared)
+        {
+            const size_t maxRequests = maxRequests_.load(std::memory_order_relaxed);
+            const int64_t windowNanos = windowNanos_.load(std::memory_order_relaxed);
+
+            // If rate limiting is disabled, allow all requests
+            if (!enabled_.load(std::memory_order_relaxed))
+            {
+                RateLimitResult result{true, 0, maxRequests, ceilSeconds(windowNanos)};
+                result.limit = maxRequests;
+                return result;
+            }
+
+            const int64_t now = nowNanos();
+            const bool sharing = sharing_.load(std::memory_order_relaxed);
+            const Limits ipLimits = makeLimits(maxRequests, windowNanos);
+            RateLimitResult ipResult = consume(clients_, sharing ? &remoteClients_ : nullptr, clientIP, maxRequests,
+                                               ipLimits, now, sharing && shared);
+            if (!ipResult.allowed)
+            {
+                KOLOSAL_LOG_WARNING("Rate limit exceeded for client %s - Limit: %zu", clientIP.c_str(), maxRequests);
+                return ipResult;
+            }
+
+            const size_t keyMaxRequests = apiKeyMaxRequests_.load(std::memory_order_relaxed);
+            if (apiKey.empty() || keyMaxRequests == 0)
+            {
+                return ipResult;
+            }
+
+            const Limits keyLimits = makeLimits(keyMaxRequests, windowNanos);
+            RateLimitResult keyResult = consume(apiKeys_, sharing ? &remoteApiKeys_ : nullptr, apiKey, keyMaxRequests,
+                                                keyLimits, now, sharing && shared);
+            if (!keyResult.allowed)
+            {
+                // The IP bucket should not pay for a request that was never served
+                refund(clients_, clientIP, ipLimits, now, sharing && shared);
+                KOLOSAL_LOG_WARNING("Rate limit exceeded for API key %s from client %s - Limit: %zu",
+                                         maskKey(apiKey).c_str(), clientIP.c_str(), keyMaxRequests);
+                return keyResult;
+            }
 
-            return RateLimitResult{true, currentRequests + 1, remaining, resetTime};
+            // Report whichever bucket is closer to running out
+            return keyResult.requestsRemaining < ipResult.requestsRemaining ? keyResult : ipResult;
         }
 
         void RateLimiter::updateConfig(const Config &config)
         {
             std::lock_guard<std::mutex> lock(mutex_);
             config_ = config;
-            ServerLogger::logInfo("Rate limiter configuration updated - Max requests: %zu, Window: %lld seconds, Enabled: %s",
-                                  config_.maxRequests, config_.windowSize.count(), config_.enabled ? "true" : "false");
+            maxRequests_.store(config_.maxRequests);
+            apiKeyMaxRequests_.store(config_.apiKeyMaxRequests);
+            windowNanos_.store(std::chrono::duration_cast<std::chrono::nanoseconds>(config_.windowSize).count());
+            enabled_.store(config_.enabled);
+            KOLOSAL_LOG_INFO("Rate limiter configuration updated - Max requests: %zu, Window: %lld seconds, Per-key max: %zu, Enabled: %s",
+                                  config_.maxRequests, static_cast<long long>(config_.windowSize.count()),
+                                  config_.apiKeyMaxRequests, config_.enabled ? "true" : "false");
         }
 
         RateLimiter::Config RateLimiter::getConfig() const
@@ -99,80 +262,217 @@ namespace kolosal
             return config_;
         }
 
-        void RateLimiter::clearClient(const std::string &clientIP)
+        void RateLimiter::setSharing(bool enabled)
         {
-            std::lock_guard<std::mutex> lock(mutex_);
-            auto it = clients_.find(clientIP);
-            if (it != clients_.end())
+            if (sharing_.exchange(enabled) == enabled)
+                return;
+            if (!enabled)
             {
-                clients_.erase(it);
-                ServerLogger::logInfo("Cleared rate limit data for client %s", clientIP.c_str());
+                for (RemoteTable *table : {&remoteClients_, &remoteApiKeys_})
+                {
+                    for (auto &shard : *table)
+                    {
+                        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+                        shard.tats.clear();
+                    }
+                }
             }
+            KOLOSAL_LOG_INFO("Rate limits %s with cluster peers", enabled ? "shared" : "no longer shared");
         }
 
-        void RateLimiter::clearAll()
+        void RateLimiter::collectUsage(const ShardTable &table, int64_t now,
+                                       std::vector<std::pair<uint64_t, uint64_t>> &out)
         {
-            std::lock_guard<std::mutex> lock(mutex_);
-            clients_.clear();
-            ServerLogger::logInfo("Cleared all rate limit data");
+            for (const auto &shard : table)
+            {
+                std::shared_lock<std::shared_mutex> lock(shard.mutex);
+                for (const auto &bucket : shard.buckets)
+                {
+                    const uint64_t admitted = bucket.second.admitted.load(std::memory_order_relaxed);
+                    if (admitted > 0 && bucket.second.tat.load(std::memory_order_relaxed) > now)
+                        out.emplace_back(keyHash(bucket.first), admitted);
+                }
+            }
         }
 
-        std::unordered_map<std::string, size_t> RateLimiter::getStatistics() const
+        RateLimiter::SharedUsage RateLimiter::sharedUsage() const
         {
-            std::lock_guard<std::mutex> lock(mutex_);
-            std::unordered_map<std::string, size_t> stats;
+            SharedUsage usage;
+            if (!sharing_.load(std::memory_order_relaxed))
+                return usage;
+            const int64_t now = nowNanos();
+            collectUsage(clients_, now, usage.clients);
+            collectUsage(apiKeys_, now, usage.apiKeys);
+            return usage;
+        }
+
+        void RateLimiter::chargeRemote(bool apiKey, uint64_t keyHash, uint64_t requests)
+        {
+            if (requests == 0 || !sharing_.load(std::memory_order_relaxed) || !enabled_.load(std::memory_order_relaxed))
+                return;
+            const size_t maxRequests = apiKey ? apiKeyMaxRequests_.load(std::memory_order_relaxed)
+                                              : maxRequests_.load(std::memory_order_relaxed);
+            if (maxRequests == 0)
+                return;
+
+            const Limits limits = makeLimits(maxRequests, windowNanos_.load(std::memory_order_relaxed));
+            const int64_t now = nowNanos();
+            // More than a full window's worth saturates the bucket all the same
+            const int64_t charge = static_cast<int64_t>(std::min<uint64_t>(requests, maxRequests + 1)) * limits.emission;
+
+            RemoteShard &shard = (apiKey ? remoteApiKeys_ : remoteClients_)[keyHash % SHARD_COUNT];
+            std::unique_lock<std::shared_mutex> lock(shard.mutex);
+            std::atomic<int64_t> &tat = shard.tats.try_emplace(keyHash, 0).first->second;
+            const int64_t next = std::min(std::max(tat.load(std::memory_order_relaxed), now) + charge, now + limits.tolerance);
+            tat.store(next, std::memory_order_relaxed);
+        }
 
-            for (const auto &client : clients_)
+        void RateLimiter::clearClient(const std::string &clientIP)
+        {
+            Shard &shard = shardFor(clients_, clientIP);
+            std::unique_lock<std::shared_mutex> lock(shard.mutex);
+            if (shard.buckets.erase(clientIP) > 0)
             {
-                stats[client.first] = client.second.requests.size();
+                KOLOSAL_LOG_INFO("Cleared rate limit data for client %s", clientIP.c_str());
             }
 
-            return stats;
+            const uint64_t hash = keyHash(clientIP);
+            RemoteShard &remote = remoteClients_[hash % SHARD_COUNT];
+            std::unique_lock<std::shared_mutex> remoteLock(remote.mutex);
+            remote.tats.erase(hash);
         }
 
-        void RateLimiter::cleanupOldRequests(ClientData &data)
+        void RateLimiter::clearAll()
         {
-            auto now = std::chrono::steady_clock::now();
-            auto cutoff = now - config_.windowSize;
+            for (ShardTable *table : {&clients_, &apiKeys_})
+            {
+                for (auto &shard : *table)
+                {
+                    std::unique_lock<std::shared_mutex> lock(shard.mutex);
+                    shard.buckets.clear();
+                }
+            }
+            for (RemoteTable *table : {&remoteClients_, &remoteApiKeys_})
+            {
+                for (auto &shard : *table)
+                {
+                    std::unique_lock<std::shared_mutex> lock(shard.mutex);
+                    shard.tats.clear();
+                }
+            }
+            KOLOSAL_LOG_INFO("Cleared all rate limit data");
+        }
 
-            // Remove requests older than the window
-            while (!data.requests.empty() && data.requests.front() < cutoff)
+        void RateLimiter::collectStatistics(const ShardTable &table, int64_t emission, int64_t now, bool maskKeys,
+                                            std::unordered_map<std::string, size_t> &stats)
+        {
+            for (const auto &shard : table)
             {
-                data.requests.pop_front();
+                std::shared_lock<std::shared_mutex> lock(shard.mutex);
+                for (const auto &bucket : shard.buckets)
+                {
+                    const size_t count = inFlight(bucket.second.tat.load(std::memory_order_relaxed), emission, now);
+                    if (count == 0)
+                        continue;
+                    if (maskKeys)
+                        stats[maskKey(bucket.first)] += count;
+                    else
+                        stats[bucket.first] = count;
+                }
             }
+        }
 
-            data.lastCleanup = now;
+        std::unordered_map<std::string, size_t> RateLimiter::getStatistics() const
+        {
+            std::unordered_map<std::string, size_t> stats;
+            const auto limits = makeLimits(maxRequests_.load(), windowNanos_.load());
+            collectStatistics(clients_, limits.emission, nowNanos(), false, stats);
+            return stats;
         }
 
-        void RateLimiter::performPeriodicCleanup()
+        std::unordered_map<std::string, size_t> RateLimiter::getApiKeyStatistics() const
         {
-            auto now = std::chrono::steady_clock::now();
+            std::unordered_map<std::string, size_t> stats;
+            const auto limits = makeLimits(apiKeyMaxRequests_.load(), windowNanos_.load());
+            collectStatistics(apiKeys_, limits.emission, nowNanos(), true, stats);
+            return stats;
+        }
 
-            // Only perform global cleanup if enough time has passed
-            if (now - lastGlobalCleanup_ < GLOBAL_CLEANUP_INTERVAL)
+        size_t RateLimiter::bucketCount() const
+        {
+            size_t count = 0;
+            for (const ShardTable *table : {&clients_, &apiKeys_})
             {
-                return;
+                for (const auto &shard : *table)
+                {
+                    std::shared_lock<std::shared_mutex> lock(shard.mutex);
+                    count += shard.buckets.size();
+                }
             }
+            return count;
+        }
 
-            // Remove clients that haven't made requests recently
-            auto cutoff = now - (config_.windowSize + GLOBAL_CLEANUP_INTERVAL);
-            auto it = clients_.begin();
-
-            while (it != clients_.end())
+        size_t RateLimiter::expireIdle(ShardTable &table, int64_t now)
+        {
+            size_t removed = 0;
+            for (auto &shard : table)
             {
-                if (it->second.lastCleanup < cutoff || it->second.requests.empty())
+                std::unique_lock<std::shared_mutex> lock(shard.mutex);
+                for (auto it = shard.buckets.begin(); it != shard.buckets.end();)
                 {
-                    ServerLogger::logDebug("Removing inactive client from rate limiter: %s", it->first.c_str());
-                    it = clients_.erase(it);
+                    // A bucket whose arrival time has passed is full again, same as a new one
+                    if (it->second.tat.load(std::memory_order_relaxed) <= now)
+                    {
+                        it = shard.buckets.erase(it);
+                        ++removed;
+                    }
+                    else
+                    {
+                        ++it;
+                    }
                 }
-                else
+            }
+            return removed;
+        }
+
+        size_t RateLimiter::expireIdle(RemoteTable &table, int64_t now)
+        {
+            size_t removed = 0;
+            for (auto &shard : table)
+            {
+                std::unique_lock<std::shared_mutex> lock(shard.mutex);
+                for (auto it = shard.tats.begin(); it != shard.tats.end();)
                 {
-                    ++it;
+                    if (it->second.load(std::memory_order_relaxed) <= now)
+                    {
+                        it = shard.tats.erase(it);
+                        ++removed;
+                    }
+                    else
+                    {
+                        ++it;
+                    }
                 }
             }
+            return removed;
+        }
 
-            lastGlobalCleanup_ = now;
-            ServerLogger::logDebug("Performed rate limiter cleanup - Active clients: %zu", clients_.size());
+        void RateLimiter::expiryLoop()
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            while (!expiryCv_.wait_for(lock, EXPIRY_INTERVAL, [this]
+                                       { return stopping_; }))
+            {
+                lock.unlock();
+                const int64_t now = nowNanos();
+                const size_t removed = expireIdle(clients_, now) + expireIdle(apiKeys_, now) +
+                                       expireIdle(remoteClients_, now) + expireIdle(remoteApiKeys_, now);
+                if (removed > 0)
+                {
+                    KOLOSAL_LOG_DEBUG("Rate limiter expired %zu idle buckets", removed);
+                }
+                lock.lock();
+            }
         }
 
     } // namespace auth
@@ -0,0 +1,56 @@
+#include "kolosal/auth/tenant_shares.hpp"
+#include "kolosal/logger.hpp"
+#include <algorithm>
+#include <mutex>
+
+namespace kolosal
+{
+    namespace auth
+    {
+
+        namespace
+        {
+            // A zero or negative weight would starve the tenant, or divide by zero
+            TenantShares::Share sanitized(TenantShares::Share share)
+            {
+                share.weight = share.weight > 0.0f ? share.weight : 1.0f;
+                share.maxSlots = std::max(0, share.maxSlots);
+                return share;
+            }
+        }
+
+        TenantShares::Share TenantShares::lookup(const std::string &subject) const
+        {
+            std::shared_lock<std::shared_mutex> lock(mutex_);
+            if (subject.compare(0, 4, "key:") == 0)
+            {
+                auto it = config_.apiKeys.find(subject.substr(4));
+                if (it != config_.apiKeys.end())
+                    return it->second;
+            }
+            return config_.defaults;
+        }
+
+        void TenantShares::updateConfig(const Config &config)
+        {
+            Config next = config;
+            next.defaults = sanitized(next.defaults);
+            for (auto &entry : next.apiKeys)
+                entry.second = sanitized(entry.second);
+            {
+                std::unique_lock<std::shared_mutex> lock(mutex_);
+                config_ = std::move(next);
+            }
+            enabled_.store(config.enabled, std::memory_order_relaxed);
+            KOLOSAL_LOG_INFO("Tenant scheduling %s (%zu API keys with their own share)",
+                             config.enabled ? "enabled" : "disabled", config.apiKeys.size());
+        }
+
+        TenantShares::Config TenantShares::getConfig() const
+        {
+            std::shared_lock<std::shared_mutex> lock(mutex_);
+            return config_;
+        }
+
+    } // namespace auth
+} // namespace kolosal
@@ -0,0 +1,333 @@
+#include "kolosal/auth/token_quota.hpp"
+#include "kolosal/logger.hpp"
+#include "kolosal/access_log.hpp"
+#include <algorithm>
+#include <functional>
+#include <cstdint>
+
+namespace kolosal
+{
+    namespace auth
+    {
+
+        namespace
+        {
+            constexpr int64_t NANOS_PER_SECOND = 1000000000LL;
+
+            std::chrono::seconds ceilSeconds(int64_t nanos)
+            {
+                if (nanos <= 0)
+                    return std::chrono::seconds(0);
+                return std::chrono::seconds((nanos + NANOS_PER_SECOND - 1) / NANOS_PER_SECOND);
+            }
+
+            std::string modelKey(const std::string &subject, const std::string &model)
+            {
+                return subject + '\n' + model;
+            }
+
+            // Statistics never expose a full API key
+            std::string labelFor(const std::string &key)
+            {
+                std::string label = key;
+                std::replace(label.begin(), label.end(), '\n', ' ');
+                if (label.compare(0, 4, "key:") != 0)
+                    return label;
+
+                const size_t end = std::min(label.find(' '), label.size());
+                const std::string apiKey = label.substr(4, end - 4);
+                const std::string masked = apiKey.size() <= 8
+                                               ? std::string(apiKey.size(), '*')
+                                               : apiKey.substr(0, 4) + "..." + apiKey.substr(apiKey.size() - 4);
+                return "key:" + masked + label.substr(end);
+            }
+        }
+
+        TokenQuota::TokenQuota()
+            : TokenQuota(Config())
+        {
+        }
+
+        TokenQuota::TokenQuota(const Config &config)
+        {
+            updateConfig(config);
+            expiryThread_ = std::thread(&TokenQuota::expiryLoop, this);
+        }
+
+        TokenQuota::~TokenQuota()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stopping_ = true;
+            }
+            expiryCv_.notify_all();
+            if (expiryThread_.joinable())
+            {
+                expiryThread_.join();
+            }
+        }
+
+        int64_t TokenQuota::nowNanos()
+        {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       std::chrono::steady_clock::now().time_since_epoch())
+                .count();
+        }
+
+        int64_t TokenQuota::emissionFor(size_t tokensPerMinute)
+        {
+            const int64_t window = std::chrono::duration_cast<std::chrono::nanoseconds>(WINDOW).count();
+            return std::max<int64_t>(window / static_cast<int64_t>(std::max<size_t>(tokensPerMinute, 1)), 1);
+        }
+
+        TokenQuota::Shard &TokenQuota::shardFor(ShardTable &table, const std::string &key)
+        {
+            return table[std::hash<std::string>{}(key) % SHARD_COUNT];
+        }
+
+        size_t TokenQuota::modelLimit(const std::string &model) const
+        {
+            std::shared_lock<std::shared_mutex> lock(modelLimitsMutex_);
+            auto it = modelLimits_.find(model);
+            return it != modelLimits_.end() ? it->second : 0;
+        }
+
+        bool TokenQuota::take(const std::string &key, size_t limit, size_t cost, int64_t now,
+                              size_t &remaining, std::chrono::seconds &retryAfter)
+        {
+            const int64_t window = std::chrono::duration_cast<std::chrono::nanoseconds>(WINDOW).count();
+            const int64_t emission = emissionFor(limit);
+            // A request larger than the whole quota is admitted into a full bucket and leaves it in debt
+            const int64_t admitCost = static_cast<int64_t>(std::min(cost, limit)) * emission;
+            const int64_t fullCost = static_cast<int64_t>(cost) * emission;
+
+            bool allowed = false;
+            auto apply = [&](Bucket &bucket)
+            {
+                int64_t tat = bucket.tat.load(std::memory_order_relaxed);
+                while (true)
+                {
+                    const int64_t base = std::max(tat, now);
+                    if (base + admitCost - now > window)
+                    {
+                        allowed = false;
+                        remaining = 0;
+                        retryAfter = std::max(ceilSeconds(base + admitCost - window - now), std::chrono::seconds(1));
+                        return;
+                    }
+                    if (bucket.tat.compare_exchange_weak(tat, base + fullCost, std::memory_order_relaxed))
+                    {
+                        allowed = true;
+                        const int64_t left = window - (base + fullCost - now);
+                        remaining = left > 0 ? static_cast<size_t>(left / emission) : 0;
+                        return;
+                    }
+                }
+            };
+
+            Shard &shard = shardFor(buckets_, key);
+            {
+                std::shared_lock<std::shared_mutex> lock(shard.mutex);
+                auto it = shard.buckets.find(key);
+                if (it != shard.buckets.end())
+                {
+                    apply(it->second);
+                    return allowed;
+                }
+            }
+
+            std::unique_lock<std::shared_mutex> lock(shard.mutex);
+            apply(shard.buckets.try_emplace(key).first->second);
+            return allowed;
+        }
+
+        void TokenQuota::adjust(const std::string &key, size_t limit, int64_t deltaTokens)
+        {
+            if (deltaTokens == 0)
+                return;
+
+            Shard &shard = shardFor(buckets_, key);
+            std::shared_lock<std::shared_mutex> lock(shard.mutex);
+            auto it = shard.buckets.find(key);
+            if (it != shard.buckets.end())
+            {
+                it->second.tat.fetch_add(deltaTokens * emissionFor(limit), std::memory_order_relaxed);
+            }
+        }
+
+        TokenQuota::Reservation TokenQuota::reserve(const std::string &subject, const std::string &model,
+                                                    size_t estimatedTokens)
+        {
+            Reservation reservation;
+            reservation.subject = subject;
+            reservation.model = model;
+            if (!enabled_.load(std::memory_order_relaxed))
+            {
+                return reservation;
+            }
+
+            const int64_t now = nowNanos();
+            const size_t cost = std::max<size_t>(estimatedTokens, 1);
+            const size_t tenantLimit = tokensPerMinute_.load(std::memory_order_relaxed);
+            const size_t perModel = modelLimit(model);
+            reservation.remaining = SIZE_MAX;
+
+            if (tenantLimit > 0)
+            {
+                size_t remaining = 0;
+                if (!take(subject, tenantLimit, cost, now, remaining, reservation.retryAfter))
+                {
+                    reservation.allowed = false;
+                    reservation.scope = "tenant";
+                    reservation.limit = tenantLimit;
+                    reservation.remaining = 0;
+                    return reservation;
+                }
+                reservation.tenantLimit = tenantLimit;
+                reservation.limit = tenantLimit;
+                reservation.remaining = remaining;
+            }
+
+            if (perModel > 0)
+            {
+                size_t remaining = 0;
+                if (!take(modelKey(subject, model), perModel, cost, now, remaining, reservation.retryAfter))
+                {
+                    // The tenant bucket should not pay for a request that never ran
+                    if (reservation.tenantLimit > 0)
+                    {
+                        adjust(subject, reservation.tenantLimit, -static_cast<int64_t>(cost));
+                        reservation.tenantLimit = 0;
+                    }
+                    reservation.allowed = false;
+                    reservation.scope = "model";
+                    reservation.limit = perModel;
+                    reservation.remaining = 0;
+                    return reservation;
+                }
+                reservation.modelLimit = perModel;
+                if (remaining < reservation.remaining)
+                {
+                    reservation.limit = perModel;
+                    reservation.remaining = remaining;
+                }
+            }
+
+            if (reservation.remaining == SIZE_MAX)
+            {
+                reservation.remaining = 0;
+            }
+            reservation.reserved = cost;
+            return reservation;
+        }
+
+        void TokenQuota::settle(const Reservation &reservation, size_t actualTokens)
+        {
+            if (!reservation.allowed || (reservation.tenantLimit == 0 && reservation.modelLimit == 0))
+            {
+                return;
+            }
+
+            const int64_t delta = static_cast<int64_t>(actualTokens) - static_cast<int64_t>(reservation.reserved);
+            if (reservation.tenantLimit > 0)
+            {
+                adjust(reservation.subject, reservation.tenantLimit, delta);
+            }
+            if (reservation.modelLimit > 0)
+            {
+                adjust(modelKey(reservation.subject, reservation.model), reservation.modelLimit, delta);
+            }
+        }
+
+        void TokenQuota::updateConfig(const Config &config)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                config_ = config;
+            }
+            {
+                std::unique_lock<std::shared_mutex> lock(modelLimitsMutex_);
+                modelLimits_ = config.modelTokensPerMinute;
+            }
+            tokensPerMinute_.store(config.tokensPerMinute);
+            enabled_.store(config.enabled);
+            KOLOSAL_LOG_INFO("Token quota configuration updated - Enabled: %s, Tokens per minute: %zu, Model limits: %zu",
+                                  config.enabled ? "true" : "false", config.tokensPerMinute,
+                                  config.modelTokensPerMinute.size());
+        }
+
+        TokenQuota::Config TokenQuota::getConfig() const
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return config_;
+        }
+
+        std::unordered_map<std::string, size_t> TokenQuota::getStatistics() const
+        {
+            std::unordered_map<std::string, size_t> stats;
+            const int64_t now = nowNanos();
+            const size_t tenantLimit = tokensPerMinute_.load();
+
+            for (const auto &shard : buckets_)
+            {
+                std::shared_lock<std::shared_mutex> lock(shard.mutex);
+                for (const auto &bucket : shard.buckets)
+                {
+                    const int64_t tat = bucket.second.tat.load(std::memory_order_relaxed);
+                    if (tat <= now)
+                        continue;
+
+                    const size_t newline = bucket.first.find('\n');
+                    const size_t limit = newline == std::string::npos ? tenantLimit
+                                                                      : modelLimit(bucket.first.substr(newline + 1));
+                    if (limit == 0)
+                        continue;
+                    const int64_t emission = emissionFor(limit);
+                    stats[labelFor(bucket.first)] += static_cast<size_t>((tat - now + emission - 1) / emission);
+                }
+            }
+            return stats;
+        }
+
+        void TokenQuota::clearAll()
+        {
+            for (auto &shard : buckets_)
+            {
+                std::unique_lock<std::shared_mutex> lock(shard.mutex);
+                shard.buckets.clear();
+            }
+            KOLOSAL_LOG_INFO("Cleared all token quota data");
+        }
+
+        void TokenQuota::expiryLoop()
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            while (!expiryCv_.wait_for(lock, EXPIRY_INTERVAL, [this]
+                                       { return stopping_; }))
+            {
+                lock.unlock();
+                const int64_t now = nowNanos();
+                for (auto &shard : buckets_)
+                {
+                    std::unique_lock<std::shared_mutex> shardLock(shard.mutex);
+                    for (auto it = shard.buckets.begin(); it != shard.buckets.end();)
+                    {
+                        // Fully refilled buckets carry no state worth keeping
+                        if (it->second.tat.load(std::memory_order_relaxed) <= now)
+                            it = shard.buckets.erase(it);
+                        else
+                            ++it;
+                    }
+                }
+                lock.lock();
+            }
+        }
+
+        TokenQuotaCharge::~TokenQuotaCharge()
+        {
+            quota_.settle(reservation_, promptTokens_ + generatedTokens_);
+            access_log::record_usage(reservation_.model, promptTokens_, generatedTokens_);
+        }
+
+    } // namespace auth
+} // namespace kolosal
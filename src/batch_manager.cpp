@@ -0,0 +1,1038 @@
+#include "kolosal/batch_manager.hpp"
+#include "kolosal/server_api.hpp"
+#include "kolosal/node_manager.h"
+#include "kolosal/logger.hpp"
+#include "kolosal/auth/auth_middleware.hpp"
+#include "kolosal/routes/llm/oai_parameters.hpp"
+#include "inference_interface.h"
+
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <stdexcept>
+
+using json = nlohmann::json;
+
+namespace kolosal
+{
+
+namespace
+{
+    namespace fs = std::filesystem;
+
+    // Below anything an interactive request asks for, so batch prefill always goes last
+    constexpr int kBatchPriority = -1000000;
+
+    // Most candidates one batch request may ask for through n, as on /v1/completions
+    constexpr int kMaxCandidates = 16;
+
+    // Bytes of a prompt kept to sort requests by shared prefix; enough for the usual system prompt
+    // and few-shot preamble while a 500k-line file stays a few hundred MB in memory
+    constexpr size_t kSortKeyBytes = 256;
+
+    // Batch state is rewritten at most this often while requests complete
+    constexpr std::chrono::seconds kPersistInterval{1};
+
+    int64_t now()
+    {
+        return static_cast<int64_t>(std::time(nullptr));
+    }
+
+    std::string randomHex(size_t bytes)
+    {
+        static thread_local std::mt19937_64 engine(std::random_device{}() ^
+                                                   static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count()));
+        static const char digits[] = "0123456789abcdef";
+        std::string out;
+        out.reserve(bytes * 2);
+        for (size_t i = 0; i < bytes; ++i)
+        {
+            const unsigned value = static_cast<unsigned>(engine() & 0xFF);
+            out.push_back(digits[value >> 4]);
+            out.push_back(digits[value & 0xF]);
+        }
+        return out;
+    }
+
+    json timestamp(int64_t value)
+    {
+        return value > 0 ? json(value) : json(nullptr);
+    }
+
+    int64_t timestampOf(const json& j, const char* key)
+    {
+        return j.contains(key) && j[key].is_number_integer() ? j[key].get<int64_t>() : 0;
+    }
+
+    std::string stringOf(const json& j, const char* key)
+    {
+        return j.contains(key) && j[key].is_string() ? j[key].get<std::string>() : std::string();
+    }
+
+    bool isTerminal(const std::string& status)
+    {
+        return status == "completed" || status == "failed" || status == "expired" || status == "cancelled";
+    }
+
+    // The start of what the model reads first, so sorting puts requests that share a prefix together
+    std::string sortKeyOf(const json& body, bool chat)
+    {
+        std::string key;
+        if (chat && body.contains("messages") && body["messages"].is_array())
+        {
+            for (const auto& message : body["messages"])
+            {
+                if (key.size() >= kSortKeyBytes)
+                    break;
+                key += stringOf(message, "role");
+                key.push_back('\n');
+                if (message.contains("content"))
+                    key += message["content"].is_string() ? message["content"].get<std::string>() : message["content"].dump();
+                key.push_back('\n');
+            }
+        }
+        else if (!chat && body.contains("prompt"))
+        {
+            const json& prompt = body["prompt"];
+            if (prompt.is_string())
+                key = prompt.get<std::string>();
+            else if (prompt.is_array() && !prompt.empty() && prompt.front().is_string())
+                key = prompt.front().get<std::string>();
+        }
+        if (key.size() > kSortKeyBytes)
+            key.resize(kSortKeyBytes);
+        return key;
+    }
+
+    // Custom ids of the results already written, from a run interrupted by a restart. A line cut
+    // short by the crash is dropped from the file so appends continue cleanly.
+    int collectWritten(const std::string& path, std::set<std::string>& written)
+    {
+        std::ifstream in(path, std::ios::binary);
+        if (!in)
+            return 0;
+
+        int count = 0;
+        uint64_t good = 0;
+        std::string line;
+        while (std::getline(in, line))
+        {
+            if (in.eof())
+                break;     // No newline: the write was interrupted
+            try
+            {
+                const json record = json::parse(line);
+                written.insert(stringOf(record, "custom_id"));
+                ++count;
+                good += line.size() + 1;
+            }
+            catch (const json::exception&)
+            {
+                break;
+            }
+        }
+        in.close();
+
+        std::error_code ec;
+        if (fs::file_size(path, ec) > good)
+            fs::resize_file(path, good, ec);
+        return count;
+    }
+
+    json errorRecord(const std::string& customId, int status, const std::string& message, const std::string& type)
+    {
+        return {{"id", "batch_req_" + randomHex(12)},
+                {"custom_id", customId},
+                {"response", {{"status_code", status},
+                              {"request_id", nullptr},
+                              {"body", {{"error", {{"message", message}, {"type", type}, {"param", nullptr}, {"code", nullptr}}}}}}},
+                {"error", nullptr}};
+    }
+}
+
+struct BatchManager::Item
+{
+    uint64_t offset = 0;        // Of the line in the input file
+    uint32_t length = 0;
+    std::string customId;
+    std::string model;
+    std::string sortKey;
+};
+
+json BatchManager::File::toJson() const
+{
+    return {{"id", id}, {"object", "file"}, {"bytes", bytes}, {"created_at", created_at},
+            {"filename", filename}, {"purpose", purpose}};
+}
+
+json BatchManager::Batch::toJson() const
+{
+    json errors = nullptr;
+    if (!error.empty())
+    {
+        errors = {{"object", "list"}, {"data", json::array({{{"code", "invalid_request"}, {"message", error}}})}};
+    }
+    return {{"id", id},
+            {"object", "batch"},
+            {"endpoint", endpoint},
+            {"errors", errors},
+            {"input_file_id", input_file_id},
+            {"completion_window", completion_window},
+            {"status", status},
+            {"output_file_id", output_file_id.empty() ? json(nullptr) : json(output_file_id)},
+            {"error_file_id", error_file_id.empty() ? json(nullptr) : json(error_file_id)},
+            {"created_at", created_at},
+            {"in_progress_at", timestamp(in_progress_at)},
+            {"expires_at", timestamp(expires_at)},
+            {"finalizing_at", timestamp(finalizing_at)},
+            {"completed_at", timestamp(completed_at)},
+            {"failed_at", timestamp(failed_at)},
+            {"expired_at", timestamp(expired_at)},
+            {"cancelling_at", timestamp(cancelling_at)},
+            {"cancelled_at", timestamp(cancelled_at)},
+            {"request_counts", {{"total", total}, {"completed", completed}, {"failed", failed}}},
+            {"metadata", metadata.is_object() ? metadata : json(nullptr)}};
+}
+
+BatchManager::Batch BatchManager::Batch::fromJson(const json& j)
+{
+    Batch batch;
+    batch.id = stringOf(j, "id");
+    batch.endpoint = stringOf(j, "endpoint");
+    batch.input_file_id = stringOf(j, "input_file_id");
+    batch.completion_window = stringOf(j, "completion_window");
+    batch.status = stringOf(j, "status");
+    batch.output_file_id = stringOf(j, "output_file_id");
+    batch.error_file_id = stringOf(j, "error_file_id");
+    if (j.contains("errors") && j["errors"].is_object() && j["errors"].contains("data") &&
+        j["errors"]["data"].is_array() && !j["errors"]["data"].empty())
+    {
+        batch.error = stringOf(j["errors"]["data"].front(), "message");
+    }
+    if (j.contains("request_counts") && j["request_counts"].is_object())
+    {
+        const json& counts = j["request_counts"];
+        batch.total = counts.value("total", 0);
+        batch.completed = counts.value("completed", 0);
+        batch.failed = counts.value("failed", 0);
+    }
+    batch.created_at = timestampOf(j, "created_at");
+    batch.in_progress_at = timestampOf(j, "in_progress_at");
+    batch.expires_at = timestampOf(j, "expires_at");
+    batch.finalizing_at = timestampOf(j, "finalizing_at");
+    batch.completed_at = timestampOf(j, "completed_at");
+    batch.failed_at = timestampOf(j, "failed_at");
+    batch.expired_at = timestampOf(j, "expired_at");
+    batch.cancelling_at = timestampOf(j, "cancelling_at");
+    batch.cancelled_at = timestampOf(j, "cancelled_at");
+    if (j.contains("metadata") && j["metadata"].is_object())
+        batch.metadata = j["metadata"];
+    batch.owner = stringOf(j, "owner");
+    return batch;
+}
+
+BatchManager& BatchManager::instance()
+{
+    static BatchManager manager;
+    return manager;
+}
+
+BatchManager::~BatchManager()
+{
+    stop();
+}
+
+void BatchManager::start(const BatchConfig& config)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (started_ || !config.enabled)
+            return;
+        config_ = config;
+        started_ = true;
+        stopping_ = false;
+    }
+
+    std::error_code ec;
+    fs::create_directories(config.directory, ec);
+    if (ec)
+    {
+        KOLOSAL_LOG_ERROR("Batch API: cannot create %s: %s", config.directory.c_str(), ec.message().c_str());
+    }
+    load();
+    worker_ = std::thread(&BatchManager::run, this);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    KOLOSAL_LOG_INFO("Batch API enabled (%s, %zu file(s), %zu batch(es) queued)",
+                          config.directory.c_str(), files_.size(), queue_.size());
+}
+
+void BatchManager::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!started_)
+            return;
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    if (worker_.joinable())
+        worker_.join();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    started_ = false;
+}
+
+bool BatchManager::enabled() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return started_;
+}
+
+size_t BatchManager::maxFileBytes() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return static_cast<size_t>(std::max(0, config_.max_file_mb)) * 1024 * 1024;
+}
+
+std::string BatchManager::stagingPath() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return (fs::path(config_.directory) / ("upload-" + randomHex(8) + ".tmp")).string();
+}
+
+std::string BatchManager::metaPath(const std::string& id) const
+{
+    return (fs::path(config_.directory) / (id + ".json")).string();
+}
+
+std::string BatchManager::outputPath(const std::string& batchId) const
+{
+    return (fs::path(config_.directory) / (batchId + ".output.partial")).string();
+}
+
+std::string BatchManager::errorPath(const std::string& batchId) const
+{
+    return (fs::path(config_.directory) / (batchId + ".errors.partial")).string();
+}
+
+// Index what a previous run left: file and batch records, with leftover uploads removed and
+// unfinished batches queued again in the order they were created
+void BatchManager::load()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::error_code ec;
+    std::vector<Batch> pending;
+    for (const auto& entry : fs::directory_iterator(config_.directory, ec))
+    {
+        const fs::path path = entry.path();
+        if (path.extension() == ".tmp")
+        {
+            fs::remove(path, ec);
+            continue;
+        }
+        if (path.extension() != ".json")
+            continue;
+
+        try
+        {
+            std::ifstream in(path);
+            const json record = json::parse(in);
+            const std::string object = stringOf(record, "object");
+            if (object == "file")
+            {
+                File file;
+                file.id = stringOf(record, "id");
+                file.filename = stringOf(record, "filename");
+                file.purpose = stringOf(record, "purpose");
+                file.bytes = record.value("bytes", int64_t(0));
+                file.created_at = timestampOf(record, "created_at");
+                file.owner = stringOf(record, "owner");
+                if (fs::exists(fs::path(config_.directory) / (file.id + ".jsonl"), ec))
+                    files_[file.id] = file;
+            }
+            else if (object == "batch")
+            {
+                Batch batch = Batch::fromJson(record);
+                if (!isTerminal(batch.status))
+                    pending.push_back(batch);
+                batches_[batch.id] = batch;
+            }
+        }
+        catch (const std::exception& ex)
+        {
+            KOLOSAL_LOG_WARNING("Batch API: skipping unreadable record %s: %s", path.string().c_str(), ex.what());
+        }
+    }
+
+    std::sort(pending.begin(), pending.end(), [](const Batch& a, const Batch& b) { return a.created_at < b.created_at; });
+    for (const auto& batch : pending)
+        queue_.push_back(batch.id);
+}
+
+void BatchManager::persistLocked(const Batch& batch) const
+{
+    const std::string path = metaPath(batch.id);
+    const std::string temp = path + ".tmp";
+    json record = batch.toJson();
+    record["owner"] = batch.owner;
+    {
+        std::ofstream out(temp, std::ios::trunc);
+        out << record.dump();
+        if (!out)
+        {
+            KOLOSAL_LOG_WARNING("Batch API: failed to write %s", temp.c_str());
+            return;
+        }
+    }
+    std::error_code ec;
+    fs::rename(temp, path, ec);
+    if (ec)
+        KOLOSAL_LOG_WARNING("Batch API: failed to replace %s: %s", path.c_str(), ec.message().c_str());
+}
+
+void BatchManager::writeFileMetaLocked(const File& file) const
+{
+    json record = file.toJson();
+    record["owner"] = file.owner;
+    std::ofstream out(metaPath(file.id), std::ios::trunc);
+    out << record.dump();
+}
+
+BatchManager::File BatchManager::addFile(const std::string& owner, const std::string& path, const std::string& filename,
+                                         const std::string& purpose)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    File file;
+    file.id = "file-" + randomHex(12);
+    file.filename = filename;
+    file.purpose = purpose;
+    file.created_at = now();
+    file.owner = owner;
+
+    std::error_code ec;
+    const fs::path target = fs::path(config_.directory) / (file.id + ".jsonl");
+    fs::rename(path, target, ec);
+    if (ec)
+    {
+        fs::remove(path, ec);
+        throw std::runtime_error("Failed to store the uploaded file");
+    }
+    file.bytes = static_cast<int64_t>(fs::file_size(target, ec));
+
+    files_[file.id] = file;
+    writeFileMetaLocked(file);
+    return file;
+}
+
+std::optional<BatchManager::File> BatchManager::getFile(const std::string& owner, const std::string& id) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = files_.find(id);
+    if (it == files_.end() || it->second.owner != owner)
+        return std::nullopt;
+    return it->second;
+}
+
+std::vector<BatchManager::File> BatchManager::listFiles(const std::string& owner, const std::string& purpose) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<File> files;
+    for (const auto& [id, file] : files_)
+    {
+        if (file.owner == owner && (purpose.empty() || file.purpose == purpose))
+            files.push_back(file);
+    }
+    std::sort(files.begin(), files.end(), [](const File& a, const File& b) { return a.created_at > b.created_at; });
+    return files;
+}
+
+std::string BatchManager::filePath(const std::string& owner, const std::string& id) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = files_.find(id);
+    if (it == files_.end() || it->second.owner != owner)
+        return std::string();
+    return (fs::path(config_.directory) / (id + ".jsonl")).string();
+}
+
+bool BatchManager::deleteFile(const std::string& owner, const std::string& id)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto file = files_.find(id);
+    if (file == files_.end() || file->second.owner != owner)
+        return false;
+    for (const auto& [batchId, batch] : batches_)
+    {
+        if (batch.input_file_id == id && !isTerminal(batch.status))
+            throw std::invalid_argument("File " + id + " is the input of batch " + batchId + ", which has not ended");
+    }
+
+    std::error_code ec;
+    fs::remove(fs::path(config_.directory) / (id + ".jsonl"), ec);
+    fs::remove(metaPath(id), ec);
+    files_.erase(id);
+    return true;
+}
+
+BatchManager::Batch BatchManager::createBatch(const std::string& owner, const std::string& input_file_id,
+                                              const std::string& endpoint, const std::string& completion_window,
+                                              const json& metadata)
+{
+    if (endpoint != "/v1/chat/completions" && endpoint != "/v1/completions")
+        throw std::invalid_argument("endpoint must be /v1/chat/completions or /v1/completions");
+    if (completion_window != "24h")
+        throw std::invalid_argument("completion_window must be 24h");
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto file = files_.find(input_file_id);
+    if (file == files_.end() || file->second.owner != owner)
+        throw std::invalid_argument("No such file: " + input_file_id);
+    if (file->second.purpose != "batch")
+        throw std::invalid_argument("File " + input_file_id + " was not uploaded with purpose 'batch'");
+
+    Batch batch;
+    batch.id = "batch_" + randomHex(12);
+    batch.endpoint = endpoint;
+    batch.input_file_id = input_file_id;
+    batch.completion_window = completion_window;
+    batch.created_at = now();
+    batch.expires_at = batch.created_at + 24 * 3600;
+    batch.metadata = metadata;
+    batch.owner = owner;
+
+    batches_[batch.id] = batch;
+    persistLocked(batch);
+    queue_.push_back(batch.id);
+    cv_.notify_all();
+    return batch;
+}
+
+std::optional<BatchManager::Batch> BatchManager::getBatch(const std::string& owner, const std::string& id) const
+{
+    auto batch = storedBatch(id);
+    if (!batch || batch->owner != owner)
+        return std::nullopt;
+    return batch;
+}
+
+// Any tenant's batch, for the worker
+std::optional<BatchManager::Batch> BatchManager::storedBatch(const std::string& id) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = batches_.find(id);
+    if (it == batches_.end())
+        return std::nullopt;
+    return it->second;
+}
+
+std::vector<BatchManager::Batch> BatchManager::listBatches(const std::string& owner, const std::string& after, size_t limit) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<Batch> batches;
+    for (const auto& [id, batch] : batches_)
+    {
+        if (batch.owner == owner)
+            batches.push_back(batch);
+    }
+    std::sort(batches.begin(), batches.end(), [](const Batch& a, const Batch& b)
+              { return a.created_at != b.created_at ? a.created_at > b.created_at : a.id > b.id; });
+
+    if (!after.empty())
+    {
+        auto it = std::find_if(batches.begin(), batches.end(), [&after](const Batch& batch) { return batch.id == after; });
+        batches.erase(batches.begin(), it == batches.end() ? it : std::next(it));
+    }
+    if (batches.size() > limit)
+        batches.resize(limit);
+    return batches;
+}
+
+std::optional<BatchManager::Batch> BatchManager::cancelBatch(const std::string& owner, const std::string& id)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = batches_.find(id);
+    if (it == batches_.end() || it->second.owner != owner)
+        return std::nullopt;
+
+    Batch& batch = it->second;
+    if (batch.status == "validating" || batch.status == "in_progress")
+    {
+        batch.status = "cancelling";
+        batch.cancelling_at = now();
+        persistLocked(batch);
+        cv_.notify_all();
+    }
+    return batch;
+}
+
+bool BatchManager::cancelRequested(const std::string& batchId) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = batches_.find(batchId);
+    return it != batches_.end() && it->second.status == "cancelling";
+}
+
+// Progress from the worker; a cancellation that arrived meanwhile is kept
+void BatchManager::update(const Batch& batch)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    Batch& stored = batches_[batch.id];
+    const bool cancelling = stored.status == "cancelling";
+    const int64_t cancellingAt = stored.cancelling_at;
+    stored = batch;
+    if (cancelling)
+    {
+        stored.status = "cancelling";
+        stored.cancelling_at = cancellingAt;
+    }
+    persistLocked(stored);
+}
+
+// Ends a batch: the results written so far become its output and error files
+void BatchManager::finish(Batch& batch, const std::string& status)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    const int64_t timestamp = now();
+    batch.cancelling_at = batches_[batch.id].cancelling_at;
+    batch.finalizing_at = timestamp;
+
+    auto publish = [&](const std::string& partial, const std::string& name, std::string& fileId)
+    {
+        std::error_code ec;
+        if (!fs::exists(partial, ec))
+            return;
+        if (fs::file_size(partial, ec) == 0)
+        {
+            fs::remove(partial, ec);
+            return;
+        }
+        File file;
+        file.id = "file-" + randomHex(12);
+        file.filename = batch.id + "_" + name + ".jsonl";
+        file.purpose = "batch_output";
+        file.created_at = timestamp;
+        file.owner = batch.owner;
+        const fs::path target = fs::path(config_.directory) / (file.id + ".jsonl");
+        fs::rename(partial, target, ec);
+        if (ec)
+        {
+            KOLOSAL_LOG_ERROR("Batch API: failed to publish %s: %s", partial.c_str(), ec.message().c_str());
+            return;
+        }
+        file.bytes = static_cast<int64_t>(fs::file_size(target, ec));
+        files_[file.id] = file;
+        writeFileMetaLocked(file);
+        fileId = file.id;
+    };
+    publish(outputPath(batch.id), "output", batch.output_file_id);
+    publish(errorPath(batch.id), "errors", batch.error_file_id);
+
+    batch.status = status;
+    if (status == "completed")
+        batch.completed_at = timestamp;
+    else if (status == "failed")
+        batch.failed_at = timestamp;
+    else if (status == "expired")
+        batch.expired_at = timestamp;
+    else if (status == "cancelled")
+        batch.cancelled_at = timestamp;
+
+    batches_[batch.id] = batch;
+    persistLocked(batch);
+    KOLOSAL_LOG_INFO("Batch %s %s: %d completed, %d failed of %d", batch.id.c_str(), status.c_str(),
+                          batch.completed, batch.failed, batch.total);
+}
+
+void BatchManager::run()
+{
+    while (true)
+    {
+        std::string batchId;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+            if (stopping_)
+                return;
+            batchId = queue_.front();
+            queue_.pop_front();
+        }
+
+        try
+        {
+            process(batchId);
+        }
+        catch (const std::exception& ex)
+        {
+            KOLOSAL_LOG_ERROR("Batch %s stopped on an error: %s", batchId.c_str(), ex.what());
+            auto batch = storedBatch(batchId);
+            if (batch)
+            {
+                batch->error = ex.what();
+                finish(*batch, "failed");
+            }
+        }
+    }
+}
+
+void BatchManager::process(const std::string& batchId)
+{
+    auto stored = storedBatch(batchId);
+    if (!stored || isTerminal(stored->status))
+        return;
+    Batch batch = *stored;
+    if (batch.status == "cancelling")
+    {
+        finish(batch, "cancelled");
+        return;
+    }
+
+    const std::string inputPath = filePath(batch.owner, batch.input_file_id);
+    std::ifstream input(inputPath, std::ios::binary);
+    if (inputPath.empty() || !input)
+    {
+        batch.error = "Input file " + batch.input_file_id + " is no longer available";
+        finish(batch, "failed");
+        return;
+    }
+    const bool chat = batch.endpoint == "/v1/chat/completions";
+
+    // Validate every line up front, as a malformed file fails the whole batch
+    std::set<std::string> written;
+    batch.completed = collectWritten(outputPath(batch.id), written);
+    batch.failed = collectWritten(errorPath(batch.id), written);
+
+    std::vector<Item> items;
+    std::set<std::string> customIds;
+    std::string line;
+    uint64_t offset = 0;
+    int lineNumber = 0;
+    while (std::getline(input, line))
+    {
+        const uint64_t lineOffset = offset;
+        offset += line.size() + 1;
+        ++lineNumber;
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+        if (line.find_first_not_of(" \t") == std::string::npos)
+            continue;
+
+        std::string problem;
+        json record;
+        try
+        {
+            record = json::parse(line);
+        }
+        catch (const json::parse_error&)
+        {
+            problem = "is not valid JSON";
+        }
+        if (problem.empty())
+        {
+            const json body = record.contains("body") ? record["body"] : json();
+            if (!record.is_object() || stringOf(record, "custom_id").empty())
+                problem = "has no custom_id";
+            else if (!customIds.insert(stringOf(record, "custom_id")).second)
+                problem = "repeats custom_id '" + stringOf(record, "custom_id") + "'";
+            else if (record.contains("method") && stringOf(record, "method") != "POST")
+                problem = "has a method other than POST";
+            else if (stringOf(record, "url") != batch.endpoint)
+                problem = "targets '" + stringOf(record, "url") + "' instead of the batch endpoint " + batch.endpoint;
+            else if (!body.is_object() || stringOf(body, "model").empty())
+                problem = "has no body with a model";
+            else if (body.value("stream", false))
+                problem = "asks for streaming, which batches do not support";
+        }
+        if (!problem.empty())
+        {
+            batch.error = "Line " + std::to_string(lineNumber) + " " + problem;
+            finish(batch, "failed");
+            return;
+        }
+
+        Item item;
+        item.customId = stringOf(record, "custom_id");
+        if (written.count(item.customId))
+            continue;
+        item.offset = lineOffset;
+        item.length = static_cast<uint32_t>(offset - lineOffset - 1);
+        item.model = stringOf(record["body"], "model");
+        item.sortKey = sortKeyOf(record["body"], chat);
+        items.push_back(std::move(item));
+    }
+    input.clear();
+
+    batch.total = static_cast<int>(customIds.size());
+    if (batch.total == 0)
+    {
+        batch.error = "The input file has no requests";
+        finish(batch, "failed");
+        return;
+    }
+
+    // Requests sharing a prompt prefix run back to back, so it is prefilled once and reused
+    std::stable_sort(items.begin(), items.end(), [](const Item& a, const Item& b)
+                     { return a.model != b.model ? a.model < b.model : a.sortKey < b.sortKey; });
+
+    if (batch.in_progress_at == 0)
+        batch.in_progress_at = now();
+    batch.status = "in_progress";
+    update(batch);
+    KOLOSAL_LOG_INFO("Batch %s in progress: %zu request(s) to run of %d", batch.id.c_str(), items.size(), batch.total);
+
+    int reservedSlots = 0;
+    int maxInFlight = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        reservedSlots = config_.reserved_slots;
+        maxInFlight = config_.max_in_flight;
+    }
+
+    std::ofstream output(outputPath(batch.id), std::ios::binary | std::ios::app);
+    std::ofstream errors(errorPath(batch.id), std::ios::binary | std::ios::app);
+    auto writeRecord = [&](std::ofstream& out, const json& record)
+    {
+        out << record.dump() << '\n';
+        out.flush();
+    };
+    auto end = [&](const std::string& status)
+    {
+        output.close();
+        errors.close();
+        finish(batch, status);
+    };
+    auto writeError = [&](const std::string& customId, int status, const std::string& message, const std::string& type)
+    {
+        writeRecord(errors, errorRecord(customId, status, message, type));
+        ++batch.failed;
+    };
+
+    struct Running
+    {
+        std::string customId;
+        std::string model;
+        std::shared_ptr<IInferenceEngine> engine;
+        std::vector<int> jobIds;
+        std::unique_ptr<auth::TokenQuotaCharge> charge;   // Settled when the entry is dropped
+    };
+    std::vector<Running> running;
+    std::map<IInferenceEngine*, int> inFlight;
+    auto &nodeManager = ServerAPI::instance().getNodeManager();
+    auto &tokenQuota = ServerAPI::instance().getAuthMiddleware().getTokenQuota();
+
+    // Out of quota, the batch waits for its owner's quota to refill rather than failing requests
+    auto quotaRetryAt = std::chrono::steady_clock::now();
+
+    auto stopRunning = [&]()
+    {
+        for (auto& job : running)
+        {
+            for (int jobId : job.jobIds)
+            {
+                job.engine->stopJob(jobId);
+                job.engine->releaseJob(jobId);
+            }
+        }
+        running.clear();
+    };
+
+    // A batch job only starts while the engine keeps reservedSlots free for interactive requests
+    auto hasRoom = [&](IInferenceEngine& engine, int candidates)
+    {
+        const int ours = inFlight[&engine];
+        if (ours > 0 && ours + candidates > maxInFlight)
+            return false;
+        const DecodeStats stats = engine.getDecodeStats();
+        if (stats.slots_total <= 0)
+            return ours == 0;
+        const int busy = std::max(engine.getLoad().active_jobs, stats.slots_in_use);
+        return ours == 0 ? busy + reservedSlots < stats.slots_total || busy == 0
+                         : busy + candidates + reservedSlots <= stats.slots_total;
+    };
+
+    size_t next = 0;
+    auto lastPersist = std::chrono::steady_clock::now();
+    while (next < items.size() || !running.empty())
+    {
+        bool stopping = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping = stopping_;
+        }
+        if (stopping)
+        {
+            // Resumes from the results written so far on the next start
+            stopRunning();
+            update(batch);
+            return;
+        }
+        if (cancelRequested(batch.id))
+        {
+            stopRunning();
+            end("cancelled");
+            return;
+        }
+        if (now() >= batch.expires_at)
+        {
+            stopRunning();
+            end("expired");
+            return;
+        }
+
+        bool progressed = false;
+
+        // Collect finished requests
+        for (auto it = running.begin(); it != running.end();)
+        {
+            auto& job = *it;
+            if (!std::all_of(job.jobIds.begin(), job.jobIds.end(), [&job](int jobId) { return job.engine->isJobFinished(jobId); }))
+            {
+                ++it;
+                continue;
+            }
+
+            std::string failure;
+            std::vector<CompletionResult> results;
+            for (int jobId : job.jobIds)
+            {
+                if (job.engine->hasJobError(jobId))
+                    failure = job.engine->getJobError(jobId);
+                else
+                    results.push_back(job.engine->getJobResult(jobId));
+            }
+            if (job.charge)
+            {
+                if (!results.empty() && results.front().prompt_token_count > 0)
+                    job.charge->setPromptTokens(static_cast<size_t>(results.front().prompt_token_count));
+                for (const auto& result : results)
+                    job.charge->addGeneratedTokens(result.tokens.size());
+            }
+
+            if (!failure.empty())
+            {
+                writeError(job.customId, 500, failure, "server_error");
+            }
+            else
+            {
+                const json body = completionResponseBody(chat, job.model, job.jobIds.front(), results);
+                writeRecord(output, {{"id", "batch_req_" + randomHex(12)},
+                                     {"custom_id", job.customId},
+                                     {"response", {{"status_code", 200}, {"request_id", body.value("id", "")}, {"body", body}}},
+                                     {"error", nullptr}});
+                ++batch.completed;
+            }
+
+            for (int jobId : job.jobIds)
+                job.engine->releaseJob(jobId);
+            inFlight[job.engine.get()] -= static_cast<int>(job.jobIds.size());
+            it = running.erase(it);
+            progressed = true;
+        }
+
+        // Start requests while the engines have spare slots
+        while (next < items.size() && std::chrono::steady_clock::now() >= quotaRetryAt)
+        {
+            const Item& item = items[next];
+
+            json request;
+            input.seekg(static_cast<std::streamoff>(item.offset));
+            std::string text(item.length, '\0');
+            input.read(&text[0], static_cast<std::streamsize>(text.size()));
+            try
+            {
+                request = json::parse(text)["body"];
+            }
+            catch (const json::exception& ex)
+            {
+                writeError(item.customId, 400, std::string("Invalid request: ") + ex.what(), "invalid_request_error");
+                ++next;
+                continue;
+            }
+
+            const int candidates = request.value("n", 1);
+            if (candidates < 1 || candidates > kMaxCandidates)
+            {
+                writeError(item.customId, 400, "n must be between 1 and " + std::to_string(kMaxCandidates), "invalid_request_error");
+                ++next;
+                continue;
+            }
+
+            auto engine = nodeManager.getEngine(item.model);
+            if (!engine)
+            {
+                // Startup models load in the background; a resumed batch waits for them
+                const auto states = nodeManager.getStartupStates();
+                auto state = states.find(item.model);
+                if (state != states.end() && (state->second == "pending" || state->second == "loading" ||
+                                              state->second == "downloading"))
+                    break;
+                writeError(item.customId, 404, "Model '" + item.model + "' not found or could not be loaded", "invalid_request_error");
+                ++next;
+                continue;
+            }
+            if (!hasRoom(*engine, candidates))
+                break;
+
+            // Each request is charged to the batch owner's quota as it starts, with the estimate
+            // a synchronous request reserves; one that fails to start refunds it
+            std::vector<int> jobIds;
+            std::unique_ptr<auth::TokenQuotaCharge> charge;
+            size_t promptEstimate = 0;
+            try
+            {
+                const RequestEstimate estimate = estimateRequestTokens(chat, request, candidates);
+                promptEstimate = estimate.promptTokens;
+                if (!batch.owner.empty())
+                {
+                    auto reservation = tokenQuota.reserve(batch.owner, item.model, estimate.totalTokens);
+                    if (!reservation.allowed)
+                    {
+                        quotaRetryAt = std::chrono::steady_clock::now() + reservation.retryAfter;
+                        break;
+                    }
+                    charge = std::make_unique<auth::TokenQuotaCharge>(tokenQuota, std::move(reservation));
+                }
+                jobIds = submitCompletionJobs(*engine, chat, request, candidates, kBatchPriority, batch.owner);
+            }
+            catch (const std::exception& ex)
+            {
+                writeError(item.customId, 400, ex.what(), "invalid_request_error");
+                ++next;
+                continue;
+            }
+            if (jobIds.empty())
+            {
+                writeError(item.customId, 500, "Failed to submit job to inference engine", "server_error");
+                ++next;
+                continue;
+            }
+            if (charge)
+                charge->setPromptTokens(promptEstimate);
+
+            inFlight[engine.get()] += candidates;
+            running.push_back(Running{item.customId, item.model, std::move(engine), std::move(jobIds), std::move(charge)});
+            ++next;
+            progressed = true;
+        }
+
+        if (std::chrono::steady_clock::now() - lastPersist >= kPersistInterval)
+        {
+            update(batch);
+            lastPersist = std::chrono::steady_clock::now();
+        }
+
+        if (!progressed)
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait_for(lock, std::chrono::milliseconds(20), [this] { return stopping_; });
+        }
+    }
+
+    end("completed");
+}
+
+} // namespace kolosal
@@ -0,0 +1,761 @@
+#include "kolosal/cluster_router.hpp"
+#include "kolosal/auth/rate_limiter.hpp"
+#include "kolosal/server_api.hpp"
+#include "kolosal/node_manager.h"
+#include "kolosal/utils.hpp"
+#include "kolosal/logger.hpp"
+#include <curl/curl.h>
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+using json = nlohmann::json;
+
+namespace kolosal
+{
+
+namespace
+{
+    constexpr size_t kMaxAdvertisedKeys = 2048;        // Keys in the published summary, oldest dropped first
+    constexpr long kConnectTimeoutMs = 1000;
+    const char* const kForwardedHeader = "X-Kolosal-Forwarded";
+    const char* const kStatePath = "/v1/cluster/state";
+
+    uint64_t fnv1a(const std::string& text)
+    {
+        uint64_t hash = 1469598103934665603ULL;
+        for (unsigned char c : text)
+        {
+            hash ^= c;
+            hash *= 1099511628211ULL;
+        }
+        // FNV alone spreads similar strings poorly over the ring; finish with a splitmix round
+        hash ^= hash >> 30;
+        hash *= 0xbf58476d1ce4e5b9ULL;
+        hash ^= hash >> 27;
+        hash *= 0x94d049bb133111ebULL;
+        hash ^= hash >> 31;
+        return hash;
+    }
+
+    uint64_t sessionHash(const std::string& model, const std::string& sessionKey)
+    {
+        // Engine keys carry suffixes after a unit separator (the LoRA adapter); requests do not
+        return fnv1a(model + '\0' + "session:" + sessionKey.substr(0, sessionKey.find('\x1f')));
+    }
+
+    std::string trimSlash(std::string url)
+    {
+        while (!url.empty() && url.back() == '/')
+            url.pop_back();
+        return url;
+    }
+
+    std::string textOf(const json& content)
+    {
+        return content.is_string() ? content.get<std::string>() : content.dump();
+    }
+
+    size_t appendHeader(char* data, size_t size, size_t count, void* userdata)
+    {
+        auto* headers = static_cast<std::map<std::string, std::string>*>(userdata);
+        std::string line(data, size * count);
+        const size_t colon = line.find(':');
+        if (line.rfind("HTTP/", 0) == 0)
+        {
+            headers->clear();   // A new response (after a 100 Continue or a redirect)
+        }
+        else if (colon != std::string::npos)
+        {
+            std::string name = line.substr(0, colon);
+            std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+            std::string value = line.substr(colon + 1);
+            value.erase(0, value.find_first_not_of(" \t"));
+            while (!value.empty() && (value.back() == '\r' || value.back() == '\n' || value.back() == ' '))
+                value.pop_back();
+            (*headers)[name] = value;
+        }
+        return size * count;
+    }
+
+    size_t appendBody(char* data, size_t size, size_t count, void* userdata)
+    {
+        static_cast<std::string*>(userdata)->append(data, size * count);
+        return size * count;
+    }
+
+    // Relays a peer's response to the client as it arrives
+    struct Relay
+    {
+        SocketType sock;
+        CURL* curl = nullptr;
+        std::map<std::string, std::string> headers;
+        std::string body;
+        bool streaming = false;
+        bool started = false;   // Headers went out to the client; the request cannot be retried
+        bool clientGone = false;
+
+        std::map<std::string, std::string> responseHeaders() const
+        {
+            std::map<std::string, std::string> out;
+            auto type = headers.find("content-type");
+            out["Content-Type"] = type != headers.end() ? type->second : "application/json";
+            auto retryAfter = headers.find("retry-after");
+            if (retryAfter != headers.end())
+                out["Retry-After"] = retryAfter->second;
+            return out;
+        }
+
+        static size_t write(char* data, size_t size, size_t count, void* userdata)
+        {
+            auto* relay = static_cast<Relay*>(userdata);
+            const size_t bytes = size * count;
+            if (!relay->started)
+            {
+                auto type = relay->headers.find("content-type");
+                relay->streaming = type != relay->headers.end() && type->second.find("text/event-stream") != std::string::npos;
+                if (relay->streaming)
+                {
+                    long status = 200;
+                    curl_easy_getinfo(relay->curl, CURLINFO_RESPONSE_CODE, &status);
+                    begin_streaming_response(relay->sock, static_cast<int>(status), relay->responseHeaders());
+                    relay->started = true;
+                }
+            }
+            if (!relay->streaming)
+            {
+                relay->body.append(data, bytes);
+                return bytes;
+            }
+            if (client_disconnected(relay->sock))
+            {
+                relay->clientGone = true;
+                return 0;   // Aborts the transfer, which stops the generation on the peer
+            }
+            send_stream_chunk(relay->sock, StreamChunk(std::string(data, bytes), false));
+            return bytes;
+        }
+    };
+}
+
+ClusterRouter& ClusterRouter::instance()
+{
+    static ClusterRouter router;
+    return router;
+}
+
+ClusterRouter::~ClusterRouter()
+{
+    stop();
+}
+
+void ClusterRouter::start(const ClusterConfig& config)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (enabled_.load() || !config.enabled)
+        return;
+
+    config_ = config;
+    config_.advertise_url = trimSlash(config.advertise_url);
+    node_id_ = config.node_id.empty() ? config_.advertise_url : config.node_id;
+    peers_.clear();
+    for (const auto& url : config.peers)
+    {
+        Node peer;
+        peer.url = trimSlash(url);
+        if (peer.url.empty() || peer.url == config_.advertise_url)
+            continue;
+        peers_.push_back(std::move(peer));
+    }
+    rebuildRingLocked();
+
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+    stopping_ = false;
+    enabled_.store(true);
+    poller_ = std::thread(&ClusterRouter::run, this);
+    KOLOSAL_LOG_INFO("Cluster routing enabled as '%s' with %zu peer(s)", node_id_.c_str(), peers_.size());
+}
+
+void ClusterRouter::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!enabled_.load())
+            return;
+        stopping_ = true;
+        enabled_.store(false);
+    }
+    cv_.notify_all();
+    if (poller_.joinable())
+        poller_.join();
+}
+
+void ClusterRouter::shareRateLimits(auth::RateLimiter* limiter)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (rate_limiter_ && rate_limiter_ != limiter)
+        rate_limiter_->setSharing(false);
+    rate_limiter_ = limiter;
+    for (auto& peer : peers_)
+    {
+        peer.admitted[0].clear();
+        peer.admitted[1].clear();
+    }
+    if (rate_limiter_)
+        rate_limiter_->setSharing(true);
+}
+
+std::string ClusterRouter::routingKey(const RequestContext& request, const json& body) const
+{
+    auto session = request.headers.find("x-session-id");
+    if (session != request.headers.end() && !session->second.empty())
+        return "session:" + session->second;
+    if (body.contains("session_id") && body["session_id"].is_string() && !body["session_id"].get<std::string>().empty())
+        return "session:" + body["session_id"].get<std::string>();
+
+    // Messages up to the first user turn stay the same for the whole conversation
+    const size_t limit = static_cast<size_t>(config_.prefix_chars);
+    std::string key;
+    if (body.contains("messages") && body["messages"].is_array())
+    {
+        for (const auto& message : body["messages"])
+        {
+            if (!message.is_object())
+                break;
+            key.append(message.value("role", "")).push_back('\n');
+            if (message.contains("content"))
+                key.append(textOf(message["content"]));
+            key.push_back('\n');
+            if (key.size() >= limit || message.value("role", "") == "user")
+                break;
+        }
+    }
+    else if (body.contains("prompt"))
+    {
+        const json& prompt = body["prompt"];
+        key = prompt.is_array() && !prompt.empty() ? textOf(prompt[0]) : textOf(prompt);
+    }
+    if (key.size() > limit)
+        key.resize(limit);
+    return "prefix:" + key;
+}
+
+std::map<std::string, ClusterRouter::ModelLoad> ClusterRouter::localModels() const
+{
+    std::map<std::string, ModelLoad> models;
+    for (const auto& replica : ServerAPI::instance().getNodeManager().getReplicaStats())
+    {
+        ModelLoad& load = models[replica.engineId];
+        load.active_jobs += replica.load.active_jobs;
+        load.pending_tokens += replica.load.pending_tokens;
+        load.slots_total += replica.decode.slots_total;
+        load.slots_in_use += replica.decode.slots_in_use;
+    }
+    return models;
+}
+
+ClusterRouter::Target ClusterRouter::route(const std::string& model, uint64_t keyHash)
+{
+    struct Candidate
+    {
+        Node* peer;             // nullptr for this node
+        ModelLoad load;
+    };
+
+    const auto local = localModels();
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto now = std::chrono::steady_clock::now();
+    const auto staleAfter = std::chrono::milliseconds(config_.stale_after_ms);
+
+    std::map<std::string, Candidate> candidates;
+    auto localModel = local.find(model);
+    if (localModel != local.end() && !draining_.load())
+        candidates[node_id_] = Candidate{nullptr, localModel->second};
+    for (auto& peer : peers_)
+    {
+        if (peer.self || peer.draining || now - peer.last_seen > staleAfter)
+            continue;
+        auto it = peer.models.find(model);
+        if (it == peer.models.end())
+            continue;
+        ModelLoad load = it->second;
+        load.active_jobs += peer.routed_since_poll;
+        candidates[peer.node_id] = Candidate{&peer, load};
+    }
+
+    auto choose = [&](const Candidate& candidate, Reason reason)
+    {
+        const int target = candidate.peer ? 1 : 0;
+        ++stats_.routed[target][static_cast<int>(reason)];
+        if (!candidate.peer)
+            return Target{};
+        ++candidate.peer->routed_since_poll;
+        return Target{false, candidate.peer->node_id, candidate.peer->url};
+    };
+
+    // Nobody else has the model loaded: serve (or lazily load) it here
+    if (candidates.empty() || (candidates.size() == 1 && candidates.begin()->second.peer == nullptr))
+    {
+        ++stats_.routed[0][static_cast<int>(Reason::Only)];
+        return Target{};
+    }
+    if (candidates.size() == 1)
+        return choose(candidates.begin()->second, Reason::Only);
+
+    // Bounded-load hashing: a node takes a key while it has a free slot or stays within
+    // load_factor times its fair share of the jobs, counting this one
+    int totalJobs = 0;
+    for (const auto& [id, candidate] : candidates)
+        totalJobs += candidate.load.active_jobs;
+    const double cap = std::ceil(config_.load_factor * (totalJobs + 1) / static_cast<double>(candidates.size()));
+    auto acceptable = [&](const Candidate& candidate)
+    {
+        return candidate.load.slots_in_use < candidate.load.slots_total || candidate.load.active_jobs + 1 <= cap;
+    };
+
+    // A node that served the key recently probably still holds its KV; this node first
+    auto self = candidates.find(node_id_);
+    if (self != candidates.end() && recent_.count(keyHash) && acceptable(self->second))
+        return choose(self->second, Reason::Affinity);
+    for (const auto& [id, candidate] : candidates)
+    {
+        if (candidate.peer && candidate.peer->prefixes.count(keyHash) && acceptable(candidate))
+            return choose(candidate, Reason::Affinity);
+    }
+
+    // The key's owner on the ring, or the next acceptable node after it
+    if (!ring_.empty())
+    {
+        auto point = std::lower_bound(ring_.begin(), ring_.end(), std::make_pair(keyHash, std::string()));
+        bool first = true;
+        std::unordered_set<std::string> seen;
+        for (size_t step = 0; step < ring_.size() && seen.size() < candidates.size(); ++step, ++point)
+        {
+            if (point == ring_.end())
+                point = ring_.begin();
+            auto candidate = candidates.find(point->second);
+            if (candidate == candidates.end() || !seen.insert(point->second).second)
+                continue;
+            if (acceptable(candidate->second))
+                return choose(candidate->second, first ? Reason::Hash : Reason::Fallback);
+            first = false;
+        }
+    }
+
+    // Every node is over its share: the least loaded per slot
+    const Candidate* best = nullptr;
+    double bestRatio = 0.0;
+    for (const auto& [id, candidate] : candidates)
+    {
+        const double ratio = candidate.load.active_jobs / static_cast<double>(std::max(1, candidate.load.slots_total));
+        if (!best || ratio < bestRatio)
+        {
+            best = &candidate;
+            bestRatio = ratio;
+        }
+    }
+    return choose(*best, Reason::Fallback);
+}
+
+void ClusterRouter::remember(uint64_t keyHash)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!recent_.insert(keyHash).second)
+        return;
+    recent_order_.push_back(keyHash);
+    if (recent_order_.size() > kMaxAdvertisedKeys)
+    {
+        recent_.erase(recent_order_.front());
+        recent_order_.pop_front();
+    }
+}
+
+bool ClusterRouter::forward(SocketType sock, const RequestContext& request, const json& body)
+{
+    if (!enabled())
+        return false;
+
+    const std::string model = body.value("model", "");
+    const uint64_t keyHash = fnv1a(model + '\0' + routingKey(request, body));
+
+    // Another node already chose this one
+    if (request.headers.count("x-kolosal-forwarded"))
+    {
+        remember(keyHash);
+        return false;
+    }
+
+    const Target target = route(model, keyHash);
+    if (target.local)
+    {
+        remember(keyHash);
+        return false;
+    }
+
+    if (proxy(sock, request, target))
+        return true;
+
+    // The peer failed before answering: take it out until it answers a poll again
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++stats_.proxy_errors;
+        for (auto& peer : peers_)
+        {
+            if (peer.node_id == target.node_id)
+                peer.last_seen = std::chrono::steady_clock::time_point{};
+        }
+    }
+    remember(keyHash);
+    return false;
+}
+
+void ClusterRouter::setDraining(bool draining)
+{
+    draining_.store(draining);
+    KOLOSAL_LOG_INFO(draining ? "Cluster: node '%s' is draining" : "Cluster: node '%s' takes requests again",
+                          node_id_.c_str());
+}
+
+std::string ClusterRouter::handoffTarget(const std::string& model, const std::string& sessionKey) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto now = std::chrono::steady_clock::now();
+    const auto staleAfter = std::chrono::milliseconds(config_.stale_after_ms);
+    auto usable = [&](const Node& peer)
+    {
+        return !peer.self && !peer.draining && now - peer.last_seen <= staleAfter && peer.models.count(model);
+    };
+
+    // The key's owner on the ring without this node, so the session's next turn is routed to it
+    const uint64_t keyHash = sessionHash(model, sessionKey);
+    auto point = std::lower_bound(ring_.begin(), ring_.end(), std::make_pair(keyHash, std::string()));
+    for (size_t step = 0; step < ring_.size(); ++step, ++point)
+    {
+        if (point == ring_.end())
+            point = ring_.begin();
+        for (const auto& peer : peers_)
+        {
+            if (peer.node_id == point->second && usable(peer))
+                return peer.url;
+        }
+    }
+    return std::string();
+}
+
+void ClusterRouter::adopt(const std::string& model, const std::string& sessionKey)
+{
+    if (enabled())
+        remember(sessionHash(model, sessionKey));
+}
+
+bool ClusterRouter::proxy(SocketType sock, const RequestContext& request, const Target& target)
+{
+    // One handle per connection thread keeps connections to the peers alive between requests
+    thread_local struct Handle
+    {
+        CURL* curl = curl_easy_init();
+        ~Handle() { if (curl) curl_easy_cleanup(curl); }
+    } handle;
+    CURL* curl = handle.curl;
+    if (!curl)
+        return false;
+    curl_easy_reset(curl);
+
+    struct curl_slist* headers = nullptr;
+    headers = curl_slist_append(headers, "Content-Type: application/json");
+    headers = curl_slist_append(headers, "Expect:");
+    headers = curl_slist_append(headers, (std::string(kForwardedHeader) + ": " + node_id_).c_str());
+    headers = curl_slist_append(headers, ("X-Forwarded-For: " + request.clientIP).c_str());
+    // The serving node applies the client's own authentication and quotas
+    for (const char* name : {"authorization", "x-api-key", "x-session-id", "traceparent", "accept"})
+    {
+        auto it = request.headers.find(name);
+        if (it != request.headers.end())
+            headers = curl_slist_append(headers, (std::string(name) + ": " + it->second).c_str());
+    }
+
+    Relay relay{sock, curl};
+    const std::string url = target.url + request.path;
+    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+    curl_easy_setopt(curl, CURLOPT_POST, 1L);
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, request.body.data());
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE_LARGE, static_cast<curl_off_t>(request.body.size()));
+    curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, appendHeader);
+    curl_easy_setopt(curl, CURLOPT_HEADERDATA, &relay.headers);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, Relay::write);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &relay);
+    curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT_MS, kConnectTimeoutMs);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT, static_cast<long>(config_.proxy_timeout_seconds));
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(curl, CURLOPT_TCP_NODELAY, 1L);
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+
+    const CURLcode result = curl_easy_perform(curl);
+    curl_slist_free_all(headers);
+
+    if (relay.started)
+    {
+        if (result != CURLE_OK && !relay.clientGone)
+        {
+            KOLOSAL_LOG_WARNING("[Thread %zu] Stream from cluster node '%s' ended early: %s",
+                                     std::hash<std::thread::id>{}(std::this_thread::get_id()), target.node_id.c_str(), curl_easy_strerror(result));
+        }
+        if (!relay.clientGone)
+            send_stream_chunk(sock, StreamChunk("", true));
+        return true;
+    }
+    if (result != CURLE_OK)
+    {
+        KOLOSAL_LOG_WARNING("[Thread %zu] Cluster node '%s' failed, serving locally: %s",
+                                 std::hash<std::thread::id>{}(std::this_thread::get_id()), target.node_id.c_str(), curl_easy_strerror(result));
+        return false;
+    }
+
+    long status = 200;
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status);
+    send_response(sock, static_cast<int>(status), relay.body, relay.responseHeaders());
+    KOLOSAL_LOG_REQUEST_DEBUG("[Thread %zu] Request served by cluster node '%s' (%ld)",
+                           std::hash<std::thread::id>{}(std::this_thread::get_id()), target.node_id.c_str(), status);
+    return true;
+}
+
+json ClusterRouter::localState() const
+{
+    json models = json::object();
+    for (const auto& [id, load] : localModels())
+    {
+        models[id] = {{"active_jobs", load.active_jobs}, {"slots_total", load.slots_total},
+                      {"slots_in_use", load.slots_in_use}, {"pending_tokens", load.pending_tokens}};
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    json state = {{"node_id", node_id_}, {"url", config_.advertise_url}, {"models", models},
+                  {"draining", draining_.load()}, {"prefixes", json(recent_order_)}};
+    if (rate_limiter_)
+    {
+        const auth::RateLimiter::SharedUsage usage = rate_limiter_->sharedUsage();
+        state["rate_limits"] = {{"clients", usage.clients}, {"api_keys", usage.apiKeys}};
+    }
+    return state;
+}
+
+json ClusterRouter::nodes() const
+{
+    json local = localState();
+    local.erase("prefixes");
+    local["self"] = true;
+    json list = json::array({local});
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto now = std::chrono::steady_clock::now();
+    for (const auto& peer : peers_)
+    {
+        if (peer.self)
+            continue;
+        json models = json::object();
+        for (const auto& [id, load] : peer.models)
+        {
+            models[id] = {{"active_jobs", load.active_jobs}, {"slots_total", load.slots_total},
+                          {"slots_in_use", load.slots_in_use}, {"pending_tokens", load.pending_tokens}};
+        }
+        const bool seen = peer.last_seen != std::chrono::steady_clock::time_point{};
+        const auto age = std::chrono::duration_cast<std::chrono::milliseconds>(now - peer.last_seen).count();
+        list.push_back({{"node_id", peer.node_id}, {"url", peer.url}, {"models", models},
+                        {"live", seen && age <= config_.stale_after_ms}, {"draining", peer.draining},
+                        {"last_seen_ms", seen ? json(age) : json(nullptr)},
+                        {"cached_keys", peer.prefixes.size()}});
+    }
+    return {{"object", "list"}, {"data", list}};
+}
+
+ClusterRouter::Stats ClusterRouter::stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stats stats = stats_;
+    const auto now = std::chrono::steady_clock::now();
+    stats.live_nodes = 1;
+    for (const auto& peer : peers_)
+    {
+        if (!peer.self && now - peer.last_seen <= std::chrono::milliseconds(config_.stale_after_ms))
+            ++stats.live_nodes;
+    }
+    return stats;
+}
+
+void ClusterRouter::rebuildRingLocked()
+{
+    std::vector<std::string> ids = {node_id_};
+    for (const auto& peer : peers_)
+    {
+        if (!peer.self && !peer.node_id.empty())
+            ids.push_back(peer.node_id);
+    }
+
+    // Every node places the same points for the same ids, so all nodes agree on each key's owner
+    ring_.clear();
+    for (const auto& id : ids)
+    {
+        for (int i = 0; i < config_.virtual_nodes; ++i)
+            ring_.emplace_back(fnv1a(id + '#' + std::to_string(i)), id);
+    }
+    std::sort(ring_.begin(), ring_.end());
+}
+
+void ClusterRouter::run()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stopping_)
+    {
+        lock.unlock();
+        poll();
+        lock.lock();
+        cv_.wait_for(lock, std::chrono::milliseconds(config_.heartbeat_ms), [this] { return stopping_; });
+    }
+}
+
+void ClusterRouter::chargePeerUsageLocked(Node& peer, const json& usage)
+{
+    static const char* const kinds[2] = {"clients", "api_keys"};
+    for (int kind = 0; kind < 2; ++kind)
+    {
+        // Counts are cumulative per bucket; one lower than last time is a bucket that expired and began again
+        std::map<uint64_t, uint64_t> reported;
+        for (const auto& entry : usage.value(kinds[kind], json::array()))
+        {
+            if (!entry.is_array() || entry.size() != 2 || !entry[0].is_number_unsigned() || !entry[1].is_number_unsigned())
+                continue;
+            const uint64_t hash = entry[0].get<uint64_t>();
+            const uint64_t count = entry[1].get<uint64_t>();
+            auto last = peer.admitted[kind].find(hash);
+            const uint64_t previous = last == peer.admitted[kind].end() ? 0 : last->second;
+            const uint64_t delta = count >= previous ? count - previous : count;
+            if (delta > 0)
+                rate_limiter_->chargeRemote(kind == 1, hash, delta);
+            reported.emplace(hash, count);
+        }
+        peer.admitted[kind] = std::move(reported);
+    }
+}
+
+void ClusterRouter::poll()
+{
+    struct Fetch
+    {
+        size_t index;
+        std::string body;
+        CURL* curl;
+    };
+
+    std::vector<std::string> urls;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& peer : peers_)
+            urls.push_back(peer.self ? std::string() : peer.url);
+    }
+
+    // All peers at once, so a dead one costs one timeout per round rather than one per peer
+    CURLM* multi = curl_multi_init();
+    struct curl_slist* headers = nullptr;
+    if (!config_.api_key.empty())
+        headers = curl_slist_append(headers, ("X-API-Key: " + config_.api_key).c_str());
+    std::vector<Fetch> fetches;
+    fetches.reserve(urls.size());
+    for (size_t i = 0; i < urls.size(); ++i)
+    {
+        if (urls[i].empty())
+            continue;
+        fetches.push_back(Fetch{i, std::string(), curl_easy_init()});
+        Fetch& fetch = fetches.back();
+        const std::string url = urls[i] + kStatePath;
+        curl_easy_setopt(fetch.curl, CURLOPT_URL, url.c_str());
+        curl_easy_setopt(fetch.curl, CURLOPT_WRITEFUNCTION, appendBody);
+        curl_easy_setopt(fetch.curl, CURLOPT_WRITEDATA, &fetch.body);
+        curl_easy_setopt(fetch.curl, CURLOPT_CONNECTTIMEOUT_MS, kConnectTimeoutMs);
+        curl_easy_setopt(fetch.curl, CURLOPT_TIMEOUT_MS, static_cast<long>(config_.stale_after_ms));
+        curl_easy_setopt(fetch.curl, CURLOPT_NOSIGNAL, 1L);
+        if (headers)
+            curl_easy_setopt(fetch.curl, CURLOPT_HTTPHEADER, headers);
+        curl_multi_add_handle(multi, fetch.curl);
+    }
+
+    int running = 0;
+    do
+    {
+        curl_multi_perform(multi, &running);
+        if (running > 0)
+            curl_multi_poll(multi, nullptr, 0, 100, nullptr);
+    } while (running > 0 && enabled());
+
+    std::map<CURL*, CURLcode> results;
+    int remaining = 0;
+    while (CURLMsg* message = curl_multi_info_read(multi, &remaining))
+    {
+        if (message->msg == CURLMSG_DONE)
+            results[message->easy_handle] = message->data.result;
+    }
+
+    bool membershipChanged = false;
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& fetch : fetches)
+    {
+        long status = 0;
+        curl_easy_getinfo(fetch.curl, CURLINFO_RESPONSE_CODE, &status);
+        curl_multi_remove_handle(multi, fetch.curl);
+        curl_easy_cleanup(fetch.curl);
+
+        auto result = results.find(fetch.curl);
+        if (result == results.end() || result->second != CURLE_OK || status != 200 || fetch.index >= peers_.size())
+            continue;
+        try
+        {
+            const json state = json::parse(fetch.body);
+            Node& peer = peers_[fetch.index];
+            const std::string id = state.value("node_id", peer.url);
+            if (id == node_id_)
+            {
+                // Our own address under another name
+                peer.self = true;
+                membershipChanged = true;
+                continue;
+            }
+            if (id != peer.node_id)
+            {
+                peer.node_id = id;
+                membershipChanged = true;
+            }
+            peer.models.clear();
+            for (const auto& [model, load] : state.value("models", json::object()).items())
+            {
+                ModelLoad& entry = peer.models[model];
+                entry.active_jobs = load.value("active_jobs", 0);
+                entry.slots_total = load.value("slots_total", 0);
+                entry.slots_in_use = load.value("slots_in_use", 0);
+                entry.pending_tokens = load.value("pending_tokens", static_cast<int64_t>(0));
+            }
+            peer.draining = state.value("draining", false);
+            peer.prefixes.clear();
+            for (const auto& key : state.value("prefixes", json::array()))
+            {
+                if (key.is_number_unsigned())
+                    peer.prefixes.insert(key.get<uint64_t>());
+            }
+            if (rate_limiter_)
+                chargePeerUsageLocked(peer, state.value("rate_limits", json::object()));
+            peer.last_seen = std::chrono::steady_clock::now();
+            peer.routed_since_poll = 0;
+        }
+        catch (const std::exception& ex)
+        {
+            KOLOSAL_LOG_WARNING("Cluster: bad state from %s: %s", peers_[fetch.index].url.c_str(), ex.what());
+        }
+    }
+    curl_slist_free_all(headers);
+    curl_multi_cleanup(multi);
+
+    // The ring holds every named peer, live or not, so a node's keys stay put while it
+    // restarts; requests skip nodes that are not live
+    if (membershipChanged)
+        rebuildRingLocked();
+}
+
+} // namespace kolosal
@@ -0,0 +1,406 @@
+#include "kolosal/config_reloader.hpp"
+#include "kolosal/server_config.hpp"
+#include "kolosal/server_api.hpp"
+#include "kolosal/node_manager.h"
+#include "kolosal/download_manager.hpp"
+#include "kolosal/download_utils.hpp"
+#include "kolosal/auth/auth_middleware.hpp"
+#include "kolosal/logger.hpp"
+#include "kolosal/response_cache.hpp"
+#include "kolosal/semantic_cache.hpp"
+#include <yaml-cpp/yaml.h>
+#include <algorithm>
+#include <map>
+#include <set>
+#include <tuple>
+
+namespace kolosal
+{
+
+    namespace
+    {
+        // Settings the running server picks up from a reload; the rest are read at startup only
+        const std::set<std::string> kLiveSettings = {
+            "auth.rate_limit", "auth.token_quota", "auth.tenant_scheduling", "auth.cors", "auth.api_keys",
+            "auth.require_api_key", "auth.api_key_header",
+            "logging.level", "logging.quiet_mode", "logging.show_request_details",
+            "response_cache.enabled", "response_cache.ttl_seconds", "response_cache.memory_mb",
+            "response_cache.max_entry_kb", "response_cache.semantic"};
+
+        // Handled model by model rather than as settings
+        const std::set<std::string> kModelSections = {"models", "model_aliases", "inference_engines", "default_inference_engine"};
+
+        bool sameLoadParams(const LoadingParameters &a, const LoadingParameters &b)
+        {
+            auto fields = [](const LoadingParameters &p)
+            {
+                return std::tie(p.n_ctx, p.n_keep, p.use_mlock, p.use_mmap, p.prefetch_weights, p.huge_pages, p.repack_cache_mb, p.cont_batching,
+                                p.warmup, p.n_parallel, p.n_replicas, p.embedding_contexts, p.embedding_batch_window_us,
+                                p.n_prefix_cache, p.prefix_cache_dir, p.prefix_cache_save_seconds, p.chunk_cache_mb, p.preempt_swap_mb, p.max_queued_jobs,
+                                p.max_queued_tokens, p.profile_steps, p.n_gpu_layers, p.split_mode, p.tensor_split,
+                                p.n_threads, p.cpu_cores, p.numa_node, p.n_batch, p.n_ubatch, p.cache_type_k,
+                                p.cache_type_v, p.fit_vram, p.moe_offload, p.autotune, p.autotune_cache, p.n_step_tokens, p.prefill_share, p.slo_ttft_ms,
+                                p.slo_tpot_ms, p.kv_block_tokens, p.max_seq_ctx, p.draft_model_path,
+                                p.n_draft, p.prompt_lookup, p.kv_host_cache_mb, p.kv_disk_cache_mb, p.kv_disk_cache_dir,
+                                p.lora_adapters, p.lora_max_loaded);
+            };
+            return fields(a) == fields(b);
+        }
+
+        std::string normalizedPath(const std::string &path)
+        {
+            return is_valid_url(path) ? path : ServerConfig::makeAbsolutePath(path);
+        }
+
+        // Whether the running engine has to be replaced. load_immediately and sha256 only
+        // matter when a model is first loaded, so a change to them alone is left alone.
+        bool needsReload(const ModelConfig &a, const std::string &defaultA,
+                         const ModelConfig &b, const std::string &defaultB)
+        {
+            const std::string &engineA = a.inferenceEngine.empty() ? defaultA : a.inferenceEngine;
+            const std::string &engineB = b.inferenceEngine.empty() ? defaultB : b.inferenceEngine;
+            return normalizedPath(a.path) != normalizedPath(b.path) || a.type != b.type ||
+                   a.mainGpuId != b.mainGpuId || engineA != engineB || !sameLoadParams(a.loadParams, b.loadParams);
+        }
+
+        bool sameInferenceEngines(const std::vector<InferenceEngineConfig> &a, const std::vector<InferenceEngineConfig> &b)
+        {
+            return std::equal(a.begin(), a.end(), b.begin(), b.end(),
+                              [](const InferenceEngineConfig &x, const InferenceEngineConfig &y)
+                              {
+                                  return x.name == y.name && x.library_path == y.library_path && x.version == y.version &&
+                                         x.description == y.description && x.load_on_startup == y.load_on_startup &&
+                                         std::equal(x.variants.begin(), x.variants.end(), y.variants.begin(), y.variants.end(),
+                                                    [](const InferenceEngineVariant &v, const InferenceEngineVariant &w)
+                                                    { return v.library_path == w.library_path && v.features == w.features; });
+                              });
+        }
+
+        // "section.key" for every top-level setting whose saved form differs
+        std::vector<std::string> changedSettings(const ServerConfig &current, const ServerConfig &next)
+        {
+            const YAML::Node a = YAML::Load(current.toYaml());
+            const YAML::Node b = YAML::Load(next.toYaml());
+
+            std::set<std::string> sections;
+            for (const YAML::Node *doc : {&a, &b})
+                for (const auto &section : *doc)
+                    sections.insert(section.first.as<std::string>());
+
+            std::vector<std::string> changed;
+            for (const auto &section : sections)
+            {
+                if (kModelSections.count(section))
+                    continue;
+                const YAML::Node sa = a[section];
+                const YAML::Node sb = b[section];
+                if (!sa.IsMap() || !sb.IsMap())
+                {
+                    if (YAML::Dump(sa) != YAML::Dump(sb))
+                        changed.push_back(section);
+                    continue;
+                }
+                std::set<std::string> keys;
+                for (const YAML::Node *node : {&sa, &sb})
+                    for (const auto &entry : *node)
+                        keys.insert(entry.first.as<std::string>());
+                for (const auto &key : keys)
+                {
+                    if (YAML::Dump(sa[key]) != YAML::Dump(sb[key]))
+                        changed.push_back(section + "." + key);
+                }
+            }
+            return changed;
+        }
+
+        LogLevel parseLogLevel(const std::string &level)
+        {
+            if (level == "ERROR")
+                return LogLevel::SERVER_ERROR;
+            if (level == "WARNING" || level == "WARN")
+                return LogLevel::SERVER_WARNING;
+            if (level == "DEBUG")
+                return LogLevel::SERVER_DEBUG;
+            return LogLevel::SERVER_INFO;
+        }
+
+        void applyLiveSetting(const std::string &setting, const ServerConfig &next)
+        {
+            auto &auth = ServerAPI::instance().getAuthMiddleware();
+            auto &logger = ServerLogger::instance();
+
+            if (setting == "auth.rate_limit")
+                auth.updateRateLimiterConfig(next.auth.rateLimiter);
+            else if (setting == "auth.token_quota")
+                auth.updateTokenQuotaConfig(next.auth.tokenQuota);
+            else if (setting == "auth.tenant_scheduling")
+                auth.updateTenantSharesConfig(next.auth.tenantScheduling);
+            else if (setting == "auth.cors")
+                auth.updateCorsConfig(next.auth.cors);
+            else if (setting == "logging.level")
+                logger.setLevel(parseLogLevel(next.logLevel));
+            else if (setting == "logging.quiet_mode")
+                logger.setQuietMode(next.quietMode);
+            else if (setting == "logging.show_request_details")
+                logger.setShowRequestDetails(next.showRequestDetails);
+            else if (setting == "response_cache.semantic")
+                SemanticCache::instance().configure(next.responseCache);
+            else if (setting.compare(0, 15, "response_cache.") == 0)
+            {
+                // The semantic cache shares the TTL and entry size limit
+                ResponseCache::instance().configure(next.responseCache);
+                SemanticCache::instance().configure(next.responseCache);
+            }
+            else
+            {
+                // API key settings are applied together, the same way startup does
+                auth::AuthMiddleware::ApiKeyConfig apiKeyConfig;
+                apiKeyConfig.enabled = next.auth.enableAuth;
+                apiKeyConfig.required = next.auth.requireApiKey;
+                apiKeyConfig.headerName = next.auth.apiKeyHeader;
+                apiKeyConfig.validKeys.insert(next.auth.allowedApiKeys.begin(), next.auth.allowedApiKeys.end());
+                auth.updateApiKeyConfig(apiKeyConfig);
+            }
+        }
+
+        // Loads a model as startup would: right away, or registered for its first request
+        void loadModel(const ModelConfig &model)
+        {
+            auto &nodeManager = ServerAPI::instance().getNodeManager();
+            nodeManager.setStartupState(model.id, "loading");
+            const bool ok = DownloadManager::getInstance().loadModelAtStartup(
+                model.id, model.path, model.type, model.loadParams, model.mainGpuId,
+                model.loadImmediately, model.inferenceEngine, model.sha256);
+            if (!ok)
+            {
+                KOLOSAL_LOG_ERROR("Config reload: failed to load model '%s' from %s", model.id.c_str(), model.path.c_str());
+                nodeManager.setStartupState(model.id, "failed");
+                return;
+            }
+            nodeManager.setStartupState(model.id, is_valid_url(model.path) ? "downloading"
+                                                  : model.loadImmediately   ? "ready"
+                                                                            : "registered");
+        }
+    }
+
+    ConfigReloader &ConfigReloader::instance()
+    {
+        static ConfigReloader reloader;
+        return reloader;
+    }
+
+    ConfigReloader::~ConfigReloader()
+    {
+        stop();
+    }
+
+    ConfigReloadResult ConfigReloader::reload()
+    {
+        std::lock_guard<std::mutex> reloadLock(reloadMutex_);
+        ConfigReloadResult result;
+
+        ServerConfig &current = ServerConfig::getInstance();
+        result.configFile = current.getCurrentConfigFilePath();
+        if (result.configFile.empty())
+        {
+            result.error = "The server was not started from a config file";
+            return result;
+        }
+
+        std::error_code ec;
+        const auto modified = std::filesystem::last_write_time(result.configFile, ec);
+        ServerConfig next;
+        if (ec || !next.loadFromFile(result.configFile))
+        {
+            result.error = "Could not load " + result.configFile + " (missing or invalid; details in the server log)";
+            KOLOSAL_LOG_ERROR("Config reload: %s", result.error.c_str());
+            return result;
+        }
+        {
+            std::lock_guard<std::mutex> lock(watchMutex_);
+            lastSeen_ = modified;
+        }
+
+        // Model changes of an earlier reload finish before this one's are planned
+        if (applier_.joinable())
+            applier_.join();
+
+        // Models: only entries that differ are touched
+        auto &nodeManager = ServerAPI::instance().getNodeManager();
+        std::map<std::string, const ModelConfig *> before;
+        for (const auto &model : current.models)
+            before[model.id] = &model;
+
+        std::vector<ModelConfig> toAdd;
+        std::vector<std::pair<ModelConfig, bool>> toUpdate;     // With whether the model type changed
+        std::vector<std::string> toRemove;
+        std::set<std::string> seen;
+        for (const auto &model : next.models)
+        {
+            seen.insert(model.id);
+            auto it = before.find(model.id);
+            const bool registered = nodeManager.getEngineStatus(model.id).first;
+            if (it == before.end() || !registered)
+            {
+                toAdd.push_back(model);
+                result.addedModels.push_back(model.id);
+            }
+            else if (needsReload(*it->second, current.defaultInferenceEngine, model, next.defaultInferenceEngine))
+            {
+                toUpdate.emplace_back(model, it->second->type != model.type);
+                result.updatedModels.push_back(model.id);
+            }
+            else
+            {
+                result.unchangedModels.push_back(model.id);
+            }
+        }
+        for (const auto &model : current.models)
+        {
+            if (!seen.count(model.id))
+            {
+                toRemove.push_back(model.id);
+                result.removedModels.push_back(model.id);
+            }
+        }
+
+        // Settings: live ones now, the others wait for a restart
+        const bool authWasEnabled = current.auth.enableAuth;
+        for (const auto &setting : changedSettings(current, next))
+        {
+            // With auth off at startup the middleware was never configured; keep it that way
+            const bool live = kLiveSettings.count(setting) &&
+                              (setting.compare(0, 5, "auth.") != 0 || (authWasEnabled && next.auth.enableAuth));
+            if (!live)
+            {
+                result.restartRequired.push_back(setting);
+                continue;
+            }
+            applyLiveSetting(setting, next);
+            result.applied.push_back(setting);
+        }
+
+        if (!sameInferenceEngines(current.inferenceEngines, next.inferenceEngines))
+        {
+            result.inferenceEnginesReconfigured = nodeManager.reconfigureEngines(next.inferenceEngines);
+        }
+
+        // The running config now describes what the file asks for; settings that need a
+        // restart keep their running values so what is reported stays true
+        current.models = next.models;
+        if (current.modelAliases != next.modelAliases)
+        {
+            nodeManager.setModelAliases(next.modelAliases);
+            current.modelAliases = next.modelAliases;
+        }
+        current.inferenceEngines = next.inferenceEngines;
+        current.defaultInferenceEngine = next.defaultInferenceEngine;
+        if (authWasEnabled && next.auth.enableAuth)
+            current.auth = next.auth;
+        current.logLevel = next.logLevel;
+        current.quietMode = next.quietMode;
+        current.showRequestDetails = next.showRequestDetails;
+        current.responseCache = next.responseCache;
+
+        for (const auto &model : toAdd)
+            nodeManager.setStartupState(model.id, "pending");
+
+        // Removals first so their memory is free for what comes next
+        if (!toAdd.empty() || !toUpdate.empty() || !toRemove.empty())
+        {
+            applier_ = std::thread([toAdd = std::move(toAdd), toUpdate = std::move(toUpdate), toRemove = std::move(toRemove)]()
+                                   {
+                auto &nodeManager = ServerAPI::instance().getNodeManager();
+                NodeManager::suspendConfigWrites(true);
+                for (const auto &id : toRemove)
+                {
+                    KOLOSAL_LOG_INFO("Config reload: removing model '%s'", id.c_str());
+                    nodeManager.removeEngine(id);
+                }
+                for (const auto &[model, typeChanged] : toUpdate)
+                {
+                    KOLOSAL_LOG_INFO("Config reload: replacing model '%s'", model.id.c_str());
+                    const auto [exists, loaded] = nodeManager.getEngineStatus(model.id);
+                    // A loaded engine keeps serving until its replacement is ready; one that is
+                    // not loaded has nothing to keep warm and is registered again from scratch
+                    if (exists && loaded && !typeChanged &&
+                        nodeManager.swapEngine(model.id, model.path.c_str(), model.loadParams, model.mainGpuId, model.inferenceEngine))
+                    {
+                        nodeManager.setStartupState(model.id, "ready");
+                        continue;
+                    }
+                    if (exists && loaded && !typeChanged)
+                        KOLOSAL_LOG_WARNING("Config reload: could not swap model '%s' in place, reloading it", model.id.c_str());
+                    nodeManager.removeEngine(model.id);
+                    loadModel(model);
+                }
+                for (const auto &model : toAdd)
+                {
+                    KOLOSAL_LOG_INFO("Config reload: adding model '%s'", model.id.c_str());
+                    loadModel(model);
+                }
+                NodeManager::suspendConfigWrites(false); });
+        }
+
+        result.ok = true;
+        KOLOSAL_LOG_INFO("Config reloaded from %s: %zu added, %zu removed, %zu updated, %zu unchanged model(s); "
+                              "%zu setting(s) applied, %zu need a restart",
+                              result.configFile.c_str(), result.addedModels.size(), result.removedModels.size(),
+                              result.updatedModels.size(), result.unchangedModels.size(),
+                              result.applied.size(), result.restartRequired.size());
+        for (const auto &setting : result.restartRequired)
+            KOLOSAL_LOG_WARNING("Config reload: '%s' changed but only takes effect after a restart", setting.c_str());
+        return result;
+    }
+
+    void ConfigReloader::startWatching(std::chrono::seconds interval)
+    {
+        if (interval.count() <= 0 || watcher_.joinable())
+            return;
+        const std::string path = ServerConfig::getInstance().getCurrentConfigFilePath();
+        if (path.empty())
+            return;
+
+        std::error_code ec;
+        lastSeen_ = std::filesystem::last_write_time(path, ec);
+        stopping_ = false;
+        watcher_ = std::thread(&ConfigReloader::watch, this, interval);
+        KOLOSAL_LOG_INFO("Watching %s for changes every %lld s", path.c_str(), static_cast<long long>(interval.count()));
+    }
+
+    void ConfigReloader::watch(std::chrono::seconds interval)
+    {
+        const std::string path = ServerConfig::getInstance().getCurrentConfigFilePath();
+        std::unique_lock<std::mutex> lock(watchMutex_);
+        while (!watchCv_.wait_for(lock, interval, [this]
+                                  { return stopping_; }))
+        {
+            std::error_code ec;
+            const auto modified = std::filesystem::last_write_time(path, ec);
+            if (ec || modified == lastSeen_)
+                continue;
+            lastSeen_ = modified;
+
+            lock.unlock();
+            KOLOSAL_LOG_INFO("Config file %s changed, reloading", path.c_str());
+            reload();
+            lock.lock();
+        }
+    }
+
+    void ConfigReloader::stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(watchMutex_);
+            stopping_ = true;
+        }
+        watchCv_.notify_all();
+        if (watcher_.joinable())
+            watcher_.join();
+
+        std::lock_guard<std::mutex> reloadLock(reloadMutex_);
+        if (applier_.joinable())
+            applier_.join();
+    }
+
+} // namespace kolosal
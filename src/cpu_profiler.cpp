@@ -0,0 +1,305 @@
+#include "kolosal/cpu_profiler.hpp"
+#include "kolosal/logger.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+
+#if defined(__linux__) && defined(__GLIBC__)
+#define KOLOSAL_CPU_PROFILER 1
+#include <cerrno>
+#include <csignal>
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <sys/time.h>
+#include <unistd.h>
+#endif
+
+namespace kolosal
+{
+
+namespace
+{
+    constexpr int kMaxFrames = 64;
+    constexpr size_t kMaxSamples = 50000;
+    // The handler's own frame and the signal trampoline sit above the interrupted code
+    constexpr int kSkipFrames = 2;
+
+#ifdef KOLOSAL_CPU_PROFILER
+    struct Slot
+    {
+        std::atomic<bool> ready{false};
+        int threadId = 0;
+        int depth = 0;
+        void* frames[kMaxFrames];
+    };
+
+    // Shared with the signal handler, so plain globals and lock-free atomics only
+    Slot* g_slots = nullptr;
+    size_t g_capacity = 0;
+    std::atomic<size_t> g_next{0};
+    std::atomic<bool> g_active{false};
+    std::atomic<int> g_inHandler{0};
+
+    void onProfilingSignal(int, siginfo_t*, void*)
+    {
+        const int savedErrno = errno;
+        g_inHandler.fetch_add(1, std::memory_order_acquire);
+        if (g_active.load(std::memory_order_acquire))
+        {
+            const size_t index = g_next.fetch_add(1, std::memory_order_relaxed);
+            if (index < g_capacity)
+            {
+                Slot& slot = g_slots[index];
+                slot.depth = backtrace(slot.frames, kMaxFrames);
+                slot.threadId = static_cast<int>(syscall(SYS_gettid));
+                slot.ready.store(true, std::memory_order_release);
+            }
+        }
+        g_inHandler.fetch_sub(1, std::memory_order_release);
+        errno = savedErrno;
+    }
+
+    // Installed once and never removed: a SIGPROF still pending when a profile ends must not
+    // meet the default action, which terminates the process
+    bool installHandler()
+    {
+        static const bool installed = []
+        {
+            // backtrace() loads the unwinder on first use, which is not safe inside a handler
+            void* warmup[4];
+            backtrace(warmup, 4);
+
+            struct sigaction action;
+            std::memset(&action, 0, sizeof(action));
+            action.sa_sigaction = onProfilingSignal;
+            action.sa_flags = SA_RESTART | SA_SIGINFO;
+            sigemptyset(&action.sa_mask);
+            return sigaction(SIGPROF, &action, nullptr) == 0;
+        }();
+        return installed;
+    }
+
+    bool setTimer(std::chrono::microseconds period)
+    {
+        struct itimerval timer;
+        timer.it_interval.tv_sec = static_cast<time_t>(period.count() / 1000000);
+        timer.it_interval.tv_usec = static_cast<suseconds_t>(period.count() % 1000000);
+        timer.it_value = timer.it_interval;
+        return setitimer(ITIMER_PROF, &timer, nullptr) == 0;
+    }
+
+    std::string threadName(int threadId)
+    {
+        std::ifstream comm("/proc/self/task/" + std::to_string(threadId) + "/comm");
+        std::string name;
+        std::getline(comm, name);
+        return name;
+    }
+
+    std::string symbolize(uintptr_t address)
+    {
+        // A return address points past the call; look up the call itself
+        const void* pc = reinterpret_cast<const void*>(address - 1);
+        Dl_info info;
+        if (dladdr(pc, &info) == 0)
+        {
+            char hex[32];
+            std::snprintf(hex, sizeof(hex), "0x%zx", static_cast<size_t>(address));
+            return hex;
+        }
+        if (info.dli_sname)
+        {
+            int status = 0;
+            std::unique_ptr<char, void (*)(void*)> demangled(
+                abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status), std::free);
+            return status == 0 && demangled ? demangled.get() : info.dli_sname;
+        }
+        const char* module = info.dli_fname ? info.dli_fname : "?";
+        if (const char* slash = std::strrchr(module, '/'))
+            module = slash + 1;
+        char offset[32];
+        std::snprintf(offset, sizeof(offset), "+0x%zx",
+                      static_cast<size_t>(address - reinterpret_cast<uintptr_t>(info.dli_fbase)));
+        return std::string(module) + offset;
+    }
+#endif
+} // namespace
+
+CpuProfiler& CpuProfiler::instance()
+{
+    static CpuProfiler profiler;
+    return profiler;
+}
+
+bool CpuProfiler::supported()
+{
+#ifdef KOLOSAL_CPU_PROFILER
+    return true;
+#else
+    return false;
+#endif
+}
+
+void CpuProfiler::nameThread(const char* name)
+{
+#ifdef KOLOSAL_CPU_PROFILER
+    char truncated[16];
+    std::snprintf(truncated, sizeof(truncated), "%s", name);
+    pthread_setname_np(pthread_self(), truncated);
+#else
+    (void)name;
+#endif
+}
+
+std::optional<CpuProfiler::Profile> CpuProfiler::record(std::chrono::milliseconds duration, int frequency)
+{
+#ifndef KOLOSAL_CPU_PROFILER
+    (void)duration;
+    (void)frequency;
+    throw std::runtime_error("CPU profiling is only available on Linux with glibc");
+#else
+    std::unique_lock<std::mutex> lock(mutex_, std::try_to_lock);
+    if (!lock.owns_lock())
+        return std::nullopt;
+    if (!installHandler())
+        throw std::runtime_error(std::string("Cannot install the SIGPROF handler: ") + std::strerror(errno));
+
+    frequency = std::clamp(frequency, 1, 1000);
+    Profile profile;
+    profile.period = std::chrono::microseconds(1000000 / frequency);
+    profile.duration = duration;
+
+    // Each busy core delivers up to frequency samples per second
+    const size_t cores = std::max(1u, std::thread::hardware_concurrency());
+    const size_t expected = static_cast<size_t>(frequency) * cores * static_cast<size_t>(duration.count() / 1000 + 1);
+    std::unique_ptr<Slot[]> slots(new Slot[std::min(expected, kMaxSamples)]);
+    g_slots = slots.get();
+    g_capacity = std::min(expected, kMaxSamples);
+    g_next.store(0, std::memory_order_relaxed);
+    g_active.store(true, std::memory_order_release);
+
+    if (!setTimer(profile.period))
+    {
+        g_active.store(false, std::memory_order_release);
+        throw std::runtime_error(std::string("Cannot arm the profiling timer: ") + std::strerror(errno));
+    }
+    std::this_thread::sleep_for(duration);
+    setTimer(std::chrono::microseconds(0));
+    g_active.store(false, std::memory_order_release);
+    while (g_inHandler.load(std::memory_order_acquire) > 0)
+        std::this_thread::yield();
+
+    const size_t taken = std::min(g_next.load(std::memory_order_relaxed), g_capacity);
+    profile.dropped = g_next.load(std::memory_order_relaxed) - taken;
+
+    // Identical stacks of the same thread become one entry with a count
+    std::map<std::pair<int, std::vector<uintptr_t>>, size_t> counts;
+    for (size_t i = 0; i < taken; ++i)
+    {
+        const Slot& slot = slots[i];
+        if (!slot.ready.load(std::memory_order_acquire) || slot.depth <= kSkipFrames)
+            continue;
+        std::vector<uintptr_t> frames;
+        frames.reserve(static_cast<size_t>(slot.depth - kSkipFrames));
+        for (int f = kSkipFrames; f < slot.depth; ++f)
+            frames.push_back(reinterpret_cast<uintptr_t>(slot.frames[f]));
+        ++counts[{slot.threadId, std::move(frames)}];
+        ++profile.samples;
+    }
+    g_slots = nullptr;
+    g_capacity = 0;
+
+    for (auto& [key, count] : counts)
+    {
+        if (profile.threadNames.find(key.first) == profile.threadNames.end())
+            profile.threadNames[key.first] = threadName(key.first);
+        profile.stacks.push_back(Stack{key.first, key.second, count});
+    }
+
+    KOLOSAL_LOG_INFO("CPU profile: %zu samples over %lld ms at %d Hz (%zu dropped)", profile.samples,
+                     static_cast<long long>(duration.count()), frequency, profile.dropped);
+    return profile;
+#endif
+}
+
+std::string CpuProfiler::Profile::collapsed() const
+{
+    std::string out;
+#ifdef KOLOSAL_CPU_PROFILER
+    std::unordered_map<uintptr_t, std::string> symbols;
+    std::map<std::string, size_t> folded;
+    for (const auto& stack : stacks)
+    {
+        auto name = threadNames.find(stack.threadId);
+        std::string line = name != threadNames.end() && !name->second.empty() ? name->second : "thread";
+        for (auto frame = stack.frames.rbegin(); frame != stack.frames.rend(); ++frame)
+        {
+            auto symbol = symbols.find(*frame);
+            if (symbol == symbols.end())
+                symbol = symbols.emplace(*frame, symbolize(*frame)).first;
+            line += ';';
+            line += symbol->second;
+        }
+        // Threads of one pool share a name, and so their stacks merge
+        folded[line] += stack.count;
+    }
+    for (const auto& [line, count] : folded)
+    {
+        out += line;
+        out += ' ';
+        out += std::to_string(count);
+        out += '\n';
+    }
+#endif
+    return out;
+}
+
+std::string CpuProfiler::Profile::pprof() const
+{
+    std::string out;
+    auto word = [&out](uintptr_t value)
+    {
+        out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    };
+
+    // Header: header words, version, sampling period, padding
+    word(0);
+    word(3);
+    word(0);
+    word(static_cast<uintptr_t>(period.count()));
+    word(0);
+
+    // pprof has no notion of threads; stacks that differ only by thread are merged
+    std::map<std::vector<uintptr_t>, size_t> merged;
+    for (const auto& stack : stacks)
+        merged[stack.frames] += stack.count;
+    for (const auto& [frames, count] : merged)
+    {
+        word(static_cast<uintptr_t>(count));
+        word(static_cast<uintptr_t>(frames.size()));
+        for (uintptr_t frame : frames)
+            word(frame);
+    }
+
+    // Trailer, then the mappings pprof resolves addresses against
+    word(0);
+    word(1);
+    word(0);
+    std::ifstream maps("/proc/self/maps");
+    std::stringstream text;
+    text << maps.rdbuf();
+    out += text.str();
+    return out;
+}
+
+} // namespace kolosal
@@ -14,12 +14,207 @@
 namespace kolosal
 {
 
+    // A download in one of these states holds a queue entry or a slot
+    static bool isActiveStatus(const std::string &status)
+    {
+        return status == "queued" || status == "downloading" || status == "paused";
+    }
+
     DownloadManager &DownloadManager::getInstance()
     {
         static DownloadManager instance;
         return instance;
     }
-    bool DownloadManager::startDownload(const std::string &model_id, const std::string &url, const std::string &local_path)
+
+    void DownloadManager::configure(const DownloadConfig &config)
+    {
+        set_download_bandwidth_limits(static_cast<size_t>(config.max_bytes_per_second),
+                                      static_cast<size_t>(config.per_download_bytes_per_second));
+
+        DownloadSources sources;
+        sources.peers = config.peers;
+        sources.mirrors = config.mirrors;
+        sources.cache_dir = config.cache_dir;
+        sources.peer_api_key = config.peer_api_key;
+        set_download_sources(sources);
+        if (!sources.peers.empty() || !sources.mirrors.empty() || !sources.cache_dir.empty())
+        {
+            KOLOSAL_LOG_INFO("Downloads look in %zu peers, %zu mirrors%s before their origin",
+                                  sources.peers.size(), sources.mirrors.size(),
+                                  sources.cache_dir.empty() ? "" : " and the shared model cache");
+        }
+
+        progress_interval_ms_ = (std::max)(1, config.progress_interval_ms);
+
+        std::lock_guard<std::mutex> lock(downloads_mutex_);
+        max_concurrent_ = (std::max)(1, config.max_concurrent);
+        connections_ = config.connections;
+        KOLOSAL_LOG_INFO("Download scheduler: %d concurrent, %lld B/s total, %lld B/s per download (0 = unlimited)",
+                              max_concurrent_, config.max_bytes_per_second, config.per_download_bytes_per_second);
+        dispatchLocked();
+    }
+
+    void DownloadManager::enqueueLocked(std::shared_ptr<DownloadProgress> progress)
+    {
+        progress->status = "queued";
+        progress->sequence = next_sequence_++;
+        queue_.push_back(progress);
+        publishLocked(*progress);
+        dispatchLocked();
+    }
+
+    void DownloadManager::publishLocked(const DownloadProgress &progress, bool removed)
+    {
+        DownloadUpdate update;
+        update.model_id = progress.model_id;
+        update.status = progress.status;
+        update.error_message = progress.error_message;
+        update.total_bytes = progress.total_bytes;
+        update.downloaded_bytes = progress.downloaded_bytes;
+        update.percentage = progress.percentage;
+        update.bytes_per_second = progress.bytes_per_second;
+        update.priority = progress.priority;
+        update.removed = removed;
+        {
+            std::lock_guard<std::mutex> lock(feed_mutex_);
+            update.version = ++feed_version_;
+            feed_[progress.model_id] = std::move(update);
+        }
+        feed_cv_.notify_all();
+    }
+
+    std::vector<DownloadUpdate> DownloadManager::waitForUpdates(unsigned long long &since, std::chrono::milliseconds timeout)
+    {
+        std::unique_lock<std::mutex> lock(feed_mutex_);
+        feed_cv_.wait_for(lock, timeout, [this, since]()
+                          { return feed_version_ > since; });
+
+        // A new observer starts from the downloads there are, not the ones cleaned up before it came
+        std::vector<DownloadUpdate> updates;
+        for (const auto &entry : feed_)
+        {
+            if (entry.second.version > since && !(since == 0 && entry.second.removed))
+                updates.push_back(entry.second);
+        }
+        std::sort(updates.begin(), updates.end(), [](const DownloadUpdate &a, const DownloadUpdate &b)
+                  { return a.version < b.version; });
+        since = feed_version_;
+        return updates;
+    }
+
+    std::chrono::milliseconds DownloadManager::progressInterval() const
+    {
+        return std::chrono::milliseconds(progress_interval_ms_.load());
+    }
+
+    void DownloadManager::retireFutureLocked(const std::string &model_id)
+    {
+        // Destroying a std::async future waits for its thread, which may itself be waiting for
+        // downloads_mutex_; park the future instead and drop it once it is ready
+        auto it = download_futures_.find(model_id);
+        if (it != download_futures_.end())
+        {
+            retired_futures_.push_back(std::move(it->second));
+            download_futures_.erase(it);
+        }
+        retired_futures_.erase(std::remove_if(retired_futures_.begin(), retired_futures_.end(),
+                                              [](std::future<void> &future)
+                                              {
+                                                  return !future.valid() ||
+                                                         future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+                                              }),
+                               retired_futures_.end());
+    }
+
+    void DownloadManager::dispatchLocked()
+    {
+        auto byPriority = [](const std::shared_ptr<DownloadProgress> &a, const std::shared_ptr<DownloadProgress> &b)
+        {
+            if (a->priority != b->priority)
+                return a->priority > b->priority;
+            return a->sequence < b->sequence;
+        };
+
+        while (!queue_.empty() && static_cast<int>(running_.size()) < max_concurrent_)
+        {
+            auto next = std::min_element(queue_.begin(), queue_.end(), byPriority);
+            auto progress = *next;
+            queue_.erase(next);
+
+            progress->status = "downloading";
+            running_.push_back(progress);
+            publishLocked(*progress);
+            retireFutureLocked(progress->model_id);
+
+            int connections = connections_;
+            download_futures_[progress->model_id] = std::async(std::launch::async, [this, progress, connections]()
+                                                               {
+                performDownload(progress, connections);
+                releaseSlot(progress); });
+
+            KOLOSAL_LOG_INFO("Started %s priority download for model %s (%zu running, %zu queued)",
+                                  downloadPriorityName(progress->priority), progress->model_id.c_str(),
+                                  running_.size(), queue_.size());
+        }
+
+        // High priority work still waiting takes the slot of the newest Low priority download,
+        // counting slots that earlier preemptions are already about to free
+        int waiting_high = static_cast<int>(std::count_if(queue_.begin(), queue_.end(), [](const std::shared_ptr<DownloadProgress> &p)
+                                                          { return p->priority == DownloadPriority::High; }));
+        for (const auto &running : running_)
+        {
+            if (running->preempted)
+                --waiting_high;
+        }
+
+        while (waiting_high > 0)
+        {
+            std::shared_ptr<DownloadProgress> victim;
+            for (const auto &running : running_)
+            {
+                if (running->priority == DownloadPriority::Low && running->status == "downloading" && !running->preempted &&
+                    (!victim || running->sequence > victim->sequence))
+                {
+                    victim = running;
+                }
+            }
+            if (!victim)
+                break;
+
+            victim->preempted = true;
+            victim->cancelled = true;
+            --waiting_high;
+            KOLOSAL_LOG_INFO("Preempting low priority download for model %s to make room for a high priority one",
+                                  victim->model_id.c_str());
+        }
+    }
+
+    void DownloadManager::releaseSlot(std::shared_ptr<DownloadProgress> progress)
+    {
+        std::lock_guard<std::mutex> lock(downloads_mutex_);
+        auto it = std::find(running_.begin(), running_.end(), progress);
+        if (it == running_.end())
+            return;
+        running_.erase(it);
+
+        if (progress->preempted && progress->status == "queued")
+        {
+            // Back in line with its original sequence; the part file lets it resume where it stopped
+            progress->preempted = false;
+            progress->cancelled = false;
+            progress->bytes_per_second = 0.0;
+            progress->last_sample_time = std::chrono::steady_clock::time_point{};
+            queue_.push_back(progress);
+            publishLocked(*progress);
+        }
+        progress->preempted = false;
+
+        dispatchLocked();
+        downloads_cv_.notify_all();
+    }
+
+    bool DownloadManager::startDownload(const std::string &model_id, const std::string &url, const std::string &local_path,
+                                        const std::string &expected_sha256, DownloadPriority priority)
     {
         std::lock_guard<std::mutex> lock(downloads_mutex_);
 
@@ -29,38 +224,38 @@ namespace kolosal
         {
             // If the existing download is cancelled, failed, or completed, we can restart it
             auto &existing_progress = existing_it->second;
-            if (existing_progress->status == "downloading" || existing_progress->status == "paused")
+            if (isActiveStatus(existing_progress->status))
             {
-                ServerLogger::logWarning("Download already in progress for model: %s", model_id.c_str());
+                KOLOSAL_LOG_WARNING("Download already in progress for model: %s", model_id.c_str());
                 return false;
             }
             else
             {
                 // Clean up the old entry to allow restart
-                ServerLogger::logInfo("Cleaning up previous download entry for model: %s (status: %s)",
+                KOLOSAL_LOG_INFO("Cleaning up previous download entry for model: %s (status: %s)",
                                       model_id.c_str(), existing_progress->status.c_str());
-                download_futures_.erase(model_id);
+                retireFutureLocked(model_id);
                 downloads_.erase(existing_it);
             }
         } // Create new download progress entry
         auto progress = std::make_shared<DownloadProgress>(model_id, url, local_path);
+        progress->expected_sha256 = expected_sha256;
+        progress->priority = priority;
         downloads_[model_id] = progress;
+        enqueueLocked(progress);
 
-        // Start download in background thread
-        download_futures_[model_id] = std::async(std::launch::async, [this, progress]()
-                                                 { performDownload(progress); });
-
-        ServerLogger::logInfo("Started download for model %s", model_id.c_str());
+        KOLOSAL_LOG_INFO("Queued download for model %s", model_id.c_str());
         return true;
     }
 
     bool DownloadManager::startDownloadWithEngine(const std::string &model_id, const std::string &url,
-                                                  const std::string &local_path, const EngineCreationParams &engine_params)
+                                                  const std::string &local_path, const EngineCreationParams &engine_params,
+                                                  const std::string &expected_sha256, DownloadPriority priority)
     {
         // Validate engine parameters first
         if (!engine_params.isValid())
         {
-            ServerLogger::logError("Invalid engine parameters for model %s: model_id='%s', model_type='%s', main_gpu_id=%d", 
+            KOLOSAL_LOG_ERROR("Invalid engine parameters for model %s: model_id='%s', model_type='%s', main_gpu_id=%d", 
                                  model_id.c_str(), engine_params.model_id.c_str(), engine_params.model_type.c_str(), engine_params.main_gpu_id);
             return false;
         }
@@ -71,7 +266,7 @@ namespace kolosal
         
         if (engineExists)
         {
-            ServerLogger::logInfo("Engine '%s' already exists on the server. Skipping download and engine creation.", engine_params.model_id.c_str());
+            KOLOSAL_LOG_INFO("Engine '%s' already exists on the server. Skipping download and engine creation.", engine_params.model_id.c_str());
             
             // Create a completed download entry for consistency
             std::lock_guard<std::mutex> lock(downloads_mutex_);
@@ -81,6 +276,7 @@ namespace kolosal
             progress->percentage = 100.0;
             progress->end_time = std::chrono::system_clock::now();
             downloads_[model_id] = progress;
+            publishLocked(*progress);
 
             return true;
         }
@@ -93,17 +289,17 @@ namespace kolosal
         {
             // If the existing download is cancelled, failed, or completed, we can restart it
             auto &existing_progress = existing_it->second;
-            if (existing_progress->status == "downloading" || existing_progress->status == "paused")
+            if (isActiveStatus(existing_progress->status))
             {
-                ServerLogger::logWarning("Download already in progress for model: %s", model_id.c_str());
+                KOLOSAL_LOG_WARNING("Download already in progress for model: %s", model_id.c_str());
                 return false;
             }
             else
             {
                 // Clean up the old entry to allow restart
-                ServerLogger::logInfo("Cleaning up previous download entry for model: %s (status: %s)",
+                KOLOSAL_LOG_INFO("Cleaning up previous download entry for model: %s (status: %s)",
                                       model_id.c_str(), existing_progress->status.c_str());
-                download_futures_.erase(model_id);
+                retireFutureLocked(model_id);
                 downloads_.erase(existing_it);
             }
         }
@@ -111,13 +307,61 @@ namespace kolosal
         // Create new download progress entry with engine parameters
         auto progress = std::make_shared<DownloadProgress>(model_id, url, local_path);
         progress->engine_params = std::make_unique<EngineCreationParams>(engine_params);
+        progress->expected_sha256 = expected_sha256;
+        progress->priority = priority;
         downloads_[model_id] = progress;
+        enqueueLocked(progress);
 
-        // Start download in background thread
-        download_futures_[model_id] = std::async(std::launch::async, [this, progress]()
-                                                 { performDownload(progress); });
+        KOLOSAL_LOG_INFO("Queued download with engine creation for model %s", model_id.c_str());
+        return true;
+    }
+
+    bool DownloadManager::downloadAndWait(const std::string &model_id, const std::string &url, const std::string &local_path,
+                                          std::string &error_message)
+    {
+        std::unique_lock<std::mutex> lock(downloads_mutex_);
 
-        ServerLogger::logInfo("Started download with engine creation for model %s", model_id.c_str());
+        std::shared_ptr<DownloadProgress> progress;
+        auto existing_it = downloads_.find(model_id);
+        if (existing_it != downloads_.end() && isActiveStatus(existing_it->second->status) &&
+            existing_it->second->local_path == local_path)
+        {
+            progress = existing_it->second;
+            if (progress->priority != DownloadPriority::High)
+            {
+                KOLOSAL_LOG_INFO("Raising download for model %s to high priority", model_id.c_str());
+                progress->priority = DownloadPriority::High;
+                publishLocked(*progress);
+                dispatchLocked();
+            }
+        }
+        else
+        {
+            if (existing_it != downloads_.end())
+            {
+                if (isActiveStatus(existing_it->second->status))
+                {
+                    error_message = "Another download is in progress for model " + model_id;
+                    return false;
+                }
+                retireFutureLocked(model_id);
+                downloads_.erase(existing_it);
+            }
+
+            progress = std::make_shared<DownloadProgress>(model_id, url, local_path);
+            progress->priority = DownloadPriority::High;
+            downloads_[model_id] = progress;
+            enqueueLocked(progress);
+        }
+
+        downloads_cv_.wait(lock, [&progress]()
+                           { return !isActiveStatus(progress->status); });
+
+        if (progress->status == "failed" || progress->status == "cancelled")
+        {
+            error_message = progress->error_message.empty() ? "Download " + progress->status : progress->error_message;
+            return false;
+        }
         return true;
     }
 
@@ -141,7 +385,7 @@ namespace kolosal
         auto it = downloads_.find(model_id);
         if (it != downloads_.end())
         {
-            return it->second->status == "downloading";
+            return it->second->status == "downloading" || it->second->status == "queued";
         }
 
         return false;
@@ -150,22 +394,25 @@ namespace kolosal
     {
         std::lock_guard<std::mutex> lock(downloads_mutex_);
         auto it = downloads_.find(model_id);
-        if (it != downloads_.end() && (it->second->status == "downloading" || it->second->status == "creating_engine" || it->second->status == "paused"))
+        if (it != downloads_.end() && (isActiveStatus(it->second->status) || it->second->status == "creating_engine"))
         {
+            queue_.erase(std::remove(queue_.begin(), queue_.end(), it->second), queue_.end());
             it->second->status = "cancelled";
             it->second->end_time = std::chrono::system_clock::now();
             it->second->cancelled = true; // Set the cancellation flag
             it->second->paused = false;   // Clear pause flag when cancelling
+            publishLocked(*it->second);
 
             // Check if this is a startup download (has engine params)
             if (it->second->engine_params)
             {
-                ServerLogger::logInfo("Cancelled startup download for model: %s", model_id.c_str());
+                KOLOSAL_LOG_INFO("Cancelled startup download for model: %s", model_id.c_str());
             }
             else
             {
-                ServerLogger::logInfo("Cancelled download for model: %s", model_id.c_str());
+                KOLOSAL_LOG_INFO("Cancelled download for model: %s", model_id.c_str());
             }
+            downloads_cv_.notify_all();
             return true;
         }
 
@@ -180,42 +427,46 @@ namespace kolosal
         for (auto &pair : downloads_)
         {
             auto progress = pair.second;
-            if (progress && (progress->status == "downloading" || progress->status == "creating_engine" || progress->status == "paused"))
+            if (progress && (isActiveStatus(progress->status) || progress->status == "creating_engine"))
             {
                 progress->status = "cancelled";
                 progress->end_time = std::chrono::system_clock::now();
                 progress->cancelled = true; // Set the cancellation flag
                 progress->paused = false;   // Clear pause flag when cancelling
+                publishLocked(*progress);
                 cancelled_count++;
 
                 // Check if this is a startup download (has engine params)
                 if (progress->engine_params)
                 {
                     startup_downloads++;
-                    ServerLogger::logInfo("Cancelled startup download for model: %s", pair.first.c_str());
+                    KOLOSAL_LOG_INFO("Cancelled startup download for model: %s", pair.first.c_str());
                 }
                 else
                 {
                     regular_downloads++;
-                    ServerLogger::logInfo("Cancelled download for model: %s", pair.first.c_str());
+                    KOLOSAL_LOG_INFO("Cancelled download for model: %s", pair.first.c_str());
                 }
             }
         }
 
+        queue_.clear();
+
         if (cancelled_count > 0)
         {
-            ServerLogger::logInfo("Cancelled %d downloads total (%d startup, %d regular)",
+            KOLOSAL_LOG_INFO("Cancelled %d downloads total (%d startup, %d regular)",
                                   cancelled_count, startup_downloads, regular_downloads);
+            downloads_cv_.notify_all();
         }
 
         return cancelled_count;
     }
     void DownloadManager::waitForAllDownloads()
     {
-        std::map<std::string, std::future<void>> futures_to_wait;
+        std::multimap<std::string, std::future<void>> futures_to_wait;
 
         // First, cancel all downloads to ensure they exit quickly
-        ServerLogger::logInfo("Cancelling all active downloads before shutdown...");
+        KOLOSAL_LOG_INFO("Cancelling all active downloads before shutdown...");
         int cancelled = cancelAllDownloads();
 
         // Give a moment for cancellation to take effect
@@ -227,17 +478,25 @@ namespace kolosal
         // Copy futures under lock to avoid holding lock while waiting
         {
             std::lock_guard<std::mutex> lock(downloads_mutex_);
-            futures_to_wait = std::move(download_futures_);
+            for (auto &pair : download_futures_)
+            {
+                futures_to_wait.emplace(pair.first, std::move(pair.second));
+            }
+            for (auto &future : retired_futures_)
+            {
+                futures_to_wait.emplace("(finished download)", std::move(future));
+            }
             download_futures_.clear();
+            retired_futures_.clear();
         }
 
         if (futures_to_wait.empty())
         {
-            ServerLogger::logInfo("No download threads to wait for");
+            KOLOSAL_LOG_INFO("No download threads to wait for");
             return;
         }
 
-        ServerLogger::logInfo("Waiting for %zu download threads to complete...", futures_to_wait.size());
+        KOLOSAL_LOG_INFO("Waiting for %zu download threads to complete...", futures_to_wait.size());
 
         // Wait for all download threads to complete with progressive timeout
         int completed = 0;
@@ -257,27 +516,27 @@ namespace kolosal
                     {
                         pair.second.get(); // Get any exceptions
                         completed++;
-                        ServerLogger::logInfo("Download thread completed (%d/%d): %s", completed, total, pair.first.c_str());
+                        KOLOSAL_LOG_INFO("Download thread completed (%d/%d): %s", completed, total, pair.first.c_str());
                     }
                     else
                     {
-                        ServerLogger::logWarning("Download thread for %s did not complete within %ds timeout, forcing shutdown",
+                        KOLOSAL_LOG_WARNING("Download thread for %s did not complete within %ds timeout, forcing shutdown",
                                                  pair.first.c_str(), timeout_seconds);
                         // Don't call get() on timeout to avoid blocking
                     }
                 }
                 else
                 {
-                    ServerLogger::logInfo("Download thread future invalid: %s", pair.first.c_str());
+                    KOLOSAL_LOG_INFO("Download thread future invalid: %s", pair.first.c_str());
                 }
             }
             catch (const std::exception &ex)
             {
-                ServerLogger::logError("Error waiting for download thread %s: %s", pair.first.c_str(), ex.what());
+                KOLOSAL_LOG_ERROR("Error waiting for download thread %s: %s", pair.first.c_str(), ex.what());
             }
         }
 
-        ServerLogger::logInfo("Finished waiting for download threads (%d/%d completed)", completed, total);
+        KOLOSAL_LOG_INFO("Finished waiting for download threads (%d/%d completed)", completed, total);
     }
 
     std::map<std::string, std::shared_ptr<DownloadProgress>> DownloadManager::getAllActiveDownloads()
@@ -287,7 +546,7 @@ namespace kolosal
         std::map<std::string, std::shared_ptr<DownloadProgress>> active_downloads;
         for (const auto &pair : downloads_)
         {
-            if (pair.second->status == "downloading" || pair.second->status == "paused")
+            if (isActiveStatus(pair.second->status))
             {
                 active_downloads[pair.first] = pair.second;
             }
@@ -306,16 +565,16 @@ namespace kolosal
         auto it = downloads_.begin();
         while (it != downloads_.end())
         {
-            auto &progress = it->second; // Only clean up completed, failed, or cancelled downloads (not downloading or paused)
-            if (progress->status != "downloading" &&
-                progress->status != "paused" &&
+            auto &progress = it->second; // Only clean up completed, failed, or cancelled downloads (not queued, downloading or paused)
+            if (!isActiveStatus(progress->status) &&
                 progress->end_time < cutoff_time)
             {
 
-                ServerLogger::logInfo("Cleaning up old download record for model: %s", it->first.c_str());
+                KOLOSAL_LOG_INFO("Cleaning up old download record for model: %s", it->first.c_str());
+                publishLocked(*progress, true);
 
                 // Clean up the future as well
-                download_futures_.erase(it->first);
+                retireFutureLocked(it->first);
 
                 it = downloads_.erase(it);
             }
@@ -325,11 +584,12 @@ namespace kolosal
             }
         }
     }
-    void DownloadManager::performDownload(std::shared_ptr<DownloadProgress> progress)
+    void DownloadManager::performDownload(std::shared_ptr<DownloadProgress> progress, int connections)
     {
         try
         {
-            // Check if file is already complete before starting download
+            // A file the download manifest has verified is used as it is; anything else goes through
+            // the download, which finishes partial files and hashes complete ones it cannot vouch for
             if (std::filesystem::exists(progress->local_path))
             {
                 try
@@ -337,24 +597,26 @@ namespace kolosal
                     size_t local_size = std::filesystem::file_size(progress->local_path);
                     if (local_size > 0)
                     {
-                        // Get expected file size to check if file is complete
-                        DownloadResult url_info = get_url_file_info(progress->url);
-                        if (url_info.success && local_size == url_info.total_bytes)
+                        if (is_download_verified(progress->local_path, progress->expected_sha256))
                         {
-                            std::lock_guard<std::mutex> lock(downloads_mutex_);
-                            progress->status = "already_complete";
-                            progress->total_bytes = local_size;
-                            progress->downloaded_bytes = local_size;
-                            progress->percentage = 100.0;
-                            progress->end_time = std::chrono::system_clock::now();
+                            {
+                                std::lock_guard<std::mutex> lock(downloads_mutex_);
+                                progress->status = "already_complete";
+                                progress->total_bytes = local_size;
+                                progress->downloaded_bytes = local_size;
+                                progress->percentage = 100.0;
+                                progress->end_time = std::chrono::system_clock::now();
+                                publishLocked(*progress);
+                            }
 
                             // File already downloaded - only log at debug level to reduce verbosity
-                            ServerLogger::logDebug("File already fully downloaded for model %s: %zu bytes (skipping download)",
+                            KOLOSAL_LOG_DEBUG("File already downloaded and verified for model %s: %zu bytes (skipping download)",
                                                    progress->model_id.c_str(), local_size);
 
-                            // If engine parameters are provided, create the engine
+                            // If engine parameters are provided, create the engine; loading it needs no download slot
                             if (progress->engine_params)
                             {
+                                releaseSlot(progress);
                                 createEngineAfterDownload(progress);
                             }
                             return;
@@ -363,22 +625,23 @@ namespace kolosal
                 }
                 catch (const std::exception &ex)
                 {
-                    ServerLogger::logWarning("Error checking existing file for model %s: %s",
+                    KOLOSAL_LOG_WARNING("Error checking existing file for model %s: %s",
                                              progress->model_id.c_str(), ex.what());
                 }
             }
             // Progress callback to update download progress
             bool progress_was_reported = false;
-            auto progressCallback = [progress, &progress_was_reported](size_t downloaded, size_t total, double percentage)
+            auto progressCallback = [this, progress, &progress_was_reported](size_t downloaded, size_t total, double percentage)
             {
-                std::lock_guard<std::mutex> lock(const_cast<DownloadManager &>(getInstance()).downloads_mutex_);
-
-                // Handle pause by checking the pause flag and waiting
-                while (progress->paused && progress->status == "paused" && !progress->cancelled)
+                // Handle pause by checking the pause flag and waiting; without the lock, so that
+                // resume and cancel can get to the flags
+                while (progress->paused && !progress->cancelled)
                 {
                     std::this_thread::sleep_for(std::chrono::milliseconds(100));
                 }
 
+                std::lock_guard<std::mutex> lock(downloads_mutex_);
+
                 // If cancelled while paused, return early
                 if (progress->cancelled)
                 {
@@ -390,7 +653,7 @@ namespace kolosal
                 // Validate percentage value before storing
                 if (percentage < 0.0 || percentage > 100.0 || std::isnan(percentage) || std::isinf(percentage))
                 {
-                    ServerLogger::logWarning("Invalid percentage value %.2f for model %s, clamping to valid range", 
+                    KOLOSAL_LOG_WARNING("Invalid percentage value %.2f for model %s, clamping to valid range", 
                                            percentage, progress->model_id.c_str());
                     percentage = (std::max)(0.0, (std::min)(100.0, percentage));
                     if (std::isnan(percentage) || std::isinf(percentage))
@@ -398,23 +661,51 @@ namespace kolosal
                         percentage = 0.0;
                     }
                 }
+                // Sample the rate at most every 500ms; the first sample only sets the baseline so
+                // bytes kept from an earlier attempt are not counted as throughput
+                auto now = std::chrono::steady_clock::now();
+                if (progress->last_sample_time == std::chrono::steady_clock::time_point{} || downloaded < progress->last_sample_bytes)
+                {
+                    progress->last_sample_time = now;
+                    progress->last_sample_bytes = downloaded;
+                }
+                else
+                {
+                    double elapsed = std::chrono::duration<double>(now - progress->last_sample_time).count();
+                    if (elapsed >= 0.5)
+                    {
+                        double rate = static_cast<double>(downloaded - progress->last_sample_bytes) / elapsed;
+                        progress->bytes_per_second = progress->bytes_per_second > 0.0 ? 0.7 * progress->bytes_per_second + 0.3 * rate : rate;
+                        progress->last_sample_time = now;
+                        progress->last_sample_bytes = downloaded;
+                    }
+                }
+
                 progress->downloaded_bytes = downloaded;
                 progress->total_bytes = total;
                 progress->percentage = percentage;
 
+                // Observers get the byte count at most once per progress interval
+                if (now - progress->last_published >= progressInterval())
+                {
+                    progress->last_published = now;
+                    publishLocked(*progress);
+                }
+
                 // Only log progress at major milestones (every 10%) to reduce verbosity
                 static std::map<std::string, int> last_logged_milestone;
                 int current_milestone = static_cast<int>(percentage / 10) * 10;
                 if (last_logged_milestone[progress->model_id] != current_milestone && current_milestone > 0)
                 {
                     last_logged_milestone[progress->model_id] = current_milestone;
-                    ServerLogger::logInfo("Download progress for %s: %d%% (%zu/%zu bytes)", progress->model_id.c_str(), current_milestone, downloaded, total);
+                    KOLOSAL_LOG_INFO("Download progress for %s: %d%% (%zu/%zu bytes)", progress->model_id.c_str(), current_milestone, downloaded, total);
                 }
             };
 
             // Perform the actual download with cancellation support
-            ServerLogger::logInfo("Starting download for model: %s", progress->model_id.c_str());
-            DownloadResult result = download_file_with_cancellation_and_resume(progress->url, progress->local_path, progressCallback, &(progress->cancelled), true);
+            KOLOSAL_LOG_INFO("Starting download for model: %s", progress->model_id.c_str());
+            DownloadResult result = download_file_with_cancellation_and_resume(progress->url, progress->local_path, progressCallback,
+                                                                               &(progress->cancelled), true, connections, progress->expected_sha256);
 
             {
                 std::lock_guard<std::mutex> lock(downloads_mutex_);
@@ -422,13 +713,15 @@ namespace kolosal
                 // Only log final result, not detailed metrics to reduce verbosity
                 if (result.success)
                 {
-                    ServerLogger::logInfo("Download completed successfully for model: %s", progress->model_id.c_str());
+                    KOLOSAL_LOG_INFO("Download completed successfully for model: %s", progress->model_id.c_str());
                 }
-                else
+                else if (!progress->preempted)
                 {
-                    ServerLogger::logError("Download failed for model %s: %s", progress->model_id.c_str(), result.error_message.c_str());
+                    KOLOSAL_LOG_ERROR("Download failed for model %s: %s", progress->model_id.c_str(), result.error_message.c_str());
                 }
 
+                progress->sha256 = result.sha256;
+
                 if (result.success && progress->status != "cancelled")
                 {
                     progress->status = "completed";
@@ -437,26 +730,35 @@ namespace kolosal
                     progress->percentage = 100.0; // Check if this was a file that was already complete (no progress reported)
                     if (!progress_was_reported && result.total_bytes > 0)
                     {
-                        ServerLogger::logInfo("File was already complete for model: %s (no download needed)", progress->model_id.c_str());
+                        KOLOSAL_LOG_INFO("File was already complete for model: %s (no download needed)", progress->model_id.c_str());
                         // Set status to indicate the file was already complete
                         progress->status = "already_complete";
                     }
                     // Download completion already logged above, no need to duplicate
                 }
+                else if (progress->status != "cancelled" && progress->preempted)
+                {
+                    // Stopped to make room for a higher priority download; releaseSlot requeues it
+                    progress->status = "queued";
+                    KOLOSAL_LOG_INFO("Download for model %s preempted, requeued at %.1f%%",
+                                          progress->model_id.c_str(), progress->percentage);
+                }
                 else if (progress->status != "cancelled")
                 {
                     progress->status = "failed";
                     progress->error_message = result.error_message;
-                    ServerLogger::logError("Download failed for model %s: %s", progress->model_id.c_str(), result.error_message.c_str());
+                    KOLOSAL_LOG_ERROR("Download failed for model %s: %s", progress->model_id.c_str(), result.error_message.c_str());
                 }
+                publishLocked(*progress);
             }
 
             // If engine parameters are provided and download was successful, create the engine
             if (progress->engine_params && result.success && progress->status != "cancelled")
             {
+                releaseSlot(progress);
                 createEngineAfterDownload(progress);
             }
-            else
+            else if (progress->status != "queued")
             {
                 std::lock_guard<std::mutex> lock(downloads_mutex_);
                 progress->end_time = std::chrono::system_clock::now();
@@ -468,8 +770,9 @@ namespace kolosal
             progress->status = "failed";
             progress->error_message = std::string("Exception during download: ") + ex.what();
             progress->end_time = std::chrono::system_clock::now();
+            publishLocked(*progress);
 
-            ServerLogger::logError("Exception during download for model %s: %s", progress->model_id.c_str(), ex.what());
+            KOLOSAL_LOG_ERROR("Exception during download for model %s: %s", progress->model_id.c_str(), ex.what());
         }
     }
 
@@ -486,7 +789,8 @@ namespace kolosal
                 std::lock_guard<std::mutex> lock(downloads_mutex_);
                 progress->status = "engine_already_exists";
                 progress->end_time = std::chrono::system_clock::now();
-                ServerLogger::logInfo("Engine '%s' already exists, skipping engine creation after download", progress->engine_params->model_id.c_str());
+                publishLocked(*progress);
+                KOLOSAL_LOG_INFO("Engine '%s' already exists, skipping engine creation after download", progress->engine_params->model_id.c_str());
                 return;
             }
 
@@ -494,7 +798,8 @@ namespace kolosal
             {
                 std::lock_guard<std::mutex> lock(downloads_mutex_);
                 progress->status = "creating_engine";
-                ServerLogger::logInfo("Starting engine creation for model: %s", progress->model_id.c_str());
+                publishLocked(*progress);
+                KOLOSAL_LOG_INFO("Starting engine creation for model: %s", progress->model_id.c_str());
             }
 
             // Use the downloaded file path as the model path
@@ -513,7 +818,7 @@ namespace kolosal
                         progress->engine_params->loading_params,
                         progress->engine_params->main_gpu_id);
                     
-                    ServerLogger::logInfo("Creating embedding engine immediately for model: %s", 
+                    KOLOSAL_LOG_INFO("Creating embedding engine immediately for model: %s", 
                                         progress->engine_params->model_id.c_str());
                 }
                 else
@@ -525,10 +830,22 @@ namespace kolosal
                         progress->engine_params->loading_params,
                         progress->engine_params->main_gpu_id);
                     
-                    ServerLogger::logInfo("Registering embedding engine for lazy loading: %s", 
+                    KOLOSAL_LOG_INFO("Registering embedding engine for lazy loading: %s", 
                                         progress->engine_params->model_id.c_str());
                 }
             }
+            else if (progress->engine_params->model_type == "rerank")
+            {
+                success = progress->engine_params->load_immediately
+                    ? nodeManager.addRerankEngine(progress->engine_params->model_id, actualModelPath.c_str(),
+                                                  progress->engine_params->loading_params, progress->engine_params->main_gpu_id)
+                    : nodeManager.registerRerankEngine(progress->engine_params->model_id, actualModelPath.c_str(),
+                                                       progress->engine_params->loading_params, progress->engine_params->main_gpu_id);
+
+                KOLOSAL_LOG_INFO("%s rerank engine for model: %s",
+                                    progress->engine_params->load_immediately ? "Creating" : "Registering",
+                                    progress->engine_params->model_id.c_str());
+            }
             else
             {
                 // For LLM engines, check loading preference
@@ -541,7 +858,7 @@ namespace kolosal
                         progress->engine_params->loading_params,
                         progress->engine_params->main_gpu_id);
                     
-                    ServerLogger::logInfo("Creating LLM engine immediately for model: %s", 
+                    KOLOSAL_LOG_INFO("Creating LLM engine immediately for model: %s", 
                                         progress->engine_params->model_id.c_str());
                 }
                 else
@@ -553,7 +870,7 @@ namespace kolosal
                         progress->engine_params->loading_params,
                         progress->engine_params->main_gpu_id);
                     
-                    ServerLogger::logInfo("Registering LLM engine for lazy loading: %s", 
+                    KOLOSAL_LOG_INFO("Registering LLM engine for lazy loading: %s", 
                                         progress->engine_params->model_id.c_str());
                 }
             }
@@ -571,7 +888,7 @@ namespace kolosal
                 }
                 catch (const std::exception &ex)
                 {
-                    ServerLogger::logWarning("Failed to verify engine status for downloaded model '%s': %s", 
+                    KOLOSAL_LOG_WARNING("Failed to verify engine status for downloaded model '%s': %s", 
                                            progress->engine_params->model_id.c_str(), ex.what());
                     engineFunctional = false;
                 }
@@ -579,26 +896,26 @@ namespace kolosal
                 if (engineFunctional)
                 {
                     progress->status = "engine_created";
-                    ServerLogger::logInfo("Engine created successfully for model: %s", progress->model_id.c_str());
+                    KOLOSAL_LOG_INFO("Engine created successfully for model: %s", progress->model_id.c_str());
                 }
                 else
                 {
                     // Engine was created but is not functional
                     progress->status = "engine_creation_failed";
                     progress->error_message = "Engine was created but failed functionality check";
-                    ServerLogger::logError("Downloaded engine for model '%s' was created but is not functional", 
+                    KOLOSAL_LOG_ERROR("Downloaded engine for model '%s' was created but is not functional", 
                                          progress->engine_params->model_id.c_str());
                     
                     // Try to remove the non-functional engine
                     try
                     {
                         nodeManager.removeEngine(progress->engine_params->model_id);
-                        ServerLogger::logInfo("Removed non-functional downloaded engine for model '%s'", 
+                        KOLOSAL_LOG_INFO("Removed non-functional downloaded engine for model '%s'", 
                                              progress->engine_params->model_id.c_str());
                     }
                     catch (const std::exception &ex)
                     {
-                        ServerLogger::logWarning("Failed to remove non-functional downloaded engine for model '%s': %s", 
+                        KOLOSAL_LOG_WARNING("Failed to remove non-functional downloaded engine for model '%s': %s", 
                                                progress->engine_params->model_id.c_str(), ex.what());
                     }
                 }
@@ -607,10 +924,11 @@ namespace kolosal
             {
                 progress->status = "engine_creation_failed";
                 progress->error_message = "Failed to create engine after successful download";
-                ServerLogger::logError("Failed to create engine for model: %s", progress->model_id.c_str());
+                KOLOSAL_LOG_ERROR("Failed to create engine for model: %s", progress->model_id.c_str());
             }
 
             progress->end_time = std::chrono::system_clock::now();
+            publishLocked(*progress);
         }
         catch (const std::exception &ex)
         {
@@ -618,7 +936,8 @@ namespace kolosal
             progress->status = "engine_creation_failed";
             progress->error_message = std::string("Exception during engine creation: ") + ex.what();
             progress->end_time = std::chrono::system_clock::now();
-            ServerLogger::logError("Exception during engine creation for model %s: %s", progress->model_id.c_str(), ex.what());
+            publishLocked(*progress);
+            KOLOSAL_LOG_ERROR("Exception during engine creation for model %s: %s", progress->model_id.c_str(), ex.what());
         }
     }
     
@@ -626,25 +945,27 @@ namespace kolosal
     bool DownloadManager::loadModelAtStartup(const std::string &model_id, const std::string &model_path,
                                              const std::string &model_type, const LoadingParameters &load_params,
                                              int main_gpu_id, bool load_immediately,
-                                             const std::string& inference_engine)
+                                             const std::string& inference_engine,
+                                             const std::string& expected_sha256,
+                                             DownloadPriority priority)
     {
         // Validate model type
-        if (model_type != "llm" && model_type != "embedding")
+        if (model_type != "llm" && model_type != "embedding" && model_type != "rerank")
         {
-            ServerLogger::logError("Invalid model_type '%s' for startup model '%s'. Must be 'llm' or 'embedding'", 
+            KOLOSAL_LOG_ERROR("Invalid model_type '%s' for startup model '%s'. Must be 'llm', 'embedding' or 'rerank'", 
                                  model_type.c_str(), model_id.c_str());
             return false;
         }
 
         // Log startup information with model type
-        if (model_type == "embedding")
+        if (model_type == "embedding" || model_type == "rerank")
         {
-            ServerLogger::logInfo("Loading embedding model '%s' at startup (load_immediately=%s, engine=%s)", 
-                                model_id.c_str(), load_immediately ? "true" : "false", inference_engine.c_str());
+            KOLOSAL_LOG_INFO("Loading %s model '%s' at startup (load_immediately=%s, engine=%s)", 
+                                model_type.c_str(), model_id.c_str(), load_immediately ? "true" : "false", inference_engine.c_str());
         }
         else
         {
-            ServerLogger::logInfo("Loading LLM model '%s' at startup (load_immediately=%s, engine=%s)", 
+            KOLOSAL_LOG_INFO("Loading LLM model '%s' at startup (load_immediately=%s, engine=%s)", 
                                 model_id.c_str(), load_immediately ? "true" : "false", inference_engine.c_str());
         }
 
@@ -654,7 +975,7 @@ namespace kolosal
 
         if (engineExists)
         {
-            ServerLogger::logInfo("Engine '%s' already exists during startup, skipping load", model_id.c_str());
+            KOLOSAL_LOG_INFO("Engine '%s' already exists during startup, skipping load", model_id.c_str());
             return true;
         }
 
@@ -667,10 +988,12 @@ namespace kolosal
             // Check if file already exists and is complete
             if (std::filesystem::exists(download_path))
             {
-                // Check if we can resume this download (file might be incomplete)
-                if (can_resume_download(model_path, download_path))
+                // Check if we can resume this download (file might be incomplete), or if a file that
+                // must match a checksum has not been verified since it was last written
+                if (can_resume_download(model_path, download_path) ||
+                    (!expected_sha256.empty() && !is_download_verified(download_path, expected_sha256)))
                 {
-                    ServerLogger::logInfo("Found incomplete download for startup model '%s', will resume: %s",
+                    KOLOSAL_LOG_INFO("Found incomplete download for startup model '%s', will resume: %s",
                                           model_id.c_str(), download_path.c_str());                    // Create engine creation parameters for resume
                     EngineCreationParams engine_params;
                     engine_params.model_id = model_id;
@@ -681,11 +1004,11 @@ namespace kolosal
                     engine_params.inference_engine = inference_engine;
 
                     // Start download with engine creation (will resume automatically)
-                    return startDownloadWithEngine(model_id, model_path, download_path, engine_params);
+                    return startDownloadWithEngine(model_id, model_path, download_path, engine_params, expected_sha256, priority);
                 }
                 else
                 {
-                    ServerLogger::logInfo("Model file already exists locally for startup model '%s': %s",
+                    KOLOSAL_LOG_INFO("Model file already exists locally for startup model '%s': %s",
                                           model_id.c_str(), download_path.c_str());                    // Load directly using NodeManager
                     auto &node_manager = ServerAPI::instance().getNodeManager();
                     if (load_immediately)
@@ -694,6 +1017,10 @@ namespace kolosal
                         {
                             return node_manager.addEmbeddingEngine(model_id, download_path.c_str(), load_params, main_gpu_id);
                         }
+                        else if (model_type == "rerank")
+                        {
+                            return node_manager.addRerankEngine(model_id, download_path.c_str(), load_params, main_gpu_id);
+                        }
                         else
                         {
                             return node_manager.addEngine(model_id, download_path.c_str(), load_params, main_gpu_id, inference_engine);
@@ -705,6 +1032,10 @@ namespace kolosal
                         {
                             return node_manager.registerEmbeddingEngine(model_id, download_path.c_str(), load_params, main_gpu_id);
                         }
+                        else if (model_type == "rerank")
+                        {
+                            return node_manager.registerRerankEngine(model_id, download_path.c_str(), load_params, main_gpu_id);
+                        }
                         else
                         {
                             return node_manager.registerEngine(model_id, download_path.c_str(), load_params, main_gpu_id);
@@ -714,7 +1045,7 @@ namespace kolosal
             }
             else
             {
-                ServerLogger::logInfo("Starting startup download for model '%s' from URL: %s", model_id.c_str(), model_path.c_str());                // Create engine creation parameters
+                KOLOSAL_LOG_INFO("Starting startup download for model '%s' from URL: %s", model_id.c_str(), model_path.c_str());                // Create engine creation parameters
                 EngineCreationParams engine_params;
                 engine_params.model_id = model_id;
                 engine_params.model_type = model_type;
@@ -724,7 +1055,7 @@ namespace kolosal
                 engine_params.inference_engine = inference_engine;
 
                 // Start download with engine creation
-                return startDownloadWithEngine(model_id, model_path, download_path, engine_params);
+                return startDownloadWithEngine(model_id, model_path, download_path, engine_params, expected_sha256, priority);
             }
         }
         else
@@ -737,6 +1068,10 @@ namespace kolosal
                 {
                     return node_manager.addEmbeddingEngine(model_id, model_path.c_str(), load_params, main_gpu_id);
                 }
+                else if (model_type == "rerank")
+                {
+                    return node_manager.addRerankEngine(model_id, model_path.c_str(), load_params, main_gpu_id);
+                }
                 else
                 {
                     return node_manager.addEngine(model_id, model_path.c_str(), load_params, main_gpu_id, inference_engine);
@@ -748,6 +1083,10 @@ namespace kolosal
                 {
                     return node_manager.registerEmbeddingEngine(model_id, model_path.c_str(), load_params, main_gpu_id);
                 }
+                else if (model_type == "rerank")
+                {
+                    return node_manager.registerRerankEngine(model_id, model_path.c_str(), load_params, main_gpu_id);
+                }
                 else
                 {
                     return node_manager.registerEngine(model_id, model_path.c_str(), load_params, main_gpu_id);
@@ -765,7 +1104,8 @@ namespace kolosal
         {
             it->second->paused = true;
             it->second->status = "paused";
-            ServerLogger::logInfo("Paused download for model: %s", model_id.c_str());
+            publishLocked(*it->second);
+            KOLOSAL_LOG_INFO("Paused download for model: %s", model_id.c_str());
             return true;
         }
 
@@ -781,7 +1121,8 @@ namespace kolosal
         {
             it->second->paused = false;
             it->second->status = "downloading";
-            ServerLogger::logInfo("Resumed download for model: %s", model_id.c_str());
+            publishLocked(*it->second);
+            KOLOSAL_LOG_INFO("Resumed download for model: %s", model_id.c_str());
             return true;
         }
 
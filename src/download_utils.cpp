@@ -1,22 +1,35 @@
 #include "kolosal/download_utils.hpp"
 #include "kolosal/logger.hpp"
+#include "kolosal/sha256.hpp"
 #include <curl/curl.h>
+#include <json.hpp>
+#include <algorithm>
+#include <cctype>
+#include <atomic>
+#include <chrono>
 #include <filesystem>
 #include <fstream>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <regex>
 #include <sstream>
 #include <thread>
+#include <vector>
 
 #ifdef _WIN32
 #include <windows.h>
 #elif defined(__APPLE__)
 #include <unistd.h>
 #include <limits.h>
+#include <fcntl.h>
 #include <mach-o/dyld.h>
 #include <pwd.h>
 #else
 #include <unistd.h>
 #include <limits.h>
+#include <fcntl.h>
 #endif
 
 namespace kolosal
@@ -32,11 +45,152 @@ namespace kolosal
         DownloadProgressData() : total_bytes(0), downloaded_bytes(0), cancelled(nullptr) {}
     };
 
+    // Download connections inside curl_easy_perform(), for /debug/memory
+    static std::atomic<size_t> g_active_transfers{0};
+
+    struct ActiveTransfer
+    {
+        ActiveTransfer() { g_active_transfers.fetch_add(1, std::memory_order_relaxed); }
+        ~ActiveTransfer() { g_active_transfers.fetch_sub(1, std::memory_order_relaxed); }
+        ActiveTransfer(const ActiveTransfer &) = delete;
+        ActiveTransfer &operator=(const ActiveTransfer &) = delete;
+    };
+
+    size_t active_download_transfers()
+    {
+        return g_active_transfers.load(std::memory_order_relaxed);
+    }
+
+    // Process-wide cap shared by every transfer. Each write callback takes its bytes from one token
+    // bucket and sleeps off any debt, which holds back reads and lets TCP flow control slow the sender.
+    class SharedBandwidth
+    {
+    public:
+        void setRate(size_t bytes_per_second)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            rate_ = bytes_per_second;
+            tokens_ = 0.0;
+            last_ = std::chrono::steady_clock::now();
+        }
+
+        void consume(size_t bytes)
+        {
+            std::chrono::duration<double> wait(0.0);
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (rate_ == 0)
+                    return;
+                auto now = std::chrono::steady_clock::now();
+                double rate = static_cast<double>(rate_);
+                // At most a quarter second of unused allowance is kept as burst
+                tokens_ = (std::min)(rate / 4.0, tokens_ + std::chrono::duration<double>(now - last_).count() * rate);
+                last_ = now;
+                tokens_ -= static_cast<double>(bytes);
+                if (tokens_ < 0.0)
+                    wait = std::chrono::duration<double>(-tokens_ / rate);
+            }
+            if (wait.count() > 0.0)
+                std::this_thread::sleep_for((std::min)(wait, std::chrono::duration<double>(1.0)));
+        }
+
+    private:
+        std::mutex mutex_;
+        size_t rate_ = 0;
+        double tokens_ = 0.0;
+        std::chrono::steady_clock::time_point last_ = std::chrono::steady_clock::now();
+    };
+
+    static SharedBandwidth shared_bandwidth;
+    static std::atomic<size_t> per_download_bandwidth{0};
+
+    void set_download_bandwidth_limits(size_t total_bytes_per_second, size_t per_download_bytes_per_second)
+    {
+        shared_bandwidth.setRate(total_bytes_per_second);
+        per_download_bandwidth = per_download_bytes_per_second;
+    }
+
+    // The per-download cap is enforced by curl on each handle, split evenly across the download's connections
+    static void apply_download_speed_limit(CURL *curl, size_t connections)
+    {
+        size_t cap = per_download_bandwidth.load();
+        if (cap > 0)
+        {
+            size_t per_connection = (std::max)(static_cast<size_t>(1024), cap / (std::max)(static_cast<size_t>(1), connections));
+            curl_easy_setopt(curl, CURLOPT_MAX_RECV_SPEED_LARGE, static_cast<curl_off_t>(per_connection));
+        }
+    }
+
+    // Fleet sources from set_download_sources, copied out under the lock by each download
+    static std::mutex sources_mutex;
+    static DownloadSources download_sources;
+
+    static DownloadSources current_download_sources()
+    {
+        std::lock_guard<std::mutex> lock(sources_mutex);
+        return download_sources;
+    }
+
+    void set_download_sources(const DownloadSources &sources)
+    {
+        auto trim_slash = [](std::string base)
+        {
+            while (!base.empty() && base.back() == '/')
+                base.pop_back();
+            return base;
+        };
+
+        std::lock_guard<std::mutex> lock(sources_mutex);
+        download_sources = DownloadSources();
+        for (const auto &peer : sources.peers)
+            if (!peer.empty())
+                download_sources.peers.push_back(trim_slash(peer));
+        for (const auto &mirror : sources.mirrors)
+            if (!mirror.empty())
+                download_sources.mirrors.push_back(trim_slash(mirror));
+        download_sources.cache_dir = sources.cache_dir;
+        download_sources.peer_api_key = sources.peer_api_key;
+    }
+
+    // Adds the peer API key to requests for files on a peer; the header list lives as long as the helper
+    class SourceHeaders
+    {
+    public:
+        SourceHeaders(CURL *curl, const std::string &url)
+        {
+            std::lock_guard<std::mutex> lock(sources_mutex);
+            if (download_sources.peer_api_key.empty())
+                return;
+            for (const auto &peer : download_sources.peers)
+            {
+                if (url.compare(0, peer.size() + 1, peer + "/") == 0)
+                {
+                    headers_ = curl_slist_append(nullptr, ("X-API-Key: " + download_sources.peer_api_key).c_str());
+                    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers_);
+                    return;
+                }
+            }
+        }
+
+        ~SourceHeaders()
+        {
+            if (headers_)
+                curl_slist_free_all(headers_);
+        }
+
+        SourceHeaders(const SourceHeaders &) = delete;
+        SourceHeaders &operator=(const SourceHeaders &) = delete;
+
+    private:
+        curl_slist *headers_ = nullptr;
+    };
+
     // CURL write callback function
     static size_t write_callback(void *contents, size_t size, size_t nmemb, std::ofstream *file)
     {
         size_t total_size = size * nmemb;
         file->write(static_cast<const char *>(contents), total_size);
+        shared_bandwidth.consume(total_size);
         return total_size;
     }
 
@@ -217,12 +371,12 @@ namespace kolosal
                 try
                 {
                     std::filesystem::path p = std::filesystem::absolute(std::filesystem::path(overrideDir));
-                    ServerLogger::logInfo("Using models directory from KOLOSAL_MODELS_DIR: %s", p.string().c_str());
+                    KOLOSAL_LOG_INFO("Using models directory from KOLOSAL_MODELS_DIR: %s", p.string().c_str());
                     return p.string();
                 }
                 catch (...)
                 {
-                    ServerLogger::logWarning("Failed to use KOLOSAL_MODELS_DIR path '%s', falling back to defaults", overrideDir);
+                    KOLOSAL_LOG_WARNING("Failed to use KOLOSAL_MODELS_DIR path '%s', falling back to defaults", overrideDir);
                 }
             }
         }
@@ -249,12 +403,12 @@ namespace kolosal
             std::filesystem::create_directories(modelsPath, ec);
             if (!ec)
             {
-                ServerLogger::logInfo("Using user Application Support models directory: %s", modelsPath.string().c_str());
+                KOLOSAL_LOG_INFO("Using user Application Support models directory: %s", modelsPath.string().c_str());
                 return std::filesystem::absolute(modelsPath).string();
             }
             else
             {
-                ServerLogger::logWarning("Could not create Application Support models directory (%s): %s", modelsPath.string().c_str(), ec.message().c_str());
+                KOLOSAL_LOG_WARNING("Could not create Application Support models directory (%s): %s", modelsPath.string().c_str(), ec.message().c_str());
             }
         }
         // Last resort: relative models directory next to executable (may be non-writable inside .app bundle)
@@ -264,20 +418,20 @@ namespace kolosal
         std::filesystem::create_directories(fallbackPath, fec);
         if (!fec)
         {
-            ServerLogger::logWarning("Falling back to models directory beside executable (writable): %s", fallbackPath.string().c_str());
+            KOLOSAL_LOG_WARNING("Falling back to models directory beside executable (writable): %s", fallbackPath.string().c_str());
             return std::filesystem::absolute(fallbackPath).string();
         }
-        ServerLogger::logWarning("Executable-adjacent models directory not writable (%s): %s", fallbackPath.string().c_str(), fec.message().c_str());
+        KOLOSAL_LOG_WARNING("Executable-adjacent models directory not writable (%s): %s", fallbackPath.string().c_str(), fec.message().c_str());
         // Final fallback: system temp directory
         std::filesystem::path tempPath = std::filesystem::temp_directory_path() / "Kolosal" / "models";
         std::error_code tec;
         std::filesystem::create_directories(tempPath, tec);
         if (!tec)
         {
-            ServerLogger::logWarning("Using temporary models directory: %s", tempPath.string().c_str());
+            KOLOSAL_LOG_WARNING("Using temporary models directory: %s", tempPath.string().c_str());
             return std::filesystem::absolute(tempPath).string();
         }
-        ServerLogger::logError("All model directory strategies failed; last error: %s", tec.message().c_str());
+        KOLOSAL_LOG_ERROR("All model directory strategies failed; last error: %s", tec.message().c_str());
         return fallbackPath.string();
 #else
         // Linux / other Unix: prefer user-writable directory (~/.kolosal/models) to avoid
@@ -290,7 +444,7 @@ namespace kolosal
             if (!ec) {
                 return std::filesystem::absolute(userModels).string();
             } else {
-                ServerLogger::logWarning("Could not create user models directory (%s): %s", userModels.string().c_str(), ec.message().c_str());
+                KOLOSAL_LOG_WARNING("Could not create user models directory (%s): %s", userModels.string().c_str(), ec.message().c_str());
             }
         }
         // Fallback to executable-adjacent path
@@ -334,7 +488,7 @@ namespace kolosal
         if (!is_valid_url(url))
         {
             std::string error = "Invalid URL format: " + url;
-            ServerLogger::logError("%s", error.c_str());
+            KOLOSAL_LOG_ERROR("%s", error.c_str());
             return DownloadResult(false, error);
         }
 
@@ -343,11 +497,12 @@ namespace kolosal
         if (!curl)
         {
             std::string error = "Failed to initialize CURL";
-            ServerLogger::logError("%s", error.c_str());
+            KOLOSAL_LOG_ERROR("%s", error.c_str());
             return DownloadResult(false, error);
         }
 
         // Configure CURL for HEAD request
+        SourceHeaders source_headers(curl, url);
         curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
         curl_easy_setopt(curl, CURLOPT_NOBODY, 1L); // HEAD request only
         curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
@@ -374,14 +529,14 @@ namespace kolosal
         if (res != CURLE_OK)
         {
             std::string error = "URL check failed: " + std::string(curl_easy_strerror(res));
-            ServerLogger::logError("%s", error.c_str());
+            KOLOSAL_LOG_ERROR("%s", error.c_str());
             return DownloadResult(false, error);
         }
 
         if (response_code != 200)
         {
             std::string error = "HTTP error: " + std::to_string(response_code);
-            ServerLogger::logError("%s", error.c_str());
+            KOLOSAL_LOG_ERROR("%s", error.c_str());
             return DownloadResult(false, error);
         }        size_t file_size = (content_length > 0) ? static_cast<size_t>(content_length) : 0;
         // URL is accessible, proceed without detailed logging
@@ -418,7 +573,7 @@ namespace kolosal
             DownloadResult url_info = get_url_file_info(url);
             if (!url_info.success || url_info.total_bytes == 0)
             {
-                ServerLogger::logWarning("Cannot get file size from URL for resume check: %s", url.c_str());
+                KOLOSAL_LOG_WARNING("Cannot get file size from URL for resume check: %s", url.c_str());
                 return false;
             }            // Check if local file is smaller than expected (incomplete download)
             if (local_size < url_info.total_bytes)
@@ -428,19 +583,19 @@ namespace kolosal
             }
             else if (local_size == url_info.total_bytes)
             {
-                ServerLogger::logInfo("File already fully downloaded: %zu bytes", local_size);
+                KOLOSAL_LOG_INFO("File already fully downloaded: %zu bytes", local_size);
                 return false; // File is complete
             }
             else
             {
-                ServerLogger::logWarning("Local file is larger than expected - may be corrupted: %zu > %zu bytes",
+                KOLOSAL_LOG_WARNING("Local file is larger than expected - may be corrupted: %zu > %zu bytes",
                                          local_size, url_info.total_bytes);
                 return false; // File is larger than expected, possibly corrupted
             }
         }
         catch (const std::exception &ex)
         {
-            ServerLogger::logError("Error checking file for resume: %s", ex.what());
+            KOLOSAL_LOG_ERROR("Error checking file for resume: %s", ex.what());
             return false;
         }
     }    DownloadResult download_file_with_resume(const std::string &url, const std::string &local_path,
@@ -453,7 +608,7 @@ namespace kolosal
         if (!is_valid_url(url))
         {
             std::string error = "Invalid URL format: " + url;
-            ServerLogger::logError("%s", error.c_str());
+            KOLOSAL_LOG_ERROR("%s", error.c_str());
             return DownloadResult(false, error);
         }
 
@@ -477,7 +632,7 @@ namespace kolosal
         {
             resume_from = std::filesystem::file_size(local_path);
             resuming = true;
-            ServerLogger::logInfo("Resuming download from byte %zu/%zu", resume_from, expected_total);
+            KOLOSAL_LOG_INFO("Resuming download from byte %zu/%zu", resume_from, expected_total);
         }
         else if (std::filesystem::exists(local_path))
         {
@@ -490,19 +645,19 @@ namespace kolosal
                     // Check if file is complete using the already fetched expected size
                     if (expected_total > 0 && local_size == expected_total)
                     {
-                        ServerLogger::logInfo("File already fully downloaded: %zu bytes, skipping download", local_size);
+                        KOLOSAL_LOG_INFO("File already fully downloaded: %zu bytes, skipping download", local_size);
                         return DownloadResult(true, "", local_path, local_size);
                     }
                 }
             }
             catch (const std::exception &ex)
             {
-                ServerLogger::logWarning("Error checking existing file: %s", ex.what());
+                KOLOSAL_LOG_WARNING("Error checking existing file: %s", ex.what());
             }
             
             // If file exists but can't resume or isn't complete, remove it and start fresh
             std::filesystem::remove(local_path);
-            ServerLogger::logInfo("Existing file cannot be resumed, starting fresh download");
+            KOLOSAL_LOG_INFO("Existing file cannot be resumed, starting fresh download");
         }
 
         // Initialize CURL
@@ -510,7 +665,7 @@ namespace kolosal
         if (!curl)
         {
             std::string error = "Failed to initialize CURL";
-            ServerLogger::logError("%s", error.c_str());
+            KOLOSAL_LOG_ERROR("%s", error.c_str());
             return DownloadResult(false, error);
         }
 
@@ -519,7 +674,7 @@ namespace kolosal
         if (!output_file.is_open())
         {
             std::string error = "Failed to create output file: " + local_path;
-            ServerLogger::logError("%s", error.c_str());
+            KOLOSAL_LOG_ERROR("%s", error.c_str());
             curl_easy_cleanup(curl);
             return DownloadResult(false, error);
         }
@@ -543,6 +698,7 @@ namespace kolosal
         curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, 30L);
         curl_easy_setopt(curl, CURLOPT_LOW_SPEED_LIMIT, 1L);
         curl_easy_setopt(curl, CURLOPT_LOW_SPEED_TIME, 60L);
+        apply_download_speed_limit(curl, 1);
 
         // Set resume range if resuming
         if (resuming)
@@ -560,7 +716,11 @@ namespace kolosal
         }
 
         // Perform the download
-        CURLcode res = curl_easy_perform(curl);
+        CURLcode res;
+        {
+            ActiveTransfer active;
+            res = curl_easy_perform(curl);
+        }
 
         // Get response code
         long response_code = 0;
@@ -578,7 +738,7 @@ namespace kolosal
         if (res != CURLE_OK)
         {
             std::string error = "Download failed: " + std::string(curl_easy_strerror(res));
-            ServerLogger::logError("%s", error.c_str());
+            KOLOSAL_LOG_ERROR("%s", error.c_str());
 
             // Don't remove file if we were resuming - keep partial download
             if (!resuming)
@@ -593,7 +753,7 @@ namespace kolosal
         if (response_code != 200 && !(resuming && response_code == 206))
         {
             std::string error = "HTTP error: " + std::to_string(response_code);
-            ServerLogger::logError("%s", error.c_str());
+            KOLOSAL_LOG_ERROR("%s", error.c_str());
 
             // Don't remove file if we were resuming - keep partial download
             if (!resuming)
@@ -609,7 +769,7 @@ namespace kolosal
         if (!std::filesystem::exists(downloaded_file) || std::filesystem::file_size(downloaded_file) == 0)
         {
             std::string error = "Downloaded file is empty or doesn't exist";
-            ServerLogger::logError("%s", error.c_str());
+            KOLOSAL_LOG_ERROR("%s", error.c_str());
 
             // Remove empty file
             if (std::filesystem::exists(downloaded_file))
@@ -627,7 +787,7 @@ namespace kolosal
         {
             std::string error = "Downloaded file size (" + std::to_string(final_size) + 
                               ") doesn't match expected size (" + std::to_string(expected_total) + ")";
-            ServerLogger::logError("%s", error.c_str());
+            KOLOSAL_LOG_ERROR("%s", error.c_str());
             
             // Remove incomplete file to allow clean restart
             std::filesystem::remove(downloaded_file);
@@ -635,217 +795,1391 @@ namespace kolosal
             return DownloadResult(false, error);
         }
 
-        ServerLogger::logInfo("Download completed successfully. File size: %zu bytes %s",
+        KOLOSAL_LOG_INFO("Download completed successfully. File size: %zu bytes %s",
                               final_size, resuming ? "(resumed)" : "(full download)");
 
         return DownloadResult(true, "", local_path, final_size);
     }
 
-    DownloadResult download_file_with_cancellation_and_resume(const std::string &url, const std::string &local_path,
-                                                              DownloadProgressCallback progress_callback,
-                                                              volatile bool *cancelled, bool resume)
+    // Segmented downloads: large files are fetched over several concurrent range requests that write
+    // straight into a preallocated "<local_path>.part" file. Progress of every segment is recorded in
+    // "<local_path>.part.segments" so an interrupted download resumes each segment where it stopped.
+    // Segments are handed to the connections in file order, so the completed prefix grows steadily
+    // and is hashed while it is still in the page cache.
+    static constexpr size_t kSegmentedMinBytes = 64ull * 1024 * 1024;
+    static constexpr size_t kSegmentMinBytes = 16ull * 1024 * 1024;
+    static constexpr size_t kSegmentMaxBytes = 128ull * 1024 * 1024;
+    static constexpr size_t kHashBlockBytes = 4ull * 1024 * 1024;
+    static constexpr int kDefaultDownloadConnections = 8;
+    static constexpr int kMaxDownloadConnections = 32;
+    static constexpr int kSegmentRetries = 5;
+    static constexpr const char *kSegmentStateMagic = "kolosal-segments 1";
+
+    struct DownloadSegment
     {
-        ServerLogger::logInfo("Starting download from URL: %s to: %s (resume: %s, cancellation: enabled)",
-                              url.c_str(), local_path.c_str(), resume ? "enabled" : "disabled");
-
-        // Validate URL
-        if (!is_valid_url(url))
-        {
-            std::string error = "Invalid URL format: " + url;
-            ServerLogger::logError("%s", error.c_str());
-            return DownloadResult(false, error);
-        }
+        size_t start = 0;
+        size_t length = 0;
+        std::atomic<size_t> done{0};
+    };
 
-        // Create directory for the file if it doesn't exist
-        std::filesystem::path file_path(local_path);
-        std::filesystem::create_directories(file_path.parent_path());
+    // Positioned writes into a preallocated file, shared by all segment threads
+    class SegmentedFile
+    {
+    public:
+        ~SegmentedFile() { close(); }
 
-        // Always get the expected file size from URL first
-        DownloadResult url_info = get_url_file_info(url);
-        size_t expected_total = 0;
-        if (url_info.success && url_info.total_bytes > 0)
+        bool open(const std::string &path, size_t size, bool preallocate)
         {
-            expected_total = url_info.total_bytes;
+#ifdef _WIN32
+            handle_ = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+                                  OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (handle_ == INVALID_HANDLE_VALUE)
+                return false;
+            if (preallocate)
+            {
+                LARGE_INTEGER end;
+                end.QuadPart = static_cast<LONGLONG>(size);
+                if (!SetFilePointerEx(handle_, end, nullptr, FILE_BEGIN) || !SetEndOfFile(handle_))
+                    return false;
+                // Skips zero-filling the allocation; needs SE_MANAGE_VOLUME_NAME, so failure is expected and harmless
+                SetFileValidData(handle_, end.QuadPart);
+            }
+            return true;
+#else
+            fd_ = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+            if (fd_ < 0)
+                return false;
+            if (preallocate)
+            {
+#if defined(__linux__)
+                // Reserve the blocks up front so segments never fail half way with ENOSPC
+                if (posix_fallocate(fd_, 0, static_cast<off_t>(size)) == 0)
+                    return true;
+#endif
+                return ftruncate(fd_, static_cast<off_t>(size)) == 0;
+            }
+            return true;
+#endif
         }
 
-        // Check if we can resume the download
-        size_t resume_from = 0;
-        bool resuming = false;
-
-        if (resume && can_resume_download(url, local_path))
-        {
-            resume_from = std::filesystem::file_size(local_path);
-            resuming = true;
-            ServerLogger::logInfo("Resuming download from byte %zu/%zu", resume_from, expected_total);
-        }        else if (std::filesystem::exists(local_path))
+        bool writeAt(size_t offset, const char *data, size_t size)
         {
-            // Check if file is already complete before removing it
-            try 
+#ifdef _WIN32
+            while (size > 0)
             {
-                size_t local_size = std::filesystem::file_size(local_path);
-                if (local_size > 0)
-                {
-                    // Check if file is complete using the already fetched expected size
-                    if (expected_total > 0 && local_size == expected_total)
-                    {
-                        ServerLogger::logInfo("File already fully downloaded: %zu bytes, skipping download", local_size);
-                        return DownloadResult(true, "", local_path, local_size);
-                    }
-                }
+                OVERLAPPED ov = {};
+                ov.Offset = static_cast<DWORD>(offset & 0xFFFFFFFFull);
+                ov.OffsetHigh = static_cast<DWORD>(static_cast<unsigned long long>(offset) >> 32);
+                DWORD chunk = static_cast<DWORD>((std::min)(size, static_cast<size_t>(1u << 30)));
+                DWORD written = 0;
+                if (!WriteFile(handle_, data, chunk, &written, &ov) || written == 0)
+                    return false;
+                data += written;
+                offset += written;
+                size -= written;
             }
-            catch (const std::exception &ex)
+#else
+            while (size > 0)
             {
-                ServerLogger::logWarning("Error checking existing file: %s", ex.what());
+                ssize_t written = ::pwrite(fd_, data, size, static_cast<off_t>(offset));
+                if (written <= 0)
+                    return false;
+                data += written;
+                offset += static_cast<size_t>(written);
+                size -= static_cast<size_t>(written);
             }
-            
-            // If file exists but can't resume or isn't complete, remove it and start fresh
-            std::filesystem::remove(local_path);
-            ServerLogger::logInfo("Existing file cannot be resumed, starting fresh download");
+#endif
+            return true;
         }
 
-        // Initialize CURL
-        CURL *curl = curl_easy_init();
-        if (!curl)
+        bool readAt(size_t offset, char *data, size_t size)
         {
-            std::string error = "Failed to initialize CURL";
-            ServerLogger::logError("%s", error.c_str());
-            return DownloadResult(false, error);
+#ifdef _WIN32
+            while (size > 0)
+            {
+                OVERLAPPED ov = {};
+                ov.Offset = static_cast<DWORD>(offset & 0xFFFFFFFFull);
+                ov.OffsetHigh = static_cast<DWORD>(static_cast<unsigned long long>(offset) >> 32);
+                DWORD chunk = static_cast<DWORD>((std::min)(size, static_cast<size_t>(1u << 30)));
+                DWORD read = 0;
+                if (!ReadFile(handle_, data, chunk, &read, &ov) || read == 0)
+                    return false;
+                data += read;
+                offset += read;
+                size -= read;
+            }
+#else
+            while (size > 0)
+            {
+                ssize_t read = ::pread(fd_, data, size, static_cast<off_t>(offset));
+                if (read <= 0)
+                    return false;
+                data += read;
+                offset += static_cast<size_t>(read);
+                size -= static_cast<size_t>(read);
+            }
+#endif
+            return true;
         }
 
-        // Open output file (append mode if resuming)
-        std::ofstream output_file(local_path, resuming ? std::ios::binary | std::ios::app : std::ios::binary);
-        if (!output_file.is_open())
+        void close()
         {
-            std::string error = "Failed to create output file: " + local_path;
-            ServerLogger::logError("%s", error.c_str());
-            curl_easy_cleanup(curl);
-            return DownloadResult(false, error);
+#ifdef _WIN32
+            if (handle_ != INVALID_HANDLE_VALUE)
+            {
+                CloseHandle(handle_);
+                handle_ = INVALID_HANDLE_VALUE;
+            }
+#else
+            if (fd_ >= 0)
+            {
+                ::close(fd_);
+                fd_ = -1;
+            }
+#endif
         }
 
-        // Set up progress data
-        DownloadProgressData progress_data;
-        progress_data.callback = progress_callback;
-        progress_data.total_bytes = expected_total;
-        progress_data.downloaded_bytes = resume_from;
-        progress_data.cancelled = cancelled;
-
-        // Configure CURL options
-        curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &output_file);
-        curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
-        curl_easy_setopt(curl, CURLOPT_USERAGENT, "Kolosal-Server/1.0");
-        curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 1L);
-        curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 2L);
+    private:
+#ifdef _WIN32
+        HANDLE handle_ = INVALID_HANDLE_VALUE;
+#else
+        int fd_ = -1;
+#endif
+    };
 
-        // Set timeouts to prevent hanging
-        curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, 30L);
-        curl_easy_setopt(curl, CURLOPT_LOW_SPEED_LIMIT, 1L);
-        curl_easy_setopt(curl, CURLOPT_LOW_SPEED_TIME, 60L);
+    // Shared state of one segmented download
+    struct SegmentedDownload
+    {
+        std::string url;
+        std::string state_path;
+        size_t total_bytes = 0;
+        std::vector<std::unique_ptr<DownloadSegment>> segments;
+        SegmentedFile file;
+
+        // Workers take the next segment in file order
+        std::atomic<size_t> next_segment{0};
+        std::atomic<int> running_workers{0};
+        int worker_count = 1;
+
+        // Only touched by the hashing (calling) thread
+        Sha256 hasher;
+        size_t hashed_bytes = 0;
+        size_t hash_cursor = 0;
+
+        volatile bool *cancelled = nullptr;
+        std::atomic<bool> failed{false};
+        std::mutex error_mutex;
+        std::string error;
+
+        // Progress reporting runs on whichever segment thread is due; holding report_mutex while the
+        // callback blocks (e.g. a paused download) stalls every segment, as the single stream did
+        DownloadProgressCallback callback;
+        std::mutex report_mutex;
+        std::chrono::steady_clock::time_point last_report;
+        std::chrono::steady_clock::time_point last_state_save;
 
-        // Set resume range if resuming
-        if (resuming)
+        // End of the prefix that has been fully written, from the start of the file
+        size_t contiguous()
         {
-            std::string range = std::to_string(resume_from) + "-";            curl_easy_setopt(curl, CURLOPT_RANGE, range.c_str());
-            // Resume download from byte position (logging suppressed for verbosity)
+            while (hash_cursor < segments.size() &&
+                   segments[hash_cursor]->done.load(std::memory_order_acquire) >= segments[hash_cursor]->length)
+            {
+                ++hash_cursor;
+            }
+            if (hash_cursor == segments.size())
+                return total_bytes;
+            const DownloadSegment &segment = *segments[hash_cursor];
+            return segment.start + segment.done.load(std::memory_order_acquire);
         }
 
-        // Set up progress callback if provided
-        if (progress_callback || cancelled)
+        size_t downloaded() const
         {
-            curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
-            curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, curl_progress_callback);
-            curl_easy_setopt(curl, CURLOPT_XFERINFODATA, &progress_data);
+            size_t sum = 0;
+            for (const auto &segment : segments)
+                sum += segment->done.load(std::memory_order_relaxed);
+            return sum;
         }
 
-        // Perform the download
-        CURLcode res = curl_easy_perform(curl);
-
-        // Get response code
-        long response_code = 0;
-        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response_code);
-
-        // Get content length
-        curl_off_t content_length = 0;
-        curl_easy_getinfo(curl, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &content_length);
-
-        // Clean up
-        output_file.close();
-        curl_easy_cleanup(curl);
-
-        // Check if download was cancelled
-        if (cancelled && *cancelled)
+        bool stopping() const
         {
-            // Don't remove partially downloaded file - keep for resume
-            ServerLogger::logInfo("Download cancelled for URL: %s (partial file preserved for resume)", url.c_str());
-            return DownloadResult(false, "Download cancelled by user");
+            return failed.load() || (cancelled && *cancelled);
         }
 
-        // Check for errors
-        if (res != CURLE_OK)
+        void fail(const std::string &message)
         {
-            std::string error = "Download failed: " + std::string(curl_easy_strerror(res));
-            ServerLogger::logError("%s", error.c_str());
-
-            // Don't remove file if we were resuming - keep partial download
-            if (!resuming)
-            {
-                std::filesystem::remove(local_path);
-            }
-
-            return DownloadResult(false, error);
+            std::lock_guard<std::mutex> lock(error_mutex);
+            if (error.empty())
+                error = message;
+            failed = true;
         }
+    };
 
-        // For resume, accept both 200 (full file) and 206 (partial content)
-        if (response_code != 200 && !(resuming && response_code == 206))
+    // The state file holds the URL, the total size and one "start length done" line per segment
+    static bool save_segment_state(const SegmentedDownload &download)
+    {
+        const std::string tmp_path = download.state_path + ".tmp";
         {
-            std::string error = "HTTP error: " + std::to_string(response_code);
-            ServerLogger::logError("%s", error.c_str());
+            std::ofstream out(tmp_path, std::ios::trunc);
+            if (!out)
+                return false;
+            out << kSegmentStateMagic << '\n'
+                << download.url << '\n'
+                << download.total_bytes << ' ' << download.segments.size() << '\n';
+            for (const auto &segment : download.segments)
+                out << segment->start << ' ' << segment->length << ' ' << segment->done.load() << '\n';
+            if (!out)
+                return false;
+        }
+        std::error_code ec;
+        std::filesystem::rename(tmp_path, download.state_path, ec);
+        return !ec;
+    }
 
-            // Don't remove file if we were resuming - keep partial download
-            if (!resuming)
-            {
-                std::filesystem::remove(local_path);
-            }
+    static bool load_segment_state(SegmentedDownload &download)
+    {
+        std::ifstream in(download.state_path);
+        if (!in)
+            return false;
 
-            return DownloadResult(false, error);
-        }
+        std::string magic, url;
+        size_t total = 0, count = 0;
+        if (!std::getline(in, magic) || magic != kSegmentStateMagic || !std::getline(in, url) || url != download.url)
+            return false;
+        if (!(in >> total >> count) || total != download.total_bytes || count == 0 || count > total / kSegmentMinBytes + 1)
+            return false;
 
-        // Verify file was downloaded and has content
-        std::filesystem::path downloaded_file(local_path);
-        if (!std::filesystem::exists(downloaded_file) || std::filesystem::file_size(downloaded_file) == 0)
+        std::vector<std::unique_ptr<DownloadSegment>> segments;
+        size_t expected_start = 0;
+        for (size_t i = 0; i < count; ++i)
         {
-            std::string error = "Downloaded file is empty or doesn't exist";
-            ServerLogger::logError("%s", error.c_str());
+            auto segment = std::make_unique<DownloadSegment>();
+            size_t done = 0;
+            if (!(in >> segment->start >> segment->length >> done) || segment->start != expected_start || done > segment->length)
+                return false;
+            segment->done = done;
+            expected_start += segment->length;
+            segments.push_back(std::move(segment));
+        }
+        if (expected_start != total)
+            return false;
 
-            // Remove empty file
-            if (std::filesystem::exists(downloaded_file))
-            {
-                std::filesystem::remove(downloaded_file);
-            }
+        download.segments = std::move(segments);
+        return true;
+    }
 
-            return DownloadResult(false, error);
-        }
+    // URL a segmented partial download of local_path was fetched from, or "" if there is none
+    static std::string partial_download_url(const std::string &local_path)
+    {
+        std::ifstream in(local_path + ".part.segments");
+        std::string magic, url;
+        if (!in || !std::getline(in, magic) || magic != kSegmentStateMagic || !std::getline(in, url))
+            return std::string();
+        return url;
+    }
 
-        size_t final_size = std::filesystem::file_size(downloaded_file);
+    // About eight segments per connection keeps every connection busy until the end while bounding
+    // how far the written data runs ahead of the hashed prefix
+    static void plan_segments(SegmentedDownload &download, int connections)
+    {
+        size_t segment_bytes = download.total_bytes / (static_cast<size_t>(connections) * 8);
+        segment_bytes = (std::max)(kSegmentMinBytes, (std::min)(kSegmentMaxBytes, segment_bytes));
 
-        // If we know the expected size, verify it matches
-        if (expected_total > 0 && final_size != expected_total)
+        download.segments.clear();
+        for (size_t start = 0; start < download.total_bytes; start += segment_bytes)
         {
-            std::string error = "Downloaded file size (" + std::to_string(final_size) + 
-                              ") doesn't match expected size (" + std::to_string(expected_total) + ")";
-            ServerLogger::logError("%s", error.c_str());
-            
-            // Remove incomplete file to allow clean restart
-            std::filesystem::remove(downloaded_file);
-            
-            return DownloadResult(false, error);
+            auto segment = std::make_unique<DownloadSegment>();
+            segment->start = start;
+            segment->length = (std::min)(segment_bytes, download.total_bytes - start);
+            download.segments.push_back(std::move(segment));
         }
+    }
 
-        ServerLogger::logInfo("Download completed successfully. File size: %zu bytes %s",
-                              final_size, resuming ? "(resumed)" : "(full download)");
-
-        return DownloadResult(true, "", local_path, final_size);
+    // Asks for the first byte; a 206 whose Content-Range total matches means ranges work for this file
+    static bool probe_range_support(const std::string &url, size_t expected_total)
+    {
+        CURL *curl = curl_easy_init();
+        if (!curl)
+            return false;
+
+        std::string content_range;
+        auto header_cb = +[](char *buffer, size_t size, size_t nitems, void *userdata) -> size_t
+        {
+            size_t length = size * nitems;
+            std::string line(buffer, length);
+            if (line.size() > 14 && (line.compare(0, 14, "Content-Range:") == 0 || line.compare(0, 14, "content-range:") == 0))
+                *static_cast<std::string *>(userdata) = line.substr(14);
+            return length;
+        };
+        auto discard_cb = +[](char *, size_t size, size_t nmemb, void *) -> size_t { return size * nmemb; };
+
+        SourceHeaders source_headers(curl, url);
+        curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+        curl_easy_setopt(curl, CURLOPT_RANGE, "0-0");
+        curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+        curl_easy_setopt(curl, CURLOPT_USERAGENT, "Kolosal-Server/1.0");
+        curl_easy_setopt(curl, CURLOPT_TIMEOUT, 30L);
+        curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 1L);
+        curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 2L);
+        curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, header_cb);
+        curl_easy_setopt(curl, CURLOPT_HEADERDATA, &content_range);
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, discard_cb);
+
+        CURLcode res = curl_easy_perform(curl);
+        long response_code = 0;
+        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response_code);
+        curl_easy_cleanup(curl);
+
+        if (res != CURLE_OK || response_code != 206)
+            return false;
+
+        // "bytes 0-0/<total>"
+        size_t slash = content_range.find('/');
+        if (slash == std::string::npos)
+            return false;
+        try
+        {
+            return std::stoull(content_range.substr(slash + 1)) == expected_total;
+        }
+        catch (const std::exception &)
+        {
+            return false;
+        }
+    }
+
+    // Reports aggregate progress and persists segment state; called from the segment threads
+    static void report_segment_progress(SegmentedDownload &download, bool force)
+    {
+        std::lock_guard<std::mutex> lock(download.report_mutex);
+        auto now = std::chrono::steady_clock::now();
+
+        if (force || now - download.last_state_save >= std::chrono::seconds(2))
+        {
+            download.last_state_save = now;
+            save_segment_state(download);
+        }
+
+        if (!download.callback || (!force && now - download.last_report < std::chrono::milliseconds(250)))
+            return;
+        download.last_report = now;
+
+        size_t downloaded = download.downloaded();
+        double percentage = download.total_bytes > 0 ? static_cast<double>(downloaded) * 100.0 / static_cast<double>(download.total_bytes) : 0.0;
+        download.callback(downloaded, download.total_bytes, (std::min)(percentage, 100.0));
+    }
+
+    struct SegmentTransfer
+    {
+        SegmentedDownload *download;
+        DownloadSegment *segment;
+        CURL *curl;
+        bool checked_status;
+    };
+
+    static size_t segment_write_callback(char *data, size_t size, size_t nmemb, void *userdata)
+    {
+        auto *transfer = static_cast<SegmentTransfer *>(userdata);
+        size_t total_size = size * nmemb;
+
+        // A server that ignores the range replies 200 with the whole file; never write that at an offset
+        if (!transfer->checked_status)
+        {
+            long response_code = 0;
+            curl_easy_getinfo(transfer->curl, CURLINFO_RESPONSE_CODE, &response_code);
+            if (response_code != 206)
+            {
+                transfer->download->fail("Unexpected HTTP " + std::to_string(response_code) + " for range request");
+                return 0;
+            }
+            transfer->checked_status = true;
+        }
+
+        DownloadSegment &segment = *transfer->segment;
+        size_t done = segment.done.load(std::memory_order_relaxed);
+        size_t writable = (std::min)(total_size, segment.length - done);
+        if (!transfer->download->file.writeAt(segment.start + done, data, writable))
+        {
+            transfer->download->fail("Failed to write to download file");
+            return 0;
+        }
+        segment.done.store(done + writable, std::memory_order_release);
+        shared_bandwidth.consume(writable);
+        return writable == total_size ? total_size : 0;
+    }
+
+    static int segment_progress_callback(void *clientp, curl_off_t, curl_off_t, curl_off_t, curl_off_t)
+    {
+        auto *transfer = static_cast<SegmentTransfer *>(clientp);
+        if (transfer->download->stopping())
+            return 1;
+        report_segment_progress(*transfer->download, false);
+        return transfer->download->stopping() ? 1 : 0;
+    }
+
+    static void download_segment(SegmentedDownload &download, DownloadSegment &segment, CURL *curl)
+    {
+        for (int attempt = 0; attempt <= kSegmentRetries; ++attempt)
+        {
+            if (segment.done.load() >= segment.length || download.stopping())
+                return;
+            if (attempt > 0)
+            {
+                // Back off before retrying a dropped connection, waking early on cancellation
+                auto until = std::chrono::steady_clock::now() + std::chrono::seconds(1 << (std::min)(attempt, 4));
+                while (std::chrono::steady_clock::now() < until && !download.stopping())
+                    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                if (download.stopping())
+                    return;
+            }
+
+            SegmentTransfer transfer{&download, &segment, curl, false};
+            std::string range = std::to_string(segment.start + segment.done.load()) + "-" +
+                                std::to_string(segment.start + segment.length - 1);
+
+            curl_easy_setopt(curl, CURLOPT_URL, download.url.c_str());
+            curl_easy_setopt(curl, CURLOPT_RANGE, range.c_str());
+            curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, segment_write_callback);
+            curl_easy_setopt(curl, CURLOPT_WRITEDATA, &transfer);
+            curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+            curl_easy_setopt(curl, CURLOPT_USERAGENT, "Kolosal-Server/1.0");
+            curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 1L);
+            curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 2L);
+            curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, 30L);
+            curl_easy_setopt(curl, CURLOPT_LOW_SPEED_LIMIT, 1L);
+            curl_easy_setopt(curl, CURLOPT_LOW_SPEED_TIME, 60L);
+            curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
+            curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, segment_progress_callback);
+            curl_easy_setopt(curl, CURLOPT_XFERINFODATA, &transfer);
+            apply_download_speed_limit(curl, static_cast<size_t>(download.worker_count));
+
+            CURLcode res;
+            {
+                ActiveTransfer active;
+                res = curl_easy_perform(curl);
+            }
+
+            if (segment.done.load() >= segment.length)
+                return;
+            if (download.stopping())
+                return;
+            KOLOSAL_LOG_WARNING("Segment at byte %zu stopped at %zu/%zu bytes (%s), retrying",
+                                     segment.start, segment.done.load(), segment.length,
+                                     res == CURLE_OK ? "connection closed early" : curl_easy_strerror(res));
+        }
+
+        download.fail("Segment at byte " + std::to_string(segment.start) + " failed after " +
+                      std::to_string(kSegmentRetries + 1) + " attempts");
+    }
+
+    // One connection: a single handle is reused so consecutive segments share the connection
+    static void segment_worker(SegmentedDownload &download)
+    {
+        CURL *curl = curl_easy_init();
+        if (!curl)
+        {
+            download.fail("Failed to initialize CURL");
+        }
+        else
+        {
+            SourceHeaders source_headers(curl, download.url);
+            for (size_t index = download.next_segment++; index < download.segments.size() && !download.stopping();
+                 index = download.next_segment++)
+            {
+                if (download.segments[index]->done.load() < download.segments[index]->length)
+                {
+                    download_segment(download, *download.segments[index], curl);
+                }
+            }
+            curl_easy_cleanup(curl);
+        }
+        download.running_workers--;
+    }
+
+    // Runs on the calling thread while the workers download, reading back the completed prefix
+    static void hash_completed_prefix(SegmentedDownload &download)
+    {
+        std::vector<char> block(kHashBlockBytes);
+        while (download.hashed_bytes < download.total_bytes && !download.stopping())
+        {
+            bool workers_done = download.running_workers.load() == 0;
+            size_t available = download.contiguous();
+            if (available <= download.hashed_bytes)
+            {
+                if (workers_done)
+                    break;
+                std::this_thread::sleep_for(std::chrono::milliseconds(20));
+                continue;
+            }
+
+            size_t size = (std::min)(available - download.hashed_bytes, block.size());
+            if (!download.file.readAt(download.hashed_bytes, block.data(), size))
+            {
+                download.fail("Failed to read back downloaded data for hashing");
+                break;
+            }
+            download.hasher.update(block.data(), size);
+            download.hashed_bytes += size;
+        }
+    }
+
+    // Returns nullopt when the server cannot serve ranges, so the caller falls back to a single stream
+    static std::optional<DownloadResult> download_segmented(const std::string &url, const std::string &local_path,
+                                                            size_t total_bytes, int connections,
+                                                            DownloadProgressCallback progress_callback,
+                                                            volatile bool *cancelled, bool resume)
+    {
+        const std::string part_path = local_path + ".part";
+        SegmentedDownload download;
+        download.url = url;
+        download.state_path = part_path + ".segments";
+        download.total_bytes = total_bytes;
+        download.cancelled = cancelled;
+        download.callback = progress_callback;
+
+        std::error_code ec;
+        bool resuming = resume && load_segment_state(download) &&
+                        std::filesystem::exists(part_path, ec) && std::filesystem::file_size(part_path, ec) == total_bytes;
+        if (!resuming)
+        {
+            if (!probe_range_support(url, total_bytes))
+            {
+                KOLOSAL_LOG_INFO("Server does not support range requests, using a single connection");
+                return std::nullopt;
+            }
+            std::filesystem::remove(part_path, ec);
+            std::filesystem::remove(download.state_path, ec);
+            plan_segments(download, connections);
+        }
+
+        if (!download.file.open(part_path, total_bytes, !resuming))
+        {
+            std::string error = "Failed to create output file: " + part_path;
+            KOLOSAL_LOG_ERROR("%s", error.c_str());
+            return DownloadResult(false, error);
+        }
+
+        size_t remaining = 0;
+        for (const auto &segment : download.segments)
+        {
+            if (segment->done.load() < segment->length)
+                ++remaining;
+        }
+        size_t worker_count = (std::max)(static_cast<size_t>(1), (std::min)(static_cast<size_t>(connections), remaining));
+
+        if (resuming)
+            KOLOSAL_LOG_INFO("Resuming segmented download at %zu/%zu bytes (%zu of %zu segments left) over %zu connections",
+                                  download.downloaded(), total_bytes, remaining, download.segments.size(), worker_count);
+        else
+            KOLOSAL_LOG_INFO("Downloading %zu bytes in %zu segments over %zu connections",
+                                  total_bytes, download.segments.size(), worker_count);
+
+        report_segment_progress(download, true);
+
+        std::vector<std::thread> workers;
+        workers.reserve(worker_count);
+        download.worker_count = static_cast<int>(worker_count);
+        download.running_workers = static_cast<int>(worker_count);
+        for (size_t i = 0; i < worker_count; ++i)
+            workers.emplace_back(segment_worker, std::ref(download));
+
+        hash_completed_prefix(download);
+        for (auto &worker : workers)
+            worker.join();
+
+        download.file.close();
+        report_segment_progress(download, true);
+
+        if (cancelled && *cancelled)
+        {
+            KOLOSAL_LOG_INFO("Download cancelled for URL: %s (segments preserved for resume)", url.c_str());
+            return DownloadResult(false, "Download cancelled by user");
+        }
+        if (download.failed)
+        {
+            std::string error = "Download failed: " + download.error;
+            KOLOSAL_LOG_ERROR("%s", error.c_str());
+            return DownloadResult(false, error);
+        }
+
+        std::filesystem::remove(download.state_path, ec);
+        std::filesystem::rename(part_path, local_path, ec);
+        if (ec)
+        {
+            std::string error = "Failed to move completed download into place: " + ec.message();
+            KOLOSAL_LOG_ERROR("%s", error.c_str());
+            return DownloadResult(false, error);
+        }
+
+        KOLOSAL_LOG_INFO("Download completed successfully. File size: %zu bytes %s",
+                              total_bytes, resuming ? "(resumed, segmented)" : "(segmented)");
+        DownloadResult result(true, "", local_path, total_bytes);
+        if (download.hashed_bytes == total_bytes)
+        {
+            result.sha256 = download.hasher.hexDigest();
+        }
+        return result;
+    }
+
+    // Output of the single-stream path, hashed as it is written
+    struct HashingSink
+    {
+        std::ofstream *file;
+        Sha256 *hasher;
+    };
+
+    static size_t hashing_write_callback(void *contents, size_t size, size_t nmemb, HashingSink *sink)
+    {
+        size_t total_size = size * nmemb;
+        sink->file->write(static_cast<const char *>(contents), total_size);
+        sink->hasher->update(contents, total_size);
+        shared_bandwidth.consume(total_size);
+        return total_size;
+    }
+
+    // Downloads without checking the result against a known checksum; result.sha256 is set whenever
+    // the whole file passed through the hasher
+    static DownloadResult download_file_unverified(const std::string &url, const std::string &local_path,
+                                                   DownloadProgressCallback progress_callback,
+                                                   volatile bool *cancelled, bool resume, int connections)
+    {
+        KOLOSAL_LOG_INFO("Starting download from URL: %s to: %s (resume: %s, cancellation: enabled)",
+                              url.c_str(), local_path.c_str(), resume ? "enabled" : "disabled");
+
+        // Validate URL
+        if (!is_valid_url(url))
+        {
+            std::string error = "Invalid URL format: " + url;
+            KOLOSAL_LOG_ERROR("%s", error.c_str());
+            return DownloadResult(false, error);
+        }
+
+        // Create directory for the file if it doesn't exist
+        std::filesystem::path file_path(local_path);
+        std::filesystem::create_directories(file_path.parent_path());
+
+        // Always get the expected file size from URL first
+        DownloadResult url_info = get_url_file_info(url);
+        size_t expected_total = 0;
+        if (url_info.success && url_info.total_bytes > 0)
+        {
+            expected_total = url_info.total_bytes;
+        }
+
+        // Large files go over several range requests; anything already at local_path (a finished file or a
+        // single-stream partial) keeps being handled below
+        if (connections <= 0)
+        {
+            connections = kDefaultDownloadConnections;
+        }
+        connections = (std::min)(connections, kMaxDownloadConnections);
+        if (connections > 1 && expected_total >= kSegmentedMinBytes && !std::filesystem::exists(local_path))
+        {
+            auto segmented = download_segmented(url, local_path, expected_total, connections, progress_callback, cancelled, resume);
+            if (segmented)
+            {
+                return *segmented;
+            }
+        }
+
+        // Check if we can resume the download
+        size_t resume_from = 0;
+        bool resuming = false;
+
+        if (resume && can_resume_download(url, local_path))
+        {
+            resume_from = std::filesystem::file_size(local_path);
+            resuming = true;
+            KOLOSAL_LOG_INFO("Resuming download from byte %zu/%zu", resume_from, expected_total);
+        }        else if (std::filesystem::exists(local_path))
+        {
+            // Check if file is already complete before removing it
+            try 
+            {
+                size_t local_size = std::filesystem::file_size(local_path);
+                if (local_size > 0)
+                {
+                    // Check if file is complete using the already fetched expected size
+                    if (expected_total > 0 && local_size == expected_total)
+                    {
+                        KOLOSAL_LOG_INFO("File already fully downloaded: %zu bytes, skipping download", local_size);
+                        return DownloadResult(true, "", local_path, local_size);
+                    }
+                }
+            }
+            catch (const std::exception &ex)
+            {
+                KOLOSAL_LOG_WARNING("Error checking existing file: %s", ex.what());
+            }
+            
+            // If file exists but can't resume or isn't complete, remove it and start fresh
+            std::filesystem::remove(local_path);
+            KOLOSAL_LOG_INFO("Existing file cannot be resumed, starting fresh download");
+        }
+
+        // Initialize CURL
+        CURL *curl = curl_easy_init();
+        if (!curl)
+        {
+            std::string error = "Failed to initialize CURL";
+            KOLOSAL_LOG_ERROR("%s", error.c_str());
+            return DownloadResult(false, error);
+        }
+
+        // The bytes already on disk go through the hasher first so the digest covers the whole file
+        Sha256 hasher;
+        if (resuming)
+        {
+            std::ifstream existing(local_path, std::ios::binary);
+            std::vector<char> block(kHashBlockBytes);
+            while (existing && hasher.size() < resume_from)
+            {
+                existing.read(block.data(), static_cast<std::streamsize>((std::min)(block.size(), resume_from - static_cast<size_t>(hasher.size()))));
+                if (existing.gcount() <= 0)
+                    break;
+                hasher.update(block.data(), static_cast<size_t>(existing.gcount()));
+            }
+        }
+
+        // Open output file (append mode if resuming)
+        std::ofstream output_file(local_path, resuming ? std::ios::binary | std::ios::app : std::ios::binary);
+        if (!output_file.is_open())
+        {
+            std::string error = "Failed to create output file: " + local_path;
+            KOLOSAL_LOG_ERROR("%s", error.c_str());
+            curl_easy_cleanup(curl);
+            return DownloadResult(false, error);
+        }
+
+        // Set up progress data
+        DownloadProgressData progress_data;
+        progress_data.callback = progress_callback;
+        progress_data.total_bytes = expected_total;
+        progress_data.downloaded_bytes = resume_from;
+        progress_data.cancelled = cancelled;
+
+        // Configure CURL options
+        SourceHeaders source_headers(curl, url);
+        curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+        HashingSink sink{&output_file, &hasher};
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, hashing_write_callback);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &sink);
+        curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+        curl_easy_setopt(curl, CURLOPT_USERAGENT, "Kolosal-Server/1.0");
+        curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 1L);
+        curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 2L);
+
+        // Set timeouts to prevent hanging
+        curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, 30L);
+        curl_easy_setopt(curl, CURLOPT_LOW_SPEED_LIMIT, 1L);
+        curl_easy_setopt(curl, CURLOPT_LOW_SPEED_TIME, 60L);
+        apply_download_speed_limit(curl, 1);
+
+        // Set resume range if resuming
+        if (resuming)
+        {
+            std::string range = std::to_string(resume_from) + "-";            curl_easy_setopt(curl, CURLOPT_RANGE, range.c_str());
+            // Resume download from byte position (logging suppressed for verbosity)
+        }
+
+        // Set up progress callback if provided
+        if (progress_callback || cancelled)
+        {
+            curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
+            curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, curl_progress_callback);
+            curl_easy_setopt(curl, CURLOPT_XFERINFODATA, &progress_data);
+        }
+
+        // Perform the download
+        CURLcode res;
+        {
+            ActiveTransfer active;
+            res = curl_easy_perform(curl);
+        }
+
+        // Get response code
+        long response_code = 0;
+        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response_code);
+
+        // Get content length
+        curl_off_t content_length = 0;
+        curl_easy_getinfo(curl, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &content_length);
+
+        // Clean up
+        output_file.close();
+        curl_easy_cleanup(curl);
+
+        // Check if download was cancelled
+        if (cancelled && *cancelled)
+        {
+            // Don't remove partially downloaded file - keep for resume
+            KOLOSAL_LOG_INFO("Download cancelled for URL: %s (partial file preserved for resume)", url.c_str());
+            return DownloadResult(false, "Download cancelled by user");
+        }
+
+        // Check for errors
+        if (res != CURLE_OK)
+        {
+            std::string error = "Download failed: " + std::string(curl_easy_strerror(res));
+            KOLOSAL_LOG_ERROR("%s", error.c_str());
+
+            // Don't remove file if we were resuming - keep partial download
+            if (!resuming)
+            {
+                std::filesystem::remove(local_path);
+            }
+
+            return DownloadResult(false, error);
+        }
+
+        // For resume, accept both 200 (full file) and 206 (partial content)
+        if (response_code != 200 && !(resuming && response_code == 206))
+        {
+            std::string error = "HTTP error: " + std::to_string(response_code);
+            KOLOSAL_LOG_ERROR("%s", error.c_str());
+
+            // Don't remove file if we were resuming - keep partial download
+            if (!resuming)
+            {
+                std::filesystem::remove(local_path);
+            }
+
+            return DownloadResult(false, error);
+        }
+
+        // Verify file was downloaded and has content
+        std::filesystem::path downloaded_file(local_path);
+        if (!std::filesystem::exists(downloaded_file) || std::filesystem::file_size(downloaded_file) == 0)
+        {
+            std::string error = "Downloaded file is empty or doesn't exist";
+            KOLOSAL_LOG_ERROR("%s", error.c_str());
+
+            // Remove empty file
+            if (std::filesystem::exists(downloaded_file))
+            {
+                std::filesystem::remove(downloaded_file);
+            }
+
+            return DownloadResult(false, error);
+        }
+
+        size_t final_size = std::filesystem::file_size(downloaded_file);
+
+        // If we know the expected size, verify it matches
+        if (expected_total > 0 && final_size != expected_total)
+        {
+            std::string error = "Downloaded file size (" + std::to_string(final_size) + 
+                              ") doesn't match expected size (" + std::to_string(expected_total) + ")";
+            KOLOSAL_LOG_ERROR("%s", error.c_str());
+            
+            // Remove incomplete file to allow clean restart
+            std::filesystem::remove(downloaded_file);
+            
+            return DownloadResult(false, error);
+        }
+
+        KOLOSAL_LOG_INFO("Download completed successfully. File size: %zu bytes %s",
+                              final_size, resuming ? "(resumed)" : "(full download)");
+
+        DownloadResult result(true, "", local_path, final_size);
+        if (hasher.size() == final_size)
+        {
+            result.sha256 = hasher.hexDigest();
+        }
+        return result;
+    }
+
+    std::string get_published_sha256(const std::string &url)
+    {
+        // HuggingFace answers a HEAD on a /resolve/ URL with a redirect whose X-Linked-Etag is
+        // the LFS object's SHA-256; other hosts publish nothing we can rely on
+        if (url.find("huggingface.co/") == std::string::npos || url.find("/resolve/") == std::string::npos)
+        {
+            return std::string();
+        }
+
+        CURL *curl = curl_easy_init();
+        if (!curl)
+        {
+            return std::string();
+        }
+
+        std::string linked_etag;
+        auto header_cb = +[](char *buffer, size_t size, size_t nitems, void *userdata) -> size_t
+        {
+            size_t length = size * nitems;
+            static constexpr char kName[] = "x-linked-etag:";
+            constexpr size_t kNameLength = sizeof(kName) - 1;
+            if (length > kNameLength)
+            {
+                bool match = true;
+                for (size_t i = 0; i < kNameLength && match; ++i)
+                    match = std::tolower(static_cast<unsigned char>(buffer[i])) == kName[i];
+                if (match)
+                    *static_cast<std::string *>(userdata) = std::string(buffer + kNameLength, length - kNameLength);
+            }
+            return length;
+        };
+
+        curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+        curl_easy_setopt(curl, CURLOPT_NOBODY, 1L);
+        curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 0L);
+        curl_easy_setopt(curl, CURLOPT_USERAGENT, "Kolosal-Server/1.0");
+        curl_easy_setopt(curl, CURLOPT_TIMEOUT, 30L);
+        curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 1L);
+        curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 2L);
+        curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, header_cb);
+        curl_easy_setopt(curl, CURLOPT_HEADERDATA, &linked_etag);
+
+        CURLcode res = curl_easy_perform(curl);
+        curl_easy_cleanup(curl);
+        if (res != CURLE_OK)
+        {
+            return std::string();
+        }
+
+        // Strip whitespace, quotes and a weak validator prefix
+        std::string digest;
+        for (char c : linked_etag)
+        {
+            if (std::isxdigit(static_cast<unsigned char>(c)))
+                digest += static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+            else if (c == 'W' || c == '/' || c == '"' || std::isspace(static_cast<unsigned char>(c)))
+                continue;
+            else
+                return std::string();
+        }
+        return Sha256::isHexDigest(digest) ? digest : std::string();
+    }
+
+    // The manifest lives beside the files it describes: one JSON object keyed by file name with the
+    // digest, size and modification time recorded when the file was last hashed
+    static constexpr const char *kManifestName = ".kolosal-manifest.json";
+    static std::mutex manifest_mutex;
+
+    static std::filesystem::path manifest_path_for(const std::filesystem::path &file)
+    {
+        return file.parent_path() / kManifestName;
+    }
+
+    static nlohmann::json read_manifest(const std::filesystem::path &path)
+    {
+        std::ifstream in(path);
+        if (!in)
+        {
+            return nlohmann::json::object();
+        }
+        nlohmann::json manifest = nlohmann::json::parse(in, nullptr, false);
+        return manifest.is_object() ? manifest : nlohmann::json::object();
+    }
+
+    static long long file_mtime(const std::filesystem::path &file, std::error_code &ec)
+    {
+        auto time = std::filesystem::last_write_time(file, ec);
+        return ec ? 0 : static_cast<long long>(time.time_since_epoch().count());
+    }
+
+    bool find_download_manifest_entry(const std::string &local_path, std::string &sha256, std::string &url)
+    {
+        std::filesystem::path file(local_path);
+        std::error_code ec;
+        size_t size = std::filesystem::file_size(file, ec);
+        if (ec)
+        {
+            return false;
+        }
+        long long mtime = file_mtime(file, ec);
+        if (ec)
+        {
+            return false;
+        }
+
+        std::lock_guard<std::mutex> lock(manifest_mutex);
+        nlohmann::json manifest = read_manifest(manifest_path_for(file));
+        auto it = manifest.find(file.filename().string());
+        if (it == manifest.end() || !it->is_object())
+        {
+            return false;
+        }
+
+        // A changed size or timestamp means the file was touched after it was hashed
+        if (it->value("size", static_cast<size_t>(0)) != size || it->value("mtime", 0LL) != mtime)
+        {
+            return false;
+        }
+        std::string recorded = it->value("sha256", std::string());
+        if (!Sha256::isHexDigest(recorded))
+        {
+            return false;
+        }
+        sha256 = recorded;
+        url = it->value("url", std::string());
+        return true;
+    }
+
+    bool is_download_verified(const std::string &local_path, const std::string &expected_sha256)
+    {
+        std::string recorded, url;
+        if (!find_download_manifest_entry(local_path, recorded, url))
+        {
+            return false;
+        }
+        return expected_sha256.empty() || recorded == expected_sha256;
+    }
+
+    // A copy of the file somewhere closer than its origin
+    struct SourceCandidate
+    {
+        std::string url;
+        std::string sha256;   // Digest the source advertises, if any
+        double seconds = 0.0; // HEAD round trip; the nearest source is tried first
+    };
+
+    // HEADs a candidate copy. A peer must advertise the digest it recorded and prove it holds the same
+    // file (the expected digest, or failing that the same origin URL), not just one with the same name.
+    static std::optional<SourceCandidate> probe_source(const std::string &candidate_url, bool peer,
+                                                       const std::string &origin_url, const std::string &expected)
+    {
+        CURL *curl = curl_easy_init();
+        if (!curl)
+            return std::nullopt;
+
+        struct Advertised
+        {
+            std::string sha256;
+            std::string source_url;
+        } advertised;
+        auto header_cb = +[](char *buffer, size_t size, size_t nitems, void *userdata) -> size_t
+        {
+            size_t length = size * nitems;
+            std::string line(buffer, length);
+            size_t colon = line.find(':');
+            if (colon != std::string::npos)
+            {
+                std::string name = line.substr(0, colon);
+                std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c)
+                               { return static_cast<char>(std::tolower(c)); });
+                size_t begin = line.find_first_not_of(" \t", colon + 1);
+                size_t end = line.find_last_not_of(" \t\r\n");
+                std::string value = begin == std::string::npos || end < begin ? std::string() : line.substr(begin, end - begin + 1);
+                auto *out = static_cast<Advertised *>(userdata);
+                if (name == "x-kolosal-sha256")
+                {
+                    std::transform(value.begin(), value.end(), value.begin(), [](unsigned char c)
+                                   { return static_cast<char>(std::tolower(c)); });
+                    out->sha256 = value;
+                }
+                else if (name == "x-kolosal-source-url")
+                {
+                    out->source_url = value;
+                }
+            }
+            return length;
+        };
+
+        SourceHeaders source_headers(curl, candidate_url);
+        curl_easy_setopt(curl, CURLOPT_URL, candidate_url.c_str());
+        curl_easy_setopt(curl, CURLOPT_NOBODY, 1L);
+        curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+        curl_easy_setopt(curl, CURLOPT_USERAGENT, "Kolosal-Server/1.0");
+        curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, 2L);
+        curl_easy_setopt(curl, CURLOPT_TIMEOUT, 5L);
+        curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 1L);
+        curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 2L);
+        curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, header_cb);
+        curl_easy_setopt(curl, CURLOPT_HEADERDATA, &advertised);
+
+        CURLcode res = curl_easy_perform(curl);
+        long response_code = 0;
+        double seconds = 0.0;
+        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response_code);
+        curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME, &seconds);
+        curl_easy_cleanup(curl);
+
+        if (res != CURLE_OK || response_code != 200)
+            return std::nullopt;
+        if (peer)
+        {
+            if (!Sha256::isHexDigest(advertised.sha256))
+                return std::nullopt;
+            if (!expected.empty() ? advertised.sha256 != expected : advertised.source_url != origin_url)
+                return std::nullopt;
+        }
+        else if (!expected.empty() && Sha256::isHexDigest(advertised.sha256) && advertised.sha256 != expected)
+        {
+            return std::nullopt;
+        }
+        return SourceCandidate{candidate_url, advertised.sha256, seconds};
+    }
+
+    static void remove_partial_download(const std::string &local_path)
+    {
+        std::error_code ec;
+        std::filesystem::remove(local_path, ec);
+        std::filesystem::remove(local_path + ".part", ec);
+        std::filesystem::remove(local_path + ".part.segments", ec);
+    }
+
+    // Link or copy a file into place: a hard link when both are on one file system, a copy otherwise.
+    // Copies go through a temporary name so nobody sees a half-written file.
+    static bool place_file(const std::filesystem::path &from, const std::filesystem::path &to)
+    {
+        std::error_code ec;
+        std::filesystem::create_hard_link(from, to, ec);
+        if (!ec)
+            return true;
+
+        std::filesystem::path tmp = to;
+        tmp += ".tmp-" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count());
+        if (!std::filesystem::copy_file(from, tmp, std::filesystem::copy_options::overwrite_existing, ec) || ec)
+        {
+            std::filesystem::remove(tmp, ec);
+            return false;
+        }
+        std::filesystem::rename(tmp, to, ec);
+        if (ec)
+        {
+            std::filesystem::remove(tmp, ec);
+            return false;
+        }
+        return true;
+    }
+
+    // Share a finished download through the cache directory, unless it already holds this file
+    static void publish_to_cache(const std::string &local_path, const std::string &url, const std::string &sha256, bool verified)
+    {
+        DownloadSources sources = current_download_sources();
+        if (sources.cache_dir.empty() || sha256.empty())
+            return;
+
+        std::filesystem::path cached = std::filesystem::path(sources.cache_dir) / std::filesystem::path(local_path).filename();
+        std::string cached_sha, cached_url;
+        if (find_download_manifest_entry(cached.string(), cached_sha, cached_url) && cached_sha == sha256)
+            return;
+
+        std::error_code ec;
+        std::filesystem::create_directories(sources.cache_dir, ec);
+        if (std::filesystem::equivalent(local_path, cached, ec))
+            return;
+        std::filesystem::remove(cached, ec);
+        if (place_file(local_path, cached) && record_download_manifest(cached.string(), url, sha256, verified))
+        {
+            KOLOSAL_LOG_INFO("Shared %s through the model cache %s", cached.filename().string().c_str(), sources.cache_dir.c_str());
+        }
+        else
+        {
+            KOLOSAL_LOG_WARNING("Failed to copy %s into the model cache %s", local_path.c_str(), sources.cache_dir.c_str());
+        }
+    }
+
+    // Looks for the file in the shared cache directory, then on the nearest peer or mirror holding it.
+    // Returns nothing when no source had it (the caller goes to the origin), or the download's result;
+    // whatever a source delivers is checked against the expected or advertised digest first.
+    static std::optional<DownloadResult> fetch_from_sources(const std::string &url, const std::string &local_path,
+                                                            const std::string &expected,
+                                                            DownloadProgressCallback progress_callback,
+                                                            volatile bool *cancelled, int connections)
+    {
+        DownloadSources sources = current_download_sources();
+        const std::string name = std::filesystem::path(local_path).filename().string();
+
+        if (!sources.cache_dir.empty())
+        {
+            std::filesystem::path cached = std::filesystem::path(sources.cache_dir) / name;
+            std::string sha, source_url;
+            if (find_download_manifest_entry(cached.string(), sha, source_url) &&
+                (!expected.empty() ? sha == expected : source_url == url))
+            {
+                std::filesystem::create_directories(std::filesystem::path(local_path).parent_path());
+                if (place_file(cached, local_path))
+                {
+                    size_t size = std::filesystem::file_size(local_path);
+                    record_download_manifest(local_path, url, sha, !expected.empty());
+                    KOLOSAL_LOG_INFO("Took %s from the model cache %s", name.c_str(), sources.cache_dir.c_str());
+                    if (progress_callback)
+                        progress_callback(size, size, 100.0);
+                    DownloadResult result(true, "", local_path, size);
+                    result.sha256 = sha;
+                    return result;
+                }
+                KOLOSAL_LOG_WARNING("Failed to copy %s from the model cache %s", name.c_str(), sources.cache_dir.c_str());
+            }
+        }
+
+        if (sources.peers.empty() && sources.mirrors.empty())
+            return std::nullopt;
+
+        // Probe every source at once and go nearest first
+        std::string escaped_name = name;
+        if (CURL *curl = curl_easy_init())
+        {
+            if (char *escaped = curl_easy_escape(curl, name.c_str(), static_cast<int>(name.size())))
+            {
+                escaped_name = escaped;
+                curl_free(escaped);
+            }
+            curl_easy_cleanup(curl);
+        }
+        std::vector<std::future<std::optional<SourceCandidate>>> probes;
+        for (const auto &peer : sources.peers)
+            probes.push_back(std::async(std::launch::async, probe_source, peer + "/v1/model-files/" + escaped_name, true, url, expected));
+        for (const auto &mirror : sources.mirrors)
+            probes.push_back(std::async(std::launch::async, probe_source, mirror + "/" + escaped_name, false, url, expected));
+
+        std::vector<SourceCandidate> candidates;
+        for (auto &probe : probes)
+        {
+            if (auto candidate = probe.get())
+                candidates.push_back(std::move(*candidate));
+        }
+        std::sort(candidates.begin(), candidates.end(), [](const SourceCandidate &a, const SourceCandidate &b)
+                  { return a.seconds < b.seconds; });
+
+        for (const auto &candidate : candidates)
+        {
+            if (cancelled && *cancelled)
+                return DownloadResult(false, "Download cancelled");
+
+            KOLOSAL_LOG_INFO("Fetching %s from %s (%.0f ms away) instead of its origin",
+                                  name.c_str(), candidate.url.c_str(), candidate.seconds * 1000.0);
+            const std::string must_match = !expected.empty() ? expected : candidate.sha256;
+            DownloadResult result = download_file_unverified(candidate.url, local_path, progress_callback, cancelled, true, connections);
+            if (result.success && result.sha256.empty())
+                result.sha256 = Sha256::hashFile(local_path);
+
+            if (result.success && (must_match.empty() || result.sha256 == must_match))
+            {
+                record_download_manifest(local_path, url, result.sha256, !expected.empty());
+                publish_to_cache(local_path, url, result.sha256, !expected.empty());
+                return result;
+            }
+            if (cancelled && *cancelled)
+                return result;
+
+            KOLOSAL_LOG_WARNING("Could not use %s: %s", candidate.url.c_str(),
+                                     result.success ? "checksum mismatch" : result.error_message.c_str());
+            remove_partial_download(local_path);
+        }
+        return std::nullopt;
+    }
+
+    bool record_download_manifest(const std::string &local_path, const std::string &url,
+                                  const std::string &sha256, bool verified)
+    {
+        std::filesystem::path file(local_path);
+        std::error_code ec;
+        size_t size = std::filesystem::file_size(file, ec);
+        if (ec)
+        {
+            return false;
+        }
+        long long mtime = file_mtime(file, ec);
+        if (ec)
+        {
+            return false;
+        }
+
+        std::lock_guard<std::mutex> lock(manifest_mutex);
+        std::filesystem::path manifest_path = manifest_path_for(file);
+        nlohmann::json manifest = read_manifest(manifest_path);
+        manifest[file.filename().string()] = {
+            {"sha256", sha256},
+            {"size", size},
+            {"mtime", mtime},
+            {"url", url},
+            {"verified", verified},
+            {"recorded_at", std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count()}};
+
+        std::filesystem::path tmp_path = manifest_path;
+        tmp_path += ".tmp";
+        {
+            std::ofstream out(tmp_path, std::ios::trunc);
+            if (!out)
+            {
+                KOLOSAL_LOG_WARNING("Failed to write download manifest: %s", tmp_path.string().c_str());
+                return false;
+            }
+            out << manifest.dump(2);
+        }
+        std::filesystem::rename(tmp_path, manifest_path, ec);
+        if (ec)
+        {
+            KOLOSAL_LOG_WARNING("Failed to update download manifest %s: %s", manifest_path.string().c_str(), ec.message().c_str());
+            return false;
+        }
+        return true;
+    }
+
+    DownloadResult download_file_with_cancellation_and_resume(const std::string &url, const std::string &local_path,
+                                                              DownloadProgressCallback progress_callback,
+                                                              volatile bool *cancelled, bool resume,
+                                                              int connections, const std::string &expected_sha256)
+    {
+        std::string expected;
+        for (char c : expected_sha256)
+            expected += static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        if (!expected.empty() && !Sha256::isHexDigest(expected))
+        {
+            std::string error = "Invalid SHA-256 checksum: " + expected_sha256;
+            KOLOSAL_LOG_ERROR("%s", error.c_str());
+            return DownloadResult(false, error);
+        }
+        if (expected.empty())
+        {
+            expected = get_published_sha256(url);
+        }
+
+        // A file the manifest vouches for is not read again
+        if (!expected.empty() && is_download_verified(local_path, expected))
+        {
+            KOLOSAL_LOG_INFO("File already downloaded and verified: %s", local_path.c_str());
+            DownloadResult verified(true, "", local_path, std::filesystem::file_size(local_path));
+            verified.sha256 = expected;
+            return verified;
+        }
+
+        // Try the fleet before the WAN, unless a partial download from the origin is waiting to be resumed
+        std::error_code exists_ec;
+        if (!std::filesystem::exists(local_path, exists_ec) && partial_download_url(local_path) != url)
+        {
+            if (auto fetched = fetch_from_sources(url, local_path, expected, progress_callback, cancelled, connections))
+            {
+                return *fetched;
+            }
+        }
+
+        DownloadResult result = download_file_unverified(url, local_path, progress_callback, cancelled, resume, connections);
+        if (!result.success)
+        {
+            return result;
+        }
+
+        if (result.sha256.empty())
+        {
+            // The file was complete on disk already and never streamed through the hasher
+            if (expected.empty())
+            {
+                return result;
+            }
+            KOLOSAL_LOG_INFO("Verifying existing file against SHA-256 %s", expected.c_str());
+            result.sha256 = Sha256::hashFile(local_path);
+        }
+
+        if (!expected.empty() && result.sha256 != expected)
+        {
+            std::string error = "Checksum mismatch for " + local_path + ": expected SHA-256 " + expected + ", got " +
+                                (result.sha256.empty() ? std::string("unreadable file") : result.sha256);
+            KOLOSAL_LOG_ERROR("%s", error.c_str());
+            std::error_code ec;
+            std::filesystem::remove(local_path, ec);
+            return DownloadResult(false, error);
+        }
+
+        record_download_manifest(local_path, url, result.sha256, !expected.empty());
+        publish_to_cache(local_path, url, result.sha256, !expected.empty());
+        if (!expected.empty())
+        {
+            KOLOSAL_LOG_INFO("SHA-256 verified for %s", local_path.c_str());
+        }
+        return result;
     }
 
 } // namespace kolosal
@@ -0,0 +1,375 @@
+#include "kolosal/drain_manager.hpp"
+#include "kolosal/cluster_router.hpp"
+#include "kolosal/remote_prefill.hpp"
+#include "kolosal/server_api.hpp"
+#include "kolosal/node_manager.h"
+#include "kolosal/logger.hpp"
+#include <curl/curl.h>
+#include <set>
+#include <thread>
+
+using json = nlohmann::json;
+
+namespace kolosal
+{
+
+namespace
+{
+    constexpr long kConnectTimeoutMs = 1000;
+    constexpr auto kIdlePoll = std::chrono::milliseconds(200);
+    const char* const kSessionsPath = "/v1/internal/sessions";
+    const char* const kResumePath = "/v1/internal/resume";
+
+    const char* stateName(DrainManager::State state)
+    {
+        switch (state)
+        {
+        case DrainManager::State::Draining: return "draining";
+        case DrainManager::State::Migrating: return "migrating";
+        case DrainManager::State::Drained: return "drained";
+        default: return "serving";
+        }
+    }
+
+    int activeJobs()
+    {
+        int active = 0;
+        for (const auto& replica : ServerAPI::instance().getNodeManager().getReplicaStats())
+            active += replica.load.active_jobs;
+        return active;
+    }
+
+    std::string frame(const json& header, const KvSequenceState* state)
+    {
+        std::string body = header.dump();
+        body.push_back('\n');
+        if (state)
+            body += RemotePrefill::encode(*state);
+        return body;
+    }
+
+    size_t forward(char* data, size_t size, size_t count, void* userdata)
+    {
+        return (*static_cast<const std::function<size_t(const char*, size_t)>*>(userdata))(data, size * count);
+    }
+}
+
+DrainManager& DrainManager::instance()
+{
+    static DrainManager manager;
+    return manager;
+}
+
+DrainManager::~DrainManager()
+{
+    stop();
+}
+
+void DrainManager::configure(const ClusterConfig& config)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    config_ = config;
+}
+
+bool DrainManager::start()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!config_.enabled || !ClusterRouter::instance().enabled() || state_.load() != State::Serving)
+        return false;
+    if (worker_.joinable())
+        worker_.join();     // A drain that was cancelled
+
+    cancelled_ = false;
+    started_ = std::chrono::steady_clock::now();
+    state_.store(State::Draining);
+    drains_.fetch_add(1, std::memory_order_relaxed);
+    ClusterRouter::instance().setDraining(true);
+    worker_ = std::thread(&DrainManager::run, this);
+    KOLOSAL_LOG_INFO("Draining: new completions are refused, running ones get %d s to finish",
+                          config_.drain_grace_seconds);
+    return true;
+}
+
+void DrainManager::cancel()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (state_.load() == State::Serving)
+            return;
+        cancelled_ = true;
+    }
+    cv_.notify_all();
+    if (worker_.joinable())
+        worker_.join();
+    state_.store(State::Serving);
+    ClusterRouter::instance().setDraining(false);
+}
+
+void DrainManager::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        cancelled_ = true;
+    }
+    cv_.notify_all();
+    if (worker_.joinable())
+        worker_.join();
+}
+
+void DrainManager::sendDraining(SocketType sock) const
+{
+    json jError = {{"error", {{"message", "This node is draining, retry the request"},
+                              {"type", "server_overloaded"}, {"param", nullptr}, {"code", "node_draining"}}}};
+    send_response(sock, 503, jError.dump(), {{"Content-Type", "application/json"}, {"Retry-After", "1"}});
+}
+
+bool DrainManager::waitIdle(std::chrono::steady_clock::time_point deadline)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!cancelled_)
+    {
+        lock.unlock();
+        const bool idle = activeJobs() == 0;
+        lock.lock();
+        if (idle)
+            return true;
+        if (std::chrono::steady_clock::now() >= deadline)
+            return false;
+        cv_.wait_for(lock, kIdlePoll, [this] { return cancelled_; });
+    }
+    return false;
+}
+
+void DrainManager::run()
+{
+    const auto grace = started_ + std::chrono::seconds(config_.drain_grace_seconds);
+    if (!waitIdle(grace))
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (cancelled_)
+                return;
+        }
+        // The completion routes suspend their generations and resume them on peers
+        state_.store(State::Migrating);
+        KOLOSAL_LOG_INFO("Draining: moving %d running job(s) to other nodes", activeJobs());
+        if (!waitIdle(grace + std::chrono::seconds(config_.drain_timeout_seconds)))
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (cancelled_)
+                return;
+            KOLOSAL_LOG_WARNING("Draining: %d job(s) still running after %d s", activeJobs(),
+                                     config_.drain_grace_seconds + config_.drain_timeout_seconds);
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (cancelled_)
+            return;
+    }
+
+    moveSessions();
+    state_.store(State::Drained);
+    KOLOSAL_LOG_INFO("Drained in %lld ms: %llu generation(s) and %llu session(s) moved to other nodes",
+                          static_cast<long long>(std::chrono::duration_cast<std::chrono::milliseconds>(
+                              std::chrono::steady_clock::now() - started_).count()),
+                          static_cast<unsigned long long>(generations_moved_.load()),
+                          static_cast<unsigned long long>(sessions_moved_.load()));
+}
+
+void DrainManager::moveSessions()
+{
+    auto& nodeManager = ServerAPI::instance().getNodeManager();
+    auto& router = ClusterRouter::instance();
+
+    std::set<std::string> models;
+    for (const auto& replica : nodeManager.getReplicaStats())
+        models.insert(replica.engineId);
+
+    for (const auto& model : models)
+    {
+        for (const auto& engine : nodeManager.getLoadedReplicas(model))
+        {
+            for (const auto& [key, state] : engine->exportSessions())
+            {
+                const std::string url = router.handoffTarget(model, key);
+                long status = 0;
+                const bool sent = !url.empty() && post(url + kSessionsPath, frame({{"model", model}, {"key", key}}, state.get()),
+                                                       [](const char*, size_t bytes) { return bytes; }, status) &&
+                                  status == 200;
+                if (sent)
+                {
+                    sessions_moved_.fetch_add(1, std::memory_order_relaxed);
+                    continue;
+                }
+                sessions_failed_.fetch_add(1, std::memory_order_relaxed);
+                KOLOSAL_LOG_WARNING("Draining: session of model '%s' (%zu tokens) dropped: %s", model.c_str(),
+                                         state->tokens.size(),
+                                         url.empty() ? "no other node has the model loaded" : ("HTTP " + std::to_string(status)).c_str());
+            }
+        }
+    }
+}
+
+bool DrainManager::resume(const std::string& model, const std::string& body, std::shared_ptr<const KvSequenceState> state,
+                          size_t generated, int maxNewTokens, const OutputHandler& onOutput)
+{
+    // Without the state a peer could only start over, repeating what the client already has
+    if (!state && generated > 0)
+    {
+        generations_failed_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    int remaining = maxNewTokens;
+    if (maxNewTokens > 0)
+    {
+        remaining = maxNewTokens - static_cast<int>(generated);
+        if (remaining <= 0)
+            return true;
+    }
+
+    json request;
+    try
+    {
+        request = json::parse(body);
+    }
+    catch (const json::parse_error&)
+    {
+        generations_failed_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    // Sessions follow their key; other generations spread over the ring by their body
+    const std::string key = request.contains("session_id") && request["session_id"].is_string()
+                                ? request["session_id"].get<std::string>() : body;
+    const std::string url = ClusterRouter::instance().handoffTarget(model, key);
+    if (url.empty())
+    {
+        generations_failed_.fetch_add(1, std::memory_order_relaxed);
+        KOLOSAL_LOG_WARNING("[Thread %zu] Draining: no other node has model '%s' loaded; output ends after %zu tokens",
+                                 std::hash<std::thread::id>{}(std::this_thread::get_id()), model.c_str(), generated);
+        return false;
+    }
+
+    // The peer answers with server-sent events: output, then {"finished":true} or {"error":...}
+    std::string pending;
+    bool finished = false;
+    bool abandoned = false;
+    std::string error;
+    auto onData = [&](const char* data, size_t bytes) -> size_t
+    {
+        pending.append(data, bytes);
+        size_t end;
+        while ((end = pending.find("\n\n")) != std::string::npos)
+        {
+            const std::string event = pending.substr(0, end);
+            pending.erase(0, end + 2);
+            if (event.rfind("data: ", 0) != 0 || event.compare(6, std::string::npos, "[DONE]") == 0)
+                continue;
+            const json message = json::parse(event.substr(6), nullptr, false);
+            if (message.is_discarded())
+                continue;
+            if (message.contains("error"))
+                error = message["error"].is_string() ? message["error"].get<std::string>() : message["error"].dump();
+            else if (message.value("finished", false))
+                finished = true;
+            else if (!onOutput(message.value("text", ""), message.value("tokens", std::vector<int32_t>())))
+            {
+                abandoned = true;
+                return 0;   // Aborts the transfer, which stops the generation on the peer
+            }
+        }
+        return bytes;
+    };
+
+    json header = {{"model", model}, {"request", std::move(request)}, {"max_tokens", remaining}};
+    long status = 0;
+    const bool sent = post(url + kResumePath, frame(header, state.get()), onData, status);
+    if (abandoned)
+        return true;
+    if (!sent || status != 200 || !finished)
+    {
+        generations_failed_.fetch_add(1, std::memory_order_relaxed);
+        if (error.empty())
+            error = sent ? "HTTP " + std::to_string(status) : "connection failed";
+        KOLOSAL_LOG_WARNING("[Thread %zu] Draining: resuming a generation on %s failed (%s)",
+                                 std::hash<std::thread::id>{}(std::this_thread::get_id()), url.c_str(), error.c_str());
+        return false;
+    }
+    generations_moved_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+bool DrainManager::post(const std::string& url, const std::string& body, const std::function<size_t(const char*, size_t)>& onData,
+                        long& status)
+{
+    // One handle per thread keeps connections to the peers alive
+    thread_local struct Handle
+    {
+        CURL* curl = curl_easy_init();
+        ~Handle() { if (curl) curl_easy_cleanup(curl); }
+    } handle;
+    CURL* curl = handle.curl;
+    if (!curl)
+        return false;
+    curl_easy_reset(curl);
+
+    std::string apiKey;
+    long timeout;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        apiKey = config_.api_key;
+        timeout = static_cast<long>(config_.proxy_timeout_seconds);
+    }
+
+    struct curl_slist* headers = nullptr;
+    headers = curl_slist_append(headers, "Content-Type: application/octet-stream");
+    headers = curl_slist_append(headers, "Expect:");
+    if (!apiKey.empty())
+        headers = curl_slist_append(headers, ("X-API-Key: " + apiKey).c_str());
+
+    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+    curl_easy_setopt(curl, CURLOPT_POST, 1L);
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, body.data());
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE_LARGE, static_cast<curl_off_t>(body.size()));
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, forward);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &onData);
+    curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT_MS, kConnectTimeoutMs);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT, timeout);
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(curl, CURLOPT_TCP_NODELAY, 1L);
+
+    const CURLcode result = curl_easy_perform(curl);
+    curl_slist_free_all(headers);
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status);
+    return result == CURLE_OK;
+}
+
+json DrainManager::status() const
+{
+    const State current = state();
+    json status = {{"state", stateName(current)}, {"active_jobs", activeJobs()},
+                   {"generations_moved", generations_moved_.load()}, {"generations_failed", generations_failed_.load()},
+                   {"sessions_moved", sessions_moved_.load()}, {"sessions_failed", sessions_failed_.load()}};
+    if (current != State::Serving)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        status["elapsed_ms"] = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - started_).count();
+    }
+    return status;
+}
+
+DrainManager::Stats DrainManager::stats() const
+{
+    Stats stats;
+    stats.drains = drains_.load(std::memory_order_relaxed);
+    stats.generations_moved = generations_moved_.load(std::memory_order_relaxed);
+    stats.generations_failed = generations_failed_.load(std::memory_order_relaxed);
+    stats.sessions_moved = sessions_moved_.load(std::memory_order_relaxed);
+    stats.sessions_failed = sessions_failed_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+} // namespace kolosal
@@ -0,0 +1,339 @@
+#include "kolosal/event_loop.hpp"
+#include "kolosal/logger.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+#if defined(_WIN32)
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#elif defined(__linux__)
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <errno.h>
+#else
+#include <sys/types.h>
+#include <sys/event.h>
+#include <sys/time.h>
+#include <errno.h>
+#endif
+
+namespace kolosal
+{
+
+#if defined(_WIN32)
+
+    // WSAPoll backend. Windows has no one-shot readiness primitive for plain
+    // sockets, so disarmed entries are simply skipped when building the poll set.
+    // WSAPoll cannot be interrupted, so wait() polls in short slices instead.
+    struct EventLoop::Impl
+    {
+        struct Entry
+        {
+            SocketType sock;
+            void *userData;
+            bool armed;
+        };
+
+        std::mutex mtx;
+        std::vector<Entry> entries;
+    };
+
+    EventLoop::EventLoop() : pImpl(std::make_unique<Impl>()) {}
+
+    EventLoop::~EventLoop() = default;
+
+    bool EventLoop::valid() const { return true; }
+
+    bool EventLoop::add(SocketType sock, void *userData)
+    {
+        std::lock_guard<std::mutex> lock(pImpl->mtx);
+        pImpl->entries.push_back({sock, userData, true});
+        return true;
+    }
+
+    bool EventLoop::rearm(SocketType sock, void *userData)
+    {
+        std::lock_guard<std::mutex> lock(pImpl->mtx);
+        for (auto &entry : pImpl->entries)
+        {
+            if (entry.sock == sock)
+            {
+                entry.userData = userData;
+                entry.armed = true;
+                return true;
+            }
+        }
+        pImpl->entries.push_back({sock, userData, true});
+        return true;
+    }
+
+    void EventLoop::remove(SocketType sock)
+    {
+        std::lock_guard<std::mutex> lock(pImpl->mtx);
+        pImpl->entries.erase(std::remove_if(pImpl->entries.begin(), pImpl->entries.end(),
+                                            [sock](const Impl::Entry &e) { return e.sock == sock; }),
+                             pImpl->entries.end());
+    }
+
+    int EventLoop::wait(std::vector<Event> &events, int timeoutMs)
+    {
+        events.clear();
+
+        std::vector<WSAPOLLFD> fds;
+        std::vector<void *> owners;
+        {
+            std::lock_guard<std::mutex> lock(pImpl->mtx);
+            for (const auto &entry : pImpl->entries)
+            {
+                if (!entry.armed)
+                    continue;
+                WSAPOLLFD pfd{};
+                pfd.fd = entry.sock;
+                pfd.events = POLLRDNORM;
+                fds.push_back(pfd);
+                owners.push_back(entry.userData);
+            }
+        }
+
+        // Poll in short slices so wakeup() and newly added sockets are noticed promptly
+        const int slice = timeoutMs < 0 ? 50 : std::min(timeoutMs, 50);
+        if (fds.empty())
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(slice));
+            return 0;
+        }
+
+        int rc = WSAPoll(fds.data(), static_cast<ULONG>(fds.size()), slice);
+        if (rc <= 0)
+            return 0;
+
+        std::lock_guard<std::mutex> lock(pImpl->mtx);
+        for (size_t i = 0; i < fds.size(); ++i)
+        {
+            if (fds[i].revents == 0)
+                continue;
+            Event ev;
+            ev.userData = owners[i];
+            ev.readable = (fds[i].revents & (POLLRDNORM | POLLHUP)) != 0;
+            ev.hangup = (fds[i].revents & (POLLERR | POLLHUP | POLLNVAL)) != 0;
+            events.push_back(ev);
+            for (auto &entry : pImpl->entries)
+            {
+                if (entry.sock == fds[i].fd)
+                {
+                    entry.armed = false;
+                    break;
+                }
+            }
+        }
+        return static_cast<int>(events.size());
+    }
+
+    void EventLoop::wakeup()
+    {
+        // wait() never blocks longer than one slice, nothing to signal
+    }
+
+    const char *EventLoop::backendName() { return "wsapoll"; }
+
+#elif defined(__linux__)
+
+    // epoll backend with an eventfd used to interrupt epoll_wait
+    struct EventLoop::Impl
+    {
+        int epfd = -1;
+        int wakeFd = -1;
+    };
+
+    EventLoop::EventLoop() : pImpl(std::make_unique<Impl>())
+    {
+        pImpl->epfd = epoll_create1(EPOLL_CLOEXEC);
+        if (pImpl->epfd == -1)
+        {
+            KOLOSAL_LOG_ERROR("epoll_create1 failed: %s", std::strerror(errno));
+            return;
+        }
+
+        pImpl->wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (pImpl->wakeFd != -1)
+        {
+            struct epoll_event ev{};
+            ev.events = EPOLLIN;
+            ev.data.ptr = nullptr; // nullptr marks the wakeup descriptor
+            epoll_ctl(pImpl->epfd, EPOLL_CTL_ADD, pImpl->wakeFd, &ev);
+        }
+    }
+
+    EventLoop::~EventLoop()
+    {
+        if (pImpl->wakeFd != -1)
+            close(pImpl->wakeFd);
+        if (pImpl->epfd != -1)
+            close(pImpl->epfd);
+    }
+
+    bool EventLoop::valid() const { return pImpl->epfd != -1; }
+
+    bool EventLoop::add(SocketType sock, void *userData)
+    {
+        struct epoll_event ev{};
+        ev.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+        ev.data.ptr = userData;
+        return epoll_ctl(pImpl->epfd, EPOLL_CTL_ADD, sock, &ev) == 0;
+    }
+
+    bool EventLoop::rearm(SocketType sock, void *userData)
+    {
+        struct epoll_event ev{};
+        ev.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+        ev.data.ptr = userData;
+        if (epoll_ctl(pImpl->epfd, EPOLL_CTL_MOD, sock, &ev) == 0)
+            return true;
+        // Socket may have been removed in the meantime; register it again
+        return errno == ENOENT && epoll_ctl(pImpl->epfd, EPOLL_CTL_ADD, sock, &ev) == 0;
+    }
+
+    void EventLoop::remove(SocketType sock)
+    {
+        epoll_ctl(pImpl->epfd, EPOLL_CTL_DEL, sock, nullptr);
+    }
+
+    int EventLoop::wait(std::vector<Event> &events, int timeoutMs)
+    {
+        events.clear();
+
+        struct epoll_event ready[128];
+        int n = epoll_wait(pImpl->epfd, ready, 128, timeoutMs);
+        if (n <= 0)
+            return 0;
+
+        for (int i = 0; i < n; ++i)
+        {
+            if (ready[i].data.ptr == nullptr)
+            {
+                uint64_t drained = 0;
+                while (read(pImpl->wakeFd, &drained, sizeof(drained)) > 0)
+                {
+                }
+                continue;
+            }
+            Event ev;
+            ev.userData = ready[i].data.ptr;
+            ev.readable = (ready[i].events & EPOLLIN) != 0;
+            ev.hangup = (ready[i].events & (EPOLLERR | EPOLLHUP | EPOLLRDHUP)) != 0;
+            events.push_back(ev);
+        }
+        return static_cast<int>(events.size());
+    }
+
+    void EventLoop::wakeup()
+    {
+        if (pImpl->wakeFd != -1)
+        {
+            uint64_t one = 1;
+            ssize_t ignored = write(pImpl->wakeFd, &one, sizeof(one));
+            (void)ignored;
+        }
+    }
+
+    const char *EventLoop::backendName() { return "epoll"; }
+
+#else
+
+    // kqueue backend; EV_DISPATCH gives one-shot delivery without dropping the
+    // registration and EVFILT_USER is used for cross-thread wakeups
+    struct EventLoop::Impl
+    {
+        int kq = -1;
+    };
+
+    EventLoop::EventLoop() : pImpl(std::make_unique<Impl>())
+    {
+        pImpl->kq = kqueue();
+        if (pImpl->kq == -1)
+        {
+            KOLOSAL_LOG_ERROR("kqueue failed: %s", std::strerror(errno));
+            return;
+        }
+
+        struct kevent ev;
+        EV_SET(&ev, 0, EVFILT_USER, EV_ADD | EV_CLEAR, 0, 0, nullptr);
+        kevent(pImpl->kq, &ev, 1, nullptr, 0, nullptr);
+    }
+
+    EventLoop::~EventLoop()
+    {
+        if (pImpl->kq != -1)
+            close(pImpl->kq);
+    }
+
+    bool EventLoop::valid() const { return pImpl->kq != -1; }
+
+    bool EventLoop::add(SocketType sock, void *userData)
+    {
+        struct kevent ev;
+        EV_SET(&ev, sock, EVFILT_READ, EV_ADD | EV_ENABLE | EV_DISPATCH, 0, 0, userData);
+        return kevent(pImpl->kq, &ev, 1, nullptr, 0, nullptr) == 0;
+    }
+
+    bool EventLoop::rearm(SocketType sock, void *userData)
+    {
+        struct kevent ev;
+        EV_SET(&ev, sock, EVFILT_READ, EV_ADD | EV_ENABLE | EV_DISPATCH, 0, 0, userData);
+        return kevent(pImpl->kq, &ev, 1, nullptr, 0, nullptr) == 0;
+    }
+
+    void EventLoop::remove(SocketType sock)
+    {
+        struct kevent ev;
+        EV_SET(&ev, sock, EVFILT_READ, EV_DELETE, 0, 0, nullptr);
+        kevent(pImpl->kq, &ev, 1, nullptr, 0, nullptr);
+    }
+
+    int EventLoop::wait(std::vector<Event> &events, int timeoutMs)
+    {
+        events.clear();
+
+        struct timespec ts;
+        struct timespec *tsp = nullptr;
+        if (timeoutMs >= 0)
+        {
+            ts.tv_sec = timeoutMs / 1000;
+            ts.tv_nsec = (timeoutMs % 1000) * 1000000L;
+            tsp = &ts;
+        }
+
+        struct kevent ready[128];
+        int n = kevent(pImpl->kq, nullptr, 0, ready, 128, tsp);
+        if (n <= 0)
+            return 0;
+
+        for (int i = 0; i < n; ++i)
+        {
+            if (ready[i].filter == EVFILT_USER)
+                continue;
+            Event ev;
+            ev.userData = ready[i].udata;
+            ev.readable = ready[i].filter == EVFILT_READ;
+            ev.hangup = (ready[i].flags & (EV_EOF | EV_ERROR)) != 0;
+            events.push_back(ev);
+        }
+        return static_cast<int>(events.size());
+    }
+
+    void EventLoop::wakeup()
+    {
+        struct kevent ev;
+        EV_SET(&ev, 0, EVFILT_USER, 0, NOTE_TRIGGER, 0, nullptr);
+        kevent(pImpl->kq, &ev, 1, nullptr, 0, nullptr);
+    }
+
+    const char *EventLoop::backendName() { return "kqueue"; }
+
+#endif
+
+} // namespace kolosal
@@ -1,258 +1,3151 @@
 #include "kolosal/faiss_client.hpp"
+#include "kolosal/faiss_point_store.hpp"
+#include "kolosal/faiss_vector_file.hpp"
 #include "kolosal/logger.hpp"
+#include "kolosal/task_executor.hpp"
+#include "kolosal/vector_math.hpp"
 #include <filesystem>
 #include <fstream>
 #include <thread>
 #include <mutex>
+#include <shared_mutex>
 #include <condition_variable>
 #include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <limits>
 #include <unordered_map>
+#include <unordered_set>
 #include <sstream>
 #include <cmath>
+#include <random>
+#include <zlib.h>
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 #ifdef USE_FAISS
 #include <faiss/IndexFlat.h>
 #include <faiss/IndexIVFFlat.h>
+#include <faiss/IndexIVFPQ.h>
 #include <faiss/IndexHNSW.h>
+#include <faiss/IndexScalarQuantizer.h>
+#include <faiss/index_factory.h>
 #include <faiss/IndexIDMap.h>
 #include <faiss/index_io.h>
 #include <faiss/impl/io.h>
+#include <faiss/impl/IDSelector.h>
+#include <faiss/clone_index.h>
+#include <faiss/invlists/InvertedLists.h>
+#include <faiss/invlists/OnDiskInvertedLists.h>
 #ifdef FAISS_ENABLE_GPU
-#include <faiss/gpu/GpuIndexFlat.h>
-#include <faiss/gpu/GpuIndexIVFFlat.h>
+#include <faiss/gpu/GpuCloner.h>
+#include <faiss/gpu/GpuClonerOptions.h>
 #include <faiss/gpu/StandardGpuResources.h>
+#include <faiss/gpu/utils/DeviceUtils.h>
 #endif
 #endif
 
 namespace kolosal
 {
 
-class FaissClient::Impl
+namespace
 {
-public:
-#ifdef USE_FAISS
-    faiss::Index* index_;
-    std::unordered_map<std::string, std::string> id_to_internal_id_;
-    std::unordered_map<faiss::idx_t, std::string> internal_id_to_id_;
-    std::unordered_map<std::string, std::unordered_map<std::string, nlohmann::json>> payloads_;
-    std::atomic<faiss::idx_t> next_internal_id_{0};
-#ifdef FAISS_ENABLE_GPU
-    std::unique_ptr<faiss::gpu::StandardGpuResources> gpu_resources_;
-#endif
+    // WAL records are [u32 length][u32 crc32][payload] in host byte order; a record whose
+    // length or checksum does not add up marks the torn tail of an interrupted write
+    constexpr uint8_t kWalUpsert = 1;
+    constexpr uint8_t kWalDelete = 2;
+    constexpr size_t kWalHeaderBytes = 8;
+
+    // Snapshot archive: magic, [u32 length][JSON header], then each file's bytes followed by its crc32
+    constexpr char kSnapshotMagic[8] = {'K', 'F', 'S', 'N', 'A', 'P', '0', '1'};
+    constexpr uint32_t kMaxSnapshotHeader = 1 << 20;
+    constexpr size_t kSnapshotBufferBytes = 1 << 20;
+
+    // Below this many tombstones a compaction rebuild is not worth a thread, whatever the ratio
+    constexpr size_t kMinCompactTombstones = 64;
+
+    // Queries kept for ordering the warm-up of a mapped index, and lists warmed per lock hold
+    constexpr size_t kRecentQueries = 64;
+    constexpr size_t kWarmBatchLists = 32;
+
+#if defined(USE_FAISS) && defined(FAISS_ENABLE_GPU)
+    // Smaller main indexes are searched on the CPU; copying them to a GPU does not pay off
+    constexpr faiss::idx_t kGpuMinVectors = 16384;
+    // Largest k the GPU top-k kernels select; deeper searches stay on the CPU
+    constexpr faiss::idx_t kGpuMaxK = 2048;
 #endif
-    
-    Config config_;
-    std::string current_collection_;
-    std::mutex mutex_;
-    bool initialized_;
-    
-    Impl(const Config& config) 
-        : config_(config), initialized_(false)
-#ifdef USE_FAISS
-        , index_(nullptr)
+
+    template <typename T>
+    void putValue(std::string& out, T value)
+    {
+        out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    void putString(std::string& out, const std::string& value)
+    {
+        putValue<uint32_t>(out, static_cast<uint32_t>(value.size()));
+        out.append(value);
+    }
+
+    struct WalReader
+    {
+        const char* pos;
+        const char* end;
+        bool ok = true;
+
+        template <typename T>
+        T get()
+        {
+            T value{};
+            if (static_cast<size_t>(end - pos) < sizeof(T))
+            {
+                ok = false;
+                return value;
+            }
+            std::memcpy(&value, pos, sizeof(T));
+            pos += sizeof(T);
+            return value;
+        }
+
+        std::string getString()
+        {
+            const uint32_t size = get<uint32_t>();
+            if (!ok || static_cast<size_t>(end - pos) < size)
+            {
+                ok = false;
+                return {};
+            }
+            std::string value(pos, size);
+            pos += size;
+            return value;
+        }
+    };
+
+    bool syncFileHandle(std::FILE* file)
+    {
+        if (std::fflush(file) != 0)
+            return false;
+#ifdef _WIN32
+        return _commit(_fileno(file)) == 0;
+#else
+        return fsync(fileno(file)) == 0;
 #endif
+    }
+
+    // Names one load of a collection in its change stream
+    std::string randomEpoch()
     {
-        ServerLogger::logInfo("FaissClient initialized with index path: %s", config_.indexPath.c_str());
+        std::random_device device;
+        std::mt19937_64 generator((static_cast<uint64_t>(device()) << 32) ^ device());
+        char text[17];
+        std::snprintf(text, sizeof(text), "%016llx", static_cast<unsigned long long>(generator()));
+        return text;
     }
-    
-    ~Impl()
+
+    // Flushes a file (or, on POSIX, a directory after a rename) to stable storage
+    void syncPath(const std::filesystem::path& path, bool directory = false)
     {
-#ifdef USE_FAISS
-        if (index_)
+#ifdef _WIN32
+        if (directory)
+            return;
+        int fd = _wopen(path.c_str(), _O_RDWR | _O_BINARY);
+        if (fd >= 0)
         {
-            delete index_;
+            _commit(fd);
+            _close(fd);
+        }
+#else
+        int fd = open(path.c_str(), directory ? O_RDONLY | O_DIRECTORY : O_RDONLY);
+        if (fd >= 0)
+        {
+            fsync(fd);
+            close(fd);
         }
 #endif
     }
-    
-    std::future<FaissResult> initializeIndex(const std::string& collection_name, int dimensions)
+} // namespace
+
+class FaissClient::Impl
+{
+public:
+#ifdef USE_FAISS
+    // A point as written to the WAL: internal id resolved, vector already normalized
+    struct WalPoint
     {
-        return std::async(std::launch::async, [this, collection_name, dimensions]() -> FaissResult {
-            std::lock_guard<std::mutex> lock(mutex_);
-            
+        std::string id;
+        faiss::idx_t internal_id;
+        std::vector<float> vector;
+        std::unordered_map<std::string, nlohmann::json> payload;
+    };
+
+    // A decoded WAL record: an upsert of points or a delete of ids
+    struct WalRecord
+    {
+        uint8_t op = 0;
+        std::vector<WalPoint> points;
+        std::vector<std::string> ids;
+    };
+
+    /**
+     * One collection: its own index, files, write-ahead log, locks and settings.
+     *
+     * mutex_ serializes writers, the WAL and checkpoints. index_mutex_ guards the index, the
+     * delta and the point store: readers hold it shared, and writers (already holding
+     * mutex_) take it exclusively only while applying a mutation or merging a delta batch.
+     */
+    class Collection : public std::enable_shared_from_this<Collection>
+    {
+    public:
+        const std::string name_;
+        const Config& config_;                  // Client-wide WAL, checkpoint and delta knobs
+        Config::CollectionConfig settings_;     // Resolved index type, metric and dimensions
+
+        faiss::Index* index_ = nullptr;
+        std::unique_ptr<faiss::IndexIDMap2> delta_;   // Flat buffer of recent inserts, merged into index_ in the background
+        FaissPointStore points_;                      // External ids and payloads by internal id, mmap'd
+        FaissVectorFile vectors_;                     // DiskIVFPQ only: full-precision vectors by internal id
+        bool disk_vectors_complete_ = false;          // Every vector of the main index is in vectors_
+        bool disk_write_failed_ = false;              // Holds checkpoints back so the WAL can rewrite them
+        std::atomic<faiss::idx_t> next_internal_id_{0};
+
+        // Write-ahead log of the mutations since the last checkpoint
+        std::FILE* wal_ = nullptr;
+        size_t wal_bytes_ = 0;
+        uint64_t wal_seq_ = 0;              // Records appended
+        uint64_t wal_synced_seq_ = 0;       // Records known to be on disk
+        size_t wal_synced_bytes_ = 0;       // Bytes of the WAL known to be on disk
+        std::condition_variable wal_synced_cv_;
+        std::chrono::steady_clock::time_point last_checkpoint_;
+
+        // Change stream for replicas: a position is a byte offset into the WAL records written
+        // since this load, across checkpoints. A checkpoint renames the WAL to .wal.prev
+        // instead of emptying it, so a replica can lag by up to one checkpoint interval.
+        std::string epoch_;                 // Random per load; positions of another load are refused
+        uint64_t wal_base_ = 0;             // Position of the first byte of the current WAL
+        uint64_t prev_wal_base_ = 0;        // Position of the first byte of .wal.prev, which ends at wal_base_
+        bool prev_wal_valid_ = false;
+
+        std::mutex mutex_;
+        std::shared_mutex index_mutex_;
+        std::atomic<bool> loaded_{false};
+        bool detached_ = false;             // Dropped from the registry; never loaded again
+
+        // Index lifecycle: the main index starts Flat and is rebuilt into the target type
+        std::string builtType_ = "Flat";    // Type of index_ as it is now
+        // Deleted or replaced ids whose vectors are still in index_. Searches skip them through
+        // an id selector; a compaction rebuild drops them once they pass tombstoneCompactRatio.
+        std::unordered_set<faiss::idx_t> tombstones_;
+        bool force_checkpoint_ = false;     // The index file predates a rebuild
+        std::atomic<bool> rebuilding_{false};
+        std::atomic<bool> cancel_rebuild_{false};
+        std::vector<faiss::idx_t> removed_during_rebuild_;  // Replayed onto the new index at the swap
+        std::chrono::steady_clock::time_point retry_rebuild_after_{};
+        std::thread rebuild_thread_;
+
+        // Set while the main index is an IVF whose inverted lists are mapped read-only from the
+        // index file. Merges, rebuilds and checkpoints wait until warmMappedIndex() swaps in
+        // an in-memory copy; until then new vectors stay in the delta.
+        std::atomic<bool> main_mapped_{false};
+        std::atomic<bool> stop_warm_{false};
+        std::thread warm_thread_;
+        mutable std::mutex recent_mutex_;
+        mutable std::vector<float> recent_queries_;     // Row-major, at most kRecentQueries rows
+
+#ifdef FAISS_ENABLE_GPU
+        // The main index copied to one or more GPUs. GPU indexes must not be searched from two
+        // threads at once, so every copy has its own mutex.
+        struct GpuMirror
+        {
+            struct Copy
+            {
+                std::vector<std::unique_ptr<faiss::gpu::StandardGpuResources>> resources;  // Outlive the index
+                std::unique_ptr<faiss::Index> index;
+                std::mutex mutex;
+            };
+            std::vector<std::unique_ptr<Copy>> copies;  // One per GPU in replica mode, otherwise one
+            faiss::idx_t ntotal = 0;                    // Leading positions of the main index it holds
+            std::atomic<size_t> next{0};
+
+            // Labels are positions in the main index, not internal ids
+            void search(faiss::idx_t n, const float* queries, faiss::idx_t k, float* distances, faiss::idx_t* labels)
+            {
+                const size_t first = next.fetch_add(1) % copies.size();
+                for (size_t i = 0; i < copies.size(); ++i)
+                {
+                    // Prefer a replica no other query is using
+                    Copy& copy = *copies[(first + i) % copies.size()];
+                    std::unique_lock<std::mutex> lock(copy.mutex, std::try_to_lock);
+                    if (lock.owns_lock())
+                    {
+                        copy.index->search(n, queries, k, distances, labels);
+                        return;
+                    }
+                }
+                Copy& copy = *copies[first];
+                std::lock_guard<std::mutex> lock(copy.mutex);
+                copy.index->search(n, queries, k, distances, labels);
+            }
+        };
+        // Both guarded by index_mutex_. gpu_lag_ collects the vectors merged into the main index
+        // since the copy was taken, so the mirror and the lag together cover all of it.
+        std::unique_ptr<GpuMirror> gpu_mirror_;
+        std::unique_ptr<faiss::IndexIDMap2> gpu_lag_;
+        uint64_t gpu_generation_ = 0;       // Bumped whenever the main index is replaced or freed
+        std::atomic<bool> gpu_syncing_{false};
+        std::chrono::steady_clock::time_point retry_gpu_after_{};
+        std::thread gpu_sync_thread_;
+#endif
+
+        // Admits every id that is not tombstoned
+        struct TombstoneSelector : faiss::IDSelector
+        {
+            const std::unordered_set<faiss::idx_t>& tombstones;
+
+            explicit TombstoneSelector(const std::unordered_set<faiss::idx_t>& dead) : tombstones(dead) {}
+
+            bool is_member(faiss::idx_t id) const override
+            {
+                return tombstones.count(id) == 0;
+            }
+        };
+
+        Collection(std::string name, const Config& config)
+            : name_(std::move(name)), config_(config)
+        {
+        }
+
+        ~Collection()
+        {
+            if (rebuild_thread_.joinable())
+            {
+                rebuild_thread_.detach();
+            }
+            if (warm_thread_.joinable())
+            {
+                warm_thread_.detach();
+            }
+#ifdef FAISS_ENABLE_GPU
+            if (gpu_sync_thread_.joinable())
+            {
+                gpu_sync_thread_.detach();
+            }
+#endif
+            if (wal_)
+            {
+                std::fclose(wal_);
+            }
+            delete index_;
+        }
+
+        std::filesystem::path indexFile() const
+        {
+            return std::filesystem::path(config_.indexPath) / (name_ + ".faiss");
+        }
+
+        std::filesystem::path metadataFile() const
+        {
+            return std::filesystem::path(config_.indexPath) / (name_ + "_metadata.json");
+        }
+
+        std::filesystem::path pointsFile() const
+        {
+            return std::filesystem::path(config_.indexPath) / (name_ + ".points");
+        }
+
+        std::filesystem::path vectorsFile() const
+        {
+            return std::filesystem::path(config_.indexPath) / (name_ + ".vectors");
+        }
+
+        std::filesystem::path walPath() const
+        {
+            return std::filesystem::path(config_.indexPath) / (name_ + ".wal");
+        }
+
+        std::filesystem::path prevWalPath() const
+        {
+            return std::filesystem::path(config_.indexPath) / (name_ + ".wal.prev");
+        }
+
+        bool existsOnDisk() const
+        {
+            return std::filesystem::exists(indexFile()) || std::filesystem::exists(walPath());
+        }
+
+        bool normalizes() const
+        {
+            return config_.normalizeVectors && settings_.metricType == "IP";
+        }
+
+        void normalize(float* vector, size_t dims) const
+        {
+            // Normalize vector for cosine similarity using inner product
+            vecmath::normalize(vector, dims);
+        }
+
+        static bool isKnownType(const std::string& type)
+        {
+            return type == "Flat" || type == "IVF" || type == "IVFPQ" || type == "HNSW" || type == "HNSWSQ8" ||
+                   type == "DiskIVFPQ" || type == "SQ8" || type == "SQfp16" || type == "IVFSQ8" || type == "IVFSQfp16";
+        }
+
+        // Types whose main index holds compressed codes instead of the float vectors
+        static bool isQuantizedType(const std::string& type)
+        {
+            return type == "IVFPQ" || type == "HNSWSQ8" || type == "DiskIVFPQ" || type == "SQ8" || type == "SQfp16" ||
+                   type == "IVFSQ8" || type == "IVFSQfp16";
+        }
+
+        static bool isHnswType(const std::string& type)
+        {
+            return type.rfind("HNSW", 0) == 0;
+        }
+
+        static bool isIvfType(const std::string& type)
+        {
+            return type.rfind("IVF", 0) == 0;
+        }
+
+        // Largest PQ sub-quantizer count that divides the dimension
+        static int pqSubquantizers(int dims)
+        {
+            for (int m : {64, 48, 32, 24, 16, 12, 8, 4, 2})
+            {
+                if (dims % m == 0)
+                {
+                    return m;
+                }
+            }
+            return 1;
+        }
+
+        static std::string factoryString(const std::string& type, int dims, int nlist)
+        {
+            if (type == "IVF") return "IVF" + std::to_string(nlist) + ",Flat";
+            if (type == "IVFPQ") return "IVF" + std::to_string(nlist) + ",PQ" + std::to_string(pqSubquantizers(dims));
+            if (type == "HNSW") return "HNSW32";
+            if (type == "HNSWSQ8") return "HNSW32,SQ8";
+            if (type == "SQ8" || type == "SQfp16") return type;
+            if (type == "IVFSQ8") return "IVF" + std::to_string(nlist) + ",SQ8";
+            if (type == "IVFSQfp16") return "IVF" + std::to_string(nlist) + ",SQfp16";
+            return "Flat";
+        }
+
+        // Approximate memory of an index: codes, ids, graph links and coarse quantizers. Index
+        // types without a case here are counted like a Flat index of the same size.
+        static size_t indexBytes(const faiss::Index* index)
+        {
+            if (!index)
+                return 0;
+            if (const auto* map2 = dynamic_cast<const faiss::IndexIDMap2*>(index))
+                return indexBytes(map2->index) + map2->id_map.size() * sizeof(faiss::idx_t) +
+                       map2->rev_map.size() * (2 * sizeof(faiss::idx_t) + 2 * sizeof(void*));
+            if (const auto* map = dynamic_cast<const faiss::IndexIDMap*>(index))
+                return indexBytes(map->index) + map->id_map.size() * sizeof(faiss::idx_t);
+            if (const auto* ivf = dynamic_cast<const faiss::IndexIVF*>(index))
+            {
+                size_t bytes = indexBytes(ivf->quantizer);
+                if (const auto* ivfpq = dynamic_cast<const faiss::IndexIVFPQ*>(index))
+                    bytes += ivfpq->pq.centroids.size() * sizeof(float);
+                for (size_t list = 0; ivf->invlists && list < ivf->invlists->nlist; ++list)
+                    bytes += ivf->invlists->list_size(list) * (ivf->invlists->code_size + sizeof(faiss::idx_t));
+                return bytes;
+            }
+            if (const auto* hnsw = dynamic_cast<const faiss::IndexHNSW*>(index))
+                return indexBytes(hnsw->storage) + hnsw->hnsw.neighbors.size() * sizeof(faiss::HNSW::storage_idx_t) +
+                       hnsw->hnsw.offsets.size() * sizeof(size_t) + hnsw->hnsw.levels.size() * sizeof(int);
+            if (const auto* codes = dynamic_cast<const faiss::IndexFlatCodes*>(index))
+                return codes->codes.size();
+            return static_cast<size_t>(index->ntotal) * index->d * sizeof(float);
+        }
+
+        // Memory held for /debug/memory; an unloaded collection reports only its name
+        nlohmann::json memoryUsage()
+        {
+            nlohmann::json usage = {{"name", name_}, {"loaded", false}};
+            std::shared_lock<std::shared_mutex> read(index_mutex_);
+            if (!loaded_ || !index_)
+                return usage;
+            size_t payload_mapped = 0;
+            const size_t payload_heap = points_.memoryUsage(payload_mapped);
+            usage["loaded"] = true;
+            usage["index_type"] = builtType_;
+            usage["vectors"] = index_->ntotal;
+            usage["index_bytes"] = indexBytes(index_);
+            usage["index_mapped"] = main_mapped_.load();    // Inverted lists are file pages, not heap
+            usage["delta_vectors"] = delta_ ? delta_->ntotal : 0;
+            usage["delta_bytes"] = indexBytes(delta_.get());
+            usage["tombstones"] = tombstones_.size();
+            usage["points"] = points_.size();
+            usage["payload_heap_bytes"] = payload_heap;
+            usage["payload_mapped_bytes"] = payload_mapped;
+            usage["text_dictionary_bytes"] = points_.dictionaryBytes();
+            return usage;
+        }
+
+        std::string targetType() const
+        {
+            return settings_.indexType == "Auto" ? config_.autoIndexType : settings_.indexType;
+        }
+
+        // DiskIVFPQ routes through an in-memory IVFPQ index and keeps the exact vectors on disk;
+        // with exactRerank every quantized type does
+        bool diskTier() const
+        {
+            const std::string target = targetType();
+            return target == "DiskIVFPQ" || (config_.exactRerank && isQuantizedType(target));
+        }
+
+        bool reranksFromDisk() const
+        {
+            return isQuantizedType(builtType_) && vectors_.isOpen() && disk_vectors_complete_ && !disk_write_failed_;
+        }
+
+        // Live vectors at which the Flat main index is replaced by the target type
+        size_t buildThreshold() const
+        {
+            if (settings_.indexType == "Auto")
+            {
+                return static_cast<size_t>(std::max(config_.autoIndexThreshold, 1));
+            }
+            const std::string target = targetType();
+            if (isIvfType(target) || target == "DiskIVFPQ")
+            {
+                // FAISS wants at least 39 training points per inverted list
+                return static_cast<size_t>(std::max(settings_.nlist, 1)) * 39;
+            }
+            return 1000;
+        }
+
+        faiss::Index* mainInner() const
+        {
+            auto* id_map = dynamic_cast<faiss::IndexIDMap*>(index_);
+            return id_map ? id_map->index : index_;
+        }
+
+        void describeMainLocked()
+        {
+            faiss::Index* inner = mainInner();
+            if (dynamic_cast<faiss::IndexIVFPQ*>(inner)) builtType_ = "IVFPQ";
+            else if (auto* ivfsq = dynamic_cast<faiss::IndexIVFScalarQuantizer*>(inner))
+                builtType_ = ivfsq->sq.qtype == faiss::ScalarQuantizer::QT_fp16 ? "IVFSQfp16" : "IVFSQ8";
+            else if (dynamic_cast<faiss::IndexIVF*>(inner)) builtType_ = "IVF";
+            else if (dynamic_cast<faiss::IndexHNSWSQ*>(inner)) builtType_ = "HNSWSQ8";
+            else if (dynamic_cast<faiss::IndexHNSW*>(inner)) builtType_ = "HNSW";
+            else if (auto* sq = dynamic_cast<faiss::IndexScalarQuantizer*>(inner))
+                builtType_ = sq->sq.qtype == faiss::ScalarQuantizer::QT_fp16 ? "SQfp16" : "SQ8";
+            else builtType_ = "Flat";
+        }
+
+        void applySearchDefaults()
+        {
+            faiss::Index* inner = mainInner();
+            if (auto* ivf = dynamic_cast<faiss::IndexIVF*>(inner); ivf && settings_.nprobe > 0)
+            {
+                ivf->nprobe = static_cast<size_t>(settings_.nprobe);
+            }
+            if (auto* hnsw = dynamic_cast<faiss::IndexHNSW*>(inner); hnsw && settings_.efSearch > 0)
+            {
+                hnsw->hnsw.efSearch = settings_.efSearch;
+            }
+        }
+
+        bool inMainLocked(faiss::idx_t id) const
+        {
+            auto* id_map = dynamic_cast<faiss::IndexIDMap2*>(index_);
+            return id_map && id_map->rev_map.count(id) > 0;
+        }
+
+        bool rebuildActive() const
+        {
+            return rebuilding_ && !cancel_rebuild_;
+        }
+
+        // Deletes never touch the main index: remove_ids is linear in its size (and rewrites
+        // inverted lists) under the exclusive lock, and HNSW cannot remove at all. Internal ids
+        // are never reused, so a tombstoned id cannot come back.
+        void removeFromMainLocked(const std::vector<faiss::idx_t>& ids)
+        {
+            if (rebuildActive())
+            {
+                removed_during_rebuild_.insert(removed_during_rebuild_.end(), ids.begin(), ids.end());
+            }
+            for (faiss::idx_t id : ids)
+            {
+                if (inMainLocked(id))
+                {
+                    tombstones_.insert(id);
+                }
+            }
+        }
+
+        // Tombstones are not persisted; every id in a loaded main index without a live point is one
+        void collectTombstonesLocked()
+        {
+            tombstones_.clear();
+            auto* id_map = dynamic_cast<faiss::IndexIDMap2*>(index_);
+            if (!id_map)
+            {
+                return;
+            }
+            for (faiss::idx_t id : id_map->id_map)
+            {
+                if (!points_.contains(id))
+                {
+                    tombstones_.insert(id);
+                }
+            }
+        }
+
+        // Loads the checkpoint and replays the WAL, or creates an empty index from the
+        // requested settings. A fresh index is checkpointed at once so its settings persist.
+        FaissResult loadLocked(const Config::CollectionConfig& requested)
+        {
             FaissResult result;
             result.success = false;
-            
-#ifndef USE_FAISS
-            result.error_message = "FAISS support not compiled in";
-            return result;
-#else
+            bool fresh = false;
             try
             {
-                current_collection_ = collection_name;
-                
+                // Readers wait while the collection loads
+                std::unique_lock<std::shared_mutex> write(index_mutex_);
+
                 // Create index directory if it doesn't exist
                 std::filesystem::path index_dir = config_.indexPath;
                 if (!std::filesystem::exists(index_dir))
                 {
                     std::filesystem::create_directories(index_dir);
                 }
-                
-                std::filesystem::path index_file = index_dir / (collection_name + ".faiss");
-                std::filesystem::path metadata_file = index_dir / (collection_name + "_metadata.json");
-                
+
+                const auto index_file = indexFile();
+                const auto metadata_file = metadataFile();
+                settings_ = requested;
+                points_.setTextCompression(settings_.textCompression == "dict");
+
                 // Try to load existing index
                 if (std::filesystem::exists(index_file))
                 {
-                    index_ = faiss::read_index(index_file.string().c_str());
-                    // Ensure the index supports add_with_ids by wrapping with ID map if needed
-                    if (dynamic_cast<faiss::IndexIDMap*>(index_) == nullptr &&
-                        dynamic_cast<faiss::IndexIDMap2*>(index_) == nullptr)
+                    index_ = readIndexFile(config_.mmapIndex);
+
+                    // Older versions wrote IVF indexes that were never trained; start those over as Flat
+                    if (!mainInner()->is_trained && index_->ntotal == 0)
                     {
-                        index_ = new faiss::IndexIDMap2(index_);
+                        KOLOSAL_LOG_WARNING("FAISS index %s was never trained, starting it over as Flat",
+                                                 index_file.string().c_str());
+                        delete index_;
+                        auto* flat = new faiss::IndexIDMap2(new faiss::IndexFlat(settings_.dimensions,
+                            settings_.metricType == "L2" ? faiss::METRIC_L2 : faiss::METRIC_INNER_PRODUCT));
+                        flat->own_fields = true;
+                        index_ = flat;
                     }
-                    
+                    describeMainLocked();
+                    main_mapped_ = mapsInvertedLists();
+
+                    // The index file decides the shape; older checkpoints carry no settings
+                    settings_.dimensions = static_cast<int>(index_->d);
+                    settings_.metricType = index_->metric_type == faiss::METRIC_L2 ? "L2" : "IP";
+
                     // Load metadata
                     if (std::filesystem::exists(metadata_file))
                     {
                         std::ifstream metadata_stream(metadata_file);
                         nlohmann::json metadata;
                         metadata_stream >> metadata;
-                        
-                        // Restore ID mappings
-                        if (metadata.contains("id_mappings"))
-                        {
-                            for (const auto& item : metadata["id_mappings"].items())
-                            {
-                                std::string external_id = item.key();
-                                faiss::idx_t internal_id = item.value().get<faiss::idx_t>();
-                                id_to_internal_id_[external_id] = std::to_string(internal_id);
-                                internal_id_to_id_[internal_id] = external_id;
-                            }
-                        }
-                        
-                        // Restore payloads
-                        if (metadata.contains("payloads"))
+
+                        if (metadata.contains("settings"))
                         {
-                            for (const auto& item : metadata["payloads"].items())
-                            {
-                                std::string external_id = item.key();
-                                payloads_[external_id] = item.value();
-                            }
+                            const auto& saved = metadata["settings"];
+                            settings_.indexType = saved.value("index_type", settings_.indexType);
+                            settings_.nlist = saved.value("nlist", settings_.nlist);
+                            // Values tuned by the last rebuild win over the configured defaults
+                            settings_.nprobe = saved.value("nprobe", settings_.nprobe);
+                            settings_.efSearch = saved.value("ef_search", settings_.efSearch);
                         }
-                        
+
                         if (metadata.contains("next_id"))
                         {
                             next_internal_id_ = metadata["next_id"].get<faiss::idx_t>();
                         }
-                    }
-                    
-                    ServerLogger::logInfo("Loaded existing FAISS index: %s", index_file.string().c_str());
-                }
-                else
-                {
-                    // Create new index
-                    if (config_.indexType == "Flat")
-                    {
-                        if (config_.metricType == "L2")
-                        {
-                            index_ = new faiss::IndexFlatL2(dimensions);
-                        }
-                        else // IP (Inner Product)
+
+                        // Older checkpoints kept ids and payloads in the metadata JSON; move them
+                        // into the point store, which the next checkpoint writes out
+                        if (metadata.contains("id_mappings") && !std::filesystem::exists(pointsFile()))
                         {
-                            index_ = new faiss::IndexFlatIP(dimensions);
+                            const auto& payloads = metadata.contains("payloads") ? metadata["payloads"] : nlohmann::json::object();
+                            for (const auto& item : metadata["id_mappings"].items())
+                            {
+                                FaissPointStore::Payload payload;
+                                auto payload_it = payloads.find(item.key());
+                                if (payload_it != payloads.end())
+                                {
+                                    payload = payload_it->get<FaissPointStore::Payload>();
+                                }
+                                points_.put(item.key(), item.value().get<faiss::idx_t>(), payload);
+                            }
+                            force_checkpoint_ = true;
+                            KOLOSAL_LOG_INFO("Migrating %zu FAISS points of collection '%s' to %s",
+                                                  points_.size(), name_.c_str(), pointsFile().string().c_str());
                         }
-                        // Wrap with ID map to support add_with_ids
-                        index_ = new faiss::IndexIDMap2(index_);
                     }
-                    else if (config_.indexType == "IVF")
+
+                    std::string points_error;
+                    if (!force_checkpoint_ && !points_.open(pointsFile(), points_error))
                     {
-                        faiss::Index* quantizer;
-                        if (config_.metricType == "L2")
-                        {
-                            quantizer = new faiss::IndexFlatL2(dimensions);
-                            index_ = new faiss::IndexIVFFlat(quantizer, dimensions, config_.nlist);
-                        }
-                        else
-                        {
-                            quantizer = new faiss::IndexFlatIP(dimensions);
-                            index_ = new faiss::IndexIVFFlat(quantizer, dimensions, config_.nlist, faiss::METRIC_INNER_PRODUCT);
-                        }
-                        // Wrap with ID map to support add_with_ids
-                        index_ = new faiss::IndexIDMap2(index_);
+                        delete index_;
+                        index_ = nullptr;
+                        result.error_message = "Failed to load FAISS points: " + points_error;
+                        return result;
                     }
-                    else
+
+                    KOLOSAL_LOG_INFO("Loaded existing FAISS index: %s", index_file.string().c_str());
+                }
+                else
+                {
+                    if (settings_.indexType != "Auto" && !isKnownType(settings_.indexType))
                     {
-                        result.error_message = "Unsupported index type: " + config_.indexType;
+                        result.error_message = "Unsupported index type: " + settings_.indexType;
                         return result;
                     }
-                    
-                    ServerLogger::logInfo("Created new FAISS index: %s (%s, %s)", 
-                                          config_.indexType.c_str(), config_.metricType.c_str(), index_file.string().c_str());
+
+                    // Every collection starts Flat; the lifecycle manager trains the target type
+                    // once there are enough vectors for it
+                    points_.close();
+                    const int dimensions = settings_.dimensions;
+                    auto* flat = new faiss::IndexIDMap2(new faiss::IndexFlat(dimensions,
+                        settings_.metricType == "L2" ? faiss::METRIC_L2 : faiss::METRIC_INNER_PRODUCT));
+                    flat->own_fields = true;
+                    index_ = flat;
+                    describeMainLocked();
+                    fresh = true;
+
+                    KOLOSAL_LOG_INFO("Created new FAISS index: %s (%s, %d dims, %s)",
+                                          settings_.indexType.c_str(), settings_.metricType.c_str(), dimensions,
+                                          index_file.string().c_str());
+                }
+                if (diskTier() && !openVectorsLocked(result))
+                {
+                    delete index_;
+                    index_ = nullptr;
+                    return result;
+                }
+                applySearchDefaults();
+
+                // Mutations acknowledged after the last checkpoint live only in the WAL
+                delta_ = makeDeltaIndex();
+                replayWalLocked();
+                if (!main_mapped_)
+                {
+                    mergeDeltaLocked(std::numeric_limits<size_t>::max());
+                }
+                collectTombstonesLocked();
+                if (!openWalLocked())
+                {
+                    result.error_message = "Failed to open FAISS write-ahead log: " + walPath().string();
+                    return result;
+                }
+                wal_synced_bytes_ = wal_bytes_;
+                epoch_ = randomEpoch();
+                wal_base_ = 0;
+                prev_wal_valid_ = false;
+                last_checkpoint_ = std::chrono::steady_clock::now();
+                loaded_ = true;
+                result.success = true;
+            }
+            catch (const std::exception& ex)
+            {
+                result.error_message = "Failed to initialize FAISS index: " + std::string(ex.what());
+                KOLOSAL_LOG_ERROR("FAISS initialization error: %s", ex.what());
+                return result;
+            }
+
+            if (fresh)
+            {
+                auto saved = checkpointLocked();
+                if (!saved.success)
+                {
+                    KOLOSAL_LOG_WARNING("Initial checkpoint of FAISS collection '%s' failed: %s",
+                                             name_.c_str(), saved.error_message.c_str());
+                }
+            }
+            if (main_mapped_)
+            {
+                KOLOSAL_LOG_INFO("Mapped FAISS collection '%s' (%lld vectors); warming it in the background",
+                                      name_.c_str(), static_cast<long long>(index_->ntotal));
+                warm_thread_ = std::thread(&Collection::warmMappedIndex, shared_from_this());
+            }
+            return result;
+        }
+
+        // Opens the vectors file of a disk-tier collection. A collection that only now became
+        // disk-tier gets its vectors copied from a Flat main index; from any other index they
+        // could only be approximated, so its older vectors keep their compressed scores.
+        bool openVectorsLocked(FaissResult& result)
+        {
+            bool created = false;
+            std::string error;
+            if (!vectors_.open(vectorsFile(), static_cast<int>(index_->d), created, error))
+            {
+                result.error_message = "Failed to open FAISS vectors file: " + error;
+                return false;
+            }
+            disk_vectors_complete_ = !created || index_->ntotal == 0;
+            auto* id_map = dynamic_cast<faiss::IndexIDMap*>(index_);
+            if (!disk_vectors_complete_ && builtType_ == "Flat" && id_map)
+            {
+                constexpr faiss::idx_t kChunk = 8192;
+                std::vector<float> chunk;
+                for (faiss::idx_t begin = 0; begin < index_->ntotal; begin += kChunk)
+                {
+                    const faiss::idx_t count = std::min(kChunk, index_->ntotal - begin);
+                    chunk.resize(static_cast<size_t>(count * index_->d));
+                    id_map->index->reconstruct_n(begin, count, chunk.data());
+                    if (!vectors_.write(id_map->id_map.data() + begin, chunk.data(), static_cast<size_t>(count), error))
+                    {
+                        result.error_message = "Failed to write FAISS vectors file: " + error;
+                        return false;
+                    }
+                }
+                disk_vectors_complete_ = true;
+            }
+            else if (!disk_vectors_complete_)
+            {
+                KOLOSAL_LOG_WARNING("FAISS collection '%s' started keeping its vectors on disk after it was built as %s; "
+                                         "its search scores stay approximate until its points are written again",
+                                         name_.c_str(), builtType_.c_str());
+            }
+            return true;
+        }
+
+        // Reads the index file, with the inverted lists of an IVF index mapped instead of read
+        // when asked to. The main index is always wrapped in an id map for add_with_ids.
+        faiss::Index* readIndexFile(bool mapped) const
+        {
+            int flags = 0;
+#ifndef _WIN32
+            if (mapped)
+            {
+                flags = faiss::IO_FLAG_MMAP;
+            }
+#endif
+            faiss::Index* index = faiss::read_index(indexFile().string().c_str(), flags);
+            if (dynamic_cast<faiss::IndexIDMap*>(index) == nullptr &&
+                dynamic_cast<faiss::IndexIDMap2*>(index) == nullptr)
+            {
+                auto* wrapped = new faiss::IndexIDMap2(index);
+                wrapped->own_fields = true;
+                index = wrapped;
+            }
+            return index;
+        }
+
+        bool mapsInvertedLists() const
+        {
+            auto* ivf = dynamic_cast<faiss::IndexIVF*>(mainInner());
+            return ivf && dynamic_cast<faiss::OnDiskInvertedLists*>(ivf->invlists) != nullptr;
+        }
+
+        // Keeps the latest queries against a mapped index, so the warm-up faults in the
+        // lists they probe before the rest
+        void rememberQueries(const std::vector<float>& queries, size_t dims) const
+        {
+            std::lock_guard<std::mutex> lock(recent_mutex_);
+            recent_queries_.insert(recent_queries_.end(), queries.begin(), queries.end());
+            const size_t limit = kRecentQueries * dims;
+            if (recent_queries_.size() > limit)
+            {
+                recent_queries_.erase(recent_queries_.begin(), recent_queries_.end() - static_cast<std::ptrdiff_t>(limit));
+            }
+        }
+
+        // Faults the mapped inverted lists in a batch at a time under the shared lock: first the
+        // lists recent queries probe, then the rest from the largest down. Then reads the index
+        // into memory, with the file now in the page cache, and swaps it in.
+        void warmMappedIndex()
+        {
+            const auto started = std::chrono::steady_clock::now();
+            std::vector<size_t> by_size;
+            std::vector<char> warmed;
+            size_t nprobe = 1;
+            {
+                std::shared_lock<std::shared_mutex> read(index_mutex_);
+                auto* ivf = dynamic_cast<faiss::IndexIVF*>(mainInner());
+                if (!ivf || !main_mapped_)
+                {
+                    return;
+                }
+                by_size.resize(ivf->nlist);
+                for (size_t list = 0; list < ivf->nlist; ++list)
+                {
+                    by_size[list] = list;
+                }
+                std::sort(by_size.begin(), by_size.end(), [ivf](size_t a, size_t b) {
+                    return ivf->invlists->list_size(a) > ivf->invlists->list_size(b);
+                });
+                warmed.assign(ivf->nlist, 0);
+                nprobe = std::max<size_t>(ivf->nprobe, 1);
+            }
+
+            size_t next = 0;    // Position in by_size
+            volatile uint8_t sink = 0;
+            while (!stop_warm_ && next < by_size.size())
+            {
+                std::vector<float> recent;
+                {
+                    std::lock_guard<std::mutex> lock(recent_mutex_);
+                    recent.swap(recent_queries_);
+                }
+
+                std::shared_lock<std::shared_mutex> read(index_mutex_);
+                auto* ivf = dynamic_cast<faiss::IndexIVF*>(mainInner());
+                if (!ivf || !main_mapped_)
+                {
+                    return;
+                }
+                std::vector<size_t> batch;
+                const faiss::idx_t m = static_cast<faiss::idx_t>(recent.size() / static_cast<size_t>(ivf->d));
+                if (m > 0)
+                {
+                    const faiss::idx_t probes = static_cast<faiss::idx_t>(std::min(nprobe, ivf->nlist));
+                    std::vector<faiss::idx_t> lists(static_cast<size_t>(m * probes));
+                    std::vector<float> distances(lists.size());
+                    ivf->quantizer->search(m, recent.data(), probes, distances.data(), lists.data());
+                    for (faiss::idx_t list : lists)
+                    {
+                        if (list >= 0 && !warmed[static_cast<size_t>(list)])
+                        {
+                            warmed[static_cast<size_t>(list)] = 1;
+                            batch.push_back(static_cast<size_t>(list));
+                        }
+                    }
+                }
+                while (batch.size() < kWarmBatchLists && next < by_size.size())
+                {
+                    const size_t list = by_size[next++];
+                    if (!warmed[list])
+                    {
+                        warmed[list] = 1;
+                        batch.push_back(list);
+                    }
+                }
+
+                // Reading one byte per page is enough to fault the list's codes and ids in
+                constexpr size_t kPage = 4096;
+                for (size_t list : batch)
+                {
+                    const size_t count = ivf->invlists->list_size(list);
+                    faiss::InvertedLists::ScopedCodes codes(ivf->invlists, list);
+                    faiss::InvertedLists::ScopedIds ids(ivf->invlists, list);
+                    const size_t code_bytes = count * ivf->invlists->code_size;
+                    const auto* id_bytes = reinterpret_cast<const uint8_t*>(ids.get());
+                    for (size_t offset = 0; offset < code_bytes; offset += kPage)
+                    {
+                        sink = sink + codes.get()[offset];
+                    }
+                    for (size_t offset = 0; offset < count * sizeof(faiss::idx_t); offset += kPage)
+                    {
+                        sink = sink + id_bytes[offset];
+                    }
+                }
+            }
+            if (stop_warm_)
+            {
+                return;
+            }
+
+            // Nothing writes the main index or the file while it is mapped
+            std::unique_ptr<faiss::Index> loaded;
+            try
+            {
+                loaded.reset(readIndexFile(false));
+            }
+            catch (const std::exception& ex)
+            {
+                KOLOSAL_LOG_ERROR("Reading FAISS collection '%s' into memory failed, it stays mapped and read-only: %s",
+                                       name_.c_str(), ex.what());
+                return;
+            }
+
+            std::unique_ptr<faiss::Index> mapped;   // Unmapped after the locks are released
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (detached_ || !loaded_ || !main_mapped_)
+                {
+                    return;
+                }
+                std::unique_lock<std::shared_mutex> write(index_mutex_);
+                mapped.reset(index_);
+                index_ = loaded.release();
+                applySearchDefaults();
+                main_mapped_ = false;
+            }
+            {
+                std::lock_guard<std::mutex> lock(recent_mutex_);
+                recent_queries_.clear();
+                recent_queries_.shrink_to_fit();
+            }
+            const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started);
+            KOLOSAL_LOG_INFO("FAISS collection '%s' is in memory after %lld ms; merges and checkpoints resume",
+                                  name_.c_str(), static_cast<long long>(elapsed.count()));
+        }
+
+        // Lets a running rebuild finish training and discards its result. Called without mutex_
+        // before unloading, since the rebuild takes mutex_ for its swap.
+        void stopRebuild()
+        {
+            std::thread rebuild;
+            std::thread warm;
+            std::thread gpu_sync;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                detached_ = true;
+                cancel_rebuild_ = true;
+                stop_warm_ = true;
+                rebuild = std::move(rebuild_thread_);
+                warm = std::move(warm_thread_);
+#ifdef FAISS_ENABLE_GPU
+                gpu_sync = std::move(gpu_sync_thread_);
+#endif
+            }
+            if (rebuild.joinable())
+            {
+                rebuild.join();
+            }
+            if (warm.joinable())
+            {
+                warm.join();
+            }
+            if (gpu_sync.joinable())
+            {
+                gpu_sync.join();
+            }
+        }
+
+        // Checkpoints and frees the index; the collection is never reused afterwards
+        void unloadLocked()
+        {
+            detached_ = true;
+            cancel_rebuild_ = true;
+            stop_warm_ = true;
+            if (!loaded_)
+            {
+                return;
+            }
+            if (wal_bytes_ > 0 && !main_mapped_)    // A mapped index cannot be written; its WAL is replayed next time
+            {
+                auto saved = checkpointLocked();
+                if (!saved.success)
+                {
+                    KOLOSAL_LOG_WARNING("Final checkpoint of FAISS collection '%s' failed, the WAL will be replayed on next load: %s",
+                                             name_.c_str(), saved.error_message.c_str());
+                }
+            }
+            closeWalLocked();
+
+            std::unique_lock<std::shared_mutex> write(index_mutex_);
+            vectors_.close();
+            dropGpuMirrorLocked();
+            delete index_;
+            index_ = nullptr;
+            delta_.reset();
+            points_.close();
+            loaded_ = false;
+        }
+
+        bool openWalLocked()
+        {
+            wal_ = std::fopen(walPath().string().c_str(), "ab");
+            return wal_ != nullptr;
+        }
+
+        void closeWalLocked()
+        {
+            if (wal_)
+            {
+                syncWalLocked();
+                std::fclose(wal_);
+                wal_ = nullptr;
+                wal_synced_cv_.notify_all();
+            }
+        }
+
+        // Appends one record; the caller applies the mutation only if this succeeds
+        bool appendWalLocked(const std::string& payload)
+        {
+            if (!wal_)
+            {
+                return false;
+            }
+            std::string record;
+            record.reserve(kWalHeaderBytes + payload.size());
+            putValue<uint32_t>(record, static_cast<uint32_t>(payload.size()));
+            putValue<uint32_t>(record, static_cast<uint32_t>(
+                crc32(0L, reinterpret_cast<const Bytef*>(payload.data()), static_cast<uInt>(payload.size()))));
+            record.append(payload);
+            if (std::fwrite(record.data(), 1, record.size(), wal_) != record.size() || std::fflush(wal_) != 0)
+            {
+                // Cut off the partial record so later appends stay replayable
+                std::fclose(wal_);
+                std::error_code ec;
+                std::filesystem::resize_file(walPath(), wal_bytes_, ec);
+                wal_ = std::fopen(walPath().string().c_str(), "ab");
+                return false;
+            }
+            wal_bytes_ += record.size();
+            ++wal_seq_;
+            return true;
+        }
+
+        void syncWalLocked()
+        {
+            if (!wal_ || wal_synced_seq_ == wal_seq_)
+            {
+                return;
+            }
+            if (!syncFileHandle(wal_))
+            {
+                KOLOSAL_LOG_WARNING("fsync of FAISS write-ahead log failed");
+            }
+            wal_synced_seq_ = wal_seq_;
+            wal_synced_bytes_ = wal_bytes_;
+            wal_synced_cv_.notify_all();
+        }
+
+        // Blocks until the record numbered seq is on disk; concurrent writers share one fsync
+        void waitForWalLocked(std::unique_lock<std::mutex>& lock, uint64_t seq)
+        {
+            if (config_.walSyncMs <= 0)
+            {
+                syncWalLocked();
+                return;
+            }
+            wal_synced_cv_.wait(lock, [this, seq] { return wal_synced_seq_ >= seq || !wal_; });
+        }
+
+        static std::string encodeUpsert(const std::vector<WalPoint>& points)
+        {
+            std::string out;
+            putValue<uint8_t>(out, kWalUpsert);
+            putValue<uint32_t>(out, static_cast<uint32_t>(points.size()));
+            for (const auto& point : points)
+            {
+                putString(out, point.id);
+                putValue<int64_t>(out, point.internal_id);
+                putValue<uint32_t>(out, static_cast<uint32_t>(point.vector.size()));
+                out.append(reinterpret_cast<const char*>(point.vector.data()), point.vector.size() * sizeof(float));
+                putString(out, nlohmann::json(point.payload).dump());
+            }
+            return out;
+        }
+
+        static std::string encodeDelete(const std::vector<std::string>& ids)
+        {
+            std::string out;
+            putValue<uint8_t>(out, kWalDelete);
+            putValue<uint32_t>(out, static_cast<uint32_t>(ids.size()));
+            for (const auto& id : ids)
+            {
+                putString(out, id);
+            }
+            return out;
+        }
+
+        std::unique_ptr<faiss::IndexIDMap2> makeDeltaIndex() const
+        {
+            auto delta = std::make_unique<faiss::IndexIDMap2>(new faiss::IndexFlat(index_->d, index_->metric_type));
+            delta->own_fields = true;
+            return delta;
+        }
+
+        size_t mergeBatchSize() const
+        {
+            return static_cast<size_t>(std::max(config_.deltaMergePoints, 1));
+        }
+
+        // Moves up to max_points of the oldest buffered vectors into the main index. The caller
+        // holds index_mutex_ exclusively, so a point is never visible in both or neither.
+        size_t mergeDeltaLocked(size_t max_points)
+        {
+            const faiss::idx_t n = static_cast<faiss::idx_t>(
+                std::min(static_cast<size_t>(delta_->ntotal), max_points));
+            if (n <= 0)
+            {
+                return 0;
+            }
+            std::vector<float> vectors(static_cast<size_t>(n) * static_cast<size_t>(delta_->d));
+            delta_->index->reconstruct_n(0, n, vectors.data());
+            std::vector<faiss::idx_t> ids(delta_->id_map.begin(), delta_->id_map.begin() + n);
+            index_->add_with_ids(n, vectors.data(), ids.data());
+            if (vectors_.isOpen())
+            {
+                std::string error;
+                if (!vectors_.write(ids.data(), vectors.data(), static_cast<size_t>(n), error))
+                {
+                    KOLOSAL_LOG_ERROR("FAISS collection '%s': %s; keeping the WAL until the next load",
+                                           name_.c_str(), error.c_str());
+                    disk_write_failed_ = true;
+                }
+            }
+#ifdef FAISS_ENABLE_GPU
+            if (gpu_lag_)
+            {
+                gpu_lag_->add_with_ids(n, vectors.data(), ids.data());  // Searched on the CPU until the next copy
+            }
+#endif
+            if (n == delta_->ntotal)
+            {
+                delta_->reset();
+                delta_->rev_map.clear();
+            }
+            else
+            {
+                delta_->remove_ids(faiss::IDSelectorBatch(ids.size(), ids.data()));
+            }
+            return static_cast<size_t>(n);
+        }
+
+        // Merges whole batches, releasing index_mutex_ in between so searches interleave. Paused
+        // while a rebuild runs: the new index is filled from a snapshot of the main one.
+        void mergeDeltaBatches(size_t min_points)
+        {
+            while (delta_ && !rebuildActive() && !main_mapped_ && static_cast<size_t>(delta_->ntotal) >= std::max<size_t>(min_points, 1))
+            {
+                std::unique_lock<std::shared_mutex> write(index_mutex_);
+                mergeDeltaLocked(mergeBatchSize());
+            }
+        }
+
+        // Replaces any previous vector of each point. On replay the internal ids themselves are
+        // removed first too, since a checkpoint may already hold them; that keeps replay idempotent.
+        // New vectors go to the delta index; the caller holds index_mutex_ exclusively.
+        void applyUpsertLocked(const std::vector<WalPoint>& points, bool replay)
+        {
+            std::vector<faiss::idx_t> stale;
+            std::vector<float> vectors;
+            std::vector<faiss::idx_t> ids;
+            vectors.reserve(points.size() * static_cast<size_t>(index_->d));
+            for (const auto& point : points)
+            {
+                // The main index keeps its checkpointed copy on replay
+                const bool checkpointed = replay && inMainLocked(point.internal_id);
+                int64_t previous;
+                if (points_.find(point.id, previous))
+                {
+                    if (previous != point.internal_id)
+                    {
+                        stale.push_back(previous);
+                    }
+                    else if (!checkpointed)
+                    {
+                        stale.push_back(previous);
+                    }
+                }
+                else if (replay && !checkpointed)
+                {
+                    stale.push_back(point.internal_id);
+                }
+                if (checkpointed)
+                {
+                    continue;
+                }
+                vectors.insert(vectors.end(), point.vector.begin(), point.vector.end());
+                ids.push_back(point.internal_id);
+            }
+
+            if (!stale.empty())
+            {
+                removeFromMainLocked(stale);
+                delta_->remove_ids(faiss::IDSelectorBatch(stale.size(), stale.data()));
+            }
+            if (!ids.empty())
+            {
+                delta_->add_with_ids(static_cast<faiss::idx_t>(ids.size()), vectors.data(), ids.data());
+            }
+
+            for (const auto& point : points)
+            {
+                points_.put(point.id, point.internal_id, point.payload);
+                if (point.internal_id >= next_internal_id_)
+                {
+                    next_internal_id_ = point.internal_id + 1;
+                }
+            }
+        }
+
+        // The caller holds index_mutex_ exclusively
+        size_t applyDeleteLocked(const std::vector<std::string>& point_ids)
+        {
+            std::vector<faiss::idx_t> ids_to_remove;
+            for (const std::string& point_id : point_ids)
+            {
+                int64_t internal_id;
+                if (points_.erase(point_id, internal_id))
+                {
+                    ids_to_remove.push_back(internal_id);
+                }
+            }
+            if (!ids_to_remove.empty())
+            {
+                removeFromMainLocked(ids_to_remove);
+                delta_->remove_ids(faiss::IDSelectorBatch(ids_to_remove.size(), ids_to_remove.data()));
+            }
+            return ids_to_remove.size();
+        }
+
+        static bool decodeWalRecord(const char* data, size_t size, WalRecord& record)
+        {
+            WalReader reader{data, data + size};
+            record.op = reader.get<uint8_t>();
+            const uint32_t count = reader.get<uint32_t>();
+            if (!reader.ok)
+            {
+                return false;
+            }
+
+            if (record.op == kWalUpsert)
+            {
+                for (uint32_t i = 0; i < count && reader.ok; ++i)
+                {
+                    WalPoint point;
+                    point.id = reader.getString();
+                    point.internal_id = reader.get<int64_t>();
+                    const uint32_t dims = reader.get<uint32_t>();
+                    if (!reader.ok || static_cast<size_t>(reader.end - reader.pos) < dims * sizeof(float))
+                    {
+                        return false;
+                    }
+                    point.vector.resize(dims);
+                    std::memcpy(point.vector.data(), reader.pos, dims * sizeof(float));
+                    reader.pos += dims * sizeof(float);
+                    auto payload = nlohmann::json::parse(reader.getString(), nullptr, false);
+                    if (!reader.ok || !payload.is_object())
+                    {
+                        return false;
+                    }
+                    point.payload = payload.get<std::unordered_map<std::string, nlohmann::json>>();
+                    record.points.push_back(std::move(point));
+                }
+                return reader.ok;
+            }
+            if (record.op == kWalDelete)
+            {
+                for (uint32_t i = 0; i < count && reader.ok; ++i)
+                {
+                    record.ids.push_back(reader.getString());
+                }
+                return reader.ok;
+            }
+            return false;
+        }
+
+        // Applies a record as replay does: idempotently, keeping the internal ids it names. The
+        // caller holds index_mutex_ exclusively.
+        void applyWalRecordLocked(WalRecord& record)
+        {
+            if (record.op == kWalDelete)
+            {
+                applyDeleteLocked(record.ids);
+                return;
+            }
+            auto mismatched = std::remove_if(record.points.begin(), record.points.end(), [this](const WalPoint& point) {
+                if (static_cast<int>(point.vector.size()) == index_->d)
+                {
+                    return false;
+                }
+                KOLOSAL_LOG_WARNING("Skipping WAL upsert of '%s': %zu dimensions, index has %d",
+                                         point.id.c_str(), point.vector.size(), static_cast<int>(index_->d));
+                return true;
+            });
+            record.points.erase(mismatched, record.points.end());
+            if (!record.points.empty())
+            {
+                applyUpsertLocked(record.points, true);
+            }
+        }
+
+        size_t replayWalLocked()
+        {
+            const auto path = walPath();
+            wal_bytes_ = 0;
+            if (!std::filesystem::exists(path))
+            {
+                return 0;
+            }
+
+            std::ifstream in(path, std::ios::binary);
+            std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+            size_t offset = 0;
+            size_t records = 0;
+            while (offset + kWalHeaderBytes <= data.size())
+            {
+                uint32_t length = 0, checksum = 0;
+                std::memcpy(&length, data.data() + offset, sizeof(length));
+                std::memcpy(&checksum, data.data() + offset + sizeof(length), sizeof(checksum));
+                const char* payload = data.data() + offset + kWalHeaderBytes;
+                WalRecord record;
+                if (length > data.size() - offset - kWalHeaderBytes ||
+                    crc32(0L, reinterpret_cast<const Bytef*>(payload), length) != checksum ||
+                    !decodeWalRecord(payload, length, record))
+                {
+                    break;
+                }
+                applyWalRecordLocked(record);
+                offset += kWalHeaderBytes + length;
+                ++records;
+            }
+            in.close();
+
+            if (offset < data.size())
+            {
+                KOLOSAL_LOG_WARNING("Discarding %zu bytes of incomplete FAISS WAL tail in %s",
+                                         data.size() - offset, path.string().c_str());
+                std::filesystem::resize_file(path, offset);
+            }
+            wal_bytes_ = offset;
+            if (records > 0)
+            {
+                KOLOSAL_LOG_INFO("Replayed %zu FAISS WAL records for collection '%s'", records, name_.c_str());
+            }
+            return records;
+        }
+
+        // Writes the index, points and metadata to temporary files, renames them into place and
+        // empties the WAL. A crash between the renames is safe: replaying the old WAL is idempotent.
+        FaissResult checkpointLocked()
+        {
+            FaissResult result;
+            result.success = false;
+            try
+            {
+                if (!index_)
+                {
+                    result.error_message = "No index to save";
+                    return result;
+                }
+                if (main_mapped_)
+                {
+                    result.error_message = "Index is still mapped from its file";
+                    return result;
+                }
+                if (disk_write_failed_)
+                {
+                    result.error_message = "Vectors file write failed earlier";
+                    return result;
+                }
+
+                std::filesystem::path index_dir = config_.indexPath;
+                std::filesystem::path index_file = indexFile();
+                std::filesystem::path metadata_file = metadataFile();
+                std::filesystem::path points_file = pointsFile();
+                std::filesystem::path index_tmp = index_file.string() + ".tmp";
+                std::filesystem::path metadata_tmp = metadata_file.string() + ".tmp";
+                std::filesystem::path points_tmp = points_file.string() + ".tmp";
+
+                // Only the main index is written, so fold the delta into it first
+                mergeDeltaBatches(1);
+
+                // Writers are held off by mutex_; searches keep running against the shared lock
+                nlohmann::json metadata;
+                {
+                    std::shared_lock<std::shared_mutex> read(index_mutex_);
+
+                    // Save index
+                    faiss::write_index(index_, index_tmp.string().c_str());
+
+                    // Save metadata
+                    metadata["next_id"] = next_internal_id_.load();
+                    metadata["settings"] = {
+                        {"index_type", settings_.indexType},
+                        {"metric_type", settings_.metricType},
+                        {"dimensions", settings_.dimensions},
+                        {"nlist", settings_.nlist},
+                        {"nprobe", settings_.nprobe},
+                        {"ef_search", settings_.efSearch}
+                    };
+
+                    // Save ids and payloads
+                    std::string points_error;
+                    if (!points_.write(points_tmp, points_error))
+                    {
+                        result.error_message = points_error;
+                        return result;
+                    }
+                }
+
+                {
+                    std::ofstream metadata_stream(metadata_tmp);
+                    metadata_stream << metadata.dump();
+                    if (!metadata_stream.flush())
+                    {
+                        result.error_message = "Failed to write " + metadata_tmp.string();
+                        return result;
+                    }
+                }
+                syncPath(index_tmp);
+                syncPath(metadata_tmp);
+                syncPath(points_tmp);
+                {
+                    // The WAL is emptied below, so the vectors it held must be on disk first
+                    std::string vectors_error;
+                    if (!vectors_.sync(vectors_error))
+                    {
+                        result.error_message = vectors_error;
+                        return result;
+                    }
+                }
+                std::filesystem::rename(index_tmp, index_file);
+                {
+                    // Readers may be decoding from the old mapping
+                    std::unique_lock<std::shared_mutex> write(index_mutex_);
+                    std::string points_error;
+                    if (!points_.replace(points_tmp, points_file, points_error))
+                    {
+                        result.error_message = points_error;
+                        return result;
+                    }
+                }
+                std::filesystem::rename(metadata_tmp, metadata_file);
+                syncPath(index_dir, true);
+
+                // Everything in the WAL is now in the checkpoint. It is set aside as .wal.prev rather
+                // than emptied, so replicas reading it and snapshots linking it keep their records.
+                if (wal_)
+                {
+                    std::fclose(wal_);
+                    std::error_code ec;
+                    std::filesystem::rename(walPath(), prevWalPath(), ec);
+                    prev_wal_valid_ = !ec;
+                    prev_wal_base_ = wal_base_;
+                    wal_ = std::fopen(walPath().string().c_str(), "wb");
+                    if (!wal_)
+                    {
+                        KOLOSAL_LOG_ERROR("Failed to reopen FAISS write-ahead log %s", walPath().string().c_str());
+                    }
+                }
+                wal_base_ += wal_bytes_;
+                wal_bytes_ = 0;
+                wal_synced_bytes_ = 0;
+                wal_synced_seq_ = wal_seq_;
+                wal_synced_cv_.notify_all();
+                last_checkpoint_ = std::chrono::steady_clock::now();
+                force_checkpoint_ = false;
+
+                result.success = true;
+                KOLOSAL_LOG_DEBUG("Saved FAISS index and metadata for collection '%s'", name_.c_str());
+            }
+            catch (const std::exception& ex)
+            {
+                result.error_message = "Failed to save FAISS index: " + std::string(ex.what());
+                KOLOSAL_LOG_ERROR("FAISS save error: %s", ex.what());
+            }
+            return result;
+        }
+
+        bool checkpointDueLocked() const
+        {
+            // The delta cannot be folded in until the rebuild swaps or the mapped index is read in,
+            // so the WAL keeps growing
+            if (rebuildActive() || main_mapped_)
+            {
+                return false;
+            }
+            if (force_checkpoint_)
+            {
+                return true;
+            }
+            if (wal_bytes_ == 0)
+            {
+                return false;
+            }
+            if (config_.checkpointWalMB > 0 && wal_bytes_ >= static_cast<size_t>(config_.checkpointWalMB) * 1024 * 1024)
+            {
+                return true;
+            }
+            return config_.checkpointIntervalSec > 0 &&
+                   std::chrono::steady_clock::now() - last_checkpoint_ >= std::chrono::seconds(config_.checkpointIntervalSec);
+        }
+
+        // Starts a rebuild when the Flat main index has outgrown it, or when the main index
+        // holds too many tombstones. The caller holds mutex_.
+        void maybeStartRebuildLocked()
+        {
+            if (rebuilding_ || detached_ || main_mapped_ || !dynamic_cast<faiss::IndexIDMap2*>(index_) ||
+                std::chrono::steady_clock::now() < retry_rebuild_after_)
+            {
+                return;
+            }
+            const std::string target = targetType();
+            std::string type;
+            if (builtType_ == "Flat" && target != "Flat" && isKnownType(target) &&
+                points_.size() >= buildThreshold())
+            {
+                type = target == "DiskIVFPQ" ? "IVFPQ" : target;
+            }
+            else if (tombstones_.size() >= kMinCompactTombstones &&
+                     static_cast<double>(tombstones_.size()) > config_.tombstoneCompactRatio * static_cast<double>(index_->ntotal))
+            {
+                type = builtType_;  // Compact away the tombstoned vectors
+            }
+            if (type.empty())
+            {
+                return;
+            }
+
+            if (rebuild_thread_.joinable())
+            {
+                rebuild_thread_.join();  // The previous rebuild has already swapped and is exiting
+            }
+            rebuilding_ = true;
+            cancel_rebuild_ = false;
+            removed_during_rebuild_.clear();
+            KOLOSAL_LOG_INFO("Rebuilding FAISS collection '%s' as %s (%zu live vectors, %zu tombstoned)",
+                                  name_.c_str(), type.c_str(), points_.size(), tombstones_.size());
+            rebuild_thread_ = std::thread(&Collection::rebuild, shared_from_this(), type);
+        }
+
+        // Copies the vectors of the ids still in the main index; the caller holds index_mutex_
+        size_t copyVectorsLocked(const faiss::idx_t* ids, size_t count, std::vector<faiss::idx_t>& out_ids,
+                                 std::vector<float>& out_vectors) const
+        {
+            auto* id_map = static_cast<faiss::IndexIDMap2*>(index_);
+            const size_t dims = static_cast<size_t>(index_->d);
+            if (vectors_.isOpen() && disk_vectors_complete_ && !disk_write_failed_)
+            {
+                // The vectors file is exact where the main index may only hold PQ codes
+                const size_t first = out_ids.size();
+                for (size_t i = 0; i < count; ++i)
+                {
+                    if (id_map->rev_map.count(ids[i]) && points_.contains(ids[i]))
+                    {
+                        out_ids.push_back(ids[i]);
+                    }
+                }
+                const size_t copied = out_ids.size() - first;
+                out_vectors.resize(out_vectors.size() + copied * dims);
+                if (vectors_.read(out_ids.data() + first, copied, out_vectors.data() + out_vectors.size() - copied * dims))
+                {
+                    return copied;
+                }
+                out_ids.resize(first);
+                out_vectors.resize(out_vectors.size() - copied * dims);
+            }
+            size_t copied = 0;
+            for (size_t i = 0; i < count; ++i)
+            {
+                if (!id_map->rev_map.count(ids[i]) || !points_.contains(ids[i]))
+                {
+                    continue;
+                }
+                out_vectors.resize(out_vectors.size() + dims);
+                id_map->reconstruct(ids[i], out_vectors.data() + out_vectors.size() - dims);
+                out_ids.push_back(ids[i]);
+                ++copied;
+            }
+            return copied;
+        }
+
+        // Trains and fills a new main index from the current one, tunes it to the recall target and
+        // swaps it in. Vectors are copied out in chunks under the shared lock, so searches and
+        // writers keep running; removals made meanwhile are replayed onto the new index at the swap.
+        void rebuild(std::string type)
+        {
+            constexpr size_t kChunk = 8192;
+            constexpr size_t kRecallK = 10;
+            constexpr size_t kRecallQueries = 32;
+            std::unique_ptr<faiss::IndexIDMap2> fresh;
+            int nlist = settings_.nlist;
+            int tuned_nprobe = settings_.nprobe;
+            int tuned_ef = settings_.efSearch;
+            const auto started = std::chrono::steady_clock::now();
+            try
+            {
+                std::vector<faiss::idx_t> ids;
+                int dims = 0;
+                faiss::MetricType metric = faiss::METRIC_INNER_PRODUCT;
+                {
+                    std::shared_lock<std::shared_mutex> read(index_mutex_);
+                    auto* id_map = static_cast<faiss::IndexIDMap2*>(index_);
+                    ids.reserve(id_map->id_map.size());
+                    for (faiss::idx_t id : id_map->id_map)
+                    {
+                        if (points_.contains(id))
+                        {
+                            ids.push_back(id);
+                        }
+                    }
+                    dims = static_cast<int>(index_->d);
+                    metric = index_->metric_type;
+                }
+                const size_t n = ids.size();
+                if (n == 0)
+                {
+                    type = "Flat";  // Nothing left to train on; grow again from scratch
+                }
+
+                if (isIvfType(type))
+                {
+                    if (settings_.indexType == "Auto")
+                    {
+                        nlist = static_cast<int>(4.0 * std::sqrt(static_cast<double>(n)));
+                    }
+                    // Never more lists than the data can train
+                    nlist = std::clamp(nlist, 1, std::max(1, static_cast<int>(n / 39)));
+                }
+                const std::string description = factoryString(type, dims, nlist);
+                auto* inner = faiss::index_factory(dims, description.c_str(), metric);
+                fresh = std::make_unique<faiss::IndexIDMap2>(inner);
+                fresh->own_fields = true;
+
+                // Train on an evenly spaced sample; its first vectors double as recall probes
+                const size_t sample_target = std::min(n, std::clamp<size_t>(static_cast<size_t>(nlist) * 64, 10000, 262144));
+                std::vector<faiss::idx_t> sample_ids;
+                for (size_t i = 0; i < sample_target; ++i)
+                {
+                    sample_ids.push_back(ids[i * n / sample_target]);
+                }
+                std::vector<faiss::idx_t> copied_ids;
+                std::vector<float> sample;
+                {
+                    std::shared_lock<std::shared_mutex> read(index_mutex_);
+                    copyVectorsLocked(sample_ids.data(), sample_ids.size(), copied_ids, sample);
+                }
+                const size_t sampled = copied_ids.size();
+                if (!inner->is_trained)
+                {
+                    inner->train(static_cast<faiss::idx_t>(sampled), sample.data());
+                }
+                // Flat is exact, so only approximate types need recall probes
+                const size_t nq = isIvfType(type) || isHnswType(type) ? std::min(kRecallQueries, sampled) : 0;
+                std::vector<float> probes(sample.begin(), sample.begin() + nq * dims);
+                sample.clear();
+                sample.shrink_to_fit();
+
+                // Fill the new index chunk by chunk, keeping an exact top-k of every probe on the side
+                std::vector<std::vector<std::pair<float, faiss::idx_t>>> truth(nq);
+                for (size_t begin = 0; begin < n && !cancel_rebuild_; begin += kChunk)
+                {
+                    std::vector<faiss::idx_t> chunk_ids;
+                    std::vector<float> chunk;
+                    {
+                        std::shared_lock<std::shared_mutex> read(index_mutex_);
+                        copyVectorsLocked(ids.data() + begin, std::min(kChunk, n - begin), chunk_ids, chunk);
+                    }
+                    if (chunk_ids.empty())
+                    {
+                        continue;
+                    }
+                    fresh->add_with_ids(static_cast<faiss::idx_t>(chunk_ids.size()), chunk.data(), chunk_ids.data());
+
+                    for (size_t q = 0; q < nq; ++q)
+                    {
+                        const float* probe = probes.data() + q * dims;
+                        auto& best = truth[q];
+                        for (size_t row = 0; row < chunk_ids.size(); ++row)
+                        {
+                            const float* vector = chunk.data() + row * dims;
+                            float score = 0.0f;
+                            if (metric == faiss::METRIC_L2)
+                            {
+                                for (int j = 0; j < dims; ++j)
+                                {
+                                    score -= (probe[j] - vector[j]) * (probe[j] - vector[j]);
+                                }
+                            }
+                            else
+                            {
+                                score = vecmath::dot(probe, vector, static_cast<size_t>(dims));
+                            }
+                            best.emplace_back(score, chunk_ids[row]);
+                        }
+                        if (best.size() > kRecallK)
+                        {
+                            std::nth_element(best.begin(), best.begin() + kRecallK, best.end(),
+                                             [](const auto& a, const auto& b) { return a.first > b.first; });
+                            best.resize(kRecallK);
+                        }
+                    }
+                }
+
+                if (!cancel_rebuild_ && nq > 0)
+                {
+                    tuneSearchParams(*fresh, type, nlist, probes, truth, tuned_nprobe, tuned_ef);
+                }
+            }
+            catch (const std::exception& ex)
+            {
+                KOLOSAL_LOG_ERROR("Rebuild of FAISS collection '%s' as %s failed: %s", name_.c_str(), type.c_str(), ex.what());
+                fresh.reset();
+            }
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!fresh)
+            {
+                retry_rebuild_after_ = std::chrono::steady_clock::now() + std::chrono::minutes(5);
+            }
+            if (fresh && !cancel_rebuild_ && loaded_)
+            {
+                std::unique_lock<std::shared_mutex> write(index_mutex_);
+                // Points removed while the copy ran become the new index's only tombstones
+                tombstones_.clear();
+                for (faiss::idx_t id : removed_during_rebuild_)
+                {
+                    if (fresh->rev_map.count(id))
+                    {
+                        tombstones_.insert(id);
+                    }
+                }
+                dropGpuMirrorLocked();
+                delete index_;
+                index_ = fresh.release();
+                builtType_ = type;
+                if (isIvfType(type))
+                {
+                    settings_.nlist = nlist;
+                }
+                settings_.nprobe = tuned_nprobe;
+                settings_.efSearch = tuned_ef;
+                applySearchDefaults();
+                force_checkpoint_ = true;
+
+                const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started);
+                KOLOSAL_LOG_INFO("FAISS collection '%s' now uses %s (%lld vectors, nprobe=%d, efSearch=%d) after %lld ms",
+                                      name_.c_str(), type.c_str(), static_cast<long long>(index_->ntotal),
+                                      tuned_nprobe, tuned_ef, static_cast<long long>(elapsed.count()));
+            }
+            removed_during_rebuild_.clear();
+            rebuilding_ = false;
+        }
+
+        // Picks the smallest nprobe (IVF) or efSearch (HNSW) whose recall@k against the exact
+        // top-k reaches recallTarget, or the largest candidate if none does
+        void tuneSearchParams(const faiss::IndexIDMap2& index, const std::string& type, int nlist,
+                              const std::vector<float>& probes,
+                              const std::vector<std::vector<std::pair<float, faiss::idx_t>>>& truth,
+                              int& nprobe, int& ef_search) const
+        {
+            const faiss::idx_t nq = static_cast<faiss::idx_t>(truth.size());
+            size_t expected = 0;
+            faiss::idx_t k = 0;
+            for (const auto& best : truth)
+            {
+                expected += best.size();
+                k = std::max(k, static_cast<faiss::idx_t>(best.size()));
+            }
+            if (expected == 0)
+            {
+                return;
+            }
+
+            auto recall = [&](const faiss::SearchParameters* params) {
+                std::vector<faiss::idx_t> labels(static_cast<size_t>(nq * k));
+                std::vector<float> distances(static_cast<size_t>(nq * k));
+                index.search(nq, probes.data(), k, distances.data(), labels.data(), params);
+                size_t found = 0;
+                for (faiss::idx_t q = 0; q < nq; ++q)
+                {
+                    for (const auto& entry : truth[q])
+                    {
+                        found += std::count(labels.begin() + q * k, labels.begin() + (q + 1) * k, entry.second) > 0;
+                    }
+                }
+                return static_cast<float>(found) / static_cast<float>(expected);
+            };
+
+            float achieved = 1.0f;
+            if (isIvfType(type))
+            {
+                faiss::SearchParametersIVF params;
+                for (int probe = 1;; probe = std::min(probe * 2, nlist))
+                {
+                    params.nprobe = static_cast<size_t>(probe);
+                    achieved = recall(&params);
+                    nprobe = probe;
+                    if (achieved >= config_.recallTarget || probe >= nlist)
+                    {
+                        break;
+                    }
+                }
+            }
+            else if (isHnswType(type))
+            {
+                faiss::SearchParametersHNSW params;
+                for (int ef = 16; ef <= 1024; ef *= 2)
+                {
+                    params.efSearch = ef;
+                    achieved = recall(&params);
+                    ef_search = ef;
+                    if (achieved >= config_.recallTarget)
+                    {
+                        break;
+                    }
+                }
+            }
+            KOLOSAL_LOG_INFO("Tuned FAISS collection '%s' (%s): recall@%lld %.3f (target %.3f)",
+                                  name_.c_str(), type.c_str(), static_cast<long long>(k), achieved, config_.recallTarget);
+        }
+
+        // Forgets the GPU copy of a main index that is being replaced or freed; a copy still
+        // in flight is discarded at its swap. The caller holds index_mutex_ exclusively.
+        void dropGpuMirrorLocked()
+        {
+#ifdef FAISS_ENABLE_GPU
+            ++gpu_generation_;
+            gpu_mirror_.reset();
+            gpu_lag_.reset();
+#endif
+        }
+
+#ifdef FAISS_ENABLE_GPU
+        // single, shard or replica; empty while the collection is searched on the CPU only.
+        // There are no GPU HNSW indexes, so HNSW collections always are.
+        std::string gpuModeLocked() const
+        {
+            const std::string& mode = settings_.gpuMode;
+            if (!config_.useGPU || (mode != "single" && mode != "shard" && mode != "replica"))
+            {
+                return {};
+            }
+            if (builtType_ != "Flat" && builtType_ != "IVF" && builtType_ != "IVFPQ")
+            {
+                return {};
+            }
+            return mode;
+        }
+
+        std::vector<int> gpuDevicesFor(const std::string& mode) const
+        {
+            const int available = faiss::gpu::getNumDevices();
+            std::vector<int> devices;
+            if (mode == "single")
+            {
+                if (config_.gpuDevice >= 0 && config_.gpuDevice < available)
+                {
+                    devices.push_back(config_.gpuDevice);
+                }
+            }
+            else if (config_.gpuDevices.empty())
+            {
+                for (int device = 0; device < available; ++device)
+                {
+                    devices.push_back(device);
+                }
+            }
+            else
+            {
+                for (int device : config_.gpuDevices)
+                {
+                    if (device >= 0 && device < available)
+                    {
+                        devices.push_back(device);
+                    }
+                }
+            }
+            return devices;
+        }
+
+        // Shard mode splits the vectors across the devices and merges their top-k; replica mode
+        // puts a full copy on each device so concurrent queries spread over them
+        static std::unique_ptr<GpuMirror> copyToGpus(const faiss::Index& snapshot, const std::string& type,
+                                                     const std::string& mode, std::vector<int> devices)
+        {
+            auto makeResources = [] {
+                auto resources = std::make_unique<faiss::gpu::StandardGpuResources>();
+                resources->setTempMemory(size_t(256) << 20);  // The default takes a share of the whole device per copy
+                return resources;
+            };
+
+            auto mirror = std::make_unique<GpuMirror>();
+            mirror->ntotal = snapshot.ntotal;
+            if (mode == "shard" && devices.size() > 1)
+            {
+                auto copy = std::make_unique<GpuMirror::Copy>();
+                std::vector<faiss::gpu::GpuResourcesProvider*> providers;
+                for (size_t i = 0; i < devices.size(); ++i)
+                {
+                    copy->resources.push_back(makeResources());
+                    providers.push_back(copy->resources.back().get());
+                }
+                faiss::gpu::GpuMultipleClonerOptions options;
+                options.shard = true;
+                options.useFloat16 = type == "IVFPQ";   // PQ lookup tables in half precision fit shared memory
+                copy->index.reset(faiss::gpu::index_cpu_to_gpu_multiple(providers, devices, &snapshot, &options));
+                mirror->copies.push_back(std::move(copy));
+            }
+            else
+            {
+                faiss::gpu::GpuClonerOptions options;
+                options.useFloat16 = type == "IVFPQ";
+                const size_t count = mode == "replica" ? devices.size() : 1;
+                for (size_t i = 0; i < count; ++i)
+                {
+                    auto copy = std::make_unique<GpuMirror::Copy>();
+                    copy->resources.push_back(makeResources());
+                    copy->index.reset(faiss::gpu::index_cpu_to_gpu(copy->resources.back().get(), devices[i], &snapshot, &options));
+                    mirror->copies.push_back(std::move(copy));
+                }
+            }
+            return mirror;
+        }
+
+        // Starts copying the main index to the GPUs once it is big enough, or when too many
+        // vectors were merged since the last copy. The caller holds mutex_.
+        void maybeStartGpuSyncLocked()
+        {
+            if (gpu_syncing_ || detached_ || rebuilding_ || main_mapped_ || !dynamic_cast<faiss::IndexIDMap2*>(index_) ||
+                std::chrono::steady_clock::now() < retry_gpu_after_)
+            {
+                return;
+            }
+            const std::string mode = gpuModeLocked();
+            if (mode.empty())
+            {
+                return;
+            }
+            const bool missing = !gpu_mirror_ && index_->ntotal >= kGpuMinVectors;
+            const bool behind = gpu_mirror_ && gpu_lag_ && gpu_lag_->ntotal >= std::max(config_.gpuSyncPoints, 1);
+            if (!missing && !behind)
+            {
+                return;
+            }
+            std::vector<int> devices = gpuDevicesFor(mode);
+            if (devices.empty())
+            {
+                KOLOSAL_LOG_WARNING("No usable GPU for FAISS collection '%s' (%s mode), searching on the CPU",
+                                         name_.c_str(), mode.c_str());
+                retry_gpu_after_ = std::chrono::steady_clock::now() + std::chrono::minutes(5);
+                return;
+            }
+
+            if (gpu_sync_thread_.joinable())
+            {
+                gpu_sync_thread_.join();  // The previous copy has already swapped and is exiting
+            }
+            if (!gpu_lag_)
+            {
+                // Catches what is merged while the copy runs
+                std::unique_lock<std::shared_mutex> write(index_mutex_);
+                gpu_lag_ = makeDeltaIndex();
+            }
+            gpu_syncing_ = true;
+            gpu_sync_thread_ = std::thread(&Collection::syncGpu, shared_from_this(), mode, std::move(devices), gpu_generation_);
+        }
+
+        // Clones the main index under the shared lock and copies the clone to the GPUs with no
+        // lock held, so searches and merges keep running. The copy is swapped in unless the main
+        // index was replaced meanwhile; a failed copy leaves the collection on the CPU for a while.
+        void syncGpu(std::string mode, std::vector<int> devices, uint64_t generation)
+        {
+            const auto started = std::chrono::steady_clock::now();
+            std::unique_ptr<GpuMirror> mirror;
+            faiss::idx_t lag_copied = 0;    // Leading lag vectors the clone already holds
+            try
+            {
+                std::unique_ptr<faiss::Index> snapshot;
+                std::string type;
+                {
+                    std::shared_lock<std::shared_mutex> read(index_mutex_);
+                    if (generation == gpu_generation_ && index_)
+                    {
+                        snapshot.reset(faiss::clone_index(mainInner()));
+                        lag_copied = gpu_lag_ ? gpu_lag_->ntotal : 0;
+                        type = builtType_;
+                    }
+                }
+                if (snapshot)
+                {
+                    mirror = copyToGpus(*snapshot, type, mode, std::move(devices));
+                }
+            }
+            catch (const std::exception& ex)
+            {
+                KOLOSAL_LOG_WARNING("Copying FAISS collection '%s' to the GPU failed, searching on the CPU: %s",
+                                         name_.c_str(), ex.what());
+                mirror.reset();
+            }
+
+            std::unique_ptr<GpuMirror> replaced;    // Freed after the locks are released
+            std::lock_guard<std::mutex> lock(mutex_);
+            {
+                std::unique_lock<std::shared_mutex> write(index_mutex_);
+                if (generation == gpu_generation_ && loaded_ && !detached_)
+                {
+                    replaced = std::move(gpu_mirror_);
+                    if (mirror)
+                    {
+                        if (lag_copied > 0 && gpu_lag_)
+                        {
+                            std::vector<faiss::idx_t> copied(gpu_lag_->id_map.begin(), gpu_lag_->id_map.begin() + lag_copied);
+                            gpu_lag_->remove_ids(faiss::IDSelectorBatch(copied.size(), copied.data()));
+                        }
+                        gpu_mirror_ = std::move(mirror);
+                        const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started);
+                        KOLOSAL_LOG_INFO("FAISS collection '%s' copied to %zu GPU index(es) in %s mode (%lld vectors) in %lld ms",
+                                              name_.c_str(), gpu_mirror_->copies.size(), mode.c_str(),
+                                              static_cast<long long>(gpu_mirror_->ntotal), static_cast<long long>(elapsed.count()));
+                    }
+                    else
+                    {
+                        gpu_lag_.reset();
+                        retry_gpu_after_ = std::chrono::steady_clock::now() + std::chrono::minutes(5);
+                    }
+                }
+            }
+            gpu_syncing_ = false;
+        }
+#else
+        void maybeStartGpuSyncLocked()
+        {
+        }
+#endif
+
+        // One background tick: group-commit the WAL, merge full delta batches, start a rebuild
+        // when the main index has outgrown its type, and checkpoint if due
+        void maintain()
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!loaded_)
+            {
+                return;
+            }
+            syncWalLocked();
+            mergeDeltaBatches(mergeBatchSize());
+            maybeStartRebuildLocked();
+            maybeStartGpuSyncLocked();
+            if (checkpointDueLocked())
+            {
+                auto saved = checkpointLocked();
+                if (!saved.success)
+                {
+                    KOLOSAL_LOG_WARNING("FAISS checkpoint of collection '%s' failed: %s",
+                                             name_.c_str(), saved.error_message.c_str());
+                }
+            }
+        }
+
+        // Links the checkpoint, the vectors file and the WAL into dir and describes them in
+        // header. The links stay a consistent snapshot after the lock is released: checkpoints
+        // rename new files into place, and the WAL and vectors file only grow past the sizes
+        // recorded here.
+        FaissResult linkSnapshotLocked(const std::filesystem::path& dir, nlohmann::json& header)
+        {
+            FaissResult result;
+            result.success = false;
+            if (!std::filesystem::exists(indexFile()) || !std::filesystem::exists(pointsFile()) ||
+                !std::filesystem::exists(metadataFile()))
+            {
+                result.error_message = "Collection '" + name_ + "' has not been checkpointed yet";
+                result.status_code = 409;
+                return result;
+            }
+            syncWalLocked();
+
+            std::vector<std::pair<std::string, std::filesystem::path>> files = {
+                {"index", indexFile()}, {"metadata", metadataFile()}, {"points", pointsFile()}};
+            if (vectors_.isOpen())
+            {
+                files.emplace_back("vectors", vectorsFile());
+            }
+            if (wal_synced_bytes_ > 0)
+            {
+                files.emplace_back("wal", walPath());
+            }
+
+            std::filesystem::create_directories(dir);
+            header = {{"collection", name_}, {"epoch", epoch_}, {"position", wal_base_ + wal_synced_bytes_},
+                      {"files", nlohmann::json::array()}};
+            for (const auto& [role, path] : files)
+            {
+                const uint64_t size = role == "wal" ? wal_synced_bytes_ : std::filesystem::file_size(path);
+                std::error_code ec;
+                std::filesystem::create_hard_link(path, dir / role, ec);
+                if (ec)
+                {
+                    // File systems without hard links get a copy, taken while writers wait
+                    ec.clear();
+                    std::filesystem::copy_file(path, dir / role, ec);
+                }
+                if (ec)
+                {
+                    result.error_message = "Failed to link " + path.string() + ": " + ec.message();
+                    result.status_code = 500;
+                    return result;
+                }
+                header["files"].push_back({{"name", role}, {"size", size}});
+            }
+            result.success = true;
+            return result;
+        }
+
+        // Replaces the quantized scores of the main index's candidates with exact ones computed from
+        // the vectors file. The candidates of all queries are read in one batch.
+        void rerankFromDiskLocked(const std::vector<float>& queries,
+                                  std::vector<std::vector<std::pair<float, faiss::idx_t>>>& candidates,
+                                  std::vector<std::vector<std::pair<float, faiss::idx_t>>>& hits) const
+        {
+            const size_t dims = static_cast<size_t>(index_->d);
+            std::vector<faiss::idx_t> ids;
+            for (const auto& query_candidates : candidates)
+            {
+                for (const auto& candidate : query_candidates)
+                {
+                    ids.push_back(candidate.second);
+                }
+            }
+            std::sort(ids.begin(), ids.end());
+            ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+
+            std::vector<float> vectors(ids.size() * dims);
+            if (!vectors_.read(ids.data(), ids.size(), vectors.data()))
+            {
+                KOLOSAL_LOG_WARNING("Reading vectors of FAISS collection '%s' failed, returning approximate scores",
+                                         name_.c_str());
+                for (size_t q = 0; q < candidates.size(); ++q)
+                {
+                    hits[q].insert(hits[q].end(), candidates[q].begin(), candidates[q].end());
+                }
+                return;
+            }
+
+            const bool l2 = settings_.metricType == "L2";
+            for (size_t q = 0; q < candidates.size(); ++q)
+            {
+                const float* query = queries.data() + q * dims;
+                for (const auto& candidate : candidates[q])
+                {
+                    const size_t row = static_cast<size_t>(std::lower_bound(ids.begin(), ids.end(), candidate.second) - ids.begin());
+                    const float* vector = vectors.data() + row * dims;
+                    float distance = 0.0f;
+                    if (l2)
+                    {
+                        for (size_t j = 0; j < dims; ++j)
+                        {
+                            distance += (query[j] - vector[j]) * (query[j] - vector[j]);
+                        }
+                    }
+                    else
+                    {
+                        distance = vecmath::dot(query, vector, dims);
+                    }
+                    // Same similarity scale as the other indexes' results
+                    hits[q].emplace_back(l2 ? 1.0f / (1.0f + distance) : distance, candidate.second);
+                }
+            }
+        }
+
+        // Runs every query through one index->search(n, ...) call per index, so FAISS can use its
+        // batched distance kernels. Returns one hit list per query; the caller holds index_mutex_.
+        // selector, when set, restricts both indexes to the ids a payload filter selected, so
+        // filtered queries still only fetch limit candidates
+        nlohmann::json searchLocked(const std::vector<std::vector<float>>& query_vectors,
+                                    int limit,
+                                    float score_threshold,
+                                    const FaissSearchParams& params,
+                                    faiss::IDSelector* selector = nullptr) const
+        {
+            // Pack the queries row-major, normalizing them if needed
+            const size_t dims = static_cast<size_t>(index_->d);
+            const faiss::idx_t n = static_cast<faiss::idx_t>(query_vectors.size());
+            std::vector<float> queries;
+            queries.reserve(query_vectors.size() * dims);
+            for (const auto& query_vector : query_vectors)
+            {
+                queries.insert(queries.end(), query_vector.begin(), query_vector.end());
+                if (normalizes())
+                {
+                    normalize(queries.data() + queries.size() - dims, dims);
+                }
+            }
+
+            if (main_mapped_)
+            {
+                rememberQueries(queries, dims);
+            }
+
+            // Tombstoned ids are skipped inside the main index search, on top of any filter
+            TombstoneSelector live(tombstones_);
+            faiss::IDSelectorAnd filtered_live(selector, &live);
+            faiss::IDSelector* main_selector = selector;
+            if (!tombstones_.empty())
+            {
+                main_selector = selector ? static_cast<faiss::IDSelector*>(&filtered_live) : &live;
+            }
+
+            // Per-query overrides of the tuned nprobe/efSearch
+            faiss::SearchParametersIVF ivf_params;
+            faiss::SearchParametersHNSW hnsw_params;
+            faiss::SearchParameters main_filter_params;
+            faiss::SearchParameters delta_params;
+            const faiss::SearchParameters* main_params = nullptr;
+            if (params.nprobe > 0 && isIvfType(builtType_))
+            {
+                ivf_params.nprobe = static_cast<size_t>(params.nprobe);
+                main_params = &ivf_params;
+            }
+            else if (params.efSearch > 0 && isHnswType(builtType_))
+            {
+                hnsw_params.efSearch = params.efSearch;
+                main_params = &hnsw_params;
+            }
+            if (main_selector)
+            {
+                ivf_params.sel = main_selector;
+                hnsw_params.sel = main_selector;
+                main_filter_params.sel = main_selector;
+                if (!main_params)
+                {
+                    main_params = &main_filter_params;
+                }
+            }
+            delta_params.sel = selector;
+
+            // Search the main index and the delta of recent inserts, then merge the two top-k lists
+            std::vector<std::vector<std::pair<float, faiss::idx_t>>> hits(query_vectors.size());
+
+            // Disk-tier main indexes hold PQ or SQ codes: fetch more candidates and re-score them exactly
+            const bool rerank = reranksFromDisk();
+            const faiss::idx_t main_extra = rerank
+                ? static_cast<faiss::idx_t>(std::max(limit, 0)) * (std::max(config_.diskRerankFactor, 1) - 1) : 0;
+            std::vector<std::vector<std::pair<float, faiss::idx_t>>> candidates(rerank ? query_vectors.size() : 0);
+            auto& main_hits = rerank ? candidates : hits;
+
+            auto addHits = [&](std::vector<std::vector<std::pair<float, faiss::idx_t>>>& into,
+                               const std::vector<faiss::idx_t>& internal_ids, const std::vector<float>& distances, faiss::idx_t k) {
+                for (faiss::idx_t q = 0; q < n; ++q)
+                {
+                    for (faiss::idx_t i = q * k; i < (q + 1) * k; ++i)
+                    {
+                        if (internal_ids[i] < 0) break; // No more results
+
+                        float score = distances[i];
+
+                        // Convert distance to similarity score based on metric type
+                        if (settings_.metricType == "L2")
+                        {
+                            score = 1.0f / (1.0f + score); // Convert L2 distance to similarity
+                        }
+                        // For IP, the score is already similarity (higher is better)
+                        if (points_.contains(internal_ids[i]))
+                        {
+                            into[q].emplace_back(score, internal_ids[i]);
+                        }
+                    }
+                }
+            };
+            auto collect = [&](std::vector<std::vector<std::pair<float, faiss::idx_t>>>& into, const faiss::Index* index,
+                               const faiss::SearchParameters* search_params, faiss::idx_t overfetch) {
+                const faiss::idx_t k = std::min<faiss::idx_t>(static_cast<faiss::idx_t>(std::max(limit, 0)) + overfetch, index->ntotal);
+                if (k <= 0) return;
+                std::vector<faiss::idx_t> internal_ids(static_cast<size_t>(n * k));
+                std::vector<float> distances(static_cast<size_t>(n * k));
+                index->search(n, queries.data(), k, distances.data(), internal_ids.data(), search_params);
+                addHits(into, internal_ids, distances, k);
+            };
+
+            bool searched_main = false;
+#ifdef FAISS_ENABLE_GPU
+            // Unfiltered queries at the tuned nprobe run on the GPU copy, plus the vectors merged
+            // since it was taken. The GPU cannot skip tombstones, so it fetches that many more.
+            if (gpu_mirror_ && !selector && params.nprobe <= 0 && params.efSearch <= 0)
+            {
+                const faiss::idx_t overfetch = static_cast<faiss::idx_t>(tombstones_.size());
+                const faiss::idx_t k = std::min<faiss::idx_t>(static_cast<faiss::idx_t>(std::max(limit, 0)) + overfetch + main_extra,
+                                                              gpu_mirror_->ntotal);
+                if (k > 0 && k <= kGpuMaxK)
+                {
+                    std::vector<faiss::idx_t> labels(static_cast<size_t>(n * k));
+                    std::vector<float> distances(static_cast<size_t>(n * k));
+                    try
+                    {
+                        gpu_mirror_->search(n, queries.data(), k, distances.data(), labels.data());
+                        const auto& positions = static_cast<const faiss::IndexIDMap2*>(index_)->id_map;
+                        for (faiss::idx_t& label : labels)
+                        {
+                            if (label >= 0) label = positions[static_cast<size_t>(label)];
+                        }
+                        addHits(main_hits, labels, distances, k);
+                        if (gpu_lag_)
+                        {
+                            collect(main_hits, gpu_lag_.get(), nullptr, overfetch + main_extra);
+                        }
+                        searched_main = true;
+                    }
+                    catch (const std::exception& ex)
+                    {
+                        KOLOSAL_LOG_WARNING("GPU search of FAISS collection '%s' failed, using the CPU index: %s",
+                                                 name_.c_str(), ex.what());
+                    }
+                }
+            }
+#endif
+            if (!searched_main)
+            {
+                collect(main_hits, index_, main_params, main_extra);
+            }
+            if (rerank)
+            {
+                rerankFromDiskLocked(queries, candidates, hits);
+            }
+            collect(hits, delta_.get(), selector ? &delta_params : nullptr, 0);
+
+            // Convert results to JSON format
+            nlohmann::json batch_results = nlohmann::json::array();
+            for (auto& query_hits : hits)
+            {
+                std::sort(query_hits.begin(), query_hits.end(),
+                          [](const auto& a, const auto& b) { return a.first > b.first; });
+                if (query_hits.size() > static_cast<size_t>(std::max(limit, 0)))
+                {
+                    query_hits.resize(static_cast<size_t>(std::max(limit, 0)));
+                }
+
+                nlohmann::json search_results = nlohmann::json::array();
+                for (const auto& [score, internal_id] : query_hits)
+                {
+                    if (score < score_threshold) continue;
+
+                    std::string external_id;
+                    if (points_.externalId(internal_id, external_id))
+                    {
+                        nlohmann::json search_result;
+                        search_result["id"] = external_id;
+                        search_result["score"] = score;
+
+                        // Add payload if available; unrequested fields are never decoded
+                        nlohmann::json payload;
+                        if (points_.payload(internal_id, params.fields, payload))
+                        {
+                            search_result["payload"] = std::move(payload);
+                        }
+
+                        search_results.push_back(std::move(search_result));
+                    }
+                }
+                batch_results.push_back(std::move(search_results));
+            }
+            return batch_results;
+        }
+    };
+
+    // Loaded collections by name; entries are added on first use and dropped on unload
+    std::unordered_map<std::string, std::shared_ptr<Collection>> collections_;
+    std::unordered_set<std::string> restoring_;     // Collections whose files a snapshot is replacing
+    std::shared_mutex registry_mutex_;
+
+    std::mutex background_mutex_;
+    std::condition_variable background_cv_;
+    bool stopping_ = false;
+    bool merge_requested_ = false;
+    std::thread background_;
+#endif
+
+    Config config_;
+
+    Impl(const Config& config)
+        : config_(config)
+    {
+        KOLOSAL_LOG_INFO("FaissClient initialized with index path: %s", config_.indexPath.c_str());
+#ifdef USE_FAISS
+        background_ = std::thread(&Impl::backgroundLoop, this);
+#endif
+    }
+
+    ~Impl()
+    {
+#ifdef USE_FAISS
+        {
+            std::lock_guard<std::mutex> lock(background_mutex_);
+            stopping_ = true;
+        }
+        background_cv_.notify_all();
+        if (background_.joinable())
+        {
+            background_.join();
+        }
+
+        // Leave a fresh checkpoint behind so the next start has nothing to replay
+        for (const auto& collection : snapshotCollections())
+        {
+            collection->stopRebuild();
+            std::lock_guard<std::mutex> lock(collection->mutex_);
+            collection->unloadLocked();
+        }
+#endif
+    }
+
+#ifdef USE_FAISS
+    // Effective settings for a collection being created: per-collection overrides from the
+    // config beat the caller's dimensions and distance, which beat the client-wide defaults
+    Config::CollectionConfig resolveSettings(const std::string& collection_name, int dimensions,
+                                             const std::string& distance) const
+    {
+        Config::CollectionConfig settings;
+        settings.indexType = config_.indexType;
+        settings.metricType = config_.metricType;
+        settings.dimensions = dimensions > 0 ? dimensions : config_.dimensions;
+        settings.nlist = config_.nlist;
+        settings.nprobe = config_.nprobe;
+        settings.efSearch = config_.efSearch;
+        settings.gpuMode = config_.gpuMode;
+        settings.textCompression = config_.textCompression;
+
+        if (distance == "L2" || distance == "Euclid" || distance == "Euclidean")
+        {
+            settings.metricType = "L2";
+        }
+        else if (distance == "IP" || distance == "Cosine" || distance == "Dot")
+        {
+            settings.metricType = "IP";
+        }
+
+        auto it = config_.collections.find(collection_name);
+        if (it != config_.collections.end())
+        {
+            const auto& overrides = it->second;
+            if (!overrides.indexType.empty()) settings.indexType = overrides.indexType;
+            if (!overrides.metricType.empty()) settings.metricType = overrides.metricType;
+            if (overrides.dimensions > 0) settings.dimensions = overrides.dimensions;
+            if (overrides.nlist > 0) settings.nlist = overrides.nlist;
+            if (overrides.nprobe > 0) settings.nprobe = overrides.nprobe;
+            if (overrides.efSearch > 0) settings.efSearch = overrides.efSearch;
+            if (!overrides.gpuMode.empty()) settings.gpuMode = overrides.gpuMode;
+            if (!overrides.textCompression.empty()) settings.textCompression = overrides.textCompression;
+        }
+        return settings;
+    }
+
+    std::vector<std::shared_ptr<Collection>> snapshotCollections()
+    {
+        std::shared_lock<std::shared_mutex> read(registry_mutex_);
+        std::vector<std::shared_ptr<Collection>> snapshot;
+        snapshot.reserve(collections_.size());
+        for (const auto& item : collections_)
+        {
+            snapshot.push_back(item.second);
+        }
+        return snapshot;
+    }
+
+    void forgetCollection(const std::shared_ptr<Collection>& collection)
+    {
+        std::unique_lock<std::shared_mutex> write(registry_mutex_);
+        auto it = collections_.find(collection->name_);
+        if (it != collections_.end() && it->second == collection)
+        {
+            collections_.erase(it);
+        }
+    }
+
+    // Returns the loaded collection, loading it from disk on first use. With dimensions <= 0 a
+    // collection that has never been written is not created and a 404 result is returned.
+    std::shared_ptr<Collection> openCollection(const std::string& collection_name, int dimensions,
+                                               const std::string& distance, FaissResult& result)
+    {
+        std::shared_ptr<Collection> collection;
+        {
+            std::shared_lock<std::shared_mutex> read(registry_mutex_);
+            auto it = collections_.find(collection_name);
+            if (it != collections_.end())
+            {
+                collection = it->second;
+            }
+        }
+        if (collection && collection->loaded_)
+        {
+            return collection;
+        }
+        if (!collection)
+        {
+            std::unique_lock<std::shared_mutex> write(registry_mutex_);
+            if (restoring_.count(collection_name))
+            {
+                result.error_message = "Collection '" + collection_name + "' is being restored from a snapshot";
+                result.status_code = 409;
+                return nullptr;
+            }
+            auto& slot = collections_[collection_name];
+            if (!slot)
+            {
+                slot = std::make_shared<Collection>(collection_name, config_);
+            }
+            collection = slot;
+        }
+
+        // Each collection loads under its own lock, so other collections stay available
+        std::lock_guard<std::mutex> lock(collection->mutex_);
+        if (collection->loaded_)
+        {
+            return collection;
+        }
+        if (collection->detached_)
+        {
+            result.error_message = "Collection '" + collection_name + "' was unloaded";
+            result.status_code = 409;
+            return nullptr;
+        }
+        if (dimensions <= 0 && !collection->existsOnDisk())
+        {
+            collection->detached_ = true;
+            forgetCollection(collection);
+            result.error_message = "Collection '" + collection_name + "' does not exist";
+            result.status_code = 404;
+            return nullptr;
+        }
+
+        auto loaded = collection->loadLocked(resolveSettings(collection_name, dimensions, distance));
+        if (!loaded.success)
+        {
+            collection->detached_ = true;
+            forgetCollection(collection);
+            result.error_message = loaded.error_message;
+            result.status_code = 500;
+            return nullptr;
+        }
+        return collection;
+    }
+
+    void requestMerge()
+    {
+        {
+            std::lock_guard<std::mutex> lock(background_mutex_);
+            merge_requested_ = true;
+        }
+        background_cv_.notify_one();
+    }
+
+    // Group-commits the WAL every walSyncMs, merges full delta batches into the main index and
+    // checkpoints when the interval or size is reached, one collection at a time
+    void backgroundLoop()
+    {
+        const auto tick = std::chrono::milliseconds(config_.walSyncMs > 0 ? config_.walSyncMs : 1000);
+        std::unique_lock<std::mutex> lock(background_mutex_);
+        while (!stopping_)
+        {
+            background_cv_.wait_for(lock, tick, [this] { return stopping_ || merge_requested_; });
+            merge_requested_ = false;
+            lock.unlock();
+            for (const auto& collection : snapshotCollections())
+            {
+                collection->maintain();
+            }
+            lock.lock();
+        }
+    }
+#endif
+
+    std::future<FaissResult> initializeIndex(const std::string& collection_name, int dimensions, const std::string& distance)
+    {
+        return TaskExecutor::instance().submit([this, collection_name, dimensions, distance]() -> FaissResult {
+            FaissResult result;
+            result.success = false;
+
+#ifndef USE_FAISS
+            result.error_message = "FAISS support not compiled in";
+            return result;
+#else
+            result.success = openCollection(collection_name, dimensions, distance, result) != nullptr;
+            return result;
+#endif
+        });
+    }
+
+    std::future<FaissResult> unloadCollection(const std::string& collection_name)
+    {
+        return TaskExecutor::instance().submit([this, collection_name]() -> FaissResult {
+            FaissResult result;
+            result.success = false;
+
+#ifndef USE_FAISS
+            result.error_message = "FAISS support not compiled in";
+            return result;
+#else
+            std::shared_ptr<Collection> collection;
+            {
+                std::unique_lock<std::shared_mutex> write(registry_mutex_);
+                auto it = collections_.find(collection_name);
+                if (it != collections_.end())
+                {
+                    collection = it->second;
+                    collections_.erase(it);
+                }
+            }
+            if (!collection)
+            {
+                result.error_message = "Collection '" + collection_name + "' is not loaded";
+                result.status_code = 404;
+                return result;
+            }
+
+            collection->stopRebuild();
+            std::lock_guard<std::mutex> lock(collection->mutex_);
+            collection->unloadLocked();
+            KOLOSAL_LOG_INFO("Unloaded FAISS collection '%s'", collection_name.c_str());
+            result.success = true;
+            return result;
+#endif
+        });
+    }
+
+    FaissResult exportSnapshot(const std::string& collection_name, const std::function<bool(const char*, size_t)>& sink)
+    {
+        FaissResult result;
+        result.success = false;
+
+#ifndef USE_FAISS
+        result.error_message = "FAISS support not compiled in";
+        return result;
+#else
+        const std::filesystem::path dir = std::filesystem::path(config_.indexPath) /
+                                          (".snapshot-" + collection_name + "-" + randomEpoch());
+        try
+        {
+            auto collection = openCollection(collection_name, 0, "", result);
+            if (!collection)
+            {
+                return result;
+            }
+            nlohmann::json header;
+            {
+                std::lock_guard<std::mutex> lock(collection->mutex_);
+                if (!collection->loaded_)
+                {
+                    result.error_message = "Collection '" + collection_name + "' was unloaded";
+                    result.status_code = 409;
+                    return result;
+                }
+                auto linked = collection->linkSnapshotLocked(dir, header);
+                if (!linked.success)
+                {
+                    std::error_code ec;
+                    std::filesystem::remove_all(dir, ec);
+                    return linked;
+                }
+            }
+
+            std::string head(kSnapshotMagic, sizeof(kSnapshotMagic));
+            const std::string header_text = header.dump();
+            putValue<uint32_t>(head, static_cast<uint32_t>(header_text.size()));
+            head.append(header_text);
+            bool sent = sink(head.data(), head.size());
+
+            std::vector<char> buffer(kSnapshotBufferBytes);
+            for (const auto& file : header["files"])
+            {
+                if (!sent)
+                {
+                    break;
+                }
+                const std::string role = file["name"].get<std::string>();
+                std::ifstream in(dir / role, std::ios::binary);
+                uint64_t remaining = file["size"].get<uint64_t>();
+                uLong checksum = crc32(0L, Z_NULL, 0);
+                while (sent && remaining > 0)
+                {
+                    const size_t step = static_cast<size_t>(std::min<uint64_t>(remaining, buffer.size()));
+                    if (!in.read(buffer.data(), static_cast<std::streamsize>(step)))
+                    {
+                        result.error_message = "Failed to read the snapshot's " + role + " file";
+                        result.status_code = 500;
+                        sent = false;
+                        break;
+                    }
+                    checksum = crc32(checksum, reinterpret_cast<const Bytef*>(buffer.data()), static_cast<uInt>(step));
+                    sent = sink(buffer.data(), step);
+                    remaining -= step;
+                }
+                const uint32_t trailer = static_cast<uint32_t>(checksum);
+                sent = sent && sink(reinterpret_cast<const char*>(&trailer), sizeof(trailer));
+            }
+            std::error_code ec;
+            std::filesystem::remove_all(dir, ec);
+            if (!sent)
+            {
+                if (result.error_message.empty())
+                {
+                    result.error_message = "Snapshot receiver went away";
+                }
+                return result;
+            }
+
+            header.erase("files");
+            result.response_data = std::move(header);
+            result.success = true;
+            KOLOSAL_LOG_INFO("Exported a snapshot of FAISS collection '%s' at position %llu",
+                                  collection_name.c_str(), result.response_data["position"].get<unsigned long long>());
+        }
+        catch (const std::exception& ex)
+        {
+            std::error_code ec;
+            std::filesystem::remove_all(dir, ec);
+            result.error_message = "Failed to export snapshot: " + std::string(ex.what());
+            result.status_code = 500;
+            KOLOSAL_LOG_ERROR("FAISS snapshot export error: %s", ex.what());
+        }
+        return result;
+#endif
+    }
+
+    FaissResult importSnapshot(const std::string& collection_name, std::istream& in)
+    {
+        FaissResult result;
+        result.success = false;
+
+#ifndef USE_FAISS
+        result.error_message = "FAISS support not compiled in";
+        return result;
+#else
+        const std::filesystem::path staging = std::filesystem::path(config_.indexPath) /
+                                              (".restore-" + collection_name + "-" + randomEpoch());
+        auto fail = [&](int status, const std::string& message) {
+            std::error_code ec;
+            std::filesystem::remove_all(staging, ec);
+            result.error_message = message;
+            result.status_code = status;
+            return result;
+        };
+        try
+        {
+            char magic[sizeof(kSnapshotMagic)];
+            uint32_t header_size = 0;
+            if (!in.read(magic, sizeof(magic)) || std::memcmp(magic, kSnapshotMagic, sizeof(magic)) != 0 ||
+                !in.read(reinterpret_cast<char*>(&header_size), sizeof(header_size)) || header_size > kMaxSnapshotHeader)
+            {
+                return fail(400, "Not a FAISS collection snapshot");
+            }
+            std::string header_text(header_size, '\0');
+            if (!in.read(&header_text[0], header_size))
+            {
+                return fail(400, "Snapshot header is truncated");
+            }
+            const auto header = nlohmann::json::parse(header_text, nullptr, false);
+            if (!header.is_object() || !header.contains("files") || !header["files"].is_array() ||
+                !header.contains("epoch") || !header["epoch"].is_string() ||
+                !header.contains("position") || !header["position"].is_number_unsigned())
+            {
+                return fail(400, "Snapshot header is malformed");
+            }
+
+            // Where each file goes, named after the collection being restored
+            const Collection target(collection_name, config_);
+            const std::unordered_map<std::string, std::filesystem::path> destinations = {
+                {"index", target.indexFile()}, {"metadata", target.metadataFile()}, {"points", target.pointsFile()},
+                {"vectors", target.vectorsFile()}, {"wal", target.walPath()}};
+
+            std::filesystem::create_directories(staging);
+            std::vector<std::string> roles;
+            std::vector<char> buffer(kSnapshotBufferBytes);
+            for (const auto& file : header["files"])
+            {
+                const std::string role = file.value("name", std::string());
+                if (!destinations.count(role) || std::find(roles.begin(), roles.end(), role) != roles.end() ||
+                    !file.contains("size") || !file["size"].is_number_unsigned())
+                {
+                    return fail(400, "Snapshot header lists an unknown file: " + role);
+                }
+                std::ofstream out(staging / role, std::ios::binary | std::ios::trunc);
+                uint64_t remaining = file["size"].get<uint64_t>();
+                uLong checksum = crc32(0L, Z_NULL, 0);
+                while (remaining > 0)
+                {
+                    const size_t step = static_cast<size_t>(std::min<uint64_t>(remaining, buffer.size()));
+                    if (!in.read(buffer.data(), static_cast<std::streamsize>(step)))
+                    {
+                        return fail(400, "Snapshot is truncated in its " + role + " file");
+                    }
+                    checksum = crc32(checksum, reinterpret_cast<const Bytef*>(buffer.data()), static_cast<uInt>(step));
+                    if (!out.write(buffer.data(), static_cast<std::streamsize>(step)))
+                    {
+                        return fail(500, "Failed to write " + (staging / role).string());
+                    }
+                    remaining -= step;
+                }
+                uint32_t trailer = 0;
+                if (!in.read(reinterpret_cast<char*>(&trailer), sizeof(trailer)) || trailer != static_cast<uint32_t>(checksum))
+                {
+                    return fail(400, "Snapshot's " + role + " file does not match its checksum");
+                }
+                if (!out.flush())
+                {
+                    return fail(500, "Failed to write " + (staging / role).string());
+                }
+                out.close();
+                syncPath(staging / role);
+                roles.push_back(role);
+            }
+            for (const char* required : {"index", "metadata", "points"})
+            {
+                if (std::find(roles.begin(), roles.end(), required) == roles.end())
+                {
+                    return fail(400, std::string("Snapshot has no ") + required + " file");
+                }
+            }
+
+            // Verified in full; only now is the collection taken down and its files swapped
+            std::shared_ptr<Collection> previous;
+            {
+                std::unique_lock<std::shared_mutex> write(registry_mutex_);
+                if (!restoring_.insert(collection_name).second)
+                {
+                    return fail(409, "Collection '" + collection_name + "' is already being restored");
+                }
+                auto it = collections_.find(collection_name);
+                if (it != collections_.end())
+                {
+                    previous = it->second;
+                    collections_.erase(it);
+                }
+            }
+            std::error_code ec;
+            if (previous)
+            {
+                previous->stopRebuild();
+                std::lock_guard<std::mutex> lock(previous->mutex_);
+                previous->unloadLocked();
+            }
+            std::filesystem::remove(target.prevWalPath(), ec);
+            for (const auto& [role, destination] : destinations)
+            {
+                if (std::find(roles.begin(), roles.end(), role) != roles.end())
+                {
+                    std::filesystem::rename(staging / role, destination, ec);
+                }
+                else
+                {
+                    std::filesystem::remove(destination, ec);
+                }
+                if (ec)
+                {
+                    break;
+                }
+            }
+            syncPath(config_.indexPath, true);
+            {
+                std::unique_lock<std::shared_mutex> write(registry_mutex_);
+                restoring_.erase(collection_name);
+            }
+            if (ec)
+            {
+                return fail(500, "Failed to move the snapshot into place: " + ec.message());
+            }
+            std::filesystem::remove_all(staging, ec);
+
+            if (!openCollection(collection_name, 0, "", result))
+            {
+                return result;
+            }
+            result.response_data = {{"collection", collection_name}, {"epoch", header["epoch"]}, {"position", header["position"]}};
+            result.success = true;
+            KOLOSAL_LOG_INFO("Restored FAISS collection '%s' from a snapshot at position %llu",
+                                  collection_name.c_str(), header["position"].get<unsigned long long>());
+        }
+        catch (const std::exception& ex)
+        {
+            {
+                std::unique_lock<std::shared_mutex> write(registry_mutex_);
+                restoring_.erase(collection_name);
+            }
+            fail(500, "Failed to import snapshot: " + std::string(ex.what()));
+            KOLOSAL_LOG_ERROR("FAISS snapshot import error: %s", ex.what());
+        }
+        return result;
+#endif
+    }
+
+    FaissResult readChanges(const std::string& collection_name, const std::string& epoch, uint64_t position,
+                            size_t max_bytes, std::string& records)
+    {
+        FaissResult result;
+        result.success = false;
+        records.clear();
+
+#ifndef USE_FAISS
+        result.error_message = "FAISS support not compiled in";
+        return result;
+#else
+        try
+        {
+            auto collection = openCollection(collection_name, 0, "", result);
+            if (!collection)
+            {
+                return result;
+            }
+            auto& c = *collection;
+            std::lock_guard<std::mutex> lock(c.mutex_);
+            if (!c.loaded_)
+            {
+                result.error_message = "Collection '" + collection_name + "' was unloaded";
+                result.status_code = 409;
+                return result;
+            }
+
+            // Only records on disk are handed out, so a replica never runs ahead of a crashed source
+            const uint64_t end = c.wal_base_ + c.wal_synced_bytes_;
+            std::filesystem::path file;
+            uint64_t offset = 0;
+            uint64_t available = 0;
+            if (epoch != c.epoch_ || position > end)
+            {
+                result.error_message = "Position belongs to another load of collection '" + collection_name + "'; take a new snapshot";
+                result.status_code = 410;
+                return result;
+            }
+            if (position >= c.wal_base_)
+            {
+                file = c.walPath();
+                offset = position - c.wal_base_;
+                available = end - position;
+            }
+            else if (c.prev_wal_valid_ && position >= c.prev_wal_base_)
+            {
+                file = c.prevWalPath();
+                offset = position - c.prev_wal_base_;
+                available = c.wal_base_ - position;
+            }
+            else
+            {
+                result.error_message = "Position was checkpointed away; take a new snapshot";
+                result.status_code = 410;
+                return result;
+            }
+
+            uint64_t used = 0;
+            size_t count = 0;
+            if (available > 0)
+            {
+                std::ifstream in(file, std::ios::binary);
+                in.seekg(static_cast<std::streamoff>(offset));
+                char head[kWalHeaderBytes];
+                while (used + kWalHeaderBytes <= available && in.read(head, sizeof(head)))
+                {
+                    uint32_t length = 0;
+                    std::memcpy(&length, head, sizeof(length));
+                    const uint64_t size = kWalHeaderBytes + length;
+                    if (size > available - used || (used > 0 && used + size > max_bytes))
+                    {
+                        break;
+                    }
+                    records.append(head, sizeof(head));
+                    records.resize(records.size() + length);
+                    if (!in.read(&records[records.size() - length], length))
+                    {
+                        records.clear();
+                        result.error_message = "Failed to read " + file.string();
+                        result.status_code = 500;
+                        return result;
+                    }
+                    used += size;
+                    ++count;
                 }
-                
-                initialized_ = true;
-                result.success = true;
-            }
-            catch (const std::exception& ex)
-            {
-                result.error_message = "Failed to initialize FAISS index: " + std::string(ex.what());
-                ServerLogger::logError("FAISS initialization error: %s", ex.what());
             }
-            
-            return result;
+            result.response_data = {{"epoch", c.epoch_}, {"position", position + used}, {"end", end}, {"records", count}};
+            result.success = true;
+        }
+        catch (const std::exception& ex)
+        {
+            records.clear();
+            result.error_message = "Failed to read changes: " + std::string(ex.what());
+            result.status_code = 500;
+            KOLOSAL_LOG_ERROR("FAISS change stream error: %s", ex.what());
+        }
+        return result;
 #endif
-        });
     }
-    
-    std::future<FaissResult> saveIndex()
+
+    FaissResult searchBatch(const std::string& collection_name,
+                            const std::vector<std::vector<float>>& query_vectors,
+                            int limit,
+                            float score_threshold,
+                            const FaissSearchParams& params)
     {
-        return std::async(std::launch::async, [this]() -> FaissResult {
-            std::lock_guard<std::mutex> lock(mutex_);
-            
-            FaissResult result;
-            result.success = false;
-            
+        FaissResult result;
+        result.success = false;
+
 #ifndef USE_FAISS
-            result.error_message = "FAISS support not compiled in";
-            return result;
-#else            
-            try
+        result.error_message = "FAISS support not compiled in";
+        return result;
+#else
+        try
+        {
+            if (query_vectors.empty())
+            {
+                result.response_data["result"] = nlohmann::json::array();
+                result.success = true;
+                return result;
+            }
+
+            // Loads an existing collection, or starts an empty one sized like the queries
+            auto collection = openCollection(collection_name, static_cast<int>(query_vectors.front().size()), "", result);
+            if (!collection)
+            {
+                return result;
+            }
+
+            std::shared_lock<std::shared_mutex> lock(collection->index_mutex_);
+            if (!collection->loaded_)
             {
-                if (!index_ || current_collection_.empty())
+                result.error_message = "Collection '" + collection_name + "' was unloaded";
+                result.status_code = 409;
+                return result;
+            }
+
+            const size_t dims = static_cast<size_t>(collection->index_->d);
+            for (const auto& query_vector : query_vectors)
+            {
+                if (query_vector.size() != dims)
                 {
-                    result.error_message = "No index to save";
+                    result.error_message = "Query vector has " + std::to_string(query_vector.size()) +
+                                           " dimensions, index has " + std::to_string(dims);
+                    result.status_code = 400;
                     return result;
                 }
-                
-                std::filesystem::path index_dir = config_.indexPath;
-                std::filesystem::path index_file = index_dir / (current_collection_ + ".faiss");
-                std::filesystem::path metadata_file = index_dir / (current_collection_ + "_metadata.json");
-                
-                // Save index
-                faiss::write_index(index_, index_file.string().c_str());
-                
-                // Save metadata
-                nlohmann::json metadata;
-                metadata["next_id"] = next_internal_id_.load();
-                
-                // Save ID mappings
-                nlohmann::json id_mappings;
-                for (const auto& item : id_to_internal_id_)
-                {
-                    faiss::idx_t internal_id = std::stoll(item.second);
-                    id_mappings[item.first] = internal_id;
-                }
-                metadata["id_mappings"] = id_mappings;
-                
-                // Save payloads
-                metadata["payloads"] = payloads_;
-                
-                std::ofstream metadata_stream(metadata_file);
-                metadata_stream << metadata.dump(2);
-                
-                result.success = true;
-                ServerLogger::logDebug("Saved FAISS index and metadata");
             }
-            catch (const std::exception& ex)
+
+            if (params.filter.is_null())
             {
-                result.error_message = "Failed to save FAISS index: " + std::string(ex.what());
-                ServerLogger::logError("FAISS save error: %s", ex.what());
+                result.response_data["result"] = collection->searchLocked(query_vectors, limit, score_threshold, params);
             }
-            
-            return result;
+            else
+            {
+                // Resolve the filter to a bitmap of internal ids from the payload field indexes
+                std::vector<uint8_t> bitmap;
+                std::string filter_error;
+                if (!collection->points_.select(params.filter, collection->next_internal_id_.load(), bitmap, filter_error))
+                {
+                    result.error_message = "Invalid filter: " + filter_error;
+                    result.status_code = 400;
+                    return result;
+                }
+                if (std::all_of(bitmap.begin(), bitmap.end(), [](uint8_t byte) { return byte == 0; }))
+                {
+                    result.response_data["result"] = nlohmann::json::array();
+                    for (size_t i = 0; i < query_vectors.size(); ++i)
+                    {
+                        result.response_data["result"].push_back(nlohmann::json::array());
+                    }
+                }
+                else
+                {
+                    faiss::IDSelectorBitmap selector(bitmap.size(), bitmap.data());
+                    result.response_data["result"] = collection->searchLocked(query_vectors, limit, score_threshold, params, &selector);
+                }
+            }
+            result.success = true;
+
+            KOLOSAL_LOG_DEBUG("FAISS search of %zu queries in '%s' completed", query_vectors.size(), collection_name.c_str());
+        }
+        catch (const std::exception& ex)
+        {
+            result.error_message = "Failed to search: " + std::string(ex.what());
+            KOLOSAL_LOG_ERROR("FAISS search error: %s", ex.what());
+        }
+
+        return result;
 #endif
-        });
     }
 };
 
@@ -264,12 +3157,33 @@ FaissClient::FaissClient(const Config& config)
 
 FaissClient::~FaissClient() = default;
 
+std::string FaissClient::indexFactoryString(const std::string& index_type, int dimensions, int nlist)
+{
+#ifdef USE_FAISS
+    return Impl::Collection::factoryString(index_type == "DiskIVFPQ" ? "IVFPQ" : index_type, dimensions, nlist);
+#else
+    return "Flat";
+#endif
+}
+
+nlohmann::json FaissClient::memoryUsage() const
+{
+    nlohmann::json collections = nlohmann::json::array();
+#ifdef USE_FAISS
+    for (const auto& collection : pImpl->snapshotCollections())
+    {
+        collections.push_back(collection->memoryUsage());
+    }
+#endif
+    return collections;
+}
+
 FaissClient::FaissClient(FaissClient&&) noexcept = default;
 FaissClient& FaissClient::operator=(FaissClient&&) noexcept = default;
 
 std::future<FaissResult> FaissClient::testConnection()
 {
-    return std::async(std::launch::async, []() -> FaissResult {
+    return TaskExecutor::instance().submit([]() -> FaissResult {
         FaissResult result;
         result.success = true;
         return result;
@@ -281,17 +3195,33 @@ std::future<FaissResult> FaissClient::createCollection(
     int vector_size,
     const std::string& distance)
 {
-    return pImpl->initializeIndex(collection_name, vector_size);
+    return pImpl->initializeIndex(collection_name, vector_size, distance);
+}
+
+std::future<FaissResult> FaissClient::unloadCollection(const std::string& collection_name)
+{
+    return pImpl->unloadCollection(collection_name);
 }
 
 std::future<FaissResult> FaissClient::collectionExists(const std::string& collection_name)
 {
-    return std::async(std::launch::async, [this, collection_name]() -> FaissResult {
+    return TaskExecutor::instance().submit([this, collection_name]() -> FaissResult {
         FaissResult result;
-        
+
+#ifdef USE_FAISS
+        {
+            std::shared_lock<std::shared_mutex> read(pImpl->registry_mutex_);
+            auto it = pImpl->collections_.find(collection_name);
+            if (it != pImpl->collections_.end() && it->second->loaded_)
+            {
+                result.success = true;
+                return result;
+            }
+        }
+#endif
         std::filesystem::path index_dir = pImpl->config_.indexPath;
         std::filesystem::path index_file = index_dir / (collection_name + ".faiss");
-        
+
         result.success = std::filesystem::exists(index_file);
         return result;
     });
@@ -301,117 +3231,102 @@ std::future<FaissResult> FaissClient::upsertPoints(
     const std::string& collection_name,
     const std::vector<FaissPoint>& points)
 {
-    return std::async(std::launch::async, [this, collection_name, points]() -> FaissResult {
-    std::unique_lock<std::mutex> lock(pImpl->mutex_);
-        
+    return TaskExecutor::instance().submit([this, collection_name, points]() -> FaissResult {
         FaissResult result;
         result.success = false;
-        
+
 #ifndef USE_FAISS
         result.error_message = "FAISS support not compiled in";
         return result;
 #else
         try
         {
-            if (!pImpl->initialized_ || !pImpl->index_)
-            {
-                // Attempt lazy initialization using vector dimension from first point
-                if (!points.empty()) {
-                    int dims = static_cast<int>(points.front().vector.size());
-                    ServerLogger::logWarning("FAISS index not initialized. Attempting lazy initialization for collection '%s' with dimension %d", collection_name.c_str(), dims);
-                    // Release lock before calling initializeIndex to avoid deadlock
-                    lock.unlock();
-                    auto init_res = pImpl->initializeIndex(collection_name, dims).get();
-                    // Reacquire lock for subsequent modifications
-                    lock.lock();
-                    if (!init_res.success) {
-                        result.error_message = "Lazy initialization failed: " + init_res.error_message;
-                        return result;
-                    }
-                } else {
-                    result.error_message = "Index not initialized and no points provided to infer dimensions";
-                    return result;
-                }
-            }
-            
             if (points.empty())
             {
                 result.success = true;
                 return result;
             }
-            
-            std::vector<float> vectors;
-            std::vector<faiss::idx_t> ids;
-            
+
+            // A collection seen for the first time is sized from the first point
+            auto collection = pImpl->openCollection(collection_name, static_cast<int>(points.front().vector.size()), "", result);
+            if (!collection)
+            {
+                result.error_message = "Failed to open collection: " + result.error_message;
+                return result;
+            }
+            auto& c = *collection;
+            std::unique_lock<std::mutex> lock(c.mutex_);
+            if (!c.loaded_)
+            {
+                result.error_message = "Collection '" + collection_name + "' was unloaded";
+                result.status_code = 409;
+                return result;
+            }
+
+            // Resolve internal ids up front so the WAL record replays exactly; a point repeated
+            // within the batch keeps its last vector
+            std::vector<Impl::WalPoint> records;
+            std::unordered_map<std::string, size_t> position;
             for (const auto& point : points)
             {
-                // Check if point already exists
-                faiss::idx_t internal_id;
-                auto it = pImpl->id_to_internal_id_.find(point.id);
-                if (it != pImpl->id_to_internal_id_.end())
+                if (static_cast<int>(point.vector.size()) != c.index_->d)
                 {
-                    internal_id = std::stoll(it->second);
+                    result.failed_ids.push_back(point.id);
+                    continue;
                 }
-                else
-                {
-                    internal_id = pImpl->next_internal_id_++;
-                    pImpl->id_to_internal_id_[point.id] = std::to_string(internal_id);
-                    pImpl->internal_id_to_id_[internal_id] = point.id;
-                }
-                
-                // Store payload
-                pImpl->payloads_[point.id] = point.payload;
-                
+
                 // Prepare vector data
                 std::vector<float> normalized_vector = point.vector;
-                if (pImpl->config_.normalizeVectors && pImpl->config_.metricType == "IP")
+                if (c.normalizes())
                 {
-                    // Normalize vector for cosine similarity using inner product
-                    float norm = 0.0f;
-                    for (float val : normalized_vector)
-                    {
-                        norm += val * val;
-                    }
-                    norm = std::sqrt(norm);
-                    if (norm > 0)
-                    {
-                        for (float& val : normalized_vector)
-                        {
-                            val /= norm;
-                        }
-                    }
+                    c.normalize(normalized_vector.data(), normalized_vector.size());
+                }
+
+                auto seen = position.find(point.id);
+                if (seen != position.end())
+                {
+                    records[seen->second].vector = std::move(normalized_vector);
+                    records[seen->second].payload = point.payload;
                 }
-                
-                for (float val : normalized_vector)
+                else
                 {
-                    vectors.push_back(val);
+                    // Every write gets a fresh internal id; the previous one, if any, is tombstoned
+                    const faiss::idx_t internal_id = c.next_internal_id_++;
+                    position[point.id] = records.size();
+                    records.push_back({point.id, internal_id, std::move(normalized_vector), point.payload});
                 }
-                ids.push_back(internal_id);
-                
+
                 result.successful_ids.push_back(point.id);
             }
-            
-            // Add vectors to index
-            pImpl->index_->add_with_ids(points.size(), vectors.data(), ids.data());
-            
-            // Save index after updates (release lock to avoid deadlock)
-            lock.unlock();
-            auto save_result = pImpl->saveIndex().get();
-            // no need to re-lock; we are done modifying shared state
-            if (!save_result.success)
+
+            if (!records.empty())
             {
-                ServerLogger::logWarning("Failed to save index after upsert: %s", save_result.error_message.c_str());
+                if (!c.appendWalLocked(Impl::Collection::encodeUpsert(records)))
+                {
+                    result.successful_ids.clear();
+                    result.error_message = "Failed to write FAISS write-ahead log";
+                    return result;
+                }
+                {
+                    std::unique_lock<std::shared_mutex> write(c.index_mutex_);
+                    c.applyUpsertLocked(records, false);
+                }
+                if (static_cast<size_t>(c.delta_->ntotal) >= c.mergeBatchSize())
+                {
+                    pImpl->requestMerge();
+                }
+                c.waitForWalLocked(lock, c.wal_seq_);
             }
-            
+
             result.success = true;
-            ServerLogger::logInfo("Added %zu points to FAISS index", points.size());
+            KOLOSAL_LOG_INFO("Added %zu points to FAISS collection '%s'", records.size(), collection_name.c_str());
         }
         catch (const std::exception& ex)
         {
             result.error_message = "Failed to upsert points: " + std::string(ex.what());
-            ServerLogger::logError("FAISS upsert error: %s", ex.what());
+            KOLOSAL_LOG_ERROR("FAISS upsert error: %s", ex.what());
         }
-        
+
         return result;
 #endif
     });
@@ -421,39 +3336,35 @@ std::future<FaissResult> FaissClient::deletePoints(
     const std::string& collection_name,
     const std::vector<std::string>& point_ids)
 {
-    return std::async(std::launch::async, [this, collection_name, point_ids]() -> FaissResult {
-    std::unique_lock<std::mutex> lock(pImpl->mutex_);
-        
+    return TaskExecutor::instance().submit([this, collection_name, point_ids]() -> FaissResult {
         FaissResult result;
         result.success = false;
-        
+
 #ifndef USE_FAISS
         result.error_message = "FAISS support not compiled in";
         return result;
-#else        
+#else
         try
         {
-            if (!pImpl->initialized_ || !pImpl->index_)
+            auto collection = pImpl->openCollection(collection_name, 0, "", result);
+            if (!collection)
             {
-                result.error_message = "Index not initialized";
                 return result;
             }
-            
-            std::vector<faiss::idx_t> ids_to_remove;
-            
+            auto& c = *collection;
+            std::unique_lock<std::mutex> lock(c.mutex_);
+            if (!c.loaded_)
+            {
+                result.error_message = "Collection '" + collection_name + "' was unloaded";
+                result.status_code = 409;
+                return result;
+            }
+
             for (const std::string& point_id : point_ids)
             {
-                auto it = pImpl->id_to_internal_id_.find(point_id);
-                if (it != pImpl->id_to_internal_id_.end())
+                int64_t internal_id;
+                if (c.points_.find(point_id, internal_id))
                 {
-                    faiss::idx_t internal_id = std::stoll(it->second);
-                    ids_to_remove.push_back(internal_id);
-                    
-                    // Clean up mappings
-                    pImpl->internal_id_to_id_.erase(internal_id);
-                    pImpl->id_to_internal_id_.erase(it);
-                    pImpl->payloads_.erase(point_id);
-                    
                     result.successful_ids.push_back(point_id);
                 }
                 else
@@ -461,31 +3372,33 @@ std::future<FaissResult> FaissClient::deletePoints(
                     result.failed_ids.push_back(point_id);
                 }
             }
-            
-            // Remove from index
-            if (!ids_to_remove.empty())
+
+            // Log, then remove from index
+            size_t removed = 0;
+            if (!result.successful_ids.empty())
             {
-                pImpl->index_->remove_ids(faiss::IDSelectorArray(ids_to_remove.size(), ids_to_remove.data()));
-                
-                // Save index after deletion (release lock to avoid deadlock)
-                lock.unlock();
-                auto save_result = pImpl->saveIndex().get();
-                // no need to re-lock; function is exiting
-                if (!save_result.success)
+                if (!c.appendWalLocked(Impl::Collection::encodeDelete(result.successful_ids)))
                 {
-                    ServerLogger::logWarning("Failed to save index after delete: %s", save_result.error_message.c_str());
+                    result.successful_ids.clear();
+                    result.error_message = "Failed to write FAISS write-ahead log";
+                    return result;
+                }
+                {
+                    std::unique_lock<std::shared_mutex> write(c.index_mutex_);
+                    removed = c.applyDeleteLocked(result.successful_ids);
                 }
+                c.waitForWalLocked(lock, c.wal_seq_);
             }
-            
+
             result.success = true;
-            ServerLogger::logInfo("Removed %zu points from FAISS index", ids_to_remove.size());
+            KOLOSAL_LOG_INFO("Removed %zu points from FAISS collection '%s'", removed, collection_name.c_str());
         }
         catch (const std::exception& ex)
         {
             result.error_message = "Failed to delete points: " + std::string(ex.what());
-            ServerLogger::logError("FAISS delete error: %s", ex.what());
+            KOLOSAL_LOG_ERROR("FAISS delete error: %s", ex.what());
         }
-        
+
         return result;
 #endif
     });
@@ -495,40 +3408,52 @@ std::future<FaissResult> FaissClient::getPoints(
     const std::string& collection_name,
     const std::vector<std::string>& point_ids)
 {
-    return std::async(std::launch::async, [this, collection_name, point_ids]() -> FaissResult {
-        std::lock_guard<std::mutex> lock(pImpl->mutex_);
-        
+    return TaskExecutor::instance().submit([this, collection_name, point_ids]() -> FaissResult {
         FaissResult result;
         result.success = false;
-        
+
 #ifndef USE_FAISS
         result.error_message = "FAISS support not compiled in";
         return result;
-#else        
+#else
         try
         {
             // Return an array in result field for parity with Qdrant expectations in DocumentService
             nlohmann::json response_points = nlohmann::json::array();
-            for (const std::string& point_id : point_ids)
+            FaissResult opened;
+            auto collection = pImpl->openCollection(collection_name, 0, "", opened);
+            if (collection)
             {
-                auto payload_it = pImpl->payloads_.find(point_id);
-                if (payload_it != pImpl->payloads_.end())
+                std::shared_lock<std::shared_mutex> lock(collection->index_mutex_);
+                for (const std::string& point_id : point_ids)
                 {
-                    nlohmann::json point;
-                    point["id"] = point_id;
-                    point["payload"] = payload_it->second;
-                    response_points.push_back(point);
+                    int64_t internal_id;
+                    nlohmann::json payload;
+                    if (collection->points_.find(point_id, internal_id) &&
+                        collection->points_.payload(internal_id, payload))
+                    {
+                        nlohmann::json point;
+                        point["id"] = point_id;
+                        point["payload"] = std::move(payload);
+                        response_points.push_back(point);
+                    }
                 }
             }
+            else if (opened.status_code != 404)
+            {
+                result.error_message = opened.error_message;
+                result.status_code = opened.status_code;
+                return result;
+            }
             result.response_data["result"] = response_points;
             result.success = true;
         }
         catch (const std::exception& ex)
         {
             result.error_message = "Failed to get points: " + std::string(ex.what());
-            ServerLogger::logError("FAISS getPoints error: %s", ex.what());
+            KOLOSAL_LOG_ERROR("FAISS getPoints error: %s", ex.what());
         }
-        
+
         return result;
 #endif
     });
@@ -538,165 +3463,272 @@ std::future<FaissResult> FaissClient::search(
     const std::string& collection_name,
     const std::vector<float>& query_vector,
     int limit,
-    float score_threshold)
+    float score_threshold,
+    const FaissSearchParams& params)
+{
+    return TaskExecutor::instance().submit([this, collection_name, query_vector, limit, score_threshold, params]() -> FaissResult {
+        auto result = pImpl->searchBatch(collection_name, {query_vector}, limit, score_threshold, params);
+        if (result.success)
+        {
+            // Single-query callers get the flat hit list
+            nlohmann::json hits = result.response_data["result"][0];
+            result.response_data["result"] = std::move(hits);
+        }
+        return result;
+    });
+}
+
+std::future<FaissResult> FaissClient::searchBatch(
+    const std::string& collection_name,
+    const std::vector<std::vector<float>>& query_vectors,
+    int limit,
+    float score_threshold,
+    const FaissSearchParams& params)
 {
-    return std::async(std::launch::async, [this, collection_name, query_vector, limit, score_threshold]() -> FaissResult {
-        std::unique_lock<std::mutex> lock(pImpl->mutex_);
-        
+    return TaskExecutor::instance().submit([this, collection_name, query_vectors, limit, score_threshold, params]() -> FaissResult {
+        return pImpl->searchBatch(collection_name, query_vectors, limit, score_threshold, params);
+    });
+}
+
+std::future<FaissResult> FaissClient::scrollPoints(
+    const std::string& collection_name,
+    int limit,
+    const std::string& offset,
+    bool with_payload,
+    const nlohmann::json& filter)
+{
+    return TaskExecutor::instance().submit([this, collection_name, limit, offset, with_payload, filter]() -> FaissResult {
         FaissResult result;
         result.success = false;
-        
+
 #ifndef USE_FAISS
         result.error_message = "FAISS support not compiled in";
         return result;
-#else        
+#else
         try
         {
-            if (!pImpl->initialized_ || !pImpl->index_)
-            {
-                // Try lazy load from disk
-                ServerLogger::logWarning("FAISS search requested but index not initialized. Attempting to load existing index '%s'", collection_name.c_str());
-                // Release lock to avoid deadlock
-                lock.unlock();
-                auto init_res = pImpl->initializeIndex(collection_name, static_cast<int>(query_vector.size())).get();
-                // Reacquire lock to continue safely
-                lock.lock();
-                if (!init_res.success || !pImpl->index_) {
-                    result.error_message = "Index not initialized and lazy load failed";
+            nlohmann::json points = nlohmann::json::array();
+            // The cursor is the internal id the next page starts at
+            int64_t start_id = std::numeric_limits<int64_t>::min();
+            if (!offset.empty())
+            {
+                size_t parsed = 0;
+                try
+                {
+                    start_id = std::stoll(offset, &parsed);
+                }
+                catch (const std::logic_error&)
+                {
+                }
+                if (parsed != offset.size())
+                {
+                    result.status_code = 400;
+                    result.error_message = "Invalid scroll offset '" + offset + "'";
                     return result;
                 }
             }
-            
-            // Normalize query vector if needed
-            std::vector<float> normalized_query = query_vector;
-            if (pImpl->config_.normalizeVectors && pImpl->config_.metricType == "IP")
+            std::string next_offset;
+            FaissResult opened;
+            auto collection = pImpl->openCollection(collection_name, 0, "", opened);
+            if (collection)
             {
-                float norm = 0.0f;
-                for (float val : normalized_query)
+                // Pages follow internal id order, which is stable across checkpoints and reloads,
+                // and each one starts with a binary search instead of skipping the pages before it
+                std::shared_lock<std::shared_mutex> lock(collection->index_mutex_);
+                const auto& store = collection->points_;
+                const size_t page_size = static_cast<size_t>(std::max(limit, 0));
+                auto visit = [&](int64_t internal_id, const std::string& id) {
+                    if (points.size() >= page_size)
+                    {
+                        next_offset = std::to_string(internal_id);
+                        return false;
+                    }
+                    nlohmann::json point;
+                    point["id"] = id;
+                    nlohmann::json payload;
+                    if (with_payload && store.payload(internal_id, payload))
+                    {
+                        point["payload"] = std::move(payload);
+                    }
+                    points.push_back(std::move(point));
+                    return true;
+                };
+                if (filter.is_null())
                 {
-                    norm += val * val;
+                    store.forEach(visit, start_id);
                 }
-                norm = std::sqrt(norm);
-                if (norm > 0)
+                else
                 {
-                    for (float& val : normalized_query)
+                    // Matching ids come from the payload field indexes, so only they are visited
+                    std::vector<uint8_t> bitmap;
+                    std::string filter_error;
+                    const int64_t id_limit = collection->next_internal_id_.load();
+                    if (!store.select(filter, id_limit, bitmap, filter_error))
+                    {
+                        result.error_message = "Invalid filter: " + filter_error;
+                        result.status_code = 400;
+                        return result;
+                    }
+                    std::string id;
+                    for (int64_t internal_id = std::max<int64_t>(start_id, 0); internal_id < id_limit; ++internal_id)
                     {
-                        val /= norm;
+                        const uint8_t bits = bitmap[static_cast<size_t>(internal_id >> 3)];
+                        if (bits == 0)
+                        {
+                            internal_id |= 7;   // Skip the rest of an empty byte
+                            continue;
+                        }
+                        if ((bits >> (internal_id & 7)) & 1 && store.externalId(internal_id, id) && !visit(internal_id, id))
+                        {
+                            break;
+                        }
                     }
                 }
             }
-            
-            // Perform search
-            std::vector<faiss::idx_t> internal_ids(limit);
-            std::vector<float> distances(limit);
-            
-            pImpl->index_->search(1, normalized_query.data(), limit, distances.data(), internal_ids.data());
-            
-            // Convert results to JSON format
-            nlohmann::json search_results = nlohmann::json::array();
-            
-            for (int i = 0; i < limit; ++i)
-            {
-                if (internal_ids[i] < 0) break; // No more results
-                
-                float score = distances[i];
-                
-                // Convert distance to similarity score based on metric type
-                if (pImpl->config_.metricType == "L2")
-                {
-                    score = 1.0f / (1.0f + score); // Convert L2 distance to similarity
-                }
-                // For IP, the score is already similarity (higher is better)
-                
-                if (score < score_threshold) continue;
-                
-                auto it = pImpl->internal_id_to_id_.find(internal_ids[i]);
-                if (it != pImpl->internal_id_to_id_.end())
-                {
-                    std::string external_id = it->second;
-                    
-                    nlohmann::json search_result;
-                    search_result["id"] = external_id;
-                    search_result["score"] = score;
-                    
-                    // Add payload if available
-                    auto payload_it = pImpl->payloads_.find(external_id);
-                    if (payload_it != pImpl->payloads_.end())
-                    {
-                        search_result["payload"] = payload_it->second;
-                    }
-                    
-                    search_results.push_back(search_result);
-                }
-            }
-            
-            result.response_data["result"] = search_results;
+            else if (opened.status_code != 404)
+            {
+                result.error_message = opened.error_message;
+                result.status_code = opened.status_code;
+                return result;
+            }
+            // Provide array directly for consistency with getPoints/search format
+            result.response_data["result"] = points;
+            if (!next_offset.empty())
+            {
+                result.response_data["next_page_offset"] = next_offset;
+            }
             result.success = true;
-            
-            ServerLogger::logDebug("FAISS search found %zu results", search_results.size());
         }
         catch (const std::exception& ex)
         {
-            result.error_message = "Failed to search: " + std::string(ex.what());
-            ServerLogger::logError("FAISS search error: %s", ex.what());
+            result.error_message = "Failed to scroll points: " + std::string(ex.what());
+            KOLOSAL_LOG_ERROR("FAISS scrollPoints error: %s", ex.what());
         }
-        
+
         return result;
 #endif
     });
 }
 
-std::future<FaissResult> FaissClient::scrollPoints(
-    const std::string& collection_name,
-    int limit,
-    const std::string& offset)
+FaissResult FaissClient::exportSnapshot(const std::string& collection_name,
+                                        const std::function<bool(const char*, size_t)>& sink)
+{
+    return pImpl->exportSnapshot(collection_name, sink);
+}
+
+FaissResult FaissClient::importSnapshot(const std::string& collection_name, std::istream& in)
+{
+    return pImpl->importSnapshot(collection_name, in);
+}
+
+FaissResult FaissClient::readChanges(const std::string& collection_name, const std::string& epoch, uint64_t position,
+                                     size_t max_bytes, std::string& records)
+{
+    return pImpl->readChanges(collection_name, epoch, position, max_bytes, records);
+}
+
+std::future<FaissResult> FaissClient::applyChanges(const std::string& collection_name, std::string records)
 {
-    return std::async(std::launch::async, [this, collection_name, limit, offset]() -> FaissResult {
-        std::lock_guard<std::mutex> lock(pImpl->mutex_);
-        
+    return TaskExecutor::instance().submit([this, collection_name, records = std::move(records)]() -> FaissResult {
         FaissResult result;
         result.success = false;
-        
+
 #ifndef USE_FAISS
         result.error_message = "FAISS support not compiled in";
         return result;
-#else        
+#else
         try
         {
-            nlohmann::json points = nlohmann::json::array();
-            size_t start_idx = 0;
-            if (!offset.empty())
+            // Every record is checked before any is applied, so a damaged batch changes nothing
+            std::vector<std::pair<std::string, Impl::WalRecord>> decoded;
+            size_t offset = 0;
+            while (offset < records.size())
             {
-                start_idx = std::stoull(offset);
+                uint32_t length = 0, checksum = 0;
+                Impl::WalRecord record;
+                if (records.size() - offset < kWalHeaderBytes)
+                {
+                    offset = std::string::npos;
+                    break;
+                }
+                std::memcpy(&length, records.data() + offset, sizeof(length));
+                std::memcpy(&checksum, records.data() + offset + sizeof(length), sizeof(checksum));
+                const char* payload = records.data() + offset + kWalHeaderBytes;
+                if (length > records.size() - offset - kWalHeaderBytes ||
+                    crc32(0L, reinterpret_cast<const Bytef*>(payload), length) != checksum ||
+                    !Impl::Collection::decodeWalRecord(payload, length, record))
+                {
+                    offset = std::string::npos;
+                    break;
+                }
+                decoded.emplace_back(std::string(payload, length), std::move(record));
+                offset += kWalHeaderBytes + length;
             }
-            size_t count = 0;
-            size_t current_idx = 0;
-            for (const auto& item : pImpl->payloads_)
+            if (offset == std::string::npos)
+            {
+                result.error_message = "Change record " + std::to_string(decoded.size()) + " is damaged";
+                result.status_code = 400;
+                return result;
+            }
+
+            auto collection = pImpl->openCollection(collection_name, 0, "", result);
+            if (!collection)
+            {
+                return result;
+            }
+            auto& c = *collection;
+            std::unique_lock<std::mutex> lock(c.mutex_);
+            if (!c.loaded_)
+            {
+                result.error_message = "Collection '" + collection_name + "' was unloaded";
+                result.status_code = 409;
+                return result;
+            }
+
+            // Logged in the replica's own WAL first, exactly as the source wrote them
+            nlohmann::json changes = nlohmann::json::array();
+            size_t applied = 0;
+            for (auto& [payload, record] : decoded)
             {
-                if (current_idx >= start_idx && count < static_cast<size_t>(limit))
+                if (!c.appendWalLocked(payload))
                 {
-                    nlohmann::json point;
-                    point["id"] = item.first;
-                    point["payload"] = item.second;
-                    points.push_back(point);
-                    count++;
+                    result.error_message = "Failed to write FAISS write-ahead log";
+                    break;
+                }
+                {
+                    std::unique_lock<std::shared_mutex> write(c.index_mutex_);
+                    c.applyWalRecordLocked(record);
+                }
+                for (const auto& point : record.points)
+                {
+                    changes.push_back({{"op", "upsert"}, {"id", point.id}, {"payload", point.payload}});
+                }
+                for (const auto& id : record.ids)
+                {
+                    changes.push_back({{"op", "delete"}, {"id", id}});
                 }
-                current_idx++;
+                ++applied;
             }
-            // Provide array directly for consistency with getPoints/search format
-            result.response_data["result"] = points;
-            if (current_idx > start_idx + limit)
+            if (static_cast<size_t>(c.delta_->ntotal) >= c.mergeBatchSize())
             {
-                result.response_data["next_page_offset"] = std::to_string(start_idx + limit);
+                pImpl->requestMerge();
+            }
+            c.waitForWalLocked(lock, c.wal_seq_);
+
+            result.response_data = {{"records", applied}, {"changes", std::move(changes)}};
+            result.success = applied == decoded.size();
+            if (!result.success)
+            {
+                result.status_code = 500;
             }
-            result.success = true;
         }
         catch (const std::exception& ex)
         {
-            result.error_message = "Failed to scroll points: " + std::string(ex.what());
-            ServerLogger::logError("FAISS scrollPoints error: %s", ex.what());
+            result.error_message = "Failed to apply changes: " + std::string(ex.what());
+            result.status_code = 500;
+            KOLOSAL_LOG_ERROR("FAISS apply changes error: %s", ex.what());
         }
-        
+
         return result;
 #endif
     });
@@ -0,0 +1,1276 @@
+#include "kolosal/faiss_point_store.hpp"
+#include "kolosal/logger.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <queue>
+#include <vector>
+#include <zlib.h>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace kolosal
+{
+
+namespace
+{
+    constexpr uint32_t kMagic = 0x5350464B;  // "KFPS"
+    constexpr uint32_t kVersion = 2;
+    constexpr size_t kHeaderBytesV1 = 32;    // magic, version, count, ids offset, hashes offset
+    constexpr size_t kHeaderBytes = 48;      // ... dictionary offset, dictionary length
+    constexpr size_t kSlotBytes = 16;        // Both tables hold two 8-byte fields per point
+
+    // Text compression
+    constexpr size_t kMinCompressBytes = 64;         // Shorter strings are stored as they are
+    constexpr size_t kDictionaryBytes = 32768 - 262; // Deflate reaches back no further than this
+    constexpr size_t kMinTrainingValues = 64;        // Strings needed before a dictionary is trained
+    constexpr size_t kTrainingSampleBytes = 4 << 20; // Text sampled for training
+    constexpr size_t kTrainingSamplePoints = 4096;   // Points sampled for training, evenly spread
+    constexpr size_t kDmerBytes = 8;                 // Substring length whose spread across points is counted
+    constexpr size_t kSegmentBytes = 64;             // Unit the dictionary is assembled from
+
+    std::atomic<uint64_t> g_raw_bytes{0};
+    std::atomic<uint64_t> g_stored_bytes{0};
+    std::atomic<uint64_t> g_inflations{0};
+    std::atomic<uint64_t> g_inflate_nanos{0};
+    std::atomic<uint64_t> g_dictionaries{0};
+    const std::string kNoDictionary;
+
+    // Stable across builds and platforms, unlike std::hash
+    uint64_t hashId(std::string_view id)
+    {
+        uint64_t hash = 14695981039346656037ULL;
+        for (unsigned char c : id)
+        {
+            hash ^= c;
+            hash *= 1099511628211ULL;
+        }
+        return hash;
+    }
+
+    template <typename T>
+    T readValue(const char* data)
+    {
+        T value;
+        std::memcpy(&value, data, sizeof(T));
+        return value;
+    }
+
+    template <typename T>
+    bool writeValue(std::FILE* file, T value)
+    {
+        return std::fwrite(&value, sizeof(T), 1, file) == 1;
+    }
+
+    // Raw deflate of text against the dictionary, after its u32 length; empty if that is no smaller
+    std::vector<uint8_t> deflateText(const std::string& text, const std::string& dictionary)
+    {
+        // One stream per thread; deflateReset keeps its buffers for the next value
+        struct Stream
+        {
+            z_stream z{};
+            bool ready = false;
+            ~Stream()
+            {
+                if (ready)
+                    deflateEnd(&z);
+            }
+        };
+        thread_local Stream stream;
+        if (!stream.ready)
+        {
+            if (deflateInit2(&stream.z, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+                return {};
+            stream.ready = true;
+        }
+        z_stream& z = stream.z;
+        deflateReset(&z);
+        if (deflateSetDictionary(&z, reinterpret_cast<const Bytef*>(dictionary.data()),
+                                 static_cast<uInt>(dictionary.size())) != Z_OK)
+            return {};
+
+        const uint32_t length = static_cast<uint32_t>(text.size());
+        std::vector<uint8_t> out(sizeof(length) + deflateBound(&z, static_cast<uLong>(text.size())));
+        std::memcpy(out.data(), &length, sizeof(length));
+        z.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(text.data()));
+        z.avail_in = static_cast<uInt>(text.size());
+        z.next_out = out.data() + sizeof(length);
+        z.avail_out = static_cast<uInt>(out.size() - sizeof(length));
+        if (deflate(&z, Z_FINISH) != Z_STREAM_END)
+            return {};
+        out.resize(out.size() - z.avail_out);
+        if (out.size() >= text.size())
+            return {};
+        return out;
+    }
+
+    bool inflateText(const std::vector<uint8_t>& bytes, const std::string& dictionary, std::string& text)
+    {
+        struct Stream
+        {
+            z_stream z{};
+            bool ready = false;
+            ~Stream()
+            {
+                if (ready)
+                    inflateEnd(&z);
+            }
+        };
+        thread_local Stream stream;
+        uint32_t length = 0;
+        if (bytes.size() < sizeof(length) || dictionary.empty())
+            return false;
+        if (!stream.ready)
+        {
+            if (inflateInit2(&stream.z, -15) != Z_OK)
+                return false;
+            stream.ready = true;
+        }
+        z_stream& z = stream.z;
+        inflateReset(&z);
+        // A raw stream takes its dictionary up front
+        if (inflateSetDictionary(&z, reinterpret_cast<const Bytef*>(dictionary.data()),
+                                 static_cast<uInt>(dictionary.size())) != Z_OK)
+            return false;
+
+        std::memcpy(&length, bytes.data(), sizeof(length));
+        text.resize(length);
+        z.next_in = const_cast<Bytef*>(bytes.data() + sizeof(length));
+        z.avail_in = static_cast<uInt>(bytes.size() - sizeof(length));
+        z.next_out = reinterpret_cast<Bytef*>(text.data());
+        z.avail_out = static_cast<uInt>(length);
+        return inflate(&z, Z_FINISH) == Z_STREAM_END && z.avail_out == 0;
+    }
+
+    // With a dictionary, long top-level strings are stored compressed as CBOR byte strings,
+    // which JSON payloads never contain otherwise
+    std::string encodePayload(nlohmann::json payload, const std::string& dictionary)
+    {
+        if (!dictionary.empty() && payload.is_object())
+        {
+            for (auto& value : payload)
+            {
+                if (!value.is_string() || value.get_ref<const std::string&>().size() < kMinCompressBytes)
+                    continue;
+                const std::string& text = value.get_ref<const std::string&>();
+                auto compressed = deflateText(text, dictionary);
+                if (compressed.empty())
+                    continue;
+                g_raw_bytes.fetch_add(text.size(), std::memory_order_relaxed);
+                g_stored_bytes.fetch_add(compressed.size(), std::memory_order_relaxed);
+                value = nlohmann::json::binary(std::move(compressed));
+            }
+        }
+        const auto bytes = nlohmann::json::to_cbor(payload);
+        return std::string(bytes.begin(), bytes.end());
+    }
+
+    // Turns compressed values of a decoded payload back into strings
+    bool inflatePayload(nlohmann::json& payload, const std::string& dictionary)
+    {
+        if (!payload.is_object())
+            return true;
+        for (auto& value : payload)
+        {
+            if (!value.is_binary())
+                continue;
+            const auto started = std::chrono::steady_clock::now();
+            std::string text;
+            if (!inflateText(value.get_binary(), dictionary, text))
+                return false;
+            value = std::move(text);
+            g_inflations.fetch_add(1, std::memory_order_relaxed);
+            g_inflate_nanos.fetch_add(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                          std::chrono::steady_clock::now() - started).count()),
+                                      std::memory_order_relaxed);
+        }
+        return true;
+    }
+
+    bool decodePayload(std::string_view bytes, nlohmann::json& payload)
+    {
+        payload = nlohmann::json::from_cbor(bytes.begin(), bytes.end(), true, false);
+        return !payload.is_discarded();
+    }
+
+    // Greedy selection in the manner of zstd's COVER trainer: 8-byte substrings are scored by
+    // how many samples contain them, and the 64-byte segments covering the most valuable ones
+    // not yet covered are taken until the dictionary is full
+    std::string trainDictionary(const std::vector<std::string>& samples)
+    {
+        auto dmerAt = [](const std::string& sample, size_t pos) {
+            uint64_t dmer;
+            std::memcpy(&dmer, sample.data() + pos, kDmerBytes);
+            return dmer;
+        };
+
+        std::unordered_map<uint64_t, uint32_t> spread;
+        std::unordered_set<uint64_t> seen;
+        for (const auto& sample : samples)
+        {
+            seen.clear();
+            for (size_t pos = 0; pos + kDmerBytes <= sample.size(); ++pos)
+            {
+                if (seen.insert(dmerAt(sample, pos)).second)
+                    ++spread[dmerAt(sample, pos)];
+            }
+        }
+
+        struct Segment
+        {
+            uint64_t score;
+            uint32_t sample;
+            uint32_t offset;
+            bool operator<(const Segment& other) const { return score < other.score; }
+        };
+        // Substrings found in one sample only would not help another one
+        auto score = [&](uint32_t sample, uint32_t offset) {
+            const std::string& text = samples[sample];
+            const size_t end = std::min(text.size(), static_cast<size_t>(offset) + kSegmentBytes);
+            uint64_t total = 0;
+            for (size_t pos = offset; pos + kDmerBytes <= end; ++pos)
+            {
+                const uint32_t count = spread[dmerAt(text, pos)];
+                if (count > 1)
+                    total += count;
+            }
+            return total;
+        };
+
+        std::priority_queue<Segment> queue;
+        for (uint32_t sample = 0; sample < samples.size(); ++sample)
+        {
+            for (uint32_t offset = 0; offset + kDmerBytes <= samples[sample].size(); offset += kSegmentBytes)
+            {
+                if (const uint64_t value = score(sample, offset))
+                    queue.push({value, sample, offset});
+            }
+        }
+
+        // Scores only fall as segments are taken, so a popped one is rescored and kept only if it still leads
+        std::vector<std::string_view> chosen;
+        size_t total = 0;
+        while (!queue.empty() && total < kDictionaryBytes)
+        {
+            Segment top = queue.top();
+            queue.pop();
+            top.score = score(top.sample, top.offset);
+            if (top.score == 0)
+                continue;
+            if (!queue.empty() && top.score < queue.top().score)
+            {
+                queue.push(top);
+                continue;
+            }
+            const std::string& text = samples[top.sample];
+            const size_t length = std::min({kSegmentBytes, text.size() - top.offset, kDictionaryBytes - total});
+            chosen.emplace_back(text.data() + top.offset, length);
+            total += length;
+            for (size_t pos = top.offset; pos + kDmerBytes <= top.offset + length; ++pos)
+                spread[dmerAt(text, pos)] = 0;
+        }
+
+        // Deflate codes short distances in fewer bits, so the best segments go last, next to the data
+        std::string dictionary;
+        dictionary.reserve(total);
+        for (auto it = chosen.rbegin(); it != chosen.rend(); ++it)
+            dictionary.append(it->data(), it->size());
+        return dictionary;
+    }
+
+    // Reads the head of the CBOR data item at pos: its major type and its argument (a value,
+    // a length or an item count). Indefinite lengths, which to_cbor never writes, are rejected.
+    bool cborHead(std::string_view bytes, size_t& pos, uint8_t& major, uint64_t& argument)
+    {
+        if (pos >= bytes.size())
+            return false;
+        const uint8_t initial = static_cast<uint8_t>(bytes[pos++]);
+        major = initial >> 5;
+        const uint8_t info = initial & 0x1f;
+        if (info < 24)
+        {
+            argument = info;
+            return true;
+        }
+        if (info > 27)
+            return false;
+        const size_t width = size_t(1) << (info - 24);
+        if (bytes.size() - pos < width)
+            return false;
+        argument = 0;
+        for (size_t i = 0; i < width; ++i)
+            argument = argument << 8 | static_cast<uint8_t>(bytes[pos++]);
+        return true;
+    }
+
+    // Moves pos past the CBOR data item starting there
+    bool cborSkip(std::string_view bytes, size_t& pos, int depth = 0)
+    {
+        uint8_t major = 0;
+        uint64_t argument = 0;
+        if (depth > 64 || !cborHead(bytes, pos, major, argument))
+            return false;
+        switch (major)
+        {
+        case 2:
+        case 3:
+            if (bytes.size() - pos < argument)
+                return false;
+            pos += static_cast<size_t>(argument);
+            return true;
+        case 4:
+        case 5:
+            for (uint64_t i = 0; i < (major == 5 ? 2 : 1) * argument; ++i)
+            {
+                if (!cborSkip(bytes, pos, depth + 1))
+                    return false;
+            }
+            return true;
+        case 6:
+            return cborSkip(bytes, pos, depth + 1);
+        default:
+            return true;    // Integers, simple values and floats end with their head
+        }
+    }
+
+    // Decodes only the values of the listed top-level keys; the rest are skipped undecoded
+    bool decodeFields(std::string_view bytes, const std::vector<std::string>& fields, nlohmann::json& payload)
+    {
+        size_t pos = 0;
+        uint8_t major = 0;
+        uint64_t count = 0;
+        if (!cborHead(bytes, pos, major, count) || major != 5)
+        {
+            // Not a definite-length map: decode it whole and drop the other keys
+            if (!decodePayload(bytes, payload))
+                return false;
+            if (payload.is_object())
+            {
+                for (auto it = payload.begin(); it != payload.end();)
+                    it = std::find(fields.begin(), fields.end(), it.key()) == fields.end() ? payload.erase(it) : std::next(it);
+            }
+            return true;
+        }
+
+        payload = nlohmann::json::object();
+        for (uint64_t i = 0; i < count; ++i)
+        {
+            uint64_t length = 0;
+            if (!cborHead(bytes, pos, major, length) || major != 3 || bytes.size() - pos < length)
+                return false;
+            const std::string_view key = bytes.substr(pos, static_cast<size_t>(length));
+            pos += static_cast<size_t>(length);
+            const size_t start = pos;
+            if (!cborSkip(bytes, pos))
+                return false;
+            if (std::find(fields.begin(), fields.end(), key) != fields.end())
+            {
+                auto value = nlohmann::json::from_cbor(bytes.begin() + start, bytes.begin() + pos, true, false);
+                if (value.is_discarded())
+                    return false;
+                payload[std::string(key)] = std::move(value);
+            }
+        }
+        return true;
+    }
+
+    // Scalar values of a dotted payload key; arrays contribute each scalar element
+    void fieldValues(const nlohmann::json& payload, const std::string& key, std::vector<const nlohmann::json*>& values)
+    {
+        const nlohmann::json* node = &payload;
+        size_t start = 0;
+        while (true)
+        {
+            const size_t dot = key.find('.', start);
+            const std::string part = key.substr(start, dot == std::string::npos ? std::string::npos : dot - start);
+            if (!node->is_object())
+                return;
+            auto it = node->find(part);
+            if (it == node->end())
+                return;
+            node = &*it;
+            if (dot == std::string::npos)
+                break;
+            start = dot + 1;
+        }
+        if (node->is_array())
+        {
+            for (const auto& element : *node)
+            {
+                if (element.is_primitive() && !element.is_null())
+                    values.push_back(&element);
+            }
+        }
+        else if (node->is_primitive() && !node->is_null())
+        {
+            values.push_back(node);
+        }
+    }
+
+    bool isMatchValue(const nlohmann::json& value)
+    {
+        return value.is_string() || value.is_number() || value.is_boolean();
+    }
+
+    void setBit(std::vector<uint8_t>& bitmap, int64_t id)
+    {
+        if (id >= 0 && static_cast<uint64_t>(id >> 3) < bitmap.size())
+            bitmap[static_cast<size_t>(id >> 3)] |= static_cast<uint8_t>(1u << (id & 7));
+    }
+} // namespace
+
+// Read-only view of a whole file
+class FaissPointStore::MappedFile
+{
+public:
+    ~MappedFile()
+    {
+#ifdef _WIN32
+        if (data_) UnmapViewOfFile(data_);
+        if (mapping_) CloseHandle(mapping_);
+        if (file_ != INVALID_HANDLE_VALUE) CloseHandle(file_);
+#else
+        if (data_) munmap(const_cast<char*>(data_), size_);
+#endif
+    }
+
+    bool map(const std::filesystem::path& path, std::string& error)
+    {
+#ifdef _WIN32
+        // FILE_SHARE_DELETE lets a checkpoint rename a freshly written file while it is mapped
+        file_ = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr,
+                            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        LARGE_INTEGER size{};
+        if (file_ == INVALID_HANDLE_VALUE || !GetFileSizeEx(file_, &size))
+        {
+            error = "Failed to open " + path.string();
+            return false;
+        }
+        size_ = static_cast<size_t>(size.QuadPart);
+        if (size_ == 0)
+        {
+            return true;
+        }
+        mapping_ = CreateFileMappingW(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        data_ = mapping_ ? static_cast<const char*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        struct stat st{};
+        if (fd < 0 || fstat(fd, &st) != 0)
+        {
+            if (fd >= 0) ::close(fd);
+            error = "Failed to open " + path.string();
+            return false;
+        }
+        size_ = static_cast<size_t>(st.st_size);
+        if (size_ == 0)
+        {
+            ::close(fd);
+            return true;
+        }
+        void* data = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);  // The mapping keeps the file alive
+        data_ = data == MAP_FAILED ? nullptr : static_cast<const char*>(data);
+#endif
+        if (!data_)
+        {
+            error = "Failed to map " + path.string();
+            return false;
+        }
+        return true;
+    }
+
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+#ifdef _WIN32
+    HANDLE file_ = INVALID_HANDLE_VALUE;
+    HANDLE mapping_ = nullptr;
+#endif
+};
+
+FaissPointStore::FaissPointStore() = default;
+
+FaissPointStore::~FaissPointStore() = default;
+
+bool FaissPointStore::open(const std::filesystem::path& path, std::string& error)
+{
+    close();
+    if (!std::filesystem::exists(path))
+    {
+        return true;
+    }
+
+    auto file = std::make_unique<MappedFile>();
+    if (!file->map(path, error))
+    {
+        return false;
+    }
+    const char* data = file->data();
+    const size_t size = file->size();
+    if (size < kHeaderBytesV1 || readValue<uint32_t>(data) != kMagic)
+    {
+        error = path.string() + " is not a FAISS points file";
+        return false;
+    }
+    const uint32_t version = readValue<uint32_t>(data + 4);
+    if (version != 1 && version != kVersion)
+    {
+        error = path.string() + " has unsupported version " + std::to_string(version);
+        return false;
+    }
+    const uint64_t count = readValue<uint64_t>(data + 8);
+    const uint64_t ids_offset = readValue<uint64_t>(data + 16);
+    const uint64_t hashes_offset = readValue<uint64_t>(data + 24);
+    const uint64_t table_bytes = count * kSlotBytes;
+    // Version 1 files have the shorter header and no dictionary
+    uint64_t dictionary_offset = 0, dictionary_size = 0;
+    if (version >= 2)
+    {
+        if (size < kHeaderBytes)
+        {
+            error = path.string() + " is truncated";
+            return false;
+        }
+        dictionary_offset = readValue<uint64_t>(data + 32);
+        dictionary_size = readValue<uint64_t>(data + 40);
+    }
+    if (count > size / kSlotBytes || ids_offset > size || size - ids_offset < table_bytes ||
+        hashes_offset > size || size - hashes_offset < table_bytes ||
+        dictionary_offset > size || size - dictionary_offset < dictionary_size)
+    {
+        error = path.string() + " is truncated";
+        return false;
+    }
+
+    dictionary_.assign(data + dictionary_offset, static_cast<size_t>(dictionary_size));
+    file_ = std::move(file);
+    base_count_ = count;
+    ids_offset_ = ids_offset;
+    hashes_offset_ = hashes_offset;
+    return true;
+}
+
+void FaissPointStore::close()
+{
+    file_.reset();
+    base_count_ = 0;
+    ids_offset_ = 0;
+    hashes_offset_ = 0;
+    dictionary_.clear();
+    overlay_.clear();
+    overlay_ids_.clear();
+    removed_.clear();
+    std::lock_guard<std::mutex> lock(field_mutex_);
+    fields_.clear();
+}
+
+size_t FaissPointStore::size() const
+{
+    return static_cast<size_t>(base_count_) - removed_.size() + overlay_.size();
+}
+
+size_t FaissPointStore::pendingChanges() const
+{
+    return overlay_.size() + removed_.size();
+}
+
+size_t FaissPointStore::memoryUsage(size_t& mapped_bytes) const
+{
+    // Hash nodes are counted as their value plus two pointers of bucket and chain overhead
+    constexpr size_t kNode = 2 * sizeof(void*);
+    mapped_bytes = file_ ? file_->size() : 0;
+    size_t bytes = 0;
+    for (const auto& [internal_id, entry] : overlay_)
+        bytes += kNode + sizeof(internal_id) + sizeof(Entry) + entry.id.capacity() + entry.payload.capacity();
+    for (const auto& [id, internal_id] : overlay_ids_)
+        bytes += kNode + sizeof(std::string) + id.capacity() + sizeof(internal_id);
+    bytes += removed_.size() * (kNode + sizeof(int64_t));
+
+    std::lock_guard<std::mutex> lock(field_mutex_);
+    for (const auto& [field, index] : fields_)
+    {
+        bytes += kNode + field.capacity();
+        for (const auto& [key, posting] : index)
+            bytes += kNode + key.capacity() + sizeof(Posting) + posting.ids.size() * (kNode + sizeof(int64_t));
+    }
+    return bytes;
+}
+
+int64_t FaissPointStore::baseInternalId(uint64_t slot) const
+{
+    return readValue<int64_t>(file_->data() + ids_offset_ + slot * kSlotBytes);
+}
+
+bool FaissPointStore::baseSlot(int64_t internal_id, uint64_t& slot) const
+{
+    uint64_t low = 0, high = base_count_;
+    while (low < high)
+    {
+        const uint64_t mid = low + (high - low) / 2;
+        if (baseInternalId(mid) < internal_id)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    if (low < base_count_ && baseInternalId(low) == internal_id)
+    {
+        slot = low;
+        return true;
+    }
+    return false;
+}
+
+bool FaissPointStore::baseRecord(uint64_t slot, Record& record) const
+{
+    const char* data = file_->data();
+    const size_t size = file_->size();
+    const uint64_t offset = readValue<uint64_t>(data + ids_offset_ + slot * kSlotBytes + 8);
+    if (offset > size || size - offset < 4)
+        return false;
+    const uint32_t id_size = readValue<uint32_t>(data + offset);
+    if (size - offset - 4 < static_cast<uint64_t>(id_size) + 4)
+        return false;
+    const uint64_t payload_at = offset + 4 + id_size;
+    const uint32_t payload_size = readValue<uint32_t>(data + payload_at);
+    if (size - payload_at - 4 < payload_size)
+        return false;
+
+    record.bytes = std::string_view(data + offset, 8 + static_cast<size_t>(id_size) + payload_size);
+    record.id = std::string_view(data + offset + 4, id_size);
+    record.payload = std::string_view(data + payload_at + 4, payload_size);
+    return true;
+}
+
+bool FaissPointStore::baseFind(const std::string& id, int64_t& internal_id) const
+{
+    if (base_count_ == 0)
+    {
+        return false;
+    }
+    const char* hashes = file_->data() + hashes_offset_;
+    const uint64_t hash = hashId(id);
+    uint64_t low = 0, high = base_count_;
+    while (low < high)
+    {
+        const uint64_t mid = low + (high - low) / 2;
+        if (readValue<uint64_t>(hashes + mid * kSlotBytes) < hash)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    // Hash collisions are resolved by comparing the stored ids
+    for (; low < base_count_ && readValue<uint64_t>(hashes + low * kSlotBytes) == hash; ++low)
+    {
+        const uint64_t slot = readValue<uint64_t>(hashes + low * kSlotBytes + 8);
+        Record record;
+        if (slot < base_count_ && baseRecord(slot, record) && record.id == id)
+        {
+            internal_id = baseInternalId(slot);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool FaissPointStore::baseLive(int64_t internal_id) const
+{
+    uint64_t slot;
+    return !removed_.count(internal_id) && baseSlot(internal_id, slot);
+}
+
+bool FaissPointStore::find(const std::string& id, int64_t& internal_id) const
+{
+    auto it = overlay_ids_.find(id);
+    if (it != overlay_ids_.end())
+    {
+        internal_id = it->second;
+        return true;
+    }
+    int64_t found;
+    if (baseFind(id, found) && !removed_.count(found))
+    {
+        internal_id = found;
+        return true;
+    }
+    return false;
+}
+
+bool FaissPointStore::contains(int64_t internal_id) const
+{
+    return overlay_.count(internal_id) || baseLive(internal_id);
+}
+
+bool FaissPointStore::externalId(int64_t internal_id, std::string& id) const
+{
+    auto it = overlay_.find(internal_id);
+    if (it != overlay_.end())
+    {
+        id = it->second.id;
+        return true;
+    }
+    uint64_t slot;
+    Record record;
+    if (removed_.count(internal_id) || !baseSlot(internal_id, slot) || !baseRecord(slot, record))
+    {
+        return false;
+    }
+    id.assign(record.id);
+    return true;
+}
+
+bool FaissPointStore::payload(int64_t internal_id, nlohmann::json& payload) const
+{
+    auto it = overlay_.find(internal_id);
+    if (it != overlay_.end())
+    {
+        return decodePayload(it->second.payload, payload) && inflatePayload(payload, dictionary_);
+    }
+    uint64_t slot;
+    Record record;
+    if (removed_.count(internal_id) || !baseSlot(internal_id, slot) || !baseRecord(slot, record))
+    {
+        return false;
+    }
+    return decodePayload(record.payload, payload) && inflatePayload(payload, dictionary_);
+}
+
+bool FaissPointStore::payload(int64_t internal_id, const std::vector<std::string>& fields, nlohmann::json& payload) const
+{
+    if (fields.empty())
+    {
+        return this->payload(internal_id, payload);
+    }
+    auto it = overlay_.find(internal_id);
+    if (it != overlay_.end())
+    {
+        return decodeFields(it->second.payload, fields, payload) && inflatePayload(payload, dictionary_);
+    }
+    uint64_t slot;
+    Record record;
+    if (removed_.count(internal_id) || !baseSlot(internal_id, slot) || !baseRecord(slot, record))
+    {
+        return false;
+    }
+    return decodeFields(record.payload, fields, payload) && inflatePayload(payload, dictionary_);
+}
+
+// The caller holds field_mutex_
+void FaissPointStore::dropLive(int64_t internal_id)
+{
+    nlohmann::json previous;
+    if (!fields_.empty() && payload(internal_id, previous))
+    {
+        indexPointLocked(internal_id, previous, false);
+    }
+
+    auto it = overlay_.find(internal_id);
+    if (it != overlay_.end())
+    {
+        auto id_it = overlay_ids_.find(it->second.id);
+        if (id_it != overlay_ids_.end() && id_it->second == internal_id)
+        {
+            overlay_ids_.erase(id_it);
+        }
+        overlay_.erase(it);
+    }
+    uint64_t slot;
+    if (baseSlot(internal_id, slot))
+    {
+        removed_.insert(internal_id);
+    }
+}
+
+void FaissPointStore::put(const std::string& id, int64_t internal_id, const Payload& payload)
+{
+    std::lock_guard<std::mutex> lock(field_mutex_);
+    int64_t previous;
+    if (find(id, previous))
+    {
+        dropLive(previous);
+    }
+    dropLive(internal_id);
+    nlohmann::json value(payload);
+    overlay_[internal_id] = Entry{id, encodePayload(value, compress_ ? dictionary_ : kNoDictionary)};
+    overlay_ids_[id] = internal_id;
+    if (!fields_.empty())
+    {
+        indexPointLocked(internal_id, value, true);
+    }
+}
+
+bool FaissPointStore::erase(const std::string& id, int64_t& internal_id)
+{
+    if (!find(id, internal_id))
+    {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(field_mutex_);
+    dropLive(internal_id);
+    return true;
+}
+
+void FaissPointStore::indexPointLocked(int64_t internal_id, const nlohmann::json& payload, bool add) const
+{
+    std::vector<const nlohmann::json*> values;
+    for (auto& [key, field] : fields_)
+    {
+        values.clear();
+        fieldValues(payload, key, values);
+        for (const nlohmann::json* value : values)
+        {
+            const std::string text = value->dump();
+            if (add)
+            {
+                auto& posting = field[text];
+                if (posting.ids.empty())
+                    posting.value = *value;
+                posting.ids.insert(internal_id);
+            }
+            else
+            {
+                auto it = field.find(text);
+                if (it != field.end() && it->second.ids.erase(internal_id) && it->second.ids.empty())
+                    field.erase(it);
+            }
+        }
+    }
+}
+
+const FaissPointStore::FieldIndex& FaissPointStore::fieldIndexLocked(const std::string& key) const
+{
+    auto it = fields_.find(key);
+    if (it != fields_.end())
+    {
+        return it->second;
+    }
+
+    // First filter on this field: one pass over the payloads, after which writers keep it current.
+    // Only the top-level key it lives under is decoded, so long texts are neither parsed nor inflated.
+    FieldIndex field;
+    std::vector<const nlohmann::json*> values;
+    const std::vector<std::string> root{key.substr(0, key.find('.'))};
+    nlohmann::json decoded;
+    forEach([&](int64_t internal_id, const std::string&) {
+        values.clear();
+        if (payload(internal_id, root, decoded))
+        {
+            fieldValues(decoded, key, values);
+        }
+        for (const nlohmann::json* value : values)
+        {
+            auto& posting = field[value->dump()];
+            if (posting.ids.empty())
+                posting.value = *value;
+            posting.ids.insert(internal_id);
+        }
+        return true;
+    });
+    return fields_.emplace(key, std::move(field)).first->second;
+}
+
+bool FaissPointStore::select(const nlohmann::json& filter, int64_t id_limit, std::vector<uint8_t>& bitmap, std::string& error) const
+{
+    std::lock_guard<std::mutex> lock(field_mutex_);
+    bitmap.assign(static_cast<size_t>((std::max<int64_t>(id_limit, 0) + 7) / 8), 0);
+    return selectFilterLocked(filter, bitmap, error);
+}
+
+bool FaissPointStore::selectFilterLocked(const nlohmann::json& filter, std::vector<uint8_t>& bitmap, std::string& error) const
+{
+    if (!filter.is_object())
+    {
+        error = "filter must be an object";
+        return false;
+    }
+    std::fill(bitmap.begin(), bitmap.end(), static_cast<uint8_t>(0xFF));
+    std::vector<uint8_t> matched(bitmap.size());
+    std::vector<uint8_t> any;
+    for (const auto& [clause, conditions] : filter.items())
+    {
+        if (clause != "must" && clause != "should" && clause != "must_not")
+        {
+            error = "unsupported filter clause '" + clause + "'";
+            return false;
+        }
+        // A clause holds a list of conditions or a single one
+        const nlohmann::json list = conditions.is_array() ? conditions : nlohmann::json::array({conditions});
+        if (clause == "should")
+        {
+            if (list.empty())
+                continue;
+            any.assign(bitmap.size(), 0);
+        }
+        for (const auto& condition : list)
+        {
+            std::fill(matched.begin(), matched.end(), static_cast<uint8_t>(0));
+            if (!selectConditionLocked(condition, matched, error))
+                return false;
+            for (size_t i = 0; i < bitmap.size(); ++i)
+            {
+                if (clause == "must")
+                    bitmap[i] &= matched[i];
+                else if (clause == "must_not")
+                    bitmap[i] &= static_cast<uint8_t>(~matched[i]);
+                else
+                    any[i] |= matched[i];
+            }
+        }
+        if (clause == "should")
+        {
+            for (size_t i = 0; i < bitmap.size(); ++i)
+                bitmap[i] &= any[i];
+        }
+    }
+    return true;
+}
+
+bool FaissPointStore::selectConditionLocked(const nlohmann::json& condition, std::vector<uint8_t>& bitmap, std::string& error) const
+{
+    if (!condition.is_object())
+    {
+        error = "filter conditions must be objects";
+        return false;
+    }
+    if (condition.contains("must") || condition.contains("should") || condition.contains("must_not"))
+    {
+        return selectFilterLocked(condition, bitmap, error);
+    }
+    auto key = condition.find("key");
+    if (key == condition.end() || !key->is_string())
+    {
+        error = "filter condition needs a string 'key'";
+        return false;
+    }
+    const FieldIndex& field = fieldIndexLocked(key->get<std::string>());
+    auto mark = [&](const Posting& posting) {
+        for (int64_t id : posting.ids)
+            setBit(bitmap, id);
+    };
+
+    auto match = condition.find("match");
+    if (match != condition.end() && match->is_object())
+    {
+        if (match->contains("value") && isMatchValue((*match)["value"]))
+        {
+            auto it = field.find((*match)["value"].dump());
+            if (it != field.end())
+                mark(it->second);
+            return true;
+        }
+        const bool except = match->contains("except");
+        const auto& list = except ? (*match)["except"] : match->value("any", nlohmann::json());
+        if (!list.is_array() || !std::all_of(list.begin(), list.end(), isMatchValue))
+        {
+            error = "'match' needs a scalar 'value' or an 'any'/'except' array of scalars";
+            return false;
+        }
+        std::unordered_set<std::string> listed;
+        for (const auto& value : list)
+            listed.insert(value.dump());
+        for (const auto& [text, posting] : field)
+        {
+            if (listed.count(text) != static_cast<size_t>(except ? 0 : 1))
+                continue;
+            mark(posting);
+        }
+        return true;
+    }
+
+    auto range = condition.find("range");
+    if (range != condition.end() && range->is_object() && !range->empty())
+    {
+        for (const auto& [bound, limit] : range->items())
+        {
+            if ((bound != "gt" && bound != "gte" && bound != "lt" && bound != "lte") || !limit.is_number())
+            {
+                error = "'range' takes numeric gt, gte, lt and lte bounds";
+                return false;
+            }
+        }
+        for (const auto& [text, posting] : field)
+        {
+            if (!posting.value.is_number())
+                continue;
+            const double value = posting.value.get<double>();
+            if ((range->contains("gt") && !(value > (*range)["gt"].get<double>())) ||
+                (range->contains("gte") && !(value >= (*range)["gte"].get<double>())) ||
+                (range->contains("lt") && !(value < (*range)["lt"].get<double>())) ||
+                (range->contains("lte") && !(value <= (*range)["lte"].get<double>())))
+                continue;
+            mark(posting);
+        }
+        return true;
+    }
+
+    error = "filter condition on '" + key->get<std::string>() + "' needs 'match' or 'range'";
+    return false;
+}
+
+void FaissPointStore::forEach(const std::function<bool(int64_t, const std::string&)>& fn, int64_t from) const
+{
+    std::vector<int64_t> pending;
+    pending.reserve(overlay_.size());
+    for (const auto& item : overlay_)
+    {
+        if (item.first >= from)
+        {
+            pending.push_back(item.first);
+        }
+    }
+    std::sort(pending.begin(), pending.end());
+
+    // The ids table is sorted, so a page of a scroll starts without walking the points before it
+    uint64_t first = 0;
+    for (uint64_t count = base_count_; count > 0;)
+    {
+        const uint64_t half = count / 2;
+        if (baseInternalId(first + half) < from)
+        {
+            first += half + 1;
+            count -= half + 1;
+        }
+        else
+        {
+            count = half;
+        }
+    }
+
+    // Merge the mapped ids (already sorted) with the overlay's
+    size_t next = 0;
+    std::string id;
+    for (uint64_t slot = first; slot <= base_count_; ++slot)
+    {
+        const bool has_base = slot < base_count_;
+        const int64_t internal_id = has_base ? baseInternalId(slot) : 0;
+        for (; next < pending.size() && (!has_base || pending[next] < internal_id); ++next)
+        {
+            if (!fn(pending[next], overlay_.at(pending[next]).id))
+                return;
+        }
+        Record record;
+        if (!has_base || removed_.count(internal_id) || !baseRecord(slot, record))
+        {
+            continue;
+        }
+        id.assign(record.id);
+        if (!fn(internal_id, id))
+            return;
+    }
+}
+
+bool FaissPointStore::write(const std::filesystem::path& path, std::string& error) const
+{
+    std::FILE* file = std::fopen(path.string().c_str(), "wb");
+    if (!file)
+    {
+        error = "Failed to create " + path.string();
+        return false;
+    }
+
+    // The first checkpoint that finds enough text trains the dictionary, and every record is
+    // re-encoded with it; after that the file keeps it and records are copied as they are
+    std::string dictionary = dictionary_;
+    if (compress_ && dictionary.empty())
+    {
+        dictionary = trainDictionary(trainingSample());
+        if (!dictionary.empty())
+        {
+            g_dictionaries.fetch_add(1, std::memory_order_relaxed);
+            KOLOSAL_LOG_INFO("Trained a %zu byte text dictionary for %s", dictionary.size(), path.string().c_str());
+        }
+    }
+    const bool recode = dictionary.size() != dictionary_.size();
+
+    std::vector<std::pair<int64_t, uint64_t>> ids;      // internal id, record offset
+    std::vector<std::pair<uint64_t, uint64_t>> hashes;  // id hash, ids table slot
+    ids.reserve(size());
+    hashes.reserve(size());
+    uint64_t offset = kHeaderBytes + dictionary.size();
+    bool ok = std::fseek(file, static_cast<long>(kHeaderBytes), SEEK_SET) == 0 &&
+              std::fwrite(dictionary.data(), 1, dictionary.size(), file) == dictionary.size();
+
+    auto append = [&](int64_t internal_id, std::string_view id, std::string_view bytes) {
+        ok = ok && std::fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+        hashes.emplace_back(hashId(id), ids.size());
+        ids.emplace_back(internal_id, offset);
+        offset += bytes.size();
+    };
+    std::string encoded;
+    auto appendRecord = [&](int64_t internal_id, std::string_view id, std::string_view payload) {
+        nlohmann::json decoded;
+        std::string recoded;
+        if (recode && decodePayload(payload, decoded))
+        {
+            recoded = encodePayload(std::move(decoded), dictionary);
+            payload = recoded;
+        }
+        encoded.clear();
+        const uint32_t id_size = static_cast<uint32_t>(id.size());
+        const uint32_t payload_size = static_cast<uint32_t>(payload.size());
+        encoded.append(reinterpret_cast<const char*>(&id_size), sizeof(id_size));
+        encoded.append(id);
+        encoded.append(reinterpret_cast<const char*>(&payload_size), sizeof(payload_size));
+        encoded.append(payload);
+        append(internal_id, id, encoded);
+    };
+
+    std::vector<int64_t> pending;
+    pending.reserve(overlay_.size());
+    for (const auto& item : overlay_)
+    {
+        pending.push_back(item.first);
+    }
+    std::sort(pending.begin(), pending.end());
+
+    // Same merge as forEach, but checkpointed records are copied byte for byte
+    size_t next = 0;
+    for (uint64_t slot = 0; slot <= base_count_ && ok; ++slot)
+    {
+        const bool has_base = slot < base_count_;
+        const int64_t internal_id = has_base ? baseInternalId(slot) : 0;
+        for (; next < pending.size() && (!has_base || pending[next] < internal_id) && ok; ++next)
+        {
+            const Entry& entry = overlay_.at(pending[next]);
+            appendRecord(pending[next], entry.id, entry.payload);
+        }
+        Record record;
+        if (!has_base || removed_.count(internal_id))
+        {
+            continue;
+        }
+        if (!baseRecord(slot, record))
+        {
+            error = "Corrupt record for internal id " + std::to_string(internal_id);
+            std::fclose(file);
+            return false;
+        }
+        if (recode)
+            appendRecord(internal_id, record.id, record.payload);
+        else
+            append(internal_id, record.id, record.bytes);
+    }
+
+    std::sort(hashes.begin(), hashes.end());
+    const uint64_t ids_offset = offset;
+    const uint64_t hashes_offset = ids_offset + ids.size() * kSlotBytes;
+    for (const auto& [internal_id, record_offset] : ids)
+    {
+        ok = ok && writeValue<int64_t>(file, internal_id) && writeValue<uint64_t>(file, record_offset);
+    }
+    for (const auto& [hash, slot] : hashes)
+    {
+        ok = ok && writeValue<uint64_t>(file, hash) && writeValue<uint64_t>(file, slot);
+    }
+
+    // The header goes last, so a torn write is never mistaken for a complete file
+    ok = ok && std::fseek(file, 0, SEEK_SET) == 0 &&
+         writeValue<uint32_t>(file, kMagic) && writeValue<uint32_t>(file, kVersion) &&
+         writeValue<uint64_t>(file, static_cast<uint64_t>(ids.size())) &&
+         writeValue<uint64_t>(file, ids_offset) && writeValue<uint64_t>(file, hashes_offset) &&
+         writeValue<uint64_t>(file, dictionary.empty() ? 0 : kHeaderBytes) &&
+         writeValue<uint64_t>(file, static_cast<uint64_t>(dictionary.size()));
+    ok = std::fflush(file) == 0 && ok;
+    ok = std::fclose(file) == 0 && ok;
+    if (!ok)
+    {
+        error = "Failed to write " + path.string();
+    }
+    return ok;
+}
+
+bool FaissPointStore::replace(const std::filesystem::path& written, const std::filesystem::path& target, std::string& error)
+{
+    // Map the new file before touching the old one, so a bad file leaves the store as it was
+    FaissPointStore fresh;
+    if (!fresh.open(written, error))
+    {
+        return false;
+    }
+
+#ifdef _WIN32
+    // A mapped file cannot be replaced on Windows
+    file_.reset();
+#endif
+    std::error_code ec;
+    std::filesystem::rename(written, target, ec);
+    if (ec)
+    {
+        error = "Failed to rename " + written.string() + ": " + ec.message();
+#ifdef _WIN32
+        std::string remap_error;
+        auto old = std::make_unique<MappedFile>();
+        if (base_count_ > 0 && old->map(target, remap_error))
+        {
+            file_ = std::move(old);
+        }
+        else
+        {
+            base_count_ = 0;  // Only the overlay is left until the collection is reloaded
+        }
+#endif
+        return false;
+    }
+
+    file_ = std::move(fresh.file_);
+    base_count_ = fresh.base_count_;
+    ids_offset_ = fresh.ids_offset_;
+    hashes_offset_ = fresh.hashes_offset_;
+    dictionary_ = std::move(fresh.dictionary_);
+    overlay_.clear();
+    overlay_ids_.clear();
+    removed_.clear();
+    return true;
+}
+
+std::vector<std::string> FaissPointStore::trainingSample() const
+{
+    // Points spread evenly over the collection, up to a few MB of their long strings
+    const size_t stride = std::max<size_t>(1, size() / kTrainingSamplePoints);
+    std::vector<std::string> samples;
+    size_t index = 0, total = 0;
+    nlohmann::json decoded;
+    forEach([&](int64_t internal_id, const std::string&) {
+        if (index++ % stride != 0 || !payload(internal_id, decoded) || !decoded.is_object())
+            return true;
+        for (const auto& value : decoded)
+        {
+            if (!value.is_string() || value.get_ref<const std::string&>().size() < kMinCompressBytes)
+                continue;
+            total += value.get_ref<const std::string&>().size();
+            samples.push_back(value.get<std::string>());
+        }
+        return total < kTrainingSampleBytes;
+    });
+    if (samples.size() < kMinTrainingValues)
+        samples.clear();
+    return samples;
+}
+
+FaissPointStore::CompressionStats FaissPointStore::compressionStats()
+{
+    CompressionStats stats;
+    stats.raw_bytes = g_raw_bytes.load(std::memory_order_relaxed);
+    stats.stored_bytes = g_stored_bytes.load(std::memory_order_relaxed);
+    stats.inflations = g_inflations.load(std::memory_order_relaxed);
+    stats.inflate_seconds = static_cast<double>(g_inflate_nanos.load(std::memory_order_relaxed)) / 1e9;
+    stats.dictionaries = g_dictionaries.load(std::memory_order_relaxed);
+    return stats;
+}
+
+} // namespace kolosal
@@ -0,0 +1,316 @@
+#include "kolosal/faiss_vector_file.hpp"
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace kolosal
+{
+
+namespace
+{
+    constexpr uint32_t kMagic = 0x4656464B;  // "KFVF"
+    constexpr uint32_t kVersion = 1;
+
+    // Slots of consecutive ids are adjacent, so runs of them take one read or write each
+    template <typename Fn>
+    bool forEachRun(const int64_t* ids, size_t count, Fn&& fn)
+    {
+        std::vector<size_t> order(count);
+        std::iota(order.begin(), order.end(), size_t{0});
+        std::sort(order.begin(), order.end(), [ids](size_t a, size_t b) { return ids[a] < ids[b]; });
+        for (size_t begin = 0; begin < count;)
+        {
+            size_t end = begin + 1;
+            while (end < count && ids[order[end]] == ids[order[end - 1]] + 1)
+            {
+                ++end;
+            }
+            if (!fn(order.data() + begin, end - begin))
+            {
+                return false;
+            }
+            begin = end;
+        }
+        return true;
+    }
+}
+
+#ifdef _WIN32
+namespace
+{
+    bool readAt(HANDLE handle, uint64_t offset, void* data, size_t size)
+    {
+        auto* out = static_cast<char*>(data);
+        while (size > 0)
+        {
+            OVERLAPPED overlapped{};
+            overlapped.Offset = static_cast<DWORD>(offset);
+            overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+            DWORD chunk = static_cast<DWORD>(std::min<size_t>(size, 1u << 30));
+            DWORD done = 0;
+            if (!ReadFile(handle, out, chunk, &done, &overlapped) || done == 0)
+                return false;
+            out += done;
+            offset += done;
+            size -= done;
+        }
+        return true;
+    }
+
+    bool writeAt(HANDLE handle, uint64_t offset, const void* data, size_t size)
+    {
+        const auto* in = static_cast<const char*>(data);
+        while (size > 0)
+        {
+            OVERLAPPED overlapped{};
+            overlapped.Offset = static_cast<DWORD>(offset);
+            overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+            DWORD chunk = static_cast<DWORD>(std::min<size_t>(size, 1u << 30));
+            DWORD done = 0;
+            if (!WriteFile(handle, in, chunk, &done, &overlapped) || done == 0)
+                return false;
+            in += done;
+            offset += done;
+            size -= done;
+        }
+        return true;
+    }
+}
+#else
+namespace
+{
+    bool readAt(int fd, uint64_t offset, void* data, size_t size)
+    {
+        auto* out = static_cast<char*>(data);
+        while (size > 0)
+        {
+            const ssize_t done = pread(fd, out, size, static_cast<off_t>(offset));
+            if (done < 0 && errno == EINTR)
+                continue;
+            if (done <= 0)
+                return false;   // Error, or a slot past the end of the file
+            out += done;
+            offset += static_cast<uint64_t>(done);
+            size -= static_cast<size_t>(done);
+        }
+        return true;
+    }
+
+    bool writeAt(int fd, uint64_t offset, const void* data, size_t size)
+    {
+        const auto* in = static_cast<const char*>(data);
+        while (size > 0)
+        {
+            const ssize_t done = pwrite(fd, in, size, static_cast<off_t>(offset));
+            if (done < 0 && errno == EINTR)
+                continue;
+            if (done <= 0)
+                return false;
+            in += done;
+            offset += static_cast<uint64_t>(done);
+            size -= static_cast<size_t>(done);
+        }
+        return true;
+    }
+}
+#endif
+
+FaissVectorFile::FaissVectorFile() = default;
+
+FaissVectorFile::~FaissVectorFile()
+{
+    close();
+}
+
+bool FaissVectorFile::open(const std::filesystem::path& path, int dimensions, bool& created, std::string& error)
+{
+    close();
+    created = !std::filesystem::exists(path);
+#ifdef _WIN32
+    HANDLE handle = CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+                                OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, nullptr);
+    if (handle == INVALID_HANDLE_VALUE)
+    {
+        error = "Failed to open " + path.string();
+        return false;
+    }
+    handle_ = handle;
+#else
+    fd_ = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd_ < 0)
+    {
+        error = "Failed to open " + path.string() + ": " + std::strerror(errno);
+        return false;
+    }
+#endif
+    dimensions_ = dimensions;
+
+    char header[kHeaderBytes] = {};
+    const uint32_t fields[3] = {kMagic, kVersion, static_cast<uint32_t>(dimensions)};
+    if (created)
+    {
+        std::memcpy(header, fields, sizeof(fields));
+#ifdef _WIN32
+        const bool written = writeAt(static_cast<HANDLE>(handle_), 0, header, sizeof(header));
+#else
+        const bool written = writeAt(fd_, 0, header, sizeof(header));
+#endif
+        if (!written)
+        {
+            error = "Failed to write the header of " + path.string();
+            close();
+            return false;
+        }
+        return true;
+    }
+
+#ifdef _WIN32
+    const bool read = readAt(static_cast<HANDLE>(handle_), 0, header, sizeof(header));
+#else
+    const bool read = readAt(fd_, 0, header, sizeof(header));
+#endif
+    uint32_t saved[3] = {};
+    std::memcpy(saved, header, sizeof(saved));
+    if (!read || saved[0] != kMagic || saved[1] != kVersion)
+    {
+        error = path.string() + " is not a vectors file";
+        close();
+        return false;
+    }
+    if (saved[2] != static_cast<uint32_t>(dimensions))
+    {
+        error = path.string() + " holds " + std::to_string(saved[2]) + "-dimensional vectors, expected " +
+                std::to_string(dimensions);
+        close();
+        return false;
+    }
+    return true;
+}
+
+void FaissVectorFile::close()
+{
+#ifdef _WIN32
+    if (handle_)
+    {
+        CloseHandle(static_cast<HANDLE>(handle_));
+        handle_ = nullptr;
+    }
+#else
+    if (fd_ >= 0)
+    {
+        ::close(fd_);
+        fd_ = -1;
+    }
+#endif
+}
+
+bool FaissVectorFile::isOpen() const
+{
+#ifdef _WIN32
+    return handle_ != nullptr;
+#else
+    return fd_ >= 0;
+#endif
+}
+
+uint64_t FaissVectorFile::slotOffset(int64_t id) const
+{
+    return kHeaderBytes + static_cast<uint64_t>(id) * static_cast<uint64_t>(dimensions_) * sizeof(float);
+}
+
+bool FaissVectorFile::write(const int64_t* ids, const float* vectors, size_t count, std::string& error)
+{
+    if (!isOpen())
+    {
+        error = "Vectors file is not open";
+        return false;
+    }
+    const size_t dims = static_cast<size_t>(dimensions_);
+    std::vector<float> run;
+    const bool ok = forEachRun(ids, count, [&](const size_t* rows, size_t length) {
+        run.resize(length * dims);
+        for (size_t i = 0; i < length; ++i)
+        {
+            std::memcpy(run.data() + i * dims, vectors + rows[i] * dims, dims * sizeof(float));
+        }
+#ifdef _WIN32
+        return writeAt(static_cast<HANDLE>(handle_), slotOffset(ids[rows[0]]), run.data(), run.size() * sizeof(float));
+#else
+        return writeAt(fd_, slotOffset(ids[rows[0]]), run.data(), run.size() * sizeof(float));
+#endif
+    });
+    if (!ok)
+    {
+        error = "Failed to write vectors";
+    }
+    return ok;
+}
+
+bool FaissVectorFile::read(const int64_t* ids, size_t count, float* out) const
+{
+    if (!isOpen())
+    {
+        return false;
+    }
+    const size_t dims = static_cast<size_t>(dimensions_);
+    const size_t slot_bytes = dims * sizeof(float);
+
+#if !defined(_WIN32) && defined(POSIX_FADV_WILLNEED)
+    // Queue every slot with the device before blocking on the first one
+    for (size_t i = 0; i < count; ++i)
+    {
+        posix_fadvise(fd_, static_cast<off_t>(slotOffset(ids[i])), static_cast<off_t>(slot_bytes), POSIX_FADV_WILLNEED);
+    }
+#endif
+
+    std::vector<float> run;
+    return forEachRun(ids, count, [&](const size_t* rows, size_t length) {
+        run.resize(length * dims);
+#ifdef _WIN32
+        if (!readAt(static_cast<HANDLE>(handle_), slotOffset(ids[rows[0]]), run.data(), length * slot_bytes))
+#else
+        if (!readAt(fd_, slotOffset(ids[rows[0]]), run.data(), length * slot_bytes))
+#endif
+        {
+            return false;
+        }
+        for (size_t i = 0; i < length; ++i)
+        {
+            std::memcpy(out + rows[i] * dims, run.data() + i * dims, slot_bytes);
+        }
+        return true;
+    });
+}
+
+bool FaissVectorFile::sync(std::string& error)
+{
+    if (!isOpen())
+    {
+        return true;
+    }
+#ifdef _WIN32
+    const bool ok = FlushFileBuffers(static_cast<HANDLE>(handle_)) != 0;
+#else
+    const bool ok = fsync(fd_) == 0;
+#endif
+    if (!ok)
+    {
+        error = "Failed to sync the vectors file";
+    }
+    return ok;
+}
+
+} // namespace kolosal
@@ -1,4 +1,11 @@
 #include "kolosal/gpu_detection.hpp"
+#include "kolosal/logger.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <string>
+#include <vector>
 
 #ifdef _WIN32
 #include <windows.h>
@@ -8,23 +15,260 @@
 
 #pragma comment(lib, "wbemuuid.lib")
 #else
+#include <dlfcn.h>
 #include <fstream>
-#include <sstream>
-#include <string>
-#include <vector>
-#include <algorithm>
 #include <filesystem>
-#include <cstdlib>
-#include <iostream>
-#include <memory>
-#include <stdexcept>
-#include <array>
 #endif
 
 namespace kolosal {
 
+namespace {
+
+// Driver libraries are opened at runtime so a missing driver only means fewer devices
 #ifdef _WIN32
-bool hasVulkanCapableGPU() {
+using LibraryHandle = HMODULE;
+LibraryHandle openLibrary(const char* name) { return LoadLibraryA(name); }
+void* findSymbol(LibraryHandle handle, const char* name) { return reinterpret_cast<void*>(GetProcAddress(handle, name)); }
+#else
+using LibraryHandle = void*;
+LibraryHandle openLibrary(const char* name) { return dlopen(name, RTLD_LAZY | RTLD_LOCAL); }
+void* findSymbol(LibraryHandle handle, const char* name) { return dlsym(handle, name); }
+#endif
+
+// The few NVML entry points used, declared here so the NVIDIA headers are not needed
+struct NvmlMemory {
+    unsigned long long total;
+    unsigned long long free;
+    unsigned long long used;
+};
+
+struct NvmlUtilization {
+    unsigned int gpu;
+    unsigned int memory;
+};
+
+using NvmlDevice = void*;
+
+class Nvml {
+public:
+    // Loads the library and initializes NVML once; false if there is no NVIDIA driver
+    bool open() {
+        if (initialized_)
+            return true;
+#ifdef _WIN32
+        library_ = openLibrary("nvml.dll");
+#elif defined(__APPLE__)
+        library_ = nullptr;
+#else
+        library_ = openLibrary("libnvidia-ml.so.1");
+#endif
+        if (!library_)
+            return false;
+
+        init_ = reinterpret_cast<int (*)()>(findSymbol(library_, "nvmlInit_v2"));
+        getCount_ = reinterpret_cast<int (*)(unsigned int*)>(findSymbol(library_, "nvmlDeviceGetCount_v2"));
+        getHandle_ = reinterpret_cast<int (*)(unsigned int, NvmlDevice*)>(findSymbol(library_, "nvmlDeviceGetHandleByIndex_v2"));
+        getName_ = reinterpret_cast<int (*)(NvmlDevice, char*, unsigned int)>(findSymbol(library_, "nvmlDeviceGetName"));
+        getMemory_ = reinterpret_cast<int (*)(NvmlDevice, NvmlMemory*)>(findSymbol(library_, "nvmlDeviceGetMemoryInfo"));
+        getUtilization_ = reinterpret_cast<int (*)(NvmlDevice, NvmlUtilization*)>(findSymbol(library_, "nvmlDeviceGetUtilizationRates"));
+        getTemperature_ = reinterpret_cast<int (*)(NvmlDevice, int, unsigned int*)>(findSymbol(library_, "nvmlDeviceGetTemperature"));
+        getComputeCapability_ = reinterpret_cast<int (*)(NvmlDevice, int*, int*)>(findSymbol(library_, "nvmlDeviceGetCudaComputeCapability"));
+        if (!init_ || !getCount_ || !getHandle_ || !getMemory_ || init_() != 0)
+            return false;
+        initialized_ = true;
+        return true;
+    }
+
+    std::vector<GpuDevice> devices() {
+        std::vector<GpuDevice> result;
+        unsigned int count = 0;
+        if (!initialized_ || getCount_(&count) != 0)
+            return result;
+        for (unsigned int i = 0; i < count; ++i) {
+            NvmlDevice handle = nullptr;
+            if (getHandle_(i, &handle) != 0)
+                continue;
+            GpuDevice device;
+            device.index = static_cast<int>(i);
+            device.vendor = "nvidia";
+            device.source = "nvml";
+            char name[96] = {};
+            if (getName_ && getName_(handle, name, sizeof(name)) == 0)
+                device.name = name;
+            int major = 0, minor = 0;
+            if (getComputeCapability_ && getComputeCapability_(handle, &major, &minor) == 0)
+                device.computeCapability = major * 10 + minor;
+            result.push_back(std::move(device));
+        }
+        return result;
+    }
+
+    void sample(GpuDevice& device) {
+        NvmlDevice handle = nullptr;
+        if (!initialized_ || getHandle_(static_cast<unsigned int>(device.index), &handle) != 0)
+            return;
+        NvmlMemory memory{};
+        if (getMemory_(handle, &memory) == 0) {
+            device.totalMemoryBytes = memory.total;
+            device.freeMemoryBytes = memory.free;
+        }
+        NvmlUtilization utilization{};
+        if (getUtilization_ && getUtilization_(handle, &utilization) == 0)
+            device.utilizationPercent = static_cast<int>(utilization.gpu);
+        unsigned int temperature = 0;
+        if (getTemperature_ && getTemperature_(handle, 0 /* NVML_TEMPERATURE_GPU */, &temperature) == 0)
+            device.temperatureC = static_cast<int>(temperature);
+    }
+
+private:
+    LibraryHandle library_ = nullptr;
+    bool initialized_ = false;
+    int (*init_)() = nullptr;
+    int (*getCount_)(unsigned int*) = nullptr;
+    int (*getHandle_)(unsigned int, NvmlDevice*) = nullptr;
+    int (*getName_)(NvmlDevice, char*, unsigned int) = nullptr;
+    int (*getMemory_)(NvmlDevice, NvmlMemory*) = nullptr;
+    int (*getUtilization_)(NvmlDevice, NvmlUtilization*) = nullptr;
+    int (*getTemperature_)(NvmlDevice, int, unsigned int*) = nullptr;
+    int (*getComputeCapability_)(NvmlDevice, int*, int*) = nullptr;
+};
+
+Nvml& nvml() {
+    static Nvml instance;
+    return instance;
+}
+
+#if !defined(_WIN32) && !defined(__APPLE__)
+
+std::string readFirstLine(const std::filesystem::path& path) {
+    std::ifstream file(path);
+    std::string line;
+    std::getline(file, line);
+    return line;
+}
+
+uint64_t readNumber(const std::filesystem::path& path) {
+    const std::string line = readFirstLine(path);
+    if (line.empty() || !std::isdigit(static_cast<unsigned char>(line[0])))
+        return 0;
+    return std::stoull(line);
+}
+
+const char* vendorName(const std::string& vendorId) {
+    if (vendorId == "0x10de")
+        return "nvidia";
+    if (vendorId == "0x1002" || vendorId == "0x1022")
+        return "amd";
+    if (vendorId == "0x8086")
+        return "intel";
+    return nullptr;
+}
+
+// DRM card directories (card0, card1, ... but not connectors like card0-DP-1), in index order
+std::vector<std::filesystem::path> drmCards() {
+    std::vector<std::filesystem::path> cards;
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator("/sys/class/drm", ec)) {
+        const std::string name = entry.path().filename().string();
+        if (name.size() > 4 && name.rfind("card", 0) == 0 && name.find('-') == std::string::npos &&
+            std::all_of(name.begin() + 4, name.end(), [](unsigned char c) { return std::isdigit(c); }))
+            cards.push_back(entry.path());
+    }
+    std::sort(cards.begin(), cards.end(), [](const auto& a, const auto& b) {
+        return std::stoi(a.filename().string().substr(4)) < std::stoi(b.filename().string().substr(4));
+    });
+    return cards;
+}
+
+// DRM card behind each device found through sysfs, by device index
+std::vector<std::pair<int, std::filesystem::path>>& sysfsCards() {
+    static std::vector<std::pair<int, std::filesystem::path>> cards;
+    return cards;
+}
+
+// GPUs the kernel driver exposes through DRM; AMD drivers also publish VRAM and load there
+void addSysfsDevices(std::vector<GpuDevice>& result, bool skipNvidia) {
+    for (const auto& card : drmCards()) {
+        const std::filesystem::path device = card / "device";
+        const char* vendor = vendorName(readFirstLine(device / "vendor"));
+        if (!vendor || (skipNvidia && std::strcmp(vendor, "nvidia") == 0))
+            continue;
+        GpuDevice gpu;
+        gpu.index = static_cast<int>(result.size());
+        gpu.vendor = vendor;
+        gpu.source = "sysfs";
+        gpu.name = readFirstLine(device / "product_name");
+        if (gpu.name.empty())
+            gpu.name = std::string(vendor) + " " + readFirstLine(device / "device") + " (" + card.filename().string() + ")";
+        sysfsCards().emplace_back(gpu.index, card);
+        result.push_back(std::move(gpu));
+    }
+}
+
+void sampleSysfs(GpuDevice& gpu) {
+    auto card = std::find_if(sysfsCards().begin(), sysfsCards().end(), [&gpu](const auto& entry) { return entry.first == gpu.index; });
+    if (card == sysfsCards().end())
+        return;
+    const std::filesystem::path device = card->second / "device";
+    const uint64_t total = readNumber(device / "mem_info_vram_total");
+    const uint64_t used = readNumber(device / "mem_info_vram_used");
+    if (total > 0) {
+        gpu.totalMemoryBytes = total;
+        gpu.freeMemoryBytes = total > used ? total - used : 0;
+    }
+    std::error_code ec;
+    if (std::filesystem::exists(device / "gpu_busy_percent", ec))
+        gpu.utilizationPercent = static_cast<int>(readNumber(device / "gpu_busy_percent"));
+    for (const auto& hwmon : std::filesystem::directory_iterator(device / "hwmon", ec)) {
+        const uint64_t milliC = readNumber(hwmon.path() / "temp1_input");
+        if (milliC > 0) {
+            gpu.temperatureC = static_cast<int>(milliC / 1000);
+            break;
+        }
+    }
+}
+
+// Fallbacks for drivers that expose no DRM card, e.g. the NVIDIA driver without modeset
+bool checkKernelModules() {
+    std::ifstream modules("/proc/modules");
+    std::string line;
+    while (std::getline(modules, line)) {
+        if (line.find("nvidia") != std::string::npos ||
+            line.find("amdgpu") != std::string::npos ||
+            line.find("radeon") != std::string::npos ||
+            line.find("nouveau") != std::string::npos) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// What lspci reports, read directly: display controllers (class 0x03xxxx) from NVIDIA or AMD
+bool checkPciDisplayControllers() {
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator("/sys/bus/pci/devices", ec)) {
+        if (readFirstLine(entry.path() / "class").rfind("0x03", 0) != 0)
+            continue;
+        const char* vendor = vendorName(readFirstLine(entry.path() / "vendor"));
+        if (vendor && std::strcmp(vendor, "intel") != 0)
+            return true;
+    }
+    return false;
+}
+
+bool checkVulkanLoader() {
+    LibraryHandle vulkan = openLibrary("libvulkan.so.1");
+    if (!vulkan)
+        return false;
+    dlclose(vulkan);
+    return true;
+}
+
+#endif
+
+#ifdef _WIN32
+// Looks for an NVIDIA or AMD video controller through WMI
+bool detectGpuWithWmi() {
     bool useVulkan = false;
 
     // Initialize COM
@@ -208,150 +452,105 @@ bool hasVulkanCapableGPU() {
     return useVulkan;
 }
 
-#else
+#endif
 
-// Helper function to execute a command and capture its output
-std::string executeCommand(const char* cmd) {
-    std::array<char, 128> buffer;
-    std::string result;
-    std::unique_ptr<FILE, decltype(&pclose)> pipe(popen(cmd, "r"), pclose);
-    if (!pipe) {
-        return "";
-    }
-    while (fgets(buffer.data(), buffer.size(), pipe.get()) != nullptr) {
-        result += buffer.data();
-    }
-    return result;
+} // namespace
+
+GpuTelemetry& GpuTelemetry::instance() {
+    static GpuTelemetry telemetry;
+    return telemetry;
 }
 
-// Check if string contains any of the GPU vendor names (case insensitive)
-bool containsGPUVendor(const std::string& text) {
-    std::string lowerText = text;
-    std::transform(lowerText.begin(), lowerText.end(), lowerText.begin(), ::tolower);
-    
-    return lowerText.find("nvidia") != std::string::npos ||
-           lowerText.find("amd") != std::string::npos ||
-           lowerText.find("ati") != std::string::npos ||
-           lowerText.find("radeon") != std::string::npos ||
-           lowerText.find("geforce") != std::string::npos ||
-           lowerText.find("quadro") != std::string::npos ||
-           lowerText.find("tesla") != std::string::npos ||
-           lowerText.find("firepro") != std::string::npos ||
-           lowerText.find("rx ") != std::string::npos ||
-           lowerText.find("gtx") != std::string::npos ||
-           lowerText.find("rtx") != std::string::npos;
+GpuTelemetry::~GpuTelemetry() {
+    stop();
 }
 
-// Method 1: Check loaded kernel modules
-bool checkKernelModules() {
-    try {
-        std::ifstream modules("/proc/modules");
-        if (!modules.is_open()) {
-            return false;
-        }
-        
-        std::string line;
-        while (std::getline(modules, line)) {
-            if (line.find("nvidia") != std::string::npos ||
-                line.find("amdgpu") != std::string::npos ||
-                line.find("radeon") != std::string::npos ||
-                line.find("nouveau") != std::string::npos) {
-                return true;
-            }
-        }
-    } catch (const std::exception&) {
-        // Ignore errors and try other methods
+void GpuTelemetry::detect() {
+    std::vector<GpuDevice> found;
+    if (nvml().open())
+        found = nvml().devices();
+#if !defined(_WIN32) && !defined(__APPLE__)
+    addSysfsDevices(found, !found.empty());
+#endif
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        devices_ = std::move(found);
+    }
+    sample();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& device : devices_) {
+        KOLOSAL_LOG_INFO("GPU %d: %s (%s), %llu MB total, %llu MB free", device.index, device.name.c_str(),
+                              device.source.c_str(), static_cast<unsigned long long>(device.totalMemoryBytes >> 20),
+                              static_cast<unsigned long long>(device.freeMemoryBytes >> 20));
     }
-    return false;
 }
 
-// Method 2: Check DRM devices
-bool checkDRMDevices() {
-    try {
-        if (!std::filesystem::exists("/sys/class/drm")) {
-            return false;
-        }
-        
-        for (const auto& entry : std::filesystem::directory_iterator("/sys/class/drm")) {
-            if (entry.is_directory()) {
-                std::string dirname = entry.path().filename().string();
-                
-                // Look for card devices (not render nodes)
-                if (dirname.find("card") == 0 && dirname.find("-") == std::string::npos) {
-                    // Check the device vendor/device info
-                    std::string devicePath = entry.path().string() + "/device";
-                    
-                    // Try to read vendor information
-                    std::ifstream vendor(devicePath + "/vendor");
-                    std::ifstream device(devicePath + "/device");
-                    
-                    if (vendor.is_open() && device.is_open()) {
-                        std::string vendorId, deviceId;
-                        std::getline(vendor, vendorId);
-                        std::getline(device, deviceId);
-                        
-                        // Check for known GPU vendor IDs
-                        // 0x10de = NVIDIA, 0x1002 = AMD, 0x1022 = AMD
-                        if (vendorId.find("0x10de") != std::string::npos ||
-                            vendorId.find("0x1002") != std::string::npos ||
-                            vendorId.find("0x1022") != std::string::npos) {
-                            return true;
-                        }
-                    }
-                }
-            }
-        }
-    } catch (const std::exception&) {
-        // Ignore errors and try other methods
+void GpuTelemetry::sample() {
+    std::vector<GpuDevice> sampled;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        sampled = devices_;
     }
-    return false;
+    // Driver calls happen outside the lock so readers always get the previous sample at once
+    for (auto& device : sampled) {
+        if (device.source == "nvml")
+            nvml().sample(device);
+#if !defined(_WIN32) && !defined(__APPLE__)
+        else
+            sampleSysfs(device);
+#endif
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    devices_ = std::move(sampled);
 }
 
-// Method 3: Use lspci command
-bool checkLspci() {
-    try {
-        std::string lspciOutput = executeCommand("lspci 2>/dev/null");
-        if (lspciOutput.empty()) {
-            return false;
-        }
-        
-        std::istringstream stream(lspciOutput);
-        std::string line;
-        
-        while (std::getline(stream, line)) {
-            // Look for VGA or 3D controller entries
-            if ((line.find("VGA") != std::string::npos || 
-                 line.find("3D controller") != std::string::npos ||
-                 line.find("Display controller") != std::string::npos) &&
-                containsGPUVendor(line)) {
-                return true;
-            }
-        }
-    } catch (const std::exception&) {
-        // Ignore errors and continue
+std::vector<GpuDevice> GpuTelemetry::devices() {
+    std::call_once(detectOnce_, [this] { detect(); });
+    std::lock_guard<std::mutex> lock(mutex_);
+    return devices_;
+}
+
+std::vector<int> GpuTelemetry::devicesByFreeMemory() {
+    std::vector<GpuDevice> known = devices();
+    known.erase(std::remove_if(known.begin(), known.end(), [](const GpuDevice& device) { return device.totalMemoryBytes == 0; }),
+                known.end());
+    std::stable_sort(known.begin(), known.end(), [](const GpuDevice& a, const GpuDevice& b) {
+        return a.freeMemoryBytes > b.freeMemoryBytes;
+    });
+    std::vector<int> order;
+    for (const auto& device : known)
+        order.push_back(device.index);
+    return order;
+}
+
+void GpuTelemetry::start(std::chrono::seconds interval) {
+    if (devices().empty() || interval.count() <= 0)
+        return;
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (sampler_.joinable())
+        return;
+    stopping_ = false;
+    sampler_ = std::thread(&GpuTelemetry::run, this, interval);
+}
+
+void GpuTelemetry::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
     }
-    return false;
+    cv_.notify_all();
+    if (sampler_.joinable())
+        sampler_.join();
 }
 
-// Method 4: Check for Vulkan support
-bool checkVulkanSupport() {
-    try {
-        // Check if vulkan-tools or vulkaninfo is available
-        std::string vulkanInfo = executeCommand("vulkaninfo --summary 2>/dev/null | head -20");
-        if (!vulkanInfo.empty() && vulkanInfo.find("ERROR") == std::string::npos) {
-            // If vulkaninfo runs successfully and doesn't show errors, likely have Vulkan support
-            return vulkanInfo.find("GPU") != std::string::npos || 
-                   vulkanInfo.find("Device") != std::string::npos;
-        }
-        
-        // Alternative: check for Vulkan loader library
-        return std::filesystem::exists("/usr/lib/x86_64-linux-gnu/libvulkan.so.1") ||
-               std::filesystem::exists("/usr/lib64/libvulkan.so.1") ||
-               std::filesystem::exists("/usr/lib/libvulkan.so.1");
-    } catch (const std::exception&) {
-        // Ignore errors
+void GpuTelemetry::run(std::chrono::seconds interval) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!cv_.wait_for(lock, interval, [this] { return stopping_; })) {
+        lock.unlock();
+        sample();
+        lock.lock();
     }
-    return false;
 }
 
 bool hasVulkanCapableGPU() {
@@ -360,31 +559,19 @@ bool hasVulkanCapableGPU() {
     // Always return false to ensure Metal is used as the primary acceleration method
     return false;
 #else
-    // Method 1: Check kernel modules (most reliable)
-    if (checkKernelModules()) {
-        return true;
-    }
-    
-    // Method 2: Check DRM devices
-    if (checkDRMDevices()) {
-        return true;
-    }
-    
-    // Method 3: Use lspci command
-    if (checkLspci()) {
-        return true;
-    }
-    
-    // Method 4: Check Vulkan support (indicates GPU presence)
-    if (checkVulkanSupport()) {
-        return true;
-    }
-    
-    // If all methods fail, assume no dedicated GPU
-    return false;
+    static const bool detected = [] {
+        for (const auto& device : GpuTelemetry::instance().devices()) {
+            if (device.vendor == "nvidia" || device.vendor == "amd")
+                return true;
+        }
+#ifdef _WIN32
+        return detectGpuWithWmi();
+#else
+        return checkKernelModules() || checkPciDisplayControllers() || checkVulkanLoader();
 #endif
-}
-
+    }();
+    return detected;
 #endif
+}
 
 } // namespace kolosal
@@ -0,0 +1,187 @@
+#include "kolosal/hardware_features.hpp"
+#include "kolosal/gpu_detection.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define KOLOSAL_X86 1
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+#if defined(__aarch64__) && defined(__linux__)
+#include <sys/auxv.h>
+#endif
+
+namespace kolosal {
+
+namespace {
+
+#ifdef KOLOSAL_X86
+struct CpuidRegisters {
+    uint32_t eax = 0, ebx = 0, ecx = 0, edx = 0;
+};
+
+CpuidRegisters cpuid(uint32_t leaf, uint32_t subleaf = 0) {
+    CpuidRegisters r;
+#ifdef _MSC_VER
+    int regs[4];
+    __cpuidex(regs, static_cast<int>(leaf), static_cast<int>(subleaf));
+    r.eax = regs[0];
+    r.ebx = regs[1];
+    r.ecx = regs[2];
+    r.edx = regs[3];
+#else
+    __cpuid_count(leaf, subleaf, r.eax, r.ebx, r.ecx, r.edx);
+#endif
+    return r;
+}
+
+// Register state the OS saves (XCR0); AVX needs the YMM bits, AVX-512 the opmask and ZMM ones
+uint64_t enabledXsaveState() {
+#ifdef _MSC_VER
+    return _xgetbv(0);
+#else
+    uint32_t eax, edx;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return (static_cast<uint64_t>(edx) << 32) | eax;
+#endif
+}
+
+void detectX86(std::set<std::string>& tags) {
+    const uint32_t maxLeaf = cpuid(0).eax;
+    if (maxLeaf < 1)
+        return;
+    const CpuidRegisters basic = cpuid(1);
+    const auto bit = [](uint32_t reg, int n) { return (reg >> n) & 1u; };
+
+    if (bit(basic.ecx, 20))
+        tags.insert("sse42");
+
+    const bool osxsave = bit(basic.ecx, 27);
+    const uint64_t xcr0 = osxsave ? enabledXsaveState() : 0;
+    const bool avxState = (xcr0 & 0x6) == 0x6;
+    const bool avx512State = avxState && (xcr0 & 0xE0) == 0xE0;
+    if (!avxState || !bit(basic.ecx, 28))
+        return;
+    tags.insert("avx");
+    if (bit(basic.ecx, 29))
+        tags.insert("f16c");
+    if (bit(basic.ecx, 12))
+        tags.insert("fma");
+
+    if (maxLeaf < 7)
+        return;
+    const CpuidRegisters extended = cpuid(7);
+    if (bit(extended.ebx, 5))
+        tags.insert("avx2");
+    const CpuidRegisters extended1 = extended.eax >= 1 ? cpuid(7, 1) : CpuidRegisters{};
+    if (bit(extended1.eax, 4))
+        tags.insert("avxvnni");
+
+    if (!avx512State || !bit(extended.ebx, 16))
+        return;
+    tags.insert("avx512");
+    tags.insert("avx512f");
+    if (bit(extended.ebx, 30))
+        tags.insert("avx512bw");
+    if (bit(extended.ebx, 31))
+        tags.insert("avx512vl");
+    if (bit(extended.ecx, 11))
+        tags.insert("avx512vnni");
+    if (bit(extended1.eax, 5))
+        tags.insert("avx512bf16");
+}
+#endif
+
+void detectArm(std::set<std::string>& tags) {
+#if defined(__aarch64__) || defined(_M_ARM64)
+    tags.insert("neon");
+#if defined(__linux__)
+    const unsigned long hwcap = getauxval(AT_HWCAP);
+    const unsigned long hwcap2 = getauxval(AT_HWCAP2);
+    if (hwcap & (1ul << 20))    // HWCAP_ASIMDDP
+        tags.insert("dotprod");
+    if (hwcap & (1ul << 22))    // HWCAP_SVE
+        tags.insert("sve");
+    if (hwcap2 & (1ul << 13))   // HWCAP2_I8MM
+        tags.insert("i8mm");
+#elif defined(__APPLE__)
+    // Every Apple Silicon core has the dot product extension; M2 and later add I8MM,
+    // which the compiler advertises when targeting them
+    tags.insert("dotprod");
+#if defined(__ARM_FEATURE_MATMUL_INT8)
+    tags.insert("i8mm");
+#endif
+#endif
+#else
+    (void)tags;
+#endif
+}
+
+std::string lowercase(std::string text) {
+    std::transform(text.begin(), text.end(), text.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return text;
+}
+
+} // namespace
+
+HardwareFeatures::HardwareFeatures() {
+    tags_.insert("cpu");
+#ifdef KOLOSAL_X86
+    detectX86(tags_);
+#endif
+    detectArm(tags_);
+
+#ifdef __APPLE__
+    tags_.insert("metal");
+#else
+    for (const auto& device : GpuTelemetry::instance().devices()) {
+        if (device.vendor == "nvidia") {
+            tags_.insert("cuda");
+            cudaComputeCapability_ = std::max(cudaComputeCapability_, device.computeCapability);
+        } else if (device.vendor == "amd") {
+            tags_.insert("rocm");
+        }
+    }
+    if (hasVulkanCapableGPU())
+        tags_.insert("vulkan");
+#endif
+}
+
+const HardwareFeatures& HardwareFeatures::host() {
+    static const HardwareFeatures features;
+    return features;
+}
+
+bool HardwareFeatures::supports(const std::string& tag) const {
+    const std::string name = lowercase(tag);
+    static const std::string kCudaArch = "cuda-sm";
+    if (name.compare(0, kCudaArch.size(), kCudaArch) == 0) {
+        const std::string digits = name.substr(kCudaArch.size());
+        if (digits.empty() || !std::all_of(digits.begin(), digits.end(), [](unsigned char c) { return std::isdigit(c); }))
+            return false;
+        return tags_.count("cuda") && cudaComputeCapability_ >= std::atoi(digits.c_str());
+    }
+    return tags_.count(name) > 0;
+}
+
+bool HardwareFeatures::supportsAll(const std::vector<std::string>& tags) const {
+    return std::all_of(tags.begin(), tags.end(), [this](const std::string& tag) { return supports(tag); });
+}
+
+std::vector<std::string> HardwareFeatures::tags() const {
+    std::vector<std::string> result(tags_.begin(), tags_.end());
+    if (cudaComputeCapability_ > 0)
+        result.push_back("cuda-sm" + std::to_string(cudaComputeCapability_));
+    return result;
+}
+
+} // namespace kolosal
@@ -0,0 +1,151 @@
+#include "kolosal/health_monitor.hpp"
+#include "kolosal/server_api.hpp"
+#include "kolosal/node_manager.h"
+#include "kolosal/drain_manager.hpp"
+#include "kolosal/logger.hpp"
+#include <json.hpp>
+
+namespace kolosal
+{
+
+HealthMonitor& HealthMonitor::instance()
+{
+    static HealthMonitor monitor;
+    return monitor;
+}
+
+HealthMonitor::~HealthMonitor()
+{
+    stop();
+}
+
+void HealthMonitor::start(std::chrono::milliseconds interval)
+{
+    refresh();
+    if (interval.count() <= 0)
+        return;
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (sampler_.joinable())
+        return;
+    stopping_ = false;
+    sampler_ = std::thread(&HealthMonitor::run, this, interval);
+}
+
+void HealthMonitor::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    if (sampler_.joinable())
+        sampler_.join();
+}
+
+void HealthMonitor::run(std::chrono::milliseconds interval)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!cv_.wait_for(lock, interval, [this] { return stopping_; }))
+    {
+        lock.unlock();
+        refresh();
+        lock.lock();
+    }
+}
+
+void HealthMonitor::refresh()
+{
+    auto snapshot = std::make_shared<Snapshot>();
+    snapshot->taken = std::chrono::system_clock::now();
+    try
+    {
+        auto& nodeManager = ServerAPI::instance().getNodeManager();
+        auto startupStates = nodeManager.getStartupStates();
+        for (const auto& engineId : nodeManager.listEngineIds())
+        {
+            // Status only; asking for the engine itself would trigger a lazy load
+            Engine engine;
+            engine.id = engineId;
+            engine.loaded = nodeManager.getEngineStatus(engineId).second;
+            auto state = startupStates.find(engineId);
+            if (state != startupStates.end())
+                engine.startupState = engine.loaded ? "ready" : state->second;
+            snapshot->loadedEngines += engine.loaded ? 1 : 0;
+            snapshot->engines.push_back(std::move(engine));
+        }
+        for (auto& [modelId, state] : startupStates)
+        {
+            if (state == "pending" || state == "loading")
+                snapshot->startupPending++;
+            snapshot->startupModels.emplace_back(modelId, std::move(state));
+        }
+    }
+    catch (const std::exception& ex)
+    {
+        KOLOSAL_LOG_WARNING("Health sample failed: %s", ex.what());
+        return;
+    }
+
+    auto render = [&](const char* status)
+    {
+        nlohmann::json body = {
+            {"status", status},
+            {"engines", {{"total", snapshot->engines.size()}, {"loaded", snapshot->loadedEngines}}},
+            {"startup", {{"complete", snapshot->startupPending == 0}, {"models_pending", snapshot->startupPending}}}};
+        return body.dump();
+    };
+    snapshot->readyBody = render("ready");
+    snapshot->notReadyBody = render("starting");
+    snapshot->drainingBody = render("draining");
+
+    std::atomic_store(&snapshot_, std::shared_ptr<const Snapshot>(std::move(snapshot)));
+}
+
+std::shared_ptr<const HealthMonitor::Snapshot> HealthMonitor::snapshot()
+{
+    auto current = std::atomic_load(&snapshot_);
+    if (!current)
+    {
+        refresh();
+        current = std::atomic_load(&snapshot_);
+    }
+    return current;
+}
+
+bool HealthMonitor::probe(std::string_view path, int& status, std::string& body)
+{
+    if (path == "/livez")
+    {
+        status = 200;
+        body = "{\"status\":\"alive\"}";
+        return true;
+    }
+    if (path != "/readyz")
+        return false;
+
+    // Never sampled yet (the server is up before the sampler starts): not ready
+    auto current = std::atomic_load(&snapshot_);
+    if (!current)
+    {
+        status = 503;
+        body = "{\"status\":\"starting\"}";
+    }
+    else if (DrainManager::instance().draining())
+    {
+        status = 503;
+        body = current->drainingBody;
+    }
+    else if (current->startupPending > 0)
+    {
+        status = 503;
+        body = current->notReadyBody;
+    }
+    else
+    {
+        status = 200;
+        body = current->readyBody;
+    }
+    return true;
+}
+
+} // namespace kolosal
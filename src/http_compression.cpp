@@ -0,0 +1,274 @@
+#include "kolosal/http_compression.hpp"
+#include "kolosal/logger.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <zlib.h>
+
+namespace kolosal
+{
+    namespace http_internal
+    {
+
+        namespace
+        {
+            // One deflate state per thread, reset between responses instead of reallocated
+            class Deflater
+            {
+            public:
+                ~Deflater()
+                {
+                    if (ready_)
+                        deflateEnd(&zs_);
+                }
+
+                bool reset(ContentCoding coding, int level)
+                {
+                    if (ready_ && coding == coding_ && level == level_)
+                        return deflateReset(&zs_) == Z_OK;
+
+                    if (ready_)
+                        deflateEnd(&zs_);
+                    std::memset(&zs_, 0, sizeof(zs_));
+                    // 15 window bits for a zlib wrapper, +16 for a gzip one
+                    const int windowBits = coding == ContentCoding::Gzip ? 15 + 16 : 15;
+                    ready_ = deflateInit2(&zs_, level, Z_DEFLATED, windowBits, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+                    coding_ = coding;
+                    level_ = level;
+                    if (!ready_)
+                        KOLOSAL_LOG_ERROR("Failed to initialise response compression (level %d)", level);
+                    return ready_;
+                }
+
+                // Append the compressed form of data to out
+                bool run(const char *data, size_t size, int flush, std::string &out)
+                {
+                    zs_.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data));
+                    size_t remaining = size;
+                    while (true)
+                    {
+                        const uInt take = static_cast<uInt>(std::min<size_t>(remaining, 1u << 30));
+                        zs_.avail_in = take;
+                        remaining -= take;
+                        const int mode = remaining > 0 ? Z_NO_FLUSH : flush;
+
+                        int rc;
+                        do
+                        {
+                            const size_t used = out.size();
+                            const size_t room = std::max<size_t>(16384, deflateBound(&zs_, zs_.avail_in) / 2);
+                            out.resize(used + room);
+                            zs_.next_out = reinterpret_cast<Bytef *>(&out[used]);
+                            zs_.avail_out = static_cast<uInt>(room);
+                            rc = deflate(&zs_, mode);
+                            out.resize(used + room - zs_.avail_out);
+                            if (rc == Z_STREAM_ERROR)
+                                return false;
+                        } while (zs_.avail_out == 0 || (mode == Z_FINISH && rc != Z_STREAM_END));
+
+                        if (remaining == 0)
+                            return true;
+                    }
+                }
+
+            private:
+                z_stream zs_{};
+                bool ready_ = false;
+                ContentCoding coding_ = ContentCoding::Identity;
+                int level_ = 0;
+            };
+
+            struct ThreadState
+            {
+                ContentCoding coding = ContentCoding::Identity;
+                int level = 0;
+                size_t minBytes = 0;
+                bool streaming = false;
+                bool unflushed = false;     // Stream input fed without a flush since
+                Deflater deflater;
+                std::string output;         // Reused for every response on the thread
+            };
+
+            ThreadState &state()
+            {
+                thread_local ThreadState s;
+                return s;
+            }
+
+            const char *codingName(ContentCoding coding)
+            {
+                return coding == ContentCoding::Gzip ? "gzip" : "deflate";
+            }
+
+            // Text formats shrink well; images, archives and PDFs are already compressed
+            bool compressible(const std::string &contentType)
+            {
+                std::string type = contentType.substr(0, contentType.find(';'));
+                std::transform(type.begin(), type.end(), type.begin(),
+                               [](unsigned char c)
+                               { return static_cast<char>(std::tolower(c)); });
+                return type.compare(0, 5, "text/") == 0 ||
+                       type.find("json") != std::string::npos ||
+                       type.find("javascript") != std::string::npos ||
+                       type.find("xml") != std::string::npos;
+            }
+
+            std::string trim(const std::string &s)
+            {
+                size_t b = s.find_first_not_of(" \t");
+                if (b == std::string::npos)
+                    return {};
+                size_t e = s.find_last_not_of(" \t");
+                return s.substr(b, e - b + 1);
+            }
+        }
+
+        ContentCoding negotiate_coding(const std::string &acceptEncoding)
+        {
+            double gzipQ = -1.0, deflateQ = -1.0, anyQ = -1.0;
+            size_t pos = 0;
+            while (pos <= acceptEncoding.size())
+            {
+                size_t comma = acceptEncoding.find(',', pos);
+                if (comma == std::string::npos)
+                    comma = acceptEncoding.size();
+                std::string item = acceptEncoding.substr(pos, comma - pos);
+                pos = comma + 1;
+
+                double q = 1.0;
+                size_t semi = item.find(';');
+                if (semi != std::string::npos)
+                {
+                    std::string param = trim(item.substr(semi + 1));
+                    if (param.size() > 2 && (param[0] == 'q' || param[0] == 'Q') && param[1] == '=')
+                        q = std::atof(param.c_str() + 2);
+                    item = item.substr(0, semi);
+                }
+                item = trim(item);
+                std::transform(item.begin(), item.end(), item.begin(),
+                               [](unsigned char c)
+                               { return static_cast<char>(std::tolower(c)); });
+
+                if (item == "gzip" || item == "x-gzip")
+                    gzipQ = q;
+                else if (item == "deflate")
+                    deflateQ = q;
+                else if (item == "*")
+                    anyQ = q;
+            }
+
+            if (gzipQ < 0)
+                gzipQ = anyQ;
+            if (deflateQ < 0)
+                deflateQ = anyQ;
+            if (gzipQ > 0 && gzipQ >= deflateQ)
+                return ContentCoding::Gzip;
+            if (deflateQ > 0)
+                return ContentCoding::Deflate;
+            return ContentCoding::Identity;
+        }
+
+        bool parse_content_coding(const std::string &contentEncoding, ContentCoding &coding)
+        {
+            std::string value = trim(contentEncoding);
+            std::transform(value.begin(), value.end(), value.begin(),
+                           [](unsigned char c)
+                           { return static_cast<char>(std::tolower(c)); });
+            if (value.empty() || value == "identity")
+                coding = ContentCoding::Identity;
+            else if (value == "gzip" || value == "x-gzip")
+                coding = ContentCoding::Gzip;
+            else if (value == "deflate")
+                coding = ContentCoding::Deflate;
+            else
+                return false;
+            return true;
+        }
+
+        void set_response_coding(ContentCoding coding, int level, size_t minBytes)
+        {
+            ThreadState &s = state();
+            s.coding = level > 0 ? coding : ContentCoding::Identity;
+            s.level = std::min(level, 9);
+            s.minBytes = minBytes;
+            s.streaming = false;
+            s.unflushed = false;
+            // Large bodies leave large buffers behind; don't pin them to an idle thread
+            if (s.output.capacity() > (4u << 20))
+                std::string().swap(s.output);
+        }
+
+        const std::string *compress_response(const std::string &body, const std::string &contentType,
+                                             const char **encoding)
+        {
+            ThreadState &s = state();
+            if (s.coding == ContentCoding::Identity || body.size() < std::max<size_t>(s.minBytes, 1) ||
+                !compressible(contentType))
+                return nullptr;
+
+            s.output.clear();
+            if (!s.deflater.reset(s.coding, s.level) ||
+                !s.deflater.run(body.data(), body.size(), Z_FINISH, s.output) ||
+                s.output.size() >= body.size())
+                return nullptr;
+
+            *encoding = codingName(s.coding);
+            return &s.output;
+        }
+
+        bool is_compressible(const std::string &contentType)
+        {
+            return compressible(contentType);
+        }
+
+        std::string gzip_compress(const std::string &data, int level)
+        {
+            Deflater deflater;
+            std::string out;
+            if (!deflater.reset(ContentCoding::Gzip, std::clamp(level, 1, 9)) ||
+                !deflater.run(data.data(), data.size(), Z_FINISH, out) || out.size() >= data.size())
+                return {};
+            return out;
+        }
+
+        const char *begin_stream_compression(const std::string &contentType)
+        {
+            ThreadState &s = state();
+            s.streaming = false;
+            s.unflushed = false;
+            if (s.coding == ContentCoding::Identity || !compressible(contentType) ||
+                !s.deflater.reset(s.coding, s.level))
+                return nullptr;
+            s.streaming = true;
+            return codingName(s.coding);
+        }
+
+        bool stream_compressed()
+        {
+            return state().streaming;
+        }
+
+        const std::string &compress_stream_frame(const std::string &data, bool flush, bool finish)
+        {
+            ThreadState &s = state();
+            s.output.clear();
+            if (!s.streaming)
+                return s.output;
+
+            // An empty sync flush with nothing queued would only add an empty deflate block
+            if (data.empty() && !finish && !(flush && s.unflushed))
+                return s.output;
+
+            const int mode = finish ? Z_FINISH : (flush ? Z_SYNC_FLUSH : Z_NO_FLUSH);
+            if (!s.deflater.run(data.data(), data.size(), mode, s.output))
+                KOLOSAL_LOG_ERROR("Response stream compression failed");
+            s.unflushed = mode == Z_NO_FLUSH;
+            if (finish)
+                s.streaming = false;
+            return s.output;
+        }
+
+    } // namespace http_internal
+} // namespace kolosal
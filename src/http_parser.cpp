@@ -0,0 +1,420 @@
+#include "kolosal/http_parser.hpp"
+
+#include <cstring>
+#include <limits>
+
+namespace kolosal
+{
+
+    namespace
+    {
+        // Longest chunk-size line accepted, extensions included
+        constexpr size_t kMaxChunkLineBytes = 1024;
+
+        // RFC 9110 token characters, as allowed in methods and field names
+        bool isTokenChar(unsigned char c)
+        {
+            if (c >= '0' && c <= '9')
+                return true;
+            if ((c | 0x20) >= 'a' && (c | 0x20) <= 'z')
+                return true;
+            return std::strchr("!#$%&'*+-.^_`|~", c) != nullptr && c != '\0';
+        }
+
+        bool isToken(std::string_view text)
+        {
+            if (text.empty())
+                return false;
+            for (unsigned char c : text)
+            {
+                if (!isTokenChar(c))
+                    return false;
+            }
+            return true;
+        }
+
+        bool equalsIgnoreCase(std::string_view a, std::string_view b)
+        {
+            if (a.size() != b.size())
+                return false;
+            for (size_t i = 0; i < a.size(); ++i)
+            {
+                if ((a[i] | 0x20) != (b[i] | 0x20))
+                    return false;
+            }
+            return true;
+        }
+
+        std::string_view trimWhitespace(std::string_view text)
+        {
+            while (!text.empty() && (text.front() == ' ' || text.front() == '\t'))
+                text.remove_prefix(1);
+            while (!text.empty() && (text.back() == ' ' || text.back() == '\t'))
+                text.remove_suffix(1);
+            return text;
+        }
+
+        int hexValue(char c)
+        {
+            if (c >= '0' && c <= '9')
+                return c - '0';
+            if ((c | 0x20) >= 'a' && (c | 0x20) <= 'f')
+                return (c | 0x20) - 'a' + 10;
+            return -1;
+        }
+    }
+
+    void HttpRequestParser::reset()
+    {
+        buffer_ = nullptr;
+        state_ = State::RequestLine;
+        pos_ = start_ = scan_ = 0;
+        method_ = target_ = Span();
+        minorVersion_ = 1;
+        headers_.clear();
+        error_.clear();
+        chunked_ = hasContentLength_ = false;
+        contentLength_ = bodyOffset_ = decoded_ = chunkLeft_ = trailerBytes_ = 0;
+        errorStatus_ = 0;
+    }
+
+    std::string_view HttpRequestParser::header(std::string_view name) const
+    {
+        for (const auto &field : headers_)
+        {
+            if (equalsIgnoreCase(view(field.name), name))
+                return view(field.value);
+        }
+        return {};
+    }
+
+    size_t HttpRequestParser::bodyLength() const
+    {
+        if (!headersComplete())
+            return 0;
+        if (chunked_)
+            return decoded_;
+        size_t available = buffer_ && buffer_->size() > bodyOffset_ ? buffer_->size() - bodyOffset_ : 0;
+        return available < contentLength_ ? available : contentLength_;
+    }
+
+    size_t HttpRequestParser::messageEnd() const
+    {
+        if (!headersComplete() || chunked_)
+            return pos_;
+        return bodyOffset_ + contentLength_;
+    }
+
+    HttpRequestParser::Status HttpRequestParser::fail(int status, const char *message)
+    {
+        state_ = State::Failed;
+        errorStatus_ = status;
+        error_ = message;
+        return Status::Error;
+    }
+
+    // Finds the end of the line starting at pos_. Lines end in \r\n or a bare \n;
+    // lineEnd excludes the terminator, next is the offset after it.
+    bool HttpRequestParser::nextLine(std::string_view data, size_t &lineEnd, size_t &next)
+    {
+        size_t from = scan_ > pos_ ? scan_ : pos_;
+        const void *found = from < data.size() ? std::memchr(data.data() + from, '\n', data.size() - from) : nullptr;
+        if (!found)
+        {
+            scan_ = data.size();
+            return false;
+        }
+        size_t eol = static_cast<size_t>(static_cast<const char *>(found) - data.data());
+        next = eol + 1;
+        lineEnd = eol > pos_ && data[eol - 1] == '\r' ? eol - 1 : eol;
+        scan_ = next;
+        return true;
+    }
+
+    bool HttpRequestParser::parseRequestLine(std::string_view line, size_t offset)
+    {
+        size_t methodEnd = line.find(' ');
+        size_t targetEnd = methodEnd == std::string_view::npos ? methodEnd : line.find(' ', methodEnd + 1);
+        if (targetEnd == std::string_view::npos || targetEnd == methodEnd + 1 || !isToken(line.substr(0, methodEnd)))
+        {
+            fail(400, "Malformed request line");
+            return false;
+        }
+        for (unsigned char c : line.substr(methodEnd + 1, targetEnd - methodEnd - 1))
+        {
+            if (c <= 0x20 || c == 0x7f)
+            {
+                fail(400, "Malformed request target");
+                return false;
+            }
+        }
+
+        std::string_view version = line.substr(targetEnd + 1);
+        if (version.size() != 8 || version.compare(0, 5, "HTTP/") != 0 || version[6] != '.' ||
+            version[5] < '0' || version[5] > '9' || version[7] < '0' || version[7] > '9')
+        {
+            fail(400, "Malformed HTTP version");
+            return false;
+        }
+        if (version[5] != '1')
+        {
+            fail(505, "Only HTTP/1.x is supported");
+            return false;
+        }
+
+        method_ = {offset, methodEnd};
+        target_ = {offset + methodEnd + 1, targetEnd - methodEnd - 1};
+        minorVersion_ = version[7] - '0';
+        return true;
+    }
+
+    bool HttpRequestParser::parseHeaderLine(std::string_view line, size_t offset)
+    {
+        // Folded continuation lines and whitespace before the colon are how requests get smuggled
+        // past proxies that read them differently, so both are refused rather than repaired
+        if (line.front() == ' ' || line.front() == '\t')
+        {
+            fail(400, "Obsolete line folding is not supported");
+            return false;
+        }
+        size_t colon = line.find(':');
+        if (colon == std::string_view::npos || !isToken(line.substr(0, colon)))
+        {
+            fail(400, "Malformed header field");
+            return false;
+        }
+        if (headers_.size() >= limits_.maxHeaderCount)
+        {
+            fail(431, "Too many header fields");
+            return false;
+        }
+
+        std::string_view name = line.substr(0, colon);
+        std::string_view rawValue = line.substr(colon + 1);
+        std::string_view value = trimWhitespace(rawValue);
+        size_t valueOffset = offset + colon + 1 + static_cast<size_t>(value.data() - rawValue.data());
+        headers_.push_back({{offset, colon}, {valueOffset, value.size()}});
+
+        if (equalsIgnoreCase(name, "content-length"))
+        {
+            if (value.empty())
+            {
+                fail(400, "Invalid Content-Length");
+                return false;
+            }
+            size_t length = 0;
+            for (char c : value)
+            {
+                if (c < '0' || c > '9' || length > (std::numeric_limits<size_t>::max() - 9) / 10)
+                {
+                    fail(400, "Invalid Content-Length");
+                    return false;
+                }
+                length = length * 10 + static_cast<size_t>(c - '0');
+            }
+            if (hasContentLength_ && length != contentLength_)
+            {
+                fail(400, "Conflicting Content-Length");
+                return false;
+            }
+            hasContentLength_ = true;
+            contentLength_ = length;
+        }
+        else if (equalsIgnoreCase(name, "transfer-encoding"))
+        {
+            // chunked is the only coding understood, and it may be applied once
+            while (!value.empty())
+            {
+                size_t comma = value.find(',');
+                std::string_view coding = trimWhitespace(value.substr(0, comma));
+                value = comma == std::string_view::npos ? std::string_view() : value.substr(comma + 1);
+                if (coding.empty())
+                    continue;
+                if (!equalsIgnoreCase(coding, "chunked"))
+                {
+                    fail(501, "Unsupported transfer coding");
+                    return false;
+                }
+                if (chunked_)
+                {
+                    fail(400, "Transfer coding chunked applied twice");
+                    return false;
+                }
+                chunked_ = true;
+            }
+        }
+        return true;
+    }
+
+    HttpRequestParser::Status HttpRequestParser::finishHeaders()
+    {
+        if (chunked_ && hasContentLength_)
+            return fail(400, "Content-Length together with Transfer-Encoding");
+        if (chunked_)
+        {
+            contentLength_ = 0;
+            state_ = State::ChunkSize;
+        }
+        else
+        {
+            state_ = contentLength_ > 0 ? State::Body : State::Done;
+        }
+        return Status::HeadersComplete;
+    }
+
+    HttpRequestParser::Status HttpRequestParser::parse(std::string &buffer)
+    {
+        buffer_ = &buffer;
+        std::string_view data(buffer);
+        size_t lineEnd = 0;
+        size_t next = 0;
+
+        for (;;)
+        {
+            switch (state_)
+            {
+            case State::RequestLine:
+                if (!nextLine(data, lineEnd, next))
+                    return data.size() - start_ > limits_.maxHeaderBytes ? fail(431, "Request headers too large") : Status::Incomplete;
+                if (lineEnd == pos_)
+                {
+                    // Empty lines before a request (left over from a previous one) are skipped
+                    pos_ = start_ = next;
+                    if (pos_ > limits_.maxHeaderBytes)
+                        return fail(400, "Malformed request line");
+                    break;
+                }
+                if (next - start_ > limits_.maxHeaderBytes)
+                    return fail(431, "Request headers too large");
+                if (!parseRequestLine(data.substr(pos_, lineEnd - pos_), pos_))
+                    return Status::Error;
+                pos_ = next;
+                state_ = State::Headers;
+                break;
+
+            case State::Headers:
+                if (!nextLine(data, lineEnd, next))
+                    return data.size() - start_ > limits_.maxHeaderBytes ? fail(431, "Request headers too large") : Status::Incomplete;
+                if (next - start_ > limits_.maxHeaderBytes)
+                    return fail(431, "Request headers too large");
+                if (lineEnd == pos_)
+                {
+                    pos_ = bodyOffset_ = next;
+                    return finishHeaders();
+                }
+                if (!parseHeaderLine(data.substr(pos_, lineEnd - pos_), pos_))
+                    return Status::Error;
+                pos_ = next;
+                break;
+
+            case State::Body:
+                // Checked here rather than with the headers, so the caller can still hand
+                // the body to a reader that streams it instead of buffering it
+                if (limits_.maxBodyBytes > 0 && contentLength_ > limits_.maxBodyBytes)
+                    return fail(413, "Request body too large");
+                if (data.size() - bodyOffset_ < contentLength_)
+                    return Status::Incomplete;
+                pos_ = bodyOffset_ + contentLength_;
+                state_ = State::Done;
+                return Status::Complete;
+
+            case State::ChunkSize:
+            {
+                if (!nextLine(data, lineEnd, next))
+                    return data.size() - pos_ > kMaxChunkLineBytes ? fail(400, "Chunk size line too long") : Status::Incomplete;
+                size_t size = 0;
+                size_t i = pos_;
+                for (int digit; i < lineEnd && (digit = hexValue(data[i])) >= 0; ++i)
+                {
+                    if (size > (std::numeric_limits<size_t>::max() >> 4))
+                        return fail(413, "Request body too large");
+                    size = (size << 4) | static_cast<size_t>(digit);
+                }
+                if (i == pos_)
+                    return fail(400, "Invalid chunk size");
+                while (i < lineEnd && (data[i] == ' ' || data[i] == '\t'))
+                    ++i;
+                if (i < lineEnd && data[i] != ';')
+                    return fail(400, "Invalid chunk size");
+                pos_ = next;
+
+                if (size == 0)
+                {
+                    state_ = State::Trailers;
+                    break;
+                }
+                if (limits_.maxBodyBytes > 0 && size > limits_.maxBodyBytes - decoded_)
+                    return fail(413, "Request body too large");
+                chunkLeft_ = size;
+                state_ = State::ChunkData;
+                break;
+            }
+
+            case State::ChunkData:
+            {
+                // Move what has arrived of the chunk down to the end of the decoded body
+                size_t available = data.size() - pos_ < chunkLeft_ ? data.size() - pos_ : chunkLeft_;
+                if (available == 0)
+                    return Status::Incomplete;
+                size_t target = bodyOffset_ + decoded_;
+                if (target != pos_)
+                    std::memmove(&buffer[target], &buffer[pos_], available);
+                decoded_ += available;
+                pos_ += available;
+                chunkLeft_ -= available;
+                if (chunkLeft_ > 0)
+                    return Status::Incomplete;
+                state_ = State::ChunkDataEnd;
+                break;
+            }
+
+            case State::ChunkDataEnd:
+                if (pos_ >= data.size())
+                    return Status::Incomplete;
+                if (data[pos_] == '\r')
+                {
+                    if (pos_ + 1 >= data.size())
+                        return Status::Incomplete;
+                    if (data[pos_ + 1] != '\n')
+                        return fail(400, "Chunk data not followed by CRLF");
+                    pos_ += 2;
+                }
+                else if (data[pos_] == '\n')
+                {
+                    pos_ += 1;
+                }
+                else
+                {
+                    return fail(400, "Chunk data not followed by CRLF");
+                }
+                state_ = State::ChunkSize;
+                break;
+
+            case State::Trailers:
+            {
+                // Trailer fields are read past but not used; they count towards the header limit
+                if (!nextLine(data, lineEnd, next))
+                    return trailerBytes_ + (data.size() - pos_) > limits_.maxHeaderBytes ? fail(431, "Request trailers too large") : Status::Incomplete;
+                trailerBytes_ += next - pos_;
+                if (trailerBytes_ > limits_.maxHeaderBytes)
+                    return fail(431, "Request trailers too large");
+                bool last = lineEnd == pos_;
+                pos_ = next;
+                if (last)
+                {
+                    state_ = State::Done;
+                    return Status::Complete;
+                }
+                break;
+            }
+
+            case State::Done:
+                return Status::Complete;
+
+            case State::Failed:
+                return Status::Error;
+            }
+        }
+    }
+
+} // namespace kolosal
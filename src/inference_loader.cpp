@@ -1,6 +1,7 @@
 #include "kolosal/inference_loader.hpp"
 #include "kolosal/server_config.hpp"
 #include "kolosal/logger.hpp"
+#include "kolosal/hardware_features.hpp"
 #include "inference_interface.h"
 
 #include <filesystem>
@@ -24,7 +25,7 @@ namespace kolosal
         // Engines are now configured through configureEngines() method
         if (!plugins_dir_.empty())
         {
-            ServerLogger::logWarning("InferenceLoader plugins_dir parameter is deprecated. Use configureEngines() instead.");
+            KOLOSAL_LOG_WARNING("InferenceLoader plugins_dir parameter is deprecated. Use configureEngines() instead.");
         }
     }
 
@@ -41,12 +42,12 @@ namespace kolosal
                     try {
                         if (engine.handle) {
                             CLOSE_LIBRARY(engine.handle);
-                            ServerLogger::logInfo("Unloaded inference engine: %s", name.c_str());
+                            KOLOSAL_LOG_INFO("Unloaded inference engine: %s", name.c_str());
                         }
                     } catch (const std::exception& e) {
-                        ServerLogger::logError("Error unloading engine '%s': %s", name.c_str(), e.what());
+                        KOLOSAL_LOG_ERROR("Error unloading engine '%s': %s", name.c_str(), e.what());
                     } catch (...) {
-                        ServerLogger::logError("Unknown error unloading engine '%s'", name.c_str());
+                        KOLOSAL_LOG_ERROR("Unknown error unloading engine '%s'", name.c_str());
                     }
                 }
                 
@@ -68,21 +69,22 @@ namespace kolosal
                 // Validate engine configuration
                 if (engineConfig.name.empty())
                 {
-                    ServerLogger::logWarning("Skipping engine with empty name");
+                    KOLOSAL_LOG_WARNING("Skipping engine with empty name");
                     continue;
                 }
                 
-                if (engineConfig.library_path.empty())
+                const std::string libraryPath = selectLibrary(engineConfig);
+                if (libraryPath.empty())
                 {
-                    ServerLogger::logWarning("Skipping engine '%s' with empty library path", engineConfig.name.c_str());
+                    KOLOSAL_LOG_WARNING("Skipping engine '%s' with empty library path", engineConfig.name.c_str());
                     continue;
                 }
                 
                 // Check if library file exists
-                if (!std::filesystem::exists(engineConfig.library_path))
+                if (!std::filesystem::exists(libraryPath))
                 {
-                    ServerLogger::logWarning("Engine library not found: %s for engine '%s'", 
-                                           engineConfig.library_path.c_str(), engineConfig.name.c_str());
+                    KOLOSAL_LOG_WARNING("Engine library not found: %s for engine '%s'", 
+                                           libraryPath.c_str(), engineConfig.name.c_str());
                     continue;
                 }
                 
@@ -93,29 +95,29 @@ namespace kolosal
                 info.description = engineConfig.description.empty() 
                     ? ("Inference engine: " + engineConfig.name) 
                     : engineConfig.description;
-                info.library_path = engineConfig.library_path;
+                info.library_path = libraryPath;
                 info.is_loaded = false;
                 
                 available_engines_[engineConfig.name] = info;
                 
-                ServerLogger::logInfo("Configured inference engine: %s at %s", 
-                                    engineConfig.name.c_str(), engineConfig.library_path.c_str());
+                KOLOSAL_LOG_INFO("Configured inference engine: %s at %s", 
+                                    engineConfig.name.c_str(), libraryPath.c_str());
                 
                 // Auto-load if specified in config
                 if (engineConfig.load_on_startup)
                 {
                     if (loadEngine(engineConfig.name))
                     {
-                        ServerLogger::logInfo("Auto-loaded inference engine: %s", engineConfig.name.c_str());
+                        KOLOSAL_LOG_INFO("Auto-loaded inference engine: %s", engineConfig.name.c_str());
                     }
                     else
                     {
-                        ServerLogger::logWarning("Failed to auto-load inference engine: %s", engineConfig.name.c_str());
+                        KOLOSAL_LOG_WARNING("Failed to auto-load inference engine: %s", engineConfig.name.c_str());
                     }
                 }
             }
             
-            ServerLogger::logInfo("Engine configuration complete. Configured %zu inference engines.", available_engines_.size());
+            KOLOSAL_LOG_INFO("Engine configuration complete. Configured %zu inference engines.", available_engines_.size());
             return !available_engines_.empty();
         }
         catch (const std::exception &e)
@@ -125,6 +127,44 @@ namespace kolosal
         }
     }
 
+    std::string InferenceLoader::selectLibrary(const InferenceEngineConfig &engine)
+    {
+        if (engine.variants.empty())
+            return engine.library_path;
+
+        const HardwareFeatures &host = HardwareFeatures::host();
+        for (const auto &variant : engine.variants)
+        {
+            std::string features;
+            for (const auto &feature : variant.features)
+                features += (features.empty() ? "" : ",") + feature;
+
+            if (!host.supportsAll(variant.features))
+            {
+                KOLOSAL_LOG_DEBUG("Engine '%s': skipping %s, host lacks [%s]",
+                                       engine.name.c_str(), variant.library_path.c_str(), features.c_str());
+                continue;
+            }
+            if (!std::filesystem::exists(variant.library_path))
+            {
+                KOLOSAL_LOG_WARNING("Engine '%s': variant [%s] not found at %s",
+                                         engine.name.c_str(), features.c_str(), variant.library_path.c_str());
+                continue;
+            }
+            KOLOSAL_LOG_INFO("Engine '%s': selected variant [%s] at %s",
+                                  engine.name.c_str(), features.c_str(), variant.library_path.c_str());
+            return variant.library_path;
+        }
+
+        std::string hostFeatures;
+        for (const auto &tag : host.tags())
+            hostFeatures += (hostFeatures.empty() ? "" : ",") + tag;
+        KOLOSAL_LOG_WARNING("Engine '%s': no variant matches this host [%s]%s",
+                                 engine.name.c_str(), hostFeatures.c_str(),
+                                 engine.library_path.empty() ? "" : ", using library_path");
+        return engine.library_path;
+    }
+
     std::vector<InferenceEngineInfo> InferenceLoader::getAvailableEngines() const
     {
         std::vector<InferenceEngineInfo> engines;
@@ -231,11 +271,11 @@ namespace kolosal
                     }
                     catch (const std::exception &e)
                     {
-                        ServerLogger::logError("Exception during engine destruction for '%s': %s", engine_name.c_str(), e.what());
+                        KOLOSAL_LOG_ERROR("Exception during engine destruction for '%s': %s", engine_name.c_str(), e.what());
                     }
                     catch (...)
                     {
-                        ServerLogger::logError("Unknown exception during engine destruction for '%s'", engine_name.c_str());
+                        KOLOSAL_LOG_ERROR("Unknown exception during engine destruction for '%s'", engine_name.c_str());
                     }
                 }
             });
@@ -248,13 +288,13 @@ namespace kolosal
 
     void InferenceLoader::setPluginsDirectory(const std::string &plugins_dir)
     {
-        ServerLogger::logWarning("setPluginsDirectory() is deprecated. Use configureEngines() instead.");
+        KOLOSAL_LOG_WARNING("setPluginsDirectory() is deprecated. Use configureEngines() instead.");
         plugins_dir_ = plugins_dir;
     }
 
     std::string InferenceLoader::getPluginsDirectory() const
     {
-        ServerLogger::logWarning("getPluginsDirectory() is deprecated. Use configureEngines() instead.");
+        KOLOSAL_LOG_WARNING("getPluginsDirectory() is deprecated. Use configureEngines() instead.");
         return plugins_dir_;
     }
 
@@ -316,7 +356,7 @@ namespace kolosal
         // Update available engines info
         available_engines_[engine_name].is_loaded = true;
 
-        ServerLogger::logInfo("Successfully loaded inference engine: %s", engine_name.c_str());
+        KOLOSAL_LOG_INFO("Successfully loaded inference engine: %s", engine_name.c_str());
         return true;
     }
 
@@ -327,14 +367,14 @@ namespace kolosal
         {
             CLOSE_LIBRARY(it->second.handle);
             loaded_engines_.erase(it);
-            ServerLogger::logInfo("Unloaded inference engine: %s", engine_name.c_str());
+            KOLOSAL_LOG_INFO("Unloaded inference engine: %s", engine_name.c_str());
         }
     }
 
     void InferenceLoader::setLastError(const std::string &error) const
     {
         last_error_ = error;
-        ServerLogger::logError("InferenceLoader: %s", error.c_str());
+        KOLOSAL_LOG_ERROR("InferenceLoader: %s", error.c_str());
     }
 
 } // namespace kolosal
@@ -0,0 +1,624 @@
+#include "kolosal/job_manager.hpp"
+#include "kolosal/server_api.hpp"
+#include "kolosal/node_manager.h"
+#include "kolosal/sha256.hpp"
+#include "kolosal/logger.hpp"
+#include "kolosal/models/chat_request_model.hpp"
+#include "kolosal/models/completion_request_model.hpp"
+#include "kolosal/routes/llm/oai_parameters.hpp"
+#include "inference_interface.h"
+
+#include <curl/curl.h>
+#include <algorithm>
+#include <ctime>
+#include <random>
+#include <stdexcept>
+
+using json = nlohmann::json;
+
+namespace kolosal
+{
+
+namespace
+{
+    // Most candidates one job may ask for through n, as on /v1/completions
+    constexpr int kMaxCandidates = 16;
+
+    // How often running jobs are checked, and how often ended jobs past their time are dropped
+    constexpr std::chrono::milliseconds kPollInterval{20};
+    constexpr std::chrono::seconds kExpiryInterval{1};
+
+    // Delay before the first webhook retry; each further one waits twice as long
+    constexpr std::chrono::seconds kWebhookRetryDelay{2};
+
+    int64_t now()
+    {
+        return static_cast<int64_t>(std::time(nullptr));
+    }
+
+    std::string randomHex(size_t bytes)
+    {
+        static thread_local std::mt19937_64 engine(std::random_device{}() ^
+                                                   static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count()));
+        static const char digits[] = "0123456789abcdef";
+        std::string out;
+        out.reserve(bytes * 2);
+        for (size_t i = 0; i < bytes; ++i)
+        {
+            const unsigned value = static_cast<unsigned>(engine() & 0xFF);
+            out.push_back(digits[value >> 4]);
+            out.push_back(digits[value & 0xF]);
+        }
+        return out;
+    }
+
+    json timestamp(int64_t value)
+    {
+        return value > 0 ? json(value) : json(nullptr);
+    }
+
+    bool isEnded(const std::string& status)
+    {
+        return status == "completed" || status == "failed" || status == "cancelled";
+    }
+
+    size_t discardBody(char*, size_t size, size_t count, void*)
+    {
+        return size * count;
+    }
+}
+
+struct JobManager::Running
+{
+    std::string id;
+    std::string model;
+    bool chat = true;
+    std::shared_ptr<IInferenceEngine> engine;
+    std::vector<int> jobIds;
+    std::unique_ptr<auth::TokenQuotaCharge> charge;   // Settled when the entry is dropped
+
+    void stop()
+    {
+        for (int jobId : jobIds)
+        {
+            engine->stopJob(jobId);
+            engine->releaseJob(jobId);
+        }
+    }
+};
+
+json JobManager::Job::toJson(bool withResult) const
+{
+    json errorJson = nullptr;
+    if (!error.empty())
+    {
+        errorJson = {{"status_code", error_status},
+                     {"message", error},
+                     {"type", error_status >= 500 ? "server_error" : "invalid_request_error"}};
+    }
+    json webhook = nullptr;
+    if (!webhook_url.empty())
+        webhook = {{"url", webhook_url}, {"status", webhook_status}, {"attempts", webhook_attempts}};
+
+    json j = {{"id", id},
+              {"object", "job"},
+              {"endpoint", endpoint},
+              {"model", model},
+              {"status", status},
+              {"created_at", created_at},
+              {"started_at", timestamp(started_at)},
+              {"ended_at", timestamp(ended_at)},
+              {"expires_at", timestamp(expires_at)},
+              {"error", errorJson},
+              {"webhook", webhook},
+              {"metadata", metadata.is_object() ? metadata : json(nullptr)}};
+    if (withResult)
+        j["result"] = status == "completed" ? result : json(nullptr);
+    return j;
+}
+
+JobManager& JobManager::instance()
+{
+    static JobManager manager;
+    return manager;
+}
+
+JobManager::~JobManager()
+{
+    stop();
+}
+
+void JobManager::start(const JobsConfig& config)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (started_ || !config.enabled)
+        return;
+    config_ = config;
+    started_ = true;
+    stopping_ = false;
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+    worker_ = std::thread(&JobManager::run, this);
+    webhookSender_ = std::thread(&JobManager::deliverWebhooks, this);
+    KOLOSAL_LOG_INFO("Async jobs enabled (%d running at once, results kept %d s)",
+                     config.max_running, config.result_ttl_seconds);
+}
+
+void JobManager::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!started_)
+            return;
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    webhookCv_.notify_all();
+    if (worker_.joinable())
+        worker_.join();
+    if (webhookSender_.joinable())
+        webhookSender_.join();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    jobs_.clear();
+    requests_.clear();
+    queue_.clear();
+    webhooks_.clear();
+    started_ = false;
+}
+
+bool JobManager::enabled() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return started_;
+}
+
+JobManager::Job JobManager::submit(const std::string& owner, const std::string& endpoint, const json& body,
+                                   const std::string& webhookUrl, const json& metadata,
+                                   std::unique_ptr<auth::TokenQuotaCharge> charge, size_t promptTokens)
+{
+    const bool chat = endpoint == "/v1/chat/completions";
+    if (!chat && endpoint != "/v1/completions")
+        throw std::invalid_argument("endpoint must be /v1/chat/completions or /v1/completions");
+    if (!body.is_object() || !body.contains("model") || !body["model"].is_string() || body["model"].get<std::string>().empty())
+        throw std::invalid_argument("body must be a request object with a model");
+    if (body.value("stream", false))
+        throw std::invalid_argument("Jobs do not stream; fetch the result or use a webhook instead");
+    const int candidates = body.value("n", 1);
+    if (candidates < 1 || candidates > kMaxCandidates)
+        throw std::invalid_argument("n must be between 1 and " + std::to_string(kMaxCandidates));
+    if (!webhookUrl.empty() && webhookUrl.rfind("http://", 0) != 0 && webhookUrl.rfind("https://", 0) != 0)
+        throw std::invalid_argument("webhook_url must be an http or https URL");
+
+    // Caught here rather than minutes later, when the job would start
+    bool valid = false;
+    try
+    {
+        if (chat)
+        {
+            ChatCompletionRequest parsed;
+            parsed.from_json(body);
+            valid = parsed.validate();
+        }
+        else
+        {
+            CompletionRequest parsed;
+            parsed.from_json(body);
+            valid = parsed.validate();
+        }
+    }
+    catch (const std::exception& ex)
+    {
+        throw std::invalid_argument(std::string("Invalid request body: ") + ex.what());
+    }
+    if (!valid)
+        throw std::invalid_argument("Invalid request parameters");
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (queue_.size() >= static_cast<size_t>(config_.max_queued))
+        throw std::length_error("Too many jobs are waiting; try again later");
+
+    Job job;
+    job.id = "job_" + randomHex(12);
+    job.endpoint = endpoint;
+    job.model = body["model"].get<std::string>();
+    job.webhook_url = webhookUrl;
+    job.created_at = now();
+    job.metadata = metadata;
+    job.owner = owner;
+
+    jobs_[job.id] = job;
+    Queued& queued = requests_[job.id];
+    queued.body = body;
+    queued.charge = std::move(charge);
+    queued.promptTokens = promptTokens;
+    queue_.push_back(job.id);
+    cv_.notify_all();
+    return job;
+}
+
+std::optional<JobManager::Job> JobManager::get(const std::string& owner, const std::string& id) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = jobs_.find(id);
+    if (it == jobs_.end() || it->second.owner != owner)
+        return std::nullopt;
+    return it->second;
+}
+
+std::vector<JobManager::Job> JobManager::list(const std::string& owner, const std::string& after, size_t limit) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<const Job*> jobs;
+    for (const auto& entry : jobs_)
+    {
+        if (entry.second.owner == owner)
+            jobs.push_back(&entry.second);
+    }
+    std::sort(jobs.begin(), jobs.end(), [](const Job* a, const Job* b)
+              { return a->created_at != b->created_at ? a->created_at > b->created_at : a->id > b->id; });
+
+    auto first = jobs.begin();
+    if (!after.empty())
+    {
+        first = std::find_if(jobs.begin(), jobs.end(), [&after](const Job* job) { return job->id == after; });
+        if (first != jobs.end())
+            ++first;
+    }
+
+    // Listings leave the results out, so copying a page stays cheap
+    std::vector<Job> page;
+    for (auto it = first; it != jobs.end() && page.size() < limit; ++it)
+    {
+        page.push_back(**it);
+        page.back().result = nullptr;
+    }
+    return page;
+}
+
+std::optional<JobManager::Job> JobManager::cancel(const std::string& owner, const std::string& id)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = jobs_.find(id);
+    if (it == jobs_.end() || it->second.owner != owner)
+        return std::nullopt;
+
+    // A queued job is skipped when its turn comes (dropping its charge refunds the quota),
+    // and a running one stopped at the next poll
+    if (!isEnded(it->second.status))
+    {
+        requests_.erase(id);
+        finishLocked(it->second, "cancelled");
+        cv_.notify_all();
+    }
+    return it->second;
+}
+
+bool JobManager::remove(const std::string& owner, const std::string& id)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = jobs_.find(id);
+    if (it == jobs_.end() || it->second.owner != owner)
+        return false;
+    if (!isEnded(it->second.status))
+        throw std::invalid_argument("Job " + id + " has not ended; cancel it first");
+    jobs_.erase(it);
+    return true;
+}
+
+void JobManager::finishLocked(Job& job, const std::string& status)
+{
+    job.status = status;
+    job.ended_at = now();
+    job.expires_at = job.ended_at + config_.result_ttl_seconds;
+    if (!job.webhook_url.empty())
+    {
+        job.webhook_status = "pending";
+        webhooks_.emplace(std::chrono::steady_clock::now(), job.id);
+        webhookCv_.notify_all();
+    }
+    KOLOSAL_LOG_DEBUG("Job %s %s", job.id.c_str(), status.c_str());
+}
+
+void JobManager::expireLocked(int64_t timestamp)
+{
+    for (auto it = jobs_.begin(); it != jobs_.end();)
+    {
+        if (isEnded(it->second.status) && it->second.expires_at <= timestamp)
+            it = jobs_.erase(it);
+        else
+            ++it;
+    }
+}
+
+bool JobManager::startQueued(std::vector<Running>& running)
+{
+    auto& nodeManager = ServerAPI::instance().getNodeManager();
+    bool progressed = false;
+    while (true)
+    {
+        Running next;
+        json body;
+        std::string tenant;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (stopping_ || queue_.empty() || running.size() >= static_cast<size_t>(config_.max_running))
+                break;
+            next.id = queue_.front();
+            auto job = jobs_.find(next.id);
+            auto request = requests_.find(next.id);
+            if (job == jobs_.end() || job->second.status != "queued" || request == requests_.end())
+            {
+                // Cancelled while it waited
+                queue_.pop_front();
+                requests_.erase(next.id);
+                continue;
+            }
+            next.model = job->second.model;
+            next.chat = job->second.endpoint == "/v1/chat/completions";
+            tenant = job->second.owner;
+            body = request->second.body;
+        }
+
+        int errorStatus = 0;
+        std::string error;
+        next.engine = nodeManager.getEngine(next.model);
+        if (!next.engine)
+        {
+            // Startup models load in the background; the queue waits for them
+            const auto states = nodeManager.getStartupStates();
+            auto state = states.find(next.model);
+            if (state != states.end() && (state->second == "pending" || state->second == "loading" ||
+                                          state->second == "downloading"))
+                break;
+            errorStatus = 404;
+            error = "Model '" + next.model + "' not found or could not be loaded";
+        }
+        else
+        {
+            try
+            {
+                next.jobIds = submitCompletionJobs(*next.engine, next.chat, body, body.value("n", 1), 0, tenant);
+                if (next.jobIds.empty())
+                {
+                    errorStatus = 500;
+                    error = "Failed to submit job to inference engine";
+                }
+            }
+            catch (const std::exception& ex)
+            {
+                errorStatus = 400;
+                error = ex.what();
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        // Only this thread takes from the queue, so its front is still the job just started.
+        // A job that fails to start drops its charge with nothing used, refunding the quota.
+        size_t promptTokens = 0;
+        auto request = requests_.find(next.id);
+        if (request != requests_.end())
+        {
+            next.charge = std::move(request->second.charge);
+            promptTokens = request->second.promptTokens;
+        }
+        queue_.pop_front();
+        requests_.erase(next.id);
+        progressed = true;
+        auto job = jobs_.find(next.id);
+        if (job == jobs_.end() || job->second.status != "queued")
+        {
+            next.stop();
+            continue;
+        }
+        if (!error.empty())
+        {
+            job->second.error_status = errorStatus;
+            job->second.error = error;
+            finishLocked(job->second, "failed");
+            continue;
+        }
+        if (next.charge)
+            next.charge->setPromptTokens(promptTokens);
+        job->second.status = "in_progress";
+        job->second.started_at = now();
+        running.push_back(std::move(next));
+    }
+    return progressed;
+}
+
+bool JobManager::collect(std::vector<Running>& running)
+{
+    bool progressed = false;
+    for (auto it = running.begin(); it != running.end();)
+    {
+        bool cancelled = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto job = jobs_.find(it->id);
+            cancelled = job == jobs_.end() || job->second.status != "in_progress";
+        }
+        if (cancelled)
+        {
+            it->stop();
+            it = running.erase(it);
+            progressed = true;
+            continue;
+        }
+
+        IInferenceEngine& engine = *it->engine;
+        if (!std::all_of(it->jobIds.begin(), it->jobIds.end(), [&engine](int jobId) { return engine.isJobFinished(jobId); }))
+        {
+            ++it;
+            continue;
+        }
+
+        std::string failure;
+        std::vector<CompletionResult> results;
+        for (int jobId : it->jobIds)
+        {
+            if (engine.hasJobError(jobId))
+                failure = engine.getJobError(jobId);
+            else
+                results.push_back(engine.getJobResult(jobId));
+            engine.releaseJob(jobId);
+        }
+        if (it->charge)
+        {
+            if (!results.empty() && results.front().prompt_token_count > 0)
+                it->charge->setPromptTokens(static_cast<size_t>(results.front().prompt_token_count));
+            for (const auto& result : results)
+                it->charge->addGeneratedTokens(result.tokens.size());
+        }
+        json body = failure.empty() ? completionResponseBody(it->chat, it->model, it->jobIds.front(), results) : json();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto job = jobs_.find(it->id);
+            if (job != jobs_.end() && job->second.status == "in_progress")
+            {
+                if (failure.empty())
+                {
+                    job->second.result = std::move(body);
+                    finishLocked(job->second, "completed");
+                }
+                else
+                {
+                    job->second.error_status = 500;
+                    job->second.error = failure;
+                    finishLocked(job->second, "failed");
+                }
+            }
+        }
+        it = running.erase(it);
+        progressed = true;
+    }
+    return progressed;
+}
+
+void JobManager::run()
+{
+    std::vector<Running> running;
+    auto lastExpiry = std::chrono::steady_clock::now();
+    while (true)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (stopping_)
+                break;
+        }
+
+        bool progressed = collect(running);
+        progressed = startQueued(running) || progressed;
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (std::chrono::steady_clock::now() - lastExpiry >= kExpiryInterval)
+        {
+            expireLocked(now());
+            lastExpiry = std::chrono::steady_clock::now();
+        }
+        // Idle, the worker only wakes for a submission or the next expiry
+        if (!progressed && !stopping_)
+            cv_.wait_for(lock, running.empty() && queue_.empty() ? std::chrono::milliseconds(kExpiryInterval) : kPollInterval);
+    }
+
+    for (auto& job : running)
+        job.stop();
+}
+
+bool JobManager::post(const Job& job, std::string& error) const
+{
+    CURL* curl = curl_easy_init();
+    if (!curl)
+    {
+        error = "cannot create a connection";
+        return false;
+    }
+
+    const std::string payload = job.toJson().dump();
+    const std::string sentAt = std::to_string(now());
+    struct curl_slist* headers = nullptr;
+    headers = curl_slist_append(headers, "Content-Type: application/json");
+    headers = curl_slist_append(headers, "Expect:");
+    headers = curl_slist_append(headers, ("X-Kolosal-Job-Id: " + job.id).c_str());
+    if (!config_.webhook_secret.empty())
+    {
+        // The receiver recomputes this over "<timestamp>.<body>" and rejects stale timestamps
+        headers = curl_slist_append(headers, ("X-Kolosal-Timestamp: " + sentAt).c_str());
+        headers = curl_slist_append(headers, ("X-Kolosal-Signature: sha256=" +
+                                              Sha256::hmacHex(config_.webhook_secret, sentAt + "." + payload)).c_str());
+    }
+
+    curl_easy_setopt(curl, CURLOPT_URL, job.webhook_url.c_str());
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+    curl_easy_setopt(curl, CURLOPT_POST, 1L);
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, payload.data());
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE_LARGE, static_cast<curl_off_t>(payload.size()));
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, discardBody);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT, static_cast<long>(config_.webhook_timeout_seconds));
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+
+    const CURLcode result = curl_easy_perform(curl);
+    long status = 0;
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status);
+    curl_slist_free_all(headers);
+    curl_easy_cleanup(curl);
+
+    if (result != CURLE_OK)
+        error = curl_easy_strerror(result);
+    else if (status < 200 || status >= 300)
+        error = "HTTP " + std::to_string(status);
+    return error.empty();
+}
+
+void JobManager::deliverWebhooks()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stopping_)
+    {
+        if (webhooks_.empty())
+        {
+            webhookCv_.wait(lock);
+            continue;
+        }
+        auto due = webhooks_.begin();
+        if (due->first > std::chrono::steady_clock::now())
+        {
+            webhookCv_.wait_until(lock, due->first);
+            continue;
+        }
+        const std::string id = due->second;
+        webhooks_.erase(due);
+        auto it = jobs_.find(id);
+        if (it == jobs_.end())
+            continue;
+        const Job job = it->second;
+
+        lock.unlock();
+        std::string error;
+        const bool delivered = post(job, error);
+        lock.lock();
+
+        it = jobs_.find(id);
+        if (it == jobs_.end())
+            continue;
+        Job& stored = it->second;
+        ++stored.webhook_attempts;
+        if (delivered)
+        {
+            stored.webhook_status = "delivered";
+        }
+        else if (stored.webhook_attempts > config_.webhook_retries || stopping_)
+        {
+            stored.webhook_status = "failed";
+            KOLOSAL_LOG_WARNING("Job %s: webhook %s failed after %d attempt(s): %s", id.c_str(),
+                                stored.webhook_url.c_str(), stored.webhook_attempts, error.c_str());
+        }
+        else
+        {
+            const int doublings = std::min(stored.webhook_attempts - 1, 8);
+            webhooks_.emplace(std::chrono::steady_clock::now() + kWebhookRetryDelay * (1 << doublings), id);
+        }
+    }
+}
+
+} // namespace kolosal
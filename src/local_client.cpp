@@ -0,0 +1,150 @@
+#include "kolosal/local_client.hpp"
+#include "kolosal/node_manager.h"
+#include "kolosal/server_api.hpp"
+#include "kolosal/worker_pool.hpp"
+#include "kolosal/retrieval/document_service.hpp"
+
+#include <algorithm>
+#include <utility>
+
+namespace kolosal
+{
+
+    namespace
+    {
+        // Waits for one job, streaming its output if asked, and returns its full result
+        CompletionResult finishJob(IInferenceEngine &engine, int jobId, const LocalClient::StreamCallback &onDelta)
+        {
+            if (jobId < 0)
+                throw LocalClient::Error("job_failed", "The engine did not accept the job");
+
+            struct Release
+            {
+                IInferenceEngine &engine;
+                int jobId;
+                ~Release() { engine.releaseJob(jobId); }
+            } release{engine, jobId};
+
+            if (onDelta)
+            {
+                CompletionDelta delta;
+                bool streaming = true;
+                while (engine.waitForJobOutput(jobId, delta, 1000))
+                {
+                    if (delta.hasError)
+                        break;
+                    if (streaming && (!delta.tokens.empty() || !delta.text.empty()) && !onDelta(delta))
+                    {
+                        engine.stopJob(jobId);
+                        streaming = false;
+                    }
+                    if (delta.finished)
+                        break;
+                }
+            }
+            else
+            {
+                engine.waitForJob(jobId);
+            }
+
+            if (engine.hasJobError(jobId))
+                throw LocalClient::Error("job_failed", engine.getJobError(jobId));
+            return engine.getJobResult(jobId);
+        }
+    }
+
+    LocalClient::LocalClient(size_t maxConcurrent)
+        : LocalClient(ServerAPI::instance().getNodeManager(), maxConcurrent)
+    {
+    }
+
+    LocalClient::LocalClient(NodeManager &nodeManager, size_t maxConcurrent)
+        : nodeManager_(nodeManager), pool_(std::make_unique<WorkerPool>(0, std::max<size_t>(maxConcurrent, 1)))
+    {
+    }
+
+    LocalClient::~LocalClient()
+    {
+        // Queued calls may still use the document service
+        pool_->shutdown();
+    }
+
+    template <typename R, typename F>
+    std::future<R> LocalClient::run(F &&fn)
+    {
+        auto task = std::make_shared<std::packaged_task<R()>>(std::forward<F>(fn));
+        std::future<R> result = task->get_future();
+        if (!pool_->submit([task]() { (*task)(); }))
+            (*task)();
+        return result;
+    }
+
+    std::shared_ptr<IInferenceEngine> LocalClient::engineFor(const std::string &model)
+    {
+        NodeManager::Admission admission;
+        auto engine = nodeManager_.getEngine(model, admission);
+        if (admission.rejected)
+            throw Error("model_overloaded", "Model '" + model + "' is at capacity, retry in " +
+                                                std::to_string(admission.retryAfterSeconds) + "s");
+        if (!engine)
+            throw Error("model_not_found", "Model '" + model + "' not found or could not be loaded");
+        return engine;
+    }
+
+    std::future<CompletionResult> LocalClient::chat(const std::string &model, ChatCompletionParameters params,
+                                                    StreamCallback onDelta)
+    {
+        return run<CompletionResult>([this, model, params = std::move(params), onDelta = std::move(onDelta)]()
+                                     {
+                                         auto engine = engineFor(model);
+                                         return finishJob(*engine, engine->submitChatCompletionsJob(params), onDelta);
+                                     });
+    }
+
+    std::future<CompletionResult> LocalClient::complete(const std::string &model, CompletionParameters params,
+                                                        StreamCallback onDelta)
+    {
+        return run<CompletionResult>([this, model, params = std::move(params), onDelta = std::move(onDelta)]()
+                                     {
+                                         auto engine = engineFor(model);
+                                         return finishJob(*engine, engine->submitCompletionsJob(params), onDelta);
+                                     });
+    }
+
+    std::future<std::vector<EmbeddingResult>> LocalClient::embed(const std::string &model, std::vector<std::string> inputs,
+                                                                 bool normalize)
+    {
+        return run<std::vector<EmbeddingResult>>([this, model, inputs = std::move(inputs), normalize]() mutable
+                                                 {
+                                                     auto engine = engineFor(model);
+                                                     std::vector<EmbeddingParameters> batch(inputs.size());
+                                                     for (size_t i = 0; i < inputs.size(); ++i)
+                                                     {
+                                                         batch[i].input = std::move(inputs[i]);
+                                                         batch[i].normalize = normalize;
+                                                     }
+                                                     return engine->submitEmbeddingBatch(batch);
+                                                 });
+    }
+
+    retrieval::DocumentService &LocalClient::documents()
+    {
+        std::lock_guard<std::mutex> lock(documentsMutex_);
+        if (!documents_)
+        {
+            auto service = std::make_unique<retrieval::DocumentService>(retrieval::DocumentService::serverDatabaseConfig());
+            if (!service->initialize().get())
+                throw Error("service_error", "Failed to initialize document service");
+            documents_ = std::move(service);
+        }
+        return *documents_;
+    }
+
+    std::future<retrieval::RetrieveResponse> LocalClient::retrieve(const retrieval::RetrieveRequest &request)
+    {
+        // The service runs retrieval on its own executor; only connecting it needs a thread here
+        return run<retrieval::RetrieveResponse>([this, request]()
+                                                { return documents().retrieveDocuments(request).get(); });
+    }
+
+} // namespace kolosal
@@ -5,14 +5,41 @@
 #include <sstream>
 #include <cstdio>
 #include <cstdarg>
+#include <cstdint>
+#include <ctime>
+#include <algorithm>
 
-ServerLogger::ServerLogger() : minLevel(LogLevel::SERVER_INFO), quietMode(false), showRequestDetails(true)
+ServerLogger::ServerLogger()
+    : minLevel(static_cast<int>(LogLevel::SERVER_INFO)), quietMode(false), showRequestDetails(true),
+      ring(new Slot[RING_CAPACITY])
 {
-    // Default constructor
+    for (size_t i = 0; i < RING_CAPACITY; ++i)
+    {
+        ring[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    updateCategoryLevels();
+    writer = std::thread(&ServerLogger::writerLoop, this);
 }
 
 ServerLogger::~ServerLogger()
 {
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        stopping = true;
+    }
+    wakeCv.notify_one();
+    if (writer.joinable())
+    {
+        writer.join();
+    }
+
+    // Write whatever was logged while shutting down; the writer may also have been
+    // terminated already if the process is exiting
+    while (drain() > 0)
+    {
+    }
+
+    std::lock_guard<std::mutex> lock(fileMutex);
     if (logFile.is_open())
     {
         logFile.close();
@@ -27,25 +54,38 @@ ServerLogger &ServerLogger::instance()
 
 void ServerLogger::setLevel(LogLevel level)
 {
-    std::lock_guard<std::mutex> lock(logMutex);
-    minLevel = level;
+    minLevel.store(static_cast<int>(level), std::memory_order_relaxed);
+    updateCategoryLevels();
 }
 
 void ServerLogger::setQuietMode(bool enabled)
 {
-    std::lock_guard<std::mutex> lock(logMutex);
-    quietMode = enabled;
+    quietMode.store(enabled, std::memory_order_relaxed);
+    updateCategoryLevels();
 }
 
 void ServerLogger::setShowRequestDetails(bool enabled)
 {
-    std::lock_guard<std::mutex> lock(logMutex);
-    showRequestDetails = enabled;
+    showRequestDetails.store(enabled, std::memory_order_relaxed);
+    updateCategoryLevels();
+}
+
+void ServerLogger::updateCategoryLevels()
+{
+    const int level = minLevel.load(std::memory_order_relaxed);
+    const int routine = std::min(level, static_cast<int>(LogLevel::SERVER_WARNING));
+    const bool quiet = quietMode.load(std::memory_order_relaxed);
+    const bool details = showRequestDetails.load(std::memory_order_relaxed);
+
+    // Muted categories still report warnings and errors
+    categoryLevel[static_cast<int>(LogCategory::General)].store(level, std::memory_order_relaxed);
+    categoryLevel[static_cast<int>(LogCategory::Connection)].store(quiet ? routine : level, std::memory_order_relaxed);
+    categoryLevel[static_cast<int>(LogCategory::Request)].store(quiet || !details ? routine : level, std::memory_order_relaxed);
 }
 
 bool ServerLogger::setLogFile(const std::string &filePath)
 {
-    std::lock_guard<std::mutex> lock(logMutex);
+    std::lock_guard<std::mutex> lock(fileMutex);
 
     // Close existing file if open
     if (logFile.is_open())
@@ -65,6 +105,49 @@ bool ServerLogger::setLogFile(const std::string &filePath)
     return true;
 }
 
+void ServerLogger::setHistoryCapacity(size_t capacity)
+{
+    std::lock_guard<std::mutex> lock(historyMutex);
+
+    // Keep the newest entries that still fit, oldest first
+    std::vector<LogEntry> kept;
+    const size_t count = history.size();
+    const size_t keep = std::min(count, capacity);
+    kept.reserve(keep);
+    for (size_t i = count - keep; i < count; ++i)
+    {
+        kept.push_back(std::move(history[(historyStart + i) % count]));
+    }
+    history = std::move(kept);
+    historyStart = 0;
+    historyCapacity = capacity;
+}
+
+void ServerLogger::flush()
+{
+    const size_t target = enqueuePos.load(std::memory_order_acquire);
+    std::unique_lock<std::mutex> lock(wakeMutex);
+    wakeCv.notify_one();
+    flushedCv.wait(lock, [&]
+                   { return writtenPos.load(std::memory_order_acquire) >= target || stopping; });
+}
+
+void ServerLogger::write(LogLevel level, LogCategory category, const std::string &message)
+{
+    if (isEnabled(level, category))
+    {
+        log(level, message);
+    }
+}
+
+void ServerLogger::write(LogLevel level, LogCategory category, const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    logFormatted(level, category, format, args);
+    va_end(args);
+}
+
 void ServerLogger::error(const std::string &message)
 {
     log(LogLevel::SERVER_ERROR, message);
@@ -87,54 +170,34 @@ void ServerLogger::debug(const std::string &message)
 
 void ServerLogger::error(const char *format, ...)
 {
-    if (LogLevel::SERVER_ERROR > minLevel)
-        return;
-
     va_list args;
     va_start(args, format);
-    std::string formattedMsg = formatString(format, args);
+    logFormatted(LogLevel::SERVER_ERROR, LogCategory::General, format, args);
     va_end(args);
-
-    log(LogLevel::SERVER_ERROR, formattedMsg);
 }
 
 void ServerLogger::warning(const char *format, ...)
 {
-    if (LogLevel::SERVER_WARNING > minLevel)
-        return;
-
     va_list args;
     va_start(args, format);
-    std::string formattedMsg = formatString(format, args);
+    logFormatted(LogLevel::SERVER_WARNING, LogCategory::General, format, args);
     va_end(args);
-
-    log(LogLevel::SERVER_WARNING, formattedMsg);
 }
 
 void ServerLogger::info(const char *format, ...)
 {
-    if (LogLevel::SERVER_INFO > minLevel)
-        return;
-
     va_list args;
     va_start(args, format);
-    std::string formattedMsg = formatString(format, args);
+    logFormatted(LogLevel::SERVER_INFO, LogCategory::General, format, args);
     va_end(args);
-
-    log(LogLevel::SERVER_INFO, formattedMsg);
 }
 
 void ServerLogger::debug(const char *format, ...)
 {
-    if (LogLevel::SERVER_DEBUG > minLevel)
-        return;
-
     va_list args;
     va_start(args, format);
-    std::string formattedMsg = formatString(format, args);
+    logFormatted(LogLevel::SERVER_DEBUG, LogCategory::General, format, args);
     va_end(args);
-
-    log(LogLevel::SERVER_DEBUG, formattedMsg);
 }
 
 void ServerLogger::logError(const std::string &message)
@@ -161,45 +224,127 @@ void ServerLogger::logError(const char *format, ...)
 {
     va_list args;
     va_start(args, format);
-    std::string formattedMsg = instance().formatString(format, args);
+    instance().logFormatted(LogLevel::SERVER_ERROR, LogCategory::General, format, args);
     va_end(args);
-
-    instance().error(formattedMsg);
 }
 
 void ServerLogger::logWarning(const char *format, ...)
 {
     va_list args;
     va_start(args, format);
-    std::string formattedMsg = instance().formatString(format, args);
+    instance().logFormatted(LogLevel::SERVER_WARNING, LogCategory::General, format, args);
     va_end(args);
-
-    instance().warning(formattedMsg);
 }
 
 void ServerLogger::logInfo(const char *format, ...)
 {
     va_list args;
     va_start(args, format);
-    std::string formattedMsg = instance().formatString(format, args);
+    instance().logFormatted(LogLevel::SERVER_INFO, LogCategory::General, format, args);
     va_end(args);
-
-    instance().info(formattedMsg);
 }
 
 void ServerLogger::logDebug(const char *format, ...)
 {
     va_list args;
     va_start(args, format);
-    std::string formattedMsg = instance().formatString(format, args);
+    instance().logFormatted(LogLevel::SERVER_DEBUG, LogCategory::General, format, args);
     va_end(args);
+}
+
+std::vector<LogEntry> ServerLogger::getLogs() const
+{
+    std::lock_guard<std::mutex> lock(historyMutex);
+    std::vector<LogEntry> entries;
+    entries.reserve(history.size());
+    for (size_t i = 0; i < history.size(); ++i)
+    {
+        entries.push_back(history[(historyStart + i) % history.size()]);
+    }
+    return entries;
+}
+
+std::vector<LogEntry> ServerLogger::getLogsAfter(uint64_t &cursor, size_t maxCount, const LogFilter &filter) const
+{
+    std::lock_guard<std::mutex> lock(historyMutex);
+    std::vector<LogEntry> entries;
+    if (history.empty())
+    {
+        return entries;
+    }
+
+    // Ids are consecutive, so the first entry after the cursor is found by arithmetic
+    const uint64_t oldest = history[historyStart].id;
+    size_t index = cursor < oldest ? 0 : static_cast<size_t>(cursor - oldest + 1);
+    for (; index < history.size() && entries.size() < maxCount; ++index)
+    {
+        const LogEntry &entry = history[(historyStart + index) % history.size()];
+        cursor = entry.id;
+        if (!filter || filter(entry))
+        {
+            entries.push_back(entry);
+        }
+    }
+    return entries;
+}
+
+std::vector<LogEntry> ServerLogger::getLogsBefore(uint64_t &cursor, size_t maxCount, const LogFilter &filter) const
+{
+    std::lock_guard<std::mutex> lock(historyMutex);
+    std::vector<LogEntry> entries;
+    if (history.empty())
+    {
+        return entries;
+    }
+
+    const uint64_t oldest = history[historyStart].id;
+    if (cursor != 0 && cursor <= oldest)
+    {
+        return entries;
+    }
+    size_t end = cursor == 0 ? history.size() : std::min(history.size(), static_cast<size_t>(cursor - oldest));
+    while (end > 0 && entries.size() < maxCount)
+    {
+        --end;
+        const LogEntry &entry = history[(historyStart + end) % history.size()];
+        cursor = entry.id;
+        if (!filter || filter(entry))
+        {
+            entries.push_back(entry);
+        }
+    }
+    std::reverse(entries.begin(), entries.end());
+    return entries;
+}
+
+bool ServerLogger::waitForLogs(uint64_t cursor, std::chrono::milliseconds timeout) const
+{
+    std::unique_lock<std::mutex> lock(historyMutex);
+    return historyCv.wait_for(lock, timeout, [&]
+                              { return lastId > cursor; });
+}
 
-    instance().debug(formattedMsg);
+uint64_t ServerLogger::oldestLogId() const
+{
+    std::lock_guard<std::mutex> lock(historyMutex);
+    return history.empty() ? lastId + 1 : history[historyStart].id;
 }
 
-const std::vector<LogEntry> &ServerLogger::getLogs() const
+uint64_t ServerLogger::newestLogId() const
 {
-    return logs;
+    std::lock_guard<std::mutex> lock(historyMutex);
+    return lastId;
+}
+
+void ServerLogger::memoryUsage(size_t &ringBytes, size_t &historyBytes, size_t &historyEntries) const
+{
+    // Slot messages are owned by the writer while it drains them, so only the slots are counted
+    ringBytes = RING_CAPACITY * sizeof(Slot);
+    std::lock_guard<std::mutex> lock(historyMutex);
+    historyEntries = history.size();
+    historyBytes = history.capacity() * sizeof(LogEntry);
+    for (const auto &entry : history)
+        historyBytes += entry.timestamp.capacity() + entry.message.capacity();
 }
 
 std::string ServerLogger::formatString(const char *format, va_list args)
@@ -221,66 +366,185 @@ std::string ServerLogger::formatString(const char *format, va_list args)
     return std::string(buffer.data(), buffer.data() + size - 1); // -1 to exclude null terminator
 }
 
+void ServerLogger::logFormatted(LogLevel level, LogCategory category, const char *format, va_list args)
+{
+    // Disabled levels cost a comparison, not a vsnprintf
+    if (!isEnabled(level, category))
+    {
+        return;
+    }
+    log(level, formatString(format, args));
+}
+
+bool ServerLogger::tryEnqueue(LogLevel level, std::chrono::system_clock::time_point time, std::string &message)
+{
+    size_t pos = enqueuePos.load(std::memory_order_relaxed);
+    while (true)
+    {
+        Slot &slot = ring[pos & (RING_CAPACITY - 1)];
+        const size_t sequence = slot.sequence.load(std::memory_order_acquire);
+        const intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+        if (diff == 0)
+        {
+            if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+            {
+                slot.level = level;
+                slot.time = time;
+                slot.message = std::move(message);
+                slot.sequence.store(pos + 1, std::memory_order_release);
+                return true;
+            }
+        }
+        else if (diff < 0)
+        {
+            return false; // The writer has not caught up with this lap of the ring yet
+        }
+        else
+        {
+            pos = enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+}
+
 void ServerLogger::log(LogLevel level, const std::string &message)
 {
     // Skip if level is below minimum
-    if (level > minLevel)
+    if (!isEnabled(level))
     {
         return;
     }
 
-    std::lock_guard<std::mutex> lock(logMutex);
-
-    // Filter out routine operational messages in quiet mode
-    if (quietMode && level == LogLevel::SERVER_INFO)
+    const auto now = std::chrono::system_clock::now();
+    std::string text = message;
+    while (!tryEnqueue(level, now, text))
     {
-        // Allow important startup/shutdown messages but filter routine operations
-        if (message.find("New client connection") != std::string::npos ||
-            message.find("Processing request") != std::string::npos ||
-            message.find("Completed request") != std::string::npos ||
-            message.find("Successfully provided") != std::string::npos ||
-            message.find("Successfully listed") != std::string::npos)
+        // Under a flood, routine messages are dropped rather than stalling request threads;
+        // warnings and errors wait for the writer
+        if (level == LogLevel::SERVER_INFO || level == LogLevel::SERVER_DEBUG)
         {
-            return; // Skip these routine messages
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
         }
+        wakeCv.notify_one();
+        std::this_thread::yield();
     }
 
-    // Filter request details if disabled
-    if (!showRequestDetails && level == LogLevel::SERVER_INFO)
+    if (writerSleeping.load())
     {
-        if (message.find("[Thread") != std::string::npos ||
-            message.find("Content-Length:") != std::string::npos ||
-            message.find("Auth middleware") != std::string::npos ||
-            message.find("CORS preflight") != std::string::npos)
+        wakeCv.notify_one();
+    }
+}
+
+size_t ServerLogger::drain()
+{
+    std::vector<LogEntry> batch;
+    batch.reserve(WRITE_BATCH);
+
+    while (batch.size() < WRITE_BATCH)
+    {
+        Slot &slot = ring[dequeuePos & (RING_CAPACITY - 1)];
+        if (slot.sequence.load(std::memory_order_acquire) != dequeuePos + 1)
         {
-            return; // Skip detailed request processing info
+            break;
         }
+        batch.push_back(LogEntry{slot.level, formatTimestamp(slot.time), std::move(slot.message), 0, slot.time});
+        slot.message.clear();
+        slot.sequence.store(dequeuePos + RING_CAPACITY, std::memory_order_release);
+        ++dequeuePos;
     }
 
-    std::string timestamp = getCurrentTimestamp();
-    std::string levelStr = levelToString(level);
+    const size_t lost = dropped.exchange(0, std::memory_order_relaxed);
+    if (lost > 0)
+    {
+        const auto now = std::chrono::system_clock::now();
+        batch.push_back(LogEntry{LogLevel::SERVER_WARNING, formatTimestamp(now),
+                                 "Logger dropped " + std::to_string(lost) + " messages while its buffer was full", 0, now});
+    }
 
-    // Format the log message
-    std::ostringstream logStream;
-    logStream << "[" << timestamp << "] [" << levelStr << "] " << message;
-    std::string formattedMessage = logStream.str();
+    if (batch.empty())
+    {
+        return 0;
+    }
 
-    // Store in memory
-    LogEntry entry{level, timestamp, message};
-    logs.push_back(entry);
+    std::string out;
+    for (const auto &entry : batch)
+    {
+        out += '[';
+        out += entry.timestamp;
+        out += "] [";
+        out += levelToString(entry.level);
+        out += "] ";
+        out += entry.message;
+        out += '\n';
+    }
 
-    // Output to console
-    std::cout << formattedMessage << std::endl;
+    // One write and one flush per batch instead of per line
+    std::cout.write(out.data(), static_cast<std::streamsize>(out.size()));
+    std::cout.flush();
+    {
+        std::lock_guard<std::mutex> lock(fileMutex);
+        if (logFile.is_open())
+        {
+            logFile.write(out.data(), static_cast<std::streamsize>(out.size()));
+            logFile.flush();
+        }
+    }
 
-    // Write to file if open
-    if (logFile.is_open())
     {
-        logFile << formattedMessage << std::endl;
-        logFile.flush();
+        std::lock_guard<std::mutex> lock(historyMutex);
+        for (auto &entry : batch)
+        {
+            entry.id = ++lastId;
+            if (historyCapacity == 0)
+            {
+                continue;
+            }
+            if (history.size() < historyCapacity)
+            {
+                history.push_back(std::move(entry));
+            }
+            else
+            {
+                history[historyStart] = std::move(entry);
+                historyStart = (historyStart + 1) % historyCapacity;
+            }
+        }
+    }
+    historyCv.notify_all();
+
+    return batch.size();
+}
+
+void ServerLogger::writerLoop()
+{
+    while (true)
+    {
+        while (drain() > 0)
+        {
+            writtenPos.store(dequeuePos, std::memory_order_release);
+            flushedCv.notify_all();
+        }
+        writtenPos.store(dequeuePos, std::memory_order_release);
+        flushedCv.notify_all();
+
+        std::unique_lock<std::mutex> lock(wakeMutex);
+        if (stopping)
+        {
+            return;
+        }
+
+        writerSleeping.store(true);
+        // A producer that published before seeing the flag did not notify; the timeout is a backstop
+        const Slot &next = ring[dequeuePos & (RING_CAPACITY - 1)];
+        if (next.sequence.load() != dequeuePos + 1)
+        {
+            wakeCv.wait_for(lock, std::chrono::milliseconds(50));
+        }
+        writerSleeping.store(false);
     }
 }
 
-std::string ServerLogger::levelToString(LogLevel level)
+const char *ServerLogger::levelToString(LogLevel level)
 {
     switch (level)
     {
@@ -297,16 +561,26 @@ std::string ServerLogger::levelToString(LogLevel level)
     }
 }
 
-std::string ServerLogger::getCurrentTimestamp()
+std::string ServerLogger::formatTimestamp(std::chrono::system_clock::time_point time)
 {
-    auto now = std::chrono::system_clock::now();
-    auto time_t = std::chrono::system_clock::to_time_t(now);
+    // Only the writer thread formats timestamps, so localtime's shared buffer and this cache are safe
+    static std::time_t cachedSecond = 0;
+    static std::string cachedPrefix;
+
+    auto time_t = std::chrono::system_clock::to_time_t(time);
     auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
-                  now.time_since_epoch()) %
+                  time.time_since_epoch()) %
               1000;
 
-    std::stringstream ss;
-    ss << std::put_time(std::localtime(&time_t), "%Y-%m-%d %H:%M:%S");
-    ss << '.' << std::setfill('0') << std::setw(3) << ms.count();
-    return ss.str();
-}
\ No newline at end of file
+    if (time_t != cachedSecond || cachedPrefix.empty())
+    {
+        std::stringstream ss;
+        ss << std::put_time(std::localtime(&time_t), "%Y-%m-%d %H:%M:%S");
+        cachedPrefix = ss.str();
+        cachedSecond = time_t;
+    }
+
+    char millis[8];
+    std::snprintf(millis, sizeof(millis), ".%03d", static_cast<int>(ms.count()));
+    return cachedPrefix + millis;
+}
@@ -6,6 +6,11 @@
 #include <atomic>
 #include <vector>
 #include <filesystem>
+#include <mutex>
+#include <condition_variable>
+#include <set>
+#include <algorithm>
+#include <functional>
 #ifdef _WIN32
 #include <winsock2.h>
 #include <ws2tcpip.h>
@@ -28,11 +33,23 @@
 #include "kolosal/auth/auth_middleware.hpp"
 #include "kolosal/download_manager.hpp"
 #include "kolosal/download_utils.hpp"
+#include "kolosal/gpu_detection.hpp"
+#include "kolosal/config_reloader.hpp"
+#include "kolosal/retrieval/embedding_cache.hpp"
+#include "kolosal/retrieval/parse_cache.hpp"
+#include "kolosal/response_cache.hpp"
+#include "kolosal/semantic_cache.hpp"
+#include "kolosal/batch_manager.hpp"
+#include "kolosal/job_manager.hpp"
+#include "kolosal/health_monitor.hpp"
 
 using namespace kolosal;
 
 // Global flag for graceful shutdown
 std::atomic<bool> keep_running{true};
+std::atomic<bool> reload_requested{false};
+std::atomic<bool> upgrade_requested{false};
+std::atomic<bool> drain_requested{false};
 
 // Function to get local IP addresses
 std::vector<std::string> getLocalIPAddresses()
@@ -211,6 +228,26 @@ void signal_handler(int signal)
     keep_running = false;
 }
 
+#ifndef _WIN32
+void reload_signal_handler(int)
+{
+    reload_requested = true;
+}
+
+// SIGUSR2 starts the new binary on this process's sockets; SIGQUIT (sent by that
+// successor once it is ready) drains in-flight requests and exits
+void upgrade_signal_handler(int)
+{
+    upgrade_requested = true;
+}
+
+void drain_signal_handler(int)
+{
+    drain_requested = true;
+    keep_running = false;
+}
+#endif
+
 void print_usage(const char *program_name)
 {
     ServerConfig config;
@@ -223,8 +260,236 @@ void print_version()
     config.printVersion();
 }
 
+// Startup stages and how long each took. A Stage logs the scope it guards; spawn() runs a
+// stage nothing in main() waits for on its own thread, overlapping the stages after it.
+// Whatever needs a spawned stage's result waits on that subsystem itself (GPU detection,
+// for one, is a call_once), and join() collects the threads before shutdown.
+class Startup
+{
+public:
+    class Stage
+    {
+    public:
+        explicit Stage(const char *name) : name_(name), start_(std::chrono::steady_clock::now()) {}
+        ~Stage()
+        {
+            KOLOSAL_LOG_INFO("Startup: %s took %.1f ms", name_, millisecondsSince(start_));
+        }
+
+    private:
+        const char *name_;
+        std::chrono::steady_clock::time_point start_;
+    };
+
+    void spawn(const char *name, std::function<void()> stage)
+    {
+        threads_.emplace_back([name, stage = std::move(stage)]()
+                              {
+            Stage timer(name);
+            try
+            {
+                stage();
+            }
+            catch (const std::exception &e)
+            {
+                KOLOSAL_LOG_ERROR("Startup: %s failed: %s", name, e.what());
+            } });
+    }
+
+    void join()
+    {
+        for (auto &thread : threads_)
+        {
+            thread.join();
+        }
+        threads_.clear();
+    }
+
+    // Since the process started
+    double elapsedMs() const { return millisecondsSince(start_); }
+
+    static double millisecondsSince(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+private:
+    const std::chrono::steady_clock::time_point start_ = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads_;
+};
+
+// Loads the startup models with up to `concurrency` loads in flight. Models that use
+// the same GPU load one after another, since VRAM fitting reads the device's free
+// memory and a concurrent load on that device would make the reading stale
+void loadStartupModels(std::vector<ModelConfig> models, int concurrency, const std::string &defaultEngine)
+{
+    auto &nodeManager = ServerAPI::instance().getNodeManager();
+    auto &downloadManager = DownloadManager::getInstance();
+
+    std::vector<std::string> deviceKeys;
+    for (const auto &modelConfig : models)
+    {
+        std::string engine = !modelConfig.inferenceEngine.empty() ? modelConfig.inferenceEngine
+                             : !defaultEngine.empty()            ? defaultEngine
+                                                                 : getPlatformDefaultInferenceEngine();
+        const bool cpuOnly = engine.find("cpu") != std::string::npos || modelConfig.loadParams.n_gpu_layers == 0;
+        deviceKeys.push_back(cpuOnly ? std::string() : engine + ":" + std::to_string(modelConfig.mainGpuId));
+    }
+
+    if (concurrency <= 0)
+        concurrency = 4;
+    concurrency = (std::min)(concurrency, static_cast<int>(models.size()));
+
+    std::atomic<int> successfulModels{0};
+    std::atomic<int> failedModels{0};
+    std::atomic<int> asyncDownloads{0};
+
+    auto loadOne = [&](const ModelConfig &modelConfig)
+    {
+        nodeManager.setStartupState(modelConfig.id, "loading");
+        KOLOSAL_LOG_INFO("Configuring model '%s'...", modelConfig.id.c_str());
+        // Use DownloadManager to handle both URLs and local files consistently
+        bool success = downloadManager.loadModelAtStartup(modelConfig.id,
+                                                          modelConfig.path,
+                                                          modelConfig.type,
+                                                          modelConfig.loadParams,
+                                                          modelConfig.mainGpuId,
+                                                          modelConfig.loadImmediately,
+                                                          modelConfig.inferenceEngine,
+                                                          modelConfig.sha256);
+
+        if (success)
+        {
+            // Check if this was a URL that started an async download
+            if (is_valid_url(modelConfig.path) && !std::filesystem::exists(generate_download_path_executable(modelConfig.path)))
+            {
+                std::cout << "✓ Model '" + modelConfig.id + "' download started (async)\n" << std::flush;
+                KOLOSAL_LOG_INFO("Model '%s' download started from URL: %s", modelConfig.id.c_str(), modelConfig.path.c_str());
+                nodeManager.setStartupState(modelConfig.id, "downloading");
+                asyncDownloads++;
+            }
+            else if (modelConfig.loadImmediately)
+            {
+                std::cout << "✓ Model '" + modelConfig.id + "' loaded successfully\n" << std::flush;
+                KOLOSAL_LOG_INFO("Model '%s' loaded successfully", modelConfig.id.c_str());
+                nodeManager.setStartupState(modelConfig.id, "ready");
+            }
+            else
+            {
+                std::cout << "✓ Model '" + modelConfig.id + "' registered for lazy loading\n" << std::flush;
+                KOLOSAL_LOG_INFO("Model '%s' registered for lazy loading", modelConfig.id.c_str());
+                nodeManager.setStartupState(modelConfig.id, "registered");
+            }
+            successfulModels++;
+        }
+        else
+        {
+            std::cerr << "✗ Failed to configure model '" + modelConfig.id + "' - skipping\n" << std::flush;
+            KOLOSAL_LOG_WARNING("Failed to configure model '%s' from %s - continuing with other models",
+                                     modelConfig.id.c_str(), modelConfig.path.c_str());
+            nodeManager.setStartupState(modelConfig.id, "failed");
+            failedModels++;
+        }
+    };
+
+    std::mutex scheduleMutex;
+    std::condition_variable scheduleCv;
+    std::vector<bool> started(models.size(), false);
+    std::set<std::string> busyDevices;
+
+    auto worker = [&]()
+    {
+        std::unique_lock<std::mutex> lock(scheduleMutex);
+        while (true)
+        {
+            size_t next = models.size();
+            bool remaining = false;
+            for (size_t i = 0; i < models.size(); ++i)
+            {
+                if (started[i])
+                    continue;
+                remaining = true;
+                if (deviceKeys[i].empty() || !busyDevices.count(deviceKeys[i]))
+                {
+                    next = i;
+                    break;
+                }
+            }
+            if (!remaining)
+                return;
+            if (next == models.size())
+            {
+                // Everything left waits for a GPU another worker is loading onto
+                scheduleCv.wait(lock);
+                continue;
+            }
+
+            started[next] = true;
+            if (!deviceKeys[next].empty())
+                busyDevices.insert(deviceKeys[next]);
+            lock.unlock();
+
+            try
+            {
+                loadOne(models[next]);
+            }
+            catch (const std::exception &e)
+            {
+                KOLOSAL_LOG_ERROR("Exception while loading startup model '%s': %s", models[next].id.c_str(), e.what());
+                nodeManager.setStartupState(models[next].id, "failed");
+                failedModels++;
+            }
+
+            lock.lock();
+            busyDevices.erase(deviceKeys[next]);
+            scheduleCv.notify_all();
+        }
+    };
+
+    const auto startTime = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (int i = 0; i < concurrency; ++i)
+    {
+        workers.emplace_back(worker);
+    }
+    for (auto &t : workers)
+    {
+        t.join();
+    }
+    const auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now() - startTime);
+
+    // Log summary of model loading
+    if (successfulModels > 0)
+    {
+        std::cout << "\n✓ Successfully configured " << successfulModels << " model(s) in " << elapsed.count() << "s";
+        if (asyncDownloads > 0)
+        {
+            std::cout << " (" << asyncDownloads << " downloading asynchronously)";
+        }
+        std::cout << std::endl;
+    }
+    if (failedModels > 0)
+    {
+        std::cout << "⚠ " << failedModels << " model(s) failed to configure" << std::endl;
+    }
+    if (asyncDownloads > 0)
+    {
+        std::cout << "\n📊 Monitor download progress using: GET /download-progress/{model-id}" << std::endl;
+        std::cout << "📊 View all downloads using: GET /downloads" << std::endl;
+    }
+
+    if (failedModels > 0)
+    {
+        KOLOSAL_LOG_WARNING("Server started with %d failed model(s) out of %d total",
+                                 failedModels.load(), (int)models.size());
+    }
+    KOLOSAL_LOG_INFO("Startup model loading finished in %lld seconds", static_cast<long long>(elapsed.count()));
+}
+
 int main(int argc, char *argv[])
 {
+    Startup startup;
+
     // Load configuration from command line arguments
     ServerConfig config;
     if (!config.loadFromArgs(argc, argv))
@@ -242,7 +507,14 @@ int main(int argc, char *argv[])
     std::signal(SIGTERM, signal_handler);
 #ifdef _WIN32
     std::signal(SIGBREAK, signal_handler);
+#else
+    // SIGHUP reloads the config file, as with most daemons
+    std::signal(SIGHUP, reload_signal_handler);
+    std::signal(SIGUSR2, upgrade_signal_handler);
+    std::signal(SIGQUIT, drain_signal_handler);
 #endif
+    // The command line a successor is started with on upgrade
+    const std::vector<std::string> commandLine(argv, argv + argc);
 
     // Print startup banner
     std::cout << "Starting Kolosal Server v1.0.0..." << std::endl;
@@ -278,10 +550,18 @@ int main(int argc, char *argv[])
         }
     }
     
-    ServerLogger::logInfo("Logger configured - Level: %s, Quiet: %s, Details: %s", 
+    KOLOSAL_LOG_INFO("Logger configured - Level: %s, Quiet: %s, Details: %s", 
                          config.logLevel.c_str(),
                          config.quietMode ? "true" : "false",
                          config.showRequestDetails ? "true" : "false");
+    KOLOSAL_LOG_INFO("Startup: configuration took %.1f ms", startup.elapsedMs());
+
+    // Probing the GPUs (NVML, sysfs) is the slowest part of startup and nothing before the
+    // model loads needs it; they wait for it themselves when they place a model
+    startup.spawn("GPU inventory", [interval = config.gpuSampleIntervalSeconds]()
+                  {
+        // Free-memory readings used for model placement, /health and /metrics
+        GpuTelemetry::instance().start(std::chrono::seconds(interval)); });
 
     // Initialize the server
     ServerAPI &server = ServerAPI::instance();
@@ -302,13 +582,19 @@ int main(int argc, char *argv[])
         std::cout << "Server will only be accessible from this machine" << std::endl;
     }
 
-    if (!server.init(config.port, bindHost, config.idleTimeout))
     {
-        std::cerr << "Failed to initialize server on " << bindHost << ":" << config.port << std::endl;
-        return 1;
-    } // Configure authentication if enabled
+        Startup::Stage stage("listener and engines");
+        if (!server.init(config.port, bindHost, config.idleTimeout))
+        {
+            std::cerr << "Failed to initialize server on " << bindHost << ":" << config.port << std::endl;
+            startup.join();
+            return 1;
+        }
+    }
+    // Configure authentication if enabled
     if (config.auth.enableAuth)
     {
+        Startup::Stage stage("authentication");
         try
         {
             auto &authMiddleware = server.getAuthMiddleware();
@@ -316,6 +602,12 @@ int main(int argc, char *argv[])
             // Update rate limiter configuration
             authMiddleware.updateRateLimiterConfig(config.auth.rateLimiter);
 
+            // Update inference token quotas
+            authMiddleware.updateTokenQuotaConfig(config.auth.tokenQuota);
+
+            // Update tenant scheduling shares
+            authMiddleware.updateTenantSharesConfig(config.auth.tenantScheduling);
+
             // Update CORS configuration
             authMiddleware.updateCorsConfig(config.auth.cors);
 
@@ -333,7 +625,7 @@ int main(int argc, char *argv[])
 
             authMiddleware.updateApiKeyConfig(apiKeyConfig);
 
-            ServerLogger::logInfo("Authentication configured - Rate Limit: %s, CORS: %s, API Keys: %s (%zu keys)",
+            KOLOSAL_LOG_INFO("Authentication configured - Rate Limit: %s, CORS: %s, API Keys: %s (%zu keys)",
                                   config.auth.rateLimiter.enabled ? "enabled" : "disabled",
                                   config.auth.cors.enabled ? "enabled" : "disabled",
                                   config.auth.requireApiKey ? "required" : "optional",
@@ -342,6 +634,7 @@ int main(int argc, char *argv[])
         catch (const std::exception &e)
         {
             std::cerr << "Failed to configure authentication: " << e.what() << std::endl;
+            startup.join();
             return 1;
         }
     }
@@ -352,11 +645,12 @@ int main(int argc, char *argv[])
         try
         {
             server.enableMetrics();
-            ServerLogger::logInfo("System metrics monitoring enabled");
+            KOLOSAL_LOG_INFO("System metrics monitoring enabled");
         }
         catch (const std::exception &e)
         {
             std::cerr << "Failed to enable metrics: " << e.what() << std::endl;
+            startup.join();
             return 1;
         }
     } // Enable internet search if configured
@@ -365,89 +659,110 @@ int main(int argc, char *argv[])
         try
         {
             server.enableSearch(config.search);
-            ServerLogger::logInfo("Internet search endpoint enabled");
+            KOLOSAL_LOG_INFO("Internet search endpoint enabled");
         }
         catch (const std::exception &e)
         {
             std::cerr << "Failed to enable internet search: " << e.what() << std::endl;
+            startup.join();
             return 1;
         }
-    } // Load models if specified
-    if (!config.models.empty())
+    } // Enable request tracing if configured
+    if (config.tracing.enabled || config.tracing.server_timing)
     {
-        auto &downloadManager = DownloadManager::getInstance();
-
-        int successfulModels = 0;
-        int failedModels = 0;
-        int asyncDownloads = 0;
-
-        for (const auto &modelConfig : config.models)
-        {
-            std::cout << "Configuring model '" << modelConfig.id << "'..." << std::endl;            // Use DownloadManager to handle both URLs and local files consistently
-            bool success = downloadManager.loadModelAtStartup(modelConfig.id,
-                                                              modelConfig.path,
-                                                              modelConfig.type,
-                                                              modelConfig.loadParams,
-                                                              modelConfig.mainGpuId,
-                                                              modelConfig.loadImmediately,
-                                                              modelConfig.inferenceEngine);
-
-            if (success)
-            {
-                // Check if this was a URL that started an async download
-                if (is_valid_url(modelConfig.path) && !std::filesystem::exists(generate_download_path_executable(modelConfig.path)))
-                {
-                    std::cout << "✓ Model '" << modelConfig.id << "' download started (async)" << std::endl;
-                    ServerLogger::logInfo("Model '%s' download started from URL: %s", modelConfig.id.c_str(), modelConfig.path.c_str());
-                    asyncDownloads++;
-                }
-                else if (modelConfig.loadImmediately)
-                {
-                    std::cout << "✓ Model '" << modelConfig.id << "' loaded successfully" << std::endl;
-                    ServerLogger::logInfo("Model '%s' loaded successfully", modelConfig.id.c_str());
-                }
-                else
-                {
-                    std::cout << "✓ Model '" << modelConfig.id << "' registered for lazy loading" << std::endl;
-                    ServerLogger::logInfo("Model '%s' registered for lazy loading", modelConfig.id.c_str());
-                }
-                successfulModels++;
-            }
-            else
-            {
-                std::cerr << "✗ Failed to configure model '" << modelConfig.id << "' - skipping" << std::endl;
-                ServerLogger::logWarning("Failed to configure model '%s' from %s - continuing with other models",
-                                         modelConfig.id.c_str(), modelConfig.path.c_str());
-                failedModels++;
-            }
-        }
-
-        // Log summary of model loading
-        if (successfulModels > 0)
-        {
-            std::cout << "\n✓ Successfully configured " << successfulModels << " model(s)";
-            if (asyncDownloads > 0)
-            {
-                std::cout << " (" << asyncDownloads << " downloading asynchronously)";
-            }
-            std::cout << std::endl;
-        }
-        if (failedModels > 0)
+        try
         {
-            std::cout << "⚠ " << failedModels << " model(s) failed to configure" << std::endl;
+            server.enableTracing(config.tracing);
         }
-        if (asyncDownloads > 0)
+        catch (const std::exception &e)
         {
-            std::cout << "\n📊 Monitor download progress using: GET /download-progress/{model-id}" << std::endl;
-            std::cout << "📊 View all downloads using: GET /downloads" << std::endl;
+            std::cerr << "Failed to enable tracing: " << e.what() << std::endl;
+            startup.join();
+            return 1;
         }
+    }
 
-        if (failedModels > 0)
+    // Structured access log, written off the request path
+    if (config.enableAccessLog)
+    {
+        server.enableAccessLog(config.accessLog);
+    }
+    if (config.trafficCapture.enabled)
+    {
+        server.enableTrafficCapture(config.trafficCapture);
+    }
+
+    {
+        Startup::Stage stage("caches");
+        // Embedding cache shared by the embedding, chunking and document routes
+        retrieval::EmbeddingCache::instance().configure(config.database.embeddingCache);
+        retrieval::ParseCache::instance().configure(config.database.parseCache);
+
+        // Deterministic completions answered from memory by the OpenAI-compatible routes
+        ResponseCache::instance().configure(config.responseCache);
+        SemanticCache::instance().configure(config.responseCache);
+    }
+
+    // Offline batches run on the capacity interactive requests leave; unfinished ones resume.
+    // Reading them back from disk does not hold up the model loads
+    if (config.batch.enabled)
+    {
+        startup.spawn("batch resume", [batch = config.batch]()
+                      { BatchManager::instance().start(batch); });
+    }
+    JobManager::instance().start(config.jobs);
+
+    // Queue limits, bandwidth caps and fleet sources apply to every download, starting with the startup models
+    DownloadManager::getInstance().configure(config.downloads);
+    if (config.downloads.serve_to_peers)
+    {
+        server.enableModelSharing();
+    }
+
+    // Completion requests go to the node holding their session's KV cache
+    if (config.cluster.enabled)
+    {
+        Startup::Stage stage("cluster");
+        server.enableCluster(config.cluster);
+    }
+
+    // Long prompts are decoded on prefill nodes and resumed here from their KV state
+    if (config.disaggregation.role != "combined")
+    {
+        server.enableDisaggregation(config.disaggregation);
+    }
+
+    // Requests for an alias go to the variant whose context fits them
+    server.getNodeManager().setModelAliases(config.modelAliases);
+
+    // Load models in the background; the listener is already up and serves each model as soon as it is ready
+    std::thread startupLoader;
+    if (!config.models.empty())
+    {
+        for (const auto &modelConfig : config.models)
         {
-            ServerLogger::logWarning("Server started with %d failed model(s) out of %d total",
-                                     failedModels, (int)config.models.size());
+            server.getNodeManager().setStartupState(modelConfig.id, "pending");
         }
+        // Copy: engines created at startup write themselves back into the config
+        startupLoader = std::thread([models = config.models, concurrency = config.startupLoadConcurrency,
+                                     engine = config.defaultInferenceEngine]() {
+            loadStartupModels(models, concurrency, engine);
+            // Ready at once rather than at the next health sample
+            HealthMonitor::instance().refresh();
+            // Taking over from an older process: it stops once the models here are loaded
+            ServerAPI::instance().releasePredecessor();
+        });
+    }
+    else
+    {
+        server.releasePredecessor();
     }
+
+    // Engine states for /health and the probes; started once the startup models are marked
+    // pending, so readiness never reports a node ready before they load
+    HealthMonitor::instance().start(std::chrono::seconds(1));
+    // Document search, internet search and the UI start on their first request
+    KOLOSAL_LOG_INFO("Startup: accepting requests %.1f ms after start", startup.elapsedMs());
     std::cout << "\nServer started successfully!" << std::endl;
 
     // Display appropriate server URLs based on configuration
@@ -545,6 +860,18 @@ int main(int argc, char *argv[])
     std::cout << "  POST /v1/chat/completions    - Chat completions (OpenAI compatible)" << std::endl;
     std::cout << "  POST /v1/completions         - Text completions (OpenAI compatible)" << std::endl;
     std::cout << "  POST /v1/embeddings          - Text embeddings (OpenAI compatible)" << std::endl;
+    std::cout << "  POST /v1/rerank              - Rerank documents against a query" << std::endl;
+    if (config.batch.enabled)
+    {
+        std::cout << "  POST /v1/files               - Upload a batch input file" << std::endl;
+        std::cout << "  POST /v1/batches             - Run a batch of requests offline" << std::endl;
+        std::cout << "  GET  /v1/batches/{id}        - Batch status" << std::endl;
+    }
+    if (config.jobs.enabled)
+    {
+        std::cout << "  POST /v1/jobs                - Run a completion in the background" << std::endl;
+        std::cout << "  GET  /v1/jobs/{id}           - Job status and result" << std::endl;
+    }
     std::cout << "  GET  /engines                - List engines" << std::endl;
     std::cout << "  POST /engines                - Add new engine" << std::endl;
     std::cout << "  GET  /engines/{id}/status    - Engine status" << std::endl;
@@ -558,16 +885,42 @@ int main(int argc, char *argv[])
         std::cout << "  GET  /v1/auth/stats          - Get authentication statistics" << std::endl;
         std::cout << "  POST /v1/auth/clear          - Clear rate limit data" << std::endl;
     }
+    if (!config.getCurrentConfigFilePath().empty())
+    {
+        std::cout << "  POST /v1/config/reload       - Apply changes to the config file" << std::endl;
+    }
 
     std::cout << "\nPress Ctrl+C to stop the server..." << std::endl;
 
+    // Picks up edits to the config file without a restart
+    ConfigReloader::instance().startWatching(std::chrono::seconds(config.configWatchIntervalSeconds));
+
     // Main server loop
     while (keep_running)
     {
         std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        if (reload_requested.exchange(false))
+        {
+            ConfigReloader::instance().reload();
+        }
+        if (upgrade_requested.exchange(false))
+        {
+            server.upgrade(commandLine);
+        }
     }
 
     std::cout << "Shutting down server..." << std::endl;
+    startup.join();
+    if (startupLoader.joinable())
+    {
+        // A model load cannot be interrupted; wait for the ones in flight
+        startupLoader.join();
+    }
+    if (drain_requested)
+    {
+        // A successor serves new connections; finish what this process started
+        server.drain();
+    }
     server.shutdown();
     std::cout << "Server stopped." << std::endl;
 
@@ -0,0 +1,265 @@
+#include "kolosal/memory_report.hpp"
+#include "kolosal/node_manager.h"
+#include "kolosal/logger.hpp"
+#include "kolosal/download_manager.hpp"
+#include "kolosal/download_utils.hpp"
+#include "kolosal/response_cache.hpp"
+#include "kolosal/semantic_cache.hpp"
+#include "kolosal/retrieval/embedding_cache.hpp"
+
+#include <curl/curl.h>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#if defined(KOLOSAL_USE_MIMALLOC)
+#include <mimalloc.h>
+#elif defined(KOLOSAL_USE_JEMALLOC)
+#include <jemalloc/jemalloc.h>
+#elif defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#elif defined(__APPLE__)
+#include <mach/mach.h>
+#include <sys/resource.h>
+#endif
+
+namespace kolosal
+{
+
+    namespace
+    {
+        void putIfKnown(nlohmann::json &object, const char *key, int64_t value)
+        {
+            if (value >= 0)
+                object[key] = value;
+        }
+
+#ifdef KOLOSAL_USE_JEMALLOC
+        int64_t jemallocStat(const char *name)
+        {
+            size_t value = 0;
+            size_t size = sizeof(value);
+            return mallctl(name, &value, &size, nullptr, 0) == 0 ? static_cast<int64_t>(value) : -1;
+        }
+#endif
+    } // namespace
+
+    MemoryReport &MemoryReport::instance()
+    {
+        static MemoryReport report;
+        return report;
+    }
+
+    uint64_t MemoryReport::addSource(const std::string &name, Source source)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        const uint64_t id = nextId_++;
+        sources_.emplace(id, std::make_pair(name, std::move(source)));
+        return id;
+    }
+
+    void MemoryReport::removeSource(uint64_t id)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        sources_.erase(id);
+    }
+
+    const char *MemoryReport::allocatorName()
+    {
+#if defined(KOLOSAL_USE_MIMALLOC)
+        return "mimalloc";
+#elif defined(KOLOSAL_USE_JEMALLOC)
+        return "jemalloc";
+#else
+        return "system";
+#endif
+    }
+
+    AllocatorStats MemoryReport::allocatorStats()
+    {
+        AllocatorStats stats;
+        stats.name = allocatorName();
+#if defined(KOLOSAL_USE_MIMALLOC)
+        size_t elapsed = 0, user = 0, system = 0, rss = 0, peakRss = 0, commit = 0, peakCommit = 0, faults = 0;
+        mi_process_info(&elapsed, &user, &system, &rss, &peakRss, &commit, &peakCommit, &faults);
+        stats.resident = static_cast<int64_t>(rss);
+        stats.committed = static_cast<int64_t>(commit);
+#elif defined(KOLOSAL_USE_JEMALLOC)
+        // Statistics are cached until the epoch is advanced
+        uint64_t epoch = 1;
+        size_t size = sizeof(epoch);
+        mallctl("epoch", &epoch, &size, &epoch, size);
+        stats.allocated = jemallocStat("stats.allocated");
+        stats.resident = jemallocStat("stats.resident");
+        stats.committed = jemallocStat("stats.mapped");
+#elif defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+        const struct mallinfo2 info = mallinfo2();
+        stats.allocated = static_cast<int64_t>(info.uordblks + info.hblkhd);
+        stats.committed = static_cast<int64_t>(info.arena + info.hblkhd);
+#endif
+        return stats;
+    }
+
+    ProcessMemory MemoryReport::processMemory()
+    {
+        ProcessMemory memory;
+#if defined(_WIN32)
+        PROCESS_MEMORY_COUNTERS counters{};
+        if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        {
+            memory.resident = static_cast<int64_t>(counters.WorkingSetSize);
+            memory.peakResident = static_cast<int64_t>(counters.PeakWorkingSetSize);
+        }
+#elif defined(__APPLE__)
+        mach_task_basic_info_data_t info{};
+        mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+        if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, reinterpret_cast<task_info_t>(&info), &count) == KERN_SUCCESS)
+            memory.resident = static_cast<int64_t>(info.resident_size);
+        struct rusage usage{};
+        if (getrusage(RUSAGE_SELF, &usage) == 0)
+            memory.peakResident = static_cast<int64_t>(usage.ru_maxrss);   // Bytes on macOS
+#elif defined(__linux__)
+        std::ifstream status("/proc/self/status");
+        std::string line;
+        while (std::getline(status, line))
+        {
+            // "VmRSS:     123456 kB"
+            if (line.rfind("VmRSS:", 0) == 0)
+                memory.resident = std::stoll(line.substr(6)) * 1024;
+            else if (line.rfind("VmHWM:", 0) == 0)
+                memory.peakResident = std::stoll(line.substr(6)) * 1024;
+        }
+#endif
+        return memory;
+    }
+
+    void MemoryReport::releaseFreeMemory()
+    {
+#if defined(KOLOSAL_USE_MIMALLOC)
+        mi_collect(true);
+#elif defined(KOLOSAL_USE_JEMALLOC)
+        const std::string purge = "arena." + std::to_string(MALLCTL_ARENAS_ALL) + ".purge";
+        mallctl(purge.c_str(), nullptr, nullptr, nullptr, 0);
+#elif defined(__GLIBC__)
+        malloc_trim(0);
+#endif
+    }
+
+    nlohmann::json MemoryReport::render(const NodeManager &nodeManager) const
+    {
+        nlohmann::json report;
+
+        const AllocatorStats allocator = allocatorStats();
+        nlohmann::json allocatorJson = {{"name", allocator.name}};
+        putIfKnown(allocatorJson, "allocated_bytes", allocator.allocated);
+        putIfKnown(allocatorJson, "resident_bytes", allocator.resident);
+        putIfKnown(allocatorJson, "committed_bytes", allocator.committed);
+        if (allocator.allocated >= 0 && allocator.committed >= 0)
+            allocatorJson["free_bytes"] = allocator.committed - allocator.allocated;   // Held but unused
+        report["allocator"] = std::move(allocatorJson);
+
+        const ProcessMemory process = processMemory();
+        nlohmann::json processJson = nlohmann::json::object();
+        putIfKnown(processJson, "resident_bytes", process.resident);
+        putIfKnown(processJson, "peak_resident_bytes", process.peakResident);
+        report["process"] = std::move(processJson);
+
+        nlohmann::json engines = nlohmann::json::array();
+        std::string replicasOf;
+        std::vector<std::shared_ptr<IInferenceEngine>> replicas;
+        for (const auto &stats : nodeManager.getReplicaStats())
+        {
+            if (stats.engineId != replicasOf)
+            {
+                replicasOf = stats.engineId;
+                replicas = nodeManager.getLoadedReplicas(stats.engineId);
+            }
+            engines.push_back({
+                {"engine", stats.engineId},
+                {"replica", stats.index},
+                {"live_jobs", stats.liveJobs},
+                {"active_jobs", stats.load.active_jobs},
+                {"slots", stats.decode.slots_total},
+                {"slots_in_use", stats.decode.slots_in_use},
+                {"kv_cells", stats.decode.kv_cells_total},
+                {"kv_cells_used", stats.decode.kv_cells_used},
+                {"kv_bytes", stats.decode.kv_bytes},
+                {"weight_bytes", stats.decode.weight_bytes},
+                {"kv_host_tier_bytes", stats.kvCache.host_bytes},
+                {"kv_host_tier_entries", stats.kvCache.host_entries}});
+
+            // Measured from /proc/self/smaps, only for engines that asked for huge pages
+            if (stats.index < static_cast<int>(replicas.size()))
+            {
+                const HugePageStats hugePages = replicas[stats.index]->getHugePageStats();
+                if (hugePages.requested != "off")
+                {
+                    engines.back()["huge_pages"] = {
+                        {"requested", hugePages.requested},
+                        {"weights", hugePages.weights},
+                        {"weight_bytes", hugePages.weight_bytes},
+                        {"weight_huge_bytes", hugePages.weight_huge_bytes},
+                        {"buffer_bytes", hugePages.buffer_bytes},
+                        {"buffer_huge_bytes", hugePages.buffer_huge_bytes}};
+                }
+            }
+        }
+        report["engines"] = std::move(engines);
+
+        size_t ringBytes = 0, historyBytes = 0, historyEntries = 0;
+        ServerLogger::instance().memoryUsage(ringBytes, historyBytes, historyEntries);
+        report["logger"] = {
+            {"ring_bytes", ringBytes},
+            {"history_bytes", historyBytes},
+            {"history_entries", historyEntries}};
+
+        // Downloads stream straight to disk; what they hold is curl's receive buffer per connection
+        const size_t transfers = active_download_transfers();
+        report["downloads"] = {
+            {"active", DownloadManager::getInstance().getAllActiveDownloads().size()},
+            {"connections", transfers},
+            {"buffer_bytes", transfers * static_cast<size_t>(CURL_MAX_WRITE_SIZE)}};
+
+        nlohmann::json caches = nlohmann::json::object();
+        const auto &embeddingCache = retrieval::EmbeddingCache::instance();
+        if (embeddingCache.enabled())
+        {
+            const auto stats = embeddingCache.stats();
+            caches["embedding"] = {{"entries", stats.entries}, {"bytes", stats.memory_bytes}};
+        }
+        const auto &responseCache = ResponseCache::instance();
+        if (responseCache.enabled())
+        {
+            const auto stats = responseCache.stats();
+            caches["response"] = {{"entries", stats.entries}, {"bytes", stats.bytes}};
+        }
+        const auto &semanticCache = SemanticCache::instance();
+        if (semanticCache.enabled())
+        {
+            const auto stats = semanticCache.stats();
+            caches["semantic"] = {{"entries", stats.entries}, {"bytes", stats.bytes}};
+        }
+        report["caches"] = std::move(caches);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto &[id, source] : sources_)
+        {
+            try
+            {
+                report[source.first] = source.second();
+            }
+            catch (const std::exception &ex)
+            {
+                report[source.first] = {{"error", ex.what()}};
+            }
+        }
+        return report;
+    }
+
+} // namespace kolosal
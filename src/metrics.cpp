@@ -0,0 +1,550 @@
+#include "kolosal/metrics.hpp"
+#include "kolosal/node_manager.h"
+#include "kolosal/gpu_detection.hpp"
+#include "kolosal/retrieval/embedding_cache.hpp"
+#include "kolosal/retrieval/parse_cache.hpp"
+#include "kolosal/faiss_point_store.hpp"
+#include "kolosal/response_cache.hpp"
+#include "kolosal/semantic_cache.hpp"
+#include "kolosal/cluster_router.hpp"
+#include "kolosal/remote_prefill.hpp"
+#include "kolosal/drain_manager.hpp"
+#include "kolosal/auth/rate_limiter.hpp"
+#include "kolosal/memory_report.hpp"
+#include "kolosal/tls.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <mutex>
+#include <sstream>
+
+#ifdef __linux__
+#include <dirent.h>
+#endif
+
+namespace kolosal
+{
+
+    namespace
+    {
+        // Request latency buckets in seconds, from cached responses to long generations
+        constexpr std::initializer_list<double> kLatencyBounds{
+            0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10, 30, 60, 120};
+        constexpr std::initializer_list<double> kModelLoadBounds{
+            1, 2.5, 5, 10, 20, 30, 60, 120, 300, 600};
+        // Arena usage in KiB; the histogram sum is kept in millionths, which bytes would overflow
+        constexpr std::initializer_list<double> kArenaKiBBounds{
+            1, 4, 16, 64, 256, 1024, 4096};
+
+        std::string escapeLabel(const std::string &value)
+        {
+            std::string out;
+            out.reserve(value.size());
+            for (char c : value)
+            {
+                if (c == '\\' || c == '"')
+                    out.push_back('\\');
+                if (c == '\n')
+                {
+                    out.append("\\n");
+                    continue;
+                }
+                out.push_back(c);
+            }
+            return out;
+        }
+
+        void writeHeader(std::ostream &os, const char *name, const char *type, const char *help)
+        {
+            os << "# HELP " << name << ' ' << help << '\n';
+            os << "# TYPE " << name << ' ' << type << '\n';
+        }
+
+        // labels is the inner label list ("a=\"x\",b=\"y\""), may be empty; scale converts the
+        // snapshot's unit (engine latencies are kept in milliseconds, exported in seconds)
+        void writeHistogram(std::ostream &os, const char *name, const std::string &labels,
+                            const HistogramSnapshot &histogram, double scale = 1.0)
+        {
+            const std::string sep = labels.empty() ? "" : ",";
+            uint64_t cumulative = 0;
+            for (size_t i = 0; i < histogram.counts.size(); ++i)
+            {
+                cumulative += histogram.counts[i];
+                os << name << "_bucket{" << labels << sep << "le=\"";
+                if (i < histogram.bounds.size())
+                    os << histogram.bounds[i] * scale;
+                else
+                    os << "+Inf";
+                os << "\"} " << cumulative << '\n';
+            }
+            const std::string braces = labels.empty() ? "" : "{" + labels + "}";
+            os << name << "_sum" << braces << ' ' << histogram.sum * scale << '\n';
+            os << name << "_count" << braces << ' ' << histogram.count << '\n';
+        }
+
+        struct EngineSample
+        {
+            std::string labels;
+            NodeManager::ReplicaStats stats;
+        };
+
+        void writeEngineFamily(std::ostream &os, const std::vector<EngineSample> &samples, const char *name,
+                               const char *type, const char *help,
+                               const std::function<double(const NodeManager::ReplicaStats &)> &value)
+        {
+            if (samples.empty())
+                return;
+            writeHeader(os, name, type, help);
+            for (const auto &sample : samples)
+            {
+                os << name << '{' << sample.labels << "} " << value(sample.stats) << '\n';
+            }
+        }
+
+        double openDescriptors()
+        {
+#ifdef __linux__
+            DIR *dir = opendir("/proc/self/fd");
+            if (!dir)
+                return -1;
+            long count = 0;
+            while (const dirent *entry = readdir(dir))
+            {
+                if (entry->d_name[0] != '.')
+                    ++count;
+            }
+            closedir(dir);
+            return static_cast<double>(count - 1); // The descriptor opendir() holds
+#else
+            return -1;
+#endif
+        }
+    } // namespace
+
+    Histogram::Histogram(std::initializer_list<double> bounds)
+        : bounds_(bounds), counts_(bounds_.size() + 1)
+    {
+    }
+
+    void Histogram::observe(double value)
+    {
+        const size_t bucket = std::lower_bound(bounds_.begin(), bounds_.end(), value) - bounds_.begin();
+        counts_[bucket].fetch_add(1, std::memory_order_relaxed);
+        count_.fetch_add(1, std::memory_order_relaxed);
+        sumMicros_.fetch_add(static_cast<uint64_t>(std::max(0.0, value) * 1e6), std::memory_order_relaxed);
+    }
+
+    HistogramSnapshot Histogram::snapshot() const
+    {
+        HistogramSnapshot result;
+        result.bounds = bounds_;
+        result.counts.reserve(counts_.size());
+        for (const auto &bucket : counts_)
+            result.counts.push_back(bucket.load(std::memory_order_relaxed));
+        result.count = count_.load(std::memory_order_relaxed);
+        result.sum = static_cast<double>(sumMicros_.load(std::memory_order_relaxed)) / 1e6;
+        return result;
+    }
+
+    Metrics::RouteSeries::RouteSeries() : latency(kLatencyBounds)
+    {
+    }
+
+    Metrics::Metrics() : arenaKiB_(kArenaKiBBounds)
+    {
+    }
+
+    Metrics &Metrics::instance()
+    {
+        static Metrics metrics;
+        return metrics;
+    }
+
+    void Metrics::observeRequest(const std::string &route, const std::string &method, int status, double seconds)
+    {
+        if (!enabled())
+            return;
+
+        RouteSeries *series = nullptr;
+        const auto key = std::make_pair(route, method);
+        {
+            std::shared_lock<std::shared_mutex> lock(mutex_);
+            auto it = routes_.find(key);
+            if (it != routes_.end())
+                series = it->second.get();
+        }
+        if (!series)
+        {
+            std::unique_lock<std::shared_mutex> lock(mutex_);
+            auto &slot = routes_[key];
+            if (!slot)
+                slot = std::make_unique<RouteSeries>();
+            series = slot.get();
+        }
+
+        series->latency.observe(seconds);
+        const int statusClass = std::clamp(status / 100, 1, 5) - 1;
+        series->byStatusClass[statusClass].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void Metrics::observeModelLoad(const std::string &engineId, double seconds)
+    {
+        Histogram *histogram = nullptr;
+        {
+            std::unique_lock<std::shared_mutex> lock(mutex_);
+            auto &slot = modelLoads_[engineId];
+            if (!slot)
+                slot = std::make_unique<Histogram>(kModelLoadBounds);
+            histogram = slot.get();
+        }
+        histogram->observe(seconds);
+    }
+
+    void Metrics::observeRequestArena(size_t bytes, bool overflowed)
+    {
+        arenaKiB_.observe(static_cast<double>(bytes) / 1024.0);
+        uint64_t seen = arenaHighWater_.load(std::memory_order_relaxed);
+        while (bytes > seen && !arenaHighWater_.compare_exchange_weak(seen, bytes, std::memory_order_relaxed))
+        {
+        }
+        if (overflowed)
+            arenaOverflows_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    std::string Metrics::render(const NodeManager &nodeManager, const auth::RateLimiter *rateLimiter) const
+    {
+        std::ostringstream os;
+        os.precision(10);
+
+        {
+            std::shared_lock<std::shared_mutex> lock(mutex_);
+            if (!routes_.empty())
+            {
+                writeHeader(os, "kolosal_http_requests_total", "counter", "HTTP requests by route, method and status class.");
+                for (const auto &[key, series] : routes_)
+                {
+                    for (int i = 0; i < 5; ++i)
+                    {
+                        const uint64_t n = series->byStatusClass[i].load(std::memory_order_relaxed);
+                        if (n == 0)
+                            continue;
+                        os << "kolosal_http_requests_total{route=\"" << escapeLabel(key.first) << "\",method=\""
+                           << escapeLabel(key.second) << "\",code=\"" << (i + 1) << "xx\"} " << n << '\n';
+                    }
+                }
+                writeHeader(os, "kolosal_http_request_duration_seconds", "histogram",
+                            "Time from routing a request to its handler returning.");
+                for (const auto &[key, series] : routes_)
+                {
+                    writeHistogram(os, "kolosal_http_request_duration_seconds",
+                                   "route=\"" + escapeLabel(key.first) + "\",method=\"" + escapeLabel(key.second) + "\"",
+                                   series->latency.snapshot());
+                }
+            }
+            if (!modelLoads_.empty())
+            {
+                writeHeader(os, "kolosal_model_load_duration_seconds", "histogram", "Time taken to load a model into an engine.");
+                for (const auto &[engineId, histogram] : modelLoads_)
+                {
+                    writeHistogram(os, "kolosal_model_load_duration_seconds", "engine=\"" + escapeLabel(engineId) + "\"",
+                                   histogram->snapshot());
+                }
+            }
+        }
+
+        const HistogramSnapshot arena = arenaKiB_.snapshot();
+        if (arena.count > 0)
+        {
+            writeHeader(os, "kolosal_request_arena_bytes", "histogram", "Request-lifetime arena memory used per request.");
+            writeHistogram(os, "kolosal_request_arena_bytes", "", arena, 1024.0);
+            writeHeader(os, "kolosal_request_arena_high_water_bytes", "gauge", "Most arena memory any single request has used.");
+            os << "kolosal_request_arena_high_water_bytes " << arenaHighWater_.load(std::memory_order_relaxed) << '\n';
+            writeHeader(os, "kolosal_request_arena_overflows_total", "counter", "Requests that outgrew their thread's arena buffer and spilled to the heap.");
+            os << "kolosal_request_arena_overflows_total " << arenaOverflows_.load(std::memory_order_relaxed) << '\n';
+        }
+
+        const TlsStats tls = TlsContext::stats();
+        if (tls.handshakes + tls.failed > 0)
+        {
+            writeHeader(os, "kolosal_tls_handshakes_total", "counter", "Completed TLS handshakes, by whether they resumed a previous session.");
+            os << "kolosal_tls_handshakes_total{resumed=\"true\"} " << tls.resumed << '\n';
+            os << "kolosal_tls_handshakes_total{resumed=\"false\"} " << tls.handshakes - tls.resumed << '\n';
+            writeHeader(os, "kolosal_tls_handshake_failures_total", "counter", "TLS handshakes that failed or were abandoned.");
+            os << "kolosal_tls_handshake_failures_total " << tls.failed << '\n';
+            writeHeader(os, "kolosal_tls_kernel_offload_total", "counter", "TLS connections whose records the kernel encrypts (send) or decrypts (recv).");
+            os << "kolosal_tls_kernel_offload_total{direction=\"send\"} " << tls.kernelSend << '\n';
+            os << "kolosal_tls_kernel_offload_total{direction=\"recv\"} " << tls.kernelRecv << '\n';
+        }
+
+        std::vector<EngineSample> samples;
+        for (auto &stats : nodeManager.getReplicaStats())
+        {
+            std::string labels = "engine=\"" + escapeLabel(stats.engineId) + "\",replica=\"" + std::to_string(stats.index) + "\"";
+            samples.push_back({std::move(labels), std::move(stats)});
+        }
+        using Stats = NodeManager::ReplicaStats;
+
+        writeEngineFamily(os, samples, "kolosal_engine_active_jobs", "gauge", "Submitted jobs not yet finished.",
+                          [](const Stats &s) { return s.load.active_jobs; });
+        writeEngineFamily(os, samples, "kolosal_engine_queued_jobs", "gauge", "Active jobs still waiting for a slot.",
+                          [](const Stats &s) { return std::max(0, s.load.active_jobs - s.decode.slots_in_use); });
+        writeEngineFamily(os, samples, "kolosal_engine_live_jobs", "gauge", "Jobs the engine still holds, finished ones not yet released included.",
+                          [](const Stats &s) { return static_cast<double>(s.liveJobs); });
+        writeEngineFamily(os, samples, "kolosal_engine_pending_tokens", "gauge", "Prompt tokens to ingest plus tokens to generate.",
+                          [](const Stats &s) { return static_cast<double>(s.load.pending_tokens); });
+        writeEngineFamily(os, samples, "kolosal_engine_slots", "gauge", "Sequences available to jobs.",
+                          [](const Stats &s) { return s.decode.slots_total; });
+        writeEngineFamily(os, samples, "kolosal_engine_slots_in_use", "gauge", "Sequences held by running jobs.",
+                          [](const Stats &s) { return s.decode.slots_in_use; });
+        writeEngineFamily(os, samples, "kolosal_engine_kv_cells", "gauge", "KV cache size in cells (context length).",
+                          [](const Stats &s) { return static_cast<double>(s.decode.kv_cells_total); });
+        writeEngineFamily(os, samples, "kolosal_engine_kv_cells_used", "gauge", "KV cells held by jobs, warm slots and the prefix cache.",
+                          [](const Stats &s) { return static_cast<double>(s.decode.kv_cells_used); });
+        if (std::any_of(samples.begin(), samples.end(), [](const EngineSample &s) { return s.stats.decode.kv_blocks_total > 0; }))
+        {
+            writeEngineFamily(os, samples, "kolosal_engine_kv_blocks", "gauge", "Paged KV blocks sequences grow into.",
+                              [](const Stats &s) { return s.decode.kv_blocks_total; });
+            writeEngineFamily(os, samples, "kolosal_engine_kv_blocks_used", "gauge", "Paged KV blocks held by sequences.",
+                              [](const Stats &s) { return s.decode.kv_blocks_used; });
+        }
+        writeEngineFamily(os, samples, "kolosal_engine_routed_requests_total", "counter", "Requests dispatched to the replica.",
+                          [](const Stats &s) { return static_cast<double>(s.routedRequests); });
+        writeEngineFamily(os, samples, "kolosal_engine_decode_calls_total", "counter", "llama_decode() calls.",
+                          [](const Stats &s) { return static_cast<double>(s.decode.decode_calls); });
+        writeEngineFamily(os, samples, "kolosal_engine_decode_tokens_total", "counter", "Tokens submitted to llama_decode().",
+                          [](const Stats &s) { return static_cast<double>(s.decode.decode_tokens); });
+        writeEngineFamily(os, samples, "kolosal_engine_prompt_tokens_total", "counter", "Prompt tokens ingested.",
+                          [](const Stats &s) { return static_cast<double>(s.decode.prompt_tokens); });
+        writeEngineFamily(os, samples, "kolosal_engine_chunk_tokens_total", "counter", "Prompt tokens spliced from cached document chunks instead of decoded.",
+                          [](const Stats &s) { return static_cast<double>(s.decode.chunk_tokens); });
+        writeEngineFamily(os, samples, "kolosal_engine_generated_tokens_total", "counter", "Tokens generated.",
+                          [](const Stats &s) { return static_cast<double>(s.decode.generated_tokens); });
+        writeEngineFamily(os, samples, "kolosal_engine_draft_tokens_total", "counter", "Speculative draft tokens verified.",
+                          [](const Stats &s) { return static_cast<double>(s.decode.draft_tokens); });
+        writeEngineFamily(os, samples, "kolosal_engine_draft_accepted_tokens_total", "counter", "Speculative draft tokens accepted.",
+                          [](const Stats &s) { return static_cast<double>(s.decode.draft_accepted); });
+        writeEngineFamily(os, samples, "kolosal_engine_embedding_inputs_total", "counter", "Inputs embedded.",
+                          [](const Stats &s) { return static_cast<double>(s.decode.embedding_inputs); });
+        writeEngineFamily(os, samples, "kolosal_engine_embedding_tokens_total", "counter", "Tokens of embedded inputs.",
+                          [](const Stats &s) { return static_cast<double>(s.decode.embedding_tokens); });
+        writeEngineFamily(os, samples, "kolosal_engine_preemptions_total", "counter", "Jobs paused so that a higher-priority job got their slot.",
+                          [](const Stats &s) { return static_cast<double>(s.decode.preemptions); });
+        writeEngineFamily(os, samples, "kolosal_engine_swapped_jobs", "gauge", "Paused jobs whose KV waits in host RAM for a slot.",
+                          [](const Stats &s) { return s.decode.swapped_jobs; });
+        writeEngineFamily(os, samples, "kolosal_engine_swapped_bytes", "gauge", "KV state held in host RAM by paused jobs.",
+                          [](const Stats &s) { return static_cast<double>(s.decode.swapped_bytes); });
+
+        if (std::any_of(samples.begin(), samples.end(), [](const EngineSample &s) { return s.stats.decode.slo_max_active > 0; }))
+        {
+            writeEngineFamily(os, samples, "kolosal_engine_slo_ttft_p95_seconds", "gauge", "p95 time to first token over the SLO controller's last window.",
+                              [](const Stats &s) { return s.decode.slo_ttft_p95_ms / 1000.0; });
+            writeEngineFamily(os, samples, "kolosal_engine_slo_tpot_p95_seconds", "gauge", "p95 time per output token over the SLO controller's last window.",
+                              [](const Stats &s) { return s.decode.slo_tpot_p95_ms / 1000.0; });
+            writeEngineFamily(os, samples, "kolosal_engine_slo_prefill_tokens", "gauge", "Prompt tokens a step may take while generations run, set by the SLO controller.",
+                              [](const Stats &s) { return s.decode.slo_prefill_tokens; });
+            writeEngineFamily(os, samples, "kolosal_engine_slo_max_active", "gauge", "Slots allowed to decode at once, set by the SLO controller.",
+                              [](const Stats &s) { return s.decode.slo_max_active; });
+            writeEngineFamily(os, samples, "kolosal_engine_slo_admit_jobs", "gauge", "Jobs admitted by the SLO controller, running plus queued (0 = no limit).",
+                              [](const Stats &s) { return s.decode.slo_admit_jobs; });
+            writeEngineFamily(os, samples, "kolosal_engine_slo_adjustments_total", "counter", "SLO controller windows after which a setting changed.",
+                              [](const Stats &s) { return static_cast<double>(s.decode.slo_adjustments); });
+        }
+
+        if (!samples.empty())
+        {
+            writeHeader(os, "kolosal_engine_decode_batch_tokens", "histogram", "Tokens per llama_decode() call (batch occupancy).");
+            for (const auto &sample : samples)
+                writeHistogram(os, "kolosal_engine_decode_batch_tokens", sample.labels, sample.stats.decode.batch_tokens);
+
+            writeHeader(os, "kolosal_engine_time_to_first_token_seconds", "histogram", "Time from submission to the first generated token.");
+            for (const auto &sample : samples)
+                writeHistogram(os, "kolosal_engine_time_to_first_token_seconds", sample.labels, sample.stats.decode.ttft_ms, 1e-3);
+
+            writeHeader(os, "kolosal_engine_time_per_output_token_seconds", "histogram", "Time between consecutive generated tokens.");
+            for (const auto &sample : samples)
+                writeHistogram(os, "kolosal_engine_time_per_output_token_seconds", sample.labels, sample.stats.decode.tpot_ms, 1e-3);
+        }
+
+        const auto admission = nodeManager.getAdmissionStats();
+        if (!admission.empty())
+        {
+            writeHeader(os, "kolosal_engine_rejected_requests_total", "counter", "Requests turned away by admission control.");
+            for (const auto &entry : admission)
+            {
+                os << "kolosal_engine_rejected_requests_total{engine=\"" << escapeLabel(entry.engineId) << "\"} "
+                   << entry.rejectedRequests << '\n';
+            }
+        }
+
+        const auto& embeddingCache = retrieval::EmbeddingCache::instance();
+        if (embeddingCache.enabled())
+        {
+            const auto cache = embeddingCache.stats();
+            writeHeader(os, "kolosal_embedding_cache_lookups_total", "counter", "Embedding cache lookups by outcome.");
+            os << "kolosal_embedding_cache_lookups_total{result=\"hit\"} " << cache.hits << '\n';
+            os << "kolosal_embedding_cache_lookups_total{result=\"disk_hit\"} " << cache.disk_hits << '\n';
+            os << "kolosal_embedding_cache_lookups_total{result=\"miss\"} " << cache.misses << '\n';
+            writeHeader(os, "kolosal_embedding_cache_evictions_total", "counter", "Embeddings dropped from memory to stay within budget.");
+            os << "kolosal_embedding_cache_evictions_total " << cache.evictions << '\n';
+            writeHeader(os, "kolosal_embedding_cache_entries", "gauge", "Cached embeddings by tier.");
+            os << "kolosal_embedding_cache_entries{tier=\"memory\"} " << cache.entries << '\n';
+            os << "kolosal_embedding_cache_entries{tier=\"disk\"} " << cache.disk_entries << '\n';
+            writeHeader(os, "kolosal_embedding_cache_bytes", "gauge", "Size of the cache by tier.");
+            os << "kolosal_embedding_cache_bytes{tier=\"memory\"} " << cache.memory_bytes << '\n';
+            os << "kolosal_embedding_cache_bytes{tier=\"disk\"} " << cache.disk_bytes << '\n';
+        }
+
+        const auto payloadText = FaissPointStore::compressionStats();
+        if (payloadText.raw_bytes > 0 || payloadText.inflations > 0)
+        {
+            writeHeader(os, "kolosal_payload_text_bytes_total", "counter", "Payload strings compressed by FAISS collections, before and after.");
+            os << "kolosal_payload_text_bytes_total{form=\"raw\"} " << payloadText.raw_bytes << '\n';
+            os << "kolosal_payload_text_bytes_total{form=\"compressed\"} " << payloadText.stored_bytes << '\n';
+            writeHeader(os, "kolosal_payload_text_inflations_total", "counter", "Compressed payload strings inflated for lookups.");
+            os << "kolosal_payload_text_inflations_total " << payloadText.inflations << '\n';
+            writeHeader(os, "kolosal_payload_text_inflate_seconds_total", "counter", "Time spent inflating payload strings.");
+            os << "kolosal_payload_text_inflate_seconds_total " << payloadText.inflate_seconds << '\n';
+            writeHeader(os, "kolosal_payload_text_dictionaries_total", "counter", "Text compression dictionaries trained.");
+            os << "kolosal_payload_text_dictionaries_total " << payloadText.dictionaries << '\n';
+        }
+
+        const auto& responseCache = ResponseCache::instance();
+        if (responseCache.enabled())
+        {
+            const auto cache = responseCache.stats();
+            writeHeader(os, "kolosal_response_cache_lookups_total", "counter", "Response cache lookups by outcome.");
+            os << "kolosal_response_cache_lookups_total{result=\"hit\"} " << cache.hits << '\n';
+            os << "kolosal_response_cache_lookups_total{result=\"miss\"} " << cache.misses << '\n';
+            writeHeader(os, "kolosal_response_cache_evictions_total", "counter", "Responses dropped from the cache by reason.");
+            os << "kolosal_response_cache_evictions_total{reason=\"budget\"} " << cache.evictions << '\n';
+            os << "kolosal_response_cache_evictions_total{reason=\"expired\"} " << cache.expirations << '\n';
+            writeHeader(os, "kolosal_response_cache_entries", "gauge", "Cached responses.");
+            os << "kolosal_response_cache_entries " << cache.entries << '\n';
+            writeHeader(os, "kolosal_response_cache_bytes", "gauge", "Size of the response cache.");
+            os << "kolosal_response_cache_bytes " << cache.bytes << '\n';
+        }
+
+        const auto& semanticCache = SemanticCache::instance();
+        if (semanticCache.enabled())
+        {
+            const auto cache = semanticCache.stats();
+            writeHeader(os, "kolosal_semantic_cache_lookups_total", "counter", "Semantic cache lookups by outcome.");
+            os << "kolosal_semantic_cache_lookups_total{result=\"hit\"} " << cache.hits << '\n';
+            os << "kolosal_semantic_cache_lookups_total{result=\"miss\"} " << cache.misses << '\n';
+            writeHeader(os, "kolosal_semantic_cache_evictions_total", "counter", "Answers dropped from the semantic cache by reason.");
+            os << "kolosal_semantic_cache_evictions_total{reason=\"budget\"} " << cache.evictions << '\n';
+            os << "kolosal_semantic_cache_evictions_total{reason=\"expired\"} " << cache.expirations << '\n';
+            writeHeader(os, "kolosal_semantic_cache_entries", "gauge", "Answers in the semantic cache.");
+            os << "kolosal_semantic_cache_entries " << cache.entries << '\n';
+            writeHeader(os, "kolosal_semantic_cache_bytes", "gauge", "Size of the semantic cache.");
+            os << "kolosal_semantic_cache_bytes " << cache.bytes << '\n';
+        }
+
+        const auto& cluster = ClusterRouter::instance();
+        if (cluster.enabled())
+        {
+            static const char* const kReasons[] = {"only", "affinity", "hash", "fallback"};
+            const auto routing = cluster.stats();
+            writeHeader(os, "kolosal_cluster_routed_total", "counter", "Completion requests routed by target and reason.");
+            for (int target = 0; target < 2; ++target)
+            {
+                for (int reason = 0; reason < 4; ++reason)
+                {
+                    os << "kolosal_cluster_routed_total{target=\"" << (target == 0 ? "local" : "peer") << "\",reason=\""
+                       << kReasons[reason] << "\"} " << routing.routed[target][reason] << '\n';
+                }
+            }
+            writeHeader(os, "kolosal_cluster_proxy_errors_total", "counter", "Peers that failed before answering; the request was served locally.");
+            os << "kolosal_cluster_proxy_errors_total " << routing.proxy_errors << '\n';
+            writeHeader(os, "kolosal_cluster_live_nodes", "gauge", "Cluster nodes heard from recently, this one included.");
+            os << "kolosal_cluster_live_nodes " << routing.live_nodes << '\n';
+        }
+
+        const auto& remotePrefill = RemotePrefill::instance();
+        if (remotePrefill.enabled())
+        {
+            const auto prefill = remotePrefill.stats();
+            writeHeader(os, "kolosal_remote_prefill_total", "counter", "Long prompts sent to a prefill node by outcome.");
+            os << "kolosal_remote_prefill_total{result=\"transferred\"} " << prefill.transfers << '\n';
+            os << "kolosal_remote_prefill_total{result=\"failed\"} " << prefill.failures << '\n';
+            writeHeader(os, "kolosal_remote_prefill_bytes_total", "counter", "KV state received from prefill nodes.");
+            os << "kolosal_remote_prefill_bytes_total " << prefill.bytes << '\n';
+        }
+
+        if (ClusterRouter::instance().enabled())
+        {
+            const auto drain = DrainManager::instance().stats();
+            writeHeader(os, "kolosal_drain_draining", "gauge", "1 while this node is draining.");
+            os << "kolosal_drain_draining " << (DrainManager::instance().draining() ? 1 : 0) << '\n';
+            writeHeader(os, "kolosal_drain_generations_total", "counter", "Generations suspended by a drain, by outcome.");
+            os << "kolosal_drain_generations_total{result=\"moved\"} " << drain.generations_moved << '\n';
+            os << "kolosal_drain_generations_total{result=\"failed\"} " << drain.generations_failed << '\n';
+            writeHeader(os, "kolosal_drain_sessions_total", "counter", "Warm sessions exported by a drain, by outcome.");
+            os << "kolosal_drain_sessions_total{result=\"moved\"} " << drain.sessions_moved << '\n';
+            os << "kolosal_drain_sessions_total{result=\"failed\"} " << drain.sessions_failed << '\n';
+        }
+
+        const auto& parseCache = retrieval::ParseCache::instance();
+        if (parseCache.enabled())
+        {
+            const auto cache = parseCache.stats();
+            writeHeader(os, "kolosal_parse_cache_lookups_total", "counter", "Parse cache lookups by outcome.");
+            os << "kolosal_parse_cache_lookups_total{result=\"hit\"} " << cache.hits << '\n';
+            os << "kolosal_parse_cache_lookups_total{result=\"miss\"} " << cache.misses << '\n';
+            writeHeader(os, "kolosal_parse_cache_evictions_total", "counter", "Parse results deleted to stay within budget.");
+            os << "kolosal_parse_cache_evictions_total " << cache.evictions << '\n';
+            writeHeader(os, "kolosal_parse_cache_entries", "gauge", "Cached parse results.");
+            os << "kolosal_parse_cache_entries " << cache.entries << '\n';
+            writeHeader(os, "kolosal_parse_cache_bytes", "gauge", "Size of the cached parse results on disk.");
+            os << "kolosal_parse_cache_bytes " << cache.bytes << '\n';
+        }
+
+        const auto gpus = GpuTelemetry::instance().devices();
+        auto writeGpuFamily = [&os, &gpus](const char *name, const char *help, auto value)
+        {
+            bool headerWritten = false;
+            for (const auto &gpu : gpus)
+            {
+                const double v = value(gpu);
+                if (v < 0)
+                    continue;
+                if (!headerWritten)
+                {
+                    writeHeader(os, name, "gauge", help);
+                    headerWritten = true;
+                }
+                os << name << "{gpu=\"" << gpu.index << "\",name=\"" << escapeLabel(gpu.name) << "\"} " << v << '\n';
+            }
+        };
+        writeGpuFamily("kolosal_gpu_memory_total_bytes", "Device memory.",
+                       [](const GpuDevice &g) { return g.totalMemoryBytes ? static_cast<double>(g.totalMemoryBytes) : -1.0; });
+        writeGpuFamily("kolosal_gpu_memory_free_bytes", "Device memory not in use by any process.",
+                       [](const GpuDevice &g) { return g.totalMemoryBytes ? static_cast<double>(g.freeMemoryBytes) : -1.0; });
+        writeGpuFamily("kolosal_gpu_utilization_percent", "Share of the last sample period the GPU was busy.",
+                       [](const GpuDevice &g) { return static_cast<double>(g.utilizationPercent); });
+        writeGpuFamily("kolosal_gpu_temperature_celsius", "GPU core temperature.",
+                       [](const GpuDevice &g) { return static_cast<double>(g.temperatureC); });
+
+        if (rateLimiter)
+        {
+            writeHeader(os, "kolosal_rate_limiter_buckets", "gauge", "Client and API key buckets held by the rate limiter.");
+            os << "kolosal_rate_limiter_buckets " << rateLimiter->bucketCount() << '\n';
+        }
+
+        auto writeProcessGauge = [&os](const char *name, const char *help, double value)
+        {
+            if (value < 0)
+                return;
+            writeHeader(os, name, "gauge", help);
+            os << name << ' ' << value << '\n';
+        };
+        writeProcessGauge("process_resident_memory_bytes", "Resident memory size in bytes.",
+                          static_cast<double>(MemoryReport::processMemory().resident));
+        writeProcessGauge("process_open_fds", "Number of open file descriptors.", openDescriptors());
+        writeProcessGauge("kolosal_heap_in_use_bytes", "Heap memory allocated and not yet freed.",
+                          static_cast<double>(MemoryReport::allocatorStats().allocated));
+
+        return os.str();
+    }
+
+} // namespace kolosal
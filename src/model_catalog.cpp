@@ -0,0 +1,341 @@
+#include "kolosal/model_catalog.hpp"
+#include "kolosal/download_utils.hpp"
+#include "kolosal/logger.hpp"
+#include <json.hpp>
+#include <filesystem>
+#include <fstream>
+
+namespace kolosal
+{
+
+    namespace
+    {
+        constexpr const char *kSidecarName = ".kolosal-catalog.json";
+        constexpr auto kUrlTrust = std::chrono::minutes(10);
+        constexpr uint64_t kMaxString = 64ull * 1024 * 1024;
+
+        std::mutex sidecarMutex;
+
+        enum GgufType : uint32_t
+        {
+            U8 = 0, I8, U16, I16, U32, I32, F32, BOOL, STRING, ARRAY, U64, I64, F64
+        };
+
+        uint64_t scalarSize(uint32_t type)
+        {
+            switch (type)
+            {
+            case U8: case I8: case BOOL: return 1;
+            case U16: case I16: return 2;
+            case U32: case I32: case F32: return 4;
+            case U64: case I64: case F64: return 8;
+            default: return 0;
+            }
+        }
+
+        class HeaderReader
+        {
+        public:
+            explicit HeaderReader(std::ifstream &in) : in_(in) {}
+
+            template <typename T>
+            bool read(T &value)
+            {
+                return static_cast<bool>(in_.read(reinterpret_cast<char *>(&value), sizeof(T)));
+            }
+
+            bool readString(std::string &value)
+            {
+                uint64_t length = 0;
+                if (!read(length) || length > kMaxString)
+                    return false;
+                value.resize(static_cast<size_t>(length));
+                return length == 0 || static_cast<bool>(in_.read(&value[0], static_cast<std::streamsize>(length)));
+            }
+
+            bool skipString()
+            {
+                uint64_t length = 0;
+                return read(length) && length <= kMaxString && static_cast<bool>(in_.seekg(static_cast<std::streamoff>(length), std::ios::cur));
+            }
+
+            // Integer value of any integer type, or nullopt for the others (which are skipped)
+            bool readValue(uint32_t type, std::optional<uint64_t> &number, std::string *text)
+            {
+                if (type == STRING)
+                    return text ? readString(*text) : skipString();
+                if (type == ARRAY)
+                {
+                    uint32_t elementType = 0;
+                    uint64_t count = 0;
+                    if (!read(elementType) || !read(count))
+                        return false;
+                    if (const uint64_t size = scalarSize(elementType))
+                        return static_cast<bool>(in_.seekg(static_cast<std::streamoff>(size * count), std::ios::cur));
+                    for (uint64_t i = 0; i < count; ++i)
+                    {
+                        std::optional<uint64_t> ignored;
+                        if (!readValue(elementType, ignored, nullptr))
+                            return false;
+                    }
+                    return true;
+                }
+                const uint64_t size = scalarSize(type);
+                if (size == 0)
+                    return false;
+                uint64_t raw = 0;
+                if (!in_.read(reinterpret_cast<char *>(&raw), static_cast<std::streamsize>(size)))
+                    return false;
+                if (type != F32 && type != F64 && type != BOOL)
+                    number = raw;
+                return true;
+            }
+
+            uint64_t position() { return static_cast<uint64_t>(in_.tellg()); }
+
+        private:
+            std::ifstream &in_;
+        };
+
+        long long fileMtime(const std::filesystem::path &file, std::error_code &ec)
+        {
+            auto time = std::filesystem::last_write_time(file, ec);
+            return ec ? 0 : static_cast<long long>(time.time_since_epoch().count());
+        }
+
+        std::filesystem::path sidecarFor(const std::string &path)
+        {
+            return std::filesystem::path(path).parent_path() / kSidecarName;
+        }
+
+        nlohmann::json readSidecarFile(const std::filesystem::path &sidecar)
+        {
+            std::ifstream in(sidecar);
+            if (!in)
+                return nlohmann::json::object();
+            nlohmann::json entries = nlohmann::json::parse(in, nullptr, false);
+            return entries.is_object() ? entries : nlohmann::json::object();
+        }
+    }
+
+    ModelCatalog &ModelCatalog::instance()
+    {
+        static ModelCatalog catalog;
+        return catalog;
+    }
+
+    bool ModelCatalog::validate(const std::string &path, std::string &error)
+    {
+        if (!is_valid_url(path))
+        {
+            std::error_code ec;
+            if (!std::filesystem::exists(path, ec))
+            {
+                error = "Local model file does not exist: " + path;
+                return false;
+            }
+            if (!std::filesystem::is_regular_file(path, ec))
+            {
+                error = "Model path is not a regular file: " + path;
+                return false;
+            }
+            if (!describe(path))
+            {
+                error = "Could not read model file: " + path;
+                return false;
+            }
+            return true;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = urls_.find(path);
+            if (it != urls_.end() && std::chrono::steady_clock::now() - it->second < kUrlTrust)
+                return true;
+        }
+
+        KOLOSAL_LOG_INFO("Validating URL accessibility: %s", path.c_str());
+        auto result = get_url_file_info(path);
+        if (!result.success)
+        {
+            error = "URL validation failed: " + path + " - " + result.error_message;
+            return false;
+        }
+        KOLOSAL_LOG_INFO("URL is accessible. File size: %.2f MB", static_cast<double>(result.total_bytes) / (1024.0 * 1024.0));
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        urls_[path] = std::chrono::steady_clock::now();
+        return true;
+    }
+
+    std::optional<ModelCatalog::ModelInfo> ModelCatalog::describe(const std::string &path)
+    {
+        std::error_code ec;
+        const uint64_t size = std::filesystem::file_size(path, ec);
+        if (ec)
+            return std::nullopt;
+        const long long mtime = fileMtime(path, ec);
+        if (ec)
+            return std::nullopt;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = files_.find(path);
+            if (it != files_.end() && it->second.file_size == size && it->second.mtime == mtime)
+                return it->second;
+        }
+
+        ModelInfo info;
+        info.path = path;
+        info.file_size = size;
+        info.mtime = mtime;
+        if (!readSidecar(info))
+        {
+            // Files that are not GGUF (or not complete yet) are still described by their size
+            if (readHeader(path, info))
+            {
+                KOLOSAL_LOG_DEBUG("Cataloged %s: %s, %u layers, context %u", path.c_str(), info.architecture.c_str(),
+                                  info.block_count, info.context_length);
+                writeSidecar(info);
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        files_[path] = info;
+        return info;
+    }
+
+    std::optional<ModelCatalog::ModelInfo> ModelCatalog::peek(const std::string &path) const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = files_.find(path);
+        if (it == files_.end())
+            return std::nullopt;
+        return it->second;
+    }
+
+    bool ModelCatalog::readHeader(const std::string &path, ModelInfo &info)
+    {
+        std::ifstream in(path, std::ios::binary);
+        if (!in)
+            return false;
+        HeaderReader reader(in);
+
+        char magic[4] = {};
+        uint32_t version = 0;
+        uint64_t tensorCount = 0, kvCount = 0;
+        if (!in.read(magic, 4) || std::string(magic, 4) != "GGUF" || !reader.read(version) || version < 2 ||
+            !reader.read(tensorCount) || !reader.read(kvCount))
+            return false;
+
+        // Architecture keys come after general.architecture in practice, but nothing requires it
+        std::map<std::string, uint64_t> numbers;
+        uint64_t alignment = 32;
+        for (uint64_t i = 0; i < kvCount; ++i)
+        {
+            std::string key;
+            uint32_t type = 0;
+            if (!reader.readString(key) || !reader.read(type))
+                return false;
+            std::optional<uint64_t> number;
+            std::string text;
+            const bool wanted = key == "general.architecture" || key == "general.name";
+            if (!reader.readValue(type, number, wanted ? &text : nullptr))
+                return false;
+            if (key == "general.architecture")
+                info.architecture = text;
+            else if (key == "general.name")
+                info.name = text;
+            else if (number)
+                numbers[key] = *number;
+        }
+        if (numbers.count("general.alignment") && numbers["general.alignment"] > 0)
+            alignment = numbers["general.alignment"];
+
+        auto archValue = [&](const char *suffix) -> uint32_t
+        {
+            auto it = numbers.find(info.architecture + "." + suffix);
+            return it == numbers.end() ? 0 : static_cast<uint32_t>(it->second);
+        };
+        info.file_type = numbers.count("general.file_type") ? static_cast<uint32_t>(numbers["general.file_type"]) : 0;
+        info.context_length = archValue("context_length");
+        info.embedding_length = archValue("embedding_length");
+        info.block_count = archValue("block_count");
+        info.head_count = archValue("attention.head_count");
+        info.head_count_kv = archValue("attention.head_count_kv");
+
+        for (uint64_t i = 0; i < tensorCount; ++i)
+        {
+            uint32_t dims = 0;
+            if (!reader.skipString() || !reader.read(dims) || dims > 8 ||
+                !in.seekg(static_cast<std::streamoff>(dims * sizeof(uint64_t) + sizeof(uint32_t) + sizeof(uint64_t)), std::ios::cur))
+                return false;
+        }
+        const uint64_t headerEnd = reader.position();
+        const uint64_t dataStart = (headerEnd + alignment - 1) / alignment * alignment;
+
+        info.tensor_count = tensorCount;
+        info.tensor_bytes = info.file_size > dataStart ? info.file_size - dataStart : 0;
+        info.gguf = true;
+        return true;
+    }
+
+    bool ModelCatalog::readSidecar(ModelInfo &info)
+    {
+        std::lock_guard<std::mutex> lock(sidecarMutex);
+        const nlohmann::json entries = readSidecarFile(sidecarFor(info.path));
+        auto it = entries.find(std::filesystem::path(info.path).filename().string());
+        if (it == entries.end() || !it->is_object())
+            return false;
+
+        // A changed size or timestamp means the file was replaced since it was read
+        if (it->value("size", static_cast<uint64_t>(0)) != info.file_size || it->value("mtime", 0LL) != info.mtime)
+            return false;
+
+        info.gguf = true;
+        info.architecture = it->value("architecture", std::string());
+        info.name = it->value("name", std::string());
+        info.file_type = it->value("file_type", 0u);
+        info.context_length = it->value("context_length", 0u);
+        info.embedding_length = it->value("embedding_length", 0u);
+        info.block_count = it->value("block_count", 0u);
+        info.head_count = it->value("head_count", 0u);
+        info.head_count_kv = it->value("head_count_kv", 0u);
+        info.tensor_count = it->value("tensor_count", static_cast<uint64_t>(0));
+        info.tensor_bytes = it->value("tensor_bytes", static_cast<uint64_t>(0));
+        return true;
+    }
+
+    void ModelCatalog::writeSidecar(const ModelInfo &info)
+    {
+        std::lock_guard<std::mutex> lock(sidecarMutex);
+        const std::filesystem::path sidecar = sidecarFor(info.path);
+        nlohmann::json entries = readSidecarFile(sidecar);
+        entries[std::filesystem::path(info.path).filename().string()] = {
+            {"size", info.file_size},
+            {"mtime", info.mtime},
+            {"architecture", info.architecture},
+            {"name", info.name},
+            {"file_type", info.file_type},
+            {"context_length", info.context_length},
+            {"embedding_length", info.embedding_length},
+            {"block_count", info.block_count},
+            {"head_count", info.head_count},
+            {"head_count_kv", info.head_count_kv},
+            {"tensor_count", info.tensor_count},
+            {"tensor_bytes", info.tensor_bytes}};
+
+        // Written beside the file and renamed into place; a read-only model directory just isn't cached
+        const std::filesystem::path temp = sidecar.string() + ".tmp";
+        {
+            std::ofstream out(temp, std::ios::trunc);
+            if (!out || !(out << entries.dump(2)))
+                return;
+        }
+        std::error_code ec;
+        std::filesystem::rename(temp, sidecar, ec);
+        if (ec)
+            std::filesystem::remove(temp, ec);
+    }
+
+} // namespace kolosal
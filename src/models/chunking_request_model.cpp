@@ -7,15 +7,30 @@ namespace kolosal
 
 bool ChunkingRequest::validate() const
 {
-    if (text.empty())
+    if (texts.empty() && text.empty())
     {
-        ServerLogger::logDebug("Validation failed: text is empty");
+        KOLOSAL_LOG_DEBUG("Validation failed: text is empty");
         return false;
     }
 
+    if (texts.size() > kMaxTexts)
+    {
+        KOLOSAL_LOG_DEBUG("Validation failed: at most %zu texts per request, got %zu", kMaxTexts, texts.size());
+        return false;
+    }
+
+    for (const auto& t : texts)
+    {
+        if (t.empty())
+        {
+            KOLOSAL_LOG_DEBUG("Validation failed: texts contains an empty text");
+            return false;
+        }
+    }
+
     if (method != "regular" && method != "semantic")
     {
-        ServerLogger::logDebug("Validation failed: method must be 'regular' or 'semantic', got '%s'", method.c_str());
+        KOLOSAL_LOG_DEBUG("Validation failed: method must be 'regular' or 'semantic', got '%s'", method.c_str());
         return false;
     }
 
@@ -23,25 +38,25 @@ bool ChunkingRequest::validate() const
     
     if (chunk_size <= 0 || chunk_size > 2048)
     {
-        ServerLogger::logDebug("Validation failed: chunk_size must be between 1 and 2048, got %d", chunk_size);
+        KOLOSAL_LOG_DEBUG("Validation failed: chunk_size must be between 1 and 2048, got %d", chunk_size);
         return false;
     }
     
     if (max_chunk_size <= 0 || max_chunk_size > 4096)
     {
-        ServerLogger::logDebug("Validation failed: max_chunk_size must be between 1 and 4096, got %d", max_chunk_size);
+        KOLOSAL_LOG_DEBUG("Validation failed: max_chunk_size must be between 1 and 4096, got %d", max_chunk_size);
         return false;
     }
     
     if (overlap < 0 || overlap >= chunk_size)
     {
-        ServerLogger::logDebug("Validation failed: overlap must be >= 0 and < chunk_size, got %d", overlap);
+        KOLOSAL_LOG_DEBUG("Validation failed: overlap must be >= 0 and < chunk_size, got %d", overlap);
         return false;
     }
     
     if (similarity_threshold < 0.0f || similarity_threshold > 1.0f)
     {
-        ServerLogger::logDebug("Validation failed: similarity_threshold must be between 0.0 and 1.0, got %f", similarity_threshold);
+        KOLOSAL_LOG_DEBUG("Validation failed: similarity_threshold must be between 0.0 and 1.0, got %f", similarity_threshold);
         return false;
     }
     
@@ -52,7 +67,15 @@ nlohmann::json ChunkingRequest::to_json() const
 {
     nlohmann::json j;
     j["model_name"] = model_name;
-    j["text"] = text;
+    if (texts.empty())
+    {
+        j["text"] = text;
+    }
+    else
+    {
+        j["texts"] = texts;
+    }
+    j["stream"] = stream;
     j["chunk_size"] = chunk_size;
     j["max_chunk_size"] = max_chunk_size;
     j["overlap"] = overlap;
@@ -84,11 +107,42 @@ void ChunkingRequest::from_json(const nlohmann::json& j)
     }
     // If model_name is missing, we'll attempt to pick a fallback later in the route handler
 
-    if (!j.contains("text") || !j["text"].is_string())
+    if (j.contains("texts"))
+    {
+        if (j.contains("text"))
+        {
+            throw std::runtime_error("Give either 'text' or 'texts', not both");
+        }
+        if (!j["texts"].is_array())
+        {
+            throw std::runtime_error("Field 'texts' must be an array of strings");
+        }
+        for (const auto& t : j["texts"])
+        {
+            if (!t.is_string())
+            {
+                throw std::runtime_error("Field 'texts' must be an array of strings");
+            }
+            texts.push_back(t.get<std::string>());
+        }
+    }
+    else
+    {
+        if (!j.contains("text") || !j["text"].is_string())
+        {
+            throw std::runtime_error("Missing or invalid 'text' field - must be a string");
+        }
+        text = j["text"].get<std::string>();
+    }
+
+    if (j.contains("stream"))
     {
-        throw std::runtime_error("Missing or invalid 'text' field - must be a string");
+        if (!j["stream"].is_boolean())
+        {
+            throw std::runtime_error("Field 'stream' must be a boolean");
+        }
+        stream = j["stream"].get<bool>();
     }
-    text = j["text"].get<std::string>();
     
     if (j.contains("chunk_size"))
     {
@@ -18,25 +18,25 @@ bool ChunkingResponse::validate() const
 {
     if (model_name.empty())
     {
-        ServerLogger::logDebug("Validation failed: model_name is empty");
+        KOLOSAL_LOG_DEBUG("Validation failed: model_name is empty");
         return false;
     }
     
     if (method != "regular" && method != "semantic")
     {
-        ServerLogger::logDebug("Validation failed: method must be 'regular' or 'semantic', got '%s'", method.c_str());
+        KOLOSAL_LOG_DEBUG("Validation failed: method must be 'regular' or 'semantic', got '%s'", method.c_str());
         return false;
     }
     
     if (total_chunks != static_cast<int>(chunks.size()))
     {
-        ServerLogger::logDebug("Validation failed: total_chunks (%d) doesn't match chunks.size() (%zu)", total_chunks, chunks.size());
+        KOLOSAL_LOG_DEBUG("Validation failed: total_chunks (%d) doesn't match chunks.size() (%zu)", total_chunks, chunks.size());
         return false;
     }
     
     if (usage.original_tokens < 0 || usage.total_chunk_tokens < 0)
     {
-        ServerLogger::logDebug("Validation failed: token counts cannot be negative");
+        KOLOSAL_LOG_DEBUG("Validation failed: token counts cannot be negative");
         return false;
     }
     
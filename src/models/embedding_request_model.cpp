@@ -1,9 +1,150 @@
 #include "kolosal/models/embedding_request_model.hpp"
+#include "kolosal/models/json_sax_reader.hpp"
 #include <stdexcept>
 
 namespace kolosal
 {
 
+namespace
+{
+
+// Fills an EmbeddingRequest while the body is parsed; input strings are moved, never copied
+class EmbeddingRequestReader : public JsonSaxReader
+{
+public:
+    explicit EmbeddingRequestReader(EmbeddingRequest& request) : request_(request) {}
+
+    void finish()
+    {
+        if (!has_model_)
+        {
+            throw std::runtime_error("Missing required field: model");
+        }
+        if (!has_input_)
+        {
+            throw std::runtime_error("Missing required field: input");
+        }
+    }
+
+protected:
+    json* collect() override
+    {
+        if (depth() != 1 || keyAt(0) == "input")
+        {
+            return nullptr;
+        }
+        field_ = keyAt(0);
+        if (field_ == "model" || field_ == "encoding_format" || field_ == "dimensions" || field_ == "user" ||
+            field_ == "stream")
+        {
+            return &value_;
+        }
+        return discard();
+    }
+
+    void onString(std::string& value) override
+    {
+        if (depth() == 0)
+        {
+            throw std::runtime_error("Request body must be a JSON object");
+        }
+        if (depth() == 1)
+        {
+            request_.input = std::move(value);
+            has_input_ = true;
+        }
+        else
+        {
+            inputs_.push_back(std::move(value));
+        }
+    }
+
+    void onScalar(json&&) override
+    {
+        if (depth() == 0)
+        {
+            throw std::runtime_error("Request body must be a JSON object");
+        }
+        throw std::runtime_error("Invalid input type: must be string or array of strings");
+    }
+
+    void onStart(bool array) override
+    {
+        if (depth() == 0)
+        {
+            if (array)
+            {
+                throw std::runtime_error("Request body must be a JSON object");
+            }
+            return;
+        }
+        if (depth() > 1 || !array)
+        {
+            throw std::runtime_error("Invalid input type: must be string or array of strings");
+        }
+        inputs_.clear();
+    }
+
+    void onEnd(bool array) override
+    {
+        if (depth() == 1 && array)
+        {
+            request_.input = std::move(inputs_);
+            has_input_ = true;
+        }
+    }
+
+    void onCollected() override
+    {
+        if (field_ == "dimensions")
+        {
+            if (!value_.is_number_integer())
+            {
+                throw std::runtime_error("Field 'dimensions' must be an integer");
+            }
+            request_.dimensions = value_.get<int>();
+            return;
+        }
+        if (field_ == "stream")
+        {
+            if (!value_.is_boolean())
+            {
+                throw std::runtime_error("Field 'stream' must be a boolean");
+            }
+            request_.stream = value_.get<bool>();
+            return;
+        }
+        if (!value_.is_string())
+        {
+            throw std::runtime_error("Field '" + field_ + "' must be a string");
+        }
+        std::string& text = value_.get_ref<std::string&>();
+        if (field_ == "model")
+        {
+            request_.model = std::move(text);
+            has_model_ = true;
+        }
+        else if (field_ == "encoding_format")
+        {
+            request_.encoding_format = std::move(text);
+        }
+        else
+        {
+            request_.user = std::move(text);
+        }
+    }
+
+private:
+    EmbeddingRequest& request_;
+    std::vector<std::string> inputs_;
+    std::string field_;
+    json value_;
+    bool has_model_ = false;
+    bool has_input_ = false;
+};
+
+} // namespace
+
 bool EmbeddingRequest::validate() const
 {
     // Model is required
@@ -44,7 +185,8 @@ bool EmbeddingRequest::validate() const
     }
 
     // Encoding format must be valid if provided
-    if (!encoding_format.empty() && encoding_format != "float" && encoding_format != "base64")
+    if (!encoding_format.empty() && encoding_format != "float" && encoding_format != "base64" &&
+        encoding_format != "float16" && encoding_format != "int8")
     {
         return false;
     }
@@ -88,6 +230,11 @@ nlohmann::json EmbeddingRequest::to_json() const
     {
         j["user"] = user;
     }
+
+    if (stream)
+    {
+        j["stream"] = true;
+    }
     
     return j;
 }
@@ -133,6 +280,25 @@ void EmbeddingRequest::from_json(const nlohmann::json& j)
     {
         user = j["user"];
     }
+
+    if (j.contains("stream"))
+    {
+        stream = j["stream"].get<bool>();
+    }
+}
+
+void EmbeddingRequest::parse(const std::string& body)
+{
+    EmbeddingRequestReader reader(*this);
+    reader.parse(body);
+    reader.finish();
+}
+
+void EmbeddingRequest::parse(std::istream& body)
+{
+    EmbeddingRequestReader reader(*this);
+    reader.parse(body);
+    reader.finish();
 }
 
 std::vector<std::string> EmbeddingRequest::getInputTexts() const
@@ -148,6 +314,17 @@ std::vector<std::string> EmbeddingRequest::getInputTexts() const
     return {};
 }
 
+std::vector<std::string> EmbeddingRequest::takeInputTexts()
+{
+    if (auto* single = std::get_if<std::string>(&input))
+    {
+        std::vector<std::string> texts;
+        texts.push_back(std::move(*single));
+        return texts;
+    }
+    return std::move(std::get<std::vector<std::string>>(input));
+}
+
 bool EmbeddingRequest::hasMultipleInputs() const
 {
     return std::holds_alternative<std::vector<std::string>>(input);
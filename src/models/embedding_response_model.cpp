@@ -1,14 +1,86 @@
 #include "kolosal/models/embedding_response_model.hpp"
+#include "kolosal/vector_math.hpp"
+#include "base64.hpp"
+
+#include <cstdint>
+#include <cstring>
 
 namespace kolosal
 {
 
+namespace
+{
+
+uint32_t floatBits(float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+template <typename T>
+void appendLittleEndian(std::string& out, T value)
+{
+    for (size_t i = 0; i < sizeof(T); ++i)
+        out.push_back(static_cast<char>((value >> (8 * i)) & 0xffu));
+}
+
+// Packs the vector and base64-encodes it, as OpenAI's encoding_format "base64" does for float32.
+// int8 maps [-1, 1] onto [-127, 127], which suits the normalised vectors the route returns.
+std::string encodeEmbedding(const std::vector<float>& embedding, const std::string& format)
+{
+    std::string packed;
+    if (format == "float16")
+    {
+        std::vector<uint16_t> halves(embedding.size());
+        vecmath::toHalf(embedding.data(), embedding.size(), halves.data());
+        packed.reserve(halves.size() * 2);
+        for (uint16_t h : halves)
+            appendLittleEndian(packed, h);
+    }
+    else if (format == "int8")
+    {
+        packed.resize(embedding.size());
+        vecmath::toInt8(embedding.data(), embedding.size(), reinterpret_cast<int8_t*>(&packed[0]));
+    }
+    else
+    {
+        packed.reserve(embedding.size() * 4);
+        for (float v : embedding)
+            appendLittleEndian(packed, floatBits(v));
+    }
+    return base64::encode(packed);
+}
+
+std::vector<float> decodeFloat32(const std::string& encoded)
+{
+    const std::string packed = base64::decode(encoded);
+    std::vector<float> values(packed.size() / 4);
+    for (size_t i = 0; i < values.size(); ++i)
+    {
+        uint32_t bits = 0;
+        for (size_t b = 0; b < 4; ++b)
+            bits |= static_cast<uint32_t>(static_cast<unsigned char>(packed[i * 4 + b])) << (8 * b);
+        std::memcpy(&values[i], &bits, sizeof(bits));
+    }
+    return values;
+}
+
+} // namespace
+
 // EmbeddingData implementations
-nlohmann::json EmbeddingData::to_json() const
+nlohmann::json EmbeddingData::to_json(const std::string& encoding_format) const
 {
     nlohmann::json j;
     j["object"] = object;
-    j["embedding"] = embedding;
+    if (encoding_format.empty() || encoding_format == "float")
+    {
+        j["embedding"] = embedding;
+    }
+    else
+    {
+        j["embedding"] = encodeEmbedding(embedding, encoding_format);
+    }
     j["index"] = index;
     return j;
 }
@@ -19,9 +91,16 @@ void EmbeddingData::from_json(const nlohmann::json& j)
     {
         object = j["object"];
     }
-      if (j.contains("embedding"))
+    if (j.contains("embedding"))
     {
-        embedding = j["embedding"].get<std::vector<float>>();
+        if (j["embedding"].is_string())
+        {
+            embedding = decodeFloat32(j["embedding"].get<std::string>());
+        }
+        else
+        {
+            embedding = j["embedding"].get<std::vector<float>>();
+        }
     }
     
     if (j.contains("index"))
@@ -85,7 +164,7 @@ nlohmann::json EmbeddingResponse::to_json() const
     nlohmann::json data_array = nlohmann::json::array();
     for (const auto& embedding_data : data)
     {
-        data_array.push_back(embedding_data.to_json());
+        data_array.push_back(embedding_data.to_json(encoding_format));
     }
     j["data"] = data_array;
     
@@ -124,12 +203,12 @@ void EmbeddingResponse::from_json(const nlohmann::json& j)
     }
 }
 
-void EmbeddingResponse::addEmbedding(const std::vector<float>& embedding, int index)
+void EmbeddingResponse::addEmbedding(std::vector<float> embedding, int index)
 {
     EmbeddingData embedding_data;
-    embedding_data.embedding = embedding;
+    embedding_data.embedding = std::move(embedding);
     embedding_data.index = index;
-    data.push_back(embedding_data);
+    data.push_back(std::move(embedding_data));
 }
 
 void EmbeddingResponse::setUsage(int prompt_tokens)
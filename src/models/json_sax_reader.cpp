@@ -0,0 +1,229 @@
+#include "kolosal/models/json_sax_reader.hpp"
+#include <cstring>
+#include <stdexcept>
+
+namespace kolosal
+{
+
+void JsonSaxReader::parse(const std::string& text)
+{
+    json::sax_parse(text, this);
+}
+
+void JsonSaxReader::parse(std::istream& in)
+{
+    json::sax_parse(in, this);
+}
+
+bool JsonSaxReader::atPath(std::initializer_list<const char*> path) const
+{
+    if (path.size() != frames_.size())
+    {
+        return false;
+    }
+    size_t level = 0;
+    for (const char* segment : path)
+    {
+        const Frame& frame = frames_[level++];
+        if (frame.array ? std::strcmp(segment, "[]") != 0 : frame.key != segment)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool JsonSaxReader::null()
+{
+    return value(json());
+}
+
+bool JsonSaxReader::boolean(bool val)
+{
+    return value(json(val));
+}
+
+bool JsonSaxReader::number_integer(number_integer_t val)
+{
+    return value(json(val));
+}
+
+bool JsonSaxReader::number_unsigned(number_unsigned_t val)
+{
+    return value(json(val));
+}
+
+bool JsonSaxReader::number_float(number_float_t val, const string_t&)
+{
+    return value(json(val));
+}
+
+bool JsonSaxReader::string(string_t& val)
+{
+    if (!target_ && !(target_ = collect()))
+    {
+        onString(val);
+        return true;
+    }
+    return value(json(std::move(val)));
+}
+
+bool JsonSaxReader::binary(binary_t&)
+{
+    // JSON text has no binary values
+    return value(json());
+}
+
+bool JsonSaxReader::start_object(std::size_t)
+{
+    return beginContainer(false);
+}
+
+bool JsonSaxReader::key(string_t& val)
+{
+    if (target_ == &discarded_)
+    {
+        return true;
+    }
+    if (target_)
+    {
+        buildingKey_ = std::move(val);
+    }
+    else
+    {
+        frames_.back().key = std::move(val);
+    }
+    return true;
+}
+
+bool JsonSaxReader::end_object()
+{
+    return endContainer(false);
+}
+
+bool JsonSaxReader::start_array(std::size_t)
+{
+    return beginContainer(true);
+}
+
+bool JsonSaxReader::end_array()
+{
+    return endContainer(true);
+}
+
+bool JsonSaxReader::parse_error(std::size_t, const std::string&, const nlohmann::detail::exception& ex)
+{
+    if (const auto* error = dynamic_cast<const json::parse_error*>(&ex))
+    {
+        throw *error;
+    }
+    throw std::runtime_error(ex.what());
+}
+
+bool JsonSaxReader::value(json&& v)
+{
+    if (!target_ && !(target_ = collect()))
+    {
+        onScalar(std::move(v));
+        return true;
+    }
+    if (target_ == &discarded_)
+    {
+        if (skipping_ == 0)
+        {
+            finishCollecting();
+        }
+        return true;
+    }
+    if (building_.empty())
+    {
+        *target_ = std::move(v);
+        finishCollecting();
+        return true;
+    }
+    json& parent = *building_.back();
+    if (parent.is_array())
+    {
+        parent.push_back(std::move(v));
+    }
+    else
+    {
+        parent[buildingKey_] = std::move(v);
+    }
+    return true;
+}
+
+bool JsonSaxReader::beginContainer(bool array)
+{
+    if (!target_ && !(target_ = collect()))
+    {
+        onStart(array);
+        frames_.push_back({array, std::string()});
+        return true;
+    }
+    if (target_ == &discarded_)
+    {
+        ++skipping_;
+        return true;
+    }
+
+    // Containers only ever grow at the innermost open one, so the pointers stay valid
+    json container = array ? json::array() : json::object();
+    json* slot = target_;
+    if (!building_.empty())
+    {
+        json& parent = *building_.back();
+        if (parent.is_array())
+        {
+            parent.push_back(std::move(container));
+            slot = &parent.back();
+        }
+        else
+        {
+            slot = &(parent[buildingKey_] = std::move(container));
+        }
+    }
+    else
+    {
+        *slot = std::move(container);
+    }
+    building_.push_back(slot);
+    return true;
+}
+
+bool JsonSaxReader::endContainer(bool array)
+{
+    if (!target_)
+    {
+        frames_.pop_back();
+        onEnd(array);
+        return true;
+    }
+    if (target_ == &discarded_)
+    {
+        if (--skipping_ == 0)
+        {
+            finishCollecting();
+        }
+        return true;
+    }
+    building_.pop_back();
+    if (building_.empty())
+    {
+        finishCollecting();
+    }
+    return true;
+}
+
+void JsonSaxReader::finishCollecting()
+{
+    const bool discarded = target_ == &discarded_;
+    target_ = nullptr;
+    building_.clear();
+    if (!discarded)
+    {
+        onCollected();
+    }
+}
+
+} // namespace kolosal
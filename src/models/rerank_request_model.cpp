@@ -0,0 +1,97 @@
+#include "kolosal/models/rerank_request_model.hpp"
+#include <stdexcept>
+
+namespace kolosal
+{
+
+bool RerankRequest::validate() const
+{
+    // Model, query and at least one document are required
+    if (model.empty() || query.empty() || documents.empty())
+    {
+        return false;
+    }
+
+    // top_n is either "all" (-1) or positive
+    if (top_n != -1 && top_n <= 0)
+    {
+        return false;
+    }
+
+    return true;
+}
+
+nlohmann::json RerankRequest::to_json() const
+{
+    nlohmann::json j;
+
+    j["model"] = model;
+    j["query"] = query;
+    j["documents"] = documents;
+
+    if (top_n != -1)
+    {
+        j["top_n"] = top_n;
+    }
+
+    j["return_documents"] = return_documents;
+
+    return j;
+}
+
+void RerankRequest::from_json(const nlohmann::json& j)
+{
+    if (!j.contains("model") || !j["model"].is_string())
+    {
+        throw std::runtime_error("Missing or invalid required field: model");
+    }
+    model = j["model"];
+
+    if (!j.contains("query") || !j["query"].is_string())
+    {
+        throw std::runtime_error("Missing or invalid required field: query");
+    }
+    query = j["query"];
+
+    if (!j.contains("documents") || !j["documents"].is_array())
+    {
+        throw std::runtime_error("Missing or invalid required field: documents (must be an array)");
+    }
+    documents.clear();
+    documents.reserve(j["documents"].size());
+    for (const auto& document : j["documents"])
+    {
+        if (document.is_string())
+        {
+            documents.push_back(document.get<std::string>());
+        }
+        else if (document.is_object() && document.contains("text") && document["text"].is_string())
+        {
+            documents.push_back(document["text"].get<std::string>());
+        }
+        else
+        {
+            throw std::runtime_error("Invalid document: must be a string or an object with a 'text' string");
+        }
+    }
+
+    if (j.contains("top_n") && !j["top_n"].is_null())
+    {
+        if (!j["top_n"].is_number_integer())
+        {
+            throw std::runtime_error("top_n must be an integer");
+        }
+        top_n = j["top_n"];
+    }
+
+    if (j.contains("return_documents"))
+    {
+        if (!j["return_documents"].is_boolean())
+        {
+            throw std::runtime_error("return_documents must be a boolean");
+        }
+        return_documents = j["return_documents"];
+    }
+}
+
+} // namespace kolosal
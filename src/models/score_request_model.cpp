@@ -0,0 +1,86 @@
+#include "kolosal/models/score_request_model.hpp"
+#include <stdexcept>
+
+namespace kolosal
+{
+
+bool ScoreRequest::validate() const
+{
+    // Model and at least one pair are required
+    if (model.empty() || pairs.empty())
+    {
+        return false;
+    }
+
+    // Every pair has text on both sides
+    for (const auto& pair : pairs)
+    {
+        if (pair.prompt.empty() || pair.continuation.empty())
+        {
+            return false;
+        }
+    }
+
+    // Same bound as OpenAI's top_logprobs
+    if (top_logprobs < 0 || top_logprobs > 20)
+    {
+        return false;
+    }
+
+    return true;
+}
+
+nlohmann::json ScoreRequest::to_json() const
+{
+    nlohmann::json j;
+
+    j["model"] = model;
+    j["pairs"] = nlohmann::json::array();
+    for (const auto& pair : pairs)
+    {
+        j["pairs"].push_back({{"prompt", pair.prompt}, {"continuation", pair.continuation}});
+    }
+
+    if (top_logprobs > 0)
+    {
+        j["top_logprobs"] = top_logprobs;
+    }
+
+    return j;
+}
+
+void ScoreRequest::from_json(const nlohmann::json& j)
+{
+    if (!j.contains("model") || !j["model"].is_string())
+    {
+        throw std::runtime_error("Missing or invalid required field: model");
+    }
+    model = j["model"];
+
+    if (!j.contains("pairs") || !j["pairs"].is_array())
+    {
+        throw std::runtime_error("Missing or invalid required field: pairs (must be an array)");
+    }
+    pairs.clear();
+    pairs.reserve(j["pairs"].size());
+    for (const auto& pair : j["pairs"])
+    {
+        if (!pair.is_object() || !pair.contains("prompt") || !pair["prompt"].is_string()
+            || !pair.contains("continuation") || !pair["continuation"].is_string())
+        {
+            throw std::runtime_error("Invalid pair: must be an object with 'prompt' and 'continuation' strings");
+        }
+        pairs.push_back({pair["prompt"].get<std::string>(), pair["continuation"].get<std::string>()});
+    }
+
+    if (j.contains("top_logprobs") && !j["top_logprobs"].is_null())
+    {
+        if (!j["top_logprobs"].is_number_integer())
+        {
+            throw std::runtime_error("top_logprobs must be an integer");
+        }
+        top_logprobs = j["top_logprobs"];
+    }
+}
+
+} // namespace kolosal
@@ -0,0 +1,197 @@
+#include "kolosal/models/sse_chunk_writer.hpp"
+#include "kolosal/models/chat_response_chunk_model.hpp"
+#include "kolosal/models/completion_response_chunk_model.hpp"
+
+namespace kolosal
+{
+
+namespace
+{
+    // Length of the UTF-8 sequence starting at text[i], or 0 if it is not valid
+    // (overlong forms, surrogates and code points past U+10FFFF included)
+    size_t utf8SequenceLength(std::string_view text, size_t i)
+    {
+        const auto byte = [&](size_t at) { return static_cast<unsigned char>(text[at]); };
+        const unsigned char lead = byte(i);
+        size_t length;
+        unsigned char low = 0x80;
+        unsigned char high = 0xBF;
+        if (lead >= 0xC2 && lead <= 0xDF)
+        {
+            length = 2;
+        }
+        else if (lead >= 0xE0 && lead <= 0xEF)
+        {
+            length = 3;
+            if (lead == 0xE0)
+                low = 0xA0;
+            else if (lead == 0xED)
+                high = 0x9F;
+        }
+        else if (lead >= 0xF0 && lead <= 0xF4)
+        {
+            length = 4;
+            if (lead == 0xF0)
+                low = 0x90;
+            else if (lead == 0xF4)
+                high = 0x8F;
+        }
+        else
+        {
+            return 0;
+        }
+        if (i + length > text.size() || byte(i + 1) < low || byte(i + 1) > high)
+        {
+            return 0;
+        }
+        for (size_t k = 2; k < length; ++k)
+        {
+            if ((byte(i + k) & 0xC0) != 0x80)
+            {
+                return 0;
+            }
+        }
+        return length;
+    }
+}
+
+void appendJsonEscaped(std::string& out, std::string_view text)
+{
+    static const char kHex[] = "0123456789abcdef";
+    size_t i = 0;
+    while (i < text.size())
+    {
+        const unsigned char c = static_cast<unsigned char>(text[i]);
+        if (c >= 0x80)
+        {
+            const size_t length = utf8SequenceLength(text, i);
+            if (length == 0)
+            {
+                out += "\xEF\xBF\xBD";
+                ++i;
+            }
+            else
+            {
+                out.append(text.data() + i, length);
+                i += length;
+            }
+            continue;
+        }
+
+        switch (c)
+        {
+        case '"': out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\b': out += "\\b"; break;
+        case '\f': out += "\\f"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        default:
+            if (c < 0x20)
+            {
+                out += "\\u00";
+                out += kHex[c >> 4];
+                out += kHex[c & 0x0F];
+            }
+            else
+            {
+                out += static_cast<char>(c);
+            }
+        }
+        ++i;
+    }
+}
+
+SseChunkWriter::SseChunkWriter(Format format, const std::string& id, const std::string& model, int64_t created)
+    : format_(format)
+{
+    // Same defaults as the chunk models; keys in the sorted order nlohmann dumps them in
+    std::string object;
+    std::string fingerprint;
+    if (format == Format::ChatCompletion)
+    {
+        ChatCompletionChunk chunk;
+        object = chunk.object;
+        fingerprint = chunk.system_fingerprint;
+    }
+    else
+    {
+        CompletionChunk chunk;
+        object = chunk.object;
+        fingerprint = chunk.system_fingerprint;
+    }
+
+    suffix_ = "],\"created\":" + std::to_string(created) + ",\"id\":\"";
+    appendJsonEscaped(suffix_, id);
+    suffix_ += "\",\"model\":\"";
+    appendJsonEscaped(suffix_, model);
+    suffix_ += "\",\"object\":\"";
+    appendJsonEscaped(suffix_, object);
+    suffix_ += "\",\"system_fingerprint\":\"";
+    appendJsonEscaped(suffix_, fingerprint);
+    suffix_ += "\"}\n\n";
+}
+
+void SseChunkWriter::begin()
+{
+    buffer_.clear();
+    buffer_ += "data: {\"choices\":[{";
+}
+
+const std::string& SseChunkWriter::end()
+{
+    buffer_ += suffix_;
+    return buffer_;
+}
+
+const std::string& SseChunkWriter::text(size_t index, std::string_view text)
+{
+    begin();
+    if (format_ == Format::ChatCompletion)
+    {
+        if (text.empty())
+        {
+            buffer_ += "\"delta\":{}";
+        }
+        else
+        {
+            buffer_ += "\"delta\":{\"content\":\"";
+            appendJsonEscaped(buffer_, text);
+            buffer_ += "\"}";
+        }
+        buffer_ += ",\"finish_reason\":null,\"index\":";
+        buffer_ += std::to_string(index);
+        buffer_ += '}';
+    }
+    else
+    {
+        buffer_ += "\"finish_reason\":null,\"index\":";
+        buffer_ += std::to_string(index);
+        buffer_ += ",\"logprobs\":null,\"text\":\"";
+        appendJsonEscaped(buffer_, text);
+        buffer_ += "\"}";
+    }
+    return end();
+}
+
+const std::string& SseChunkWriter::finish(size_t index, std::string_view reason)
+{
+    begin();
+    if (format_ == Format::ChatCompletion)
+    {
+        buffer_ += "\"delta\":{},";
+    }
+    buffer_ += "\"finish_reason\":\"";
+    appendJsonEscaped(buffer_, reason);
+    buffer_ += "\",\"index\":";
+    buffer_ += std::to_string(index);
+    if (format_ == Format::TextCompletion)
+    {
+        buffer_ += ",\"logprobs\":null,\"text\":\"\"";
+    }
+    buffer_ += '}';
+    return end();
+}
+
+} // namespace kolosal
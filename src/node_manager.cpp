@@ -2,10 +2,17 @@
 #include "kolosal/server_config.hpp"
 #include "kolosal/logger.hpp" // Assuming a logger is available
 #include "kolosal/download_utils.hpp"
+#include "kolosal/download_manager.hpp"
 #include "kolosal/gpu_detection.hpp"
+#include "kolosal/metrics.hpp"
+#include "kolosal/model_catalog.hpp"
+#include "kolosal/tracing.hpp"
+#include "kolosal/response_cache.hpp"
+#include "kolosal/semantic_cache.hpp"
 #include <filesystem>
 #include <mutex>
 #include <algorithm> // For std::max and std::min
+#include <fstream>
 
 #ifdef _WIN32
 #include <winsock2.h>
@@ -14,16 +21,31 @@
 #elif defined(__APPLE__)
 #include <unistd.h>
 #include <limits.h>
+#include <fcntl.h>
+#include <sys/mman.h>
 #include <mach-o/dyld.h>
 #define LIBRARY_EXTENSION ".dylib"
 #else
 #include <unistd.h>
 #include <limits.h>
+#include <fcntl.h>
+#include <sys/mman.h>
 #define LIBRARY_EXTENSION ".so"
 #endif
 
 namespace kolosal
 {
+    // Set on a thread applying a reloaded config; see suspendConfigWrites()
+    static thread_local bool configWritesSuspended = false;
+
+    static double secondsSince(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // Length of one request rate window
+    static constexpr auto rateWindow = std::chrono::seconds(60);
+
     // Helper function to get the directory containing the current executable
     static std::string getExecutableDirectory()
     {
@@ -55,6 +77,104 @@ namespace kolosal
 #endif
     }
 
+    // Free physical memory in bytes, or 0 when the platform does not report it
+    static uint64_t availableSystemMemory()
+    {
+#ifdef _WIN32
+        MEMORYSTATUSEX status;
+        status.dwLength = sizeof(status);
+        if (GlobalMemoryStatusEx(&status))
+            return static_cast<uint64_t>(status.ullAvailPhys);
+        return 0;
+#elif defined(__APPLE__)
+        return 0;
+#else
+        std::ifstream meminfo("/proc/meminfo");
+        std::string key;
+        uint64_t valueKb = 0;
+        std::string unit;
+        while (meminfo >> key >> valueKb >> unit)
+        {
+            if (key == "MemAvailable:")
+                return valueKb * 1024;
+        }
+        return 0;
+#endif
+    }
+
+    // Maps a model file and keeps its pages in RAM: locked where the memlock limit allows, otherwise
+    // read through once so the page cache holds them for as long as the kernel can spare it
+    struct NodeManager::WeightPin
+    {
+        uint64_t bytes = 0;
+        bool locked = false;
+
+        explicit WeightPin(const std::string &path)
+        {
+            std::error_code ec;
+            const uint64_t size = std::filesystem::file_size(path, ec);
+            if (ec || size == 0)
+                return;
+#ifdef _WIN32
+            file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (file_ == INVALID_HANDLE_VALUE)
+                return;
+            mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            addr_ = mapping_ ? MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0) : nullptr;
+            if (!addr_)
+                return;
+            locked = VirtualLock(addr_, static_cast<SIZE_T>(size)) != 0;
+#else
+            const int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0)
+                return;
+            void *addr = ::mmap(nullptr, static_cast<size_t>(size), PROT_READ, MAP_SHARED, fd, 0);
+            ::close(fd);
+            if (addr == MAP_FAILED)
+                return;
+            addr_ = addr;
+            ::madvise(addr_, static_cast<size_t>(size), MADV_WILLNEED);
+            locked = ::mlock(addr_, static_cast<size_t>(size)) == 0;
+#endif
+            bytes = size;
+            if (!locked)
+            {
+                const volatile char *pages = static_cast<const char *>(addr_);
+                for (uint64_t offset = 0; offset < size; offset += 4096)
+                    (void)pages[offset];
+            }
+        }
+
+        ~WeightPin()
+        {
+#ifdef _WIN32
+            if (addr_)
+            {
+                if (locked)
+                    VirtualUnlock(addr_, static_cast<SIZE_T>(bytes));
+                UnmapViewOfFile(addr_);
+            }
+            if (mapping_)
+                CloseHandle(mapping_);
+            if (file_ != INVALID_HANDLE_VALUE)
+                CloseHandle(file_);
+#else
+            if (addr_)
+                ::munmap(addr_, static_cast<size_t>(bytes));
+#endif
+        }
+
+        WeightPin(const WeightPin &) = delete;
+        WeightPin &operator=(const WeightPin &) = delete;
+
+    private:
+        void *addr_ = nullptr;
+#ifdef _WIN32
+        HANDLE file_ = INVALID_HANDLE_VALUE;
+        HANDLE mapping_ = nullptr;
+#endif
+    };
+
 #ifdef __APPLE__
     // Helper function to detect if we're running from a macOS app bundle
     static bool isRunningFromAppBundle()
@@ -85,7 +205,7 @@ namespace kolosal
             
             return false;
         } catch (const std::exception& e) {
-            ServerLogger::logWarning("Failed to detect app bundle structure: %s", e.what());
+            KOLOSAL_LOG_WARNING("Failed to detect app bundle structure: %s", e.what());
             return false;
         }
     }
@@ -96,7 +216,7 @@ namespace kolosal
         std::vector<std::string> searchPaths;
         
         if (isRunningFromAppBundle()) {
-            ServerLogger::logInfo("App bundle detected, prioritizing Frameworks directory");
+            KOLOSAL_LOG_INFO("App bundle detected, prioritizing Frameworks directory");
             // Prioritize app bundle paths
             searchPaths.insert(searchPaths.end(), {
                 execDir + "/../Frameworks/" + libName + std::string(LIBRARY_EXTENSION),
@@ -133,7 +253,7 @@ namespace kolosal
         // Check for Termux environment (Android)
         const char* prefix = std::getenv("PREFIX");
         if (prefix) {
-            ServerLogger::logInfo("Termux environment detected (PREFIX=%s)", prefix);
+            KOLOSAL_LOG_INFO("Termux environment detected (PREFIX=%s)", prefix);
             // Termux-specific paths
             searchPaths.push_back(std::string(prefix) + "/lib/" + libName + std::string(LIBRARY_EXTENSION));
             searchPaths.push_back(std::string(prefix) + "/opt/kolosal-server/lib/" + libName + std::string(LIBRARY_EXTENSION));
@@ -172,7 +292,7 @@ namespace kolosal
     NodeManager::NodeManager(std::chrono::seconds idleTimeout)
         : idleTimeout_(idleTimeout), stopAutoscaling_(false)
     {
-        ServerLogger::logInfo("NodeManager initialized with idle timeout: %lld seconds.", idleTimeout_.count());
+        KOLOSAL_LOG_INFO("NodeManager initialized with idle timeout: %lld seconds.", idleTimeout_.count());
 
         // Initialize the inference loader
         inferenceLoader_ = std::make_unique<InferenceLoader>();
@@ -184,10 +304,10 @@ namespace kolosal
             if (inferenceLoader_->configureEngines(config.inferenceEngines))
             {
                 auto availableEngines = inferenceLoader_->getAvailableEngines();
-                ServerLogger::logInfo("Configured %zu inference engines:", availableEngines.size());
+                KOLOSAL_LOG_INFO("Configured %zu inference engines:", availableEngines.size());
                 for (const auto &engine : availableEngines)
                 {
-                    ServerLogger::logInfo("  - %s: %s (%s)", engine.name.c_str(), engine.description.c_str(), 
+                    KOLOSAL_LOG_INFO("  - %s: %s (%s)", engine.name.c_str(), engine.description.c_str(), 
                                         engine.is_loaded ? "loaded" : "available");
                 }
                 
@@ -198,13 +318,13 @@ namespace kolosal
                     
 #ifdef __APPLE__
                     // On Apple systems, prioritize Metal acceleration
-                    ServerLogger::logInfo("Apple system detected. Looking for Metal-accelerated engine...");
+                    KOLOSAL_LOG_INFO("Apple system detected. Looking for Metal-accelerated engine...");
                     for (const auto &engine : availableEngines)
                     {
                         if (engine.name == "llama-metal")
                         {
                             preferredEngine = engine.name;
-                            ServerLogger::logInfo("Metal acceleration available. Setting default inference engine to: %s", preferredEngine.c_str());
+                            KOLOSAL_LOG_INFO("Metal acceleration available. Setting default inference engine to: %s", preferredEngine.c_str());
                             break;
                         }
                     }
@@ -217,7 +337,7 @@ namespace kolosal
                             if (engine.name == "llama-cpu")
                             {
                                 preferredEngine = engine.name;
-                                ServerLogger::logInfo("Metal acceleration not available. Using CPU-based engine: %s", preferredEngine.c_str());
+                                KOLOSAL_LOG_INFO("Metal acceleration not available. Using CPU-based engine: %s", preferredEngine.c_str());
                                 break;
                             }
                         }
@@ -227,7 +347,7 @@ namespace kolosal
                     if (preferredEngine.empty())
                     {
                         preferredEngine = availableEngines[0].name;
-                        ServerLogger::logInfo("Using first available engine: %s", preferredEngine.c_str());
+                        KOLOSAL_LOG_INFO("Using first available engine: %s", preferredEngine.c_str());
                     }
 #else
                     // On non-Apple systems, check if system has a dedicated GPU for Vulkan acceleration
@@ -241,7 +361,7 @@ namespace kolosal
                             if (engine.name == "llama-vulkan")
                             {
                                 preferredEngine = engine.name;
-                                ServerLogger::logInfo("Dedicated GPU detected. Setting default inference engine to Vulkan-accelerated engine: %s", preferredEngine.c_str());
+                                KOLOSAL_LOG_INFO("Dedicated GPU detected. Setting default inference engine to Vulkan-accelerated engine: %s", preferredEngine.c_str());
                                 break;
                             }
                         }
@@ -250,19 +370,19 @@ namespace kolosal
                         if (preferredEngine.empty())
                         {
                             preferredEngine = availableEngines[0].name;
-                            ServerLogger::logInfo("Dedicated GPU detected, but llama-vulkan engine not available. Using first available engine: %s", preferredEngine.c_str());
+                            KOLOSAL_LOG_INFO("Dedicated GPU detected, but llama-vulkan engine not available. Using first available engine: %s", preferredEngine.c_str());
                         }
                     }
                     else
                     {
                         // No dedicated GPU, use first available engine (likely CPU-based)
                         preferredEngine = availableEngines[0].name;
-                        ServerLogger::logInfo("No dedicated GPU detected. Using CPU-based engine: %s", preferredEngine.c_str());
+                        KOLOSAL_LOG_INFO("No dedicated GPU detected. Using CPU-based engine: %s", preferredEngine.c_str());
                     }
 #endif
                     
                     config.defaultInferenceEngine = preferredEngine;
-                    ServerLogger::logInfo("Set default inference engine to: %s", config.defaultInferenceEngine.c_str());
+                    KOLOSAL_LOG_INFO("Set default inference engine to: %s", config.defaultInferenceEngine.c_str());
                     
                     // Persisting default engine changes to disk is disabled by default on macOS app bundle installs.
                     // Allow opt-in via environment variable KOLOSAL_ALLOW_CONFIG_SAVE=1
@@ -279,38 +399,38 @@ namespace kolosal
                     const char *allowSave = getenv("KOLOSAL_ALLOW_CONFIG_SAVE");
                     if ((allowSave && std::string(allowSave) == "1") || canWritePath())
                     {
-                        ServerLogger::logInfo("Persisting default inference engine to config (KOLOSAL_ALLOW_CONFIG_SAVE=1)");
-                        ServerLogger::logInfo("Current config file path during initialization: '%s'", config.getCurrentConfigFilePath().c_str());
+                        KOLOSAL_LOG_INFO("Persisting default inference engine to config (KOLOSAL_ALLOW_CONFIG_SAVE=1)");
+                        KOLOSAL_LOG_INFO("Current config file path during initialization: '%s'", config.getCurrentConfigFilePath().c_str());
                         if (config.saveToCurrentFile())
                         {
-                            ServerLogger::logInfo("Saved default inference engine configuration to current config file");
+                            KOLOSAL_LOG_INFO("Saved default inference engine configuration to current config file");
                         }
                         else
                         {
-                            ServerLogger::logWarning("Failed to save default inference engine configuration to current config file");
+                            KOLOSAL_LOG_WARNING("Failed to save default inference engine configuration to current config file");
                         }
                     }
                     else
                     {
-                        ServerLogger::logInfo("Skipping config file write (set KOLOSAL_ALLOW_CONFIG_SAVE=1 to force; path not writable)");
+                        KOLOSAL_LOG_INFO("Skipping config file write (set KOLOSAL_ALLOW_CONFIG_SAVE=1 to force; path not writable)");
                     }
                 }
             }
             else
             {
-                ServerLogger::logError("Failed to configure inference engines: %s", inferenceLoader_->getLastError().c_str());
+                KOLOSAL_LOG_ERROR("Failed to configure inference engines: %s", inferenceLoader_->getLastError().c_str());
             }
         }
         else
         {
-            ServerLogger::logWarning("No inference engines configured. Setting up default engines...");
+            KOLOSAL_LOG_WARNING("No inference engines configured. Setting up default engines...");
             
             // Set up default inference engines based on platform
             std::vector<InferenceEngineConfig> defaultEngines;
             
 #ifdef __APPLE__
             // On Apple systems, prioritize Metal acceleration
-            ServerLogger::logInfo("Apple system detected. Adding Metal and CPU inference engines...");
+            KOLOSAL_LOG_INFO("Apple system detected. Adding Metal and CPU inference engines...");
             
             // Try to find libraries in the build directory
             std::filesystem::path buildDir = std::filesystem::current_path();
@@ -320,13 +440,13 @@ namespace kolosal
             if (std::filesystem::exists(metalPath))
             {
                 defaultEngines.emplace_back("llama-metal", metalPath.string(), "Apple Metal GPU acceleration");
-                ServerLogger::logInfo("Added Metal inference engine: %s", metalPath.string().c_str());
+                KOLOSAL_LOG_INFO("Added Metal inference engine: %s", metalPath.string().c_str());
             }
             
             if (std::filesystem::exists(cpuPath))
             {
                 defaultEngines.emplace_back("llama-cpu", cpuPath.string(), "CPU inference engine");
-                ServerLogger::logInfo("Added CPU inference engine: %s", cpuPath.string().c_str());
+                KOLOSAL_LOG_INFO("Added CPU inference engine: %s", cpuPath.string().c_str());
             }
             
             // If no libraries found in build dir, try system paths
@@ -334,7 +454,7 @@ namespace kolosal
             {
                 // Get executable directory for relative path searches
                 std::string execDir = getExecutableDirectory();
-                ServerLogger::logInfo("Searching for inference engines. Executable directory: %s", execDir.c_str());
+                KOLOSAL_LOG_INFO("Searching for inference engines. Executable directory: %s", execDir.c_str());
                 
                 // Use helper function to get app bundle-aware search paths
                 std::vector<std::string> metalPaths = getLibrarySearchPaths(execDir, "libllama-metal");
@@ -343,11 +463,11 @@ namespace kolosal
                 // Check for Metal engine first
                 for (const auto& path : metalPaths)
                 {
-                    ServerLogger::logInfo("Checking for Metal inference engine at: %s", path.c_str());
+                    KOLOSAL_LOG_INFO("Checking for Metal inference engine at: %s", path.c_str());
                     if (std::filesystem::exists(path))
                     {
                         defaultEngines.emplace_back("llama-metal", path, "Apple Metal GPU acceleration");
-                        ServerLogger::logInfo("Found Metal inference engine: %s", path.c_str());
+                        KOLOSAL_LOG_INFO("Found Metal inference engine: %s", path.c_str());
                         break; // Found Metal, stop searching
                     }
                 }
@@ -355,11 +475,11 @@ namespace kolosal
                 // Check for CPU engine
                 for (const auto& path : cpuPaths)
                 {
-                    ServerLogger::logInfo("Checking for CPU inference engine at: %s", path.c_str());
+                    KOLOSAL_LOG_INFO("Checking for CPU inference engine at: %s", path.c_str());
                     if (std::filesystem::exists(path))
                     {
                         defaultEngines.emplace_back("llama-cpu", path, "CPU inference engine");
-                        ServerLogger::logInfo("Found CPU inference engine: %s", path.c_str());
+                        KOLOSAL_LOG_INFO("Found CPU inference engine: %s", path.c_str());
                         break; // Found CPU, stop searching
                     }
                 }
@@ -367,20 +487,20 @@ namespace kolosal
                 // If still no engines found, provide detailed logging
                 if (defaultEngines.empty())
                 {
-                    ServerLogger::logError("No inference engine libraries found in any of the searched paths.");
-                    ServerLogger::logError("Please ensure inference engine libraries are properly installed in:");
-                    ServerLogger::logError("  - App bundle Frameworks directory (../Frameworks/)");
-                    ServerLogger::logError("  - Homebrew locations (/opt/homebrew/lib/ or /usr/local/lib/)");
-                    ServerLogger::logError("  - Application bundle (/Applications/Kolosal CLI.app/Contents/Frameworks/)");
-                    ServerLogger::logError("  - Relative to executable (./lib/ or ../lib/)");
+                    KOLOSAL_LOG_ERROR("No inference engine libraries found in any of the searched paths.");
+                    KOLOSAL_LOG_ERROR("Please ensure inference engine libraries are properly installed in:");
+                    KOLOSAL_LOG_ERROR("  - App bundle Frameworks directory (../Frameworks/)");
+                    KOLOSAL_LOG_ERROR("  - Homebrew locations (/opt/homebrew/lib/ or /usr/local/lib/)");
+                    KOLOSAL_LOG_ERROR("  - Application bundle (/Applications/Kolosal CLI.app/Contents/Frameworks/)");
+                    KOLOSAL_LOG_ERROR("  - Relative to executable (./lib/ or ../lib/)");
                 }
             }
 #else
             // On non-Apple systems (Linux, Android/Termux), use path search
-            ServerLogger::logInfo("Non-Apple system detected. Adding CPU and GPU inference engines...");
+            KOLOSAL_LOG_INFO("Non-Apple system detected. Adding CPU and GPU inference engines...");
             
             std::string execDir = getExecutableDirectory();
-            ServerLogger::logInfo("Searching for inference engines. Executable directory: %s", execDir.c_str());
+            KOLOSAL_LOG_INFO("Searching for inference engines. Executable directory: %s", execDir.c_str());
             
             // Use helper function to get search paths
             std::vector<std::string> cpuPaths = getLibrarySearchPathsLinux(execDir, "libllama-cpu");
@@ -389,11 +509,11 @@ namespace kolosal
             // Check for CPU engine
             for (const auto& path : cpuPaths)
             {
-                ServerLogger::logInfo("Checking for CPU inference engine at: %s", path.c_str());
+                KOLOSAL_LOG_INFO("Checking for CPU inference engine at: %s", path.c_str());
                 if (std::filesystem::exists(path))
                 {
                     defaultEngines.emplace_back("llama-cpu", path, "CPU inference engine");
-                    ServerLogger::logInfo("Found CPU inference engine: %s", path.c_str());
+                    KOLOSAL_LOG_INFO("Found CPU inference engine: %s", path.c_str());
                     break; // Found CPU, stop searching
                 }
             }
@@ -401,11 +521,11 @@ namespace kolosal
             // Check for Vulkan engine
             for (const auto& path : vulkanPaths)
             {
-                ServerLogger::logInfo("Checking for Vulkan inference engine at: %s", path.c_str());
+                KOLOSAL_LOG_INFO("Checking for Vulkan inference engine at: %s", path.c_str());
                 if (std::filesystem::exists(path))
                 {
                     defaultEngines.emplace_back("llama-vulkan", path, "Vulkan GPU acceleration");
-                    ServerLogger::logInfo("Found Vulkan inference engine: %s", path.c_str());
+                    KOLOSAL_LOG_INFO("Found Vulkan inference engine: %s", path.c_str());
                     break; // Found Vulkan, stop searching
                 }
             }
@@ -413,12 +533,12 @@ namespace kolosal
             // If still no engines found, provide detailed logging
             if (defaultEngines.empty())
             {
-                ServerLogger::logError("No inference engine libraries found in any of the searched paths.");
-                ServerLogger::logError("Please ensure inference engine libraries are properly installed.");
-                ServerLogger::logError("Searched paths include:");
+                KOLOSAL_LOG_ERROR("No inference engine libraries found in any of the searched paths.");
+                KOLOSAL_LOG_ERROR("Please ensure inference engine libraries are properly installed.");
+                KOLOSAL_LOG_ERROR("Searched paths include:");
                 for (const auto& path : cpuPaths)
                 {
-                    ServerLogger::logError("  - %s", path.c_str());
+                    KOLOSAL_LOG_ERROR("  - %s", path.c_str());
                 }
             }
 #endif
@@ -432,7 +552,7 @@ namespace kolosal
                 if (inferenceLoader_->configureEngines(config.inferenceEngines))
                 {
                     auto availableEngines = inferenceLoader_->getAvailableEngines();
-                    ServerLogger::logInfo("Configured %zu default inference engines:", availableEngines.size());
+                    KOLOSAL_LOG_INFO("Configured %zu default inference engines:", availableEngines.size());
                     
                     // Set default engine based on platform
                     if (config.defaultInferenceEngine.empty() && !availableEngines.empty())
@@ -474,7 +594,7 @@ namespace kolosal
 #endif
                         
                         config.defaultInferenceEngine = preferredEngine;
-                        ServerLogger::logInfo("Set default inference engine to: %s", config.defaultInferenceEngine.c_str());
+                        KOLOSAL_LOG_INFO("Set default inference engine to: %s", config.defaultInferenceEngine.c_str());
                         
                         // Persisting configuration is opt-in
                         auto canWritePath = [&config]() -> bool {
@@ -487,27 +607,27 @@ namespace kolosal
                         {
                             if (config.saveToCurrentFile())
                             {
-                                ServerLogger::logInfo("Saved default configuration to file");
+                                KOLOSAL_LOG_INFO("Saved default configuration to file");
                             }
                         }
                     }
                 }
                 else
                 {
-                    ServerLogger::logError("Failed to configure default inference engines: %s", inferenceLoader_->getLastError().c_str());
+                    KOLOSAL_LOG_ERROR("Failed to configure default inference engines: %s", inferenceLoader_->getLastError().c_str());
                 }
             }
             else
             {
-                ServerLogger::logError("No inference engine libraries found. Please build inference engines or check installation.");
-                ServerLogger::logError("To resolve this issue:");
-                ServerLogger::logError("1. Ensure that inference engines are built and installed properly");
-                ServerLogger::logError("2. Check that libraries are in one of the expected locations:");
-                ServerLogger::logError("   - /opt/homebrew/lib/ (Homebrew installation)");
-                ServerLogger::logError("   - /usr/local/lib/ (standard installation)");
-                ServerLogger::logError("   - Relative to executable: bin/../lib/");
-                ServerLogger::logError("3. Verify that the Metal/CPU inference libraries exist (.dylib files)");
-                ServerLogger::logError("4. Consider configuring engines manually in the configuration file");
+                KOLOSAL_LOG_ERROR("No inference engine libraries found. Please build inference engines or check installation.");
+                KOLOSAL_LOG_ERROR("To resolve this issue:");
+                KOLOSAL_LOG_ERROR("1. Ensure that inference engines are built and installed properly");
+                KOLOSAL_LOG_ERROR("2. Check that libraries are in one of the expected locations:");
+                KOLOSAL_LOG_ERROR("   - /opt/homebrew/lib/ (Homebrew installation)");
+                KOLOSAL_LOG_ERROR("   - /usr/local/lib/ (standard installation)");
+                KOLOSAL_LOG_ERROR("   - Relative to executable: bin/../lib/");
+                KOLOSAL_LOG_ERROR("3. Verify that the Metal/CPU inference libraries exist (.dylib files)");
+                KOLOSAL_LOG_ERROR("4. Consider configuring engines manually in the configuration file");
             }
         }
 
@@ -516,7 +636,7 @@ namespace kolosal
 
     NodeManager::~NodeManager()
     {
-        ServerLogger::logInfo("NodeManager shutting down.");
+        KOLOSAL_LOG_INFO("NodeManager shutting down.");
         stopAutoscaling_.store(true);
 
         // Wake up autoscaling thread
@@ -529,7 +649,11 @@ namespace kolosal
         {
             autoscalingThread_.join();
         }
-        ServerLogger::logInfo("Autoscaling thread stopped.");
+        if (preloadThread_.joinable())
+        {
+            preloadThread_.join();
+        }
+        KOLOSAL_LOG_INFO("Autoscaling thread stopped.");
 
         // Get exclusive access to engines map
         std::unique_lock<std::shared_mutex> mapLock(engineMapMutex_);
@@ -541,22 +665,24 @@ namespace kolosal
             {
                 recordPtr->markedForRemoval.store(true);
                 std::lock_guard<std::mutex> engineLock(recordPtr->engineMutex);
+                publishServing(*recordPtr);
 
                 if (recordPtr->isLoaded.load() && recordPtr->engine)
                 {
-                    ServerLogger::logInfo("Unloading engine ID \'%s\' during shutdown.", id.c_str());
+                    KOLOSAL_LOG_INFO("Unloading engine ID \'%s\' during shutdown.", id.c_str());
                     try
                     {
+                        unloadReplicas(id, *recordPtr);
                         recordPtr->engine->unloadModel();
-                        ServerLogger::logInfo("Successfully unloaded engine ID \'%s\'.", id.c_str());
+                        KOLOSAL_LOG_INFO("Successfully unloaded engine ID \'%s\'.", id.c_str());
                     }
                     catch (const std::exception &e)
                     {
-                        ServerLogger::logError("Exception while unloading engine ID \'%s\': %s", id.c_str(), e.what());
+                        KOLOSAL_LOG_ERROR("Exception while unloading engine ID \'%s\': %s", id.c_str(), e.what());
                     }
                     catch (...)
                     {
-                        ServerLogger::logError("Unknown exception while unloading engine ID \'%s\'", id.c_str());
+                        KOLOSAL_LOG_ERROR("Unknown exception while unloading engine ID \'%s\'", id.c_str());
                     }
                 }
 
@@ -565,7 +691,8 @@ namespace kolosal
             }
         }
         engines_.clear();
-        ServerLogger::logInfo("All engines unloaded and NodeManager shut down complete.");
+        publishEnginesLocked();
+        KOLOSAL_LOG_INFO("All engines unloaded and NodeManager shut down complete.");
     }
 
     bool NodeManager::addEngine(const std::string &engineId, const char *modelPath, const LoadingParameters &loadParams, int mainGpuId, const std::string &engineType)
@@ -575,16 +702,16 @@ namespace kolosal
             std::shared_lock<std::shared_mutex> mapLock(engineMapMutex_);
             if (engines_.count(engineId))
             {
-                ServerLogger::logWarning("Engine with ID \'%s\' already exists.", engineId.c_str());
+                KOLOSAL_LOG_WARNING("Engine with ID \'%s\' already exists.", engineId.c_str());
                 return false;
             }
         }
 
         // Validate model file outside of any locks
-        ServerLogger::logInfo("Validating model file for engine \'%s\': %s", engineId.c_str(), modelPath);
+        KOLOSAL_LOG_INFO("Validating model file for engine \'%s\': %s", engineId.c_str(), modelPath);
         if (!validateModelFile(modelPath))
         {
-            ServerLogger::logError("Model validation failed for engine \'%s\'. Skipping engine creation.", engineId.c_str());
+            KOLOSAL_LOG_ERROR("Model validation failed for engine \'%s\'. Skipping engine creation.", engineId.c_str());
             return false;
         }
 
@@ -600,7 +727,7 @@ namespace kolosal
         }
 
         // Create engine instance using dynamic loader with safety handlers
-        ServerLogger::logInfo("Creating %s inference engine for ID '%s'", engineType.c_str(), engineId.c_str());
+        KOLOSAL_LOG_INFO("Creating %s inference engine for ID '%s'", engineType.c_str(), engineId.c_str());
 
         std::shared_ptr<IInferenceEngine> enginePtr;
 
@@ -609,47 +736,48 @@ namespace kolosal
             // Load the inference engine plugin if not already loaded
             if (!inferenceLoader_->isEngineLoaded(engineType))
             {
-                ServerLogger::logInfo("Loading %s inference engine plugin...", engineType.c_str());
+                KOLOSAL_LOG_INFO("Loading %s inference engine plugin...", engineType.c_str());
                 if (!inferenceLoader_->loadEngine(engineType))
                 {
-                    ServerLogger::logError("Failed to load %s inference engine: %s",
+                    KOLOSAL_LOG_ERROR("Failed to load %s inference engine: %s",
                                            engineType.c_str(), inferenceLoader_->getLastError().c_str());
                     return false;
                 }
-                ServerLogger::logInfo("Successfully loaded %s inference engine plugin", engineType.c_str());
+                KOLOSAL_LOG_INFO("Successfully loaded %s inference engine plugin", engineType.c_str());
             }
 
             // Create engine instance from the loaded plugin
-            ServerLogger::logInfo("Creating inference engine instance...");
+            KOLOSAL_LOG_INFO("Creating inference engine instance...");
             auto engineInstance = inferenceLoader_->createEngineInstance(engineType);
             if (!engineInstance)
             {
-                ServerLogger::logError("Failed to create %s inference engine instance: %s",
+                KOLOSAL_LOG_ERROR("Failed to create %s inference engine instance: %s",
                                        engineType.c_str(), inferenceLoader_->getLastError().c_str());
                 return false;
             }
 
             // Load the model with safety handling
-            ServerLogger::logInfo("Loading model for engine '%s' from path: %s", engineId.c_str(), actualModelPath.c_str());
+            KOLOSAL_LOG_INFO("Loading model for engine '%s' from path: %s", engineId.c_str(), actualModelPath.c_str());
             bool loadSuccess = false;
+            const auto loadStart = std::chrono::steady_clock::now();
             try
             {
-                loadSuccess = engineInstance->loadModel(actualModelPath.c_str(), loadParams, mainGpuId);
+                loadSuccess = engineInstance->loadModel(actualModelPath.c_str(), replicaLoadParams(loadParams, engineType), replicaGpuId(mainGpuId, engineType, 0));
             }
             catch (const std::exception &e)
             {
-                ServerLogger::logError("Exception during model loading for engine '%s': %s", engineId.c_str(), e.what());
+                KOLOSAL_LOG_ERROR("Exception during model loading for engine '%s': %s", engineId.c_str(), e.what());
                 loadSuccess = false;
             }
             catch (...)
             {
-                ServerLogger::logError("Unknown exception during model loading for engine '%s'", engineId.c_str());
+                KOLOSAL_LOG_ERROR("Unknown exception during model loading for engine '%s'", engineId.c_str());
                 loadSuccess = false;
             }
 
             if (!loadSuccess)
             {
-                ServerLogger::logError("Failed to load model for engine ID '%s' from path '%s'", engineId.c_str(), actualModelPath.c_str());
+                KOLOSAL_LOG_ERROR("Failed to load model for engine ID '%s' from path '%s'", engineId.c_str(), actualModelPath.c_str());
                 // Ensure engine is properly cleaned up
                 try
                 {
@@ -660,47 +788,51 @@ namespace kolosal
                 }
                 catch (...)
                 {
-                    ServerLogger::logWarning("Exception during cleanup after failed model load for engine '%s'", engineId.c_str());
+                    KOLOSAL_LOG_WARNING("Exception during cleanup after failed model load for engine '%s'", engineId.c_str());
                 }
                 return false;
             }
 
+            Metrics::instance().observeModelLoad(engineId, secondsSince(loadStart));
             enginePtr = std::shared_ptr<IInferenceEngine>(engineInstance.release());
-            ServerLogger::logInfo("Successfully loaded model for engine '%s'", engineId.c_str());
+            KOLOSAL_LOG_INFO("Successfully loaded model for engine '%s'", engineId.c_str());
         }
         catch (const std::exception &e)
         {
-            ServerLogger::logError("Exception during engine creation for '%s': %s", engineId.c_str(), e.what());
+            KOLOSAL_LOG_ERROR("Exception during engine creation for '%s': %s", engineId.c_str(), e.what());
             return false;
         }
         catch (...)
         {
-            ServerLogger::logError("Unknown exception during engine creation for '%s'", engineId.c_str());
+            KOLOSAL_LOG_ERROR("Unknown exception during engine creation for '%s'", engineId.c_str());
             return false;
         }
 
         // Create record and add to map (exclusive lock only for map modification)
         auto recordPtr = std::make_shared<EngineRecord>();
         recordPtr->engine = enginePtr;
+        recordPtr->replicas = loadReplicas(engineId, actualModelPath, engineType, loadParams, mainGpuId, ModelType::LLM);
         recordPtr->modelPath = actualModelPath;
         recordPtr->engineType = engineType;
         recordPtr->loadParams = loadParams;
         recordPtr->mainGpuId = mainGpuId;
         recordPtr->isLoaded.store(true);
-        recordPtr->lastActivityTime = std::chrono::steady_clock::now();
+        recordPtr->touch(std::chrono::steady_clock::now());
+        publishServing(*recordPtr);
 
         {
             std::unique_lock<std::shared_mutex> mapLock(engineMapMutex_);
             // Double-check pattern to ensure no race condition
             if (engines_.count(engineId))
             {
-                ServerLogger::logWarning("Engine with ID \'%s\' was added by another thread.", engineId.c_str());
+                KOLOSAL_LOG_WARNING("Engine with ID \'%s\' was added by another thread.", engineId.c_str());
                 return false;
             }
             engines_[engineId] = recordPtr;
+            publishEnginesLocked();
         }
 
-        ServerLogger::logInfo("Successfully added and loaded engine with ID \'%s\'. Model: %s", engineId.c_str(), actualModelPath.c_str());
+        KOLOSAL_LOG_INFO("Successfully added and loaded engine with ID \'%s\'. Model: %s", engineId.c_str(), actualModelPath.c_str());
 
         // Save model to configuration file
         saveModelToConfig(engineId, modelPath, loadParams, mainGpuId, engineType, true);
@@ -721,7 +853,7 @@ namespace kolosal
         std::string engineType = !config.defaultInferenceEngine.empty() ? 
                                  config.defaultInferenceEngine : getPlatformDefaultInferenceEngine();
         
-        ServerLogger::logInfo("Using inference engine '%s' for model '%s' (platform default)", 
+        KOLOSAL_LOG_INFO("Using inference engine '%s' for model '%s' (platform default)", 
                             engineType.c_str(), engineId.c_str());
         
         // Call the main addEngine method with the determined engine type
@@ -730,21 +862,33 @@ namespace kolosal
 
     bool NodeManager::addEmbeddingEngine(const std::string &engineId, const char *modelPath, const LoadingParameters &loadParams, int mainGpuId)
     {
+        return addEncoderEngine(engineId, modelPath, loadParams, mainGpuId, ModelType::EMBEDDING);
+    }
+
+    bool NodeManager::addRerankEngine(const std::string &engineId, const char *modelPath, const LoadingParameters &loadParams, int mainGpuId)
+    {
+        return addEncoderEngine(engineId, modelPath, loadParams, mainGpuId, ModelType::RERANK);
+    }
+
+    bool NodeManager::addEncoderEngine(const std::string &engineId, const char *modelPath, const LoadingParameters &loadParams, int mainGpuId, ModelType type)
+    {
+        const char *kind = modelTypeName(type);
+
         // First check if engine already exists (read lock)
         {
             std::shared_lock<std::shared_mutex> mapLock(engineMapMutex_);
             if (engines_.count(engineId))
             {
-                ServerLogger::logWarning("Embedding engine with ID \'%s\' already exists.", engineId.c_str());
+                KOLOSAL_LOG_WARNING("Engine with ID \'%s\' already exists.", engineId.c_str());
                 return false;
             }
         }
 
         // Validate model file outside of any locks
-        ServerLogger::logInfo("Validating embedding model file for engine \'%s\': %s", engineId.c_str(), modelPath);
+        KOLOSAL_LOG_INFO("Validating %s model file for engine \'%s\': %s", kind, engineId.c_str(), modelPath);
         if (!validateModelFile(modelPath))
         {
-            ServerLogger::logError("Embedding model validation failed for engine \'%s\'. Skipping engine creation.", engineId.c_str());
+            KOLOSAL_LOG_ERROR("Model validation failed for engine \'%s\'. Skipping engine creation.", engineId.c_str());
             return false;
         }
 
@@ -759,12 +903,12 @@ namespace kolosal
             }
         }
 
-        // Use the default inference engine for embedding models if available
+        // Use the default inference engine for embedding and rerank models if available
         auto& config = ServerConfig::getInstance();
         std::string engineType = !config.defaultInferenceEngine.empty() ? 
                                  config.defaultInferenceEngine : getPlatformDefaultInferenceEngine();
-        ServerLogger::logInfo("Using inference engine '%s' for embedding model '%s'", 
-                            engineType.c_str(), engineId.c_str());
+        KOLOSAL_LOG_INFO("Using inference engine '%s' for %s model '%s'", 
+                            engineType.c_str(), kind, engineId.c_str());
         std::shared_ptr<IInferenceEngine> enginePtr;
 
         try
@@ -772,48 +916,48 @@ namespace kolosal
             // Load the inference engine plugin if not already loaded
             if (!inferenceLoader_->isEngineLoaded(engineType))
             {
-                ServerLogger::logInfo("Loading %s inference engine plugin for embedding...", engineType.c_str());
+                KOLOSAL_LOG_INFO("Loading %s inference engine plugin for %s...", engineType.c_str(), kind);
                 if (!inferenceLoader_->loadEngine(engineType))
                 {
-                    ServerLogger::logError("Failed to load %s inference engine for embedding: %s",
-                                           engineType.c_str(), inferenceLoader_->getLastError().c_str());
+                    KOLOSAL_LOG_ERROR("Failed to load %s inference engine for %s: %s",
+                                           engineType.c_str(), kind, inferenceLoader_->getLastError().c_str());
                     return false;
                 }
-                ServerLogger::logInfo("Successfully loaded %s inference engine plugin for embedding", engineType.c_str());
+                KOLOSAL_LOG_INFO("Successfully loaded %s inference engine plugin for %s", engineType.c_str(), kind);
             }
 
             // Create engine instance from the loaded plugin
-            ServerLogger::logInfo("Creating inference engine instance for embedding...");
+            KOLOSAL_LOG_INFO("Creating inference engine instance for %s...", kind);
             auto engineInstance = inferenceLoader_->createEngineInstance(engineType);
             if (!engineInstance)
             {
-                ServerLogger::logError("Failed to create %s inference engine instance for embedding: %s",
-                                       engineType.c_str(), inferenceLoader_->getLastError().c_str());
+                KOLOSAL_LOG_ERROR("Failed to create %s inference engine instance for %s: %s",
+                                       engineType.c_str(), kind, inferenceLoader_->getLastError().c_str());
                 return false;
             }
 
-            // Load the embedding model with safety handling
-            ServerLogger::logInfo("Loading embedding model for engine '%s' from path: %s", engineId.c_str(), actualModelPath.c_str());
+            // Load the model with safety handling
+            KOLOSAL_LOG_INFO("Loading %s model for engine '%s' from path: %s", kind, engineId.c_str(), actualModelPath.c_str());
             bool loadSuccess = false;
+            const auto loadStart = std::chrono::steady_clock::now();
             try
             {
-                // For embedding models, use the specialized loadEmbeddingModel method
-                loadSuccess = engineInstance->loadEmbeddingModel(actualModelPath.c_str(), loadParams, mainGpuId);
+                loadSuccess = loadModelOfType(*engineInstance, type, actualModelPath, replicaLoadParams(loadParams, engineType), replicaGpuId(mainGpuId, engineType, 0));
             }
             catch (const std::exception &e)
             {
-                ServerLogger::logError("Exception during embedding model loading for engine '%s': %s", engineId.c_str(), e.what());
+                KOLOSAL_LOG_ERROR("Exception during %s model loading for engine '%s': %s", kind, engineId.c_str(), e.what());
                 loadSuccess = false;
             }
             catch (...)
             {
-                ServerLogger::logError("Unknown exception during embedding model loading for engine '%s'", engineId.c_str());
+                KOLOSAL_LOG_ERROR("Unknown exception during %s model loading for engine '%s'", kind, engineId.c_str());
                 loadSuccess = false;
             }
 
             if (!loadSuccess)
             {
-                ServerLogger::logError("Failed to load embedding model for engine ID '%s' from path '%s'", engineId.c_str(), actualModelPath.c_str());
+                KOLOSAL_LOG_ERROR("Failed to load %s model for engine ID '%s' from path '%s'", kind, engineId.c_str(), actualModelPath.c_str());
                 // Ensure engine is properly cleaned up
                 try
                 {
@@ -824,48 +968,53 @@ namespace kolosal
                 }
                 catch (...)
                 {
-                    ServerLogger::logWarning("Exception during cleanup after failed embedding model load for engine '%s'", engineId.c_str());
+                    KOLOSAL_LOG_WARNING("Exception during cleanup after failed %s model load for engine '%s'", kind, engineId.c_str());
                 }
                 return false;
             }
 
+            Metrics::instance().observeModelLoad(engineId, secondsSince(loadStart));
             enginePtr = std::shared_ptr<IInferenceEngine>(engineInstance.release());
-            ServerLogger::logInfo("Successfully loaded embedding model for engine '%s'", engineId.c_str());
+            KOLOSAL_LOG_INFO("Successfully loaded %s model for engine '%s'", kind, engineId.c_str());
         }
         catch (const std::exception &e)
         {
-            ServerLogger::logError("Exception during embedding engine creation for '%s': %s", engineId.c_str(), e.what());
+            KOLOSAL_LOG_ERROR("Exception during %s engine creation for '%s': %s", kind, engineId.c_str(), e.what());
             return false;
         }
         catch (...)
         {
-            ServerLogger::logError("Unknown exception during embedding engine creation for '%s'", engineId.c_str());
+            KOLOSAL_LOG_ERROR("Unknown exception during %s engine creation for '%s'", kind, engineId.c_str());
             return false;
         }
 
         // Create record and add to map (exclusive lock only for map modification)
         auto recordPtr = std::make_shared<EngineRecord>();
         recordPtr->engine = enginePtr;
+        recordPtr->replicas = loadReplicas(engineId, actualModelPath, engineType, loadParams, mainGpuId, type);
         recordPtr->modelPath = actualModelPath;
         recordPtr->engineType = engineType;
         recordPtr->loadParams = loadParams;
         recordPtr->mainGpuId = mainGpuId;
         recordPtr->isLoaded.store(true);
-        recordPtr->isEmbeddingModel.store(true); // Mark as embedding model
-        recordPtr->lastActivityTime = std::chrono::steady_clock::now();
+        recordPtr->isEmbeddingModel.store(true); // Runs on the embedding service
+        recordPtr->isRerankModel.store(type == ModelType::RERANK);
+        recordPtr->touch(std::chrono::steady_clock::now());
+        publishServing(*recordPtr);
 
         {
             std::unique_lock<std::shared_mutex> mapLock(engineMapMutex_);
             // Double-check pattern to ensure no race condition
             if (engines_.count(engineId))
             {
-                ServerLogger::logWarning("Embedding engine with ID \'%s\' was added by another thread.", engineId.c_str());
+                KOLOSAL_LOG_WARNING("Engine with ID \'%s\' was added by another thread.", engineId.c_str());
                 return false;
             }
             engines_[engineId] = recordPtr;
+            publishEnginesLocked();
         }
 
-        ServerLogger::logInfo("Successfully added and loaded embedding engine with ID \'%s\'. Model: %s", engineId.c_str(), actualModelPath.c_str());
+        KOLOSAL_LOG_INFO("Successfully added and loaded %s engine with ID \'%s\'. Model: %s", kind, engineId.c_str(), actualModelPath.c_str());
         
         // Notify autoscaling thread about new engine
         {
@@ -876,41 +1025,480 @@ namespace kolosal
         return true;
     }
 
-    std::shared_ptr<IInferenceEngine> NodeManager::getEngine(const std::string &engineId)
+    const char *NodeManager::modelTypeName(ModelType type)
+    {
+        switch (type)
+        {
+        case ModelType::EMBEDDING: return "embedding";
+        case ModelType::RERANK:    return "rerank";
+        default:                   return "LLM";
+        }
+    }
+
+    bool NodeManager::loadModelOfType(IInferenceEngine &engine, ModelType type, const std::string &modelPath,
+                                      const LoadingParameters &loadParams, int mainGpuId)
+    {
+        switch (type)
+        {
+        case ModelType::EMBEDDING: return engine.loadEmbeddingModel(modelPath.c_str(), loadParams, mainGpuId);
+        case ModelType::RERANK:    return engine.loadRerankModel(modelPath.c_str(), loadParams, mainGpuId);
+        default:                   return engine.loadModel(modelPath.c_str(), loadParams, mainGpuId);
+        }
+    }
+
+    LoadingParameters NodeManager::replicaLoadParams(const LoadingParameters &loadParams, const std::string &engineType)
+    {
+        LoadingParameters params = loadParams;
+        // With several GPU replicas each one owns a device instead of splitting layers across all of them
+        if (loadParams.n_replicas > 1 && engineType.find("cpu") == std::string::npos)
+        {
+            params.split_mode = 0;
+            params.tensor_split.clear();
+        }
+        return params;
+    }
+
+    int NodeManager::replicaGpuId(int mainGpuId, const std::string &engineType, int index)
+    {
+        if (engineType.find("cpu") != std::string::npos)
+            return mainGpuId;
+        // main_gpu_id -1 places the model, then each replica, on the GPUs with the most free memory
+        if (mainGpuId < 0)
+        {
+            const auto byFreeMemory = GpuTelemetry::instance().devicesByFreeMemory();
+            if (!byFreeMemory.empty())
+                return byFreeMemory[static_cast<size_t>(index) % byFreeMemory.size()];
+            if (index == 0)
+                return mainGpuId;
+        }
+        return std::max(mainGpuId, 0) + index;
+    }
+
+    std::vector<std::shared_ptr<IInferenceEngine>> NodeManager::loadReplicas(const std::string &engineId, const std::string &modelPath,
+                                                                             const std::string &engineType, const LoadingParameters &loadParams,
+                                                                             int mainGpuId, ModelType type)
+    {
+        std::vector<std::shared_ptr<IInferenceEngine>> replicas;
+        for (int index = 1; index < loadParams.n_replicas; ++index)
+        {
+            const int gpuId = replicaGpuId(mainGpuId, engineType, index);
+            KOLOSAL_LOG_INFO("Loading replica %d of engine '%s' (GPU %d)", index, engineId.c_str(), gpuId);
+            try
+            {
+                auto instance = inferenceLoader_->createEngineInstance(engineType);
+                if (!instance)
+                {
+                    KOLOSAL_LOG_WARNING("Failed to create replica %d of engine '%s': %s", index, engineId.c_str(),
+                                             inferenceLoader_->getLastError().c_str());
+                    continue;
+                }
+                const LoadingParameters params = replicaLoadParams(loadParams, engineType);
+                const bool loaded = loadModelOfType(*instance, type, modelPath, params, gpuId);
+                if (!loaded)
+                {
+                    KOLOSAL_LOG_WARNING("Failed to load replica %d of engine '%s', continuing with fewer replicas", index, engineId.c_str());
+                    instance->unloadModel();
+                    continue;
+                }
+                replicas.emplace_back(instance.release());
+            }
+            catch (const std::exception &e)
+            {
+                KOLOSAL_LOG_WARNING("Exception while loading replica %d of engine '%s': %s", index, engineId.c_str(), e.what());
+            }
+        }
+        return replicas;
+    }
+
+    void NodeManager::unloadReplicas(const std::string &engineId, EngineRecord &record)
+    {
+        for (auto &replica : record.replicas)
+        {
+            try
+            {
+                replica->unloadModel();
+            }
+            catch (const std::exception &e)
+            {
+                KOLOSAL_LOG_ERROR("Exception while unloading a replica of engine ID '%s': %s", engineId.c_str(), e.what());
+            }
+        }
+        record.replicas.clear();
+    }
+
+    void NodeManager::publishServing(EngineRecord &record)
+    {
+        std::shared_ptr<const ServingSet> serving;
+        if (record.isLoaded.load() && record.engine && !record.markedForRemoval.load())
+        {
+            std::vector<std::shared_ptr<IInferenceEngine>> engines;
+            engines.reserve(record.replicas.size() + 1);
+            engines.push_back(record.engine);
+            engines.insert(engines.end(), record.replicas.begin(), record.replicas.end());
+            serving = std::make_shared<const ServingSet>(std::move(engines), record.loadParams);
+        }
+        std::atomic_store(&record.serving, std::move(serving));
+    }
+
+    bool NodeManager::withdrawServing(EngineRecord &record, std::chrono::steady_clock::time_point quietSince)
+    {
+        // A request touches the record before it reads the serving set, and we clear the set before
+        // reading the activity time; so either that request finds no set and waits on engineMutex
+        // for the unload, or we see its activity here
+        std::atomic_store(&record.serving, std::shared_ptr<const ServingSet>());
+        if (record.lastActivity() <= quietSince)
+            return true;
+        publishServing(record);
+        return false;
+    }
+
+    void NodeManager::publishEnginesLocked()
+    {
+        std::atomic_store(&publishedEngines_, std::shared_ptr<const EngineMap>(std::make_shared<const EngineMap>(engines_)));
+    }
+
+    std::shared_ptr<NodeManager::EngineRecord> NodeManager::findEngine(const std::string &engineId) const
+    {
+        const auto engines = std::atomic_load(&publishedEngines_);
+        auto it = engines->find(engineId);
+        return it == engines->end() ? nullptr : it->second;
+    }
+
+    std::shared_ptr<IInferenceEngine> NodeManager::pickReplica(EngineRecord &record, const ServingSet &serving, Admission *admission)
+    {
+        const LoadingParameters &limits = serving.limits;
+        const bool sloControlled = limits.slo_ttft_ms > 0.0f || limits.slo_tpot_ms > 0.0f;
+        const bool limited = admission && (limits.max_queued_jobs > 0 || limits.max_queued_tokens > 0 || sloControlled);
+        const size_t count = serving.engines.size();
+        if (count == 1 && !limited)
+            return serving.engines.front();
+
+        size_t best = 0;
+        bool bestFull = true;
+        EngineLoad bestLoad;
+        for (size_t i = 0; i < count; ++i)
+        {
+            const EngineLoad load = serving.engines[i]->getLoad();
+            const bool full = load.active_jobs >= std::max(1, limits.n_parallel);
+            if (i == 0 || (!full && bestFull) ||
+                (full == bestFull && (load.pending_tokens < bestLoad.pending_tokens ||
+                                      (load.pending_tokens == bestLoad.pending_tokens && load.active_jobs < bestLoad.active_jobs))))
+            {
+                best = i;
+                bestFull = full;
+                bestLoad = load;
+            }
+        }
+
+        if (limited)
+        {
+            // The least loaded replica decides: if it is over a limit, all of them are
+            const int queued = bestLoad.active_jobs - std::max(1, limits.n_parallel);
+            if ((limits.max_queued_jobs > 0 && queued >= limits.max_queued_jobs) ||
+                (limits.max_queued_tokens > 0 && bestLoad.pending_tokens >= limits.max_queued_tokens) ||
+                (bestLoad.admit_jobs > 0 && bestLoad.active_jobs >= bestLoad.admit_jobs))
+            {
+                ++record.rejectedRequests;
+                admission->rejected = true;
+                admission->retryAfterSeconds = 1;
+                return nullptr;
+            }
+        }
+
+        if (count > 1)
+            serving.routed[best].fetch_add(1, std::memory_order_relaxed);
+        return serving.engines[best];
+    }
+
+    std::vector<NodeManager::ReplicaStats> NodeManager::getReplicaStats() const
+    {
+        std::vector<std::pair<std::string, std::shared_ptr<EngineRecord>>> snapshot;
+        {
+            std::shared_lock<std::shared_mutex> mapLock(engineMapMutex_);
+            for (const auto &[id, recordPtr] : engines_)
+            {
+                if (recordPtr && !recordPtr->markedForRemoval.load())
+                    snapshot.emplace_back(id, recordPtr);
+            }
+        }
+
+        std::vector<ReplicaStats> stats;
+        for (const auto &[id, recordPtr] : snapshot)
+        {
+            std::lock_guard<std::mutex> engineLock(recordPtr->engineMutex);
+            if (!recordPtr->isLoaded.load() || !recordPtr->engine)
+                continue;
+            const auto serving = std::atomic_load(&recordPtr->serving);
+            for (size_t i = 0; i <= recordPtr->replicas.size(); ++i)
+            {
+                ReplicaStats entry;
+                entry.engineId = id;
+                entry.index = static_cast<int>(i);
+                entry.mainGpuId = replicaGpuId(recordPtr->mainGpuId, recordPtr->engineType, entry.index);
+                const auto &engine = i == 0 ? recordPtr->engine : recordPtr->replicas[i - 1];
+                entry.load = engine->getLoad();
+                entry.decode = engine->getDecodeStats();
+                entry.liveJobs = engine->liveJobCount();
+                entry.kvCache = engine->getKvCacheStats();
+                entry.routedRequests = serving && i < serving->routed.size() ? serving->routed[i].load(std::memory_order_relaxed) : 0;
+                stats.push_back(std::move(entry));
+            }
+        }
+        return stats;
+    }
+
+    std::vector<std::vector<DecodeStepSample>> NodeManager::getStepProfiles(const std::string &engineId) const
     {
-        // First, get shared access to find the engine record
         std::shared_ptr<EngineRecord> recordPtr;
         {
             std::shared_lock<std::shared_mutex> mapLock(engineMapMutex_);
             auto it = engines_.find(engineId);
-            if (it == engines_.end())
+            if (it == engines_.end() || !it->second || it->second->markedForRemoval.load())
+                return {};
+            recordPtr = it->second;
+        }
+
+        std::vector<std::vector<DecodeStepSample>> profiles;
+        std::lock_guard<std::mutex> engineLock(recordPtr->engineMutex);
+        if (!recordPtr->isLoaded.load() || !recordPtr->engine)
+            return profiles;
+        profiles.push_back(recordPtr->engine->getStepProfile());
+        for (const auto &replica : recordPtr->replicas)
+        {
+            profiles.push_back(replica->getStepProfile());
+        }
+        return profiles;
+    }
+
+    std::vector<std::shared_ptr<IInferenceEngine>> NodeManager::getLoadedReplicas(const std::string &engineId) const
+    {
+        std::shared_ptr<EngineRecord> recordPtr;
+        {
+            std::shared_lock<std::shared_mutex> mapLock(engineMapMutex_);
+            auto it = engines_.find(engineId);
+            if (it == engines_.end() || !it->second || it->second->markedForRemoval.load())
+                return {};
+            recordPtr = it->second;
+        }
+
+        std::vector<std::shared_ptr<IInferenceEngine>> engines;
+        std::lock_guard<std::mutex> engineLock(recordPtr->engineMutex);
+        if (!recordPtr->isLoaded.load() || !recordPtr->engine)
+            return engines;
+        engines.push_back(recordPtr->engine);
+        for (const auto &replica : recordPtr->replicas)
+        {
+            engines.push_back(replica);
+        }
+        return engines;
+    }
+
+    std::vector<NodeManager::AdmissionStats> NodeManager::getAdmissionStats() const
+    {
+        std::vector<std::pair<std::string, std::shared_ptr<EngineRecord>>> snapshot;
+        {
+            std::shared_lock<std::shared_mutex> mapLock(engineMapMutex_);
+            for (const auto &[id, recordPtr] : engines_)
             {
-                ServerLogger::logWarning("Engine with ID \'%s\' not found.", engineId.c_str());
-                return nullptr;
+                if (recordPtr && !recordPtr->markedForRemoval.load())
+                    snapshot.emplace_back(id, recordPtr);
             }
+        }
+
+        std::vector<AdmissionStats> stats;
+        for (const auto &[id, recordPtr] : snapshot)
+        {
+            std::lock_guard<std::mutex> engineLock(recordPtr->engineMutex);
+            AdmissionStats entry;
+            entry.engineId = id;
+            entry.maxQueuedJobs = recordPtr->loadParams.max_queued_jobs;
+            entry.maxQueuedTokens = recordPtr->loadParams.max_queued_tokens;
+            entry.rejectedRequests = recordPtr->rejectedRequests.load();
+            stats.push_back(std::move(entry));
+        }
+        return stats;
+    }
 
-            recordPtr = it->second; // Get shared ownership of the record
-            if (!recordPtr || recordPtr->markedForRemoval.load())
+    void NodeManager::setStartupState(const std::string &engineId, const std::string &state)
+    {
+        std::lock_guard<std::mutex> lock(startupMutex_);
+        startupStates_[engineId] = state;
+    }
+
+    std::map<std::string, std::string> NodeManager::getStartupStates() const
+    {
+        std::lock_guard<std::mutex> lock(startupMutex_);
+        return startupStates_;
+    }
+
+    std::shared_ptr<IInferenceEngine> NodeManager::getEngine(const std::string &engineId)
+    {
+        return acquireEngine(routeCandidates(engineId, 0).front(), true);
+    }
+
+    std::shared_ptr<IInferenceEngine> NodeManager::getEngine(const std::string &engineId, Admission &admission)
+    {
+        return getEngine(engineId, admission, 0);
+    }
+
+    std::shared_ptr<IInferenceEngine> NodeManager::getEngine(const std::string &engineId, Admission &admission, int contextTokens)
+    {
+        const std::vector<std::string> candidates = routeCandidates(engineId, contextTokens);
+        bool rejected = false;
+        int retryAfterSeconds = 0;
+        for (const auto &candidate : candidates)
+        {
+            admission = Admission();
+            auto engine = acquireEngine(candidate, true, &admission);
+            if (engine)
             {
-                ServerLogger::logWarning("Engine with ID \'%s\' is marked for removal.", engineId.c_str());
-                return nullptr;
+                if (candidate != engineId)
+                    KOLOSAL_LOG_DEBUG("Routed '%s' (%d tokens) to '%s'", engineId.c_str(), contextTokens, candidate.c_str());
+                return engine;
+            }
+            if (admission.rejected)
+            {
+                rejected = true;
+                retryAfterSeconds = std::max(retryAfterSeconds, admission.retryAfterSeconds);
             }
         }
 
-        // Now work with the engine record without holding the map lock
-        std::unique_lock<std::mutex> engineLock(recordPtr->engineMutex);
+        admission.rejected = rejected;
+        admission.retryAfterSeconds = retryAfterSeconds;
+        if (rejected)
+        {
+            KOLOSAL_LOG_WARNING("Engine '%s' is over its queue limits; rejecting request", engineId.c_str());
+        }
+        return nullptr;
+    }
+
+    void NodeManager::setModelAliases(const std::map<std::string, std::vector<std::string>> &aliases)
+    {
+        std::unique_lock<std::shared_mutex> lock(aliasMutex_);
+        modelAliases_ = aliases;
+    }
+
+    std::map<std::string, std::vector<std::string>> NodeManager::getModelAliases() const
+    {
+        std::shared_lock<std::shared_mutex> lock(aliasMutex_);
+        return modelAliases_;
+    }
+
+    std::vector<std::string> NodeManager::routeCandidates(const std::string &engineId, int contextTokens) const
+    {
+        std::vector<std::string> variants;
+        {
+            std::shared_lock<std::shared_mutex> lock(aliasMutex_);
+            auto it = modelAliases_.find(engineId);
+            if (it == modelAliases_.end() || it->second.empty())
+                return {engineId};
+            variants = it->second;
+        }
 
-        // Update activity time first
-        recordPtr->lastActivityTime = std::chrono::steady_clock::now();
+        std::vector<std::pair<std::string, std::shared_ptr<EngineRecord>>> records;
+        for (const auto &variant : variants)
+        {
+            auto recordPtr = findEngine(variant);
+            if (recordPtr && !recordPtr->markedForRemoval.load())
+                records.emplace_back(variant, std::move(recordPtr));
+        }
+        if (records.empty())
+            return {variants.front()};
+
+        // Context a single request may use on each variant; only unloaded ones need their lock
+        std::vector<std::pair<int, std::string>> capacities;
+        auto capacityOf = [](const LoadingParameters &params)
+        {
+            return params.max_seq_ctx > 0 ? std::min(params.max_seq_ctx, params.n_ctx) : params.n_ctx;
+        };
+        for (const auto &entry : records)
+        {
+            if (const auto serving = std::atomic_load(&entry.second->serving))
+            {
+                capacities.emplace_back(capacityOf(serving->limits), entry.first);
+                continue;
+            }
+            std::lock_guard<std::mutex> lock(entry.second->engineMutex);
+            capacities.emplace_back(capacityOf(entry.second->loadParams), entry.first);
+        }
+        std::stable_sort(capacities.begin(), capacities.end(),
+                         [](const auto &a, const auto &b) { return a.first < b.first; });
+
+        std::vector<std::string> fitting;
+        for (const auto &entry : capacities)
+        {
+            if (entry.first >= contextTokens)
+                fitting.push_back(entry.second);
+        }
+        if (fitting.empty())
+        {
+            KOLOSAL_LOG_DEBUG("No variant of '%s' holds %d tokens; using '%s' (%d)", engineId.c_str(), contextTokens,
+                                capacities.back().second.c_str(), capacities.back().first);
+            fitting.push_back(capacities.back().second);
+        }
+        return fitting;
+    }
+
+    std::shared_ptr<IInferenceEngine> NodeManager::acquireEngine(const std::string &engineId, bool countRequest,
+                                                                 Admission *admission)
+    {
+        tracing::Span acquireSpan("engine.acquire");
+        acquireSpan.setAttribute("engine.id", engineId);
+
+        // The published map needs no lock, so lookups never wait behind an add or remove
+        std::shared_ptr<EngineRecord> recordPtr = findEngine(engineId);
+        if (!recordPtr)
+        {
+            KOLOSAL_LOG_WARNING("Engine with ID \'%s\' not found.", engineId.c_str());
+            return nullptr;
+        }
+        if (recordPtr->markedForRemoval.load())
+        {
+            KOLOSAL_LOG_WARNING("Engine with ID \'%s\' is marked for removal.", engineId.c_str());
+            return nullptr;
+        }
+
+        // Update activity time first (before the serving set is read; see withdrawServing());
+        // preloads count as neither activity nor traffic
+        if (countRequest)
+        {
+            const auto now = std::chrono::steady_clock::now();
+            recordPtr->touch(now);
+            if (now - recordPtr->windowStart() >= rateWindow)
+            {
+                // Whoever holds the lock can roll the window over just as well
+                std::unique_lock<std::mutex> rateLock(recordPtr->engineMutex, std::try_to_lock);
+                if (rateLock.owns_lock())
+                    requestRate(*recordPtr, now);
+            }
+            recordPtr->windowRequests.fetch_add(1);
+        }
+
+        auto serve = [&](const std::shared_ptr<const ServingSet> &serving) -> std::shared_ptr<IInferenceEngine>
+        {
+            if (!serving)
+                return nullptr;
+            return countRequest ? pickReplica(*recordPtr, *serving, admission) : serving->engines.front();
+        };
+
+        // A loaded engine serves from its published set without taking any lock
+        if (auto serving = std::atomic_load(&recordPtr->serving))
+            return serve(serving);
+
+        // Loading, or waiting for another thread's load, takes only this engine's mutex
+        std::unique_lock<std::mutex> engineLock(recordPtr->engineMutex);
 
         if (!recordPtr->isLoaded.load())
         {
             // Check if another thread is already loading
             if (recordPtr->isLoading.load())
             {
-                ServerLogger::logDebug("Engine ID \'%s\' is being loaded by another thread. Waiting...", engineId.c_str());
-                recordPtr->loadingCv.wait(engineLock, [recordPtr]
-                                          { return !recordPtr->isLoading.load() || recordPtr->markedForRemoval.load(); });
+                KOLOSAL_LOG_DEBUG("Engine ID \'%s\' is being loaded by another thread. Waiting...", engineId.c_str());
+                {
+                    tracing::Span waitSpan("engine.wait_for_load");
+                    recordPtr->loadingCv.wait(engineLock, [recordPtr]
+                                              { return !recordPtr->isLoading.load() || recordPtr->markedForRemoval.load(); });
+                }
 
                 if (recordPtr->markedForRemoval.load())
                 {
@@ -919,12 +1507,12 @@ namespace kolosal
 
                 if (recordPtr->isLoaded.load() && recordPtr->engine)
                 {
-                    ServerLogger::logDebug("Engine ID \'%s\' loaded by another thread.", engineId.c_str());
-                    return recordPtr->engine;
+                    KOLOSAL_LOG_DEBUG("Engine ID \'%s\' loaded by another thread.", engineId.c_str());
+                    return serve(std::atomic_load(&recordPtr->serving));
                 }
                 else
                 {
-                    ServerLogger::logError("Engine ID \'%s\' failed to load by another thread.", engineId.c_str());
+                    KOLOSAL_LOG_ERROR("Engine ID \'%s\' failed to load by another thread.", engineId.c_str());
                     return nullptr;
                 }
             }
@@ -932,22 +1520,28 @@ namespace kolosal
             // This thread will handle the loading
             recordPtr->isLoading.store(true);
             engineLock.unlock(); // Release lock during potentially long loading operation
+            tracing::Span reloadSpan("engine.reload");
 
-            ServerLogger::logInfo("Engine ID \'%s\' was unloaded due to inactivity. Attempting to reload.", engineId.c_str());
+            if (recordPtr->isHibernated.load())
+                KOLOSAL_LOG_INFO("Engine ID \'%s\' is hibernating. Waking it from the weights held in RAM.", engineId.c_str());
+            else
+                KOLOSAL_LOG_INFO("Engine ID \'%s\' was unloaded due to %s. Attempting to %s.", engineId.c_str(),
+                                      recordPtr->evictedForMemory ? "memory pressure" : "inactivity", countRequest ? "reload" : "preload");
 
             // Create new engine instance using dynamic loader with safety handlers
             std::string engineType = recordPtr->engineType;
-            ServerLogger::logInfo("Stored engine type for '%s': '%s'", engineId.c_str(), engineType.c_str());
+            KOLOSAL_LOG_INFO("Stored engine type for '%s': '%s'", engineId.c_str(), engineType.c_str());
             std::shared_ptr<IInferenceEngine> newEngine;
+            std::vector<std::shared_ptr<IInferenceEngine>> newReplicas;
 
             try
             {
                 if (!inferenceLoader_->isEngineLoaded(engineType))
                 {
-                    ServerLogger::logInfo("Reloading %s inference engine plugin...", engineType.c_str());
+                    KOLOSAL_LOG_INFO("Reloading %s inference engine plugin...", engineType.c_str());
                     if (!inferenceLoader_->loadEngine(engineType))
                     {
-                        ServerLogger::logError("Failed to reload %s inference engine: %s",
+                        KOLOSAL_LOG_ERROR("Failed to reload %s inference engine: %s",
                                                engineType.c_str(), inferenceLoader_->getLastError().c_str());
                         // Re-acquire lock to update state
                         engineLock.lock();
@@ -957,11 +1551,11 @@ namespace kolosal
                     }
                 }
 
-                ServerLogger::logInfo("Creating new inference engine instance for reload...");
+                KOLOSAL_LOG_INFO("Creating new inference engine instance for reload...");
                 auto newEngineInstance = inferenceLoader_->createEngineInstance(engineType);
                 if (!newEngineInstance)
                 {
-                    ServerLogger::logError("Failed to create %s inference engine instance during reload: %s",
+                    KOLOSAL_LOG_ERROR("Failed to create %s inference engine instance during reload: %s",
                                            engineType.c_str(), inferenceLoader_->getLastError().c_str());
                     // Re-acquire lock to update state
                     engineLock.lock();
@@ -971,39 +1565,42 @@ namespace kolosal
                 }
 
                 bool loadSuccess = false;
+                engineLock.lock();
+                recordPtr->loadingEngine = newEngineInstance.get();
+                engineLock.unlock();
+                const auto loadStart = std::chrono::steady_clock::now();
                 try
                 {
-                    ServerLogger::logInfo("Reloading model from path: %s", recordPtr->modelPath.c_str());
-                    // Check if this is an embedding model or regular model
-                    if (recordPtr->isEmbeddingModel.load())
-                    {
-                        // For embedding models, use the specialized loadEmbeddingModel method
-                        loadSuccess = newEngineInstance->loadEmbeddingModel(recordPtr->modelPath.c_str(), recordPtr->loadParams, recordPtr->mainGpuId);
-                    }
-                    else
-                    {
-                        loadSuccess = newEngineInstance->loadModel(recordPtr->modelPath.c_str(), recordPtr->loadParams, recordPtr->mainGpuId);
-                    }
+                    KOLOSAL_LOG_INFO("Reloading model from path: %s", recordPtr->modelPath.c_str());
+                    loadSuccess = loadModelOfType(*newEngineInstance, recordPtr->modelType(), recordPtr->modelPath,
+                                                  replicaLoadParams(recordPtr->loadParams, engineType), replicaGpuId(recordPtr->mainGpuId, engineType, 0));
                 }
                 catch (const std::exception &e)
                 {
-                    ServerLogger::logError("Exception during model reload for engine '%s': %s", engineId.c_str(), e.what());
+                    KOLOSAL_LOG_ERROR("Exception during model reload for engine '%s': %s", engineId.c_str(), e.what());
                     loadSuccess = false;
                 }
                 catch (...)
                 {
-                    ServerLogger::logError("Unknown exception during model reload for engine '%s'", engineId.c_str());
+                    KOLOSAL_LOG_ERROR("Unknown exception during model reload for engine '%s'", engineId.c_str());
                     loadSuccess = false;
                 }
+                engineLock.lock();
+                recordPtr->loadingEngine = nullptr;
+                engineLock.unlock();
 
                 if (loadSuccess)
                 {
+                    Metrics::instance().observeModelLoad(engineId, secondsSince(loadStart));
                     newEngine = std::shared_ptr<IInferenceEngine>(newEngineInstance.release());
-                    ServerLogger::logInfo("Successfully reloaded model for engine '%s'", engineId.c_str());
+                    newReplicas = loadReplicas(engineId, recordPtr->modelPath, engineType, recordPtr->loadParams,
+                                               recordPtr->mainGpuId, recordPtr->modelType());
+                    KOLOSAL_LOG_INFO("Successfully reloaded model for engine '%s'", engineId.c_str());
                 }
                 else
                 {
-                    ServerLogger::logError("Failed to reload model for engine '%s'", engineId.c_str());
+                    KOLOSAL_LOG_ERROR("Failed to reload model for engine '%s'", engineId.c_str());
+                    reloadSpan.setError("model load failed");
                     // Ensure cleanup
                     try
                     {
@@ -1014,43 +1611,51 @@ namespace kolosal
                     }
                     catch (...)
                     {
-                        ServerLogger::logWarning("Exception during cleanup after failed model reload for engine '%s'", engineId.c_str());
+                        KOLOSAL_LOG_WARNING("Exception during cleanup after failed model reload for engine '%s'", engineId.c_str());
                     }
                 }
             }
             catch (const std::exception &e)
             {
-                ServerLogger::logError("Exception during engine reload for '%s': %s", engineId.c_str(), e.what());
+                KOLOSAL_LOG_ERROR("Exception during engine reload for '%s': %s", engineId.c_str(), e.what());
             }
             catch (...)
             {
-                ServerLogger::logError("Unknown exception during engine reload for '%s'", engineId.c_str());
+                KOLOSAL_LOG_ERROR("Unknown exception during engine reload for '%s'", engineId.c_str());
             }
-            // Re-acquire lock to update state
+            // Re-acquire lock to update state; the load has read the weights, whether or not it worked
             engineLock.lock();
             recordPtr->isLoading.store(false);
+            endHibernation(*recordPtr);
 
             if (newEngine && !recordPtr->markedForRemoval.load())
             {
                 recordPtr->engine = newEngine;
+                recordPtr->replicas = std::move(newReplicas);
+                recordPtr->evictedForMemory = false;
                 recordPtr->isLoaded.store(true);
-                ServerLogger::logInfo("Successfully reloaded %s engine ID \'%s\'.", 
-                                      recordPtr->isEmbeddingModel.load() ? "embedding" : "LLM", 
+                publishServing(*recordPtr);
+                KOLOSAL_LOG_INFO("Successfully reloaded %s engine ID \'%s\'.", 
+                                      modelTypeName(recordPtr->modelType()), 
                                       engineId.c_str());
             }
             else
             {
                 if (recordPtr->markedForRemoval.load())
                 {
-                    ServerLogger::logInfo("Engine ID \'%s\' was marked for removal during loading.", engineId.c_str());
+                    KOLOSAL_LOG_INFO("Engine ID \'%s\' was marked for removal during loading.", engineId.c_str());
                 }
                 else
                 {
-                    ServerLogger::logError("Failed to reload %s model for engine ID \'%s\' from path \'%s\'.", 
-                                          recordPtr->isEmbeddingModel.load() ? "embedding" : "LLM",
+                    KOLOSAL_LOG_ERROR("Failed to reload %s model for engine ID \'%s\' from path \'%s\'.", 
+                                          modelTypeName(recordPtr->modelType()),
                                           engineId.c_str(), recordPtr->modelPath.c_str());
                 }
                 recordPtr->engine = nullptr;
+                for (auto &replica : newReplicas)
+                {
+                    replica->unloadModel();
+                }
             }
 
             // Notify all waiting threads
@@ -1062,13 +1667,404 @@ namespace kolosal
             }
         }
 
-        // Notify autoscaling thread about activity
+        // Notify autoscaling thread that an engine is loaded again
         {
             std::lock_guard<std::mutex> lock(autoscalingMutex_);
             autoscalingCv_.notify_one();
         }
 
-        return recordPtr->engine;
+        return serve(std::atomic_load(&recordPtr->serving));
+    }
+
+    double NodeManager::requestRate(EngineRecord &record, std::chrono::steady_clock::time_point now)
+    {
+        auto windowStart = record.windowStart();
+        if (now - windowStart >= 2 * rateWindow)
+        {
+            // Nothing recorded for a whole window
+            record.prevWindowRequests = 0;
+            record.windowRequests.store(0);
+            windowStart = now;
+        }
+        else if (now - windowStart >= rateWindow)
+        {
+            record.prevWindowRequests = record.windowRequests.exchange(0);
+            windowStart += rateWindow;
+        }
+        record.windowStartTicks.store(windowStart.time_since_epoch().count());
+
+        // Blend the previous window in proportion to how much of it still overlaps the last minute
+        const double elapsed = std::chrono::duration<double>(now - windowStart).count() / rateWindow.count();
+        return record.windowRequests.load() + record.prevWindowRequests * (std::max)(0.0, 1.0 - elapsed);
+    }
+
+    uint64_t NodeManager::estimatedFootprint(const EngineRecord &record)
+    {
+        std::error_code ec;
+        const auto fileSize = std::filesystem::file_size(record.modelPath, ec);
+        if (ec)
+            return 0;
+
+        // GPU replicas each hold a copy of the weights; CPU replicas share one mapping
+        const bool cpuEngine = record.engineType.find("cpu") != std::string::npos;
+        const int copies = cpuEngine ? 1 : (std::max)(1, record.loadParams.n_replicas);
+        return static_cast<uint64_t>(fileSize) * copies;
+    }
+
+    void NodeManager::hibernateEngine(const std::string &engineId, EngineRecord &record)
+    {
+        unloadReplicas(engineId, record);
+        record.engine->unloadModel();
+        record.isLoaded.store(false);
+        record.engine = nullptr;
+        record.evictedForMemory = false;
+        publishServing(record);
+
+        // Only as much as the budget allows and the system can spare; the rest unloads for good
+        const auto &config = ServerConfig::getInstance();
+        const uint64_t budget = static_cast<uint64_t>((std::max)(0, config.hibernateMemoryMb)) * 1024 * 1024;
+        const uint64_t minFree = static_cast<uint64_t>((std::max)(0, config.minFreeMemoryMb)) * 1024 * 1024;
+        std::error_code ec;
+        const uint64_t bytes = budget > 0 ? std::filesystem::file_size(record.modelPath, ec) : 0;
+        const uint64_t freeBytes = availableSystemMemory();
+        if (bytes == 0 || ec || hibernatedBytes_.load() + bytes > budget ||
+            (freeBytes > 0 && freeBytes < minFree + bytes))
+        {
+            KOLOSAL_LOG_INFO("Engine ID \'%s\' unloaded due to inactivity.", engineId.c_str());
+            return;
+        }
+
+        auto pin = std::make_shared<WeightPin>(record.modelPath);
+        if (pin->bytes == 0)
+        {
+            KOLOSAL_LOG_WARNING("Could not map \'%s\' to keep it in memory; engine ID \'%s\' unloaded instead of hibernating.",
+                                     record.modelPath.c_str(), engineId.c_str());
+            return;
+        }
+        hibernatedBytes_.fetch_add(pin->bytes);
+        KOLOSAL_LOG_INFO("Engine ID \'%s\' hibernated due to inactivity: %.0f MB of weights kept in RAM (%s).",
+                              engineId.c_str(), pin->bytes / (1024.0 * 1024.0), pin->locked ? "locked" : "page cache");
+        record.weightPin = std::move(pin);
+        record.isHibernated.store(true);
+    }
+
+    void NodeManager::endHibernation(EngineRecord &record)
+    {
+        if (record.weightPin)
+        {
+            hibernatedBytes_.fetch_sub(record.weightPin->bytes);
+            record.weightPin.reset();
+        }
+        record.isHibernated.store(false);
+    }
+
+    void NodeManager::enforceMemoryBudget(const std::vector<std::pair<std::string, std::shared_ptr<EngineRecord>>> &snapshot,
+                                          std::chrono::steady_clock::time_point now)
+    {
+        const auto &config = ServerConfig::getInstance();
+        const uint64_t budget = static_cast<uint64_t>((std::max)(0, config.modelMemoryBudgetMb)) * 1024 * 1024;
+        const uint64_t minFree = static_cast<uint64_t>((std::max)(0, config.minFreeMemoryMb)) * 1024 * 1024;
+        if (budget == 0 && minFree == 0)
+            return;
+
+        // Engines used in the last few seconds are about to serve again; never evict them
+        constexpr auto recentlyUsed = std::chrono::seconds(30);
+        std::vector<const EngineRecord *> busyEngines;
+
+        while (!stopAutoscaling_.load())
+        {
+            uint64_t loadedBytes = 0;
+            std::shared_ptr<EngineRecord> victim;
+            std::string victimId;
+            double victimRate = 0.0;
+            std::shared_ptr<EngineRecord> sleeper;
+            std::string sleeperId;
+            for (const auto &[engineId, recordPtr] : snapshot)
+            {
+                std::lock_guard<std::mutex> engineLock(recordPtr->engineMutex);
+                if (recordPtr->weightPin && (!sleeper || recordPtr->lastActivity() < sleeper->lastActivity()))
+                {
+                    sleeper = recordPtr;
+                    sleeperId = engineId;
+                }
+                if (!recordPtr->isLoaded.load() || !recordPtr->engine || recordPtr->markedForRemoval.load())
+                    continue;
+                loadedBytes += estimatedFootprint(*recordPtr);
+
+                if (now - recordPtr->lastActivity() < recentlyUsed ||
+                    std::find(busyEngines.begin(), busyEngines.end(), recordPtr.get()) != busyEngines.end())
+                    continue;
+                const double rate = requestRate(*recordPtr, now);
+                if (!victim || rate < victimRate ||
+                    (rate == victimRate && recordPtr->lastActivity() < victim->lastActivity()))
+                {
+                    victim = recordPtr;
+                    victimId = engineId;
+                    victimRate = rate;
+                }
+            }
+
+            const uint64_t freeBytes = minFree > 0 ? availableSystemMemory() : 0;
+            const bool overBudget = budget > 0 && loadedBytes > budget;
+            const bool lowMemory = minFree > 0 && freeBytes > 0 && freeBytes < minFree;
+
+            // Weights kept for a fast wake-up are the cheapest memory to give back
+            if (lowMemory && sleeper)
+            {
+                std::lock_guard<std::mutex> engineLock(sleeper->engineMutex);
+                KOLOSAL_LOG_INFO("Engine ID \'%s\' stops hibernating to free memory (%.0f MB free).",
+                                      sleeperId.c_str(), freeBytes / (1024.0 * 1024.0));
+                endHibernation(*sleeper);
+                continue;
+            }
+            if ((!overBudget && !lowMemory) || !victim)
+            {
+                if ((overBudget || lowMemory) && !victim)
+                    KOLOSAL_LOG_DEBUG("Model memory is over the limit but every loaded engine is in use.");
+                return;
+            }
+
+            std::lock_guard<std::mutex> engineLock(victim->engineMutex);
+            if (!victim->isLoaded.load() || !victim->engine)
+                continue;
+            bool busy = victim->engine->hasActiveJobs();
+            for (const auto &replica : victim->replicas)
+            {
+                busy = replica->hasActiveJobs() || busy;
+            }
+            if (busy)
+            {
+                busyEngines.push_back(victim.get());
+                continue;
+            }
+            if (!withdrawServing(*victim, now - recentlyUsed))
+                continue;
+
+            KOLOSAL_LOG_INFO("Unloading engine ID \'%s\' to free memory (%.0f MB loaded, %.0f MB free, %.1f requests/min).",
+                                  victimId.c_str(), loadedBytes / (1024.0 * 1024.0), freeBytes / (1024.0 * 1024.0), victimRate);
+            unloadReplicas(victimId, *victim);
+            victim->engine->unloadModel();
+            victim->isLoaded.store(false);
+            victim->engine = nullptr;
+            victim->evictedForMemory = true;
+            publishServing(*victim);
+        }
+    }
+
+    void NodeManager::schedulePreload(const std::vector<std::pair<std::string, std::shared_ptr<EngineRecord>>> &snapshot,
+                                      std::chrono::steady_clock::time_point now)
+    {
+        const auto &config = ServerConfig::getInstance();
+        if (!config.preloadModels || preloadRunning_.load())
+            return;
+
+        const uint64_t budget = static_cast<uint64_t>((std::max)(0, config.modelMemoryBudgetMb)) * 1024 * 1024;
+        const uint64_t minFree = static_cast<uint64_t>((std::max)(0, config.minFreeMemoryMb)) * 1024 * 1024;
+        const uint64_t freeBytes = availableSystemMemory();
+
+        uint64_t loadedBytes = 0;
+        std::string candidateId;
+        uint64_t candidateBytes = 0;
+        double candidateRate = 0.0;
+        for (const auto &[engineId, recordPtr] : snapshot)
+        {
+            std::lock_guard<std::mutex> engineLock(recordPtr->engineMutex);
+            if (recordPtr->markedForRemoval.load() || recordPtr->isLoading.load())
+                continue;
+            if (recordPtr->isLoaded.load())
+            {
+                loadedBytes += estimatedFootprint(*recordPtr);
+                continue;
+            }
+
+            // Only models pushed out by memory pressure whose traffic is holding or growing;
+            // idle-unloaded models stay unloaded until asked for
+            const double rate = requestRate(*recordPtr, now);
+            const uint32_t windowRequests = recordPtr->windowRequests.load();
+            if (!recordPtr->evictedForMemory || windowRequests == 0 || windowRequests < recordPtr->prevWindowRequests)
+                continue;
+            if (rate > candidateRate)
+            {
+                candidateId = engineId;
+                candidateBytes = estimatedFootprint(*recordPtr);
+                candidateRate = rate;
+            }
+        }
+
+        if (candidateId.empty())
+            return;
+        if (budget > 0 && loadedBytes + candidateBytes > budget)
+            return;
+        if (minFree > 0 && freeBytes > 0 && freeBytes < minFree + candidateBytes)
+            return;
+
+        if (preloadThread_.joinable())
+        {
+            preloadThread_.join();
+        }
+        KOLOSAL_LOG_INFO("Preloading engine ID \'%s\' (%.1f requests/min).", candidateId.c_str(), candidateRate);
+        preloadRunning_.store(true);
+        preloadThread_ = std::thread([this, candidateId]()
+                                     {
+            acquireEngine(candidateId, false);
+            preloadRunning_.store(false); });
+    }
+
+    bool NodeManager::swapEngine(const std::string &engineId, const char *modelPath, const LoadingParameters &loadParams,
+                                 int mainGpuId, const std::string &engineType, std::chrono::seconds drainTimeout)
+    {
+        std::shared_ptr<EngineRecord> recordPtr;
+        {
+            std::shared_lock<std::shared_mutex> mapLock(engineMapMutex_);
+            auto it = engines_.find(engineId);
+            if (it == engines_.end() || !it->second || it->second->markedForRemoval.load())
+            {
+                KOLOSAL_LOG_WARNING("Engine with ID \'%s\' not found for swap.", engineId.c_str());
+                return false;
+            }
+            recordPtr = it->second;
+        }
+
+        bool expected = false;
+        if (!recordPtr->isSwapping.compare_exchange_strong(expected, true))
+        {
+            KOLOSAL_LOG_WARNING("Engine ID \'%s\' is already being swapped.", engineId.c_str());
+            return false;
+        }
+
+        std::string newEngineType;
+        ModelType type = ModelType::LLM;
+        {
+            std::lock_guard<std::mutex> engineLock(recordPtr->engineMutex);
+            newEngineType = engineType.empty() ? recordPtr->engineType : engineType;
+            type = recordPtr->modelType();
+        }
+
+        // Everything up to the switch-over runs next to the old engine, which keeps serving
+        KOLOSAL_LOG_INFO("Validating replacement model for engine \'%s\': %s", engineId.c_str(), modelPath);
+        std::string actualModelPath = modelPath;
+        if (!validateModelFile(modelPath) ||
+            (is_valid_url(modelPath) && (actualModelPath = handleUrlDownload(engineId, modelPath)).empty()))
+        {
+            KOLOSAL_LOG_ERROR("Replacement model for engine \'%s\' is not usable. Keeping the current model.", engineId.c_str());
+            recordPtr->isSwapping.store(false);
+            return false;
+        }
+
+        std::shared_ptr<IInferenceEngine> newEngine;
+        try
+        {
+            if (!inferenceLoader_->isEngineLoaded(newEngineType) && !inferenceLoader_->loadEngine(newEngineType))
+            {
+                KOLOSAL_LOG_ERROR("Failed to load %s inference engine: %s",
+                                       newEngineType.c_str(), inferenceLoader_->getLastError().c_str());
+            }
+            else if (auto engineInstance = inferenceLoader_->createEngineInstance(newEngineType))
+            {
+                const LoadingParameters params = replicaLoadParams(loadParams, newEngineType);
+                const auto loadStart = std::chrono::steady_clock::now();
+                const bool loadSuccess = loadModelOfType(*engineInstance, type, actualModelPath, params, replicaGpuId(mainGpuId, newEngineType, 0));
+                if (loadSuccess)
+                {
+                    Metrics::instance().observeModelLoad(engineId, secondsSince(loadStart));
+                    newEngine = std::shared_ptr<IInferenceEngine>(engineInstance.release());
+                }
+            }
+            else
+            {
+                KOLOSAL_LOG_ERROR("Failed to create %s inference engine instance: %s",
+                                       newEngineType.c_str(), inferenceLoader_->getLastError().c_str());
+            }
+        }
+        catch (const std::exception &e)
+        {
+            KOLOSAL_LOG_ERROR("Exception while loading replacement model for engine \'%s\': %s", engineId.c_str(), e.what());
+        }
+        catch (...)
+        {
+            KOLOSAL_LOG_ERROR("Unknown exception while loading replacement model for engine \'%s\'", engineId.c_str());
+        }
+
+        if (!newEngine)
+        {
+            KOLOSAL_LOG_ERROR("Failed to load replacement model for engine \'%s\' from \'%s\'. Keeping the current model.",
+                                   engineId.c_str(), actualModelPath.c_str());
+            recordPtr->isSwapping.store(false);
+            return false;
+        }
+        auto newReplicas = loadReplicas(engineId, actualModelPath, newEngineType, loadParams, mainGpuId, type);
+
+        // Switch over: requests that ask for the engine from here on get the new model
+        std::shared_ptr<IInferenceEngine> oldEngine;
+        std::vector<std::shared_ptr<IInferenceEngine>> oldReplicas;
+        {
+            std::unique_lock<std::mutex> engineLock(recordPtr->engineMutex);
+            // A lazy reload running right now would otherwise overwrite the new engine
+            recordPtr->loadingCv.wait(engineLock, [&recordPtr]
+                                      { return !recordPtr->isLoading.load(); });
+            if (recordPtr->markedForRemoval.load())
+            {
+                engineLock.unlock();
+                KOLOSAL_LOG_INFO("Engine ID \'%s\' was removed during the swap.", engineId.c_str());
+                newEngine->unloadModel();
+                for (auto &replica : newReplicas)
+                {
+                    replica->unloadModel();
+                }
+                recordPtr->isSwapping.store(false);
+                return false;
+            }
+
+            oldEngine = std::move(recordPtr->engine);
+            oldReplicas = std::move(recordPtr->replicas);
+            recordPtr->engine = newEngine;
+            recordPtr->replicas = std::move(newReplicas);
+            recordPtr->modelPath = actualModelPath;
+            recordPtr->engineType = newEngineType;
+            recordPtr->loadParams = loadParams;
+            recordPtr->mainGpuId = mainGpuId;
+            recordPtr->evictedForMemory = false;
+            recordPtr->touch(std::chrono::steady_clock::now());
+            recordPtr->isLoaded.store(true);
+            endHibernation(*recordPtr);
+            publishServing(*recordPtr);
+        }
+        recordPtr->isSwapping.store(false);
+        ResponseCache::instance().invalidateModel(engineId);
+        SemanticCache::instance().invalidateModel(engineId);
+        KOLOSAL_LOG_INFO("Engine ID \'%s\' now serves %s.", engineId.c_str(), actualModelPath.c_str());
+
+        saveModelToConfig(engineId, modelPath, loadParams, mainGpuId, newEngineType, true);
+
+        // Drain: the old engine finishes what it already accepted, then it is freed. Handlers that
+        // fetched it just before the switch hold their own reference, so dropping ours is safe
+        if (oldEngine)
+        {
+            oldReplicas.insert(oldReplicas.begin(), std::move(oldEngine));
+        }
+        const auto deadline = std::chrono::steady_clock::now() + drainTimeout;
+        auto draining = [&oldReplicas]()
+        {
+            return std::any_of(oldReplicas.begin(), oldReplicas.end(), [](const std::shared_ptr<IInferenceEngine> &engine)
+                               { return engine->hasActiveJobs(); });
+        };
+        while (draining() && std::chrono::steady_clock::now() < deadline && !stopAutoscaling_.load())
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+        if (draining())
+        {
+            KOLOSAL_LOG_WARNING("Old model of engine \'%s\' still had active jobs after %lld seconds; releasing it anyway.",
+                                     engineId.c_str(), static_cast<long long>(drainTimeout.count()));
+        }
+        oldReplicas.clear();
+        KOLOSAL_LOG_INFO("Previous model of engine \'%s\' drained and released.", engineId.c_str());
+
+        {
+            std::lock_guard<std::mutex> lock(autoscalingMutex_);
+            autoscalingCv_.notify_one();
+        }
+        return true;
     }
 
     bool NodeManager::removeEngine(const std::string &engineId)
@@ -1081,34 +2077,44 @@ namespace kolosal
             auto it = engines_.find(engineId);
             if (it == engines_.end())
             {
-                ServerLogger::logWarning("Attempted to remove non-existent engine with ID \'%s\'.", engineId.c_str());
+                KOLOSAL_LOG_WARNING("Attempted to remove non-existent engine with ID \'%s\'.", engineId.c_str());
                 return false;
             }
 
             recordPtr = it->second;
             engines_.erase(it);
+            publishEnginesLocked();
         }
+        {
+            std::lock_guard<std::mutex> lock(startupMutex_);
+            startupStates_.erase(engineId);
+        }
+        ResponseCache::instance().invalidateModel(engineId);
+        SemanticCache::instance().invalidateModel(engineId);
 
         if (recordPtr)
         {
             recordPtr->markedForRemoval.store(true);
             std::lock_guard<std::mutex> engineLock(recordPtr->engineMutex);
+            publishServing(*recordPtr);
+            endHibernation(*recordPtr);
 
             if (recordPtr->isLoaded.load() && recordPtr->engine)
             {
-                ServerLogger::logInfo("Unloading engine with ID \'%s\'.", engineId.c_str());
+                KOLOSAL_LOG_INFO("Unloading engine with ID \'%s\'.", engineId.c_str());
                 try
                 {
+                    unloadReplicas(engineId, *recordPtr);
                     recordPtr->engine->unloadModel();
-                    ServerLogger::logInfo("Engine with ID \'%s\' unloaded successfully.", engineId.c_str());
+                    KOLOSAL_LOG_INFO("Engine with ID \'%s\' unloaded successfully.", engineId.c_str());
                 }
                 catch (const std::exception &e)
                 {
-                    ServerLogger::logError("Exception while unloading engine ID \'%s\': %s", engineId.c_str(), e.what());
+                    KOLOSAL_LOG_ERROR("Exception while unloading engine ID \'%s\': %s", engineId.c_str(), e.what());
                 }
                 catch (...)
                 {
-                    ServerLogger::logError("Unknown exception while unloading engine ID \'%s\'", engineId.c_str());
+                    KOLOSAL_LOG_ERROR("Unknown exception while unloading engine ID \'%s\'", engineId.c_str());
                 }
             }
 
@@ -1116,7 +2122,7 @@ namespace kolosal
             recordPtr->loadingCv.notify_all();
         }
 
-        ServerLogger::logInfo("Engine with ID \'%s\' removed from manager.", engineId.c_str());
+        KOLOSAL_LOG_INFO("Engine with ID \'%s\' removed from manager.", engineId.c_str());
 
         // Remove model from configuration file
         removeModelFromConfig(engineId);
@@ -1145,6 +2151,24 @@ namespace kolosal
         return ids;
     }
 
+    std::optional<ModelCatalog::ModelInfo> NodeManager::getModelInfo(const std::string &engineId) const
+    {
+        std::shared_ptr<EngineRecord> recordPtr;
+        {
+            std::shared_lock<std::shared_mutex> mapLock(engineMapMutex_);
+            auto it = engines_.find(engineId);
+            if (it == engines_.end() || !it->second)
+                return std::nullopt;
+            recordPtr = it->second;
+        }
+        std::string modelPath;
+        {
+            std::lock_guard<std::mutex> lock(recordPtr->engineMutex);
+            modelPath = recordPtr->modelPath;
+        }
+        return ModelCatalog::instance().peek(modelPath);
+    }
+
     std::vector<InferenceEngineInfo> NodeManager::getAvailableInferenceEngines() const
     {
         if (inferenceLoader_)
@@ -1154,100 +2178,31 @@ namespace kolosal
         return {};
     }
 
-    // Helper function to validate model file existence
+    // Validates a model file or URL; the catalog remembers the result while the file is unchanged
     bool NodeManager::validateModelFile(const std::string &modelPath)
     {
         try
         {
-            if (is_valid_url(modelPath))
+            std::string error;
+            if (!ModelCatalog::instance().validate(modelPath, error))
             {
-                // For URLs, we can perform a HEAD request to check if the file exists
-                ServerLogger::logInfo("Validating URL accessibility: %s", modelPath.c_str());
-
-                try
-                {
-                    // Try to get file info without downloading
-                    auto result = get_url_file_info(modelPath);
-                    if (!result.success)
-                    {
-                        ServerLogger::logError("URL validation failed: %s - %s", modelPath.c_str(), result.error_message.c_str());
-                        return false;
-                    }
-                    ServerLogger::logInfo("URL is accessible. File size: %.2f MB",
-                                          static_cast<double>(result.total_bytes) / (1024.0 * 1024.0));
-                    return true;
-                }
-                catch (const std::exception &e)
-                {
-                    ServerLogger::logError("Exception during URL validation for %s: %s", modelPath.c_str(), e.what());
-                    return false;
-                }
-                catch (...)
-                {
-                    ServerLogger::logError("Unknown exception during URL validation for %s", modelPath.c_str());
-                    return false;
-                }
+                KOLOSAL_LOG_ERROR("%s", error.c_str());
+                return false;
             }
-            else
+            if (auto info = ModelCatalog::instance().peek(modelPath))
             {
-                // For local paths, check if the file exists
-                try
-                {
-                    if (!std::filesystem::exists(modelPath))
-                    {
-                        ServerLogger::logError("Local model file does not exist: %s", modelPath.c_str());
-                        return false;
-                    }
-
-                    // Check if it's a regular file (not a directory)
-                    if (!std::filesystem::is_regular_file(modelPath))
-                    {
-                        ServerLogger::logError("Model path is not a regular file: %s", modelPath.c_str());
-                        return false;
-                    }
-                }
-                catch (const std::filesystem::filesystem_error &e)
-                {
-                    ServerLogger::logError("Filesystem error during model validation for %s: %s", modelPath.c_str(), e.what());
-                    return false;
-                }
-                catch (const std::exception &e)
-                {
-                    ServerLogger::logError("Exception during local file validation for %s: %s", modelPath.c_str(), e.what());
-                    return false;
-                }
-
-                // Get file size for logging
-                try
-                {
-                    std::error_code ec;
-                    auto fileSize = std::filesystem::file_size(modelPath, ec);
-                    if (!ec)
-                    {
-                        ServerLogger::logInfo("Local model file found. Size: %.2f MB",
-                                              static_cast<double>(fileSize) / (1024.0 * 1024.0));
-                    }
-                    else
-                    {
-                        ServerLogger::logWarning("Could not determine file size for: %s", modelPath.c_str());
-                    }
-                }
-                catch (...)
-                {
-                    ServerLogger::logWarning("Exception while getting file size for: %s", modelPath.c_str());
-                }
-
-                return true;
+                KOLOSAL_LOG_INFO("Local model file found. Size: %.2f MB", static_cast<double>(info->file_size) / (1024.0 * 1024.0));
             }
+            return true;
         }
         catch (const std::exception &e)
         {
-            ServerLogger::logError("Exception during model file validation for %s: %s", modelPath.c_str(), e.what());
+            KOLOSAL_LOG_ERROR("Exception during model file validation for %s: %s", modelPath.c_str(), e.what());
             return false;
         }
         catch (...)
         {
-            ServerLogger::logError("Unknown exception during model file validation for %s", modelPath.c_str());
+            KOLOSAL_LOG_ERROR("Unknown exception during model file validation for %s", modelPath.c_str());
             return false;
         }
     }
@@ -1260,7 +2215,7 @@ namespace kolosal
 
     void NodeManager::autoscalingLoop()
     {
-        ServerLogger::logInfo("Autoscaling thread started.");
+        KOLOSAL_LOG_INFO("Autoscaling thread started.");
 
         // Initial check interval
         auto nextCheckInterval = std::chrono::seconds(10);
@@ -1283,7 +2238,7 @@ namespace kolosal
             }
 
             auto now = std::chrono::steady_clock::now();
-            ServerLogger::logDebug("Autoscaling check at %lld (next check interval was: %lld seconds)",
+            KOLOSAL_LOG_DEBUG("Autoscaling check at %lld (next check interval was: %lld seconds)",
                                    std::chrono::duration_cast<std::chrono::seconds>(now.time_since_epoch()).count(),
                                    std::chrono::duration_cast<std::chrono::seconds>(nextCheckInterval).count());
 
@@ -1315,29 +2270,34 @@ namespace kolosal
                 if (recordPtr->isLoaded.load() && recordPtr->engine && !recordPtr->markedForRemoval.load())
                 {
                     hasLoadedEngines = true;
-                    auto idleDuration = std::chrono::duration_cast<std::chrono::seconds>(now - recordPtr->lastActivityTime);
+                    auto idleDuration = std::chrono::duration_cast<std::chrono::seconds>(now - recordPtr->lastActivity());
 
                     if (idleDuration >= idleTimeout_)
                     {
                         // Check if the engine has any active jobs before unloading
-                        if (recordPtr->engine->hasActiveJobs())
+                        bool busy = recordPtr->engine->hasActiveJobs();
+                        for (const auto &replica : recordPtr->replicas)
                         {
-                            ServerLogger::logDebug("Engine ID \'%s\' has been idle for %lld seconds but has active jobs. Skipping unload.",
+                            busy = replica->hasActiveJobs() || busy;
+                        }
+                        if (busy)
+                        {
+                            KOLOSAL_LOG_DEBUG("Engine ID \'%s\' has been idle for %lld seconds but has active jobs. Skipping unload.",
                                                    engineId.c_str(), idleDuration.count());
                             continue;
                         }
 
-                        ServerLogger::logInfo("Engine ID \'%s\' has been idle for %lld seconds (threshold: %llds). Unloading.",
+                        if (!withdrawServing(*recordPtr, now - idleTimeout_))
+                            continue;
+
+                        KOLOSAL_LOG_INFO("Engine ID \'%s\' has been idle for %lld seconds (threshold: %llds). Unloading.",
                                               engineId.c_str(), idleDuration.count(), idleTimeout_.count());
-                        recordPtr->engine->unloadModel();
-                        recordPtr->isLoaded.store(false);
-                        recordPtr->engine = nullptr;
-                        ServerLogger::logInfo("Engine ID \'%s\' unloaded due to inactivity.", engineId.c_str());
+                        hibernateEngine(engineId, *recordPtr);
                     }
                     else
                     {
                         // Calculate when this engine will become idle
-                        auto timeWhenIdle = recordPtr->lastActivityTime + idleTimeout_;
+                        auto timeWhenIdle = recordPtr->lastActivity() + idleTimeout_;
                         if (timeWhenIdle < nextCheckTime)
                         {
                             nextCheckTime = timeWhenIdle;
@@ -1346,6 +2306,9 @@ namespace kolosal
                 }
             }
 
+            enforceMemoryBudget(engineSnapshot, now);
+            schedulePreload(engineSnapshot, now);
+
             // If no loaded engines, use longer interval
             if (!hasLoadedEngines)
             {
@@ -1363,9 +2326,9 @@ namespace kolosal
             // Set the next check interval for the next iteration
             nextCheckInterval = timeUntilNextCheck;
 
-            ServerLogger::logDebug("Next autoscaling check in %lld seconds", timeUntilNextCheck.count());
+            KOLOSAL_LOG_DEBUG("Next autoscaling check in %lld seconds", timeUntilNextCheck.count());
         }
-        ServerLogger::logInfo("Autoscaling thread finished.");
+        KOLOSAL_LOG_INFO("Autoscaling thread finished.");
     }
 
     bool NodeManager::registerEngine(const std::string &engineId, const char *modelPath, const LoadingParameters &loadParams, int mainGpuId, const std::string &engineType)
@@ -1375,16 +2338,16 @@ namespace kolosal
             std::shared_lock<std::shared_mutex> mapLock(engineMapMutex_);
             if (engines_.count(engineId))
             {
-                ServerLogger::logWarning("Engine with ID \'%s\' already exists.", engineId.c_str());
+                KOLOSAL_LOG_WARNING("Engine with ID \'%s\' already exists.", engineId.c_str());
                 return false;
             }
         }
 
         // Validate model file outside of any locks
-        ServerLogger::logInfo("Validating model file for engine registration \'%s\': %s", engineId.c_str(), modelPath);
+        KOLOSAL_LOG_INFO("Validating model file for engine registration \'%s\': %s", engineId.c_str(), modelPath);
         if (!validateModelFile(modelPath))
         {
-            ServerLogger::logError("Model validation failed for engine \'%s\'. Skipping engine registration.", engineId.c_str());
+            KOLOSAL_LOG_ERROR("Model validation failed for engine \'%s\'. Skipping engine registration.", engineId.c_str());
             return false;
         }
 
@@ -1407,9 +2370,9 @@ namespace kolosal
         recordPtr->loadParams = loadParams;
         recordPtr->mainGpuId = mainGpuId;
         recordPtr->isLoaded.store(false); // Mark as not loaded for lazy loading
-        recordPtr->lastActivityTime = std::chrono::steady_clock::now();
+        recordPtr->touch(std::chrono::steady_clock::now());
 
-        ServerLogger::logInfo("Registering engine '%s' with engine type '%s' (passed: '%s')", 
+        KOLOSAL_LOG_INFO("Registering engine '%s' with engine type '%s' (passed: '%s')", 
                             engineId.c_str(), recordPtr->engineType.c_str(), engineType.c_str());
 
         {
@@ -1417,13 +2380,14 @@ namespace kolosal
             // Double-check pattern to ensure no race condition
             if (engines_.count(engineId))
             {
-                ServerLogger::logWarning("Engine with ID \'%s\' was registered by another thread.", engineId.c_str());
+                KOLOSAL_LOG_WARNING("Engine with ID \'%s\' was registered by another thread.", engineId.c_str());
                 return false;
             }
             engines_[engineId] = recordPtr;
+            publishEnginesLocked();
         }
 
-        ServerLogger::logInfo("Successfully registered engine with ID \'%s\' for lazy loading. Model: %s", engineId.c_str(), actualModelPath.c_str());
+        KOLOSAL_LOG_INFO("Successfully registered engine with ID \'%s\' for lazy loading. Model: %s", engineId.c_str(), actualModelPath.c_str());
         
         // Save model to configuration file
         saveModelToConfig(engineId, modelPath, loadParams, mainGpuId, engineType, false);
@@ -1438,13 +2402,30 @@ namespace kolosal
         std::string engineType = !config.defaultInferenceEngine.empty() ? 
                                  config.defaultInferenceEngine : getPlatformDefaultInferenceEngine();
         
-        ServerLogger::logInfo("Using inference engine '%s' for model registration '%s' (platform default)", 
+        KOLOSAL_LOG_INFO("Using inference engine '%s' for model registration '%s' (platform default)", 
                             engineType.c_str(), engineId.c_str());
         
         // Call the main registerEngine method with the determined engine type
         return registerEngine(engineId, modelPath, loadParams, mainGpuId, engineType);
     }
 
+    float NodeManager::getEngineLoadProgress(const std::string &engineId) const
+    {
+        std::shared_ptr<EngineRecord> recordPtr;
+        {
+            std::shared_lock<std::shared_mutex> mapLock(engineMapMutex_);
+            auto it = engines_.find(engineId);
+            if (it == engines_.end() || !it->second)
+                return -1.0f;
+            recordPtr = it->second;
+        }
+
+        std::lock_guard<std::mutex> engineLock(recordPtr->engineMutex);
+        if (recordPtr->isLoaded.load())
+            return 1.0f;
+        return recordPtr->loadingEngine ? recordPtr->loadingEngine->getLoadProgress() : 0.0f;
+    }
+
     std::pair<bool, bool> NodeManager::getEngineStatus(const std::string &engineId) const
     {
         std::shared_lock<std::shared_mutex> mapLock(engineMapMutex_);
@@ -1463,9 +2444,17 @@ namespace kolosal
         return std::make_pair(true, recordPtr->isLoaded.load()); // Engine exists, return load status
     }
 
+    bool NodeManager::isEngineHibernated(const std::string &engineId) const
+    {
+        std::shared_lock<std::shared_mutex> mapLock(engineMapMutex_);
+        auto it = engines_.find(engineId);
+        return it != engines_.end() && it->second && !it->second->markedForRemoval.load() &&
+               it->second->isHibernated.load();
+    }
+
     std::string NodeManager::handleUrlDownload(const std::string &engineId, const std::string &modelPath)
     {
-        ServerLogger::logInfo("Model path for engine \'%s\' is a URL. Starting download: %s", engineId.c_str(), modelPath.c_str());
+        KOLOSAL_LOG_INFO("Model path for engine \'%s\' is a URL. Starting download: %s", engineId.c_str(), modelPath.c_str());
 
     // Generate local path for the downloaded model - use user-writable models directory
     std::string downloadsDir = get_executable_models_directory();
@@ -1477,83 +2466,72 @@ namespace kolosal
             // Check if we can resume this download (file might be incomplete)
             if (can_resume_download(modelPath, localPath))
             {
-                ServerLogger::logInfo("Found incomplete download for engine '%s', resuming: %s", engineId.c_str(), localPath.c_str());
+                KOLOSAL_LOG_INFO("Found incomplete download for engine '%s', resuming: %s", engineId.c_str(), localPath.c_str());
 
-                // Download the model with progress callback (will resume automatically)
-                auto progressCallback = [&engineId](size_t downloaded, size_t total, double percentage)
+                // A request is waiting on this model, so it goes ahead of queued background downloads
+                // (and resumes automatically); progress is visible under /downloads
+                std::string error;
+                if (!DownloadManager::getInstance().downloadAndWait(engineId, modelPath, localPath, error))
                 {
-                    if (total > 0)
-                    {
-                        ServerLogger::logInfo("Resuming download for engine '%s': %.1f%% (%zu/%zu bytes)",
-                                              engineId.c_str(), percentage, downloaded, total);
-                    }
-                };
-
-                DownloadResult result = download_file(modelPath, localPath, progressCallback);
-
-                if (!result.success)
-                {
-                    ServerLogger::logError("Failed to resume download for engine '%s' from URL '%s': %s",
-                                           engineId.c_str(), modelPath.c_str(), result.error_message.c_str());
+                    KOLOSAL_LOG_ERROR("Failed to resume download for engine '%s' from URL '%s': %s",
+                                           engineId.c_str(), modelPath.c_str(), error.c_str());
                     return "";
                 }
 
-                ServerLogger::logInfo("Successfully completed download for engine '%s' to: %s (%.2f MB)",
-                                      engineId.c_str(), localPath.c_str(),
-                                      static_cast<double>(result.total_bytes) / (1024.0 * 1024.0));
+                KOLOSAL_LOG_INFO("Successfully completed download for engine '%s' to: %s", engineId.c_str(), localPath.c_str());
                 return localPath;
             }
             else
             {
-                ServerLogger::logInfo("Model file already exists locally for engine \'%s\': %s", engineId.c_str(), localPath.c_str());
+                KOLOSAL_LOG_INFO("Model file already exists locally for engine \'%s\': %s", engineId.c_str(), localPath.c_str());
                 return localPath;
             }
         }
         else
         {
-            // Download the model with progress callback
-            auto progressCallback = [&engineId](size_t downloaded, size_t total, double percentage)
-            {
-                if (total > 0)
-                {
-                    ServerLogger::logInfo("Downloading model for engine \'%s\': %.1f%% (%zu/%zu bytes)",
-                                          engineId.c_str(), percentage, downloaded, total);
-                }
-            };
-
-            DownloadResult result = download_file(modelPath, localPath, progressCallback);
-
-            if (!result.success)
+            // A request is waiting on this model, so it goes ahead of queued background downloads
+            std::string error;
+            if (!DownloadManager::getInstance().downloadAndWait(engineId, modelPath, localPath, error))
             {
-                ServerLogger::logError("Failed to download model for engine \'%s\' from URL \'%s\': %s",
-                                       engineId.c_str(), modelPath.c_str(), result.error_message.c_str());
+                KOLOSAL_LOG_ERROR("Failed to download model for engine \'%s\' from URL \'%s\': %s",
+                                       engineId.c_str(), modelPath.c_str(), error.c_str());
                 return "";
             }
 
-            ServerLogger::logInfo("Successfully downloaded model for engine \'%s\' to: %s (%.2f MB)",
-                                  engineId.c_str(), localPath.c_str(),
-                                  static_cast<double>(result.total_bytes) / (1024.0 * 1024.0));
+            KOLOSAL_LOG_INFO("Successfully downloaded model for engine \'%s\' to: %s", engineId.c_str(), localPath.c_str());
             return localPath;
         }
     }
 
     bool NodeManager::registerEmbeddingEngine(const std::string &engineId, const char *modelPath, const LoadingParameters &loadParams, int mainGpuId)
     {
+        return registerEncoderEngine(engineId, modelPath, loadParams, mainGpuId, ModelType::EMBEDDING);
+    }
+
+    bool NodeManager::registerRerankEngine(const std::string &engineId, const char *modelPath, const LoadingParameters &loadParams, int mainGpuId)
+    {
+        return registerEncoderEngine(engineId, modelPath, loadParams, mainGpuId, ModelType::RERANK);
+    }
+
+    bool NodeManager::registerEncoderEngine(const std::string &engineId, const char *modelPath, const LoadingParameters &loadParams, int mainGpuId, ModelType type)
+    {
+        const char *kind = modelTypeName(type);
+
         // First check if engine already exists (read lock)
         {
             std::shared_lock<std::shared_mutex> mapLock(engineMapMutex_);
             if (engines_.count(engineId))
             {
-                ServerLogger::logWarning("Embedding engine with ID \'%s\' already exists.", engineId.c_str());
+                KOLOSAL_LOG_WARNING("Engine with ID \'%s\' already exists.", engineId.c_str());
                 return false;
             }
         }
 
         // Validate model file outside of any locks
-        ServerLogger::logInfo("Validating embedding model file for engine registration \'%s\': %s", engineId.c_str(), modelPath);
+        KOLOSAL_LOG_INFO("Validating %s model file for engine registration \'%s\': %s", kind, engineId.c_str(), modelPath);
         if (!validateModelFile(modelPath))
         {
-            ServerLogger::logError("Embedding model validation failed for engine \'%s\'. Skipping engine registration.", engineId.c_str());
+            KOLOSAL_LOG_ERROR("Model validation failed for engine \'%s\'. Skipping engine registration.", engineId.c_str());
             return false;
         }
 
@@ -1573,32 +2551,34 @@ namespace kolosal
         recordPtr->engine = nullptr;            // No engine instance yet
         recordPtr->modelPath = actualModelPath; // Store the actual local path
         
-        // Use the default inference engine for embedding models if available
+        // Use the default inference engine for embedding and rerank models if available
         auto& config = ServerConfig::getInstance();
         std::string engineType = !config.defaultInferenceEngine.empty() ? 
                                  config.defaultInferenceEngine : getPlatformDefaultInferenceEngine();
         recordPtr->engineType = engineType;    // Use appropriate engine type
-        ServerLogger::logInfo("Registering embedding model '%s' with inference engine '%s'", 
-                            engineId.c_str(), engineType.c_str());
+        KOLOSAL_LOG_INFO("Registering %s model '%s' with inference engine '%s'", 
+                            kind, engineId.c_str(), engineType.c_str());
         
         recordPtr->loadParams = loadParams;
         recordPtr->mainGpuId = mainGpuId;
         recordPtr->isLoaded.store(false); // Mark as not loaded for lazy loading
-        recordPtr->isEmbeddingModel.store(true); // Mark as embedding model
-        recordPtr->lastActivityTime = std::chrono::steady_clock::now();
+        recordPtr->isEmbeddingModel.store(true); // Runs on the embedding service
+        recordPtr->isRerankModel.store(type == ModelType::RERANK);
+        recordPtr->touch(std::chrono::steady_clock::now());
 
         {
             std::unique_lock<std::shared_mutex> mapLock(engineMapMutex_);
             // Double-check pattern to ensure no race condition
             if (engines_.count(engineId))
             {
-                ServerLogger::logWarning("Embedding engine with ID \'%s\' was registered by another thread.", engineId.c_str());
+                KOLOSAL_LOG_WARNING("Engine with ID \'%s\' was registered by another thread.", engineId.c_str());
                 return false;
             }
             engines_[engineId] = recordPtr;
+            publishEnginesLocked();
         }
 
-        ServerLogger::logInfo("Successfully registered embedding engine with ID \'%s\' for lazy loading. Model: %s", engineId.c_str(), actualModelPath.c_str());
+        KOLOSAL_LOG_INFO("Successfully registered %s engine with ID \'%s\' for lazy loading. Model: %s", kind, engineId.c_str(), actualModelPath.c_str());
         return true;
     }
 
@@ -1606,23 +2586,23 @@ namespace kolosal
     {
         if (!inferenceLoader_)
         {
-            ServerLogger::logError("InferenceLoader not initialized");
+            KOLOSAL_LOG_ERROR("InferenceLoader not initialized");
             return false;
         }
 
-        ServerLogger::logInfo("Reconfiguring inference engines with %zu engine(s)", engines.size());
+        KOLOSAL_LOG_INFO("Reconfiguring inference engines with %zu engine(s)", engines.size());
         
         if (!inferenceLoader_->configureEngines(engines))
         {
-            ServerLogger::logError("Failed to reconfigure inference engines");
+            KOLOSAL_LOG_ERROR("Failed to reconfigure inference engines");
             return false;
         }
 
         auto availableEngines = inferenceLoader_->getAvailableEngines();
-        ServerLogger::logInfo("Successfully reconfigured %zu inference engines:", availableEngines.size());
+        KOLOSAL_LOG_INFO("Successfully reconfigured %zu inference engines:", availableEngines.size());
         for (const auto &engine : availableEngines)
         {
-            ServerLogger::logInfo("  - %s: %s", engine.name.c_str(), engine.description.c_str());
+            KOLOSAL_LOG_INFO("  - %s: %s", engine.name.c_str(), engine.description.c_str());
         }
 
         return true;
@@ -1660,10 +2640,17 @@ namespace kolosal
         return listEngineIds();
     }
 
+    void NodeManager::suspendConfigWrites(bool suspend)
+    {
+        configWritesSuspended = suspend;
+    }
+
     bool NodeManager::saveModelToConfig(const std::string& engineId, const std::string& modelPath, 
                                       const LoadingParameters& loadParams, int mainGpuId, 
                                       const std::string& inferenceEngine, bool loadImmediately)
     {
+        if (configWritesSuspended)
+            return true;
         try
         {
             auto &config = ServerConfig::getInstance();
@@ -1676,7 +2663,7 @@ namespace kolosal
                 (actualInferenceEngine.empty() || actualInferenceEngine == platformDefault))
             {
                 actualInferenceEngine = config.defaultInferenceEngine;
-                ServerLogger::logInfo("Using default inference engine '%s' for model '%s' instead of '%s'", 
+                KOLOSAL_LOG_INFO("Using default inference engine '%s' for model '%s' instead of '%s'", 
                                     actualInferenceEngine.c_str(), engineId.c_str(), inferenceEngine.c_str());
             }
             
@@ -1687,7 +2674,7 @@ namespace kolosal
                 if (existingModel.id == engineId)
                 {
                     modelExistsInConfig = true;
-                    ServerLogger::logInfo("Model '%s' already exists in configuration, updating it", engineId.c_str());
+                    KOLOSAL_LOG_INFO("Model '%s' already exists in configuration, updating it", engineId.c_str());
                     break;
                 }
             }
@@ -1709,7 +2696,7 @@ namespace kolosal
                 modelConfig.loadParams = loadParams;
                 
                 config.models.push_back(modelConfig);
-                ServerLogger::logInfo("Added model '%s' to configuration", engineId.c_str());
+                KOLOSAL_LOG_INFO("Added model '%s' to configuration", engineId.c_str());
             }
             else
             {
@@ -1728,16 +2715,16 @@ namespace kolosal
                         existingModel.mainGpuId = mainGpuId;
                         existingModel.inferenceEngine = actualInferenceEngine;
                         existingModel.loadParams = loadParams;
-                        ServerLogger::logInfo("Updated model '%s' in configuration", engineId.c_str());
+                        KOLOSAL_LOG_INFO("Updated model '%s' in configuration", engineId.c_str());
                         break;
                     }
                 }
             }
             
             // Save the updated configuration
-            ServerLogger::logInfo("About to save configuration for model '%s'", engineId.c_str());
-            ServerLogger::logInfo("Current config file path in NodeManager: '%s'", config.getCurrentConfigFilePath().c_str());
-            ServerLogger::logInfo("ServerConfig instance address during model save: %lu", reinterpret_cast<uintptr_t>(&config));
+            KOLOSAL_LOG_INFO("About to save configuration for model '%s'", engineId.c_str());
+            KOLOSAL_LOG_INFO("Current config file path in NodeManager: '%s'", config.getCurrentConfigFilePath().c_str());
+            KOLOSAL_LOG_INFO("ServerConfig instance address during model save: %lu", reinterpret_cast<uintptr_t>(&config));
             
             auto canWritePathModel = [&config]() -> bool {
                 std::string path = config.getCurrentConfigFilePath();
@@ -1749,26 +2736,28 @@ namespace kolosal
             {
                 if (!config.saveToCurrentFile())
                 {
-                    ServerLogger::logWarning("Failed to save configuration to file for model '%s'. Configuration changes are in memory only.", engineId.c_str());
+                    KOLOSAL_LOG_WARNING("Failed to save configuration to file for model '%s'. Configuration changes are in memory only.", engineId.c_str());
                     return false;
                 }
-                ServerLogger::logInfo("Successfully saved model '%s' to configuration file", engineId.c_str());
+                KOLOSAL_LOG_INFO("Successfully saved model '%s' to configuration file", engineId.c_str());
             }
             else
             {
-                ServerLogger::logInfo("Skipping saving model '%s' to config (not writable and KOLOSAL_ALLOW_CONFIG_SAVE not set)", engineId.c_str());
+                KOLOSAL_LOG_INFO("Skipping saving model '%s' to config (not writable and KOLOSAL_ALLOW_CONFIG_SAVE not set)", engineId.c_str());
             }
             return true;
         }
         catch (const std::exception &ex)
         {
-            ServerLogger::logError("Exception while saving model '%s' to config: %s", engineId.c_str(), ex.what());
+            KOLOSAL_LOG_ERROR("Exception while saving model '%s' to config: %s", engineId.c_str(), ex.what());
             return false;
         }
     }
 
     bool NodeManager::removeModelFromConfig(const std::string& engineId)
     {
+        if (configWritesSuspended)
+            return true;
         try
         {
             auto &config = ServerConfig::getInstance();
@@ -1782,12 +2771,12 @@ namespace kolosal
             if (it != config.models.end())
             {
                 config.models.erase(it);
-                ServerLogger::logInfo("Removed model '%s' from configuration", engineId.c_str());
+                KOLOSAL_LOG_INFO("Removed model '%s' from configuration", engineId.c_str());
                 
                 // Save the updated configuration
-                ServerLogger::logInfo("About to save configuration after removing model '%s'", engineId.c_str());
-                ServerLogger::logInfo("Current config file path in NodeManager: '%s'", config.getCurrentConfigFilePath().c_str());
-                ServerLogger::logInfo("ServerConfig instance address during model removal: %lu", reinterpret_cast<uintptr_t>(&config));
+                KOLOSAL_LOG_INFO("About to save configuration after removing model '%s'", engineId.c_str());
+                KOLOSAL_LOG_INFO("Current config file path in NodeManager: '%s'", config.getCurrentConfigFilePath().c_str());
+                KOLOSAL_LOG_INFO("ServerConfig instance address during model removal: %lu", reinterpret_cast<uintptr_t>(&config));
                 
                 auto canWritePathRemove = [&config]() -> bool {
                     std::string path = config.getCurrentConfigFilePath();
@@ -1799,26 +2788,26 @@ namespace kolosal
                 {
                     if (!config.saveToCurrentFile())
                     {
-                        ServerLogger::logWarning("Failed to save configuration to file after removing model '%s'. Configuration changes are in memory only.", engineId.c_str());
+                        KOLOSAL_LOG_WARNING("Failed to save configuration to file after removing model '%s'. Configuration changes are in memory only.", engineId.c_str());
                         return false;
                     }
-                    ServerLogger::logInfo("Successfully updated configuration file after removing model '%s'", engineId.c_str());
+                    KOLOSAL_LOG_INFO("Successfully updated configuration file after removing model '%s'", engineId.c_str());
                 }
                 else
                 {
-                    ServerLogger::logInfo("Skipping config update after removing model '%s' (not writable and KOLOSAL_ALLOW_CONFIG_SAVE not set)", engineId.c_str());
+                    KOLOSAL_LOG_INFO("Skipping config update after removing model '%s' (not writable and KOLOSAL_ALLOW_CONFIG_SAVE not set)", engineId.c_str());
                 }
                 return true;
             }
             else
             {
-                ServerLogger::logInfo("Model '%s' was not found in configuration", engineId.c_str());
+                KOLOSAL_LOG_INFO("Model '%s' was not found in configuration", engineId.c_str());
                 return true; // Not an error if model wasn't in config
             }
         }
         catch (const std::exception &ex)
         {
-            ServerLogger::logError("Exception while removing model '%s' from config: %s", engineId.c_str(), ex.what());
+            KOLOSAL_LOG_ERROR("Exception while removing model '%s' from config: %s", engineId.c_str(), ex.what());
             return false;
         }
     }
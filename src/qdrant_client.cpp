@@ -5,13 +5,17 @@
 #include <sstream>
 #include <chrono>
 #include <mutex>
-#include <condition_variable>
 #include <queue>
 #include <future>
 #include <memory>
 #include <random>
 #include <map>
 #include <atomic>
+#include <algorithm>
+#include <vector>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
 
 namespace kolosal
 {
@@ -24,6 +28,71 @@ static size_t WriteCallback(void* contents, size_t size, size_t nmemb, std::stri
     return totalSize;
 }
 
+namespace
+{
+    constexpr size_t kUpsertChunkPoints = 256;   // Points per request when a large upsert is split
+    constexpr size_t kLatencySamples = 512;      // Recent search latencies the hedge delay is taken from
+    constexpr size_t kMinHedgeSamples = 64;      // Searches timed before any is hedged
+    constexpr size_t kHedgeDelayRefresh = 32;    // Searches between recomputations of the p95
+    constexpr long kIdlePollMs = 1000;
+
+    // Append a vector as a JSON array. nlohmann widens each float to double and prints up
+    // to 17 digits; the shortest form that round-trips the float is about half as long and
+    // much cheaper to produce, and vectors are nearly all of an upsert body.
+    void appendVector(std::string& out, const std::vector<float>& values)
+    {
+        char buffer[32];
+        out.push_back('[');
+        for (size_t i = 0; i < values.size(); ++i)
+        {
+            if (i > 0)
+            {
+                out.push_back(',');
+            }
+            if (!std::isfinite(values[i]))
+            {
+                out.append("null");     // As nlohmann writes non-finite numbers
+                continue;
+            }
+#if defined(__cpp_lib_to_chars)
+            auto converted = std::to_chars(buffer, buffer + sizeof(buffer), values[i]);
+            out.append(buffer, converted.ptr);
+#else
+            int length = std::snprintf(buffer, sizeof(buffer), "%.9g", values[i]);
+            out.append(buffer, static_cast<size_t>(length));
+#endif
+        }
+        out.push_back(']');
+    }
+
+    std::string upsertBody(const std::vector<QdrantPoint>& points, size_t begin, size_t end)
+    {
+        std::string body;
+        body.reserve(16 + (end - begin) * (64 + (points.empty() ? 0 : points[begin].vector.size() * 12)));
+        body.append("{\"points\":[");
+        for (size_t i = begin; i < end; ++i)
+        {
+            if (i > begin)
+            {
+                body.push_back(',');
+            }
+            body.append("{\"id\":").append(nlohmann::json(points[i].id).dump());
+            body.append(",\"vector\":");
+            appendVector(body, points[i].vector);
+            body.append(",\"payload\":").append(nlohmann::json(points[i].payload).dump());
+            body.push_back('}');
+        }
+        body.append("]}");
+        return body;
+    }
+
+    // Search's with_payload selector: every field, or only the listed ones
+    nlohmann::json withPayload(const std::vector<std::string>& fields)
+    {
+        return fields.empty() ? nlohmann::json(true) : nlohmann::json{{"include", fields}};
+    }
+}
+
 // HTTP request structure
 struct HttpRequest
 {
@@ -32,12 +101,24 @@ struct HttpRequest
     std::string body;
     std::map<std::string, std::string> headers;
     int timeout = 30;
+    std::string endpoint;                                   // Path, to resend the request to a replica
+    std::chrono::steady_clock::time_point deadline{};       // Fail with 504 once passed (epoch = none)
+    std::chrono::steady_clock::time_point started{};        // When the first attempt was sent
+    
+    // Hedging, all owned by the worker thread
+    bool hedgeable = false;     // Idempotent search that may run twice
+    bool hedged = false;        // A second attempt was sent, or this is it
+    size_t base = 0;            // Index into the client's base URLs
+    CURL* twin = nullptr;       // The other attempt while both are in flight
     
     // Response data
     std::string response_body;
     long response_code = 0;
     std::string error_message;
     
+    // Header list handed to curl; freed once the transfer completes
+    struct curl_slist* header_list = nullptr;
+    
     // Promise for async operations
     std::shared_ptr<std::promise<QdrantResult>> promise;
 };
@@ -59,33 +140,74 @@ public:
     CURLM* multi_handle_;
     std::queue<std::shared_ptr<HttpRequest>> request_queue_;
     std::mutex queue_mutex_;
-    std::condition_variable queue_cv_;
     std::thread worker_thread_;
     std::atomic<bool> shutdown_{false};
     
+    std::vector<std::string> base_urls_;   // host first, then the replicas
+    
+    // Owned by the worker thread
+    std::map<CURL*, std::shared_ptr<HttpRequest>> in_flight_;
+    std::vector<CURL*> idle_handles_;   // Finished easy handles, reset and reused
+    std::vector<double> search_latencies_ms_;   // Ring of the last kLatencySamples searches
+    size_t next_latency_ = 0;
+    size_t latencies_since_refresh_ = 0;
+    double hedge_delay_ms_ = 0.0;       // 0 until enough searches were timed
+    
     Impl(const Config& config) : config_(config)
     {
+        const std::string protocol = config_.useHttps ? "https://" : "http://";
+        base_urls_.push_back(protocol + config_.host + ":" + std::to_string(config_.port));
+        for (const auto& replica : config_.replicas)
+        {
+            if (replica.find("://") != std::string::npos)
+            {
+                base_urls_.push_back(replica.back() == '/' ? replica.substr(0, replica.size() - 1) : replica);
+            }
+            else
+            {
+                base_urls_.push_back(protocol + replica +
+                                     (replica.find(':') == std::string::npos ? ":" + std::to_string(config_.port) : ""));
+            }
+        }
+        search_latencies_ms_.reserve(kLatencySamples);
+        
         // Initialize libcurl
         curl_global_init(CURL_GLOBAL_DEFAULT);
         multi_handle_ = curl_multi_init();
         
+        // Connections to the server are cached and reused by every easy handle in the
+        // multi handle; cap them so maxConnections bounds both sockets and transfers
+        const long max_connections = static_cast<long>(std::max(1, config_.maxConnections));
+        curl_multi_setopt(multi_handle_, CURLMOPT_MAX_HOST_CONNECTIONS, max_connections);
+        curl_multi_setopt(multi_handle_, CURLMOPT_MAXCONNECTS, max_connections);
+        if (config_.http2)
+        {
+            curl_multi_setopt(multi_handle_, CURLMOPT_PIPELINING, static_cast<long>(CURLPIPE_MULTIPLEX));
+        }
+        
         // Start worker thread
         worker_thread_ = std::thread(&Impl::workerLoop, this);
         
-        ServerLogger::logInfo("QdrantClient initialized - Host: %s:%d", 
-                              config_.host.c_str(), config_.port);
+        const std::string hedging = config_.hedge ? ", searches hedged over " + std::to_string(base_urls_.size()) + " node(s)" : "";
+        KOLOSAL_LOG_INFO("QdrantClient initialized - Host: %s:%d, connections: %ld%s%s", 
+                              config_.host.c_str(), config_.port, max_connections, config_.http2 ? ", HTTP/2" : "", hedging.c_str());
     }
     
     ~Impl()
     {
         shutdown_ = true;
-        queue_cv_.notify_all();
+        curl_multi_wakeup(multi_handle_);
         
         if (worker_thread_.joinable())
         {
             worker_thread_.join();
         }
         
+        for (CURL* handle : idle_handles_)
+        {
+            curl_easy_cleanup(handle);
+        }
+        
         if (multi_handle_)
         {
             curl_multi_cleanup(multi_handle_);
@@ -94,21 +216,26 @@ public:
         curl_global_cleanup();
     }
     
-    std::string buildUrl(const std::string& endpoint) const
+    std::string buildUrl(const std::string& endpoint, size_t base = 0) const
     {
-        std::string protocol = config_.useHttps ? "https" : "http";
-        return protocol + "://" + config_.host + ":" + std::to_string(config_.port) + endpoint;
+        return base_urls_[base] + endpoint;
     }
     
+    // hedgeable marks requests that are safe to send twice (searches)
     std::future<QdrantResult> makeRequest(const std::string& method, 
                                          const std::string& endpoint,
-                                         const std::string& body = "")
+                                         const std::string& body = "",
+                                         std::chrono::steady_clock::time_point deadline = {},
+                                         bool hedgeable = false)
     {
         auto request = std::make_shared<HttpRequest>();
         request->method = method;
         request->url = buildUrl(endpoint);
+        request->endpoint = endpoint;
         request->body = body;
         request->timeout = config_.timeout;
+        request->deadline = deadline;
+        request->hedgeable = hedgeable && config_.hedge;
         request->promise = std::make_shared<std::promise<QdrantResult>>();
         
         // Set headers
@@ -125,69 +252,223 @@ public:
             std::lock_guard<std::mutex> lock(queue_mutex_);
             request_queue_.push(request);
         }
-        queue_cv_.notify_one();
+        curl_multi_wakeup(multi_handle_);
         
         return future;
     }
     
+    // Drives every transfer from one thread: queued requests are started while fewer than
+    // maxConnections are in flight, curl_multi_perform advances all of them, and
+    // curl_multi_poll sleeps until a socket is ready, makeRequest() wakes it or a hedge is due
     void workerLoop()
     {
+        const size_t max_in_flight = static_cast<size_t>(std::max(1, config_.maxConnections));
         while (!shutdown_)
         {
-            std::shared_ptr<HttpRequest> request;
+            {
+                std::lock_guard<std::mutex> lock(queue_mutex_);
+                while (!request_queue_.empty() && in_flight_.size() < max_in_flight)
+                {
+                    startRequest(request_queue_.front());
+                    request_queue_.pop();
+                }
+            }
+            
+            int running = 0;
+            curl_multi_perform(multi_handle_, &running);
             
-            // Wait for request
+            int remaining = 0;
+            while (CURLMsg* message = curl_multi_info_read(multi_handle_, &remaining))
             {
-                std::unique_lock<std::mutex> lock(queue_mutex_);
-                queue_cv_.wait(lock, [this] { return !request_queue_.empty() || shutdown_; });
-                
-                if (shutdown_)
-                    break;
-                
-                request = request_queue_.front();
-                request_queue_.pop();
+                if (message->msg == CURLMSG_DONE)
+                {
+                    finishRequest(message->easy_handle, message->data.result);
+                }
             }
             
-            // Execute request
-            executeRequest(request);
+            const long wait_ms = sendHedges(max_in_flight);
+            curl_multi_poll(multi_handle_, nullptr, 0, static_cast<int>(wait_ms), nullptr);
+        }
+        
+        // Fail whatever is still pending so no caller waits forever; of two attempts of a
+        // hedged search the last one removed answers
+        while (!in_flight_.empty())
+        {
+            auto it = in_flight_.begin();
+            CURL* handle = it->first;
+            auto request = std::move(it->second);
+            in_flight_.erase(it);
+            curl_multi_remove_handle(multi_handle_, handle);
+            curl_easy_cleanup(handle);
+            failRequest(request, "Qdrant client shut down");
+        }
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        while (!request_queue_.empty())
+        {
+            failRequest(request_queue_.front(), "Qdrant client shut down");
+            request_queue_.pop();
+        }
+    }
+    
+    // Starts a second attempt of every hedgeable search older than the hedge delay, while
+    // connections are free. Returns how long the worker may sleep before the next is due.
+    long sendHedges(size_t max_in_flight)
+    {
+        if (!config_.hedge || hedge_delay_ms_ <= 0.0)
+        {
+            return kIdlePollMs;
+        }
+        
+        const auto now = std::chrono::steady_clock::now();
+        const auto delay = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double, std::milli>(hedge_delay_ms_));
+        long wait_ms = kIdlePollMs;
+        std::vector<std::pair<CURL*, std::shared_ptr<HttpRequest>>> due;
+        for (const auto& [handle, request] : in_flight_)
+        {
+            if (!request->hedgeable || request->hedged)
+            {
+                continue;
+            }
+            const auto hedge_at = request->started + delay;
+            if (hedge_at <= now)
+            {
+                due.emplace_back(handle, request);
+            }
+            else
+            {
+                wait_ms = std::min(wait_ms, static_cast<long>(
+                    std::chrono::duration_cast<std::chrono::milliseconds>(hedge_at - now).count()) + 1);
+            }
+        }
+        
+        for (auto& [handle, request] : due)
+        {
+            // A hedge never takes a connection a first attempt is waiting for
+            if (in_flight_.size() >= max_in_flight)
+            {
+                break;
+            }
+            request->hedged = true;
+            
+            auto attempt = std::make_shared<HttpRequest>();
+            attempt->method = request->method;
+            attempt->base = (request->base + 1) % base_urls_.size();
+            attempt->url = buildUrl(request->endpoint, attempt->base);
+            attempt->endpoint = request->endpoint;
+            attempt->body = request->body;
+            attempt->headers = request->headers;
+            attempt->timeout = request->timeout;
+            attempt->deadline = request->deadline;
+            attempt->started = request->started;
+            attempt->hedgeable = true;
+            attempt->hedged = true;
+            attempt->twin = handle;
+            attempt->promise = request->promise;
+            
+            KOLOSAL_LOG_DEBUG("Hedging Qdrant request %s to %s after %.1f ms", request->endpoint.c_str(),
+                              base_urls_[attempt->base].c_str(), hedge_delay_ms_);
+            if (CURL* second = startRequest(std::move(attempt)))
+            {
+                request->twin = second;
+            }
+        }
+        return wait_ms;
+    }
+    
+    void recordSearchLatency(double ms)
+    {
+        if (search_latencies_ms_.size() < kLatencySamples)
+        {
+            search_latencies_ms_.push_back(ms);
+        }
+        else
+        {
+            search_latencies_ms_[next_latency_] = ms;
+            next_latency_ = (next_latency_ + 1) % kLatencySamples;
+        }
+        
+        if (++latencies_since_refresh_ >= kHedgeDelayRefresh && search_latencies_ms_.size() >= kMinHedgeSamples)
+        {
+            latencies_since_refresh_ = 0;
+            std::vector<double> sorted = search_latencies_ms_;
+            auto p95 = sorted.begin() + static_cast<std::ptrdiff_t>(sorted.size() * 95 / 100);
+            std::nth_element(sorted.begin(), p95, sorted.end());
+            hedge_delay_ms_ = std::max(static_cast<double>(config_.hedgeMinDelayMs), *p95);
         }
     }
     
-    void executeRequest(std::shared_ptr<HttpRequest> request)
+    // Returns the handle the request runs on, or null if it failed to start
+    CURL* startRequest(std::shared_ptr<HttpRequest> request)
     {
-        CURL* curl = curl_easy_init();
+        const auto now = std::chrono::steady_clock::now();
+        if (request->started == std::chrono::steady_clock::time_point{})
+        {
+            request->started = now;
+        }
+        
+        // Whatever is left of the deadline caps the timeout; a request that queued past it is not sent
+        long timeout_ms = static_cast<long>(request->timeout) * 1000;
+        if (request->deadline != std::chrono::steady_clock::time_point{})
+        {
+            const long remaining_ms = static_cast<long>(
+                std::chrono::duration_cast<std::chrono::milliseconds>(request->deadline - now).count());
+            if (remaining_ms <= 0)
+            {
+                failRequest(request, "Deadline exceeded before the request was sent", 504);
+                return nullptr;
+            }
+            timeout_ms = timeout_ms > 0 ? std::min(timeout_ms, remaining_ms) : remaining_ms;
+        }
+        
+        CURL* curl = nullptr;
+        if (!idle_handles_.empty())
+        {
+            curl = idle_handles_.back();
+            idle_handles_.pop_back();
+            curl_easy_reset(curl);
+        }
+        else
+        {
+            curl = curl_easy_init();
+        }
         if (!curl)
         {
-            QdrantResult result;
-            result.success = false;
-            result.error_message = "Failed to initialize CURL";
-            request->promise->set_value(result);
-            return;
+            failRequest(request, "Failed to initialize CURL");
+            return nullptr;
         }
         
         // Set basic options
         curl_easy_setopt(curl, CURLOPT_URL, request->url.c_str());
         curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
         curl_easy_setopt(curl, CURLOPT_WRITEDATA, &request->response_body);
-        curl_easy_setopt(curl, CURLOPT_TIMEOUT, request->timeout);
+        curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, timeout_ms);
+        curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, static_cast<long>(config_.connectionTimeout));
         curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+        curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+        curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+        if (config_.http2)
+        {
+            // Plain-text Qdrant speaks h2c only with prior knowledge; over TLS it is negotiated
+            curl_easy_setopt(curl, CURLOPT_HTTP_VERSION,
+                             config_.useHttps ? static_cast<long>(CURL_HTTP_VERSION_2TLS)
+                                              : static_cast<long>(CURL_HTTP_VERSION_2_PRIOR_KNOWLEDGE));
+            curl_easy_setopt(curl, CURLOPT_PIPEWAIT, 1L);
+        }
         
-        // Set method and body
-        if (request->method == "POST")
+        // Set method and body; an empty POSTFIELDS keeps curl from reading the body from stdin
+        if (request->method == "POST" || request->method == "PUT")
         {
-            curl_easy_setopt(curl, CURLOPT_POST, 1L);
-            if (!request->body.empty())
+            if (request->method == "POST")
             {
-                curl_easy_setopt(curl, CURLOPT_POSTFIELDS, request->body.c_str());
+                curl_easy_setopt(curl, CURLOPT_POST, 1L);
             }
-        }
-        else if (request->method == "PUT")
-        {
-            curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "PUT");
-            if (!request->body.empty())
+            else
             {
-                curl_easy_setopt(curl, CURLOPT_POSTFIELDS, request->body.c_str());
+                curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "PUT");
             }
+            curl_easy_setopt(curl, CURLOPT_POSTFIELDS, request->body.c_str());
+            curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE_LARGE, static_cast<curl_off_t>(request->body.size()));
         }
         else if (request->method == "DELETE")
         {
@@ -195,41 +476,121 @@ public:
         }
         
         // Set headers
-        struct curl_slist* headers = nullptr;
         for (const auto& [key, value] : request->headers)
         {
             std::string header = key + ": " + value;
-            headers = curl_slist_append(headers, header.c_str());
+            request->header_list = curl_slist_append(request->header_list, header.c_str());
+        }
+        if (request->header_list)
+        {
+            curl_easy_setopt(curl, CURLOPT_HTTPHEADER, request->header_list);
+        }
+        
+        CURLMcode added = curl_multi_add_handle(multi_handle_, curl);
+        if (added != CURLM_OK)
+        {
+            curl_easy_cleanup(curl);
+            failRequest(request, "CURL error: " + std::string(curl_multi_strerror(added)));
+            return nullptr;
         }
-        if (headers)
+        in_flight_[curl] = std::move(request);
+        return curl;
+    }
+    
+    // Drops an attempt that lost to its twin
+    void cancelAttempt(CURL* curl)
+    {
+        auto it = in_flight_.find(curl);
+        if (it == in_flight_.end())
+        {
+            return;
+        }
+        curl_multi_remove_handle(multi_handle_, curl);
+        idle_handles_.push_back(curl);
+        if (it->second->header_list)
+        {
+            curl_slist_free_all(it->second->header_list);
+        }
+        in_flight_.erase(it);
+    }
+    
+    void finishRequest(CURL* curl, CURLcode code)
+    {
+        auto it = in_flight_.find(curl);
+        if (it == in_flight_.end())
         {
-            curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+            return;
         }
+        auto request = std::move(it->second);
+        in_flight_.erase(it);
         
-        // Perform request
-        CURLcode res = curl_easy_perform(curl);
         curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &request->response_code);
+        curl_multi_remove_handle(multi_handle_, curl);
+        idle_handles_.push_back(curl);
         
         // Parse result
-        QdrantResult result = parseResponse(request, res);
+        QdrantResult result = parseResponse(request, code);
         
         // Cleanup
-        if (headers)
+        if (request->header_list)
         {
-            curl_slist_free_all(headers);
+            curl_slist_free_all(request->header_list);
+            request->header_list = nullptr;
+        }
+        
+        // The first answer of a hedged search wins; a failure leaves the answer to the other attempt
+        if (request->twin && in_flight_.count(request->twin))
+        {
+            if (!result.success && result.status_code != 504)
+            {
+                in_flight_[request->twin]->twin = nullptr;
+                return;
+            }
+            cancelAttempt(request->twin);
+        }
+        if (result.success && request->hedgeable)
+        {
+            recordSearchLatency(std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - request->started).count());
         }
-        curl_easy_cleanup(curl);
         
         // Set promise result
         request->promise->set_value(result);
     }
     
+    void failRequest(const std::shared_ptr<HttpRequest>& request, const std::string& error, int status_code = 0)
+    {
+        if (request->header_list)
+        {
+            curl_slist_free_all(request->header_list);
+            request->header_list = nullptr;
+        }
+        // An attempt whose twin is still running leaves the answer to it
+        if (request->twin && in_flight_.count(request->twin))
+        {
+            in_flight_[request->twin]->twin = nullptr;
+            return;
+        }
+        QdrantResult result;
+        result.success = false;
+        result.error_message = error;
+        result.status_code = status_code;
+        request->promise->set_value(result);
+    }
+    
     QdrantResult parseResponse(std::shared_ptr<HttpRequest> request, CURLcode curl_code)
     {
         QdrantResult result;
         result.success = false;
         result.status_code = static_cast<int>(request->response_code);
         
+        if (curl_code == CURLE_OPERATION_TIMEDOUT && request->deadline != std::chrono::steady_clock::time_point{} &&
+            std::chrono::steady_clock::now() + std::chrono::milliseconds(1) >= request->deadline)
+        {
+            result.error_message = "Deadline exceeded";
+            result.status_code = 504;
+            return result;
+        }
         if (curl_code != CURLE_OK)
         {
             result.error_message = "CURL error: " + std::string(curl_easy_strerror(curl_code));
@@ -336,15 +697,41 @@ std::future<QdrantResult> QdrantClient::upsertPoints(
     const std::string& collection_name,
     const std::vector<QdrantPoint>& points)
 {
-    nlohmann::json body;
-    body["points"] = nlohmann::json::array();
+    const std::string endpoint = "/collections/" + collection_name + "/points";
+    if (points.size() <= kUpsertChunkPoints)
+    {
+        return pImpl->makeRequest("PUT", endpoint, upsertBody(points, 0, points.size()));
+    }
     
-    for (const auto& point : points)
+    // Stream a bulk upsert as consecutive chunks: each is encoded while the earlier ones are
+    // already on the wire, and the transport runs them in parallel over pooled connections.
+    // Chunks may be applied in any order, so an id repeated within one call has no defined winner.
+    std::vector<std::future<QdrantResult>> chunks;
+    for (size_t begin = 0; begin < points.size(); begin += kUpsertChunkPoints)
     {
-        body["points"].push_back(point.to_json());
+        const size_t end = std::min(points.size(), begin + kUpsertChunkPoints);
+        chunks.push_back(pImpl->makeRequest("PUT", endpoint, upsertBody(points, begin, end)));
     }
     
-    return pImpl->makeRequest("PUT", "/collections/" + collection_name + "/points", body.dump());
+    return std::async(std::launch::deferred, [chunks = std::move(chunks)]() mutable {
+        QdrantResult merged;
+        merged.success = true;
+        for (auto& chunk : chunks)
+        {
+            QdrantResult result = chunk.get();
+            if (!result.success && merged.success)
+            {
+                merged = std::move(result);
+            }
+            else if (merged.success)
+            {
+                merged.status_code = result.status_code;
+                merged.operation_id = result.operation_id;
+                merged.response_data = std::move(result.response_data);
+            }
+        }
+        return merged;
+    });
 }
 
 std::future<QdrantResult> QdrantClient::deletePoints(
@@ -373,22 +760,74 @@ std::future<QdrantResult> QdrantClient::search(
     const std::string& collection_name,
     const std::vector<float>& query_vector,
     int limit,
-    float score_threshold)
+    float score_threshold,
+    int hnsw_ef,
+    const nlohmann::json& filter,
+    const std::vector<std::string>& payload_fields,
+    std::chrono::steady_clock::time_point deadline)
 {
     nlohmann::json body;
     body["vector"] = query_vector;
     body["limit"] = limit;
     body["score_threshold"] = score_threshold;
-    body["with_payload"] = true;
+    body["with_payload"] = withPayload(payload_fields);
+    if (hnsw_ef > 0)
+    {
+        body["params"]["hnsw_ef"] = hnsw_ef;
+    }
+    if (!filter.is_null())
+    {
+        body["filter"] = filter;
+    }
     
-    return pImpl->makeRequest("POST", "/collections/" + collection_name + "/points/search", body.dump());
+    return pImpl->makeRequest("POST", "/collections/" + collection_name + "/points/search", body.dump(), deadline, true);
 }
 
-std::future<QdrantResult> QdrantClient::scrollPoints(const std::string& collection_name, int limit, const std::string& offset)
+std::future<QdrantResult> QdrantClient::searchBatch(
+    const std::string& collection_name,
+    const std::vector<std::vector<float>>& query_vectors,
+    int limit,
+    float score_threshold,
+    int hnsw_ef,
+    const nlohmann::json& filter,
+    const std::vector<std::string>& payload_fields,
+    std::chrono::steady_clock::time_point deadline)
+{
+    nlohmann::json searches = nlohmann::json::array();
+    for (const auto& query_vector : query_vectors)
+    {
+        nlohmann::json search;
+        search["vector"] = query_vector;
+        search["limit"] = limit;
+        search["score_threshold"] = score_threshold;
+        search["with_payload"] = withPayload(payload_fields);
+        if (hnsw_ef > 0)
+        {
+            search["params"]["hnsw_ef"] = hnsw_ef;
+        }
+        if (!filter.is_null())
+        {
+            search["filter"] = filter;
+        }
+        searches.push_back(std::move(search));
+    }
+    
+    nlohmann::json body;
+    body["searches"] = std::move(searches);
+    
+    return pImpl->makeRequest("POST", "/collections/" + collection_name + "/points/search/batch", body.dump(), deadline, true);
+}
+
+std::future<QdrantResult> QdrantClient::scrollPoints(const std::string& collection_name, int limit, const std::string& offset, bool with_payload,
+                                                     const nlohmann::json& filter)
 {
     nlohmann::json body;
     body["limit"] = limit;
-    body["with_payload"] = true;
+    body["with_payload"] = with_payload;
+    if (!filter.is_null())
+    {
+        body["filter"] = filter;
+    }
     body["with_vector"] = false; // We don't need vectors for listing
     
     if (!offset.empty())
@@ -0,0 +1,218 @@
+#include "kolosal/remote_prefill.hpp"
+#include "kolosal/logger.hpp"
+#include <curl/curl.h>
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+namespace kolosal
+{
+
+namespace
+{
+    constexpr char kMagic[4] = {'K', 'V', 'S', '1'};
+    constexpr long kConnectTimeoutMs = 1000;
+    constexpr auto kNodeBackoff = std::chrono::seconds(10);    // A failed node is skipped this long
+
+    struct Response
+    {
+        std::vector<uint8_t> body;
+        bool sized = false;
+    };
+
+    size_t appendBody(char* data, size_t size, size_t count, void* userdata)
+    {
+        auto* response = static_cast<Response*>(userdata);
+        response->body.insert(response->body.end(), data, data + size * count);
+        return size * count;
+    }
+
+    size_t readLength(char* data, size_t size, size_t count, void* userdata)
+    {
+        // Reserve the whole state up front instead of growing a multi-megabyte buffer
+        auto* response = static_cast<Response*>(userdata);
+        const size_t bytes = size * count;
+        std::string line(data, bytes);
+        std::transform(line.begin(), line.end(), line.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        if (!response->sized && line.rfind("content-length:", 0) == 0)
+        {
+            response->body.reserve(static_cast<size_t>(std::strtoull(line.c_str() + 15, nullptr, 10)));
+            response->sized = true;
+        }
+        return bytes;
+    }
+}
+
+RemotePrefill& RemotePrefill::instance()
+{
+    static RemotePrefill prefill;
+    return prefill;
+}
+
+void RemotePrefill::configure(const DisaggregationConfig& config)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    config_ = config;
+    for (auto& node : config_.prefill_nodes)
+    {
+        while (!node.empty() && node.back() == '/')
+            node.pop_back();
+    }
+    down_until_.assign(config_.prefill_nodes.size(), std::chrono::steady_clock::time_point{});
+    next_ = 0;
+    const bool decode = config.role == "decode" && !config_.prefill_nodes.empty();
+    if (decode)
+        curl_global_init(CURL_GLOBAL_DEFAULT);
+    enabled_.store(decode);
+    if (decode)
+    {
+        KOLOSAL_LOG_INFO("Prompts of %d+ tokens are decoded on %zu prefill node(s)",
+                              config.min_prompt_tokens, config_.prefill_nodes.size());
+    }
+}
+
+std::string RemotePrefill::encode(const KvSequenceState& state)
+{
+    const uint32_t count = static_cast<uint32_t>(state.tokens.size());
+    std::string data;
+    data.reserve(sizeof(kMagic) + sizeof(count) + count * sizeof(int32_t) + state.state.size());
+    data.append(kMagic, sizeof(kMagic));
+    data.append(reinterpret_cast<const char*>(&count), sizeof(count));
+    data.append(reinterpret_cast<const char*>(state.tokens.data()), count * sizeof(int32_t));
+    data.append(reinterpret_cast<const char*>(state.state.data()), state.state.size());
+    return data;
+}
+
+std::shared_ptr<KvSequenceState> RemotePrefill::decode(std::vector<uint8_t>& data)
+{
+    uint32_t count = 0;
+    const size_t header = sizeof(kMagic) + sizeof(count);
+    if (data.size() < header || std::memcmp(data.data(), kMagic, sizeof(kMagic)) != 0)
+        return nullptr;
+    std::memcpy(&count, data.data() + sizeof(kMagic), sizeof(count));
+    const size_t stateOffset = header + static_cast<size_t>(count) * sizeof(int32_t);
+    if (count == 0 || data.size() <= stateOffset)
+        return nullptr;
+
+    auto state = std::make_shared<KvSequenceState>();
+    state->tokens.resize(count);
+    std::memcpy(state->tokens.data(), data.data() + header, count * sizeof(int32_t));
+    // The state is the tail of the buffer: shift it to the front and keep the allocation
+    data.erase(data.begin(), data.begin() + static_cast<std::ptrdiff_t>(stateOffset));
+    state->state = std::move(data);
+    return state;
+}
+
+std::shared_ptr<const KvSequenceState> RemotePrefill::fetch(const std::string& body, size_t promptTokens)
+{
+    if (!enabled())
+        return nullptr;
+
+    std::string node;
+    size_t index = 0;
+    DisaggregationConfig config;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (promptTokens < static_cast<size_t>(config_.min_prompt_tokens))
+            return nullptr;
+        const auto now = std::chrono::steady_clock::now();
+        for (size_t tried = 0; tried < config_.prefill_nodes.size(); ++tried)
+        {
+            const size_t candidate = (next_ + tried) % config_.prefill_nodes.size();
+            if (down_until_[candidate] <= now)
+            {
+                index = candidate;
+                node = config_.prefill_nodes[candidate];
+                next_ = candidate + 1;
+                break;
+            }
+        }
+        config = config_;
+    }
+    if (node.empty())
+        return nullptr;     // Every prefill node failed recently
+
+    // One handle per connection thread keeps connections to the prefill nodes alive
+    thread_local struct Handle
+    {
+        CURL* curl = curl_easy_init();
+        ~Handle() { if (curl) curl_easy_cleanup(curl); }
+    } handle;
+    CURL* curl = handle.curl;
+    if (!curl)
+        return nullptr;
+    curl_easy_reset(curl);
+
+    struct curl_slist* headers = nullptr;
+    headers = curl_slist_append(headers, "Content-Type: application/json");
+    headers = curl_slist_append(headers, "Expect:");
+    if (!config.api_key.empty())
+        headers = curl_slist_append(headers, ("X-API-Key: " + config.api_key).c_str());
+
+    Response response;
+    const std::string url = node + "/v1/internal/prefill";
+    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+    curl_easy_setopt(curl, CURLOPT_POST, 1L);
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, body.data());
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE_LARGE, static_cast<curl_off_t>(body.size()));
+    curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, readLength);
+    curl_easy_setopt(curl, CURLOPT_HEADERDATA, &response);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, appendBody);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
+    curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT_MS, kConnectTimeoutMs);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT, static_cast<long>(config.timeout_seconds));
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(curl, CURLOPT_TCP_NODELAY, 1L);
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+
+    const auto start = std::chrono::steady_clock::now();
+    const CURLcode result = curl_easy_perform(curl);
+    curl_slist_free_all(headers);
+    long status = 0;
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status);
+
+    std::shared_ptr<KvSequenceState> state;
+    if (result == CURLE_OK && status == 200)
+        state = decode(response.body);
+
+    if (!state)
+    {
+        failures_.fetch_add(1, std::memory_order_relaxed);
+        std::string reason = result != CURLE_OK ? curl_easy_strerror(result) : "HTTP " + std::to_string(status);
+        if (result == CURLE_OK && status == 200)
+            reason = "malformed KV state";
+        // A node that answered with a request error is fine; only unreachable or failing nodes are skipped
+        if (result != CURLE_OK || status >= 500)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (index < down_until_.size())
+                down_until_[index] = std::chrono::steady_clock::now() + kNodeBackoff;
+        }
+        KOLOSAL_LOG_WARNING("[Thread %zu] Remote prefill on %s failed (%s); decoding the prompt locally",
+                                 std::hash<std::thread::id>{}(std::this_thread::get_id()), node.c_str(), reason.c_str());
+        return nullptr;
+    }
+
+    transfers_.fetch_add(1, std::memory_order_relaxed);
+    bytes_.fetch_add(state->state.size(), std::memory_order_relaxed);
+    KOLOSAL_LOG_REQUEST_DEBUG("[Thread %zu] Prefilled %zu tokens on %s in %lld ms (%zu bytes of KV)",
+                           std::hash<std::thread::id>{}(std::this_thread::get_id()), state->tokens.size(), node.c_str(),
+                           static_cast<long long>(std::chrono::duration_cast<std::chrono::milliseconds>(
+                               std::chrono::steady_clock::now() - start).count()),
+                           state->state.size());
+    return state;
+}
+
+RemotePrefill::Stats RemotePrefill::stats() const
+{
+    Stats stats;
+    stats.transfers = transfers_.load(std::memory_order_relaxed);
+    stats.failures = failures_.load(std::memory_order_relaxed);
+    stats.bytes = bytes_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+} // namespace kolosal
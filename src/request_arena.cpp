@@ -0,0 +1,119 @@
+#include "kolosal/request_arena.hpp"
+#include "kolosal/metrics.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <optional>
+
+namespace kolosal
+{
+
+    namespace
+    {
+        constexpr size_t kMinRetainedBytes = 16 * 1024;
+
+        // Counts what passes through to another resource
+        class CountingResource : public std::pmr::memory_resource
+        {
+        public:
+            void reset(std::pmr::memory_resource *target)
+            {
+                target_ = target;
+                bytes_ = 0;
+            }
+            size_t bytes() const { return bytes_; }
+
+        private:
+            void *do_allocate(size_t bytes, size_t alignment) override
+            {
+                void *p = target_->allocate(bytes, alignment);
+                bytes_ += bytes;
+                return p;
+            }
+            void do_deallocate(void *p, size_t bytes, size_t alignment) override
+            {
+                target_->deallocate(p, bytes, alignment);
+            }
+            bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override
+            {
+                return this == &other;
+            }
+
+            std::pmr::memory_resource *target_ = std::pmr::new_delete_resource();
+            size_t bytes_ = 0;
+        };
+
+        struct ThreadArena
+        {
+            std::unique_ptr<std::byte[]> buffer;
+            size_t capacity = 0;
+            size_t wanted = kMinRetainedBytes;   // Next buffer size, from the largest request so far
+            CountingResource upstream;             // Heap blocks taken once the buffer is full
+            std::optional<std::pmr::monotonic_buffer_resource> arena;
+            CountingResource front;                // Everything the request allocated
+            bool active = false;
+        };
+
+        ThreadArena &threadArena()
+        {
+            thread_local ThreadArena state;
+            return state;
+        }
+    }
+
+    RequestArena::Scope::Scope()
+    {
+        ThreadArena &state = threadArena();
+        outermost_ = !state.active;
+        if (!outermost_)
+            return;
+
+        if (state.capacity < state.wanted)
+        {
+            state.buffer.reset(new std::byte[state.wanted]);
+            state.capacity = state.wanted;
+        }
+        state.upstream.reset(std::pmr::new_delete_resource());
+        state.arena.emplace(state.buffer.get(), state.capacity, &state.upstream);
+        state.front.reset(&*state.arena);
+        state.active = true;
+    }
+
+    RequestArena::Scope::~Scope()
+    {
+        if (!outermost_)
+            return;
+
+        ThreadArena &state = threadArena();
+        const size_t used = state.front.bytes();
+        const bool overflowed = state.upstream.bytes() > 0;
+        state.active = false;
+        state.front.reset(std::pmr::new_delete_resource());
+        state.arena.reset();   // Returns the overflow blocks to the heap
+
+        // Grow to the next power of two that would have held this request
+        if (overflowed && state.wanted < kMaxRetainedBytes)
+        {
+            size_t next = state.wanted;
+            while (next < used && next < kMaxRetainedBytes)
+                next *= 2;
+            state.wanted = std::min(next, kMaxRetainedBytes);
+        }
+
+        if (Metrics::instance().enabled())
+            Metrics::instance().observeRequestArena(used, overflowed);
+    }
+
+    std::pmr::memory_resource *RequestArena::resource()
+    {
+        ThreadArena &state = threadArena();
+        return state.active ? static_cast<std::pmr::memory_resource *>(&state.front) : std::pmr::new_delete_resource();
+    }
+
+    size_t RequestArena::used()
+    {
+        ThreadArena &state = threadArena();
+        return state.active ? state.front.bytes() : 0;
+    }
+
+} // namespace kolosal
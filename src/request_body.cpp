@@ -0,0 +1,326 @@
+#include "kolosal/request_body.hpp"
+#include "kolosal/logger.hpp"
+#include "kolosal/utils.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <streambuf>
+#include <system_error>
+#include <zlib.h>
+
+#ifndef _WIN32
+#include <cerrno>
+#endif
+
+namespace kolosal
+{
+
+    namespace
+    {
+        std::string makeSpillPath()
+        {
+            static std::atomic<unsigned long long> counter{0};
+            std::error_code ec;
+            auto dir = std::filesystem::temp_directory_path(ec);
+            if (ec)
+                dir = ".";
+            auto stamp = std::chrono::steady_clock::now().time_since_epoch().count();
+            std::string name = "kolosal-body-" + std::to_string(stamp) + "-" + std::to_string(counter.fetch_add(1)) + ".tmp";
+            return (dir / name).string();
+        }
+    }
+
+    // Pulls the body through RequestBody::read() in fixed-size pieces
+    class RequestBody::StreamBuf : public std::streambuf
+    {
+    public:
+        explicit StreamBuf(RequestBody &body) : body_(body) {}
+
+    protected:
+        int_type underflow() override
+        {
+            if (gptr() < egptr())
+                return traits_type::to_int_type(*gptr());
+            size_t n = body_.read(buffer_, sizeof(buffer_));
+            if (n == 0)
+                return traits_type::eof();
+            setg(buffer_, buffer_, buffer_ + n);
+            return traits_type::to_int_type(*gptr());
+        }
+
+    private:
+        RequestBody &body_;
+        char buffer_[65536];
+    };
+
+    // Inflate state and the compressed bytes waiting for it
+    class RequestBody::Inflater
+    {
+    public:
+        explicit Inflater(http_internal::ContentCoding coding) : coding(coding)
+        {
+            // 15 window bits for a zlib wrapper, +16 for a gzip one
+            ready = inflateInit2(&zs, coding == http_internal::ContentCoding::Gzip ? 15 + 16 : 15) == Z_OK;
+        }
+
+        ~Inflater()
+        {
+            if (ready)
+                inflateEnd(&zs);
+        }
+
+        http_internal::ContentCoding coding;
+        z_stream zs{};
+        bool ready = false;
+        bool done = false;
+        char input[65536];
+    };
+
+    RequestBody::RequestBody(SocketType sock, std::string prefix, size_t length)
+        : sock_(sock), length_(length), prefix_(std::move(prefix))
+    {
+        if (prefix_.size() > length_)
+            prefix_.resize(length_);
+        received_ = prefix_.size();
+    }
+
+    RequestBody::~RequestBody()
+    {
+        stream_.reset();
+        streamBuf_.reset();
+        if (file_)
+            std::fclose(file_);
+        if (!filePath_.empty())
+        {
+            std::error_code ec;
+            std::filesystem::remove(filePath_, ec);
+        }
+    }
+
+    size_t RequestBody::receive(char *dst, size_t max)
+    {
+        if (prefixPos_ < prefix_.size())
+        {
+            size_t n = std::min(max, prefix_.size() - prefixPos_);
+            std::copy_n(prefix_.data() + prefixPos_, n, dst);
+            prefixPos_ += n;
+            if (prefixPos_ == prefix_.size())
+            {
+                prefix_.clear();
+                prefix_.shrink_to_fit();
+                prefixPos_ = 0;
+            }
+            return n;
+        }
+
+        size_t wanted = std::min(max, length_ - received_);
+        while (wanted > 0)
+        {
+            // The socket carries the server's receive timeout, so a stalled client ends here
+            int n = static_cast<int>(kolosal::http_internal::socket_recv(sock_, dst, std::min<size_t>(wanted, 1 << 20)));
+            if (n > 0)
+            {
+                received_ += static_cast<size_t>(n);
+                return static_cast<size_t>(n);
+            }
+#ifndef _WIN32
+            if (n < 0 && errno == EINTR)
+                continue;
+#endif
+            KOLOSAL_LOG_WARNING("Client stopped sending the request body after %zu of %zu bytes",
+                                     received_, length_);
+            failed_ = true;
+            break;
+        }
+        return 0;
+    }
+
+    void RequestBody::decode(http_internal::ContentCoding coding, size_t maxDecoded)
+    {
+        if (coding == http_internal::ContentCoding::Identity || consumed_ > 0 || file_ || stream_)
+            return;
+        inflater_ = std::make_unique<Inflater>(coding);
+        maxDecoded_ = maxDecoded;
+        if (!inflater_->ready)
+        {
+            KOLOSAL_LOG_ERROR("Failed to initialise request body decompression");
+            failed_ = true;
+        }
+    }
+
+    size_t RequestBody::inflate(char *dst, size_t max)
+    {
+        Inflater &in = *inflater_;
+        z_stream &zs = in.zs;
+        zs.next_out = reinterpret_cast<Bytef *>(dst);
+        zs.avail_out = static_cast<uInt>(std::min<size_t>(max, 1u << 30));
+        const uInt room = zs.avail_out;
+        while (zs.avail_out == room && !in.done)
+        {
+            if (zs.avail_in == 0)
+            {
+                const size_t n = receive(in.input, sizeof(in.input));
+                if (n == 0)
+                {
+                    if (!failed_)
+                    {
+                        KOLOSAL_LOG_WARNING("Compressed request body ended before its stream did");
+                        failed_ = corrupt_ = true;
+                    }
+                    return 0;
+                }
+                zs.next_in = reinterpret_cast<Bytef *>(in.input);
+                zs.avail_in = static_cast<uInt>(n);
+            }
+
+            const int rc = ::inflate(&zs, Z_NO_FLUSH);
+            if (rc == Z_STREAM_END)
+            {
+                // Concatenated gzip members decode as one body, as gunzip does
+                const bool more = zs.avail_in > 0 || prefixPos_ < prefix_.size() || received_ < length_;
+                if (more && in.coding == http_internal::ContentCoding::Gzip)
+                    inflateReset(&zs);
+                else
+                    in.done = true;
+            }
+            else if (rc != Z_OK && rc != Z_BUF_ERROR)
+            {
+                KOLOSAL_LOG_WARNING("Invalid compressed request body: %s", zs.msg ? zs.msg : "inflate failed");
+                failed_ = corrupt_ = true;
+                return 0;
+            }
+        }
+
+        const size_t n = room - zs.avail_out;
+        if (maxDecoded_ > 0 && n > maxDecoded_ - std::min(consumed_, maxDecoded_))
+        {
+            KOLOSAL_LOG_WARNING("Decompressed request body exceeds %zu bytes", maxDecoded_);
+            failed_ = tooLarge_ = true;
+            return 0;
+        }
+        return n;
+    }
+
+    size_t RequestBody::read(char *dst, size_t max)
+    {
+        if (failed_ || max == 0)
+            return 0;
+
+        size_t n = 0;
+        if (file_)
+        {
+            if (consumed_ >= fileSize_)
+                return 0;
+            n = std::fread(dst, 1, std::min(max, fileSize_ - consumed_), file_);
+            if (n == 0)
+                failed_ = true;
+        }
+        else if (inflater_)
+        {
+            n = inflate(dst, max);
+        }
+        else
+        {
+            if (consumed_ >= length_)
+                return 0;
+            n = receive(dst, std::min(max, length_ - consumed_));
+        }
+        consumed_ += n;
+        return n;
+    }
+
+    std::string RequestBody::error() const
+    {
+        if (tooLarge_)
+            return "Decompressed request body is larger than " + std::to_string(maxDecoded_) + " bytes";
+        if (corrupt_)
+            return "Request body is not valid " + std::string(inflater_->coding == http_internal::ContentCoding::Gzip ? "gzip" : "deflate") + " data";
+        return "Incomplete request body: received " + std::to_string(consumed()) + " of " + std::to_string(length_) + " bytes";
+    }
+
+    std::istream &RequestBody::stream()
+    {
+        if (!stream_)
+        {
+            streamBuf_ = std::make_unique<StreamBuf>(*this);
+            stream_ = std::make_unique<std::istream>(streamBuf_.get());
+        }
+        return *stream_;
+    }
+
+    const std::string &RequestBody::spillToFile()
+    {
+        static const std::string empty;
+        if (file_)
+            return filePath_;
+        if (consumed_ > 0 || stream_)
+        {
+            KOLOSAL_LOG_ERROR("Request body can only be spilled to a file before it is read");
+            return empty;
+        }
+
+        filePath_ = makeSpillPath();
+        file_ = std::fopen(filePath_.c_str(), "wb+");
+        if (!file_)
+        {
+            KOLOSAL_LOG_ERROR("Cannot create request body file %s", filePath_.c_str());
+            filePath_.clear();
+            return empty;
+        }
+
+        std::unique_ptr<char[]> chunk(new char[1 << 20]);
+        size_t written = 0;
+        if (inflater_)
+        {
+            // The file holds the inflated body, so its size is only known at the end
+            while (size_t n = inflate(chunk.get(), 1 << 20))
+            {
+                consumed_ += n;
+                if (std::fwrite(chunk.get(), 1, n, file_) != n)
+                {
+                    failed_ = true;
+                    return empty;
+                }
+                written += n;
+            }
+            consumed_ = 0;
+            if (failed_)
+                return empty;
+        }
+        while (!inflater_ && written < length_)
+        {
+            size_t n = receive(chunk.get(), std::min<size_t>(length_ - written, 1 << 20));
+            if (n == 0 || std::fwrite(chunk.get(), 1, n, file_) != n)
+            {
+                failed_ = true;
+                return empty;
+            }
+            written += n;
+        }
+        fileSize_ = written;
+        std::fflush(file_);
+        std::rewind(file_);
+        return filePath_;
+    }
+
+    bool RequestBody::discardRemaining(size_t limit)
+    {
+        // Only bytes still on the socket matter; a spill file or the prefix can just be dropped
+        if (failed_ || length_ - received_ > limit)
+            return false;
+
+        prefix_.clear();
+        prefixPos_ = 0;
+        char chunk[16384];
+        while (received_ < length_)
+        {
+            if (receive(chunk, sizeof(chunk)) == 0)
+                return false;
+        }
+        consumed_ = length_;
+        return true;
+    }
+
+} // namespace kolosal
@@ -0,0 +1,175 @@
+#include "kolosal/response_cache.hpp"
+#include "kolosal/logger.hpp"
+#include <algorithm>
+#include <iterator>
+
+namespace kolosal
+{
+
+namespace
+{
+    constexpr size_t kEntryOverheadBytes = 160;     // List node, map node, shared state and vector headers
+}
+
+ResponseCache& ResponseCache::instance()
+{
+    static ResponseCache cache;
+    return cache;
+}
+
+void ResponseCache::configure(const ResponseCacheConfig& config)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        enabled_ = config.enabled;
+        memory_limit_ = static_cast<size_t>(std::max(0, config.memory_mb)) * 1024 * 1024;
+        entry_limit_ = static_cast<size_t>(std::max(0, config.max_entry_kb)) * 1024;
+        ttl_ = std::chrono::seconds(std::max(0, config.ttl_seconds));
+        lru_.clear();
+        entries_.clear();
+        bytes_ = 0;
+    }
+
+    KOLOSAL_LOG_INFO("Response cache %s (memory %d MB, ttl %d s)",
+                          config.enabled ? "enabled" : "disabled", config.memory_mb, config.ttl_seconds);
+}
+
+std::string ResponseCache::makeKey(const std::string& model_id, const std::string& request)
+{
+    std::string key;
+    key.reserve(model_id.size() + 1 + request.size());
+    key.append(model_id).push_back('\0');
+    key.append(request);
+    return key;
+}
+
+void ResponseCache::eraseLocked(std::list<Entry>::iterator it)
+{
+    bytes_ -= it->bytes;
+    entries_.erase(it->key);
+    lru_.erase(it);
+}
+
+uint64_t ResponseCache::generation(const std::string& model_id) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = generations_.find(model_id);
+    return it == generations_.end() ? 0 : it->second;
+}
+
+std::shared_ptr<const ResponseCache::Response> ResponseCache::get(const std::string& model_id, const std::string& request)
+{
+    if (!enabled())
+    {
+        return nullptr;
+    }
+
+    const std::string key = makeKey(model_id, request);
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(key);
+    if (it == entries_.end())
+    {
+        misses_.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    if (ttl_.count() > 0 && std::chrono::steady_clock::now() >= it->second->expires)
+    {
+        eraseLocked(it->second);
+        expirations_.fetch_add(1, std::memory_order_relaxed);
+        misses_.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    lru_.splice(lru_.begin(), lru_, it->second);
+    hits_.fetch_add(1, std::memory_order_relaxed);
+    return it->second->response;
+}
+
+void ResponseCache::put(const std::string& model_id, const std::string& request, uint64_t generation, Response response)
+{
+    if (!enabled() || response.choices.empty())
+    {
+        return;
+    }
+
+    std::string key = makeKey(model_id, request);
+    size_t bytes = 2 * key.size() + model_id.size() + kEntryOverheadBytes;    // The key is held by the map and the entry
+    for (const auto& pieces : response.choices)
+    {
+        for (const auto& piece : pieces)
+        {
+            bytes += piece.size() + sizeof(std::string);
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (bytes > entry_limit_ || bytes > memory_limit_)
+    {
+        return;
+    }
+    auto generationIt = generations_.find(model_id);
+    if (generation != (generationIt == generations_.end() ? 0 : generationIt->second))
+    {
+        return;
+    }
+
+    auto it = entries_.find(key);
+    if (it != entries_.end())
+    {
+        eraseLocked(it->second);
+    }
+
+    Entry entry;
+    entry.key = key;
+    entry.model_id = model_id;
+    entry.response = std::make_shared<const Response>(std::move(response));
+    entry.expires = std::chrono::steady_clock::now() + ttl_;
+    entry.bytes = bytes;
+    lru_.push_front(std::move(entry));
+    entries_.emplace(std::move(key), lru_.begin());
+    bytes_ += bytes;
+
+    while (bytes_ > memory_limit_ && !lru_.empty())
+    {
+        eraseLocked(std::prev(lru_.end()));
+        evictions_.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void ResponseCache::invalidateModel(const std::string& model_id)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    generations_[model_id] = ++next_generation_;
+
+    size_t dropped = 0;
+    for (auto it = lru_.begin(); it != lru_.end();)
+    {
+        auto next = std::next(it);
+        if (it->model_id == model_id)
+        {
+            eraseLocked(it);
+            ++dropped;
+        }
+        it = next;
+    }
+    if (dropped > 0)
+    {
+        KOLOSAL_LOG_INFO("Response cache: dropped %zu response(s) of model '%s'", dropped, model_id.c_str());
+    }
+}
+
+ResponseCache::Stats ResponseCache::stats() const
+{
+    Stats stats;
+    stats.hits = hits_.load(std::memory_order_relaxed);
+    stats.misses = misses_.load(std::memory_order_relaxed);
+    stats.evictions = evictions_.load(std::memory_order_relaxed);
+    stats.expirations = expirations_.load(std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats.entries = entries_.size();
+    stats.bytes = bytes_;
+    return stats;
+}
+
+} // namespace kolosal
@@ -1,4 +1,7 @@
 #include "kolosal/retrieval/add_document_types.hpp"
+#include "kolosal/models/json_sax_reader.hpp"
+#include "kolosal/vector_math.hpp"
+#include <cstring>
 #include <stdexcept>
 
 namespace kolosal
@@ -6,6 +9,141 @@ namespace kolosal
 namespace retrieval
 {
 
+namespace
+{
+
+// Fills an AddDocumentsRequest while the body is parsed; only metadata objects are built as JSON
+class AddDocumentsReader : public JsonSaxReader
+{
+public:
+    explicit AddDocumentsReader(AddDocumentsRequest& request) : request_(request) {}
+
+    void finish()
+    {
+        if (!has_documents_)
+        {
+            throw std::runtime_error("Request must contain a 'documents' array");
+        }
+    }
+
+protected:
+    json* collect() override
+    {
+        if (depth() == 1)
+        {
+            field_ = keyAt(0);
+            return field_ == "documents" ? nullptr :
+                   field_ == "async" || field_ == "mode" || field_ == "source_field" ? &value_ : discard();
+        }
+        if (depth() == 3)
+        {
+            field_ = keyAt(2);
+            return field_ == "text" ? nullptr : field_ == "metadata" ? &value_ : discard();
+        }
+        return nullptr;
+    }
+
+    void onString(std::string& value) override
+    {
+        if (depth() == 3)
+        {
+            request_.documents.back().text = std::move(value);
+            has_text_ = true;
+            return;
+        }
+        reject();
+    }
+
+    void onScalar(json&&) override
+    {
+        reject();
+    }
+
+    void onStart(bool array) override
+    {
+        if (depth() == 0 && !array)
+        {
+            return;
+        }
+        if (depth() == 1 && array)
+        {
+            request_.documents.clear();
+            has_documents_ = true;
+            return;
+        }
+        if (depth() == 2 && !array)
+        {
+            request_.documents.emplace_back();
+            has_text_ = false;
+            return;
+        }
+        reject();
+    }
+
+    void onEnd(bool) override
+    {
+        if (depth() == 2 && !has_text_)
+        {
+            throw std::runtime_error("Document must contain a 'text' field of type string");
+        }
+    }
+
+    void onCollected() override
+    {
+        if (field_ == "async")
+        {
+            if (!value_.is_boolean())
+            {
+                throw std::runtime_error("Field 'async' must be a boolean");
+            }
+            request_.async = value_.get<bool>();
+            return;
+        }
+        if (field_ == "mode" || field_ == "source_field")
+        {
+            if (!value_.is_string())
+            {
+                throw std::runtime_error("Field '" + field_ + "' must be a string");
+            }
+            (field_ == "mode" ? request_.mode : request_.source_field) = value_.get<std::string>();
+            return;
+        }
+        if (!value_.is_object())
+        {
+            throw std::runtime_error("Document 'metadata' field must be an object");
+        }
+        auto& metadata = request_.documents.back().metadata;
+        metadata.clear();
+        for (auto& [key, value] : value_.items())
+        {
+            metadata[key] = std::move(value);
+        }
+    }
+
+private:
+    // A value of the wrong type at the current position
+    void reject() const
+    {
+        if (depth() == 0)
+        {
+            throw std::runtime_error("Request body must be a JSON object");
+        }
+        if (depth() == 1)
+        {
+            throw std::runtime_error("Request must contain a 'documents' array");
+        }
+        throw std::runtime_error("Document must contain a 'text' field of type string");
+    }
+
+    AddDocumentsRequest& request_;
+    std::string field_;
+    json value_;
+    bool has_documents_ = false;
+    bool has_text_ = false;
+};
+
+} // namespace
+
 // Document implementations
 nlohmann::json Document::to_json() const
 {
@@ -66,11 +204,52 @@ void AddDocumentsRequest::from_json(const nlohmann::json& j)
     
     // Collection name is always "documents" - ignore any provided collection_name
     collection_name = "documents";
+    
+    if (j.contains("async"))
+    {
+        if (!j["async"].is_boolean())
+        {
+            throw std::runtime_error("Field 'async' must be a boolean");
+        }
+        async = j["async"].get<bool>();
+    }
+    if (j.contains("mode"))
+    {
+        if (!j["mode"].is_string())
+        {
+            throw std::runtime_error("Field 'mode' must be a string");
+        }
+        mode = j["mode"].get<std::string>();
+    }
+    if (j.contains("source_field"))
+    {
+        if (!j["source_field"].is_string())
+        {
+            throw std::runtime_error("Field 'source_field' must be a string");
+        }
+        source_field = j["source_field"].get<std::string>();
+    }
+}
+
+void AddDocumentsRequest::parse(const std::string& body)
+{
+    AddDocumentsReader reader(*this);
+    reader.parse(body);
+    reader.finish();
+    collection_name = "documents";
+}
+
+void AddDocumentsRequest::parse(std::istream& body)
+{
+    AddDocumentsReader reader(*this);
+    reader.parse(body);
+    reader.finish();
+    collection_name = "documents";
 }
 
 bool AddDocumentsRequest::validate() const
 {
-    if (documents.empty())
+    if (documents.empty() || (mode != "add" && mode != "update") || source_field.empty())
     {
         return false;
     }
@@ -92,6 +271,14 @@ nlohmann::json DocumentResult::to_json() const
     nlohmann::json j;
     j["id"] = id;
     j["success"] = success;
+    if (unchanged)
+    {
+        j["unchanged"] = true;
+    }
+    if (duplicate)
+    {
+        j["duplicate"] = true;
+    }
     if (!success && !error.empty())
     {
         j["error"] = error;
@@ -109,6 +296,20 @@ void AddDocumentsResponse::addSuccess(const std::string& document_id)
     successful_count++;
 }
 
+void AddDocumentsResponse::addUnchanged(const std::string& document_id)
+{
+    addSuccess(document_id);
+    results.back().unchanged = true;
+    unchanged_count++;
+}
+
+void AddDocumentsResponse::addDuplicate(const std::string& document_id)
+{
+    addSuccess(document_id);
+    results.back().duplicate = true;
+    duplicate_count++;
+}
+
 void AddDocumentsResponse::addFailure(const std::string& error)
 {
     DocumentResult result;
@@ -124,6 +325,15 @@ nlohmann::json AddDocumentsResponse::to_json() const
     j["collection_name"] = collection_name;
     j["successful_count"] = successful_count;
     j["failed_count"] = failed_count;
+    if (update)
+    {
+        j["unchanged_count"] = unchanged_count;
+        j["removed_count"] = removed_count;
+    }
+    if (dedup)
+    {
+        j["duplicate_count"] = duplicate_count;
+    }
     
     nlohmann::json results_array = nlohmann::json::array();
     for (const auto& result : results)
@@ -141,6 +351,44 @@ bool AddDocumentsResponse::validate() const
            (successful_count + failed_count) == static_cast<int>(results.size());
 }
 
+// IngestionJobStatus implementations
+bool IngestionJobStatus::finished() const
+{
+    return status == "completed" || status == "cancelled" || status == "failed";
+}
+
+nlohmann::json IngestionJobStatus::to_json(bool include_results) const
+{
+    auto seconds = [](std::chrono::system_clock::time_point time) -> nlohmann::json {
+        if (time.time_since_epoch().count() == 0)
+        {
+            return nullptr;
+        }
+        return std::chrono::duration_cast<std::chrono::seconds>(time.time_since_epoch()).count();
+    };
+    
+    nlohmann::json j;
+    j["job_id"] = job_id;
+    j["status"] = status;
+    j["total"] = total;
+    j["processed"] = processed;
+    j["succeeded"] = succeeded;
+    j["failed"] = failed;
+    j["progress"] = total ? static_cast<double>(processed) / static_cast<double>(total) : 1.0;
+    j["created_at"] = seconds(created_at);
+    j["started_at"] = seconds(started_at);
+    j["finished_at"] = seconds(finished_at);
+    if (!error.empty())
+    {
+        j["error"] = error;
+    }
+    if (include_results && finished())
+    {
+        j["result"] = response.to_json();
+    }
+    return j;
+}
+
 // AddDocumentsErrorResponse implementations
 nlohmann::json AddDocumentsErrorResponse::to_json() const
 {
@@ -163,5 +411,124 @@ nlohmann::json AddDocumentsErrorResponse::to_json() const
     return j;
 }
 
+VectorImportReader::VectorImportReader(std::istream& body, size_t dimensions, const std::string& dtype)
+    : body_(body), dimensions_(dimensions), half_(dtype == "f16")
+{
+    if (dtype != "f32" && dtype != "f16")
+    {
+        throw std::invalid_argument("dtype must be 'f32' or 'f16'");
+    }
+    if (dimensions == 0 || dimensions > kMaxDimensions)
+    {
+        throw std::invalid_argument("dimensions must be between 1 and " + std::to_string(kMaxDimensions));
+    }
+}
+
+bool VectorImportReader::next(VectorImportBatch& batch)
+{
+    // Frames are little-endian, as is every host the server builds for
+    unsigned char header[8];
+    body_.read(reinterpret_cast<char*>(header), sizeof(header));
+    if (body_.gcount() == 0)
+    {
+        return false;
+    }
+    if (body_.gcount() != sizeof(header))
+    {
+        throw std::runtime_error("Truncated frame header after row " + std::to_string(rows_));
+    }
+    uint32_t rows = 0;
+    uint32_t payload_bytes = 0;
+    std::memcpy(&rows, header, sizeof(rows));
+    std::memcpy(&payload_bytes, header + 4, sizeof(payload_bytes));
+    if (rows == 0 || rows > kMaxRows)
+    {
+        throw std::runtime_error("Frame row count must be between 1 and " + std::to_string(kMaxRows));
+    }
+    if (payload_bytes > kMaxPayloadBytes)
+    {
+        throw std::runtime_error("Frame payload is larger than " + std::to_string(kMaxPayloadBytes >> 20) + " MB");
+    }
+    
+    std::string payload(payload_bytes, '\0');
+    if (!body_.read(&payload[0], payload_bytes))
+    {
+        throw std::runtime_error("Truncated payload in the frame starting at row " + std::to_string(rows_));
+    }
+    
+    batch.ids.assign(rows, std::string());
+    batch.documents.assign(rows, Document());
+    batch.dimensions = dimensions_;
+    size_t row = 0;
+    size_t start = 0;
+    while (start < payload.size())
+    {
+        size_t end = payload.find('\n', start);
+        if (end == std::string::npos)
+        {
+            end = payload.size();
+        }
+        if (end > start && !(end == start + 1 && payload[start] == '\r'))
+        {
+            if (row == rows)
+            {
+                throw std::runtime_error("Frame starting at row " + std::to_string(rows_) + " has more payload lines than rows");
+            }
+            const std::string where = "Row " + std::to_string(rows_ + row);
+            nlohmann::json line = nlohmann::json::parse(payload.begin() + start, payload.begin() + end, nullptr, false);
+            if (!line.is_object())
+            {
+                throw std::runtime_error(where + ": payload line is not a JSON object");
+            }
+            if (line.contains("id"))
+            {
+                if (!line["id"].is_string() || line["id"].get_ref<const std::string&>().empty())
+                {
+                    throw std::runtime_error(where + ": 'id' must be a non-empty string");
+                }
+                batch.ids[row] = line["id"].get<std::string>();
+            }
+            try
+            {
+                batch.documents[row].from_json(line);
+            }
+            catch (const std::exception& ex)
+            {
+                throw std::runtime_error(where + ": " + ex.what());
+            }
+            ++row;
+        }
+        start = end + 1;
+    }
+    if (row != rows)
+    {
+        throw std::runtime_error("Frame starting at row " + std::to_string(rows_) + " has " + std::to_string(row) +
+                                 " payload lines for " + std::to_string(rows) + " rows");
+    }
+    
+    const size_t values = static_cast<size_t>(rows) * dimensions_;
+    batch.vectors.resize(values);
+    bool complete;
+    if (half_)
+    {
+        halves_.resize(values);
+        complete = static_cast<bool>(body_.read(reinterpret_cast<char*>(halves_.data()), static_cast<std::streamsize>(values * sizeof(uint16_t))));
+        if (complete)
+        {
+            vecmath::fromHalf(halves_.data(), values, batch.vectors.data());
+        }
+    }
+    else
+    {
+        complete = static_cast<bool>(body_.read(reinterpret_cast<char*>(batch.vectors.data()), static_cast<std::streamsize>(values * sizeof(float))));
+    }
+    if (!complete)
+    {
+        throw std::runtime_error("Truncated vectors in the frame starting at row " + std::to_string(rows_));
+    }
+    rows_ += rows;
+    return true;
+}
+
 } // namespace retrieval
 } // namespace kolosal
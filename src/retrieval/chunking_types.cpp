@@ -2,13 +2,16 @@
 #include "kolosal/server_api.hpp"
 #include "kolosal/node_manager.h"
 #include "kolosal/logger.hpp"
+#include "kolosal/task_executor.hpp"
+#include "kolosal/retrieval/embedding_cache.hpp"
+#include "kolosal/vector_math.hpp"
 #include "inference_interface.h"
 #include <stdexcept>
 #include <future>
 #include <algorithm>
 #include <cmath>
 #include <numeric>
-#include <regex>
+#include <cctype>
 
 namespace kolosal
 {
@@ -17,58 +20,147 @@ namespace retrieval
 
 ChunkingService::ChunkingService()
 {
-    ServerLogger::logInfo("ChunkingService initialized");
+    KOLOSAL_LOG_INFO("ChunkingService initialized");
 }
 
 ChunkingService::~ChunkingService() = default;
 
 std::vector<std::string> ChunkingService::generateBaseChunks(
     const std::string& text,
-    const std::vector<std::string>& tokens,
     int chunk_size,
     int overlap
 ) const
 {
-    validateChunkingParameters(chunk_size, overlap, chunk_size * 2, 0.0f);
-    
-    if (tokens.empty())
+    const auto tokens = splitWordSpans(text);
+    const auto spans = generateChunkSpans(tokens, chunk_size, overlap);
+    if (spans.empty())
     {
-        ServerLogger::logWarning("Empty tokens vector provided to generateBaseChunks");
+        KOLOSAL_LOG_WARNING("Empty text provided to generateBaseChunks");
         return {};
     }
-    
+
     std::vector<std::string> chunks;
-    int step = chunk_size - overlap;
-    
-    if (step <= 0)
+    chunks.reserve(spans.size());
+    for (const auto& span : spans)
     {
-        throw std::runtime_error("Invalid chunking parameters: step size must be positive");
+        chunks.push_back(materializeChunk(text, tokens, span));
     }
-    
-    for (int start = 0; start < static_cast<int>(tokens.size()); start += step)
+
+    KOLOSAL_LOG_DEBUG("Generated %zu base chunks from %zu tokens", chunks.size(), tokens.size());
+    return chunks;
+}
+
+std::vector<std::string> ChunkingService::generateBaseChunks(
+    const std::string& text,
+    const std::vector<std::string>& tokens,
+    int chunk_size,
+    int overlap
+) const
+{
+    // Only the window arithmetic is needed here, so give the tokens unit spans
+    // and join the strings themselves
+    std::vector<TokenSpan> positions(tokens.size());
+    for (size_t i = 0; i < tokens.size(); ++i)
     {
-        int end = std::min(start + chunk_size, static_cast<int>(tokens.size()));
-        
-        if (start >= end)
+        positions[i].offset = i;
+        positions[i].length = 1;
+    }
+
+    const auto spans = generateChunkSpans(positions, chunk_size, overlap);
+    if (spans.empty())
+    {
+        KOLOSAL_LOG_WARNING("Empty tokens vector provided to generateBaseChunks");
+        return {};
+    }
+
+    std::vector<std::string> chunks;
+    chunks.reserve(spans.size());
+    for (const auto& span : spans)
+    {
+        size_t bytes = span.last_token - span.first_token - 1;
+        for (size_t i = span.first_token; i < span.last_token; ++i)
         {
-            break;
+            bytes += tokens[i].size();
         }
-        
-        auto chunk_tokens = extractTokenSubset(tokens, start, end);
-        if (!chunk_tokens.empty())
+
+        std::string chunk_text;
+        chunk_text.reserve(bytes);
+        for (size_t i = span.first_token; i < span.last_token; ++i)
         {
-            std::string chunk_text = reconstructText(chunk_tokens);
-            chunks.push_back(chunk_text);
+            if (i > span.first_token)
+            {
+                chunk_text += ' ';
+            }
+            chunk_text += tokens[i];
         }
-        
-        if (end >= static_cast<int>(tokens.size()))
+        chunks.push_back(std::move(chunk_text));
+    }
+
+    KOLOSAL_LOG_DEBUG("Generated %zu base chunks from %zu tokens", chunks.size(), tokens.size());
+    return chunks;
+}
+
+std::vector<ChunkSpan> ChunkingService::generateChunkSpans(
+    const std::vector<TokenSpan>& tokens,
+    int chunk_size,
+    int overlap
+) const
+{
+    validateChunkingParameters(chunk_size, overlap, chunk_size * 2, 0.0f);
+
+    const size_t step = static_cast<size_t>(chunk_size - overlap);
+    const size_t size = static_cast<size_t>(chunk_size);
+
+    std::vector<ChunkSpan> spans;
+    if (tokens.empty())
+    {
+        return spans;
+    }
+    spans.reserve((tokens.size() + step - 1) / step);
+
+    for (size_t start = 0; start < tokens.size(); start += step)
+    {
+        const size_t end = std::min(start + size, tokens.size());
+
+        ChunkSpan span;
+        span.first_token = start;
+        span.last_token = end;
+        span.begin = tokens[start].offset;
+        span.end = tokens[end - 1].offset + tokens[end - 1].length;
+        spans.push_back(span);
+
+        if (end >= tokens.size())
         {
             break;
         }
     }
-    
-    ServerLogger::logDebug("Generated %zu base chunks from %zu tokens", chunks.size(), tokens.size());
-    return chunks;
+
+    return spans;
+}
+
+std::string ChunkingService::materializeChunk(
+    std::string_view text,
+    const std::vector<TokenSpan>& tokens,
+    const ChunkSpan& chunk
+)
+{
+    if (chunk.first_token >= chunk.last_token || chunk.last_token > tokens.size())
+    {
+        return "";
+    }
+
+    // The joined text is never longer than the source range it came from
+    std::string result;
+    result.reserve(chunk.end - chunk.begin);
+    for (size_t i = chunk.first_token; i < chunk.last_token; ++i)
+    {
+        if (i > chunk.first_token)
+        {
+            result += ' ';
+        }
+        result.append(text.data() + tokens[i].offset, tokens[i].length);
+    }
+    return result;
 }
 
 std::future<std::vector<std::string>> ChunkingService::semanticChunk(
@@ -80,17 +172,13 @@ std::future<std::vector<std::string>> ChunkingService::semanticChunk(
     float similarity_threshold
 )
 {
-    return std::async(std::launch::async, [=]() -> std::vector<std::string> {
+    return TaskExecutor::instance().submit([=]() -> std::vector<std::string> {
         try
         {
             validateChunkingParameters(chunk_size, overlap, max_tokens, similarity_threshold);
             
-            // Step 1: Tokenize the text
-            auto tokens_future = tokenizeText(text, model_name);
-            auto tokens = tokens_future.get();
-            
-            // Step 2: Generate base chunks
-            auto base_chunks = generateBaseChunks(text, tokens, chunk_size, overlap);
+            // Steps 1-2: Split the text into word spans and cut the base chunks
+            auto base_chunks = generateBaseChunks(text, chunk_size, overlap);
             
             if (base_chunks.empty())
             {
@@ -102,29 +190,45 @@ std::future<std::vector<std::string>> ChunkingService::semanticChunk(
                 return base_chunks;
             }
             
-            // Step 3: Compute embeddings for all base chunks sequentially
-            std::vector<std::vector<float>> embeddings;
-            embeddings.reserve(base_chunks.size());
+            // Step 3: Embed all base chunks in one batch
+            auto embeddings = computeEmbeddings(base_chunks, model_name).get();
             
-            for (const auto& chunk : base_chunks)
+            // Lay the embeddings out as one row-major matrix with precomputed norms,
+            // so each comparison below is a single dot product over contiguous rows
+            const size_t dimensions = embeddings[0].size();
+            std::vector<float> matrix(base_chunks.size() * dimensions, 0.0f);
+            std::vector<float> norms(base_chunks.size(), 0.0f);
+            for (size_t i = 0; i < embeddings.size(); ++i)
             {
-                auto embedding_future = computeEmbedding(chunk, model_name);
-                embeddings.push_back(embedding_future.get());
+                if (embeddings[i].size() != dimensions)
+                {
+                    continue; // Mismatched rows stay zero and never merge
+                }
+                float* row = matrix.data() + i * dimensions;
+                std::copy(embeddings[i].begin(), embeddings[i].end(), row);
             }
+            embeddings.clear();
+            vecmath::norms(matrix.data(), base_chunks.size(), dimensions, norms.data());
             
-            // Step 4: Merge chunks based on semantic similarity
+            // Step 4: Merge chunks based on semantic similarity, budgeting with real token counts
+            const auto token_counts = countTokens(base_chunks, model_name);
             std::vector<std::string> merged_chunks;
             std::string current_chunk = base_chunks[0];
-            std::vector<float> current_embedding = embeddings[0];
-            int current_token_count = estimateTokenCount(current_chunk);
+            size_t current_row = 0;
+            int current_token_count = token_counts[0];
             
             for (size_t i = 1; i < base_chunks.size(); ++i)
             {
                 const auto& next_chunk = base_chunks[i];
-                const auto& next_embedding = embeddings[i];
-                int next_token_count = estimateTokenCount(next_chunk);
+                int next_token_count = token_counts[i];
                 
-                float similarity = cosineSimilarity(current_embedding, next_embedding);
+                float similarity = 0.0f;
+                if (norms[current_row] > 0.0f && norms[i] > 0.0f)
+                {
+                    similarity = vecmath::dot(matrix.data() + current_row * dimensions,
+                                              matrix.data() + i * dimensions, dimensions) /
+                                 (norms[current_row] * norms[i]);
+                }
                 
                 bool can_merge = (
                     similarity >= similarity_threshold &&
@@ -134,31 +238,32 @@ std::future<std::vector<std::string>> ChunkingService::semanticChunk(
                 if (can_merge)
                 {
                     // Merge chunks
-                    current_chunk = current_chunk + " " + next_chunk;
+                    current_chunk += ' ';
+                    current_chunk += next_chunk;
                     current_token_count += next_token_count;
                     // Note: We don't update the embedding to save computation cost
                 }
                 else
                 {
                     // Finalize current chunk and start new one
-                    merged_chunks.push_back(current_chunk);
+                    merged_chunks.push_back(std::move(current_chunk));
                     current_chunk = next_chunk;
-                    current_embedding = next_embedding;
+                    current_row = i;
                     current_token_count = next_token_count;
                 }
             }
             
             // Add the last chunk
-            merged_chunks.push_back(current_chunk);
+            merged_chunks.push_back(std::move(current_chunk));
             
-            ServerLogger::logDebug("Semantic chunking: %zu base chunks merged into %zu chunks", 
+            KOLOSAL_LOG_DEBUG("Semantic chunking: %zu base chunks merged into %zu chunks", 
                                    base_chunks.size(), merged_chunks.size());
             
             return merged_chunks;
         }
         catch (const std::exception& ex)
         {
-            ServerLogger::logError("Error in semantic chunking: %s", ex.what());
+            KOLOSAL_LOG_ERROR("Error in semantic chunking: %s", ex.what());
             throw;
         }
     });
@@ -169,29 +274,19 @@ std::future<std::vector<std::string>> ChunkingService::tokenizeText(
     const std::string& model_name
 )
 {
-    return std::async(std::launch::async, [=]() -> std::vector<std::string> {
+    return TaskExecutor::instance().submit([=]() -> std::vector<std::string> {
         try
         {
             // For now, use simple space-based tokenization as a fallback
             // In a real implementation, we would use the model's tokenizer
-            std::vector<std::string> tokens;
+            std::vector<std::string> tokens = splitWords(text);
             
-            // Simple regex-based tokenization
-            std::regex word_regex(R"(\S+)");
-            std::sregex_iterator iter(text.begin(), text.end(), word_regex);
-            std::sregex_iterator end;
-            
-            for (; iter != end; ++iter)
-            {
-                tokens.push_back(iter->str());
-            }
-            
-            ServerLogger::logDebug("Tokenized text into %zu tokens", tokens.size());
+            KOLOSAL_LOG_DEBUG("Tokenized text into %zu tokens", tokens.size());
             return tokens;
         }
         catch (const std::exception& ex)
         {
-            ServerLogger::logError("Error in tokenization: %s", ex.what());
+            KOLOSAL_LOG_ERROR("Error in tokenization: %s", ex.what());
             throw;
         }
     });
@@ -202,12 +297,10 @@ std::future<std::vector<float>> ChunkingService::computeEmbedding(
     const std::string& model_name
 )
 {
-    return std::async(std::launch::async, [=]() -> std::vector<float> {
+    return TaskExecutor::instance().submit([=]() -> std::vector<float> {
         try
         {
-            // Serialize embedding requests to avoid concurrency issues
-            std::lock_guard<std::mutex> lock(embedding_mutex_);
-            
+            // No lock: the engine queues and batches concurrent embedding jobs itself
             // Get the NodeManager and build candidate engine list (requested first)
             auto& nodeManager = ServerAPI::instance().getNodeManager();
             std::vector<std::string> candidates;
@@ -217,9 +310,16 @@ std::future<std::vector<float>> ChunkingService::computeEmbedding(
                 if (id != model_name) candidates.push_back(id);
             }
 
+            auto& cache = EmbeddingCache::instance();
             std::string usedModel;
             for (const auto& id : candidates)
             {
+                // Overlapping chunking windows repeat the same sentences
+                if (auto cached = cache.get(id, text, true))
+                {
+                    return std::move(*cached);
+                }
+
                 auto engine = nodeManager.getEngine(id);
                 if (!engine)
                 {
@@ -234,37 +334,38 @@ std::future<std::vector<float>> ChunkingService::computeEmbedding(
 
                 if (!params.isValid())
                 {
-                    ServerLogger::logWarning("Invalid embedding parameters; skipping engine '%s'", id.c_str());
+                    KOLOSAL_LOG_WARNING("Invalid embedding parameters; skipping engine '%s'", id.c_str());
                     continue;
                 }
 
                 int jobId = engine->submitEmbeddingJob(params);
                 if (jobId < 0)
                 {
-                    ServerLogger::logWarning("Engine '%s' rejected embedding job; trying next engine", id.c_str());
+                    KOLOSAL_LOG_WARNING("Engine '%s' rejected embedding job; trying next engine", id.c_str());
                     continue;
                 }
 
-                ServerLogger::logDebug("Submitted embedding job %d for model '%s', text length: %zu", jobId, id.c_str(), text.length());
+                KOLOSAL_LOG_DEBUG("Submitted embedding job %d for model '%s', text length: %zu", jobId, id.c_str(), text.length());
 
                 engine->waitForJob(jobId);
 
                 if (engine->hasJobError(jobId))
                 {
                     std::string error = engine->getJobError(jobId);
-                    ServerLogger::logWarning("Embedding job %d on model '%s' failed: %s", jobId, id.c_str(), error.c_str());
+                    KOLOSAL_LOG_WARNING("Embedding job %d on model '%s' failed: %s", jobId, id.c_str(), error.c_str());
                     continue;
                 }
 
                 EmbeddingResult result = engine->getEmbeddingResult(jobId);
                 if (result.embedding.empty())
                 {
-                    ServerLogger::logWarning("Model '%s' returned empty embedding; trying next engine", id.c_str());
+                    KOLOSAL_LOG_WARNING("Model '%s' returned empty embedding; trying next engine", id.c_str());
                     continue;
                 }
 
                 usedModel = id;
-                ServerLogger::logInfo("Completed embedding: using model '%s' with %zu dimensions", usedModel.c_str(), result.embedding.size());
+                KOLOSAL_LOG_INFO("Completed embedding: using model '%s' with %zu dimensions", usedModel.c_str(), result.embedding.size());
+                cache.put(id, text, params.normalize, result.embedding);
                 return result.embedding;
             }
 
@@ -272,7 +373,88 @@ std::future<std::vector<float>> ChunkingService::computeEmbedding(
         }
         catch (const std::exception& ex)
         {
-            ServerLogger::logError("Error computing embedding: %s", ex.what());
+            KOLOSAL_LOG_ERROR("Error computing embedding: %s", ex.what());
+            throw;
+        }
+    });
+}
+
+std::future<std::vector<std::vector<float>>> ChunkingService::computeEmbeddings(
+    const std::vector<std::string>& texts,
+    const std::string& model_name
+)
+{
+    return TaskExecutor::instance().submit([=]() -> std::vector<std::vector<float>> {
+        try
+        {
+            auto& nodeManager = ServerAPI::instance().getNodeManager();
+            std::string model_id = model_name;
+            if (model_id.empty() || !nodeManager.getEngine(model_id))
+            {
+                const auto ids = nodeManager.listEngineIds();
+                if (ids.empty())
+                {
+                    throw std::runtime_error("No available engine could compute embeddings");
+                }
+                model_id = ids.front();
+            }
+
+            auto& cache = EmbeddingCache::instance();
+            std::vector<std::vector<float>> embeddings(texts.size());
+            std::vector<size_t> pending;
+            for (size_t i = 0; i < texts.size(); ++i)
+            {
+                if (auto cached = cache.get(model_id, texts[i], true))
+                {
+                    embeddings[i] = std::move(*cached);
+                }
+                else
+                {
+                    pending.push_back(i);
+                }
+            }
+
+            if (!pending.empty())
+            {
+                auto engine = nodeManager.getEngine(model_id);
+                std::vector<EmbeddingResult> results;
+                if (engine)
+                {
+                    std::vector<EmbeddingParameters> params(pending.size());
+                    for (size_t i = 0; i < pending.size(); ++i)
+                    {
+                        params[i].input = texts[pending[i]];
+                        params[i].normalize = true;
+                    }
+                    results = engine->submitEmbeddingBatch(params);
+                }
+
+                size_t retried = 0;
+                for (size_t i = 0; i < pending.size(); ++i)
+                {
+                    const size_t index = pending[i];
+                    if (i < results.size() && !results[i].hasError && !results[i].embedding.empty())
+                    {
+                        cache.put(model_id, texts[index], true, results[i].embedding);
+                        embeddings[index] = std::move(results[i].embedding);
+                    }
+                    else
+                    {
+                        // Falls back across the other engines one text at a time
+                        embeddings[index] = computeEmbedding(texts[index], model_name).get();
+                        ++retried;
+                    }
+                }
+
+                KOLOSAL_LOG_DEBUG("Embedded %zu chunks with model '%s' in one batch (%zu cached, %zu retried singly)",
+                                       pending.size(), model_id.c_str(), texts.size() - pending.size(), retried);
+            }
+
+            return embeddings;
+        }
+        catch (const std::exception& ex)
+        {
+            KOLOSAL_LOG_ERROR("Error computing batch embeddings: %s", ex.what());
             throw;
         }
     });
@@ -285,23 +467,7 @@ float ChunkingService::cosineSimilarity(const std::vector<float>& a, const std::
         return 0.0f;
     }
     
-    float dot_product = 0.0f;
-    float norm_a = 0.0f;
-    float norm_b = 0.0f;
-    
-    for (size_t i = 0; i < a.size(); ++i)
-    {
-        dot_product += a[i] * b[i];
-        norm_a += a[i] * a[i];
-        norm_b += b[i] * b[i];
-    }
-    
-    if (norm_a == 0.0f || norm_b == 0.0f)
-    {
-        return 0.0f;
-    }
-    
-    return dot_product / (std::sqrt(norm_a) * std::sqrt(norm_b));
+    return vecmath::cosine(a.data(), b.data(), a.size());
 }
 
 int ChunkingService::estimateTokenCount(const std::string& text)
@@ -310,6 +476,36 @@ int ChunkingService::estimateTokenCount(const std::string& text)
     return std::max(1, static_cast<int>(text.length() / 4));
 }
 
+std::vector<int> ChunkingService::countTokens(const std::vector<std::string>& texts, const std::string& model_name) const
+{
+    std::vector<int> counts;
+    if (!model_name.empty())
+    {
+        try
+        {
+            if (auto engine = ServerAPI::instance().getNodeManager().getEngine(model_name))
+            {
+                counts = engine->countTokens(texts);
+            }
+        }
+        catch (const std::exception& ex)
+        {
+            KOLOSAL_LOG_WARNING("Token counting with model '%s' failed, estimating instead: %s", model_name.c_str(), ex.what());
+            counts.clear();
+        }
+    }
+
+    counts.resize(texts.size(), -1);
+    for (size_t i = 0; i < texts.size(); ++i)
+    {
+        if (counts[i] < 0)
+        {
+            counts[i] = estimateTokenCount(texts[i]);
+        }
+    }
+    return counts;
+}
+
 std::string ChunkingService::reconstructText(const std::vector<std::string>& tokens)
 {
     if (tokens.empty())
@@ -358,18 +554,39 @@ void ChunkingService::validateChunkingParameters(
     }
 }
 
-std::vector<std::string> ChunkingService::extractTokenSubset(
-    const std::vector<std::string>& tokens,
-    int start,
-    int end
-) const
+std::vector<std::string> ChunkingService::splitWords(const std::string& text)
 {
-    if (start < 0 || end > static_cast<int>(tokens.size()) || start >= end)
+    const auto spans = splitWordSpans(text);
+    std::vector<std::string> words;
+    words.reserve(spans.size());
+    for (const auto& span : spans)
     {
-        return {};
+        words.emplace_back(text, span.offset, span.length);
     }
-    
-    return std::vector<std::string>(tokens.begin() + start, tokens.begin() + end);
+    return words;
+}
+
+std::vector<TokenSpan> ChunkingService::splitWordSpans(std::string_view text)
+{
+    std::vector<TokenSpan> spans;
+    size_t pos = 0;
+    while (pos < text.size())
+    {
+        while (pos < text.size() && std::isspace(static_cast<unsigned char>(text[pos])))
+        {
+            ++pos;
+        }
+        size_t start = pos;
+        while (pos < text.size() && !std::isspace(static_cast<unsigned char>(text[pos])))
+        {
+            ++pos;
+        }
+        if (pos > start)
+        {
+            spans.push_back({start, pos - start});
+        }
+    }
+    return spans;
 }
 
 } // namespace retrieval
@@ -14,6 +14,10 @@ nlohmann::json ListDocumentsResponse::to_json() const
     j["document_ids"] = document_ids;
     j["total_count"] = total_count;
     j["collection_name"] = collection_name;
+    if (paged)
+    {
+        j["next_cursor"] = next_cursor.empty() ? nlohmann::json(nullptr) : nlohmann::json(next_cursor);
+    }
     return j;
 }
 
@@ -61,7 +65,7 @@ bool DocumentsInfoRequest::validate() const
 {
     if (ids.empty())
     {
-        ServerLogger::logWarning("DocumentsInfoRequest validation failed: empty ids array");
+        KOLOSAL_LOG_WARNING("DocumentsInfoRequest validation failed: empty ids array");
         return false;
     }
     
@@ -70,7 +74,7 @@ bool DocumentsInfoRequest::validate() const
     {
         if (id.empty() || std::all_of(id.begin(), id.end(), ::isspace))
         {
-            ServerLogger::logWarning("DocumentsInfoRequest validation failed: empty or whitespace-only ID");
+            KOLOSAL_LOG_WARNING("DocumentsInfoRequest validation failed: empty or whitespace-only ID");
             return false;
         }
     }
@@ -1,11 +1,18 @@
 #include "kolosal/retrieval/document_service.hpp"
 #include "kolosal/retrieval/remove_document_types.hpp"
+#include "kolosal/retrieval/lexical_index.hpp"
+#include "kolosal/retrieval/near_duplicate_index.hpp"
+#include "kolosal/retrieval/embedding_cache.hpp"
 #include "kolosal/vector_database.hpp"
+#include "kolosal/sharded_vector_database.hpp"
 #include "kolosal/server_api.hpp"
 #include "kolosal/server_config.hpp"
 #include "kolosal/node_manager.h"
 #include "kolosal/logger.hpp"
+#include "kolosal/memory_report.hpp"
+#include "kolosal/task_executor.hpp"
 #include "inference_interface.h"
+#include <curl/curl.h>
 #include <thread>
 #include <chrono>
 #include <sstream>
@@ -13,24 +20,313 @@
 #include <random>
 #include <set>
 #include <algorithm>
+#include <cmath>
 #include <numeric>
 #include <cstdint>
+#include <cstdio>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <map>
+#include <unordered_set>
 
 namespace kolosal
 {
 namespace retrieval
 {
 
+namespace
+{
+    // Blocking queue between ingestion stages; close() lets consumers drain it and exit
+    template <typename T>
+    class BoundedQueue
+    {
+    public:
+        explicit BoundedQueue(size_t capacity) : capacity_(capacity) {}
+        
+        void push(T item)
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            not_full_.wait(lock, [this]() { return items_.size() < capacity_; });
+            items_.push_back(std::move(item));
+            not_empty_.notify_one();
+        }
+        
+        bool pop(T& item)
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            not_empty_.wait(lock, [this]() { return !items_.empty() || closed_; });
+            if (items_.empty())
+            {
+                return false;
+            }
+            item = std::move(items_.front());
+            items_.pop_front();
+            not_full_.notify_one();
+            return true;
+        }
+        
+        // Wait for at least one item, then take everything queued
+        bool popAll(std::vector<T>& items)
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            not_empty_.wait(lock, [this]() { return !items_.empty() || closed_; });
+            if (items_.empty())
+            {
+                return false;
+            }
+            for (auto& item : items_)
+            {
+                items.push_back(std::move(item));
+            }
+            items_.clear();
+            not_full_.notify_all();
+            return true;
+        }
+        
+        void close()
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            closed_ = true;
+            not_empty_.notify_all();
+        }
+        
+    private:
+        size_t capacity_;
+        std::deque<T> items_;
+        bool closed_ = false;
+        std::mutex mutex_;
+        std::condition_variable not_empty_;
+        std::condition_variable not_full_;
+    };
+    
+    constexpr int kLexicalLoadPageSize = 1000;
+    constexpr int kLexicalLoadPasses = 3;      // Extra passes only run when documents were removed mid-load
+    constexpr int kMinFusionCandidates = 50;   // Depth of each ranking fed into hybrid fusion
+    constexpr float kRrfK = 60.0f;             // Reciprocal rank fusion damping constant
+    constexpr size_t kMaxIngestionJobs = 100;  // Finished jobs beyond this are forgotten, oldest first
+    constexpr int kYieldPollMs = 50;           // How often a yielding background batch rechecks the embedder
+    constexpr size_t kMaxPendingChunkKv = 1024;    // Chunks waiting for the chat model; more are dropped until retrieved again
+    constexpr size_t kMaxTrackedRetrievals = 100000; // Retrieval counts are forgotten all at once beyond this
+    constexpr long kReplicationConnectTimeoutMs = 5000;
+    constexpr long kChangesTimeoutSeconds = 60;
+    constexpr auto kReplicationRetryAfter = std::chrono::seconds(5);    // Pause after a failed replication request
+
+    std::string pointId(const nlohmann::json& point)
+    {
+        return point["id"].is_string() ? point["id"].get<std::string>() : std::to_string(point["id"].get<int64_t>());
+    }
+
+    bool wantsField(const std::vector<std::string>& fields, const std::string& key)
+    {
+        return fields.empty() || std::find(fields.begin(), fields.end(), key) != fields.end();
+    }
+
+    // Moves the payload out of the point. With fields set, only those payload keys are kept;
+    // "text" is one of them.
+    RetrievedDocument documentFromPoint(nlohmann::json& point, const std::vector<std::string>& fields = {})
+    {
+        RetrievedDocument doc;
+        doc.id = pointId(point);
+        auto& payload = point["payload"];
+        if (!payload.is_object())
+        {
+            return doc;
+        }
+        for (auto& [key, value] : payload.items())
+        {
+            if (!wantsField(fields, key))
+            {
+                continue;
+            }
+            if (key == "text")
+            {
+                if (value.is_string())
+                {
+                    doc.text = std::move(value.get_ref<std::string&>());
+                }
+            }
+            else
+            {
+                doc.metadata[key] = std::move(value);
+            }
+        }
+        return doc;
+    }
+
+    // Points of a search, getPoints or scroll response; Qdrant scrolls nest them under "points".
+    // A reference into the response, so its points can be read or moved out without a copy.
+    nlohmann::json& resultPoints(nlohmann::json& response_data)
+    {
+        if (!response_data.is_object())
+        {
+            response_data = nlohmann::json::object();
+        }
+        auto& result = response_data["result"];
+        if (result.is_array())
+        {
+            return result;
+        }
+        if (result.is_object() && result.contains("points") && result["points"].is_array())
+        {
+            return result["points"];
+        }
+        result = nlohmann::json::array();
+        return result;
+    }
+
+    // Payload field holding chunkHash(); an update keeps a stored chunk whose hash is unchanged
+    const char* const kChunkHashField = "chunk_hash";
+
+    // Identity of a chunk's content, its text and metadata. The metadata goes through a JSON
+    // object, which sorts its keys; fields the server adds itself are left out
+    std::string chunkHash(const Document& document)
+    {
+        nlohmann::json metadata = nlohmann::json::object();
+        for (const auto& [key, value] : document.metadata)
+        {
+            if (key != kChunkHashField && key != "indexed_at")
+            {
+                metadata[key] = value;
+            }
+        }
+        uint64_t hash = 1469598103934665603ULL;
+        auto mix = [&hash](const std::string& bytes) {
+            for (unsigned char c : bytes)
+            {
+                hash ^= c;
+                hash *= 0x100000001B3ULL;
+            }
+        };
+        mix(document.text);
+        mix(std::string(1, '\0'));
+        mix(metadata.dump());
+        char hex[17];
+        std::snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(hash));
+        return hex;
+    }
+
+    size_t appendToString(char* data, size_t size, size_t count, void* target)
+    {
+        static_cast<std::string*>(target)->append(data, size * count);
+        return size * count;
+    }
+
+    size_t writeToStream(char* data, size_t size, size_t count, void* target)
+    {
+        auto* out = static_cast<std::ostream*>(target);
+        return out->write(data, static_cast<std::streamsize>(size * count)) ? size * count : 0;
+    }
+
+    // Response headers by lowercase name
+    size_t collectHeader(char* data, size_t size, size_t count, void* target)
+    {
+        const std::string line(data, size * count);
+        const size_t colon = line.find(':');
+        if (colon != std::string::npos)
+        {
+            std::string name = line.substr(0, colon);
+            std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+            const size_t start = line.find_first_not_of(" \t", colon + 1);
+            const size_t end = line.find_last_not_of(" \t\r\n");
+            (*static_cast<std::map<std::string, std::string>*>(target))[name] =
+                start == std::string::npos || end < start ? std::string() : line.substr(start, end - start + 1);
+        }
+        return size * count;
+    }
+
+    // Aborts a transfer once the service is shutting down
+    int abortOnStop(void* stopping, curl_off_t, curl_off_t, curl_off_t, curl_off_t)
+    {
+        return static_cast<std::atomic<bool>*>(stopping)->load() ? 1 : 0;
+    }
+
+    ReplicationResult replicationResult(VectorResult result)
+    {
+        ReplicationResult replication;
+        replication.success = result.success;
+        replication.status = result.success ? 200 : result.status_code == 200 ? 500 : result.status_code;
+        replication.error = std::move(result.error_message);
+        replication.info = std::move(result.response_data);
+        return replication;
+    }
+
+    // Cursor of the page after a scroll response, or "" after the last; Qdrant nests it under "result"
+    std::string nextPageOffset(const nlohmann::json& response_data)
+    {
+        nlohmann::json next;
+        if (response_data.contains("next_page_offset"))
+        {
+            next = response_data["next_page_offset"];
+        }
+        else if (response_data.contains("result") && response_data["result"].is_object() &&
+                 response_data["result"].contains("next_page_offset"))
+        {
+            next = response_data["result"]["next_page_offset"];
+        }
+        return next.is_string() ? next.get<std::string>() :
+               next.is_number() ? std::to_string(next.get<int64_t>()) : std::string();
+    }
+}
+
 class DocumentService::Impl
 {
 public:
     DatabaseConfig config_;
     std::unique_ptr<IVectorDatabase> vector_db_;
+    std::unique_ptr<LexicalIndex> lexical_;
+    std::unique_ptr<NearDuplicateIndex> dedup_;     // Signatures of stored chunks when ingestion.dedup is on
     bool initialized_ = false;
     std::mutex mutex_;
+    std::thread text_index_loader_;
+    std::atomic<bool> stopping_{false};
+    
+    struct IngestionJob
+    {
+        IngestionJobStatus status;
+        std::vector<Document> documents;    // Released once the job finishes
+        bool update = false;                // AddDocumentsRequest::mode == "update"
+        std::string source_field;
+        std::atomic<bool> cancelled{false};
+    };
+    
+    mutable std::mutex jobs_mutex_;
+    std::condition_variable jobs_cv_;
+    std::unordered_map<std::string, std::shared_ptr<IngestionJob>> jobs_;
+    std::deque<std::string> job_order_;                     // Job IDs in submission order
+    std::deque<std::shared_ptr<IngestionJob>> job_queue_;   // Jobs waiting for the runner
+    std::thread job_runner_;                                // Started by the first job
+    
+    // Chunks waiting to be precomputed on config_.chunkKv.model, and how often /retrieve returned each
+    std::mutex chunk_kv_mutex_;
+    std::condition_variable chunk_kv_cv_;
+    std::deque<std::string> chunk_kv_queue_;
+    std::unordered_map<std::string, int> chunk_retrievals_;  // By document ID
+    std::thread chunk_kv_worker_;                            // Started by the first queued chunk
+    
+    uint64_t memory_source_ = 0;                             // Section of /debug/memory
+    
+    // Following config_.replication.source: its snapshot first, then its change stream
+    std::thread replicator_;
+    mutable std::mutex replication_mutex_;
+    std::condition_variable replication_cv_;                 // Wakes the follower early to stop
+    nlohmann::json replication_status_;
     
     Impl(const DatabaseConfig& config) : config_(config)
     {
+        if (config_.lexical.enabled)
+        {
+            lexical_ = std::make_unique<LexicalIndex>(config_.lexical.k1, config_.lexical.b);
+        }
+        if (config_.ingestion.dedup.enabled)
+        {
+            dedup_ = makeDedupIndex();
+        }
+        
         // Create vector database based on configuration
         try
         {
@@ -47,16 +343,45 @@ public:
                 db_config["nprobe"] = config_.faiss.nprobe;
                 db_config["useGPU"] = config_.faiss.useGPU;
                 db_config["gpuDevice"] = config_.faiss.gpuDevice;
+                db_config["gpuMode"] = config_.faiss.gpuMode;
+                db_config["gpuDevices"] = config_.faiss.gpuDevices;
+                db_config["gpuSyncPoints"] = config_.faiss.gpuSyncPoints;
                 db_config["metricType"] = config_.faiss.metricType;
+                db_config["walSyncMs"] = config_.faiss.walSyncMs;
+                db_config["checkpointIntervalSec"] = config_.faiss.checkpointIntervalSec;
+                db_config["checkpointWalMB"] = config_.faiss.checkpointWalMB;
+                db_config["deltaMergePoints"] = config_.faiss.deltaMergePoints;
+                db_config["autoIndexType"] = config_.faiss.autoIndexType;
+                db_config["autoIndexThreshold"] = config_.faiss.autoIndexThreshold;
+                db_config["recallTarget"] = config_.faiss.recallTarget;
+                db_config["efSearch"] = config_.faiss.efSearch;
+                db_config["tombstoneCompactRatio"] = config_.faiss.tombstoneCompactRatio;
+                db_config["mmapIndex"] = config_.faiss.mmapIndex;
+                db_config["diskRerankFactor"] = config_.faiss.diskRerankFactor;
+                db_config["exactRerank"] = config_.faiss.exactRerank;
+                db_config["textCompression"] = config_.faiss.textCompression;
+                for (const auto& [name, collection] : config_.faiss.collections)
+                {
+                    db_config["collections"][name] = {
+                        {"indexType", collection.indexType},
+                        {"metricType", collection.metricType},
+                        {"dimensions", collection.dimensions},
+                        {"nlist", collection.nlist},
+                        {"nprobe", collection.nprobe},
+                        {"efSearch", collection.efSearch},
+                        {"gpuMode", collection.gpuMode},
+                        {"textCompression", collection.textCompression}
+                    };
+                }
                 
-                vector_db_ = VectorDatabaseFactory::create(VectorDatabaseFactory::DatabaseType::FAISS, db_config);
-                ServerLogger::logInfo("DocumentService initialized with FAISS vector database");
+                vector_db_ = createVectorDatabase(VectorDatabaseFactory::DatabaseType::FAISS, db_config);
+                KOLOSAL_LOG_INFO("DocumentService initialized with FAISS vector database");
 #else
-                ServerLogger::logError("FAISS selected but not compiled in, attempting fallback to Qdrant");
+                KOLOSAL_LOG_ERROR("FAISS selected but not compiled in, attempting fallback to Qdrant");
                 // Auto-enable Qdrant fallback if disabled
                 if (!config_.qdrant.enabled)
                 {
-                    ServerLogger::logWarning("Qdrant disabled in configuration; enabling fallback with default parameters");
+                    KOLOSAL_LOG_WARNING("Qdrant disabled in configuration; enabling fallback with default parameters");
                     config_.qdrant.enabled = true;
                     if (config_.qdrant.host.empty()) config_.qdrant.host = "localhost";
                     if (config_.qdrant.port == 0) config_.qdrant.port = 6333;
@@ -78,13 +403,17 @@ public:
                     db_config["timeout"] = config_.qdrant.timeout;
                     db_config["maxConnections"] = config_.qdrant.maxConnections;
                     db_config["connectionTimeout"] = config_.qdrant.connectionTimeout;
+                    db_config["http2"] = config_.qdrant.http2;
+                    db_config["replicas"] = config_.qdrant.replicas;
+                    db_config["hedge"] = config_.qdrant.hedge;
+                    db_config["hedgeMinDelayMs"] = config_.qdrant.hedgeMinDelayMs;
                     
                     vector_db_ = VectorDatabaseFactory::create(VectorDatabaseFactory::DatabaseType::QDRANT, db_config);
-                    ServerLogger::logInfo("DocumentService initialized with Qdrant client (automatic fallback)");
+                    KOLOSAL_LOG_INFO("DocumentService initialized with Qdrant client (automatic fallback)");
                 }
                 else
                 {
-                    ServerLogger::logError("No vector database available after failed FAISS fallback");
+                    KOLOSAL_LOG_ERROR("No vector database available after failed FAISS fallback");
                 }
 #endif
             }
@@ -98,20 +427,77 @@ public:
                     db_config["timeout"] = config_.qdrant.timeout;
                     db_config["maxConnections"] = config_.qdrant.maxConnections;
                     db_config["connectionTimeout"] = config_.qdrant.connectionTimeout;
+                    db_config["http2"] = config_.qdrant.http2;
+                    db_config["replicas"] = config_.qdrant.replicas;
+                    db_config["hedge"] = config_.qdrant.hedge;
+                    db_config["hedgeMinDelayMs"] = config_.qdrant.hedgeMinDelayMs;
                     
-                    vector_db_ = VectorDatabaseFactory::create(VectorDatabaseFactory::DatabaseType::QDRANT, db_config);
-                    ServerLogger::logInfo("DocumentService initialized with Qdrant client");
+                    vector_db_ = createVectorDatabase(VectorDatabaseFactory::DatabaseType::QDRANT, db_config);
+                    KOLOSAL_LOG_INFO("DocumentService initialized with Qdrant client");
                 }
                 else
                 {
-                    ServerLogger::logWarning("DocumentService initialized but Qdrant is disabled in configuration");
+                    KOLOSAL_LOG_WARNING("DocumentService initialized but Qdrant is disabled in configuration");
                 }
             }
         }
         catch (const std::exception& ex)
         {
-            ServerLogger::logError("Failed to initialize vector database: %s", ex.what());
+            KOLOSAL_LOG_ERROR("Failed to initialize vector database: %s", ex.what());
+        }
+        
+        memory_source_ = MemoryReport::instance().addSource("documents", [this]() {
+            nlohmann::json usage = {
+                {"vector_store", vector_db_ ? vector_db_->memoryUsage() : nlohmann::json()},
+                {"lexical_documents", lexical_ ? lexical_->size() : 0}
+            };
+            if (dedup_)
+            {
+                usage["dedup_chunks"] = dedup_->size();
+                usage["dedup_bytes"] = dedup_->memoryBytes();
+            }
+            std::lock_guard<std::mutex> lock(jobs_mutex_);
+            usage["ingestion_jobs"] = jobs_.size();
+            usage["queued_ingestion_jobs"] = job_queue_.size();
+            return usage;
+        });
+    }
+    
+    std::unique_ptr<NearDuplicateIndex> makeDedupIndex() const
+    {
+        const auto& dedup = config_.ingestion.dedup;
+        return std::make_unique<NearDuplicateIndex>(dedup.threshold, dedup.shingleWords, dedup.numHashes);
+    }
+    
+    // One backend, or one per configured shard behind a ShardedVectorDatabase
+    std::unique_ptr<IVectorDatabase> createVectorDatabase(VectorDatabaseFactory::DatabaseType type, const nlohmann::json& db_config)
+    {
+        if (config_.shards.empty())
+        {
+            return VectorDatabaseFactory::create(type, db_config);
+        }
+        
+        std::vector<std::unique_ptr<IVectorDatabase>> shards;
+        for (size_t i = 0; i < config_.shards.size(); ++i)
+        {
+            const auto& shard = config_.shards[i];
+            nlohmann::json shard_config = db_config;
+            if (type == VectorDatabaseFactory::DatabaseType::FAISS)
+            {
+                shard_config["indexPath"] = !shard.indexPath.empty() ? shard.indexPath :
+                    (std::filesystem::path(config_.faiss.indexPath) / ("shard-" + std::to_string(i))).string();
+            }
+            else
+            {
+                if (!shard.host.empty()) shard_config["host"] = shard.host;
+                if (shard.port > 0) shard_config["port"] = shard.port;
+                if (!shard.apiKey.empty()) shard_config["apiKey"] = shard.apiKey;
+                shard_config["replicas"] = shard.replicas; // qdrant.replicas hold the unsharded collection
+            }
+            shards.push_back(VectorDatabaseFactory::create(type, shard_config));
         }
+        KOLOSAL_LOG_INFO("Vector store split over %zu shards by document ID", shards.size());
+        return std::make_unique<ShardedVectorDatabase>(std::move(shards));
     }
     
     // Decide which embedding model to use when none is explicitly provided
@@ -178,12 +564,18 @@ public:
     
     std::future<std::vector<float>> generateEmbedding(const std::string& text, const std::string& model_id)
     {
-    return std::async(std::launch::async, [this, text, model_id]() -> std::vector<float> {
+    return TaskExecutor::instance().submit([this, text, model_id]() -> std::vector<float> {
             try
             {
         std::string effective_model_id = chooseEmbeddingModelId(model_id);
                 
-                ServerLogger::logDebug("Generating embedding for text (length: %zu) using model: %s", 
+                auto& cache = EmbeddingCache::instance();
+                if (auto cached = cache.get(effective_model_id, text, true))
+                {
+                    return std::move(*cached);
+                }
+                
+                KOLOSAL_LOG_DEBUG("Generating embedding for text (length: %zu) using model: %s", 
                                        text.length(), effective_model_id.c_str());
                 
                 // Get the NodeManager and inference engine
@@ -212,13 +604,13 @@ public:
                     throw std::runtime_error("Failed to submit embedding job to inference engine");
                 }
                 
-                ServerLogger::logDebug("Submitted embedding job %d for model '%s'", jobId, effective_model_id.c_str());
+                KOLOSAL_LOG_DEBUG("Submitted embedding job %d for model '%s'", jobId, effective_model_id.c_str());
                 
                 // Wait for job completion with timeout
                 const int max_wait_seconds = 30;
                 int wait_count = 0;
                 
-                ServerLogger::logDebug("Waiting for embedding job %d to complete", jobId);
+                KOLOSAL_LOG_DEBUG("Waiting for embedding job %d to complete", jobId);
                 
                 while (!engine->isJobFinished(jobId) && wait_count < max_wait_seconds * 10)
                 {
@@ -246,13 +638,14 @@ public:
                     throw std::runtime_error("Empty embedding result from inference engine");
                 }
                 
-                ServerLogger::logDebug("Generated embedding with %zu dimensions", result.embedding.size());
+                KOLOSAL_LOG_DEBUG("Generated embedding with %zu dimensions", result.embedding.size());
                 
+                cache.put(effective_model_id, text, params.normalize, result.embedding);
                 return result.embedding;
             }
             catch (const std::exception& ex)
             {
-                ServerLogger::logError("Error generating embedding: %s", ex.what());
+                KOLOSAL_LOG_ERROR("Error generating embedding: %s", ex.what());
                 throw;
             }
         });
@@ -262,7 +655,7 @@ public:
     std::future<std::vector<std::pair<size_t, std::vector<float>>>> generateEmbeddingsBatch(
         const std::vector<std::pair<size_t, std::string>>& texts, const std::string& model_id)
     {
-    return std::async(std::launch::async, [this, texts, model_id]() -> std::vector<std::pair<size_t, std::vector<float>>> {
+    return TaskExecutor::instance().submit([this, texts, model_id]() -> std::vector<std::pair<size_t, std::vector<float>>> {
             std::vector<std::pair<size_t, std::vector<float>>> results;
             
             if (texts.empty()) {
@@ -272,8 +665,22 @@ public:
             try {
                 std::string effective_model_id = chooseEmbeddingModelId(model_id);
                 
-                ServerLogger::logInfo("Generating embeddings for batch of %zu texts using model: %s", 
-                                     texts.size(), effective_model_id.c_str());
+                // Unchanged chunks of a re-ingested document come from the cache
+                auto& cache = EmbeddingCache::instance();
+                std::vector<size_t> pending;
+                for (size_t i = 0; i < texts.size(); ++i) {
+                    if (auto cached = cache.get(effective_model_id, texts[i].second, true)) {
+                        results.emplace_back(texts[i].first, std::move(*cached));
+                    } else {
+                        pending.push_back(i);
+                    }
+                }
+                if (pending.empty()) {
+                    return results;
+                }
+                
+                KOLOSAL_LOG_INFO("Generating embeddings for batch of %zu texts (%zu cached) using model: %s", 
+                                     texts.size(), texts.size() - pending.size(), effective_model_id.c_str());
                 
                 // Get the NodeManager and inference engine
                 auto& nodeManager = ServerAPI::instance().getNodeManager();
@@ -283,87 +690,35 @@ public:
                     throw std::runtime_error("Embedding model '" + effective_model_id + "' not found or could not be loaded");
                 }
                 
-                // Process texts in this batch concurrently, but limit concurrency to avoid resource exhaustion
-                std::vector<std::future<std::vector<float>>> embedding_futures;
-                
-                for (const auto& [index, text] : texts) {
-                    embedding_futures.push_back(std::async(std::launch::async, [this, text, effective_model_id]() -> std::vector<float> {
-                        try {
-                            // Get engine instance for this thread
-                            auto& nodeManager = ServerAPI::instance().getNodeManager();
-                            auto engine = nodeManager.getEngine(effective_model_id);
-                            
-                            if (!engine) {
-                                throw std::runtime_error("Embedding model not available");
-                            }
-                            
-                            // Prepare embedding parameters
-                            EmbeddingParameters params;
-                            params.input = text;
-                            params.seqId = 0;
-                            
-                            if (!params.isValid()) {
-                                throw std::runtime_error("Invalid embedding parameters");
-                            }
-                            
-                            // Submit embedding job
-                            int jobId = engine->submitEmbeddingJob(params);
-                            if (jobId < 0) {
-                                throw std::runtime_error("Failed to submit embedding job");
-                            }
-                            
-                            // Wait for completion with timeout
-                            const int max_wait_seconds = 30;
-                            int wait_count = 0;
-                            
-                            while (!engine->isJobFinished(jobId) && wait_count < max_wait_seconds * 10) {
-                                std::this_thread::sleep_for(std::chrono::milliseconds(100));
-                                wait_count++;
-                            }
-                            
-                            if (!engine->isJobFinished(jobId)) {
-                                throw std::runtime_error("Embedding job timed out after " + std::to_string(max_wait_seconds) + " seconds");
-                            }
-                            
-                            // Check for errors
-                            if (engine->hasJobError(jobId)) {
-                                std::string error = engine->getJobError(jobId);
-                                throw std::runtime_error("Inference error: " + error);
-                            }
-                            
-                            // Get result
-                            EmbeddingResult result = engine->getEmbeddingResult(jobId);
-                            
-                            if (result.embedding.empty()) {
-                                throw std::runtime_error("Empty embedding result");
-                            }
-                            
-                            return result.embedding;
-                        } catch (const std::exception& ex) {
-                            ServerLogger::logError("Error generating embedding in batch: %s", ex.what());
-                            throw;
-                        }
-                    }));
+                // Submit the whole batch at once; the engine packs it into shared decodes
+                std::vector<EmbeddingParameters> params(pending.size());
+                for (size_t i = 0; i < pending.size(); ++i) {
+                    params[i].input = texts[pending[i]].second;
+                    params[i].seqId = 0;
                 }
                 
+                std::vector<EmbeddingResult> batch_results = engine->submitEmbeddingBatch(params);
+                
                 // Collect results
-                for (size_t i = 0; i < embedding_futures.size(); ++i) {
-                    try {
-                        auto embedding = embedding_futures[i].get();
-                        results.emplace_back(texts[i].first, std::move(embedding));
-                    } catch (const std::exception& ex) {
-                        ServerLogger::logError("Failed to get embedding result for text %zu in batch: %s", 
-                                             texts[i].first, ex.what());
+                for (size_t i = 0; i < batch_results.size() && i < pending.size(); ++i) {
+                    const auto& text = texts[pending[i]];
+                    if (batch_results[i].hasError || batch_results[i].embedding.empty()) {
+                        KOLOSAL_LOG_ERROR("Failed to get embedding result for text %zu in batch: %s", 
+                                             text.first,
+                                             batch_results[i].hasError ? batch_results[i].errorMessage.c_str() : "Empty embedding result");
                         // Continue processing other embeddings
+                        continue;
                     }
+                    cache.put(effective_model_id, text.second, params[i].normalize, batch_results[i].embedding);
+                    results.emplace_back(text.first, std::move(batch_results[i].embedding));
                 }
                 
-                ServerLogger::logInfo("Completed batch embedding generation: %zu/%zu successful", 
+                KOLOSAL_LOG_INFO("Completed batch embedding generation: %zu/%zu successful", 
                                      results.size(), texts.size());
                 
                 return results;
             } catch (const std::exception& ex) {
-                ServerLogger::logError("Error in batch embedding generation: %s", ex.what());
+                KOLOSAL_LOG_ERROR("Error in batch embedding generation: %s", ex.what());
                 throw;
             }
         });
@@ -371,12 +726,12 @@ public:
     
     std::future<bool> ensureCollection(const std::string& collection_name, int vector_size)
     {
-        return std::async(std::launch::async, [this, collection_name, vector_size]() -> bool {
+        return TaskExecutor::instance().submit([this, collection_name, vector_size]() -> bool {
             try
             {
                 if (!vector_db_)
                 {
-                    ServerLogger::logError("Vector database not initialized");
+                    KOLOSAL_LOG_ERROR("Vector database not initialized");
                     return false;
                 }
                 
@@ -385,279 +740,1364 @@ public:
                 
                 if (exists_result.success)
                 {
-                    ServerLogger::logDebug("Collection '%s' already exists", collection_name.c_str());
+                    KOLOSAL_LOG_DEBUG("Collection '%s' already exists", collection_name.c_str());
                     return true;
                 }
                 
                 // Create collection
-                ServerLogger::logInfo("Creating collection '%s' with vector size %d", collection_name.c_str(), vector_size);
+                KOLOSAL_LOG_INFO("Creating collection '%s' with vector size %d", collection_name.c_str(), vector_size);
                 std::string distance_metric = (config_.vectorDatabase == DatabaseConfig::VectorDatabase::FAISS && 
                                                 config_.faiss.metricType == "IP") ? "IP" : "Cosine";
                 auto create_result = vector_db_->createCollection(collection_name, vector_size, distance_metric).get();
                 
                 if (!create_result.success)
                 {
-                    ServerLogger::logError("Failed to create collection '%s': %s", 
+                    KOLOSAL_LOG_ERROR("Failed to create collection '%s': %s", 
                                            collection_name.c_str(), create_result.error_message.c_str());
                     return false;
                 }
                 
-                ServerLogger::logInfo("Successfully created collection '%s'", collection_name.c_str());
+                KOLOSAL_LOG_INFO("Successfully created collection '%s'", collection_name.c_str());
                 return true;
             }
             catch (const std::exception& ex)
             {
-                ServerLogger::logError("Error ensuring collection '%s': %s", collection_name.c_str(), ex.what());
+                KOLOSAL_LOG_ERROR("Error ensuring collection '%s': %s", collection_name.c_str(), ex.what());
                 return false;
             }
         });
     }
-};
-
-// DocumentService implementations
-DocumentService::DocumentService(const DatabaseConfig& database_config)
-    : pImpl(std::make_unique<Impl>(database_config))
-{
-}
-
-DocumentService::~DocumentService() = default;
-
-DocumentService::DocumentService(DocumentService&&) noexcept = default;
-DocumentService& DocumentService::operator=(DocumentService&&) noexcept = default;
-
-std::future<bool> DocumentService::initialize()
-{
-    return std::async(std::launch::async, [this]() -> bool {
-        std::lock_guard<std::mutex> lock(pImpl->mutex_);
-        
-        if (pImpl->initialized_)
-        {
-            return true;
-        }
+    
+    // Optional callbacks a background job uses to follow and throttle ingest()
+    struct IngestHooks
+    {
+        std::function<bool()> cancelled;                    // Checked before each batch is queued
+        std::function<void(size_t)> before_embed;           // Gets the documents this run is already embedding
+        std::function<void(size_t, size_t)> progress;       // Documents a stage just indexed and failed
+    };
+    
+    // Embed and store documents, returning per-document results in request order. With dedup
+    // (and ingestion.dedup on), near-duplicates of stored chunks or of earlier documents in the
+    // request are neither embedded nor stored; their result names the chunk they duplicate
+    AddDocumentsResponse ingest(const std::vector<Document>& documents, const std::string& collection_name,
+                                const IngestHooks& hooks, bool dedup = true)
+    {
+        // Staged pipeline: this thread cuts batches, embed workers turn them into points and
+        // upsert workers write them, with bounded queues in between. Embedding the next batch
+        // overlaps writing the previous one, so throughput follows the slowest stage.
+        const size_t batch_size = static_cast<size_t>(std::max(1,
+            config_.vectorDatabase == DatabaseConfig::VectorDatabase::FAISS ? 5 : config_.qdrant.embeddingBatchSize));
+        const auto& ingestion = config_.ingestion;
+        const size_t queue_depth = static_cast<size_t>(std::max(1, ingestion.queueDepth));
+        KOLOSAL_LOG_INFO("Using embedding batch size %zu with %d embed and %d upsert workers",
+                              batch_size, ingestion.embedWorkers, ingestion.upsertWorkers);
         
-        if (!pImpl->vector_db_)
-        {
-            ServerLogger::logError("DocumentService: Vector database not initialized");
-            return false;
+        const size_t count = documents.size();
+        std::vector<std::string> document_ids;
+        for (size_t i = 0; i < count; ++i) {
+            document_ids.push_back(generateDocumentId());
         }
+        // Each document's outcome is written only by the worker holding its batch
+        std::vector<char> indexed(count, 0);
+        std::vector<std::string> errors(count);
         
-        try
-        {
-            // Test connection
-            std::string db_type = (pImpl->config_.vectorDatabase == DatabaseConfig::VectorDatabase::FAISS) ? "FAISS" : "Qdrant";
-            ServerLogger::logInfo("DocumentService: Testing %s connection...", db_type.c_str());
-            auto connection_result = pImpl->vector_db_->testConnection().get();
-            
-            if (!connection_result.success)
-            {
-                ServerLogger::logError("DocumentService: Failed to connect to %s: %s", 
-                                       db_type.c_str(), connection_result.error_message.c_str());
-                return false;
+        std::atomic<size_t> embedding{0};
+        auto reportProgress = [&](size_t indexed_count, size_t failed_count) {
+            if (hooks.progress && (indexed_count || failed_count)) {
+                hooks.progress(indexed_count, failed_count);
             }
-            
-            if (pImpl->config_.vectorDatabase == DatabaseConfig::VectorDatabase::FAISS)
-            {
-                ServerLogger::logInfo("DocumentService: Successfully initialized FAISS at %s", 
-                                      pImpl->config_.faiss.indexPath.c_str());
-                // Auto-create default collection if it does not exist yet
-                const std::string default_collection = pImpl->config_.qdrant.collectionName.empty() ? "documents" : pImpl->config_.qdrant.collectionName;
-                try {
-                    auto exists = pImpl->vector_db_->collectionExists(default_collection).get();
-                    if (!exists.success) {
-                        ServerLogger::logInfo("FAISS default collection '%s' not found. Creating with dimension %d", 
-                                              default_collection.c_str(), pImpl->config_.faiss.dimensions);
-                        auto created = pImpl->vector_db_->createCollection(default_collection, pImpl->config_.faiss.dimensions, 
-                            pImpl->config_.faiss.metricType == "IP" ? "IP" : "L2").get();
-                        if (!created.success) {
-                            ServerLogger::logError("Failed to create FAISS collection '%s': %s", default_collection.c_str(), created.error_message.c_str());
-                            return false;
-                        }
-                    }
-                } catch (const std::exception& ex) {
-                    ServerLogger::logError("Error ensuring FAISS default collection: %s", ex.what());
-                    return false;
+        };
+        
+        // Documents to embed, in request order
+        const bool skip_duplicates = dedup && dedup_;
+        std::vector<size_t> order;
+        std::vector<NearDuplicateIndex::Signature> signatures;
+        std::vector<std::string> duplicate_of;          // Stored chunk a document duplicates
+        std::vector<size_t> duplicate_in_request;       // ...or the earlier document it duplicates
+        if (skip_duplicates) {
+            signatures.resize(count);
+            duplicate_of.resize(count);
+            duplicate_in_request.assign(count, count);
+            auto pending = makeDedupIndex();
+            NearDuplicateIndex::Match match;
+            for (size_t i = 0; i < count; ++i) {
+                signatures[i] = dedup_->signature(documents[i].text);
+                if (dedup_->find(signatures[i], match)) {
+                    duplicate_of[i] = match.id;
+                } else if (pending->find(signatures[i], match)) {
+                    duplicate_in_request[i] = static_cast<size_t>(std::stoull(match.id));
+                } else {
+                    pending->add(std::to_string(i), signatures[i]);
+                    order.push_back(i);
                 }
             }
-            else
-            {
-                ServerLogger::logInfo("DocumentService: Successfully connected to Qdrant at %s:%d",
-                                      pImpl->config_.qdrant.host.c_str(), pImpl->config_.qdrant.port);
+            const size_t stored_duplicates = static_cast<size_t>(
+                std::count_if(duplicate_of.begin(), duplicate_of.end(), [](const std::string& id) { return !id.empty(); }));
+            if (order.size() < count) {
+                KOLOSAL_LOG_INFO("Skipping %zu near-duplicate documents (%zu of stored chunks)",
+                                      count - order.size(), stored_duplicates);
+            }
+            reportProgress(stored_duplicates, 0);
+        } else {
+            order.resize(count);
+            for (size_t i = 0; i < count; ++i) {
+                order[i] = i;
             }
-            
-            pImpl->initialized_ = true;
-            return true;
-        }
-        catch (const std::exception& ex)
-        {
-            ServerLogger::logError("DocumentService: Initialization failed: %s", ex.what());
-            return false;
         }
-    });
-}
-
-std::future<AddDocumentsResponse> DocumentService::addDocuments(const AddDocumentsRequest& request)
-{
-    return std::async(std::launch::async, [this, request]() -> AddDocumentsResponse {
-        AddDocumentsResponse response;
+        const size_t to_embed = order.size();
         
-        try
-        {
-            if (!pImpl->initialized_)
-            {
-                throw std::runtime_error("DocumentService not initialized");
-            }
-            
-            if (!pImpl->vector_db_)
-            {
-                throw std::runtime_error("Vector database not initialized");
-            }
-            
-            std::string collection_name = "documents"; // Always use "documents" collection
-            
-            response.collection_name = collection_name;
-            
-            ServerLogger::logInfo("Processing %zu documents for collection '%s'", 
-                                  request.documents.size(), collection_name.c_str());
-            
-            // Use batching to generate embeddings
-            const int batch_size = (pImpl->config_.vectorDatabase == DatabaseConfig::VectorDatabase::FAISS ? 
-                                     5 : pImpl->config_.qdrant.embeddingBatchSize);
-            ServerLogger::logInfo("Using embedding batch size: %d", batch_size);
-            
-            std::vector<std::string> document_ids;
-            std::vector<QdrantPoint> points;
-            int vector_size = 0;
-            
-            // Generate document IDs first
-            for (size_t i = 0; i < request.documents.size(); ++i) {
-                document_ids.push_back(pImpl->generateDocumentId());
-            }
-            
-            // Process documents in batches
-            for (size_t batch_start = 0; batch_start < request.documents.size(); batch_start += batch_size)
+        BoundedQueue<std::pair<size_t, size_t>> batches(queue_depth);
+        BoundedQueue<std::vector<std::pair<size_t, VectorPoint>>> embedded(queue_depth);
+        std::atomic<int> vector_size{0};
+        std::once_flag collection_once;
+        bool collection_ready = false;
+        
+        auto embedWorker = [&]() {
+            std::pair<size_t, size_t> batch;
+            while (batches.pop(batch))
             {
-                size_t batch_end = std::min(batch_start + batch_size, request.documents.size());
-                size_t current_batch_size = batch_end - batch_start;
+                const size_t batch_start = batch.first;
+                const size_t batch_end = batch.second;
+                KOLOSAL_LOG_INFO("Embedding batch %zu-%zu (%zu documents)",
+                                      batch_start, batch_end - 1, batch_end - batch_start);
                 
-                ServerLogger::logInfo("Processing batch %zu-%zu (%zu documents)", 
-                                     batch_start, batch_end - 1, current_batch_size);
-                
-                // Prepare texts for this batch with their original indices
                 std::vector<std::pair<size_t, std::string>> batch_texts;
-                for (size_t i = batch_start; i < batch_end; ++i) {
-                    batch_texts.emplace_back(i, request.documents[i].text);
+                for (size_t p = batch_start; p < batch_end; ++p) {
+                    batch_texts.emplace_back(order[p], documents[order[p]].text);
+                    errors[order[p]] = "Failed to generate embedding";
+                }
+                
+                if (hooks.before_embed) {
+                    hooks.before_embed(embedding.load());
                 }
+                embedding += batch_end - batch_start;
                 
-                // Generate embeddings for this batch
+                std::vector<std::pair<size_t, VectorPoint>> points;
                 try {
-                    auto batch_future = pImpl->generateEmbeddingsBatch(batch_texts, "");
-                    auto batch_results = batch_future.get();
-                    
-                    // Process batch results
-                    for (const auto& [original_index, embedding] : batch_results) {
-                        try {
-                            if (vector_size == 0) {
-                                vector_size = static_cast<int>(embedding.size());
-                            } else if (static_cast<int>(embedding.size()) != vector_size) {
-                                throw std::runtime_error("Inconsistent embedding dimensions");
-                            }
-                            
-                            QdrantPoint point;
-                            point.id = document_ids[original_index];
-                            point.vector = embedding;
-                            
-                            // Add document metadata
-                            point.payload["text"] = request.documents[original_index].text;
-                            for (const auto& [key, value] : request.documents[original_index].metadata) {
-                                point.payload[key] = value;
-                            }
-                            
-                            // Add timestamp
-                            auto now = std::chrono::system_clock::now();
-                            auto timestamp = std::chrono::duration_cast<std::chrono::seconds>(now.time_since_epoch()).count();
-                            point.payload["indexed_at"] = timestamp;
-                            
-                            points.push_back(std::move(point));
-                            response.addSuccess(document_ids[original_index]);
-                            
-                        } catch (const std::exception& ex) {
-                            ServerLogger::logError("Failed to process embedding result for document %zu: %s", 
-                                                 original_index, ex.what());
-                            response.addFailure("Failed to process embedding: " + std::string(ex.what()));
+                    auto batch_results = generateEmbeddingsBatch(batch_texts, "").get();
+                    for (auto& [original_index, embedding] : batch_results) {
+                        int expected = 0;
+                        const int dimensions = static_cast<int>(embedding.size());
+                        if (!vector_size.compare_exchange_strong(expected, dimensions) && expected != dimensions) {
+                            KOLOSAL_LOG_ERROR("Failed to process embedding result for document %zu: Inconsistent embedding dimensions",
+                                                   original_index);
+                            errors[original_index] = "Failed to process embedding: Inconsistent embedding dimensions";
+                            continue;
                         }
+                        
+                        VectorPoint point;
+                        point.id = document_ids[original_index];
+                        point.vector = std::move(embedding);
+                        
+                        // Add document metadata
+                        point.payload["text"] = documents[original_index].text;
+                        for (const auto& [key, value] : documents[original_index].metadata) {
+                            point.payload[key] = value;
+                        }
+                        
+                        point.payload[kChunkHashField] = chunkHash(documents[original_index]);
+                        
+                        // Add timestamp
+                        auto now = std::chrono::system_clock::now();
+                        auto timestamp = std::chrono::duration_cast<std::chrono::seconds>(now.time_since_epoch()).count();
+                        point.payload["indexed_at"] = timestamp;
+                        
+                        errors[original_index].clear();
+                        points.emplace_back(original_index, std::move(point));
                     }
-                    
-                    // Handle any documents in this batch that failed to get embeddings
-                    std::set<size_t> successful_indices;
-                    for (const auto& [index, _] : batch_results) {
-                        successful_indices.insert(index);
+                } catch (const std::exception& ex) {
+                    KOLOSAL_LOG_ERROR("Failed to process embedding batch %zu-%zu: %s",
+                                           batch_start, batch_end - 1, ex.what());
+                    for (size_t p = batch_start; p < batch_end; ++p) {
+                        errors[order[p]] = "Batch processing failed: " + std::string(ex.what());
                     }
-                    
-                    for (size_t i = batch_start; i < batch_end; ++i) {
-                        if (successful_indices.find(i) == successful_indices.end()) {
-                            ServerLogger::logError("Failed to generate embedding for document %zu", i);
-                            response.addFailure("Failed to generate embedding");
+                    points.clear();
+                }
+                embedding -= batch_end - batch_start;
+                reportProgress(0, (batch_end - batch_start) - points.size());
+                
+                if (!points.empty()) {
+                    embedded.push(std::move(points));
+                }
+            }
+        };
+        
+        auto upsertWorker = [&]() {
+            std::vector<std::vector<std::pair<size_t, VectorPoint>>> pending;
+            // Coalesce whatever batches are waiting into one write
+            while (embedded.popAll(pending))
+            {
+                std::vector<size_t> indices;
+                std::vector<VectorPoint> vector_points;
+                for (auto& batch : pending) {
+                    for (auto& [index, point] : batch) {
+                        indices.push_back(index);
+                        vector_points.push_back(std::move(point));
+                    }
+                }
+                pending.clear();
+                
+                std::call_once(collection_once, [&]() {
+                    collection_ready = ensureCollection(collection_name, vector_size.load()).get();
+                });
+                std::string error;
+                if (!collection_ready) {
+                    error = "Failed to create or access collection '" + collection_name + "'";
+                } else {
+                    KOLOSAL_LOG_INFO("Upserting %zu points to collection '%s'", vector_points.size(), collection_name.c_str());
+                    try {
+                        auto upsert_result = vector_db_->upsertPoints(collection_name, vector_points).get();
+                        if (!upsert_result.success) {
+                            std::string db_type = (config_.vectorDatabase == DatabaseConfig::VectorDatabase::FAISS) ? "FAISS" : "Qdrant";
+                            error = "Failed to upsert points to " + db_type + ": " + upsert_result.error_message;
                         }
+                    } catch (const std::exception& ex) {
+                        error = ex.what();
+                    }
+                }
+                
+                if (!error.empty()) {
+                    KOLOSAL_LOG_ERROR("%s", error.c_str());
+                    for (size_t index : indices) {
+                        errors[index] = "Service error: " + error;
+                    }
+                    reportProgress(0, indices.size());
+                    continue;
+                }
+                for (size_t i = 0; i < indices.size(); ++i) {
+                    indexed[indices[i]] = 1;
+                    if (lexical_) {
+                        lexical_->add(vector_points[i].id, vector_points[i].payload.at("text").get<std::string>());
+                    }
+                    if (dedup_) {
+                        dedup_->add(vector_points[i].id, skip_duplicates ? signatures[indices[i]]
+                                                                         : dedup_->signature(vector_points[i].payload.at("text").get<std::string>()));
+                    }
+                }
+                reportProgress(indices.size(), 0);
+            }
+        };
+        
+        const size_t batch_count = (to_embed + batch_size - 1) / batch_size;
+        const size_t embed_workers = std::min(batch_count, static_cast<size_t>(std::max(1, ingestion.embedWorkers)));
+        const size_t upsert_workers = std::min(batch_count, static_cast<size_t>(std::max(1, ingestion.upsertWorkers)));
+        std::vector<std::thread> embed_threads;
+        std::vector<std::thread> upsert_threads;
+        for (size_t i = 0; i < embed_workers; ++i) {
+            embed_threads.emplace_back(embedWorker);
+        }
+        for (size_t i = 0; i < upsert_workers; ++i) {
+            upsert_threads.emplace_back(upsertWorker);
+        }
+        
+        for (size_t batch_start = 0; batch_start < to_embed; batch_start += batch_size) {
+            if (hooks.cancelled && hooks.cancelled()) {
+                // Batches already queued still finish; the rest are reported as cancelled
+                for (size_t p = batch_start; p < to_embed; ++p) {
+                    errors[order[p]] = "Cancelled";
+                }
+                break;
+            }
+            batches.push({batch_start, std::min(batch_start + batch_size, to_embed)});
+        }
+        batches.close();
+        for (auto& thread : embed_threads) {
+            thread.join();
+        }
+        embedded.close();
+        for (auto& thread : upsert_threads) {
+            thread.join();
+        }
+        
+        AddDocumentsResponse response;
+        response.collection_name = collection_name;
+        response.dedup = skip_duplicates;
+        std::vector<std::string> chunk_texts;
+        size_t request_duplicates_indexed = 0;
+        size_t request_duplicates_failed = 0;
+        for (size_t i = 0; i < count; ++i) {
+            if (skip_duplicates && !duplicate_of[i].empty()) {
+                response.addDuplicate(duplicate_of[i]);
+            } else if (skip_duplicates && duplicate_in_request[i] < count) {
+                // Stands or falls with the document it duplicates
+                const size_t original = duplicate_in_request[i];
+                if (indexed[original]) {
+                    response.addDuplicate(document_ids[original]);
+                    ++request_duplicates_indexed;
+                } else {
+                    response.addFailure(errors[original].empty() ? "Failed to index document" : errors[original]);
+                    ++request_duplicates_failed;
+                }
+            } else if (indexed[i]) {
+                response.addSuccess(document_ids[i]);
+                if (config_.chunkKv.onIngest) {
+                    chunk_texts.push_back(documents[i].text);
+                }
+            } else {
+                response.addFailure(errors[i].empty() ? "Failed to index document" : errors[i]);
+            }
+        }
+        reportProgress(request_duplicates_indexed, request_duplicates_failed);
+        queueChunkKv(std::move(chunk_texts));
+        return response;
+    }
+    
+    // Store documents that brought their own vectors: ingest() without the embedding stage,
+    // one upsert for the whole batch. Results are in batch order
+    AddDocumentsResponse importVectors(VectorImportBatch& batch, const std::string& collection_name)
+    {
+        const size_t count = batch.documents.size();
+        const size_t dimensions = batch.dimensions;
+        std::vector<std::string> errors(count);
+        std::vector<std::string> ids(count);
+        std::vector<size_t> rows;
+        std::vector<VectorPoint> points;
+        rows.reserve(count);
+        points.reserve(count);
+        const auto timestamp = std::chrono::duration_cast<std::chrono::seconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        for (size_t i = 0; i < count; ++i) {
+            const float* vector = batch.vectors.data() + i * dimensions;
+            if (!std::all_of(vector, vector + dimensions, [](float value) { return std::isfinite(value); })) {
+                errors[i] = "Vector has a NaN or infinite component";
+                continue;
+            }
+            Document& document = batch.documents[i];
+            VectorPoint point;
+            point.id = batch.ids[i].empty() ? generateDocumentId() : std::move(batch.ids[i]);
+            point.vector.assign(vector, vector + dimensions);
+            point.payload[kChunkHashField] = chunkHash(document);
+            for (auto& [key, value] : document.metadata) {
+                point.payload[key] = std::move(value);
+            }
+            point.payload["text"] = std::move(document.text);
+            point.payload["indexed_at"] = timestamp;
+            ids[i] = point.id;
+            rows.push_back(i);
+            points.push_back(std::move(point));
+        }
+        batch.vectors.clear();
+        batch.vectors.shrink_to_fit();
+        
+        std::string error;
+        if (!points.empty()) {
+            if (!ensureCollection(collection_name, static_cast<int>(dimensions)).get()) {
+                error = "Failed to create or access collection '" + collection_name + "'";
+            } else {
+                try {
+                    auto upsert_result = vector_db_->upsertPoints(collection_name, points).get();
+                    if (!upsert_result.success) {
+                        std::string db_type = (config_.vectorDatabase == DatabaseConfig::VectorDatabase::FAISS) ? "FAISS" : "Qdrant";
+                        error = "Failed to upsert points to " + db_type + ": " + upsert_result.error_message;
                     }
-                    
                 } catch (const std::exception& ex) {
-                    ServerLogger::logError("Failed to process embedding batch %zu-%zu: %s", 
-                                         batch_start, batch_end - 1, ex.what());
-                    
-                    // Mark all documents in this batch as failed
-                    for (size_t i = batch_start; i < batch_end; ++i) {
-                        response.addFailure("Batch processing failed: " + std::string(ex.what()));
+                    error = ex.what();
+                }
+            }
+        }
+        if (!error.empty()) {
+            KOLOSAL_LOG_ERROR("%s", error.c_str());
+            for (size_t row : rows) {
+                errors[row] = "Service error: " + error;
+            }
+        }
+        std::vector<std::string> chunk_texts;
+        for (size_t i = 0; error.empty() && i < points.size(); ++i) {
+            const std::string& text = points[i].payload.at("text").get_ref<const std::string&>();
+            if (lexical_) {
+                lexical_->add(points[i].id, text);
+            }
+            if (dedup_) {
+                dedup_->add(points[i].id, dedup_->signature(text));
+            }
+            if (config_.chunkKv.onIngest) {
+                chunk_texts.push_back(text);
+            }
+        }
+        
+        AddDocumentsResponse response;
+        response.collection_name = collection_name;
+        for (size_t i = 0; i < count; ++i) {
+            if (errors[i].empty()) {
+                response.addSuccess(ids[i]);
+            } else {
+                response.addFailure(errors[i]);
+            }
+        }
+        queueChunkKv(std::move(chunk_texts));
+        return response;
+    }
+    
+    // Points stored for one source, by chunk hash. Points written before chunk hashes were
+    // stored have none and come back under "", so an update replaces them
+    bool storedChunks(const std::string& collection_name, const std::string& source_field, const nlohmann::json& source,
+                      std::unordered_map<std::string, std::vector<std::string>>& chunks, std::string& error)
+    {
+        const nlohmann::json filter = {{"must", nlohmann::json::array({{{"key", source_field}, {"match", {{"value", source}}}}})}};
+        std::string offset;
+        do
+        {
+            VectorResult result = vector_db_->scrollPoints(collection_name, kLexicalLoadPageSize, offset, true, filter).get();
+            if (!result.success)
+            {
+                // A collection that does not exist yet holds nothing to compare against
+                if (result.status_code == 404)
+                {
+                    return true;
+                }
+                error = result.error_message;
+                return false;
+            }
+            for (const auto& point : resultPoints(result.response_data))
+            {
+                if (!point.contains("id"))
+                {
+                    continue;
+                }
+                std::string hash;
+                if (point.contains("payload") && point["payload"].contains(kChunkHashField) &&
+                    point["payload"][kChunkHashField].is_string())
+                {
+                    hash = point["payload"][kChunkHashField].get<std::string>();
+                }
+                chunks[hash].push_back(pointId(point));
+            }
+            offset = nextPageOffset(result.response_data);
+        } while (!offset.empty());
+        return true;
+    }
+    
+    // Re-ingest the chunks of the sources a request names: stored chunks whose hash matches one
+    // of the request's are kept, only the rest are embedded, and what is left of the stored
+    // chunks is deleted once every chunk of its source is in place
+    AddDocumentsResponse update(const std::vector<Document>& documents, const std::string& collection_name,
+                                const std::string& source_field, const IngestHooks& hooks)
+    {
+        const size_t count = documents.size();
+        std::vector<std::string> kept(count);           // Stored chunk an unchanged document maps to
+        std::vector<std::string> errors(count);
+        std::vector<size_t> changed;
+        
+        // Group the documents by source, in order of first appearance
+        std::vector<nlohmann::json> sources;
+        std::unordered_map<std::string, std::vector<size_t>> members;
+        for (size_t i = 0; i < count; ++i)
+        {
+            auto field = documents[i].metadata.find(source_field);
+            if (field == documents[i].metadata.end() || !(field->second.is_string() || field->second.is_number_integer()))
+            {
+                errors[i] = "Update mode needs a string or integer '" + source_field + "' in the document's metadata";
+                continue;
+            }
+            auto& group = members[field->second.dump()];
+            if (group.empty())
+            {
+                sources.push_back(field->second);
+            }
+            group.push_back(i);
+        }
+        
+        std::unordered_map<std::string, std::vector<std::string>> stale;    // By source
+        size_t unchanged = 0;
+        for (const auto& source : sources)
+        {
+            const auto& group = members[source.dump()];
+            std::unordered_map<std::string, std::vector<std::string>> stored;
+            std::string error;
+            if (!storedChunks(collection_name, source_field, source, stored, error))
+            {
+                KOLOSAL_LOG_ERROR("Failed to read the stored chunks of %s: %s", source.dump().c_str(), error.c_str());
+                for (size_t i : group)
+                {
+                    errors[i] = "Failed to read stored chunks: " + error;
+                }
+                continue;
+            }
+            for (size_t i : group)
+            {
+                auto match = stored.find(chunkHash(documents[i]));
+                if (match != stored.end() && !match->second.empty())
+                {
+                    kept[i] = std::move(match->second.back());
+                    match->second.pop_back();
+                    ++unchanged;
+                }
+                else
+                {
+                    changed.push_back(i);
+                }
+            }
+            auto& leftover = stale[source.dump()];
+            for (auto& [hash, ids] : stored)
+            {
+                leftover.insert(leftover.end(), std::make_move_iterator(ids.begin()), std::make_move_iterator(ids.end()));
+            }
+        }
+        if (hooks.progress)
+        {
+            hooks.progress(unchanged, std::count_if(errors.begin(), errors.end(), [](const std::string& e) { return !e.empty(); }));
+        }
+        
+        std::vector<Document> to_embed;
+        to_embed.reserve(changed.size());
+        for (size_t i : changed)
+        {
+            to_embed.push_back(documents[i]);
+        }
+        AddDocumentsResponse embedded;
+        if (!to_embed.empty())
+        {
+            // Chunks are stored under their own source so later updates find them
+            embedded = ingest(to_embed, collection_name, hooks, false);
+        }
+        
+        AddDocumentsResponse response;
+        response.collection_name = collection_name;
+        response.update = true;
+        std::vector<DocumentResult> results(count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            results[i].id = kept[i];
+            results[i].success = !kept[i].empty();
+            results[i].unchanged = results[i].success;
+            results[i].error = errors[i];
+        }
+        for (size_t n = 0; n < changed.size(); ++n)
+        {
+            results[changed[n]] = n < embedded.results.size() ? embedded.results[n] : DocumentResult{"", false, false, false, "Failed to index document"};
+        }
+        
+        // Sources whose every chunk is now stored give up their stale chunks
+        std::vector<std::string> removable;
+        for (const auto& source : sources)
+        {
+            const auto& group = members[source.dump()];
+            if (std::all_of(group.begin(), group.end(), [&](size_t i) { return results[i].success; }))
+            {
+                auto& ids = stale[source.dump()];
+                removable.insert(removable.end(), ids.begin(), ids.end());
+            }
+        }
+        if (!removable.empty())
+        {
+            VectorResult deleted = vector_db_->deletePoints(collection_name, removable).get();
+            if (deleted.success)
+            {
+                response.removed_count = static_cast<int>(removable.size());
+                for (const auto& id : removable)
+                {
+                    if (lexical_)
+                    {
+                        lexical_->remove(id);
+                    }
+                    if (dedup_)
+                    {
+                        dedup_->remove(id);
                     }
                 }
-                
-                // Add a small delay between batches to prevent overwhelming the system
-                if (batch_end < request.documents.size()) {
-                    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            }
+            else
+            {
+                KOLOSAL_LOG_WARNING("Failed to delete %zu stale chunks: %s", removable.size(), deleted.error_message.c_str());
+            }
+        }
+        
+        for (const auto& result : results)
+        {
+            if (result.unchanged)
+            {
+                response.addUnchanged(result.id);
+            }
+            else if (result.success)
+            {
+                response.addSuccess(result.id);
+            }
+            else
+            {
+                response.addFailure(result.error.empty() ? "Failed to index document" : result.error);
+            }
+        }
+        KOLOSAL_LOG_INFO("Updated %zu sources: %d chunks unchanged, %zu embedded, %d stale removed",
+                              sources.size(), response.unchanged_count, changed.size(), response.removed_count);
+        return response;
+    }
+    
+    // Hand chunks to the chat model's chunk cache on a background thread, so prompts quoting
+    // them splice their KV in instead of prefilling it; the engine skips chunks it holds
+    void queueChunkKv(std::vector<std::string> texts)
+    {
+        if (config_.chunkKv.model.empty() || texts.empty())
+        {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(chunk_kv_mutex_);
+            if (stopping_)
+            {
+                return;
+            }
+            for (auto& text : texts)
+            {
+                if (chunk_kv_queue_.size() >= kMaxPendingChunkKv)
+                {
+                    break;
+                }
+                chunk_kv_queue_.push_back(std::move(text));
+            }
+            if (!chunk_kv_worker_.joinable())
+            {
+                chunk_kv_worker_ = std::thread([this]() { runChunkKv(); });
+            }
+        }
+        chunk_kv_cv_.notify_one();
+    }
+    
+    // Count the documents a /retrieve returned; from chunkKv.minRetrievals on they are queued
+    // each time, which costs the engine only a lookup once a chunk is cached
+    void countRetrievals(const std::vector<RetrievedDocument>& documents)
+    {
+        const int threshold = config_.chunkKv.minRetrievals;
+        if (config_.chunkKv.model.empty() || threshold <= 0)
+        {
+            return;
+        }
+        
+        std::vector<std::string> due;
+        {
+            std::lock_guard<std::mutex> lock(chunk_kv_mutex_);
+            if (chunk_retrievals_.size() >= kMaxTrackedRetrievals)
+            {
+                chunk_retrievals_.clear();
+            }
+            for (const auto& doc : documents)
+            {
+                int& retrievals = chunk_retrievals_[doc.id];
+                retrievals = std::min(retrievals + 1, threshold);
+                if (retrievals == threshold)
+                {
+                    due.push_back(doc.text);
+                }
+            }
+        }
+        queueChunkKv(std::move(due));
+    }
+    
+    void runChunkKv()
+    {
+        while (true)
+        {
+            std::string text;
+            {
+                std::unique_lock<std::mutex> lock(chunk_kv_mutex_);
+                chunk_kv_cv_.wait(lock, [this]() { return stopping_ || !chunk_kv_queue_.empty(); });
+                if (stopping_)
+                {
+                    return;
+                }
+                text = std::move(chunk_kv_queue_.front());
+                chunk_kv_queue_.pop_front();
+            }
+            
+            try
+            {
+                auto engine = ServerAPI::instance().getNodeManager().getEngine(config_.chunkKv.model);
+                if (!engine)
+                {
+                    KOLOSAL_LOG_WARNING("Chunk KV model '%s' not found or could not be loaded", config_.chunkKv.model.c_str());
+                    continue;
+                }
+                if (!engine->precomputeChunk(text))
+                {
+                    KOLOSAL_LOG_DEBUG("Chunk of %zu bytes not cached by '%s' (cache off, or chunk too short or long)",
+                                           text.size(), config_.chunkKv.model.c_str());
+                }
+            }
+            catch (const std::exception& ex)
+            {
+                KOLOSAL_LOG_WARNING("Failed to precompute chunk KV: %s", ex.what());
+            }
+        }
+    }
+    
+    // Hold a background batch back while the embedding model is serving anything besides this
+    // job, for at most ingestion.backgroundYieldMs, so bulk loads soak up idle time instead of
+    // queueing ahead of interactive requests
+    void yieldToForeground(const IngestionJob& job, size_t own_in_flight)
+    {
+        const int limit_ms = config_.ingestion.backgroundYieldMs;
+        if (limit_ms <= 0)
+        {
+            return;
+        }
+        
+        std::shared_ptr<IInferenceEngine> engine;
+        try
+        {
+            engine = ServerAPI::instance().getNodeManager().getEngine(chooseEmbeddingModelId(""));
+        }
+        catch (const std::exception&)
+        {
+            return;
+        }
+        if (!engine)
+        {
+            return;
+        }
+        
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(limit_ms);
+        while (!job.cancelled && !stopping_ && std::chrono::steady_clock::now() < deadline &&
+               static_cast<size_t>(std::max(0, engine->getLoad().active_jobs)) > own_in_flight)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(kYieldPollMs));
+        }
+    }
+    
+    void runIngestionJob(IngestionJob& job)
+    {
+        IngestHooks hooks;
+        hooks.cancelled = [this, &job]() { return job.cancelled.load() || stopping_.load(); };
+        hooks.before_embed = [this, &job](size_t own_in_flight) { yieldToForeground(job, own_in_flight); };
+        hooks.progress = [this, &job](size_t indexed_count, size_t failed_count) {
+            std::lock_guard<std::mutex> lock(jobs_mutex_);
+            job.status.succeeded += indexed_count;
+            job.status.failed += failed_count;
+            job.status.processed = job.status.succeeded + job.status.failed;
+        };
+        
+        AddDocumentsResponse response;
+        std::string error;
+        try
+        {
+            if (!initialized_ || !vector_db_)
+            {
+                throw std::runtime_error("DocumentService not initialized");
+            }
+            response = job.update ? update(job.documents, "documents", job.source_field, hooks)
+                                  : ingest(job.documents, "documents", hooks);
+        }
+        catch (const std::exception& ex)
+        {
+            error = ex.what();
+            KOLOSAL_LOG_ERROR("Ingestion job %s failed: %s", job.status.job_id.c_str(), ex.what());
+        }
+        
+        std::lock_guard<std::mutex> lock(jobs_mutex_);
+        auto& status = job.status;
+        if (!error.empty())
+        {
+            status.status = "failed";
+            status.error = error;
+        }
+        else
+        {
+            status.status = job.cancelled ? "cancelled" : "completed";
+            status.succeeded = static_cast<size_t>(response.successful_count);
+            status.failed = static_cast<size_t>(response.failed_count);
+            status.processed = status.succeeded + status.failed;
+            status.response = std::move(response);
+        }
+        status.finished_at = std::chrono::system_clock::now();
+        std::vector<Document>().swap(job.documents);
+        KOLOSAL_LOG_INFO("Ingestion job %s %s: %zu indexed, %zu failed",
+                              status.job_id.c_str(), status.status.c_str(), status.succeeded, status.failed);
+    }
+    
+    // Runs queued jobs one at a time, so a bulk load never competes with itself for the embedder
+    void runIngestionJobs()
+    {
+        while (true)
+        {
+            std::shared_ptr<IngestionJob> job;
+            {
+                std::unique_lock<std::mutex> lock(jobs_mutex_);
+                jobs_cv_.wait(lock, [this]() { return stopping_ || !job_queue_.empty(); });
+                if (stopping_)
+                {
+                    if (!job_queue_.empty())
+                    {
+                        KOLOSAL_LOG_WARNING("Dropping %zu queued ingestion jobs at shutdown", job_queue_.size());
+                    }
+                    return;
+                }
+                job = std::move(job_queue_.front());
+                job_queue_.pop_front();
+                job->status.status = "running";
+                job->status.started_at = std::chrono::system_clock::now();
+            }
+            runIngestionJob(*job);
+        }
+    }
+    
+    // Forget the oldest finished jobs once more than kMaxIngestionJobs are kept
+    void pruneIngestionJobsLocked()
+    {
+        for (auto it = job_order_.begin(); it != job_order_.end() && job_order_.size() > kMaxIngestionJobs;)
+        {
+            auto job = jobs_.find(*it);
+            if (job != jobs_.end() && !job->second->status.finished())
+            {
+                ++it;
+                continue;
+            }
+            if (job != jobs_.end())
+            {
+                jobs_.erase(job);
+            }
+            it = job_order_.erase(it);
+        }
+    }
+
+    ~Impl()
+    {
+        MemoryReport::instance().removeSource(memory_source_);
+        {
+            std::lock_guard<std::mutex> lock(jobs_mutex_);
+            stopping_ = true;
+        }
+        jobs_cv_.notify_all();
+        if (job_runner_.joinable())
+        {
+            job_runner_.join();
+        }
+        {
+            std::lock_guard<std::mutex> lock(chunk_kv_mutex_);
+            chunk_kv_queue_.clear();
+        }
+        chunk_kv_cv_.notify_all();
+        if (chunk_kv_worker_.joinable())
+        {
+            chunk_kv_worker_.join();
+        }
+        {
+            std::lock_guard<std::mutex> lock(replication_mutex_);
+        }
+        replication_cv_.notify_all();
+        if (replicator_.joinable())
+        {
+            replicator_.join();
+        }
+        if (text_index_loader_.joinable())
+        {
+            text_index_loader_.join();
+        }
+    }
+    
+    bool following() const
+    {
+        return !config_.replication.source.empty();
+    }
+    
+    // A follower's collection holds the source's internal ids; a local write could reuse one
+    void ensureWritable() const
+    {
+        if (following())
+        {
+            throw std::runtime_error("This server replicates its documents from " + config_.replication.source +
+                                     "; send writes there");
+        }
+    }
+    
+    // Replaces the collection with a snapshot and rebuilds the text indexes from it. The
+    // documents it had before are dropped from them first, since the snapshot may lack some.
+    ReplicationResult restoreSnapshot(const std::string& collection_name, std::istream& in)
+    {
+        std::vector<std::string> previous;
+        if (lexical_ || dedup_)
+        {
+            std::string cursor;
+            do
+            {
+                VectorResult page = vector_db_->scrollPoints(collection_name, kLexicalLoadPageSize, cursor, false).get();
+                if (!page.success)
+                {
+                    break;
+                }
+                for (const auto& point : resultPoints(page.response_data))
+                {
+                    if (point.contains("id"))
+                    {
+                        previous.push_back(pointId(point));
+                    }
+                }
+                cursor = nextPageOffset(page.response_data);
+            } while (!cursor.empty());
+        }
+        
+        ReplicationResult result = replicationResult(vector_db_->importSnapshot(collection_name, in));
+        if (!result.success)
+        {
+            return result;
+        }
+        for (const auto& id : previous)
+        {
+            if (lexical_)
+            {
+                lexical_->remove(id);
+            }
+            if (dedup_)
+            {
+                dedup_->remove(id);
+            }
+        }
+        if (lexical_ || dedup_)
+        {
+            loadTextIndexes(collection_name);
+        }
+        return result;
+    }
+    
+    // Applies records of the source's change stream, keeping the text indexes in step
+    ReplicationResult applyChanges(const std::string& collection_name, std::string records)
+    {
+        VectorResult applied = vector_db_->applyChanges(collection_name, std::move(records)).get();
+        if (applied.response_data.contains("changes"))
+        {
+            for (const auto& change : applied.response_data["changes"])
+            {
+                const std::string id = change.value("id", std::string());
+                if (change.value("op", std::string()) == "delete")
+                {
+                    if (lexical_)
+                    {
+                        lexical_->remove(id);
+                    }
+                    if (dedup_)
+                    {
+                        dedup_->remove(id);
+                    }
+                    continue;
+                }
+                auto text = change["payload"].find("text");
+                if (text == change["payload"].end() || !text->is_string())
+                {
+                    continue;
+                }
+                if (lexical_)
+                {
+                    lexical_->add(id, text->get_ref<const std::string&>());
+                }
+                if (dedup_)
+                {
+                    dedup_->add(id, dedup_->signature(text->get_ref<const std::string&>()));
+                }
+            }
+            applied.response_data.erase("changes");
+        }
+        return replicationResult(std::move(applied));
+    }
+    
+    void updateReplication(const nlohmann::json& fields)
+    {
+        std::lock_guard<std::mutex> lock(replication_mutex_);
+        for (const auto& [key, value] : fields.items())
+        {
+            replication_status_[key] = value;
+        }
+        replication_status_["updated_at"] = std::chrono::duration_cast<std::chrono::seconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+    
+    // GET from the source with the configured API key. False on a transport error or a status
+    // other than 200, with the status (0 without a response) and the reason in error.
+    bool fetchFromSource(const std::string& url, curl_write_callback write, void* target, long timeout_seconds,
+                         std::map<std::string, std::string>* headers, long& status, std::string& error)
+    {
+        status = 0;
+        CURL* curl = curl_easy_init();
+        if (!curl)
+        {
+            error = "cannot create a connection";
+            return false;
+        }
+        struct curl_slist* request_headers = nullptr;
+        if (!config_.replication.apiKey.empty())
+        {
+            request_headers = curl_slist_append(request_headers, ("X-API-Key: " + config_.replication.apiKey).c_str());
+        }
+        curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, request_headers);
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, target);
+        if (headers)
+        {
+            curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, collectHeader);
+            curl_easy_setopt(curl, CURLOPT_HEADERDATA, headers);
+        }
+        curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT_MS, kReplicationConnectTimeoutMs);
+        curl_easy_setopt(curl, CURLOPT_TIMEOUT, timeout_seconds);
+        // A snapshot may take long, but never stalls for a minute
+        curl_easy_setopt(curl, CURLOPT_LOW_SPEED_LIMIT, 1L);
+        curl_easy_setopt(curl, CURLOPT_LOW_SPEED_TIME, 60L);
+        curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
+        curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, abortOnStop);
+        curl_easy_setopt(curl, CURLOPT_XFERINFODATA, &stopping_);
+        curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+        
+        const CURLcode result = curl_easy_perform(curl);
+        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status);
+        curl_slist_free_all(request_headers);
+        curl_easy_cleanup(curl);
+        
+        if (result != CURLE_OK)
+        {
+            error = curl_easy_strerror(result);
+        }
+        else if (status != 200)
+        {
+            error = "HTTP " + std::to_string(status) + " from " + url;
+        }
+        return error.empty();
+    }
+    
+    // Downloads the source's snapshot to a spool file beside the index and restores from it
+    bool restoreFromSource(const std::string& source, const std::string& collection_name, std::string& epoch,
+                           uint64_t& position, std::string& error)
+    {
+        const std::filesystem::path spool = std::filesystem::path(config_.faiss.indexPath) / ".replica-snapshot";
+        std::error_code ec;
+        std::filesystem::create_directories(spool.parent_path(), ec);
+        long status = 0;
+        {
+            std::ofstream out(spool, std::ios::binary | std::ios::trunc);
+            if (!out)
+            {
+                error = "cannot write " + spool.string();
+                return false;
+            }
+            if (!fetchFromSource(source + "/replication/snapshot", writeToStream, &out, 0, nullptr, status, error) ||
+                !out.flush())
+            {
+                if (error.empty())
+                {
+                    error = "cannot write " + spool.string();
+                }
+                out.close();
+                std::filesystem::remove(spool, ec);
+                return false;
+            }
+        }
+        
+        ReplicationResult restored;
+        {
+            std::ifstream in(spool, std::ios::binary);
+            restored = restoreSnapshot(collection_name, in);
+        }
+        std::filesystem::remove(spool, ec);
+        if (!restored.success)
+        {
+            error = restored.error;
+            return false;
+        }
+        epoch = restored.info.value("epoch", std::string());
+        position = restored.info.value("position", static_cast<uint64_t>(0));
+        return true;
+    }
+    
+    // Keeps the collection a copy of the source's: restores its snapshot, then applies its
+    // change stream, polling once caught up. A position the source can no longer serve
+    // (it restarted, or this follower fell a checkpoint behind) starts over from a snapshot.
+    void runReplication()
+    {
+        const std::string collection_name = "documents";
+        std::string source = config_.replication.source;
+        while (!source.empty() && source.back() == '/')
+        {
+            source.pop_back();
+        }
+        const auto poll = std::chrono::milliseconds(std::max(config_.replication.pollMs, 1));
+        std::string epoch;
+        uint64_t position = 0;
+        bool restored = false;
+        uint64_t applied_records = 0;
+        uint64_t snapshots = 0;
+        updateReplication({{"source", source}, {"state", "starting"}});
+        KOLOSAL_LOG_INFO("Replicating the '%s' collection from %s", collection_name.c_str(), source.c_str());
+        
+        while (!stopping_)
+        {
+            std::string error;
+            bool behind = false;
+            if (!restored)
+            {
+                updateReplication({{"state", "snapshot"}});
+                restored = restoreFromSource(source, collection_name, epoch, position, error);
+                if (restored)
+                {
+                    ++snapshots;
+                    behind = true;
+                    KOLOSAL_LOG_INFO("Restored '%s' from the snapshot of %s at position %llu", collection_name.c_str(),
+                                          source.c_str(), static_cast<unsigned long long>(position));
+                }
+            }
+            else
+            {
+                std::string records;
+                std::map<std::string, std::string> headers;
+                long status = 0;
+                const std::string url = source + "/replication/changes?epoch=" + epoch + "&position=" + std::to_string(position);
+                if (fetchFromSource(url, appendToString, &records, kChangesTimeoutSeconds, &headers, status, error))
+                {
+                    const uint64_t next = std::stoull(headers["x-replication-position"]);
+                    const uint64_t end = std::stoull(headers["x-replication-end"]);
+                    if (!records.empty())
+                    {
+                        // A batch that failed part way is applied again from the same position
+                        ReplicationResult applied = applyChanges(collection_name, std::move(records));
+                        if (applied.success)
+                        {
+                            position = next;
+                            applied_records += applied.info.value("records", static_cast<uint64_t>(0));
+                        }
+                        else
+                        {
+                            error = applied.error;
+                        }
+                    }
+                    behind = error.empty() && position < end;
+                    updateReplication({{"source_end", end}, {"lag_bytes", end > position ? end - position : 0}});
+                }
+                else if (status == 410)
+                {
+                    KOLOSAL_LOG_WARNING("%s can no longer serve the changes after position %llu; taking a new snapshot",
+                                             source.c_str(), static_cast<unsigned long long>(position));
+                    restored = false;
+                    behind = true;
+                    error.clear();
                 }
             }
             
-            if (points.empty())
+            updateReplication({{"state", !error.empty() ? "error" : restored ? "following" : "snapshot"},
+                               {"epoch", epoch}, {"position", position}, {"applied_records", applied_records},
+                               {"snapshots", snapshots}, {"last_error", error}});
+            if (!error.empty())
             {
-                throw std::runtime_error("No documents could be processed");
+                KOLOSAL_LOG_WARNING("Replication from %s: %s", source.c_str(), error.c_str());
             }
+            if (behind)
+            {
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(replication_mutex_);
+            replication_cv_.wait_for(lock, error.empty() ? std::chrono::duration_cast<std::chrono::milliseconds>(poll)
+                                                         : std::chrono::duration_cast<std::chrono::milliseconds>(kReplicationRetryAfter),
+                                     [this]() { return stopping_.load(); });
+        }
+    }
+    
+    // Refill the lexical and near-duplicate indexes from the text payloads in the vector store.
+    // Scroll pages are positional, so a removal during a pass can shift documents past the
+    // loader; another pass picks those up, skipping everything already indexed.
+    void loadTextIndexes(const std::string& collection_name)
+    {
+        auto endLoad = [this]() {
+            size_t removed = 0;
+            if (lexical_)
+            {
+                removed += lexical_->endLoad();
+            }
+            if (dedup_)
+            {
+                removed += dedup_->endLoad();
+            }
+            return removed;
+        };
+        
+        for (int pass = 0; pass < kLexicalLoadPasses && !stopping_; ++pass)
+        {
+            if (lexical_)
+            {
+                lexical_->beginLoad();
+            }
+            if (dedup_)
+            {
+                dedup_->beginLoad();
+            }
+            size_t scanned = 0;
+            std::string offset;
+            try
+            {
+                do
+                {
+                    auto result = vector_db_->scrollPoints(collection_name, kLexicalLoadPageSize, offset).get();
+                    if (!result.success)
+                    {
+                        KOLOSAL_LOG_WARNING("Text index load of '%s' stopped: %s; keyword search and deduplication cover only documents added from now on",
+                                                 collection_name.c_str(), result.error_message.c_str());
+                        endLoad();
+                        return;
+                    }
+                    
+                    for (const auto& point : resultPoints(result.response_data))
+                    {
+                        if (!point.contains("id") || !point.contains("payload") ||
+                            !point["payload"].contains("text") || !point["payload"]["text"].is_string())
+                        {
+                            continue;
+                        }
+                        const std::string id = pointId(point);
+                        const auto& text = point["payload"]["text"].get_ref<const std::string&>();
+                        if (lexical_)
+                        {
+                            lexical_->load(id, text);
+                        }
+                        if (dedup_)
+                        {
+                            dedup_->load(id, text);
+                        }
+                        ++scanned;
+                    }
+                    
+                    offset = nextPageOffset(result.response_data);
+                } while (!offset.empty() && !stopping_);
+            }
+            catch (const std::exception& ex)
+            {
+                KOLOSAL_LOG_WARNING("Text index load of '%s' failed: %s", collection_name.c_str(), ex.what());
+                endLoad();
+                return;
+            }
+            
+            const size_t removed = endLoad();
+            KOLOSAL_LOG_INFO("Text indexes loaded %zu documents from '%s' (%zu lexical, %zu deduplication)",
+                                  scanned, collection_name.c_str(), lexical_ ? lexical_->size() : 0,
+                                  dedup_ ? dedup_->size() : 0);
+            if (removed == 0)
+            {
+                break;
+            }
+        }
+    }
+};
+
+// DocumentService implementations
+DocumentService::DocumentService(const DatabaseConfig& database_config)
+    : pImpl(std::make_unique<Impl>(database_config))
+{
+}
+
+DocumentService::~DocumentService() = default;
+
+DocumentService::DocumentService(DocumentService&&) noexcept = default;
+DocumentService& DocumentService::operator=(DocumentService&&) noexcept = default;
+
+std::future<bool> DocumentService::initialize()
+{
+    return TaskExecutor::instance().submit([this]() -> bool {
+        std::lock_guard<std::mutex> lock(pImpl->mutex_);
+        
+        if (pImpl->initialized_)
+        {
+            return true;
+        }
+        
+        if (!pImpl->vector_db_)
+        {
+            KOLOSAL_LOG_ERROR("DocumentService: Vector database not initialized");
+            return false;
+        }
+        
+        try
+        {
+            // Test connection
+            std::string db_type = (pImpl->config_.vectorDatabase == DatabaseConfig::VectorDatabase::FAISS) ? "FAISS" : "Qdrant";
+            KOLOSAL_LOG_INFO("DocumentService: Testing %s connection...", db_type.c_str());
+            auto connection_result = pImpl->vector_db_->testConnection().get();
             
-            // Ensure collection exists
-            bool collection_ready = pImpl->ensureCollection(collection_name, vector_size).get();
-            if (!collection_ready)
+            if (!connection_result.success)
+            {
+                KOLOSAL_LOG_ERROR("DocumentService: Failed to connect to %s: %s", 
+                                       db_type.c_str(), connection_result.error_message.c_str());
+                return false;
+            }
+            
+            if (pImpl->config_.vectorDatabase == DatabaseConfig::VectorDatabase::FAISS)
+            {
+                KOLOSAL_LOG_INFO("DocumentService: Successfully initialized FAISS at %s", 
+                                      pImpl->config_.faiss.indexPath.c_str());
+                // Auto-create default collection if it does not exist yet
+                const std::string default_collection = pImpl->config_.qdrant.collectionName.empty() ? "documents" : pImpl->config_.qdrant.collectionName;
+                try {
+                    auto exists = pImpl->vector_db_->collectionExists(default_collection).get();
+                    if (!exists.success) {
+                        KOLOSAL_LOG_INFO("FAISS default collection '%s' not found. Creating with dimension %d", 
+                                              default_collection.c_str(), pImpl->config_.faiss.dimensions);
+                        auto created = pImpl->vector_db_->createCollection(default_collection, pImpl->config_.faiss.dimensions, 
+                            pImpl->config_.faiss.metricType == "IP" ? "IP" : "L2").get();
+                        if (!created.success) {
+                            KOLOSAL_LOG_ERROR("Failed to create FAISS collection '%s': %s", default_collection.c_str(), created.error_message.c_str());
+                            return false;
+                        }
+                    }
+                } catch (const std::exception& ex) {
+                    KOLOSAL_LOG_ERROR("Error ensuring FAISS default collection: %s", ex.what());
+                    return false;
+                }
+            }
+            else
             {
-                throw std::runtime_error("Failed to create or access collection '" + collection_name + "'");
+                KOLOSAL_LOG_INFO("DocumentService: Successfully connected to Qdrant at %s:%d",
+                                      pImpl->config_.qdrant.host.c_str(), pImpl->config_.qdrant.port);
             }
             
-            // Upsert points to vector database
-            ServerLogger::logInfo("Upserting %zu points to collection '%s'", points.size(), collection_name.c_str());
+            pImpl->initialized_ = true;
+            
+            if ((pImpl->lexical_ || pImpl->dedup_) && !pImpl->text_index_loader_.joinable())
+            {
+                Impl* impl = pImpl.get();
+                pImpl->text_index_loader_ = std::thread([impl]() { impl->loadTextIndexes("documents"); });
+            }
+            if (pImpl->following() && !pImpl->replicator_.joinable())
+            {
+                curl_global_init(CURL_GLOBAL_DEFAULT);
+                Impl* impl = pImpl.get();
+                pImpl->replicator_ = std::thread([impl]() { impl->runReplication(); });
+            }
+            return true;
+        }
+        catch (const std::exception& ex)
+        {
+            KOLOSAL_LOG_ERROR("DocumentService: Initialization failed: %s", ex.what());
+            return false;
+        }
+    });
+}
+
+std::future<AddDocumentsResponse> DocumentService::addDocuments(AddDocumentsRequest request)
+{
+    return TaskExecutor::instance().submit([this, request = std::move(request)]() -> AddDocumentsResponse {
+        AddDocumentsResponse response;
+        
+        try
+        {
+            if (!pImpl->initialized_)
+            {
+                throw std::runtime_error("DocumentService not initialized");
+            }
             
-            // Convert QdrantPoint to VectorPoint
-            std::vector<VectorPoint> vector_points;
-            for (const auto& qpoint : points)
+            if (!pImpl->vector_db_)
             {
-                VectorPoint vpoint;
-                vpoint.id = qpoint.id;
-                vpoint.vector = qpoint.vector;
-                vpoint.payload = qpoint.payload;
-                vector_points.push_back(vpoint);
+                throw std::runtime_error("Vector database not initialized");
             }
+            pImpl->ensureWritable();
+            
+            std::string collection_name = "documents"; // Always use "documents" collection
+            
+            response.collection_name = collection_name;
             
-            auto upsert_result = pImpl->vector_db_->upsertPoints(collection_name, vector_points).get();
+            KOLOSAL_LOG_INFO("Processing %zu documents for collection '%s'", 
+                                  request.documents.size(), collection_name.c_str());
             
-            if (!upsert_result.success)
-            {
-                std::string db_type = (pImpl->config_.vectorDatabase == DatabaseConfig::VectorDatabase::FAISS) ? "FAISS" : "Qdrant";
-                throw std::runtime_error("Failed to upsert points to " + db_type + ": " + upsert_result.error_message);
-            }
+            response = request.mode == "update" ? pImpl->update(request.documents, collection_name, request.source_field, {})
+                                                : pImpl->ingest(request.documents, collection_name, {});
             
-            ServerLogger::logInfo("Successfully indexed %d documents to collection '%s'", 
+            KOLOSAL_LOG_INFO("Successfully indexed %d documents to collection '%s'", 
                                   response.successful_count, collection_name.c_str());
             
             return response;
         }
         catch (const std::exception& ex)
         {
-            ServerLogger::logError("Error in addDocuments: %s", ex.what());
+            KOLOSAL_LOG_ERROR("Error in addDocuments: %s", ex.what());
             
             // If we had some successes but failed at the end, still return partial results
             if (response.successful_count == 0)
@@ -670,9 +2110,132 @@ std::future<AddDocumentsResponse> DocumentService::addDocuments(const AddDocumen
     });
 }
 
+std::future<AddDocumentsResponse> DocumentService::importVectors(VectorImportBatch batch)
+{
+    return TaskExecutor::instance().submit([this, batch = std::move(batch)]() mutable -> AddDocumentsResponse {
+        const std::string collection_name = "documents"; // Always use "documents" collection
+        try
+        {
+            if (!pImpl->initialized_)
+            {
+                throw std::runtime_error("DocumentService not initialized");
+            }
+            if (!pImpl->vector_db_)
+            {
+                throw std::runtime_error("Vector database not initialized");
+            }
+            pImpl->ensureWritable();
+            return pImpl->importVectors(batch, collection_name);
+        }
+        catch (const std::exception& ex)
+        {
+            KOLOSAL_LOG_ERROR("Error in importVectors: %s", ex.what());
+            AddDocumentsResponse response;
+            response.collection_name = collection_name;
+            for (size_t i = 0; i < batch.documents.size(); ++i)
+            {
+                response.addFailure("Service error: " + std::string(ex.what()));
+            }
+            return response;
+        }
+    });
+}
+
+std::string DocumentService::submitAddDocumentsJob(AddDocumentsRequest request)
+{
+    pImpl->ensureWritable();
+    auto job = std::make_shared<Impl::IngestionJob>();
+    job->status.job_id = pImpl->generateDocumentId();
+    job->status.total = request.documents.size();
+    job->status.created_at = std::chrono::system_clock::now();
+    job->documents = std::move(request.documents);
+    job->update = request.mode == "update";
+    job->source_field = request.source_field;
+    
+    std::lock_guard<std::mutex> lock(pImpl->jobs_mutex_);
+    if (pImpl->stopping_)
+    {
+        throw std::runtime_error("DocumentService is shutting down");
+    }
+    pImpl->jobs_[job->status.job_id] = job;
+    pImpl->job_order_.push_back(job->status.job_id);
+    pImpl->job_queue_.push_back(job);
+    pImpl->pruneIngestionJobsLocked();
+    if (!pImpl->job_runner_.joinable())
+    {
+        Impl* impl = pImpl.get();
+        pImpl->job_runner_ = std::thread([impl]() { impl->runIngestionJobs(); });
+    }
+    pImpl->jobs_cv_.notify_one();
+    
+    KOLOSAL_LOG_INFO("Queued ingestion job %s with %zu documents", job->status.job_id.c_str(), job->status.total);
+    return job->status.job_id;
+}
+
+std::optional<IngestionJobStatus> DocumentService::getIngestionJob(const std::string& job_id) const
+{
+    std::lock_guard<std::mutex> lock(pImpl->jobs_mutex_);
+    auto it = pImpl->jobs_.find(job_id);
+    if (it == pImpl->jobs_.end())
+    {
+        return std::nullopt;
+    }
+    return it->second->status;
+}
+
+std::vector<IngestionJobStatus> DocumentService::listIngestionJobs() const
+{
+    std::lock_guard<std::mutex> lock(pImpl->jobs_mutex_);
+    std::vector<IngestionJobStatus> jobs;
+    for (const auto& job_id : pImpl->job_order_)
+    {
+        auto it = pImpl->jobs_.find(job_id);
+        if (it == pImpl->jobs_.end())
+        {
+            continue;
+        }
+        IngestionJobStatus status = it->second->status;
+        status.response = AddDocumentsResponse();
+        jobs.push_back(std::move(status));
+    }
+    return jobs;
+}
+
+bool DocumentService::cancelIngestionJob(const std::string& job_id)
+{
+    std::lock_guard<std::mutex> lock(pImpl->jobs_mutex_);
+    auto it = pImpl->jobs_.find(job_id);
+    if (it == pImpl->jobs_.end() || it->second->status.finished())
+    {
+        return false;
+    }
+    
+    auto& job = *it->second;
+    job.cancelled = true;
+    auto queued = std::find(pImpl->job_queue_.begin(), pImpl->job_queue_.end(), it->second);
+    if (queued != pImpl->job_queue_.end())
+    {
+        // Never started, so it finishes here; a running job stops after its queued batches
+        pImpl->job_queue_.erase(queued);
+        job.status.status = "cancelled";
+        job.status.response.collection_name = "documents";
+        for (size_t i = 0; i < job.status.total; ++i)
+        {
+            job.status.response.addFailure("Cancelled");
+        }
+        job.status.failed = job.status.total;
+        job.status.processed = job.status.total;
+        job.status.finished_at = std::chrono::system_clock::now();
+        std::vector<Document>().swap(job.documents);
+    }
+    
+    KOLOSAL_LOG_INFO("Cancelled ingestion job %s", job_id.c_str());
+    return true;
+}
+
 std::future<bool> DocumentService::testConnection()
 {
-    return std::async(std::launch::async, [this]() -> bool {
+    return TaskExecutor::instance().submit([this]() -> bool {
         if (!pImpl->vector_db_)
         {
             return false;
@@ -685,7 +2248,7 @@ std::future<bool> DocumentService::testConnection()
         }
         catch (const std::exception& ex)
         {
-            ServerLogger::logError("DocumentService connection test failed: %s", ex.what());
+            KOLOSAL_LOG_ERROR("DocumentService connection test failed: %s", ex.what());
             return false;
         }
     });
@@ -696,9 +2259,46 @@ std::future<std::vector<float>> DocumentService::getEmbedding(const std::string&
     return pImpl->generateEmbedding(text, model_id);
 }
 
+DatabaseConfig DocumentService::serverDatabaseConfig()
+{
+    // Get database config from the server configuration
+    DatabaseConfig db_config = ServerConfig::getInstance().database;
+    
+    // Ensure Qdrant is configured with proper defaults if not set
+    if (db_config.qdrant.host.empty()) {
+        db_config.qdrant.host = "localhost";
+    }
+    if (db_config.qdrant.port == 0) {
+        db_config.qdrant.port = 6333;
+    }
+    if (db_config.qdrant.collectionName.empty()) {
+        db_config.qdrant.collectionName = "documents";
+    }
+    if (db_config.qdrant.defaultEmbeddingModel.empty()) {
+        db_config.qdrant.defaultEmbeddingModel = "text-embedding-3-small";
+    }
+    if (db_config.qdrant.timeout == 0) {
+        db_config.qdrant.timeout = 30;
+    }
+    if (db_config.qdrant.maxConnections == 0) {
+        db_config.qdrant.maxConnections = 10;
+    }
+    if (db_config.qdrant.connectionTimeout == 0) {
+        db_config.qdrant.connectionTimeout = 5;
+    }
+    if (db_config.qdrant.embeddingBatchSize == 0) {
+        db_config.qdrant.embeddingBatchSize = 5;
+    }
+    return db_config;
+}
+
 std::future<RetrieveResponse> DocumentService::retrieveDocuments(const RetrieveRequest& request)
 {
-    return std::async(std::launch::async, [this, request]() -> RetrieveResponse {
+    // The deadline runs from here, so time spent queued for the executor counts against it
+    const auto deadline = request.deadline_ms > 0 ?
+        std::chrono::steady_clock::now() + std::chrono::milliseconds(request.deadline_ms) :
+        std::chrono::steady_clock::time_point{};
+    return TaskExecutor::instance().submit([this, request, deadline]() -> RetrieveResponse {
         RetrieveResponse response;
         
         try
@@ -715,42 +2315,101 @@ std::future<RetrieveResponse> DocumentService::retrieveDocuments(const RetrieveR
             response.collection_name = collection_name;
             response.score_threshold = request.score_threshold;
             
-            ServerLogger::logInfo("Retrieving documents for query: '%s' (k=%d, collection='%s')", 
-                                  request.query.c_str(), request.k, collection_name.c_str());
-            
-            // Generate embedding for the query
-            auto query_embedding_future = pImpl->generateEmbedding(request.query, "");
-            std::vector<float> query_embedding = query_embedding_future.get();
+            KOLOSAL_LOG_INFO("Retrieving documents for query: '%s' (k=%d, collection='%s', mode=%s)", 
+                                  request.query.c_str(), request.k, collection_name.c_str(), request.search_mode.c_str());
             
-            if (query_embedding.empty())
+            const bool use_vector = request.search_mode != "keyword";
+            bool use_keyword = request.search_mode != "vector";
+            if (use_keyword && !(pImpl->lexical_ && pImpl->lexical_->ready()))
             {
-                throw std::runtime_error("Failed to generate embedding for query");
+                if (!use_vector)
+                {
+                    throw std::runtime_error(pImpl->lexical_ ? "Keyword index is still loading" :
+                                                               "Keyword search is disabled (database.lexical.enabled)");
+                }
+                KOLOSAL_LOG_WARNING("Keyword index not available; answering hybrid query with vector search only");
+                use_keyword = false;
             }
             
-            ServerLogger::logDebug("Generated query embedding with %zu dimensions", query_embedding.size());
+            // Fusion, and filtering keyword hits after the fact, both need deeper rankings than k
+            const bool fused = use_vector && use_keyword;
+            int candidates = (fused || (use_keyword && !request.filter.is_null())) ?
+                std::min(1000, std::max(request.k * 4, kMinFusionCandidates)) : request.k;
             
-            // Perform vector search
-            auto search_result = pImpl->vector_db_->search(
-                collection_name, 
-                query_embedding, 
-                request.k, 
-                request.score_threshold
-            ).get();
+            // A reranker rescores a deeper first-stage ranking than it returns
+            const bool rerank = !request.rerank_model.empty();
+            const int rerank_pool = request.rerank_candidates > 0 ? request.rerank_candidates : std::min(1000, request.k * 4);
+            if (rerank)
+            {
+                candidates = std::max(candidates, rerank_pool);
+            }
             
-            if (!search_result.success)
+            // The reranker reads the text even when the response leaves it out
+            std::vector<std::string> fetch_fields = request.fields;
+            const bool return_text = wantsField(request.fields, "text");
+            if (rerank && !return_text)
             {
-                std::string db_type = (pImpl->config_.vectorDatabase == DatabaseConfig::VectorDatabase::FAISS) ? "FAISS" : "Qdrant";
-                throw std::runtime_error("Vector search failed in " + db_type + ": " + search_result.error_message);
+                fetch_fields.push_back("text");
             }
             
-            ServerLogger::logInfo("Found search results in vector database");
+            // Per-stage latency, reported with the results
+            auto stage_start = std::chrono::steady_clock::now();
+            auto stage_ms = [&stage_start]() {
+                const auto now = std::chrono::steady_clock::now();
+                const double ms = std::chrono::duration<double, std::milli>(now - stage_start).count();
+                stage_start = now;
+                return ms;
+            };
             
-            // Process search results from response_data (works for both FAISS and Qdrant)
-            if (search_result.response_data.contains("result") && search_result.response_data["result"].is_array())
+            std::vector<RetrievedDocument> vector_hits;
+            if (use_vector)
             {
-                auto results = search_result.response_data["result"];
+                // Generate embedding for the query
+                auto query_embedding_future = pImpl->generateEmbedding(request.query, "");
+                std::vector<float> query_embedding = query_embedding_future.get();
+                response.embed_ms = stage_ms();
+                
+                if (query_embedding.empty())
+                {
+                    throw std::runtime_error("Failed to generate embedding for query");
+                }
+                
+                KOLOSAL_LOG_DEBUG("Generated query embedding with %zu dimensions", query_embedding.size());
                 
-                for (const auto& result_item : results)
+                // Perform vector search; the filter is applied by the database, so k results still come back.
+                // Only the projected payload fields are read back.
+                VectorSearchParams search_params;
+                search_params.filter = request.filter;
+                search_params.fields = fetch_fields;
+                search_params.deadline = deadline;
+                if (search_params.expired())
+                {
+                    throw DeadlineExceeded("Retrieval deadline of " + std::to_string(request.deadline_ms) +
+                                           " ms passed while embedding the query");
+                }
+                auto search_result = pImpl->vector_db_->search(
+                    collection_name, 
+                    query_embedding, 
+                    candidates, 
+                    request.score_threshold,
+                    search_params
+                ).get();
+                
+                if (!search_result.success && search_result.status_code == 504)
+                {
+                    throw DeadlineExceeded("Retrieval deadline of " + std::to_string(request.deadline_ms) +
+                                           " ms passed during the vector search");
+                }
+                if (!search_result.success)
+                {
+                    std::string db_type = (pImpl->config_.vectorDatabase == DatabaseConfig::VectorDatabase::FAISS) ? "FAISS" : "Qdrant";
+                    throw std::runtime_error("Vector search failed in " + db_type + ": " + search_result.error_message);
+                }
+                
+                KOLOSAL_LOG_INFO("Found search results in vector database");
+                
+                // Process search results from response_data (works for both FAISS and Qdrant)
+                for (auto& result_item : resultPoints(search_result.response_data))
                 {
                     if (result_item.contains("id") && result_item.contains("score") && 
                         result_item.contains("payload"))
@@ -761,38 +2420,175 @@ std::future<RetrieveResponse> DocumentService::retrieveDocuments(const RetrieveR
                             continue; // Skip results below threshold
                         }
                         
-                        RetrievedDocument doc;
-                        doc.id = result_item["id"].get<std::string>();
+                        RetrievedDocument doc = documentFromPoint(result_item, fetch_fields);
                         doc.score = score;
-                        
-                        // Extract text from payload
-                        auto payload = result_item["payload"];
-                        if (payload.contains("text"))
+                        vector_hits.push_back(std::move(doc));
+                    }
+                }
+            }
+            
+            std::vector<RetrievedDocument> keyword_hits;
+            if (use_keyword)
+            {
+                auto hits = pImpl->lexical_->search(request.query, candidates);
+                
+                // Payloads come from the vector store, reusing the ones the vector ranking already returned
+                std::unordered_map<std::string, const RetrievedDocument*> known;
+                for (const auto& doc : vector_hits)
+                {
+                    known[doc.id] = &doc;
+                }
+                std::vector<std::string> missing;
+                for (const auto& hit : hits)
+                {
+                    if (!known.count(hit.id))
+                    {
+                        missing.push_back(hit.id);
+                    }
+                }
+                std::unordered_map<std::string, RetrievedDocument> fetched;
+                if (!missing.empty())
+                {
+                    auto get_result = pImpl->vector_db_->getPoints(collection_name, missing).get();
+                    if (!get_result.success)
+                    {
+                        throw std::runtime_error("Failed to load keyword hits: " + get_result.error_message);
+                    }
+                    for (auto& point : resultPoints(get_result.response_data))
+                    {
+                        if (point.contains("id") && point.contains("payload") &&
+                            payloadMatchesFilter(request.filter, point["payload"]))
                         {
-                            doc.text = payload["text"].get<std::string>();
+                            RetrievedDocument doc = documentFromPoint(point, fetch_fields);
+                            fetched.emplace(doc.id, std::move(doc));
                         }
-                        
-                        // Extract metadata (exclude text field)
-                        for (auto& [key, value] : payload.items())
+                    }
+                }
+                
+                // Documents gone from the store or rejected by the filter drop out here
+                for (const auto& hit : hits)
+                {
+                    RetrievedDocument doc;
+                    if (auto it = known.find(hit.id); it != known.end())
+                    {
+                        doc = *it->second;
+                    }
+                    else if (auto found = fetched.find(hit.id); found != fetched.end())
+                    {
+                        doc = std::move(found->second);
+                    }
+                    else
+                    {
+                        continue;
+                    }
+                    doc.score = hit.score;
+                    keyword_hits.push_back(std::move(doc));
+                }
+                KOLOSAL_LOG_DEBUG("Keyword search matched %zu documents", keyword_hits.size());
+            }
+            
+            std::vector<RetrievedDocument> ranked;
+            if (!fused)
+            {
+                ranked = use_vector ? std::move(vector_hits) : std::move(keyword_hits);
+            }
+            else
+            {
+                // Vector similarities and BM25 scores live on different scales, so fuse ranks (RRF)
+                // or min-max normalized scores ("weighted")
+                const float keyword_weight = request.keyword_weight;
+                std::unordered_map<std::string, size_t> slots;
+                std::vector<float> fused_scores;
+                auto accumulate = [&](std::vector<RetrievedDocument>& hits, float weight) {
+                    float low = 0.0f;
+                    float high = 0.0f;
+                    if (!hits.empty())
+                    {
+                        auto [min_it, max_it] = std::minmax_element(hits.begin(), hits.end(),
+                            [](const RetrievedDocument& a, const RetrievedDocument& b) { return a.score < b.score; });
+                        low = min_it->score;
+                        high = max_it->score;
+                    }
+                    for (size_t rank = 0; rank < hits.size(); ++rank)
+                    {
+                        const float contribution = request.fusion == "weighted" ?
+                            weight * (high > low ? (hits[rank].score - low) / (high - low) : 1.0f) :
+                            weight / (kRrfK + static_cast<float>(rank + 1));
+                        auto [it, inserted] = slots.try_emplace(hits[rank].id, ranked.size());
+                        if (inserted)
                         {
-                            if (key != "text")
-                            {
-                                doc.metadata[key] = value;
-                            }
+                            ranked.push_back(std::move(hits[rank]));
+                            fused_scores.push_back(0.0f);
                         }
-                        
-                        response.addDocument(doc);
+                        fused_scores[it->second] += contribution;
                     }
+                };
+                accumulate(vector_hits, 1.0f - keyword_weight);
+                accumulate(keyword_hits, keyword_weight);
+                
+                for (size_t i = 0; i < ranked.size(); ++i)
+                {
+                    ranked[i].score = fused_scores[i];
+                }
+                std::stable_sort(ranked.begin(), ranked.end(),
+                    [](const RetrievedDocument& a, const RetrievedDocument& b) { return a.score > b.score; });
+            }
+            response.search_ms = stage_ms();
+            
+            if (rerank && !ranked.empty())
+            {
+                auto engine = ServerAPI::instance().getNodeManager().getEngine(request.rerank_model);
+                if (!engine)
+                {
+                    throw std::runtime_error("Rerank model '" + request.rerank_model + "' not found or could not be loaded");
+                }
+                
+                // All pairs are scored in shared decodes; the engine sorts only the k best
+                if (ranked.size() > static_cast<size_t>(rerank_pool))
+                {
+                    ranked.resize(rerank_pool);
+                }
+                std::vector<std::string> texts;
+                texts.reserve(ranked.size());
+                for (const auto& doc : ranked)
+                {
+                    texts.push_back(doc.text);
+                }
+                const std::vector<RerankResult> scored = engine->rerank(request.query, texts, request.k);
+                
+                std::vector<RetrievedDocument> reranked;
+                reranked.reserve(scored.size());
+                for (const auto& result : scored)
+                {
+                    reranked.push_back(std::move(ranked[result.index]));
+                    reranked.back().score = result.score;
+                }
+                ranked = std::move(reranked);
+                response.rerank_ms = stage_ms();
+                KOLOSAL_LOG_DEBUG("Reranked %zu candidates with '%s'", texts.size(), request.rerank_model.c_str());
+            }
+            
+            for (auto& doc : ranked)
+            {
+                if (response.total_found >= request.k)
+                {
+                    break;
+                }
+                if (!return_text)
+                {
+                    doc.text.clear();
                 }
+                response.addDocument(std::move(doc));
             }
+            pImpl->countRetrievals(response.documents);
             
-            ServerLogger::logInfo("Successfully retrieved %d documents for query", response.total_found);
+            KOLOSAL_LOG_INFO("Successfully retrieved %d documents for query", response.total_found);
             
             return response;
         }
         catch (const std::exception& ex)
         {
-            ServerLogger::logError("Error retrieving documents: %s", ex.what());
+            KOLOSAL_LOG_ERROR("Error retrieving documents: %s", ex.what());
             throw;
         }
     });
@@ -800,7 +2596,7 @@ std::future<RetrieveResponse> DocumentService::retrieveDocuments(const RetrieveR
 
 std::future<RemoveDocumentsResponse> DocumentService::removeDocuments(const RemoveDocumentsRequest& request)
 {
-    return std::async(std::launch::async, [this, request]() -> RemoveDocumentsResponse {
+    return TaskExecutor::instance().submit([this, request]() -> RemoveDocumentsResponse {
         RemoveDocumentsResponse response;
         
         try
@@ -814,12 +2610,13 @@ std::future<RemoveDocumentsResponse> DocumentService::removeDocuments(const Remo
             {
                 throw std::runtime_error("Vector database not initialized");
             }
+            pImpl->ensureWritable();
             
             std::string collection_name = "documents"; // Always use "documents" collection
             
             response.collection_name = collection_name;
             
-            ServerLogger::logInfo("Removing %zu documents from collection '%s'", 
+            KOLOSAL_LOG_INFO("Removing %zu documents from collection '%s'", 
                                   request.ids.size(), collection_name.c_str());
             
             // Check if collection exists
@@ -827,7 +2624,7 @@ std::future<RemoveDocumentsResponse> DocumentService::removeDocuments(const Remo
             if (!exists_result.success)
             {
                 // Collection doesn't exist, all IDs are "not found"
-                ServerLogger::logWarning("Collection '%s' does not exist, marking all documents as not found", 
+                KOLOSAL_LOG_WARNING("Collection '%s' does not exist, marking all documents as not found", 
                                          collection_name.c_str());
                 for (const auto& id : request.ids)
                 {
@@ -837,7 +2634,7 @@ std::future<RemoveDocumentsResponse> DocumentService::removeDocuments(const Remo
             }
             
             // First, check which documents exist by retrieving them
-            ServerLogger::logDebug("Checking existence of %zu documents before deletion", request.ids.size());
+            KOLOSAL_LOG_DEBUG("Checking existence of %zu documents before deletion", request.ids.size());
             auto get_result = pImpl->vector_db_->getPoints(collection_name, request.ids).get();
             
             std::vector<std::string> existing_ids;
@@ -874,7 +2671,7 @@ std::future<RemoveDocumentsResponse> DocumentService::removeDocuments(const Remo
             }
             else
             {
-                ServerLogger::logWarning("Failed to check document existence: %s", get_result.error_message.c_str());
+                KOLOSAL_LOG_WARNING("Failed to check document existence: %s", get_result.error_message.c_str());
                 // If we can't check existence, treat all as not found
                 not_found_ids = request.ids;
             }
@@ -885,7 +2682,7 @@ std::future<RemoveDocumentsResponse> DocumentService::removeDocuments(const Remo
                 response.addNotFound(id);
             }
             
-            ServerLogger::logInfo("Found %zu existing documents, %zu not found", 
+            KOLOSAL_LOG_INFO("Found %zu existing documents, %zu not found", 
                                   existing_ids.size(), not_found_ids.size());
             
             // Only attempt to delete existing documents
@@ -899,16 +2696,24 @@ std::future<RemoveDocumentsResponse> DocumentService::removeDocuments(const Remo
                     for (const auto& id : existing_ids)
                     {
                         response.addRemoved(id);
+                        if (pImpl->lexical_)
+                        {
+                            pImpl->lexical_->remove(id);
+                        }
+                        if (pImpl->dedup_)
+                        {
+                            pImpl->dedup_->remove(id);
+                        }
                     }
                     
-                    ServerLogger::logInfo("Successfully deleted %zu document IDs from collection '%s'", 
+                    KOLOSAL_LOG_INFO("Successfully deleted %zu document IDs from collection '%s'", 
                                           existing_ids.size(), collection_name.c_str());
                 }
                 else
                 {
                     // Delete operation failed, mark all existing documents as failed
                     std::string db_type = (pImpl->config_.vectorDatabase == DatabaseConfig::VectorDatabase::FAISS) ? "FAISS" : "Qdrant";
-                    ServerLogger::logError("Failed to delete points from %s: %s", 
+                    KOLOSAL_LOG_ERROR("Failed to delete points from %s: %s", 
                                            db_type.c_str(), delete_result.error_message.c_str());
                     
                     for (const auto& id : existing_ids)
@@ -922,7 +2727,7 @@ std::future<RemoveDocumentsResponse> DocumentService::removeDocuments(const Remo
         }
         catch (const std::exception& ex)
         {
-            ServerLogger::logError("Error in removeDocuments: %s", ex.what());
+            KOLOSAL_LOG_ERROR("Error in removeDocuments: %s", ex.what());
             
             // If we had some successes but failed at the end, still return partial results
             if (response.removed_count == 0 && response.not_found_count == 0)
@@ -941,213 +2746,211 @@ std::future<RemoveDocumentsResponse> DocumentService::removeDocuments(const Remo
 
 std::future<std::vector<std::string>> DocumentService::listDocuments(const std::string& collection_name)
 {
-    return std::async(std::launch::async, [this, collection_name]() -> std::vector<std::string> {
+    return TaskExecutor::instance().submit([this, collection_name]() -> std::vector<std::string> {
         try
         {
             std::string effective_collection_name = collection_name.empty() ? 
                 "documents" : collection_name;
             
             std::vector<std::string> all_ids;
-            std::string offset = "";
-            const int batch_size = 1000;
+            std::string cursor;
+            const size_t batch_size = 1000;
             
-            ServerLogger::logDebug("Starting to list documents from collection '%s'", 
+            KOLOSAL_LOG_DEBUG("Starting to list documents from collection '%s'", 
                                    effective_collection_name.c_str());
             
-            // Use scroll API to get all points
-            do {
-                auto result_future = pImpl->vector_db_->scrollPoints(effective_collection_name, batch_size, offset);
-                VectorResult result = result_future.get();
-                
-                if (!result.success)
-                {
-                    std::string db_type = (pImpl->config_.vectorDatabase == DatabaseConfig::VectorDatabase::FAISS) ? "FAISS" : "Qdrant";
-                    throw std::runtime_error("Failed to scroll points in " + db_type + ": " + result.error_message);
-                }
-                
-                // Process results from response_data (works for both FAISS and Qdrant)  
-                bool hasPoints = false;
-                if (result.response_data.contains("result"))
-                {
-                    nlohmann::json resultData = result.response_data["result"];
-                    
-                    // Handle different response formats
-                    nlohmann::json points;
-                    if (resultData.contains("points") && resultData["points"].is_array())
-                    {
-                        // Qdrant format
-                        points = resultData["points"];
-                    }
-                    else if (resultData.is_array())
-                    {
-                        // FAISS format (direct array)
-                        points = resultData;
-                    }
-                    
-                    if (!points.empty())
-                    {
-                        hasPoints = true;
-                        
-                        // Extract IDs from points
-                        for (const auto& point : points)
-                        {
-                            if (point.contains("id"))
-                            {
-                                std::string id = point["id"].is_string() ? 
-                                    point["id"].get<std::string>() : 
-                                    std::to_string(point["id"].get<int64_t>());
-                                all_ids.push_back(id);
-                            }
-                        }
-                    }
-                }
-                
-                if (!hasPoints)
-                {
-                    break; // No more points
-                }
-                
-                // Update offset for next batch
-                // For FAISS, this may be handled differently than Qdrant
-                if (result.response_data.contains("next_page_offset") &&
-                    !result.response_data["next_page_offset"].is_null())
-                {
-                    if (result.response_data["next_page_offset"].is_string())
-                    {
-                        offset = result.response_data["next_page_offset"].get<std::string>();
-                    }
-                    else if (result.response_data["next_page_offset"].is_number())
-                    {
-                        offset = std::to_string(result.response_data["next_page_offset"].get<int64_t>());
-                    }
-                    else
-                    {
-                        break; // No more pages
-                    }
-                }
-                else
-                {
-                    break; // No next page
-                }
-                
-            } while (!offset.empty() && offset != "null");
+            do
+            {
+                DocumentPage page = listDocumentsPage(batch_size, cursor, effective_collection_name).get();
+                all_ids.insert(all_ids.end(), std::make_move_iterator(page.ids.begin()),
+                               std::make_move_iterator(page.ids.end()));
+                cursor = std::move(page.next_cursor);
+            } while (!cursor.empty());
             
-            ServerLogger::logInfo("Listed %zu documents from collection '%s'", 
+            KOLOSAL_LOG_INFO("Listed %zu documents from collection '%s'", 
                                   all_ids.size(), effective_collection_name.c_str());
             
             return all_ids;
         }
         catch (const std::exception& ex)
         {
-            ServerLogger::logError("Error listing documents: %s", ex.what());
+            KOLOSAL_LOG_ERROR("Error listing documents: %s", ex.what());
             throw;
         }
     });
 }
 
+std::future<DocumentPage> DocumentService::listDocumentsPage(size_t limit, const std::string& cursor,
+                                                             const std::string& collection_name)
+{
+    return TaskExecutor::instance().submit([this, limit, cursor, collection_name]() -> DocumentPage {
+        const std::string effective_collection_name = collection_name.empty() ? "documents" : collection_name;
+        const int page_size = static_cast<int>(std::clamp<size_t>(limit, 1, std::numeric_limits<int>::max()));
+
+        // IDs only: payloads are neither read from the store nor sent over the wire
+        VectorResult result = pImpl->vector_db_->scrollPoints(effective_collection_name, page_size, cursor, false).get();
+        if (!result.success)
+        {
+            if (result.status_code == 400 && !cursor.empty())
+            {
+                throw std::invalid_argument("Invalid cursor '" + cursor + "': " + result.error_message);
+            }
+            std::string db_type = (pImpl->config_.vectorDatabase == DatabaseConfig::VectorDatabase::FAISS) ? "FAISS" : "Qdrant";
+            throw std::runtime_error("Failed to scroll points in " + db_type + ": " + result.error_message);
+        }
+
+        DocumentPage page;
+        const nlohmann::json& points = resultPoints(result.response_data);
+        page.ids.reserve(points.size());
+        for (const auto& point : points)
+        {
+            if (point.contains("id"))
+            {
+                page.ids.push_back(pointId(point));
+            }
+        }
+        // A backend that hands out an empty page with a cursor still gets asked again by the caller
+        page.next_cursor = nextPageOffset(result.response_data);
+        return page;
+    });
+}
+
 std::future<std::vector<std::pair<std::string, std::optional<std::pair<std::string, std::unordered_map<std::string, nlohmann::json>>>>>> 
 DocumentService::getDocumentsInfo(const std::vector<std::string>& ids, const std::string& collection_name)
 {
-    return std::async(std::launch::async, [this, ids, collection_name]() {
+    return TaskExecutor::instance().submit([this, ids, collection_name]() {
         try
         {
             std::string effective_collection_name = collection_name.empty() ? 
                 "documents" : collection_name;
             
-            ServerLogger::logDebug("Getting info for %zu documents from collection '%s'", 
+            KOLOSAL_LOG_DEBUG("Getting info for %zu documents from collection '%s'", 
                                    ids.size(), effective_collection_name.c_str());
             
+            // Results keep the request's order; each returned point is placed through a hash lookup
             std::vector<std::pair<std::string, std::optional<std::pair<std::string, std::unordered_map<std::string, nlohmann::json>>>>> results;
-            
-            // Process in batches to avoid overwhelming the server
-            const size_t batch_size = 100;
-            for (size_t i = 0; i < ids.size(); i += batch_size)
+            results.reserve(ids.size());
+            std::unordered_map<std::string, std::vector<size_t>> positions;
+            positions.reserve(ids.size());
+            std::vector<std::string> unique_ids;
+            unique_ids.reserve(ids.size());
+            for (size_t i = 0; i < ids.size(); ++i)
             {
-                std::vector<std::string> batch_ids;
-                for (size_t j = i; j < std::min(i + batch_size, ids.size()); ++j)
+                results.emplace_back(ids[i], std::nullopt);
+                auto& slots = positions[ids[i]];
+                if (slots.empty())
                 {
-                    batch_ids.push_back(ids[j]);
+                    unique_ids.push_back(ids[i]);
                 }
+                slots.push_back(i);
+            }
+            
+            // FAISS lives in this process and looks every ID up directly, so it takes them in one call;
+            // Qdrant gets batches to keep its requests small
+            const bool remote = pImpl->config_.vectorDatabase != DatabaseConfig::VectorDatabase::FAISS;
+            const size_t batch_size = remote ? 100 : std::max<size_t>(unique_ids.size(), 1);
+            size_t found = 0;
+            for (size_t i = 0; i < unique_ids.size(); i += batch_size)
+            {
+                const std::vector<std::string> batch_ids(unique_ids.begin() + i,
+                                                         unique_ids.begin() + std::min(i + batch_size, unique_ids.size()));
                 
-                auto result_future = pImpl->vector_db_->getPoints(effective_collection_name, batch_ids);
-                VectorResult result = result_future.get();
-                
+                VectorResult result = pImpl->vector_db_->getPoints(effective_collection_name, batch_ids).get();
                 if (!result.success)
                 {
-                    ServerLogger::logWarning("Failed to get batch of points: %s", result.error_message.c_str());
-                    
-                    // Mark all points in this batch as not found
-                    for (const auto& id : batch_ids)
-                    {
-                        results.emplace_back(id, std::nullopt);
-                    }
+                    // The batch's IDs stay not found
+                    KOLOSAL_LOG_WARNING("Failed to get batch of points: %s", result.error_message.c_str());
                     continue;
                 }
                 
-                // Process results from response_data (works for both FAISS and Qdrant)
-                std::set<std::string> found_ids;
-                
-                if (result.response_data.contains("result") && result.response_data["result"].is_array())
+                for (auto& point : resultPoints(result.response_data))
                 {
-                    auto points = result.response_data["result"];
+                    if (!point.contains("id") || !point.contains("payload"))
+                    {
+                        continue;
+                    }
+                    auto slots = positions.find(pointId(point));
+                    if (slots == positions.end())
+                    {
+                        continue;
+                    }
                     
-                    for (const auto& point : points)
+                    // Extract text and metadata (everything except text) from the payload
+                    std::string text;
+                    std::unordered_map<std::string, nlohmann::json> metadata;
+                    for (auto& [key, value] : point["payload"].items())
                     {
-                        if (point.contains("id") && point.contains("payload"))
+                        if (key == "text")
                         {
-                            std::string id = point["id"].is_string() ? 
-                                point["id"].get<std::string>() : 
-                                std::to_string(point["id"].get<int64_t>());
-                            
-                            found_ids.insert(id);
-                            
-                            // Extract text and metadata from payload
-                            std::string text = "";
-                            std::unordered_map<std::string, nlohmann::json> metadata;
-                            
-                            if (point["payload"].contains("text") && point["payload"]["text"].is_string())
+                            if (value.is_string())
                             {
-                                text = point["payload"]["text"].get<std::string>();
+                                text = value.get<std::string>();
                             }
-                            
-                            // Extract metadata (everything except text)
-                            for (auto it = point["payload"].begin(); it != point["payload"].end(); ++it)
-                            {
-                                if (it.key() != "text")
-                                {
-                                    metadata[it.key()] = it.value();
-                                }
-                            }
-                            
-                            results.emplace_back(id, std::make_pair(text, metadata));
+                        }
+                        else
+                        {
+                            metadata[key] = std::move(value);
                         }
                     }
-                }
-                
-                // Mark any IDs that weren't found
-                for (const auto& id : batch_ids)
-                {
-                    if (found_ids.find(id) == found_ids.end())
+                    
+                    for (size_t slot : slots->second)
                     {
-                        results.emplace_back(id, std::nullopt);
+                        results[slot].second = std::make_pair(text, metadata);
+                        ++found;
                     }
                 }
             }
             
-            ServerLogger::logInfo("Retrieved info for %zu/%zu documents from collection '%s'", 
-                                  std::count_if(results.begin(), results.end(), 
-                                               [](const auto& pair) { return pair.second.has_value(); }),
-                                  ids.size(), effective_collection_name.c_str());
+            KOLOSAL_LOG_INFO("Retrieved info for %zu/%zu documents from collection '%s'", 
+                                  found, ids.size(), effective_collection_name.c_str());
             
             return results;
         }
         catch (const std::exception& ex)
         {
-            ServerLogger::logError("Error getting documents info: %s", ex.what());
+            KOLOSAL_LOG_ERROR("Error getting documents info: %s", ex.what());
             throw;
         }
     });
 }
 
+ReplicationResult DocumentService::exportSnapshot(const std::function<bool(const char*, size_t)>& sink)
+{
+    if (!pImpl->initialized_ || !pImpl->vector_db_)
+    {
+        return {false, 503, "DocumentService not initialized", nullptr};
+    }
+    return replicationResult(pImpl->vector_db_->exportSnapshot("documents", sink));
+}
+
+ReplicationResult DocumentService::importSnapshot(std::istream& in)
+{
+    if (!pImpl->initialized_ || !pImpl->vector_db_)
+    {
+        return {false, 503, "DocumentService not initialized", nullptr};
+    }
+    if (pImpl->following())
+    {
+        return {false, 409, "This server restores its snapshots from " + pImpl->config_.replication.source + " itself", nullptr};
+    }
+    return pImpl->restoreSnapshot("documents", in);
+}
+
+ReplicationResult DocumentService::readChanges(const std::string& epoch, uint64_t position, size_t max_bytes,
+                                               std::string& records)
+{
+    if (!pImpl->initialized_ || !pImpl->vector_db_)
+    {
+        return {false, 503, "DocumentService not initialized", nullptr};
+    }
+    return replicationResult(pImpl->vector_db_->readChanges("documents", epoch, position, max_bytes, records));
+}
+
+nlohmann::json DocumentService::replicationStatus() const
+{
+    std::lock_guard<std::mutex> lock(pImpl->replication_mutex_);
+    return pImpl->following() ? pImpl->replication_status_ : nlohmann::json();
+}
+
 } // namespace retrieval
 } // namespace kolosal
@@ -0,0 +1,399 @@
+#include "kolosal/retrieval/embedding_cache.hpp"
+#include "kolosal/logger.hpp"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+
+namespace kolosal
+{
+namespace retrieval
+{
+
+namespace
+{
+    constexpr char kMagic[8] = {'K', 'L', 'E', 'M', 'B', 'C', '0', '1'};
+    constexpr size_t kRecordHeaderBytes = 8 + 8 + 4;    // Key high, key low, dimensions
+    constexpr uint32_t kMaxDimensions = 1 << 16;        // Anything larger is a corrupt record
+    constexpr size_t kEntryOverheadBytes = 96;          // List node, map node and vector header
+
+    uint64_t mix(uint64_t value)
+    {
+        value ^= value >> 33;
+        value *= 0xFF51AFD7ED558CCDULL;
+        value ^= value >> 33;
+        value *= 0xC4CEB9FE1A85EC53ULL;
+        value ^= value >> 33;
+        return value;
+    }
+
+    // Two independent 64-bit hashes over the same bytes: FNV-1a, and a word-at-a-time
+    // multiply-mix seeded differently. Stable across runs and platforms, as the disk tier needs.
+    void hashBytes(const std::string& bytes, uint64_t& fnv, uint64_t& mixed)
+    {
+        for (unsigned char c : bytes)
+        {
+            fnv ^= c;
+            fnv *= 0x100000001B3ULL;
+        }
+
+        size_t i = 0;
+        for (; i + 8 <= bytes.size(); i += 8)
+        {
+            uint64_t word = 0;
+            for (int b = 7; b >= 0; --b)
+            {
+                word = (word << 8) | static_cast<unsigned char>(bytes[i + b]);
+            }
+            mixed = mix(mixed ^ word) * 0x9E3779B97F4A7C15ULL;
+        }
+        uint64_t tail = 0;
+        for (size_t b = bytes.size(); b > i; --b)
+        {
+            tail = (tail << 8) | static_cast<unsigned char>(bytes[b - 1]);
+        }
+        mixed = mix(mixed ^ tail ^ (static_cast<uint64_t>(bytes.size()) << 56));
+    }
+}
+
+EmbeddingCache& EmbeddingCache::instance()
+{
+    static EmbeddingCache cache;
+    return cache;
+}
+
+void EmbeddingCache::configure(const DatabaseConfig::EmbeddingCacheConfig& config)
+{
+    std::lock_guard<std::mutex> disk_lock(disk_mutex_);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        enabled_ = config.enabled;
+        memory_limit_ = static_cast<size_t>(std::max(0, config.memoryMb)) * 1024 * 1024;
+        lru_.clear();
+        entries_.clear();
+        memory_bytes_ = 0;
+    }
+
+    if (disk_.is_open())
+    {
+        disk_.close();
+    }
+    disk_index_.clear();
+    disk_bytes_ = 0;
+    disk_path_ = config.enabled ? config.path : std::string();
+    disk_limit_ = static_cast<uint64_t>(std::max(0, config.diskMb)) * 1024 * 1024;
+    if (!disk_path_.empty())
+    {
+        openDiskLocked();
+    }
+
+    KOLOSAL_LOG_INFO("Embedding cache %s (memory %d MB, disk %s)",
+                          config.enabled ? "enabled" : "disabled", config.memoryMb,
+                          disk_.is_open() ? disk_path_.c_str() : "off");
+}
+
+EmbeddingCache::Key EmbeddingCache::makeKey(const std::string& model_id, const std::string& text, bool normalize)
+{
+    uint64_t fnv = 0xCBF29CE484222325ULL;
+    uint64_t mixed = 0x243F6A8885A308D3ULL;
+    hashBytes(model_id + '\0' + (normalize ? '1' : '0') + '\0', fnv, mixed);
+    hashBytes(text, fnv, mixed);
+    return Key{mixed, fnv};
+}
+
+size_t EmbeddingCache::entryBytes(const Entry& entry)
+{
+    return entry.embedding.size() * sizeof(float) + kEntryOverheadBytes;
+}
+
+std::optional<std::vector<float>> EmbeddingCache::get(const std::string& model_id, const std::string& text, bool normalize)
+{
+    if (!enabled())
+    {
+        return std::nullopt;
+    }
+
+    const Key key = makeKey(model_id, text, normalize);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = entries_.find(key);
+        if (it != entries_.end())
+        {
+            lru_.splice(lru_.begin(), lru_, it->second);
+            hits_.fetch_add(1, std::memory_order_relaxed);
+            return it->second->embedding;
+        }
+    }
+
+    auto embedding = readDisk(key);
+    if (!embedding)
+    {
+        misses_.fetch_add(1, std::memory_order_relaxed);
+        return std::nullopt;
+    }
+
+    disk_hits_.fetch_add(1, std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(mutex_);
+    insertLocked(key, *embedding);
+    return embedding;
+}
+
+void EmbeddingCache::put(const std::string& model_id, const std::string& text, bool normalize, const std::vector<float>& embedding)
+{
+    if (!enabled() || embedding.empty())
+    {
+        return;
+    }
+
+    const Key key = makeKey(model_id, text, normalize);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        insertLocked(key, embedding);
+    }
+    appendDisk(key, embedding);
+}
+
+void EmbeddingCache::insertLocked(const Key& key, std::vector<float> embedding)
+{
+    auto it = entries_.find(key);
+    if (it != entries_.end())
+    {
+        memory_bytes_ -= entryBytes(*it->second);
+        it->second->embedding = std::move(embedding);
+        memory_bytes_ += entryBytes(*it->second);
+        lru_.splice(lru_.begin(), lru_, it->second);
+    }
+    else
+    {
+        lru_.push_front(Entry{key, std::move(embedding)});
+        entries_[key] = lru_.begin();
+        memory_bytes_ += entryBytes(lru_.front());
+    }
+
+    while (memory_bytes_ > memory_limit_ && !lru_.empty())
+    {
+        memory_bytes_ -= entryBytes(lru_.back());
+        entries_.erase(lru_.back().key);
+        lru_.pop_back();
+        evictions_.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+std::optional<std::vector<float>> EmbeddingCache::readDisk(const Key& key)
+{
+    std::lock_guard<std::mutex> lock(disk_mutex_);
+    if (!disk_.is_open())
+    {
+        return std::nullopt;
+    }
+    auto it = disk_index_.find(key);
+    if (it == disk_index_.end())
+    {
+        return std::nullopt;
+    }
+
+    std::vector<float> embedding(it->second.dimensions);
+    disk_.clear();
+    disk_.seekg(static_cast<std::streamoff>(it->second.offset));
+    disk_.read(reinterpret_cast<char*>(embedding.data()), static_cast<std::streamsize>(embedding.size() * sizeof(float)));
+    if (!disk_)
+    {
+        KOLOSAL_LOG_WARNING("Embedding cache: failed to read %s; dropping the entry", disk_path_.c_str());
+        disk_.clear();
+        disk_index_.erase(it);
+        return std::nullopt;
+    }
+    return embedding;
+}
+
+void EmbeddingCache::appendDisk(const Key& key, const std::vector<float>& embedding)
+{
+    std::lock_guard<std::mutex> lock(disk_mutex_);
+    if (!disk_.is_open() || disk_index_.count(key) || embedding.size() > kMaxDimensions)
+    {
+        return;
+    }
+
+    const uint64_t record_bytes = kRecordHeaderBytes + embedding.size() * sizeof(float);
+    if (disk_limit_ > 0 && disk_bytes_ + record_bytes > disk_limit_)
+    {
+        compactDiskLocked();
+        if (!disk_.is_open() || disk_index_.count(key) || disk_bytes_ + record_bytes > disk_limit_)
+        {
+            return;
+        }
+    }
+
+    const uint32_t dimensions = static_cast<uint32_t>(embedding.size());
+    disk_.clear();
+    disk_.seekp(static_cast<std::streamoff>(disk_bytes_));
+    disk_.write(reinterpret_cast<const char*>(&key.high), sizeof(key.high));
+    disk_.write(reinterpret_cast<const char*>(&key.low), sizeof(key.low));
+    disk_.write(reinterpret_cast<const char*>(&dimensions), sizeof(dimensions));
+    disk_.write(reinterpret_cast<const char*>(embedding.data()), static_cast<std::streamsize>(embedding.size() * sizeof(float)));
+    disk_.flush();
+    if (!disk_)
+    {
+        // A torn record past disk_bytes_ is overwritten by the next append or cut off on load
+        KOLOSAL_LOG_WARNING("Embedding cache: failed to write %s", disk_path_.c_str());
+        disk_.clear();
+        return;
+    }
+
+    disk_index_[key] = DiskRecord{disk_bytes_ + kRecordHeaderBytes, dimensions};
+    disk_bytes_ += record_bytes;
+}
+
+// Index the records of the cache file, creating it if needed. A record cut short by a
+// crash ends the scan, and the file is truncated there so appends continue cleanly.
+void EmbeddingCache::openDiskLocked()
+{
+    namespace fs = std::filesystem;
+    std::error_code ec;
+    const fs::path path(disk_path_);
+    if (path.has_parent_path())
+    {
+        fs::create_directories(path.parent_path(), ec);
+    }
+
+    if (!fs::exists(path, ec) || fs::file_size(path, ec) < sizeof(kMagic))
+    {
+        std::ofstream create(disk_path_, std::ios::binary | std::ios::trunc);
+        create.write(kMagic, sizeof(kMagic));
+        if (!create)
+        {
+            KOLOSAL_LOG_WARNING("Embedding cache: cannot create %s; disk tier disabled", disk_path_.c_str());
+            return;
+        }
+    }
+
+    std::ifstream in(disk_path_, std::ios::binary);
+    char magic[sizeof(kMagic)] = {};
+    in.read(magic, sizeof(magic));
+    if (!in || std::memcmp(magic, kMagic, sizeof(kMagic)) != 0)
+    {
+        KOLOSAL_LOG_WARNING("Embedding cache: %s is not an embedding cache file; disk tier disabled", disk_path_.c_str());
+        return;
+    }
+
+    uint64_t offset = sizeof(kMagic);
+    while (true)
+    {
+        Key key;
+        uint32_t dimensions = 0;
+        in.read(reinterpret_cast<char*>(&key.high), sizeof(key.high));
+        in.read(reinterpret_cast<char*>(&key.low), sizeof(key.low));
+        in.read(reinterpret_cast<char*>(&dimensions), sizeof(dimensions));
+        if (!in || dimensions == 0 || dimensions > kMaxDimensions)
+        {
+            break;
+        }
+        in.seekg(static_cast<std::streamoff>(dimensions * sizeof(float)), std::ios::cur);
+        if (!in || static_cast<uint64_t>(in.tellg()) < offset + kRecordHeaderBytes + dimensions * sizeof(float))
+        {
+            break;
+        }
+        disk_index_[key] = DiskRecord{offset + kRecordHeaderBytes, dimensions};
+        offset += kRecordHeaderBytes + dimensions * sizeof(float);
+    }
+    in.close();
+
+    if (fs::file_size(path, ec) > offset)
+    {
+        KOLOSAL_LOG_WARNING("Embedding cache: discarding a truncated record at the end of %s", disk_path_.c_str());
+        fs::resize_file(path, offset, ec);
+    }
+
+    disk_.open(disk_path_, std::ios::binary | std::ios::in | std::ios::out);
+    if (!disk_.is_open())
+    {
+        KOLOSAL_LOG_WARNING("Embedding cache: cannot open %s; disk tier disabled", disk_path_.c_str());
+        disk_index_.clear();
+        return;
+    }
+    disk_bytes_ = offset;
+    KOLOSAL_LOG_INFO("Embedding cache: indexed %zu embeddings in %s", disk_index_.size(), disk_path_.c_str());
+}
+
+// Rewrite the cache file with the memory tier, most recently used first, up to half the
+// budget, so the next compaction is at least as many appends away
+void EmbeddingCache::compactDiskLocked()
+{
+    const std::string temp_path = disk_path_ + ".tmp";
+    std::unordered_map<Key, DiskRecord, KeyHash> index;
+    uint64_t bytes = sizeof(kMagic);
+    {
+        std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+        out.write(kMagic, sizeof(kMagic));
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& entry : lru_)
+        {
+            const uint32_t dimensions = static_cast<uint32_t>(entry.embedding.size());
+            const uint64_t record_bytes = kRecordHeaderBytes + dimensions * sizeof(float);
+            if (dimensions > kMaxDimensions || bytes + record_bytes > disk_limit_ / 2)
+            {
+                continue;
+            }
+            out.write(reinterpret_cast<const char*>(&entry.key.high), sizeof(entry.key.high));
+            out.write(reinterpret_cast<const char*>(&entry.key.low), sizeof(entry.key.low));
+            out.write(reinterpret_cast<const char*>(&dimensions), sizeof(dimensions));
+            out.write(reinterpret_cast<const char*>(entry.embedding.data()), static_cast<std::streamsize>(dimensions * sizeof(float)));
+            index[entry.key] = DiskRecord{bytes + kRecordHeaderBytes, dimensions};
+            bytes += record_bytes;
+        }
+        out.flush();
+        if (!out)
+        {
+            KOLOSAL_LOG_WARNING("Embedding cache: failed to compact %s", disk_path_.c_str());
+            std::error_code ec;
+            std::filesystem::remove(temp_path, ec);
+            return;
+        }
+    }
+
+    disk_.close();
+    std::error_code ec;
+    std::filesystem::rename(temp_path, disk_path_, ec);
+    if (ec)
+    {
+        KOLOSAL_LOG_WARNING("Embedding cache: failed to replace %s: %s", disk_path_.c_str(), ec.message().c_str());
+        std::filesystem::remove(temp_path, ec);
+    }
+    else
+    {
+        disk_index_ = std::move(index);
+        disk_bytes_ = bytes;
+    }
+
+    disk_.open(disk_path_, std::ios::binary | std::ios::in | std::ios::out);
+    if (!disk_.is_open())
+    {
+        KOLOSAL_LOG_WARNING("Embedding cache: cannot reopen %s; disk tier disabled", disk_path_.c_str());
+        disk_index_.clear();
+        return;
+    }
+    KOLOSAL_LOG_INFO("Embedding cache: compacted %s to %zu embeddings", disk_path_.c_str(), disk_index_.size());
+}
+
+EmbeddingCache::Stats EmbeddingCache::stats() const
+{
+    Stats stats;
+    stats.hits = hits_.load(std::memory_order_relaxed);
+    stats.disk_hits = disk_hits_.load(std::memory_order_relaxed);
+    stats.misses = misses_.load(std::memory_order_relaxed);
+    stats.evictions = evictions_.load(std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats.entries = entries_.size();
+        stats.memory_bytes = memory_bytes_;
+    }
+    {
+        std::lock_guard<std::mutex> lock(disk_mutex_);
+        stats.disk_entries = disk_index_.size();
+        stats.disk_bytes = static_cast<size_t>(disk_bytes_);
+    }
+    return stats;
+}
+
+} // namespace retrieval
+} // namespace kolosal
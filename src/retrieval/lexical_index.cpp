@@ -0,0 +1,527 @@
+#include "kolosal/retrieval/lexical_index.hpp"
+#include "kolosal/retrieval/chunking_types.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <functional>
+#include <mutex>
+#include <queue>
+
+namespace kolosal
+{
+namespace retrieval
+{
+
+namespace
+{
+    constexpr uint32_t kEnd = UINT32_MAX;
+    constexpr size_t kMaxTermBytes = 64;        // Longer "words" are hashes, URLs or base64 noise
+    constexpr size_t kMinCompactDocs = 1024;    // Dead documents tolerated before compacting
+
+    // UTF-8 continuation and lead bytes count as word characters
+    bool isWordByte(unsigned char c)
+    {
+        return c >= 0x80 || std::isalnum(c);
+    }
+
+    void putVarint(std::vector<uint8_t>& out, uint32_t value)
+    {
+        while (value >= 0x80)
+        {
+            out.push_back(static_cast<uint8_t>(value | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<uint8_t>(value));
+    }
+
+    uint32_t getVarint(const uint8_t*& in)
+    {
+        uint32_t value = 0;
+        for (int shift = 0;; shift += 7)
+        {
+            const uint8_t byte = *in++;
+            value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80))
+                return value;
+        }
+    }
+}
+
+// Walks one posting list for search(); blocks are decoded only when the cursor lands in them
+class LexicalIndex::Cursor
+{
+public:
+    Cursor(const LexicalIndex& index, const PostingList& list, float idf)
+        : index_(index), list_(list), idf_(idf),
+          blocks_(list.blocks.size() + (list.tail.empty() ? 0 : 1)),
+          max_score_(idf * index.weight(list.max_tf, list.min_length))
+    {
+        load(0);
+    }
+
+    uint32_t doc() const { return doc_; }
+    float maxScore() const { return max_score_; }
+
+    float score() const
+    {
+        return idf_ * index_.weight(buffer_[pos_].second, index_.doc_lengths_[doc_]);
+    }
+
+    void next()
+    {
+        if (++pos_ < buffer_.size())
+            doc_ = buffer_[pos_].first;
+        else
+            load(block_ + 1);
+    }
+
+    // Move to the first posting at or after target
+    void advance(uint32_t target)
+    {
+        if (doc_ >= target)
+            return;
+        const size_t block = find(target);
+        if (block != block_)
+        {
+            load(block);
+            if (doc_ == kEnd)
+                return;
+        }
+        while (buffer_[pos_].first < target)
+            ++pos_;
+        doc_ = buffer_[pos_].first;
+    }
+
+    // Upper bound of the block holding target, without moving; last is set to that block's last doc
+    float blockMax(uint32_t target, uint32_t& last) const
+    {
+        const size_t block = find(target);
+        if (block >= blocks_)
+        {
+            last = kEnd;
+            return 0.0f;
+        }
+        last = lastDoc(block);
+        const bool tail = block == list_.blocks.size();
+        return idf_ * index_.weight(tail ? list_.tail_max_tf : list_.blocks[block].max_tf,
+                                    tail ? list_.tail_min_length : list_.blocks[block].min_length);
+    }
+
+private:
+    uint32_t lastDoc(size_t block) const
+    {
+        return block < list_.blocks.size() ? list_.blocks[block].last_doc : list_.tail.back().first;
+    }
+
+    // First block from the current one whose last doc reaches target, or blocks_
+    size_t find(uint32_t target) const
+    {
+        auto it = std::partition_point(list_.blocks.begin() + std::min(block_, list_.blocks.size()), list_.blocks.end(),
+                                       [target](const Block& block) { return block.last_doc < target; });
+        size_t block = static_cast<size_t>(it - list_.blocks.begin());
+        if (block == list_.blocks.size() && (list_.tail.empty() || list_.tail.back().first < target))
+            return blocks_;
+        return block;
+    }
+
+    void load(size_t block)
+    {
+        block_ = block;
+        pos_ = 0;
+        if (block >= blocks_)
+        {
+            doc_ = kEnd;
+            return;
+        }
+        LexicalIndex::decodeBlock(list_, block, buffer_);
+        doc_ = buffer_[0].first;
+    }
+
+    const LexicalIndex& index_;
+    const PostingList& list_;
+    float idf_;
+    size_t blocks_;
+    float max_score_;
+    size_t block_ = 0;
+    size_t pos_ = 0;
+    uint32_t doc_ = kEnd;
+    std::vector<std::pair<uint32_t, uint32_t>> buffer_;
+};
+
+LexicalIndex::LexicalIndex(float k1, float b) : k1_(k1), b_(b)
+{
+}
+
+std::vector<std::string> LexicalIndex::analyze(const std::string& text)
+{
+    std::vector<std::string> terms;
+    for (const auto& span : ChunkingService::splitWordSpans(text))
+    {
+        const std::string_view word(text.data() + span.offset, span.length);
+        size_t first = 0;
+        size_t last = word.size();
+        while (first < last && !isWordByte(static_cast<unsigned char>(word[first])))
+            ++first;
+        while (last > first && !isWordByte(static_cast<unsigned char>(word[last - 1])))
+            --last;
+        if (first == last || last - first > kMaxTermBytes)
+            continue;
+
+        std::string term(word.substr(first, last - first));
+        bool compound = false;
+        for (char& c : term)
+        {
+            const unsigned char byte = static_cast<unsigned char>(c);
+            if (byte < 0x80)
+            {
+                c = static_cast<char>(std::tolower(byte));
+                compound = compound || !std::isalnum(byte);
+            }
+        }
+        if (compound)
+        {
+            size_t start = 0;
+            for (size_t i = 0; i <= term.size(); ++i)
+            {
+                if (i < term.size() && isWordByte(static_cast<unsigned char>(term[i])))
+                    continue;
+                if (i > start)
+                    terms.push_back(term.substr(start, i - start));
+                start = i + 1;
+            }
+        }
+        terms.push_back(std::move(term));
+    }
+    return terms;
+}
+
+float LexicalIndex::weight(uint32_t tf, uint32_t length) const
+{
+    const float average = live_docs_ ? static_cast<float>(live_length_) / static_cast<float>(live_docs_) : 1.0f;
+    const float norm = k1_ * (1.0f - b_ + b_ * static_cast<float>(length) / std::max(average, 1.0f));
+    return static_cast<float>(tf) * (k1_ + 1.0f) / (static_cast<float>(tf) + norm);
+}
+
+void LexicalIndex::append(PostingList& list, uint32_t doc, uint32_t tf, uint32_t length)
+{
+    list.tail.emplace_back(doc, tf);
+    list.tail_max_tf = std::max(list.tail_max_tf, tf);
+    list.tail_min_length = std::min(list.tail_min_length, length);
+    list.max_tf = std::max(list.max_tf, tf);
+    list.min_length = std::min(list.min_length, length);
+    ++list.doc_freq;
+    if (list.tail.size() == kBlockSize)
+        flushTail(list);
+}
+
+void LexicalIndex::flushTail(PostingList& list)
+{
+    Block block;
+    block.offset = static_cast<uint32_t>(list.bytes.size());
+    block.count = static_cast<uint32_t>(list.tail.size());
+    block.last_doc = list.tail.back().first;
+    block.max_tf = list.tail_max_tf;
+    block.min_length = list.tail_min_length;
+
+    uint32_t previous = list.blocks.empty() ? 0 : list.blocks.back().last_doc;
+    for (const auto& [doc, tf] : list.tail)
+    {
+        putVarint(list.bytes, doc - previous);
+        putVarint(list.bytes, tf);
+        previous = doc;
+    }
+    list.blocks.push_back(block);
+    list.tail.clear();
+    list.tail_max_tf = 0;
+    list.tail_min_length = UINT32_MAX;
+}
+
+void LexicalIndex::decodeBlock(const PostingList& list, size_t block, std::vector<std::pair<uint32_t, uint32_t>>& out)
+{
+    if (block == list.blocks.size())
+    {
+        out = list.tail;
+        return;
+    }
+    const Block& meta = list.blocks[block];
+    out.resize(meta.count);
+    const uint8_t* in = list.bytes.data() + meta.offset;
+    uint32_t doc = block ? list.blocks[block - 1].last_doc : 0;
+    for (auto& posting : out)
+    {
+        doc += getVarint(in);
+        posting.first = doc;
+        posting.second = getVarint(in);
+    }
+}
+
+void LexicalIndex::add(const std::string& id, const std::string& text)
+{
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    if (loading_)
+        touched_.insert(id);
+    addLocked(id, text);
+}
+
+bool LexicalIndex::remove(const std::string& id)
+{
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    if (loading_)
+    {
+        touched_.insert(id);
+        ++removed_during_load_;
+    }
+    return removeLocked(id);
+}
+
+void LexicalIndex::beginLoad()
+{
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    loading_ = true;
+    touched_.clear();
+    removed_during_load_ = 0;
+}
+
+void LexicalIndex::load(const std::string& id, const std::string& text)
+{
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    if (touched_.count(id) || docs_.count(id))
+        return;
+    addLocked(id, text);
+}
+
+size_t LexicalIndex::endLoad()
+{
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    loading_ = false;
+    ready_ = true;
+    touched_.clear();
+    return removed_during_load_;
+}
+
+bool LexicalIndex::ready() const
+{
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return ready_;
+}
+
+size_t LexicalIndex::size() const
+{
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return live_docs_;
+}
+
+void LexicalIndex::addLocked(const std::string& id, const std::string& text)
+{
+    removeLocked(id);
+    const auto words = analyze(text);
+    if (words.empty())
+        return;
+    if (doc_ids_.size() >= kEnd - 1)
+        compactLocked();
+
+    std::unordered_map<std::string, uint32_t> frequencies;
+    for (const auto& word : words)
+        ++frequencies[word];
+
+    const uint32_t doc = static_cast<uint32_t>(doc_ids_.size());
+    const uint32_t length = static_cast<uint32_t>(words.size());
+    doc_ids_.push_back(id);
+    doc_lengths_.push_back(length);
+    docs_[id] = doc;
+    ++live_docs_;
+    live_length_ += length;
+
+    for (const auto& [term, tf] : frequencies)
+    {
+        auto [it, inserted] = terms_.try_emplace(term, static_cast<uint32_t>(postings_.size()));
+        if (inserted)
+            postings_.emplace_back();
+        append(postings_[it->second], doc, tf, length);
+    }
+}
+
+bool LexicalIndex::removeLocked(const std::string& id)
+{
+    auto it = docs_.find(id);
+    if (it == docs_.end())
+        return false;
+    const uint32_t doc = it->second;
+    docs_.erase(it);
+    doc_ids_[doc].clear();
+    --live_docs_;
+    live_length_ -= doc_lengths_[doc];
+
+    const size_t dead = doc_ids_.size() - live_docs_;
+    if (dead >= kMinCompactDocs && dead > live_docs_ / 4)
+        compactLocked();
+    return true;
+}
+
+void LexicalIndex::compactLocked()
+{
+    // Renumbering keeps the live documents in order, so every list stays sorted
+    std::vector<uint32_t> renumbered(doc_ids_.size(), kEnd);
+    std::vector<std::string> doc_ids;
+    std::vector<uint32_t> doc_lengths;
+    doc_ids.reserve(live_docs_);
+    doc_lengths.reserve(live_docs_);
+    for (size_t doc = 0; doc < doc_ids_.size(); ++doc)
+    {
+        if (doc_ids_[doc].empty())
+            continue;
+        renumbered[doc] = static_cast<uint32_t>(doc_ids.size());
+        docs_[doc_ids_[doc]] = renumbered[doc];
+        doc_ids.push_back(std::move(doc_ids_[doc]));
+        doc_lengths.push_back(doc_lengths_[doc]);
+    }
+
+    std::unordered_map<std::string, uint32_t> terms;
+    std::vector<PostingList> postings;
+    std::vector<std::pair<uint32_t, uint32_t>> buffer;
+    for (auto& [term, index] : terms_)
+    {
+        const PostingList& old_list = postings_[index];
+        PostingList list;
+        const size_t blocks = old_list.blocks.size() + (old_list.tail.empty() ? 0 : 1);
+        for (size_t block = 0; block < blocks; ++block)
+        {
+            decodeBlock(old_list, block, buffer);
+            for (const auto& [doc, tf] : buffer)
+            {
+                if (renumbered[doc] != kEnd)
+                    append(list, renumbered[doc], tf, doc_lengths[renumbered[doc]]);
+            }
+        }
+        if (list.doc_freq == 0)
+            continue;
+        terms.emplace(term, static_cast<uint32_t>(postings.size()));
+        postings.push_back(std::move(list));
+    }
+
+    terms_ = std::move(terms);
+    postings_ = std::move(postings);
+    doc_ids_ = std::move(doc_ids);
+    doc_lengths_ = std::move(doc_lengths);
+}
+
+std::vector<LexicalIndex::Hit> LexicalIndex::search(const std::string& query, int k) const
+{
+    std::vector<Hit> hits;
+    if (k <= 0)
+        return hits;
+    auto words = analyze(query);
+    std::sort(words.begin(), words.end());
+    words.erase(std::unique(words.begin(), words.end()), words.end());
+
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    if (live_docs_ == 0)
+        return hits;
+
+    // Dead documents still count towards N and df until the next compaction
+    const float docs = static_cast<float>(doc_ids_.size());
+    std::vector<Cursor> cursors;
+    cursors.reserve(words.size());
+    for (const auto& word : words)
+    {
+        auto it = terms_.find(word);
+        if (it == terms_.end())
+            continue;
+        const PostingList& list = postings_[it->second];
+        const float df = static_cast<float>(list.doc_freq);
+        cursors.emplace_back(*this, list, std::log(1.0f + (docs - df + 0.5f) / (df + 0.5f)));
+    }
+    std::vector<Cursor*> order;
+    for (auto& cursor : cursors)
+        order.push_back(&cursor);
+
+    // Block-max WAND: min-heap of the best k, theta is the score a document must beat to enter it
+    using Scored = std::pair<float, uint32_t>;
+    std::priority_queue<Scored, std::vector<Scored>, std::greater<Scored>> top;
+    float theta = 0.0f;
+    auto byDoc = [](const Cursor* a, const Cursor* b) { return a->doc() < b->doc(); };
+    auto byBound = [](const Cursor* a, const Cursor* b) { return a->maxScore() < b->maxScore(); };
+
+    while (true)
+    {
+        std::sort(order.begin(), order.end(), byDoc);
+
+        // Pivot: the first document whose terms' list-wide bounds could beat theta
+        float bound = 0.0f;
+        size_t pivot = order.size();
+        for (size_t i = 0; i < order.size() && order[i]->doc() != kEnd; ++i)
+        {
+            bound += order[i]->maxScore();
+            if (bound > theta)
+            {
+                pivot = i;
+                break;
+            }
+        }
+        if (pivot == order.size())
+            break;
+        const uint32_t pivot_doc = order[pivot]->doc();
+        while (pivot + 1 < order.size() && order[pivot + 1]->doc() == pivot_doc)
+            ++pivot;
+
+        // Tighten with the bounds of the blocks that actually hold the pivot
+        float block_bound = 0.0f;
+        uint32_t block_end = kEnd;
+        for (size_t i = 0; i <= pivot; ++i)
+        {
+            uint32_t last;
+            block_bound += order[i]->blockMax(pivot_doc, last);
+            block_end = std::min(block_end, last);
+        }
+
+        if (block_bound > theta)
+        {
+            if (order[0]->doc() == pivot_doc)
+            {
+                if (!doc_ids_[pivot_doc].empty())
+                {
+                    float score = 0.0f;
+                    for (size_t i = 0; i <= pivot; ++i)
+                        score += order[i]->score();
+                    if (top.size() < static_cast<size_t>(k) || score > top.top().first)
+                    {
+                        top.emplace(score, pivot_doc);
+                        if (top.size() > static_cast<size_t>(k))
+                            top.pop();
+                        if (top.size() == static_cast<size_t>(k))
+                            theta = top.top().first;
+                    }
+                }
+                for (size_t i = 0; i <= pivot; ++i)
+                    order[i]->next();
+            }
+            else
+            {
+                // Documents before the pivot cannot beat theta; skip the strongest lagging list to it
+                auto lagging = std::partition_point(order.begin(), order.begin() + pivot,
+                                                    [pivot_doc](const Cursor* c) { return c->doc() < pivot_doc; });
+                (*std::max_element(order.begin(), lagging, byBound))->advance(pivot_doc);
+            }
+        }
+        else
+        {
+            // Nothing up to the end of the shortest of these blocks can beat theta either
+            uint32_t target = block_end == kEnd ? kEnd : block_end + 1;
+            if (pivot + 1 < order.size())
+                target = std::min(target, order[pivot + 1]->doc());
+            target = std::max(target, pivot_doc + 1);
+            (*std::max_element(order.begin(), order.begin() + pivot + 1, byBound))->advance(target);
+        }
+    }
+
+    hits.resize(top.size());
+    for (size_t i = top.size(); i-- > 0; top.pop())
+    {
+        hits[i].id = doc_ids_[top.top().second];
+        hits[i].score = top.top().first;
+    }
+    return hits;
+}
+
+} // namespace retrieval
+} // namespace kolosal
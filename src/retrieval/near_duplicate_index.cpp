@@ -0,0 +1,290 @@
+#include "kolosal/retrieval/near_duplicate_index.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <mutex>
+
+namespace kolosal
+{
+namespace retrieval
+{
+
+namespace
+{
+    constexpr uint64_t kFnvOffset = 1469598103934665603ULL;
+    constexpr uint64_t kFnvPrime = 1099511628211ULL;
+    // The LSH curve's midpoint sits this far below the threshold, so pairs just above it
+    // still share a band with high probability (about 99% at 0.9 with 128 hashes)
+    constexpr double kBandMargin = 0.1;
+
+    // UTF-8 continuation and lead bytes count as word characters, as in LexicalIndex
+    bool isWordByte(unsigned char c)
+    {
+        return c >= 0x80 || std::isalnum(c);
+    }
+
+    // splitmix64 finalizer: a cheap, well-mixed 64-bit permutation
+    uint64_t mix(uint64_t x)
+    {
+        x ^= x >> 30;
+        x *= 0xbf58476d1ce4e5b9ULL;
+        x ^= x >> 27;
+        x *= 0x94d049bb133111ebULL;
+        x ^= x >> 31;
+        return x;
+    }
+}
+
+NearDuplicateIndex::NearDuplicateIndex(double threshold, int shingle_words, int num_hashes)
+    : threshold_(std::min(1.0, std::max(0.0, threshold))),
+      shingle_words_(std::max(1, shingle_words)),
+      num_hashes_(std::max(1, num_hashes))
+{
+    // Longest bands whose curve midpoint (1/bands)^(1/rows) stays below the threshold:
+    // longer bands mean fewer chance collisions to verify
+    rows_ = 1;
+    for (int rows = 2; rows <= num_hashes_; ++rows)
+    {
+        const int bands = num_hashes_ / rows;
+        if (std::pow(1.0 / bands, 1.0 / rows) > threshold_ - kBandMargin)
+            break;
+        rows_ = rows;
+    }
+    bands_ = num_hashes_ / rows_;
+
+    // Fixed seeds keep signatures comparable across restarts
+    uint64_t state = 0x6b6f6c6f73616cULL;
+    seeds_.reserve(num_hashes_);
+    for (int i = 0; i < num_hashes_; ++i)
+    {
+        state += 0x9e3779b97f4a7c15ULL;
+        seeds_.push_back(mix(state));
+    }
+}
+
+NearDuplicateIndex::Signature NearDuplicateIndex::signature(const std::string& text) const
+{
+    // One hash per lowercased word
+    std::vector<uint64_t> words;
+    uint64_t word = kFnvOffset;
+    bool in_word = false;
+    for (unsigned char c : text)
+    {
+        if (isWordByte(c))
+        {
+            word = (word ^ static_cast<unsigned char>(std::tolower(c))) * kFnvPrime;
+            in_word = true;
+        }
+        else if (in_word)
+        {
+            words.push_back(word);
+            word = kFnvOffset;
+            in_word = false;
+        }
+    }
+    if (in_word)
+        words.push_back(word);
+    if (words.empty())
+        return {};
+
+    // Texts shorter than a shingle are one shingle of all their words
+    const size_t width = std::min(words.size(), static_cast<size_t>(shingle_words_));
+    std::vector<uint64_t> shingles;
+    shingles.reserve(words.size() - width + 1);
+    for (size_t i = 0; i + width <= words.size(); ++i)
+    {
+        uint64_t shingle = kFnvOffset;
+        for (size_t j = i; j < i + width; ++j)
+            shingle = mix(shingle ^ words[j]);
+        shingles.push_back(shingle);
+    }
+    std::sort(shingles.begin(), shingles.end());
+    shingles.erase(std::unique(shingles.begin(), shingles.end()), shingles.end());
+
+    Signature result(num_hashes_, UINT32_MAX);
+    for (uint64_t shingle : shingles)
+    {
+        for (int h = 0; h < num_hashes_; ++h)
+            result[h] = std::min(result[h], static_cast<uint32_t>(mix(shingle ^ seeds_[h])));
+    }
+    return result;
+}
+
+double NearDuplicateIndex::similarity(const Signature& a, const Signature& b) const
+{
+    if (a.size() != static_cast<size_t>(num_hashes_) || b.size() != a.size())
+        return 0.0;
+    int equal = 0;
+    for (int h = 0; h < num_hashes_; ++h)
+        equal += a[h] == b[h];
+    return static_cast<double>(equal) / num_hashes_;
+}
+
+uint64_t NearDuplicateIndex::bandKey(const uint32_t* signature, int band) const
+{
+    uint64_t key = mix(kFnvOffset + static_cast<uint64_t>(band));
+    const uint32_t* rows = signature + static_cast<size_t>(band) * rows_;
+    for (int r = 0; r < rows_; ++r)
+        key = mix(key ^ rows[r]);
+    return key;
+}
+
+bool NearDuplicateIndex::find(const Signature& signature, Match& match) const
+{
+    if (signature.size() != static_cast<size_t>(num_hashes_))
+        return false;
+
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    std::vector<uint32_t> candidates;
+    for (int band = 0; band < bands_; ++band)
+    {
+        auto bucket = buckets_.find(bandKey(signature.data(), band));
+        if (bucket != buckets_.end())
+            candidates.insert(candidates.end(), bucket->second.begin(), bucket->second.end());
+    }
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+    bool found = false;
+    for (uint32_t slot : candidates)
+    {
+        const uint32_t* stored = signatures_.data() + static_cast<size_t>(slot) * num_hashes_;
+        int equal = 0;
+        for (int h = 0; h < num_hashes_; ++h)
+            equal += signature[h] == stored[h];
+        const double estimate = static_cast<double>(equal) / num_hashes_;
+        if (estimate >= threshold_ && (!found || estimate > match.similarity))
+        {
+            match.id = slot_ids_[slot];
+            match.similarity = estimate;
+            found = true;
+        }
+    }
+    return found;
+}
+
+void NearDuplicateIndex::add(const std::string& id, const Signature& signature)
+{
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    if (loading_)
+        touched_.insert(id);
+    addLocked(id, signature);
+}
+
+bool NearDuplicateIndex::remove(const std::string& id)
+{
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    if (loading_)
+    {
+        touched_.insert(id);
+        ++removed_during_load_;
+    }
+    return removeLocked(id);
+}
+
+void NearDuplicateIndex::beginLoad()
+{
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    loading_ = true;
+    touched_.clear();
+    removed_during_load_ = 0;
+}
+
+void NearDuplicateIndex::load(const std::string& id, const std::string& text)
+{
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        if (touched_.count(id) || slots_.count(id))
+            return;
+    }
+    // Hash outside the lock; add() and remove() may run meanwhile, so check again
+    const Signature computed = signature(text);
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    if (touched_.count(id) || slots_.count(id))
+        return;
+    addLocked(id, computed);
+}
+
+size_t NearDuplicateIndex::endLoad()
+{
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    loading_ = false;
+    touched_.clear();
+    return removed_during_load_;
+}
+
+size_t NearDuplicateIndex::size() const
+{
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return slots_.size();
+}
+
+size_t NearDuplicateIndex::memoryBytes() const
+{
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    size_t bytes = signatures_.capacity() * sizeof(uint32_t) + bucket_entries_ * sizeof(uint32_t);
+    bytes += buckets_.size() * (sizeof(uint64_t) + sizeof(std::vector<uint32_t>) + sizeof(void*));
+    for (const auto& [id, slot] : slots_)
+        bytes += 2 * id.capacity() + sizeof(slot);
+    return bytes;
+}
+
+void NearDuplicateIndex::addLocked(const std::string& id, const Signature& signature)
+{
+    removeLocked(id);
+    if (signature.size() != static_cast<size_t>(num_hashes_))
+        return;
+
+    uint32_t slot;
+    if (!free_slots_.empty())
+    {
+        slot = free_slots_.back();
+        free_slots_.pop_back();
+        slot_ids_[slot] = id;
+    }
+    else
+    {
+        slot = static_cast<uint32_t>(slot_ids_.size());
+        slot_ids_.push_back(id);
+        signatures_.resize(signatures_.size() + num_hashes_);
+    }
+    std::copy(signature.begin(), signature.end(), signatures_.begin() + static_cast<size_t>(slot) * num_hashes_);
+    slots_[id] = slot;
+
+    for (int band = 0; band < bands_; ++band)
+        buckets_[bandKey(signature.data(), band)].push_back(slot);
+    bucket_entries_ += bands_;
+}
+
+bool NearDuplicateIndex::removeLocked(const std::string& id)
+{
+    auto it = slots_.find(id);
+    if (it == slots_.end())
+        return false;
+    const uint32_t slot = it->second;
+    slots_.erase(it);
+
+    const uint32_t* stored = signatures_.data() + static_cast<size_t>(slot) * num_hashes_;
+    for (int band = 0; band < bands_; ++band)
+    {
+        auto bucket = buckets_.find(bandKey(stored, band));
+        if (bucket == buckets_.end())
+            continue;
+        auto& entries = bucket->second;
+        auto entry = std::find(entries.begin(), entries.end(), slot);
+        if (entry != entries.end())
+        {
+            *entry = entries.back();
+            entries.pop_back();
+            --bucket_entries_;
+        }
+        if (entries.empty())
+            buckets_.erase(bucket);
+    }
+    slot_ids_[slot].clear();
+    free_slots_.push_back(slot);
+    return true;
+}
+
+} // namespace retrieval
+} // namespace kolosal
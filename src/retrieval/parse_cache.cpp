@@ -0,0 +1,273 @@
+#include "kolosal/retrieval/parse_cache.hpp"
+#include "kolosal/logger.hpp"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+namespace kolosal
+{
+namespace retrieval
+{
+
+namespace
+{
+    constexpr const char* kExtension = ".parse";
+
+    uint64_t mix(uint64_t value)
+    {
+        value ^= value >> 33;
+        value *= 0xFF51AFD7ED558CCDULL;
+        value ^= value >> 33;
+        value *= 0xC4CEB9FE1A85EC53ULL;
+        value ^= value >> 33;
+        return value;
+    }
+
+    // Two independently seeded word-at-a-time lanes. Uploads run to hundreds of megabytes, so
+    // this reads whole words rather than bytes; the key only has to be stable on one host.
+    void hashBytes(std::string_view bytes, uint64_t& first, uint64_t& second)
+    {
+        const char* data = bytes.data();
+        size_t i = 0;
+        for (; i + 8 <= bytes.size(); i += 8)
+        {
+            uint64_t word;
+            std::memcpy(&word, data + i, sizeof(word));
+            first = (first ^ word) * 0x9E3779B97F4A7C15ULL;
+            first = (first << 31) | (first >> 33);
+            second = (second + word) * 0xC2B2AE3D27D4EB4FULL;
+            second = (second << 29) | (second >> 35);
+        }
+        uint64_t tail = 0;
+        std::memcpy(&tail, data + i, bytes.size() - i);
+        first = mix(first ^ tail ^ (static_cast<uint64_t>(bytes.size()) << 56));
+        second = mix(second + tail + bytes.size());
+    }
+
+    bool isKey(const std::string& name)
+    {
+        return name.size() == 32 && std::all_of(name.begin(), name.end(), [](char c) {
+            return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f');
+        });
+    }
+}
+
+ParseCache& ParseCache::instance()
+{
+    static ParseCache cache;
+    return cache;
+}
+
+void ParseCache::configure(const DatabaseConfig::ParseCacheConfig& config)
+{
+    namespace fs = std::filesystem;
+    std::lock_guard<std::mutex> lock(mutex_);
+    enabled_ = false;
+    lru_.clear();
+    entries_.clear();
+    bytes_ = 0;
+    directory_ = config.path;
+    limit_ = static_cast<uint64_t>(std::max(0, config.diskMb)) * 1024 * 1024;
+    if (!config.enabled || directory_.empty())
+    {
+        KOLOSAL_LOG_INFO("Parse cache disabled");
+        return;
+    }
+
+    std::error_code ec;
+    fs::create_directories(directory_, ec);
+    if (!fs::is_directory(directory_, ec))
+    {
+        KOLOSAL_LOG_WARNING("Parse cache: cannot create %s; cache disabled", directory_.c_str());
+        return;
+    }
+
+    // Rebuild the recency order from the modification times, which hits keep current
+    struct Found
+    {
+        std::string key;
+        uint64_t bytes;
+        fs::file_time_type used;
+    };
+    std::vector<Found> found;
+    for (fs::directory_iterator it(directory_, ec), end; !ec && it != end; it.increment(ec))
+    {
+        const fs::path& path = it->path();
+        if (!it->is_regular_file(ec))
+        {
+            continue;
+        }
+        if (path.extension() != kExtension || !isKey(path.stem().string()))
+        {
+            // A result whose write was interrupted
+            if (path.extension() == ".tmp")
+            {
+                fs::remove(path, ec);
+            }
+            continue;
+        }
+        found.push_back({path.stem().string(), it->file_size(ec), it->last_write_time(ec)});
+    }
+    std::sort(found.begin(), found.end(), [](const Found& a, const Found& b) { return a.used > b.used; });
+
+    for (auto& entry : found)
+    {
+        lru_.push_back(Entry{std::move(entry.key), entry.bytes});
+        entries_[lru_.back().key] = std::prev(lru_.end());
+        bytes_ += entry.bytes;
+    }
+    evictLocked();
+    enabled_ = true;
+
+    KOLOSAL_LOG_INFO("Parse cache enabled in %s (%zu results, %d MB budget)",
+                          directory_.c_str(), entries_.size(), config.diskMb);
+}
+
+std::string ParseCache::makeKey(const std::string& type, const std::string& options, std::string_view content)
+{
+    uint64_t first = 0x243F6A8885A308D3ULL;
+    uint64_t second = 0x13198A2E03707344ULL;
+    hashBytes(type + '\0' + options + '\0', first, second);
+    hashBytes(content, first, second);
+
+    static const char digits[] = "0123456789abcdef";
+    std::string key(32, '0');
+    for (int i = 0; i < 16; ++i)
+    {
+        key[15 - i] = digits[(first >> (4 * i)) & 0xF];
+        key[31 - i] = digits[(second >> (4 * i)) & 0xF];
+    }
+    return key;
+}
+
+std::string ParseCache::pathFor(const std::string& key) const
+{
+    return (std::filesystem::path(directory_) / (key + kExtension)).string();
+}
+
+std::optional<std::string> ParseCache::get(const std::string& key)
+{
+    if (!enabled())
+    {
+        return std::nullopt;
+    }
+
+    std::string path;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = entries_.find(key);
+        if (it == entries_.end())
+        {
+            misses_.fetch_add(1, std::memory_order_relaxed);
+            return std::nullopt;
+        }
+        lru_.splice(lru_.begin(), lru_, it->second);
+        path = pathFor(key);
+    }
+
+    std::ifstream in(path, std::ios::binary);
+    std::string result((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    if (!in.is_open() || in.bad() || result.empty())
+    {
+        // Evicted by a concurrent put, or removed from under us
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = entries_.find(key);
+        if (it != entries_.end())
+        {
+            bytes_ -= it->second->bytes;
+            lru_.erase(it->second);
+            entries_.erase(it);
+        }
+        misses_.fetch_add(1, std::memory_order_relaxed);
+        return std::nullopt;
+    }
+
+    std::error_code ec;
+    std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), ec);
+    hits_.fetch_add(1, std::memory_order_relaxed);
+    return result;
+}
+
+void ParseCache::put(const std::string& key, const std::string& result)
+{
+    if (!enabled() || result.empty() || result.size() > limit_)
+    {
+        return;
+    }
+
+    // Write beside the final name and rename, so readers never see a partial result
+    const std::string path = pathFor(key);
+    const std::string temp_path = path + ".tmp";
+    {
+        std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+        out.write(result.data(), static_cast<std::streamsize>(result.size()));
+        out.flush();
+        if (!out)
+        {
+            KOLOSAL_LOG_WARNING("Parse cache: failed to write %s", temp_path.c_str());
+            std::error_code ec;
+            std::filesystem::remove(temp_path, ec);
+            return;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::error_code ec;
+    std::filesystem::rename(temp_path, path, ec);
+    if (ec)
+    {
+        KOLOSAL_LOG_WARNING("Parse cache: failed to store %s: %s", path.c_str(), ec.message().c_str());
+        std::filesystem::remove(temp_path, ec);
+        return;
+    }
+    touchLocked(key, result.size());
+    evictLocked();
+}
+
+void ParseCache::touchLocked(const std::string& key, uint64_t bytes)
+{
+    auto it = entries_.find(key);
+    if (it != entries_.end())
+    {
+        bytes_ -= it->second->bytes;
+        it->second->bytes = bytes;
+        lru_.splice(lru_.begin(), lru_, it->second);
+    }
+    else
+    {
+        lru_.push_front(Entry{key, bytes});
+        entries_[key] = lru_.begin();
+    }
+    bytes_ += bytes;
+}
+
+void ParseCache::evictLocked()
+{
+    while (bytes_ > limit_ && !lru_.empty())
+    {
+        std::error_code ec;
+        std::filesystem::remove(pathFor(lru_.back().key), ec);
+        bytes_ -= lru_.back().bytes;
+        entries_.erase(lru_.back().key);
+        lru_.pop_back();
+        evictions_.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+ParseCache::Stats ParseCache::stats() const
+{
+    Stats stats;
+    stats.hits = hits_.load(std::memory_order_relaxed);
+    stats.misses = misses_.load(std::memory_order_relaxed);
+    stats.evictions = evictions_.load(std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats.entries = entries_.size();
+    stats.bytes = static_cast<size_t>(bytes_);
+    return stats;
+}
+
+} // namespace retrieval
+} // namespace kolosal
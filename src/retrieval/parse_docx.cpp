@@ -1,248 +1,683 @@
 #include "kolosal/retrieval/parse_docx.hpp"
+#include "kolosal/task_executor.hpp"
 #include <fstream>
 #include <filesystem>
 #include <algorithm>
 #include <thread>
 #include <future>
-#include <mutex>
-#include <regex>
 #include <sstream>
 #include <stdexcept>
 #include <cstring>
+#include <cctype>
+#include <cstdlib>
+#include <string_view>
 #include <unzip.h>
-#include <pugixml.hpp>
 
 namespace retrieval
 {
-    // Thread safety mutex for minizip operations
-    static std::mutex zip_mutex;
-
-    // Forward declaration
-    static std::string extract_document_xml_from_file(const std::string &file_path);    // Internal function to extract document.xml from file (without mutex locking)
-    static std::string extract_document_xml_from_file_internal(const std::string &file_path)
+    namespace
     {
+        // Inflated bytes handed to the XML reader per read
+        constexpr size_t kInflateChunkBytes = 64 * 1024;
 
-        unzFile archive = unzOpen(file_path.c_str());
-        if (!archive)
+        // minizip reads a memory buffer through these callbacks, so every archive has its
+        // own handle and nothing is shared between threads
+        struct MemoryArchive
         {
-            throw std::runtime_error("Failed to open DOCX file: " + file_path);
-        }
+            const unsigned char *data = nullptr;
+            size_t size = 0;
+            size_t position = 0;
+        };
 
-        // Find document.xml
-        if (unzLocateFile(archive, "word/document.xml", 0) != UNZ_OK)
+        voidpf ZCALLBACK memory_open(voidpf /*opaque*/, const void *filename, int /*mode*/)
         {
-            unzClose(archive);
-            throw std::runtime_error("document.xml not found in DOCX file");
+            return const_cast<void *>(filename);
         }
 
-        if (unzOpenCurrentFile(archive) != UNZ_OK)
+        uLong ZCALLBACK memory_read(voidpf /*opaque*/, voidpf stream, void *buf, uLong size)
         {
-            unzClose(archive);
-            throw std::runtime_error("Failed to open document.xml");
+            auto *archive = static_cast<MemoryArchive *>(stream);
+            const size_t count = std::min<size_t>(size, archive->size - archive->position);
+            std::memcpy(buf, archive->data + archive->position, count);
+            archive->position += count;
+            return static_cast<uLong>(count);
         }
 
-        // Read file content
-        std::string content;
-        char buffer[8192];
-        int bytes_read;
-
-        while ((bytes_read = unzReadCurrentFile(archive, buffer, sizeof(buffer))) > 0)
+        uLong ZCALLBACK memory_write(voidpf /*opaque*/, voidpf /*stream*/, const void * /*buf*/, uLong /*size*/)
         {
-            content.append(buffer, bytes_read);
+            return 0;
         }
 
-        unzCloseCurrentFile(archive);
-        unzClose(archive);
-
-        if (bytes_read < 0)
+        ZPOS64_T ZCALLBACK memory_tell(voidpf /*opaque*/, voidpf stream)
         {
-            throw std::runtime_error("Error reading document.xml");
+            return static_cast<ZPOS64_T>(static_cast<MemoryArchive *>(stream)->position);
         }
 
-        return content;
-    }
-
-    // Extract document.xml from file (with mutex locking)
-    static std::string extract_document_xml_from_file(const std::string &file_path)
-    {
-        std::lock_guard<std::mutex> lock(zip_mutex);
-        return extract_document_xml_from_file_internal(file_path);
-    }
-
-    // Extract document.xml from DOCX archive in memory
-    static std::string extract_document_xml_from_memory(const unsigned char *data, size_t size)
-    {
-        std::lock_guard<std::mutex> lock(zip_mutex);
-        
-        // Write data to temporary file for minizip
-        std::string temp_file = (std::filesystem::temp_directory_path() / "temp_docx.docx").string();
-        std::ofstream temp_out(temp_file, std::ios::binary);
-        if (!temp_out.is_open())
+        long ZCALLBACK memory_seek(voidpf /*opaque*/, voidpf stream, ZPOS64_T offset, int origin)
         {
-            throw std::runtime_error("Failed to create temporary file");
+            auto *archive = static_cast<MemoryArchive *>(stream);
+            ZPOS64_T base = 0;
+            switch (origin)
+            {
+            case ZLIB_FILEFUNC_SEEK_SET:
+                base = 0;
+                break;
+            case ZLIB_FILEFUNC_SEEK_CUR:
+                base = archive->position;
+                break;
+            case ZLIB_FILEFUNC_SEEK_END:
+                base = archive->size;
+                break;
+            default:
+                return -1;
+            }
+            if (base + offset > archive->size)
+            {
+                return -1;
+            }
+            archive->position = static_cast<size_t>(base + offset);
+            return 0;
         }
-        temp_out.write(reinterpret_cast<const char*>(data), size);
-        temp_out.close();
 
-        try
+        int ZCALLBACK memory_close(voidpf /*opaque*/, voidpf /*stream*/)
         {
-            // Use the internal function to avoid double locking
-            std::string result = extract_document_xml_from_file_internal(temp_file);
-            std::filesystem::remove(temp_file);
-            return result;
+            return 0;
         }
-        catch (...)
+
+        int ZCALLBACK memory_error(voidpf /*opaque*/, voidpf /*stream*/)
         {
-            std::filesystem::remove(temp_file);
-            throw;
+            return 0;
         }
-    }
 
-    // Process text run with formatting
-    static std::string process_run(const pugi::xml_node &run)
-    {
-        std::string text;
-        bool is_bold = false;
-        bool is_italic = false;
+        unzFile open_memory_archive(MemoryArchive &archive)
+        {
+            zlib_filefunc64_def functions{};
+            functions.zopen64_file = memory_open;
+            functions.zread_file = memory_read;
+            functions.zwrite_file = memory_write;
+            functions.ztell64_file = memory_tell;
+            functions.zseek64_file = memory_seek;
+            functions.zclose_file = memory_close;
+            functions.zerror_file = memory_error;
+            functions.opaque = nullptr;
+            return unzOpen2_64(&archive, &functions);
+        }
 
-        // Check formatting properties
-        pugi::xml_node props = run.select_node(".//w:rPr").node();
-        if (props)
+        // Closes the archive however the caller leaves
+        struct ArchiveHandle
         {
-            is_bold = props.select_node(".//w:b").node() != nullptr;
-            is_italic = props.select_node(".//w:i").node() != nullptr;
-        }        // Extract text content
-        for (pugi::xpath_node xpath_node : run.select_nodes(".//w:t"))
+            unzFile archive;
+            explicit ArchiveHandle(unzFile a) : archive(a) {}
+            ~ArchiveHandle()
+            {
+                if (archive)
+                {
+                    unzClose(archive);
+                }
+            }
+            ArchiveHandle(const ArchiveHandle &) = delete;
+            ArchiveHandle &operator=(const ArchiveHandle &) = delete;
+        };
+
+        bool has_docx_parts(unzFile archive)
         {
-            pugi::xml_node text_node = xpath_node.node();
-            text += text_node.text().get();
+            return unzLocateFile(archive, "word/document.xml", 0) == UNZ_OK &&
+                   unzLocateFile(archive, "[Content_Types].xml", 0) == UNZ_OK &&
+                   unzLocateFile(archive, "_rels/.rels", 0) == UNZ_OK;
         }
 
-        // Handle line breaks
-        for (pugi::xpath_node xpath_node : run.select_nodes(".//w:br"))
+        void append_utf8(std::string &out, unsigned long code_point)
         {
-            text += "\n";
+            if (code_point < 0x80)
+            {
+                out += static_cast<char>(code_point);
+            }
+            else if (code_point < 0x800)
+            {
+                out += static_cast<char>(0xC0 | (code_point >> 6));
+                out += static_cast<char>(0x80 | (code_point & 0x3F));
+            }
+            else if (code_point < 0x10000)
+            {
+                out += static_cast<char>(0xE0 | (code_point >> 12));
+                out += static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+                out += static_cast<char>(0x80 | (code_point & 0x3F));
+            }
+            else if (code_point < 0x110000)
+            {
+                out += static_cast<char>(0xF0 | (code_point >> 18));
+                out += static_cast<char>(0x80 | ((code_point >> 12) & 0x3F));
+                out += static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+                out += static_cast<char>(0x80 | (code_point & 0x3F));
+            }
         }
 
-        // Apply markdown formatting
-        if (is_bold && is_italic)
+        // Appends character data with the predefined and numeric entities resolved
+        void append_decoded(std::string &out, std::string_view text)
         {
-            text = "***" + text + "***";
+            size_t pos = 0;
+            while (pos < text.size())
+            {
+                const size_t amp = text.find('&', pos);
+                if (amp == std::string_view::npos)
+                {
+                    out.append(text.data() + pos, text.size() - pos);
+                    return;
+                }
+                out.append(text.data() + pos, amp - pos);
+                const size_t semi = text.find(';', amp);
+                if (semi == std::string_view::npos)
+                {
+                    out.append(text.data() + amp, text.size() - amp);
+                    return;
+                }
+
+                const std::string_view entity = text.substr(amp + 1, semi - amp - 1);
+                if (entity == "amp") out += '&';
+                else if (entity == "lt") out += '<';
+                else if (entity == "gt") out += '>';
+                else if (entity == "quot") out += '"';
+                else if (entity == "apos") out += '\'';
+                else if (entity.size() > 1 && entity[0] == '#')
+                {
+                    const bool hex = entity[1] == 'x' || entity[1] == 'X';
+                    const std::string digits(entity.substr(hex ? 2 : 1));
+                    char *end = nullptr;
+                    const unsigned long code_point = std::strtoul(digits.c_str(), &end, hex ? 16 : 10);
+                    if (!digits.empty() && end && *end == '\0')
+                    {
+                        append_utf8(out, code_point);
+                    }
+                }
+                else
+                {
+                    out.append(text.data() + amp, semi - amp + 1);
+                }
+                pos = semi + 1;
+            }
         }
-        else if (is_bold)
+
+        // Value of an attribute within a start tag's text, entities resolved
+        bool attribute_value(std::string_view tag, std::string_view name, std::string &value)
         {
-            text = "**" + text + "**";
+            size_t pos = 0;
+            while ((pos = tag.find(name, pos)) != std::string_view::npos)
+            {
+                const bool starts_name = pos > 0 && std::isspace(static_cast<unsigned char>(tag[pos - 1]));
+                size_t cursor = pos + name.size();
+                pos = cursor;
+                if (!starts_name)
+                {
+                    continue;
+                }
+                while (cursor < tag.size() && std::isspace(static_cast<unsigned char>(tag[cursor])))
+                    ++cursor;
+                if (cursor >= tag.size() || tag[cursor] != '=')
+                {
+                    continue;
+                }
+                ++cursor;
+                while (cursor < tag.size() && std::isspace(static_cast<unsigned char>(tag[cursor])))
+                    ++cursor;
+                if (cursor >= tag.size() || (tag[cursor] != '"' && tag[cursor] != '\''))
+                {
+                    continue;
+                }
+                const char quote = tag[cursor];
+                const size_t close = tag.find(quote, cursor + 1);
+                if (close == std::string_view::npos)
+                {
+                    return false;
+                }
+                value.clear();
+                append_decoded(value, tag.substr(cursor + 1, close - cursor - 1));
+                return true;
+            }
+            return false;
         }
-        else if (is_italic)
+
+        // Collapses whitespace runs to one space and trims both ends
+        std::string collapse_whitespace(const std::string &text)
         {
-            text = "*" + text + "*";
+            std::string result;
+            result.reserve(text.size());
+            bool pending_space = false;
+            for (char c : text)
+            {
+                if (std::isspace(static_cast<unsigned char>(c)))
+                {
+                    pending_space = !result.empty();
+                    continue;
+                }
+                if (pending_space)
+                {
+                    result += ' ';
+                    pending_space = false;
+                }
+                result += c;
+            }
+            return result;
         }
 
-        return text;
-    }
+        /**
+         * Incremental reader for WordprocessingML that turns word/document.xml into
+         * Markdown paragraphs as bytes arrive, holding only the paragraph being built
+         * and an unfinished tag or text node between feeds.
+         *
+         * Paragraphs (w:p) become one block each, headings come from a
+         * "HeadingN" w:pStyle, and runs (w:r) with w:b / w:i properties are
+         * wrapped in ** / * markers. Text comes from w:t, line breaks from w:br.
+         */
+        class DocumentXmlReader
+        {
+        public:
+            explicit DocumentXmlReader(ParagraphCallback on_paragraph)
+                : on_paragraph_(std::move(on_paragraph))
+            {
+            }
 
-    // Process paragraph
-    static std::string process_paragraph(const pugi::xml_node &para)
-    {
-        std::stringstream result;
-        bool is_heading = false;
-        int heading_level = 1;
+            void feed(const char *data, size_t size)
+            {
+                pending_.append(data, size);
+                size_t pos = 0;
+                while (pos < pending_.size())
+                {
+                    if (pending_[pos] != '<')
+                    {
+                        const size_t lt = pending_.find('<', pos);
+                        if (lt == std::string::npos)
+                        {
+                            break; // The text node may continue in the next chunk
+                        }
+                        characters(std::string_view(pending_).substr(pos, lt - pos));
+                        pos = lt;
+                        continue;
+                    }
+
+                    const size_t end = markupEnd(pos);
+                    if (end == std::string::npos)
+                    {
+                        break;
+                    }
+                    markup(std::string_view(pending_).substr(pos, end - pos));
+                    pos = end;
+                }
+                pending_.erase(0, pos);
+            }
 
-        // Check if paragraph is a heading
-        pugi::xml_node style = para.select_node(".//w:pStyle").node();
-        if (style)
-        {
-            std::string style_val = style.attribute("w:val").value();
-            if (style_val.find("Heading") != std::string::npos ||
-                style_val.find("heading") != std::string::npos)
+            void finish()
+            {
+                if (!seen_body_)
+                {
+                    throw std::runtime_error("Document body not found in XML");
+                }
+                while (!paragraphs_.empty())
+                {
+                    closeParagraph();
+                }
+            }
+
+            size_t paragraphCount() const { return paragraph_count_; }
+
+        private:
+            struct Run
             {
-                is_heading = true;
+                std::string text;
+                bool bold = false;
+                bool italic = false;
+            };
 
-                // Extract heading level
-                std::regex heading_regex(R"([Hh]eading\s*(\d+))");
-                std::smatch match;
-                if (std::regex_search(style_val, match, heading_regex))
+            struct Paragraph
+            {
+                std::string text;
+                std::string style;
+                bool has_style = false;
+                bool in_run = false;
+                int properties_depth = 0;   // Inside w:rPr of the current run
+                Run run;
+            };
+
+            // One past the end of the markup starting at pos, or npos when it is not complete yet
+            size_t markupEnd(size_t pos) const
+            {
+                std::string_view rest = std::string_view(pending_).substr(pos);
+                if (rest.size() < 2)
+                {
+                    return std::string::npos;
+                }
+                auto after = [&](std::string_view terminator) -> size_t {
+                    const size_t found = pending_.find(terminator.data(), pos, terminator.size());
+                    return found == std::string::npos ? found : found + terminator.size();
+                };
+                if (rest.substr(0, 4) == "<!--")
+                {
+                    return after("-->");
+                }
+                if (rest.substr(0, 9) == "<![CDATA[")
+                {
+                    return after("]]>");
+                }
+                if (rest[1] == '!' && rest.size() < 9)
                 {
-                    heading_level = std::stoi(match[1].str());
+                    return std::string::npos; // Could still be the start of a comment or CDATA section
                 }
+                if (rest[1] == '?' || rest[1] == '!')
+                {
+                    return after(">");
+                }
+
+                // Attribute values may legally contain '>'
+                char quote = 0;
+                for (size_t i = pos + 1; i < pending_.size(); ++i)
+                {
+                    const char c = pending_[i];
+                    if (quote)
+                    {
+                        if (c == quote) quote = 0;
+                    }
+                    else if (c == '"' || c == '\'')
+                    {
+                        quote = c;
+                    }
+                    else if (c == '>')
+                    {
+                        return i + 1;
+                    }
+                }
+                return std::string::npos;
             }
-        }        // Process all text runs in the paragraph
-        std::string text_content;
-        for (pugi::xpath_node xpath_node : para.select_nodes(".//w:r"))
-        {
-            pugi::xml_node run = xpath_node.node();
-            text_content += process_run(run);
-        }
 
-        // Clean up whitespace
-        text_content = std::regex_replace(text_content, std::regex(R"(\s+)"), " ");
-        text_content = std::regex_replace(text_content, std::regex(R"(^\s+|\s+$)"), "");
+            void characters(std::string_view data)
+            {
+                if (in_text_ && !paragraphs_.empty() && paragraphs_.back().in_run)
+                {
+                    append_decoded(paragraphs_.back().run.text, data);
+                }
+            }
 
-        if (text_content.empty())
-        {
-            return "";
-        }
+            void markup(std::string_view tag)
+            {
+                if (tag.substr(0, 9) == "<![CDATA[")
+                {
+                    if (in_text_ && !paragraphs_.empty() && paragraphs_.back().in_run)
+                    {
+                        paragraphs_.back().run.text.append(tag.substr(9, tag.size() - 12));
+                    }
+                    return;
+                }
+                if (tag[1] == '?' || tag[1] == '!')
+                {
+                    return;
+                }
 
-        // Format as heading or regular paragraph
-        if (is_heading && heading_level > 0 && heading_level <= 6)
-        {
-            result << std::string(heading_level, '#') << " " << text_content;
-        }
-        else
-        {
-            result << text_content;
-        }
+                if (tag[1] == '/')
+                {
+                    endElement(elementName(tag.substr(2)));
+                    return;
+                }
 
-        return result.str();
-    }
+                const bool self_closing = tag.size() >= 2 && tag[tag.size() - 2] == '/';
+                const std::string_view name = elementName(tag.substr(1));
+                startElement(name, tag);
+                if (self_closing)
+                {
+                    endElement(name);
+                }
+            }
 
-    // Convert XML content to Markdown
-    static std::string xml_to_markdown(const std::string &xml_content)
-    {
-        pugi::xml_document doc;
-        pugi::xml_parse_result result = doc.load_string(xml_content.c_str());
+            static std::string_view elementName(std::string_view tag)
+            {
+                size_t end = 0;
+                while (end < tag.size() && !std::isspace(static_cast<unsigned char>(tag[end])) &&
+                       tag[end] != '>' && tag[end] != '/')
+                {
+                    ++end;
+                }
+                return tag.substr(0, end);
+            }
 
-        if (!result)
-        {
-            throw std::runtime_error("Failed to parse XML: " + std::string(result.description()));
-        }
+            static bool enabled(std::string_view tag)
+            {
+                std::string value;
+                if (!attribute_value(tag, "w:val", value))
+                {
+                    return true;
+                }
+                return value != "0" && value != "false" && value != "off";
+            }
 
-        std::stringstream markdown;
+            void startElement(std::string_view name, std::string_view tag)
+            {
+                if (name == "w:body")
+                {
+                    seen_body_ = true;
+                    return;
+                }
+                if (name == "w:p")
+                {
+                    paragraphs_.emplace_back();
+                    return;
+                }
+                if (paragraphs_.empty())
+                {
+                    return;
+                }
 
-        // Find document body
-        pugi::xml_node body = doc.select_node("//w:body").node();
-        if (!body)
-        {
-            throw std::runtime_error("Document body not found in XML");
-        }        // Process all paragraphs
-        for (pugi::xpath_node xpath_node : body.select_nodes("//w:p"))
+                Paragraph &paragraph = paragraphs_.back();
+                if (name == "w:pStyle" && !paragraph.has_style)
+                {
+                    paragraph.has_style = attribute_value(tag, "w:val", paragraph.style);
+                }
+                else if (name == "w:r")
+                {
+                    paragraph.in_run = true;
+                    paragraph.properties_depth = 0;
+                    paragraph.run = Run();
+                }
+                else if (!paragraph.in_run)
+                {
+                    return;
+                }
+                else if (name == "w:rPr")
+                {
+                    ++paragraph.properties_depth;
+                }
+                else if (name == "w:b" && paragraph.properties_depth > 0)
+                {
+                    paragraph.run.bold = enabled(tag);
+                }
+                else if (name == "w:i" && paragraph.properties_depth > 0)
+                {
+                    paragraph.run.italic = enabled(tag);
+                }
+                else if (name == "w:t")
+                {
+                    in_text_ = true;
+                }
+                else if (name == "w:br")
+                {
+                    paragraph.run.text += '\n';
+                }
+            }
+
+            void endElement(std::string_view name)
+            {
+                if (name == "w:t")
+                {
+                    in_text_ = false;
+                    return;
+                }
+                if (name == "w:p")
+                {
+                    closeParagraph();
+                    return;
+                }
+                if (paragraphs_.empty())
+                {
+                    return;
+                }
+
+                Paragraph &paragraph = paragraphs_.back();
+                if (name == "w:rPr" && paragraph.properties_depth > 0)
+                {
+                    --paragraph.properties_depth;
+                }
+                else if (name == "w:r" && paragraph.in_run)
+                {
+                    closeRun(paragraph);
+                }
+            }
+
+            static void closeRun(Paragraph &paragraph)
+            {
+                Run &run = paragraph.run;
+                paragraph.in_run = false;
+                if (run.text.empty())
+                {
+                    return;
+                }
+
+                // Apply markdown formatting
+                const char *marker = run.bold && run.italic ? "***" : run.bold ? "**" : run.italic ? "*" : "";
+                paragraph.text += marker;
+                paragraph.text += run.text;
+                paragraph.text += marker;
+            }
+
+            void closeParagraph()
+            {
+                Paragraph paragraph = std::move(paragraphs_.back());
+                paragraphs_.pop_back();
+                in_text_ = false;
+                if (paragraph.in_run)
+                {
+                    closeRun(paragraph);
+                }
+
+                std::string text = collapse_whitespace(paragraph.text);
+                if (text.empty())
+                {
+                    return;
+                }
+
+                // Format as heading or regular paragraph
+                if (paragraph.has_style)
+                {
+                    const int level = headingLevel(paragraph.style);
+                    if (level > 0 && level <= 6)
+                    {
+                        text = std::string(level, '#') + " " + text;
+                    }
+                }
+
+                ++paragraph_count_;
+                if (on_paragraph_)
+                {
+                    on_paragraph_(text);
+                }
+            }
+
+            // Level of a "Heading N" style, 1 when it names no level, 0 when it is not a heading
+            static int headingLevel(const std::string &style)
+            {
+                size_t pos = style.find("Heading");
+                if (pos == std::string::npos)
+                {
+                    pos = style.find("heading");
+                }
+                if (pos == std::string::npos)
+                {
+                    return 0;
+                }
+                for (pos += 7; pos < style.size() && std::isspace(static_cast<unsigned char>(style[pos])); ++pos)
+                {
+                }
+                int level = 0;
+                bool has_digits = false;
+                for (; pos < style.size() && std::isdigit(static_cast<unsigned char>(style[pos])); ++pos)
+                {
+                    level = std::min(level * 10 + (style[pos] - '0'), 100);
+                    has_digits = true;
+                }
+                return has_digits ? level : 1;
+            }
+
+            ParagraphCallback on_paragraph_;
+            std::string pending_;
+            std::vector<Paragraph> paragraphs_;   // Text boxes nest paragraphs inside runs
+            bool in_text_ = false;
+            bool seen_body_ = false;
+            size_t paragraph_count_ = 0;
+        };
+
+        // Inflates word/document.xml chunk by chunk into the reader
+        void stream_document_xml(unzFile archive, DocumentXmlReader &reader)
         {
-            pugi::xml_node para = xpath_node.node();
-            std::string paragraph_text = process_paragraph(para);
-            if (!paragraph_text.empty())
+            // Find document.xml
+            if (unzLocateFile(archive, "word/document.xml", 0) != UNZ_OK)
             {
-                markdown << paragraph_text << "\n\n";
+                throw std::runtime_error("document.xml not found in DOCX file");
             }
+
+            if (unzOpenCurrentFile(archive) != UNZ_OK)
+            {
+                throw std::runtime_error("Failed to open document.xml");
+            }
+
+            std::vector<char> buffer(kInflateChunkBytes);
+            int bytes_read;
+            try
+            {
+                while ((bytes_read = unzReadCurrentFile(archive, buffer.data(), static_cast<unsigned>(buffer.size()))) > 0)
+                {
+                    reader.feed(buffer.data(), static_cast<size_t>(bytes_read));
+                }
+            }
+            catch (...)
+            {
+                unzCloseCurrentFile(archive);
+                throw;
+            }
+            unzCloseCurrentFile(archive);
+
+            if (bytes_read < 0)
+            {
+                throw std::runtime_error("Error reading document.xml");
+            }
+            reader.finish();
         }
 
-        return markdown.str();
-    }
+        std::string docx_to_markdown(unzFile archive, const ParagraphCallback &paragraph_cb)
+        {
+            std::string markdown;
+            DocumentXmlReader reader([&](const std::string &paragraph) {
+                markdown += paragraph;
+                markdown += "\n\n";
+                if (paragraph_cb)
+                {
+                    paragraph_cb(paragraph);
+                }
+            });
+            stream_document_xml(archive, reader);
+            return markdown;
+        }
+    } // namespace
 
     // Public method implementations
 
-    std::string DOCXParser::parse_docx(const std::string &file_path)
+    std::string DOCXParser::parse_docx(const std::string &file_path, ParagraphCallback paragraph_cb)
     {
-        return parse_docx_internal(file_path);
+        return parse_docx_internal(file_path, std::move(paragraph_cb));
     }
 
-    std::string DOCXParser::parse_docx_from_bytes(const unsigned char *data, size_t size)
+    std::string DOCXParser::parse_docx_from_bytes(const unsigned char *data, size_t size, ParagraphCallback paragraph_cb)
     {
-        return parse_docx_from_bytes_internal(data, size);
+        return parse_docx_from_bytes_internal(data, size, std::move(paragraph_cb));
     }
 
     std::future<std::string> DOCXParser::parse_docx_async(const std::string &file_path)
     {
-        return std::async(std::launch::async, [file_path]()
+        return kolosal::TaskExecutor::instance().submit([file_path]()
                           { return parse_docx_internal(file_path); });
     }
 
@@ -255,7 +690,7 @@ namespace retrieval
 
         for (const auto &file_path : file_paths)
         {
-            futures.push_back(std::async(std::launch::async, [file_path]()
+            futures.push_back(kolosal::TaskExecutor::instance().submit([file_path]()
                                          { return parse_docx_internal(file_path); }));
         }
 
@@ -267,30 +702,26 @@ namespace retrieval
         if (!file_exists(file_path) || !has_docx_extension(file_path))
         {
             return false;
-        }        try
-        {
-            std::lock_guard<std::mutex> lock(zip_mutex);
+        }
 
-            unzFile archive = unzOpen(file_path.c_str());
-            if (!archive)
+        try
+        {
+            ArchiveHandle handle(unzOpen64(file_path.c_str()));
+            if (!handle.archive)
             {
                 return false;
             }
 
             // Check for required DOCX structure
-            bool has_document_xml = unzLocateFile(archive, "word/document.xml", 0) == UNZ_OK;
-            bool has_content_types = unzLocateFile(archive, "[Content_Types].xml", 0) == UNZ_OK;
-            bool has_rels = unzLocateFile(archive, "_rels/.rels", 0) == UNZ_OK;
-
-            unzClose(archive);
-
-            return has_document_xml && has_content_types && has_rels;
+            return has_docx_parts(handle.archive);
         }
         catch (...)
         {
             return false;
         }
-    }    size_t DOCXParser::get_page_count(const std::string &file_path)
+    }
+
+    size_t DOCXParser::get_page_count(const std::string &file_path)
     {
         if (!file_exists(file_path) || !has_docx_extension(file_path))
         {
@@ -299,31 +730,8 @@ namespace retrieval
 
         try
         {
-            std::lock_guard<std::mutex> lock(zip_mutex);
-            
-            // Check if it's a valid DOCX (inline check to avoid double locking)
-            unzFile archive = unzOpen(file_path.c_str());
-            if (!archive)
-            {
-                return 0;
-            }
-
-            // Check for required DOCX structure
-            bool has_document_xml = unzLocateFile(archive, "word/document.xml", 0) == UNZ_OK;
-            bool has_content_types = unzLocateFile(archive, "[Content_Types].xml", 0) == UNZ_OK;
-            bool has_rels = unzLocateFile(archive, "_rels/.rels", 0) == UNZ_OK;
-
-            if (!has_document_xml || !has_content_types || !has_rels)
-            {
-                unzClose(archive);
-                return 0;
-            }
-
-            // Extract document.xml content inline to avoid double locking
-            std::string xml_content = extract_document_xml_from_file_internal(file_path);
-
-            pugi::xml_document doc;
-            if (!doc.load_string(xml_content.c_str()))
+            ArchiveHandle handle(unzOpen64(file_path.c_str()));
+            if (!handle.archive || !has_docx_parts(handle.archive))
             {
                 return 0;
             }
@@ -331,22 +739,11 @@ namespace retrieval
             // Count paragraphs as a rough estimate of pages
             // In a real implementation, you might want to parse document properties
             // or use more sophisticated page counting logic
-            pugi::xml_node body = doc.select_node("//w:body").node();
-            if (!body)
-            {
-                return 0;
-            }            size_t paragraph_count = 0;
-            for (pugi::xpath_node xpath_node : body.select_nodes("//w:p"))
-            {
-                pugi::xml_node para = xpath_node.node();
-                if (!process_paragraph(para).empty())
-                {
-                    paragraph_count++;
-                }
-            }
+            DocumentXmlReader reader(nullptr);
+            stream_document_xml(handle.archive, reader);
 
             // Rough estimate: assume 10-15 paragraphs per page
-            return std::max(static_cast<size_t>(1), (paragraph_count + 12) / 13);
+            return std::max(static_cast<size_t>(1), (reader.paragraphCount() + 12) / 13);
         }
         catch (...)
         {
@@ -356,7 +753,7 @@ namespace retrieval
 
     // Private method implementations
 
-    std::string DOCXParser::parse_docx_internal(const std::string &file_path)
+    std::string DOCXParser::parse_docx_internal(const std::string &file_path, ParagraphCallback paragraph_cb)
     {
         if (!file_exists(file_path))
         {
@@ -370,8 +767,12 @@ namespace retrieval
 
         try
         {
-            std::string xml_content = extract_document_xml_from_file(file_path);
-            return xml_to_markdown(xml_content);
+            ArchiveHandle handle(unzOpen64(file_path.c_str()));
+            if (!handle.archive)
+            {
+                throw std::runtime_error("Failed to open DOCX file: " + file_path);
+            }
+            return docx_to_markdown(handle.archive, paragraph_cb);
         }
         catch (const std::exception &e)
         {
@@ -379,7 +780,7 @@ namespace retrieval
         }
     }
 
-    std::string DOCXParser::parse_docx_from_bytes_internal(const unsigned char *data, size_t size)
+    std::string DOCXParser::parse_docx_from_bytes_internal(const unsigned char *data, size_t size, ParagraphCallback paragraph_cb)
     {
         if (!data || size == 0)
         {
@@ -388,8 +789,13 @@ namespace retrieval
 
         try
         {
-            std::string xml_content = extract_document_xml_from_memory(data, size);
-            return xml_to_markdown(xml_content);
+            MemoryArchive memory{data, size, 0};
+            ArchiveHandle handle(open_memory_archive(memory));
+            if (!handle.archive)
+            {
+                throw std::runtime_error("Failed to open DOCX archive");
+            }
+            return docx_to_markdown(handle.archive, paragraph_cb);
         }
         catch (const std::exception &e)
         {
@@ -422,4 +828,4 @@ namespace retrieval
         return extension == ".docx";
     }
 
-} // namespace retrieval
\ No newline at end of file
+} // namespace retrieval
@@ -1,14 +1,902 @@
 #include "kolosal/retrieval/parse_html.hpp"
-#include <regex>
+#include "kolosal/task_executor.hpp"
 #include <algorithm>
-#include <sstream>
-#include <map>
+#include <cstring>
 #include <future>
 #include <thread>
 #include <mutex>
 
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
 namespace retrieval
 {
+    namespace
+    {
+        constexpr size_t kMaxTagBytes = 64 * 1024;      // Beyond this an unclosed quote no longer hides '>'
+        constexpr size_t kMaxEntityBytes = 32;
+        constexpr size_t kCancelCheckBytes = 1024 * 1024;
+
+        struct NamedEntity
+        {
+            const char *name;
+            const char *value;
+        };
+
+        // Sorted by name for binary search
+        constexpr NamedEntity kEntities[] = {
+            {"amp", "&"}, {"apos", "'"}, {"bull", "\xE2\x80\xA2"}, {"cent", "\xC2\xA2"},
+            {"copy", "(c)"}, {"deg", "\xC2\xB0"}, {"euro", "\xE2\x82\xAC"}, {"gt", ">"},
+            {"hellip", "..."}, {"laquo", "\xC2\xAB"}, {"ldquo", "\""}, {"lsquo", "'"},
+            {"lt", "<"}, {"mdash", "-"}, {"middot", "\xC2\xB7"}, {"nbsp", " "},
+            {"ndash", "-"}, {"pound", "\xC2\xA3"}, {"quot", "\""}, {"raquo", "\xC2\xBB"},
+            {"rdquo", "\""}, {"reg", "(r)"}, {"rsquo", "'"}, {"sect", "\xC2\xA7"},
+            {"times", "\xC3\x97"}, {"trade", "(tm)"}, {"yen", "\xC2\xA5"},
+        };
+
+        // First '<' or '&' in [p, end), sixteen bytes at a time where the target allows
+        const char *findMarkup(const char *p, const char *end)
+        {
+#if defined(__SSE2__) || defined(_M_X64)
+            const __m128i lt = _mm_set1_epi8('<');
+            const __m128i amp = _mm_set1_epi8('&');
+            for (; p + 16 <= end; p += 16)
+            {
+                const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+                const int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(bytes, lt), _mm_cmpeq_epi8(bytes, amp)));
+                if (mask != 0)
+                {
+#if defined(_MSC_VER)
+                    unsigned long index;
+                    _BitScanForward(&index, static_cast<unsigned long>(mask));
+                    return p + index;
+#else
+                    return p + __builtin_ctz(static_cast<unsigned>(mask));
+#endif
+                }
+            }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+            const uint8x16_t lt = vdupq_n_u8('<');
+            const uint8x16_t amp = vdupq_n_u8('&');
+            for (; p + 16 <= end; p += 16)
+            {
+                const uint8x16_t bytes = vld1q_u8(reinterpret_cast<const uint8_t *>(p));
+                if (vmaxvq_u8(vorrq_u8(vceqq_u8(bytes, lt), vceqq_u8(bytes, amp))) != 0)
+                {
+                    break;
+                }
+            }
+#endif
+            for (; p < end; ++p)
+            {
+                if (*p == '<' || *p == '&')
+                {
+                    return p;
+                }
+            }
+            return end;
+        }
+
+        bool isSpace(char c)
+        {
+            return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f';
+        }
+
+        bool isAlpha(char c)
+        {
+            return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+        }
+
+        bool isAlnum(char c)
+        {
+            return isAlpha(c) || (c >= '0' && c <= '9');
+        }
+
+        char toLower(char c)
+        {
+            return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+        }
+
+        bool iequals(const char *data, std::string_view lower)
+        {
+            for (size_t i = 0; i < lower.size(); ++i)
+            {
+                if (toLower(data[i]) != lower[i])
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        template <size_t N>
+        bool isOneOf(std::string_view name, const std::string_view (&names)[N])
+        {
+            return std::find(std::begin(names), std::end(names), name) != std::end(names);
+        }
+
+        constexpr std::string_view kVoidElements[] = {"area", "base", "br", "col", "embed", "hr", "img", "input",
+                                                      "link", "meta", "param", "source", "track", "wbr"};
+
+        // Content is not markup and never part of the text
+        constexpr std::string_view kRawTextElements[] = {"script", "style", "noscript", "textarea", "title",
+                                                         "xmp", "iframe", "noembed", "noframes"};
+
+        // Markup whose text is not document content
+        constexpr std::string_view kDroppedElements[] = {"head", "template", "svg", "math", "select", "button",
+                                                         "canvas", "object", "audio", "video", "map"};
+
+        constexpr std::string_view kBoilerplateElements[] = {"nav", "aside", "footer", "form", "dialog"};
+
+        constexpr std::string_view kBlockElements[] = {"div", "section", "article", "main", "figure", "figcaption",
+                                                       "dl", "dt", "dd", "address", "details", "summary", "fieldset",
+                                                       "center", "caption", "body", "header"};
+
+        void appendUtf8(std::string &out, uint32_t code)
+        {
+            if (code < 0x80)
+            {
+                out += static_cast<char>(code);
+            }
+            else if (code < 0x800)
+            {
+                out += static_cast<char>(0xC0 | (code >> 6));
+                out += static_cast<char>(0x80 | (code & 0x3F));
+            }
+            else if (code < 0x10000)
+            {
+                out += static_cast<char>(0xE0 | (code >> 12));
+                out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+                out += static_cast<char>(0x80 | (code & 0x3F));
+            }
+            else
+            {
+                out += static_cast<char>(0xF0 | (code >> 18));
+                out += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+                out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+                out += static_cast<char>(0x80 | (code & 0x3F));
+            }
+        }
+
+        // Decode the entity between '&' and ';'; false leaves it to be kept literally
+        bool decodeEntity(std::string_view body, std::string &out)
+        {
+            if (body.size() > 1 && body[0] == '#')
+            {
+                const bool hex = body[1] == 'x' || body[1] == 'X';
+                const size_t first = hex ? 2 : 1;
+                if (first >= body.size() || body.size() - first > 8)
+                {
+                    return false;
+                }
+                uint32_t code = 0;
+                for (size_t i = first; i < body.size(); ++i)
+                {
+                    const char c = toLower(body[i]);
+                    uint32_t digit;
+                    if (c >= '0' && c <= '9')
+                        digit = static_cast<uint32_t>(c - '0');
+                    else if (hex && c >= 'a' && c <= 'f')
+                        digit = static_cast<uint32_t>(c - 'a' + 10);
+                    else
+                        return false;
+                    code = code * (hex ? 16 : 10) + digit;
+                }
+                if (code == 0 || code > 0x10FFFF || (code >= 0xD800 && code <= 0xDFFF))
+                {
+                    code = 0xFFFD;
+                }
+                appendUtf8(out, code == 0xA0 ? ' ' : code);
+                return true;
+            }
+
+            auto it = std::lower_bound(std::begin(kEntities), std::end(kEntities), body,
+                                       [](const NamedEntity &entity, std::string_view name) { return name.compare(entity.name) > 0; });
+            if (it == std::end(kEntities) || body != it->name)
+            {
+                return false;
+            }
+            out += it->value;
+            return true;
+        }
+
+        std::string decodeEntities(std::string_view value)
+        {
+            std::string out;
+            out.reserve(value.size());
+            for (size_t i = 0; i < value.size(); ++i)
+            {
+                if (value[i] == '&')
+                {
+                    const size_t semicolon = value.find(';', i + 1);
+                    if (semicolon != std::string_view::npos && semicolon - i <= kMaxEntityBytes &&
+                        decodeEntity(value.substr(i + 1, semicolon - i - 1), out))
+                    {
+                        i = semicolon;
+                        continue;
+                    }
+                }
+                out += value[i];
+            }
+            return out;
+        }
+
+        // Value of a named attribute in the text between the tag name and '>', entity-decoded
+        std::string attributeValue(std::string_view attributes, std::string_view wanted)
+        {
+            size_t i = 0;
+            while (i < attributes.size())
+            {
+                while (i < attributes.size() && (isSpace(attributes[i]) || attributes[i] == '/'))
+                    ++i;
+                const size_t name_start = i;
+                while (i < attributes.size() && !isSpace(attributes[i]) && attributes[i] != '=' && attributes[i] != '/')
+                    ++i;
+                const std::string_view name = attributes.substr(name_start, i - name_start);
+                while (i < attributes.size() && isSpace(attributes[i]))
+                    ++i;
+
+                std::string_view value;
+                if (i < attributes.size() && attributes[i] == '=')
+                {
+                    ++i;
+                    while (i < attributes.size() && isSpace(attributes[i]))
+                        ++i;
+                    if (i < attributes.size() && (attributes[i] == '"' || attributes[i] == '\''))
+                    {
+                        const char quote = attributes[i++];
+                        const size_t end = std::min(attributes.find(quote, i), attributes.size());
+                        value = attributes.substr(i, end - i);
+                        i = end + 1;
+                    }
+                    else
+                    {
+                        const size_t start = i;
+                        while (i < attributes.size() && !isSpace(attributes[i]))
+                            ++i;
+                        value = attributes.substr(start, i - start);
+                    }
+                }
+
+                if (name.size() == wanted.size() && iequals(name.data(), wanted))
+                {
+                    return decodeEntities(value);
+                }
+                if (name.empty())
+                {
+                    ++i;
+                }
+            }
+            return std::string();
+        }
+    }
+
+    HtmlTextExtractor::HtmlTextExtractor(HtmlExtractOptions options, HtmlTextCallback on_text)
+        : options_(options), on_text_(std::move(on_text))
+    {
+    }
+
+    HtmlTextExtractor::~HtmlTextExtractor() = default;
+
+    void HtmlTextExtractor::feed(const char *data, size_t size)
+    {
+        if (pending_.empty())
+        {
+            const size_t used = consume(data, size, false);
+            pending_.assign(data + used, size - used);
+        }
+        else
+        {
+            pending_.append(data, size);
+            const size_t used = consume(pending_.data(), pending_.size(), false);
+            pending_.erase(0, used);
+        }
+        flush();
+    }
+
+    std::string HtmlTextExtractor::finish()
+    {
+        consume(pending_.data(), pending_.size(), true);
+        pending_.clear();
+        flush();
+        return std::move(out_);
+    }
+
+    size_t HtmlTextExtractor::curlWrite(char *data, size_t size, size_t nmemb, void *extractor)
+    {
+        static_cast<HtmlTextExtractor *>(extractor)->feed(data, size * nmemb);
+        return size * nmemb;
+    }
+
+    // Returns how much of the input was consumed; the rest is an incomplete construct kept for the next piece
+    size_t HtmlTextExtractor::consume(const char *data, size_t size, bool final)
+    {
+        size_t i = 0;
+        while (i < size)
+        {
+            if (in_comment_)
+            {
+                const char *end = std::search(data + i, data + size, "-->", "-->" + 3);
+                if (end == data + size)
+                {
+                    // Keep what could be the start of "-->"
+                    return final ? size : std::max(i, size - std::min<size_t>(size, 2));
+                }
+                in_comment_ = false;
+                i = static_cast<size_t>(end - data) + 3;
+                continue;
+            }
+
+            if (!raw_tag_.empty())
+            {
+                const char *lt = static_cast<const char *>(std::memchr(data + i, '<', size - i));
+                if (!lt)
+                {
+                    return size;
+                }
+                const size_t at = static_cast<size_t>(lt - data);
+                if (size - at < raw_tag_.size() + 3)
+                {
+                    return final ? size : at;
+                }
+                const char after = data[at + 2 + raw_tag_.size()];
+                if (data[at + 1] == '/' && iequals(data + at + 2, raw_tag_) && (after == '>' || after == '/' || isSpace(after)))
+                {
+                    // The end tag itself is handled as markup below
+                    raw_tag_.clear();
+                    i = at;
+                }
+                else
+                {
+                    i = at + 1;
+                }
+                continue;
+            }
+
+            const char *special = findMarkup(data + i, data + size);
+            const size_t at = static_cast<size_t>(special - data);
+            if (at > i)
+            {
+                text(data + i, at - i);
+                i = at;
+            }
+            if (i == size)
+            {
+                break;
+            }
+
+            const size_t used = data[i] == '<' ? consumeTag(data + i, size - i, final)
+                                               : consumeEntity(data + i, size - i, final);
+            if (used == 0)
+            {
+                return i;
+            }
+            i += used;
+        }
+        return size;
+    }
+
+    size_t HtmlTextExtractor::consumeTag(const char *data, size_t size, bool final)
+    {
+        if (size < 4 && !final && std::memcmp(data, "<!--", size) == 0)
+        {
+            return 0;
+        }
+        if (size >= 4 && std::memcmp(data, "<!--", 4) == 0)
+        {
+            in_comment_ = true;
+            return 4;
+        }
+        if (size < 2)
+        {
+            if (final)
+            {
+                text(data, 1);
+                return 1;
+            }
+            return 0;
+        }
+
+        const char kind = data[1];
+        if (kind == '!' || kind == '?' || kind == '/')
+        {
+            const char *close = static_cast<const char *>(std::memchr(data, '>', size));
+            if (!close)
+            {
+                return final ? size : 0;
+            }
+            if (kind == '/')
+            {
+                std::string name;
+                for (const char *p = data + 2; p < close && (isAlnum(*p) || *p == '-' || *p == ':'); ++p)
+                {
+                    name += toLower(*p);
+                }
+                endTag(name);
+            }
+            return static_cast<size_t>(close - data) + 1;
+        }
+
+        if (!isAlpha(kind))
+        {
+            text(data, 1);
+            return 1;
+        }
+
+        // Find the closing '>', which may appear inside quoted attribute values
+        size_t end = 0;
+        char quote = 0;
+        char previous = 0;      // Last non-space character outside quotes
+        for (size_t i = 1; i < size; ++i)
+        {
+            const char c = data[i];
+            if (quote)
+            {
+                if (c == quote)
+                {
+                    quote = 0;
+                    previous = c;
+                }
+            }
+            else if ((c == '"' || c == '\'') && previous == '=')
+            {
+                quote = c;
+            }
+            else if (c == '>')
+            {
+                end = i;
+                break;
+            }
+            else if (!isSpace(c))
+            {
+                previous = c;
+            }
+        }
+        if (end == 0)
+        {
+            if (!final && size < kMaxTagBytes)
+            {
+                return 0;
+            }
+            const char *close = static_cast<const char *>(std::memchr(data, '>', size));
+            if (!close)
+            {
+                if (!final)
+                {
+                    return 0;
+                }
+                text(data, 1);
+                return 1;
+            }
+            end = static_cast<size_t>(close - data);
+        }
+
+        std::string name;
+        size_t i = 1;
+        for (; i < end && (isAlnum(data[i]) || data[i] == '-' || data[i] == ':'); ++i)
+        {
+            name += toLower(data[i]);
+        }
+        const bool self_closing = data[end - 1] == '/';
+        startTag(name, std::string_view(data + i, end - i), self_closing);
+        return end + 1;
+    }
+
+    size_t HtmlTextExtractor::consumeEntity(const char *data, size_t size, bool final)
+    {
+        size_t i = 1;
+        while (i < size && i <= kMaxEntityBytes && (isAlnum(data[i]) || data[i] == '#'))
+        {
+            ++i;
+        }
+        if (i == size && i <= kMaxEntityBytes && !final)
+        {
+            return 0;
+        }
+
+        if (i < size && data[i] == ';')
+        {
+            std::string decoded;
+            if (decodeEntity(std::string_view(data + 1, i - 1), decoded))
+            {
+                text(decoded.data(), decoded.size());
+                return i + 1;
+            }
+        }
+        text(data, 1);
+        return 1;
+    }
+
+    void HtmlTextExtractor::startTag(std::string_view name, std::string_view attributes, bool self_closing)
+    {
+        ++elements_;
+        const bool is_void = self_closing || isOneOf(name, kVoidElements);
+
+        if (isOneOf(name, kRawTextElements))
+        {
+            if (!is_void)
+            {
+                raw_tag_ = std::string(name);
+            }
+            return;
+        }
+
+        if (skip_depth_ > 0)
+        {
+            if (skip_tag_ == "head" && name == "body")
+            {
+                skip_depth_ = 0;    // <head> left unclosed
+            }
+            else
+            {
+                if (name == skip_tag_ && !is_void)
+                {
+                    ++skip_depth_;
+                }
+                return;
+            }
+        }
+
+        const bool boilerplate = options_.skip_boilerplate &&
+                                 (isOneOf(name, kBoilerplateElements) || (name == "header" && content_depth_ == 0));
+        if (boilerplate || isOneOf(name, kDroppedElements))
+        {
+            if (!is_void)
+            {
+                skip_tag_ = std::string(name);
+                skip_depth_ = 1;
+            }
+            return;
+        }
+
+        if (name.size() == 2 && name[0] == 'h' && name[1] >= '1' && name[1] <= '6')
+        {
+            breakLine(2);
+            open(std::string(static_cast<size_t>(name[1] - '0'), '#') + " ");
+        }
+        else if (name == "p")
+        {
+            breakLine(2);
+        }
+        else if (name == "br")
+        {
+            if (pre_depth_ > 0)
+                text("\n", 1);
+            else
+                breakLine(1);
+        }
+        else if (name == "hr")
+        {
+            breakLine(2);
+            open("---");
+            breakLine(2);
+        }
+        else if (name == "strong" || name == "b")
+        {
+            open("**");
+        }
+        else if (name == "em" || name == "i")
+        {
+            open("*");
+        }
+        else if (name == "u")
+        {
+            open("_");
+        }
+        else if (name == "s" || name == "strike" || name == "del")
+        {
+            open("~~");
+        }
+        else if (name == "code")
+        {
+            if (pre_depth_ == 0)
+                open("`");
+        }
+        else if (name == "pre")
+        {
+            breakLine(2);
+            if (pre_depth_++ == 0)
+            {
+                open("```");
+                breakLine(1);
+                pre_fresh_ = true;
+            }
+        }
+        else if (name == "blockquote")
+        {
+            breakLine(2);
+            if (options_.markdown)
+                ++quote_depth_;
+        }
+        else if (name == "a")
+        {
+            std::string href = options_.markdown ? attributeValue(attributes, "href") : std::string();
+            if (!href.empty())
+                open("[");
+            links_.push_back(std::move(href));
+        }
+        else if (name == "img")
+        {
+            const std::string src = attributeValue(attributes, "src");
+            const std::string alt = attributeValue(attributes, "alt");
+            if (options_.markdown && !src.empty())
+            {
+                open("![");
+                text(alt.data(), alt.size());
+                close("](" + src + ")");
+            }
+            else
+            {
+                text(alt.data(), alt.size());
+            }
+        }
+        else if (name == "ul" || name == "ol")
+        {
+            breakLine(lists_.empty() ? 2 : 1);
+            lists_.push_back(ListState{name == "ol", 1});
+        }
+        else if (name == "li")
+        {
+            breakLine(1);
+            if (!lists_.empty())
+            {
+                ListState &list = lists_.back();
+                const std::string indent((lists_.size() - 1) * 2, ' ');
+                open(list.ordered ? indent + std::to_string(list.next++) + ". " : indent + "- ");
+            }
+            else
+            {
+                open("- ");
+            }
+        }
+        else if (name == "table")
+        {
+            breakLine(2);
+        }
+        else if (name == "tr")
+        {
+            breakLine(1);
+        }
+        else if (name == "td" || name == "th")
+        {
+            open("| ");
+        }
+        else if (isOneOf(name, kBlockElements))
+        {
+            if (name == "article" || name == "main")
+                ++content_depth_;
+            breakLine(1);
+        }
+    }
+
+    void HtmlTextExtractor::endTag(std::string_view name)
+    {
+        if (skip_depth_ > 0)
+        {
+            if (name == skip_tag_ && --skip_depth_ == 0)
+            {
+                skip_tag_.clear();
+            }
+            else if (name == "body" || name == "html")
+            {
+                skip_depth_ = 0;    // An unclosed boilerplate block ends with the document
+                skip_tag_.clear();
+            }
+            return;
+        }
+
+        if (name.size() == 2 && name[0] == 'h' && name[1] >= '1' && name[1] <= '6')
+        {
+            breakLine(2);
+        }
+        else if (name == "p" || name == "table")
+        {
+            breakLine(2);
+        }
+        else if (name == "strong" || name == "b")
+        {
+            close("**");
+        }
+        else if (name == "em" || name == "i")
+        {
+            close("*");
+        }
+        else if (name == "u")
+        {
+            close("_");
+        }
+        else if (name == "s" || name == "strike" || name == "del")
+        {
+            close("~~");
+        }
+        else if (name == "code")
+        {
+            if (pre_depth_ == 0)
+                close("`");
+        }
+        else if (name == "pre")
+        {
+            if (pre_depth_ > 0 && --pre_depth_ == 0)
+            {
+                pre_fresh_ = false;
+                breakLine(1);
+                open("```");
+            }
+            breakLine(2);
+        }
+        else if (name == "blockquote")
+        {
+            breakLine(2);
+            if (quote_depth_ > 0)
+                --quote_depth_;
+        }
+        else if (name == "a")
+        {
+            if (!links_.empty())
+            {
+                if (!links_.back().empty())
+                    close("](" + links_.back() + ")");
+                links_.pop_back();
+            }
+        }
+        else if (name == "ul" || name == "ol")
+        {
+            if (!lists_.empty())
+                lists_.pop_back();
+            breakLine(lists_.empty() ? 2 : 1);
+        }
+        else if (name == "li")
+        {
+            breakLine(1);
+        }
+        else if (name == "td" || name == "th")
+        {
+            if (emitting())
+                pending_space_ = true;
+        }
+        else if (name == "tr")
+        {
+            open("|");
+            breakLine(1);
+        }
+        else if (isOneOf(name, kBlockElements))
+        {
+            if ((name == "article" || name == "main") && content_depth_ > 0)
+                --content_depth_;
+            breakLine(1);
+        }
+    }
+
+    // Separators owed to the output (newlines, or a collapsed space) are written only once
+    // more content follows, so nothing is ever trailing and nothing has to be trimmed
+    void HtmlTextExtractor::writePrefix()
+    {
+        if (pending_newlines_ > 0)
+        {
+            if (written_)
+            {
+                // Blank lines stay inside a quote only when both neighbours are quoted
+                const int count = pre_depth_ > 0 ? pending_newlines_ : std::min(pending_newlines_, 2);
+                const int blank_depth = std::min(quote_depth_, line_quote_depth_);
+                for (int n = 0; n < count; ++n)
+                {
+                    if (n > 0 && blank_depth > 0)
+                        out_.append(static_cast<size_t>(blank_depth), '>');
+                    out_ += '\n';
+                }
+            }
+            if (quote_depth_ > 0)
+            {
+                out_.append(static_cast<size_t>(quote_depth_), '>');
+                out_ += ' ';
+            }
+            line_quote_depth_ = quote_depth_;
+            pending_newlines_ = 0;
+        }
+        else if (pending_space_)
+        {
+            out_ += ' ';
+        }
+        pending_space_ = false;
+        written_ = true;
+    }
+
+    void HtmlTextExtractor::text(const char *data, size_t size)
+    {
+        if (!emitting())
+        {
+            return;
+        }
+
+        const char *end = data + size;
+        if (pre_depth_ > 0)
+        {
+            for (const char *p = data; p < end; ++p)
+            {
+                if (*p == '\r')
+                    continue;
+                if (*p == '\n')
+                {
+                    if (!pre_fresh_)
+                        ++pending_newlines_;
+                    pre_fresh_ = false;
+                    continue;
+                }
+                pre_fresh_ = false;
+                writePrefix();
+                out_ += *p;
+            }
+            at_start_ = false;
+            return;
+        }
+
+        const char *p = data;
+        while (p < end)
+        {
+            if (isSpace(*p))
+            {
+                if (!at_start_)
+                    pending_space_ = true;
+                ++p;
+                continue;
+            }
+            const char *word = p;
+            while (p < end && !isSpace(*p))
+                ++p;
+            writePrefix();
+            out_.append(word, static_cast<size_t>(p - word));
+            at_start_ = false;
+        }
+    }
+
+    void HtmlTextExtractor::open(std::string_view markup)
+    {
+        if (!emitting() || !options_.markdown)
+        {
+            return;
+        }
+        writePrefix();
+        out_.append(markup.data(), markup.size());
+        at_start_ = true;
+    }
+
+    void HtmlTextExtractor::close(std::string_view markup)
+    {
+        if (!emitting() || !options_.markdown)
+        {
+            return;
+        }
+        out_.append(markup.data(), markup.size());
+        written_ = true;
+        at_start_ = false;
+    }
+
+    void HtmlTextExtractor::breakLine(int count)
+    {
+        if (!emitting())
+        {
+            return;
+        }
+        pending_newlines_ = std::max(pending_newlines_, count);
+        pending_space_ = false;
+        at_start_ = true;
+    }
+
+    void HtmlTextExtractor::flush()
+    {
+        if (on_text_ && !out_.empty())
+        {
+            on_text_(out_);
+            out_.clear();
+        }
+    }
+
     HtmlParser::HtmlParser() 
         : is_busy_(std::make_unique<std::atomic<bool>>(false))
         , should_cancel_(std::make_unique<std::atomic<bool>>(false))
@@ -21,7 +909,7 @@ namespace retrieval
         const std::string& html_content,
         HtmlProgressCallback progress_callback)
     {
-        return std::async(std::launch::async, [this, html_content, progress_callback]() {
+        return kolosal::TaskExecutor::instance().submit([this, html_content, progress_callback]() {
             return parseHtmlSync(html_content);
         });
     }
@@ -40,11 +928,21 @@ namespace retrieval
                 return HtmlParseResult("", false, "Empty HTML content provided", 0);
             }
 
-            std::string markdown = convertHtmlToMarkdown(html_content);
-            markdown = cleanupMarkdown(markdown);
+            // Fed in slices only so that cancel() takes effect on large pages
+            HtmlTextExtractor extractor;
+            for (size_t offset = 0; offset < html_content.size(); offset += kCancelCheckBytes)
+            {
+                if (*should_cancel_)
+                {
+                    *is_busy_ = false;
+                    return HtmlParseResult("", false, "HTML parsing cancelled", extractor.elementsProcessed());
+                }
+                extractor.feed(html_content.data() + offset, std::min(kCancelCheckBytes, html_content.size() - offset));
+            }
+            std::string markdown = extractor.finish();
 
             *is_busy_ = false;
-            return HtmlParseResult(markdown, true, "", 1);
+            return HtmlParseResult(markdown, true, "", extractor.elementsProcessed());
         }
         catch (const std::exception& e)
         {
@@ -63,241 +961,4 @@ namespace retrieval
         *should_cancel_ = true;
     }
 
-    std::string HtmlParser::decodeHtmlEntities(const std::string& html)
-    {
-        std::string result = html;
-        
-        // Common HTML entities
-        std::map<std::string, std::string> entities = {
-            {"&amp;", "&"},
-            {"&lt;", "<"},
-            {"&gt;", ">"},
-            {"&quot;", "\""},
-            {"&apos;", "'"},
-            {"&nbsp;", " "},
-            {"&hellip;", "..."},
-            {"&mdash;", "-"},
-            {"&ndash;", "-"},
-            {"&lsquo;", "'"},
-            {"&rsquo;", "'"},
-            {"&ldquo;", "\""},
-            {"&rdquo;", "\""},
-            {"&copy;", "(c)"},
-            {"&reg;", "(r)"},
-            {"&trade;", "(tm)"}
-        };
-
-        for (const auto& entity : entities)
-        {
-            size_t pos = 0;
-            while ((pos = result.find(entity.first, pos)) != std::string::npos)
-            {
-                result.replace(pos, entity.first.length(), entity.second);
-                pos += entity.second.length();
-            }
-        }
-
-        // Decode numeric entities (&#123; and &#x1A;) - use simpler approach
-        std::regex numeric_entity_regex("&#(\\d+);");
-        std::sregex_iterator iter(result.begin(), result.end(), numeric_entity_regex);
-        std::sregex_iterator end;
-        
-        std::string decoded_result;
-        size_t last_pos = 0;
-        
-        for (std::sregex_iterator i = iter; i != end; ++i) {
-            std::smatch match = *i;
-            decoded_result += result.substr(last_pos, match.position() - last_pos);
-            
-            int code = std::stoi(match[1].str());
-            if (code < 128) {
-                decoded_result += static_cast<char>(code);
-            } else {
-                decoded_result += match.str(); // Keep as is if not ASCII
-            }
-            
-            last_pos = match.position() + match.length();
-        }
-        
-        decoded_result += result.substr(last_pos);
-        result = decoded_result;
-
-        return result;
-    }
-
-    std::string HtmlParser::convertHtmlToMarkdown(const std::string& html)
-    {
-        std::string markdown = html;
-        
-        // Remove HTML comments
-        std::regex comment_regex(R"(<!--.*?-->)", std::regex_constants::ECMAScript);
-        markdown = std::regex_replace(markdown, comment_regex, "");
-        
-        // Remove script and style tags completely
-        std::regex script_regex(R"(<script[^>]*>.*?</script>)", std::regex_constants::ECMAScript | std::regex_constants::icase);
-        markdown = std::regex_replace(markdown, script_regex, "");
-        
-        std::regex style_regex(R"(<style[^>]*>.*?</style>)", std::regex_constants::ECMAScript | std::regex_constants::icase);
-        markdown = std::regex_replace(markdown, style_regex, "");
-        
-        // Convert headings (h1-h6)
-        std::regex h1_regex(R"(<h1[^>]*>(.*?)</h1>)", std::regex_constants::ECMAScript | std::regex_constants::icase);
-        markdown = std::regex_replace(markdown, h1_regex, "# $1\n\n");
-        
-        std::regex h2_regex(R"(<h2[^>]*>(.*?)</h2>)", std::regex_constants::ECMAScript | std::regex_constants::icase);
-        markdown = std::regex_replace(markdown, h2_regex, "## $1\n\n");
-        
-        std::regex h3_regex(R"(<h3[^>]*>(.*?)</h3>)", std::regex_constants::ECMAScript | std::regex_constants::icase);
-        markdown = std::regex_replace(markdown, h3_regex, "### $1\n\n");
-        
-        std::regex h4_regex(R"(<h4[^>]*>(.*?)</h4>)", std::regex_constants::ECMAScript | std::regex_constants::icase);
-        markdown = std::regex_replace(markdown, h4_regex, "#### $1\n\n");
-        
-        std::regex h5_regex(R"(<h5[^>]*>(.*?)</h5>)", std::regex_constants::ECMAScript | std::regex_constants::icase);
-        markdown = std::regex_replace(markdown, h5_regex, "##### $1\n\n");
-        
-        std::regex h6_regex(R"(<h6[^>]*>(.*?)</h6>)", std::regex_constants::ECMAScript | std::regex_constants::icase);
-        markdown = std::regex_replace(markdown, h6_regex, "###### $1\n\n");
-        
-        // Convert bold text (strong, b)
-        std::regex strong_regex(R"(<(strong|b)[^>]*>(.*?)</\1>)", std::regex_constants::ECMAScript | std::regex_constants::icase);
-        markdown = std::regex_replace(markdown, strong_regex, "**$2**");
-        
-        // Convert italic text (em, i)
-        std::regex em_regex(R"(<(em|i)[^>]*>(.*?)</\1>)", std::regex_constants::ECMAScript | std::regex_constants::icase);
-        markdown = std::regex_replace(markdown, em_regex, "*$2*");
-        
-        // Convert underline to emphasis (since Markdown doesn't have underline)
-        std::regex u_regex(R"(<u[^>]*>(.*?)</u>)", std::regex_constants::ECMAScript | std::regex_constants::icase);
-        markdown = std::regex_replace(markdown, u_regex, "_$1_");
-        
-        // Convert strikethrough
-        std::regex strike_regex(R"(<(s|strike|del)[^>]*>(.*?)</\1>)", std::regex_constants::ECMAScript | std::regex_constants::icase);
-        markdown = std::regex_replace(markdown, strike_regex, "~~$2~~");
-        
-        // Convert inline code
-        std::regex code_regex(R"(<code[^>]*>(.*?)</code>)", std::regex_constants::ECMAScript | std::regex_constants::icase);
-        markdown = std::regex_replace(markdown, code_regex, "`$1`");
-        
-        // Convert code blocks (pre with code)
-        std::regex pre_code_regex(R"(<pre[^>]*>\s*<code[^>]*>(.*?)</code>\s*</pre>)", std::regex_constants::ECMAScript | std::regex_constants::icase);
-        markdown = std::regex_replace(markdown, pre_code_regex, "\n```\n$1\n```\n\n");
-        
-        // Convert simple pre blocks
-        std::regex pre_regex(R"(<pre[^>]*>(.*?)</pre>)", std::regex_constants::ECMAScript | std::regex_constants::icase);
-        markdown = std::regex_replace(markdown, pre_regex, "\n```\n$1\n```\n\n");
-        
-        // Convert links
-        std::regex link_regex(R"(<a[^>]*href\s*=\s*[\"']([^\"']*)[\"'][^>]*>(.*?)</a>)", std::regex_constants::ECMAScript | std::regex_constants::icase);
-        markdown = std::regex_replace(markdown, link_regex, "[$2]($1)");
-        
-        // Convert images
-        std::regex img_regex(R"(<img[^>]*src\s*=\s*[\"']([^\"']*)[\"'][^>]*alt\s*=\s*[\"']([^\"']*)[\"'][^>]*\/?>)", std::regex_constants::ECMAScript | std::regex_constants::icase);
-        markdown = std::regex_replace(markdown, img_regex, "![$2]($1)");
-        
-        std::regex img_regex2(R"(<img[^>]*alt\s*=\s*[\"']([^\"']*)[\"'][^>]*src\s*=\s*[\"']([^\"']*)[\"'][^>]*\/?>)", std::regex_constants::ECMAScript | std::regex_constants::icase);
-        markdown = std::regex_replace(markdown, img_regex2, "![$1]($2)");
-        
-        // Convert simple img tags without alt
-        std::regex img_simple_regex(R"(<img[^>]*src\s*=\s*[\"']([^\"']*)[\"'][^>]*\/?>)", std::regex_constants::ECMAScript | std::regex_constants::icase);
-        markdown = std::regex_replace(markdown, img_simple_regex, "![]($1)");
-        
-        // Convert blockquotes
-        std::regex blockquote_regex(R"(<blockquote[^>]*>(.*?)</blockquote>)", std::regex_constants::ECMAScript | std::regex_constants::icase);
-        markdown = std::regex_replace(markdown, blockquote_regex, "\n> $1\n\n");
-        
-        // Convert horizontal rules
-        std::regex hr_regex(R"(<hr[^>]*\/?>)", std::regex_constants::ECMAScript | std::regex_constants::icase);
-        markdown = std::regex_replace(markdown, hr_regex, "\n---\n\n");
-        
-        // Convert line breaks
-        std::regex br_regex(R"(<br[^>]*\/?>)", std::regex_constants::ECMAScript | std::regex_constants::icase);
-        markdown = std::regex_replace(markdown, br_regex, "  \n");
-        
-        // Convert unordered lists
-        std::regex ul_start_regex(R"(<ul[^>]*>)", std::regex_constants::ECMAScript | std::regex_constants::icase);
-        markdown = std::regex_replace(markdown, ul_start_regex, "\n");
-        
-        std::regex ul_end_regex(R"(</ul>)", std::regex_constants::ECMAScript | std::regex_constants::icase);
-        markdown = std::regex_replace(markdown, ul_end_regex, "\n");
-        
-        // Convert ordered lists
-        std::regex ol_start_regex(R"(<ol[^>]*>)", std::regex_constants::ECMAScript | std::regex_constants::icase);
-        markdown = std::regex_replace(markdown, ol_start_regex, "\n");
-        
-        std::regex ol_end_regex(R"(</ol>)", std::regex_constants::ECMAScript | std::regex_constants::icase);
-        markdown = std::regex_replace(markdown, ol_end_regex, "\n");
-        
-        // Convert list items (this is a simplified approach)
-        std::regex li_regex(R"(<li[^>]*>(.*?)</li>)", std::regex_constants::ECMAScript | std::regex_constants::icase);
-        markdown = std::regex_replace(markdown, li_regex, "- $1\n");
-        
-        // Convert paragraphs
-        std::regex p_regex(R"(<p[^>]*>(.*?)</p>)", std::regex_constants::ECMAScript | std::regex_constants::icase);
-        markdown = std::regex_replace(markdown, p_regex, "$1\n\n");
-        
-        // Convert divs (simple conversion)
-        std::regex div_regex(R"(<div[^>]*>(.*?)</div>)", std::regex_constants::ECMAScript | std::regex_constants::icase);
-        markdown = std::regex_replace(markdown, div_regex, "$1\n");
-        
-        // Convert spans (just extract content)
-        std::regex span_regex(R"(<span[^>]*>(.*?)</span>)", std::regex_constants::ECMAScript | std::regex_constants::icase);
-        markdown = std::regex_replace(markdown, span_regex, "$1");
-        
-        // Convert tables (basic support)
-        std::regex table_regex(R"(<table[^>]*>(.*?)</table>)", std::regex_constants::ECMAScript | std::regex_constants::icase);
-        std::regex tr_regex(R"(<tr[^>]*>(.*?)</tr>)", std::regex_constants::ECMAScript | std::regex_constants::icase);
-        std::regex td_regex(R"(<t[hd][^>]*>(.*?)</t[hd]>)", std::regex_constants::ECMAScript | std::regex_constants::icase);
-        
-        // Simple table conversion (this is very basic)
-        markdown = std::regex_replace(markdown, td_regex, "| $1 ");
-        markdown = std::regex_replace(markdown, tr_regex, "$1|\n");
-        markdown = std::regex_replace(markdown, table_regex, "\n$1\n");
-        
-        // Remove any remaining HTML tags
-        std::regex html_tag_regex(R"(<[^>]*>)", std::regex_constants::ECMAScript);
-        markdown = std::regex_replace(markdown, html_tag_regex, "");
-        
-        // Decode HTML entities
-        markdown = decodeHtmlEntities(markdown);
-        
-        return markdown;
-    }
-
-    std::string HtmlParser::cleanupMarkdown(const std::string& markdown)
-    {
-        std::string result = markdown;
-        
-        // Clean up excessive whitespace
-        std::regex multiple_spaces_regex(R"( {3,})");
-        result = std::regex_replace(result, multiple_spaces_regex, " ");
-        
-        // Clean up multiple newlines (keep maximum of 2)
-        std::regex multiple_newlines_regex(R"(\n{3,})");
-        result = std::regex_replace(result, multiple_newlines_regex, "\n\n");
-        
-        // Remove leading/trailing whitespace from each line
-        std::istringstream iss(result);
-        std::ostringstream oss;
-        std::string line;
-        
-        while (std::getline(iss, line))
-        {
-            // Trim leading and trailing whitespace
-            line.erase(0, line.find_first_not_of(" \t"));
-            line.erase(line.find_last_not_of(" \t") + 1);
-            oss << line << "\n";
-        }
-        
-        result = oss.str();
-        
-        // Final cleanup: remove trailing newlines
-        while (!result.empty() && result.back() == '\n')
-        {
-            result.pop_back();
-        }
-        
-        return result;
-    }
-
 } // namespace retrieval
@@ -1,4 +1,5 @@
 #include "kolosal/retrieval/parse_pdf.hpp"
+#include "kolosal/task_executor.hpp"
 #include <podofo/podofo.h>
 #include <stdexcept>
 #include <sstream>
@@ -7,16 +8,30 @@
 #include <algorithm>
 #include <fstream>
 #include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <iterator>
 
 using namespace PoDoFo;
 
 namespace retrieval
 {
+    namespace
+    {
+        // PoDoFo documents are not safe to share between threads, so every extraction
+        // thread loads its own copy; these bound the threads and the memory that costs
+        constexpr size_t kMaxExtractionThreads = 8;
+        constexpr size_t kMinPagesPerThread = 16;
+        // Pages handed out per claim; small enough that ordered streaming is not held up long
+        constexpr size_t kPagesPerRange = 8;
+    }
+
     // Public API Implementation
     ParseResult DocumentParser::parse_pdf(const std::string &file_path,
                                           PDFParseMethod method,
                                           const std::string &language,
-                                          ProgressCallback progress_cb)
+                                          ProgressCallback progress_cb,
+                                          PageCallback page_cb)
     {
         try
         {
@@ -38,7 +53,7 @@ namespace retrieval
             switch (method)
             {
             case PDFParseMethod::Fast:
-                return parse_pdf_fast(file_path, progress_cb);
+                return parse_pdf_fast(file_path, progress_cb, page_cb);
             case PDFParseMethod::OCR:
                 return parse_pdf_ocr(file_path, language, progress_cb);
             case PDFParseMethod::Visual:
@@ -61,7 +76,8 @@ namespace retrieval
     ParseResult DocumentParser::parse_pdf_from_bytes(const unsigned char *data, size_t size,
                                                      PDFParseMethod method,
                                                      const std::string &language,
-                                                     ProgressCallback progress_cb)
+                                                     ProgressCallback progress_cb,
+                                                     PageCallback page_cb)
     {
         try
         {
@@ -78,7 +94,7 @@ namespace retrieval
             switch (method)
             {
             case PDFParseMethod::Fast:
-                return parse_pdf_fast_from_bytes(data, size, progress_cb);
+                return parse_pdf_fast_from_bytes(data, size, progress_cb, page_cb);
             case PDFParseMethod::OCR:
                 return parse_pdf_ocr_from_bytes(data, size, language, progress_cb);
             case PDFParseMethod::Visual:
@@ -104,7 +120,7 @@ namespace retrieval
                                                              const std::string &language,
                                                              ProgressCallback progress_cb)
     {
-        return std::async(std::launch::async, [=]()
+        return kolosal::TaskExecutor::instance().submit([=]()
                           { return parse_pdf(file_path, method, language, progress_cb); });
     }
 
@@ -125,7 +141,7 @@ namespace retrieval
         for (const auto &file_path : file_paths)
         {
             futures.emplace_back(
-                std::async(std::launch::async, [=]()
+                kolosal::TaskExecutor::instance().submit([=]()
                            { return parse_pdf(file_path, method, language); }));
         }
 
@@ -174,55 +190,19 @@ namespace retrieval
 
     // Private Implementation Methods
     ParseResult DocumentParser::parse_pdf_fast(const std::string &file_path,
-                                               ProgressCallback progress_cb)
+                                               ProgressCallback progress_cb,
+                                               PageCallback page_cb)
     {
         try
         {
-            PdfMemDocument doc;
-            doc.Load(file_path);
-            auto& pages = doc.GetPages();
-
-            const int page_count = static_cast<int>(pages.GetCount());
-            if (page_count <= 0)
-            {
-                ParseResult result;
-                result.success = false;
-                result.error_message = "PDF has no pages";
-                return result;
-            }
-
-            std::ostringstream output;
-            output.str().reserve(page_count * 1024); // Pre-allocate reasonable space
-
-            for (int i = 0; i < page_count; ++i)
+            // Read once; every extraction thread loads its document from this buffer
+            std::ifstream file(file_path, std::ios::binary);
+            if (!file)
             {
-                try
-                {
-                    std::string page_text = extract_text_from_page(doc, i);
-                    if (!page_text.empty())
-                    {
-                        output << page_text;
-                        if (i < page_count - 1)
-                        {
-                            output << "\n\n"; // Page separator
-                        }
-                    }
-
-                    // Progress callback
-                    if (progress_cb)
-                    {
-                        progress_cb(i + 1, page_count);
-                    }
-                }
-                catch (const std::exception &e)
-                {
-                    // Log page error but continue processing
-                    output << "[Error processing page " << (i + 1) << ": " << e.what() << "]\n\n";
-                }
+                throw std::runtime_error("Unable to open " + file_path);
             }
-
-            ParseResult result(output.str(), true, page_count);
-            return result;
+            std::vector<char> buffer((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+            return extract_pages(buffer.data(), buffer.size(), progress_cb, page_cb);
         }
         catch (const std::exception &e)
         {
@@ -237,16 +217,23 @@ namespace retrieval
                                               const std::string &language,
                                               ProgressCallback progress_cb)
     {
-        // TODO: Implement OCR using Tesseract
-        // This would involve:
-        // 1. Converting PDF pages to images using PoDoFo
-        // 2. Using Tesseract to perform OCR on each image
-        // 3. Combining the results
-
-        ParseResult result;
-        result.success = false;
-        result.error_message = "OCR parsing not yet implemented. Please use Fast method or implement Tesseract integration.";
-        return result;
+        try
+        {
+            std::ifstream file(file_path, std::ios::binary);
+            if (!file)
+            {
+                throw std::runtime_error("Unable to open " + file_path);
+            }
+            std::vector<char> buffer((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+            return ocr_pages(buffer.data(), buffer.size(), language, progress_cb);
+        }
+        catch (const std::exception &e)
+        {
+            ParseResult result;
+            result.success = false;
+            result.error_message = e.what();
+            return result;
+        }
     }
 
     ParseResult DocumentParser::parse_pdf_visual(const std::string &file_path,                                                 ProgressCallback progress_cb)
@@ -265,16 +252,40 @@ namespace retrieval
 
     // Memory-based parsing methods
     ParseResult DocumentParser::parse_pdf_fast_from_bytes(const unsigned char *data, size_t size,
-                                                         ProgressCallback progress_cb)
+                                                         ProgressCallback progress_cb,
+                                                         PageCallback page_cb)
+    {
+        return extract_pages(reinterpret_cast<const char*>(data), size, progress_cb, page_cb);
+    }
+
+    ParseResult DocumentParser::parse_pdf_ocr_from_bytes(const unsigned char *data, size_t size,
+                                                        const std::string &language,
+                                                        ProgressCallback progress_cb)
+    {
+        return ocr_pages(reinterpret_cast<const char*>(data), size, language, progress_cb);
+    }
+
+    ParseResult DocumentParser::parse_pdf_visual_from_bytes(const unsigned char *data, size_t size,
+                                                           ProgressCallback progress_cb)
+    {
+        // TODO: Implement visual parsing using ML models for memory data
+        ParseResult result;
+        result.success = false;
+        result.error_message = "Visual parsing from bytes not yet implemented. Please use Fast method or implement vision model integration.";
+        return result;
+    }
+
+    ParseResult DocumentParser::extract_pages(const char *data, size_t size,
+                                              ProgressCallback progress_cb,
+                                              PageCallback page_cb)
     {
         try
         {
             PdfMemDocument doc;
-            doc.LoadFromBuffer({reinterpret_cast<const char*>(data), size});
-            auto& pages = doc.GetPages();
+            doc.LoadFromBuffer({data, size});
 
-            const int page_count = static_cast<int>(pages.GetCount());
-            if (page_count <= 0)
+            const size_t page_count = static_cast<size_t>(doc.GetPages().GetCount());
+            if (page_count == 0)
             {
                 ParseResult result;
                 result.success = false;
@@ -282,37 +293,132 @@ namespace retrieval
                 return result;
             }
 
-            std::ostringstream output;
-            output.str().reserve(page_count * 1024); // Pre-allocate reasonable space
+            const size_t hardware_threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+            const size_t thread_count = std::max<size_t>(1, std::min({kMaxExtractionThreads, hardware_threads,
+                                                                      page_count / kMinPagesPerThread}));
+
+            // Threads claim page ranges in order; this thread assembles pages in order as they land
+            std::vector<std::string> page_texts(page_count);
+            std::vector<char> page_failed(page_count, 0);
+            std::vector<char> page_done(page_count, 0);
+            std::atomic<size_t> next_range{0};
+            std::mutex done_mutex;
+            std::condition_variable done_cv;
+
+            auto extractRanges = [&](const PdfMemDocument &worker_doc)
+            {
+                for (;;)
+                {
+                    const size_t begin = next_range.fetch_add(kPagesPerRange);
+                    if (begin >= page_count)
+                    {
+                        return;
+                    }
+                    const size_t end = std::min(begin + kPagesPerRange, page_count);
+                    for (size_t i = begin; i < end; ++i)
+                    {
+                        std::string text;
+                        bool failed = false;
+                        try
+                        {
+                            text = extract_text_from_page(worker_doc, static_cast<int>(i));
+                        }
+                        catch (const std::exception &e)
+                        {
+                            text = e.what();
+                            failed = true;
+                        }
+
+                        std::lock_guard<std::mutex> lock(done_mutex);
+                        page_texts[i] = std::move(text);
+                        page_failed[i] = failed ? 1 : 0;
+                        page_done[i] = 1;
+                    }
+                    done_cv.notify_one();
+                }
+            };
+
+            std::vector<std::thread> threads;
+            threads.reserve(thread_count);
+            threads.emplace_back([&]() { extractRanges(doc); });
+            for (size_t t = 1; t < thread_count; ++t)
+            {
+                threads.emplace_back([&]()
+                {
+                    try
+                    {
+                        PdfMemDocument worker_doc;
+                        worker_doc.LoadFromBuffer({data, size});
+                        extractRanges(worker_doc);
+                    }
+                    catch (const std::exception &)
+                    {
+                        // The remaining ranges are picked up by the threads that did load
+                    }
+                });
+            }
+
+            // Callbacks may throw; stop handing out ranges and join before the exception leaves
+            auto joinThreads = [&]()
+            {
+                for (auto &thread : threads)
+                {
+                    if (thread.joinable())
+                    {
+                        thread.join();
+                    }
+                }
+            };
 
-            for (int i = 0; i < page_count; ++i)
+            std::string output;
+            output.reserve(page_count * 1024); // Pre-allocate reasonable space
+            try
             {
-                try
+                for (size_t i = 0; i < page_count; ++i)
                 {
-                    std::string page_text = extract_text_from_page(doc, i);
-                    if (!page_text.empty())
+                    std::string page_text;
+                    bool failed = false;
+                    {
+                        std::unique_lock<std::mutex> lock(done_mutex);
+                        done_cv.wait(lock, [&]() { return page_done[i] != 0; });
+                        page_text = std::move(page_texts[i]);
+                        failed = page_failed[i] != 0;
+                    }
+
+                    if (failed)
+                    {
+                        // Log page error but continue processing
+                        output += "[Error processing page " + std::to_string(i + 1) + ": " + page_text + "]\n\n";
+                        page_text.clear();
+                    }
+                    else if (!page_text.empty())
                     {
-                        output << page_text;
+                        output += page_text;
                         if (i < page_count - 1)
                         {
-                            output << "\n\n"; // Page separator
+                            output += "\n\n"; // Page separator
                         }
                     }
 
-                    // Progress callback
+                    if (page_cb)
+                    {
+                        page_cb(i, page_text);
+                    }
                     if (progress_cb)
                     {
                         progress_cb(i + 1, page_count);
                     }
                 }
-                catch (const std::exception &e)
-                {
-                    // Log page error but continue processing
-                    output << "[Error processing page " << (i + 1) << ": " << e.what() << "]\n\n";
-                }
             }
+            catch (...)
+            {
+                next_range.store(page_count);
+                joinThreads();
+                throw;
+            }
+            joinThreads();
 
-            ParseResult result(output.str(), true, page_count);
+            ParseResult result(output, true, page_count);
             return result;
         }
         catch (const std::exception &e)
@@ -324,27 +430,6 @@ namespace retrieval
         }
     }
 
-    ParseResult DocumentParser::parse_pdf_ocr_from_bytes(const unsigned char *data, size_t size,
-                                                        const std::string &language,
-                                                        ProgressCallback progress_cb)
-    {
-        // TODO: Implement OCR using Tesseract for memory data
-        ParseResult result;
-        result.success = false;
-        result.error_message = "OCR parsing from bytes not yet implemented. Please use Fast method or implement Tesseract integration.";
-        return result;
-    }
-
-    ParseResult DocumentParser::parse_pdf_visual_from_bytes(const unsigned char *data, size_t size,
-                                                           ProgressCallback progress_cb)
-    {
-        // TODO: Implement visual parsing using ML models for memory data
-        ParseResult result;
-        result.success = false;
-        result.error_message = "Visual parsing from bytes not yet implemented. Please use Fast method or implement vision model integration.";
-        return result;
-    }
-
     // Helper Functions
     std::string DocumentParser::extract_text_from_page(const PdfMemDocument& doc, int page_num)
     {
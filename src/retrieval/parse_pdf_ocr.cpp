@@ -0,0 +1,313 @@
+#include "kolosal/retrieval/parse_pdf.hpp"
+#include "kolosal/retrieval/parse_cache.hpp"
+#include "kolosal/logger.hpp"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#ifdef KOLOSAL_WITH_OCR
+#include <poppler-document.h>
+#include <poppler-image.h>
+#include <poppler-page.h>
+#include <poppler-page-renderer.h>
+#include <tesseract/baseapi.h>
+#endif
+
+namespace retrieval
+{
+#ifdef KOLOSAL_WITH_OCR
+    namespace
+    {
+        // Scans are rasterized at the resolution Tesseract's models are trained for
+        constexpr double kOcrDpi = 300.0;
+
+        /**
+         * Initialized Tesseract engines, kept per language between requests
+         *
+         * Loading a language's models takes hundreds of milliseconds and tens of
+         * megabytes, so an engine is leased for one page and handed back rather than
+         * created per call. Each engine is used by one thread at a time; at most one
+         * per hardware thread is kept idle for each language.
+         */
+        class OcrEnginePool
+        {
+        public:
+            struct Release
+            {
+                std::string language;
+                void operator()(tesseract::TessBaseAPI *engine) const
+                {
+                    OcrEnginePool::instance().release(language, engine);
+                }
+            };
+            using Lease = std::unique_ptr<tesseract::TessBaseAPI, Release>;
+
+            static OcrEnginePool &instance()
+            {
+                static OcrEnginePool pool;
+                return pool;
+            }
+
+            Lease acquire(const std::string &language)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    auto &idle = idle_[language];
+                    if (!idle.empty())
+                    {
+                        tesseract::TessBaseAPI *engine = idle.back().release();
+                        idle.pop_back();
+                        return Lease(engine, Release{language});
+                    }
+                }
+
+                // Initialized outside the lock; other languages and pages keep going meanwhile
+                auto engine = std::make_unique<tesseract::TessBaseAPI>();
+                if (engine->Init(nullptr, language.c_str(), tesseract::OEM_LSTM_ONLY) != 0)
+                {
+                    throw std::runtime_error("Tesseract has no trained data for language '" + language +
+                                             "' (install it or set TESSDATA_PREFIX)");
+                }
+                engine->SetPageSegMode(tesseract::PSM_AUTO);
+                return Lease(engine.release(), Release{language});
+            }
+
+        private:
+            void release(const std::string &language, tesseract::TessBaseAPI *engine)
+            {
+                std::unique_ptr<tesseract::TessBaseAPI> owned(engine);
+                owned->Clear();
+                std::lock_guard<std::mutex> lock(mutex_);
+                auto &idle = idle_[language];
+                if (idle.size() < std::max<size_t>(1, std::thread::hardware_concurrency()))
+                {
+                    idle.push_back(std::move(owned));
+                }
+            }
+
+            std::mutex mutex_;
+            std::unordered_map<std::string, std::vector<std::unique_ptr<tesseract::TessBaseAPI>>> idle_;
+        };
+
+        std::string recognize_page(const poppler::document &doc, int page_num, const std::string &language)
+        {
+            std::unique_ptr<poppler::page> page(doc.create_page(page_num));
+            if (!page)
+            {
+                throw std::runtime_error("Unable to open page");
+            }
+
+            poppler::page_renderer renderer;
+            renderer.set_render_hint(poppler::page_renderer::antialiasing, true);
+            renderer.set_render_hint(poppler::page_renderer::text_antialiasing, true);
+            renderer.set_image_format(poppler::image::format_gray8);
+            poppler::image image = renderer.render_page(page.get(), kOcrDpi, kOcrDpi);
+            if (!image.is_valid())
+            {
+                throw std::runtime_error("Unable to render page");
+            }
+
+            auto engine = OcrEnginePool::instance().acquire(language);
+            engine->SetImage(reinterpret_cast<const unsigned char *>(image.const_data()),
+                             image.width(), image.height(), 1, image.bytes_per_row());
+            engine->SetSourceResolution(static_cast<int>(kOcrDpi));
+            std::unique_ptr<char[]> text(engine->GetUTF8Text());
+            return text ? std::string(text.get()) : std::string();
+        }
+    }
+#endif
+
+    ParseResult DocumentParser::ocr_pages(const char *data, size_t size,
+                                          const std::string &language,
+                                          ProgressCallback progress_cb)
+    {
+#ifndef KOLOSAL_WITH_OCR
+        (void)data;
+        (void)size;
+        (void)language;
+        (void)progress_cb;
+        ParseResult result;
+        result.success = false;
+        result.error_message = "OCR parsing is not available in this build (configure with -DUSE_OCR=ON and Tesseract and Poppler installed)";
+        return result;
+#else
+        try
+        {
+            std::unique_ptr<poppler::document> doc(poppler::document::load_from_raw_data(data, static_cast<int>(size)));
+            if (!doc || doc->is_locked())
+            {
+                ParseResult result;
+                result.success = false;
+                result.error_message = doc ? "PDF is encrypted" : "Unable to load PDF";
+                return result;
+            }
+
+            const size_t page_count = static_cast<size_t>(std::max(0, doc->pages()));
+            if (page_count == 0)
+            {
+                ParseResult result;
+                result.success = false;
+                result.error_message = "PDF has no pages";
+                return result;
+            }
+
+            // Pages recognized before, in this document and language, come from the parse cache
+            auto &cache = kolosal::retrieval::ParseCache::instance();
+            const std::string document_key = cache.enabled()
+                ? kolosal::retrieval::ParseCache::makeKey("pdf-ocr", "", std::string_view(data, size))
+                : std::string();
+            auto pageKey = [&](size_t i)
+            {
+                return kolosal::retrieval::ParseCache::makeKey("pdf-ocr-page", language + '\0' + std::to_string(i), document_key);
+            };
+
+            // OCR dominates, so threads claim one page at a time; each renders from its own
+            // document, since Poppler documents are not safe to share between threads
+            const size_t hardware_threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+            const size_t thread_count = std::min(hardware_threads, page_count);
+
+            std::vector<std::string> page_texts(page_count);
+            std::vector<char> page_failed(page_count, 0);
+            std::vector<char> page_done(page_count, 0);
+            std::atomic<size_t> next_page{0};
+            std::atomic<size_t> cached_pages{0};
+            std::mutex done_mutex;
+            std::condition_variable done_cv;
+
+            auto recognizePages = [&](const poppler::document &worker_doc)
+            {
+                for (size_t i = next_page.fetch_add(1); i < page_count; i = next_page.fetch_add(1))
+                {
+                    std::string text;
+                    bool failed = false;
+                    try
+                    {
+                        std::optional<std::string> cached;
+                        if (!document_key.empty())
+                        {
+                            cached = cache.get(pageKey(i));
+                        }
+                        if (cached)
+                        {
+                            text = std::move(*cached);
+                            cached_pages.fetch_add(1, std::memory_order_relaxed);
+                        }
+                        else
+                        {
+                            text = recognize_page(worker_doc, static_cast<int>(i), language);
+                            if (!document_key.empty())
+                            {
+                                cache.put(pageKey(i), text);
+                            }
+                        }
+                    }
+                    catch (const std::exception &e)
+                    {
+                        text = e.what();
+                        failed = true;
+                    }
+
+                    {
+                        std::lock_guard<std::mutex> lock(done_mutex);
+                        page_texts[i] = std::move(text);
+                        page_failed[i] = failed ? 1 : 0;
+                        page_done[i] = 1;
+                    }
+                    done_cv.notify_one();
+                }
+            };
+
+            std::vector<std::thread> threads;
+            threads.reserve(thread_count);
+            threads.emplace_back([&]() { recognizePages(*doc); });
+            for (size_t t = 1; t < thread_count; ++t)
+            {
+                threads.emplace_back([&]()
+                {
+                    std::unique_ptr<poppler::document> worker_doc(
+                        poppler::document::load_from_raw_data(data, static_cast<int>(size)));
+                    if (worker_doc)
+                    {
+                        // The remaining pages are picked up by the threads that did load
+                        recognizePages(*worker_doc);
+                    }
+                });
+            }
+
+            auto joinThreads = [&]()
+            {
+                for (auto &thread : threads)
+                {
+                    if (thread.joinable())
+                    {
+                        thread.join();
+                    }
+                }
+            };
+
+            std::string output;
+            output.reserve(page_count * 2048);
+            try
+            {
+                for (size_t i = 0; i < page_count; ++i)
+                {
+                    std::string page_text;
+                    bool failed = false;
+                    {
+                        std::unique_lock<std::mutex> lock(done_mutex);
+                        done_cv.wait(lock, [&]() { return page_done[i] != 0; });
+                        page_text = std::move(page_texts[i]);
+                        failed = page_failed[i] != 0;
+                    }
+
+                    if (failed)
+                    {
+                        output += "[Error processing page " + std::to_string(i + 1) + ": " + page_text + "]\n\n";
+                    }
+                    else if (!page_text.empty())
+                    {
+                        output += page_text;
+                        if (i < page_count - 1)
+                        {
+                            output += "\n\n";
+                        }
+                    }
+
+                    if (progress_cb)
+                    {
+                        progress_cb(i + 1, page_count);
+                    }
+                }
+            }
+            catch (...)
+            {
+                next_page.store(page_count);
+                joinThreads();
+                throw;
+            }
+            joinThreads();
+
+            KOLOSAL_LOG_INFO("OCR of %zu pages on %zu threads (%zu from cache)",
+                                           page_count, thread_count, cached_pages.load());
+            return ParseResult(output, true, page_count);
+        }
+        catch (const std::exception &e)
+        {
+            ParseResult result;
+            result.success = false;
+            result.error_message = e.what();
+            return result;
+        }
+#endif
+    }
+
+} // namespace retrieval
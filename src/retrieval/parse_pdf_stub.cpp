@@ -1,4 +1,5 @@
 #include "kolosal/retrieval/parse_pdf.hpp"
+#include "kolosal/task_executor.hpp"
 
 namespace retrieval {
 
@@ -7,7 +8,8 @@ namespace retrieval {
 ParseResult DocumentParser::parse_pdf(const std::string &/*file_path*/,
                                       PDFParseMethod /*method*/,
                                       const std::string &/*language*/,
-                                      ProgressCallback /*progress_cb*/)
+                                      ProgressCallback /*progress_cb*/,
+                                      PageCallback /*page_cb*/)
 {
     ParseResult result;
     result.success = false;
@@ -19,7 +21,8 @@ ParseResult DocumentParser::parse_pdf(const std::string &/*file_path*/,
 ParseResult DocumentParser::parse_pdf_from_bytes(const unsigned char * /*data*/, size_t /*size*/,
                                                  PDFParseMethod /*method*/,
                                                  const std::string &/*language*/,
-                                                 ProgressCallback /*progress_cb*/)
+                                                 ProgressCallback /*progress_cb*/,
+                                                 PageCallback /*page_cb*/)
 {
     ParseResult result;
     result.success = false;
@@ -33,7 +36,7 @@ std::future<ParseResult> DocumentParser::parse_pdf_async(const std::string &file
                                                          const std::string &language,
                                                          ProgressCallback progress_cb)
 {
-    return std::async(std::launch::async, [=](){
+    return kolosal::TaskExecutor::instance().submit([=](){
         return parse_pdf(file_path, method, language, progress_cb);
     });
 }
@@ -47,7 +50,7 @@ std::vector<std::future<ParseResult>> DocumentParser::parse_pdf_batch(
     std::vector<std::future<ParseResult>> futures;
     futures.reserve(file_paths.size());
     for (const auto &path : file_paths) {
-        futures.emplace_back(std::async(std::launch::async, [=](){
+        futures.emplace_back(kolosal::TaskExecutor::instance().submit([=](){
             return parse_pdf(path, method, language);
         }));
     }
@@ -65,7 +68,7 @@ size_t DocumentParser::get_page_count(const std::string & /*file_path*/)
 }
 
 // Private helpers (not used in stub builds)
-ParseResult DocumentParser::parse_pdf_fast(const std::string & /*file_path*/, ProgressCallback /*progress_cb*/)
+ParseResult DocumentParser::parse_pdf_fast(const std::string & /*file_path*/, ProgressCallback /*progress_cb*/, PageCallback /*page_cb*/)
 {
     return parse_pdf("", PDFParseMethod::Fast, "eng", nullptr);
 }
@@ -80,7 +83,7 @@ ParseResult DocumentParser::parse_pdf_visual(const std::string & /*file_path*/,
     return parse_pdf("", PDFParseMethod::Visual, "eng", nullptr);
 }
 
-ParseResult DocumentParser::parse_pdf_fast_from_bytes(const unsigned char * /*data*/, size_t /*size*/, ProgressCallback /*progress_cb*/)
+ParseResult DocumentParser::parse_pdf_fast_from_bytes(const unsigned char * /*data*/, size_t /*size*/, ProgressCallback /*progress_cb*/, PageCallback /*page_cb*/)
 {
     return parse_pdf_from_bytes(nullptr, 0, PDFParseMethod::Fast, "eng", nullptr);
 }
@@ -95,6 +98,11 @@ ParseResult DocumentParser::parse_pdf_visual_from_bytes(const unsigned char * /*
     return parse_pdf_from_bytes(nullptr, 0, PDFParseMethod::Visual, "eng", nullptr);
 }
 
+ParseResult DocumentParser::extract_pages(const char * /*data*/, size_t /*size*/, ProgressCallback /*progress_cb*/, PageCallback /*page_cb*/)
+{
+    return parse_pdf_from_bytes(nullptr, 0, PDFParseMethod::Fast, "eng", nullptr);
+}
+
 std::string DocumentParser::extract_text_from_page(const PoDoFo::PdfMemDocument& /*doc*/, int /*page_num*/)
 {
     return {};
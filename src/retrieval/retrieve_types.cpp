@@ -1,5 +1,6 @@
 #include "kolosal/retrieval/retrieve_types.hpp"
 #include "kolosal/logger.hpp"
+#include <algorithm>
 #include <stdexcept>
 
 namespace kolosal
@@ -43,31 +44,294 @@ void RetrieveRequest::from_json(const nlohmann::json& j)
         }
         score_threshold = j["score_threshold"].get<float>();
     }
+    
+    if (j.contains("filter") && !j["filter"].is_null())
+    {
+        if (!j["filter"].is_object())
+        {
+            throw std::runtime_error("Field 'filter' must be an object with 'must', 'should' or 'must_not' conditions");
+        }
+        filter = j["filter"];
+    }
+    
+    if (j.contains("search_mode"))
+    {
+        if (!j["search_mode"].is_string())
+        {
+            throw std::runtime_error("Field 'search_mode' must be a string");
+        }
+        search_mode = j["search_mode"].get<std::string>();
+        if (search_mode != "vector" && search_mode != "keyword" && search_mode != "hybrid")
+        {
+            throw std::runtime_error("Field 'search_mode' must be 'vector', 'keyword' or 'hybrid'");
+        }
+    }
+    
+    if (j.contains("fusion"))
+    {
+        if (!j["fusion"].is_string())
+        {
+            throw std::runtime_error("Field 'fusion' must be a string");
+        }
+        fusion = j["fusion"].get<std::string>();
+        if (fusion != "rrf" && fusion != "weighted")
+        {
+            throw std::runtime_error("Field 'fusion' must be 'rrf' or 'weighted'");
+        }
+    }
+    
+    if (j.contains("keyword_weight"))
+    {
+        if (!j["keyword_weight"].is_number())
+        {
+            throw std::runtime_error("Field 'keyword_weight' must be a number");
+        }
+        keyword_weight = j["keyword_weight"].get<float>();
+    }
+    
+    if (j.contains("rerank_model") && !j["rerank_model"].is_null())
+    {
+        if (!j["rerank_model"].is_string())
+        {
+            throw std::runtime_error("Field 'rerank_model' must be a string");
+        }
+        rerank_model = j["rerank_model"].get<std::string>();
+    }
+    
+    if (j.contains("rerank_candidates"))
+    {
+        if (!j["rerank_candidates"].is_number_integer() || j["rerank_candidates"].get<int>() < 0)
+        {
+            throw std::runtime_error("Field 'rerank_candidates' must be a non-negative integer");
+        }
+        rerank_candidates = j["rerank_candidates"].get<int>();
+    }
+    
+    if (j.contains("fields") && !j["fields"].is_null())
+    {
+        if (!j["fields"].is_array() ||
+            !std::all_of(j["fields"].begin(), j["fields"].end(), [](const nlohmann::json& field) { return field.is_string(); }))
+        {
+            throw std::runtime_error("Field 'fields' must be an array of strings");
+        }
+        fields = j["fields"].get<std::vector<std::string>>();
+    }
+    
+    if (j.contains("deadline_ms"))
+    {
+        if (!j["deadline_ms"].is_number_integer() || j["deadline_ms"].get<int>() < 0)
+        {
+            throw std::runtime_error("Field 'deadline_ms' must be a non-negative integer");
+        }
+        deadline_ms = j["deadline_ms"].get<int>();
+    }
 }
 
 bool RetrieveRequest::validate() const
 {
     if (query.empty())
     {
-        ServerLogger::logDebug("Validation failed: query is empty");
+        KOLOSAL_LOG_DEBUG("Validation failed: query is empty");
         return false;
     }
     
     if (k <= 0 || k > 1000)  // Reasonable upper limit
     {
-        ServerLogger::logDebug("Validation failed: k must be between 1 and 1000, got %d", k);
+        KOLOSAL_LOG_DEBUG("Validation failed: k must be between 1 and 1000, got %d", k);
         return false;
     }
     
     if (score_threshold < 0.0f || score_threshold > 1.0f)
     {
-        ServerLogger::logDebug("Validation failed: score_threshold must be between 0.0 and 1.0, got %f", score_threshold);
+        KOLOSAL_LOG_DEBUG("Validation failed: score_threshold must be between 0.0 and 1.0, got %f", score_threshold);
+        return false;
+    }
+    
+    if (keyword_weight < 0.0f || keyword_weight > 1.0f)
+    {
+        KOLOSAL_LOG_DEBUG("Validation failed: keyword_weight must be between 0.0 and 1.0, got %f", keyword_weight);
+        return false;
+    }
+    
+    if (rerank_candidates < 0 || rerank_candidates > 1000)
+    {
+        KOLOSAL_LOG_DEBUG("Validation failed: rerank_candidates must be between 0 and 1000, got %d", rerank_candidates);
         return false;
     }
     
     return true;
 }
 
+namespace
+{
+    // Scalar values of a dotted payload key; an array field contributes each scalar element
+    void fieldValues(const nlohmann::json& payload, const std::string& key, std::vector<const nlohmann::json*>& values)
+    {
+        const nlohmann::json* node = &payload;
+        size_t start = 0;
+        while (true)
+        {
+            const size_t dot = key.find('.', start);
+            const std::string part = key.substr(start, dot == std::string::npos ? std::string::npos : dot - start);
+            if (!node->is_object())
+            {
+                return;
+            }
+            auto it = node->find(part);
+            if (it == node->end())
+            {
+                return;
+            }
+            node = &*it;
+            if (dot == std::string::npos)
+            {
+                break;
+            }
+            start = dot + 1;
+        }
+        if (node->is_array())
+        {
+            for (const auto& element : *node)
+            {
+                if (element.is_primitive() && !element.is_null())
+                {
+                    values.push_back(&element);
+                }
+            }
+        }
+        else if (node->is_primitive() && !node->is_null())
+        {
+            values.push_back(node);
+        }
+    }
+    
+    bool isMatchValue(const nlohmann::json& value)
+    {
+        return value.is_string() || value.is_number() || value.is_boolean();
+    }
+    
+    bool matchesCondition(const nlohmann::json& condition, const nlohmann::json& payload);
+    
+    bool matchesClauses(const nlohmann::json& filter, const nlohmann::json& payload)
+    {
+        if (!filter.is_object())
+        {
+            throw std::runtime_error("Invalid filter: filter must be an object");
+        }
+        bool matched = true;
+        for (const auto& [clause, conditions] : filter.items())
+        {
+            if (clause != "must" && clause != "should" && clause != "must_not")
+            {
+                throw std::runtime_error("Invalid filter: unsupported filter clause '" + clause + "'");
+            }
+            // A clause holds a list of conditions or a single one
+            const nlohmann::json list = conditions.is_array() ? conditions : nlohmann::json::array({conditions});
+            if (clause == "should" && list.empty())
+            {
+                continue;
+            }
+            bool any = false;
+            for (const auto& condition : list)
+            {
+                // Evaluate every condition so malformed ones are reported regardless of order
+                const bool hit = matchesCondition(condition, payload);
+                if (clause == "must" && !hit)
+                {
+                    matched = false;
+                }
+                else if (clause == "must_not" && hit)
+                {
+                    matched = false;
+                }
+                any = any || hit;
+            }
+            if (clause == "should" && !any)
+            {
+                matched = false;
+            }
+        }
+        return matched;
+    }
+    
+    bool matchesCondition(const nlohmann::json& condition, const nlohmann::json& payload)
+    {
+        if (!condition.is_object())
+        {
+            throw std::runtime_error("Invalid filter: filter conditions must be objects");
+        }
+        if (condition.contains("must") || condition.contains("should") || condition.contains("must_not"))
+        {
+            return matchesClauses(condition, payload);
+        }
+        if (!condition.contains("key") || !condition["key"].is_string())
+        {
+            throw std::runtime_error("Invalid filter: filter condition needs a string 'key'");
+        }
+        const std::string key = condition["key"].get<std::string>();
+        std::vector<const nlohmann::json*> values;
+        fieldValues(payload, key, values);
+        
+        if (condition.contains("match") && condition["match"].is_object())
+        {
+            const auto& match = condition["match"];
+            // Values compare by their JSON text, as in the FAISS field index
+            if (match.contains("value") && isMatchValue(match["value"]))
+            {
+                const std::string wanted = match["value"].dump();
+                return std::any_of(values.begin(), values.end(),
+                                   [&](const nlohmann::json* value) { return value->dump() == wanted; });
+            }
+            const bool except = match.contains("except");
+            const auto& list = except ? match["except"] : match.value("any", nlohmann::json());
+            if (!list.is_array() || !std::all_of(list.begin(), list.end(), isMatchValue))
+            {
+                throw std::runtime_error("Invalid filter: 'match' needs a scalar 'value' or an 'any'/'except' array of scalars");
+            }
+            return std::any_of(values.begin(), values.end(), [&](const nlohmann::json* value) {
+                const std::string text = value->dump();
+                const bool listed = std::any_of(list.begin(), list.end(),
+                                                [&](const nlohmann::json& item) { return item.dump() == text; });
+                return listed != except;
+            });
+        }
+        
+        if (condition.contains("range") && condition["range"].is_object() && !condition["range"].empty())
+        {
+            const auto& range = condition["range"];
+            for (const auto& [bound, limit] : range.items())
+            {
+                if ((bound != "gt" && bound != "gte" && bound != "lt" && bound != "lte") || !limit.is_number())
+                {
+                    throw std::runtime_error("Invalid filter: 'range' takes numeric gt, gte, lt and lte bounds");
+                }
+            }
+            return std::any_of(values.begin(), values.end(), [&](const nlohmann::json* value) {
+                if (!value->is_number())
+                {
+                    return false;
+                }
+                const double number = value->get<double>();
+                return !((range.contains("gt") && !(number > range["gt"].get<double>())) ||
+                         (range.contains("gte") && !(number >= range["gte"].get<double>())) ||
+                         (range.contains("lt") && !(number < range["lt"].get<double>())) ||
+                         (range.contains("lte") && !(number <= range["lte"].get<double>())));
+            });
+        }
+        
+        throw std::runtime_error("Invalid filter: filter condition on '" + key + "' needs 'match' or 'range'");
+    }
+}
+
+bool payloadMatchesFilter(const nlohmann::json& filter, const nlohmann::json& payload)
+{
+    if (filter.is_null())
+    {
+        return true;
+    }
+    return matchesClauses(filter, payload);
+}
+
 // RetrievedDocument implementation
 nlohmann::json RetrievedDocument::to_json() const
 {
@@ -86,6 +350,12 @@ void RetrieveResponse::addDocument(const RetrievedDocument& document)
     total_found = static_cast<int>(documents.size());
 }
 
+void RetrieveResponse::addDocument(RetrievedDocument&& document)
+{
+    documents.push_back(std::move(document));
+    total_found = static_cast<int>(documents.size());
+}
+
 nlohmann::json RetrieveResponse::to_json() const
 {
     nlohmann::json j;
@@ -100,7 +370,8 @@ nlohmann::json RetrieveResponse::to_json() const
     {
         docs_array.push_back(doc.to_json());
     }
-    j["documents"] = docs_array;
+    j["documents"] = std::move(docs_array);
+    j["timings"] = {{"embed_ms", embed_ms}, {"search_ms", search_ms}, {"rerank_ms", rerank_ms}};
     
     return j;
 }
@@ -0,0 +1,155 @@
+#include "kolosal/route_table.hpp"
+
+#include <algorithm>
+
+namespace kolosal
+{
+
+    namespace
+    {
+        // Splits "/a/b/c?x=1" into {"a", "b", "c"}; empty segments (double or trailing slashes) are skipped
+        std::vector<std::string> splitPath(const std::string &path)
+        {
+            std::vector<std::string> segments;
+            const size_t end = std::min(path.find('?'), path.size());
+            size_t pos = 0;
+            while (pos < end)
+            {
+                size_t next = path.find('/', pos);
+                if (next == std::string::npos || next > end)
+                    next = end;
+                if (next > pos)
+                    segments.push_back(path.substr(pos, next - pos));
+                pos = next + 1;
+            }
+            return segments;
+        }
+
+        bool isParam(const std::string &segment)
+        {
+            return segment.size() >= 2 && segment.front() == '{' && segment.back() == '}';
+        }
+    }
+
+    RouteTable::RouteTable()
+        : root_(std::make_unique<Node>())
+    {
+    }
+
+    RouteTable::~RouteTable() = default;
+
+    void RouteTable::add(IRoute *route)
+    {
+        const Entry entry{count_++, route, {}, {}};
+        const auto patterns = route->patterns();
+        if (patterns.empty())
+        {
+            unpatterned_.push_back(entry);
+            return;
+        }
+        for (const auto &pattern : patterns)
+        {
+            insert(pattern, entry);
+        }
+    }
+
+    void RouteTable::insert(const RoutePattern &pattern, Entry entry)
+    {
+        entry.pattern = pattern.path;
+        Node *node = root_.get();
+        for (const auto &segment : splitPath(pattern.path))
+        {
+            if (segment == "*")
+            {
+                node->rest[pattern.method].push_back(std::move(entry));
+                return;
+            }
+            const bool param = isParam(segment);
+            if (param)
+                entry.paramNames.push_back(segment.substr(1, segment.size() - 2));
+            std::unique_ptr<Node> &child = param ? node->param : node->children[segment];
+            if (!child)
+                child = std::make_unique<Node>();
+            node = child.get();
+        }
+        node->routes[pattern.method].push_back(std::move(entry));
+    }
+
+    void RouteTable::collect(const std::unordered_map<std::string, std::vector<Entry>> &byMethod,
+                             const std::string &method, const std::vector<std::string> &values,
+                             std::vector<Found> &out)
+    {
+        for (const char *key : {method.c_str(), "*"})
+        {
+            auto it = byMethod.find(key);
+            if (it == byMethod.end())
+                continue;
+            for (const auto &entry : it->second)
+            {
+                out.push_back({&entry, values});
+            }
+        }
+    }
+
+    std::vector<RouteTable::Match> RouteTable::lookup(const std::string &method, const std::string &path) const
+    {
+        std::vector<Found> found;
+        for (const auto &entry : unpatterned_)
+        {
+            found.push_back({&entry, {}});
+        }
+        const auto segments = splitPath(path);
+
+        // Literal segments and {param} segments can both apply, so walk every live branch;
+        // with the handful of patterns a server has this stays a few nodes per segment
+        struct Branch
+        {
+            const Node *node;
+            std::vector<std::string> values;
+        };
+        std::vector<Branch> frontier{{root_.get(), {}}};
+        for (const auto &segment : segments)
+        {
+            std::vector<Branch> next;
+            for (const auto &branch : frontier)
+            {
+                collect(branch.node->rest, method, branch.values, found);
+                auto it = branch.node->children.find(segment);
+                if (it != branch.node->children.end())
+                    next.push_back({it->second.get(), branch.values});
+                if (branch.node->param)
+                {
+                    next.push_back({branch.node->param.get(), branch.values});
+                    next.back().values.push_back(segment);
+                }
+            }
+            frontier.swap(next);
+            if (frontier.empty())
+                break;
+        }
+        for (const auto &branch : frontier)
+        {
+            collect(branch.node->routes, method, branch.values, found);
+        }
+
+        // Stable, so a route matched by several patterns keeps the params of its first one
+        std::stable_sort(found.begin(), found.end(), [](const Found &a, const Found &b)
+                         { return a.entry->order < b.entry->order; });
+        std::vector<Match> matches;
+        matches.reserve(found.size());
+        for (const auto &candidate : found)
+        {
+            if (!matches.empty() && matches.back().route == candidate.entry->route)
+                continue;
+            Match match{candidate.entry->route, {}, candidate.entry->pattern};
+            const auto &names = candidate.entry->paramNames;
+            for (size_t i = 0; i < names.size() && i < candidate.values.size(); ++i)
+            {
+                match.params[names[i]] = candidate.values[i];
+            }
+            matches.push_back(std::move(match));
+        }
+        return matches;
+    }
+
+} // namespace kolosal
@@ -0,0 +1,58 @@
+#include "kolosal/routes/cluster_route.hpp"
+#include "kolosal/cluster_router.hpp"
+#include "kolosal/drain_manager.hpp"
+#include "kolosal/utils.hpp"
+#include "kolosal/logger.hpp"
+#include <json.hpp>
+#include <thread>
+
+using json = nlohmann::json;
+
+namespace kolosal
+{
+
+    bool ClusterRoute::match(const std::string &method, const std::string &path)
+    {
+        const std::string base = path.substr(0, path.find('?'));
+        if (base == "/v1/cluster/drain")
+            return method == "GET" || method == "POST" || method == "DELETE";
+        return method == "GET" && (base == "/v1/cluster/state" || base == "/v1/cluster/nodes");
+    }
+
+    std::vector<RoutePattern> ClusterRoute::patterns() const
+    {
+        return {{"GET", "/v1/cluster/state"}, {"GET", "/v1/cluster/nodes"}, {"GET", "/v1/cluster/drain"},
+                {"POST", "/v1/cluster/drain"}, {"DELETE", "/v1/cluster/drain"}};
+    }
+
+    void ClusterRoute::handle(SocketType sock, const RequestContext &request)
+    {
+        try
+        {
+            auto &router = ClusterRouter::instance();
+            const std::string path = request.path.substr(0, request.path.find('?'));
+            if (path == "/v1/cluster/drain")
+            {
+                auto &drain = DrainManager::instance();
+                if (request.method == "POST" && !drain.start() && !drain.draining())
+                {
+                    json jError = {{"error", {{"message", "Cluster routing is not enabled"}, {"type", "invalid_request_error"}, {"param", nullptr}, {"code", nullptr}}}};
+                    send_response(sock, 400, jError.dump());
+                    return;
+                }
+                if (request.method == "DELETE")
+                    drain.cancel();
+                send_response(sock, request.method == "POST" ? 202 : 200, drain.status().dump());
+                return;
+            }
+            send_response(sock, 200, (path == "/v1/cluster/state" ? router.localState() : router.nodes()).dump());
+        }
+        catch (const std::exception &ex)
+        {
+            KOLOSAL_LOG_ERROR("[Thread %zu] Error handling cluster request: %s", std::hash<std::thread::id>{}(std::this_thread::get_id()), ex.what());
+            json jError = {{"error", {{"message", std::string("Internal server error: ") + ex.what()}, {"type", "server_error"}, {"param", nullptr}, {"code", nullptr}}}};
+            send_response(sock, 500, jError.dump());
+        }
+    }
+
+} // namespace kolosal
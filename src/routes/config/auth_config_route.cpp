@@ -13,7 +13,7 @@ namespace kolosal
 
     AuthConfigRoute::AuthConfigRoute()
     {
-        ServerLogger::logInfo("Auth config route initialized");
+        KOLOSAL_LOG_INFO("Auth config route initialized");
     }
 
     bool AuthConfigRoute::match(const std::string &method, const std::string &path)
@@ -24,23 +24,45 @@ namespace kolosal
                 (method == "POST" && path == "/v1/auth/clear"));
     }
 
-    void AuthConfigRoute::handle(SocketType sock, const std::string &body)
+    std::vector<RoutePattern> AuthConfigRoute::patterns() const
+    {
+        return {
+            {"GET", "/v1/auth/config"},
+            {"GET", "/v1/auth/stats"},
+            {"PUT", "/v1/auth/config"},
+            {"POST", "/v1/auth/clear"}
+        };
+    }
+
+    void AuthConfigRoute::handle(SocketType sock, const RequestContext &request)
     {
         try
         {
-            // Parse the request to get method and path
-            // Note: In a real implementation, we'd extract this from the HTTP request
-            // For now, we'll determine based on the body content and handle accordingly
+            // Strip any query string before comparing paths
+            const std::string path = request.path.substr(0, request.path.find('?'));
 
-            if (body.empty())
+            if (request.method == "GET")
+            {
+                if (path == "/v1/auth/stats")
+                    handleGetStats(sock);
+                else
+                    handleGetConfig(sock);
+                return;
+            }
+            if (request.method == "POST" && path == "/v1/auth/clear")
+            {
+                handleClearRateLimit(sock, request.body);
+                return;
+            }
+
+            // PUT /v1/auth/config; older clients send an "action" field instead
+            if (request.body.empty())
             {
-                // GET request - determine if it's config or stats based on the path
-                // This is a simplified approach - in practice you'd parse the full HTTP request
                 handleGetConfig(sock);
             }
             else
             {
-                json j = json::parse(body);
+                json j = json::parse(request.body);
 
                 if (j.contains("action"))
                 {
@@ -51,7 +73,7 @@ namespace kolosal
                     }
                     else if (action == "update_config")
                     {
-                        handleUpdateConfig(sock, body);
+                        handleUpdateConfig(sock, request.body);
                     }
                     else if (action == "get_stats")
                     {
@@ -59,7 +81,7 @@ namespace kolosal
                     }
                     else if (action == "clear_rate_limit")
                     {
-                        handleClearRateLimit(sock, body);
+                        handleClearRateLimit(sock, request.body);
                     }
                     else
                     {
@@ -71,20 +93,20 @@ namespace kolosal
                 else
                 {
                     // Assume it's a config update
-                    handleUpdateConfig(sock, body);
+                    handleUpdateConfig(sock, request.body);
                 }
             }
         }
         catch (const json::exception &ex)
         {
-            ServerLogger::logError("JSON parsing error in auth config route: %s", ex.what());
+            KOLOSAL_LOG_ERROR("JSON parsing error in auth config route: %s", ex.what());
             json error = {
                 {"error", {{"message", "Invalid JSON in request body"}, {"type", "invalid_request_error"}}}};
             send_response(sock, 400, error.dump());
         }
         catch (const std::exception &ex)
         {
-            ServerLogger::logError("Error in auth config route: %s", ex.what());
+            KOLOSAL_LOG_ERROR("Error in auth config route: %s", ex.what());
             json error = {
                 {"error", {{"message", std::string("Internal error: ") + ex.what()}, {"type", "server_error"}}}};
             send_response(sock, 500, error.dump());
@@ -102,17 +124,21 @@ namespace kolosal
             auto rateLimiterConfig = rateLimiter.getConfig();
             auto corsConfig = corsHandler.getConfig();
             auto apiKeyConfig = authMiddleware.getApiKeyConfig();
+            auto tokenQuotaConfig = authMiddleware.getTokenQuota().getConfig();
+            auto tenantConfig = authMiddleware.getTenantShares().getConfig();
             json response = {
-                {"rate_limiter", {{"enabled", rateLimiterConfig.enabled}, {"max_requests", rateLimiterConfig.maxRequests}, {"window_size", rateLimiterConfig.windowSize.count()}}},
+                {"rate_limiter", {{"enabled", rateLimiterConfig.enabled}, {"max_requests", rateLimiterConfig.maxRequests}, {"window_size", rateLimiterConfig.windowSize.count()}, {"api_key_max_requests", rateLimiterConfig.apiKeyMaxRequests}}},
+                {"token_quota", {{"enabled", tokenQuotaConfig.enabled}, {"tokens_per_minute", tokenQuotaConfig.tokensPerMinute}, {"models", tokenQuotaConfig.modelTokensPerMinute}}},
+                {"tenant_scheduling", {{"enabled", tenantConfig.enabled}, {"weight", tenantConfig.defaults.weight}, {"max_slots", tenantConfig.defaults.maxSlots}, {"api_keys_count", tenantConfig.apiKeys.size()}}},
                 {"cors", {{"enabled", corsConfig.enabled}, {"allowed_origins", corsConfig.allowedOrigins}, {"allowed_methods", corsConfig.allowedMethods}, {"allowed_headers", corsConfig.allowedHeaders}, {"allow_credentials", corsConfig.allowCredentials}, {"max_age", corsConfig.maxAge}}},
                 {"api_key", {{"enabled", apiKeyConfig.enabled}, {"required", apiKeyConfig.required}, {"header_name", apiKeyConfig.headerName}, {"keys_count", apiKeyConfig.validKeys.size()}}}};
 
             send_response(sock, 200, response.dump());
-            ServerLogger::logInfo("Sent auth config response");
+            KOLOSAL_LOG_INFO("Sent auth config response");
         }
         catch (const std::exception &ex)
         {
-            ServerLogger::logError("Error getting auth config: %s", ex.what());
+            KOLOSAL_LOG_ERROR("Error getting auth config: %s", ex.what());
             json error = {
                 {"error", {{"message", std::string("Failed to get config: ") + ex.what()}, {"type", "server_error"}}}};
             send_response(sock, 500, error.dump());
@@ -144,6 +170,13 @@ namespace kolosal
                     send_response(sock, 400, error.dump());
                     return;
                 }
+                if (rl.contains("api_key_max_requests") && !rl["api_key_max_requests"].is_number_unsigned())
+                {
+                    json error = {
+                        {"error", {{"message", "api_key_max_requests must be a non-negative integer"}, {"type", "invalid_request_error"}}}};
+                    send_response(sock, 400, error.dump());
+                    return;
+                }
 
                 // Update rate limiter configuration
                 auto &rateLimiter = authMiddleware.getRateLimiter();
@@ -155,9 +188,92 @@ namespace kolosal
                     config.maxRequests = rl["max_requests"];
                 if (rl.contains("window_size"))
                     config.windowSize = std::chrono::seconds(rl["window_size"]);
+                if (rl.contains("api_key_max_requests"))
+                    config.apiKeyMaxRequests = rl["api_key_max_requests"];
 
                 rateLimiter.updateConfig(config);
             }
+            // Validate and update token quota config
+            if (j.contains("token_quota"))
+            {
+                auto &tq = j["token_quota"];
+                bool validModels = !tq.contains("models") || tq["models"].is_object();
+                if (validModels && tq.contains("models"))
+                {
+                    for (const auto &limit : tq["models"].items())
+                    {
+                        validModels = validModels && limit.value().is_number_unsigned();
+                    }
+                }
+                if ((tq.contains("tokens_per_minute") && !tq["tokens_per_minute"].is_number_unsigned()) || !validModels)
+                {
+                    json error = {
+                        {"error", {{"message", "tokens_per_minute and models must hold non-negative integers"}, {"type", "invalid_request_error"}}}};
+                    send_response(sock, 400, error.dump());
+                    return;
+                }
+
+                auto &tokenQuota = authMiddleware.getTokenQuota();
+                auto config = tokenQuota.getConfig();
+
+                if (tq.contains("enabled"))
+                    config.enabled = tq["enabled"];
+                if (tq.contains("tokens_per_minute"))
+                    config.tokensPerMinute = tq["tokens_per_minute"];
+                if (tq.contains("models"))
+                    config.modelTokensPerMinute = tq["models"].get<std::map<std::string, size_t>>();
+
+                tokenQuota.updateConfig(config);
+            }
+            // Validate and update tenant scheduling config
+            if (j.contains("tenant_scheduling"))
+            {
+                auto &ts = j["tenant_scheduling"];
+                auto validShare = [](const json &share)
+                {
+                    return share.is_object() &&
+                           (!share.contains("weight") || (share["weight"].is_number() && share["weight"].get<double>() > 0.0)) &&
+                           (!share.contains("max_slots") || share["max_slots"].is_number_unsigned());
+                };
+                bool valid = validShare(ts) && (!ts.contains("api_keys") || ts["api_keys"].is_object());
+                if (valid && ts.contains("api_keys"))
+                {
+                    for (const auto &share : ts["api_keys"].items())
+                    {
+                        valid = valid && validShare(share.value());
+                    }
+                }
+                if (!valid)
+                {
+                    json error = {
+                        {"error", {{"message", "weight must be a positive number and max_slots a non-negative integer"}, {"type", "invalid_request_error"}}}};
+                    send_response(sock, 400, error.dump());
+                    return;
+                }
+
+                auto &tenantShares = authMiddleware.getTenantShares();
+                auto config = tenantShares.getConfig();
+
+                if (ts.contains("enabled"))
+                    config.enabled = ts["enabled"];
+                if (ts.contains("weight"))
+                    config.defaults.weight = ts["weight"];
+                if (ts.contains("max_slots"))
+                    config.defaults.maxSlots = ts["max_slots"];
+                if (ts.contains("api_keys"))
+                {
+                    config.apiKeys.clear();
+                    for (const auto &share : ts["api_keys"].items())
+                    {
+                        auth::TenantShares::Share entry;
+                        entry.weight = share.value().value("weight", entry.weight);
+                        entry.maxSlots = share.value().value("max_slots", entry.maxSlots);
+                        config.apiKeys[share.key()] = entry;
+                    }
+                }
+
+                tenantShares.updateConfig(config);
+            }
             // Validate CORS config
             if (j.contains("cors"))
             {
@@ -258,11 +374,11 @@ namespace kolosal
                 {"status", "success"}};
 
             send_response(sock, 200, response.dump());
-            ServerLogger::logInfo("Updated auth configuration");
+            KOLOSAL_LOG_INFO("Updated auth configuration");
         }
         catch (const std::exception &ex)
         {
-            ServerLogger::logError("Error updating auth config: %s", ex.what());
+            KOLOSAL_LOG_ERROR("Error updating auth config: %s", ex.what());
             json error = {
                 {"error", {{"message", std::string("Failed to update config: ") + ex.what()}, {"type", "server_error"}}}};
             send_response(sock, 500, error.dump());
@@ -277,25 +393,37 @@ namespace kolosal
             auto &rateLimiter = authMiddleware.getRateLimiter();
 
             auto stats = rateLimiter.getStatistics();
+            auto keyStats = rateLimiter.getApiKeyStatistics();
 
+            size_t totalRequests = 0;
             json clientsJson = json::object();
             for (const auto &client : stats)
             {
                 clientsJson[client.first] = {
                     {"request_count", client.second}};
+                totalRequests += client.second;
+            }
+
+            json apiKeysJson = json::object();
+            for (const auto &key : keyStats)
+            {
+                apiKeysJson[key.first] = {
+                    {"request_count", key.second}};
             }
 
             json response = {
-                {"rate_limit_stats", {{"total_clients", stats.size()}, {"total_requests", 0}, // Would need to sum up all request counts
-                                      {"clients", clientsJson}}},
+                {"rate_limit_stats", {{"total_clients", stats.size()}, {"total_requests", totalRequests},
+                                      {"clients", clientsJson},
+                                      {"api_keys", apiKeysJson}}},
+                {"token_quota_stats", {{"tokens_last_minute", authMiddleware.getTokenQuota().getStatistics()}}},
                 {"cors_stats", {{"message", "CORS statistics not implemented yet"}}}};
 
             send_response(sock, 200, response.dump());
-            ServerLogger::logInfo("Served auth statistics");
+            KOLOSAL_LOG_INFO("Served auth statistics");
         }
         catch (const std::exception &ex)
         {
-            ServerLogger::logError("Error getting auth stats: %s", ex.what());
+            KOLOSAL_LOG_ERROR("Error getting auth stats: %s", ex.what());
             json error = {
                 {"error", {{"message", std::string("Failed to get stats: ") + ex.what()}, {"type", "server_error"}}}};
             send_response(sock, 500, error.dump());
@@ -319,7 +447,7 @@ namespace kolosal
                     {"message", "Rate limit data cleared for client: " + clientIP},
                     {"status", "success"}};
                 send_response(sock, 200, response.dump());
-                ServerLogger::logInfo("Cleared rate limit data for client: %s", clientIP.c_str());
+                KOLOSAL_LOG_INFO("Cleared rate limit data for client: %s", clientIP.c_str());
             }
             else if (j.contains("clear_all") && j["clear_all"].is_boolean() && j["clear_all"])
             {
@@ -329,7 +457,7 @@ namespace kolosal
                     {"message", "All rate limit data cleared"},
                     {"status", "success"}};
                 send_response(sock, 200, response.dump());
-                ServerLogger::logInfo("Cleared all rate limit data");
+                KOLOSAL_LOG_INFO("Cleared all rate limit data");
             }
             else
             {
@@ -340,7 +468,7 @@ namespace kolosal
         }
         catch (const std::exception &ex)
         {
-            ServerLogger::logError("Error clearing rate limit data: %s", ex.what());
+            KOLOSAL_LOG_ERROR("Error clearing rate limit data: %s", ex.what());
             json error = {
                 {"error", {{"message", std::string("Failed to clear data: ") + ex.what()}, {"type", "server_error"}}}};
             send_response(sock, 500, error.dump());
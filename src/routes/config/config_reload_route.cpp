@@ -0,0 +1,56 @@
+#include "kolosal/routes/config/config_reload_route.hpp"
+#include "kolosal/config_reloader.hpp"
+#include "kolosal/utils.hpp"
+#include "kolosal/logger.hpp"
+#include <json.hpp>
+#include <thread>
+
+using json = nlohmann::json;
+
+namespace kolosal
+{
+
+    bool ConfigReloadRoute::match(const std::string &method, const std::string &path)
+    {
+        return method == "POST" && path.substr(0, path.find('?')) == "/v1/config/reload";
+    }
+
+    std::vector<RoutePattern> ConfigReloadRoute::patterns() const
+    {
+        return {{"POST", "/v1/config/reload"}};
+    }
+
+    void ConfigReloadRoute::handle(SocketType sock, const RequestContext &request)
+    {
+        KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Received config reload request", std::hash<std::thread::id>{}(std::this_thread::get_id()));
+
+        try
+        {
+            const ConfigReloadResult result = ConfigReloader::instance().reload();
+            if (!result.ok)
+            {
+                json error = {
+                    {"error", {{"message", result.error}, {"type", "invalid_request_error"}, {"param", nullptr}, {"code", nullptr}}}};
+                send_response(sock, 422, error.dump());
+                return;
+            }
+
+            json response = {
+                {"status", "reloaded"},
+                {"config_file", result.configFile},
+                {"models", {{"added", result.addedModels}, {"removed", result.removedModels}, {"updated", result.updatedModels}, {"unchanged", result.unchangedModels}}},
+                {"inference_engines_reconfigured", result.inferenceEnginesReconfigured},
+                {"applied", result.applied},
+                {"restart_required", result.restartRequired}};
+            send_response(sock, 200, response.dump());
+        }
+        catch (const std::exception &ex)
+        {
+            KOLOSAL_LOG_ERROR("[Thread %zu] Config reload failed: %s", std::hash<std::thread::id>{}(std::this_thread::get_id()), ex.what());
+            json error = {
+                {"error", {{"message", std::string("Config reload failed: ") + ex.what()}, {"type", "server_error"}, {"param", nullptr}, {"code", nullptr}}}};
+            send_response(sock, 500, error.dump());
+        }
+    }
+
+} // namespace kolosal
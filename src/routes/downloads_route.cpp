@@ -14,6 +14,76 @@ using json = nlohmann::json;
 namespace kolosal
 {
 
+    namespace
+    {
+        // Compiled once; matching against a const std::regex is safe from any thread
+        struct DownloadPatterns
+        {
+            const std::regex all{R"(^(?:/v1)?/downloads$)"};
+            const std::regex single{R"(^(?:/v1)?/downloads/([^/]+)$)"};
+            const std::regex cancel{R"(^(?:/v1)?/downloads/([^/]+)/cancel$)"};
+            const std::regex pause{R"(^(?:/v1)?/downloads/([^/]+)/pause$)"};
+            const std::regex resume{R"(^(?:/v1)?/downloads/([^/]+)/resume$)"};
+            const std::regex cancelAll{R"(^(?:/v1)?/downloads/cancel$)"};
+            const std::regex events{R"(^(?:/v1)?/downloads/events(?:\?(.*))?$)"};
+            const std::regex action{R"(^(?:/v1)?/downloads/([^/]+)/(?:cancel|pause|resume)$)"};
+        };
+
+        const DownloadPatterns &downloadPatterns()
+        {
+            static const DownloadPatterns patterns;
+            return patterns;
+        }
+
+        constexpr auto kStreamKeepAlive = std::chrono::seconds(15);
+
+        std::string queryValue(const std::string &query, const std::string &key)
+        {
+            size_t start = 0;
+            while (start <= query.size())
+            {
+                size_t end = query.find('&', start);
+                if (end == std::string::npos)
+                    end = query.size();
+                const std::string param = query.substr(start, end - start);
+                const size_t eq = param.find('=');
+                if (param.substr(0, eq) == key)
+                    return eq == std::string::npos ? "" : param.substr(eq + 1);
+                start = end + 1;
+            }
+            return "";
+        }
+
+        std::string progressEvent(const DownloadUpdate &update)
+        {
+            json data = {
+                {"model_id", update.model_id},
+                {"status", update.status},
+                {"priority", downloadPriorityName(update.priority)},
+                {"progress", {
+                    {"downloaded_bytes", update.downloaded_bytes},
+                    {"total_bytes", update.total_bytes},
+                    {"percentage", update.percentage},
+                    {"download_speed_bps", update.bytes_per_second}
+                }}
+            };
+            if (update.status == "downloading" && update.bytes_per_second > 0.0 && update.total_bytes >= update.downloaded_bytes)
+            {
+                data["estimated_remaining_seconds"] =
+                    static_cast<long long>((update.total_bytes - update.downloaded_bytes) / update.bytes_per_second);
+            }
+            if (!update.error_message.empty())
+            {
+                data["error_message"] = update.error_message;
+            }
+            if (update.removed)
+            {
+                data["removed"] = true;
+            }
+            return "id: " + std::to_string(update.version) + "\nevent: progress\ndata: " + data.dump() + "\n\n";
+        }
+    }
+
     // Helper to infer model type when engine params aren't present
     static std::string infer_model_type(const std::shared_ptr<DownloadProgress> &progress)
     {
@@ -59,18 +129,19 @@ namespace kolosal
         // DELETE /downloads or /v1/downloads (cancel all downloads)
         // POST /downloads/cancel or /v1/downloads/cancel (cancel all downloads)
         
-        std::regex all_pattern(R"(^(?:/v1)?/downloads$)");
-        std::regex single_pattern(R"(^(?:/v1)?/downloads/([^/]+)$)");
-        std::regex cancel_pattern(R"(^(?:/v1)?/downloads/([^/]+)/cancel$)");
-        std::regex pause_pattern(R"(^(?:/v1)?/downloads/([^/]+)/pause$)");
-        std::regex resume_pattern(R"(^(?:/v1)?/downloads/([^/]+)/resume$)");
-        std::regex cancel_all_pattern(R"(^(?:/v1)?/downloads/cancel$)");
+        const std::regex &all_pattern = downloadPatterns().all;
+        const std::regex &single_pattern = downloadPatterns().single;
+        const std::regex &cancel_pattern = downloadPatterns().cancel;
+        const std::regex &pause_pattern = downloadPatterns().pause;
+        const std::regex &resume_pattern = downloadPatterns().resume;
+        const std::regex &cancel_all_pattern = downloadPatterns().cancelAll;
         
         bool matches = false;
         
         if (method == "GET")
         {
-            matches = std::regex_match(path, all_pattern) || std::regex_match(path, single_pattern);
+            matches = std::regex_match(path, all_pattern) || std::regex_match(path, single_pattern) ||
+                      std::regex_match(path, downloadPatterns().events);
         }
         else if (method == "DELETE")
         {
@@ -85,34 +156,59 @@ namespace kolosal
                      std::regex_match(path, all_pattern); // POST to /downloads for cancel all
         }
 
-        if (matches)
-        {
-            // Store the path for later use in handle method
-            matched_path_ = path;
-        }
-
         return matches;
     }
 
-    void DownloadsRoute::handle(SocketType sock, const std::string &body)
+    std::vector<RoutePattern> DownloadsRoute::patterns() const
+    {
+        return {
+            {"GET", "/downloads"},
+            {"GET", "/downloads/events"},
+            {"GET", "/downloads/{id}"},
+            {"DELETE", "/downloads"},
+            {"DELETE", "/downloads/{id}"},
+            {"POST", "/downloads"},
+            {"POST", "/downloads/cancel"},
+            {"POST", "/downloads/{id}/cancel"},
+            {"POST", "/downloads/{id}/pause"},
+            {"POST", "/downloads/{id}/resume"},
+            {"GET", "/v1/downloads"},
+            {"GET", "/v1/downloads/events"},
+            {"GET", "/v1/downloads/{id}"},
+            {"DELETE", "/v1/downloads"},
+            {"DELETE", "/v1/downloads/{id}"},
+            {"POST", "/v1/downloads"},
+            {"POST", "/v1/downloads/cancel"},
+            {"POST", "/v1/downloads/{id}/cancel"},
+            {"POST", "/v1/downloads/{id}/pause"},
+            {"POST", "/v1/downloads/{id}/resume"}
+        };
+    }
+
+    void DownloadsRoute::handle(SocketType sock, const RequestContext &request)
     {
         try
         {
-            // Get HTTP method from the socket (assuming we can determine it)
-            // For now, we'll parse the path to determine the action
-            
-            std::regex all_pattern(R"(^(?:/v1)?/downloads$)");
-            std::regex single_pattern(R"(^(?:/v1)?/downloads/([^/]+)$)");
-            std::regex cancel_pattern(R"(^(?:/v1)?/downloads/([^/]+)/cancel$)");
-            std::regex pause_pattern(R"(^(?:/v1)?/downloads/([^/]+)/pause$)");
-            std::regex resume_pattern(R"(^(?:/v1)?/downloads/([^/]+)/resume$)");
-            std::regex cancel_all_pattern(R"(^(?:/v1)?/downloads/cancel$)");
+            const std::string &path = request.path;
+            const bool isDelete = request.method == "DELETE";
+
+            const std::regex &all_pattern = downloadPatterns().all;
+            const std::regex &single_pattern = downloadPatterns().single;
+            const std::regex &cancel_pattern = downloadPatterns().cancel;
+            const std::regex &pause_pattern = downloadPatterns().pause;
+            const std::regex &resume_pattern = downloadPatterns().resume;
+            const std::regex &cancel_all_pattern = downloadPatterns().cancelAll;
             
             // Determine the action based on path patterns
-            if (std::regex_match(matched_path_, cancel_pattern))
+            std::smatch eventsMatch;
+            if (!isDelete && request.method == "GET" && std::regex_match(path, eventsMatch, downloadPatterns().events))
+            {
+                handleProgressStream(sock, request, eventsMatch[1].str());
+            }
+            else if (std::regex_match(path, cancel_pattern))
             {
                 // Handle cancel single download
-                std::string model_id = extractModelId(matched_path_);
+                std::string model_id = extractModelId(path);
                 if (!model_id.empty())
                 {
                     handleCancelDownload(sock, model_id);
@@ -130,10 +226,10 @@ namespace kolosal
                     send_response(sock, 400, jError.dump());
                 }
             }
-            else if (std::regex_match(matched_path_, pause_pattern))
+            else if (std::regex_match(path, pause_pattern))
             {
                 // Handle pause download
-                std::string model_id = extractModelId(matched_path_);
+                std::string model_id = extractModelId(path);
                 if (!model_id.empty())
                 {
                     handlePauseDownload(sock, model_id);
@@ -151,10 +247,10 @@ namespace kolosal
                     send_response(sock, 400, jError.dump());
                 }
             }
-            else if (std::regex_match(matched_path_, resume_pattern))
+            else if (std::regex_match(path, resume_pattern))
             {
                 // Handle resume download
-                std::string model_id = extractModelId(matched_path_);
+                std::string model_id = extractModelId(path);
                 if (!model_id.empty())
                 {
                     handleResumeDownload(sock, model_id);
@@ -172,21 +268,21 @@ namespace kolosal
                     send_response(sock, 400, jError.dump());
                 }
             }
-            else if (std::regex_match(matched_path_, cancel_all_pattern) || 
-                    (std::regex_match(matched_path_, all_pattern) && body.find("cancel") != std::string::npos))
+            else if (std::regex_match(path, cancel_all_pattern) ||
+                    (std::regex_match(path, all_pattern) && (isDelete || request.body.find("cancel") != std::string::npos)))
             {
-                // Handle cancel all downloads (either /downloads/cancel or POST to /downloads with cancel action)
+                // Handle cancel all downloads (/downloads/cancel, DELETE /downloads or POST to /downloads with cancel action)
                 handleCancelAllDownloads(sock);
             }
-            else if (std::regex_match(matched_path_, all_pattern))
+            else if (std::regex_match(path, all_pattern))
             {
                 // Handle all downloads status (GET /downloads)
                 handleAllDownloads(sock);
             }
-            else if (std::regex_match(matched_path_, single_pattern))
+            else if (std::regex_match(path, single_pattern))
             {
                 // Handle specific download progress or cancel (depending on method)
-                std::string model_id = extractModelId(matched_path_);
+                std::string model_id = extractModelId(path);
                 if (model_id.empty())
                 {
                     json jError = {
@@ -199,14 +295,15 @@ namespace kolosal
                     };
 
                     send_response(sock, 400, jError.dump());
-                    ServerLogger::logError("[Thread %u] Cannot extract model ID from request path: %s", std::this_thread::get_id(), matched_path_.c_str());
+                    KOLOSAL_LOG_ERROR("[Thread %zu] Cannot extract model ID from request path: %s", std::hash<std::thread::id>{}(std::this_thread::get_id()), path.c_str());
                     return;
                 }
                 
-                // This could be either GET (progress) or DELETE (cancel)
-                // For now, we'll assume GET for progress since we need to determine HTTP method
-                // In a real implementation, you'd check the actual HTTP method
-                handleSingleDownload(sock, model_id);
+                // GET reports progress, DELETE cancels
+                if (isDelete)
+                    handleCancelDownload(sock, model_id);
+                else
+                    handleSingleDownload(sock, model_id);
             }
             else
             {
@@ -223,7 +320,7 @@ namespace kolosal
         }
         catch (const std::exception &ex)
         {
-            ServerLogger::logError("[Thread %u] Error handling downloads request: %s", std::this_thread::get_id(), ex.what());
+            KOLOSAL_LOG_ERROR("[Thread %zu] Error handling downloads request: %s", std::hash<std::thread::id>{}(std::this_thread::get_id()), ex.what());
 
             json jError = {
                 {"error", {
@@ -246,8 +343,8 @@ namespace kolosal
         // /downloads/{model_id}/pause or /v1/downloads/{model_id}/pause
         // /downloads/{model_id}/resume or /v1/downloads/{model_id}/resume
         
-        std::regex single_pattern(R"(^(?:/v1)?/downloads/([^/]+)$)");
-        std::regex action_pattern(R"(^(?:/v1)?/downloads/([^/]+)/(?:cancel|pause|resume)$)");
+        const std::regex &single_pattern = downloadPatterns().single;
+        const std::regex &action_pattern = downloadPatterns().action;
         std::smatch match;
 
         if (std::regex_match(path, match, single_pattern) || 
@@ -264,7 +361,7 @@ namespace kolosal
 
     void DownloadsRoute::handleSingleDownload(SocketType sock, const std::string& model_id)
     {
-        ServerLogger::logInfo("[Thread %u] Received download progress request for model: %s", std::this_thread::get_id(), model_id.c_str());
+        KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Received download progress request for model: %s", std::hash<std::thread::id>{}(std::this_thread::get_id()), model_id.c_str());
 
         // Get download progress from download manager
         auto &download_manager = DownloadManager::getInstance();
@@ -283,18 +380,23 @@ namespace kolosal
             };
 
             send_response(sock, 404, jError.dump());
-            ServerLogger::logInfo("[Thread %u] No download found for model ID: %s", std::this_thread::get_id(), model_id.c_str());
+            KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] No download found for model ID: %s", std::hash<std::thread::id>{}(std::this_thread::get_id()), model_id.c_str());
             return;
         }
 
         // Calculate elapsed time
         auto now = std::chrono::system_clock::now();
         auto elapsed_seconds = std::chrono::duration_cast<std::chrono::seconds>(
-                                   (progress->status == "downloading" || progress->status == "creating_engine" ? now : progress->end_time) - progress->start_time)
+                                   (progress->status == "downloading" || progress->status == "creating_engine" || progress->status == "queued" ? now : progress->end_time) - progress->start_time)
                                    .count();
 
         // Calculate download speed (bytes per second)
         double download_speed = elapsed_seconds > 0 ? static_cast<double>(progress->downloaded_bytes) / elapsed_seconds : 0.0;
+        if (progress->status == "downloading" && progress->bytes_per_second > 0.0)
+        {
+            // Aggregate rate across all segment connections, excluding bytes resumed from disk
+            download_speed = progress->bytes_per_second;
+        }
 
         // Estimate remaining time (only for active downloads)
         int estimated_remaining_seconds = -1;
@@ -308,7 +410,7 @@ namespace kolosal
         double safe_percentage = progress->percentage;
         if (std::isnan(safe_percentage) || std::isinf(safe_percentage) || safe_percentage < 0.0 || safe_percentage > 100.0)
         {
-            ServerLogger::logWarning("Invalid percentage value %.2f for model %s in API response, using 0.0", 
+            KOLOSAL_LOG_WARNING("Invalid percentage value %.2f for model %s in API response, using 0.0", 
                                    progress->percentage, model_id.c_str());
             safe_percentage = 0.0;
         }
@@ -318,6 +420,7 @@ namespace kolosal
             {"model_id", progress->model_id},
             {"type", progress->engine_params ? progress->engine_params->model_type : infer_model_type(progress)},
             {"status", progress->status},
+            {"priority", downloadPriorityName(progress->priority)},
             {"url", progress->url},
             {"local_path", progress->local_path},
             {"progress", {
@@ -333,7 +436,7 @@ namespace kolosal
         };
 
         // Add end time and error message if applicable
-        if (progress->status != "downloading" && progress->status != "creating_engine")
+        if (progress->status != "downloading" && progress->status != "creating_engine" && progress->status != "queued")
         {
             response["timing"]["end_time"] = std::chrono::duration_cast<std::chrono::milliseconds>(progress->end_time.time_since_epoch()).count();
         }
@@ -343,6 +446,11 @@ namespace kolosal
             response["error_message"] = progress->error_message;
         }
 
+        if (!progress->sha256.empty())
+        {
+            response["sha256"] = progress->sha256;
+        }
+
         if (estimated_remaining_seconds >= 0)
         {
             response["timing"]["estimated_remaining_seconds"] = estimated_remaining_seconds;
@@ -387,13 +495,68 @@ namespace kolosal
         }
 
         send_response(sock, 200, response.dump());
-        ServerLogger::logInfo("[Thread %u] Successfully provided download progress for model: %s (%.1f%%)",
-                              std::this_thread::get_id(), model_id.c_str(), progress->percentage);
+        KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Successfully provided download progress for model: %s (%.1f%%)",
+                              std::hash<std::thread::id>{}(std::this_thread::get_id()), model_id.c_str(), progress->percentage);
+    }
+
+    void DownloadsRoute::handleProgressStream(SocketType sock, const RequestContext &request, const std::string &query)
+    {
+        auto &download_manager = DownloadManager::getInstance();
+        const std::string model_id = queryValue(query, "model_id");
+
+        // Clients may ask for a slower rate, never a faster one than the server's
+        std::chrono::milliseconds interval = download_manager.progressInterval();
+        const std::string requested = queryValue(query, "interval_ms");
+        if (!requested.empty() && std::all_of(requested.begin(), requested.end(), ::isdigit) && requested.size() < 9)
+        {
+            interval = (std::max)(interval, std::chrono::milliseconds(std::stoll(requested)));
+        }
+
+        // A reconnecting EventSource resumes after the last update it saw; the feed holds the
+        // latest state of every download, so the changes it missed are all sent at once
+        unsigned long long cursor = 0;
+        auto lastEventId = request.headers.find("last-event-id");
+        if (lastEventId != request.headers.end() && !lastEventId->second.empty() && lastEventId->second.size() < 20 &&
+            std::all_of(lastEventId->second.begin(), lastEventId->second.end(), ::isdigit))
+        {
+            cursor = std::stoull(lastEventId->second);
+        }
+
+        KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Streaming download progress%s%s every %lld ms", std::hash<std::thread::id>{}(std::this_thread::get_id()),
+                                 model_id.empty() ? "" : " for ", model_id.c_str(), static_cast<long long>(interval.count()));
+
+        begin_streaming_response(sock, 200, {{"Content-Type", "text/event-stream"}, {"Cache-Control", "no-cache"}, {"X-Accel-Buffering", "no"}});
+
+        auto lastWrite = std::chrono::steady_clock::now();
+        while (!client_disconnected(sock))
+        {
+            std::string frame;
+            for (const auto &update : download_manager.waitForUpdates(cursor, kStreamKeepAlive))
+            {
+                if (model_id.empty() || update.model_id == model_id)
+                    frame += progressEvent(update);
+            }
+
+            const auto now = std::chrono::steady_clock::now();
+            if (!frame.empty())
+            {
+                send_stream_chunk(sock, StreamChunk(frame));
+                lastWrite = now;
+
+                // Changes until the next frame coalesce into the latest state of each download
+                std::this_thread::sleep_for(interval);
+            }
+            else if (now - lastWrite >= kStreamKeepAlive)
+            {
+                send_stream_chunk(sock, StreamChunk(": keep-alive\n\n"));
+                lastWrite = now;
+            }
+        }
     }
 
     void DownloadsRoute::handleAllDownloads(SocketType sock)
     {
-        ServerLogger::logInfo("[Thread %u] Received downloads status request", std::this_thread::get_id());
+        KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Received downloads status request", std::hash<std::thread::id>{}(std::this_thread::get_id()));
 
         // Get all active downloads from download manager
         auto &download_manager = DownloadManager::getInstance();
@@ -407,11 +570,21 @@ namespace kolosal
             // Calculate elapsed time
             auto now = std::chrono::system_clock::now();
             auto elapsed_seconds = std::chrono::duration_cast<std::chrono::seconds>(
-                                       (progress->status == "downloading" || progress->status == "creating_engine" ? now : progress->end_time) - progress->start_time)
+                                       (progress->status == "downloading" || progress->status == "creating_engine" || progress->status == "queued" ? now : progress->end_time) - progress->start_time)
                                        .count();
 
             // Calculate download speed (bytes per second)
             double download_speed = elapsed_seconds > 0 ? static_cast<double>(progress->downloaded_bytes) / elapsed_seconds : 0.0;
+            if (progress->status == "downloading" && progress->bytes_per_second > 0.0)
+            {
+                // Aggregate rate across all segment connections, excluding bytes resumed from disk
+                download_speed = progress->bytes_per_second;
+            }
+        if (progress->status == "downloading" && progress->bytes_per_second > 0.0)
+        {
+            // Aggregate rate across all segment connections, excluding bytes resumed from disk
+            download_speed = progress->bytes_per_second;
+        }
 
             // Estimate remaining time (only for active downloads)
             int estimated_remaining_seconds = -1;
@@ -425,7 +598,7 @@ namespace kolosal
             double safe_percentage = progress->percentage;
             if (std::isnan(safe_percentage) || std::isinf(safe_percentage) || safe_percentage < 0.0 || safe_percentage > 100.0)
             {
-                ServerLogger::logWarning("Invalid percentage value %.2f for model %s in downloads status, using 0.0", 
+                KOLOSAL_LOG_WARNING("Invalid percentage value %.2f for model %s in downloads status, using 0.0", 
                                        progress->percentage, progress->model_id.c_str());
                 safe_percentage = 0.0;
             }
@@ -435,6 +608,7 @@ namespace kolosal
                 {"type", progress->engine_params ? progress->engine_params->model_type : infer_model_type(progress)},
                 {"status", progress->status},
                 {"download_type", progress->engine_params ? "startup" : "regular"},
+                {"priority", downloadPriorityName(progress->priority)},
                 {"url", progress->url},
                 {"local_path", progress->local_path},
                 {"progress", {
@@ -450,7 +624,7 @@ namespace kolosal
             };
 
             // Add end time and error message if applicable
-            if (progress->status != "downloading" && progress->status != "creating_engine")
+            if (progress->status != "downloading" && progress->status != "creating_engine" && progress->status != "queued")
             {
                 download_info["timing"]["end_time"] = std::chrono::duration_cast<std::chrono::milliseconds>(progress->end_time.time_since_epoch()).count();
             }
@@ -460,6 +634,11 @@ namespace kolosal
                 download_info["error_message"] = progress->error_message;
             }
 
+            if (!progress->sha256.empty())
+            {
+                download_info["sha256"] = progress->sha256;
+            }
+
             if (estimated_remaining_seconds >= 0)
             {
                 download_info["timing"]["estimated_remaining_seconds"] = estimated_remaining_seconds;
@@ -514,13 +693,13 @@ namespace kolosal
         };
 
         send_response(sock, 200, response.dump());
-        ServerLogger::logInfo("[Thread %u] Successfully provided downloads status - %zu active downloads (%d startup, %d regular, %d embedding, %d LLM)",
-                              std::this_thread::get_id(), active_downloads.size(), startup_count, regular_count, embedding_downloads, llm_downloads);
+        KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Successfully provided downloads status - %zu active downloads (%d startup, %d regular, %d embedding, %d LLM)",
+                              std::hash<std::thread::id>{}(std::this_thread::get_id()), active_downloads.size(), startup_count, regular_count, embedding_downloads, llm_downloads);
     }
 
     void DownloadsRoute::handleCancelDownload(SocketType sock, const std::string& model_id)
     {
-        ServerLogger::logInfo("[Thread %u] Received cancel download request for model: %s", std::this_thread::get_id(), model_id.c_str());
+        KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Received cancel download request for model: %s", std::hash<std::thread::id>{}(std::this_thread::get_id()), model_id.c_str());
 
         // Get download manager instance and cancel download
         auto &download_manager = DownloadManager::getInstance();
@@ -583,8 +762,8 @@ namespace kolosal
             }
 
             send_response(sock, 200, response.dump());
-            ServerLogger::logInfo("[Thread %u] Successfully cancelled download for model: %s",
-                                  std::this_thread::get_id(), model_id.c_str());
+            KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Successfully cancelled download for model: %s",
+                                  std::hash<std::thread::id>{}(std::this_thread::get_id()), model_id.c_str());
         }
         else
         {
@@ -602,7 +781,7 @@ namespace kolosal
 
     void DownloadsRoute::handleCancelAllDownloads(SocketType sock)
     {
-        ServerLogger::logInfo("[Thread %u] Received cancel all downloads request", std::this_thread::get_id());
+        KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Received cancel all downloads request", std::hash<std::thread::id>{}(std::this_thread::get_id()));
 
         auto &download_manager = DownloadManager::getInstance();
         auto active_downloads = download_manager.getAllActiveDownloads();
@@ -662,8 +841,8 @@ namespace kolosal
                 cancelled_downloads.push_back(cancel_info);
                 successful_cancellations++;
 
-                ServerLogger::logInfo("[Thread %u] Successfully cancelled %s download for model: %s",
-                                      std::this_thread::get_id(), is_startup ? "startup" : "regular", model_id.c_str());
+                KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Successfully cancelled %s download for model: %s",
+                                      std::hash<std::thread::id>{}(std::this_thread::get_id()), is_startup ? "startup" : "regular", model_id.c_str());
             }
             else
             {
@@ -674,8 +853,8 @@ namespace kolosal
                 };
                 failed_cancellations.push_back(fail_info);
 
-                ServerLogger::logWarning("[Thread %u] Failed to cancel download for model: %s",
-                                         std::this_thread::get_id(), model_id.c_str());
+                KOLOSAL_LOG_WARNING("[Thread %zu] Failed to cancel download for model: %s",
+                                         std::hash<std::thread::id>{}(std::this_thread::get_id()), model_id.c_str());
             }
         }
 
@@ -697,14 +876,14 @@ namespace kolosal
         };
 
         send_response(sock, 200, response.dump());
-        ServerLogger::logInfo("[Thread %u] Bulk cancellation completed: %d successful (%d startup, %d regular), %d failed",
-                              std::this_thread::get_id(), successful_cancellations, startup_cancellations,
+        KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Bulk cancellation completed: %d successful (%d startup, %d regular), %d failed",
+                              std::hash<std::thread::id>{}(std::this_thread::get_id()), successful_cancellations, startup_cancellations,
                               regular_cancellations, static_cast<int>(failed_cancellations.size()));
     }
 
     void DownloadsRoute::handlePauseDownload(SocketType sock, const std::string& model_id)
     {
-        ServerLogger::logInfo("[Thread %u] Received pause download request for model: %s", std::this_thread::get_id(), model_id.c_str());
+        KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Received pause download request for model: %s", std::hash<std::thread::id>{}(std::this_thread::get_id()), model_id.c_str());
 
         // Get the download manager and pause the download
         auto &download_manager = DownloadManager::getInstance();
@@ -712,7 +891,7 @@ namespace kolosal
 
         if (success)
         {
-            ServerLogger::logInfo("Successfully paused download for model: %s", model_id.c_str());
+            KOLOSAL_LOG_INFO("Successfully paused download for model: %s", model_id.c_str());
 
             json response = {
                 {"success", true},
@@ -726,7 +905,7 @@ namespace kolosal
         {
             std::string error_msg = "Could not pause download for model: " + model_id + 
                                    " (download may not exist or may not be in progress)";
-            ServerLogger::logWarning("%s", error_msg.c_str());
+            KOLOSAL_LOG_WARNING("%s", error_msg.c_str());
 
             json response = {
                 {"success", false},
@@ -740,7 +919,7 @@ namespace kolosal
 
     void DownloadsRoute::handleResumeDownload(SocketType sock, const std::string& model_id)
     {
-        ServerLogger::logInfo("[Thread %u] Received resume download request for model: %s", std::this_thread::get_id(), model_id.c_str());
+        KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Received resume download request for model: %s", std::hash<std::thread::id>{}(std::this_thread::get_id()), model_id.c_str());
 
         // Get the download manager and resume the download
         auto &download_manager = DownloadManager::getInstance();
@@ -748,7 +927,7 @@ namespace kolosal
 
         if (success)
         {
-            ServerLogger::logInfo("Successfully resumed download for model: %s", model_id.c_str());
+            KOLOSAL_LOG_INFO("Successfully resumed download for model: %s", model_id.c_str());
 
             json response = {
                 {"success", true},
@@ -762,7 +941,7 @@ namespace kolosal
         {
             std::string error_msg = "Could not resume download for model: " + model_id + 
                                    " (download may not exist or may not be paused)";
-            ServerLogger::logWarning("%s", error_msg.c_str());
+            KOLOSAL_LOG_WARNING("%s", error_msg.c_str());
 
             json response = {
                 {"success", false},
@@ -23,31 +23,35 @@ namespace kolosal
 
     bool EnginesRoute::match(const std::string &method, const std::string &path)
     {
-        bool matches = ((method == "GET" || method == "POST" || method == "PUT") && (path == "/engines" || path == "/v1/engines"));
-        
-        // Store matched method for use in handle()
-        if (matches)
-        {
-            matched_method_ = method;
-        }
-        
-        return matches;
+        return (method == "GET" || method == "POST" || method == "PUT") && (path == "/engines" || path == "/v1/engines");
+    }
+
+    std::vector<RoutePattern> EnginesRoute::patterns() const
+    {
+        return {
+            {"GET", "/engines"},
+            {"POST", "/engines"},
+            {"PUT", "/engines"},
+            {"GET", "/v1/engines"},
+            {"POST", "/v1/engines"},
+            {"PUT", "/v1/engines"}
+        };
     }
 
-    void EnginesRoute::handle(SocketType sock, const std::string &body)
+    void EnginesRoute::handle(SocketType sock, const RequestContext &request)
     {
         // Route to appropriate handler based on method
-        if (matched_method_ == "GET")
+        if (request.method == "GET")
         {
             handleGetEngines(sock);
         }
-        else if (matched_method_ == "POST")
+        else if (request.method == "POST")
         {
-            handleAddEngine(sock, body);
+            handleAddEngine(sock, request.body);
         }
-        else if (matched_method_ == "PUT")
+        else if (request.method == "PUT")
         {
-            handleSetDefaultEngine(sock, body);
+            handleSetDefaultEngine(sock, request.body);
         }
         else
         {
@@ -67,7 +71,7 @@ namespace kolosal
     {
         try
         {
-            ServerLogger::logDebug("[Thread %u] Received list inference engines request", std::this_thread::get_id());
+            KOLOSAL_LOG_REQUEST_DEBUG("[Thread %zu] Received list inference engines request", std::hash<std::thread::id>{}(std::this_thread::get_id()));
 
             // Get the NodeManager and list available inference engines
             auto &nodeManager = ServerAPI::instance().getNodeManager();
@@ -92,18 +96,46 @@ namespace kolosal
                 enginesList.push_back(engineInfo);
             }
 
+            // Load of the replicas behind each loaded model
+            json replicas = json::array();
+            for (const auto &replica : nodeManager.getReplicaStats())
+            {
+                replicas.push_back({
+                    {"engine_id", replica.engineId},
+                    {"replica", replica.index},
+                    {"main_gpu_id", replica.mainGpuId},
+                    {"active_jobs", replica.load.active_jobs},
+                    {"pending_tokens", replica.load.pending_tokens},
+                    {"routed_requests", replica.routedRequests}
+                });
+            }
+
+            // Queue limits and how many requests they turned away, for load balancers
+            json admission = json::array();
+            for (const auto &entry : nodeManager.getAdmissionStats())
+            {
+                admission.push_back({
+                    {"engine_id", entry.engineId},
+                    {"max_queued_jobs", entry.maxQueuedJobs},
+                    {"max_queued_tokens", entry.maxQueuedTokens},
+                    {"rejected_requests", entry.rejectedRequests}
+                });
+            }
+
             json response = {
                 {"inference_engines", enginesList},
                 {"default_engine", defaultEngine},
-                {"total_count", enginesList.size()}
+                {"total_count", enginesList.size()},
+                {"replicas", replicas},
+                {"admission", admission}
             };
 
             send_response(sock, 200, response.dump());
-            ServerLogger::logDebug("[Thread %u] Successfully listed %zu inference engines", std::this_thread::get_id(), enginesList.size());
+            KOLOSAL_LOG_REQUEST_DEBUG("[Thread %zu] Successfully listed %zu inference engines", std::hash<std::thread::id>{}(std::this_thread::get_id()), enginesList.size());
         }
         catch (const std::exception &ex)
         {
-            ServerLogger::logError("[Thread %u] Error handling list inference engines request: %s", std::this_thread::get_id(), ex.what());
+            KOLOSAL_LOG_ERROR("[Thread %zu] Error handling list inference engines request: %s", std::hash<std::thread::id>{}(std::this_thread::get_id()), ex.what());
 
             json jError = {
                 {"error", {
@@ -122,7 +154,7 @@ namespace kolosal
     {
         try
         {
-            ServerLogger::logDebug("[Thread %u] Received add inference engine request", std::this_thread::get_id());
+            KOLOSAL_LOG_REQUEST_DEBUG("[Thread %zu] Received add inference engine request", std::hash<std::thread::id>{}(std::this_thread::get_id()));
 
             // Parse JSON request body
             json requestData;
@@ -198,8 +230,8 @@ namespace kolosal
                         }}
                     };
                     send_response(sock, 200, response.dump());
-                    ServerLogger::logInfo("[Thread %u] Engine '%s' already exists in config - actual load status: %s", 
-                                        std::this_thread::get_id(), engineName.c_str(), actuallyLoaded ? "loaded" : "not loaded");
+                    KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Engine '%s' already exists in config - actual load status: %s", 
+                                        std::hash<std::thread::id>{}(std::this_thread::get_id()), engineName.c_str(), actuallyLoaded ? "loaded" : "not loaded");
                     return;
                 }
                 else if (existingEngine.name == engineName)
@@ -240,8 +272,8 @@ namespace kolosal
             config.inferenceEngines.push_back(newEngine);
 
             // Save updated config to file
-            ServerLogger::logInfo("About to save configuration after adding engine '%s'", engineName.c_str());
-            ServerLogger::logInfo("Current config file path in EnginesRoute: '%s'", config.getCurrentConfigFilePath().c_str());
+            KOLOSAL_LOG_INFO("About to save configuration after adding engine '%s'", engineName.c_str());
+            KOLOSAL_LOG_INFO("Current config file path in EnginesRoute: '%s'", config.getCurrentConfigFilePath().c_str());
             
             if (!config.saveToCurrentFile())
             {
@@ -265,7 +297,7 @@ namespace kolosal
             
             if (!nodeManager.reconfigureEngines(config.inferenceEngines))
             {
-                ServerLogger::logWarning("Failed to reconfigure inference engines after adding new engine");
+                KOLOSAL_LOG_WARNING("Failed to reconfigure inference engines after adding new engine");
             }
 
             // Prepare response
@@ -283,11 +315,11 @@ namespace kolosal
             };
 
             send_response(sock, 201, response.dump());
-            ServerLogger::logInfo("[Thread %u] Successfully added inference engine: %s", std::this_thread::get_id(), engineName.c_str());
+            KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Successfully added inference engine: %s", std::hash<std::thread::id>{}(std::this_thread::get_id()), engineName.c_str());
         }
         catch (const std::exception &ex)
         {
-            ServerLogger::logError("[Thread %u] Error handling add inference engine request: %s", std::this_thread::get_id(), ex.what());
+            KOLOSAL_LOG_ERROR("[Thread %zu] Error handling add inference engine request: %s", std::hash<std::thread::id>{}(std::this_thread::get_id()), ex.what());
 
             json jError = {
                 {"error", {
@@ -306,7 +338,7 @@ namespace kolosal
     {
         try
         {
-            ServerLogger::logDebug("[Thread %u] Received set default inference engine request", std::this_thread::get_id());
+            KOLOSAL_LOG_REQUEST_DEBUG("[Thread %zu] Received set default inference engine request", std::hash<std::thread::id>{}(std::this_thread::get_id()));
 
             // Parse JSON request body
             json requestData;
@@ -375,8 +407,8 @@ namespace kolosal
             config.defaultInferenceEngine = engineName;
 
             // Save updated config to file
-            ServerLogger::logInfo("About to save configuration after setting default engine to '%s'", engineName.c_str());
-            ServerLogger::logInfo("Current config file path in EnginesRoute: '%s'", config.getCurrentConfigFilePath().c_str());
+            KOLOSAL_LOG_INFO("About to save configuration after setting default engine to '%s'", engineName.c_str());
+            KOLOSAL_LOG_INFO("Current config file path in EnginesRoute: '%s'", config.getCurrentConfigFilePath().c_str());
             
             if (!config.saveToCurrentFile())
             {
@@ -399,11 +431,11 @@ namespace kolosal
             };
 
             send_response(sock, 200, response.dump());
-            ServerLogger::logInfo("[Thread %u] Successfully set default inference engine to: %s", std::this_thread::get_id(), engineName.c_str());
+            KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Successfully set default inference engine to: %s", std::hash<std::thread::id>{}(std::this_thread::get_id()), engineName.c_str());
         }
         catch (const std::exception &ex)
         {
-            ServerLogger::logError("[Thread %u] Error handling set default inference engine request: %s", std::this_thread::get_id(), ex.what());
+            KOLOSAL_LOG_ERROR("[Thread %zu] Error handling set default inference engine request: %s", std::hash<std::thread::id>{}(std::this_thread::get_id()), ex.what());
 
             json jError = {
                 {"error", {
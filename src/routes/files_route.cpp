@@ -0,0 +1,342 @@
+#include "kolosal/routes/files_route.hpp"
+#include "kolosal/routes/route_utils.hpp"
+#include "kolosal/batch_manager.hpp"
+#include "kolosal/request_body.hpp"
+#include "kolosal/utils.hpp"
+#include "kolosal/logger.hpp"
+#include <json.hpp>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+using json = nlohmann::json;
+
+namespace kolosal
+{
+
+namespace
+{
+    constexpr size_t kReadChunkBytes = 64 * 1024;
+    constexpr size_t kMaxFieldBytes = 64 * 1024;       // Form fields other than the file
+    constexpr size_t kMaxPartHeaderBytes = 16 * 1024;
+
+    // Value of a header parameter such as boundary=... or name="...", unquoted
+    std::string headerParam(const std::string& header, const std::string& name)
+    {
+        size_t pos = 0;
+        while ((pos = header.find(name + "=", pos)) != std::string::npos)
+        {
+            if (pos == 0 || header[pos - 1] == ' ' || header[pos - 1] == ';' || header[pos - 1] == '\t')
+                break;
+            pos += name.size() + 1;
+        }
+        if (pos == std::string::npos)
+            return std::string();
+        pos += name.size() + 1;
+        if (pos < header.size() && header[pos] == '"')
+        {
+            const size_t end = header.find('"', pos + 1);
+            return header.substr(pos + 1, end == std::string::npos ? std::string::npos : end - pos - 1);
+        }
+        const size_t end = header.find(';', pos);
+        std::string value = header.substr(pos, end == std::string::npos ? std::string::npos : end - pos);
+        while (!value.empty() && (value.back() == ' ' || value.back() == '\r'))
+            value.pop_back();
+        return value;
+    }
+
+    struct Upload
+    {
+        std::map<std::string, std::string> fields;
+        std::string filename;
+        uint64_t fileBytes = 0;
+        bool hasFile = false;
+    };
+
+    // Reads a multipart/form-data body as it arrives: small fields are kept, the "file" part is
+    // written to filePath. Returns "" or what is wrong with the body.
+    std::string readMultipart(std::istream& in, const std::string& boundary, const std::string& filePath,
+                              uint64_t maxFileBytes, Upload& upload)
+    {
+        const std::string delimiter = "\r\n--" + boundary;
+        // The body starts with the delimiter minus its CRLF; adding it makes every delimiter alike
+        std::string buffer = "\r\n";
+        bool eof = false;
+        auto fill = [&]()
+        {
+            if (eof)
+                return false;
+            char chunk[kReadChunkBytes];
+            in.read(chunk, sizeof(chunk));
+            const std::streamsize got = in.gcount();
+            if (got <= 0)
+            {
+                eof = true;
+                return false;
+            }
+            buffer.append(chunk, static_cast<size_t>(got));
+            return true;
+        };
+
+        // Preamble up to the first delimiter
+        size_t found;
+        while ((found = buffer.find(delimiter)) == std::string::npos)
+        {
+            if (buffer.size() > kMaxPartHeaderBytes || !fill())
+                return "Body is not multipart/form-data with the declared boundary";
+        }
+        buffer.erase(0, found + delimiter.size());
+
+        while (true)
+        {
+            // "--" closes the body, CRLF starts a part
+            while (buffer.size() < 2 && fill()) {}
+            if (buffer.compare(0, 2, "--") == 0)
+                break;
+            if (buffer.compare(0, 2, "\r\n") != 0)
+                return "Malformed multipart delimiter";
+            buffer.erase(0, 2);
+
+            size_t headersEnd;
+            while ((headersEnd = buffer.find("\r\n\r\n")) == std::string::npos)
+            {
+                if (buffer.size() > kMaxPartHeaderBytes || !fill())
+                    return "Malformed multipart part headers";
+            }
+            const std::string headers = buffer.substr(0, headersEnd);
+            buffer.erase(0, headersEnd + 4);
+
+            std::string disposition;
+            std::istringstream lines(headers);
+            std::string line;
+            while (std::getline(lines, line))
+            {
+                const size_t colon = line.find(':');
+                std::string name = line.substr(0, colon);
+                for (auto& c : name)
+                    c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+                if (colon != std::string::npos && name == "content-disposition")
+                    disposition = line.substr(colon + 1);
+            }
+            const std::string fieldName = headerParam(disposition, "name");
+            const bool isFile = fieldName == "file";
+
+            std::ofstream file;
+            std::string value;
+            if (isFile)
+            {
+                if (upload.hasFile)
+                    return "Only one file can be uploaded per request";
+                upload.hasFile = true;
+                upload.filename = headerParam(disposition, "filename");
+                file.open(filePath, std::ios::binary | std::ios::trunc);
+                if (!file)
+                    return "Cannot store the upload";
+            }
+
+            // Part content runs to the next delimiter; everything before a possible partial
+            // delimiter at the end of the buffer is safe to hand on
+            while (true)
+            {
+                const size_t end = buffer.find(delimiter);
+                const size_t ready = end != std::string::npos ? end
+                                     : buffer.size() >= delimiter.size() ? buffer.size() - delimiter.size() + 1 : 0;
+                if (isFile)
+                {
+                    file.write(buffer.data(), static_cast<std::streamsize>(ready));
+                    upload.fileBytes += ready;
+                    if (upload.fileBytes > maxFileBytes)
+                        return "File is larger than the " + std::to_string(maxFileBytes >> 20) + " MB limit";
+                }
+                else
+                {
+                    value.append(buffer, 0, ready);
+                    if (value.size() > kMaxFieldBytes)
+                        return "Form field '" + fieldName + "' is too large";
+                }
+                buffer.erase(0, ready);
+                if (end != std::string::npos)
+                {
+                    buffer.erase(0, delimiter.size());
+                    break;
+                }
+                if (!fill())
+                    return "Body ended inside a part";
+            }
+
+            if (isFile)
+            {
+                file.close();
+                if (!file)
+                    return "Cannot store the upload";
+            }
+            else if (!fieldName.empty())
+            {
+                upload.fields[fieldName] = value;
+            }
+        }
+        return std::string();
+    }
+
+    json fileList(const std::vector<BatchManager::File>& files)
+    {
+        json data = json::array();
+        for (const auto& file : files)
+            data.push_back(file.toJson());
+        return {{"object", "list"}, {"data", data}, {"has_more", false}};
+    }
+}
+
+bool FilesRoute::match(const std::string& method, const std::string& full_path)
+{
+    const std::string path = strip_query(full_path);
+    if (path == "/v1/files" || path == "/files")
+        return method == "GET" || method == "POST";
+    const bool item = path.rfind("/v1/files/", 0) == 0 || path.rfind("/files/", 0) == 0;
+    return item && (method == "GET" || method == "DELETE");
+}
+
+std::vector<RoutePattern> FilesRoute::patterns() const
+{
+    return {
+        {"POST", "/v1/files"},
+        {"GET", "/v1/files"},
+        {"GET", "/v1/files/{id}"},
+        {"GET", "/v1/files/{id}/content"},
+        {"DELETE", "/v1/files/{id}"},
+        {"POST", "/files"},
+        {"GET", "/files"},
+        {"GET", "/files/{id}"},
+        {"GET", "/files/{id}/content"},
+        {"DELETE", "/files/{id}"}
+    };
+}
+
+void FilesRoute::handle(SocketType sock, const RequestContext& request)
+{
+    try
+    {
+        auto& batches = BatchManager::instance();
+        if (!batches.enabled())
+        {
+            send_error_response(sock, 404, "The Batch API is disabled on this server", "not_found_error");
+            return;
+        }
+
+        // Another tenant's file answers 404, as a missing one does
+        const std::string owner = request_subject(request);
+        const std::string path = strip_query(request.path);
+        const std::string id = request.param("id");
+
+        if (request.method == "POST")
+        {
+            handleUpload(sock, request);
+        }
+        else if (id.empty())
+        {
+            send_response(sock, 200, fileList(batches.listFiles(owner, query_param(request.path, "purpose"))).dump());
+        }
+        else if (request.method == "DELETE")
+        {
+            if (!batches.deleteFile(owner, id))
+            {
+                send_error_response(sock, 404, "No such file: " + id, "not_found_error");
+                return;
+            }
+            send_response(sock, 200, json({{"id", id}, {"object", "file"}, {"deleted", true}}).dump());
+        }
+        else if (path.size() > 8 && path.compare(path.size() - 8, 8, "/content") == 0)
+        {
+            const std::string filePath = batches.filePath(owner, id);
+            std::error_code ec;
+            const uint64_t size = filePath.empty() ? 0 : std::filesystem::file_size(filePath, ec);
+            if (filePath.empty() || ec)
+            {
+                send_error_response(sock, 404, "No such file: " + id, "not_found_error");
+                return;
+            }
+            if (!send_file_response(sock, 200, filePath, 0, size, {{"Content-Type", "application/jsonl"}}, true))
+            {
+                KOLOSAL_LOG_WARNING("[Thread %zu] Transfer of file %s stopped early", std::hash<std::thread::id>{}(std::this_thread::get_id()), id.c_str());
+            }
+        }
+        else
+        {
+            auto file = batches.getFile(owner, id);
+            if (!file)
+            {
+                send_error_response(sock, 404, "No such file: " + id, "not_found_error");
+                return;
+            }
+            send_response(sock, 200, file->toJson().dump());
+        }
+    }
+    catch (const std::invalid_argument& ex)
+    {
+        send_error_response(sock, 409, ex.what());
+    }
+    catch (const std::exception& ex)
+    {
+        KOLOSAL_LOG_ERROR("[Thread %zu] Error handling files request: %s", std::hash<std::thread::id>{}(std::this_thread::get_id()), ex.what());
+        send_error_response(sock, 500, std::string("Internal server error: ") + ex.what(), "server_error");
+    }
+}
+
+void FilesRoute::handleUpload(SocketType sock, const RequestContext& request)
+{
+    auto& batches = BatchManager::instance();
+    auto contentType = request.headers.find("content-type");
+    const std::string boundary = contentType != request.headers.end() && contentType->second.find("multipart/form-data") != std::string::npos
+                                     ? headerParam(contentType->second, "boundary")
+                                     : std::string();
+    if (boundary.empty())
+    {
+        send_error_response(sock, 400, "Upload the file as multipart/form-data with 'file' and 'purpose' fields");
+        return;
+    }
+
+    const uint64_t maxBytes = batches.maxFileBytes();
+    const std::string staging = batches.stagingPath();
+    Upload upload;
+    std::string problem;
+    if (request.bodyStream)
+    {
+        // The multipart envelope adds little, so a body this much over the limit cannot fit
+        if (request.bodyStream->size() > maxBytes + kMaxFieldBytes)
+        {
+            send_error_response(sock, 413, "File is larger than the " + std::to_string(maxBytes >> 20) + " MB limit");
+            return;
+        }
+        problem = readMultipart(request.bodyStream->stream(), boundary, staging, maxBytes, upload);
+        if (problem.empty() && !request.bodyStream->ok())
+            problem = request.bodyStream->error();
+    }
+    else
+    {
+        std::istringstream body(request.body);
+        problem = readMultipart(body, boundary, staging, maxBytes, upload);
+    }
+
+    const std::string purpose = upload.fields.count("purpose") ? upload.fields["purpose"] : std::string();
+    if (problem.empty() && !upload.hasFile)
+        problem = "Missing 'file' field";
+    if (problem.empty() && purpose != "batch")
+        problem = "purpose must be 'batch'";
+    if (!problem.empty())
+    {
+        std::error_code ec;
+        std::filesystem::remove(staging, ec);
+        send_error_response(sock, problem.find("limit") != std::string::npos ? 413 : 400, problem);
+        return;
+    }
+
+    const BatchManager::File file = batches.addFile(request_subject(request), staging, upload.filename.empty() ? "upload.jsonl" : upload.filename, purpose);
+    KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Stored file %s (%s, %lld bytes)", std::hash<std::thread::id>{}(std::this_thread::get_id()),
+                          file.id.c_str(), file.filename.c_str(), static_cast<long long>(file.bytes));
+    send_response(sock, 200, file.toJson().dump());
+}
+
+} // namespace kolosal
@@ -1,8 +1,10 @@
 #include "kolosal/routes/health_status_route.hpp"
 #include "kolosal/utils.hpp"
-#include "kolosal/server_api.hpp"
-#include "kolosal/node_manager.h"
+#include "kolosal/health_monitor.hpp"
 #include "kolosal/logger.hpp"
+#include "kolosal/task_executor.hpp"
+#include "kolosal/gpu_detection.hpp"
+#include "kolosal/drain_manager.hpp"
 #include <json.hpp>
 #include <iostream>
 #include <thread>
@@ -15,24 +17,31 @@ namespace kolosal
 
     bool HealthStatusRoute::match(const std::string &method, const std::string &path)
     {
-        if ((method == "GET" || method == "OPTIONS") && 
-            (path == "/health" || path == "/v1/health" || path == "/status"))
-        {
-            current_method_ = method;
-            return true;
-        }
-        return false;
+        return (method == "GET" || method == "OPTIONS") &&
+               (path == "/health" || path == "/v1/health" || path == "/status");
+    }
+
+    std::vector<RoutePattern> HealthStatusRoute::patterns() const
+    {
+        return {
+            {"GET", "/health"},
+            {"OPTIONS", "/health"},
+            {"GET", "/v1/health"},
+            {"OPTIONS", "/v1/health"},
+            {"GET", "/status"},
+            {"OPTIONS", "/status"}
+        };
     }
 
-    void HealthStatusRoute::handle(SocketType sock, const std::string &body)
+    void HealthStatusRoute::handle(SocketType sock, const RequestContext &request)
     {        
         try
         {
             // Handle OPTIONS request for CORS preflight
-            if (current_method_ == "OPTIONS")
+            if (request.method == "OPTIONS")
             {
-                ServerLogger::logDebug("[Thread %u] Handling OPTIONS request for health endpoint", 
-                                       std::this_thread::get_id());
+                KOLOSAL_LOG_REQUEST_DEBUG("[Thread %zu] Handling OPTIONS request for health endpoint", 
+                                       std::hash<std::thread::id>{}(std::this_thread::get_id()));
                 
                 std::map<std::string, std::string> headers = {
                     {"Content-Type", "text/plain"},
@@ -46,46 +55,72 @@ namespace kolosal
                 return;
             }
 
-            ServerLogger::logDebug("[Thread %u] Received health status request", std::this_thread::get_id());
-
-            // Get the NodeManager and collect metrics
-            auto &nodeManager = ServerAPI::instance().getNodeManager();
-            auto engineIds = nodeManager.listEngineIds();
+            KOLOSAL_LOG_REQUEST_DEBUG("[Thread %zu] Received health status request", std::hash<std::thread::id>{}(std::this_thread::get_id()));
 
-            // Count loaded vs unloaded engines
-            int loadedCount = 0;
-            int unloadedCount = 0;
+            // Engine states from the background sample, so this never waits on NodeManager locks
+            auto health = HealthMonitor::instance().snapshot();
             json engineSummary = json::array();
-
-            for (const auto &engineId : engineIds)
+            for (const auto &engine : health->engines)
             {
-                // Check engine status without loading it (to avoid triggering lazy model loading)
-                auto [exists, isLoaded] = nodeManager.getEngineStatus(engineId);
-                if (isLoaded)
-                {
-                    loadedCount++;
-                }
-                else
+                json entry = {{"engine_id", engine.id},
+                              {"status", engine.loaded ? "loaded" : "unloaded"},
+                              {"ready", engine.loaded}};
+                if (!engine.startupState.empty())
                 {
-                    unloadedCount++;
+                    entry["startup_state"] = engine.startupState;
                 }
+                engineSummary.push_back(std::move(entry));
+            }
+            const size_t loadedCount = health->loadedEngines;
+            const size_t unloadedCount = health->engines.size() - loadedCount;
+
+            // Models still loading at startup have no engine yet; report them so callers can
+            // tell "not configured" apart from "not ready yet"
+            json startupModels = json::array();
+            for (const auto &[modelId, state] : health->startupModels)
+            {
+                startupModels.push_back({{"model_id", modelId}, {"state", state}});
+            }
+            const size_t startupPending = health->startupPending;
 
-                engineSummary.push_back({{"engine_id", engineId},
-                                         {"status", isLoaded ? "loaded" : "unloaded"}});
-            } // Get current timestamp
+            // Get current timestamp
             auto now = std::chrono::system_clock::now();
             auto time_t = std::chrono::system_clock::to_time_t(now);
             auto duration = now.time_since_epoch();
             auto millis = std::chrono::duration_cast<std::chrono::milliseconds>(duration).count();
 
+            auto tasks = TaskExecutor::instance().stats();
+
+            // Last sample from the GPU telemetry thread; reading it never touches the driver
+            json gpus = json::array();
+            for (const auto &gpu : GpuTelemetry::instance().devices())
+            {
+                json entry = {{"index", gpu.index}, {"name", gpu.name}, {"vendor", gpu.vendor}};
+                if (gpu.totalMemoryBytes > 0)
+                {
+                    entry["memory_total_mb"] = gpu.totalMemoryBytes >> 20;
+                    entry["memory_free_mb"] = gpu.freeMemoryBytes >> 20;
+                }
+                if (gpu.utilizationPercent >= 0)
+                    entry["utilization_percent"] = gpu.utilizationPercent;
+                if (gpu.temperatureC >= 0)
+                    entry["temperature_c"] = gpu.temperatureC;
+                gpus.push_back(std::move(entry));
+            }
+
+            // A draining node reports unhealthy so load balancers stop sending it traffic
+            const bool draining = DrainManager::instance().draining();
             json response = {
-                {"status", "healthy"},
+                {"status", draining ? "draining" : "healthy"},
                 {"timestamp", millis},
                 {"server", {
                                {"name", "Kolosal Inference Server"}, {"version", "1.0.0"}, {"uptime", "running"} // Could be enhanced with actual uptime
                            }},
-                {"node_manager", {{"total_engines", engineIds.size()}, {"loaded_engines", loadedCount}, {"unloaded_engines", unloadedCount}, {"autoscaling", "enabled"}}},
-                {"engines", engineSummary}};
+                {"node_manager", {{"total_engines", health->engines.size()}, {"loaded_engines", loadedCount}, {"unloaded_engines", unloadedCount}, {"autoscaling", "enabled"}}},
+                {"engines", engineSummary},
+                {"startup", {{"complete", startupPending == 0}, {"models_pending", startupPending}, {"models", startupModels}}},
+                {"background_tasks", {{"threads", tasks.threads}, {"busy", tasks.busy}, {"queued", tasks.queued}, {"max_queued", tasks.maxQueued}, {"completed", tasks.completed}, {"ran_inline", tasks.ranInline}}},
+                {"gpus", gpus}};
 
             std::map<std::string, std::string> headers = {
                 {"Content-Type", "application/json"},
@@ -94,13 +129,18 @@ namespace kolosal
                 {"Access-Control-Allow-Headers", "Content-Type, Authorization, X-API-Key"}
             };
 
-            send_response(sock, 200, response.dump(), headers);
-            ServerLogger::logDebug("[Thread %u] Successfully provided health status - %zu engines total (%d loaded, %d unloaded)",
-                                  std::this_thread::get_id(), engineIds.size(), loadedCount, unloadedCount);
+            if (draining)
+            {
+                response["drain"] = DrainManager::instance().status();
+            }
+
+            send_response(sock, draining ? 503 : 200, response.dump(), headers);
+            KOLOSAL_LOG_REQUEST_DEBUG("[Thread %zu] Successfully provided health status - %zu engines total (%zu loaded, %zu unloaded)",
+                                  std::hash<std::thread::id>{}(std::this_thread::get_id()), health->engines.size(), loadedCount, unloadedCount);
         }
         catch (const std::exception &ex)
         {
-            ServerLogger::logError("[Thread %u] Error handling health status request: %s", std::this_thread::get_id(), ex.what());
+            KOLOSAL_LOG_ERROR("[Thread %zu] Error handling health status request: %s", std::hash<std::thread::id>{}(std::this_thread::get_id()), ex.what());
 
             json jError = {{"error", {{"message", std::string("Server error: ") + ex.what()}, {"type", "server_error"}, {"param", nullptr}, {"code", nullptr}}}};
 
@@ -0,0 +1,159 @@
+#include "kolosal/routes/llm/batches_route.hpp"
+#include "kolosal/routes/route_utils.hpp"
+#include "kolosal/batch_manager.hpp"
+#include "kolosal/utils.hpp"
+#include "kolosal/logger.hpp"
+#include <json.hpp>
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+
+using json = nlohmann::json;
+
+namespace kolosal
+{
+
+namespace
+{
+    constexpr size_t kDefaultListLimit = 20;
+    constexpr size_t kMaxListLimit = 100;
+
+    void listBatches(SocketType sock, const std::string& owner, const std::string& path)
+    {
+        size_t limit = kDefaultListLimit;
+        const std::string limitParam = query_param(path, "limit");
+        if (!limitParam.empty())
+        {
+            try
+            {
+                limit = static_cast<size_t>(std::clamp(std::stoi(limitParam), 1, static_cast<int>(kMaxListLimit)));
+            }
+            catch (const std::exception&)
+            {
+                send_error_response(sock, 400, "limit must be an integer between 1 and 100");
+                return;
+            }
+        }
+
+        // One extra tells whether there is another page
+        auto batches = BatchManager::instance().listBatches(owner, query_param(path, "after"), limit + 1);
+        const bool hasMore = batches.size() > limit;
+        if (hasMore)
+            batches.resize(limit);
+
+        json data = json::array();
+        for (const auto& batch : batches)
+            data.push_back(batch.toJson());
+        json response = {
+            {"object", "list"},
+            {"data", data},
+            {"first_id", batches.empty() ? json(nullptr) : json(batches.front().id)},
+            {"last_id", batches.empty() ? json(nullptr) : json(batches.back().id)},
+            {"has_more", hasMore}
+        };
+        send_response(sock, 200, response.dump());
+    }
+
+    void createBatch(SocketType sock, const std::string& owner, const std::string& body)
+    {
+        if (body.empty())
+        {
+            send_error_response(sock, 400, "Request body is empty");
+            return;
+        }
+        json j;
+        try
+        {
+            j = json::parse(body);
+        }
+        catch (const json::parse_error& ex)
+        {
+            send_error_response(sock, 400, std::string("Invalid JSON: ") + ex.what());
+            return;
+        }
+
+        if (!j.is_object() || !j.contains("input_file_id") || !j["input_file_id"].is_string() ||
+            !j.contains("endpoint") || !j["endpoint"].is_string())
+        {
+            send_error_response(sock, 400, "input_file_id and endpoint are required");
+            return;
+        }
+        const std::string window = j.contains("completion_window") && j["completion_window"].is_string()
+                                       ? j["completion_window"].get<std::string>()
+                                       : "24h";
+        const json metadata = j.contains("metadata") && j["metadata"].is_object() ? j["metadata"] : json(nullptr);
+
+        const auto batch = BatchManager::instance().createBatch(owner, j["input_file_id"].get<std::string>(),
+                                                                j["endpoint"].get<std::string>(), window, metadata);
+        KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Created batch %s over file %s", std::hash<std::thread::id>{}(std::this_thread::get_id()),
+                              batch.id.c_str(), batch.input_file_id.c_str());
+        send_response(sock, 200, batch.toJson().dump());
+    }
+}
+
+bool BatchesRoute::match(const std::string& method, const std::string& full_path)
+{
+    const std::string path = strip_query(full_path);
+    if (path == "/v1/batches" || path == "/batches")
+        return method == "GET" || method == "POST";
+    const bool item = path.rfind("/v1/batches/", 0) == 0 || path.rfind("/batches/", 0) == 0;
+    return item && (method == "GET" || method == "POST");
+}
+
+std::vector<RoutePattern> BatchesRoute::patterns() const
+{
+    return {
+        {"POST", "/v1/batches"},
+        {"GET", "/v1/batches"},
+        {"GET", "/v1/batches/{id}"},
+        {"POST", "/v1/batches/{id}/cancel"},
+        {"POST", "/batches"},
+        {"GET", "/batches"},
+        {"GET", "/batches/{id}"},
+        {"POST", "/batches/{id}/cancel"}
+    };
+}
+
+void BatchesRoute::handle(SocketType sock, const RequestContext& request)
+{
+    try
+    {
+        auto& batches = BatchManager::instance();
+        if (!batches.enabled())
+        {
+            send_error_response(sock, 404, "The Batch API is disabled on this server", "not_found_error");
+            return;
+        }
+
+        // Another tenant's batch answers 404, as a missing one does
+        const std::string owner = request_subject(request);
+        const std::string id = request.param("id");
+        if (id.empty())
+        {
+            if (request.method == "POST")
+                createBatch(sock, owner, request.body);
+            else
+                listBatches(sock, owner, request.path);
+            return;
+        }
+
+        auto batch = request.method == "POST" ? batches.cancelBatch(owner, id) : batches.getBatch(owner, id);
+        if (!batch)
+        {
+            send_error_response(sock, 404, "No such batch: " + id, "not_found_error");
+            return;
+        }
+        send_response(sock, 200, batch->toJson().dump());
+    }
+    catch (const std::invalid_argument& ex)
+    {
+        send_error_response(sock, 400, ex.what());
+    }
+    catch (const std::exception& ex)
+    {
+        KOLOSAL_LOG_ERROR("[Thread %zu] Error handling batches request: %s", std::hash<std::thread::id>{}(std::this_thread::get_id()), ex.what());
+        send_error_response(sock, 500, std::string("Internal server error: ") + ex.what(), "server_error");
+    }
+}
+
+} // namespace kolosal
@@ -0,0 +1,312 @@
+#include "kolosal/routes/llm/chat_session_route.hpp"
+#include "kolosal/routes/route_utils.hpp"
+#include "kolosal/routes/llm/oai_parameters.hpp"
+#include "kolosal/websocket.hpp"
+#include "kolosal/server_api.hpp"
+#include "kolosal/node_manager.h"
+#include "kolosal/drain_manager.hpp"
+#include "kolosal/auth/auth_middleware.hpp"
+#include "kolosal/logger.hpp"
+#include "inference_interface.h"
+#include <json.hpp>
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+using json = nlohmann::json;
+
+namespace kolosal
+{
+
+namespace
+{
+    constexpr size_t kMaxMessageBytes = 4u << 20;
+    constexpr size_t kMaxInFlight = 8;                          // Concurrent requests per connection
+    constexpr auto kPingInterval = std::chrono::seconds(30);
+    constexpr auto kIdleTimeout = std::chrono::seconds(120);    // Nothing from the peer, not even a pong
+
+    // A request generating on one of the connection's jobs
+    struct ActiveRequest
+    {
+        json id;                                                // As the client sent it
+        std::shared_ptr<IInferenceEngine> engine;
+        int jobId = -1;
+        std::unique_ptr<auth::TokenQuotaCharge> quotaCharge;
+        int promptTokens = 0;
+        size_t completionTokens = 0;
+        bool cancelled = false;
+    };
+
+    // Thrown while starting a request; becomes the error frame for that id
+    struct RequestError : std::runtime_error
+    {
+        RequestError(std::string code, const std::string& message, int retryAfter = 0)
+            : std::runtime_error(message), code(std::move(code)), retryAfter(retryAfter) {}
+        std::string code;
+        int retryAfter;
+    };
+
+    std::string newSessionKey()
+    {
+        static thread_local std::mt19937_64 rng{std::random_device{}()};
+        std::ostringstream key;
+        key << "ws-" << std::hex << rng();
+        return key.str();
+    }
+
+    void sendError(WebSocket& ws, const json& id, const std::string& code, const std::string& message, int retryAfter = 0)
+    {
+        json frame = {{"type", "error"}, {"id", id}, {"code", code}, {"message", message}};
+        if (retryAfter > 0)
+            frame["retry_after"] = retryAfter;
+        ws.sendText(frame.dump());
+    }
+
+    // Submits one chat turn; the job's output is sent by pumpOutput()
+    ActiveRequest startRequest(const json& body, const std::string& sessionKey, const std::string& subject)
+    {
+        if (!body.is_object())
+            throw RequestError("invalid_request", "'request' must be a chat completion request object");
+
+        ChatCompletionRequest request;
+        request.from_json(body);
+        if (!request.validate())
+            throw RequestError("invalid_request", "Invalid request parameters");
+
+        ChatCompletionParameters params = buildChatCompletionParameters(request, body);
+        params.streaming = true;
+        if (params.sessionKey.empty())
+            params.sessionKey = sessionKey;
+
+        // Charge the tenant's token quota before any engine work is queued
+        auto& tokenQuota = ServerAPI::instance().getAuthMiddleware().getTokenQuota();
+        size_t promptEstimate = 0;
+        for (const auto& message : params.messages)
+            promptEstimate += auth::TokenQuota::estimateTokens(message.content) + 4; // Role and template markers
+        auto reservation = tokenQuota.reserve(subject, request.model,
+                                              promptEstimate + static_cast<size_t>(std::max(params.maxNewTokens, 0)));
+        if (!reservation.allowed)
+            throw RequestError("token_quota_exceeded", "Token quota exceeded, retry later",
+                               static_cast<int>(reservation.retryAfter.count()));
+
+        ActiveRequest active;
+        active.quotaCharge = std::make_unique<auth::TokenQuotaCharge>(tokenQuota, std::move(reservation));
+        ServerAPI::instance().getAuthMiddleware().getTenantShares().assign(subject, params);
+
+        NodeManager::Admission admission;
+        active.engine = ServerAPI::instance().getNodeManager().getEngine(request.model, admission,
+                                                                         static_cast<int>(promptEstimate + static_cast<size_t>(std::max(params.maxNewTokens, 0))));
+        if (admission.rejected)
+            throw RequestError("model_overloaded", "Model '" + request.model + "' is at capacity, retry later",
+                               admission.retryAfterSeconds);
+        if (!active.engine)
+            throw RequestError("model_not_found", "Model '" + request.model + "' not found or could not be loaded");
+
+        active.jobId = active.engine->submitChatCompletionsJob(params);
+        if (active.jobId < 0)
+            throw RequestError("job_failed", "Failed to submit job to inference engine");
+        active.quotaCharge->setPromptTokens(promptEstimate);
+        return active;
+    }
+
+    // Sends what each job decoded since the last pass; finished requests are answered and dropped.
+    // Jobs are visited in turn so none of them stalls behind another.
+    void pumpOutput(WebSocket& ws, std::map<std::string, ActiveRequest>& active)
+    {
+        const int waitMs = active.size() == 1 ? 20 : 5;
+        for (auto it = active.begin(); it != active.end() && ws.isOpen();)
+        {
+            ActiveRequest& request = it->second;
+            CompletionDelta delta;
+            const bool known = request.engine->waitForJobOutput(request.jobId, delta, waitMs);
+            if (known)
+            {
+                if (delta.prompt_token_count > 0)
+                {
+                    request.promptTokens = delta.prompt_token_count;
+                    request.quotaCharge->setPromptTokens(static_cast<size_t>(delta.prompt_token_count));
+                }
+                request.completionTokens += delta.tokens.size();
+                request.quotaCharge->addGeneratedTokens(delta.tokens.size());
+                if (!delta.text.empty())
+                    ws.sendText(json{{"type", "delta"}, {"id", request.id}, {"text", delta.text}}.dump());
+            }
+            if (known && !delta.finished)
+            {
+                ++it;
+                continue;
+            }
+
+            if (request.engine->hasJobError(request.jobId) && !request.cancelled)
+            {
+                sendError(ws, request.id, "job_failed", request.engine->getJobError(request.jobId));
+            }
+            else
+            {
+                json done = {{"type", "done"},
+                             {"id", request.id},
+                             {"finish_reason", request.cancelled ? "cancelled" : "stop"},
+                             {"usage", {{"prompt_tokens", request.promptTokens},
+                                        {"completion_tokens", request.completionTokens},
+                                        {"total_tokens", request.promptTokens + static_cast<int>(request.completionTokens)}}}};
+                if (known)
+                {
+                    done["tps"] = delta.tps;
+                    done["ttft_ms"] = delta.ttft;
+                }
+                ws.sendText(done.dump());
+            }
+            request.engine->releaseJob(request.jobId);
+            it = active.erase(it);
+        }
+    }
+}
+
+bool ChatSessionRoute::match(const std::string& method, const std::string& path)
+{
+    return method == "GET" && path.substr(0, path.find('?')) == "/v1/chat/sessions";
+}
+
+std::vector<RoutePattern> ChatSessionRoute::patterns() const
+{
+    return {{"GET", "/v1/chat/sessions"}};
+}
+
+void ChatSessionRoute::stop()
+{
+    stopping_ = true;
+}
+
+void ChatSessionRoute::handle(SocketType sock, const RequestContext& request)
+{
+    if (!WebSocket::upgrade(sock, request.headers))
+        return;
+
+    WebSocket ws(sock, kMaxMessageBytes);
+    const std::string subject = auth::TokenQuota::subjectFor(
+        ServerAPI::instance().getAuthMiddleware().extractApiKey(request.headers), request.clientIP);
+    std::string sessionKey = query_param(request.path, "session_id");
+    if (sessionKey.empty())
+        sessionKey = newSessionKey();
+
+    KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Chat session %s opened from %s",
+                          std::hash<std::thread::id>{}(std::this_thread::get_id()), sessionKey.c_str(), request.clientIP.c_str());
+    ws.sendText(json{{"type", "session"}, {"session_id", sessionKey}}.dump());
+
+    std::map<std::string, ActiveRequest> active;
+    auto lastPing = std::chrono::steady_clock::now();
+    while (ws.isOpen())
+    {
+        const bool draining = DrainManager::instance().draining();
+        if (stopping_ || (draining && active.empty()))
+        {
+            ws.close(WebSocket::kGoingAway, stopping_ ? "Server is stopping" : "Server is draining");
+            break;
+        }
+
+        // Block on the socket only while nothing is generating
+        std::string message;
+        const WebSocket::Status status = ws.receive(message, active.empty() ? 1000 : 0);
+        if (status == WebSocket::Status::Closed)
+            break;
+
+        if (status == WebSocket::Status::Message)
+        {
+            json frame = json::parse(message, nullptr, false);
+            if (frame.is_discarded() || !frame.is_object())
+            {
+                sendError(ws, nullptr, "invalid_json", "Messages must be JSON objects");
+                continue;
+            }
+            const json id = frame.contains("id") ? frame["id"] : json();
+            const std::string type = frame.value("type", "");
+            if (!id.is_string() && !id.is_number_integer())
+            {
+                sendError(ws, id, "invalid_request", "Every message needs a string or integer 'id'");
+                continue;
+            }
+            const std::string key = id.is_string() ? id.get<std::string>() : id.dump();
+
+            if (type == "cancel")
+            {
+                auto it = active.find(key);
+                if (it == active.end())
+                {
+                    sendError(ws, id, "unknown_request", "No request with this id is running");
+                    continue;
+                }
+                // The done frame follows once the engine has stopped the job
+                it->second.cancelled = true;
+                it->second.engine->stopJob(it->second.jobId);
+            }
+            else if (type == "chat")
+            {
+                if (active.count(key))
+                {
+                    sendError(ws, id, "duplicate_id", "A request with this id is already running");
+                    continue;
+                }
+                if (active.size() >= kMaxInFlight)
+                {
+                    sendError(ws, id, "too_many_requests",
+                              "At most " + std::to_string(kMaxInFlight) + " requests may run at once per session");
+                    continue;
+                }
+                if (draining)
+                {
+                    sendError(ws, id, "node_draining", "Server is draining; reconnect to continue");
+                    continue;
+                }
+                try
+                {
+                    ActiveRequest started = startRequest(frame.contains("request") ? frame["request"] : json(), sessionKey, subject);
+                    started.id = id;
+                    active.emplace(key, std::move(started));
+                }
+                catch (const RequestError& ex)
+                {
+                    sendError(ws, id, ex.code, ex.what(), ex.retryAfter);
+                }
+                catch (const std::exception& ex)
+                {
+                    sendError(ws, id, "invalid_request", ex.what());
+                }
+            }
+            else
+            {
+                sendError(ws, id, "invalid_request", "Unknown message type '" + type + "'");
+            }
+        }
+
+        if (!active.empty())
+            pumpOutput(ws, active);
+
+        // Keep intermediaries from dropping a quiet connection, and drop peers that stopped answering
+        const auto now = std::chrono::steady_clock::now();
+        if (now - ws.lastReceived() > kIdleTimeout && active.empty())
+        {
+            ws.close(WebSocket::kGoingAway, "Idle timeout");
+            break;
+        }
+        if (now - lastPing >= kPingInterval && now - ws.lastReceived() >= kPingInterval)
+        {
+            ws.ping();
+            lastPing = now;
+        }
+    }
+
+    // Nobody is left to read what is still generating
+    for (auto& entry : active)
+    {
+        entry.second.engine->stopJob(entry.second.jobId);
+        entry.second.engine->releaseJob(entry.second.jobId);
+    }
+    KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Chat session %s closed", std::hash<std::thread::id>{}(std::this_thread::get_id()), sessionKey.c_str());
+}
+
+} // namespace kolosal
@@ -1,8 +1,14 @@
 #include "kolosal/routes/llm/completion_route.hpp"
+#include "kolosal/routes/route_utils.hpp"
+#include "kolosal/routes/llm/oai_parameters.hpp"
 #include "kolosal/utils.hpp"
 #include "kolosal/server_api.hpp"
 #include "kolosal/logger.hpp"
 #include "kolosal/node_manager.h"
+#include "kolosal/tracing.hpp"
+#include "kolosal/cluster_router.hpp"
+#include "kolosal/drain_manager.hpp"
+#include "kolosal/auth/auth_middleware.hpp"
 #include "kolosal/models/chat_message_model.hpp"
 
 #include "inference_interface.h"
@@ -15,6 +21,7 @@
 #include <chrono>
 #include <mutex>
 #include <memory>
+#include <algorithm>
 
 using json = nlohmann::json;
 
@@ -22,19 +29,45 @@ namespace kolosal
 {
     namespace
     {
+        // Waits for a non-streaming job, polling the connection; if the client goes away the
+        // job is stopped and released and false is returned, as there is nobody to answer
+        bool waitUnlessDisconnected(SocketType sock, IInferenceEngine &engine, int jobId)
+        {
+            while (!engine.waitForJob(jobId, 500))
+            {
+                if (client_disconnected(sock))
+                {
+                    KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Client disconnected, cancelling job %d", std::hash<std::thread::id>{}(std::this_thread::get_id()), jobId);
+                    engine.stopJob(jobId);
+                    engine.releaseJob(jobId);
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        // 503 for a request turned away by admission control, so clients and load balancers retry elsewhere
+        void sendOverloaded(SocketType sock, const std::string &model, const NodeManager::Admission &admission)
+        {
+            json jError = {{"error", {{"message", "Model '" + model + "' is at capacity, retry later"},
+                                      {"type", "server_overloaded"}, {"param", nullptr}, {"code", "model_overloaded"}}}};
+            send_response(sock, 503, jError.dump(),
+                          {{"Content-Type", "application/json"}, {"Retry-After", std::to_string(admission.retryAfterSeconds)}});
+        }
+
         // Helper: finalize precedence between grammar & jsonSchema and log choice
         template <typename P>
         void finalizeStructuredOutput(P &params, const char *context) {
             // Precedence: explicit grammar overrides jsonSchema-derived grammar
             if (!params.grammar.empty()) {
                 if (!params.jsonSchema.empty()) {
-                    ServerLogger::logInfo("[%s] Both grammar & jsonSchema provided; grammar takes precedence", context);
+                    KOLOSAL_LOG_INFO("[%s] Both grammar & jsonSchema provided; grammar takes precedence", context);
                     // Keep jsonSchema string for potential future reference but engine will ignore because grammar set
                 } else {
-                    ServerLogger::logInfo("[%s] Using provided grammar (chars=%zu)", context, params.grammar.size());
+                    KOLOSAL_LOG_INFO("[%s] Using provided grammar (chars=%zu)", context, params.grammar.size());
                 }
             } else if (!params.jsonSchema.empty()) {
-                ServerLogger::logInfo("[%s] Using provided JSON schema (chars=%zu)", context, params.jsonSchema.size());
+                KOLOSAL_LOG_INFO("[%s] Using provided JSON schema (chars=%zu)", context, params.jsonSchema.size());
             }
         }
         /**
@@ -95,6 +128,40 @@ namespace kolosal
             if (j.contains("seqId") && j["seqId"].is_number_integer()) {
                 params.seqId = j["seqId"].get<int>();
             }
+
+            if (j.contains("sessionKey") && j["sessionKey"].is_string()) {
+                params.sessionKey = j["sessionKey"].get<std::string>();
+            }
+
+            if (j.contains("priority") && j["priority"].is_number_integer()) {
+                params.priority = j["priority"].get<int>();
+            }
+
+            if (j.contains("maxContext") && j["maxContext"].is_number_integer()) {
+                params.maxContext = j["maxContext"].get<int>();
+            }
+
+            if (j.contains("deadlineMs") && j["deadlineMs"].is_number_integer()) {
+                params.deadlineMs = j["deadlineMs"].get<int>();
+            }
+
+            if (j.contains("promptLookup") && j["promptLookup"].is_boolean()) {
+                params.promptLookup = j["promptLookup"].get<bool>() ? 1 : 0;
+            }
+
+            if (j.contains("loraAdapter") && j["loraAdapter"].is_string()) {
+                params.loraAdapter = j["loraAdapter"].get<std::string>();
+            }
+
+            if (j.contains("stop")) {
+                if (j["stop"].is_string()) {
+                    params.stop.push_back(j["stop"].get<std::string>());
+                } else if (j["stop"].is_array()) {
+                    for (const auto &stop : j["stop"]) {
+                        if (stop.is_string()) params.stop.push_back(stop.get<std::string>());
+                    }
+                }
+            }
             
             if (j.contains("tools") && j["tools"].is_string()) {
                 params.tools = j["tools"].get<std::string>();
@@ -203,6 +270,40 @@ namespace kolosal
                 params.seqId = j["seqId"].get<int>();
             }
 
+            if (j.contains("sessionKey") && j["sessionKey"].is_string()) {
+                params.sessionKey = j["sessionKey"].get<std::string>();
+            }
+
+            if (j.contains("priority") && j["priority"].is_number_integer()) {
+                params.priority = j["priority"].get<int>();
+            }
+
+            if (j.contains("maxContext") && j["maxContext"].is_number_integer()) {
+                params.maxContext = j["maxContext"].get<int>();
+            }
+
+            if (j.contains("deadlineMs") && j["deadlineMs"].is_number_integer()) {
+                params.deadlineMs = j["deadlineMs"].get<int>();
+            }
+
+            if (j.contains("promptLookup") && j["promptLookup"].is_boolean()) {
+                params.promptLookup = j["promptLookup"].get<bool>() ? 1 : 0;
+            }
+
+            if (j.contains("loraAdapter") && j["loraAdapter"].is_string()) {
+                params.loraAdapter = j["loraAdapter"].get<std::string>();
+            }
+
+            if (j.contains("stop")) {
+                if (j["stop"].is_string()) {
+                    params.stop.push_back(j["stop"].get<std::string>());
+                } else if (j["stop"].is_array()) {
+                    for (const auto &stop : j["stop"]) {
+                        if (stop.is_string()) params.stop.push_back(stop.get<std::string>());
+                    }
+                }
+            }
+
             // Grammar and JSON schema support
             if (j.contains("grammar") && j["grammar"].is_string()) {
                 params.grammar = j["grammar"].get<std::string>();
@@ -263,6 +364,24 @@ namespace kolosal
             response["prompt_tokens"] = result.prompt_token_count;
             response["completion_tokens"] = static_cast<int>(result.tokens.size());
             response["total_tokens"] = response["prompt_tokens"].get<int>() + response["completion_tokens"].get<int>();
+
+            if (result.draft_token_count > 0) {
+                response["draft_tokens"] = result.draft_token_count;
+                response["draft_accepted_tokens"] = result.draft_accepted_count;
+                response["draft_acceptance_rate"] = result.draft_acceptance_rate;
+            }
+
+            const JobTiming& timing = result.timing;
+            response["timings"] = {
+                {"queue_ms", timing.queue_ms},
+                {"tokenize_ms", timing.tokenize_ms},
+                {"grammar_ms", timing.grammar_ms},
+                {"session_ms", timing.session_ms},
+                {"prefill_ms", timing.prefill_ms},
+                {"decode_ms", timing.decode_ms},
+                {"sample_ms", timing.sample_ms},
+                {"decode_steps", timing.decode_steps}
+            };
             
             return response;
         }
@@ -282,26 +401,53 @@ namespace kolosal
                  path == "/v1/inference/chat/completions" || path == "/inference/chat/completions"));
     }
 
-    void CompletionRoute::handle(SocketType sock, const std::string& body)
+    std::vector<RoutePattern> CompletionRoute::patterns() const
+    {
+        return {
+            {"POST", "/v1/inference/completions"},
+            {"POST", "/inference/completions"},
+            {"POST", "/v1/inference/chat/completions"},
+            {"POST", "/inference/chat/completions"}
+        };
+    }
+
+    void CompletionRoute::handle(SocketType sock, const RequestContext& request)
     {
         try
         {
             // Check for empty body
-            if (body.empty())
+            if (request.body.empty())
             {
                 throw std::invalid_argument("Request body is empty");
             }
 
-            auto j = json::parse(body);
+            auto j = json::parse(request.body);
+
+            // In a cluster, the node holding this conversation's KV cache serves it
+            if (ClusterRouter::instance().forward(sock, request, j))
+            {
+                return;
+            }
+
+            // A draining node takes no new work; a peer that has not seen the drain yet is still served
+            if (DrainManager::instance().draining() && !request.headers.count("x-kolosal-forwarded"))
+            {
+                DrainManager::instance().sendDraining(sock);
+                return;
+            }
+
+            // Tenant charged for the tokens this request uses
+            const std::string subject = auth::TokenQuota::subjectFor(
+                ServerAPI::instance().getAuthMiddleware().extractApiKey(request.headers), request.clientIP);
             
             // Determine the type of request based on the presence of 'messages' field in the JSON
             if (j.contains("messages"))
             {
-                handleChatCompletion(sock, body);
+                handleChatCompletion(sock, request.body, subject);
             }
             else if (j.contains("prompt"))
             {
-                handleTextCompletion(sock, body);
+                handleTextCompletion(sock, request.body, subject);
             }
             else
             {
@@ -310,13 +456,13 @@ namespace kolosal
         }
         catch (const json::parse_error &ex)
         {
-            ServerLogger::logError("JSON parsing error: %s", ex.what());
+            KOLOSAL_LOG_ERROR("JSON parsing error: %s", ex.what());
             json jError = {{"error", {{"message", std::string("Invalid JSON: ") + ex.what()}, {"type", "invalid_request_error"}}}};
             send_response(sock, 400, jError.dump());
         }
         catch (const std::exception &ex)
         {
-            ServerLogger::logError("Error handling completion request: %s", ex.what());
+            KOLOSAL_LOG_ERROR("Error handling completion request: %s", ex.what());
             json jError = {{"error", {{"message", std::string("Error: ") + ex.what()}, {"type", "invalid_request_error"}}}};
             send_response(sock, 400, jError.dump());
         }
@@ -332,12 +478,12 @@ namespace kolosal
         return (path == "/v1/inference/chat/completions" || path == "/inference/chat/completions");
     }
 
-    void CompletionRoute::handleChatCompletion(SocketType sock, const std::string& body)
+    void CompletionRoute::handleChatCompletion(SocketType sock, const std::string& body, const std::string& subject)
     {
         try
         {
             auto j = json::parse(body);
-            ServerLogger::logInfo("[Thread %u] Received inference chat completion request", std::this_thread::get_id());
+            KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Received inference chat completion request", std::hash<std::thread::id>{}(std::this_thread::get_id()));
 
             // Extract model name (required field)
             std::string modelName;
@@ -350,17 +496,38 @@ namespace kolosal
             // Parse the chat completion parameters (includes structured output precedence & logging)
             ChatCompletionParameters params = parseChatCompletionParameters(j);
 
-            ServerLogger::logInfo("[Thread %u] Processing chat completion for model '%s' with seqId: %d", 
-                                      std::this_thread::get_id(), modelName.c_str(), params.seqId);
+            KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Processing chat completion for model '%s' with seqId: %d", 
+                                      std::hash<std::thread::id>{}(std::this_thread::get_id()), modelName.c_str(), params.seqId);
 
             if (!params.isValid())
             {
                 throw std::invalid_argument("Invalid chat completion parameters");
             }
 
+            // Charge the tenant's token quota before any engine work is queued
+            auto &tokenQuota = ServerAPI::instance().getAuthMiddleware().getTokenQuota();
+            const size_t promptEstimate = estimatePromptTokens(params);
+            auto reservation = tokenQuota.reserve(subject, modelName,
+                                                  promptEstimate + static_cast<size_t>(std::max(params.maxNewTokens, 0)));
+            if (!reservation.allowed)
+            {
+                send_quota_exceeded(sock, reservation);
+                return;
+            }
+            auth::TokenQuotaCharge quotaCharge(tokenQuota, std::move(reservation));
+            ServerAPI::instance().getAuthMiddleware().getTenantShares().assign(subject, params);
+
             // Get the NodeManager and inference engine
             auto& nodeManager = ServerAPI::instance().getNodeManager();
-            auto engine = nodeManager.getEngine(modelName);
+            NodeManager::Admission admission;
+            auto engine = nodeManager.getEngine(modelName, admission,
+                                                static_cast<int>(promptEstimate + static_cast<size_t>(std::max(params.maxNewTokens, 0))));
+
+            if (admission.rejected)
+            {
+                sendOverloaded(sock, modelName, admission);
+                return;
+            }
 
             if (!engine)
             {
@@ -370,8 +537,8 @@ namespace kolosal
             if (params.streaming)
             {
                 // Handle streaming response
-                ServerLogger::logInfo("[Thread %u] Processing streaming inference chat completion request for model '%s'",
-                                      std::this_thread::get_id(), modelName.c_str());
+                KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Processing streaming inference chat completion request for model '%s'",
+                                      std::hash<std::thread::id>{}(std::this_thread::get_id()), modelName.c_str());
 
                 // Submit job to inference engine
                 int jobId = engine->submitChatCompletionsJob(params);
@@ -381,60 +548,38 @@ namespace kolosal
                     throw std::runtime_error("Failed to submit chat completion job to inference engine");
                 }
 
+                quotaCharge.setPromptTokens(promptEstimate);
+
                 // Start the streaming response with proper SSE headers
                 begin_streaming_response(sock, 200, {{"Content-Type", "text/event-stream"}, {"Cache-Control", "no-cache"}});
 
-                bool firstTokenRecorded = false;
-                std::string previousText = "";
-                size_t lastTokenCount = 0;
-
-                // Poll for results until job is finished
-                while (!engine->isJobFinished(jobId))
+                // Stream each delta as soon as the engine decodes it
+                CompletionDelta delta;
+                bool disconnected = false;
+                while (engine->waitForJobOutput(jobId, delta, 1000))
                 {
-                    // Check for errors
-                    if (engine->hasJobError(jobId))
-                    {
-                        std::string error = engine->getJobError(jobId);
-                        ServerLogger::logError("[Thread %u] Inference job error: %s", std::this_thread::get_id(), error.c_str());
-
-                        // Send error as final chunk
-                        json errorResponse;
-                        errorResponse["error"] = error;
-                        errorResponse["text"] = "";
-                        errorResponse["tokens"] = json::array();
-                        errorResponse["tps"] = 0.0f;
-                        errorResponse["ttft"] = 0.0f;
+                    if (delta.prompt_token_count > 0)
+                        quotaCharge.setPromptTokens(static_cast<size_t>(delta.prompt_token_count));
+                    quotaCharge.addGeneratedTokens(delta.tokens.size());
 
-                        std::string sseData = "data: " + errorResponse.dump() + "\n\n";
-                        send_stream_chunk(sock, StreamChunk(sseData, false));
+                    // Stop generating for a client that has gone away
+                    if (client_disconnected(sock))
+                    {
+                        KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Client disconnected, stopping job %d", std::hash<std::thread::id>{}(std::this_thread::get_id()), jobId);
+                        engine->stopJob(jobId);
+                        disconnected = true;
                         break;
                     }
 
-                    // Get current result
-                    CompletionResult result = engine->getJobResult(jobId);
-                    
-                    // Check if we have new content to stream
-                    if (result.text.length() > previousText.length())
+                    if (!delta.text.empty() || !delta.tokens.empty())
                     {
-                        // Record first token if this is the first output
-                        if (!firstTokenRecorded && result.text.length() > 0)
-                        {
-                            firstTokenRecorded = true;
-                        }
-
-                        std::string newContent = result.text.substr(previousText.length());
-
                         // Create partial result for streaming
                         CompletionResult partialResult;
-                        partialResult.text = newContent;
-                        partialResult.tps = result.tps;
-                        partialResult.ttft = result.ttft;
-                        // Only include new tokens since last update based on token vector growth
-                        if (result.tokens.size() > lastTokenCount) {
-                            auto startIt = result.tokens.begin() + static_cast<long>(lastTokenCount);
-                            partialResult.tokens.assign(startIt, result.tokens.end());
-                        }
-                        partialResult.prompt_token_count = result.prompt_token_count;
+                        partialResult.text = delta.text;
+                        partialResult.tokens = delta.tokens;
+                        partialResult.tps = delta.tps;
+                        partialResult.ttft = delta.ttft;
+                        partialResult.prompt_token_count = delta.prompt_token_count;
 
                         json streamResponse = completionResultToJson(partialResult);
                         streamResponse["partial"] = true;
@@ -442,36 +587,45 @@ namespace kolosal
                         // Format as SSE data message
                         std::string sseData = "data: " + streamResponse.dump() + "\n\n";
                         send_stream_chunk(sock, StreamChunk(sseData, false));
-
-                        previousText = result.text;
-                        lastTokenCount = result.tokens.size();
                     }
 
-                    // Brief sleep to avoid busy waiting
-                    std::this_thread::sleep_for(std::chrono::milliseconds(50));
-                }
+                    if (delta.hasError)
+                    {
+                        KOLOSAL_LOG_ERROR("[Thread %zu] Inference job error: %s", std::hash<std::thread::id>{}(std::this_thread::get_id()), delta.errorMessage.c_str());
 
-                // Send the final [DONE] marker to indicate completion
-                send_stream_chunk(sock, StreamChunk("data: [DONE]\n\n", false));
+                        // Send error as final chunk
+                        json errorResponse;
+                        errorResponse["error"] = delta.errorMessage;
+                        errorResponse["text"] = "";
+                        errorResponse["tokens"] = json::array();
+                        errorResponse["tps"] = 0.0f;
+                        errorResponse["ttft"] = 0.0f;
 
-                // Then terminate the stream
-                send_stream_chunk(sock, StreamChunk("", true));
+                        std::string sseData = "data: " + errorResponse.dump() + "\n\n";
+                        send_stream_chunk(sock, StreamChunk(sseData, false));
+                    }
 
-                if (engine->hasJobError(jobId))
-                {
+                    if (delta.finished)
+                        break;
                 }
-                else
+
+                // Queue the final [DONE] marker; it goes out together with the stream terminator
+                if (!disconnected)
                 {
+                    send_stream_chunk(sock, StreamChunk("data: [DONE]\n\n", false), false);
+                    send_stream_chunk(sock, StreamChunk("", true));
                 }
 
-                ServerLogger::logInfo("[Thread %u] Completed streaming response for job %d",
-                                      std::this_thread::get_id(), jobId);
+                engine->releaseJob(jobId);
+
+                KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Completed streaming response for job %d",
+                                      std::hash<std::thread::id>{}(std::this_thread::get_id()), jobId);
             }
             else
             {
                 // Handle normal (non-streaming) response
-                ServerLogger::logInfo("[Thread %u] Processing non-streaming inference chat completion request for model '%s'",
-                                      std::this_thread::get_id(), modelName.c_str());
+                KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Processing non-streaming inference chat completion request for model '%s'",
+                                      std::hash<std::thread::id>{}(std::this_thread::get_id()), modelName.c_str());
 
                 // Submit job to inference engine
                 int jobId = engine->submitChatCompletionsJob(params);
@@ -481,8 +635,13 @@ namespace kolosal
                     throw std::runtime_error("Failed to submit chat completion job to inference engine");
                 }
 
+                quotaCharge.setPromptTokens(promptEstimate);
+
                 // Wait for job completion
-                engine->waitForJob(jobId);
+                if (!waitUnlessDisconnected(sock, *engine, jobId))
+                {
+                    return;
+                }
 
                 // Check for errors
                 if (engine->hasJobError(jobId))
@@ -493,20 +652,30 @@ namespace kolosal
 
                 // Get the final result
                 CompletionResult result = engine->getJobResult(jobId);
+                if (result.prompt_token_count > 0)
+                    quotaCharge.setPromptTokens(static_cast<size_t>(result.prompt_token_count));
+                quotaCharge.addGeneratedTokens(result.tokens.size());
+                tracing::record_job(result.timing, jobId);
 
                 // Convert result to JSON and send response
-                json response = completionResultToJson(result);
-                send_response(sock, 200, response.dump());
+                std::string payload;
+                {
+                    tracing::Span serializeSpan("serialize");
+                    payload = completionResultToJson(result).dump();
+                }
+                send_response(sock, 200, payload);
 
-                ServerLogger::logInfo("[Thread %u] Completed non-streaming response for job %d (%.2f tokens/sec)",
-                                      std::this_thread::get_id(), jobId, result.tps);
+                engine->releaseJob(jobId);
+
+                KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Completed non-streaming response for job %d (%.2f tokens/sec)",
+                                      std::hash<std::thread::id>{}(std::this_thread::get_id()), jobId, result.tps);
             }
         }
         catch (const json::exception& ex)
         {
             // Specifically handle JSON parsing errors
-            ServerLogger::logError("[Thread %u] JSON parsing error: %s",
-                                   std::this_thread::get_id(), ex.what());
+            KOLOSAL_LOG_ERROR("[Thread %zu] JSON parsing error: %s",
+                                   std::hash<std::thread::id>{}(std::this_thread::get_id()), ex.what());
 
             json jError = {{"error", {{"message", std::string("Invalid JSON: ") + ex.what()}, {"type", "invalid_request_error"}}}};
 
@@ -514,8 +683,8 @@ namespace kolosal
         }
         catch (const std::exception& ex)
         {
-            ServerLogger::logError("[Thread %u] Error handling inference chat completion: %s",
-                                   std::this_thread::get_id(), ex.what());
+            KOLOSAL_LOG_ERROR("[Thread %zu] Error handling inference chat completion: %s",
+                                   std::hash<std::thread::id>{}(std::this_thread::get_id()), ex.what());
 
             json jError = {{"error", {{"message", std::string("Error: ") + ex.what()}, {"type", "invalid_request_error"}}}};
 
@@ -523,12 +692,12 @@ namespace kolosal
         }
     }
 
-    void CompletionRoute::handleTextCompletion(SocketType sock, const std::string& body)
+    void CompletionRoute::handleTextCompletion(SocketType sock, const std::string& body, const std::string& subject)
     {
         try
         {
             auto j = json::parse(body);
-            ServerLogger::logInfo("[Thread %u] Received inference completion request", std::this_thread::get_id());
+            KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Received inference completion request", std::hash<std::thread::id>{}(std::this_thread::get_id()));
 
             // Extract model name (required field)
             std::string modelName;
@@ -546,9 +715,30 @@ namespace kolosal
                 throw std::invalid_argument("Invalid completion parameters");
             }
 
+            // Charge the tenant's token quota before any engine work is queued
+            auto &tokenQuota = ServerAPI::instance().getAuthMiddleware().getTokenQuota();
+            const size_t promptEstimate = estimatePromptTokens(params);
+            auto reservation = tokenQuota.reserve(subject, modelName,
+                                                  promptEstimate + static_cast<size_t>(std::max(params.maxNewTokens, 0)));
+            if (!reservation.allowed)
+            {
+                send_quota_exceeded(sock, reservation);
+                return;
+            }
+            auth::TokenQuotaCharge quotaCharge(tokenQuota, std::move(reservation));
+            ServerAPI::instance().getAuthMiddleware().getTenantShares().assign(subject, params);
+
             // Get the NodeManager and inference engine
             auto& nodeManager = ServerAPI::instance().getNodeManager();
-            auto engine = nodeManager.getEngine(modelName);
+            NodeManager::Admission admission;
+            auto engine = nodeManager.getEngine(modelName, admission,
+                                                static_cast<int>(promptEstimate + static_cast<size_t>(std::max(params.maxNewTokens, 0))));
+
+            if (admission.rejected)
+            {
+                sendOverloaded(sock, modelName, admission);
+                return;
+            }
 
             if (!engine)
             {
@@ -558,8 +748,8 @@ namespace kolosal
             if (params.streaming)
             {
                 // Handle streaming response
-                ServerLogger::logInfo("[Thread %u] Processing streaming inference completion request for model '%s'",
-                                      std::this_thread::get_id(), modelName.c_str());
+                KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Processing streaming inference completion request for model '%s'",
+                                      std::hash<std::thread::id>{}(std::this_thread::get_id()), modelName.c_str());
 
                 // Submit job to inference engine
                 int jobId = engine->submitCompletionsJob(params);
@@ -569,60 +759,38 @@ namespace kolosal
                     throw std::runtime_error("Failed to submit completion job to inference engine");
                 }
 
+                quotaCharge.setPromptTokens(promptEstimate);
+
                 // Start the streaming response with proper SSE headers
                 begin_streaming_response(sock, 200, {{"Content-Type", "text/event-stream"}, {"Cache-Control", "no-cache"}});
 
-                bool firstTokenRecorded = false;
-                std::string previousText = "";
-                size_t lastTokenCount = 0;
-
-                // Poll for results until job is finished
-                while (!engine->isJobFinished(jobId))
+                // Stream each delta as soon as the engine decodes it
+                CompletionDelta delta;
+                bool disconnected = false;
+                while (engine->waitForJobOutput(jobId, delta, 1000))
                 {
-                    // Check for errors
-                    if (engine->hasJobError(jobId))
-                    {
-                        std::string error = engine->getJobError(jobId);
-                        ServerLogger::logError("[Thread %u] Inference job error: %s", std::this_thread::get_id(), error.c_str());
+                    if (delta.prompt_token_count > 0)
+                        quotaCharge.setPromptTokens(static_cast<size_t>(delta.prompt_token_count));
+                    quotaCharge.addGeneratedTokens(delta.tokens.size());
 
-                        // Send error as final chunk
-                        json errorResponse;
-                        errorResponse["error"] = error;
-                        errorResponse["text"] = "";
-                        errorResponse["tokens"] = json::array();
-                        errorResponse["tps"] = 0.0f;
-                        errorResponse["ttft"] = 0.0f;
-
-                        std::string sseData = "data: " + errorResponse.dump() + "\n\n";
-                        send_stream_chunk(sock, StreamChunk(sseData, false));
+                    // Stop generating for a client that has gone away
+                    if (client_disconnected(sock))
+                    {
+                        KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Client disconnected, stopping job %d", std::hash<std::thread::id>{}(std::this_thread::get_id()), jobId);
+                        engine->stopJob(jobId);
+                        disconnected = true;
                         break;
                     }
 
-                    // Get current result
-                    CompletionResult result = engine->getJobResult(jobId);
-                    
-                    // Check if we have new content to stream
-                    if (result.text.length() > previousText.length())
+                    if (!delta.text.empty() || !delta.tokens.empty())
                     {
-                        // Record first token if this is the first output
-                        if (!firstTokenRecorded && result.text.length() > 0)
-                        {
-                            firstTokenRecorded = true;
-                        }
-
-                        std::string newContent = result.text.substr(previousText.length());
-
                         // Create partial result for streaming
                         CompletionResult partialResult;
-                        partialResult.text = newContent;
-                        partialResult.tps = result.tps;
-                        partialResult.ttft = result.ttft;
-                        // Only include new tokens since last update based on token vector growth
-                        if (result.tokens.size() > lastTokenCount) {
-                            auto startIt = result.tokens.begin() + static_cast<long>(lastTokenCount);
-                            partialResult.tokens.assign(startIt, result.tokens.end());
-                        }
-                        partialResult.prompt_token_count = result.prompt_token_count;
+                        partialResult.text = delta.text;
+                        partialResult.tokens = delta.tokens;
+                        partialResult.tps = delta.tps;
+                        partialResult.ttft = delta.ttft;
+                        partialResult.prompt_token_count = delta.prompt_token_count;
 
                         json streamResponse = completionResultToJson(partialResult);
                         streamResponse["partial"] = true;
@@ -630,36 +798,45 @@ namespace kolosal
                         // Format as SSE data message
                         std::string sseData = "data: " + streamResponse.dump() + "\n\n";
                         send_stream_chunk(sock, StreamChunk(sseData, false));
-
-                        previousText = result.text;
-                        lastTokenCount = result.tokens.size();
                     }
 
-                    // Brief sleep to avoid busy waiting
-                    std::this_thread::sleep_for(std::chrono::milliseconds(50));
-                }
+                    if (delta.hasError)
+                    {
+                        KOLOSAL_LOG_ERROR("[Thread %zu] Inference job error: %s", std::hash<std::thread::id>{}(std::this_thread::get_id()), delta.errorMessage.c_str());
 
-                // Send the final [DONE] marker to indicate completion
-                send_stream_chunk(sock, StreamChunk("data: [DONE]\n\n", false));
+                        // Send error as final chunk
+                        json errorResponse;
+                        errorResponse["error"] = delta.errorMessage;
+                        errorResponse["text"] = "";
+                        errorResponse["tokens"] = json::array();
+                        errorResponse["tps"] = 0.0f;
+                        errorResponse["ttft"] = 0.0f;
 
-                // Then terminate the stream
-                send_stream_chunk(sock, StreamChunk("", true));
+                        std::string sseData = "data: " + errorResponse.dump() + "\n\n";
+                        send_stream_chunk(sock, StreamChunk(sseData, false));
+                    }
 
-                if (engine->hasJobError(jobId))
-                {
+                    if (delta.finished)
+                        break;
                 }
-                else
+
+                // Queue the final [DONE] marker; it goes out together with the stream terminator
+                if (!disconnected)
                 {
+                    send_stream_chunk(sock, StreamChunk("data: [DONE]\n\n", false), false);
+                    send_stream_chunk(sock, StreamChunk("", true));
                 }
 
-                ServerLogger::logInfo("[Thread %u] Completed streaming response for job %d",
-                                      std::this_thread::get_id(), jobId);
+                engine->releaseJob(jobId);
+
+                KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Completed streaming response for job %d",
+                                      std::hash<std::thread::id>{}(std::this_thread::get_id()), jobId);
             }
             else
             {
                 // Handle normal (non-streaming) response
-                ServerLogger::logInfo("[Thread %u] Processing non-streaming inference completion request for model '%s'",
-                                      std::this_thread::get_id(), modelName.c_str());
+                KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Processing non-streaming inference completion request for model '%s'",
+                                      std::hash<std::thread::id>{}(std::this_thread::get_id()), modelName.c_str());
 
                 // Submit job to inference engine
                 int jobId = engine->submitCompletionsJob(params);
@@ -669,8 +846,13 @@ namespace kolosal
                     throw std::runtime_error("Failed to submit completion job to inference engine");
                 }
 
+                quotaCharge.setPromptTokens(promptEstimate);
+
                 // Wait for job completion
-                engine->waitForJob(jobId);
+                if (!waitUnlessDisconnected(sock, *engine, jobId))
+                {
+                    return;
+                }
 
                 // Check for errors
                 if (engine->hasJobError(jobId))
@@ -681,20 +863,30 @@ namespace kolosal
 
                 // Get the final result
                 CompletionResult result = engine->getJobResult(jobId);
+                if (result.prompt_token_count > 0)
+                    quotaCharge.setPromptTokens(static_cast<size_t>(result.prompt_token_count));
+                quotaCharge.addGeneratedTokens(result.tokens.size());
+                tracing::record_job(result.timing, jobId);
 
                 // Convert result to JSON and send response
-                json response = completionResultToJson(result);
-                send_response(sock, 200, response.dump());
+                std::string payload;
+                {
+                    tracing::Span serializeSpan("serialize");
+                    payload = completionResultToJson(result).dump();
+                }
+                send_response(sock, 200, payload);
+
+                engine->releaseJob(jobId);
 
-                ServerLogger::logInfo("[Thread %u] Completed non-streaming response for job %d (%.2f tokens/sec)",
-                                      std::this_thread::get_id(), jobId, result.tps);
+                KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Completed non-streaming response for job %d (%.2f tokens/sec)",
+                                      std::hash<std::thread::id>{}(std::this_thread::get_id()), jobId, result.tps);
             }
         }
         catch (const json::exception& ex)
         {
             // Specifically handle JSON parsing errors
-            ServerLogger::logError("[Thread %u] JSON parsing error: %s",
-                                   std::this_thread::get_id(), ex.what());
+            KOLOSAL_LOG_ERROR("[Thread %zu] JSON parsing error: %s",
+                                   std::hash<std::thread::id>{}(std::this_thread::get_id()), ex.what());
 
             json jError = {{"error", {{"message", std::string("Invalid JSON: ") + ex.what()}, {"type", "invalid_request_error"}}}};
 
@@ -702,8 +894,8 @@ namespace kolosal
         }
         catch (const std::exception& ex)
         {
-            ServerLogger::logError("[Thread %u] Error handling inference completion: %s",
-                                   std::this_thread::get_id(), ex.what());
+            KOLOSAL_LOG_ERROR("[Thread %zu] Error handling inference completion: %s",
+                                   std::hash<std::thread::id>{}(std::this_thread::get_id()), ex.what());
 
             json jError = {{"error", {{"message", std::string("Error: ") + ex.what()}, {"type", "invalid_request_error"}}}};
 
@@ -0,0 +1,217 @@
+#include "kolosal/routes/llm/jobs_route.hpp"
+#include "kolosal/routes/route_utils.hpp"
+#include "kolosal/routes/llm/oai_parameters.hpp"
+#include "kolosal/job_manager.hpp"
+#include "kolosal/server_api.hpp"
+#include "kolosal/auth/auth_middleware.hpp"
+#include "kolosal/utils.hpp"
+#include "kolosal/logger.hpp"
+#include <json.hpp>
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+
+using json = nlohmann::json;
+
+namespace kolosal
+{
+
+namespace
+{
+    constexpr size_t kDefaultListLimit = 20;
+    constexpr size_t kMaxListLimit = 100;
+
+    void listJobs(SocketType sock, const std::string& owner, const std::string& path)
+    {
+        size_t limit = kDefaultListLimit;
+        const std::string limitParam = query_param(path, "limit");
+        if (!limitParam.empty())
+        {
+            try
+            {
+                limit = static_cast<size_t>(std::clamp(std::stoi(limitParam), 1, static_cast<int>(kMaxListLimit)));
+            }
+            catch (const std::exception&)
+            {
+                send_error_response(sock, 400, "limit must be an integer between 1 and 100");
+                return;
+            }
+        }
+
+        // One extra tells whether there is another page
+        auto jobs = JobManager::instance().list(owner, query_param(path, "after"), limit + 1);
+        const bool hasMore = jobs.size() > limit;
+        if (hasMore)
+            jobs.resize(limit);
+
+        json data = json::array();
+        for (const auto& job : jobs)
+            data.push_back(job.toJson(false));
+        json response = {
+            {"object", "list"},
+            {"data", data},
+            {"first_id", jobs.empty() ? json(nullptr) : json(jobs.front().id)},
+            {"last_id", jobs.empty() ? json(nullptr) : json(jobs.back().id)},
+            {"has_more", hasMore}
+        };
+        send_response(sock, 200, response.dump());
+    }
+
+    void submitJob(SocketType sock, const std::string& owner, const std::string& body)
+    {
+        if (body.empty())
+        {
+            send_error_response(sock, 400, "Request body is empty");
+            return;
+        }
+        json j;
+        try
+        {
+            j = json::parse(body);
+        }
+        catch (const json::parse_error& ex)
+        {
+            send_error_response(sock, 400, std::string("Invalid JSON: ") + ex.what());
+            return;
+        }
+
+        if (!j.is_object() || !j.contains("body") || !j["body"].is_object())
+        {
+            send_error_response(sock, 400, "body (the completion request) is required");
+            return;
+        }
+        const std::string endpoint = j.contains("endpoint") && j["endpoint"].is_string()
+                                         ? j["endpoint"].get<std::string>()
+                                         : "/v1/chat/completions";
+        const std::string webhook = j.contains("webhook_url") && j["webhook_url"].is_string()
+                                        ? j["webhook_url"].get<std::string>()
+                                        : std::string();
+        const json metadata = j.contains("metadata") && j["metadata"].is_object() ? j["metadata"] : json(nullptr);
+        const bool chat = endpoint == "/v1/chat/completions";
+        if (!chat && endpoint != "/v1/completions")
+        {
+            send_error_response(sock, 400, "endpoint must be /v1/chat/completions or /v1/completions");
+            return;
+        }
+
+        // The job's tokens are held against the quota from now until it ends, as for a synchronous request
+        RequestEstimate estimate;
+        std::string model;
+        try
+        {
+            model = j["body"].value("model", std::string());
+            estimate = estimateRequestTokens(chat, j["body"], j["body"].value("n", 1));
+        }
+        catch (const std::exception& ex)
+        {
+            send_error_response(sock, 400, std::string("Invalid request body: ") + ex.what());
+            return;
+        }
+        auto& tokenQuota = ServerAPI::instance().getAuthMiddleware().getTokenQuota();
+        auto reservation = tokenQuota.reserve(owner, model, estimate.totalTokens);
+        if (!reservation.allowed)
+        {
+            send_quota_exceeded(sock, reservation);
+            return;
+        }
+
+        JobManager::Job job;
+        try
+        {
+            job = JobManager::instance().submit(owner, endpoint, j["body"], webhook, metadata,
+                                                std::make_unique<auth::TokenQuotaCharge>(tokenQuota, std::move(reservation)),
+                                                estimate.promptTokens);
+        }
+        catch (const std::length_error& ex)
+        {
+            json jError = {{"error", {{"message", ex.what()}, {"type", "rate_limit_error"}, {"param", nullptr}, {"code", nullptr}}}};
+            send_response(sock, 429, jError.dump(), {{"Content-Type", "application/json"}, {"Retry-After", "5"}});
+            return;
+        }
+        KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Queued job %s for model '%s'", std::hash<std::thread::id>{}(std::this_thread::get_id()),
+                                 job.id.c_str(), job.model.c_str());
+        send_response(sock, 202, job.toJson().dump(),
+                      {{"Content-Type", "application/json"}, {"Location", "/v1/jobs/" + job.id}});
+    }
+}
+
+bool JobsRoute::match(const std::string& method, const std::string& full_path)
+{
+    const std::string path = strip_query(full_path);
+    if (path == "/v1/jobs" || path == "/jobs")
+        return method == "GET" || method == "POST";
+    const bool item = path.rfind("/v1/jobs/", 0) == 0 || path.rfind("/jobs/", 0) == 0;
+    return item && (method == "GET" || method == "POST" || method == "DELETE");
+}
+
+std::vector<RoutePattern> JobsRoute::patterns() const
+{
+    return {
+        {"POST", "/v1/jobs"},
+        {"GET", "/v1/jobs"},
+        {"GET", "/v1/jobs/{id}"},
+        {"DELETE", "/v1/jobs/{id}"},
+        {"POST", "/v1/jobs/{id}/cancel"},
+        {"POST", "/jobs"},
+        {"GET", "/jobs"},
+        {"GET", "/jobs/{id}"},
+        {"DELETE", "/jobs/{id}"},
+        {"POST", "/jobs/{id}/cancel"}
+    };
+}
+
+void JobsRoute::handle(SocketType sock, const RequestContext& request)
+{
+    try
+    {
+        auto& jobs = JobManager::instance();
+        if (!jobs.enabled())
+        {
+            send_error_response(sock, 404, "Async jobs are disabled on this server", "not_found_error");
+            return;
+        }
+
+        // Another tenant's job answers 404, as a missing one does
+        const std::string owner = request_subject(request);
+        const std::string id = request.param("id");
+        if (id.empty())
+        {
+            if (request.method == "POST")
+                submitJob(sock, owner, request.body);
+            else
+                listJobs(sock, owner, request.path);
+            return;
+        }
+
+        if (request.method == "DELETE")
+        {
+            if (!jobs.remove(owner, id))
+            {
+                send_error_response(sock, 404, "No such job: " + id, "not_found_error");
+                return;
+            }
+            send_response(sock, 200, json({{"id", id}, {"object", "job"}, {"deleted", true}}).dump());
+            return;
+        }
+
+        auto job = request.method == "POST" ? jobs.cancel(owner, id) : jobs.get(owner, id);
+        if (!job)
+        {
+            send_error_response(sock, 404, "No such job: " + id, "not_found_error");
+            return;
+        }
+        send_response(sock, 200, job->toJson().dump());
+    }
+    catch (const std::invalid_argument& ex)
+    {
+        send_error_response(sock, 400, ex.what());
+    }
+    catch (const std::exception& ex)
+    {
+        KOLOSAL_LOG_ERROR("[Thread %zu] Error handling jobs request: %s", std::hash<std::thread::id>{}(std::this_thread::get_id()), ex.what());
+        send_error_response(sock, 500, std::string("Internal server error: ") + ex.what(), "server_error");
+    }
+}
+
+} // namespace kolosal
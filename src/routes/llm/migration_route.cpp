@@ -0,0 +1,179 @@
+#include "kolosal/routes/llm/migration_route.hpp"
+#include "kolosal/routes/route_utils.hpp"
+#include "kolosal/routes/llm/oai_parameters.hpp"
+#include "kolosal/remote_prefill.hpp"
+#include "kolosal/cluster_router.hpp"
+#include "kolosal/server_api.hpp"
+#include "kolosal/node_manager.h"
+#include "kolosal/utils.hpp"
+#include "kolosal/logger.hpp"
+#include "inference_interface.h"
+#include <json.hpp>
+#include <stdexcept>
+#include <thread>
+
+using json = nlohmann::json;
+
+namespace kolosal
+{
+
+namespace
+{
+    void sendEvent(SocketType sock, const std::string& data)
+    {
+        send_stream_chunk(sock, StreamChunk("data: " + data + "\n\n", false));
+    }
+}
+
+bool MigrationRoute::match(const std::string& method, const std::string& path)
+{
+    return method == "POST" && (path == "/v1/internal/sessions" || path == "/v1/internal/resume");
+}
+
+std::vector<RoutePattern> MigrationRoute::patterns() const
+{
+    return {{"POST", "/v1/internal/sessions"}, {"POST", "/v1/internal/resume"}};
+}
+
+void MigrationRoute::handle(SocketType sock, const RequestContext& request)
+{
+    try
+    {
+        // A JSON header line, then the KV state in RemotePrefill::encode()'s layout
+        const size_t newline = request.body.find('\n');
+        if (newline == std::string::npos)
+        {
+            throw std::invalid_argument("Expected a JSON header line");
+        }
+        std::vector<uint8_t> state(request.body.begin() + static_cast<std::ptrdiff_t>(newline) + 1, request.body.end());
+        const std::string header = request.body.substr(0, newline);
+
+        if (request.path == "/v1/internal/sessions")
+            importSession(sock, header, state);
+        else
+            resumeGeneration(sock, header, state);
+    }
+    catch (const json::exception& ex)
+    {
+        send_error_response(sock, 400, std::string("Invalid JSON: ") + ex.what(), "invalid_request_error");
+    }
+    catch (const std::exception& ex)
+    {
+        KOLOSAL_LOG_ERROR("[Thread %zu] Error handling migration request: %s", std::hash<std::thread::id>{}(std::this_thread::get_id()), ex.what());
+        send_error_response(sock, 400, std::string("Error: ") + ex.what(), "invalid_request_error");
+    }
+}
+
+void MigrationRoute::importSession(SocketType sock, const std::string& header, std::vector<uint8_t>& state)
+{
+    const json j = json::parse(header);
+    const std::string model = j.at("model").get<std::string>();
+    const std::string key = j.at("key").get<std::string>();
+    auto session = RemotePrefill::decode(state);
+    if (!session)
+    {
+        throw std::invalid_argument("Malformed KV state");
+    }
+
+    auto engine = ServerAPI::instance().getNodeManager().getEngine(model);
+    if (!engine)
+    {
+        send_error_response(sock, 404, "Model '" + model + "' not found or could not be loaded", "invalid_request_error");
+        return;
+    }
+
+    const size_t tokens = session->tokens.size();
+    if (!engine->importSession(key, std::move(session)))
+    {
+        send_error_response(sock, 503, "No room for the session", "server_overloaded");
+        return;
+    }
+
+    // The conversation's next turn is routed here, where its KV now is
+    ClusterRouter::instance().adopt(model, key);
+    send_response(sock, 200, json{{"imported", true}, {"tokens", tokens}}.dump());
+    KOLOSAL_LOG_REQUEST_DEBUG("[Thread %zu] Took over a %zu-token session of model '%s' from a draining node",
+                           std::hash<std::thread::id>{}(std::this_thread::get_id()), tokens, model.c_str());
+}
+
+void MigrationRoute::resumeGeneration(SocketType sock, const std::string& header, std::vector<uint8_t>& state)
+{
+    const json j = json::parse(header);
+    const std::string model = j.at("model").get<std::string>();
+    const json& body = j.at("request");
+    const int maxTokens = j.value("max_tokens", 0);
+    // No state: the generation was suspended before it decoded its prompt and starts over here
+    std::shared_ptr<const KvSequenceState> kvState = state.empty() ? nullptr : RemotePrefill::decode(state);
+    if (!state.empty() && !kvState)
+    {
+        throw std::invalid_argument("Malformed KV state");
+    }
+
+    // The same parameter mapping as the completion routes, so the output continues as it would have there
+    CompletionParameters completionParams;
+    ChatCompletionParameters chatParams;
+    const bool chat = body.contains("messages");
+    if (chat)
+    {
+        ChatCompletionRequest parsed;
+        parsed.from_json(body);
+        chatParams = buildChatCompletionParameters(parsed, body);
+        chatParams.maxNewTokens = maxTokens;
+        chatParams.streaming = true;
+        chatParams.kvState = kvState;
+        chatParams.resumeFromKvState = kvState != nullptr;
+    }
+    else
+    {
+        CompletionRequest parsed;
+        parsed.from_json(body);
+        completionParams = buildCompletionParameters(parsed, body);
+        completionParams.maxNewTokens = maxTokens;
+        completionParams.streaming = true;
+        completionParams.kvState = kvState;
+        completionParams.resumeFromKvState = kvState != nullptr;
+    }
+
+    auto engine = ServerAPI::instance().getNodeManager().getEngine(model);
+    if (!engine)
+    {
+        send_error_response(sock, 404, "Model '" + model + "' not found or could not be loaded", "invalid_request_error");
+        return;
+    }
+
+    const int jobId = chat ? engine->submitChatCompletionsJob(chatParams) : engine->submitCompletionsJob(completionParams);
+    if (jobId < 0)
+    {
+        throw std::runtime_error("Failed to submit job to inference engine");
+    }
+
+    begin_streaming_response(sock, 200, {{"Content-Type", "text/event-stream"}, {"Cache-Control", "no-cache"}});
+    CompletionDelta delta;
+    while (engine->waitForJobOutput(jobId, delta, 1000))
+    {
+        // The draining node stops relaying once its client has gone
+        if (client_disconnected(sock))
+        {
+            engine->stopJob(jobId);
+            engine->releaseJob(jobId);
+            return;
+        }
+        if (!delta.tokens.empty() || !delta.text.empty())
+            sendEvent(sock, json{{"text", delta.text}, {"tokens", delta.tokens}}.dump());
+        if (delta.finished)
+            break;
+        delta = CompletionDelta();
+    }
+
+    if (engine->hasJobError(jobId))
+        sendEvent(sock, json{{"error", engine->getJobError(jobId)}}.dump());
+    else
+        sendEvent(sock, json{{"finished", true}}.dump());
+    sendEvent(sock, "[DONE]");
+    send_stream_chunk(sock, StreamChunk("", true));
+    engine->releaseJob(jobId);
+    KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Resumed a generation of model '%s' for a draining node",
+                          std::hash<std::thread::id>{}(std::this_thread::get_id()), model.c_str());
+}
+
+} // namespace kolosal
@@ -1,13 +1,24 @@
 #include "kolosal/routes/llm/oai_completions_route.hpp"
+#include "kolosal/routes/route_utils.hpp"
+#include "kolosal/routes/llm/oai_parameters.hpp"
 #include "kolosal/utils.hpp"
 #include "kolosal/models/chat_response_model.hpp"
 #include "kolosal/models/chat_response_chunk_model.hpp"
 #include "kolosal/models/completion_request_model.hpp"
 #include "kolosal/models/completion_response_model.hpp"
 #include "kolosal/models/completion_response_chunk_model.hpp"
+#include "kolosal/models/sse_chunk_writer.hpp"
 #include "kolosal/server_api.hpp"
 #include "kolosal/logger.hpp"
 #include "kolosal/node_manager.h"
+#include "kolosal/tracing.hpp"
+#include "kolosal/response_cache.hpp"
+#include "kolosal/semantic_cache.hpp"
+#include "kolosal/retrieval/embedding_cache.hpp"
+#include "kolosal/cluster_router.hpp"
+#include "kolosal/remote_prefill.hpp"
+#include "kolosal/drain_manager.hpp"
+#include "kolosal/auth/auth_middleware.hpp"
 
 #include "inference_interface.h"
 #include <json.hpp>
@@ -19,6 +30,8 @@
 #include <chrono>
 #include <mutex>
 #include <memory>
+#include <algorithm>
+#include <atomic>
 #include <variant>
 #include <functional>
 
@@ -28,150 +41,460 @@ namespace kolosal
 {
     namespace
     {
-        template <typename P>
-        void finalizeStructuredOutput(P &params, const char *context) {
-            if (!params.grammar.empty()) {
-                if (!params.jsonSchema.empty()) {
-                    ServerLogger::logInfo("[oai-%s] Both grammar & jsonSchema provided; grammar takes precedence", context);
-                } else {
-                    ServerLogger::logInfo("[oai-%s] Using provided grammar (chars=%zu)", context, params.grammar.size());
+        // Waits for a non-streaming job, polling the connection; if the client goes away the
+        // job is stopped and released and false is returned, as there is nobody to answer.
+        // A migratable job is suspended once a draining node moves its generations to peers
+        bool waitUnlessDisconnected(SocketType sock, IInferenceEngine &engine, int jobId, bool migratable = false)
+        {
+            bool suspending = false;
+            while (!engine.waitForJob(jobId, 500))
+            {
+                if (migratable && !suspending && DrainManager::instance().migrating())
+                {
+                    engine.suspendJob(jobId);
+                    suspending = true;
+                }
+                if (client_disconnected(sock))
+                {
+                    KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Client disconnected, cancelling job %d", std::hash<std::thread::id>{}(std::this_thread::get_id()), jobId);
+                    engine.stopJob(jobId);
+                    engine.releaseJob(jobId);
+                    return false;
                 }
-            } else if (!params.jsonSchema.empty()) {
-                ServerLogger::logInfo("[oai-%s] Using provided JSON schema (chars=%zu)", context, params.jsonSchema.size());
             }
+            return true;
         }
 
-        size_t threadIdForLog()
+        // Waits for every candidate of a non-streaming request; all of them are released if
+        // the client goes away
+        bool waitUnlessDisconnected(SocketType sock, IInferenceEngine &engine, const std::vector<int> &jobIds)
         {
-            return std::hash<std::thread::id>{}(std::this_thread::get_id());
+            for (size_t i = 0; i < jobIds.size(); ++i)
+            {
+                if (!waitUnlessDisconnected(sock, engine, jobIds[i], jobIds.size() == 1))
+                {
+                    for (size_t k = 0; k < jobIds.size(); ++k)
+                    {
+                        if (k != i)
+                            engine.releaseJob(jobIds[k]);
+                    }
+                    return false;
+                }
+            }
+            return true;
         }
 
-        std::string formatPayloadForLog(const json &payload)
+        // Hands each candidate's output to onDelta(candidate index, delta) as it is decoded,
+        // visiting the candidates in turn so none of their streams stalls behind another.
+        // Returns false, with every candidate stopped, if the client goes away. A single
+        // candidate is suspended once a draining node moves its generations to peers
+        bool streamCandidates(SocketType sock, IInferenceEngine &engine, const std::vector<int> &jobIds,
+                              auth::TokenQuotaCharge &quotaCharge,
+                              const std::function<void(size_t, const CompletionDelta &)> &onDelta)
         {
-            static constexpr size_t kMaxLoggedPayloadBytes = 8192;
-            std::string pretty = payload.dump(2);
-
-            if (pretty.size() <= kMaxLoggedPayloadBytes)
+            // a single job can block on its output; candidates generate in the same batches
+            // and only wait briefly for each other
+            const int waitMs = jobIds.size() == 1 ? 1000 : 20;
+            std::vector<bool> finished(jobIds.size(), false);
+            size_t running = jobIds.size();
+            bool suspending = false;
+            while (running > 0)
             {
-                return pretty;
+                if (jobIds.size() == 1 && !suspending && DrainManager::instance().migrating())
+                {
+                    engine.suspendJob(jobIds.front());
+                    suspending = true;
+                }
+                for (size_t i = 0; i < jobIds.size(); ++i)
+                {
+                    if (finished[i])
+                        continue;
+
+                    CompletionDelta delta;
+                    if (!engine.waitForJobOutput(jobIds[i], delta, waitMs))
+                    {
+                        finished[i] = true;
+                        --running;
+                        continue;
+                    }
+                    if (delta.prompt_token_count > 0)
+                        quotaCharge.setPromptTokens(static_cast<size_t>(delta.prompt_token_count));
+                    quotaCharge.addGeneratedTokens(delta.tokens.size());
+
+                    // Stop generating for a client that has gone away
+                    if (client_disconnected(sock))
+                    {
+                        KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Client disconnected, stopping job %d", std::hash<std::thread::id>{}(std::this_thread::get_id()), jobIds[i]);
+                        for (int jobId : jobIds)
+                            engine.stopJob(jobId);
+                        return false;
+                    }
+
+                    onDelta(i, delta);
+                    if (delta.finished)
+                    {
+                        finished[i] = true;
+                        --running;
+                    }
+                }
             }
+            return true;
+        }
 
-            std::ostringstream oss;
-            oss << pretty.substr(0, kMaxLoggedPayloadBytes)
-                << "\n... [truncated " << (pretty.size() - kMaxLoggedPayloadBytes) << " bytes]";
-            return oss.str();
+        // Continues a job suspended by a drain on a peer, handing the rest of its output to
+        // onOutput; the output ends where the job stopped if no peer can continue it
+        void continueOnPeer(SocketType sock, IInferenceEngine &engine, int jobId, const std::string &model,
+                            const std::string &body, size_t generated, int maxNewTokens, auth::TokenQuotaCharge &quotaCharge,
+                            const std::function<void(const std::string &, const std::vector<int32_t> &)> &onOutput)
+        {
+            DrainManager::instance().resume(model, body, engine.getJobKvState(jobId), generated, maxNewTokens,
+                                            [&](const std::string &text, const std::vector<int32_t> &tokens)
+                                            {
+                                                quotaCharge.addGeneratedTokens(tokens.size());
+                                                if (client_disconnected(sock))
+                                                    return false;
+                                                onOutput(text, tokens);
+                                                return true;
+                                            });
         }
 
-        void logDetailedRequest(const char *context, const json &payload, size_t rawSize)
+        // Most candidates one request may have generated through n / best_of
+        constexpr int kMaxCandidates = 16;
+
+        // Candidates to generate for a request's n and best_of
+        int candidateCount(int n, const std::optional<int> &bestOf, bool stream)
         {
-            const std::string formatted = formatPayloadForLog(payload);
-            ServerLogger::logInfo("[oai-%s][Thread %zu] Incoming request (%zu bytes):\n%s",
-                                  context,
-                                  threadIdForLog(),
-                                  rawSize,
-                                  formatted.c_str());
+            if (n < 1 || n > kMaxCandidates)
+            {
+                throw std::invalid_argument("n must be between 1 and " + std::to_string(kMaxCandidates));
+            }
+            if (!bestOf.has_value())
+            {
+                return n;
+            }
+            if (*bestOf < n || *bestOf > kMaxCandidates)
+            {
+                throw std::invalid_argument("best_of must be between n and " + std::to_string(kMaxCandidates));
+            }
+            if (stream && *bestOf > n)
+            {
+                throw std::invalid_argument("best_of cannot be used with stream");
+            }
+            return *bestOf;
         }
-        /**
-         * @brief Builds ChatCompletionParameters from a ChatCompletionRequest
-         * Following the ModelManager pattern from the example
-         */
-        ChatCompletionParameters buildChatCompletionParameters(const ChatCompletionRequest &request)
+
+        // One job per candidate; empty if the engine refused them
+        std::vector<int> submitCandidates(IInferenceEngine &engine, const ChatCompletionParameters &params, int candidates)
         {
-            ChatCompletionParameters params;
+            if (candidates > 1)
+            {
+                return engine.submitChatCompletionsJobs(params, candidates);
+            }
+            const int jobId = engine.submitChatCompletionsJob(params);
+            return jobId < 0 ? std::vector<int>() : std::vector<int>{jobId};
+        }
 
-            // Convert messages
-            params.messages.clear();
-            for (const auto &msg : request.messages)
+        std::vector<int> submitCandidates(IInferenceEngine &engine, const CompletionParameters &params, int candidates)
+        {
+            if (candidates > 1)
             {
-                params.messages.emplace_back(msg.role, msg.content);
+                return engine.submitCompletionsJobs(params, candidates);
             }
+            const int jobId = engine.submitCompletionsJob(params);
+            return jobId < 0 ? std::vector<int>() : std::vector<int>{jobId};
+        }
+
+        // Indexes of the n results with the highest log-probability per token, best first
+        std::vector<size_t> bestCandidates(const std::vector<CompletionResult> &results, int n)
+        {
+            std::vector<size_t> order(results.size());
+            for (size_t i = 0; i < order.size(); ++i)
+                order[i] = i;
+            auto perToken = [&results](size_t i)
+            { return results[i].logprob / static_cast<double>(std::max<size_t>(1, results[i].tokens.size())); };
+            std::stable_sort(order.begin(), order.end(), [&perToken](size_t a, size_t b)
+                             { return perToken(a) > perToken(b); });
+            order.resize(std::min(order.size(), static_cast<size_t>(std::max(n, 0))));
+            return order;
+        }
+
+        // 503 for a request turned away by admission control, so clients and load balancers retry elsewhere
+        void sendOverloaded(SocketType sock, const std::string &model, const NodeManager::Admission &admission)
+        {
+            json jError = {{"error", {{"message", "Model '" + model + "' is at capacity, retry later"},
+                                      {"type", "server_overloaded"}, {"param", nullptr}, {"code", "model_overloaded"}}}};
+            send_response(sock, 503, jError.dump(),
+                          {{"Content-Type", "application/json"}, {"Retry-After", std::to_string(admission.retryAfterSeconds)}});
+        }
+
+        // Whether a request's output is fixed by its inputs, so a repeat can be answered from the
+        // response cache; clients opt out per request with "cache": false
+        bool cacheableRequest(const json &j, float temperature, bool seeded)
+        {
+            if (!ResponseCache::instance().enabled())
+                return false;
+            if (j.contains("cache") && j["cache"].is_boolean() && !j["cache"].get<bool>())
+                return false;
+            return temperature <= 0.0f || seeded;
+        }
+
+        // Everything besides the prompt that shapes the output, for the response cache key.
+        // Greedy decoding ignores the seed, so it is left out and seeded and unseeded repeats share
+        template <typename P>
+        json responseCacheKeyBase(const P &params, int n, int candidates)
+        {
+            return {{"seed", params.temperature <= 0.0f ? 0 : params.randomSeed},
+                    {"max_tokens", params.maxNewTokens},
+                    {"min_length", params.minLength},
+                    {"temperature", params.temperature},
+                    {"top_p", params.topP},
+                    {"grammar", params.grammar},
+                    {"json_schema", params.jsonSchema},
+                    {"stop", params.stop},
+                    {"n", n},
+                    {"candidates", candidates},
+                    {"allow_context_shift", params.allow_context_shift},
+                    {"n_discard", params.n_discard},
+                    {"prompt_lookup", params.promptLookup},
+                    {"lora_adapter", params.loraAdapter}};
+        }
 
-            // Set generation parameters
-            params.temperature = static_cast<float>(request.temperature);
-            params.topP = static_cast<float>(request.top_p);
-            params.streaming = request.stream;
+        // Object keys are dumped sorted, so equal requests always serialize the same
+        std::string responseCacheKey(const ChatCompletionParameters &params, int n, int candidates)
+        {
+            json key = responseCacheKeyBase(params, n, candidates);
+            json messages = json::array();
+            for (const auto &message : params.messages)
+                messages.push_back({message.role, message.content});
+            key["messages"] = std::move(messages);
+            return key.dump();
+        }
+
+        std::string responseCacheKey(const CompletionParameters &params, int n, int candidates)
+        {
+            json key = responseCacheKeyBase(params, n, candidates);
+            key["prompt"] = params.prompt;
+            return key.dump();
+        }
+
+        // Final user message of a chat request the semantic cache may answer, and a key of the rest of
+        // the context that shapes the answer: earlier messages, system prompt included, and every
+        // generation setting except the sampling randomness a paraphrase already varies more than
+        bool semanticCacheQuery(const json &j, const ChatCompletionParameters &params, int n, int candidates,
+                                std::string &message, std::string &context)
+        {
+            if (!SemanticCache::instance().enabled() || params.messages.empty())
+                return false;
+            if (j.contains("cache") && j["cache"].is_boolean() && !j["cache"].get<bool>())
+                return false;
+            const auto &last = params.messages.back();
+            if (last.role != "user" || last.content.empty())
+                return false;
+
+            json key = responseCacheKeyBase(params, n, candidates);
+            key.erase("seed");
+            key.erase("temperature");
+            key.erase("top_p");
+            json history = json::array();
+            for (size_t i = 0; i + 1 < params.messages.size(); ++i)
+                history.push_back({params.messages[i].role, params.messages[i].content});
+            key["history"] = std::move(history);
+            message = last.content;
+            context = key.dump();
+            return true;
+        }
 
-            // Set max tokens if specified
-            if (request.max_tokens.has_value())
+        // Normalized embedding of a message for the semantic cache; empty if the embedding engine
+        // cannot produce one, in which case the request just skips the cache
+        std::vector<float> embedForSemanticCache(const std::string &message)
+        {
+            const std::string model = SemanticCache::instance().embeddingModel();
+            auto &cache = retrieval::EmbeddingCache::instance();
+            if (auto cached = cache.get(model, message, true))
+                return std::move(*cached);
+            try
             {
-                params.maxNewTokens = request.max_tokens.value();
+                auto engine = ServerAPI::instance().getNodeManager().getEngine(model);
+                if (!engine)
+                    throw std::runtime_error("embedding model '" + model + "' not found or could not be loaded");
+                std::vector<EmbeddingParameters> params(1);
+                params[0].input = message;
+                params[0].normalize = true;
+                std::vector<EmbeddingResult> results = engine->submitEmbeddingBatch(params);
+                if (results.empty() || results[0].hasError || results[0].embedding.empty())
+                    throw std::runtime_error(results.empty() || !results[0].hasError ? "empty embedding" : results[0].errorMessage);
+                cache.put(model, message, true, results[0].embedding);
+                return std::move(results[0].embedding);
             }
-
-            // Set random seed if specified
-            if (request.seed.has_value())
+            catch (const std::exception &ex)
             {
-                params.randomSeed = request.seed.value();
+                KOLOSAL_LOG_WARNING("Semantic cache skipped: %s", ex.what());
+                return {};
             }
+        }
 
-            // OpenAI-style response_format handling will be parsed outside; keep hook via json extras
+        // Id of a response answered from the response cache, which has no job behind it
+        std::string cachedResponseId(const char *prefix)
+        {
+            static std::atomic<uint64_t> next{0};
+            return std::string(prefix) + "cached-" + std::to_string(next.fetch_add(1) + 1);
+        }
 
-            return params;
+        void sendStreamHeaders(SocketType sock)
+        {
+            std::string headers = "HTTP/1.1 200 OK\r\n"
+                                  "Content-Type: text/event-stream\r\n"
+                                  "Cache-Control: no-cache\r\n"
+                                  "Connection: keep-alive\r\n"
+                                  "Access-Control-Allow-Origin: *\r\n"
+                                  "Access-Control-Allow-Headers: *\r\n\r\n";
+            kolosal::http_internal::send_all(sock, headers);
         }
 
-        /**
-         * @brief Builds CompletionParameters from a CompletionRequest
-         * Following the ModelManager pattern from the example
-         */
-        CompletionParameters buildCompletionParameters(const CompletionRequest &request)
+        void sendEvent(SocketType sock, const std::string &data)
+        {
+            const std::string event = "data: " + data + "\n\n";
+            kolosal::http_internal::send_all(sock, event);
+        }
+
+        // Sends an event already framed by SseChunkWriter
+        void sendFrame(SocketType sock, const std::string &frame)
         {
-            CompletionParameters params;
+            kolosal::http_internal::send_all(sock, frame);
+        }
+
+        // Answers a chat completion from the response cache; a stream is replayed in the pieces
+        // it was generated in, each choice followed by its finish chunk
+        void sendCachedChatCompletion(SocketType sock, const std::string &model, const ResponseCache::Response &cached, bool stream)
+        {
+            const std::string id = cachedResponseId("chatcmpl-");
+            const long long created = static_cast<long long>(std::time(nullptr));
 
-            // Set prompt based on request format
-            if (std::holds_alternative<std::string>(request.prompt))
+            if (!stream)
             {
-                params.prompt = std::get<std::string>(request.prompt);
+                ChatCompletionResponse response;
+                response.id = id;
+                response.object = "chat.completion";
+                response.created = created;
+                response.model = model;
+                for (size_t index = 0; index < cached.choices.size(); ++index)
+                {
+                    ChatCompletionChoice choice;
+                    choice.index = static_cast<int>(index);
+                    choice.message.role = "assistant";
+                    for (const auto &piece : cached.choices[index])
+                        choice.message.content += piece;
+                    choice.finish_reason = "stop";
+                    response.choices.push_back(choice);
+                }
+                response.usage.prompt_tokens = cached.prompt_tokens;
+                response.usage.completion_tokens = cached.completion_tokens;
+                response.usage.total_tokens = cached.prompt_tokens + cached.completion_tokens;
+                send_response(sock, 200, response.to_json().dump());
+                return;
             }
-            else if (std::holds_alternative<std::vector<std::string>>(request.prompt))
+
+            SseChunkWriter writer(SseChunkWriter::Format::ChatCompletion, id, model, created);
+            sendStreamHeaders(sock);
+            for (size_t index = 0; index < cached.choices.size(); ++index)
+            {
+                for (const auto &piece : cached.choices[index])
+                    sendFrame(sock, writer.text(index, piece));
+                sendFrame(sock, writer.finish(index));
+            }
+            sendEvent(sock, "[DONE]");
+        }
+
+        void sendCachedCompletion(SocketType sock, const std::string &model, const ResponseCache::Response &cached, bool stream)
+        {
+            const std::string id = cachedResponseId("cmpl-");
+            const long long created = static_cast<long long>(std::time(nullptr));
+
+            if (!stream)
             {
-                // Join multiple prompts with newlines if array is provided
-                const auto &prompts = std::get<std::vector<std::string>>(request.prompt);
-                std::ostringstream joined;
-                for (size_t i = 0; i < prompts.size(); ++i)
+                CompletionResponse response;
+                response.id = id;
+                response.object = "text_completion";
+                response.created = created;
+                response.model = model;
+                for (size_t index = 0; index < cached.choices.size(); ++index)
                 {
-                    joined << prompts[i];
-                    if (i < prompts.size() - 1)
-                        joined << "\n";
+                    CompletionChoice choice;
+                    choice.index = static_cast<int>(index);
+                    for (const auto &piece : cached.choices[index])
+                        choice.text += piece;
+                    choice.finish_reason = "stop";
+                    response.choices.push_back(choice);
                 }
-                params.prompt = joined.str();
+                response.usage.prompt_tokens = cached.prompt_tokens;
+                response.usage.completion_tokens = cached.completion_tokens;
+                response.usage.total_tokens = cached.prompt_tokens + cached.completion_tokens;
+                send_response(sock, 200, response.to_json().dump());
+                return;
             }
 
-            // Set generation parameters
-            params.temperature = static_cast<float>(request.temperature);
-            params.topP = static_cast<float>(request.top_p);
-            params.streaming = request.stream;
-
-            // Set max tokens if specified
-            if (request.max_tokens.has_value())
+            SseChunkWriter writer(SseChunkWriter::Format::TextCompletion, id, model, created);
+            sendStreamHeaders(sock);
+            for (size_t index = 0; index < cached.choices.size(); ++index)
             {
-                params.maxNewTokens = request.max_tokens.value();
+                for (const auto &piece : cached.choices[index])
+                    sendFrame(sock, writer.text(index, piece));
+                sendFrame(sock, writer.finish(index));
             }
+            sendEvent(sock, "[DONE]");
+        }
 
-            // Set random seed if specified
-            if (request.seed.has_value())
+        size_t threadIdForLog()
+        {
+            return std::hash<std::thread::id>{}(std::this_thread::get_id());
+        }
+
+        std::string formatPayloadForLog(const json &payload)
+        {
+            static constexpr size_t kMaxLoggedPayloadBytes = 8192;
+            std::string pretty = payload.dump(2);
+
+            if (pretty.size() <= kMaxLoggedPayloadBytes)
             {
-                params.randomSeed = request.seed.value();
+                return pretty;
             }
 
-            return params;
+            std::ostringstream oss;
+            oss << pretty.substr(0, kMaxLoggedPayloadBytes)
+                << "\n... [truncated " << (pretty.size() - kMaxLoggedPayloadBytes) << " bytes]";
+            return oss.str();
         }
 
+        void logDetailedRequest(const char *context, const json &payload, size_t rawSize)
+        {
+            const std::string formatted = formatPayloadForLog(payload);
+            KOLOSAL_LOG_INFO("[oai-%s][Thread %zu] Incoming request (%zu bytes):\n%s",
+                                  context,
+                                  threadIdForLog(),
+                                  rawSize,
+                                  formatted.c_str());
+        }
         /**
-         * @brief Converts tokens per second and token count to usage statistics (chat)
+         * @brief Converts token counts to usage statistics (chat); every candidate generated counts
          */
-        void updateChatUsageStats(ChatCompletionResponse &response, const CompletionResult &result, int promptTokens)
+        void updateChatUsageStats(ChatCompletionResponse &response, const std::vector<CompletionResult> &results, int promptTokens)
         {
             response.usage.prompt_tokens = promptTokens;
-            response.usage.completion_tokens = static_cast<int>(result.tokens.size());
+            response.usage.completion_tokens = 0;
+            for (const auto &result : results)
+                response.usage.completion_tokens += static_cast<int>(result.tokens.size());
             response.usage.total_tokens = response.usage.prompt_tokens + response.usage.completion_tokens;
         }
 
         /**
-         * @brief Updates usage statistics for completion response
+         * @brief Updates usage statistics for completion response; every candidate generated counts
          */
-        void updateCompletionUsageStats(CompletionResponse &response, const CompletionResult &result, int promptTokens)
+        void updateCompletionUsageStats(CompletionResponse &response, const std::vector<CompletionResult> &results, int promptTokens)
         {
             response.usage.prompt_tokens = promptTokens;
-            response.usage.completion_tokens = static_cast<int>(result.tokens.size());
+            response.usage.completion_tokens = 0;
+            for (const auto &result : results)
+                response.usage.completion_tokens += static_cast<int>(result.tokens.size());
             response.usage.total_tokens = response.usage.prompt_tokens + response.usage.completion_tokens;
         }
     }
@@ -189,28 +512,55 @@ namespace kolosal
                  path == "/v1/completions" || path == "/completions"));
     }
 
-    void OaiCompletionsRoute::handle(SocketType sock, const std::string &body)
+    std::vector<RoutePattern> OaiCompletionsRoute::patterns() const
+    {
+        return {
+            {"POST", "/v1/chat/completions"},
+            {"POST", "/chat/completions"},
+            {"POST", "/v1/completions"},
+            {"POST", "/completions"}
+        };
+    }
+
+    void OaiCompletionsRoute::handle(SocketType sock, const RequestContext &request)
     {
         try
         {
             // Check for empty body
-            if (body.empty())
+            if (request.body.empty())
             {
                 throw std::invalid_argument("Request body is empty");
             }
 
-            auto j = json::parse(body);
+            auto j = json::parse(request.body);
+
+            // In a cluster, the node holding this conversation's KV cache serves it
+            if (ClusterRouter::instance().forward(sock, request, j))
+            {
+                return;
+            }
+
+            // A draining node takes no new work; a peer that has not seen the drain yet is still served
+            if (DrainManager::instance().draining() && !request.headers.count("x-kolosal-forwarded"))
+            {
+                DrainManager::instance().sendDraining(sock);
+                return;
+            }
+
+            // Tenant charged for the tokens this request uses
+            const std::string subject = auth::TokenQuota::subjectFor(
+                ServerAPI::instance().getAuthMiddleware().extractApiKey(request.headers), request.clientIP);
             
             // Determine the type of request based on the endpoint path
             // We need to get the path from the request context, but since it's not available in handle(),
             // we'll determine it based on the presence of 'messages' field in the JSON
             if (j.contains("messages"))
             {
-                handleChatCompletion(sock, body);
+                handleChatCompletion(sock, request.body, subject);
             }
             else if (j.contains("prompt"))
             {
-                handleTextCompletion(sock, body);
+                handleTextCompletion(sock, request.body, subject);
             }
             else
             {
@@ -219,13 +569,13 @@ namespace kolosal
         }
         catch (const json::parse_error &ex)
         {
-            ServerLogger::logError("JSON parsing error: %s", ex.what());
+            KOLOSAL_LOG_ERROR("JSON parsing error: %s", ex.what());
             json jError = {{"error", {{"message", std::string("Invalid JSON: ") + ex.what()}, {"type", "invalid_request_error"}, {"param", nullptr}, {"code", nullptr}}}};
             send_response(sock, 400, jError.dump());
         }
         catch (const std::exception &ex)
         {
-            ServerLogger::logError("Error handling completion request: %s", ex.what());
+            KOLOSAL_LOG_ERROR("Error handling completion request: %s", ex.what());
             json jError = {{"error", {{"message", std::string("Error: ") + ex.what()}, {"type", "invalid_request_error"}, {"param", nullptr}, {"code", nullptr}}}};
             send_response(sock, 400, jError.dump());
         }
@@ -241,12 +591,12 @@ namespace kolosal
         return (path == "/v1/chat/completions" || path == "/chat/completions");
     }
 
-    void OaiCompletionsRoute::handleChatCompletion(SocketType sock, const std::string &body)
+    void OaiCompletionsRoute::handleChatCompletion(SocketType sock, const std::string &body, const std::string &subject)
     {
         try
         {
             auto j = json::parse(body);
-            ServerLogger::logInfo("[Thread %u] Received chat completion request", std::this_thread::get_id());
+            KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Received chat completion request", std::hash<std::thread::id>{}(std::this_thread::get_id()));
             logDetailedRequest("chat", j, body.size());
 
             // Parse the request
@@ -258,80 +608,99 @@ namespace kolosal
                 throw std::invalid_argument("Invalid request parameters");
             }
 
-            // Get the NodeManager and inference engine
-            auto &nodeManager = ServerAPI::instance().getNodeManager();
-            auto engine = nodeManager.getEngine(request.model);
+            // Build inference parameters, extension fields (grammar, response_format, context shift) included
+            ChatCompletionParameters inferenceParams = buildChatCompletionParameters(request, j);
+            const int candidates = candidateCount(request.n, std::nullopt, request.stream);
 
-            if (!engine)
+            // Charge the tenant's token quota before any engine work is queued
+            auto &tokenQuota = ServerAPI::instance().getAuthMiddleware().getTokenQuota();
+            const size_t promptEstimate = estimatePromptTokens(inferenceParams);
+            auto reservation = tokenQuota.reserve(subject, request.model,
+                                                  promptEstimate + static_cast<size_t>(std::max(inferenceParams.maxNewTokens, 0)) * candidates);
+            if (!reservation.allowed)
             {
-                throw std::runtime_error("Model '" + request.model + "' not found or could not be loaded");
+                send_quota_exceeded(sock, reservation);
+                return;
             }
-
-            // Build inference parameters following ModelManager pattern
-            ChatCompletionParameters inferenceParams = buildChatCompletionParameters(request);
-
-            // Extend with grammar and JSON schema features
-            if (j.contains("grammar") && j["grammar"].is_string()) {
-                inferenceParams.grammar = j["grammar"].get<std::string>();
-            }
-
-            // Map OpenAI response_format to jsonSchema
-            if (j.contains("response_format") && j["response_format"].is_object()) {
-                const auto &rf = j["response_format"];
-                if (rf.contains("type") && rf["type"].is_string()) {
-                    const std::string type = rf["type"].get<std::string>();
-                    if (type == "json_object") {
-                        inferenceParams.jsonSchema = std::string("{") + "\"type\":\"object\"}";
-                    } else if (type == "json_schema") {
-                        if (rf.contains("json_schema")) {
-                            const auto &js = rf["json_schema"];
-                            if (js.is_object()) {
-                                if (js.contains("schema") && js["schema"].is_object()) {
-                                    inferenceParams.jsonSchema = js["schema"].dump();
-                                } else {
-                                    inferenceParams.jsonSchema = js.dump();
-                                }
-                            } else if (js.is_string()) {
-                                inferenceParams.jsonSchema = js.get<std::string>();
-                            }
-                        }
-                    }
+            auth::TokenQuotaCharge quotaCharge(tokenQuota, std::move(reservation));
+            ServerAPI::instance().getAuthMiddleware().getTenantShares().assign(subject, inferenceParams);
+
+            // A deterministic request seen before is answered without queueing any engine work
+            auto &responseCache = ResponseCache::instance();
+            const bool useCache = cacheableRequest(j, inferenceParams.temperature, request.seed.has_value());
+            const std::string cacheKey = useCache ? responseCacheKey(inferenceParams, request.n, candidates) : std::string();
+            const uint64_t cacheGeneration = useCache ? responseCache.generation(request.model) : 0;
+            if (useCache)
+            {
+                if (auto cached = responseCache.get(request.model, cacheKey))
+                {
+                    quotaCharge.setPromptTokens(static_cast<size_t>(cached->prompt_tokens));
+                    quotaCharge.addGeneratedTokens(static_cast<size_t>(cached->completion_tokens));
+                    sendCachedChatCompletion(sock, request.model, *cached, request.stream);
+                    KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Chat completion for model '%s' answered from the response cache",
+                                          std::hash<std::thread::id>{}(std::this_thread::get_id()), request.model.c_str());
+                    return;
                 }
             }
 
-            // Also support custom top-level jsonSchema object/string
-            if (j.contains("jsonSchema")) {
-                if (j["jsonSchema"].is_string()) {
-                    inferenceParams.jsonSchema = j["jsonSchema"].get<std::string>();
-                } else if (j["jsonSchema"].is_object()) {
-                    inferenceParams.jsonSchema = j["jsonSchema"].dump();
+            // ...and a paraphrase of a recent question in the same context gets its answer
+            auto &semanticCache = SemanticCache::instance();
+            std::string semanticMessage, semanticContext;
+            std::vector<float> semanticEmbedding;
+            uint64_t semanticGeneration = 0;
+            if (semanticCacheQuery(j, inferenceParams, request.n, candidates, semanticMessage, semanticContext))
+            {
+                semanticGeneration = semanticCache.generation(request.model);
+                semanticEmbedding = embedForSemanticCache(semanticMessage);
+                float similarity = 0.0f;
+                if (auto cached = semanticCache.get(request.model, semanticContext, semanticEmbedding, &similarity))
+                {
+                    quotaCharge.setPromptTokens(static_cast<size_t>(cached->prompt_tokens));
+                    quotaCharge.addGeneratedTokens(static_cast<size_t>(cached->completion_tokens));
+                    sendCachedChatCompletion(sock, request.model, *cached, request.stream);
+                    KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Chat completion for model '%s' answered from the semantic cache (similarity %.3f)",
+                                          std::hash<std::thread::id>{}(std::this_thread::get_id()), request.model.c_str(), similarity);
+                    return;
                 }
             }
+            const bool useSemanticCache = !semanticEmbedding.empty();
 
-            // Context shifting support (extension)
-            if (j.contains("allow_context_shift") && j["allow_context_shift"].is_boolean()) {
-                inferenceParams.allow_context_shift = j["allow_context_shift"].get<bool>();
+            // Get the NodeManager and inference engine
+            auto &nodeManager = ServerAPI::instance().getNodeManager();
+            NodeManager::Admission admission;
+            auto engine = nodeManager.getEngine(request.model, admission,
+                                                static_cast<int>(promptEstimate + static_cast<size_t>(std::max(inferenceParams.maxNewTokens, 0))));
+
+            if (admission.rejected)
+            {
+                sendOverloaded(sock, request.model, admission);
+                return;
             }
-            if (j.contains("n_discard") && j["n_discard"].is_number_integer()) {
-                inferenceParams.n_discard = j["n_discard"].get<int>();
+
+            if (!engine)
+            {
+                throw std::runtime_error("Model '" + request.model + "' not found or could not be loaded");
             }
 
-            finalizeStructuredOutput(inferenceParams, "chat");
+            // A long prompt is decoded on a prefill node; this node resumes from its KV state
+            inferenceParams.kvState = RemotePrefill::instance().fetch(body, promptEstimate);
 
             if (request.stream)
             {
                 // Handle streaming response
-                ServerLogger::logInfo("[Thread %u] Processing streaming chat completion request for model '%s'",
-                                      std::this_thread::get_id(), request.model.c_str());
+                KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Processing streaming chat completion request for model '%s'",
+                                      std::hash<std::thread::id>{}(std::this_thread::get_id()), request.model.c_str());
 
                 // Submit job to inference engine
-                int jobId = engine->submitChatCompletionsJob(inferenceParams);
+                const std::vector<int> jobIds = submitCandidates(*engine, inferenceParams, candidates);
 
-                if (jobId < 0)
+                if (jobIds.empty())
                 {
                     throw std::runtime_error("Failed to submit job to inference engine");
                 }
 
+                quotaCharge.setPromptTokens(promptEstimate);
+
                 // Send streaming headers
                 std::string headers = "HTTP/1.1 200 OK\r\n"
                                       "Content-Type: text/event-stream\r\n"
@@ -340,143 +709,189 @@ namespace kolosal
                                       "Access-Control-Allow-Origin: *\r\n"
                                       "Access-Control-Allow-Headers: *\r\n\r\n";
 
-                send(sock, headers.c_str(), static_cast<int>(headers.length()), 0);
-
-                // Poll for results and stream them
-                bool jobComplete = false;
-                std::string allText;
-                size_t lastTokenCount = 0;
+                kolosal::http_internal::send_all(sock, headers);
 
-                while (!jobComplete)
+                // Stream each delta as soon as the engine decodes it; only the delta text is serialized per event
+                SseChunkWriter writer(SseChunkWriter::Format::ChatCompletion, "chatcmpl-" + std::to_string(jobIds.front()), request.model);
+                auto sendText = [&](size_t index, const std::string &text)
                 {
-                    std::this_thread::sleep_for(std::chrono::milliseconds(50));
-
-                    CompletionResult result = engine->getJobResult(jobId);
-
-                    // Check if we have new text to stream
-                    if (result.text.length() > allText.length())
+                    sendFrame(sock, writer.text(index, text));
+                };
+                auto sendFinish = [&](size_t index)
+                {
+                    sendFrame(sock, writer.finish(index));
+                };
+
+                ResponseCache::Response generated;
+                generated.choices.resize(jobIds.size());
+                bool failed = false;
+                bool suspended = false;
+                size_t streamedTokens = 0;
+                const bool completed = streamCandidates(sock, *engine, jobIds, quotaCharge, [&](size_t index, const CompletionDelta &delta)
+                {
+                    if (useCache || useSemanticCache)
                     {
-                        // Send new characters as tokens
-                        std::string newText = result.text.substr(allText.length());
-                        
-                        ChatCompletionChunk chunk;
-                        chunk.id = "chatcmpl-" + std::to_string(jobId);
-                        chunk.object = "chat.completion.chunk";
-                        chunk.created = static_cast<long long>(std::time(nullptr));
-                        chunk.model = request.model;
-
-                        ChatCompletionChunkChoice choice;
-                        choice.index = 0;
-                        choice.delta.content = newText;
-                        choice.finish_reason = "";
-
-                        chunk.choices.push_back(choice);
-
-                        json chunkJson = chunk.to_json();
-                        std::string chunkData = "data: " + chunkJson.dump() + "\n\n";
-                        send(sock, chunkData.c_str(), static_cast<int>(chunkData.length()), 0);
-                        
-                        allText = result.text;
-                        lastTokenCount = result.tokens.size();
+                        if (!delta.text.empty())
+                            generated.choices[index].push_back(delta.text);
+                        if (delta.prompt_token_count > 0)
+                            generated.prompt_tokens = delta.prompt_token_count;
+                        generated.completion_tokens += static_cast<int>(delta.tokens.size());
+                        failed = failed || delta.hasError;
                     }
+                    streamedTokens += delta.tokens.size();
 
-                    if (engine->isJobFinished(jobId))
-                    {
-                        jobComplete = true;
-
-                        // Send final chunk with finish_reason
-                        ChatCompletionChunk finalChunk;
-                        finalChunk.id = "chatcmpl-" + std::to_string(jobId);
-                        finalChunk.object = "chat.completion.chunk";
-                        finalChunk.created = static_cast<long long>(std::time(nullptr));
-                        finalChunk.model = request.model;
+                    if (!delta.text.empty())
+                        sendText(index, delta.text);
 
-                        ChatCompletionChunkChoice finalChoice;
-                        finalChoice.index = 0;
-                        finalChoice.delta.content = "";
-                        finalChoice.finish_reason = "stop";
+                    // A suspended job's output goes on once it resumes elsewhere
+                    if (delta.suspended)
+                        suspended = true;
+                    else if (delta.finished)
+                        sendFinish(index);
+                });
 
-                        finalChunk.choices.push_back(finalChoice);
-
-                        json finalChunkJson = finalChunk.to_json();
-                        std::string finalChunkData = "data: " + finalChunkJson.dump() + "\n\n";
-                        send(sock, finalChunkData.c_str(), static_cast<int>(finalChunkData.length()), 0);
+                // This node is draining: a peer generates the rest of the output
+                if (completed && suspended)
+                {
+                    failed = true;
+                    continueOnPeer(sock, *engine, jobIds.front(), request.model, body, streamedTokens, inferenceParams.maxNewTokens,
+                                   quotaCharge, [&](const std::string &text, const std::vector<int32_t> &)
+                                   {
+                                       if (!text.empty())
+                                           sendText(0, text);
+                                   });
+                    sendFinish(0);
+                }
 
-                        // Send [DONE]
-                        std::string doneData = "data: [DONE]\n\n";
-                        send(sock, doneData.c_str(), static_cast<int>(doneData.length()), 0);
-                    }
+                if (completed)
+                {
+                    // Send [DONE]
+                    std::string doneData = "data: [DONE]\n\n";
+                    kolosal::http_internal::send_all(sock, doneData);
+
+                    if (useSemanticCache && !failed)
+                        semanticCache.put(request.model, semanticContext, semanticGeneration, std::move(semanticEmbedding), generated);
+                    if (useCache && !failed)
+                        responseCache.put(request.model, cacheKey, cacheGeneration, std::move(generated));
                 }
 
-                ServerLogger::logInfo("[Thread %u] Streaming chat completion completed for model '%s'",
-                                      std::this_thread::get_id(), request.model.c_str());
+                for (int jobId : jobIds)
+                    engine->releaseJob(jobId);
+
+                KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Streaming chat completion completed for model '%s'",
+                                      std::hash<std::thread::id>{}(std::this_thread::get_id()), request.model.c_str());
             }
             else
             {
                 // Handle non-streaming response
-                ServerLogger::logInfo("[Thread %u] Processing non-streaming chat completion request for model '%s'",
-                                      std::this_thread::get_id(), request.model.c_str());
+                KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Processing non-streaming chat completion request for model '%s'",
+                                      std::hash<std::thread::id>{}(std::this_thread::get_id()), request.model.c_str());
 
                 // Submit job to inference engine
-                int jobId = engine->submitChatCompletionsJob(inferenceParams);
+                const std::vector<int> jobIds = submitCandidates(*engine, inferenceParams, candidates);
 
-                if (jobId < 0)
+                if (jobIds.empty())
                 {
                     throw std::runtime_error("Failed to submit job to inference engine");
                 }
 
+                quotaCharge.setPromptTokens(promptEstimate);
+
                 // Wait for completion
-                CompletionResult result;
-                while (!engine->isJobFinished(jobId))
+                if (!waitUnlessDisconnected(sock, *engine, jobIds))
                 {
-                    std::this_thread::sleep_for(std::chrono::milliseconds(100));
-                    result = engine->getJobResult(jobId);
+                    return;
                 }
 
-                // Get final result
-                result = engine->getJobResult(jobId);
+                // Get final results
+                std::vector<CompletionResult> results;
+                for (int jobId : jobIds)
+                {
+                    results.push_back(engine->getJobResult(jobId));
+                    quotaCharge.addGeneratedTokens(results.back().tokens.size());
+                    tracing::record_job(results.back().timing, jobId);
+                }
+                if (results.front().prompt_token_count > 0)
+                    quotaCharge.setPromptTokens(static_cast<size_t>(results.front().prompt_token_count));
+
+                // This node is draining: a peer generates the rest of the output
+                const bool suspended = results.front().suspended;
+                if (suspended)
+                {
+                    CompletionResult &result = results.front();
+                    continueOnPeer(sock, *engine, jobIds.front(), request.model, body, result.tokens.size(), inferenceParams.maxNewTokens,
+                                   quotaCharge, [&result](const std::string &text, const std::vector<int32_t> &tokens)
+                                   {
+                                       result.text += text;
+                                       result.tokens.insert(result.tokens.end(), tokens.begin(), tokens.end());
+                                   });
+                }
 
                 // Build response
                 ChatCompletionResponse response;
-                response.id = "chatcmpl-" + std::to_string(jobId);
+                response.id = "chatcmpl-" + std::to_string(jobIds.front());
                 response.object = "chat.completion";
                 response.created = static_cast<long long>(std::time(nullptr));
                 response.model = request.model;
 
-                // Build choice
-                ChatCompletionChoice choice;
-                choice.index = 0;
-                choice.message.role = "assistant";
-                choice.message.content = result.text;
-                choice.finish_reason = "stop";
+                // Build one choice per candidate
+                for (size_t index = 0; index < results.size(); ++index)
+                {
+                    ChatCompletionChoice choice;
+                    choice.index = static_cast<int>(index);
+                    choice.message.role = "assistant";
+                    choice.message.content = results[index].text;
+                    choice.finish_reason = "stop";
 
-                response.choices.push_back(choice);
+                    response.choices.push_back(choice);
+                }
 
                 // Compute usage from actual token counts
-                updateChatUsageStats(response, result, result.prompt_token_count);
+                updateChatUsageStats(response, results, results.front().prompt_token_count);
 
                 // Send response
-                json jResponse = response.to_json();
-                send_response(sock, 200, jResponse.dump());
+                std::string payload;
+                {
+                    tracing::Span serializeSpan("serialize");
+                    payload = response.to_json().dump();
+                }
+                send_response(sock, 200, payload);
+
+                if ((useCache || useSemanticCache) && !suspended && std::none_of(jobIds.begin(), jobIds.end(), [&engine](int jobId)
+                                                                         { return engine->hasJobError(jobId); }))
+                {
+                    ResponseCache::Response generated;
+                    for (const auto &choice : response.choices)
+                        generated.choices.push_back({choice.message.content});
+                    generated.prompt_tokens = response.usage.prompt_tokens;
+                    generated.completion_tokens = response.usage.completion_tokens;
+                    if (useSemanticCache)
+                        semanticCache.put(request.model, semanticContext, semanticGeneration, std::move(semanticEmbedding), generated);
+                    if (useCache)
+                        responseCache.put(request.model, cacheKey, cacheGeneration, std::move(generated));
+                }
 
-                ServerLogger::logInfo("[Thread %u] Non-streaming chat completion completed for model '%s'",
-                                      std::this_thread::get_id(), request.model.c_str());
+                for (int jobId : jobIds)
+                    engine->releaseJob(jobId);
+
+                KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Non-streaming chat completion completed for model '%s'",
+                                      std::hash<std::thread::id>{}(std::this_thread::get_id()), request.model.c_str());
             }
         }
         catch (const std::exception &ex)
         {
-            ServerLogger::logError("Error in chat completion: %s", ex.what());
+            KOLOSAL_LOG_ERROR("Error in chat completion: %s", ex.what());
             json jError = {{"error", {{"message", std::string("Error: ") + ex.what()}, {"type", "invalid_request_error"}, {"param", nullptr}, {"code", nullptr}}}};
             send_response(sock, 400, jError.dump());
         }
     }
 
-    void OaiCompletionsRoute::handleTextCompletion(SocketType sock, const std::string &body)
+    void OaiCompletionsRoute::handleTextCompletion(SocketType sock, const std::string &body, const std::string &subject)
     {
         try
         {
             auto j = json::parse(body);
-            ServerLogger::logInfo("[Thread %u] Received completion request", std::this_thread::get_id());
+            KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Received completion request", std::hash<std::thread::id>{}(std::this_thread::get_id()));
             logDetailedRequest("completion", j, body.size());
 
             // Parse the request
@@ -488,76 +903,79 @@ namespace kolosal
                 throw std::invalid_argument("Invalid request parameters");
             }
 
-            // Get the NodeManager and inference engine
-            auto &nodeManager = ServerAPI::instance().getNodeManager();
-            auto engine = nodeManager.getEngine(request.model);
-
-            if (!engine)
+            // Build inference parameters, extension fields (grammar, response_format, context shift) included
+            CompletionParameters inferenceParams = buildCompletionParameters(request, j);
+            const int candidates = candidateCount(request.n, request.best_of, request.stream);
+            // best_of keeps the n candidates the model finds most likely
+            inferenceParams.scoreOutput = candidates > request.n;
+
+            // Charge the tenant's token quota before any engine work is queued
+            auto &tokenQuota = ServerAPI::instance().getAuthMiddleware().getTokenQuota();
+            const size_t promptEstimate = estimatePromptTokens(inferenceParams);
+            auto reservation = tokenQuota.reserve(subject, request.model,
+                                                  promptEstimate + static_cast<size_t>(std::max(inferenceParams.maxNewTokens, 0)) * candidates);
+            if (!reservation.allowed)
             {
-                throw std::runtime_error("Model '" + request.model + "' not found or could not be loaded");
-            }
-
-            // Build inference parameters
-            CompletionParameters inferenceParams = buildCompletionParameters(request);
-
-            // Extend with grammar and JSON schema features
-            if (j.contains("grammar") && j["grammar"].is_string()) {
-                inferenceParams.grammar = j["grammar"].get<std::string>();
-            }
-            if (j.contains("response_format") && j["response_format"].is_object()) {
-                const auto &rf = j["response_format"];
-                if (rf.contains("type") && rf["type"].is_string()) {
-                    const std::string type = rf["type"].get<std::string>();
-                    if (type == "json_object") {
-                        inferenceParams.jsonSchema = std::string("{") + "\"type\":\"object\"}";
-                    } else if (type == "json_schema") {
-                        if (rf.contains("json_schema")) {
-                            const auto &js = rf["json_schema"];
-                            if (js.is_object()) {
-                                if (js.contains("schema") && js["schema"].is_object()) {
-                                    inferenceParams.jsonSchema = js["schema"].dump();
-                                } else {
-                                    inferenceParams.jsonSchema = js.dump();
-                                }
-                            } else if (js.is_string()) {
-                                inferenceParams.jsonSchema = js.get<std::string>();
-                            }
-                        }
-                    }
-                }
+                send_quota_exceeded(sock, reservation);
+                return;
             }
-            if (j.contains("jsonSchema")) {
-                if (j["jsonSchema"].is_string()) {
-                    inferenceParams.jsonSchema = j["jsonSchema"].get<std::string>();
-                } else if (j["jsonSchema"].is_object()) {
-                    inferenceParams.jsonSchema = j["jsonSchema"].dump();
+            auth::TokenQuotaCharge quotaCharge(tokenQuota, std::move(reservation));
+            ServerAPI::instance().getAuthMiddleware().getTenantShares().assign(subject, inferenceParams);
+
+            // A deterministic request seen before is answered without queueing any engine work
+            auto &responseCache = ResponseCache::instance();
+            const bool useCache = cacheableRequest(j, inferenceParams.temperature, request.seed.has_value());
+            const std::string cacheKey = useCache ? responseCacheKey(inferenceParams, request.n, candidates) : std::string();
+            const uint64_t cacheGeneration = useCache ? responseCache.generation(request.model) : 0;
+            if (useCache)
+            {
+                if (auto cached = responseCache.get(request.model, cacheKey))
+                {
+                    quotaCharge.setPromptTokens(static_cast<size_t>(cached->prompt_tokens));
+                    quotaCharge.addGeneratedTokens(static_cast<size_t>(cached->completion_tokens));
+                    sendCachedCompletion(sock, request.model, *cached, request.stream);
+                    KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Completion for model '%s' answered from the response cache",
+                                          std::hash<std::thread::id>{}(std::this_thread::get_id()), request.model.c_str());
+                    return;
                 }
             }
 
-            // Context shifting support (extension)
-            if (j.contains("allow_context_shift") && j["allow_context_shift"].is_boolean()) {
-                inferenceParams.allow_context_shift = j["allow_context_shift"].get<bool>();
+            // Get the NodeManager and inference engine
+            auto &nodeManager = ServerAPI::instance().getNodeManager();
+            NodeManager::Admission admission;
+            auto engine = nodeManager.getEngine(request.model, admission,
+                                                static_cast<int>(promptEstimate + static_cast<size_t>(std::max(inferenceParams.maxNewTokens, 0))));
+
+            if (admission.rejected)
+            {
+                sendOverloaded(sock, request.model, admission);
+                return;
             }
-            if (j.contains("n_discard") && j["n_discard"].is_number_integer()) {
-                inferenceParams.n_discard = j["n_discard"].get<int>();
+
+            if (!engine)
+            {
+                throw std::runtime_error("Model '" + request.model + "' not found or could not be loaded");
             }
 
-            finalizeStructuredOutput(inferenceParams, "completion");
+            // A long prompt is decoded on a prefill node; this node resumes from its KV state
+            inferenceParams.kvState = RemotePrefill::instance().fetch(body, promptEstimate);
 
             if (request.stream)
             {
                 // Handle streaming response
-                ServerLogger::logInfo("[Thread %u] Processing streaming completion request for model '%s'",
-                                      std::this_thread::get_id(), request.model.c_str());
+                KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Processing streaming completion request for model '%s'",
+                                      std::hash<std::thread::id>{}(std::this_thread::get_id()), request.model.c_str());
 
                 // Submit job to inference engine
-                int jobId = engine->submitCompletionsJob(inferenceParams);
+                const std::vector<int> jobIds = submitCandidates(*engine, inferenceParams, candidates);
 
-                if (jobId < 0)
+                if (jobIds.empty())
                 {
                     throw std::runtime_error("Failed to submit job to inference engine");
                 }
 
+                quotaCharge.setPromptTokens(promptEstimate);
+
                 // Send streaming headers
                 std::string headers = "HTTP/1.1 200 OK\r\n"
                                       "Content-Type: text/event-stream\r\n"
@@ -566,131 +984,173 @@ namespace kolosal
                                       "Access-Control-Allow-Origin: *\r\n"
                                       "Access-Control-Allow-Headers: *\r\n\r\n";
 
-                send(sock, headers.c_str(), static_cast<int>(headers.length()), 0);
-
-                // Poll for results and stream them
-                bool jobComplete = false;
-                std::string allText;
-                size_t lastTokenCount = 0;
+                kolosal::http_internal::send_all(sock, headers);
 
-                while (!jobComplete)
+                // Stream each delta as soon as the engine decodes it; only the delta text is serialized per event
+                SseChunkWriter writer(SseChunkWriter::Format::TextCompletion, "cmpl-" + std::to_string(jobIds.front()), request.model);
+                auto sendText = [&](size_t index, const std::string &text)
                 {
-                    std::this_thread::sleep_for(std::chrono::milliseconds(50));
-
-                    CompletionResult result = engine->getJobResult(jobId);
-
-                    // Check if we have new text to stream
-                    if (result.text.length() > allText.length())
+                    sendFrame(sock, writer.text(index, text));
+                };
+                auto sendFinish = [&](size_t index)
+                {
+                    sendFrame(sock, writer.finish(index));
+                };
+
+                ResponseCache::Response generated;
+                generated.choices.resize(jobIds.size());
+                bool failed = false;
+                bool suspended = false;
+                size_t streamedTokens = 0;
+                const bool completed = streamCandidates(sock, *engine, jobIds, quotaCharge, [&](size_t index, const CompletionDelta &delta)
+                {
+                    if (useCache)
                     {
-                        // Send new characters
-                        std::string newText = result.text.substr(allText.length());
-                        
-                        CompletionChunk chunk;
-                        chunk.id = "cmpl-" + std::to_string(jobId);
-                        chunk.object = "text_completion";
-                        chunk.created = static_cast<long long>(std::time(nullptr));
-                        chunk.model = request.model;
-
-                        CompletionChunkChoice choice;
-                        choice.text = newText;
-                        choice.index = 0;
-                        choice.finish_reason = "";
-
-                        chunk.choices.push_back(choice);
-
-                        json chunkJson = chunk.to_json();
-                        std::string chunkData = "data: " + chunkJson.dump() + "\n\n";
-                        send(sock, chunkData.c_str(), static_cast<int>(chunkData.length()), 0);
-                        
-                        allText = result.text;
-                        lastTokenCount = result.tokens.size();
+                        if (!delta.text.empty())
+                            generated.choices[index].push_back(delta.text);
+                        if (delta.prompt_token_count > 0)
+                            generated.prompt_tokens = delta.prompt_token_count;
+                        generated.completion_tokens += static_cast<int>(delta.tokens.size());
+                        failed = failed || delta.hasError;
                     }
+                    streamedTokens += delta.tokens.size();
 
-                    if (engine->isJobFinished(jobId))
-                    {
-                        jobComplete = true;
-
-                        // Send final chunk with finish_reason
-                        CompletionChunk finalChunk;
-                        finalChunk.id = "cmpl-" + std::to_string(jobId);
-                        finalChunk.object = "text_completion";
-                        finalChunk.created = static_cast<long long>(std::time(nullptr));
-                        finalChunk.model = request.model;
+                    if (!delta.text.empty())
+                        sendText(index, delta.text);
 
-                        CompletionChunkChoice finalChoice;
-                        finalChoice.text = "";
-                        finalChoice.index = 0;
-                        finalChoice.finish_reason = "stop";
+                    // A suspended job's output goes on once it resumes elsewhere
+                    if (delta.suspended)
+                        suspended = true;
+                    else if (delta.finished)
+                        sendFinish(index);
+                });
 
-                        finalChunk.choices.push_back(finalChoice);
+                // This node is draining: a peer generates the rest of the output
+                if (completed && suspended)
+                {
+                    failed = true;
+                    continueOnPeer(sock, *engine, jobIds.front(), request.model, body, streamedTokens, inferenceParams.maxNewTokens,
+                                   quotaCharge, [&](const std::string &text, const std::vector<int32_t> &)
+                                   {
+                                       if (!text.empty())
+                                           sendText(0, text);
+                                   });
+                    sendFinish(0);
+                }
 
-                        json finalChunkJson = finalChunk.to_json();
-                        std::string finalChunkData = "data: " + finalChunkJson.dump() + "\n\n";
-                        send(sock, finalChunkData.c_str(), static_cast<int>(finalChunkData.length()), 0);
+                if (completed)
+                {
+                    // Send [DONE]
+                    std::string doneData = "data: [DONE]\n\n";
+                    kolosal::http_internal::send_all(sock, doneData);
 
-                        // Send [DONE]
-                        std::string doneData = "data: [DONE]\n\n";
-                        send(sock, doneData.c_str(), static_cast<int>(doneData.length()), 0);
-                    }
+                    if (useCache && !failed)
+                        responseCache.put(request.model, cacheKey, cacheGeneration, std::move(generated));
                 }
 
-                ServerLogger::logInfo("[Thread %u] Streaming completion completed for model '%s'",
-                                      std::this_thread::get_id(), request.model.c_str());
+                for (int jobId : jobIds)
+                    engine->releaseJob(jobId);
+
+                KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Streaming completion completed for model '%s'",
+                                      std::hash<std::thread::id>{}(std::this_thread::get_id()), request.model.c_str());
             }
             else
             {
                 // Handle non-streaming response
-                ServerLogger::logInfo("[Thread %u] Processing non-streaming completion request for model '%s'",
-                                      std::this_thread::get_id(), request.model.c_str());
+                KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Processing non-streaming completion request for model '%s'",
+                                      std::hash<std::thread::id>{}(std::this_thread::get_id()), request.model.c_str());
 
                 // Submit job to inference engine
-                int jobId = engine->submitCompletionsJob(inferenceParams);
+                const std::vector<int> jobIds = submitCandidates(*engine, inferenceParams, candidates);
 
-                if (jobId < 0)
+                if (jobIds.empty())
                 {
                     throw std::runtime_error("Failed to submit job to inference engine");
                 }
 
+                quotaCharge.setPromptTokens(promptEstimate);
+
                 // Wait for completion
-                CompletionResult result;
-                while (!engine->isJobFinished(jobId))
+                if (!waitUnlessDisconnected(sock, *engine, jobIds))
                 {
-                    std::this_thread::sleep_for(std::chrono::milliseconds(100));
-                    result = engine->getJobResult(jobId);
+                    return;
                 }
 
-                // Get final result
-                result = engine->getJobResult(jobId);
+                // Get final results
+                std::vector<CompletionResult> results;
+                for (int jobId : jobIds)
+                {
+                    results.push_back(engine->getJobResult(jobId));
+                    quotaCharge.addGeneratedTokens(results.back().tokens.size());
+                    tracing::record_job(results.back().timing, jobId);
+                }
+                if (results.front().prompt_token_count > 0)
+                    quotaCharge.setPromptTokens(static_cast<size_t>(results.front().prompt_token_count));
+
+                // This node is draining: a peer generates the rest of the output
+                const bool suspended = results.front().suspended;
+                if (suspended)
+                {
+                    CompletionResult &result = results.front();
+                    continueOnPeer(sock, *engine, jobIds.front(), request.model, body, result.tokens.size(), inferenceParams.maxNewTokens,
+                                   quotaCharge, [&result](const std::string &text, const std::vector<int32_t> &tokens)
+                                   {
+                                       result.text += text;
+                                       result.tokens.insert(result.tokens.end(), tokens.begin(), tokens.end());
+                                   });
+                }
 
                 // Build response
                 CompletionResponse response;
-                response.id = "cmpl-" + std::to_string(jobId);
+                response.id = "cmpl-" + std::to_string(jobIds.front());
                 response.object = "text_completion";
                 response.created = static_cast<long long>(std::time(nullptr));
                 response.model = request.model;
 
-                // Build choice
-                CompletionChoice choice;
-                choice.index = 0;
-                choice.text = result.text;
-                choice.finish_reason = "stop";
+                // Build one choice per kept candidate
+                const std::vector<size_t> kept = bestCandidates(results, request.n);
+                for (size_t index = 0; index < kept.size(); ++index)
+                {
+                    CompletionChoice choice;
+                    choice.index = static_cast<int>(index);
+                    choice.text = results[kept[index]].text;
+                    choice.finish_reason = "stop";
 
-                response.choices.push_back(choice);
+                    response.choices.push_back(choice);
+                }
 
                 // Compute usage from actual token counts
-                updateCompletionUsageStats(response, result, result.prompt_token_count);
+                updateCompletionUsageStats(response, results, results.front().prompt_token_count);
 
                 // Send response
-                json jResponse = response.to_json();
-                send_response(sock, 200, jResponse.dump());
+                std::string payload;
+                {
+                    tracing::Span serializeSpan("serialize");
+                    payload = response.to_json().dump();
+                }
+                send_response(sock, 200, payload);
+
+                if (useCache && !suspended && std::none_of(jobIds.begin(), jobIds.end(), [&engine](int jobId)
+                                             { return engine->hasJobError(jobId); }))
+                {
+                    ResponseCache::Response generated;
+                    for (const auto &choice : response.choices)
+                        generated.choices.push_back({choice.text});
+                    generated.prompt_tokens = response.usage.prompt_tokens;
+                    generated.completion_tokens = response.usage.completion_tokens;
+                    responseCache.put(request.model, cacheKey, cacheGeneration, std::move(generated));
+                }
+
+                for (int jobId : jobIds)
+                    engine->releaseJob(jobId);
 
-                ServerLogger::logInfo("[Thread %u] Non-streaming completion completed for model '%s'",
-                                      std::this_thread::get_id(), request.model.c_str());
+                KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Non-streaming completion completed for model '%s'",
+                                      std::hash<std::thread::id>{}(std::this_thread::get_id()), request.model.c_str());
             }
         }
         catch (const std::exception &ex)
         {
-            ServerLogger::logError("Error in text completion: %s", ex.what());
+            KOLOSAL_LOG_ERROR("Error in text completion: %s", ex.what());
             json jError = {{"error", {{"message", std::string("Error: ") + ex.what()}, {"type", "invalid_request_error"}, {"param", nullptr}, {"code", nullptr}}}};
             send_response(sock, 400, jError.dump());
         }
@@ -0,0 +1,338 @@
+#include "kolosal/routes/llm/oai_parameters.hpp"
+#include "kolosal/models/chat_response_model.hpp"
+#include "kolosal/models/completion_response_model.hpp"
+#include "kolosal/server_api.hpp"
+#include "kolosal/auth/auth_middleware.hpp"
+#include "kolosal/logger.hpp"
+
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+#include <variant>
+
+using json = nlohmann::json;
+
+namespace kolosal
+{
+    namespace
+    {
+        /**
+         * @brief Flattens OpenAI's string-or-array "stop" field
+         */
+        std::vector<std::string> stopSequences(const std::optional<std::variant<std::string, std::vector<std::string>>> &stop)
+        {
+            if (!stop.has_value())
+            {
+                return {};
+            }
+            if (std::holds_alternative<std::string>(*stop))
+            {
+                return {std::get<std::string>(*stop)};
+            }
+            return std::get<std::vector<std::string>>(*stop);
+        }
+
+        // Grammar, JSON schema and context shifting, which the request models do not carry
+        template <typename P>
+        void applyExtensions(P &params, const json &j, const char *context)
+        {
+            if (j.contains("grammar") && j["grammar"].is_string()) {
+                params.grammar = j["grammar"].get<std::string>();
+            }
+
+            // Map OpenAI response_format to jsonSchema
+            if (j.contains("response_format") && j["response_format"].is_object()) {
+                const auto &rf = j["response_format"];
+                if (rf.contains("type") && rf["type"].is_string()) {
+                    const std::string type = rf["type"].get<std::string>();
+                    if (type == "json_object") {
+                        params.jsonSchema = std::string("{") + "\"type\":\"object\"}";
+                    } else if (type == "json_schema") {
+                        if (rf.contains("json_schema")) {
+                            const auto &js = rf["json_schema"];
+                            if (js.is_object()) {
+                                if (js.contains("schema") && js["schema"].is_object()) {
+                                    params.jsonSchema = js["schema"].dump();
+                                } else {
+                                    params.jsonSchema = js.dump();
+                                }
+                            } else if (js.is_string()) {
+                                params.jsonSchema = js.get<std::string>();
+                            }
+                        }
+                    }
+                }
+            }
+
+            // Also support custom top-level jsonSchema object/string
+            if (j.contains("jsonSchema")) {
+                if (j["jsonSchema"].is_string()) {
+                    params.jsonSchema = j["jsonSchema"].get<std::string>();
+                } else if (j["jsonSchema"].is_object()) {
+                    params.jsonSchema = j["jsonSchema"].dump();
+                }
+            }
+
+            // Context shifting support (extension)
+            if (j.contains("allow_context_shift") && j["allow_context_shift"].is_boolean()) {
+                params.allow_context_shift = j["allow_context_shift"].get<bool>();
+            }
+            if (j.contains("n_discard") && j["n_discard"].is_number_integer()) {
+                params.n_discard = j["n_discard"].get<int>();
+            }
+
+            if (!params.grammar.empty()) {
+                if (!params.jsonSchema.empty()) {
+                    KOLOSAL_LOG_INFO("[oai-%s] Both grammar & jsonSchema provided; grammar takes precedence", context);
+                } else {
+                    KOLOSAL_LOG_INFO("[oai-%s] Using provided grammar (chars=%zu)", context, params.grammar.size());
+                }
+            } else if (!params.jsonSchema.empty()) {
+                KOLOSAL_LOG_INFO("[oai-%s] Using provided JSON schema (chars=%zu)", context, params.jsonSchema.size());
+            }
+        }
+    }
+
+    ChatCompletionParameters buildChatCompletionParameters(const ChatCompletionRequest &request, const json &body)
+    {
+        ChatCompletionParameters params;
+
+        // Convert messages
+        params.messages.clear();
+        for (const auto &msg : request.messages)
+        {
+            params.messages.emplace_back(msg.role, msg.content);
+        }
+
+        // Set generation parameters
+        params.temperature = static_cast<float>(request.temperature);
+        params.topP = static_cast<float>(request.top_p);
+        params.streaming = request.stream;
+
+        // Set max tokens if specified
+        if (request.max_tokens.has_value())
+        {
+            params.maxNewTokens = request.max_tokens.value();
+        }
+
+        // Set random seed if specified
+        if (request.seed.has_value())
+        {
+            params.randomSeed = request.seed.value();
+        }
+
+        if (request.session_id.has_value())
+        {
+            params.sessionKey = request.session_id.value();
+        }
+
+        params.stop = stopSequences(request.stop);
+
+        if (request.prompt_lookup.has_value())
+        {
+            params.promptLookup = request.prompt_lookup.value() ? 1 : 0;
+        }
+
+        if (request.lora_adapter.has_value())
+        {
+            params.loraAdapter = request.lora_adapter.value();
+        }
+
+        applyExtensions(params, body, "chat");
+        return params;
+    }
+
+    CompletionParameters buildCompletionParameters(const CompletionRequest &request, const json &body)
+    {
+        CompletionParameters params;
+
+        // Set prompt based on request format
+        if (std::holds_alternative<std::string>(request.prompt))
+        {
+            params.prompt = std::get<std::string>(request.prompt);
+        }
+        else if (std::holds_alternative<std::vector<std::string>>(request.prompt))
+        {
+            // Join multiple prompts with newlines if array is provided
+            const auto &prompts = std::get<std::vector<std::string>>(request.prompt);
+            std::ostringstream joined;
+            for (size_t i = 0; i < prompts.size(); ++i)
+            {
+                joined << prompts[i];
+                if (i < prompts.size() - 1)
+                    joined << "\n";
+            }
+            params.prompt = joined.str();
+        }
+
+        // Set generation parameters
+        params.temperature = static_cast<float>(request.temperature);
+        params.topP = static_cast<float>(request.top_p);
+        params.streaming = request.stream;
+
+        // Set max tokens if specified
+        if (request.max_tokens.has_value())
+        {
+            params.maxNewTokens = request.max_tokens.value();
+        }
+
+        // Set random seed if specified
+        if (request.seed.has_value())
+        {
+            params.randomSeed = request.seed.value();
+        }
+
+        params.stop = stopSequences(request.stop);
+
+        if (request.prompt_lookup.has_value())
+        {
+            params.promptLookup = request.prompt_lookup.value() ? 1 : 0;
+        }
+
+        if (request.lora_adapter.has_value())
+        {
+            params.loraAdapter = request.lora_adapter.value();
+        }
+
+        applyExtensions(params, body, "completion");
+        return params;
+    }
+
+    size_t estimatePromptTokens(const ChatCompletionParameters &params)
+    {
+        size_t tokens = 0;
+        for (const auto &message : params.messages)
+        {
+            tokens += auth::TokenQuota::estimateTokens(message.content) + 4; // Role and template markers
+        }
+        return tokens;
+    }
+
+    size_t estimatePromptTokens(const CompletionParameters &params)
+    {
+        return auth::TokenQuota::estimateTokens(params.prompt);
+    }
+
+    RequestEstimate estimateRequestTokens(bool chat, const json &body, int candidates)
+    {
+        RequestEstimate estimate;
+        int maxNewTokens = 0;
+        if (chat)
+        {
+            ChatCompletionRequest parsed;
+            parsed.from_json(body);
+            if (!parsed.validate())
+                throw std::invalid_argument("Invalid request parameters");
+            const ChatCompletionParameters params = buildChatCompletionParameters(parsed, body);
+            estimate.promptTokens = estimatePromptTokens(params);
+            maxNewTokens = params.maxNewTokens;
+        }
+        else
+        {
+            CompletionRequest parsed;
+            parsed.from_json(body);
+            if (!parsed.validate())
+                throw std::invalid_argument("Invalid request parameters");
+            const CompletionParameters params = buildCompletionParameters(parsed, body);
+            estimate.promptTokens = estimatePromptTokens(params);
+            maxNewTokens = params.maxNewTokens;
+        }
+        estimate.totalTokens = estimate.promptTokens + static_cast<size_t>(std::max(maxNewTokens, 0)) * std::max(candidates, 1);
+        return estimate;
+    }
+
+    std::vector<int> submitCompletionJobs(IInferenceEngine &engine, bool chat, const json &body, int candidates, int priority,
+                                          const std::string &tenant)
+    {
+        const auto &tenantShares = ServerAPI::instance().getAuthMiddleware().getTenantShares();
+        std::vector<int> jobIds;
+        if (chat)
+        {
+            ChatCompletionRequest parsed;
+            parsed.from_json(body);
+            if (!parsed.validate())
+                throw std::invalid_argument("Invalid request parameters");
+            ChatCompletionParameters params = buildChatCompletionParameters(parsed, body);
+            params.streaming = false;
+            params.priority = priority;
+            if (!tenant.empty())
+                tenantShares.assign(tenant, params);
+            jobIds = candidates > 1 ? engine.submitChatCompletionsJobs(params, candidates)
+                                    : std::vector<int>{engine.submitChatCompletionsJob(params)};
+        }
+        else
+        {
+            CompletionRequest parsed;
+            parsed.from_json(body);
+            if (!parsed.validate())
+                throw std::invalid_argument("Invalid request parameters");
+            if (parsed.best_of.has_value() && *parsed.best_of != parsed.n)
+                throw std::invalid_argument("best_of is not supported here");
+            CompletionParameters params = buildCompletionParameters(parsed, body);
+            params.streaming = false;
+            params.priority = priority;
+            if (!tenant.empty())
+                tenantShares.assign(tenant, params);
+            jobIds = candidates > 1 ? engine.submitCompletionsJobs(params, candidates)
+                                    : std::vector<int>{engine.submitCompletionsJob(params)};
+        }
+
+        jobIds.erase(std::remove_if(jobIds.begin(), jobIds.end(), [](int jobId) { return jobId < 0; }), jobIds.end());
+        if (static_cast<int>(jobIds.size()) != candidates)
+        {
+            for (int jobId : jobIds)
+            {
+                engine.stopJob(jobId);
+                engine.releaseJob(jobId);
+            }
+            jobIds.clear();
+        }
+        return jobIds;
+    }
+
+    json completionResponseBody(bool chat, const std::string &model, int firstJobId, const std::vector<CompletionResult> &results)
+    {
+        int completionTokens = 0;
+        for (const auto &result : results)
+            completionTokens += static_cast<int>(result.tokens.size());
+        const int promptTokens = results.empty() ? 0 : results.front().prompt_token_count;
+
+        if (chat)
+        {
+            ChatCompletionResponse response;
+            response.id = "chatcmpl-" + std::to_string(firstJobId);
+            response.model = model;
+            for (size_t index = 0; index < results.size(); ++index)
+            {
+                ChatCompletionChoice choice;
+                choice.index = static_cast<int>(index);
+                choice.message.role = "assistant";
+                choice.message.content = results[index].text;
+                choice.finish_reason = "stop";
+                response.choices.push_back(choice);
+            }
+            response.usage.prompt_tokens = promptTokens;
+            response.usage.completion_tokens = completionTokens;
+            response.usage.total_tokens = promptTokens + completionTokens;
+            return response.to_json();
+        }
+
+        CompletionResponse response;
+        response.id = "cmpl-" + std::to_string(firstJobId);
+        response.object = "text_completion";
+        response.model = model;
+        for (size_t index = 0; index < results.size(); ++index)
+        {
+            CompletionChoice choice;
+            choice.index = static_cast<int>(index);
+            choice.text = results[index].text;
+            choice.finish_reason = "stop";
+            response.choices.push_back(choice);
+        }
+        response.usage.prompt_tokens = promptTokens;
+        response.usage.completion_tokens = completionTokens;
+        response.usage.total_tokens = promptTokens + completionTokens;
+        return response.to_json();
+    }
+
+} // namespace kolosal
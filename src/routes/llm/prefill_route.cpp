@@ -0,0 +1,133 @@
+#include "kolosal/routes/llm/prefill_route.hpp"
+#include "kolosal/routes/route_utils.hpp"
+#include "kolosal/routes/llm/oai_parameters.hpp"
+#include "kolosal/remote_prefill.hpp"
+#include "kolosal/server_api.hpp"
+#include "kolosal/node_manager.h"
+#include "kolosal/utils.hpp"
+#include "kolosal/logger.hpp"
+#include "inference_interface.h"
+#include <json.hpp>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+
+using json = nlohmann::json;
+
+namespace kolosal
+{
+
+bool PrefillRoute::match(const std::string& method, const std::string& path)
+{
+    return method == "POST" && path == "/v1/internal/prefill";
+}
+
+std::vector<RoutePattern> PrefillRoute::patterns() const
+{
+    return {{"POST", "/v1/internal/prefill"}};
+}
+
+void PrefillRoute::handle(SocketType sock, const RequestContext& request)
+{
+    try
+    {
+        if (request.body.empty())
+        {
+            throw std::invalid_argument("Request body is empty");
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        auto j = json::parse(request.body);
+
+        // The same parameter mapping as the completion routes, so the prompt tokenizes identically on the decode node
+        std::string model;
+        CompletionParameters completionParams;
+        ChatCompletionParameters chatParams;
+        const bool chat = j.contains("messages");
+        if (chat)
+        {
+            ChatCompletionRequest parsed;
+            parsed.from_json(j);
+            if (!parsed.validate())
+                throw std::invalid_argument("Invalid request parameters");
+            chatParams = buildChatCompletionParameters(parsed, j);
+            chatParams.prefillOnly = true;
+            chatParams.streaming = false;
+            model = parsed.model;
+        }
+        else if (j.contains("prompt"))
+        {
+            CompletionRequest parsed;
+            parsed.from_json(j);
+            if (!parsed.validate())
+                throw std::invalid_argument("Invalid request parameters");
+            completionParams = buildCompletionParameters(parsed, j);
+            completionParams.prefillOnly = true;
+            completionParams.streaming = false;
+            model = parsed.model;
+        }
+        else
+        {
+            throw std::invalid_argument("Invalid request: missing 'messages' or 'prompt' field");
+        }
+
+        auto engine = ServerAPI::instance().getNodeManager().getEngine(model);
+        if (!engine)
+        {
+            send_error_response(sock, 404, "Model '" + model + "' not found or could not be loaded", "invalid_request_error");
+            return;
+        }
+
+        const int jobId = chat ? engine->submitChatCompletionsJob(chatParams) : engine->submitCompletionsJob(completionParams);
+        if (jobId < 0)
+        {
+            throw std::runtime_error("Failed to submit job to inference engine");
+        }
+
+        // The decode node gives up after its timeout; stop prefilling for it once it has gone
+        while (!engine->waitForJob(jobId, 500))
+        {
+            if (client_disconnected(sock))
+            {
+                engine->stopJob(jobId);
+                engine->waitForJob(jobId);
+                engine->releaseJob(jobId);
+                return;
+            }
+        }
+
+        if (engine->hasJobError(jobId))
+        {
+            const std::string error = engine->getJobError(jobId);
+            engine->releaseJob(jobId);
+            send_error_response(sock, 500, "Prefill failed: " + error, "server_error");
+            return;
+        }
+
+        auto state = engine->getJobKvState(jobId);
+        engine->releaseJob(jobId);
+        if (!state)
+        {
+            send_error_response(sock, 500, "Prefill produced no KV state", "server_error");
+            return;
+        }
+
+        send_response(sock, 200, RemotePrefill::encode(*state), {{"Content-Type", "application/octet-stream"}});
+        KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Prefilled %zu tokens for model '%s' in %lld ms (%zu bytes of KV)",
+                              std::hash<std::thread::id>{}(std::this_thread::get_id()), state->tokens.size(), model.c_str(),
+                              static_cast<long long>(std::chrono::duration_cast<std::chrono::milliseconds>(
+                                  std::chrono::steady_clock::now() - start).count()),
+                              state->state.size());
+    }
+    catch (const json::parse_error& ex)
+    {
+        send_error_response(sock, 400, std::string("Invalid JSON: ") + ex.what(), "invalid_request_error");
+    }
+    catch (const std::exception& ex)
+    {
+        KOLOSAL_LOG_ERROR("[Thread %zu] Error handling prefill request: %s", std::hash<std::thread::id>{}(std::this_thread::get_id()), ex.what());
+        send_error_response(sock, 400, std::string("Error: ") + ex.what(), "invalid_request_error");
+    }
+}
+
+} // namespace kolosal
@@ -0,0 +1,180 @@
+#include "kolosal/routes/llm/score_route.hpp"
+#include "kolosal/models/score_request_model.hpp"
+#include "kolosal/utils.hpp"
+#include "kolosal/server_api.hpp"
+#include "kolosal/logger.hpp"
+#include "kolosal/node_manager.h"
+#include "inference_interface.h"
+#include <json.hpp>
+#include <stdexcept>
+#include <thread>
+
+using json = nlohmann::json;
+
+namespace kolosal
+{
+
+namespace
+{
+    json tokenToJson(const TokenLogprob& token)
+    {
+        return {{"token", token.text}, {"id", token.token}, {"logprob", token.logprob}};
+    }
+}
+
+bool ScoreRoute::match(const std::string& method, const std::string& path)
+{
+    return (method == "POST" && (path == "/v1/score" || path == "/score"));
+}
+
+std::vector<RoutePattern> ScoreRoute::patterns() const
+{
+    return {
+        {"POST", "/v1/score"},
+        {"POST", "/score"}
+    };
+}
+
+void ScoreRoute::handle(SocketType sock, const RequestContext& context)
+{
+    try
+    {
+        if (context.body.empty())
+        {
+            sendErrorResponse(sock, 400, "Request body is empty");
+            return;
+        }
+
+        json j;
+        try
+        {
+            j = json::parse(context.body);
+        }
+        catch (const json::parse_error& ex)
+        {
+            sendErrorResponse(sock, 400, "Invalid JSON: " + std::string(ex.what()));
+            return;
+        }
+
+        ScoreRequest request;
+        try
+        {
+            request.from_json(j);
+        }
+        catch (const std::runtime_error& ex)
+        {
+            sendErrorResponse(sock, 400, ex.what());
+            return;
+        }
+
+        if (!request.validate())
+        {
+            sendErrorResponse(sock, 400, "Invalid request parameters: model and a non-empty pairs array with non-empty prompts and continuations are required, top_logprobs must be between 0 and 20");
+            return;
+        }
+
+        auto& nodeManager = ServerAPI::instance().getNodeManager();
+        NodeManager::Admission admission;
+        auto engine = nodeManager.getEngine(request.model, admission);
+
+        if (admission.rejected)
+        {
+            json jError = {{"error", {{"message", "Model '" + request.model + "' is at capacity, retry later"},
+                                      {"type", "server_overloaded"}, {"param", nullptr}, {"code", "model_overloaded"}}}};
+            send_response(sock, 503, jError.dump(),
+                          {{"Content-Type", "application/json"}, {"Retry-After", std::to_string(admission.retryAfterSeconds)}});
+            return;
+        }
+
+        if (!engine)
+        {
+            sendErrorResponse(sock, 404, "Model '" + request.model + "' not found or could not be loaded", "model_not_found", "model");
+            return;
+        }
+
+        KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Scoring %zu continuation(s) with model '%s'",
+                              std::hash<std::thread::id>{}(std::this_thread::get_id()), request.pairs.size(), request.model.c_str());
+
+        std::vector<ScoringRequest> pairs;
+        pairs.reserve(request.pairs.size());
+        for (const auto& pair : request.pairs)
+        {
+            pairs.push_back({pair.prompt, pair.continuation});
+        }
+
+        std::vector<ScoringResult> scored;
+        try
+        {
+            scored = engine->score(pairs, request.top_logprobs);
+        }
+        catch (const std::exception& ex)
+        {
+            sendErrorResponse(sock, 500, "Failed to score continuations: " + std::string(ex.what()), "server_error");
+            return;
+        }
+
+        // Usage counts every token the model read, continuations included
+        int promptTokens = 0;
+        json results = json::array();
+        for (size_t i = 0; i < scored.size(); ++i)
+        {
+            const ScoringResult& result = scored[i];
+            json tokens = json::array();
+            for (const auto& token : result.tokens)
+            {
+                json item = tokenToJson(token);
+                if (request.top_logprobs > 0)
+                {
+                    json top = json::array();
+                    for (const auto& alternative : token.top)
+                    {
+                        top.push_back(tokenToJson(alternative));
+                    }
+                    item["top_logprobs"] = std::move(top);
+                }
+                tokens.push_back(std::move(item));
+            }
+            promptTokens += result.prompt_tokens + static_cast<int>(result.tokens.size());
+            results.push_back({
+                {"index", i},
+                {"logprob", result.logprob},
+                {"is_greedy", result.greedy},
+                {"prompt_tokens", result.prompt_tokens},
+                {"tokens", std::move(tokens)}
+            });
+        }
+
+        json response = {
+            {"object", "list"},
+            {"model", request.model},
+            {"results", std::move(results)},
+            {"usage", {{"prompt_tokens", promptTokens}, {"total_tokens", promptTokens}}}
+        };
+        send_response(sock, 200, response.dump());
+
+        KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Scored %zu continuation(s) with model '%s'",
+                              std::hash<std::thread::id>{}(std::this_thread::get_id()), scored.size(), request.model.c_str());
+    }
+    catch (const std::exception& ex)
+    {
+        KOLOSAL_LOG_ERROR("[Thread %zu] Error handling score request: %s", std::hash<std::thread::id>{}(std::this_thread::get_id()), ex.what());
+        sendErrorResponse(sock, 500, "Internal server error: " + std::string(ex.what()), "server_error");
+    }
+}
+
+void ScoreRoute::sendErrorResponse(
+    SocketType sock,
+    int status_code,
+    const std::string& error_message,
+    const std::string& error_type,
+    const std::string& param)
+{
+    json jError = {{"error", {{"message", error_message}, {"type", error_type},
+                              {"param", param.empty() ? json(nullptr) : json(param)}, {"code", nullptr}}}};
+    send_response(sock, status_code, jError.dump());
+
+    KOLOSAL_LOG_ERROR("[Thread %zu] Score request error (%d): %s",
+                           std::hash<std::thread::id>{}(std::this_thread::get_id()), status_code, error_message.c_str());
+}
+
+} // namespace kolosal
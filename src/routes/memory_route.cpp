@@ -0,0 +1,46 @@
+#include "kolosal/routes/memory_route.hpp"
+#include "kolosal/utils.hpp"
+#include "kolosal/server_api.hpp"
+#include "kolosal/node_manager.h"
+#include "kolosal/memory_report.hpp"
+#include "kolosal/logger.hpp"
+#include <json.hpp>
+#include <thread>
+
+using json = nlohmann::json;
+
+namespace kolosal
+{
+
+    bool MemoryRoute::match(const std::string &method, const std::string &path)
+    {
+        return (method == "GET" && path == "/debug/memory") || (method == "POST" && path == "/debug/memory/release");
+    }
+
+    std::vector<RoutePattern> MemoryRoute::patterns() const
+    {
+        return {{"GET", "/debug/memory"}, {"POST", "/debug/memory/release"}};
+    }
+
+    void MemoryRoute::handle(SocketType sock, const RequestContext &request)
+    {
+        try
+        {
+            if (request.method == "POST")
+            {
+                MemoryReport::releaseFreeMemory();
+                KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Released free allocator memory", std::hash<std::thread::id>{}(std::this_thread::get_id()));
+            }
+            const json body = MemoryReport::instance().render(ServerAPI::instance().getNodeManager());
+            send_response(sock, 200, body.dump(2));
+        }
+        catch (const std::exception &ex)
+        {
+            KOLOSAL_LOG_ERROR("[Thread %zu] Error building memory report: %s", std::hash<std::thread::id>{}(std::this_thread::get_id()), ex.what());
+
+            json jError = {{"error", {{"message", std::string("Server error: ") + ex.what()}, {"type", "server_error"}, {"param", nullptr}, {"code", nullptr}}}};
+            send_response(sock, 500, jError.dump());
+        }
+    }
+
+} // namespace kolosal
@@ -0,0 +1,44 @@
+#include "kolosal/routes/metrics_route.hpp"
+#include "kolosal/utils.hpp"
+#include "kolosal/server_api.hpp"
+#include "kolosal/node_manager.h"
+#include "kolosal/metrics.hpp"
+#include "kolosal/logger.hpp"
+#include "kolosal/auth/auth_middleware.hpp"
+#include <json.hpp>
+#include <thread>
+
+using json = nlohmann::json;
+
+namespace kolosal
+{
+
+    bool MetricsRoute::match(const std::string &method, const std::string &path)
+    {
+        return method == "GET" && path == "/metrics";
+    }
+
+    std::vector<RoutePattern> MetricsRoute::patterns() const
+    {
+        return {{"GET", "/metrics"}};
+    }
+
+    void MetricsRoute::handle(SocketType sock, const RequestContext &request)
+    {
+        try
+        {
+            auto &server = ServerAPI::instance();
+            const std::string body = Metrics::instance().render(server.getNodeManager(),
+                                                                &server.getAuthMiddleware().getRateLimiter());
+            send_response(sock, 200, body, {{"Content-Type", "text/plain; version=0.0.4; charset=utf-8"}});
+        }
+        catch (const std::exception &ex)
+        {
+            KOLOSAL_LOG_ERROR("[Thread %zu] Error rendering metrics: %s", std::hash<std::thread::id>{}(std::this_thread::get_id()), ex.what());
+
+            json jError = {{"error", {{"message", std::string("Server error: ") + ex.what()}, {"type", "server_error"}, {"param", nullptr}, {"code", nullptr}}}};
+            send_response(sock, 500, jError.dump());
+        }
+    }
+
+} // namespace kolosal
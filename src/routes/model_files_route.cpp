@@ -0,0 +1,169 @@
+#include "kolosal/routes/model_files_route.hpp"
+#include "kolosal/utils.hpp"
+#include "kolosal/download_utils.hpp"
+#include "kolosal/logger.hpp"
+#include <json.hpp>
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <filesystem>
+#include <thread>
+
+using json = nlohmann::json;
+
+namespace kolosal
+{
+
+    namespace
+    {
+        bool hasPrefix(const std::string &path, const char *prefix)
+        {
+            return path.compare(0, std::strlen(prefix), prefix) == 0;
+        }
+
+        // %XX escapes in the file name segment
+        std::string decodeName(const std::string &segment)
+        {
+            std::string name;
+            for (size_t i = 0; i < segment.size(); ++i)
+            {
+                if (segment[i] == '%' && i + 2 < segment.size() &&
+                    std::isxdigit(static_cast<unsigned char>(segment[i + 1])) &&
+                    std::isxdigit(static_cast<unsigned char>(segment[i + 2])))
+                {
+                    name += static_cast<char>(std::stoi(segment.substr(i + 1, 2), nullptr, 16));
+                    i += 2;
+                }
+                else
+                {
+                    name += segment[i];
+                }
+            }
+            return name;
+        }
+
+        // One "bytes=first-last", "bytes=first-" or "bytes=-suffix" range; multipart ranges are not served
+        bool parseRange(const std::string &header, std::uint64_t size, std::uint64_t &offset, std::uint64_t &length)
+        {
+            if (header.compare(0, 6, "bytes=") != 0 || header.find(',') != std::string::npos || size == 0)
+                return false;
+            const std::string spec = header.substr(6);
+            const size_t dash = spec.find('-');
+            if (dash == std::string::npos)
+                return false;
+            try
+            {
+                const std::string first = spec.substr(0, dash);
+                const std::string last = spec.substr(dash + 1);
+                if (first.empty())
+                {
+                    std::uint64_t suffix = static_cast<std::uint64_t>(std::stoull(last));
+                    if (suffix == 0)
+                        return false;
+                    offset = suffix >= size ? 0 : size - suffix;
+                    length = size - offset;
+                    return true;
+                }
+                offset = static_cast<std::uint64_t>(std::stoull(first));
+                std::uint64_t end = last.empty() ? size - 1 : (std::min)(static_cast<std::uint64_t>(std::stoull(last)), size - 1);
+                if (offset >= size || end < offset)
+                    return false;
+                length = end - offset + 1;
+                return true;
+            }
+            catch (const std::exception &)
+            {
+                return false;
+            }
+        }
+
+        void sendNotFound(SocketType sock, const std::string &name)
+        {
+            json jError = {{"error", {{"message", "No shareable model file named '" + name + "'"}, {"type", "not_found_error"}, {"param", "name"}, {"code", "model_file_not_found"}}}};
+            send_response(sock, 404, jError.dump());
+        }
+    }
+
+    bool ModelFilesRoute::match(const std::string &method, const std::string &path)
+    {
+        return (method == "GET" || method == "HEAD") &&
+               (hasPrefix(path, "/v1/model-files/") || hasPrefix(path, "/model-files/"));
+    }
+
+    std::vector<RoutePattern> ModelFilesRoute::patterns() const
+    {
+        return {
+            {"GET", "/v1/model-files/{name}"},
+            {"HEAD", "/v1/model-files/{name}"},
+            {"GET", "/model-files/{name}"},
+            {"HEAD", "/model-files/{name}"}};
+    }
+
+    void ModelFilesRoute::handle(SocketType sock, const RequestContext &request)
+    {
+        std::string segment = request.param("name");
+        segment = segment.substr(0, segment.find('?'));
+        const std::string name = decodeName(segment);
+
+        // Only plain file names inside the models directory; hidden files include the manifest itself
+        if (name.empty() || name[0] == '.' || name.find('/') != std::string::npos || name.find('\\') != std::string::npos)
+        {
+            sendNotFound(sock, name);
+            return;
+        }
+
+        const std::filesystem::path file = std::filesystem::path(get_executable_models_directory()) / name;
+        std::string sha256, sourceUrl;
+        if (!find_download_manifest_entry(file.string(), sha256, sourceUrl))
+        {
+            sendNotFound(sock, name);
+            return;
+        }
+
+        std::error_code ec;
+        const std::uint64_t size = std::filesystem::file_size(file, ec);
+        if (ec)
+        {
+            sendNotFound(sock, name);
+            return;
+        }
+
+        std::map<std::string, std::string> headers = {
+            {"Content-Type", "application/octet-stream"},
+            {"Accept-Ranges", "bytes"},
+            {"ETag", "\"" + sha256 + "\""},
+            {"X-Kolosal-Sha256", sha256}};
+        if (!sourceUrl.empty())
+        {
+            headers["X-Kolosal-Source-Url"] = sourceUrl;
+        }
+
+        int status = 200;
+        std::uint64_t offset = 0;
+        std::uint64_t length = size;
+        auto range = request.headers.find("range");
+        if (range != request.headers.end())
+        {
+            if (!parseRange(range->second, size, offset, length))
+            {
+                headers["Content-Range"] = "bytes */" + std::to_string(size);
+                send_file_response(sock, 416, file.string(), 0, 0, headers, false);
+                return;
+            }
+            status = 206;
+            headers["Content-Range"] = "bytes " + std::to_string(offset) + "-" + std::to_string(offset + length - 1) + "/" + std::to_string(size);
+        }
+
+        const bool sendBody = request.method != "HEAD";
+        if (!send_file_response(sock, status, file.string(), offset, length, headers, sendBody) && sendBody)
+        {
+            KOLOSAL_LOG_WARNING("[Thread %zu] Transfer of model file %s stopped early", std::hash<std::thread::id>{}(std::this_thread::get_id()), name.c_str());
+        }
+        else if (sendBody)
+        {
+            KOLOSAL_LOG_REQUEST_DEBUG("[Thread %zu] Served %llu bytes of model file %s", std::hash<std::thread::id>{}(std::this_thread::get_id()),
+                                   static_cast<unsigned long long>(length), name.c_str());
+        }
+    }
+
+} // namespace kolosal
@@ -26,12 +26,101 @@ using json = nlohmann::json;
 
 namespace kolosal
 {
+    namespace
+    {
+        // Request DTO to engine parameters, shared by add and swap
+        LoadingParameters toLoadingParameters(const AddModelRequest::LoadingParametersModel &in)
+        {
+            LoadingParameters loadParams;
+            loadParams.n_ctx = in.n_ctx;
+            loadParams.n_keep = in.n_keep;
+            loadParams.n_batch = in.n_batch;
+            loadParams.n_ubatch = in.n_ubatch;
+            loadParams.n_step_tokens = in.n_step_tokens;
+            loadParams.prefill_share = in.prefill_share;
+            loadParams.slo_ttft_ms = in.slo_ttft_ms;
+            loadParams.slo_tpot_ms = in.slo_tpot_ms;
+            loadParams.draft_model_path = in.draft_model_path;
+            loadParams.n_draft = in.n_draft;
+            loadParams.prompt_lookup = in.prompt_lookup;
+            loadParams.n_threads = in.n_threads;
+            loadParams.cpu_cores = in.cpu_cores;
+            loadParams.numa_node = in.numa_node;
+            loadParams.cache_type_k = in.cache_type_k;
+            loadParams.cache_type_v = in.cache_type_v;
+            loadParams.fit_vram = in.fit_vram;
+            loadParams.moe_offload = in.moe_offload;
+            loadParams.autotune = in.autotune;
+            loadParams.autotune_cache = in.autotune_cache;
+            loadParams.kv_host_cache_mb = in.kv_host_cache_mb;
+            loadParams.kv_disk_cache_mb = in.kv_disk_cache_mb;
+            loadParams.kv_disk_cache_dir = in.kv_disk_cache_dir;
+            loadParams.n_parallel = in.n_parallel;
+            loadParams.n_replicas = in.n_replicas;
+            loadParams.embedding_contexts = in.embedding_contexts;
+            loadParams.embedding_batch_window_us = in.embedding_batch_window_us;
+            loadParams.n_prefix_cache = in.n_prefix_cache;
+            loadParams.prefix_cache_dir = in.prefix_cache_dir;
+            loadParams.prefix_cache_save_seconds = in.prefix_cache_save_seconds;
+            loadParams.chunk_cache_mb = in.chunk_cache_mb;
+            loadParams.preempt_swap_mb = in.preempt_swap_mb;
+            loadParams.kv_block_tokens = in.kv_block_tokens;
+            loadParams.max_seq_ctx = in.max_seq_ctx;
+            loadParams.max_queued_jobs = in.max_queued_jobs;
+            loadParams.max_queued_tokens = in.max_queued_tokens;
+            loadParams.profile_steps = in.profile_steps;
+            loadParams.n_gpu_layers = in.n_gpu_layers;
+            loadParams.split_mode = in.split_mode;
+            loadParams.use_mmap = in.use_mmap;
+            loadParams.prefetch_weights = in.prefetch_weights;
+            loadParams.huge_pages = in.huge_pages;
+            loadParams.repack_cache_mb = in.repack_cache_mb;
+            loadParams.use_mlock = in.use_mlock;
+            loadParams.cont_batching = in.cont_batching;
+            loadParams.warmup = in.warmup;
+            loadParams.tensor_split = in.tensor_split;
+            for (const auto &adapter : in.lora_adapters)
+            {
+                loadParams.lora_adapters.push_back({adapter.name, adapter.path, adapter.scale});
+            }
+            loadParams.lora_max_loaded = in.lora_max_loaded;
+
+            // ---------------------------------------------------------------------
+            // Automatic multi-GPU utilization
+            // If caller did not specify an explicit tensor_split and n_gpu_layers > 0,
+            // attempt to distribute work evenly across all detected devices.
+            // A split_mode value of -1 (sentinel from CLI) or 0 with empty tensor_split
+            // triggers auto mode. We set layer split (1) for simplicity.
+            // ---------------------------------------------------------------------
+            try {
+                bool wants_auto = (loadParams.tensor_split.empty() && loadParams.n_gpu_layers > 0 && (loadParams.split_mode <= 0));
+                if (wants_auto) {
+                    size_t dev_count = 1;
+                    try { dev_count = (size_t) llama_max_devices(); } catch (...) { dev_count = 1; }
+                    if (dev_count > 1) {
+                        loadParams.split_mode = 1; // layer split
+                        loadParams.tensor_split.assign(dev_count, 1.0f / static_cast<float>(dev_count));
+                        // Adjust last element to fix any floating point drift
+                        float sum = 0.0f; for (size_t i = 0; i < dev_count - 1; ++i) sum += loadParams.tensor_split[i];
+                        loadParams.tensor_split.back() = 1.0f - sum;
+                        KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Auto multi-GPU enabled: %zu devices (split_mode=1)", std::hash<std::thread::id>{}(std::this_thread::get_id()), dev_count);
+                    }
+                }
+            } catch (const std::exception &e) {
+                KOLOSAL_LOG_WARNING("[Thread %zu] Auto multi-GPU setup failed: %s", std::hash<std::thread::id>{}(std::this_thread::get_id()), e.what());
+            }
+
+            return loadParams;
+        }
+    } // namespace
+
     ModelsRoute::ModelsRoute()
         : modelsPattern_(R"(^/(v1/)?models/?$)")
         , modelIdPattern_(R"(^/(v1/)?models/([^/]+)/?$)")
         , modelStatusPattern_(R"(^/(v1/)?models/([^/]+)/status/?$)")
+        , modelProfilePattern_(R"(^/(v1/)?models/([^/]+)/profile/?$)")
     {
-        ServerLogger::logInfo("ModelsRoute initialized");
+        KOLOSAL_LOG_INFO("ModelsRoute initialized");
     }
 
     ModelsRoute::~ModelsRoute() = default;
@@ -40,8 +129,9 @@ namespace kolosal
     {
         // Match all model-related endpoints:
         // GET/POST /models, /v1/models
-        // GET/DELETE /models/{id}, /v1/models/{id}  
+        // GET/PUT/DELETE /models/{id}, /v1/models/{id}  
         // GET /models/{id}/status, /v1/models/{id}/status
+        // GET /models/{id}/profile, /v1/models/{id}/profile
         
         bool matches = false;
         
@@ -51,40 +141,66 @@ namespace kolosal
         }
         else if (std::regex_match(path, modelIdPattern_))
         {
-            matches = (method == "GET" || method == "DELETE");
+            matches = (method == "GET" || method == "PUT" || method == "DELETE");
         }
-        else if (std::regex_match(path, modelStatusPattern_))
+        else if (std::regex_match(path, modelStatusPattern_) || std::regex_match(path, modelProfilePattern_))
         {
             matches = (method == "GET");
         }
-        
-        // Store matched path and method for use in handle()
-        if (matches)
-        {
-            matched_path_ = path;
-            matched_method_ = method;
-        }
-        
+
         return matches;
     }
 
-    void ModelsRoute::handle(SocketType sock, const std::string &body)
+    std::vector<RoutePattern> ModelsRoute::patterns() const
+    {
+        return {
+            {"GET", "/models"},
+            {"POST", "/models"},
+            {"GET", "/models/{id}"},
+            {"PUT", "/models/{id}"},
+            {"DELETE", "/models/{id}"},
+            {"GET", "/models/{id}/status"},
+            {"GET", "/models/{id}/profile"},
+            {"GET", "/v1/models"},
+            {"POST", "/v1/models"},
+            {"GET", "/v1/models/{id}"},
+            {"PUT", "/v1/models/{id}"},
+            {"DELETE", "/v1/models/{id}"},
+            {"GET", "/v1/models/{id}/status"},
+            {"GET", "/v1/models/{id}/profile"}
+        };
+    }
+
+    void ModelsRoute::handle(SocketType sock, const RequestContext &request)
     {
         try
         {
-            ServerLogger::logDebug("[Thread %u] Received %s request for path: %s", 
-                                   std::this_thread::get_id(), matched_method_.c_str(), matched_path_.c_str());
+            KOLOSAL_LOG_REQUEST_DEBUG("[Thread %zu] Received %s request for path: %s", 
+                                   std::hash<std::thread::id>{}(std::this_thread::get_id()), request.method.c_str(), request.path.c_str());
 
-            // Route to appropriate handler based on stored method and path
-            if (std::regex_match(matched_path_, modelsPattern_))
+            // Route to appropriate handler based on method and path
+            if (std::regex_match(request.path, modelsPattern_))
             {
-                if (matched_method_ == "GET")
+                if (request.method == "GET")
                 {
-                    handleListModels(sock, body);
+                    handleListModels(sock, request.body);
+                }
+                else if (request.method == "POST")
+                {
+                    handleAddModel(sock, request.body);
+                }
+                else
+                {
+                    json jError = {{"error", {{"message", "Method not allowed"}, {"type", "method_not_allowed"}, {"param", nullptr}, {"code", nullptr}}}};
+                    send_response(sock, 405, jError.dump());
                 }
-                else if (matched_method_ == "POST")
+            }
+            else if (std::regex_match(request.path, modelStatusPattern_))
+            {
+                if (request.method == "GET")
                 {
-                    handleAddModel(sock, body);
+                    std::string modelId = extractModelIdFromPath(request.path);
+                    handleModelStatus(sock, request.body, modelId);
                 }
                 else
                 {
@@ -92,12 +208,11 @@ namespace kolosal
                     send_response(sock, 405, jError.dump());
                 }
             }
-            else if (std::regex_match(matched_path_, modelStatusPattern_))
+            else if (std::regex_match(request.path, modelProfilePattern_))
             {
-                if (matched_method_ == "GET")
+                if (request.method == "GET")
                 {
-                    std::string modelId = extractModelIdFromPath(matched_path_);
-                    handleModelStatus(sock, body, modelId);
+                    handleModelProfile(sock, extractModelIdFromPath(request.path));
                 }
                 else
                 {
@@ -105,17 +220,21 @@ namespace kolosal
                     send_response(sock, 405, jError.dump());
                 }
             }
-            else if (std::regex_match(matched_path_, modelIdPattern_))
+            else if (std::regex_match(request.path, modelIdPattern_))
             {
-                std::string modelId = extractModelIdFromPath(matched_path_);
+                std::string modelId = extractModelIdFromPath(request.path);
                 
-                if (matched_method_ == "GET")
+                if (request.method == "GET")
                 {
-                    handleGetModel(sock, body, modelId);
+                    handleGetModel(sock, request.body, modelId);
                 }
-                else if (matched_method_ == "DELETE")
+                else if (request.method == "PUT")
                 {
-                    handleRemoveModel(sock, body, modelId);
+                    handleSwapModel(sock, request.body, modelId);
+                }
+                else if (request.method == "DELETE")
+                {
+                    handleRemoveModel(sock, request.body, modelId);
                 }
                 else
                 {
@@ -131,7 +250,7 @@ namespace kolosal
         }
         catch (const std::exception &ex)
         {
-            ServerLogger::logError("[Thread %u] Error in ModelsRoute: %s", std::this_thread::get_id(), ex.what());
+            KOLOSAL_LOG_ERROR("[Thread %zu] Error in ModelsRoute: %s", std::hash<std::thread::id>{}(std::this_thread::get_id()), ex.what());
             json jError = {{"error", {{"message", std::string("Server error: ") + ex.what()}, {"type", "server_error"}, {"param", nullptr}, {"code", nullptr}}}};
             send_response(sock, 500, jError.dump());
         }
@@ -141,7 +260,7 @@ namespace kolosal
     {
         try
         {
-            ServerLogger::logDebug("[Thread %u] Received list models request", std::this_thread::get_id());
+            KOLOSAL_LOG_REQUEST_DEBUG("[Thread %zu] Received list models request", std::hash<std::thread::id>{}(std::this_thread::get_id()));
 
             // Get the NodeManager and list engines
             auto &nodeManager = ServerAPI::instance().getNodeManager();
@@ -149,6 +268,7 @@ namespace kolosal
 
             json modelsList = json::array();
             int embeddingModels = 0;
+            int rerankModels = 0;
             int llmModels = 0;
             int loadedModels = 0;
             int unloadedModels = 0;
@@ -160,11 +280,31 @@ namespace kolosal
 
                 json modelInfo = {
                     {"model_id", engineId},
-                    {"status", isLoaded ? "loaded" : "unloaded"},
+                    {"status", isLoaded ? "loaded" : nodeManager.isEngineHibernated(engineId) ? "hibernated" : "unloaded"},
                     {"available", exists},
                     {"last_accessed", "recently"} // Could be enhanced with actual timestamps
                 };
 
+                // From the model catalog, so listing reads no model files
+                if (auto info = nodeManager.getModelInfo(engineId))
+                {
+                    modelInfo["file_size"] = info->file_size;
+                    if (info->gguf)
+                    {
+                        modelInfo["metadata"] = {
+                            {"architecture", info->architecture},
+                            {"name", info->name},
+                            {"file_type", info->file_type},
+                            {"context_length", info->context_length},
+                            {"embedding_length", info->embedding_length},
+                            {"block_count", info->block_count},
+                            {"head_count", info->head_count},
+                            {"head_count_kv", info->head_count_kv},
+                            {"tensor_count", info->tensor_count},
+                            {"tensor_bytes", info->tensor_bytes}};
+                    }
+                }
+
                 // Try to determine model type and capabilities
                 try
                 {
@@ -175,6 +315,7 @@ namespace kolosal
                     // Check if the model ID contains embedding-related keywords
                     std::string lowerEngineId = engineId;
                     std::transform(lowerEngineId.begin(), lowerEngineId.end(), lowerEngineId.begin(), ::tolower);
+                    const bool isRerankModel = lowerEngineId.find("rerank") != std::string::npos;
                     
                     if (lowerEngineId.find("embedding") != std::string::npos ||
                         lowerEngineId.find("embed") != std::string::npos ||
@@ -183,7 +324,13 @@ namespace kolosal
                         isEmbeddingModel = true;
                     }
                     
-                    if (isEmbeddingModel)
+                    if (isRerankModel)
+                    {
+                        modelInfo["model_type"] = "rerank";
+                        modelInfo["capabilities"] = json::array({"rerank", "retrieval"});
+                        rerankModels++;
+                    }
+                    else if (isEmbeddingModel)
                     {
                         modelInfo["model_type"] = "embedding";
                         modelInfo["capabilities"] = json::array({"embedding", "retrieval"});
@@ -209,8 +356,8 @@ namespace kolosal
                 }
                 catch (const std::exception &ex)
                 {
-                    ServerLogger::logWarning("[Thread %u] Error getting model info for '%s': %s", 
-                                           std::this_thread::get_id(), engineId.c_str(), ex.what());
+                    KOLOSAL_LOG_WARNING("[Thread %zu] Error getting model info for '%s': %s", 
+                                           std::hash<std::thread::id>{}(std::this_thread::get_id()), engineId.c_str(), ex.what());
                     modelInfo["model_type"] = "unknown";
                     modelInfo["capabilities"] = json::array();
                     modelInfo["inference_ready"] = false;
@@ -225,6 +372,7 @@ namespace kolosal
                 {"summary", {
                     {"total_models", modelsList.size()},
                     {"embedding_models", embeddingModels},
+                    {"rerank_models", rerankModels},
                     {"llm_models", llmModels},
                     {"loaded_models", loadedModels},
                     {"unloaded_models", unloadedModels}
@@ -232,12 +380,12 @@ namespace kolosal
             };
 
             send_response(sock, 200, response.dump());
-            ServerLogger::logDebug("[Thread %u] Successfully listed %zu models (%d embedding, %d LLM, %d loaded)", 
-                                   std::this_thread::get_id(), modelsList.size(), embeddingModels, llmModels, loadedModels);
+            KOLOSAL_LOG_REQUEST_DEBUG("[Thread %zu] Successfully listed %zu models (%d embedding, %d LLM, %d loaded)", 
+                                   std::hash<std::thread::id>{}(std::this_thread::get_id()), modelsList.size(), embeddingModels, llmModels, loadedModels);
         }
         catch (const std::exception &ex)
         {
-            ServerLogger::logError("[Thread %u] Error handling list models request: %s", std::this_thread::get_id(), ex.what());
+            KOLOSAL_LOG_ERROR("[Thread %zu] Error handling list models request: %s", std::hash<std::thread::id>{}(std::this_thread::get_id()), ex.what());
             json jError = {{"error", {{"message", std::string("Server error: ") + ex.what()}, {"type", "server_error"}, {"param", nullptr}, {"code", nullptr}}}};
             send_response(sock, 500, jError.dump());
         }
@@ -248,7 +396,7 @@ namespace kolosal
         // This is a complex implementation, let's include the original logic from AddModelRoute
         try
         {
-            ServerLogger::logInfo("[Thread %u] Received add model request", std::this_thread::get_id());
+            KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Received add model request", std::hash<std::thread::id>{}(std::this_thread::get_id()));
 
             if (body.empty())
             {
@@ -289,7 +437,7 @@ namespace kolosal
                 {
                     // Only fall back to platform-specific default if no default is configured
                     inferenceEngine = getPlatformDefaultInferenceEngine();
-                    ServerLogger::logWarning("No default inference engine configured, falling back to %s for model '%s'", 
+                    KOLOSAL_LOG_WARNING("No default inference engine configured, falling back to %s for model '%s'", 
                                            inferenceEngine.c_str(), modelId.c_str());
                 }
             }
@@ -298,56 +446,18 @@ namespace kolosal
             int mainGpuId = request.main_gpu_id;
             bool loadImmediately = request.load_immediately;
 
-            // Convert loading parameters
-            LoadingParameters loadParams;
-            loadParams.n_ctx = request.loading_parameters.n_ctx;
-            loadParams.n_keep = request.loading_parameters.n_keep;
-            loadParams.n_batch = request.loading_parameters.n_batch;
-            loadParams.n_ubatch = request.loading_parameters.n_ubatch;
-            loadParams.n_parallel = request.loading_parameters.n_parallel;
-            loadParams.n_gpu_layers = request.loading_parameters.n_gpu_layers;
-            loadParams.split_mode = request.loading_parameters.split_mode;
-            loadParams.use_mmap = request.loading_parameters.use_mmap;
-            loadParams.use_mlock = request.loading_parameters.use_mlock;
-            loadParams.cont_batching = request.loading_parameters.cont_batching;
-            loadParams.warmup = request.loading_parameters.warmup;
-            loadParams.tensor_split = request.loading_parameters.tensor_split;
-
-            // ---------------------------------------------------------------------
-            // Automatic multi-GPU utilization
-            // If caller did not specify an explicit tensor_split and n_gpu_layers > 0,
-            // attempt to distribute work evenly across all detected devices.
-            // A split_mode value of -1 (sentinel from CLI) or 0 with empty tensor_split
-            // triggers auto mode. We set layer split (1) for simplicity.
-            // ---------------------------------------------------------------------
-            try {
-                bool wants_auto = (loadParams.tensor_split.empty() && loadParams.n_gpu_layers > 0 && (loadParams.split_mode <= 0));
-                if (wants_auto) {
-                    size_t dev_count = 1;
-                    try { dev_count = (size_t) llama_max_devices(); } catch (...) { dev_count = 1; }
-                    if (dev_count > 1) {
-                        loadParams.split_mode = 1; // layer split
-                        loadParams.tensor_split.assign(dev_count, 1.0f / static_cast<float>(dev_count));
-                        // Adjust last element to fix any floating point drift
-                        float sum = 0.0f; for (size_t i = 0; i < dev_count - 1; ++i) sum += loadParams.tensor_split[i];
-                        loadParams.tensor_split.back() = 1.0f - sum;
-                        ServerLogger::logInfo("[Thread %u] Auto multi-GPU enabled: %zu devices (split_mode=1)", std::this_thread::get_id(), dev_count);
-                    }
-                }
-            } catch (const std::exception &e) {
-                ServerLogger::logWarning("[Thread %u] Auto multi-GPU setup failed: %s", std::this_thread::get_id(), e.what());
-            }
+            LoadingParameters loadParams = toLoadingParameters(request.loading_parameters);
 
             std::string errorMessage;
             std::string errorType;
             int errorCode = 500;
 
             // Validate model type and provide helpful feedback
-            if (modelType != "llm" && modelType != "embedding")
+            if (modelType != "llm" && modelType != "embedding" && modelType != "rerank")
             {
-                ServerLogger::logError("[Thread %u] Invalid model_type '%s' for model '%s'. Must be 'llm' or 'embedding'", 
-                                      std::this_thread::get_id(), modelType.c_str(), modelId.c_str());
-                json jError = {{"error", {{"message", "Invalid model_type. Must be 'llm' or 'embedding'"}, {"type", "invalid_request_error"}, {"param", "model_type"}, {"code", nullptr}}}};
+                KOLOSAL_LOG_ERROR("[Thread %zu] Invalid model_type '%s' for model '%s'. Must be 'llm', 'embedding' or 'rerank'", 
+                                      std::hash<std::thread::id>{}(std::this_thread::get_id()), modelType.c_str(), modelId.c_str());
+                json jError = {{"error", {{"message", "Invalid model_type. Must be 'llm', 'embedding' or 'rerank'"}, {"type", "invalid_request_error"}, {"param", "model_type"}, {"code", nullptr}}}};
                 send_response(sock, 400, jError.dump());
                 return;
             }
@@ -355,26 +465,26 @@ namespace kolosal
             // Log specific information for embedding models
             if (modelType == "embedding")
             {
-                ServerLogger::logInfo("[Thread %u] Processing embedding model '%s' with inference engine '%s'", 
-                                     std::this_thread::get_id(), modelId.c_str(), inferenceEngine.c_str());
+                KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Processing embedding model '%s' with inference engine '%s'", 
+                                     std::hash<std::thread::id>{}(std::this_thread::get_id()), modelId.c_str(), inferenceEngine.c_str());
                 
                 // Embedding-specific parameter recommendations
                 if (loadParams.n_ctx > 8192)
                 {
-                    ServerLogger::logWarning("[Thread %u] Large context size (n_ctx=%d) for embedding model '%s' may not be necessary. Consider reducing for better performance",
-                                           std::this_thread::get_id(), loadParams.n_ctx, modelId.c_str());
+                    KOLOSAL_LOG_WARNING("[Thread %zu] Large context size (n_ctx=%d) for embedding model '%s' may not be necessary. Consider reducing for better performance",
+                                           std::hash<std::thread::id>{}(std::this_thread::get_id()), loadParams.n_ctx, modelId.c_str());
                 }
                 
                 if (loadParams.n_parallel > 4)
                 {
-                    ServerLogger::logWarning("[Thread %u] High parallel processing (n_parallel=%d) for embedding model '%s' may not improve performance significantly",
-                                           std::this_thread::get_id(), loadParams.n_parallel, modelId.c_str());
+                    KOLOSAL_LOG_WARNING("[Thread %zu] High parallel processing (n_parallel=%d) for embedding model '%s' may not improve performance significantly",
+                                           std::hash<std::thread::id>{}(std::this_thread::get_id()), loadParams.n_parallel, modelId.c_str());
                 }
             }
             else
             {
-                ServerLogger::logInfo("[Thread %u] Processing LLM model '%s' with inference engine '%s'", 
-                                     std::this_thread::get_id(), modelId.c_str(), inferenceEngine.c_str());
+                KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Processing LLM model '%s' with inference engine '%s'", 
+                                     std::hash<std::thread::id>{}(std::this_thread::get_id()), modelId.c_str(), inferenceEngine.c_str());
             }
 
             std::string modelPathStr = modelPath;
@@ -402,15 +512,15 @@ namespace kolosal
                         if (fileSize >= previous_download->total_bytes)
                         {
                             // File is complete
-                            ServerLogger::logInfo("[Thread %u] Model file already complete locally at: %s (%llu bytes)", 
-                                                  std::this_thread::get_id(), downloadPath.c_str(), fileSize);
+                            KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Model file already complete locally at: %s (%llu bytes)", 
+                                                  std::hash<std::thread::id>{}(std::this_thread::get_id()), downloadPath.c_str(), fileSize);
                             fileIsComplete = true;
                         }
                         else
                         {
                             // File is incomplete - need to resume download
-                            ServerLogger::logInfo("[Thread %u] Model file incomplete locally at: %s (%llu/%llu bytes), will resume download", 
-                                                  std::this_thread::get_id(), downloadPath.c_str(), fileSize, previous_download->total_bytes);
+                            KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Model file incomplete locally at: %s (%llu/%llu bytes), will resume download", 
+                                                  std::hash<std::thread::id>{}(std::this_thread::get_id()), downloadPath.c_str(), fileSize, previous_download->total_bytes);
                         }
                     }
                     else
@@ -420,17 +530,26 @@ namespace kolosal
                         // Assume files smaller than 100MB might be incomplete for large models
                         if (fileSize > 100 * 1024 * 1024) // 100 MB threshold
                         {
-                            ServerLogger::logInfo("[Thread %u] Model file exists and seems complete at: %s (%llu bytes)", 
-                                                  std::this_thread::get_id(), downloadPath.c_str(), fileSize);
+                            KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Model file exists and seems complete at: %s (%llu bytes)", 
+                                                  std::hash<std::thread::id>{}(std::this_thread::get_id()), downloadPath.c_str(), fileSize);
                             fileIsComplete = true;
                         }
                         else
                         {
-                            ServerLogger::logInfo("[Thread %u] Model file exists but seems small at: %s (%llu bytes), will restart download", 
-                                                  std::this_thread::get_id(), downloadPath.c_str(), fileSize);
+                            KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Model file exists but seems small at: %s (%llu bytes), will restart download", 
+                                                  std::hash<std::thread::id>{}(std::this_thread::get_id()), downloadPath.c_str(), fileSize);
                         }
                     }
                     
+                    // A checksum the file has not been verified against sends it through the download
+                    // manager, which hashes it once and records the result
+                    if (fileIsComplete && !request.sha256.empty() && !is_download_verified(downloadPath, request.sha256))
+                    {
+                        KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Model file at %s has not been verified against the requested SHA-256",
+                                              std::hash<std::thread::id>{}(std::this_thread::get_id()), downloadPath.c_str());
+                        fileIsComplete = false;
+                    }
+
                     if (fileIsComplete)
                     {
                         actualModelPath = downloadPath;
@@ -453,8 +572,8 @@ namespace kolosal
                     auto previous_download = download_manager.getDownloadProgress(modelId);
                     if (previous_download && (previous_download->cancelled || previous_download->status == "failed"))
                     {
-                        ServerLogger::logInfo("[Thread %u] Previous download for model '%s' was cancelled or failed, restarting", 
-                                             std::this_thread::get_id(), modelId.c_str());
+                        KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Previous download for model '%s' was cancelled or failed, restarting", 
+                                             std::hash<std::thread::id>{}(std::this_thread::get_id()), modelId.c_str());
                         // Cancel the old download record to clean it up
                         download_manager.cancelDownload(modelId);
                     }
@@ -468,7 +587,11 @@ namespace kolosal
                     engine_params.loading_params = loadParams;
                     engine_params.inference_engine = inferenceEngine;
 
-                    bool download_started = download_manager.startDownloadWithEngine(modelId, modelPathStr, downloadPath, engine_params);
+                    DownloadPriority priority = DownloadPriority::Normal;
+                    parseDownloadPriority(request.priority, priority);
+
+                    bool download_started = download_manager.startDownloadWithEngine(modelId, modelPathStr, downloadPath, engine_params,
+                                                                                     request.sha256, priority);
 
                     if (!download_started)
                     {
@@ -484,30 +607,32 @@ namespace kolosal
                                 {"local_path", downloadPath}
                             };
                             send_response(sock, 202, jResponse.dump());
-                            ServerLogger::logInfo("[Thread %u] Model download already in progress: %s", std::this_thread::get_id(), modelId.c_str());
+                            KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Model download already in progress: %s", std::hash<std::thread::id>{}(std::this_thread::get_id()), modelId.c_str());
                             return;
                         }
                         else
                         {
                             json jError = {{"error", {{"message", "Failed to start download. This could be due to invalid URL or server configuration."}, {"type", "download_error"}, {"param", "model_path"}, {"code", "download_start_failed"}}}};
                             send_response(sock, 500, jError.dump());
-                            ServerLogger::logError("[Thread %u] Failed to start download for model: %s", std::this_thread::get_id(), modelId.c_str());
+                            KOLOSAL_LOG_ERROR("[Thread %zu] Failed to start download for model: %s", std::hash<std::thread::id>{}(std::this_thread::get_id()), modelId.c_str());
                             return;
                         }
                     }
 
-                    // Return 202 Accepted for async download
+                    // Return 202 Accepted for async download; it may be waiting for a free download slot
+                    auto queued_download = download_manager.getDownloadProgress(modelId);
                     json jResponse = {
                         {"model_id", modelId},
                         {"model_type", modelType},
-                        {"status", "downloading"},
+                        {"status", queued_download ? queued_download->status : std::string("queued")},
+                        {"priority", request.priority},
                         {"message", "Download started in background"},
                         {"download_url", modelPathStr},
                         {"local_path", downloadPath}
                     };
 
                     send_response(sock, 202, jResponse.dump());
-                    ServerLogger::logInfo("[Thread %u] Started async download for model %s from URL: %s", std::this_thread::get_id(), modelId.c_str(), modelPathStr.c_str());
+                    KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Started async download for model %s from URL: %s", std::hash<std::thread::id>{}(std::this_thread::get_id()), modelId.c_str(), modelPathStr.c_str());
                     return;
                 }
             }
@@ -521,7 +646,7 @@ namespace kolosal
 
                 json jError = {{"error", {{"message", errorMessage}, {"type", errorType}, {"param", "model_path"}, {"code", "model_path_not_found"}}}};
                 send_response(sock, errorCode, jError.dump());
-                ServerLogger::logError("[Thread %u] Model path '%s' does not exist", std::this_thread::get_id(), actualModelPath.c_str());
+                KOLOSAL_LOG_ERROR("[Thread %zu] Model path '%s' does not exist", std::hash<std::thread::id>{}(std::this_thread::get_id()), actualModelPath.c_str());
                 return;
             }
 
@@ -549,7 +674,7 @@ namespace kolosal
 
                     json jError = {{"error", {{"message", errorMessage}, {"type", errorType}, {"param", "model_path"}, {"code", "model_path_access_denied"}}}};
                     send_response(sock, errorCode, jError.dump());
-                    ServerLogger::logError("[Thread %u] Cannot access model directory '%s': %s", std::this_thread::get_id(), actualModelPath.c_str(), e.what());
+                    KOLOSAL_LOG_ERROR("[Thread %zu] Cannot access model directory '%s': %s", std::hash<std::thread::id>{}(std::this_thread::get_id()), actualModelPath.c_str(), e.what());
                     return;
                 }
 
@@ -561,7 +686,7 @@ namespace kolosal
 
                     json jError = {{"error", {{"message", errorMessage}, {"type", errorType}, {"param", "model_path"}, {"code", "model_file_not_found"}}}};
                     send_response(sock, errorCode, jError.dump());
-                    ServerLogger::logError("[Thread %u] No .gguf files found in directory '%s'", std::this_thread::get_id(), actualModelPath.c_str());
+                    KOLOSAL_LOG_ERROR("[Thread %zu] No .gguf files found in directory '%s'", std::hash<std::thread::id>{}(std::this_thread::get_id()), actualModelPath.c_str());
                     return;
                 }
             }
@@ -576,7 +701,7 @@ namespace kolosal
 
                     json jError = {{"error", {{"message", errorMessage}, {"type", errorType}, {"param", "model_path"}, {"code", "invalid_model_format"}}}};
                     send_response(sock, errorCode, jError.dump());
-                    ServerLogger::logError("[Thread %u] Model file '%s' is not a .gguf file", std::this_thread::get_id(), actualModelPath.c_str());
+                    KOLOSAL_LOG_ERROR("[Thread %zu] Model file '%s' is not a .gguf file", std::hash<std::thread::id>{}(std::this_thread::get_id()), actualModelPath.c_str());
                     return;
                 }
             }
@@ -588,27 +713,27 @@ namespace kolosal
 
                 json jError = {{"error", {{"message", errorMessage}, {"type", errorType}, {"param", "model_path"}, {"code", "invalid_model_path_type"}}}};
                 send_response(sock, errorCode, jError.dump());
-                ServerLogger::logError("[Thread %u] Model path '%s' is not a valid file or directory", std::this_thread::get_id(), actualModelPath.c_str());
+                KOLOSAL_LOG_ERROR("[Thread %zu] Model path '%s' is not a valid file or directory", std::hash<std::thread::id>{}(std::this_thread::get_id()), actualModelPath.c_str());
                 return;
             }
 
             // Log configuration warnings for potentially problematic settings
             if (loadParams.n_ctx > 32768)
             {
-                ServerLogger::logWarning("[Thread %u] Large context size (n_ctx=%d) may cause high memory usage for model '%s'",
-                                         std::this_thread::get_id(), loadParams.n_ctx, modelId.c_str());
+                KOLOSAL_LOG_WARNING("[Thread %zu] Large context size (n_ctx=%d) may cause high memory usage for model '%s'",
+                                         std::hash<std::thread::id>{}(std::this_thread::get_id()), loadParams.n_ctx, modelId.c_str());
             }
 
             if (loadParams.n_gpu_layers > 0 && mainGpuId == -1)
             {
-                ServerLogger::logInfo("[Thread %u] GPU layers enabled but main_gpu_id is auto-select (-1) for model '%s'",
-                                      std::this_thread::get_id(), modelId.c_str());
+                KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] GPU layers enabled but main_gpu_id is auto-select (-1) for model '%s'",
+                                      std::hash<std::thread::id>{}(std::this_thread::get_id()), modelId.c_str());
             }
 
             if (loadParams.n_batch > 4096)
             {
-                ServerLogger::logWarning("[Thread %u] Large batch size (n_batch=%d) may cause high memory usage for model '%s'",
-                                         std::this_thread::get_id(), loadParams.n_batch, modelId.c_str());
+                KOLOSAL_LOG_WARNING("[Thread %zu] Large batch size (n_batch=%d) may cause high memory usage for model '%s'",
+                                         std::hash<std::thread::id>{}(std::this_thread::get_id()), loadParams.n_batch, modelId.c_str());
             }
 
             // Get the NodeManager and attempt to add the engine
@@ -620,6 +745,10 @@ namespace kolosal
                 {
                     success = nodeManager.addEmbeddingEngine(modelId, actualModelPath.c_str(), loadParams, mainGpuId);
                 }
+                else if (modelType == "rerank")
+                {
+                    success = nodeManager.addRerankEngine(modelId, actualModelPath.c_str(), loadParams, mainGpuId);
+                }
                 else
                 {
                     success = nodeManager.addEngine(modelId, actualModelPath.c_str(), loadParams, mainGpuId, inferenceEngine);
@@ -632,11 +761,15 @@ namespace kolosal
                 {
                     success = nodeManager.registerEmbeddingEngine(modelId, actualModelPath.c_str(), loadParams, mainGpuId);
                 }
+                else if (modelType == "rerank")
+                {
+                    success = nodeManager.registerRerankEngine(modelId, actualModelPath.c_str(), loadParams, mainGpuId);
+                }
                 else
                 {
                     success = nodeManager.registerEngine(modelId, actualModelPath.c_str(), loadParams, mainGpuId);
                 }
-                ServerLogger::logInfo("Model '%s' registered with load_immediately=false (will load on first access)", modelId.c_str());
+                KOLOSAL_LOG_INFO("Model '%s' registered with load_immediately=false (will load on first access)", modelId.c_str());
             }
 
             if (success)
@@ -650,8 +783,8 @@ namespace kolosal
                 }
                 catch (const std::exception &ex)
                 {
-                    ServerLogger::logWarning("[Thread %u] Failed to verify engine status for model '%s': %s", 
-                                           std::this_thread::get_id(), modelId.c_str(), ex.what());
+                    KOLOSAL_LOG_WARNING("[Thread %zu] Failed to verify engine status for model '%s': %s", 
+                                           std::hash<std::thread::id>{}(std::this_thread::get_id()), modelId.c_str(), ex.what());
                     engineFunctional = false;
                 }
 
@@ -679,25 +812,25 @@ namespace kolosal
                     }
 
                     send_response(sock, 201, response.dump());
-                    ServerLogger::logInfo("[Thread %u] Successfully added model '%s'", std::this_thread::get_id(), modelId.c_str());
+                    KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Successfully added model '%s'", std::hash<std::thread::id>{}(std::this_thread::get_id()), modelId.c_str());
                 }
                 else
                 {
                     // Engine was added but is not functional, treat as failure
-                    ServerLogger::logError("[Thread %u] Engine for model '%s' was added but is not functional", 
-                                         std::this_thread::get_id(), modelId.c_str());
+                    KOLOSAL_LOG_ERROR("[Thread %zu] Engine for model '%s' was added but is not functional", 
+                                         std::hash<std::thread::id>{}(std::this_thread::get_id()), modelId.c_str());
                     
                     // Try to remove the non-functional engine
                     try
                     {
                         nodeManager.removeEngine(modelId);
-                        ServerLogger::logInfo("[Thread %u] Removed non-functional engine for model '%s'", 
-                                             std::this_thread::get_id(), modelId.c_str());
+                        KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Removed non-functional engine for model '%s'", 
+                                             std::hash<std::thread::id>{}(std::this_thread::get_id()), modelId.c_str());
                     }
                     catch (const std::exception &ex)
                     {
-                        ServerLogger::logWarning("[Thread %u] Failed to remove non-functional engine for model '%s': %s", 
-                                               std::this_thread::get_id(), modelId.c_str(), ex.what());
+                        KOLOSAL_LOG_WARNING("[Thread %zu] Failed to remove non-functional engine for model '%s': %s", 
+                                               std::hash<std::thread::id>{}(std::this_thread::get_id()), modelId.c_str(), ex.what());
                     }
                     
                     json jError = {{"error", {{"message", "Engine was created but failed functionality check"}, {"type", "model_loading_error"}, {"param", "model_path"}, {"code", "engine_not_functional"}}}};
@@ -732,13 +865,13 @@ namespace kolosal
 
                         json jError = {{"error", {{"message", errorMessage}, {"type", errorType}, {"param", "model_id"}, {"code", "model_already_loaded"}}}};
                         send_response(sock, errorCode, jError.dump());
-                        ServerLogger::logError("[Thread %u] Model ID '%s' is already loaded", std::this_thread::get_id(), modelId.c_str());
+                        KOLOSAL_LOG_ERROR("[Thread %zu] Model ID '%s' is already loaded", std::hash<std::thread::id>{}(std::this_thread::get_id()), modelId.c_str());
                     }
                     else
                     {
                         // Model exists in config but is not loaded (could be from cancelled download or failed load)
                         // Try to remove it first, then retry adding
-                        ServerLogger::logInfo("[Thread %u] Model '%s' exists but is not loaded, removing and retrying", std::this_thread::get_id(), modelId.c_str());
+                        KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Model '%s' exists but is not loaded, removing and retrying", std::hash<std::thread::id>{}(std::this_thread::get_id()), modelId.c_str());
                         
                         bool removed = nodeManager.removeEngine(modelId);
                         if (removed)
@@ -751,6 +884,10 @@ namespace kolosal
                                 {
                                     retrySuccess = nodeManager.addEmbeddingEngine(modelId, actualModelPath.c_str(), loadParams, mainGpuId);
                                 }
+                                else if (modelType == "rerank")
+                                {
+                                    retrySuccess = nodeManager.addRerankEngine(modelId, actualModelPath.c_str(), loadParams, mainGpuId);
+                                }
                                 else
                                 {
                                     retrySuccess = nodeManager.addEngine(modelId, actualModelPath.c_str(), loadParams, mainGpuId, inferenceEngine);
@@ -762,6 +899,10 @@ namespace kolosal
                                 {
                                     retrySuccess = nodeManager.registerEmbeddingEngine(modelId, actualModelPath.c_str(), loadParams, mainGpuId);
                                 }
+                                else if (modelType == "rerank")
+                                {
+                                    retrySuccess = nodeManager.registerRerankEngine(modelId, actualModelPath.c_str(), loadParams, mainGpuId);
+                                }
                                 else
                                 {
                                     retrySuccess = nodeManager.registerEngine(modelId, actualModelPath.c_str(), loadParams, mainGpuId);
@@ -779,8 +920,8 @@ namespace kolosal
                                 }
                                 catch (const std::exception &ex)
                                 {
-                                    ServerLogger::logWarning("[Thread %u] Failed to verify engine status for model '%s' (retry): %s", 
-                                                           std::this_thread::get_id(), modelId.c_str(), ex.what());
+                                    KOLOSAL_LOG_WARNING("[Thread %zu] Failed to verify engine status for model '%s' (retry): %s", 
+                                                           std::hash<std::thread::id>{}(std::this_thread::get_id()), modelId.c_str(), ex.what());
                                     engineFunctional = false;
                                 }
 
@@ -808,25 +949,25 @@ namespace kolosal
                                     }
 
                                     send_response(sock, 201, response.dump());
-                                    ServerLogger::logInfo("[Thread %u] Successfully re-added model '%s' after removing failed configuration", std::this_thread::get_id(), modelId.c_str());
+                                    KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Successfully re-added model '%s' after removing failed configuration", std::hash<std::thread::id>{}(std::this_thread::get_id()), modelId.c_str());
                                 }
                                 else
                                 {
                                     // Engine was added but is not functional
-                                    ServerLogger::logError("[Thread %u] Retry engine for model '%s' was added but is not functional", 
-                                                         std::this_thread::get_id(), modelId.c_str());
+                                    KOLOSAL_LOG_ERROR("[Thread %zu] Retry engine for model '%s' was added but is not functional", 
+                                                         std::hash<std::thread::id>{}(std::this_thread::get_id()), modelId.c_str());
                                     
                                     // Try to remove the non-functional engine
                                     try
                                     {
                                         nodeManager.removeEngine(modelId);
-                                        ServerLogger::logInfo("[Thread %u] Removed non-functional retry engine for model '%s'", 
-                                                             std::this_thread::get_id(), modelId.c_str());
+                                        KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Removed non-functional retry engine for model '%s'", 
+                                                             std::hash<std::thread::id>{}(std::this_thread::get_id()), modelId.c_str());
                                     }
                                     catch (const std::exception &ex)
                                     {
-                                        ServerLogger::logWarning("[Thread %u] Failed to remove non-functional retry engine for model '%s': %s", 
-                                                               std::this_thread::get_id(), modelId.c_str(), ex.what());
+                                        KOLOSAL_LOG_WARNING("[Thread %zu] Failed to remove non-functional retry engine for model '%s': %s", 
+                                                               std::hash<std::thread::id>{}(std::this_thread::get_id()), modelId.c_str(), ex.what());
                                     }
                                     
                                     json jError = {{"error", {{"message", "Retry engine was created but failed functionality check"}, {"type", "model_loading_error"}, {"param", "model_path"}, {"code", "retry_engine_not_functional"}}}};
@@ -843,7 +984,7 @@ namespace kolosal
 
                         json jError = {{"error", {{"message", errorMessage}, {"type", errorType}, {"param", "model_id"}, {"code", "model_retry_failed"}}}};
                         send_response(sock, errorCode, jError.dump());
-                        ServerLogger::logError("[Thread %u] Failed to retry adding model '%s' after removing failed configuration", std::this_thread::get_id(), modelId.c_str());
+                        KOLOSAL_LOG_ERROR("[Thread %zu] Failed to retry adding model '%s' after removing failed configuration", std::hash<std::thread::id>{}(std::this_thread::get_id()), modelId.c_str());
                     }
                 }
                 else
@@ -884,25 +1025,25 @@ namespace kolosal
 
                     json jError = {{"error", {{"message", errorMessage}, {"type", errorType}, {"param", "model_path"}, {"code", "model_loading_failed"}, {"details", errorDetails}}}};
                     send_response(sock, errorCode, jError.dump());
-                    ServerLogger::logError("[Thread %u] Failed to load model for model '%s' from path '%s'", std::this_thread::get_id(), modelId.c_str(), actualModelPath.c_str());
+                    KOLOSAL_LOG_ERROR("[Thread %zu] Failed to load model for model '%s' from path '%s'", std::hash<std::thread::id>{}(std::this_thread::get_id()), modelId.c_str(), actualModelPath.c_str());
                 }
             }
         }
         catch (const json::exception &ex)
         {
-            ServerLogger::logError("[Thread %u] JSON parsing error: %s", std::this_thread::get_id(), ex.what());
+            KOLOSAL_LOG_ERROR("[Thread %zu] JSON parsing error: %s", std::hash<std::thread::id>{}(std::this_thread::get_id()), ex.what());
             json jError = {{"error", {{"message", std::string("Invalid JSON: ") + ex.what()}, {"type", "invalid_request_error"}, {"param", nullptr}, {"code", nullptr}}}};
             send_response(sock, 400, jError.dump());
         }
         catch (const std::runtime_error &ex)
         {
-            ServerLogger::logError("[Thread %u] Request validation error: %s", std::this_thread::get_id(), ex.what());
+            KOLOSAL_LOG_ERROR("[Thread %zu] Request validation error: %s", std::hash<std::thread::id>{}(std::this_thread::get_id()), ex.what());
             json jError = {{"error", {{"message", ex.what()}, {"type", "invalid_request_error"}, {"param", nullptr}, {"code", nullptr}}}};
             send_response(sock, 400, jError.dump());
         }
         catch (const std::exception &ex)
         {
-            ServerLogger::logError("[Thread %u] Error handling add model request: %s", std::this_thread::get_id(), ex.what());
+            KOLOSAL_LOG_ERROR("[Thread %zu] Error handling add model request: %s", std::hash<std::thread::id>{}(std::this_thread::get_id()), ex.what());
             json jError = {{"error", {{"message", std::string("Server error: ") + ex.what()}, {"type", "server_error"}, {"param", nullptr}, {"code", nullptr}}}};
             send_response(sock, 500, jError.dump());
         }
@@ -918,7 +1059,7 @@ namespace kolosal
     {
         try
         {
-            ServerLogger::logInfo("[Thread %u] Received remove model request for model: %s", std::this_thread::get_id(), modelId.c_str());
+            KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Received remove model request for model: %s", std::hash<std::thread::id>{}(std::this_thread::get_id()), modelId.c_str());
 
             // Get the NodeManager and remove the engine
             auto &nodeManager = ServerAPI::instance().getNodeManager();
@@ -933,7 +1074,7 @@ namespace kolosal
                 };
 
                 send_response(sock, 200, response.dump());
-                ServerLogger::logInfo("[Thread %u] Successfully removed model '%s'", std::this_thread::get_id(), modelId.c_str());
+                KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Successfully removed model '%s'", std::hash<std::thread::id>{}(std::this_thread::get_id()), modelId.c_str());
             }
             else
             {
@@ -947,12 +1088,98 @@ namespace kolosal
                 };
 
                 send_response(sock, 404, errorResponse.dump());
-                ServerLogger::logWarning("[Thread %u] Failed to remove model '%s' - not found", std::this_thread::get_id(), modelId.c_str());
+                KOLOSAL_LOG_WARNING("[Thread %zu] Failed to remove model '%s' - not found", std::hash<std::thread::id>{}(std::this_thread::get_id()), modelId.c_str());
             }
         }
         catch (const std::exception &ex)
         {
-            ServerLogger::logError("[Thread %u] Error handling remove model request: %s", std::this_thread::get_id(), ex.what());
+            KOLOSAL_LOG_ERROR("[Thread %zu] Error handling remove model request: %s", std::hash<std::thread::id>{}(std::this_thread::get_id()), ex.what());
+            json jError = {{"error", {{"message", std::string("Server error: ") + ex.what()}, {"type", "server_error"}, {"param", nullptr}, {"code", nullptr}}}};
+            send_response(sock, 500, jError.dump());
+        }
+    }
+
+    void ModelsRoute::handleSwapModel(SocketType sock, const std::string &body, const std::string &modelId)
+    {
+        try
+        {
+            KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Received swap model request for model: %s", std::hash<std::thread::id>{}(std::this_thread::get_id()), modelId.c_str());
+
+            if (body.empty())
+            {
+                json jError = {{"error", {{"message", "Request body is required"}, {"type", "invalid_request_error"}, {"param", "body"}, {"code", "missing_body"}}}};
+                send_response(sock, 400, jError.dump());
+                return;
+            }
+
+            // Same body as POST /models; the ID comes from the path
+            auto j = json::parse(body);
+            if (!j.is_object())
+            {
+                json jError = {{"error", {{"message", "Request body must be a JSON object"}, {"type", "invalid_request_error"}, {"param", "body"}, {"code", nullptr}}}};
+                send_response(sock, 400, jError.dump());
+                return;
+            }
+            if (j.contains("model_id") && j["model_id"].is_string() && j["model_id"].get<std::string>() != modelId)
+            {
+                json jError = {{"error", {{"message", "model_id in the body does not match the path"}, {"type", "invalid_request_error"}, {"param", "model_id"}, {"code", nullptr}}}};
+                send_response(sock, 400, jError.dump());
+                return;
+            }
+            j["model_id"] = modelId;
+
+            AddModelRequest request;
+            request.from_json(j);
+            if (!request.validate())
+            {
+                json jError = {{"error", {{"message", "Invalid request parameters"}, {"type", "invalid_request_error"}, {"param", nullptr}, {"code", nullptr}}}};
+                send_response(sock, 400, jError.dump());
+                return;
+            }
+
+            auto &nodeManager = ServerAPI::instance().getNodeManager();
+            auto status = nodeManager.getEngineStatus(modelId);
+            if (!status.first)
+            {
+                json jError = {{"error", {{"message", "Model not found"}, {"type", "not_found_error"}, {"param", "model_id"}, {"code", "model_not_found"}}}};
+                send_response(sock, 404, jError.dump());
+                return;
+            }
+
+            // Blocks until the old model has drained so the caller knows the rollout finished
+            const auto start = std::chrono::steady_clock::now();
+            bool success = nodeManager.swapEngine(modelId, request.model_path.c_str(), toLoadingParameters(request.loading_parameters),
+                                                  request.main_gpu_id, request.inference_engine);
+            const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+
+            if (success)
+            {
+                json response = {
+                    {"model_id", modelId},
+                    {"model_path", request.model_path},
+                    {"status", "swapped"},
+                    {"swap_time_ms", elapsed.count()},
+                    {"message", "Model replaced; the previous model was drained and unloaded"}
+                };
+                send_response(sock, 200, response.dump());
+                KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Swapped model '%s' in %lld ms", std::hash<std::thread::id>{}(std::this_thread::get_id()), modelId.c_str(),
+                                      static_cast<long long>(elapsed.count()));
+            }
+            else
+            {
+                json jError = {{"error", {{"message", "Replacement model could not be loaded; the current model keeps serving"}, {"type", "server_error"}, {"param", "model_path"}, {"code", "model_swap_failed"}}}};
+                send_response(sock, 500, jError.dump());
+                KOLOSAL_LOG_WARNING("[Thread %zu] Failed to swap model '%s'", std::hash<std::thread::id>{}(std::this_thread::get_id()), modelId.c_str());
+            }
+        }
+        catch (const json::exception &ex)
+        {
+            json jError = {{"error", {{"message", std::string("Invalid JSON: ") + ex.what()}, {"type", "invalid_request_error"}, {"param", nullptr}, {"code", nullptr}}}};
+            send_response(sock, 400, jError.dump());
+        }
+        catch (const std::exception &ex)
+        {
+            KOLOSAL_LOG_ERROR("[Thread %zu] Error handling swap model request: %s", std::hash<std::thread::id>{}(std::this_thread::get_id()), ex.what());
             json jError = {{"error", {{"message", std::string("Server error: ") + ex.what()}, {"type", "server_error"}, {"param", nullptr}, {"code", nullptr}}}};
             send_response(sock, 500, jError.dump());
         }
@@ -962,7 +1189,7 @@ namespace kolosal
     {
         try
         {
-            ServerLogger::logInfo("[Thread %u] Received model status request for model: %s", std::this_thread::get_id(), modelId.c_str());
+            KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Received model status request for model: %s", std::hash<std::thread::id>{}(std::this_thread::get_id()), modelId.c_str());
 
             // Get the NodeManager and check engine status
             auto &nodeManager = ServerAPI::instance().getNodeManager();
@@ -976,11 +1203,17 @@ namespace kolosal
                 auto [exists, isLoaded] = nodeManager.getEngineStatus(modelId);
 
                 // Try to get additional model information
+                const float loadProgress = nodeManager.getEngineLoadProgress(modelId);
+                const bool reloading = !isLoaded && loadProgress > 0.0f;
+                const bool hibernated = !isLoaded && !reloading && nodeManager.isEngineHibernated(modelId);
                 json response = {
                     {"model_id", modelId},
-                    {"status", isLoaded ? "loaded" : "unloaded"},
+                    {"status", isLoaded ? "loaded" : reloading ? "loading" : hibernated ? "hibernated" : "unloaded"},
                     {"available", true},
-                    {"message", isLoaded ? "Model is loaded and ready" : "Model exists but is currently unloaded"}
+                    {"load_progress", (std::max)(0.0f, loadProgress)},
+                    {"message", isLoaded ? "Model is loaded and ready" : reloading ? "Model is being loaded"
+                                : hibernated ? "Model is unloaded with its weights kept in memory for a fast reload"
+                                             : "Model exists but is currently unloaded"}
                 };
 
                 // Get additional model information if available
@@ -1020,14 +1253,14 @@ namespace kolosal
                 }
                 catch (const std::exception &ex)
                 {
-                    ServerLogger::logWarning("[Thread %u] Could not get detailed engine info for model '%s': %s", 
-                                           std::this_thread::get_id(), modelId.c_str(), ex.what());
+                    KOLOSAL_LOG_WARNING("[Thread %zu] Could not get detailed engine info for model '%s': %s", 
+                                           std::hash<std::thread::id>{}(std::this_thread::get_id()), modelId.c_str(), ex.what());
                     response["engine_loaded"] = false;
                     response["inference_ready"] = false;
                 }
 
                 send_response(sock, 200, response.dump());
-                ServerLogger::logInfo("[Thread %u] Successfully retrieved status for model '%s'", std::this_thread::get_id(), modelId.c_str());
+                KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Successfully retrieved status for model '%s'", std::hash<std::thread::id>{}(std::this_thread::get_id()), modelId.c_str());
             }
             else
             {
@@ -1041,12 +1274,77 @@ namespace kolosal
                 };
 
                 send_response(sock, 404, errorResponse.dump());
-                ServerLogger::logWarning("[Thread %u] Model '%s' not found", std::this_thread::get_id(), modelId.c_str());
+                KOLOSAL_LOG_WARNING("[Thread %zu] Model '%s' not found", std::hash<std::thread::id>{}(std::this_thread::get_id()), modelId.c_str());
+            }
+        }
+        catch (const std::exception &ex)
+        {
+            KOLOSAL_LOG_ERROR("[Thread %zu] Error handling model status request: %s", std::hash<std::thread::id>{}(std::this_thread::get_id()), ex.what());
+            json jError = {{"error", {{"message", std::string("Server error: ") + ex.what()}, {"type", "server_error"}, {"param", nullptr}, {"code", nullptr}}}};
+            send_response(sock, 500, jError.dump());
+        }
+    }
+
+    void ModelsRoute::handleModelProfile(SocketType sock, const std::string &modelId)
+    {
+        try
+        {
+            auto &nodeManager = ServerAPI::instance().getNodeManager();
+            auto engineIds = nodeManager.listEngineIds();
+            if (std::find(engineIds.begin(), engineIds.end(), modelId) == engineIds.end())
+            {
+                json errorResponse = {{"error", {{"message", "Model not found"}, {"type", "not_found_error"}, {"param", "model_id"}, {"code", "model_not_found"}}}};
+                send_response(sock, 404, errorResponse.dump());
+                return;
             }
+
+            json replicas = json::array();
+            const auto profiles = nodeManager.getStepProfiles(modelId);
+            for (size_t i = 0; i < profiles.size(); ++i)
+            {
+                json steps = json::array();
+                double decodeMs = 0.0, scheduleMs = 0.0, maxDecodeMs = 0.0;
+                int64_t batchTokens = 0;
+                for (const auto &step : profiles[i])
+                {
+                    steps.push_back({
+                        {"start_us", step.start_us},
+                        {"batch_tokens", step.batch_tokens},
+                        {"prompt_tokens", step.prompt_tokens},
+                        {"generating_jobs", step.generating_jobs},
+                        {"prefill_jobs", step.prefill_jobs},
+                        {"schedule_ms", step.schedule_ms},
+                        {"decode_ms", step.decode_ms}
+                    });
+                    decodeMs += step.decode_ms;
+                    scheduleMs += step.schedule_ms;
+                    maxDecodeMs = (std::max)(maxDecodeMs, static_cast<double>(step.decode_ms));
+                    batchTokens += step.batch_tokens;
+                }
+                const double n = (std::max)(static_cast<double>(profiles[i].size()), 1.0);
+                replicas.push_back({
+                    {"replica", i},
+                    {"summary", {
+                        {"steps", profiles[i].size()},
+                        {"avg_batch_tokens", batchTokens / n},
+                        {"avg_schedule_ms", scheduleMs / n},
+                        {"avg_decode_ms", decodeMs / n},
+                        {"max_decode_ms", maxDecodeMs}
+                    }},
+                    {"steps", std::move(steps)}
+                });
+            }
+
+            json response = {
+                {"model_id", modelId},
+                {"loaded", !profiles.empty()},
+                {"replicas", std::move(replicas)}
+            };
+            send_response(sock, 200, response.dump());
         }
         catch (const std::exception &ex)
         {
-            ServerLogger::logError("[Thread %u] Error handling model status request: %s", std::this_thread::get_id(), ex.what());
+            KOLOSAL_LOG_ERROR("[Thread %zu] Error handling model profile request: %s", std::hash<std::thread::id>{}(std::this_thread::get_id()), ex.what());
             json jError = {{"error", {{"message", std::string("Server error: ") + ex.what()}, {"type", "server_error"}, {"param", nullptr}, {"code", nullptr}}}};
             send_response(sock, 500, jError.dump());
         }
@@ -1057,7 +1355,7 @@ namespace kolosal
         std::smatch matches;
         
         // Try model status pattern first
-        if (std::regex_match(path, matches, modelStatusPattern_))
+        if (std::regex_match(path, matches, modelStatusPattern_) || std::regex_match(path, matches, modelProfilePattern_))
         {
             return matches[2].str(); // Group 2 contains the model ID
         }
@@ -0,0 +1,217 @@
+#include "kolosal/routes/profile_route.hpp"
+#include "kolosal/routes/route_utils.hpp"
+#include "kolosal/cpu_profiler.hpp"
+#include "kolosal/utils.hpp"
+#include "kolosal/server_api.hpp"
+#include "kolosal/node_manager.h"
+#include "kolosal/logger.hpp"
+#include <json.hpp>
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+using json = nlohmann::json;
+
+namespace kolosal
+{
+
+    namespace
+    {
+        constexpr int kMaxSeconds = 60;
+        constexpr size_t kDefaultTimelineSteps = 100000;
+
+        json parseOptions(const std::string &body)
+        {
+            if (body.empty())
+                return json::object();
+            json options = json::parse(body);
+            if (!options.is_object())
+                throw std::invalid_argument("Request body must be a JSON object");
+            return options;
+        }
+
+        std::chrono::milliseconds captureDuration(const json &options, double fallback)
+        {
+            const double seconds = options.value("seconds", fallback);
+            if (!(seconds > 0.0) || seconds > kMaxSeconds)
+                throw std::invalid_argument("seconds must be greater than 0 and at most " + std::to_string(kMaxSeconds));
+            return std::chrono::milliseconds(static_cast<int64_t>(seconds * 1000.0));
+        }
+
+        json stepToJson(const DecodeStepSample &step)
+        {
+            json jobs = json::array();
+            for (const auto &job : step.jobs)
+                jobs.push_back({{"job_id", job.job_id}, {"tokens", job.tokens}, {"prefill", job.prefill}});
+            return {
+                {"start_us", step.start_us},
+                {"batch_tokens", step.batch_tokens},
+                {"prompt_tokens", step.prompt_tokens},
+                {"generating_jobs", step.generating_jobs},
+                {"prefill_jobs", step.prefill_jobs},
+                {"schedule_ms", step.schedule_ms},
+                {"decode_ms", step.decode_ms},
+                {"jobs", std::move(jobs)}};
+        }
+
+        // Chrome trace events (chrome://tracing, Perfetto): one track per replica, each step
+        // split into its scheduling and its llama_decode() call
+        json stepsToTraceEvents(const std::vector<std::vector<DecodeStepSample>> &replicas)
+        {
+            json events = json::array();
+            for (size_t replica = 0; replica < replicas.size(); ++replica)
+            {
+                events.push_back({{"name", "thread_name"}, {"ph", "M"}, {"pid", 1}, {"tid", replica},
+                                  {"args", {{"name", "replica " + std::to_string(replica)}}}});
+                for (const auto &step : replicas[replica])
+                {
+                    const double scheduleUs = step.schedule_ms * 1000.0;
+                    events.push_back({{"name", "schedule"}, {"ph", "X"}, {"pid", 1}, {"tid", replica},
+                                      {"ts", step.start_us}, {"dur", scheduleUs}});
+                    json decode = stepToJson(step);
+                    decode.erase("start_us");
+                    events.push_back({{"name", step.prefill_jobs > 0 ? "decode+prefill" : "decode"}, {"ph", "X"},
+                                      {"pid", 1}, {"tid", replica}, {"ts", step.start_us + scheduleUs},
+                                      {"dur", step.decode_ms * 1000.0}, {"args", std::move(decode)}});
+                }
+            }
+            return {{"traceEvents", std::move(events)}, {"displayTimeUnit", "ms"}};
+        }
+    } // namespace
+
+    bool ProfileRoute::match(const std::string &method, const std::string &path)
+    {
+        return method == "POST" && (path == "/debug/profile" || path == "/debug/profile/timeline");
+    }
+
+    std::vector<RoutePattern> ProfileRoute::patterns() const
+    {
+        return {{"POST", "/debug/profile"}, {"POST", "/debug/profile/timeline"}};
+    }
+
+    void ProfileRoute::handle(SocketType sock, const RequestContext &request)
+    {
+        try
+        {
+            if (request.path == "/debug/profile/timeline")
+                handleTimeline(sock, request);
+            else
+                handleCpuProfile(sock, request);
+        }
+        catch (const json::exception &ex)
+        {
+            send_error_response(sock, 400, std::string("Invalid JSON: ") + ex.what(), "invalid_request_error");
+        }
+        catch (const std::invalid_argument &ex)
+        {
+            send_error_response(sock, 400, ex.what(), "invalid_request_error");
+        }
+        catch (const std::exception &ex)
+        {
+            KOLOSAL_LOG_ERROR("[Thread %zu] Profiling failed: %s", std::hash<std::thread::id>{}(std::this_thread::get_id()), ex.what());
+            send_error_response(sock, 500, std::string("Server error: ") + ex.what(), "server_error");
+        }
+    }
+
+    void ProfileRoute::handleCpuProfile(SocketType sock, const RequestContext &request)
+    {
+        const json options = parseOptions(request.body);
+        const auto duration = captureDuration(options, 10.0);
+        const int frequency = options.value("frequency", 99);
+        if (frequency < 1 || frequency > 1000)
+            throw std::invalid_argument("frequency must be between 1 and 1000 Hz");
+        const std::string format = options.value("format", std::string("collapsed"));
+        if (format != "collapsed" && format != "pprof")
+            throw std::invalid_argument("format must be \"collapsed\" or \"pprof\"");
+        if (!CpuProfiler::supported())
+        {
+            send_error_response(sock, 501, "CPU profiling is only available on Linux with glibc", "not_supported_error");
+            return;
+        }
+
+        KOLOSAL_LOG_INFO("[Thread %zu] Profiling CPU for %lld ms at %d Hz", std::hash<std::thread::id>{}(std::this_thread::get_id()),
+                         static_cast<long long>(duration.count()), frequency);
+        auto profile = CpuProfiler::instance().record(duration, frequency);
+        if (!profile)
+        {
+            send_error_response(sock, 409, "A CPU profile is already being recorded", "conflict_error");
+            return;
+        }
+
+        if (format == "pprof")
+        {
+            send_response(sock, 200, profile->pprof(),
+                          {{"Content-Type", "application/octet-stream"},
+                           {"Content-Disposition", "attachment; filename=\"cpu.prof\""}});
+        }
+        else
+        {
+            send_response(sock, 200, profile->collapsed(), {{"Content-Type", "text/plain; charset=utf-8"}});
+        }
+    }
+
+    void ProfileRoute::handleTimeline(SocketType sock, const RequestContext &request)
+    {
+        const json options = parseOptions(request.body);
+        const std::string modelId = options.value("model", std::string());
+        if (modelId.empty())
+            throw std::invalid_argument("model is required");
+        const auto duration = captureDuration(options, 5.0);
+        const size_t maxSteps = options.value("max_steps", kDefaultTimelineSteps);
+        if (maxSteps == 0)
+            throw std::invalid_argument("max_steps must be positive");
+        const std::string format = options.value("format", std::string("json"));
+        if (format != "json" && format != "chrome")
+            throw std::invalid_argument("format must be \"json\" or \"chrome\"");
+
+        // Without a lazy load: a timeline of an engine that is not running says nothing
+        const auto engines = ServerAPI::instance().getNodeManager().getLoadedReplicas(modelId);
+        if (engines.empty())
+        {
+            send_error_response(sock, 404, "Model '" + modelId + "' is not loaded", "not_found_error");
+            return;
+        }
+
+        // A second capture on the same engines would end the first one's early
+        static std::mutex captureMutex;
+        std::unique_lock<std::mutex> lock(captureMutex, std::try_to_lock);
+        if (!lock.owns_lock())
+        {
+            send_error_response(sock, 409, "A decode timeline is already being recorded", "conflict_error");
+            return;
+        }
+
+        KOLOSAL_LOG_INFO("[Thread %zu] Recording the decode timeline of '%s' for %lld ms", std::hash<std::thread::id>{}(std::this_thread::get_id()),
+                         modelId.c_str(), static_cast<long long>(duration.count()));
+        for (const auto &engine : engines)
+            engine->beginStepCapture(maxSteps);
+        const auto deadline = std::chrono::steady_clock::now() + duration;
+        while (std::chrono::steady_clock::now() < deadline && !client_disconnected(sock))
+            std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(
+                std::chrono::milliseconds(100), deadline - std::chrono::steady_clock::now()));
+        std::vector<std::vector<DecodeStepSample>> replicas;
+        for (const auto &engine : engines)
+            replicas.push_back(engine->endStepCapture());
+
+        if (format == "chrome")
+        {
+            send_response(sock, 200, stepsToTraceEvents(replicas).dump());
+            return;
+        }
+        json jReplicas = json::array();
+        for (size_t i = 0; i < replicas.size(); ++i)
+        {
+            json steps = json::array();
+            for (const auto &step : replicas[i])
+                steps.push_back(stepToJson(step));
+            jReplicas.push_back({{"replica", i}, {"steps", std::move(steps)}});
+        }
+        json response = {
+            {"model_id", modelId},
+            {"duration_ms", duration.count()},
+            {"replicas", std::move(jReplicas)}};
+        send_response(sock, 200, response.dump());
+    }
+
+} // namespace kolosal
@@ -1,10 +1,12 @@
 #include "kolosal/routes/retrieval/chunking_route.hpp"
+#include "kolosal/routes/retrieval/record_stream.hpp"
 #include "kolosal/models/chunking_request_model.hpp"
 #include "kolosal/models/chunking_response_model.hpp"
 #include "kolosal/utils.hpp"
 #include "kolosal/server_api.hpp"
 #include "kolosal/logger.hpp"
 #include "kolosal/node_manager.h"
+#include "kolosal/task_executor.hpp"
 #include <json.hpp>
 #include <iostream>
 #include <stdexcept>
@@ -21,30 +23,33 @@ ChunkingRoute::ChunkingRoute()
     : chunking_service_(std::make_unique<retrieval::ChunkingService>())
     , request_counter_(0)
 {
-    ServerLogger::logInfo("ChunkingRoute initialized");
+    KOLOSAL_LOG_INFO("ChunkingRoute initialized");
 }
 
 ChunkingRoute::~ChunkingRoute() = default;
 
 bool ChunkingRoute::match(const std::string& method, const std::string& path)
 {
-    if ((method == "POST" || method == "OPTIONS") && path == "/chunking")
-    {
-        current_method_ = method;
-        return true;
-    }
-    return false;
+    return (method == "POST" || method == "OPTIONS") && path == "/chunking";
 }
 
-void ChunkingRoute::handle(SocketType sock, const std::string& body)
+std::vector<RoutePattern> ChunkingRoute::patterns() const
+{
+    return {
+        {"POST", "/chunking"},
+        {"OPTIONS", "/chunking"}
+    };
+}
+
+void ChunkingRoute::handle(SocketType sock, const RequestContext& context)
 {
     try
     {
-        ServerLogger::logInfo("[Thread %u] Received %s request for /chunking", 
-                              std::this_thread::get_id(), current_method_.c_str());
+        KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Received %s request for /chunking", 
+                              std::hash<std::thread::id>{}(std::this_thread::get_id()), context.method.c_str());
 
         // Handle OPTIONS request for CORS preflight
-        if (current_method_ == "OPTIONS")
+        if (context.method == "OPTIONS")
         {
             handleOptions(sock);
             return;
@@ -53,10 +58,10 @@ void ChunkingRoute::handle(SocketType sock, const std::string& body)
         std::string requestId;
         auto start_time = std::chrono::high_resolution_clock::now();
 
-        ServerLogger::logInfo("[Thread %u] Processing chunking request", std::this_thread::get_id());
+        KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Processing chunking request", std::hash<std::thread::id>{}(std::this_thread::get_id()));
 
         // Check for empty body
-        if (body.empty())
+        if (context.body.empty())
         {
             sendErrorResponse(sock, 400, "Request body is empty");
             return;
@@ -66,7 +71,7 @@ void ChunkingRoute::handle(SocketType sock, const std::string& body)
         json j;
         try
         {
-            j = json::parse(body);
+            j = json::parse(context.body);
         }
         catch (const json::parse_error& ex)
         {
@@ -127,43 +132,22 @@ void ChunkingRoute::handle(SocketType sock, const std::string& body)
         // Generate unique request ID
         requestId = "chunk-" + std::to_string(++request_counter_) + "-" + std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count());
 
-        ServerLogger::logInfo("[Thread %u] Processing chunking request '%s' for model '%s' using method '%s'",
-                              std::this_thread::get_id(), requestId.c_str(), request.model_name.c_str(), request.method.c_str());
-
-        // Process the request based on the method
-        std::future<std::vector<std::string>> chunks_future;
+        KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Processing chunking request '%s' for model '%s' using method '%s'",
+                              std::hash<std::thread::id>{}(std::this_thread::get_id()), requestId.c_str(), request.model_name.c_str(), request.method.c_str());
 
-    if (request.method == "regular")
+        // Several texts, or a streamed answer: texts are chunked concurrently and each is
+        // answered (or streamed as records) as soon as it is done
+        const bool stream = RecordStream::requested(context, j);
+        if (!request.texts.empty() || stream)
         {
-            chunks_future = processRegularChunking(
-                request.text,
-                request.model_name,
-                request.chunk_size,
-                request.overlap
-            );
-        }
-        else if (request.method == "semantic")
-        {
-            chunks_future = processSemanticChunking(
-                request.text,
-                request.model_name,
-                request.chunk_size,
-                request.overlap,
-                request.max_chunk_size,
-                request.similarity_threshold
-            );
-        }
-        else
-        {
-            sendErrorResponse(sock, 400, "Invalid method: must be 'regular' or 'semantic'", "invalid_parameter", "method");
+            handleBatch(sock, context, request, requestId, stream);
             return;
         }
 
-        // Wait for processing to complete
-        std::vector<std::string> chunks;
+        ChunkingResponse response;
         try
         {
-            chunks = chunks_future.get();
+            response = chunkText(request, request.text);
         }
         catch (const std::exception& ex)
         {
@@ -171,30 +155,6 @@ void ChunkingRoute::handle(SocketType sock, const std::string& body)
             return;
         }
 
-        // Calculate processing time
-        auto end_time = std::chrono::high_resolution_clock::now();
-        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
-        float processing_time_ms = static_cast<float>(duration.count());
-
-        // Build response
-        ChunkingResponse response;
-        response.model_name = request.model_name;
-        response.method = request.method;
-
-        int original_tokens = estimateTokenCount(request.text);
-        int total_chunk_tokens = 0;
-
-        for (size_t i = 0; i < chunks.size(); ++i)
-        {
-            int chunk_tokens = estimateTokenCount(chunks[i]);
-            total_chunk_tokens += chunk_tokens;
-            
-            ChunkData chunk_data(chunks[i], static_cast<int>(i), chunk_tokens);
-            response.addChunk(chunk_data);
-        }
-
-        response.setUsage(original_tokens, total_chunk_tokens, processing_time_ms);
-
         // Send successful response
         std::map<std::string, std::string> headers = {
             {"Content-Type", "application/json"},
@@ -204,21 +164,204 @@ void ChunkingRoute::handle(SocketType sock, const std::string& body)
         };
         send_response(sock, 200, response.to_json().dump(), headers);
 
-        ServerLogger::logInfo("[Thread %u] Successfully processed chunking request '%s': %zu chunks generated in %.2fms",
-                              std::this_thread::get_id(), requestId.c_str(), chunks.size(), processing_time_ms);
+        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - start_time);
+        KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Successfully processed chunking request '%s': %zu chunks generated in %.2fms",
+                              std::hash<std::thread::id>{}(std::this_thread::get_id()), requestId.c_str(), response.chunks.size(), static_cast<float>(duration.count()));
     }
     catch (const json::exception& ex)
     {
-        ServerLogger::logError("[Thread %u] JSON parsing error: %s", std::this_thread::get_id(), ex.what());
+        KOLOSAL_LOG_ERROR("[Thread %zu] JSON parsing error: %s", std::hash<std::thread::id>{}(std::this_thread::get_id()), ex.what());
         sendErrorResponse(sock, 400, "Invalid JSON: " + std::string(ex.what()));
     }
     catch (const std::exception& ex)
     {
-        ServerLogger::logError("[Thread %u] Error handling chunking request: %s", std::this_thread::get_id(), ex.what());
+        KOLOSAL_LOG_ERROR("[Thread %zu] Error handling chunking request: %s", std::hash<std::thread::id>{}(std::this_thread::get_id()), ex.what());
         sendErrorResponse(sock, 500, "Internal server error: " + std::string(ex.what()), "server_error");
     }
 }
 
+ChunkingResponse ChunkingRoute::chunkText(const ChunkingRequest& request, const std::string& text)
+{
+    auto start_time = std::chrono::high_resolution_clock::now();
+
+    // On an executor worker these run inline rather than queueing behind the caller
+    std::future<std::vector<std::string>> chunks_future;
+    if (request.method == "semantic")
+    {
+        chunks_future = processSemanticChunking(
+            text,
+            request.model_name,
+            request.chunk_size,
+            request.overlap,
+            request.max_chunk_size,
+            request.similarity_threshold
+        );
+    }
+    else
+    {
+        chunks_future = processRegularChunking(
+            text,
+            request.model_name,
+            request.chunk_size,
+            request.overlap
+        );
+    }
+    std::vector<std::string> chunks = chunks_future.get();
+
+    ChunkingResponse response;
+    response.model_name = request.model_name;
+    response.method = request.method;
+
+    // One call counts the source text and every chunk with the model's tokenizer
+    std::vector<std::string> counted;
+    counted.reserve(chunks.size() + 1);
+    counted.push_back(text);
+    counted.insert(counted.end(), std::make_move_iterator(chunks.begin()), std::make_move_iterator(chunks.end()));
+    const auto token_counts = chunking_service_->countTokens(counted, request.model_name);
+
+    int original_tokens = token_counts[0];
+    int total_chunk_tokens = 0;
+
+    for (size_t i = 1; i < counted.size(); ++i)
+    {
+        int chunk_tokens = token_counts[i];
+        total_chunk_tokens += chunk_tokens;
+        response.addChunk(ChunkData(std::move(counted[i]), static_cast<int>(i - 1), chunk_tokens));
+    }
+
+    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - start_time);
+    response.setUsage(original_tokens, total_chunk_tokens, static_cast<float>(duration.count()));
+    return response;
+}
+
+void ChunkingRoute::handleBatch(SocketType sock, const RequestContext& context, ChunkingRequest& request,
+                                const std::string& requestId, bool stream)
+{
+    std::vector<std::string> texts = std::move(request.texts);
+    if (texts.empty())
+    {
+        texts.push_back(std::move(request.text));
+    }
+    const size_t total = texts.size();
+
+    struct Chunked
+    {
+        size_t document = 0;
+        ChunkingResponse response;
+        std::string error;
+    };
+    auto finished = std::make_shared<CompletionQueue<Chunked>>();
+    for (size_t i = 0; i < total; ++i)
+    {
+        TaskExecutor::instance().submit([this, request, i, finished, text = std::move(texts[i])]() {
+            Chunked chunked;
+            chunked.document = i;
+            try
+            {
+                chunked.response = chunkText(request, text);
+            }
+            catch (const std::exception& ex)
+            {
+                chunked.error = ex.what();
+            }
+            finished->push(std::move(chunked));
+        });
+    }
+
+    size_t total_chunks = 0;
+    size_t failed = 0;
+    int original_tokens = 0;
+    int total_chunk_tokens = 0;
+    auto account = [&](const Chunked& chunked) {
+        if (!chunked.error.empty())
+        {
+            ++failed;
+            return;
+        }
+        total_chunks += chunked.response.chunks.size();
+        original_tokens += chunked.response.usage.original_tokens;
+        total_chunk_tokens += chunked.response.usage.total_chunk_tokens;
+    };
+
+    if (stream)
+    {
+        // Every chunk is a record, followed by one closing its text; texts arrive in completion order
+        RecordStream records(sock, context);
+        bool open = true;
+        for (size_t received = 0; received < total && open; ++received)
+        {
+            Chunked chunked = finished->pop();
+            account(chunked);
+            if (!chunked.error.empty())
+            {
+                open = records.send({{"document", chunked.document}, {"done", true}, {"error", chunked.error}});
+                continue;
+            }
+            for (const auto& chunk : chunked.response.chunks)
+            {
+                json record = chunk.to_json();
+                record["document"] = chunked.document;
+                if (!(open = records.send(record)))
+                {
+                    break;
+                }
+            }
+            if (open)
+            {
+                json done = chunked.response.to_json();
+                done.erase("chunks");
+                done["document"] = chunked.document;
+                done["done"] = true;
+                open = records.send(done);
+            }
+        }
+        if (!open)
+        {
+            KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Client left chunking stream '%s'", std::hash<std::thread::id>{}(std::this_thread::get_id()), requestId.c_str());
+        }
+        records.finish({{"done", true}, {"documents", total}, {"failed", failed}, {"total_chunks", total_chunks},
+                        {"usage", {{"original_tokens", original_tokens}, {"total_chunk_tokens", total_chunk_tokens}}}});
+        return;
+    }
+
+    std::vector<json> ordered(total);
+    for (size_t received = 0; received < total; ++received)
+    {
+        Chunked chunked = finished->pop();
+        account(chunked);
+        if (chunked.error.empty())
+        {
+            ordered[chunked.document] = chunked.response.to_json();
+        }
+        else
+        {
+            ordered[chunked.document] = {{"error", {{"message", "Failed to process chunking request: " + chunked.error},
+                                                    {"type", "processing_error"}}}};
+        }
+        ordered[chunked.document]["document"] = chunked.document;
+    }
+
+    json response;
+    response["model_name"] = request.model_name;
+    response["method"] = request.method;
+    response["documents"] = total;
+    response["failed"] = failed;
+    response["total_chunks"] = total_chunks;
+    response["results"] = std::move(ordered);
+    response["usage"] = {{"original_tokens", original_tokens}, {"total_chunk_tokens", total_chunk_tokens}};
+
+    std::map<std::string, std::string> headers = {
+        {"Content-Type", "application/json"},
+        {"Access-Control-Allow-Origin", "*"},
+        {"Access-Control-Allow-Methods", "POST, OPTIONS"},
+        {"Access-Control-Allow-Headers", "Content-Type, Authorization, X-API-Key"}
+    };
+    send_response(sock, 200, response.dump(), headers);
+
+    KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Chunked %zu texts for request '%s': %zu chunks, %zu failed",
+                          std::hash<std::thread::id>{}(std::this_thread::get_id()), total, requestId.c_str(), total_chunks, failed);
+}
+
 std::future<std::vector<std::string>> ChunkingRoute::processRegularChunking(
     const std::string& text,
     const std::string& model_name,
@@ -226,22 +369,16 @@ std::future<std::vector<std::string>> ChunkingRoute::processRegularChunking(
     int overlap
 )
 {
-    return std::async(std::launch::async, [=]() -> std::vector<std::string> {
+    return TaskExecutor::instance().submit([=]() -> std::vector<std::string> {
         try
         {
-            std::lock_guard<std::mutex> lock(service_mutex_);
-            
-            // Tokenize the text
-            auto tokens_future = chunking_service_->tokenizeText(text, model_name);
-            auto tokens = tokens_future.get();
-            
-            // Generate base chunks
-            return chunking_service_->generateBaseChunks(text, tokens, chunk_size, overlap);
+            // Chunk over word spans of the text rather than copied tokens
+            return chunking_service_->generateBaseChunks(text, chunk_size, overlap);
         }
         catch (const std::exception& ex)
         {
-            ServerLogger::logError("[Thread %u] Error in regular chunking: %s", 
-                                   std::this_thread::get_id(), ex.what());
+            KOLOSAL_LOG_ERROR("[Thread %zu] Error in regular chunking: %s", 
+                                   std::hash<std::thread::id>{}(std::this_thread::get_id()), ex.what());
             throw;
         }
     });
@@ -256,11 +393,9 @@ std::future<std::vector<std::string>> ChunkingRoute::processSemanticChunking(
     float similarity_threshold
 )
 {
-    return std::async(std::launch::async, [=]() -> std::vector<std::string> {
+    return TaskExecutor::instance().submit([=]() -> std::vector<std::string> {
         try
         {
-            std::lock_guard<std::mutex> lock(service_mutex_);
-            
             // Use the semantic chunking service
             auto chunks_future = chunking_service_->semanticChunk(
                 text, model_name, chunk_size, overlap, max_chunk_size, similarity_threshold
@@ -270,8 +405,8 @@ std::future<std::vector<std::string>> ChunkingRoute::processSemanticChunking(
         }
         catch (const std::exception& ex)
         {
-            ServerLogger::logError("[Thread %u] Error in semantic chunking: %s", 
-                                   std::this_thread::get_id(), ex.what());
+            KOLOSAL_LOG_ERROR("[Thread %zu] Error in semantic chunking: %s", 
+                                   std::hash<std::thread::id>{}(std::this_thread::get_id()), ex.what());
             throw;
         }
     });
@@ -281,8 +416,8 @@ void ChunkingRoute::handleOptions(SocketType sock)
 {
     try
     {
-        ServerLogger::logDebug("[Thread %u] Handling OPTIONS request for /chunking endpoint", 
-                               std::this_thread::get_id());
+        KOLOSAL_LOG_REQUEST_DEBUG("[Thread %zu] Handling OPTIONS request for /chunking endpoint", 
+                               std::hash<std::thread::id>{}(std::this_thread::get_id()));
 
         std::map<std::string, std::string> headers = {
             {"Content-Type", "text/plain"},
@@ -294,13 +429,13 @@ void ChunkingRoute::handleOptions(SocketType sock)
         
         send_response(sock, 200, "", headers);
         
-        ServerLogger::logDebug("[Thread %u] Successfully handled OPTIONS request", 
-                               std::this_thread::get_id());
+        KOLOSAL_LOG_REQUEST_DEBUG("[Thread %zu] Successfully handled OPTIONS request", 
+                               std::hash<std::thread::id>{}(std::this_thread::get_id()));
     }
     catch (const std::exception& ex)
     {
-        ServerLogger::logError("[Thread %u] Error handling OPTIONS request: %s", 
-                               std::this_thread::get_id(), ex.what());
+        KOLOSAL_LOG_ERROR("[Thread %zu] Error handling OPTIONS request: %s", 
+                               std::hash<std::thread::id>{}(std::this_thread::get_id()), ex.what());
         sendErrorResponse(sock, 500, "Internal server error: " + std::string(ex.what()), "server_error");
     }
 }
@@ -331,14 +466,8 @@ void ChunkingRoute::sendErrorResponse(
     };
     send_response(sock, status_code, errorResponse.dump(), headers);
     
-    ServerLogger::logError("[Thread %u] Chunking request error (%d): %s", 
-                           std::this_thread::get_id(), status_code, error_message.c_str());
-}
-
-int ChunkingRoute::estimateTokenCount(const std::string& text) const
-{
-    // Simple estimation: roughly 4 characters per token for English text
-    return std::max(1, static_cast<int>(text.length() / 4));
+    KOLOSAL_LOG_ERROR("[Thread %zu] Chunking request error (%d): %s", 
+                           std::hash<std::thread::id>{}(std::this_thread::get_id()), status_code, error_message.c_str());
 }
 
 bool ChunkingRoute::validateChunkingModel(const std::string& model_name) const
@@ -3,78 +3,318 @@
 #include "kolosal/retrieval/remove_document_types.hpp"
 #include "kolosal/retrieval/document_list_types.hpp"
 #include "kolosal/retrieval/retrieve_types.hpp"
+#include "kolosal/routes/llm/oai_parameters.hpp"
+#include "kolosal/models/chat_response_model.hpp"
+#include "kolosal/models/sse_chunk_writer.hpp"
+#include "kolosal/auth/auth_middleware.hpp"
+#include "kolosal/node_manager.h"
 #include "kolosal/server_config.hpp"
+#include "kolosal/request_body.hpp"
 #include "kolosal/utils.hpp"
 #include "kolosal/server_api.hpp"
 #include "kolosal/logger.hpp"
+#include "kolosal/tracing.hpp"
 #include <json.hpp>
+#include <future>
 #include <iostream>
 #include <stdexcept>
 #include <thread>
 #include <chrono>
 #include <memory>
+#include <sstream>
+#include <algorithm>
+#include <cctype>
 
 using json = nlohmann::json;
 
 namespace kolosal
 {
 
+namespace
+{
+    const std::string kJobsPath = "/add_documents/jobs";
+    constexpr int kJobStreamIntervalMs = 500;
+
+    // "/add_documents/jobs/{id}", with any query string already removed
+    bool isJobPath(const std::string& path)
+    {
+        const std::string prefix = kJobsPath + "/";
+        return path.size() > prefix.size() && path.compare(0, prefix.size(), prefix) == 0 &&
+               path.find('/', prefix.size()) == std::string::npos;
+    }
+
+    // Whether the query string sets a flag, as in "?stream=true" or "?stream=1"
+    bool queryFlag(const std::string& path, const std::string& name)
+    {
+        const size_t query = path.find('?');
+        if (query == std::string::npos)
+        {
+            return false;
+        }
+        std::istringstream params(path.substr(query + 1));
+        std::string param;
+        while (std::getline(params, param, '&'))
+        {
+            if (param == name + "=true" || param == name + "=1")
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Value of a query string parameter, percent-decoded; "" if absent
+    std::string queryValue(const std::string& path, const std::string& name)
+    {
+        const size_t query = path.find('?');
+        if (query == std::string::npos)
+        {
+            return std::string();
+        }
+        std::istringstream params(path.substr(query + 1));
+        std::string param;
+        while (std::getline(params, param, '&'))
+        {
+            if (param.compare(0, name.size() + 1, name + "=") != 0)
+            {
+                continue;
+            }
+            std::string value;
+            for (size_t i = name.size() + 1; i < param.size(); ++i)
+            {
+                if (param[i] == '%' && i + 2 < param.size() && std::isxdigit(static_cast<unsigned char>(param[i + 1])) &&
+                    std::isxdigit(static_cast<unsigned char>(param[i + 2])))
+                {
+                    value += static_cast<char>(std::stoi(param.substr(i + 1, 2), nullptr, 16));
+                    i += 2;
+                }
+                else
+                {
+                    value += param[i] == '+' ? ' ' : param[i];
+                }
+            }
+            return value;
+        }
+        return std::string();
+    }
+
+    // Change stream bytes per /replication/changes response, by default and at most
+    constexpr size_t kChangesPageBytes = 4 * 1024 * 1024;
+    constexpr size_t kMaxChangesPageBytes = 16 * 1024 * 1024;
+
+    // IDs per page of a streamed /list_documents, and the largest page a client may ask for
+    constexpr size_t kListPageSize = 1000;
+    constexpr size_t kMaxListPageSize = 10000;
+
+    // Instruction placed before the documents when a /rag request brings no "system"
+    const std::string kDefaultRagInstruction =
+        "Answer the user's question using the documents below. If they do not contain the answer, say so.";
+
+    // /rag body fields that only steer retrieval, removed before the chat completion sees the body
+    const char* const kRagOnlyFields[] = {"query", "k", "collection_name", "score_threshold", "filter", "search_mode",
+                                          "fusion", "keyword_weight", "rerank_model", "rerank_candidates", "system",
+                                          "deadline_ms"};
+
+    // System message of a /rag request. Documents are ordered by ID rather than score, so the
+    // same set always produces byte-identical text and hits the model's prefix cache.
+    std::string assembleRagContext(const std::string& instruction, std::vector<kolosal::retrieval::RetrievedDocument> documents)
+    {
+        std::sort(documents.begin(), documents.end(),
+                  [](const kolosal::retrieval::RetrievedDocument& a, const kolosal::retrieval::RetrievedDocument& b)
+                  { return a.id < b.id; });
+        std::string context = instruction;
+        for (size_t i = 0; i < documents.size(); ++i)
+        {
+            context += "\n\n[" + std::to_string(i + 1) + "] " + documents[i].text;
+        }
+        return context;
+    }
+
+    // Runs a retrieval as one traced stage, its phases reported alongside in Server-Timing
+    kolosal::retrieval::RetrieveResponse retrieveTimed(kolosal::retrieval::DocumentService& service,
+                                                       const kolosal::retrieval::RetrieveRequest& request)
+    {
+        tracing::Span retrievalSpan("retrieval");
+        kolosal::retrieval::RetrieveResponse response = service.retrieveDocuments(request).get();
+        tracing::add_timing("retrieval.embed", response.embed_ms);
+        tracing::add_timing("retrieval.search", response.search_ms);
+        if (response.rerank_ms > 0)
+            tracing::add_timing("retrieval.rerank", response.rerank_ms);
+        return response;
+    }
+
+    // The documents a /rag answer was grounded on, without their text
+    json ragDocuments(const kolosal::retrieval::RetrieveResponse& retrieved)
+    {
+        json documents = json::array();
+        for (const auto& doc : retrieved.documents)
+        {
+            documents.push_back({{"id", doc.id}, {"score", doc.score}, {"metadata", doc.metadata}});
+        }
+        return documents;
+    }
+
+    // A streamed body in full, for the endpoints that parse it as a DOM
+    std::string readBody(RequestBody& body)
+    {
+        std::string text;
+        text.reserve(body.size());
+        char buffer[64 * 1024];
+        while (size_t read = body.read(buffer, sizeof(buffer)))
+        {
+            text.append(buffer, read);
+        }
+        return text;
+    }
+
+    double elapsedMs(std::chrono::steady_clock::time_point since)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - since).count();
+    }
+}
+
 std::atomic<long long> DocumentsRoute::request_counter_{0};
 
 DocumentsRoute::DocumentsRoute()
 {
-    ServerLogger::logInfo("DocumentsRoute initialized");
+    KOLOSAL_LOG_INFO("DocumentsRoute initialized");
+    
+    // A replica follows its source from startup rather than from its first request
+    if (!kolosal::retrieval::DocumentService::serverDatabaseConfig().replication.source.empty() && !ensureDocumentService())
+    {
+        KOLOSAL_LOG_ERROR("DocumentService failed to initialize; replication is not running");
+    }
 }
 
 DocumentsRoute::~DocumentsRoute() = default;
 
-bool DocumentsRoute::match(const std::string& method, const std::string& path)
+bool DocumentsRoute::match(const std::string& method, const std::string& full_path)
+{
+    const std::string path = full_path.substr(0, full_path.find('?'));
+    return (method == "POST" && (path == "/add_documents" || path == "/import_vectors")) ||
+           (method == "GET" && (path == kJobsPath || isJobPath(path))) ||
+           (method == "DELETE" && isJobPath(path)) ||
+           (method == "POST" && path == "/remove_documents") ||
+           (method == "GET" && path == "/list_documents") ||
+           (method == "POST" && path == "/info_documents") ||
+           (method == "POST" && path == "/retrieve") ||
+           (method == "POST" && path == "/rag") ||
+           ((method == "GET" || method == "POST") && path == "/replication/snapshot") ||
+           (method == "GET" && (path == "/replication/changes" || path == "/replication/status")) ||
+           (method == "OPTIONS" && (path == "/add_documents" || path == "/import_vectors" || path == "/remove_documents" ||
+                                   path == "/list_documents" || path == "/info_documents" || path == "/retrieve" ||
+                                   path == "/rag" || path == "/replication/snapshot" || path == "/replication/changes" ||
+                                   path == "/replication/status" || path == kJobsPath || isJobPath(path)));
+}
+
+std::vector<RoutePattern> DocumentsRoute::patterns() const
 {
-    if ((method == "POST" && path == "/add_documents") ||
-        (method == "POST" && path == "/remove_documents") ||
-        (method == "GET" && path == "/list_documents") ||
-        (method == "POST" && path == "/info_documents") ||
-        (method == "POST" && path == "/retrieve") ||
-        (method == "OPTIONS" && (path == "/add_documents" || path == "/remove_documents" || 
-                                path == "/list_documents" || path == "/info_documents" || path == "/retrieve")))
-    {
-        current_endpoint_ = path;
-        current_method_ = method;
-        return true;
-    }
-    return false;
+    return {
+        {"POST", "/add_documents"},
+        {"POST", "/import_vectors"},
+        {"POST", "/remove_documents"},
+        {"GET", "/list_documents"},
+        {"POST", "/info_documents"},
+        {"POST", "/retrieve"},
+        {"POST", "/rag"},
+        {"GET", "/add_documents/jobs"},
+        {"GET", "/add_documents/jobs/{id}"},
+        {"DELETE", "/add_documents/jobs/{id}"},
+        {"GET", "/replication/snapshot"},
+        {"POST", "/replication/snapshot"},
+        {"GET", "/replication/changes"},
+        {"GET", "/replication/status"},
+        {"OPTIONS", "/add_documents"},
+        {"OPTIONS", "/import_vectors"},
+        {"OPTIONS", "/remove_documents"},
+        {"OPTIONS", "/list_documents"},
+        {"OPTIONS", "/info_documents"},
+        {"OPTIONS", "/retrieve"},
+        {"OPTIONS", "/rag"},
+        {"OPTIONS", "/add_documents/jobs"},
+        {"OPTIONS", "/add_documents/jobs/{id}"},
+        {"OPTIONS", "/replication/snapshot"},
+        {"OPTIONS", "/replication/changes"},
+        {"OPTIONS", "/replication/status"}
+    };
 }
 
-void DocumentsRoute::handle(SocketType sock, const std::string& body)
+void DocumentsRoute::handle(SocketType sock, const RequestContext& request)
 {
+    const std::string endpoint = request.path.substr(0, request.path.find('?'));
     try
     {
-        ServerLogger::logInfo("[Thread %u] Received %s request for endpoint: %s", 
-                              std::this_thread::get_id(), current_method_.c_str(), current_endpoint_.c_str());
+        KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Received %s request for endpoint: %s", 
+                              std::hash<std::thread::id>{}(std::this_thread::get_id()), request.method.c_str(), endpoint.c_str());
 
-        if (current_method_ == "OPTIONS")
+        if (request.method == "OPTIONS")
         {
             handleOptions(sock);
         }
-        else if (current_endpoint_ == "/add_documents")
+        else if (endpoint == "/add_documents")
+        {
+            handleAddDocuments(sock, request.body, request.bodyStream);
+        }
+        else if (endpoint == "/import_vectors")
+        {
+            handleImportVectors(sock, request);
+        }
+        else if (endpoint == "/replication/snapshot" && request.method == "POST")
+        {
+            handleImportSnapshot(sock, request);
+        }
+        else if (request.bodyStream)
         {
-            handleAddDocuments(sock, body);
+            // Only /add_documents, /import_vectors and snapshot imports read their body incrementally
+            const std::string body = readBody(*request.bodyStream);
+            RequestContext buffered{request.method, request.path, request.headers, request.params, body, nullptr, request.clientIP, request.unixSocket};
+            handle(sock, buffered);
         }
-        else if (current_endpoint_ == "/remove_documents")
+        else if (endpoint == kJobsPath)
         {
-            handleRemoveDocuments(sock, body);
+            handleListIngestionJobs(sock);
         }
-        else if (current_endpoint_ == "/list_documents")
+        else if (isJobPath(endpoint) && request.method == "DELETE")
         {
-            handleListDocuments(sock);
+            handleCancelIngestionJob(sock, request.param("id"));
         }
-        else if (current_endpoint_ == "/info_documents")
+        else if (isJobPath(endpoint))
         {
-            handleDocumentsInfo(sock, body);
+            handleIngestionJob(sock, request.param("id"), queryFlag(request.path, "stream"));
         }
-        else if (current_endpoint_ == "/retrieve")
+        else if (endpoint == "/remove_documents")
         {
-            handleRetrieve(sock, body);
+            handleRemoveDocuments(sock, request.body);
+        }
+        else if (endpoint == "/list_documents")
+        {
+            handleListDocuments(sock, request);
+        }
+        else if (endpoint == "/info_documents")
+        {
+            handleDocumentsInfo(sock, request.body);
+        }
+        else if (endpoint == "/retrieve")
+        {
+            handleRetrieve(sock, request.body);
+        }
+        else if (endpoint == "/replication/snapshot")
+        {
+            handleExportSnapshot(sock);
+        }
+        else if (endpoint == "/replication/changes")
+        {
+            handleChanges(sock, request);
+        }
+        else if (endpoint == "/replication/status")
+        {
+            handleReplicationStatus(sock);
+        }
+        else if (endpoint == "/rag")
+        {
+            const std::string subject = auth::TokenQuota::subjectFor(
+                ServerAPI::instance().getAuthMiddleware().extractApiKey(request.headers), request.clientIP);
+            handleRag(sock, request.body, subject);
         }
         else
         {
@@ -83,51 +323,347 @@ void DocumentsRoute::handle(SocketType sock, const std::string& body)
     }
     catch (const std::exception& ex)
     {
-        ServerLogger::logError("[Thread %u] Error handling documents request: %s", 
-                               std::this_thread::get_id(), ex.what());
+        KOLOSAL_LOG_ERROR("[Thread %zu] Error handling documents request: %s", 
+                               std::hash<std::thread::id>{}(std::this_thread::get_id()), ex.what());
         sendErrorResponse(sock, 500, "Internal server error: " + std::string(ex.what()), "server_error");
     }
 }
 
-void DocumentsRoute::handleAddDocuments(SocketType sock, const std::string& body)
+void DocumentsRoute::handleImportVectors(SocketType sock, const RequestContext& request)
+{
+    // Row failures reported in full; beyond this only counted
+    constexpr size_t kMaxReportedErrors = 100;
+    
+    const std::string dimensions = queryValue(request.path, "dimensions");
+    const std::string dtype = queryValue(request.path, "dtype");
+    size_t dims = 0;
+    try
+    {
+        dims = dimensions.empty() ? 0 : static_cast<size_t>(std::stoul(dimensions));
+    }
+    catch (const std::exception&)
+    {
+    }
+    if (!request.bodyStream && request.body.empty())
+    {
+        sendErrorResponse(sock, 400, "Request body is empty");
+        return;
+    }
+    
+    std::istringstream buffered;
+    if (!request.bodyStream)
+    {
+        buffered.str(request.body);
+    }
+    std::istream& body = request.bodyStream ? request.bodyStream->stream() : buffered;
+    std::unique_ptr<kolosal::retrieval::VectorImportReader> reader;
+    try
+    {
+        reader = std::make_unique<kolosal::retrieval::VectorImportReader>(body, dims, dtype.empty() ? "f32" : dtype);
+    }
+    catch (const std::invalid_argument& ex)
+    {
+        sendErrorResponse(sock, 400, ex.what(), "invalid_request_error", dims == 0 || dims > kolosal::retrieval::VectorImportReader::kMaxDimensions ? "dimensions" : "dtype");
+        return;
+    }
+    
+    if (!ensureDocumentService())
+    {
+        sendErrorResponse(sock, 500, "Failed to initialize document service", "service_error");
+        return;
+    }
+    if (!document_service_->testConnection().get())
+    {
+        sendErrorResponse(sock, 503, "Database connection failed", "service_unavailable");
+        return;
+    }
+    
+    // The next frame is read while the previous one is written
+    size_t succeeded = 0;
+    size_t failed = 0;
+    size_t frames = 0;
+    size_t rows_written = 0;
+    json errors = json::array();
+    std::future<kolosal::retrieval::AddDocumentsResponse> pending;
+    auto collect = [&]() {
+        if (!pending.valid())
+        {
+            return;
+        }
+        const kolosal::retrieval::AddDocumentsResponse written = pending.get();
+        for (size_t i = 0; i < written.results.size(); ++i)
+        {
+            if (written.results[i].success)
+            {
+                ++succeeded;
+            }
+            else if (++failed <= kMaxReportedErrors)
+            {
+                errors.push_back({{"row", rows_written + i}, {"error", written.results[i].error}});
+            }
+        }
+        rows_written += written.results.size();
+    };
+    
+    std::string problem;
+    try
+    {
+        kolosal::retrieval::VectorImportBatch batch;
+        while (reader->next(batch))
+        {
+            ++frames;
+            collect();
+            pending = document_service_->importVectors(std::move(batch));
+            batch = {};
+        }
+    }
+    catch (const std::exception& ex)
+    {
+        problem = request.bodyStream && !request.bodyStream->ok() ? request.bodyStream->error() : ex.what();
+    }
+    collect();
+    
+    if (!problem.empty())
+    {
+        const int status = request.bodyStream && !request.bodyStream->ok() ? request.bodyStream->errorStatus() : 400;
+        sendErrorResponse(sock, status, problem + " (" + std::to_string(succeeded) + " rows before it were imported)");
+        return;
+    }
+    
+    json response = {
+        {"collection_name", "documents"},
+        {"successful_count", succeeded},
+        {"failed_count", failed},
+        {"frames", frames},
+        {"errors", errors}
+    };
+    std::map<std::string, std::string> headers = {
+        {"Content-Type", "application/json"},
+        {"Access-Control-Allow-Origin", "*"},
+        {"Access-Control-Allow-Methods", "POST, OPTIONS"},
+        {"Access-Control-Allow-Headers", "Content-Type, Authorization, X-API-Key"}
+    };
+    send_response(sock, 200, response.dump(), headers);
+    
+    KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Imported %zu vectors in %zu frames (%zu failed)",
+                          std::hash<std::thread::id>{}(std::this_thread::get_id()), succeeded, frames, failed);
+}
+
+void DocumentsRoute::handleExportSnapshot(SocketType sock)
+{
+    if (!ensureDocumentService())
+    {
+        sendErrorResponse(sock, 500, "Failed to initialize document service", "service_error");
+        return;
+    }
+    
+    // The status line waits for the first bytes, so a snapshot that cannot start still gets an error response
+    bool started = false;
+    size_t sent = 0;
+    const kolosal::retrieval::ReplicationResult result = document_service_->exportSnapshot(
+        [&](const char* data, size_t size) {
+            if (!started)
+            {
+                begin_streaming_response(sock, 200, {
+                    {"Content-Type", "application/octet-stream"},
+                    {"Access-Control-Allow-Origin", "*"},
+                    {"Access-Control-Allow-Methods", "GET, POST, OPTIONS"},
+                    {"Access-Control-Allow-Headers", "Content-Type, Authorization, X-API-Key"}
+                });
+                started = true;
+            }
+            send_stream_chunk(sock, StreamChunk(std::string(data, size), false));
+            sent += size;
+            return !client_disconnected(sock);
+        });
+    
+    if (!started)
+    {
+        sendErrorResponse(sock, result.status, result.error, result.status == 409 ? "conflict" : "server_error");
+        return;
+    }
+    // A failure after the first bytes leaves an archive the importer rejects by its checksums
+    send_stream_chunk(sock, StreamChunk("", true));
+    if (result.success)
+    {
+        KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Sent a %zu byte snapshot at position %llu", std::hash<std::thread::id>{}(std::this_thread::get_id()), sent,
+                              static_cast<unsigned long long>(result.info.value("position", static_cast<uint64_t>(0))));
+    }
+    else
+    {
+        KOLOSAL_LOG_ERROR("[Thread %zu] Snapshot stopped after %zu bytes: %s", std::hash<std::thread::id>{}(std::this_thread::get_id()), sent,
+                               result.error.c_str());
+    }
+}
+
+void DocumentsRoute::handleImportSnapshot(SocketType sock, const RequestContext& request)
+{
+    if (!request.bodyStream && request.body.empty())
+    {
+        sendErrorResponse(sock, 400, "Request body is empty");
+        return;
+    }
+    if (!ensureDocumentService())
+    {
+        sendErrorResponse(sock, 500, "Failed to initialize document service", "service_error");
+        return;
+    }
+    
+    std::istringstream buffered;
+    if (!request.bodyStream)
+    {
+        buffered.str(request.body);
+    }
+    std::istream& body = request.bodyStream ? request.bodyStream->stream() : buffered;
+    const kolosal::retrieval::ReplicationResult result = document_service_->importSnapshot(body);
+    if (!result.success)
+    {
+        if (request.bodyStream && !request.bodyStream->ok())
+        {
+            sendErrorResponse(sock, request.bodyStream->errorStatus(), request.bodyStream->error());
+        }
+        else
+        {
+            sendErrorResponse(sock, result.status, result.error, result.status < 500 ? "invalid_request_error" : "server_error");
+        }
+        return;
+    }
+    
+    std::map<std::string, std::string> headers = {
+        {"Content-Type", "application/json"},
+        {"Access-Control-Allow-Origin", "*"},
+        {"Access-Control-Allow-Methods", "GET, POST, OPTIONS"},
+        {"Access-Control-Allow-Headers", "Content-Type, Authorization, X-API-Key"}
+    };
+    send_response(sock, 200, result.info.dump(), headers);
+    
+    KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Restored the documents collection from a snapshot", std::hash<std::thread::id>{}(std::this_thread::get_id()));
+}
+
+void DocumentsRoute::handleChanges(SocketType sock, const RequestContext& request)
+{
+    const std::string epoch = queryValue(request.path, "epoch");
+    uint64_t position = 0;
+    size_t max_bytes = kChangesPageBytes;
+    try
+    {
+        position = std::stoull(queryValue(request.path, "position"));
+        const std::string limit = queryValue(request.path, "max_bytes");
+        if (!limit.empty())
+        {
+            max_bytes = std::clamp<size_t>(std::stoull(limit), 1, kMaxChangesPageBytes);
+        }
+    }
+    catch (const std::exception&)
+    {
+        sendErrorResponse(sock, 400, "position and max_bytes must be numbers", "invalid_request_error", "position");
+        return;
+    }
+    if (epoch.empty())
+    {
+        sendErrorResponse(sock, 400, "epoch is required", "invalid_request_error", "epoch");
+        return;
+    }
+    if (!ensureDocumentService())
+    {
+        sendErrorResponse(sock, 500, "Failed to initialize document service", "service_error");
+        return;
+    }
+    
+    std::string records;
+    const kolosal::retrieval::ReplicationResult result = document_service_->readChanges(epoch, position, max_bytes, records);
+    if (!result.success)
+    {
+        sendErrorResponse(sock, result.status, result.error, result.status == 410 ? "snapshot_required" : "server_error");
+        return;
+    }
+    
+    std::map<std::string, std::string> headers = {
+        {"Content-Type", "application/octet-stream"},
+        {"X-Replication-Epoch", result.info.value("epoch", std::string())},
+        {"X-Replication-Position", std::to_string(result.info.value("position", static_cast<uint64_t>(0)))},
+        {"X-Replication-End", std::to_string(result.info.value("end", static_cast<uint64_t>(0)))},
+        {"Access-Control-Allow-Origin", "*"},
+        {"Access-Control-Allow-Methods", "GET, OPTIONS"},
+        {"Access-Control-Allow-Headers", "Content-Type, Authorization, X-API-Key"},
+        {"Access-Control-Expose-Headers", "X-Replication-Epoch, X-Replication-Position, X-Replication-End"}
+    };
+    send_response(sock, 200, records, headers);
+}
+
+void DocumentsRoute::handleReplicationStatus(SocketType sock)
+{
+    json status = {{"role", "source"}};
+    if (ensureDocumentService())
+    {
+        json following = document_service_->replicationStatus();
+        if (!following.is_null())
+        {
+            status = std::move(following);
+            status["role"] = "replica";
+        }
+    }
+    std::map<std::string, std::string> headers = {
+        {"Content-Type", "application/json"},
+        {"Access-Control-Allow-Origin", "*"},
+        {"Access-Control-Allow-Methods", "GET, OPTIONS"},
+        {"Access-Control-Allow-Headers", "Content-Type, Authorization, X-API-Key"}
+    };
+    send_response(sock, 200, status.dump(), headers);
+}
+
+void DocumentsRoute::handleAddDocuments(SocketType sock, const std::string& body, RequestBody* bodyStream)
 {
     std::string requestId; // Declare here so it's accessible in catch blocks
 
     try
     {
-        ServerLogger::logInfo("[Thread %u] Received add documents request", std::this_thread::get_id());
+        KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Received add documents request", std::hash<std::thread::id>{}(std::this_thread::get_id()));
 
         // Check for empty body
-        if (body.empty())
+        if (!bodyStream && body.empty())
         {
             sendErrorResponse(sock, 400, "Request body is empty");
             return;
         }
 
-        // Parse JSON request
-        json j;
+        // Parse straight into the DTO model; document texts are moved out of the parser, never copied
+        kolosal::retrieval::AddDocumentsRequest request;
         try
         {
-            j = json::parse(body);
+            if (bodyStream)
+            {
+                request.parse(bodyStream->stream());
+            }
+            else
+            {
+                request.parse(body);
+            }
         }
         catch (const json::parse_error& ex)
         {
-            sendErrorResponse(sock, 400, "Invalid JSON: " + std::string(ex.what()));
+            if (bodyStream && !bodyStream->ok())
+            {
+                sendErrorResponse(sock, bodyStream->errorStatus(), bodyStream->error());
+            }
+            else
+            {
+                sendErrorResponse(sock, 400, "Invalid JSON: " + std::string(ex.what()));
+            }
             return;
         }
-
-        // Parse the request using the DTO model
-        kolosal::retrieval::AddDocumentsRequest request;
-        try
-        {
-            request.from_json(j);
-        }
         catch (const std::runtime_error& ex)
         {
             sendErrorResponse(sock, 400, ex.what());
             return;
         }
 
+        if (request.mode != "add" && request.mode != "update")
+        {
+            sendErrorResponse(sock, 400, "mode must be 'add' or 'update'", "invalid_request_error", "mode");
+            return;
+        }
+
         // Validate the request
         if (!request.validate())
         {
@@ -140,8 +676,8 @@ void DocumentsRoute::handleAddDocuments(SocketType sock, const std::string& body
                    std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(
                        std::chrono::system_clock::now().time_since_epoch()).count());
 
-        ServerLogger::logInfo("[Thread %u] Processing %zu documents for indexing (Request ID: %s)", 
-                              std::this_thread::get_id(), request.documents.size(), requestId.c_str());
+        KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Processing %zu documents for indexing (Request ID: %s)", 
+                              std::hash<std::thread::id>{}(std::this_thread::get_id()), request.documents.size(), requestId.c_str());
 
         // Initialize document service if needed
         if (!ensureDocumentService())
@@ -158,10 +694,33 @@ void DocumentsRoute::handleAddDocuments(SocketType sock, const std::string& body
             return;
         }
 
+        const size_t document_count = request.documents.size();
+        if (request.async)
+        {
+            const std::string job_id = document_service_->submitAddDocumentsJob(std::move(request));
+            json accepted = {
+                {"job_id", job_id},
+                {"status", "queued"},
+                {"total", document_count},
+                {"status_url", kJobsPath + "/" + job_id}
+            };
+            std::map<std::string, std::string> headers = {
+                {"Content-Type", "application/json"},
+                {"Access-Control-Allow-Origin", "*"},
+                {"Access-Control-Allow-Methods", "POST, OPTIONS"},
+                {"Access-Control-Allow-Headers", "Content-Type, Authorization, X-API-Key"}
+            };
+            send_response(sock, 202, accepted.dump(), headers);
+            
+            KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Queued %zu documents as ingestion job %s (Request ID: %s)",
+                                  std::hash<std::thread::id>{}(std::this_thread::get_id()), document_count, job_id.c_str(), requestId.c_str());
+            return;
+        }
+
         // Process documents
-        ServerLogger::logDebug("[Thread %u] Submitting documents for processing", std::this_thread::get_id());
+        KOLOSAL_LOG_REQUEST_DEBUG("[Thread %zu] Submitting documents for processing", std::hash<std::thread::id>{}(std::this_thread::get_id()));
         
-        auto response_future = document_service_->addDocuments(request);
+        auto response_future = document_service_->addDocuments(std::move(request));
         
         // Wait for processing to complete
         kolosal::retrieval::AddDocumentsResponse response = response_future.get();
@@ -175,17 +734,143 @@ void DocumentsRoute::handleAddDocuments(SocketType sock, const std::string& body
         };
         send_response(sock, 200, response.to_json().dump(), headers);
 
-        ServerLogger::logInfo("[Thread %u] Successfully processed documents - Success: %d, Failed: %d", 
-                              std::this_thread::get_id(), response.successful_count, response.failed_count);
+        KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Successfully processed documents - Success: %d, Failed: %d", 
+                              std::hash<std::thread::id>{}(std::this_thread::get_id()), response.successful_count, response.failed_count);
     }
     catch (const json::exception& ex)
     {
-        ServerLogger::logError("[Thread %u] JSON parsing error: %s", std::this_thread::get_id(), ex.what());
+        KOLOSAL_LOG_ERROR("[Thread %zu] JSON parsing error: %s", std::hash<std::thread::id>{}(std::this_thread::get_id()), ex.what());
         sendErrorResponse(sock, 400, "Invalid JSON: " + std::string(ex.what()));
     }
     catch (const std::exception& ex)
     {
-        ServerLogger::logError("[Thread %u] Error handling add documents request: %s", std::this_thread::get_id(), ex.what());
+        KOLOSAL_LOG_ERROR("[Thread %zu] Error handling add documents request: %s", std::hash<std::thread::id>{}(std::this_thread::get_id()), ex.what());
+        sendErrorResponse(sock, 500, "Internal server error: " + std::string(ex.what()), "server_error");
+    }
+}
+
+void DocumentsRoute::handleListIngestionJobs(SocketType sock)
+{
+    try
+    {
+        if (!ensureDocumentService())
+        {
+            sendErrorResponse(sock, 500, "Failed to initialize document service", "service_error");
+            return;
+        }
+
+        json jobs = json::array();
+        for (const auto& job : document_service_->listIngestionJobs())
+        {
+            jobs.push_back(job.to_json(false));
+        }
+
+        std::map<std::string, std::string> headers = {
+            {"Content-Type", "application/json"},
+            {"Access-Control-Allow-Origin", "*"},
+            {"Access-Control-Allow-Methods", "GET, OPTIONS"},
+            {"Access-Control-Allow-Headers", "Content-Type, Authorization, X-API-Key"}
+        };
+        send_response(sock, 200, json{{"jobs", jobs}, {"total_count", jobs.size()}}.dump(), headers);
+    }
+    catch (const std::exception& ex)
+    {
+        KOLOSAL_LOG_ERROR("[Thread %zu] Error listing ingestion jobs: %s", std::hash<std::thread::id>{}(std::this_thread::get_id()), ex.what());
+        sendErrorResponse(sock, 500, "Internal server error: " + std::string(ex.what()), "server_error");
+    }
+}
+
+void DocumentsRoute::handleIngestionJob(SocketType sock, const std::string& job_id, bool stream)
+{
+    try
+    {
+        if (!ensureDocumentService())
+        {
+            sendErrorResponse(sock, 500, "Failed to initialize document service", "service_error");
+            return;
+        }
+
+        auto job = document_service_->getIngestionJob(job_id);
+        if (!job)
+        {
+            sendErrorResponse(sock, 404, "Ingestion job '" + job_id + "' not found", "not_found_error", "job_id");
+            return;
+        }
+
+        if (!stream)
+        {
+            std::map<std::string, std::string> headers = {
+                {"Content-Type", "application/json"},
+                {"Access-Control-Allow-Origin", "*"},
+                {"Access-Control-Allow-Methods", "GET, DELETE, OPTIONS"},
+                {"Access-Control-Allow-Headers", "Content-Type, Authorization, X-API-Key"}
+            };
+            send_response(sock, 200, job->to_json().dump(), headers);
+            return;
+        }
+
+        // Server-sent events: an event whenever the counters move, the last one with the results
+        begin_streaming_response(sock, 200, {{"Content-Type", "text/event-stream"}, {"Cache-Control", "no-cache"}});
+        std::string last_event;
+        while (job)
+        {
+            const std::string event = job->to_json().dump();
+            if (event != last_event)
+            {
+                send_stream_chunk(sock, StreamChunk("data: " + event + "\n\n", false));
+                last_event = event;
+            }
+            if (job->finished() || client_disconnected(sock))
+            {
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(kJobStreamIntervalMs));
+            job = document_service_->getIngestionJob(job_id);
+        }
+        send_stream_chunk(sock, StreamChunk("", true));
+    }
+    catch (const std::exception& ex)
+    {
+        KOLOSAL_LOG_ERROR("[Thread %zu] Error reading ingestion job %s: %s", std::hash<std::thread::id>{}(std::this_thread::get_id()), job_id.c_str(), ex.what());
+        sendErrorResponse(sock, 500, "Internal server error: " + std::string(ex.what()), "server_error");
+    }
+}
+
+void DocumentsRoute::handleCancelIngestionJob(SocketType sock, const std::string& job_id)
+{
+    try
+    {
+        if (!ensureDocumentService())
+        {
+            sendErrorResponse(sock, 500, "Failed to initialize document service", "service_error");
+            return;
+        }
+
+        if (!document_service_->cancelIngestionJob(job_id))
+        {
+            if (document_service_->getIngestionJob(job_id))
+            {
+                sendErrorResponse(sock, 409, "Ingestion job '" + job_id + "' has already finished", "conflict_error", "job_id");
+            }
+            else
+            {
+                sendErrorResponse(sock, 404, "Ingestion job '" + job_id + "' not found", "not_found_error", "job_id");
+            }
+            return;
+        }
+
+        auto job = document_service_->getIngestionJob(job_id);
+        std::map<std::string, std::string> headers = {
+            {"Content-Type", "application/json"},
+            {"Access-Control-Allow-Origin", "*"},
+            {"Access-Control-Allow-Methods", "GET, DELETE, OPTIONS"},
+            {"Access-Control-Allow-Headers", "Content-Type, Authorization, X-API-Key"}
+        };
+        send_response(sock, 200, (job ? job->to_json(false) : json{{"job_id", job_id}}).dump(), headers);
+    }
+    catch (const std::exception& ex)
+    {
+        KOLOSAL_LOG_ERROR("[Thread %zu] Error cancelling ingestion job %s: %s", std::hash<std::thread::id>{}(std::this_thread::get_id()), job_id.c_str(), ex.what());
         sendErrorResponse(sock, 500, "Internal server error: " + std::string(ex.what()), "server_error");
     }
 }
@@ -196,7 +881,7 @@ void DocumentsRoute::handleRemoveDocuments(SocketType sock, const std::string& b
 
     try
     {
-        ServerLogger::logInfo("[Thread %u] Received remove documents request", std::this_thread::get_id());
+        KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Received remove documents request", std::hash<std::thread::id>{}(std::this_thread::get_id()));
 
         // Check for empty body
         if (body.empty())
@@ -241,8 +926,8 @@ void DocumentsRoute::handleRemoveDocuments(SocketType sock, const std::string& b
                    std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(
                        std::chrono::system_clock::now().time_since_epoch()).count());
 
-        ServerLogger::logInfo("[Thread %u] Processing removal of %zu documents (Request ID: %s)", 
-                              std::this_thread::get_id(), request.ids.size(), requestId.c_str());
+        KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Processing removal of %zu documents (Request ID: %s)", 
+                              std::hash<std::thread::id>{}(std::this_thread::get_id()), request.ids.size(), requestId.c_str());
 
         // Initialize document service if needed
         if (!ensureDocumentService())
@@ -260,7 +945,7 @@ void DocumentsRoute::handleRemoveDocuments(SocketType sock, const std::string& b
         }
 
         // Process removal
-        ServerLogger::logDebug("[Thread %u] Submitting documents for removal", std::this_thread::get_id());
+        KOLOSAL_LOG_REQUEST_DEBUG("[Thread %zu] Submitting documents for removal", std::hash<std::thread::id>{}(std::this_thread::get_id()));
         
         auto response_future = document_service_->removeDocuments(request);
         
@@ -276,26 +961,56 @@ void DocumentsRoute::handleRemoveDocuments(SocketType sock, const std::string& b
         };
         send_response(sock, 200, response.to_json().dump(), headers);
 
-        ServerLogger::logInfo("[Thread %u] Successfully processed document removal - Removed: %d, Failed: %d, Not Found: %d", 
-                              std::this_thread::get_id(), response.removed_count, response.failed_count, response.not_found_count);
+        KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Successfully processed document removal - Removed: %d, Failed: %d, Not Found: %d", 
+                              std::hash<std::thread::id>{}(std::this_thread::get_id()), response.removed_count, response.failed_count, response.not_found_count);
     }
     catch (const json::exception& ex)
     {
-        ServerLogger::logError("[Thread %u] JSON parsing error: %s", std::this_thread::get_id(), ex.what());
+        KOLOSAL_LOG_ERROR("[Thread %zu] JSON parsing error: %s", std::hash<std::thread::id>{}(std::this_thread::get_id()), ex.what());
         sendErrorResponse(sock, 400, "Invalid JSON: " + std::string(ex.what()));
     }
     catch (const std::exception& ex)
     {
-        ServerLogger::logError("[Thread %u] Error handling remove documents request: %s", std::this_thread::get_id(), ex.what());
+        KOLOSAL_LOG_ERROR("[Thread %zu] Error handling remove documents request: %s", std::hash<std::thread::id>{}(std::this_thread::get_id()), ex.what());
         sendErrorResponse(sock, 500, "Internal server error: " + std::string(ex.what()), "server_error");
     }
 }
 
-void DocumentsRoute::handleListDocuments(SocketType sock)
+void DocumentsRoute::handleListDocuments(SocketType sock, const RequestContext& request)
 {
     try
     {
-        ServerLogger::logInfo("[Thread %u] Received list documents request", std::this_thread::get_id());
+        KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Received list documents request", std::hash<std::thread::id>{}(std::this_thread::get_id()));
+
+        const std::string limitParam = queryValue(request.path, "limit");
+        const std::string cursor = queryValue(request.path, "cursor");
+        std::string collection = queryValue(request.path, "collection_name");
+        if (collection.empty())
+        {
+            collection = "documents";
+        }
+        auto accept = request.headers.find("accept");
+        const bool ndjson = queryValue(request.path, "format") == "ndjson" ||
+                            (accept != request.headers.end() && accept->second.find("application/x-ndjson") != std::string::npos);
+
+        size_t limit = kListPageSize;
+        if (!limitParam.empty())
+        {
+            try
+            {
+                limit = static_cast<size_t>(std::stoul(limitParam));
+            }
+            catch (const std::exception&)
+            {
+                limit = 0;
+            }
+            if (limit == 0 || limit > kMaxListPageSize)
+            {
+                sendErrorResponse(sock, 400, "limit must be an integer between 1 and " + std::to_string(kMaxListPageSize),
+                                  "invalid_request_error", "limit");
+                return;
+            }
+        }
 
         // Initialize document service if needed
         if (!ensureDocumentService())
@@ -312,34 +1027,123 @@ void DocumentsRoute::handleListDocuments(SocketType sock)
             return;
         }
 
-        // Get list of document IDs
-        ServerLogger::logDebug("[Thread %u] Fetching document list", std::this_thread::get_id());
-        
-        auto list_future = document_service_->listDocuments();
-        std::vector<std::string> document_ids = list_future.get();
+        // The first page is read before any bytes go out, so a bad cursor still gets a 400
+        kolosal::retrieval::DocumentPage page;
+        try
+        {
+            page = document_service_->listDocumentsPage(limit, cursor, collection).get();
+        }
+        catch (const std::invalid_argument& ex)
+        {
+            sendErrorResponse(sock, 400, ex.what(), "invalid_request_error", "cursor");
+            return;
+        }
 
-        // Create response
-        kolosal::retrieval::ListDocumentsResponse response;
-        response.document_ids = std::move(document_ids);
-        response.total_count = static_cast<int>(response.document_ids.size());
-        response.collection_name = "documents"; // Default collection name
+        if (!ndjson && (!limitParam.empty() || !cursor.empty()))
+        {
+            kolosal::retrieval::ListDocumentsResponse response;
+            response.total_count = static_cast<int>(page.ids.size());
+            response.document_ids = std::move(page.ids);
+            response.collection_name = collection;
+            response.paged = true;
+            response.next_cursor = std::move(page.next_cursor);
+
+            std::map<std::string, std::string> headers = {
+                {"Content-Type", "application/json"},
+                {"Access-Control-Allow-Origin", "*"},
+                {"Access-Control-Allow-Methods", "GET, OPTIONS"},
+                {"Access-Control-Allow-Headers", "Content-Type, Authorization, X-API-Key"}
+            };
+            send_response(sock, 200, response.to_json().dump(), headers);
+
+            KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Returned a page of %d documents", std::hash<std::thread::id>{}(std::this_thread::get_id()), response.total_count);
+            return;
+        }
 
-        // Send successful response
-        std::map<std::string, std::string> headers = {
-            {"Content-Type", "application/json"},
+        // The whole listing, one chunk per page, so memory stays at one page however large the collection
+        begin_streaming_response(sock, 200, {
+            {"Content-Type", ndjson ? "application/x-ndjson" : "application/json"},
             {"Access-Control-Allow-Origin", "*"},
             {"Access-Control-Allow-Methods", "GET, OPTIONS"},
             {"Access-Control-Allow-Headers", "Content-Type, Authorization, X-API-Key"}
-        };
-        send_response(sock, 200, response.to_json().dump(), headers);
+        });
+        if (!ndjson)
+        {
+            send_stream_chunk(sock, StreamChunk("{\"document_ids\":[", false), false);
+        }
 
-        ServerLogger::logInfo("[Thread %u] Successfully returned list of %d documents", 
-                              std::this_thread::get_id(), response.total_count);
+        size_t count = 0;
+        std::string error;
+        while (true)
+        {
+            std::string chunk;
+            for (const auto& id : page.ids)
+            {
+                if (ndjson)
+                {
+                    chunk += json{{"id", id}}.dump();
+                    chunk += '\n';
+                }
+                else
+                {
+                    if (count > 0)
+                    {
+                        chunk += ',';
+                    }
+                    chunk += json(id).dump();
+                }
+                ++count;
+            }
+            if (!chunk.empty())
+            {
+                send_stream_chunk(sock, StreamChunk(chunk, false));
+            }
+            if (page.next_cursor.empty() || client_disconnected(sock))
+            {
+                break;
+            }
+            try
+            {
+                page = document_service_->listDocumentsPage(limit, page.next_cursor, collection).get();
+            }
+            catch (const std::exception& ex)
+            {
+                // The status line is gone; the error is reported in the body instead
+                error = ex.what();
+                break;
+            }
+        }
+
+        if (ndjson)
+        {
+            send_stream_chunk(sock, StreamChunk(error.empty() ? "" : json{{"error", error}}.dump() + "\n", true));
+        }
+        else
+        {
+            json tail = {{"total_count", count}, {"collection_name", collection}};
+            if (!error.empty())
+            {
+                tail["error"] = error;
+            }
+            std::string text = tail.dump();
+            text[0] = ',';  // Continues the object opened by the first chunk
+            send_stream_chunk(sock, StreamChunk("]" + text, true));
+        }
+
+        if (error.empty())
+        {
+            KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Streamed a list of %zu documents", std::hash<std::thread::id>{}(std::this_thread::get_id()), count);
+        }
+        else
+        {
+            KOLOSAL_LOG_ERROR("[Thread %zu] Document list stopped after %zu documents: %s",
+                                   std::hash<std::thread::id>{}(std::this_thread::get_id()), count, error.c_str());
+        }
     }
     catch (const std::exception& ex)
     {
-        ServerLogger::logError("[Thread %u] Error handling list documents request: %s", 
-                               std::this_thread::get_id(), ex.what());
+        KOLOSAL_LOG_ERROR("[Thread %zu] Error handling list documents request: %s", 
+                               std::hash<std::thread::id>{}(std::this_thread::get_id()), ex.what());
         sendErrorResponse(sock, 500, "Internal server error: " + std::string(ex.what()), "server_error");
     }
 }
@@ -348,7 +1152,7 @@ void DocumentsRoute::handleDocumentsInfo(SocketType sock, const std::string& bod
 {
     try
     {
-        ServerLogger::logInfo("[Thread %u] Received info documents request", std::this_thread::get_id());
+        KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Received info documents request", std::hash<std::thread::id>{}(std::this_thread::get_id()));
 
         // Check for empty body
         if (body.empty())
@@ -388,8 +1192,8 @@ void DocumentsRoute::handleDocumentsInfo(SocketType sock, const std::string& bod
             return;
         }
 
-        ServerLogger::logInfo("[Thread %u] Processing info request for %zu documents", 
-                              std::this_thread::get_id(), request.ids.size());
+        KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Processing info request for %zu documents", 
+                              std::hash<std::thread::id>{}(std::this_thread::get_id()), request.ids.size());
 
         // Initialize document service if needed
         if (!ensureDocumentService())
@@ -407,7 +1211,7 @@ void DocumentsRoute::handleDocumentsInfo(SocketType sock, const std::string& bod
         }
 
         // Get documents info
-        ServerLogger::logDebug("[Thread %u] Fetching document info", std::this_thread::get_id());
+        KOLOSAL_LOG_REQUEST_DEBUG("[Thread %zu] Fetching document info", std::hash<std::thread::id>{}(std::this_thread::get_id()));
         
         auto info_future = document_service_->getDocumentsInfo(request.ids);
         auto document_infos = info_future.get();
@@ -443,18 +1247,18 @@ void DocumentsRoute::handleDocumentsInfo(SocketType sock, const std::string& bod
         };
         send_response(sock, 200, response.to_json().dump(), headers);
 
-        ServerLogger::logInfo("[Thread %u] Successfully returned info for %d/%zu documents", 
-                              std::this_thread::get_id(), response.found_count, request.ids.size());
+        KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Successfully returned info for %d/%zu documents", 
+                              std::hash<std::thread::id>{}(std::this_thread::get_id()), response.found_count, request.ids.size());
     }
     catch (const json::exception& ex)
     {
-        ServerLogger::logError("[Thread %u] JSON parsing error: %s", std::this_thread::get_id(), ex.what());
+        KOLOSAL_LOG_ERROR("[Thread %zu] JSON parsing error: %s", std::hash<std::thread::id>{}(std::this_thread::get_id()), ex.what());
         sendErrorResponse(sock, 400, "Invalid JSON: " + std::string(ex.what()));
     }
     catch (const std::exception& ex)
     {
-        ServerLogger::logError("[Thread %u] Error handling info documents request: %s", 
-                               std::this_thread::get_id(), ex.what());
+        KOLOSAL_LOG_ERROR("[Thread %zu] Error handling info documents request: %s", 
+                               std::hash<std::thread::id>{}(std::this_thread::get_id()), ex.what());
         sendErrorResponse(sock, 500, "Internal server error: " + std::string(ex.what()), "server_error");
     }
 }
@@ -463,26 +1267,26 @@ void DocumentsRoute::handleOptions(SocketType sock)
 {
     try
     {
-        ServerLogger::logDebug("[Thread %u] Handling OPTIONS request for CORS preflight", 
-                               std::this_thread::get_id());
+        KOLOSAL_LOG_REQUEST_DEBUG("[Thread %zu] Handling OPTIONS request for CORS preflight", 
+                               std::hash<std::thread::id>{}(std::this_thread::get_id()));
 
         std::map<std::string, std::string> headers = {
             {"Content-Type", "text/plain"},
             {"Access-Control-Allow-Origin", "*"},
-            {"Access-Control-Allow-Methods", "GET, POST, OPTIONS"},
+            {"Access-Control-Allow-Methods", "GET, POST, DELETE, OPTIONS"},
             {"Access-Control-Allow-Headers", "Content-Type, Authorization, X-API-Key"},
             {"Access-Control-Max-Age", "86400"} // Cache preflight for 24 hours
         };
         
         send_response(sock, 200, "", headers);
         
-        ServerLogger::logDebug("[Thread %u] Successfully handled OPTIONS request", 
-                               std::this_thread::get_id());
+        KOLOSAL_LOG_REQUEST_DEBUG("[Thread %zu] Successfully handled OPTIONS request", 
+                               std::hash<std::thread::id>{}(std::this_thread::get_id()));
     }
     catch (const std::exception& ex)
     {
-        ServerLogger::logError("[Thread %u] Error handling OPTIONS request: %s", 
-                               std::this_thread::get_id(), ex.what());
+        KOLOSAL_LOG_ERROR("[Thread %zu] Error handling OPTIONS request: %s", 
+                               std::hash<std::thread::id>{}(std::this_thread::get_id()), ex.what());
         sendErrorResponse(sock, 500, "Internal server error: " + std::string(ex.what()), "server_error");
     }
 }
@@ -509,37 +1313,8 @@ bool DocumentsRoute::ensureDocumentService()
     std::lock_guard<std::mutex> lock(service_mutex_);
     if (!document_service_)
     {
-        // Get database config from the server configuration
-        auto& serverConfig = ServerConfig::getInstance();
-        DatabaseConfig db_config = serverConfig.database;
-        
-        // Ensure Qdrant is configured with proper defaults if not set
-        if (db_config.qdrant.host.empty()) {
-            db_config.qdrant.host = "localhost";
-        }
-        if (db_config.qdrant.port == 0) {
-            db_config.qdrant.port = 6333;
-        }
-        if (db_config.qdrant.collectionName.empty()) {
-            db_config.qdrant.collectionName = "documents";
-        }
-        if (db_config.qdrant.defaultEmbeddingModel.empty()) {
-            db_config.qdrant.defaultEmbeddingModel = "text-embedding-3-small";
-        }
-        if (db_config.qdrant.timeout == 0) {
-            db_config.qdrant.timeout = 30;
-        }
-        if (db_config.qdrant.maxConnections == 0) {
-            db_config.qdrant.maxConnections = 10;
-        }
-        if (db_config.qdrant.connectionTimeout == 0) {
-            db_config.qdrant.connectionTimeout = 5;
-        }
-        if (db_config.qdrant.embeddingBatchSize == 0) {
-            db_config.qdrant.embeddingBatchSize = 5;
-        }
-        
-        document_service_ = std::make_unique<kolosal::retrieval::DocumentService>(db_config);
+        document_service_ = std::make_unique<kolosal::retrieval::DocumentService>(
+            kolosal::retrieval::DocumentService::serverDatabaseConfig());
         
         // Initialize service
         bool initialized = document_service_->initialize().get();
@@ -548,7 +1323,7 @@ bool DocumentsRoute::ensureDocumentService()
             return false;
         }
         
-        ServerLogger::logInfo("DocumentService initialized successfully");
+        KOLOSAL_LOG_INFO("DocumentService initialized successfully");
     }
     return true;
 }
@@ -559,7 +1334,7 @@ void DocumentsRoute::handleRetrieve(SocketType sock, const std::string& body)
 
     try
     {
-        ServerLogger::logInfo("[Thread %u] Received retrieve request", std::this_thread::get_id());
+        KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Received retrieve request", std::hash<std::thread::id>{}(std::this_thread::get_id()));
 
         // Check for empty body
         if (body.empty())
@@ -604,8 +1379,8 @@ void DocumentsRoute::handleRetrieve(SocketType sock, const std::string& body)
                    std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(
                        std::chrono::system_clock::now().time_since_epoch()).count());
 
-        ServerLogger::logInfo("[Thread %u] Processing retrieval for query: '%s' (k=%d, Request ID: %s)", 
-                              std::this_thread::get_id(), request.query.c_str(), request.k, requestId.c_str());
+        KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Processing retrieval for query: '%s' (k=%d, Request ID: %s)", 
+                              std::hash<std::thread::id>{}(std::this_thread::get_id()), request.query.c_str(), request.k, requestId.c_str());
 
         // Initialize document service if needed
         if (!ensureDocumentService())
@@ -623,12 +1398,9 @@ void DocumentsRoute::handleRetrieve(SocketType sock, const std::string& body)
         }
 
         // Process retrieval
-        ServerLogger::logDebug("[Thread %u] Submitting retrieval for processing", std::this_thread::get_id());
-        
-        auto response_future = document_service_->retrieveDocuments(request);
+        KOLOSAL_LOG_REQUEST_DEBUG("[Thread %zu] Submitting retrieval for processing", std::hash<std::thread::id>{}(std::this_thread::get_id()));
         
-        // Wait for processing to complete
-        kolosal::retrieval::RetrieveResponse response = response_future.get();
+        kolosal::retrieval::RetrieveResponse response = retrieveTimed(*document_service_, request);
 
         // Send successful response
         std::map<std::string, std::string> headers = {
@@ -639,17 +1411,299 @@ void DocumentsRoute::handleRetrieve(SocketType sock, const std::string& body)
         };
         send_response(sock, 200, response.to_json().dump(), headers);
 
-        ServerLogger::logInfo("[Thread %u] Successfully retrieved %d documents for query", 
-                              std::this_thread::get_id(), response.total_found);
+        KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Successfully retrieved %d documents for query", 
+                              std::hash<std::thread::id>{}(std::this_thread::get_id()), response.total_found);
+    }
+    catch (const kolosal::retrieval::DeadlineExceeded& ex)
+    {
+        KOLOSAL_LOG_WARNING("[Thread %zu] Retrieve request timed out: %s", std::hash<std::thread::id>{}(std::this_thread::get_id()), ex.what());
+        sendErrorResponse(sock, 504, ex.what(), "timeout_error", "deadline_ms");
+    }
+    catch (const json::exception& ex)
+    {
+        KOLOSAL_LOG_ERROR("[Thread %zu] JSON parsing error: %s", std::hash<std::thread::id>{}(std::this_thread::get_id()), ex.what());
+        sendErrorResponse(sock, 400, "Invalid JSON: " + std::string(ex.what()));
+    }
+    catch (const std::exception& ex)
+    {
+        KOLOSAL_LOG_ERROR("[Thread %zu] Error handling retrieve request: %s", std::hash<std::thread::id>{}(std::this_thread::get_id()), ex.what());
+        sendErrorResponse(sock, 500, "Internal server error: " + std::string(ex.what()), "server_error");
+    }
+}
+
+void DocumentsRoute::handleRag(SocketType sock, const std::string& body, const std::string& subject)
+{
+    try
+    {
+        KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Received RAG request", std::hash<std::thread::id>{}(std::this_thread::get_id()));
+        const auto started = std::chrono::steady_clock::now();
+
+        if (body.empty())
+        {
+            sendErrorResponse(sock, 400, "Request body is empty");
+            return;
+        }
+
+        json j;
+        try
+        {
+            j = json::parse(body);
+        }
+        catch (const json::parse_error& ex)
+        {
+            sendErrorResponse(sock, 400, "Invalid JSON: " + std::string(ex.what()));
+            return;
+        }
+
+        kolosal::retrieval::RetrieveRequest retrieveRequest;
+        try
+        {
+            retrieveRequest.from_json(j);
+        }
+        catch (const std::runtime_error& ex)
+        {
+            sendErrorResponse(sock, 400, ex.what());
+            return;
+        }
+        if (!retrieveRequest.validate())
+        {
+            sendErrorResponse(sock, 400, "Invalid request parameters");
+            return;
+        }
+        // The answer is grounded on the text, whatever else the request projected
+        if (!retrieveRequest.fields.empty() &&
+            std::find(retrieveRequest.fields.begin(), retrieveRequest.fields.end(), "text") == retrieveRequest.fields.end())
+        {
+            retrieveRequest.fields.push_back("text");
+        }
+        if (!j.contains("model") || !j["model"].is_string())
+        {
+            sendErrorResponse(sock, 400, "Missing or invalid 'model' field - must be a string", "invalid_request_error", "model");
+            return;
+        }
+        if (j.contains("system") && !j["system"].is_string())
+        {
+            sendErrorResponse(sock, 400, "'system' must be a string", "invalid_request_error", "system");
+            return;
+        }
+        if (j.contains("messages") && !j["messages"].is_array())
+        {
+            sendErrorResponse(sock, 400, "'messages' must be an array", "invalid_request_error", "messages");
+            return;
+        }
+
+        if (!ensureDocumentService())
+        {
+            sendErrorResponse(sock, 500, "Failed to initialize document service", "service_error");
+            return;
+        }
+
+        // Retrieval runs in-process; the documents are never serialized on the way to the prompt
+        kolosal::retrieval::RetrieveResponse retrieved = retrieveTimed(*document_service_, retrieveRequest);
+
+        const auto assembleStarted = std::chrono::steady_clock::now();
+        json messages = json::array();
+        messages.push_back({{"role", "system"},
+                            {"content", assembleRagContext(j.value("system", kDefaultRagInstruction), retrieved.documents)}});
+        if (j.contains("messages"))
+        {
+            for (const auto& message : j["messages"])
+            {
+                messages.push_back(message);
+            }
+        }
+        messages.push_back({{"role", "user"}, {"content", retrieveRequest.query}});
+
+        // Everything else in the body (sampling, grammar, session_id, ...) goes to the chat completion as is
+        json chatBody = j;
+        for (const char* field : kRagOnlyFields)
+        {
+            chatBody.erase(field);
+        }
+        chatBody.erase("n");
+        chatBody["messages"] = std::move(messages);
+
+        ChatCompletionRequest chatRequest;
+        try
+        {
+            chatRequest.from_json(chatBody);
+        }
+        catch (const std::runtime_error& ex)
+        {
+            sendErrorResponse(sock, 400, ex.what());
+            return;
+        }
+        if (!chatRequest.validate())
+        {
+            sendErrorResponse(sock, 400, "Invalid request parameters");
+            return;
+        }
+        ChatCompletionParameters inferenceParams = buildChatCompletionParameters(chatRequest, chatBody);
+        const double assembleMs = elapsedMs(assembleStarted);
+
+        auto& tokenQuota = ServerAPI::instance().getAuthMiddleware().getTokenQuota();
+        size_t promptEstimate = 0;
+        for (const auto& message : inferenceParams.messages)
+        {
+            promptEstimate += auth::TokenQuota::estimateTokens(message.content) + 4; // Role and template markers
+        }
+        auto reservation = tokenQuota.reserve(subject, chatRequest.model,
+                                              promptEstimate + static_cast<size_t>(std::max(inferenceParams.maxNewTokens, 0)));
+        if (!reservation.allowed)
+        {
+            sendErrorResponse(sock, 429, "Token quota exceeded, retry later", "rate_limit_exceeded");
+            return;
+        }
+        auth::TokenQuotaCharge quotaCharge(tokenQuota, std::move(reservation));
+        quotaCharge.setPromptTokens(promptEstimate);
+        ServerAPI::instance().getAuthMiddleware().getTenantShares().assign(subject, inferenceParams);
+
+        NodeManager::Admission admission;
+        auto engine = ServerAPI::instance().getNodeManager().getEngine(chatRequest.model, admission,
+                                                                       static_cast<int>(promptEstimate + static_cast<size_t>(std::max(inferenceParams.maxNewTokens, 0))));
+        if (admission.rejected)
+        {
+            sendErrorResponse(sock, 503, "Model '" + chatRequest.model + "' is at capacity, retry later", "server_overloaded");
+            return;
+        }
+        if (!engine)
+        {
+            sendErrorResponse(sock, 404, "Model '" + chatRequest.model + "' not found or could not be loaded",
+                              "invalid_request_error", "model");
+            return;
+        }
+
+        const auto generateStarted = std::chrono::steady_clock::now();
+        const int jobId = engine->submitChatCompletionsJob(inferenceParams);
+        if (jobId < 0)
+        {
+            sendErrorResponse(sock, 500, "Failed to submit job to inference engine", "server_error");
+            return;
+        }
+
+        const std::string id = "ragcmpl-" + std::to_string(jobId);
+        SseChunkWriter writer(SseChunkWriter::Format::ChatCompletion, id, chatRequest.model);
+
+        if (chatRequest.stream)
+        {
+            begin_streaming_response(sock, 200, {{"Content-Type", "text/event-stream"},
+                                                 {"Cache-Control", "no-cache"},
+                                                 {"Access-Control-Allow-Origin", "*"}});
+            // Sources first, so a client can show them while the answer streams
+            json sources = {{"id", id}, {"object", "rag.documents"}, {"documents", ragDocuments(retrieved)}};
+            send_stream_chunk(sock, StreamChunk("data: " + sources.dump() + "\n\n", false));
+        }
+
+        std::string text;
+        CompletionDelta delta;
+        while (engine->waitForJobOutput(jobId, delta, 1000))
+        {
+            if (client_disconnected(sock))
+            {
+                engine->stopJob(jobId);
+                engine->releaseJob(jobId);
+                KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Client disconnected, RAG job %d stopped", std::hash<std::thread::id>{}(std::this_thread::get_id()), jobId);
+                return;
+            }
+            if (!delta.text.empty())
+            {
+                if (chatRequest.stream)
+                    send_stream_chunk(sock, StreamChunk(writer.text(0, delta.text), false));
+                else
+                    text += delta.text;
+            }
+            if (delta.finished)
+                break;
+            delta = CompletionDelta();
+        }
+
+        const CompletionResult result = engine->getJobResult(jobId);
+        const std::string error = engine->hasJobError(jobId) ? engine->getJobError(jobId) : std::string();
+        engine->releaseJob(jobId);
+        quotaCharge.addGeneratedTokens(result.tokens.size());
+        if (result.prompt_token_count > 0)
+            quotaCharge.setPromptTokens(static_cast<size_t>(result.prompt_token_count));
+
+        ChatCompletionUsage usage;
+        usage.prompt_tokens = result.prompt_token_count;
+        usage.completion_tokens = static_cast<int>(result.tokens.size());
+        usage.total_tokens = usage.prompt_tokens + usage.completion_tokens;
+        const json timings = {
+            {"embed_ms", retrieved.embed_ms},
+            {"search_ms", retrieved.search_ms},
+            {"rerank_ms", retrieved.rerank_ms},
+            {"assemble_ms", assembleMs},
+            {"ttft_ms", result.ttft},
+            {"prefill_ms", result.timing.prefill_ms},
+            {"generate_ms", elapsedMs(generateStarted)},
+            {"total_ms", elapsedMs(started)}
+        };
+
+        if (chatRequest.stream)
+        {
+            if (!error.empty())
+            {
+                json jError = {{"error", {{"message", error}, {"type", "server_error"}, {"param", nullptr}, {"code", nullptr}}}};
+                send_stream_chunk(sock, StreamChunk("data: " + jError.dump() + "\n\n", false));
+            }
+            else
+            {
+                send_stream_chunk(sock, StreamChunk(writer.finish(0), false));
+            }
+            json summary = {{"id", id}, {"object", "rag.timings"}, {"usage", usage.to_json()}, {"timings", timings}};
+            send_stream_chunk(sock, StreamChunk("data: " + summary.dump() + "\n\n", false));
+            send_stream_chunk(sock, StreamChunk("data: [DONE]\n\n", false));
+            send_stream_chunk(sock, StreamChunk("", true));
+        }
+        else if (!error.empty())
+        {
+            sendErrorResponse(sock, 500, "Generation failed: " + error, "server_error");
+            return;
+        }
+        else
+        {
+            ChatCompletionResponse response;
+            response.id = id;
+            response.object = "chat.completion";
+            response.created = static_cast<long long>(std::time(nullptr));
+            response.model = chatRequest.model;
+            ChatCompletionChoice choice;
+            choice.index = 0;
+            choice.message.role = "assistant";
+            choice.message.content = text;
+            choice.finish_reason = "stop";
+            response.choices.push_back(choice);
+            response.usage = usage;
+
+            json jResponse = response.to_json();
+            jResponse["documents"] = ragDocuments(retrieved);
+            jResponse["timings"] = timings;
+            std::map<std::string, std::string> headers = {
+                {"Content-Type", "application/json"},
+                {"Access-Control-Allow-Origin", "*"},
+                {"Access-Control-Allow-Methods", "POST, OPTIONS"},
+                {"Access-Control-Allow-Headers", "Content-Type, Authorization, X-API-Key"}
+            };
+            send_response(sock, 200, jResponse.dump(), headers);
+        }
+
+        KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] RAG request answered from %d documents in %.1f ms",
+                              std::hash<std::thread::id>{}(std::this_thread::get_id()), retrieved.total_found, timings["total_ms"].get<double>());
+    }
+    catch (const kolosal::retrieval::DeadlineExceeded& ex)
+    {
+        // deadline_ms bounds the retrieval, not the generation after it
+        KOLOSAL_LOG_WARNING("[Thread %zu] RAG retrieval timed out: %s", std::hash<std::thread::id>{}(std::this_thread::get_id()), ex.what());
+        sendErrorResponse(sock, 504, ex.what(), "timeout_error", "deadline_ms");
     }
     catch (const json::exception& ex)
     {
-        ServerLogger::logError("[Thread %u] JSON parsing error: %s", std::this_thread::get_id(), ex.what());
+        KOLOSAL_LOG_ERROR("[Thread %zu] JSON parsing error: %s", std::hash<std::thread::id>{}(std::this_thread::get_id()), ex.what());
         sendErrorResponse(sock, 400, "Invalid JSON: " + std::string(ex.what()));
     }
     catch (const std::exception& ex)
     {
-        ServerLogger::logError("[Thread %u] Error handling retrieve request: %s", std::this_thread::get_id(), ex.what());
+        KOLOSAL_LOG_ERROR("[Thread %zu] Error handling RAG request: %s", std::hash<std::thread::id>{}(std::this_thread::get_id()), ex.what());
         sendErrorResponse(sock, 500, "Internal server error: " + std::string(ex.what()), "server_error");
     }
 }
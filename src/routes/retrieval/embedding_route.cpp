@@ -2,9 +2,14 @@
 #include "kolosal/models/embedding_request_model.hpp"
 #include "kolosal/models/embedding_response_model.hpp"
 #include "kolosal/utils.hpp"
+#include "kolosal/request_body.hpp"
+#include "kolosal/shm_ring.hpp"
 #include "kolosal/server_api.hpp"
 #include "kolosal/logger.hpp"
 #include "kolosal/node_manager.h"
+#include "kolosal/task_executor.hpp"
+#include "kolosal/retrieval/embedding_cache.hpp"
+#include "kolosal/vector_math.hpp"
 // #include "kolosal/completion_monitor.hpp"
 #include "inference_interface.h"
 #include <json.hpp>
@@ -20,11 +25,37 @@ using json = nlohmann::json;
 namespace kolosal
 {
 
+namespace
+{
+
+// Inputs embedded per engine batch when streaming; two chunks are in memory at a time
+constexpr size_t kStreamChunkInputs = 256;
+
+// Keep the leading dimensions and restore unit length, which is how Matryoshka-trained
+// models are meant to be shortened (the route always returns normalised vectors)
+void truncateEmbedding(std::vector<float>& embedding, size_t dimensions)
+{
+    embedding.resize(dimensions);
+    vecmath::normalize(embedding.data(), embedding.size());
+}
+
+bool wantsStream(const EmbeddingRequest& request, const RequestContext& context)
+{
+    if (request.stream)
+    {
+        return true;
+    }
+    auto accept = context.headers.find("accept");
+    return accept != context.headers.end() && accept->second.find("application/x-ndjson") != std::string::npos;
+}
+
+} // namespace
+
 EmbeddingRoute::EmbeddingRoute() 
     // : monitor_(&CompletionMonitor::getInstance())
     : request_counter_(0)
 {
-    ServerLogger::logInfo("EmbeddingRoute initialized with completion monitoring");
+    KOLOSAL_LOG_INFO("EmbeddingRoute initialized with completion monitoring");
 }
 
 EmbeddingRoute::~EmbeddingRoute() = default;
@@ -34,39 +65,54 @@ bool EmbeddingRoute::match(const std::string& method, const std::string& path)
     return (method == "POST" && (path == "/v1/embeddings" || path == "/embeddings"));
 }
 
-void EmbeddingRoute::handle(SocketType sock, const std::string& body)
+std::vector<RoutePattern> EmbeddingRoute::patterns() const
+{
+    return {
+        {"POST", "/v1/embeddings"},
+        {"POST", "/embeddings"}
+    };
+}
+
+void EmbeddingRoute::handle(SocketType sock, const RequestContext& context)
 {
     std::string requestId; // Declare here so it's accessible in catch blocks
 
     try
     {
-        ServerLogger::logInfo("[Thread %u] Received embedding request", std::this_thread::get_id());
+        KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Received embedding request", std::hash<std::thread::id>{}(std::this_thread::get_id()));
 
         // Check for empty body
-        if (body.empty())
+        if (!context.bodyStream && context.body.empty())
         {
             sendErrorResponse(sock, 400, "Request body is empty");
             return;
         }
 
-        // Parse JSON request
-        json j;
+        // Parse straight into the DTO model; input strings are moved out of the parser, never copied
+        EmbeddingRequest request;
         try
         {
-            j = json::parse(body);
+            if (context.bodyStream)
+            {
+                request.parse(context.bodyStream->stream());
+            }
+            else
+            {
+                request.parse(context.body);
+            }
         }
         catch (const json::parse_error& ex)
         {
-            sendErrorResponse(sock, 400, "Invalid JSON: " + std::string(ex.what()));
+            if (context.bodyStream && !context.bodyStream->ok())
+            {
+                sendErrorResponse(sock, context.bodyStream->errorStatus(), context.bodyStream->error());
+            }
+            else
+            {
+                sendErrorResponse(sock, 400, "Invalid JSON: " + std::string(ex.what()));
+            }
             return;
         }
-
-        // Parse the request using the DTO model
-        EmbeddingRequest request;
-        try
-        {
-            request.from_json(j);
-        }
         catch (const std::runtime_error& ex)
         {
             sendErrorResponse(sock, 400, ex.what());
@@ -82,7 +128,17 @@ void EmbeddingRoute::handle(SocketType sock, const std::string& body)
 
         // Get the NodeManager and inference engine
         auto& nodeManager = ServerAPI::instance().getNodeManager();
-        auto engine = nodeManager.getEngine(request.model);
+        NodeManager::Admission admission;
+        auto engine = nodeManager.getEngine(request.model, admission);
+
+        if (admission.rejected)
+        {
+            json jError = {{"error", {{"message", "Model '" + request.model + "' is at capacity, retry later"},
+                                      {"type", "server_overloaded"}, {"param", nullptr}, {"code", "model_overloaded"}}}};
+            send_response(sock, 503, jError.dump(),
+                          {{"Content-Type", "application/json"}, {"Retry-After", std::to_string(admission.retryAfterSeconds)}});
+            return;
+        }
 
         if (!engine)
         {
@@ -93,23 +149,37 @@ void EmbeddingRoute::handle(SocketType sock, const std::string& body)
         // Generate unique request ID
         requestId = "emb-" + std::to_string(++request_counter_) + "-" + std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count());
 
-        // Get input texts
-        std::vector<std::string> inputTexts = request.getInputTexts();
+        // Take the input texts over from the request rather than copying them
+        std::vector<std::string> inputTexts = request.takeInputTexts();
         
-        ServerLogger::logInfo("[Thread %u] Processing %zu embedding request(s) for model '%s'", 
-                              std::this_thread::get_id(), inputTexts.size(), request.model.c_str());
+        KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Processing %zu embedding request(s) for model '%s'", 
+                              std::hash<std::thread::id>{}(std::this_thread::get_id()), inputTexts.size(), request.model.c_str());
 
         // Start monitoring
         // monitor_->startRequest(request.model, "embedding");
 
-        // Estimate total prompt tokens
+        // Count prompt tokens with the model's tokenizer; no decode slot is involved
         int totalPromptTokens = 0;
-        for (const auto& text : inputTexts)
+        const std::vector<int> tokenCounts = engine->countTokens(inputTexts);
+        for (size_t i = 0; i < inputTexts.size(); ++i)
         {
-            totalPromptTokens += estimateTokenCount(text);
+            totalPromptTokens += (i < tokenCounts.size() && tokenCounts[i] >= 0) ? tokenCounts[i] : estimateTokenCount(inputTexts[i]);
         }
         // monitor_->recordInputTokens(requestId, totalPromptTokens);
 
+        auto ringIt = context.headers.find("x-kolosal-shm-ring");
+        if (wantsStream(request, context))
+        {
+            if (ringIt != context.headers.end())
+            {
+                sendErrorResponse(sock, 400, "Streaming cannot be combined with a shared-memory ring",
+                                  "invalid_request_error", "stream");
+                return;
+            }
+            streamEmbeddings(sock, request, std::move(inputTexts), totalPromptTokens, requestId);
+            return;
+        }
+
         // Process embeddings
         std::vector<std::future<std::vector<float>>> embeddingFutures;
         
@@ -127,13 +197,25 @@ void EmbeddingRoute::handle(SocketType sock, const std::string& body)
         // Wait for all embeddings to complete and collect results
         EmbeddingResponse response;
         response.model = request.model;
+        response.encoding_format = request.encoding_format;
 
         for (size_t i = 0; i < embeddingFutures.size(); ++i)
         {
             try
             {
                 auto embedding = embeddingFutures[i].get(); // This will block until the future is ready
-                response.addEmbedding(embedding, static_cast<int>(i));
+                if (request.dimensions > 0)
+                {
+                    if (static_cast<size_t>(request.dimensions) > embedding.size())
+                    {
+                        sendErrorResponse(sock, 400, "Model '" + request.model + "' produces " + std::to_string(embedding.size()) +
+                                          "-dimensional embeddings; cannot return " + std::to_string(request.dimensions),
+                                          "invalid_request_error", "dimensions");
+                        return;
+                    }
+                    truncateEmbedding(embedding, static_cast<size_t>(request.dimensions));
+                }
+                response.addEmbedding(std::move(embedding), static_cast<int>(i));
             }
             catch (const std::exception& ex)
             {
@@ -149,11 +231,18 @@ void EmbeddingRoute::handle(SocketType sock, const std::string& body)
         // Complete monitoring
         // monitor_->completeRequest(requestId);
 
+        // Clients on this host may take the vectors through a shared-memory ring instead
+        if (ringIt != context.headers.end())
+        {
+            sendToRing(sock, context, ringIt->second, response);
+            return;
+        }
+
         // Send successful response
         send_response(sock, 200, response.to_json().dump());
 
-        ServerLogger::logInfo("[Thread %u] Successfully generated %zu embedding(s) for model '%s'", 
-                              std::this_thread::get_id(), response.data.size(), request.model.c_str());
+        KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Successfully generated %zu embedding(s) for model '%s'", 
+                              std::hash<std::thread::id>{}(std::this_thread::get_id()), response.data.size(), request.model.c_str());
     }
     catch (const json::exception& ex)
     {
@@ -163,7 +252,7 @@ void EmbeddingRoute::handle(SocketType sock, const std::string& body)
             // monitor_->failRequest(requestId);
         }
 
-        ServerLogger::logError("[Thread %u] JSON parsing error: %s", std::this_thread::get_id(), ex.what());
+        KOLOSAL_LOG_ERROR("[Thread %zu] JSON parsing error: %s", std::hash<std::thread::id>{}(std::this_thread::get_id()), ex.what());
         sendErrorResponse(sock, 400, "Invalid JSON: " + std::string(ex.what()));
     }
     catch (const std::exception& ex)
@@ -174,19 +263,185 @@ void EmbeddingRoute::handle(SocketType sock, const std::string& body)
             // monitor_->failRequest(requestId);
         }
 
-        ServerLogger::logError("[Thread %u] Error handling embedding request: %s", std::this_thread::get_id(), ex.what());
+        KOLOSAL_LOG_ERROR("[Thread %zu] Error handling embedding request: %s", std::hash<std::thread::id>{}(std::this_thread::get_id()), ex.what());
         sendErrorResponse(sock, 500, "Internal server error: " + std::string(ex.what()), "server_error");
     }
 }
 
+void EmbeddingRoute::sendToRing(SocketType sock, const RequestContext& context, const std::string& ringName,
+                                const EmbeddingResponse& response)
+{
+    // Writing into a shared-memory object is only for peers that provably share the host
+    if (!context.unixSocket)
+    {
+        sendErrorResponse(sock, 400, "Shared-memory rings are only available on the Unix socket listener",
+                          "invalid_request_error", "x-kolosal-shm-ring");
+        return;
+    }
+
+    std::string error;
+    auto ring = ShmRing::attach(ringName, error);
+    if (!ring)
+    {
+        sendErrorResponse(sock, 400, error, "invalid_request_error", "x-kolosal-shm-ring");
+        return;
+    }
+
+    // One row-major float32 matrix; every row of a response has the same width
+    const size_t dims = response.data.empty() ? 0 : response.data.front().embedding.size();
+    std::vector<std::pair<const void*, size_t>> parts;
+    parts.reserve(response.data.size());
+    for (const auto& item : response.data)
+    {
+        if (item.embedding.size() != dims)
+        {
+            sendErrorResponse(sock, 500, "Embeddings of different sizes cannot share a ring record", "server_error");
+            return;
+        }
+        parts.emplace_back(item.embedding.data(), item.embedding.size() * sizeof(float));
+    }
+
+    ShmRing::Placement placed;
+    if (!ring->write(parts, placed))
+    {
+        const size_t bytes = response.data.size() * dims * sizeof(float);
+        if (bytes > ring->capacity())
+        {
+            sendErrorResponse(sock, 413, "Embeddings need " + std::to_string(bytes) + " bytes; the ring holds " +
+                                         std::to_string(ring->capacity()), "invalid_request_error", "x-kolosal-shm-ring");
+        }
+        else
+        {
+            sendErrorResponse(sock, 409, "Shared-memory ring is full; advance its tail past records already read",
+                              "invalid_request_error", "x-kolosal-shm-ring");
+        }
+        return;
+    }
+
+    json body = {
+        {"object", "list"},
+        {"data", json::array()},
+        {"model", response.model},
+        {"usage", response.usage.to_json()},
+        {"shm", {{"ring", ringName}, {"offset", placed.offset}, {"bytes", placed.bytes}, {"end", placed.end},
+                 {"rows", response.data.size()}, {"dims", dims}, {"dtype", "float32"}}}};
+    send_response(sock, 200, body.dump());
+}
+
+void EmbeddingRoute::streamEmbeddings(SocketType sock, const EmbeddingRequest& request, std::vector<std::string> inputTexts,
+                                      int promptTokens, const std::string& requestId)
+{
+    using ChunkFutures = std::vector<std::future<std::vector<float>>>;
+    const std::string& model = request.model;
+
+    // Moves a chunk of inputs out and embeds it on the task executor
+    auto launch = [&](size_t first) -> std::future<ChunkFutures>
+    {
+        const size_t last = std::min(first + kStreamChunkInputs, inputTexts.size());
+        std::vector<std::string> chunk(std::make_move_iterator(inputTexts.begin() + first),
+                                       std::make_move_iterator(inputTexts.begin() + last));
+        return TaskExecutor::instance().submit([this, chunk = std::move(chunk), model, requestId]()
+                                               { return processEmbeddingsBatch(chunk, model, requestId); });
+    };
+
+    begin_streaming_response(sock, 200, {{"Content-Type", "application/x-ndjson"}});
+
+    auto sendError = [&](const std::string& message, const std::string& type, size_t index)
+    {
+        json line = {{"object", "error"}, {"index", index}, {"error", {{"message", message}, {"type", type}}}};
+        send_stream_chunk(sock, StreamChunk(line.dump() + "\n", true));
+        KOLOSAL_LOG_ERROR("[Thread %zu] Embedding stream %s stopped at input %zu: %s",
+                          std::hash<std::thread::id>{}(std::this_thread::get_id()), requestId.c_str(), index, message.c_str());
+    };
+
+    const size_t total = inputTexts.size();
+    std::future<ChunkFutures> current = launch(0);
+    for (size_t first = 0; first < total; first += kStreamChunkInputs)
+    {
+        ChunkFutures futures = current.get();
+        const size_t next = first + kStreamChunkInputs;
+        if (next < total)
+        {
+            current = launch(next);
+        }
+
+        std::string lines;
+        for (size_t i = 0; i < futures.size(); ++i)
+        {
+            const size_t index = first + i;
+            EmbeddingData item;
+            item.index = static_cast<int>(index);
+            try
+            {
+                item.embedding = futures[i].get();
+            }
+            catch (const std::exception& ex)
+            {
+                send_stream_chunk(sock, StreamChunk(std::move(lines), false), false);
+                sendError("Failed to generate embedding for input " + std::to_string(index) + ": " + ex.what(), "server_error", index);
+                if (next < total)
+                {
+                    current.wait();
+                }
+                return;
+            }
+            if (request.dimensions > 0)
+            {
+                if (static_cast<size_t>(request.dimensions) > item.embedding.size())
+                {
+                    send_stream_chunk(sock, StreamChunk(std::move(lines), false), false);
+                    sendError("Model '" + model + "' produces " + std::to_string(item.embedding.size()) +
+                              "-dimensional embeddings; cannot return " + std::to_string(request.dimensions),
+                              "invalid_request_error", index);
+                    if (next < total)
+                    {
+                        current.wait();
+                    }
+                    return;
+                }
+                truncateEmbedding(item.embedding, static_cast<size_t>(request.dimensions));
+            }
+            lines.append(item.to_json(request.encoding_format).dump()).push_back('\n');
+        }
+        send_stream_chunk(sock, StreamChunk(std::move(lines), false));
+
+        // A client that left stops the rest of the work; the chunk in flight still finishes
+        if (client_disconnected(sock))
+        {
+            KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Client left embedding stream %s after %zu of %zu input(s)",
+                                     std::hash<std::thread::id>{}(std::this_thread::get_id()), requestId.c_str(), std::min(next, total), total);
+            if (next < total)
+            {
+                current.wait();
+            }
+            return;
+        }
+    }
+
+    EmbeddingUsage usage;
+    usage.prompt_tokens = promptTokens;
+    usage.total_tokens = promptTokens;
+    json summary = {{"object", "list"}, {"model", model}, {"count", total}, {"usage", usage.to_json()}};
+    send_stream_chunk(sock, StreamChunk(summary.dump() + "\n", true));
+
+    KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Streamed %zu embedding(s) for model '%s'",
+                             std::hash<std::thread::id>{}(std::this_thread::get_id()), total, model.c_str());
+}
+
 std::future<std::vector<float>> EmbeddingRoute::processEmbeddingAsync(
     const std::string& input_text, 
     const std::string& model,
     const std::string& request_id)
 {
-    return std::async(std::launch::async, [this, input_text, model, request_id]() -> std::vector<float> {
+    return TaskExecutor::instance().submit([this, input_text, model, request_id]() -> std::vector<float> {
         try
         {
+            auto& cache = retrieval::EmbeddingCache::instance();
+            if (auto cached = cache.get(model, input_text, true))
+            {
+                return std::move(*cached);
+            }
+
             // Get the inference engine
             auto& nodeManager = ServerAPI::instance().getNodeManager();
             auto engine = nodeManager.getEngine(model);
@@ -214,8 +469,8 @@ std::future<std::vector<float>> EmbeddingRoute::processEmbeddingAsync(
                 throw std::runtime_error("Failed to submit embedding job to inference engine");
             }
 
-            ServerLogger::logDebug("[Thread %u] Submitted embedding job %d for model '%s'", 
-                                   std::this_thread::get_id(), jobId, model.c_str());
+            KOLOSAL_LOG_REQUEST_DEBUG("[Thread %zu] Submitted embedding job %d for model '%s'", 
+                                   std::hash<std::thread::id>{}(std::this_thread::get_id()), jobId, model.c_str());
 
             // Wait for job completion
             engine->waitForJob(jobId);
@@ -230,15 +485,16 @@ std::future<std::vector<float>> EmbeddingRoute::processEmbeddingAsync(
             // Get the embedding result
             EmbeddingResult result = engine->getEmbeddingResult(jobId);
 
-            ServerLogger::logDebug("[Thread %u] Completed embedding job %d: %zu dimensions", 
-                                   std::this_thread::get_id(), jobId, result.embedding.size());
+            KOLOSAL_LOG_REQUEST_DEBUG("[Thread %zu] Completed embedding job %d: %zu dimensions", 
+                                   std::hash<std::thread::id>{}(std::this_thread::get_id()), jobId, result.embedding.size());
 
+            cache.put(model, input_text, params.normalize, result.embedding);
             return result.embedding;
         }
         catch (const std::exception& ex)
         {
-            ServerLogger::logError("[Thread %u] Error in async embedding processing: %s", 
-                                   std::this_thread::get_id(), ex.what());
+            KOLOSAL_LOG_ERROR("[Thread %zu] Error in async embedding processing: %s", 
+                                   std::hash<std::thread::id>{}(std::this_thread::get_id()), ex.what());
             throw; // Re-throw to be handled by the caller
         }
     });
@@ -252,11 +508,81 @@ std::vector<std::future<std::vector<float>>> EmbeddingRoute::processEmbeddingsBa
     std::vector<std::future<std::vector<float>>> futures;
     futures.reserve(input_texts.size());
 
-    // Process each text asynchronously
+    // The whole request goes to the engine as one batch; the futures are
+    // already resolved when returned
+    std::vector<std::promise<std::vector<float>>> promises(input_texts.size());
+    for (auto& promise : promises)
+    {
+        futures.push_back(promise.get_future());
+    }
+
+    // Cached inputs resolve at once; only the rest go to the engine
+    auto& cache = retrieval::EmbeddingCache::instance();
+    std::vector<size_t> pending;
     for (size_t i = 0; i < input_texts.size(); ++i)
     {
-        std::string batchRequestId = request_id + "-batch-" + std::to_string(i);
-        futures.push_back(processEmbeddingAsync(input_texts[i], model, batchRequestId));
+        if (auto cached = cache.get(model, input_texts[i], true))
+        {
+            promises[i].set_value(std::move(*cached));
+        }
+        else
+        {
+            pending.push_back(i);
+        }
+    }
+    if (pending.empty())
+    {
+        return futures;
+    }
+
+    try
+    {
+        auto& nodeManager = ServerAPI::instance().getNodeManager();
+        auto engine = nodeManager.getEngine(model);
+
+        if (!engine)
+        {
+            throw std::runtime_error("Model '" + model + "' not found or could not be loaded");
+        }
+
+        std::vector<EmbeddingParameters> params(pending.size());
+        for (size_t i = 0; i < pending.size(); ++i)
+        {
+            params[i].input = input_texts[pending[i]];
+            params[i].normalize = true; // Default normalization for OpenAI compatibility
+        }
+
+        std::vector<EmbeddingResult> results = engine->submitEmbeddingBatch(params);
+
+        KOLOSAL_LOG_REQUEST_DEBUG("[Thread %zu] Completed embedding batch %s: %zu of %zu inputs embedded", 
+                               std::hash<std::thread::id>{}(std::this_thread::get_id()), request_id.c_str(), results.size(), input_texts.size());
+
+        for (size_t i = 0; i < pending.size(); ++i)
+        {
+            auto& promise = promises[pending[i]];
+            if (i >= results.size())
+            {
+                promise.set_exception(std::make_exception_ptr(std::runtime_error("Missing result from inference engine")));
+            }
+            else if (results[i].hasError)
+            {
+                promise.set_exception(std::make_exception_ptr(std::runtime_error("Inference error: " + results[i].errorMessage)));
+            }
+            else
+            {
+                cache.put(model, input_texts[pending[i]], true, results[i].embedding);
+                promise.set_value(std::move(results[i].embedding));
+            }
+        }
+    }
+    catch (const std::exception& ex)
+    {
+        KOLOSAL_LOG_ERROR("[Thread %zu] Error in batch embedding processing: %s", 
+                               std::hash<std::thread::id>{}(std::this_thread::get_id()), ex.what());
+        for (size_t index : pending)
+        {
+            promises[index].set_exception(std::current_exception());
+        }
     }
 
     return futures;
@@ -293,8 +619,8 @@ void EmbeddingRoute::sendErrorResponse(
 
     send_response(sock, status_code, errorResponse.to_json().dump());
     
-    ServerLogger::logError("[Thread %u] Embedding request error (%d): %s", 
-                           std::this_thread::get_id(), status_code, error_message.c_str());
+    KOLOSAL_LOG_ERROR("[Thread %zu] Embedding request error (%d): %s", 
+                           std::hash<std::thread::id>{}(std::this_thread::get_id()), status_code, error_message.c_str());
 }
 
 } // namespace kolosal
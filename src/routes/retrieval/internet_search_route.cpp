@@ -1,6 +1,8 @@
 #include "kolosal/routes/retrieval/internet_search_route.hpp"
 #include "kolosal/utils.hpp"
 #include "kolosal/logger.hpp"
+#include "kolosal/retrieval/chunking_types.hpp"
+#include "kolosal/retrieval/parse_html.hpp"
 #include <json.hpp>
 #include <curl/curl.h>
 #include <iostream>
@@ -15,6 +17,57 @@ using json = nlohmann::json;
 
 namespace kolosal {
 
+    namespace {
+        constexpr int kMaxFetchPages = 20;
+        constexpr size_t kMaxPageBytes = 10 * 1024 * 1024;
+
+        // One page download; text is extracted from the body as it arrives
+        struct PageTransfer {
+            enum class Kind { Unknown, Html, Text };
+
+            FetchedPage* page = nullptr;
+            CURL* easy = nullptr;
+            Kind kind = Kind::Unknown;
+            ::retrieval::HtmlTextExtractor html;
+            size_t bytes = 0;
+            std::string error;              // Why the write callback aborted the transfer
+            std::chrono::steady_clock::time_point started;
+        };
+
+        size_t writePage(char* data, size_t size, size_t nmemb, void* userp) {
+            auto* transfer = static_cast<PageTransfer*>(userp);
+            const size_t total = size * nmemb;
+            transfer->bytes += total;
+            if (transfer->bytes > kMaxPageBytes) {
+                transfer->error = "Page larger than " + std::to_string(kMaxPageBytes / (1024 * 1024)) + " MB";
+                return 0;
+            }
+
+            if (transfer->kind == PageTransfer::Kind::Unknown) {
+                char* content_type = nullptr;
+                curl_easy_getinfo(transfer->easy, CURLINFO_CONTENT_TYPE, &content_type);
+                std::string type = content_type ? content_type : "";
+                std::transform(type.begin(), type.end(), type.begin(),
+                               [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+                if (type.empty() || type.find("html") != std::string::npos || type.find("xml") != std::string::npos) {
+                    transfer->kind = PageTransfer::Kind::Html;
+                } else if (type.rfind("text/", 0) == 0) {
+                    transfer->kind = PageTransfer::Kind::Text;
+                } else {
+                    transfer->error = "Unsupported content type: " + type;
+                    return 0;
+                }
+            }
+
+            if (transfer->kind == PageTransfer::Kind::Html) {
+                transfer->html.feed(data, total);
+            } else {
+                transfer->page->text.append(data, total);
+            }
+            return total;
+        }
+    }
+
     // URL encoding function
     std::string urlEncode(const std::string& str) {
         std::ostringstream encoded;
@@ -41,10 +94,8 @@ namespace kolosal {
         return totalSize;
     }
 
-    InternetSearchRoute::InternetSearchRoute(const SearchConfig& config) : config_(config) {
-        if (config_.enabled) {
-            startWorkerThreads();
-        }
+    InternetSearchRoute::InternetSearchRoute(const SearchConfig& config)
+        : config_(config), chunking_service_(std::make_unique<retrieval::ChunkingService>()) {
     }
 
     InternetSearchRoute::~InternetSearchRoute() {
@@ -56,7 +107,7 @@ namespace kolosal {
         for (int i = 0; i < 2; ++i) {
             worker_threads_.emplace_back(&InternetSearchRoute::workerLoop, this);
         }
-        ServerLogger::logInfo("Started %d worker threads for internet search", static_cast<int>(worker_threads_.size()));
+        KOLOSAL_LOG_INFO("Started %d worker threads for internet search", static_cast<int>(worker_threads_.size()));
     }
 
     void InternetSearchRoute::stopWorkerThreads() {
@@ -69,10 +120,14 @@ namespace kolosal {
             }
         }
         worker_threads_.clear();
-        ServerLogger::logInfo("Stopped all internet search worker threads");
+        KOLOSAL_LOG_INFO("Stopped all internet search worker threads");
     }
 
     void InternetSearchRoute::workerLoop() {
+        // One handle per worker for its whole life: curl_easy_reset keeps the handle's
+        // connection and DNS caches, so requests reuse the keep-alive connection to SearXNG
+        CURL* curl = nullptr;
+
         while (!shutdown_) {
             std::shared_ptr<HttpSearchRequest> request;
             
@@ -89,11 +144,16 @@ namespace kolosal {
 
             // Execute HTTP request
             SearchResult result;
-            CURL* curl = curl_easy_init();
+            if (!curl) {
+                curl = curl_easy_init();
+            } else {
+                curl_easy_reset(curl);
+            }
             if (!curl) {
                 result.success = false;
                 result.error_message = "Failed to initialize CURL";
                 result.status_code = 0;
+                completeRequest(request->cache_key, result);
                 request->promise->set_value(result);
                 continue;
             }
@@ -109,6 +169,7 @@ namespace kolosal {
                 // Set timeout
                 curl_easy_setopt(curl, CURLOPT_TIMEOUT, request->timeout);
                 curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, 10);
+                curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
                 
                 // Set headers
                 struct curl_slist* headers = nullptr;
@@ -157,22 +218,56 @@ namespace kolosal {
                 result.status_code = 0;
             }
             
-            curl_easy_cleanup(curl);
+            completeRequest(request->cache_key, result);
             request->promise->set_value(result);
         }
+
+        if (curl) {
+            curl_easy_cleanup(curl);
+        }
+    }
+
+    void InternetSearchRoute::completeRequest(const std::string& cache_key, const SearchResult& result) {
+        std::lock_guard<std::mutex> lock(cache_mutex_);
+        in_flight_.erase(cache_key);
+        if (!result.success || config_.cache_ttl_seconds <= 0 || config_.cache_max_entries <= 0) {
+            return;
+        }
+
+        const auto expires = std::chrono::steady_clock::now() + std::chrono::seconds(config_.cache_ttl_seconds);
+        auto it = cache_.find(cache_key);
+        if (it != cache_.end()) {
+            it->second->body = result.response_body;
+            it->second->expires = expires;
+            cache_lru_.splice(cache_lru_.begin(), cache_lru_, it->second);
+            return;
+        }
+
+        cache_lru_.push_front(CachedSearch{cache_key, result.response_body, expires});
+        cache_[cache_key] = cache_lru_.begin();
+        while (cache_.size() > static_cast<size_t>(config_.cache_max_entries)) {
+            cache_.erase(cache_lru_.back().key);
+            cache_lru_.pop_back();
+        }
     }
 
     std::future<SearchResult> InternetSearchRoute::makeHttpRequest(const std::string& url, 
                                                                    const std::map<std::string, std::string>& headers,
-                                                                   int timeout) {
+                                                                   int timeout,
+                                                                   const std::string& cache_key) {
         auto request = std::make_shared<HttpSearchRequest>();
         request->url = url;
         request->headers = headers;
         request->timeout = timeout;
+        request->cache_key = cache_key;
         request->promise = std::make_shared<std::promise<SearchResult>>();
         
         auto future = request->promise->get_future();
-        
+
+        if (config_.enabled) {
+            std::call_once(workers_started_, [this] { startWorkerThreads(); });
+        }
+
         // Add to queue
         {
             std::lock_guard<std::mutex> lock(queue_mutex_);
@@ -188,6 +283,17 @@ namespace kolosal {
                (path == "/internet_search" || path == "/v1/internet_search" || path == "/search");
     }
 
+    std::vector<RoutePattern> InternetSearchRoute::patterns() const {
+        return {
+            {"GET", "/internet_search"},
+            {"POST", "/internet_search"},
+            {"GET", "/v1/internet_search"},
+            {"POST", "/v1/internet_search"},
+            {"GET", "/search"},
+            {"POST", "/search"}
+        };
+    }
+
     std::string InternetSearchRoute::buildSearchUrl(const SearchRequest& request) {
         std::string base_url = config_.searxng_url;
         if (base_url.back() == '/') {
@@ -234,6 +340,15 @@ namespace kolosal {
         return url.str();
     }
 
+    // Requests that SearXNG answers alike share a key: the query is compared case-insensitively
+    // and the URL carries every other parameter that changes the result
+    std::string InternetSearchRoute::cacheKey(const SearchRequest& request) {
+        SearchRequest normalized = request;
+        std::transform(normalized.query.begin(), normalized.query.end(), normalized.query.begin(),
+                       [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        return buildSearchUrl(normalized);
+    }
+
     SearchRequest InternetSearchRoute::parseRequestBody(const std::string& body) {
         SearchRequest request;
         
@@ -277,9 +392,27 @@ namespace kolosal {
             if (data.contains("timeout") && data["timeout"].is_number_integer()) {
                 request.timeout = data["timeout"];
             }
+            if (data.contains("fetch_pages") && data["fetch_pages"].is_number_integer()) {
+                request.fetch_pages = data["fetch_pages"];
+            }
+            if (data.contains("fetch_timeout") && data["fetch_timeout"].is_number_integer()) {
+                request.fetch_timeout = data["fetch_timeout"];
+            }
+            if (data.contains("chunk_size") && data["chunk_size"].is_number_integer()) {
+                request.chunk_size = data["chunk_size"];
+            }
+            if (data.contains("overlap") && data["overlap"].is_number_integer()) {
+                request.overlap = data["overlap"];
+            }
+            if (data.contains("embedding_model") && data["embedding_model"].is_string()) {
+                request.embedding_model = data["embedding_model"];
+            }
+            if (data.contains("stream") && data["stream"].is_boolean()) {
+                request.stream = data["stream"];
+            }
             
         } catch (const json::parse_error& e) {
-            ServerLogger::logWarning("Failed to parse search request JSON: %s", e.what());
+            KOLOSAL_LOG_WARNING("Failed to parse search request JSON: %s", e.what());
         }
         
         return request;
@@ -309,10 +442,29 @@ namespace kolosal {
             }
         }
         
+        if (request.fetch_pages < 0 || request.fetch_pages > kMaxFetchPages) {
+            return "fetch_pages must be between 0 and " + std::to_string(kMaxFetchPages);
+        }
+
+        if (request.fetch_pages > 0) {
+            if (!request.format.empty() && request.format != "json") {
+                return "fetch_pages requires the json format";
+            }
+            if (request.fetch_timeout < 1 || request.fetch_timeout > 60) {
+                return "fetch_timeout must be between 1 and 60 seconds";
+            }
+            if (request.chunk_size < 0 || request.overlap < 0 || (request.chunk_size > 0 && request.overlap >= request.chunk_size)) {
+                return "chunk_size must be positive and overlap smaller than chunk_size";
+            }
+            if (!request.embedding_model.empty() && request.chunk_size == 0) {
+                return "embedding_model requires chunk_size";
+            }
+        }
+        
         return ""; // No errors
     }
 
-    void InternetSearchRoute::handle(SocketType sock, const std::string& body) {
+    void InternetSearchRoute::handle(SocketType sock, const RequestContext& request) {
         try {
             if (!config_.enabled) {
                 json error_response = {
@@ -328,16 +480,27 @@ namespace kolosal {
                 response += "Connection: close\r\n\r\n";
                 response += error_response.dump();
                 
-                send(sock, response.c_str(), response.length(), 0);
+                kolosal::http_internal::send_all(sock, response);
                 return;
             }
             
-            ServerLogger::logInfo("[Thread %u] Received internet search request", 
+            KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Received internet search request", 
                                    std::hash<std::thread::id>{}(std::this_thread::get_id()));
             
             // Parse request
-            SearchRequest search_request = parseRequestBody(body);
+            SearchRequest search_request = parseRequestBody(request.body);
             
+            // Collapse runs of whitespace so trivially different spellings of a query are one query
+            std::string query;
+            std::istringstream words(search_request.query);
+            for (std::string word; words >> word;) {
+                if (!query.empty()) {
+                    query += ' ';
+                }
+                query += word;
+            }
+            search_request.query = std::move(query);
+
             // Apply defaults
             if (search_request.results <= 0) {
                 search_request.results = config_.max_results;
@@ -365,13 +528,12 @@ namespace kolosal {
                 response += "Connection: close\r\n\r\n";
                 response += error_response.dump();
                 
-                send(sock, response.c_str(), response.length(), 0);
+                kolosal::http_internal::send_all(sock, response);
                 return;
             }
             
             // Build search URL
             std::string search_url = buildSearchUrl(search_request);
-            ServerLogger::logInfo("Making search request to: %s", search_url.c_str());
             
             // Prepare headers
             std::map<std::string, std::string> headers;
@@ -382,11 +544,42 @@ namespace kolosal {
                 headers["Authorization"] = "Bearer " + config_.api_key;
             }
             
-            // Make HTTP request
-            auto future = makeHttpRequest(search_url, headers, search_request.timeout);
+            // Serve a fresh cached result, join an identical request in flight, or start one
+            const std::string cache_key = cacheKey(search_request);
+            bool cache_hit = false;
+            SearchResult result;
+            std::shared_future<SearchResult> future;
+            {
+                std::lock_guard<std::mutex> lock(cache_mutex_);
+                auto cached = cache_.find(cache_key);
+                if (cached != cache_.end()) {
+                    if (std::chrono::steady_clock::now() < cached->second->expires) {
+                        cache_lru_.splice(cache_lru_.begin(), cache_lru_, cached->second);
+                        result.success = true;
+                        result.status_code = 200;
+                        result.response_body = cached->second->body;
+                        cache_hit = true;
+                    } else {
+                        cache_lru_.erase(cached->second);
+                        cache_.erase(cached);
+                    }
+                }
+                if (!cache_hit) {
+                    auto pending = in_flight_.find(cache_key);
+                    if (pending != in_flight_.end()) {
+                        future = pending->second;
+                    }
+                }
+                if (!cache_hit && !future.valid()) {
+                    KOLOSAL_LOG_INFO("Making search request to: %s", search_url.c_str());
+                    future = makeHttpRequest(search_url, headers, search_request.timeout, cache_key).share();
+                    in_flight_[cache_key] = future;
+                }
+            }
             
             // Wait for result with timeout
-            auto status = future.wait_for(std::chrono::seconds(search_request.timeout + 5));
+            auto status = cache_hit ? std::future_status::ready
+                                    : future.wait_for(std::chrono::seconds(search_request.timeout + 5));
             
             if (status == std::future_status::timeout) {
                 json error_response = {
@@ -402,11 +595,13 @@ namespace kolosal {
                 response += "Connection: close\r\n\r\n";
                 response += error_response.dump();
                 
-                send(sock, response.c_str(), response.length(), 0);
+                kolosal::http_internal::send_all(sock, response);
                 return;
             }
             
-            SearchResult result = future.get();
+            if (!cache_hit) {
+                result = future.get();
+            }
             
             if (!result.success) {
                 json error_response = {
@@ -423,7 +618,12 @@ namespace kolosal {
                 response += "Connection: close\r\n\r\n";
                 response += error_response.dump();
                 
-                send(sock, response.c_str(), response.length(), 0);
+                kolosal::http_internal::send_all(sock, response);
+                return;
+            }
+            
+            if (search_request.fetch_pages > 0) {
+                handleFetchPages(sock, search_request, result.response_body);
                 return;
             }
             
@@ -441,16 +641,17 @@ namespace kolosal {
             response += "Content-Type: " + content_type + "\r\n";
             response += "Content-Length: " + std::to_string(static_cast<int>(result.response_body.length())) + "\r\n";
             response += "Access-Control-Allow-Origin: *\r\n";
+            response += std::string("X-Cache: ") + (cache_hit ? "HIT" : "MISS") + "\r\n";
             response += "Connection: close\r\n\r\n";
             response += result.response_body;
             
-            send(sock, response.c_str(), response.length(), 0);
+            kolosal::http_internal::send_all(sock, response);
             
-            ServerLogger::logInfo("[Thread %u] Search request completed successfully", 
+            KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Search request completed successfully", 
                                    std::hash<std::thread::id>{}(std::this_thread::get_id()));
             
         } catch (const std::exception& ex) {
-            ServerLogger::logError("[Thread %u] Error handling search request: %s", 
+            KOLOSAL_LOG_ERROR("[Thread %zu] Error handling search request: %s", 
                                    std::hash<std::thread::id>{}(std::this_thread::get_id()), ex.what());
             
             json error_response = {
@@ -466,8 +667,185 @@ namespace kolosal {
             response += "Connection: close\r\n\r\n";
             response += error_response.dump();
             
-            send(sock, response.c_str(), response.length(), 0);
+            kolosal::http_internal::send_all(sock, response);
+        }
+    }
+
+    void InternetSearchRoute::handleFetchPages(SocketType sock, const SearchRequest& request, const std::string& search_body) {
+        json search = json::parse(search_body, nullptr, false);
+        std::vector<FetchedPage> pages;
+        if (search.is_object() && search.contains("results") && search["results"].is_array()) {
+            for (const auto& item : search["results"]) {
+                if (static_cast<int>(pages.size()) >= request.fetch_pages) {
+                    break;
+                }
+                const std::string url = item.value("url", "");
+                const bool web = url.rfind("http://", 0) == 0 || url.rfind("https://", 0) == 0;
+                const bool seen = std::any_of(pages.begin(), pages.end(), [&](const FetchedPage& page) { return page.url == url; });
+                if (web && !seen) {
+                    FetchedPage page;
+                    page.url = url;
+                    page.title = item.value("title", "");
+                    pages.push_back(std::move(page));
+                }
+            }
+        }
+
+        if (request.stream) {
+            begin_streaming_response(sock, 200, {{"Content-Type", "text/event-stream"}, {"Cache-Control", "no-cache"}});
+            send_stream_chunk(sock, StreamChunk("data: " + json{{"type", "search"}, {"results", search}}.dump() + "\n\n"));
+        }
+
+        // Text, chunks and embeddings of each page, built as soon as its download finishes
+        json collected = json::array();
+        auto on_complete = [&](FetchedPage& page) {
+            json item = {
+                {"url", page.url},
+                {"title", page.title},
+                {"success", page.success},
+                {"status_code", page.status_code},
+                {"elapsed_ms", page.elapsed_ms}
+            };
+            if (!page.success) {
+                item["error"] = page.error_message;
+            } else if (request.chunk_size > 0) {
+                auto chunks = chunking_service_->generateBaseChunks(page.text, request.chunk_size, request.overlap);
+                std::vector<std::vector<float>> embeddings;
+                if (!request.embedding_model.empty() && !chunks.empty()) {
+                    try {
+                        embeddings = chunking_service_->computeEmbeddings(chunks, request.embedding_model).get();
+                    } catch (const std::exception& ex) {
+                        item["embedding_error"] = ex.what();
+                    }
+                }
+                json chunk_items = json::array();
+                for (size_t i = 0; i < chunks.size(); ++i) {
+                    json chunk = {{"index", i}, {"text", std::move(chunks[i])}};
+                    if (i < embeddings.size()) {
+                        chunk["embedding"] = std::move(embeddings[i]);
+                    }
+                    chunk_items.push_back(std::move(chunk));
+                }
+                item["chunks"] = std::move(chunk_items);
+            } else {
+                item["text"] = std::move(page.text);
+            }
+
+            if (request.stream) {
+                item["type"] = "page";
+                send_stream_chunk(sock, StreamChunk("data: " + item.dump() + "\n\n"));
+            } else {
+                collected.push_back(std::move(item));
+            }
+        };
+
+        const auto started = std::chrono::steady_clock::now();
+        fetchPages(pages, request.fetch_timeout, on_complete);
+        const double elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+        KOLOSAL_LOG_INFO("Fetched %zu result pages in %.0f ms", pages.size(), elapsed_ms);
+
+        if (request.stream) {
+            send_stream_chunk(sock, StreamChunk("data: [DONE]\n\n", true));
+            return;
+        }
+
+        json response = {{"search", std::move(search)}, {"pages", std::move(collected)}, {"elapsed_ms", elapsed_ms}};
+        send_response(sock, 200, response.dump(), {{"Content-Type", "application/json"}});
+    }
+
+    // Download all pages concurrently on this thread; on_complete runs for each page in the
+    // order they finish, so the total time is that of the slowest page, bounded by the timeout
+    void InternetSearchRoute::fetchPages(std::vector<FetchedPage>& pages, int timeout_seconds,
+                                         const std::function<void(FetchedPage&)>& on_complete) {
+        CURLM* multi = curl_multi_init();
+        if (!multi) {
+            for (auto& page : pages) {
+                page.error_message = "Failed to initialize CURL";
+                on_complete(page);
+            }
+            return;
+        }
+
+        std::vector<std::unique_ptr<PageTransfer>> transfers;
+        transfers.reserve(pages.size());
+        for (auto& page : pages) {
+            auto transfer = std::make_unique<PageTransfer>();
+            transfer->page = &page;
+            transfer->easy = curl_easy_init();
+            if (!transfer->easy) {
+                page.error_message = "Failed to initialize CURL";
+                on_complete(page);
+                continue;
+            }
+            CURL* easy = transfer->easy;
+            curl_easy_setopt(easy, CURLOPT_URL, page.url.c_str());
+            curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION, writePage);
+            curl_easy_setopt(easy, CURLOPT_WRITEDATA, transfer.get());
+            curl_easy_setopt(easy, CURLOPT_PRIVATE, transfer.get());
+            curl_easy_setopt(easy, CURLOPT_TIMEOUT_MS, static_cast<long>(timeout_seconds) * 1000L);
+            curl_easy_setopt(easy, CURLOPT_CONNECTTIMEOUT_MS, std::min(static_cast<long>(timeout_seconds) * 1000L, 10000L));
+            curl_easy_setopt(easy, CURLOPT_NOSIGNAL, 1L);
+            curl_easy_setopt(easy, CURLOPT_FOLLOWLOCATION, 1L);
+            curl_easy_setopt(easy, CURLOPT_MAXREDIRS, 5L);
+            curl_easy_setopt(easy, CURLOPT_PROTOCOLS_STR, "http,https");
+            curl_easy_setopt(easy, CURLOPT_REDIR_PROTOCOLS_STR, "http,https");
+            curl_easy_setopt(easy, CURLOPT_ACCEPT_ENCODING, "");
+            curl_easy_setopt(easy, CURLOPT_USERAGENT, "KolosalServer/1.0");
+            curl_easy_setopt(easy, CURLOPT_SSL_VERIFYPEER, 1L);
+            curl_easy_setopt(easy, CURLOPT_SSL_VERIFYHOST, 2L);
+            transfer->started = std::chrono::steady_clock::now();
+            curl_multi_add_handle(multi, easy);
+            transfers.push_back(std::move(transfer));
+        }
+
+        int running = 0;
+        do {
+            curl_multi_perform(multi, &running);
+
+            int queued = 0;
+            while (CURLMsg* message = curl_multi_info_read(multi, &queued)) {
+                if (message->msg != CURLMSG_DONE) {
+                    continue;
+                }
+                PageTransfer* transfer = nullptr;
+                curl_easy_getinfo(message->easy_handle, CURLINFO_PRIVATE, &transfer);
+                FetchedPage& page = *transfer->page;
+
+                long status = 0;
+                curl_easy_getinfo(message->easy_handle, CURLINFO_RESPONSE_CODE, &status);
+                page.status_code = static_cast<int>(status);
+                page.elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - transfer->started).count();
+                if (transfer->kind == PageTransfer::Kind::Html) {
+                    page.text = transfer->html.finish();
+                }
+
+                if (message->data.result != CURLE_OK) {
+                    page.error_message = !transfer->error.empty() ? transfer->error
+                                                                  : std::string(curl_easy_strerror(message->data.result));
+                } else if (status >= 400) {
+                    page.error_message = "HTTP error " + std::to_string(status);
+                } else {
+                    page.success = true;
+                }
+
+                curl_multi_remove_handle(multi, message->easy_handle);
+                curl_easy_cleanup(message->easy_handle);
+                transfer->easy = nullptr;
+                on_complete(page);
+            }
+
+            if (running > 0) {
+                curl_multi_poll(multi, nullptr, 0, 100, nullptr);
+            }
+        } while (running > 0);
+
+        for (auto& transfer : transfers) {
+            if (transfer->easy) {
+                curl_multi_remove_handle(multi, transfer->easy);
+                curl_easy_cleanup(transfer->easy);
+            }
         }
+        curl_multi_cleanup(multi);
     }
 
 } // namespace kolosal
@@ -4,6 +4,9 @@
 #include "kolosal/retrieval/parse_pdf.hpp"
 #include "kolosal/retrieval/parse_docx.hpp"
 #include "kolosal/retrieval/parse_html.hpp"
+#include "kolosal/retrieval/parse_cache.hpp"
+#include "kolosal/routes/retrieval/record_stream.hpp"
+#include "kolosal/task_executor.hpp"
 #include <json.hpp>
 #include <iostream>
 #include <sstream>
@@ -12,6 +15,7 @@
 #include <algorithm>
 #include <memory>
 #include <iomanip>
+#include <iterator>
 #include <mutex>
 
 #include "base64.hpp"
@@ -20,48 +24,46 @@ using json = nlohmann::json;
 
 namespace kolosal
 {
-    // Thread-local storage for current path
-    thread_local std::string ParseDocumentRoute::current_path_;
-
     namespace
     {
         // Helper function to convert method string to enum
-        retrieval::PDFParseMethod parseMethodFromString(const std::string &method_str)
+        ::retrieval::PDFParseMethod parseMethodFromString(const std::string &method_str)
         {
             std::string lower_method = method_str;
             std::transform(lower_method.begin(), lower_method.end(), lower_method.begin(), ::tolower);
 
             if (lower_method == "fast")
             {
-                return retrieval::PDFParseMethod::Fast;
+                return ::retrieval::PDFParseMethod::Fast;
             }
             else if (lower_method == "ocr")
             {
-                return retrieval::PDFParseMethod::OCR;
+                return ::retrieval::PDFParseMethod::OCR;
             }
             else if (lower_method == "visual")
             {
-                return retrieval::PDFParseMethod::Visual;
+                return ::retrieval::PDFParseMethod::Visual;
             }
             else
             {
-                return retrieval::PDFParseMethod::Fast; // Default fallback
+                return ::retrieval::PDFParseMethod::Fast; // Default fallback
             }
         }
     }
 
     bool ParseDocumentRoute::match(const std::string &method, const std::string &path)
     {
-        bool matches = method == "POST" && 
-                      (path == "/parse_pdf" || path == "/parse_docx" || path == "/parse_html");
-        
-        if (matches)
-        {
-            // Store the path in thread-local storage (thread-safe)
-            current_path_ = path;
-        }
-        
-        return matches;
+        return method == "POST" &&
+               (path == "/parse_pdf" || path == "/parse_docx" || path == "/parse_html");
+    }
+
+    std::vector<RoutePattern> ParseDocumentRoute::patterns() const
+    {
+        return {
+            {"POST", "/parse_pdf"},
+            {"POST", "/parse_docx"},
+            {"POST", "/parse_html"}
+        };
     }
 
     ParseDocumentRoute::DocumentType ParseDocumentRoute::getDocumentType(const std::string &path)
@@ -134,7 +136,7 @@ namespace kolosal
         }
         catch (const json::parse_error &ex)
         {
-            ServerLogger::logError("[Thread %u] JSON parsing error: %s", std::this_thread::get_id(), ex.what());
+            KOLOSAL_LOG_ERROR("[Thread %zu] JSON parsing error: %s", std::hash<std::thread::id>{}(std::this_thread::get_id()), ex.what());
             json errorResponse;
             errorResponse["success"] = false;
             errorResponse["error"] = "Invalid JSON format";
@@ -144,11 +146,37 @@ namespace kolosal
         }
     }
 
-    bool ParseDocumentRoute::validateDocumentData(const nlohmann::json &request, const std::string &data_key, SocketType sock)
+    bool ParseDocumentRoute::parseStreamedRequest(RequestBody &body, nlohmann::json &request, SocketType sock)
+    {
+        try
+        {
+            request = json::parse(body.stream());
+        }
+        catch (const json::parse_error &ex)
+        {
+            json errorResponse;
+            errorResponse["success"] = false;
+            if (!body.ok())
+            {
+                errorResponse["error"] = "Unreadable request body";
+                errorResponse["details"] = body.error();
+            }
+            else
+            {
+                KOLOSAL_LOG_ERROR("[Thread %zu] JSON parsing error: %s", std::hash<std::thread::id>{}(std::this_thread::get_id()), ex.what());
+                errorResponse["error"] = "Invalid JSON format";
+                errorResponse["details"] = ex.what();
+            }
+            sendJsonResponse(sock, errorResponse, body.ok() ? 400 : body.errorStatus());
+            return false;
+        }
+        return true;
+    }
+
+    bool ParseDocumentRoute::validateDocumentData(const nlohmann::json &request, const std::string &data_key, nlohmann::json &error_response)
     {
         if (!request.contains(data_key) || !request[data_key].is_string())
         {
-            json error_response;
             error_response["success"] = false;
             error_response["error"] = "Missing or invalid '" + data_key + "' field";
             
@@ -160,14 +188,11 @@ namespace kolosal
             {
                 error_response["details"] = "Expected HTML content as string";
             }
-            
-            sendJsonResponse(sock, error_response, 400);
             return false;
         }
 
-        if (request[data_key].get<std::string>().empty())
+        if (request[data_key].get_ref<const std::string &>().empty())
         {
-            json error_response;
             error_response["success"] = false;
             
             if (data_key == "data")
@@ -179,29 +204,26 @@ namespace kolosal
             {
                 error_response["error"] = "Missing or invalid 'html' field in request";
             }
-            
-            sendJsonResponse(sock, error_response, 400);
             return false;
         }
 
         return true;
     }
 
-    std::vector<unsigned char> ParseDocumentRoute::decodeBase64Data(const std::string &base64_data, SocketType sock)
+    std::vector<unsigned char> ParseDocumentRoute::decodeBase64Data(const std::string &base64_data, nlohmann::json &error_response)
     {
         try
         {
-            // Use the existing base64 utility
-            std::string decoded_str = base64::decode(base64_data);
-            std::vector<unsigned char> decoded_data(decoded_str.begin(), decoded_str.end());
+            // Decode straight into the output buffer; documents can be hundreds of MB
+            std::vector<unsigned char> decoded_data;
+            decoded_data.reserve(base64::max_decode_size(base64_data.size()));
+            base64::decode(base64_data.begin(), base64_data.end(), std::back_inserter(decoded_data));
             
             if (decoded_data.empty())
             {
-                json error_response;
                 error_response["success"] = false;
                 error_response["error"] = "Empty decoded document data";
                 error_response["details"] = "Decoded document data is empty";
-                sendJsonResponse(sock, error_response, 400);
                 return {};
             }
             
@@ -209,197 +231,346 @@ namespace kolosal
         }
         catch (const std::exception &ex)
         {
-            json error_response;
             error_response["success"] = false;
             error_response["error"] = "Failed to decode base64 data";
             error_response["details"] = ex.what();
-            sendJsonResponse(sock, error_response, 400);
             return {};
         }
     }
 
-    void ParseDocumentRoute::handle(SocketType sock, const std::string &body)
+    int ParseDocumentRoute::parseDocument(DocumentType docType, nlohmann::json &payload, nlohmann::json &response)
     {
-        try
+        const std::string data_key = getDataKey(docType);
+        const std::string log_prefix = getLogPrefix(docType);
+
+        if (!validateDocumentData(payload, data_key, response))
         {
-            // Get document type from thread-local storage
-            DocumentType docType = getDocumentType(current_path_);
-            std::string data_key = getDataKey(docType);
-            std::string log_prefix = getLogPrefix(docType);
+            return 400;
+        }
 
-            ServerLogger::logInfo("[Thread %u] Received %s parse request", std::this_thread::get_id(), log_prefix.c_str());
+        response["success"] = false;
 
-            // Handle OPTIONS request for CORS (empty body indicates OPTIONS)
-            if (body.empty())
+        // Handle different document types
+        switch (docType)
+        {
+            case DocumentType::HTML:
             {
-                std::string description;
-                switch (docType)
+                std::string html_content = payload[data_key].get<std::string>();
+                
+                KOLOSAL_LOG_REQUEST_DEBUG("[Thread %zu] Converting HTML to Markdown (length: %zu)", 
+                                      std::hash<std::thread::id>{}(std::this_thread::get_id()), html_content.length());
+                
+                // Use the HTML parser class
+                ::retrieval::HtmlParser parser;
+                ::retrieval::HtmlParseResult result = parser.parseHtmlSync(html_content);
+                
+                if (result.success)
                 {
-                    case DocumentType::PDF:
-                        description = "Send base64-encoded PDF data to parse text";
-                        break;
-                    case DocumentType::DOCX:
-                        description = "Send base64-encoded DOCX data to parse text";
-                        break;
-                    case DocumentType::HTML:
-                        description = "Send HTML content to convert to Markdown";
-                        break;
+                    response["success"] = true;
+                    response["markdown"] = result.markdown;
+                    response["elements_processed"] = result.elements_processed;
+                    
+                    KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Successfully converted HTML to Markdown", 
+                                        std::hash<std::thread::id>{}(std::this_thread::get_id()));
                 }
-                sendOptionsResponse(sock, log_prefix, description);
-                return;
+                else
+                {
+                    response["error"] = result.error_message.empty() ? "Failed to parse HTML content" : result.error_message;
+                    response["elements_processed"] = result.elements_processed;
+                    KOLOSAL_LOG_ERROR("[Thread %zu] Error converting HTML to Markdown: %s",
+                                         std::hash<std::thread::id>{}(std::this_thread::get_id()), response["error"].get<std::string>().c_str());
+                }
+                break;
             }
 
-            json request;
-            if (!parseRequest(body, request, sock))
+            case DocumentType::PDF:
+            case DocumentType::DOCX:
             {
-                return;
-            }
+                std::string method_str = "fast";
+                std::string language = "eng";
+                if (docType == DocumentType::PDF)
+                {
+                    if (payload.contains("method") && payload["method"].is_string())
+                    {
+                        method_str = payload["method"].get<std::string>();
+                    }
+                    if (payload.contains("language") && payload["language"].is_string())
+                    {
+                        language = payload["language"].get<std::string>();
+                    }
+                }
 
-            // Validate document data
-            if (!validateDocumentData(request, data_key, sock))
-            {
-                return;
-            }
+                // A document parsed before is answered without decoding or parsing it again
+                auto &parse_cache = retrieval::ParseCache::instance();
+                std::string cache_key;
+                if (parse_cache.enabled())
+                {
+                    cache_key = retrieval::ParseCache::makeKey(
+                        log_prefix, docType == DocumentType::PDF ? method_str + '\0' + language : std::string(),
+                        payload[data_key].get_ref<const std::string &>());
+                    if (auto cached = parse_cache.get(cache_key))
+                    {
+                        json cached_response = json::parse(*cached, nullptr, false);
+                        if (!cached_response.is_discarded())
+                        {
+                            cached_response["cached"] = true;
+                            KOLOSAL_LOG_INFO("%s parse served from cache (%s)", log_prefix.c_str(), cache_key.c_str());
+                            response = std::move(cached_response);
+                            return 200;
+                        }
+                    }
+                }
 
-            json response;
-            response["success"] = false;
+                // For PDF and DOCX, decode base64 data, then drop the encoded copy
+                std::vector<unsigned char> document_data =
+                    decodeBase64Data(payload[data_key].get_ref<const std::string &>(), response);
+                payload[data_key] = nullptr;
+                
+                if (document_data.empty())
+                {
+                    return 400;
+                }
 
-            // Handle different document types
-            switch (docType)
-            {
-                case DocumentType::HTML:
+                KOLOSAL_LOG_INFO("Parsing %s data (size: %zu bytes)", log_prefix.c_str(), document_data.size());
+
+                if (docType == DocumentType::PDF)
                 {
-                    std::string html_content = request[data_key].get<std::string>();
-                    
-                    ServerLogger::logDebug("[Thread %u] Converting HTML to Markdown (length: %zu)", 
-                                          std::this_thread::get_id(), html_content.length());
-                    
-                    // Use the HTML parser class
-                    retrieval::HtmlParser parser;
-                    retrieval::HtmlParseResult result = parser.parseHtmlSync(html_content);
-                    
+                    // Handle PDF parsing
+                    ::retrieval::PDFParseMethod parse_method = parseMethodFromString(method_str);
+
+                    KOLOSAL_LOG_INFO("Parsing PDF data (size: %zu bytes) using method: %s, language: %s", 
+                                        document_data.size(), method_str.c_str(), language.c_str());
+
+                    // Progress callback (optional)
+                    ::retrieval::ProgressCallback progress_cb = nullptr;
+                    if (payload.value("progress", false))
+                    {
+                        progress_cb = [](size_t current, size_t total)
+                        {
+                            KOLOSAL_LOG_INFO("PDF parsing progress: %zu/%zu pages", current, total);
+                        };
+                    }
+
+                    auto result = ::retrieval::DocumentParser::parse_pdf_from_bytes(
+                        document_data.data(), document_data.size(), parse_method, language, progress_cb
+                    );
+
                     if (result.success)
                     {
                         response["success"] = true;
-                        response["markdown"] = result.markdown;
-                        response["elements_processed"] = result.elements_processed;
+                        response["text"] = result.text;
+                        response["pages_processed"] = result.pages_processed;
+                        response["method"] = method_str;
+                        response["language"] = language;
+                        response["data_size_bytes"] = document_data.size();
                         
-                        ServerLogger::logInfo("[Thread %u] Successfully converted HTML to Markdown", 
-                                            std::this_thread::get_id());
+                        KOLOSAL_LOG_INFO("PDF parsing completed successfully. Pages: %zu, Text length: %zu",
+                                            result.pages_processed, result.text.length());
                     }
                     else
                     {
-                        response["error"] = result.error_message.empty() ? "Failed to parse HTML content" : result.error_message;
-                        response["elements_processed"] = result.elements_processed;
-                        ServerLogger::logError("[Thread %u] Error converting HTML to Markdown: %s",
-                                             std::this_thread::get_id(), response["error"].get<std::string>().c_str());
+                        response["error"] = result.error_message;
+                        response["pages_processed"] = result.pages_processed;
+                        response["method"] = method_str;
+                        response["language"] = language;
+                        response["data_size_bytes"] = document_data.size();
+                        KOLOSAL_LOG_ERROR("PDF parsing failed: %s", result.error_message.c_str());
                     }
-                    break;
                 }
-
-                case DocumentType::PDF:
-                case DocumentType::DOCX:
+                else // DOCX
                 {
-                    // For PDF and DOCX, decode base64 data
-                    std::string base64_data = request[data_key].get<std::string>();
-                    std::vector<unsigned char> document_data = decodeBase64Data(base64_data, sock);
-                    
-                    if (document_data.empty())
+                    try
                     {
-                        return; // Error already sent by decodeBase64Data
+                        std::string parsed_text = ::retrieval::DOCXParser::parse_docx_from_bytes(
+                            document_data.data(), document_data.size()
+                        );
+                        
+                        response["success"] = true;
+                        response["text"] = parsed_text;
+                        response["pages_processed"] = 1; // DOCX doesn't have pages like PDF, so we'll use 1
+                        response["data_size_bytes"] = document_data.size();
+                        
+                        KOLOSAL_LOG_INFO("DOCX parsing completed successfully. Text length: %zu",
+                                            parsed_text.length());
                     }
-
-                    ServerLogger::logInfo("Parsing %s data (size: %zu bytes)", log_prefix.c_str(), document_data.size());
-
-                    if (docType == DocumentType::PDF)
+                    catch (const std::exception &e)
                     {
-                        // Handle PDF parsing
-                        std::string method_str = "fast";
-                        if (request.contains("method") && request["method"].is_string())
-                        {
-                            method_str = request["method"].get<std::string>();
-                        }
+                        response["error"] = e.what();
+                        response["pages_processed"] = 1;
+                        response["data_size_bytes"] = document_data.size();
+                        KOLOSAL_LOG_ERROR("DOCX parsing failed: %s", e.what());
+                    }
+                }
 
-                        std::string language = "eng";
-                        if (request.contains("language") && request["language"].is_string())
-                        {
-                            language = request["language"].get<std::string>();
-                        }
+                if (!cache_key.empty() && response["success"].get<bool>())
+                {
+                    parse_cache.put(cache_key, response.dump());
+                }
+                break;
+            }
+        }
 
-                        retrieval::PDFParseMethod parse_method = parseMethodFromString(method_str);
+        return response["success"].get<bool>() ? 200 : 500;
+    }
 
-                        ServerLogger::logInfo("Parsing PDF data (size: %zu bytes) using method: %s, language: %s", 
-                                            document_data.size(), method_str.c_str(), language.c_str());
+    void ParseDocumentRoute::handleBatch(SocketType sock, const RequestContext &request, DocumentType docType, nlohmann::json &payload)
+    {
+        json &files = payload["files"];
+        if (!files.is_array() || files.empty() || files.size() > kMaxBatchFiles ||
+            !std::all_of(files.begin(), files.end(), [](const json &file) { return file.is_object(); }))
+        {
+            json error_response;
+            error_response["success"] = false;
+            error_response["error"] = "Invalid 'files' field";
+            error_response["details"] = "Expected an array of 1 to " + std::to_string(kMaxBatchFiles) + " document objects";
+            sendJsonResponse(sock, error_response, 400);
+            return;
+        }
 
-                        // Progress callback (optional)
-                        retrieval::ProgressCallback progress_cb = nullptr;
-                        if (request.value("progress", false))
-                        {
-                            progress_cb = [](size_t current, size_t total)
-                            {
-                                ServerLogger::logInfo("PDF parsing progress: %zu/%zu pages", current, total);
-                            };
-                        }
+        const bool stream = RecordStream::requested(request, payload);
+        const size_t total = files.size();
+        KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Parsing %zu %s documents%s", std::hash<std::thread::id>{}(std::this_thread::get_id()), total,
+                              getLogPrefix(docType).c_str(), stream ? " as a stream" : "");
 
-                        auto result = retrieval::DocumentParser::parse_pdf_from_bytes(
-                            document_data.data(), document_data.size(), parse_method, language, progress_cb
-                        );
+        // Each file is parsed on the shared executor and handed back as it finishes; a file
+        // without its own method or language takes the request's
+        struct Parsed
+        {
+            size_t index = 0;
+            int status = 500;
+            json response;
+        };
+        auto finished = std::make_shared<CompletionQueue<Parsed>>();
+        for (size_t i = 0; i < total; ++i)
+        {
+            json file = std::move(files[i]);
+            for (const char *key : {"method", "language", "progress"})
+            {
+                if (!file.contains(key) && payload.contains(key))
+                {
+                    file[key] = payload[key];
+                }
+            }
+            TaskExecutor::instance().submit([this, docType, i, finished, file = std::move(file)]() mutable {
+                Parsed parsed;
+                parsed.index = i;
+                try
+                {
+                    parsed.status = parseDocument(docType, file, parsed.response);
+                }
+                catch (const std::exception &ex)
+                {
+                    parsed.response = {{"success", false}, {"error", "Internal server error"}, {"details", ex.what()}};
+                }
+                if (file.contains("id"))
+                {
+                    parsed.response["id"] = file["id"];
+                }
+                parsed.response["index"] = i;
+                finished->push(std::move(parsed));
+            });
+        }
+        files = nullptr;
 
-                        if (result.success)
-                        {
-                            response["success"] = true;
-                            response["text"] = result.text;
-                            response["pages_processed"] = result.pages_processed;
-                            response["method"] = method_str;
-                            response["language"] = language;
-                            response["data_size_bytes"] = document_data.size();
-                            
-                            ServerLogger::logInfo("PDF parsing completed successfully. Pages: %zu, Text length: %zu",
-                                                result.pages_processed, result.text.length());
-                        }
-                        else
-                        {
-                            response["error"] = result.error_message;
-                            response["pages_processed"] = result.pages_processed;
-                            response["method"] = method_str;
-                            response["language"] = language;
-                            response["data_size_bytes"] = document_data.size();
-                            ServerLogger::logError("PDF parsing failed: %s", result.error_message.c_str());
-                        }
-                    }
-                    else // DOCX
-                    {
-                        try
-                        {
-                            std::string parsed_text = retrieval::DOCXParser::parse_docx_from_bytes(
-                                document_data.data(), document_data.size()
-                            );
-                            
-                            response["success"] = true;
-                            response["text"] = parsed_text;
-                            response["pages_processed"] = 1; // DOCX doesn't have pages like PDF, so we'll use 1
-                            response["data_size_bytes"] = document_data.size();
-                            
-                            ServerLogger::logInfo("DOCX parsing completed successfully. Text length: %zu",
-                                                parsed_text.length());
-                        }
-                        catch (const std::exception &e)
-                        {
-                            response["error"] = e.what();
-                            response["pages_processed"] = 1;
-                            response["data_size_bytes"] = document_data.size();
-                            ServerLogger::logError("DOCX parsing failed: %s", e.what());
-                        }
-                    }
+        size_t succeeded = 0;
+        if (stream)
+        {
+            RecordStream records(sock, request);
+            for (size_t received = 0; received < total; ++received)
+            {
+                Parsed parsed = finished->pop();
+                succeeded += parsed.status == 200;
+                parsed.response["status"] = parsed.status;
+                if (!records.send(parsed.response))
+                {
+                    KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Client left a %s parse stream after %zu of %zu documents",
+                                          std::hash<std::thread::id>{}(std::this_thread::get_id()), getLogPrefix(docType).c_str(), received, total);
                     break;
                 }
             }
+            records.finish({{"done", true}, {"total", total}, {"succeeded", succeeded}, {"failed", total - succeeded}});
+            return;
+        }
+
+        json results = json::array();
+        std::vector<json> ordered(total);
+        for (size_t received = 0; received < total; ++received)
+        {
+            Parsed parsed = finished->pop();
+            succeeded += parsed.status == 200;
+            parsed.response["status"] = parsed.status;
+            ordered[parsed.index] = std::move(parsed.response);
+        }
+        for (auto &result : ordered)
+        {
+            results.push_back(std::move(result));
+        }
+        json response;
+        response["success"] = succeeded == total;
+        response["total"] = total;
+        response["succeeded"] = succeeded;
+        response["failed"] = total - succeeded;
+        response["results"] = std::move(results);
+        sendJsonResponse(sock, response, 200);
+    }
+
+    void ParseDocumentRoute::handle(SocketType sock, const RequestContext &request)
+    {
+        try
+        {
+            DocumentType docType = getDocumentType(request.path);
+            std::string log_prefix = getLogPrefix(docType);
+
+            KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Received %s parse request", std::hash<std::thread::id>{}(std::this_thread::get_id()), log_prefix.c_str());
 
-            sendJsonResponse(sock, response, response["success"].get<bool>() ? 200 : 500);
+            // Handle OPTIONS request for CORS (empty body indicates OPTIONS)
+            if (request.body.empty() && !request.bodyStream)
+            {
+                std::string description;
+                switch (docType)
+                {
+                    case DocumentType::PDF:
+                        description = "Send base64-encoded PDF data to parse text";
+                        break;
+                    case DocumentType::DOCX:
+                        description = "Send base64-encoded DOCX data to parse text";
+                        break;
+                    case DocumentType::HTML:
+                        description = "Send HTML content to convert to Markdown";
+                        break;
+                }
+                sendOptionsResponse(sock, log_prefix, description);
+                return;
+            }
+
+            json payload;
+            if (request.bodyStream)
+            {
+                // Large upload: parse the JSON while it is still arriving
+                if (!parseStreamedRequest(*request.bodyStream, payload, sock))
+                {
+                    return;
+                }
+            }
+            else if (!parseRequest(request.body, payload, sock))
+            {
+                return;
+            }
+
+            // Several documents: parsed concurrently, answered together or streamed as each finishes
+            if (payload.is_object() && payload.contains("files"))
+            {
+                handleBatch(sock, request, docType, payload);
+                return;
+            }
+
+            json response;
+            const int status = parseDocument(docType, payload, response);
+            sendJsonResponse(sock, response, status);
         }
         catch (const std::exception &ex)
         {
-            ServerLogger::logError("[Thread %u] Exception in document parsing: %s", std::this_thread::get_id(), ex.what());
+            KOLOSAL_LOG_ERROR("[Thread %zu] Exception in document parsing: %s", std::hash<std::thread::id>{}(std::this_thread::get_id()), ex.what());
             json error_response;
             error_response["success"] = false;
             error_response["error"] = "Internal server error";
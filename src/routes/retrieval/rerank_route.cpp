@@ -0,0 +1,155 @@
+#include "kolosal/routes/retrieval/rerank_route.hpp"
+#include "kolosal/models/rerank_request_model.hpp"
+#include "kolosal/utils.hpp"
+#include "kolosal/server_api.hpp"
+#include "kolosal/logger.hpp"
+#include "kolosal/node_manager.h"
+#include "inference_interface.h"
+#include <json.hpp>
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+
+using json = nlohmann::json;
+
+namespace kolosal
+{
+
+bool RerankRoute::match(const std::string& method, const std::string& path)
+{
+    return (method == "POST" && (path == "/v1/rerank" || path == "/rerank"));
+}
+
+std::vector<RoutePattern> RerankRoute::patterns() const
+{
+    return {
+        {"POST", "/v1/rerank"},
+        {"POST", "/rerank"}
+    };
+}
+
+void RerankRoute::handle(SocketType sock, const RequestContext& context)
+{
+    try
+    {
+        if (context.body.empty())
+        {
+            sendErrorResponse(sock, 400, "Request body is empty");
+            return;
+        }
+
+        json j;
+        try
+        {
+            j = json::parse(context.body);
+        }
+        catch (const json::parse_error& ex)
+        {
+            sendErrorResponse(sock, 400, "Invalid JSON: " + std::string(ex.what()));
+            return;
+        }
+
+        RerankRequest request;
+        try
+        {
+            request.from_json(j);
+        }
+        catch (const std::runtime_error& ex)
+        {
+            sendErrorResponse(sock, 400, ex.what());
+            return;
+        }
+
+        if (!request.validate())
+        {
+            sendErrorResponse(sock, 400, "Invalid request parameters: model, query and a non-empty documents array are required, top_n must be positive");
+            return;
+        }
+
+        auto& nodeManager = ServerAPI::instance().getNodeManager();
+        NodeManager::Admission admission;
+        auto engine = nodeManager.getEngine(request.model, admission);
+
+        if (admission.rejected)
+        {
+            json jError = {{"error", {{"message", "Model '" + request.model + "' is at capacity, retry later"},
+                                      {"type", "server_overloaded"}, {"param", nullptr}, {"code", "model_overloaded"}}}};
+            send_response(sock, 503, jError.dump(),
+                          {{"Content-Type", "application/json"}, {"Retry-After", std::to_string(admission.retryAfterSeconds)}});
+            return;
+        }
+
+        if (!engine)
+        {
+            sendErrorResponse(sock, 404, "Model '" + request.model + "' not found or could not be loaded", "model_not_found", "model");
+            return;
+        }
+
+        KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Reranking %zu document(s) with model '%s'",
+                              std::hash<std::thread::id>{}(std::this_thread::get_id()), request.documents.size(), request.model.c_str());
+
+        std::vector<RerankResult> ranked;
+        try
+        {
+            ranked = engine->rerank(request.query, request.documents, request.top_n);
+        }
+        catch (const std::exception& ex)
+        {
+            sendErrorResponse(sock, 500, "Failed to rerank documents: " + std::string(ex.what()), "server_error");
+            return;
+        }
+
+        // Usage counts every pair the model read, query included each time
+        int totalTokens = 0;
+        const std::vector<int> documentTokens = engine->countTokens(request.documents);
+        const int queryTokens = engine->countTokens({request.query}).front();
+        for (int count : documentTokens)
+        {
+            totalTokens += std::max(0, count) + std::max(0, queryTokens);
+        }
+
+        json results = json::array();
+        for (const auto& result : ranked)
+        {
+            json item = {{"index", result.index}, {"relevance_score", result.score}};
+            if (request.return_documents)
+            {
+                item["document"] = {{"text", request.documents[result.index]}};
+            }
+            results.push_back(std::move(item));
+        }
+
+        json response = {
+            {"object", "list"},
+            {"model", request.model},
+            {"results", std::move(results)},
+            {"usage", {{"prompt_tokens", totalTokens}, {"total_tokens", totalTokens}}}
+        };
+        send_response(sock, 200, response.dump());
+
+        KOLOSAL_LOG_REQUEST_INFO("[Thread %zu] Reranked %zu document(s) with model '%s', returned %zu",
+                              std::hash<std::thread::id>{}(std::this_thread::get_id()), request.documents.size(), request.model.c_str(), ranked.size());
+    }
+    catch (const std::exception& ex)
+    {
+        KOLOSAL_LOG_ERROR("[Thread %zu] Error handling rerank request: %s", std::hash<std::thread::id>{}(std::this_thread::get_id()), ex.what());
+        sendErrorResponse(sock, 500, "Internal server error: " + std::string(ex.what()), "server_error");
+    }
+}
+
+void RerankRoute::sendErrorResponse(
+    SocketType sock,
+    int status_code,
+    const std::string& error_message,
+    const std::string& error_type,
+    const std::string& param)
+{
+    json jError = {{"error", {{"message", error_message}, {"type", error_type},
+                              {"param", param.empty() ? json(nullptr) : json(param)}, {"code", nullptr}}}};
+    send_response(sock, status_code, jError.dump());
+
+    KOLOSAL_LOG_ERROR("[Thread %zu] Rerank request error (%d): %s",
+                           std::hash<std::thread::id>{}(std::this_thread::get_id()), status_code, error_message.c_str());
+}
+
+} // namespace kolosal
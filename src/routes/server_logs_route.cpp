@@ -7,57 +7,284 @@
 #include <chrono>
 #include <iomanip>
 #include <sstream>
+#include <algorithm>
+#include <cctype>
 
 using json = nlohmann::json;
 
 namespace kolosal
 {
+    namespace
+    {
+        constexpr size_t kDefaultLimit = 100;
+        constexpr size_t kMaxLimit = 1000;
+        constexpr auto kStreamKeepAlive = std::chrono::seconds(15);
+
+        std::string decodeComponent(const std::string &value)
+        {
+            std::string decoded;
+            decoded.reserve(value.size());
+            for (size_t i = 0; i < value.size(); ++i)
+            {
+                if (value[i] == '+')
+                {
+                    decoded += ' ';
+                }
+                else if (value[i] == '%' && i + 2 < value.size() &&
+                         std::isxdigit(static_cast<unsigned char>(value[i + 1])) &&
+                         std::isxdigit(static_cast<unsigned char>(value[i + 2])))
+                {
+                    decoded += static_cast<char>(std::stoi(value.substr(i + 1, 2), nullptr, 16));
+                    i += 2;
+                }
+                else
+                {
+                    decoded += value[i];
+                }
+            }
+            return decoded;
+        }
+
+        std::map<std::string, std::string> parseQuery(const std::string &path)
+        {
+            std::map<std::string, std::string> query;
+            const size_t start = path.find('?');
+            if (start == std::string::npos)
+            {
+                return query;
+            }
+            std::istringstream params(path.substr(start + 1));
+            std::string param;
+            while (std::getline(params, param, '&'))
+            {
+                const size_t eq = param.find('=');
+                query[decodeComponent(param.substr(0, eq))] =
+                    eq == std::string::npos ? "" : decodeComponent(param.substr(eq + 1));
+            }
+            return query;
+        }
+
+        const char *levelName(LogLevel level)
+        {
+            switch (level)
+            {
+            case LogLevel::SERVER_ERROR:
+                return "ERROR";
+            case LogLevel::SERVER_WARNING:
+                return "WARNING";
+            case LogLevel::SERVER_INFO:
+                return "INFO";
+            case LogLevel::SERVER_DEBUG:
+                return "DEBUG";
+            default:
+                return "UNKNOWN";
+            }
+        }
+
+        bool parseLevel(std::string name, LogLevel &level)
+        {
+            std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+            if (name == "error")
+                level = LogLevel::SERVER_ERROR;
+            else if (name == "warning" || name == "warn")
+                level = LogLevel::SERVER_WARNING;
+            else if (name == "info")
+                level = LogLevel::SERVER_INFO;
+            else if (name == "debug")
+                level = LogLevel::SERVER_DEBUG;
+            else
+                return false;
+            return true;
+        }
+
+        std::string lowercase(std::string text)
+        {
+            std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c)
+                           { return static_cast<char>(std::tolower(c)); });
+            return text;
+        }
+
+        json entryToJson(const LogEntry &entry)
+        {
+            return {
+                {"id", entry.id},
+                {"level", levelName(entry.level)},
+                {"timestamp", entry.timestamp},
+                {"message", entry.message}};
+        }
+
+        uint64_t parseUnsigned(const std::map<std::string, std::string> &query, const std::string &name, uint64_t fallback)
+        {
+            auto it = query.find(name);
+            if (it == query.end() || it->second.empty())
+            {
+                return fallback;
+            }
+            if (!std::all_of(it->second.begin(), it->second.end(), ::isdigit))
+            {
+                throw std::invalid_argument("'" + name + "' must be a non-negative integer");
+            }
+            return std::stoull(it->second);
+        }
+
+        // Filters from the query string: level (minimum severity), since/until (unix seconds)
+        // and q (case-insensitive substring of the message); all are evaluated server-side
+        LogFilter buildFilter(const std::map<std::string, std::string> &query)
+        {
+            LogLevel minLevel = LogLevel::SERVER_DEBUG;
+            auto level = query.find("level");
+            if (level != query.end() && !level->second.empty() && !parseLevel(level->second, minLevel))
+            {
+                throw std::invalid_argument("'level' must be one of error, warning, info, debug");
+            }
+
+            const uint64_t since = parseUnsigned(query, "since", 0);
+            const uint64_t until = parseUnsigned(query, "until", 0);
+            auto q = query.find("q");
+            const std::string needle = q != query.end() ? lowercase(q->second) : std::string();
+
+            if (minLevel == LogLevel::SERVER_DEBUG && since == 0 && until == 0 && needle.empty())
+            {
+                return nullptr;
+            }
+
+            const auto sinceTime = std::chrono::system_clock::time_point(std::chrono::seconds(since));
+            const auto untilTime = std::chrono::system_clock::time_point(std::chrono::seconds(until));
+            return [=](const LogEntry &entry)
+            {
+                if (entry.level > minLevel)
+                    return false;
+                if (since != 0 && entry.time < sinceTime)
+                    return false;
+                if (until != 0 && entry.time >= untilTime)
+                    return false;
+                if (!needle.empty() && lowercase(entry.message).find(needle) == std::string::npos)
+                    return false;
+                return true;
+            };
+        }
+
+        std::string sseEvent(const LogEntry &entry)
+        {
+            return "id: " + std::to_string(entry.id) + "\nevent: log\ndata: " + entryToJson(entry).dump() + "\n\n";
+        }
+
+        // "tail -f": send entries as they are written until the client goes away
+        void streamLogs(SocketType sock, uint64_t cursor, bool hasCursor, size_t backlog, const LogFilter &filter)
+        {
+            auto &logger = ServerLogger::instance();
+            begin_streaming_response(sock, 200, {{"Content-Type", "text/event-stream"}, {"X-Accel-Buffering", "no"}});
+
+            if (!hasCursor)
+            {
+                // Start with the last few matching lines, like tail does
+                uint64_t back = 0;
+                for (const auto &entry : logger.getLogsBefore(back, backlog, filter))
+                {
+                    send_stream_chunk(sock, StreamChunk(sseEvent(entry)), false);
+                }
+                cursor = logger.newestLogId();
+                send_stream_chunk(sock, StreamChunk(": tailing from " + std::to_string(cursor) + "\n\n"));
+            }
+
+            while (!client_disconnected(sock))
+            {
+                auto entries = logger.getLogsAfter(cursor, kMaxLimit, filter);
+                if (!entries.empty())
+                {
+                    std::string frame;
+                    for (const auto &entry : entries)
+                    {
+                        frame += sseEvent(entry);
+                    }
+                    send_stream_chunk(sock, StreamChunk(frame));
+                    continue;
+                }
+                if (cursor < logger.newestLogId())
+                {
+                    continue; // Everything examined so far was filtered out
+                }
+                if (!logger.waitForLogs(cursor, kStreamKeepAlive))
+                {
+                    send_stream_chunk(sock, StreamChunk(": keep-alive\n\n"));
+                }
+            }
+        }
+    }
 
     bool ServerLogsRoute::match(const std::string &method, const std::string &path)
     {
-        return (method == "GET" && (path == "/logs" || path == "/v1/logs" || path == "/server/logs"));
+        const std::string endpoint = path.substr(0, path.find('?'));
+        return (method == "GET" && (endpoint == "/logs" || endpoint == "/v1/logs" || endpoint == "/server/logs"));
     }
 
-    void ServerLogsRoute::handle(SocketType sock, const std::string &body)
+    std::vector<RoutePattern> ServerLogsRoute::patterns() const
+    {
+        return {
+            {"GET", "/logs"},
+            {"GET", "/v1/logs"},
+            {"GET", "/server/logs"}
+        };
+    }
+
+    void ServerLogsRoute::handle(SocketType sock, const RequestContext &request)
     {
         try
         {
-            ServerLogger::logDebug("[Thread %u] Received server logs request", std::this_thread::get_id());
+            KOLOSAL_LOG_REQUEST_DEBUG("[Thread %zu] Received server logs request", std::hash<std::thread::id>{}(std::this_thread::get_id()));
+
+            const auto query = parseQuery(request.path);
+            LogFilter filter;
+            uint64_t after = 0;
+            uint64_t before = 0;
+            size_t limit = kDefaultLimit;
+            try
+            {
+                filter = buildFilter(query);
+                after = parseUnsigned(query, "after", 0);
+                before = parseUnsigned(query, "before", 0);
+                limit = static_cast<size_t>(std::min<uint64_t>(parseUnsigned(query, "limit", kDefaultLimit), kMaxLimit));
+            }
+            catch (const std::exception &ex)
+            {
+                json jError = {{"error", {{"message", ex.what()}, {"type", "invalid_request_error"}, {"param", nullptr}, {"code", nullptr}}}};
+                send_response(sock, 400, jError.dump());
+                return;
+            }
 
-            // Get the ServerLogger instance and retrieve logs
             auto &logger = ServerLogger::instance();
-            const auto &logs = logger.getLogs();
 
-            json logsList = json::array();
-            for (const auto &logEntry : logs)
+            auto stream = query.find("stream");
+            auto accept = request.headers.find("accept");
+            if ((stream != query.end() && (stream->second == "true" || stream->second == "1")) ||
+                (accept != request.headers.end() && accept->second.find("text/event-stream") != std::string::npos))
             {
-                std::string levelStr;
-                switch (logEntry.level)
+                // A reconnecting EventSource resumes from the last id it saw
+                auto lastEventId = request.headers.find("last-event-id");
+                bool hasCursor = query.count("after") > 0;
+                if (!hasCursor && lastEventId != request.headers.end() &&
+                    !lastEventId->second.empty() && std::all_of(lastEventId->second.begin(), lastEventId->second.end(), ::isdigit))
                 {
-                case LogLevel::SERVER_ERROR:
-                    levelStr = "ERROR";
-                    break;
-                case LogLevel::SERVER_WARNING:
-                    levelStr = "WARNING";
-                    break;
-                case LogLevel::SERVER_INFO:
-                    levelStr = "INFO";
-                    break;
-                case LogLevel::SERVER_DEBUG:
-                    levelStr = "DEBUG";
-                    break;
-                default:
-                    levelStr = "UNKNOWN";
-                    break;
+                    after = std::stoull(lastEventId->second);
+                    hasCursor = true;
                 }
+                streamLogs(sock, after, hasCursor, limit, filter);
+                return;
+            }
 
-                json logObject = {
-                    {"level", levelStr},
-                    {"timestamp", logEntry.timestamp},
-                    {"message", logEntry.message}
-                };
+            // Pages: after=<id> walks forward, before=<id> walks back; neither gives the newest page
+            const bool forward = query.count("after") > 0;
+            uint64_t cursor = forward ? after : before;
+            std::vector<LogEntry> logs = forward ? logger.getLogsAfter(cursor, limit, filter)
+                                                 : logger.getLogsBefore(cursor, limit, filter);
 
-                logsList.push_back(logObject);
+            const uint64_t oldest = logger.oldestLogId();
+            const uint64_t newest = logger.newestLogId();
+
+            json logsList = json::array();
+            for (const auto &logEntry : logs)
+            {
+                logsList.push_back(entryToJson(logEntry));
             }
 
             // Get current timestamp for the response
@@ -67,18 +294,29 @@ namespace kolosal
             ss << std::put_time(std::localtime(&time_t), "%Y-%m-%d %H:%M:%S");
             std::string currentTimestamp = ss.str();
 
+            // next_cursor continues forward from the last entry examined, prev_cursor goes back
+            // from the first; both skip entries that were examined but filtered out
+            const uint64_t nextCursor = forward ? cursor : (logs.empty() ? newest : std::max(logs.back().id, before == 0 ? newest : before - 1));
+            const uint64_t prevCursor = forward ? (logs.empty() ? after + 1 : logs.front().id) : cursor;
+
             json response = {
                 {"logs", logsList},
                 {"total_count", logsList.size()},
+                {"next_cursor", nextCursor},
+                {"prev_cursor", prevCursor},
+                {"has_more", forward ? nextCursor < newest : prevCursor > oldest},
+                {"oldest_id", oldest},
+                {"newest_id", newest},
+                {"truncated", forward && after + 1 < oldest},
                 {"retrieved_at", currentTimestamp}
             };
 
             send_response(sock, 200, response.dump());
-            ServerLogger::logDebug("[Thread %u] Successfully retrieved %zu log entries", std::this_thread::get_id(), logsList.size());
+            KOLOSAL_LOG_REQUEST_DEBUG("[Thread %zu] Successfully retrieved %zu log entries", std::hash<std::thread::id>{}(std::this_thread::get_id()), logsList.size());
         }
         catch (const std::exception &ex)
         {
-            ServerLogger::logError("[Thread %u] Error handling server logs request: %s", std::this_thread::get_id(), ex.what());
+            KOLOSAL_LOG_ERROR("[Thread %zu] Error handling server logs request: %s", std::hash<std::thread::id>{}(std::this_thread::get_id()), ex.what());
 
             json jError = {
                 {"error", {
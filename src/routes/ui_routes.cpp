@@ -1,135 +1,200 @@
 #include "kolosal/routes/ui_routes.hpp"
 #include "kolosal/utils.hpp"
 #include "kolosal/logger.hpp"
+#include "kolosal/http_compression.hpp"
+#include "kolosal/sha256.hpp"
+#include <cctype>
+#include <chrono>
 #include <fstream>
 #include <sstream>
 #include <filesystem>
 #include <iostream>
+#include <mutex>
 #include <thread>
 
 namespace kolosal {
 
-    bool UIRoute::match(const std::string &method, const std::string &path) {
-        if (method == "GET" || method == "OPTIONS") {
-            // Extract the path without query parameters
-            std::string cleanPath = path;
-            size_t queryPos = path.find('?');
-            if (queryPos != std::string::npos) {
-                cleanPath = path.substr(0, queryPos);
-            }
-            
-            // Match playground routes
-            if (cleanPath == "/playground" || cleanPath == "/playground/") {
-                current_method_ = method;
-                current_path_ = "/playground/playground.html";
-                return true;
-            }
-            
-            // Match direct playground.html access
-            if (cleanPath == "/playground/playground.html") {
-                current_method_ = method;
-                current_path_ = "/playground/playground.html";
-                return true;
-            }
-            
-            // Match dashboard routes
-            if (cleanPath == "/" || cleanPath == "/dashboard" || cleanPath == "/dashboard/") {
-                current_method_ = method;
-                current_path_ = "/index.html";
-                return true;
-            }
-            
-            // Match specific dashboard pages (both with and without /dashboard prefix)
-            if (cleanPath == "/dashboard/index" || cleanPath == "/dashboard/index.html" || 
-                cleanPath == "/index" || cleanPath == "/index.html") {
-                current_method_ = method;
-                current_path_ = "/index.html";
-                return true;
-            }
-            
-            if (cleanPath == "/dashboard/engine" || cleanPath == "/dashboard/engine.html" ||
-                cleanPath == "/engine" || cleanPath == "/engine.html") {
-                current_method_ = method;
-                current_path_ = "/engine.html";
-                return true;
-            }
-            
-            if (cleanPath == "/dashboard/collection" || cleanPath == "/dashboard/collection.html" ||
-                cleanPath == "/collection" || cleanPath == "/collection.html") {
-                current_method_ = method;
-                current_path_ = "/collection.html";
-                return true;
-            }
-            
-            if (cleanPath == "/dashboard/retrieve" || cleanPath == "/dashboard/retrieve.html" ||
-                cleanPath == "/retrieve" || cleanPath == "/retrieve.html") {
-                current_method_ = method;
-                current_path_ = "/retrieve.html";
-                return true;
-            }
-            
-            if (cleanPath == "/dashboard/upload" || cleanPath == "/dashboard/upload.html" ||
-                cleanPath == "/upload" || cleanPath == "/upload.html") {
-                current_method_ = method;
-                current_path_ = "/upload.html";
-                return true;
-            }
-            
-            // Match static assets (CSS, JS) - with /playground prefix
-            if (cleanPath.length() >= 19 && cleanPath.substr(0, 19) == "/playground/styles/" && 
-                cleanPath.length() >= 4 && cleanPath.substr(cleanPath.length() - 4) == ".css") {
-                current_method_ = method;
-                current_path_ = cleanPath; // Keep the full path for playground assets
-                return true;
-            }
-            
-            if (cleanPath.length() >= 19 && cleanPath.substr(0, 19) == "/playground/script/" && 
-                cleanPath.length() >= 3 && cleanPath.substr(cleanPath.length() - 3) == ".js") {
-                current_method_ = method;
-                current_path_ = cleanPath; // Keep the full path for playground assets
-                return true;
-            }
-            
-            // Match static assets (CSS, JS) - with /dashboard prefix
-            if (cleanPath.length() >= 18 && cleanPath.substr(0, 18) == "/dashboard/styles/" && 
-                cleanPath.length() >= 4 && cleanPath.substr(cleanPath.length() - 4) == ".css") {
-                current_method_ = method;
-                current_path_ = cleanPath.substr(10); // Remove "/dashboard" prefix
-                return true;
-            }
-            
-            if (cleanPath.length() >= 18 && cleanPath.substr(0, 18) == "/dashboard/script/" && 
-                cleanPath.length() >= 3 && cleanPath.substr(cleanPath.length() - 3) == ".js") {
-                current_method_ = method;
-                current_path_ = cleanPath.substr(10); // Remove "/dashboard" prefix
-                return true;
-            }
-            
-            // Match static assets (CSS, JS) - without /dashboard prefix
-            if (cleanPath.length() >= 8 && cleanPath.substr(0, 8) == "/styles/" && 
-                cleanPath.length() >= 4 && cleanPath.substr(cleanPath.length() - 4) == ".css") {
-                current_method_ = method;
-                current_path_ = cleanPath; // Use path as is
-                return true;
+    namespace {
+        // How long a cached file is served before its mtime is checked again
+        constexpr int64_t kRevalidateMs = 2000;
+
+        int64_t steadyNowMs() {
+            return std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+        // Build tools name fingerprinted files like app.3f9a2c1b.js or app-3f9a2c1b.css; their
+        // content never changes under the same name, so clients may keep them indefinitely
+        bool isHashedAsset(const std::filesystem::path& path) {
+            const std::string stem = path.stem().string();
+            const size_t sep = stem.find_last_of(".-");
+            if (sep == std::string::npos || stem.size() - sep - 1 < 8) return false;
+            for (size_t i = sep + 1; i < stem.size(); ++i) {
+                if (!std::isxdigit(static_cast<unsigned char>(stem[i]))) return false;
             }
-            
-            if (cleanPath.length() >= 8 && cleanPath.substr(0, 8) == "/script/" && 
-                cleanPath.length() >= 3 && cleanPath.substr(cleanPath.length() - 3) == ".js") {
-                current_method_ = method;
-                current_path_ = cleanPath; // Use path as is
-                return true;
+            return true;
+        }
+
+        // If-None-Match against either variant of the ETag; weak validators compare equal too
+        bool etagMatches(const std::string& ifNoneMatch, const std::string& etag) {
+            const std::string gzipTag = etag.substr(0, etag.size() - 1) + "-gz\"";
+            size_t pos = 0;
+            while (pos < ifNoneMatch.size()) {
+                size_t comma = ifNoneMatch.find(',', pos);
+                if (comma == std::string::npos) comma = ifNoneMatch.size();
+                std::string tag = ifNoneMatch.substr(pos, comma - pos);
+                pos = comma + 1;
+                const size_t b = tag.find_first_not_of(" \t");
+                if (b == std::string::npos) continue;
+                tag = tag.substr(b, tag.find_last_not_of(" \t") - b + 1);
+                if (tag == "*") return true;
+                if (tag.compare(0, 2, "W/") == 0) tag = tag.substr(2);
+                if (tag == etag || tag == gzipTag) return true;
             }
+            return false;
+        }
+    }
+
+    UIRoute::UIRoute() = default;
+
+    bool UIRoute::match(const std::string &method, const std::string &path) {
+        return (method == "GET" || method == "OPTIONS") && !resolveFile(path).empty();
+    }
+
+    // File to serve for a UI path, or "" if the path is not one of ours
+    std::string UIRoute::resolveFile(const std::string &path) {
+        // Extract the path without query parameters
+        std::string cleanPath = path;
+        size_t queryPos = path.find('?');
+        if (queryPos != std::string::npos) {
+            cleanPath = path.substr(0, queryPos);
+        }
+        
+        // Match playground routes
+        if (cleanPath == "/playground" || cleanPath == "/playground/") {
+            return "/playground/playground.html";
+        }
+        
+        // Match direct playground.html access
+        if (cleanPath == "/playground/playground.html") {
+            return "/playground/playground.html";
+        }
+        
+        // Match dashboard routes
+        if (cleanPath == "/" || cleanPath == "/dashboard" || cleanPath == "/dashboard/") {
+            return "/index.html";
+        }
+        
+        // Match specific dashboard pages (both with and without /dashboard prefix)
+        if (cleanPath == "/dashboard/index" || cleanPath == "/dashboard/index.html" || 
+            cleanPath == "/index" || cleanPath == "/index.html") {
+            return "/index.html";
+        }
+        
+        if (cleanPath == "/dashboard/engine" || cleanPath == "/dashboard/engine.html" ||
+            cleanPath == "/engine" || cleanPath == "/engine.html") {
+            return "/engine.html";
+        }
+        
+        if (cleanPath == "/dashboard/collection" || cleanPath == "/dashboard/collection.html" ||
+            cleanPath == "/collection" || cleanPath == "/collection.html") {
+            return "/collection.html";
+        }
+        
+        if (cleanPath == "/dashboard/retrieve" || cleanPath == "/dashboard/retrieve.html" ||
+            cleanPath == "/retrieve" || cleanPath == "/retrieve.html") {
+            return "/retrieve.html";
+        }
+        
+        if (cleanPath == "/dashboard/upload" || cleanPath == "/dashboard/upload.html" ||
+            cleanPath == "/upload" || cleanPath == "/upload.html") {
+            return "/upload.html";
+        }
+        
+        // Match static assets (CSS, JS) - with /playground prefix
+        if (cleanPath.length() >= 19 && cleanPath.substr(0, 19) == "/playground/styles/" && 
+            cleanPath.length() >= 4 && cleanPath.substr(cleanPath.length() - 4) == ".css") {
+            return cleanPath; // Keep the full path for playground assets
+        }
+        
+        if (cleanPath.length() >= 19 && cleanPath.substr(0, 19) == "/playground/script/" && 
+            cleanPath.length() >= 3 && cleanPath.substr(cleanPath.length() - 3) == ".js") {
+            return cleanPath; // Keep the full path for playground assets
+        }
+        
+        // Match static assets (CSS, JS) - with /dashboard prefix
+        if (cleanPath.length() >= 18 && cleanPath.substr(0, 18) == "/dashboard/styles/" && 
+            cleanPath.length() >= 4 && cleanPath.substr(cleanPath.length() - 4) == ".css") {
+            return cleanPath.substr(10); // Remove "/dashboard" prefix
         }
         
-        return false;
+        if (cleanPath.length() >= 18 && cleanPath.substr(0, 18) == "/dashboard/script/" && 
+            cleanPath.length() >= 3 && cleanPath.substr(cleanPath.length() - 3) == ".js") {
+            return cleanPath.substr(10); // Remove "/dashboard" prefix
+        }
+        
+        // Match static assets (CSS, JS) - without /dashboard prefix
+        if (cleanPath.length() >= 8 && cleanPath.substr(0, 8) == "/styles/" && 
+            cleanPath.length() >= 4 && cleanPath.substr(cleanPath.length() - 4) == ".css") {
+            return cleanPath; // Use path as is
+        }
+        
+        if (cleanPath.length() >= 8 && cleanPath.substr(0, 8) == "/script/" && 
+            cleanPath.length() >= 3 && cleanPath.substr(cleanPath.length() - 3) == ".js") {
+            return cleanPath; // Use path as is
+        }
+
+        return {};
+    }
+
+    std::vector<RoutePattern> UIRoute::patterns() const {
+        return {
+            {"GET", "/"},
+            {"OPTIONS", "/"},
+            {"GET", "/playground"},
+            {"OPTIONS", "/playground"},
+            {"GET", "/playground/*"},
+            {"OPTIONS", "/playground/*"},
+            {"GET", "/dashboard"},
+            {"OPTIONS", "/dashboard"},
+            {"GET", "/dashboard/*"},
+            {"OPTIONS", "/dashboard/*"},
+            {"GET", "/index"},
+            {"OPTIONS", "/index"},
+            {"GET", "/index.html"},
+            {"OPTIONS", "/index.html"},
+            {"GET", "/engine"},
+            {"OPTIONS", "/engine"},
+            {"GET", "/engine.html"},
+            {"OPTIONS", "/engine.html"},
+            {"GET", "/collection"},
+            {"OPTIONS", "/collection"},
+            {"GET", "/collection.html"},
+            {"OPTIONS", "/collection.html"},
+            {"GET", "/retrieve"},
+            {"OPTIONS", "/retrieve"},
+            {"GET", "/retrieve.html"},
+            {"OPTIONS", "/retrieve.html"},
+            {"GET", "/upload"},
+            {"OPTIONS", "/upload"},
+            {"GET", "/upload.html"},
+            {"OPTIONS", "/upload.html"},
+            {"GET", "/styles/*"},
+            {"OPTIONS", "/styles/*"},
+            {"GET", "/script/*"},
+            {"OPTIONS", "/script/*"}
+        };
     }
 
-    void UIRoute::handle(SocketType sock, const std::string &body) {
+    void UIRoute::handle(SocketType sock, const RequestContext &request) {
+        // Startup does not wait for the UI; whoever opens it first pays for reading it
+        std::call_once(preloadOnce_, [this] { preload(); });
+        const std::string filePath = resolveFile(request.path);
         try {
             // Handle OPTIONS request for CORS preflight
-            if (current_method_ == "OPTIONS") {
-                ServerLogger::logDebug("[Thread %u] Handling OPTIONS request for UI endpoint: %s", 
-                                     std::this_thread::get_id(), current_path_.c_str());
+            if (request.method == "OPTIONS") {
+                KOLOSAL_LOG_REQUEST_DEBUG("[Thread %zu] Handling OPTIONS request for UI endpoint: %s", 
+                                     std::hash<std::thread::id>{}(std::this_thread::get_id()), filePath.c_str());
                 
                 std::map<std::string, std::string> headers = {
                     {"Content-Type", "text/plain"},
@@ -143,18 +208,14 @@ namespace kolosal {
                 return;
             }
 
-            ServerLogger::logDebug("[Thread %u] Serving UI file: %s", 
-                                 std::this_thread::get_id(), current_path_.c_str());
+            KOLOSAL_LOG_REQUEST_DEBUG("[Thread %zu] Serving UI file: %s", 
+                                 std::hash<std::thread::id>{}(std::this_thread::get_id()), filePath.c_str());
 
-            // Determine content type
-            std::string contentType = getContentType(current_path_);
-            
-            // Serve the file
-            serveStaticFile(sock, current_path_, contentType);
+            serveStaticFile(sock, request, filePath);
             
         } catch (const std::exception &ex) {
-            ServerLogger::logError("[Thread %u] Error serving UI file %s: %s", 
-                                 std::this_thread::get_id(), current_path_.c_str(), ex.what());
+            KOLOSAL_LOG_ERROR("[Thread %zu] Error serving UI file %s: %s", 
+                                 std::hash<std::thread::id>{}(std::this_thread::get_id()), filePath.c_str(), ex.what());
             serve404(sock);
         }
     }
@@ -183,68 +244,184 @@ namespace kolosal {
         return "text/plain; charset=utf-8";
     }
 
-    std::string UIRoute::readStaticFile(const std::string& relativePath) {
-        // Determine which static directory to use based on the path
-        std::filesystem::path staticDir;
-        std::filesystem::path filePath;
-        
-        // Get the absolute path to the executable's directory
-        std::filesystem::path executablePath = std::filesystem::current_path();
-        
+    // Disk location of a resolved UI path
+    std::filesystem::path UIRoute::staticPath(const std::string& relativePath) {
+        std::filesystem::path staticRoot = std::filesystem::current_path() / "static";
         if (relativePath.find("/playground/") == 0) {
-            // This is a playground file
-            staticDir = executablePath / "static" / "kolosal-playground";
-            filePath = relativePath.substr(12); // Remove "/playground/" prefix
-        } else {
-            // This is a dashboard file
-            staticDir = executablePath / "static" / "kolosal-dashboard";
-            filePath = relativePath.substr(1); // Remove leading slash
+            return staticRoot / "kolosal-playground" / relativePath.substr(12); // Remove "/playground/" prefix
         }
-        
-        std::filesystem::path fullPath = staticDir / filePath;
-        
-        // Security check: ensure the path is within the static directory
-        std::filesystem::path canonicalPath = std::filesystem::canonical(fullPath.parent_path()) / fullPath.filename();
-        std::filesystem::path canonicalStatic = std::filesystem::canonical(staticDir);
-        
-        // Check if the canonical path starts with the canonical static directory
-        std::string pathStr = canonicalPath.string();
-        std::string staticStr = canonicalStatic.string();
-        if (pathStr.find(staticStr) != 0) {
-            throw std::runtime_error("Path traversal attack detected");
-        }
-        
-        // Read the file
-        std::ifstream file(canonicalPath, std::ios::binary);
+        return staticRoot / "kolosal-dashboard" / relativePath.substr(1); // Remove leading slash
+    }
+
+    std::shared_ptr<const UIRoute::StaticAsset> UIRoute::loadAsset(const std::filesystem::path& fullPath) {
+        auto asset = std::make_shared<StaticAsset>();
+        asset->fullPath = fullPath;
+        asset->modified = std::filesystem::last_write_time(fullPath);
+
+        std::ifstream file(fullPath, std::ios::binary);
         if (!file.is_open()) {
-            throw std::runtime_error("File not found: " + relativePath);
+            throw std::runtime_error("File not found: " + fullPath.string());
         }
-        
         std::stringstream buffer;
         buffer << file.rdbuf();
-        return buffer.str();
+        asset->content = buffer.str();
+        asset->size = asset->content.size();
+
+        Sha256 hasher;
+        hasher.update(asset->content.data(), asset->content.size());
+        asset->etag = "\"" + hasher.hexDigest().substr(0, 16) + "\"";
+        asset->contentType = getContentType(fullPath.string());
+
+        // A .gz next to the file, as a build step may leave, wins over compressing here
+        std::filesystem::path gzPath = fullPath;
+        gzPath += ".gz";
+        std::error_code ec;
+        if (std::filesystem::is_regular_file(gzPath, ec) &&
+            std::filesystem::last_write_time(gzPath, ec) >= asset->modified) {
+            std::ifstream gz(gzPath, std::ios::binary);
+            std::stringstream gzBuffer;
+            gzBuffer << gz.rdbuf();
+            asset->gzip = gzBuffer.str();
+        } else if (http_internal::is_compressible(asset->contentType)) {
+            asset->gzip = http_internal::gzip_compress(asset->content, 9);
+        }
+
+        // Pages are revalidated on every load so a new build shows up at once (a 304 costs
+        // nothing); fingerprinted files are immutable
+        if (asset->contentType.compare(0, 9, "text/html") == 0) {
+            asset->cacheControl = "no-cache";
+        } else if (isHashedAsset(fullPath)) {
+            asset->cacheControl = "public, max-age=31536000, immutable";
+        } else {
+            asset->cacheControl = "public, max-age=3600";
+        }
+
+        asset->recheckAfterMs.store(steadyNowMs() + kRevalidateMs, std::memory_order_relaxed);
+        return asset;
+    }
+
+    void UIRoute::preload() {
+        const std::filesystem::path staticRoot = std::filesystem::current_path() / "static";
+        const std::pair<const char*, const char*> trees[] = {
+            {"kolosal-dashboard", "/"},
+            {"kolosal-playground", "/playground/"}
+        };
+
+        size_t files = 0, bytes = 0;
+        for (const auto& [dir, prefix] : trees) {
+            const std::filesystem::path root = staticRoot / dir;
+            std::error_code ec;
+            if (!std::filesystem::is_directory(root, ec)) continue;
+
+            for (auto it = std::filesystem::recursive_directory_iterator(root, ec);
+                 !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec)) {
+                if (!it->is_regular_file(ec) || it->path().extension() == ".gz") continue;
+                std::string key = prefix + it->path().lexically_relative(root).generic_string();
+                try {
+                    auto asset = loadAsset(it->path());
+                    bytes += asset->size;
+                    ++files;
+                    std::unique_lock<std::shared_mutex> lock(cacheMutex_);
+                    cache_[key] = std::move(asset);
+                } catch (const std::exception& ex) {
+                    KOLOSAL_LOG_WARNING("Could not preload UI file %s: %s", it->path().string().c_str(), ex.what());
+                }
+            }
+        }
+        if (files > 0) {
+            KOLOSAL_LOG_INFO("Loaded %zu UI files (%zu KB) into memory", files, bytes / 1024);
+        }
     }
 
-    void UIRoute::serveStaticFile(SocketType sock, const std::string& filePath, const std::string& contentType) {
+    // The cached asset for a resolved UI path. The disk is only touched on a miss or once the
+    // asset is due for revalidation, and then just to compare mtime and size unless it changed.
+    std::shared_ptr<const UIRoute::StaticAsset> UIRoute::getAsset(const std::string& relativePath) {
+        std::shared_ptr<const StaticAsset> cached;
+        {
+            std::shared_lock<std::shared_mutex> lock(cacheMutex_);
+            auto it = cache_.find(relativePath);
+            if (it != cache_.end()) cached = it->second;
+        }
+
+        const int64_t now = steadyNowMs();
+        if (cached && now < cached->recheckAfterMs.load(std::memory_order_relaxed)) {
+            return cached;
+        }
+
+        std::filesystem::path fullPath;
+        if (cached) {
+            fullPath = cached->fullPath;
+            std::error_code ec;
+            auto modified = std::filesystem::last_write_time(fullPath, ec);
+            auto size = ec ? 0 : std::filesystem::file_size(fullPath, ec);
+            if (!ec && modified == cached->modified && size == cached->size) {
+                cached->recheckAfterMs.store(now + kRevalidateMs, std::memory_order_relaxed);
+                return cached;
+            }
+        } else {
+            // First request for a file not present at startup: make sure it stays inside
+            // the static directory before it is cached under this name
+            fullPath = staticPath(relativePath);
+            std::filesystem::path staticRoot = std::filesystem::canonical(std::filesystem::current_path() / "static");
+            std::filesystem::path canonicalPath = std::filesystem::canonical(fullPath);
+            if (canonicalPath.string().find(staticRoot.string()) != 0) {
+                throw std::runtime_error("Path traversal attack detected");
+            }
+        }
+
+        std::shared_ptr<const StaticAsset> fresh;
         try {
-            std::string content = readStaticFile(filePath);
-            
+            fresh = loadAsset(fullPath);
+        } catch (...) {
+            std::unique_lock<std::shared_mutex> lock(cacheMutex_);
+            cache_.erase(relativePath);
+            throw;
+        }
+        std::unique_lock<std::shared_mutex> lock(cacheMutex_);
+        cache_[relativePath] = fresh;
+        return fresh;
+    }
+
+    void UIRoute::serveStaticFile(SocketType sock, const RequestContext& request, const std::string& filePath) {
+        try {
+            std::shared_ptr<const StaticAsset> asset = getAsset(filePath);
+
             std::map<std::string, std::string> headers = {
-                {"Content-Type", contentType},
+                {"Content-Type", asset->contentType},
                 {"Access-Control-Allow-Origin", "*"},
                 {"Access-Control-Allow-Methods", "GET, OPTIONS"},
                 {"Access-Control-Allow-Headers", "Content-Type, Authorization, X-API-Key"},
-                {"Cache-Control", "public, max-age=3600"} // Cache for 1 hour
+                {"Cache-Control", asset->cacheControl},
+                {"ETag", asset->etag}
             };
-            
-            send_response(sock, 200, content, headers);
-            
-            ServerLogger::logDebug("[Thread %u] Successfully served %s (%zu bytes)", 
-                                 std::this_thread::get_id(), filePath.c_str(), content.size());
+            if (!asset->gzip.empty()) {
+                headers["Vary"] = "Accept-Encoding";
+            }
+
+            auto ifNoneMatch = request.headers.find("if-none-match");
+            if (ifNoneMatch != request.headers.end() && etagMatches(ifNoneMatch->second, asset->etag)) {
+                send_response(sock, 304, "", headers);
+                return;
+            }
+
+            // The precompressed copy is sent as it is; other codings are left to send_response
+            const std::string* body = &asset->content;
+            auto acceptEncoding = request.headers.find("accept-encoding");
+            if (!asset->gzip.empty() && acceptEncoding != request.headers.end() &&
+                http_internal::negotiate_coding(acceptEncoding->second) == http_internal::ContentCoding::Gzip) {
+                body = &asset->gzip;
+                headers["Content-Encoding"] = "gzip";
+                headers["ETag"] = asset->etag.substr(0, asset->etag.size() - 1) + "-gz\"";
+            }
+
+            send_response(sock, 200, *body, headers);
+
+            KOLOSAL_LOG_REQUEST_DEBUG("[Thread %zu] Successfully served %s (%zu bytes)", 
+                                 std::hash<std::thread::id>{}(std::this_thread::get_id()), filePath.c_str(), body->size());
                                  
         } catch (const std::exception &ex) {
-            ServerLogger::logError("[Thread %u] Failed to serve %s: %s", 
-                                 std::this_thread::get_id(), filePath.c_str(), ex.what());
+            KOLOSAL_LOG_ERROR("[Thread %zu] Failed to serve %s: %s", 
+                                 std::hash<std::thread::id>{}(std::this_thread::get_id()), filePath.c_str(), ex.what());
             serve404(sock);
         }
     }
@@ -0,0 +1,317 @@
+#include "kolosal/semantic_cache.hpp"
+#include "kolosal/logger.hpp"
+#include "kolosal/sha256.hpp"
+#include "kolosal/vector_math.hpp"
+#include <algorithm>
+#include <iterator>
+
+#ifdef USE_FAISS
+#include <faiss/IndexFlat.h>
+#include <faiss/impl/IDSelector.h>
+#endif
+
+namespace kolosal
+{
+
+namespace
+{
+    constexpr size_t kEntryOverheadBytes = 192;     // List node, map node, shared state, group row and vector headers
+}
+
+// Answers sharing a model and context: their message embeddings, one row per entry
+class SemanticCache::Group
+{
+public:
+    explicit Group(size_t dimensions)
+        : dimensions_(dimensions)
+#ifdef USE_FAISS
+        , index_(static_cast<faiss::idx_t>(dimensions))
+#endif
+    {
+    }
+
+    size_t dimensions() const { return dimensions_; }
+    bool empty() const { return ids_.empty(); }
+
+    void add(uint64_t id, const std::vector<float>& embedding)
+    {
+#ifdef USE_FAISS
+        index_.add(1, embedding.data());
+#else
+        vectors_.insert(vectors_.end(), embedding.begin(), embedding.end());
+#endif
+        ids_.push_back(id);
+    }
+
+    void remove(uint64_t id)
+    {
+        auto it = std::find(ids_.begin(), ids_.end(), id);
+        if (it == ids_.end())
+        {
+            return;
+        }
+        const size_t row = static_cast<size_t>(it - ids_.begin());
+#ifdef USE_FAISS
+        // A flat index compacts its rows, so the later ones shift down like ids_
+        faiss::IDSelectorRange selector(static_cast<faiss::idx_t>(row), static_cast<faiss::idx_t>(row + 1));
+        index_.remove_ids(selector);
+#else
+        vectors_.erase(vectors_.begin() + row * dimensions_, vectors_.begin() + (row + 1) * dimensions_);
+#endif
+        ids_.erase(it);
+    }
+
+    // Entry with the highest inner product with the query
+    bool nearest(const std::vector<float>& query, uint64_t& id, float& score) const
+    {
+        if (ids_.empty())
+        {
+            return false;
+        }
+#ifdef USE_FAISS
+        faiss::idx_t row = -1;
+        index_.search(1, query.data(), 1, &score, &row);
+        if (row < 0 || static_cast<size_t>(row) >= ids_.size())
+        {
+            return false;
+        }
+        id = ids_[static_cast<size_t>(row)];
+#else
+        size_t best = 0;
+        score = -2.0f;
+        for (size_t row = 0; row < ids_.size(); ++row)
+        {
+            const float* vector = vectors_.data() + row * dimensions_;
+            const float dot = vecmath::dot(vector, query.data(), dimensions_);
+            if (dot > score)
+            {
+                score = dot;
+                best = row;
+            }
+        }
+        id = ids_[best];
+#endif
+        return true;
+    }
+
+private:
+    size_t dimensions_;
+    std::vector<uint64_t> ids_;
+#ifdef USE_FAISS
+    faiss::IndexFlatIP index_;
+#else
+    std::vector<float> vectors_;
+#endif
+};
+
+SemanticCache::SemanticCache() = default;
+SemanticCache::~SemanticCache() = default;
+
+SemanticCache& SemanticCache::instance()
+{
+    static SemanticCache cache;
+    return cache;
+}
+
+void SemanticCache::configure(const ResponseCacheConfig& config)
+{
+    const auto& semantic = config.semantic;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        enabled_ = semantic.enabled && !semantic.embedding_model.empty();
+        embedding_model_ = semantic.embedding_model;
+        threshold_ = semantic.threshold;
+        max_entries_ = static_cast<size_t>(std::max(0, semantic.max_entries));
+        entry_limit_ = static_cast<size_t>(std::max(0, config.max_entry_kb)) * 1024;
+        ttl_ = std::chrono::seconds(std::max(0, config.ttl_seconds));
+        lru_.clear();
+        entries_.clear();
+        groups_.clear();
+        bytes_ = 0;
+    }
+
+    if (semantic.enabled)
+    {
+        KOLOSAL_LOG_INFO("Semantic cache enabled (embedding model '%s', similarity >= %.3f, %d entries)",
+                              semantic.embedding_model.c_str(), semantic.threshold, semantic.max_entries);
+    }
+}
+
+std::string SemanticCache::embeddingModel() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return embedding_model_;
+}
+
+std::string SemanticCache::groupKey(const std::string& model_id, const std::string& context)
+{
+    // Contexts carry whole system prompts and histories; groups keep only their digest
+    Sha256 hasher;
+    hasher.update(context.data(), context.size());
+    std::string key;
+    key.reserve(model_id.size() + 65);
+    key.append(model_id).push_back('\0');
+    key.append(hasher.hexDigest());
+    return key;
+}
+
+void SemanticCache::eraseLocked(std::list<Entry>::iterator it)
+{
+    auto group = groups_.find(it->group);
+    if (group != groups_.end())
+    {
+        group->second->remove(it->id);
+        if (group->second->empty())
+        {
+            groups_.erase(group);
+        }
+    }
+    bytes_ -= it->bytes;
+    entries_.erase(it->id);
+    lru_.erase(it);
+}
+
+uint64_t SemanticCache::generation(const std::string& model_id) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = generations_.find(model_id);
+    return it == generations_.end() ? 0 : it->second;
+}
+
+std::shared_ptr<const ResponseCache::Response> SemanticCache::get(const std::string& model_id, const std::string& context,
+                                                                  const std::vector<float>& embedding, float* similarity)
+{
+    if (!enabled() || embedding.empty())
+    {
+        return nullptr;
+    }
+
+    const std::string key = groupKey(model_id, context);
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto group = groups_.find(key);
+    uint64_t id = 0;
+    float score = 0.0f;
+    if (group == groups_.end() || group->second->dimensions() != embedding.size() ||
+        !group->second->nearest(embedding, id, score) || score < threshold_)
+    {
+        misses_.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    auto it = entries_.find(id);
+    if (it == entries_.end())
+    {
+        misses_.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    if (ttl_.count() > 0 && std::chrono::steady_clock::now() >= it->second->expires)
+    {
+        eraseLocked(it->second);
+        expirations_.fetch_add(1, std::memory_order_relaxed);
+        misses_.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    lru_.splice(lru_.begin(), lru_, it->second);
+    hits_.fetch_add(1, std::memory_order_relaxed);
+    if (similarity)
+    {
+        *similarity = score;
+    }
+    return it->second->response;
+}
+
+void SemanticCache::put(const std::string& model_id, const std::string& context, uint64_t generation,
+                        std::vector<float> embedding, ResponseCache::Response response)
+{
+    if (!enabled() || embedding.empty() || response.choices.empty())
+    {
+        return;
+    }
+
+    std::string key = groupKey(model_id, context);
+    size_t bytes = key.size() + model_id.size() + embedding.size() * sizeof(float) + kEntryOverheadBytes;
+    for (const auto& pieces : response.choices)
+    {
+        for (const auto& piece : pieces)
+        {
+            bytes += piece.size() + sizeof(std::string);
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (bytes > entry_limit_ || max_entries_ == 0)
+    {
+        return;
+    }
+    auto generationIt = generations_.find(model_id);
+    if (generation != (generationIt == generations_.end() ? 0 : generationIt->second))
+    {
+        return;
+    }
+
+    auto& group = groups_[key];
+    if (!group)
+    {
+        group = std::make_unique<Group>(embedding.size());
+    }
+    else if (group->dimensions() != embedding.size())
+    {
+        return;
+    }
+
+    Entry entry;
+    entry.id = ++next_id_;
+    entry.group = std::move(key);
+    entry.model_id = model_id;
+    entry.response = std::make_shared<const ResponseCache::Response>(std::move(response));
+    entry.expires = std::chrono::steady_clock::now() + ttl_;
+    entry.bytes = bytes;
+    group->add(entry.id, embedding);
+    lru_.push_front(std::move(entry));
+    entries_.emplace(lru_.front().id, lru_.begin());
+    bytes_ += bytes;
+
+    while (entries_.size() > max_entries_ && !lru_.empty())
+    {
+        eraseLocked(std::prev(lru_.end()));
+        evictions_.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void SemanticCache::invalidateModel(const std::string& model_id)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    generations_[model_id] = ++next_generation_;
+
+    size_t dropped = 0;
+    for (auto it = lru_.begin(); it != lru_.end();)
+    {
+        auto next = std::next(it);
+        if (it->model_id == model_id)
+        {
+            eraseLocked(it);
+            ++dropped;
+        }
+        it = next;
+    }
+    if (dropped > 0)
+    {
+        KOLOSAL_LOG_INFO("Semantic cache: dropped %zu answer(s) of model '%s'", dropped, model_id.c_str());
+    }
+}
+
+SemanticCache::Stats SemanticCache::stats() const
+{
+    Stats stats;
+    stats.hits = hits_.load(std::memory_order_relaxed);
+    stats.misses = misses_.load(std::memory_order_relaxed);
+    stats.evictions = evictions_.load(std::memory_order_relaxed);
+    stats.expirations = expirations_.load(std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats.entries = entries_.size();
+    stats.bytes = bytes_;
+    return stats;
+}
+
+} // namespace kolosal
@@ -1,15 +1,28 @@
 #include "kolosal/server.hpp"
+#include "kolosal/event_loop.hpp"
+#include "kolosal/worker_pool.hpp"
+#include "kolosal/request_body.hpp"
+#include "kolosal/http_parser.hpp"
 #include "kolosal/utils.hpp"
 #include "kolosal/logger.hpp"
+#include "kolosal/metrics.hpp"
+#include "kolosal/tracing.hpp"
+#include "kolosal/access_log.hpp"
+#include "kolosal/traffic_capture.hpp"
+#include "kolosal/request_arena.hpp"
+#include "kolosal/cpu_profiler.hpp"
 #include <iostream>
 #include <cstring>
 #include <thread>
 #include <vector>
 #include <mutex>
+#include <chrono>
+#include <unordered_map>
 #include <json.hpp>
 #include <algorithm>
 #include <cctype>
 #include <sstream>
+#include <string_view>
 
 #ifdef _WIN32
 #include <winsock2.h>
@@ -22,6 +35,18 @@
 #include <arpa/inet.h>
 #include <unistd.h>
 #include <netdb.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+extern char **environ;
+#endif
+
+// Linux spreads connections over sockets sharing a port with SO_REUSEPORT; other
+// systems accept the option without balancing, so there acceptors share one socket
+#if defined(__linux__) && defined(SO_REUSEPORT)
+#define KOLOSAL_REUSEPORT_BALANCES
 #endif
 
 namespace kolosal
@@ -42,148 +67,162 @@ namespace kolosal
 #endif
 		return std::string(clientIP);
 	}
-	// Helper: parse HTTP headers from request with improved error handling
-	static std::map<std::string, std::string> parseHeaders(const std::string &request)
+	// Helper: close a client socket, saying goodbye first on TLS
+	static void closeSocket(SocketType sock)
 	{
-		std::map<std::string, std::string> headers;
-
-		// Find the first \r\n (end of request line)
-		size_t start = request.find("\r\n");
-		if (start == std::string::npos)
-		{
-			// Try with just \n in case of Unix line endings
-			start = request.find('\n');
-			if (start == std::string::npos)
-				return headers;
-			start += 1;
-		}
-		else
-		{
-			start += 2;
-		}
-
-		// Find the end of headers
-		size_t end = request.find("\r\n\r\n", start);
-		if (end == std::string::npos)
-		{
-			// Try with just \n\n
-			end = request.find("\n\n", start);
-			if (end == std::string::npos)
-				end = request.length(); // Use entire string if no clear end
-		}
-
-		std::string headerSection = request.substr(start, end - start);
-		
-		// Parse each header line
-		std::istringstream headerStream(headerSection);
-		std::string line;
-
-		while (std::getline(headerStream, line) && !line.empty())
-		{
-			// Remove both \r and \n characters
-			line.erase(std::remove(line.begin(), line.end(), '\r'), line.end());
-			line.erase(std::remove(line.begin(), line.end(), '\n'), line.end());
-			
-			if (line.empty()) continue;
-
-			size_t colonPos = line.find(':');
-			if (colonPos != std::string::npos)
-			{
-				std::string name = line.substr(0, colonPos);
-				std::string value = line.substr(colonPos + 1);
-
-				// Trim whitespace from name and value
-				name.erase(0, name.find_first_not_of(" \t"));
-				name.erase(name.find_last_not_of(" \t") + 1);
-				value.erase(0, value.find_first_not_of(" \t"));
-				value.erase(value.find_last_not_of(" \t") + 1);
+		if (auto channel = kolosal::http_internal::SecureChannels::instance().remove(sock))
+			channel->shutdown();
+#ifdef _WIN32
+		closesocket(sock);
+#else
+		close(sock);
+#endif
+	}
 
-				// Convert header name to lowercase for case-insensitive lookup
-				std::transform(name.begin(), name.end(), name.begin(), ::tolower);
-				headers[name] = value;
-			}
-		}
+	// Helper: close a listening socket
+	static void closeListener(SocketType sock)
+	{
+#ifdef _WIN32
+		closesocket(sock);
+#else
+		close(sock);
+#endif
+	}
 
-		return headers;
+	// Helper: toggle non-blocking mode on a socket
+	static bool setNonBlocking(SocketType sock, bool enabled)
+	{
+#ifdef _WIN32
+		u_long mode = enabled ? 1 : 0;
+		return ioctlsocket(sock, FIONBIO, &mode) == 0;
+#else
+		int flags = fcntl(sock, F_GETFL, 0);
+		if (flags == -1)
+			return false;
+		flags = enabled ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK);
+		return fcntl(sock, F_SETFL, flags) == 0;
+#endif
 	}
 
-	// Helper: parse the first line of the HTTP request
-	static void parse_request_line(const std::string &requestLine,
-								   std::string &method, std::string &path)
+	// Helper: true if the last socket call failed only because it would block
+	static bool wouldBlock()
 	{
-		size_t first = requestLine.find(' ');
-		if (first == std::string::npos)
-			return;
-		method = requestLine.substr(0, first);
-		size_t second = requestLine.find(' ', first + 1);
-		if (second == std::string::npos)
-			return;
-		path = requestLine.substr(first + 1, second - first - 1);
+#ifdef _WIN32
+		return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+		return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+#endif
 	}
 
-	// Thread function to handle a client request
-	void handle_client(SocketType client_sock,
-					   const std::vector<std::unique_ptr<IRoute>> &routes,
-					   const std::string &request,
-					   const char *clientIP)
+	// Helper: wait up to timeoutMs for room in the socket's send buffer
+	static bool waitWritable(SocketType sock, int timeoutMs)
 	{
-		// Parse the HTTP request line
-		size_t pos = request.find("\r\n");
-		if (pos == std::string::npos)
-		{
-			ServerLogger::logWarning("Malformed request received from %s", clientIP);
-			send_response(client_sock, 400, "{\"error\":\"Bad Request\"}");
 #ifdef _WIN32
-			closesocket(client_sock);
+		WSAPOLLFD pfd{sock, POLLWRNORM, 0};
+		return WSAPoll(&pfd, 1, timeoutMs) > 0;
 #else
-			close(client_sock);
+		struct pollfd pfd{sock, POLLOUT, 0};
+		return poll(&pfd, 1, timeoutMs) > 0;
 #endif
-			return;
-		}
-		std::string requestLine = request.substr(0, pos);
-		std::string method, path;
-		parse_request_line(requestLine, method, path);
+	}
 
-		ServerLogger::logInfo("[Thread %u] Processing %s request for %s from %s",
-							  std::this_thread::get_id(), method.c_str(), path.c_str(), clientIP);
+	// Helper: decide whether the client asked for a persistent connection
+	static bool clientWantsKeepAlive(int minorVersion, std::string_view connectionHeader)
+	{
+		std::string connection(connectionHeader);
+		std::transform(connection.begin(), connection.end(), connection.begin(), ::tolower);
 
-		// Extract body (if any)
-		size_t headerEnd = request.find("\r\n\r\n");
-		std::string body;
-		if (headerEnd != std::string::npos)
-			body = request.substr(headerEnd + 4);
+		// HTTP/1.1 defaults to persistent connections, HTTP/1.0 must opt in
+		if (minorVersion == 0)
+			return connection.find("keep-alive") != std::string::npos;
+		return connection.find("close") == std::string::npos;
+	}
 
-		bool routeFound = false;
-		for (const auto &route : routes)
+	// Reads the top-level "model" of a JSON body without building the document, stopping
+	// at it; requests name the model ahead of their messages, so little is scanned
+	class ModelFieldReader : public nlohmann::json_sax<nlohmann::json>
+	{
+	public:
+		std::string model;
+
+		bool null() override { wanted_ = false; return true; }
+		bool boolean(bool) override { wanted_ = false; return true; }
+		bool number_integer(number_integer_t) override { wanted_ = false; return true; }
+		bool number_unsigned(number_unsigned_t) override { wanted_ = false; return true; }
+		bool number_float(number_float_t, const string_t &) override { wanted_ = false; return true; }
+		bool binary(binary_t &) override { wanted_ = false; return true; }
+		bool string(string_t &value) override
 		{
-			if (route->match(method, path))
-			{
-				routeFound = true;
-				route->handle(client_sock, body);
-				break;
-			}
+			if (!wanted_)
+				return true;
+			model = std::move(value);
+			return false;
 		}
-
-		if (!routeFound)
+		bool key(string_t &name) override
 		{
-			ServerLogger::logWarning("No route found for %s %s", method.c_str(), path.c_str());
-			send_response(client_sock, 404, "{\"error\":\"Not Found\"}");
+			wanted_ = depth_ == 1 && name == "model";
+			return true;
 		}
-
-#ifdef _WIN32
-		closesocket(client_sock);
-#else
-		close(client_sock);
-#endif
-		ServerLogger::logInfo("[Thread %u] Completed request for %s",
-							  std::this_thread::get_id(), path.c_str());
+		bool start_object(std::size_t) override { ++depth_; wanted_ = false; return true; }
+		bool end_object() override { --depth_; return true; }
+		bool start_array(std::size_t) override { ++depth_; wanted_ = false; return true; }
+		bool end_array() override { --depth_; return true; }
+		bool parse_error(std::size_t, const std::string &, const nlohmann::detail::exception &) override { return false; }
+
+	private:
+		int depth_ = 0;
+		bool wanted_ = false;
+	};
+
+	static std::string bodyModel(const char *first, const char *last)
+	{
+		ModelFieldReader reader;
+		nlohmann::json::sax_parse(first, last, &reader);
+		return reader.model;
 	}
-	Server::Server(const std::string &port, const std::string &host) : port(port), host(host), running(false)
+
+	// Read state for a connection while an I/O thread owns it
+	struct Server::Connection
+	{
+		SocketType sock;
+		std::string clientIP;
+		std::string buffer;                   // May hold the start of a pipelined follow-up request
+		HttpRequestParser parser;             // Progress through the request at the front of buffer
+		bool streamBody = false;              // Dispatched before its body arrived; see RequestBody
+		std::unique_ptr<RequestBody> body;    // Set by the worker for a streamed body
+		size_t requestsServed = 0;
+		bool unixSocket = false;              // Accepted on the Unix domain socket listener
+		bool probeOnly = false;               // Accepted on the probe port: probes only, answered on the I/O thread
+		std::shared_ptr<TlsConnection> tls;   // TLS state; registered as the socket's secure channel after the handshake
+		bool handshaking = false;             // TLS handshake still in progress
+		IoThread *owner = nullptr;            // I/O thread the connection returns to between requests
+		std::chrono::steady_clock::time_point lastActivity = std::chrono::steady_clock::now();
+	};
+
+	// One event loop plus the connections it is reading from
+	struct Server::IoThread
+	{
+		EventLoop loop;
+		std::thread thread;
+		std::mutex pendingMutex;
+		std::vector<std::shared_ptr<Connection>> pending; // Accepted but not yet registered
+		std::unordered_map<Connection *, std::shared_ptr<Connection>> connections;
+	};
+
+	// Handler threads set aside for one request class or model; see ServerOptions::classBulkheads
+	struct Server::Bulkhead
+	{
+		std::unique_ptr<WorkerPool> pool;
+		size_t maxQueued = 0;   // 0 = unbounded
+	};
+
+	Server::Server(const std::string &port, const std::string &host, const ServerOptions &options)
+		: port(port), host(host), options_(options), running(false)
 	{
 #ifdef _WIN32
-		listen_sock = INVALID_SOCKET;
+		unix_sock = INVALID_SOCKET;
 #else
-		listen_sock = -1;
+		unix_sock = -1;
 #endif
 		// Initialize authentication middleware with default settings
 		authMiddleware_ = std::make_unique<auth::AuthMiddleware>();
@@ -192,13 +231,22 @@ namespace kolosal
 	Server::~Server()
 	{
 		stop();
+		for (SocketType sock : listenSocks_)
+			closeListener(sock);
+		listenSocks_.clear();
+		if (probeListening_)
+			closeListener(probeSock_);
+		probeListening_ = false;
 #ifdef _WIN32
-		if (listen_sock != INVALID_SOCKET)
-			closesocket(listen_sock);
 		WSACleanup();
 #else
-		if (listen_sock != -1)
-			close(listen_sock);
+		if (unix_sock != -1)
+		{
+			close(unix_sock);
+			// A successor listens on the same socket file
+			if (!handedOver_)
+				unlink(options_.unixSocketPath.c_str());
+		}
 #endif
 	}
 
@@ -208,11 +256,112 @@ namespace kolosal
 		WSADATA wsaData;
 		if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
 		{
-			ServerLogger::logError("WSAStartup failed");
+			KOLOSAL_LOG_ERROR("WSAStartup failed");
+			return false;
+		}
+#else
+		// A client that disconnects mid-response must fail the write, not kill the process;
+		// handlers notice the failure (client_disconnected) and stop their jobs
+		signal(SIGPIPE, SIG_IGN);
+#endif
+
+		// Started by spawnSuccessor(): serve on the predecessor's sockets instead of binding
+		const bool inherited = adoptInheritedSockets();
+		if (!inherited && !listenTcp())
 			return false;
+
+		if (!options_.tls.certFile.empty())
+		{
+			try
+			{
+				tls_ = std::make_unique<TlsContext>(options_.tls);
+			}
+			catch (const std::exception &ex)
+			{
+				KOLOSAL_LOG_ERROR("%s", ex.what());
+				return false;
+			}
 		}
+
+		KOLOSAL_LOG_INFO("Server initialized and listening on %s:%s%s (%zu listener%s%s)",
+							  host.c_str(), port.c_str(), tls_ ? " (TLS)" : "", listenSocks_.size(),
+							  listenSocks_.size() == 1 ? "" : "s", inherited ? ", inherited" : "");
+
+		// Without its own port, probes are still answered ahead of the handlers on the main one
+		if (!options_.probePort.empty() && listenProbe())
+			KOLOSAL_LOG_INFO("Answering health probes on %s:%s", host.c_str(), options_.probePort.c_str());
+
+#ifndef _WIN32
+		if (unix_sock != -1)
+			return true;
 #endif
+		if (!options_.unixSocketPath.empty() && !listenUnix())
+			return false;
+		return true;
+	}
+
+	bool Server::listenProbe()
+	{
+		struct addrinfo hints, *servinfo;
+		std::memset(&hints, 0, sizeof(hints));
+		hints.ai_family = AF_INET;
+		hints.ai_socktype = SOCK_STREAM;
+		hints.ai_flags = AI_PASSIVE;
+		const char *bind_host = (host == "0.0.0.0") ? NULL : host.c_str();
+		if (getaddrinfo(bind_host, options_.probePort.c_str(), &hints, &servinfo) != 0 || servinfo == nullptr)
+		{
+			KOLOSAL_LOG_WARNING("Cannot resolve probe port %s; probes are answered on the main port only", options_.probePort.c_str());
+			return false;
+		}
 
+		SocketType sock = socket(servinfo->ai_family, servinfo->ai_socktype, servinfo->ai_protocol);
+#ifdef _WIN32
+		bool ok = sock != INVALID_SOCKET;
+#else
+		bool ok = sock != -1;
+		if (ok)
+			fcntl(sock, F_SETFD, FD_CLOEXEC);
+#endif
+		int yes = 1;
+		ok = ok && setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char *>(&yes), sizeof(yes)) != -1;
+#ifdef KOLOSAL_REUSEPORT_BALANCES
+		// The probe socket is not handed over on upgrade; the successor binds the port alongside
+		ok = ok && setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, &yes, sizeof(yes)) != -1;
+#endif
+		ok = ok && bind(sock, servinfo->ai_addr, static_cast<int>(servinfo->ai_addrlen)) != -1;
+		ok = ok && listen(sock, SOMAXCONN) != -1 && setNonBlocking(sock, true);
+		freeaddrinfo(servinfo);
+		if (!ok)
+		{
+			KOLOSAL_LOG_WARNING("Cannot listen on probe port %s; probes are answered on the main port only", options_.probePort.c_str());
+#ifdef _WIN32
+			if (sock != INVALID_SOCKET)
+#else
+			if (sock != -1)
+#endif
+				closeListener(sock);
+			return false;
+		}
+		probeSock_ = sock;
+		probeListening_ = true;
+		return true;
+	}
+
+	size_t Server::acceptorCount() const
+	{
+		if (options_.acceptThreads > 0)
+			return static_cast<size_t>(options_.acceptThreads);
+#ifdef KOLOSAL_REUSEPORT_BALANCES
+		// One per I/O thread, matching run()'s default
+		const size_t hw = std::max(1u, std::thread::hardware_concurrency());
+		return options_.ioThreads > 0 ? static_cast<size_t>(options_.ioThreads) : std::min<size_t>(hw, 4);
+#else
+		return 1;
+#endif
+	}
+
+	bool Server::listenTcp()
+	{
 		struct addrinfo hints, *servinfo, *p;
 		std::memset(&hints, 0, sizeof(hints));
 		hints.ai_family = AF_INET;
@@ -224,84 +373,365 @@ namespace kolosal
 		if ((rv = getaddrinfo(bind_host, port.c_str(), &hints, &servinfo)) != 0)
 		{
 #ifdef _WIN32
-			ServerLogger::logError("getaddrinfo: %s", gai_strerrorA(rv));
+			KOLOSAL_LOG_ERROR("getaddrinfo: %s", gai_strerrorA(rv));
 #else
-			ServerLogger::logError("getaddrinfo: %s", gai_strerror(rv));
+			KOLOSAL_LOG_ERROR("getaddrinfo: %s", gai_strerror(rv));
 #endif
 			return false;
 		}
 
-		for (p = servinfo; p != nullptr; p = p->ai_next)
+		// With SO_REUSEPORT every acceptor gets its own socket on the address and the kernel
+		// spreads connections over them; elsewhere the acceptors share one socket
+#ifdef KOLOSAL_REUSEPORT_BALANCES
+		const size_t socketCount = acceptorCount();
+#else
+		const size_t socketCount = 1;
+#endif
+		auto openOn = [&](const struct addrinfo *ai) -> SocketType
 		{
+			SocketType sock = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
 #ifdef _WIN32
-			listen_sock = socket(p->ai_family, p->ai_socktype, p->ai_protocol);
-			if (listen_sock == INVALID_SOCKET)
-				continue;
+			if (sock == INVALID_SOCKET)
+				return INVALID_SOCKET;
 #else
-			listen_sock = socket(p->ai_family, p->ai_socktype, p->ai_protocol);
-			if (listen_sock == -1)
-				continue;
+			if (sock == -1)
+				return -1;
+			fcntl(sock, F_SETFD, FD_CLOEXEC);
 #endif
-
 			int yes = 1;
-			if (setsockopt(listen_sock, SOL_SOCKET, SO_REUSEADDR,
-						   reinterpret_cast<const char *>(&yes),
-						   sizeof(yes)) == -1)
+			bool ok = setsockopt(sock, SOL_SOCKET, SO_REUSEADDR,
+								 reinterpret_cast<const char *>(&yes), sizeof(yes)) != -1;
+#ifdef KOLOSAL_REUSEPORT_BALANCES
+			ok = ok && (socketCount == 1 || setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, &yes, sizeof(yes)) != -1);
+#endif
+			ok = ok && bind(sock, ai->ai_addr, static_cast<int>(ai->ai_addrlen)) != -1;
+			// Non-blocking, so an acceptor that loses the race for a connection does not hang in accept()
+			ok = ok && listen(sock, SOMAXCONN) != -1 && setNonBlocking(sock, true);
+			if (!ok)
 			{
+				closeListener(sock);
 #ifdef _WIN32
-				closesocket(listen_sock);
+				return INVALID_SOCKET;
 #else
-				close(listen_sock);
+				return -1;
 #endif
-				continue;
 			}
+			return sock;
+		};
 
-			if (bind(listen_sock, p->ai_addr, static_cast<int>(p->ai_addrlen)) == -1)
-			{
+		for (p = servinfo; p != nullptr; p = p->ai_next)
+		{
+			SocketType sock = openOn(p);
 #ifdef _WIN32
-				closesocket(listen_sock);
+			if (sock == INVALID_SOCKET)
 #else
-				close(listen_sock);
+			if (sock == -1)
 #endif
 				continue;
-			}
+			listenSocks_.push_back(sock);
 			break;
 		}
+
+		if (p == nullptr)
+		{
+			freeaddrinfo(servinfo);
+			KOLOSAL_LOG_ERROR("Failed to bind socket");
+			return false;
+		}
+
+		for (size_t i = 1; i < socketCount; ++i)
+		{
+			SocketType sock = openOn(p);
+#ifdef _WIN32
+			if (sock == INVALID_SOCKET)
+#else
+			if (sock == -1)
+#endif
+			{
+				KOLOSAL_LOG_WARNING("Could not open SO_REUSEPORT listener %zu of %zu; continuing with %zu",
+										 i + 1, socketCount, listenSocks_.size());
+				break;
+			}
+			listenSocks_.push_back(sock);
+		}
 		freeaddrinfo(servinfo);
+		return true;
+	}
 
+	bool Server::adoptInheritedSockets()
+	{
 #ifdef _WIN32
-		if (listen_sock == INVALID_SOCKET)
-		{
+		return false;
 #else
-		if (p == nullptr)
+		const char *fds = std::getenv("KOLOSAL_LISTEN_FDS");
+		if (!fds || !*fds)
+			return false;
+		const char *parent = std::getenv("KOLOSAL_UPGRADE_PARENT");
+		upgradeParent_ = parent ? std::atol(parent) : 0;
+		const std::string list = fds;
+		// Not passed on to anything this process starts
+		unsetenv("KOLOSAL_LISTEN_FDS");
+		unsetenv("KOLOSAL_UPGRADE_PARENT");
+
+		std::istringstream in(list);
+		std::string item;
+		while (std::getline(in, item, ','))
 		{
+			const int fd = std::atoi(item.c_str());
+			struct sockaddr_storage addr;
+			socklen_t len = sizeof(addr);
+			if (fd <= 2 || getsockname(fd, reinterpret_cast<struct sockaddr *>(&addr), &len) == -1)
+			{
+				KOLOSAL_LOG_WARNING("Ignoring inherited descriptor '%s': not a socket", item.c_str());
+				continue;
+			}
+			fcntl(fd, F_SETFD, FD_CLOEXEC);
+			if (addr.ss_family == AF_UNIX)
+			{
+				if (options_.unixSocketPath.empty())
+					close(fd);
+				else
+					unix_sock = fd;
+				continue;
+			}
+
+			// A changed port in the new config means a fresh listener, not the old one
+			const int boundPort = addr.ss_family == AF_INET
+									  ? ntohs(reinterpret_cast<struct sockaddr_in *>(&addr)->sin_port)
+									  : ntohs(reinterpret_cast<struct sockaddr_in6 *>(&addr)->sin6_port);
+			if (std::to_string(boundPort) != port)
+			{
+				KOLOSAL_LOG_WARNING("Inherited listener is on port %d, not %s; closing it", boundPort, port.c_str());
+				close(fd);
+				continue;
+			}
+			setNonBlocking(fd, true);
+			listenSocks_.push_back(fd);
+		}
+
+		if (listenSocks_.empty())
+		{
+			KOLOSAL_LOG_WARNING("No usable listener inherited from process %ld; binding a new one", upgradeParent_);
+			upgradeParent_ = 0;
+			if (unix_sock != -1)
+			{
+				close(unix_sock);
+				unix_sock = -1;
+			}
+			return false;
+		}
+		KOLOSAL_LOG_INFO("Took over %zu listener(s) from process %ld", listenSocks_.size() + (unix_sock != -1), upgradeParent_);
+		return true;
 #endif
-			ServerLogger::logError("Failed to bind socket");
+	}
+
+	bool Server::listenUnix()
+	{
+#ifdef _WIN32
+		KOLOSAL_LOG_WARNING("Unix domain socket listener is not supported on Windows; serving TCP only");
+		return true;
+#else
+		const std::string &path = options_.unixSocketPath;
+		struct sockaddr_un addr;
+		std::memset(&addr, 0, sizeof(addr));
+		addr.sun_family = AF_UNIX;
+		if (path.size() >= sizeof(addr.sun_path))
+		{
+			KOLOSAL_LOG_ERROR("Unix socket path is too long: %s", path.c_str());
 			return false;
 		}
+		std::memcpy(addr.sun_path, path.c_str(), path.size());
 
-		if (listen(listen_sock, 10) == -1)
+		// A socket file left by a previous run would make bind() fail; anything else there is kept
+		struct stat st;
+		if (lstat(path.c_str(), &st) == 0)
 		{
-			ServerLogger::logError("Listen failed");
+			if (!S_ISSOCK(st.st_mode))
+			{
+				KOLOSAL_LOG_ERROR("Cannot listen on %s: the path exists and is not a socket", path.c_str());
+				return false;
+			}
+			unlink(path.c_str());
+		}
+
+		unix_sock = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (unix_sock == -1)
+		{
+			KOLOSAL_LOG_ERROR("Failed to create Unix socket: %s", std::strerror(errno));
+			return false;
+		}
+		if (bind(unix_sock, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) == -1 ||
+			listen(unix_sock, SOMAXCONN) == -1)
+		{
+			KOLOSAL_LOG_ERROR("Failed to listen on Unix socket %s: %s", path.c_str(), std::strerror(errno));
+			close(unix_sock);
+			unix_sock = -1;
 			return false;
 		}
+		// Access is governed by the file mode: the owner and its group
+		chmod(path.c_str(), 0660);
 
-		ServerLogger::logInfo("Server initialized and listening on %s:%s",
-							  host.c_str(), port.c_str());
+		KOLOSAL_LOG_INFO("Also listening on Unix socket %s", path.c_str());
 		return true;
+#endif
 	}
 
 	void Server::addRoute(std::unique_ptr<IRoute> route)
 	{
+		routeTable_.add(route.get());
 		routes.push_back(std::move(route));
 	}
 
 	void Server::run()
 	{
-		running = true;
-		ServerLogger::logInfo("Server entering main loop with concurrent request handling");
+		{
+			std::lock_guard<std::mutex> lock(lifecycleMutex_);
+			loopActive_ = true;
+			running = true;
+		}
+		accepting_ = true;
+		draining_ = false;
 
-		while (running)
+		const size_t hw = std::max(1u, std::thread::hardware_concurrency());
+		const size_t ioCount = options_.ioThreads > 0 ? static_cast<size_t>(options_.ioThreads) : std::min<size_t>(hw, 4);
+		const size_t minWorkers = options_.minWorkerThreads > 0 ? static_cast<size_t>(options_.minWorkerThreads) : hw;
+		const size_t maxWorkers = std::max(options_.maxWorkerThreads > 0 ? static_cast<size_t>(options_.maxWorkerThreads) : size_t(512), minWorkers);
+
+		workers_ = std::make_unique<WorkerPool>(minWorkers, maxWorkers);
+
+		// Partitions keep no idle threads; they are there to cap a class, not to keep it warm
+		auto buildBulkheads = [](const std::map<std::string, BulkheadOptions> &limits, const char *kind)
+		{
+			std::map<std::string, std::unique_ptr<Bulkhead>> partitions;
+			for (const auto &entry : limits)
+			{
+				auto bulkhead = std::make_unique<Bulkhead>();
+				bulkhead->pool = std::make_unique<WorkerPool>(0, static_cast<size_t>(std::max(entry.second.maxConcurrent, 1)));
+				bulkhead->maxQueued = static_cast<size_t>(std::max(entry.second.maxQueued, 0));
+				KOLOSAL_LOG_INFO("Bulkhead for %s '%s': %d handler(s), %s", kind, entry.first.c_str(), entry.second.maxConcurrent,
+								 bulkhead->maxQueued > 0 ? ("up to " + std::to_string(bulkhead->maxQueued) + " queued").c_str() : "unbounded queue");
+				partitions.emplace(entry.first, std::move(bulkhead));
+			}
+			return partitions;
+		};
+		classBulkheads_ = buildBulkheads(options_.classBulkheads, "class");
+		modelBulkheads_ = buildBulkheads(options_.modelBulkheads, "model");
+
+		for (size_t i = 0; i < ioCount; ++i)
+		{
+			auto io = std::make_unique<IoThread>();
+			if (!io->loop.valid())
+			{
+				KOLOSAL_LOG_ERROR("Failed to create %s event loop", EventLoop::backendName());
+				continue;
+			}
+			IoThread *raw = io.get();
+			io->thread = std::thread([this, raw]()
+									 { ioLoop(*raw); });
+			ioThreads_.push_back(std::move(io));
+		}
+
+		// Inherited listeners keep their number; otherwise every socket gets its acceptor
+		const size_t acceptors = std::max(listenSocks_.size(), listenSocks_.size() == 1 ? acceptorCount() : size_t(1));
+		if (ioThreads_.empty() || listenSocks_.empty())
+		{
+			KOLOSAL_LOG_ERROR("No I/O threads available, server cannot accept connections");
+			running = false;
+			accepting_ = false;
+		}
+		else
+		{
+			KOLOSAL_LOG_INFO("Server entering main loop (%s, %zu I/O threads, %zu acceptors on %zu listeners, %zu-%zu worker threads)",
+								  EventLoop::backendName(), ioThreads_.size(), acceptors, listenSocks_.size(), minWorkers, maxWorkers);
+		}
+
+		std::vector<std::thread> acceptThreads;
+		{
+			std::lock_guard<std::mutex> lock(lifecycleMutex_);
+			activeAcceptors_ = accepting_ ? acceptors : 0;
+		}
+		// Probes get an acceptor and I/O thread of their own, so they are answered even when the
+		// others are backed up; they keep answering (not ready) while the server drains
+		std::thread probeAcceptor;
+		if (probeListening_ && accepting_)
+		{
+			probeIo_ = std::make_unique<IoThread>();
+			if (probeIo_->loop.valid())
+			{
+				IoThread *raw = probeIo_.get();
+				probeIo_->thread = std::thread([this, raw]()
+											   { ioLoop(*raw); });
+				probeAcceptor = std::thread([this, raw]()
+											{
+												CpuProfiler::nameThread("kolosal-accept");
+												acceptLoop(probeSock_, false, raw); });
+			}
+			else
+			{
+				KOLOSAL_LOG_ERROR("Failed to create the probe port's event loop");
+				probeIo_.reset();
+			}
+		}
+
+		for (size_t i = 1; i < acceptors && accepting_; ++i)
+			acceptThreads.emplace_back([this, i]()
+									   {
+										   CpuProfiler::nameThread("kolosal-accept");
+										   acceptLoop(listenSocks_[i % listenSocks_.size()], false, nullptr); });
+		if (accepting_)
+			acceptLoop(listenSocks_[0], true, nullptr);
+		for (auto &thread : acceptThreads)
+			thread.join();
+
+		// Draining: the I/O threads and handlers keep serving until stop()
+		{
+			std::unique_lock<std::mutex> lock(lifecycleMutex_);
+			lifecycleCv_.wait(lock, [this]
+							  { return !running; });
+		}
+
+		if (probeAcceptor.joinable())
+			probeAcceptor.join();
+		if (probeIo_)
+		{
+			probeIo_->loop.wakeup();
+			if (probeIo_->thread.joinable())
+				probeIo_->thread.join();
+		}
+		for (auto &io : ioThreads_)
+		{
+			io->loop.wakeup();
+			if (io->thread.joinable())
+				io->thread.join();
+		}
+
+		// Long-lived sessions would otherwise keep their handlers running
+		for (auto &route : routes)
+			route->stop();
+
+		// In-flight handlers reference routes and I/O threads owned by this server,
+		// so wait for them before releasing either; with running cleared they close
+		// their sockets instead of handing them back
+		workers_->shutdown();
+		for (auto *partitions : {&classBulkheads_, &modelBulkheads_})
+			for (auto &entry : *partitions)
+				entry.second->pool->shutdown();
+		ioThreads_.clear();
+		probeIo_.reset();
+
+		KOLOSAL_LOG_INFO("Server main loop exited");
+
+		{
+			std::lock_guard<std::mutex> lock(lifecycleMutex_);
+			loopActive_ = false;
+		}
+		lifecycleCv_.notify_all();
+	}
+
+	void Server::acceptLoop(SocketType listenSock, bool withUnix, IoThread *pinned)
+	{
+		// The probe acceptor (pinned to the probe I/O thread) keeps going while the others drain
+		while (running && (accepting_ || pinned))
 		{
 			struct sockaddr_storage client_addr;
 #ifdef _WIN32
@@ -313,17 +743,27 @@ namespace kolosal
 			// Setup select for timeout to check running flag periodically
 			fd_set readfds;
 			FD_ZERO(&readfds);
-			FD_SET(listen_sock, &readfds);
+			FD_SET(listenSock, &readfds);
+			int maxSock = static_cast<int>(listenSock);
+#ifndef _WIN32
+			if (withUnix && unix_sock != -1)
+			{
+				FD_SET(unix_sock, &readfds);
+				maxSock = std::max(maxSock, unix_sock);
+			}
+#endif
 
 			struct timeval tv;
 			tv.tv_sec = 1; // 1 second timeout
 			tv.tv_usec = 0;
 
-			int select_result = select(static_cast<int>(listen_sock) + 1, &readfds, NULL, NULL, &tv);
+			int select_result = select(maxSock + 1, &readfds, NULL, NULL, &tv);
 
 			if (select_result == -1)
 			{
-				ServerLogger::logError("Select failed");
+				if (wouldBlock())
+					continue;
+				KOLOSAL_LOG_ERROR("Select failed");
 				break;
 			}
 
@@ -333,12 +773,17 @@ namespace kolosal
 				continue;
 			}
 
-			if (!FD_ISSET(listen_sock, &readfds))
+			// A ready Unix socket is served first; the TCP one is still ready on the next pass
+			bool fromUnix = false;
+#ifndef _WIN32
+			fromUnix = withUnix && unix_sock != -1 && FD_ISSET(unix_sock, &readfds);
+#endif
+			if (!fromUnix && !FD_ISSET(listenSock, &readfds))
 			{
 				continue;
 			}
 
-			SocketType client_sock = accept(listen_sock,
+			SocketType client_sock = accept(fromUnix ? unix_sock : listenSock,
 											reinterpret_cast<struct sockaddr *>(&client_addr),
 											&sin_size);
 #ifdef _WIN32
@@ -348,300 +793,951 @@ namespace kolosal
 			if (client_sock == -1)
 			{
 #endif
-				ServerLogger::logError("Accept failed");
+				// Another acceptor, or the other process during an upgrade, took it
+				if (!wouldBlock())
+					KOLOSAL_LOG_ERROR("Accept failed");
 				continue;
 			}
 
-			// Get client information for logging
-			char clientIP[INET6_ADDRSTRLEN];
-#ifdef _WIN32
-			inet_ntop(client_addr.ss_family,
-					  client_addr.ss_family == AF_INET ? (void *)&(((struct sockaddr_in *)&client_addr)->sin_addr) : (void *)&(((struct sockaddr_in6 *)&client_addr)->sin6_addr),
-					  clientIP, sizeof(clientIP));
-#else
-			inet_ntop(client_addr.ss_family,
-					  client_addr.ss_family == AF_INET ? (void *)&(((struct sockaddr_in *)&client_addr)->sin_addr) : (void *)&(((struct sockaddr_in6 *)&client_addr)->sin6_addr),
-					  clientIP, sizeof(clientIP));
-#endif
-			ServerLogger::logDebug("New client connection from %s", clientIP);
-			// Spawn a thread to handle this client
-			std::thread([this, client_sock, clientIP]()
+			// Unix socket peers have no address; they share one rate-limit and quota subject
+			std::string clientIP = fromUnix ? std::string("unix") : extractClientIP(client_addr);
+			KOLOSAL_LOG(LogLevel::SERVER_DEBUG, LogCategory::Connection, "New client connection from %s", clientIP.c_str());
+
+			if (!setNonBlocking(client_sock, true))
+			{
+				KOLOSAL_LOG_ERROR("Failed to make socket from %s non-blocking", clientIP.c_str());
+				closeSocket(client_sock);
+				continue;
+			}
+
+			// Hand the connection to the next I/O thread; it reads the request without blocking
+			IoThread &io = pinned ? *pinned : *ioThreads_[nextIo_.fetch_add(1, std::memory_order_relaxed) % ioThreads_.size()];
+
+			auto conn = std::make_shared<Connection>();
+			conn->sock = client_sock;
+			conn->clientIP = std::move(clientIP);
+			conn->unixSocket = fromUnix;
+			conn->probeOnly = pinned != nullptr;
+			conn->owner = &io;
+			HttpRequestParser::Limits limits;
+			limits.maxHeaderBytes = options_.maxHeaderBytes;
+			limits.maxHeaderCount = options_.maxHeaderCount;
+			limits.maxBodyBytes = options_.maxBodyBytes;
+			conn->parser.setLimits(limits);
+			// The Unix socket stays plain: it never leaves the machine; probes are plain HTTP too
+			if (tls_ && !fromUnix && !pinned)
+			{
+				conn->tls = tls_->accept(client_sock);
+				if (!conn->tls)
+				{
+					KOLOSAL_LOG_ERROR("Failed to set up TLS for %s", conn->clientIP.c_str());
+					closeSocket(client_sock);
+					continue;
+				}
+				conn->handshaking = true;
+			}
+			{
+				std::lock_guard<std::mutex> lock(io.pendingMutex);
+				io.pending.push_back(std::move(conn));
+			}
+			io.loop.wakeup();
+		}
+
+		if (pinned)
+			return;
+		{
+			std::lock_guard<std::mutex> lock(lifecycleMutex_);
+			--activeAcceptors_;
+		}
+		lifecycleCv_.notify_all();
+	}
+
+	void Server::ioLoop(IoThread &io)
+	{
+		CpuProfiler::nameThread("kolosal-io");
+		const auto requestTimeout = std::chrono::seconds(options_.requestTimeoutSeconds);
+		const auto keepAliveTimeout = std::chrono::seconds(options_.keepAliveTimeoutSeconds);
+		auto lastSweep = std::chrono::steady_clock::now();
+		std::vector<EventLoop::Event> events;
+
+		while (running)
+		{
+			// Register connections handed over by the accept loop or returned by workers
+			std::vector<std::shared_ptr<Connection>> adopted;
+			{
+				std::lock_guard<std::mutex> lock(io.pendingMutex);
+				adopted.swap(io.pending);
+			}
+			for (auto &conn : adopted)
+			{
+				conn->lastActivity = std::chrono::steady_clock::now();
+				io.connections[conn.get()] = conn;
+				if (!io.loop.add(conn->sock, conn.get()))
+				{
+					KOLOSAL_LOG_ERROR("Failed to register connection from %s", conn->clientIP.c_str());
+					closeConnection(io, conn);
+				}
+				else if (!conn->buffer.empty())
+				{
+					// A pipelined request arrived together with the previous one
+					processBuffer(io, conn, false);
+				}
+				else if (conn->tls && !conn->handshaking && conn->tls->hasBuffered())
+				{
+					// It was decrypted with the previous one and waits in the TLS buffer, unseen by the loop
+					readConnection(io, conn);
+				}
+			}
+
+			io.loop.wait(events, 250);
+			for (const auto &ev : events)
+			{
+				auto it = io.connections.find(static_cast<Connection *>(ev.userData));
+				if (it == io.connections.end())
+					continue;
+				std::shared_ptr<Connection> conn = it->second;
+				readConnection(io, conn);
+			}
+
+			// Drop connections that stalled mid-request or idled between requests
+			auto now = std::chrono::steady_clock::now();
+			if (now - lastSweep >= std::chrono::seconds(1))
+			{
+				lastSweep = now;
+				std::vector<std::shared_ptr<Connection>> expired;
+				for (const auto &entry : io.connections)
+				{
+					const auto &conn = entry.second;
+					bool idleBetweenRequests = conn->requestsServed > 0 && conn->buffer.empty();
+					if ((idleBetweenRequests && draining_) ||
+						now - conn->lastActivity > (idleBetweenRequests ? keepAliveTimeout : requestTimeout))
+						expired.push_back(conn);
+				}
+				for (const auto &conn : expired)
+				{
+					if (conn->requestsServed > 0 && conn->buffer.empty())
+						KOLOSAL_LOG(LogLevel::SERVER_DEBUG, LogCategory::Connection, "Closing idle keep-alive connection from %s", conn->clientIP.c_str());
+					else
+						KOLOSAL_LOG_WARNING("Timed out waiting for request from %s", conn->clientIP.c_str());
+					closeConnection(io, conn);
+				}
+			}
+		}
+
+		// Shutting down: close connections that never produced a complete request
+		{
+			std::lock_guard<std::mutex> lock(io.pendingMutex);
+			for (const auto &conn : io.pending)
+				closeSocket(conn->sock);
+			io.pending.clear();
+		}
+		for (const auto &entry : io.connections)
+		{
+			io.loop.remove(entry.second->sock);
+			closeSocket(entry.second->sock);
+		}
+		io.connections.clear();
+	}
+
+	void Server::readConnection(IoThread &io, const std::shared_ptr<Connection> &conn)
+	{
+		if (conn->handshaking && !advanceHandshake(io, conn))
+			return;
+
+		char chunk[16384];
+		bool peerClosed = false;
+
+		// Drain everything the socket has right now
+		while (true)
+		{
+			int bytesReceived = conn->tls ? static_cast<int>(conn->tls->read(chunk, sizeof(chunk)))
+										  : recv(conn->sock, chunk, sizeof(chunk), 0);
+			if (bytesReceived > 0)
+			{
+				conn->buffer.append(chunk, bytesReceived);
+				continue;
+			}
+			if (bytesReceived < 0 && wouldBlock())
+				break;
+			peerClosed = true;
+			break;
+		}
+		conn->lastActivity = std::chrono::steady_clock::now();
+
+		processBuffer(io, conn, peerClosed);
+	}
+
+	bool Server::advanceHandshake(IoThread &io, const std::shared_ptr<Connection> &conn)
+	{
+		while (true)
+		{
+			switch (conn->tls->handshake())
+			{
+			case TlsConnection::Step::Done:
+				conn->handshaking = false;
+				TlsContext::recordHandshake(*conn->tls);
+				kolosal::http_internal::SecureChannels::instance().add(conn->sock, conn->tls);
+				KOLOSAL_LOG(LogLevel::SERVER_DEBUG, LogCategory::Connection, "TLS handshake with %s done (%s, kernel send %s, recv %s)", conn->clientIP.c_str(),
+									   conn->tls->resumed() ? "resumed" : "full",
+									   conn->tls->kernelSend() ? "on" : "off", conn->tls->kernelRecv() ? "on" : "off");
+				return true;
+			case TlsConnection::Step::WantRead:
+				conn->lastActivity = std::chrono::steady_clock::now();
+				io.loop.rearm(conn->sock, conn.get());
+				return false;
+			case TlsConnection::Step::WantWrite:
+				// The server's handshake flight rarely outgrows the send buffer, so waiting here is short
+				if (waitWritable(conn->sock, 1000))
+					continue;
+				break;
+			case TlsConnection::Step::Failed:
+				break;
+			}
+			KOLOSAL_LOG(LogLevel::SERVER_DEBUG, LogCategory::Connection, "TLS handshake with %s failed: %s", conn->clientIP.c_str(), conn->tls->error().c_str());
+			TlsContext::recordFailure();
+			closeConnection(io, conn);
+			return false;
+		}
+	}
+
+	void Server::processBuffer(IoThread &io, const std::shared_ptr<Connection> &conn, bool peerClosed)
+	{
+		auto &parser = conn->parser;
+		while (!conn->buffer.empty())
+		{
+			auto status = parser.parse(conn->buffer);
+			if (status == HttpRequestParser::Status::HeadersComplete)
+			{
+				// Large uploads to routes that read their body incrementally are handed over now;
+				// the body size limit only applies to bodies that are buffered
+				if (options_.streamBodyBytes > 0 && !conn->probeOnly && !parser.chunked() &&
+					parser.contentLength() >= options_.streamBodyBytes && conn->buffer.size() < parser.messageEnd())
+				{
+					IRoute *route = findRoute(std::string(parser.method()), std::string(parser.target()));
+					if (route && route->streamsBody())
+					{
+						conn->streamBody = true;
+						dispatch(io, conn);
+						return;
+					}
+				}
+				status = parser.parse(conn->buffer);
+			}
+
+			if (status == HttpRequestParser::Status::Complete)
+			{
+				// Probes are answered right here; a pipelined request behind one is parsed next
+				if (answerProbe(io, conn))
+				{
+					if (io.connections.find(conn.get()) == io.connections.end())
+						return;
+					continue;
+				}
+				dispatch(io, conn);
+				return;
+			}
+			if (status == HttpRequestParser::Status::Error)
+			{
+				KOLOSAL_LOG_WARNING("Rejected request from %s: %s", conn->clientIP.c_str(), parser.error().c_str());
+				io.loop.remove(conn->sock);
+				io.connections.erase(conn.get());
+				setNonBlocking(conn->sock, false);
+				nlohmann::json jError = {{"error", {{"message", parser.error()}, {"type", "invalid_request_error"}, {"param", nullptr}, {"code", nullptr}}}};
+				send_response(conn->sock, parser.errorStatus(), jError.dump());
+				closeSocket(conn->sock);
+				return;
+			}
+			break;
+		}
+
+		if (peerClosed)
+		{
+			// A peer that half-closed during a Content-Length body gets whatever it sent
+			if (parser.headersComplete() && !parser.chunked() && !conn->probeOnly)
+			{
+				dispatch(io, conn);
+				return;
+			}
+			if (conn->buffer.empty())
+				KOLOSAL_LOG(LogLevel::SERVER_DEBUG, LogCategory::Connection, "Client %s closed connection", conn->clientIP.c_str());
+			else
+				KOLOSAL_LOG_WARNING("Incomplete HTTP request from %s", conn->clientIP.c_str());
+			closeConnection(io, conn);
+			return;
+		}
+
+		io.loop.rearm(conn->sock, conn.get());
+	}
+
+	bool Server::answerProbe(IoThread &io, const std::shared_ptr<Connection> &conn)
+	{
+		const auto &parser = conn->parser;
+		const bool head = parser.method() == "HEAD";
+		int status = 404;
+		std::string body;
+		bool probe = probeResponder_ && !conn->tls && (head || parser.method() == "GET") &&
+					 probeResponder_(parser.target().substr(0, parser.target().find('?')), status, body);
+		if (!probe)
+		{
+			// Everything else goes to the handlers, except on the probe port
+			if (!conn->probeOnly)
+				return false;
+			status = 404;
+			body = "{\"error\":{\"message\":\"Only health probes are served on this port\",\"type\":\"invalid_request_error\"}}";
+		}
+
+		const bool keepAlive = options_.keepAliveTimeoutSeconds > 0 && running && !draining_ &&
+							   conn->requestsServed + 1 < static_cast<size_t>(std::max(options_.maxKeepAliveRequests, 1)) &&
+							   clientWantsKeepAlive(parser.minorVersion(), parser.header("connection"));
+		std::string response;
+		response.reserve(160 + body.size());
+		response.append("HTTP/1.1 ").append(std::to_string(status)).append(" ").append(get_status_text(status));
+		response.append("\r\nContent-Type: application/json\r\nCache-Control: no-store\r\nContent-Length: ");
+		response.append(std::to_string(body.size())).append("\r\nConnection: ").append(keepAlive ? "keep-alive" : "close");
+		response.append("\r\n\r\n");
+		if (!head)
+			response.append(body);
+
+		// The socket is non-blocking; an answer this small fits its send buffer, and a client
+		// that cannot take it is dropped rather than waited for on the I/O thread
+		size_t sent = 0;
+		while (sent < response.size())
+		{
+			auto n = ::send(conn->sock, response.data() + sent, static_cast<int>(response.size() - sent), 0);
+			if (n <= 0)
+				break;
+			sent += static_cast<size_t>(n);
+		}
+		if (sent < response.size() || !keepAlive)
+		{
+			closeConnection(io, conn);
+			return true;
+		}
+
+		conn->buffer.erase(0, std::min(conn->buffer.size(), parser.messageEnd()));
+		conn->parser.reset();
+		conn->requestsServed++;
+		conn->lastActivity = std::chrono::steady_clock::now();
+		return true;
+	}
+
+	IRoute *Server::findRoute(const std::string &method, const std::string &path)
+	{
+		for (const auto &candidate : routeTable_.lookup(method, path))
+		{
+			if (candidate.route->match(method, path))
+				return candidate.route;
+		}
+		return nullptr;
+	}
+
+	Server::Bulkhead *Server::bulkheadFor(const std::shared_ptr<Connection> &conn)
+	{
+		const auto &parser = conn->parser;
+		if (!modelBulkheads_.empty() && !conn->streamBody && parser.bodyLength() > 0)
+		{
+			const char *body = conn->buffer.data() + parser.bodyOffset();
+			auto it = modelBulkheads_.find(bodyModel(body, body + parser.bodyLength()));
+			if (it != modelBulkheads_.end())
+				return it->second.get();
+		}
+		if (!classBulkheads_.empty())
+		{
+			if (IRoute *route = findRoute(std::string(parser.method()), std::string(parser.target())))
+			{
+				auto it = classBulkheads_.find(route->capacityClass());
+				if (it != classBulkheads_.end())
+					return it->second.get();
+			}
+		}
+		return nullptr;
+	}
+
+	size_t Server::handlersInFlight() const
+	{
+		size_t count = workers_ ? workers_->busyCount() + workers_->queuedCount() : 0;
+		for (const auto *partitions : {&classBulkheads_, &modelBulkheads_})
+			for (const auto &entry : *partitions)
+				count += entry.second->pool->busyCount() + entry.second->pool->queuedCount();
+		return count;
+	}
+
+	void Server::closeConnection(IoThread &io, const std::shared_ptr<Connection> &conn)
+	{
+		io.loop.remove(conn->sock);
+		io.connections.erase(conn.get());
+		closeSocket(conn->sock);
+	}
+
+	void Server::dispatch(IoThread &io, const std::shared_ptr<Connection> &conn)
+	{
+		// Chosen while the request is still in the buffer the I/O thread parsed
+		Bulkhead *bulkhead = bulkheadFor(conn);
+
+		io.loop.remove(conn->sock);
+		io.connections.erase(conn.get());
+
+		// Route handlers use blocking sends, so restore blocking mode before handing over
+		setNonBlocking(conn->sock, false);
+		struct timeval timeout;
+		timeout.tv_sec = options_.requestTimeoutSeconds;
+		timeout.tv_usec = 0;
+		setsockopt(conn->sock, SOL_SOCKET, SO_RCVTIMEO, (const char *)&timeout, sizeof(timeout));
+
+		WorkerPool &pool = bulkhead ? *bulkhead->pool : *workers_;
+		if (bulkhead && bulkhead->maxQueued > 0 && pool.queuedCount() >= bulkhead->maxQueued)
+		{
+			// The partition is saturated; answering now beats a wait that only grows
+			KOLOSAL_LOG_DEBUG("Rejected %.*s %.*s from %s: its bulkhead is full", static_cast<int>(conn->parser.method().size()),
+							  conn->parser.method().data(), static_cast<int>(conn->parser.target().size()), conn->parser.target().data(),
+							  conn->clientIP.c_str());
+			nlohmann::json jError = {{"error", {{"message", "Too many concurrent requests of this kind, retry shortly"}, {"type", "overloaded_error"}, {"param", nullptr}, {"code", nullptr}}}};
+			send_response(conn->sock, 503, jError.dump(), {{"Content-Type", "application/json"}, {"Retry-After", "1"}});
+			closeSocket(conn->sock);
+			return;
+		}
+
+		if (!pool.submit([this, conn]()
+						 { handleConnection(conn); }))
+		{
+			closeSocket(conn->sock);
+		}
+	}
+
+	void Server::handleConnection(const std::shared_ptr<Connection> &conn)
+	{
+		bool keepAlive = options_.keepAliveTimeoutSeconds > 0 && running && !draining_ &&
+						 conn->requestsServed + 1 < static_cast<size_t>(std::max(options_.maxKeepAliveRequests, 1));
+
+		if (conn->streamBody)
+		{
+			// The body bytes that came with the headers move into the body reader
+			size_t bodyStart = conn->parser.bodyOffset();
+			conn->body = std::make_unique<RequestBody>(conn->sock, conn->buffer.substr(bodyStart), conn->parser.contentLength());
+			conn->buffer.resize(bodyStart);
+		}
+
+		bool reuse;
+		{
+			RequestArena::Scope arena;
+			kolosal::http_internal::begin_response_tracking(keepAlive);
+			reuse = handleRequest(conn, keepAlive) && kolosal::http_internal::response_allows_reuse();
+			kolosal::http_internal::begin_response_tracking(false);
+			kolosal::http_internal::set_response_coding(kolosal::http_internal::ContentCoding::Identity, 0, 0);
+		}
+
+		if (conn->body)
+		{
+			// Whatever the handler left unread must come off the socket before the next request;
+			// past a small amount it is cheaper to close the connection
+			reuse = reuse && conn->body->discardRemaining(1 << 20);
+			conn->body.reset();
+			conn->streamBody = false;
+		}
+
+		if (!reuse || !running)
+		{
+			closeSocket(conn->sock);
+			return;
+		}
+
+		// Drop the bytes of the request just served; anything left is a pipelined request
+		size_t consumed = std::min(conn->buffer.size(), conn->parser.messageEnd());
+		conn->buffer.erase(0, consumed);
+		conn->parser.reset();
+		conn->requestsServed++;
+		conn->lastActivity = std::chrono::steady_clock::now();
+
+		if (!setNonBlocking(conn->sock, true))
+		{
+			closeSocket(conn->sock);
+			return;
+		}
+
+		IoThread &io = *conn->owner;
+		{
+			std::lock_guard<std::mutex> lock(io.pendingMutex);
+			io.pending.push_back(conn);
+		}
+		io.loop.wakeup();
+	}
+
+	bool Server::handleRequest(const std::shared_ptr<Connection> &conn, bool keepAlive)
+	{
+		SocketType client_sock = conn->sock;
+		const char *clientIP = conn->clientIP.c_str();
+		const std::string &request = conn->buffer;
+		const HttpRequestParser &parser = conn->parser;
+
+		KOLOSAL_LOG_REQUEST_DEBUG("[Thread %zu] Processing request from %s",
+							   std::hash<std::thread::id>{}(std::this_thread::get_id()), clientIP);
+
+		// The I/O thread parsed the request; only the fields routes get are copied out of the buffer
+		std::string method(parser.method());
+		std::string path(parser.target());
+		const size_t bytesIn = parser.chunked() ? parser.bodyLength() : parser.contentLength();
+
+		// Headers go straight into the request the auth middleware checks, names lowercased
+		// for case-insensitive lookup
+		auth::AuthMiddleware::RequestInfo authRequest(method, path, clientIP);
+		for (size_t i = 0; i < parser.headerCount(); ++i)
+		{
+			std::string key(parser.headerName(i));
+			std::transform(key.begin(), key.end(), key.begin(), [](unsigned char c)
+						   { return static_cast<char>(std::tolower(c)); });
+			authRequest.headers.insert_or_assign(std::move(key), std::string(parser.headerValue(i)));
+		}
+		const auto &headers = authRequest.headers;
+		auto connectionIt = headers.find("connection");
+		if (keepAlive && !clientWantsKeepAlive(parser.minorVersion(), connectionIt != headers.end() ? connectionIt->second : std::string()))
+		{
+			kolosal::http_internal::begin_response_tracking(false);
+		}
+		KOLOSAL_LOG_REQUEST_DEBUG("[Thread %zu] Processing %s request for %s from %s",
+							   std::hash<std::thread::id>{}(std::this_thread::get_id()), method.c_str(), path.c_str(), clientIP);
+
+		// Trace context from the caller's traceparent, if any; spans below nest under it
+		auto traceparentIt = headers.find("traceparent");
+		tracing::RequestScope trace(traceparentIt != headers.end() ? &traceparentIt->second : nullptr);
+		tracing::Span requestSpan(("HTTP " + method).c_str(), tracing::SpanKind::Server);
+		requestSpan.setAttribute("http.method", method);
+		requestSpan.setAttribute("url.path", path);
+		const auto requestStart = std::chrono::steady_clock::now();
+		const auto requestStartWall = std::chrono::system_clock::now();
+		access_log::begin_request();
+		const std::string *capturedBody = nullptr; // The body as the route got it, once known
+		auto finishSpan = [&](const std::string &route)
+		{
+			requestSpan.setAttribute("http.route", route);
+			requestSpan.setAttribute("http.status_code", static_cast<int64_t>(kolosal::http_internal::g_response_status));
+			if (kolosal::http_internal::g_response_status >= 500)
+				requestSpan.setError("HTTP " + std::to_string(kolosal::http_internal::g_response_status));
+
+			if (access_log::enabled())
+			{
+				access_log::AccessRecord record;
+				record.timestampUs = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+															   requestStartWall.time_since_epoch())
+															   .count());
+				record.latencyUs = static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+															 std::chrono::steady_clock::now() - requestStart)
+															 .count());
+				record.status = static_cast<uint16_t>(kolosal::http_internal::g_response_status);
+				record.method = method;
+				record.route = route;
+				record.bytesIn = bytesIn;
+				record.bytesOut = kolosal::http_internal::g_response_bytes;
+				record.clientIp = conn->clientIP;
+				record.traceId = trace.context().traceId;
+				access_log::finish_request(std::move(record), authMiddleware_->extractApiKey(headers));
+			}
+			if (traffic_capture::enabled())
+			{
+				traffic_capture::CaptureRecord record;
+				record.timestampUs = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+															   requestStartWall.time_since_epoch())
+															   .count());
+				record.latencyUs = static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+															 std::chrono::steady_clock::now() - requestStart)
+															 .count());
+				record.status = static_cast<uint16_t>(kolosal::http_internal::g_response_status);
+				record.method = method;
+				record.path = path;
+				record.route = route;
+				record.bytesIn = bytesIn;
+				record.bytesOut = kolosal::http_internal::g_response_bytes;
+				auto contentTypeIt = headers.find("content-type");
+				if (contentTypeIt != headers.end())
+					record.contentType = contentTypeIt->second;
+				traffic_capture::finish_request(std::move(record), capturedBody, authMiddleware_->extractApiKey(headers));
+			}
+		};
+
+		// Process authentication middleware
+		KOLOSAL_LOG_REQUEST_DEBUG("[Thread %zu] Calling auth middleware for %s %s from %s",
+							   std::hash<std::thread::id>{}(std::this_thread::get_id()), method.c_str(), path.c_str(), clientIP);
+
+		auto authResult = [&]
+		{
+			tracing::Span authSpan("auth");
+			return authMiddleware_->processRequest(authRequest);
+		}();
+		const auto routeStart = std::chrono::steady_clock::now();
+
+		KOLOSAL_LOG_REQUEST_DEBUG("[Thread %zu] Auth middleware result - Allowed: %s, Status: %d, Reason: %s",
+							   std::hash<std::thread::id>{}(std::this_thread::get_id()),
+							   authResult.allowed ? "true" : "false",
+							   authResult.statusCode,
+							   authResult.reason.c_str());
+
+		// Add OpenAI-compatible response headers
+		std::map<std::string, std::string> responseHeaders = {
+			{"Content-Type", "application/json"},
+			{"X-Content-Type-Options", "nosniff"},
+			{"X-Frame-Options", "DENY"},
+			{"X-XSS-Protection", "1; mode=block"},
+			{"Referrer-Policy", "strict-origin-when-cross-origin"}};
+		if (!trace.context().traceId.empty())
+			responseHeaders["X-Request-Id"] = trace.context().traceId;
+
+		// Overwrite merge to ensure dynamic CORS headers replace defaults
+		for (const auto &kv : authResult.headers)
+		{
+			responseHeaders[kv.first] = kv.second;
+		}
+
+		// Ensure Access-Control-Allow-Origin not containing repeated comma '*'
+		auto acaoIt = responseHeaders.find("Access-Control-Allow-Origin");
+		if (acaoIt != responseHeaders.end())
+		{
+			if (acaoIt->second.find(",") != std::string::npos)
+			{
+				// Simplify: if any '*' present reduce to single '*', else take first token
+				if (acaoIt->second.find("*") != std::string::npos)
+				{
+					acaoIt->second = "*";
+				}
+				else
+				{
+					auto commaPos = acaoIt->second.find(',');
+					acaoIt->second = acaoIt->second.substr(0, commaPos);
+					// trim
+					while (!acaoIt->second.empty() && (acaoIt->second.front() == ' ' || acaoIt->second.front() == '\t'))
+						acaoIt->second.erase(acaoIt->second.begin());
+					while (!acaoIt->second.empty() && (acaoIt->second.back() == ' ' || acaoIt->second.back() == '\t'))
+						acaoIt->second.pop_back();
+				}
+			}
+		}
+
+		// Set default headers for all subsequent responses on this thread. Only a pointer to
+		// responseHeaders is kept, so it is cleared again on every way out of this function.
+		kolosal::http_internal::set_default_response_headers(responseHeaders);
+		if (trace.context().timed)
+			kolosal::http_internal::g_server_timing = &tracing::server_timing;
+		struct DefaultHeadersReset
+		{
+			~DefaultHeadersReset()
+			{
+				kolosal::http_internal::clear_default_response_headers();
+				kolosal::http_internal::g_server_timing = nullptr;
+			}
+		} defaultHeadersReset;
+
+		// Response compression for this request, negotiated from Accept-Encoding
+		auto acceptEncodingIt = headers.find("accept-encoding");
+		kolosal::http_internal::set_response_coding(
+			acceptEncodingIt != headers.end() && options_.compressionLevel > 0
+				? kolosal::http_internal::negotiate_coding(acceptEncodingIt->second)
+				: kolosal::http_internal::ContentCoding::Identity,
+			options_.compressionLevel, options_.compressionMinBytes);
+
+		// Check if request is blocked by authentication
+		if (!authResult.allowed)
+		{
+			nlohmann::json jError = {
+				{"error", {{"message", authResult.reason}, {"type", authResult.statusCode == 429 ? "rate_limit_exceeded" : "authentication_error"}, {"code", authResult.statusCode}}}};
+
+			send_response(client_sock, authResult.statusCode, jError.dump(), responseHeaders);
+
+			KOLOSAL_LOG_WARNING("[Thread %zu] Request blocked: %s",
+									 std::hash<std::thread::id>{}(std::this_thread::get_id()), authResult.reason.c_str());
+			finishSpan("auth");
+			return true;
+		}
+
+		// Handle CORS preflight requests
+		if (authResult.isPreflight)
+		{
+			send_response(client_sock, authResult.statusCode, "", responseHeaders);
+			KOLOSAL_LOG_REQUEST_DEBUG("[Thread %zu] CORS preflight request handled",
+								   std::hash<std::thread::id>{}(std::this_thread::get_id()));
+			finishSpan("preflight");
+			return true;
+		}
+
+		// The I/O thread has already buffered the whole body (decoded, if it was chunked),
+		// unless it is being streamed
+		std::string body;
+		const size_t bodyStart = parser.bodyOffset();
+		const size_t bodyLength = parser.bodyLength();
+		if (!conn->body && bodyLength > 0)
+		{
+			if (parser.messageEnd() >= request.size())
+			{
+				// Nothing pipelined behind the body: take over the buffer instead of copying it
+				body = std::move(conn->buffer);
+				conn->buffer.clear();
+				body.resize(bodyStart + bodyLength);
+				body.erase(0, bodyStart);
+			}
+			else
+			{
+				body = request.substr(bodyStart, bodyLength);
+			}
+		}
+
+		// Compressed bodies are inflated as they are read; routes only ever see the plain bytes
+		kolosal::http_internal::ContentCoding bodyCoding = kolosal::http_internal::ContentCoding::Identity;
+		auto contentEncodingIt = headers.find("content-encoding");
+		if (contentEncodingIt != headers.end())
+		{
+			if (!kolosal::http_internal::parse_content_coding(contentEncodingIt->second, bodyCoding))
+			{
+				nlohmann::json jError = {{"error", {{"message", "Unsupported Content-Encoding '" + contentEncodingIt->second + "'; send the body as gzip, deflate or uncompressed"}, {"type", "invalid_request_error"}, {"param", nullptr}, {"code", nullptr}}}};
+				auto unsupportedHeaders = responseHeaders;
+				unsupportedHeaders["Accept-Encoding"] = "gzip, deflate";
+				send_response(client_sock, 415, jError.dump(), unsupportedHeaders);
+				finishSpan("other");
+				return true;
+			}
+			authRequest.headers.erase(contentEncodingIt);
+		}
+
+		if (conn->body)
+		{
+			conn->body->decode(bodyCoding, options_.maxDecodedBodyBytes);
+
+			// Clients that wait for permission before sending a large body get it now
+			auto expectIt = headers.find("expect");
+			if (expectIt != headers.end() && expectIt->second == "100-continue")
+			{
+				static const char kContinue[] = "HTTP/1.1 100 Continue\r\n\r\n";
+				kolosal::http_internal::IoSlice slice{kContinue, sizeof(kContinue) - 1};
+				kolosal::http_internal::send_all(client_sock, &slice, 1);
+			}
+		}
+
+		// Route the request; only routes whose patterns fit the path are asked
+		bool routeFound = false;
+		for (auto &candidate : routeTable_.lookup(method, path))
+		{
+			IRoute *route = candidate.route;
+			if (route->match(method, path))
+			{
+				routeFound = true;
+
+				// A compressed buffered body reaches a streaming route as a stream, so it is never
+				// held inflated; other routes get it inflated in full, under the buffered limit
+				std::unique_ptr<RequestBody> inflated;
+				if (bodyCoding != kolosal::http_internal::ContentCoding::Identity && !conn->body && !body.empty())
+				{
+					std::string compressed = std::move(body);
+					body.clear();
+					const size_t compressedSize = compressed.size();
+					inflated = std::make_unique<RequestBody>(client_sock, std::move(compressed), compressedSize);
+					size_t limit = options_.maxDecodedBodyBytes;
+					if (!route->streamsBody() && options_.maxBodyBytes > 0)
+						limit = limit > 0 ? std::min(limit, options_.maxBodyBytes) : options_.maxBodyBytes;
+					inflated->decode(bodyCoding, limit);
+					if (!route->streamsBody())
+					{
+						char chunk[65536];
+						while (size_t n = inflated->read(chunk, sizeof(chunk)))
+							body.append(chunk, n);
+						if (!inflated->ok())
 						{
-							ServerLogger::logDebug("[Thread %d] Processing request from %s",
-												  std::this_thread::get_id(), clientIP);
-
-							// Read the HTTP request with improved error handling
-							const int bufferSize = 16384; // Increased buffer size for larger headers
-							char buffer[bufferSize];
-							std::string request;
-							
-							// Read data in chunks until we have the complete headers
-							bool headersComplete = false;
-							int totalBytesReceived = 0;
-							
-							// Set socket timeout to prevent hanging
-							struct timeval timeout;
-							timeout.tv_sec = 30;  // 30 second timeout
-							timeout.tv_usec = 0;
-							setsockopt(client_sock, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
-							
-							while (!headersComplete && totalBytesReceived < bufferSize - 1)
-							{
-								int bytesReceived = recv(client_sock, buffer + totalBytesReceived, 
-														bufferSize - 1 - totalBytesReceived, 0);
-								
-								if (bytesReceived <= 0)
-								{
-									if (totalBytesReceived == 0)
-									{
-										ServerLogger::logError("[Thread %d] Failed to read HTTP headers from %s", 
-															   std::this_thread::get_id(), clientIP);
-									}
-									else
-									{
-										ServerLogger::logWarning("[Thread %d] Incomplete HTTP request from %s, using partial data", 
-																std::this_thread::get_id(), clientIP);
-									}
-									break;
-								}
-								
-								totalBytesReceived += bytesReceived;
-								buffer[totalBytesReceived] = '\0';
-								
-								// Check if we have complete headers (indicated by \r\n\r\n)
-								if (strstr(buffer, "\r\n\r\n") != nullptr)
-								{
-									headersComplete = true;
-								}
-							}
-							
-							if (totalBytesReceived == 0)
-							{
-								ServerLogger::logError("[Thread %d] No data received from %s", 
-													   std::this_thread::get_id(), clientIP);
-#ifdef _WIN32
-								closesocket(client_sock);
-#else
-								close(client_sock);
-#endif
-								return;
-							}
-							
-							request = std::string(buffer, totalBytesReceived);
-
-							// Parse the HTTP request line
-							size_t endOfLine = request.find("\r\n");
-							if (endOfLine == std::string::npos)
-							{
-								ServerLogger::logWarning("[Thread %d] Malformed request received", std::this_thread::get_id());
-								send_response(client_sock, 400, "{\"error\":\"Bad Request\"}");
-#ifdef _WIN32
-								closesocket(client_sock);
-#else
-								close(client_sock);
-#endif
-								return;
-							}
-
-							std::string requestLine = request.substr(0, endOfLine);
-							std::string method, path;
-							parse_request_line(requestLine, method, path);
-
-							// Parse headers for authentication middleware
-							auto headers = parseHeaders(request);ServerLogger::logDebug("[Thread %d] Processing %s request for %s from %s",
-												  std::this_thread::get_id(), method.c_str(), path.c_str(), clientIP); // Process authentication middleware
-							ServerLogger::logDebug("[Thread %d] Calling auth middleware for %s %s from %s",
-												  std::this_thread::get_id(), method.c_str(), path.c_str(), clientIP);
-
-							auth::AuthMiddleware::RequestInfo authRequest(method, path, clientIP);
-							authRequest.headers = headers;
-
-							auto authResult = authMiddleware_->processRequest(authRequest);
-
-							ServerLogger::logDebug("[Thread %d] Auth middleware result - Allowed: %s, Status: %d, Reason: %s",
-												  std::this_thread::get_id(),
-												  authResult.allowed ? "true" : "false",
-												  authResult.statusCode,
-												  authResult.reason.c_str());							// Add OpenAI-compatible response headers
-							std::map<std::string, std::string> responseHeaders = {
-								{"Content-Type", "application/json"},
-								{"X-Content-Type-Options", "nosniff"},
-								{"X-Frame-Options", "DENY"},
-								{"X-XSS-Protection", "1; mode=block"},
-								{"Referrer-Policy", "strict-origin-when-cross-origin"}
-							};
-
-							// Overwrite merge to ensure dynamic CORS headers replace defaults
-							for (const auto &kv : authResult.headers) {
-								responseHeaders[kv.first] = kv.second;
-							}
-
-							// Ensure Access-Control-Allow-Origin not containing repeated comma '*'
-							auto acaoIt = responseHeaders.find("Access-Control-Allow-Origin");
-							if (acaoIt != responseHeaders.end()) {
-								if (acaoIt->second.find(",") != std::string::npos) {
-									// Simplify: if any '*' present reduce to single '*', else take first token
-									if (acaoIt->second.find("*") != std::string::npos) {
-										acaoIt->second = "*";
-									} else {
-										auto commaPos = acaoIt->second.find(',');
-										acaoIt->second = acaoIt->second.substr(0, commaPos);
-										// trim
-										while (!acaoIt->second.empty() && (acaoIt->second.front()==' '||acaoIt->second.front()=='\t')) acaoIt->second.erase(acaoIt->second.begin());
-										while (!acaoIt->second.empty() && (acaoIt->second.back()==' '||acaoIt->second.back()=='\t')) acaoIt->second.pop_back();
-									}
-								}
-							}
-
-							// Set default headers for all subsequent responses on this thread
-							kolosal::http_internal::set_default_response_headers(responseHeaders);
-
-							// Check if request is blocked by authentication
-							if (!authResult.allowed)
-							{
-								nlohmann::json jError = {
-									{"error", {{"message", authResult.reason}, {"type", authResult.statusCode == 429 ? "rate_limit_exceeded" : "authentication_error"}, {"code", authResult.statusCode}}}};
-
-								send_response(client_sock, authResult.statusCode, jError.dump(), responseHeaders);
-
-								ServerLogger::logWarning("[Thread %d] Request blocked: %s",
-														 std::this_thread::get_id(), authResult.reason.c_str());
+							nlohmann::json jError = {{"error", {{"message", inflated->error()}, {"type", "invalid_request_error"}, {"param", nullptr}, {"code", nullptr}}}};
+							send_response(client_sock, inflated->errorStatus(), jError.dump(), responseHeaders);
+							finishSpan(candidate.pattern.empty() ? "other" : candidate.pattern);
+							break;
+						}
+						inflated.reset();
+					}
+				}
+
+				RequestContext context{method, path, headers, std::move(candidate.params), body, conn->body ? conn->body.get() : inflated.get(), conn->clientIP, conn->unixSocket};
+				capturedBody = &body;
+				const auto handleStart = std::chrono::steady_clock::now();
+				if (trace.context().timed)
+					tracing::add_timing("route", std::chrono::duration<double, std::milli>(handleStart - routeStart).count());
+				try
+				{
+					route->handle(client_sock, context);
+				}
+				catch (const std::exception &ex)
+				{
+					KOLOSAL_LOG_ERROR("[Thread %zu] Error in route handler: %s",
+										   std::hash<std::thread::id>{}(std::this_thread::get_id()), ex.what());
+
+					// The handler may have written part of a response, so never reuse the socket
+					kolosal::http_internal::begin_response_tracking(false);
+
+					// If we haven't sent a response yet, send an error
+					nlohmann::json jError = {{"error", {{"message", std::string("Internal error: ") + ex.what()}, {"type", "server_error"}, {"param", nullptr}, {"code", nullptr}}}};
+					send_response(client_sock, 500, jError.dump(), responseHeaders);
+				}
+				Metrics::instance().observeRequest(candidate.pattern.empty() ? "other" : candidate.pattern, method,
+												   kolosal::http_internal::g_response_status,
+												   std::chrono::duration<double>(std::chrono::steady_clock::now() - handleStart).count());
+				finishSpan(candidate.pattern.empty() ? "other" : candidate.pattern);
+				break;
+			}
+		}
 
-#ifdef _WIN32
-								closesocket(client_sock);
-#else
-								close(client_sock);
+		if (!routeFound)
+		{
+			KOLOSAL_LOG_WARNING("[Thread %zu] No route found for %s %s",
+									 std::hash<std::thread::id>{}(std::this_thread::get_id()), method.c_str(), path.c_str());
+
+			nlohmann::json jError = {{"error", {{"message", "Not found"}, {"type", "invalid_request_error"}, {"param", nullptr}, {"code", nullptr}}}};
+			send_response(client_sock, 404, jError.dump(), responseHeaders);
+			finishSpan("other");
+		}
+
+		KOLOSAL_LOG_REQUEST_DEBUG("[Thread %zu] Completed request for %s",
+							   std::hash<std::thread::id>{}(std::this_thread::get_id()), path.c_str());
+		return true;
+	}
+
+	void Server::drain()
+	{
+		if (!running)
+			return;
+
+		KOLOSAL_LOG_INFO("Draining: no longer accepting connections");
+		draining_ = true;
+		accepting_ = false;
+		{
+			std::unique_lock<std::mutex> lock(lifecycleMutex_);
+			lifecycleCv_.wait(lock, [this]
+							  { return activeAcceptors_ == 0; });
+		}
+
+		// The acceptors are gone; a successor holding the same sockets keeps them open
+		for (SocketType sock : listenSocks_)
+			closeListener(sock);
+		listenSocks_.clear();
+#ifndef _WIN32
+		if (unix_sock != -1)
+		{
+			close(unix_sock);
+			unix_sock = -1;
+			if (!handedOver_)
+				unlink(options_.unixSocketPath.c_str());
+		}
 #endif
-								kolosal::http_internal::clear_default_response_headers();
-								return;
-							}
 
-							// Handle CORS preflight requests
-							if (authResult.isPreflight)
-							{
-								send_response(client_sock, authResult.statusCode, "", responseHeaders);								ServerLogger::logDebug("[Thread %d] CORS preflight request handled",
-													  std::this_thread::get_id());
+		// Requests already being handled, streams included, run to completion
+		const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(std::max(0, options_.drainTimeoutSeconds));
+		while (handlersInFlight() > 0 && std::chrono::steady_clock::now() < deadline)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		}
+		if (const size_t inFlight = handlersInFlight())
+			KOLOSAL_LOG_WARNING("Drain timed out with %zu request(s) still in flight", inFlight);
+		else
+			KOLOSAL_LOG_INFO("Drained all in-flight requests");
+	}
 
+	long Server::spawnSuccessor(const std::vector<std::string> &args)
+	{
 #ifdef _WIN32
-								closesocket(client_sock);
+		(void)args;
+		KOLOSAL_LOG_ERROR("Handing the listeners to a new process is not supported on Windows");
+		return -1;
 #else
-								close(client_sock);
-#endif
-								kolosal::http_internal::clear_default_response_headers();
-								return;
-							}							// Find Content-Length header (case-insensitive)
-							int contentLength = 0;
-							auto it = headers.find("content-length");
-							if (it != headers.end())
-							{
-								try
-								{
-									contentLength = std::stoi(it->second);
-									ServerLogger::logDebug("[Thread %d] Content-Length: %d",
-														   std::this_thread::get_id(), contentLength);
-								}
-								catch (const std::exception &)
-								{
-									ServerLogger::logWarning("[Thread %d] Invalid Content-Length header: %s",
-															 std::this_thread::get_id(), it->second.c_str());
-								}
-							}
-
-							// Find the start of the body
-							size_t bodyStart = request.find("\r\n\r\n");
-							std::string body;
-
-							if (bodyStart != std::string::npos)
-							{
-								// Extract the body we've already read
-								body = request.substr(bodyStart + 4);
-
-								// If Content-Length indicates there's more data to read
-								if (contentLength > 0 && body.length() < static_cast<size_t>(contentLength))
-								{
-									int remaining = static_cast<int>(contentLength - body.length());
-									std::vector<char> bodyBuffer(remaining + 1, 0);
-
-									int totalRead = 0;
-									while (totalRead < remaining)
-									{
-										int bytesRead = recv(client_sock, bodyBuffer.data() + totalRead,
-															 remaining - totalRead, 0);
-										if (bytesRead <= 0)
-										{
-											break; // Error or connection closed
-										}
-										totalRead += bytesRead;
-									}
-
-									if (totalRead > 0)
-									{
-										body.append(bodyBuffer.data(), totalRead);
-									}
-
-									ServerLogger::logDebug("[Thread %d] Read %d additional bytes for body",
-														   std::this_thread::get_id(), totalRead);
-								}
-							} // Route the request
-							bool routeFound = false;
-							for (auto &route : routes)
-							{
-								if (route->match(method, path))
-								{
-									routeFound = true;
-									try
-									{
-										// Note: Routes will need to be updated to handle authentication headers
-										// For now, they'll work as before but won't include auth headers
-										route->handle(client_sock, body);
-									}
-									catch (const std::exception &ex)
-									{
-										ServerLogger::logError("[Thread %d] Error in route handler: %s",
-															   std::this_thread::get_id(), ex.what());
-
-										// If we haven't sent a response yet, send an error
-										nlohmann::json jError = {{"error", {{"message", std::string("Internal error: ") + ex.what()}, {"type", "server_error"}, {"param", nullptr}, {"code", nullptr}}}};
-										send_response(client_sock, 500, jError.dump(), responseHeaders);
-									}
-									break;
-								}
-							}
-
-							if (!routeFound)
-							{
-								ServerLogger::logWarning("[Thread %d] No route found for %s %s",
-														 std::this_thread::get_id(), method.c_str(), path.c_str());
-
-								nlohmann::json jError = {{"error", {{"message", "Not found"}, {"type", "invalid_request_error"}, {"param", nullptr}, {"code", nullptr}}}};
-								send_response(client_sock, 404, jError.dump(), responseHeaders);
-							}							
-							
-							ServerLogger::logDebug("[Thread %d] Completed request for %s",
-							std::this_thread::get_id(), path.c_str());
+		if (args.empty() || listenSocks_.empty() || !accepting_)
+		{
+			KOLOSAL_LOG_ERROR("Cannot start a successor: the server is not listening");
+			return -1;
+		}
 
-#ifdef _WIN32
-							closesocket(client_sock);
-#else
-							close(client_sock);
-#endif
-							kolosal::http_internal::clear_default_response_headers();
-						})
-				.detach(); // Detach the thread to handle the request independently
+		// Everything the child needs is prepared here: between fork and exec only
+		// async-signal-safe calls are allowed in a multithreaded process
+		std::string program = args[0];
+		if (program.find('/') == std::string::npos)
+		{
+			const char *path = std::getenv("PATH");
+			std::istringstream dirs(path ? path : "/usr/local/bin:/usr/bin:/bin");
+			std::string dir;
+			while (std::getline(dirs, dir, ':'))
+			{
+				std::string candidate = (dir.empty() ? std::string(".") : dir) + "/" + program;
+				if (access(candidate.c_str(), X_OK) == 0)
+				{
+					program = candidate;
+					break;
+				}
+			}
 		}
 
-		ServerLogger::logInfo("Server main loop exited");
+		std::vector<int> fds(listenSocks_.begin(), listenSocks_.end());
+		if (unix_sock != -1)
+			fds.push_back(unix_sock);
+		std::string fdList;
+		for (int fd : fds)
+			fdList += (fdList.empty() ? "" : ",") + std::to_string(fd);
+
+		std::vector<std::string> env;
+		for (char **var = environ; *var; ++var)
+		{
+			if (std::strncmp(*var, "KOLOSAL_LISTEN_FDS=", 19) != 0 && std::strncmp(*var, "KOLOSAL_UPGRADE_PARENT=", 23) != 0)
+				env.emplace_back(*var);
+		}
+		env.push_back("KOLOSAL_LISTEN_FDS=" + fdList);
+		env.push_back("KOLOSAL_UPGRADE_PARENT=" + std::to_string(static_cast<long>(getpid())));
+
+		std::vector<char *> argv;
+		for (const auto &arg : args)
+			argv.push_back(const_cast<char *>(arg.c_str()));
+		argv.push_back(nullptr);
+		std::vector<char *> envp;
+		for (const auto &var : env)
+			envp.push_back(const_cast<char *>(var.c_str()));
+		envp.push_back(nullptr);
+
+		const pid_t pid = fork();
+		if (pid == 0)
+		{
+			for (int fd : fds)
+				fcntl(fd, F_SETFD, 0);
+			execve(program.c_str(), argv.data(), envp.data());
+			_exit(127);
+		}
+		if (pid < 0)
+		{
+			KOLOSAL_LOG_ERROR("Failed to start a successor: %s", std::strerror(errno));
+			return -1;
+		}
+
+		handedOver_ = true;
+		KOLOSAL_LOG_INFO("Started successor process %ld (%s) on %zu listener(s); serving until it is ready",
+							  static_cast<long>(pid), program.c_str(), fds.size());
+		return static_cast<long>(pid);
+#endif
+	}
+
+	void Server::releasePredecessor()
+	{
+#ifndef _WIN32
+		if (upgradeParent_ <= 0)
+			return;
+		const pid_t parent = static_cast<pid_t>(upgradeParent_);
+		upgradeParent_ = 0;
+		if (kill(parent, SIGQUIT) == 0)
+			KOLOSAL_LOG_INFO("Ready; asked process %ld to drain and exit", static_cast<long>(parent));
+		else
+			KOLOSAL_LOG_WARNING("Could not signal process %ld to exit: %s", static_cast<long>(parent), std::strerror(errno));
+#endif
 	}
 
 	void Server::stop()
 	{
-		if (running)
 		{
-			ServerLogger::logInfo("Stopping server");
-			running = false;
-
-			// Additional cleanup could be added here
+			std::lock_guard<std::mutex> lock(lifecycleMutex_);
+			if (running)
+			{
+				KOLOSAL_LOG_INFO("Stopping server");
+				running = false;
+			}
 		}
+		lifecycleCv_.notify_all();
+
+		// Wait for run() to join its I/O threads and drain in-flight handlers
+		std::unique_lock<std::mutex> lock(lifecycleMutex_);
+		lifecycleCv_.wait(lock, [this]
+						  { return !loopActive_; });
 	}
 
-} // namespace kolosal
\ No newline at end of file
+} // namespace kolosal
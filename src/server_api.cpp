@@ -1,12 +1,26 @@
+#include <algorithm>
 #include <memory>
 #include <stdexcept>
 #include <thread>
 
 #include "kolosal/server_api.hpp"
 #include "kolosal/server.hpp"
+#include "kolosal/server_config.hpp"
 #include "kolosal/download_manager.hpp"
 #include "kolosal/node_manager.h"
 #include "kolosal/logger.hpp"
+#include "kolosal/metrics.hpp"
+#include "kolosal/tracing.hpp"
+#include "kolosal/access_log.hpp"
+#include "kolosal/traffic_capture.hpp"
+#include "kolosal/gpu_detection.hpp"
+#include "kolosal/health_monitor.hpp"
+#include "kolosal/config_reloader.hpp"
+#include "kolosal/batch_manager.hpp"
+#include "kolosal/job_manager.hpp"
+#include "kolosal/cluster_router.hpp"
+#include "kolosal/drain_manager.hpp"
+#include "kolosal/remote_prefill.hpp"
 
 //-----------------routes-----------------//
 
@@ -18,19 +32,33 @@
 #include "kolosal/routes/server_logs_route.hpp"
 #include "kolosal/routes/downloads_route.hpp"
 #include "kolosal/routes/ui_routes.hpp"
+#include "kolosal/routes/metrics_route.hpp"
+#include "kolosal/routes/memory_route.hpp"
+#include "kolosal/routes/profile_route.hpp"
+#include "kolosal/routes/model_files_route.hpp"
+#include "kolosal/routes/files_route.hpp"
+#include "kolosal/routes/cluster_route.hpp"
 
 // LLM routes
 
 #include "kolosal/routes/llm/oai_completions_route.hpp"
 #include "kolosal/routes/llm/completion_route.hpp"
+#include "kolosal/routes/llm/batches_route.hpp"
+#include "kolosal/routes/llm/jobs_route.hpp"
+#include "kolosal/routes/llm/chat_session_route.hpp"
+#include "kolosal/routes/llm/prefill_route.hpp"
+#include "kolosal/routes/llm/migration_route.hpp"
+#include "kolosal/routes/llm/score_route.hpp"
 
 // Config routes
 
 #include "kolosal/routes/config/auth_config_route.hpp"
+#include "kolosal/routes/config/config_reload_route.hpp"
 
 // Retrieval routes
 
 #include "kolosal/routes/retrieval/embedding_route.hpp"
+#include "kolosal/routes/retrieval/rerank_route.hpp"
 #include "kolosal/routes/retrieval/parse_document_route.hpp"
 #include "kolosal/routes/retrieval/documents_route.hpp"
 #include "kolosal/routes/retrieval/internet_search_route.hpp"
@@ -71,20 +99,56 @@ namespace kolosal
     {
         try
         {
-            ServerLogger::logInfo("Initializing server on %s:%s with idle timeout: %lld seconds", host.c_str(), port.c_str(), idleTimeout.count());
+            KOLOSAL_LOG_INFO("Initializing server on %s:%s with idle timeout: %lld seconds", host.c_str(), port.c_str(), idleTimeout.count());
 
             // Initialize NodeManager with configured idle timeout
             pImpl->initNodeManager(idleTimeout);
 
-            pImpl->server = std::make_unique<Server>(port, host);
+            // Connection layer sizing comes from the global config
+            const auto &config = ServerConfig::getInstance();
+            ServerOptions options;
+            options.ioThreads = config.ioThreads;
+            options.acceptThreads = config.acceptThreads;
+            options.drainTimeoutSeconds = config.upgradeDrainTimeout;
+            options.minWorkerThreads = config.workerThreads;
+            options.maxWorkerThreads = config.maxWorkerThreads;
+            options.keepAliveTimeoutSeconds = config.keepAliveTimeout;
+            options.maxKeepAliveRequests = config.maxKeepAliveRequests;
+            options.streamBodyBytes = static_cast<size_t>(std::max(config.streamBodyThresholdMb, 0)) << 20;
+            options.maxBodyBytes = static_cast<size_t>(std::max(config.maxBodyMb, 0)) << 20;
+            options.maxDecodedBodyBytes = static_cast<size_t>(std::max(config.maxDecompressedBodyMb, 0)) << 20;
+            options.compressionLevel = config.compressionLevel;
+            options.compressionMinBytes = static_cast<size_t>(std::max(config.compressionMinBytes, 0));
+            options.unixSocketPath = config.unixSocket;
+            for (const auto &entry : config.bulkheads.classes)
+                options.classBulkheads[entry.first] = {entry.second.max_concurrent, entry.second.max_queued};
+            for (const auto &entry : config.bulkheads.models)
+                options.modelBulkheads[entry.first] = {entry.second.max_concurrent, entry.second.max_queued};
+            if (config.healthPort > 0)
+                options.probePort = std::to_string(config.healthPort);
+            if (config.tls.enabled)
+            {
+                options.tls.certFile = config.tls.cert_file;
+                options.tls.keyFile = config.tls.key_file;
+                options.tls.kernelOffload = config.tls.kernel_offload;
+                options.tls.sessionTickets = config.tls.session_tickets;
+                options.tls.sessionCacheSize = config.tls.session_cache_size;
+                options.tls.sessionTimeoutSeconds = config.tls.session_timeout_seconds;
+            }
+
+            pImpl->server = std::make_unique<Server>(port, host, options);
             if (!pImpl->server->init())
             {
-                ServerLogger::logError("Failed to initialize server");
+                KOLOSAL_LOG_ERROR("Failed to initialize server");
                 return false;
             }
+
+            // Liveness and readiness are answered from HealthMonitor's snapshot on the I/O threads
+            pImpl->server->setProbeResponder([](std::string_view path, int &status, std::string &body)
+                                             { return HealthMonitor::instance().probe(path, status, body); });
             
             // Register routes
-            ServerLogger::logInfo("Registering routes");
+            KOLOSAL_LOG_INFO("Registering routes");
 
             //-----------------routes-----------------//
 
@@ -103,23 +167,30 @@ namespace kolosal
 
             pImpl->server->addRoute(std::make_unique<OaiCompletionsRoute>());
             pImpl->server->addRoute(std::make_unique<CompletionRoute>());
+            pImpl->server->addRoute(std::make_unique<FilesRoute>());
+            pImpl->server->addRoute(std::make_unique<BatchesRoute>());
+            pImpl->server->addRoute(std::make_unique<JobsRoute>());
+            pImpl->server->addRoute(std::make_unique<ChatSessionRoute>());
+            pImpl->server->addRoute(std::make_unique<ScoreRoute>());
 
             // Config routes
             
             pImpl->server->addRoute(std::make_unique<AuthConfigRoute>());
+            pImpl->server->addRoute(std::make_unique<ConfigReloadRoute>());
 
             // Retrieval routes
 
             pImpl->server->addRoute(std::make_unique<EmbeddingRoute>());
+            pImpl->server->addRoute(std::make_unique<RerankRoute>());
             pImpl->server->addRoute(std::make_unique<ParseDocumentRoute>());
             pImpl->server->addRoute(std::make_unique<DocumentsRoute>());
             pImpl->server->addRoute(std::make_unique<ChunkingRoute>());
 
-            ServerLogger::logInfo("Routes registered successfully");
+            KOLOSAL_LOG_INFO("Routes registered successfully");
 
             // Start server in a background thread
             std::thread([this]() {
-                ServerLogger::logInfo("Starting server main loop");
+                KOLOSAL_LOG_INFO("Starting server main loop");
                 pImpl->server->run(); 
             }).detach();
 
@@ -127,32 +198,68 @@ namespace kolosal
         }
         catch (const std::exception &ex)
         {
-            ServerLogger::logError("Failed to initialize server: %s", ex.what());
+            KOLOSAL_LOG_ERROR("Failed to initialize server: %s", ex.what());
             return false;
         }
     }
+    bool ServerAPI::upgrade(const std::vector<std::string> &args)
+    {
+        return pImpl->server && pImpl->server->spawnSuccessor(args) > 0;
+    }
+
+    void ServerAPI::releasePredecessor()
+    {
+        if (pImpl->server)
+        {
+            pImpl->server->releasePredecessor();
+        }
+    }
+
+    void ServerAPI::drain()
+    {
+        if (pImpl->server)
+        {
+            pImpl->server->drain();
+        }
+    }
+
     void ServerAPI::shutdown()
     {
         if (pImpl->server)
         {
-            ServerLogger::logInfo("Shutting down server");
+            KOLOSAL_LOG_INFO("Shutting down server");
+
+            // No config reload may start loading models from here on
+            ConfigReloader::instance().stop();
+
+            // A running batch stops its jobs here and resumes on the next start
+            BatchManager::instance().stop();
+            JobManager::instance().stop();
 
             // Wait for all download threads to complete (this will cancel them first)
             try
             {
                 auto &download_manager = DownloadManager::getInstance();
-                ServerLogger::logInfo("Stopping all downloads and waiting for threads to finish...");
+                KOLOSAL_LOG_INFO("Stopping all downloads and waiting for threads to finish...");
                 download_manager.waitForAllDownloads();
             }
             catch (const std::exception &ex)
             {
-                ServerLogger::logError("Error during download shutdown: %s", ex.what());
+                KOLOSAL_LOG_ERROR("Error during download shutdown: %s", ex.what());
             }
 
             // Shutdown the server
-            ServerLogger::logInfo("Shutting down HTTP server");
+            KOLOSAL_LOG_INFO("Shutting down HTTP server");
+            ClusterRouter::instance().shareRateLimits(nullptr);
             pImpl->server.reset();
-            ServerLogger::logInfo("Server shutdown complete");
+            DrainManager::instance().stop();
+            ClusterRouter::instance().stop();
+            tracing::stop();
+            access_log::stop();
+            traffic_capture::stop();
+            GpuTelemetry::instance().stop();
+            HealthMonitor::instance().stop();
+            KOLOSAL_LOG_INFO("Server shutdown complete");
         }
     }
 
@@ -163,10 +270,22 @@ namespace kolosal
             throw std::runtime_error("Server not initialized - call init() first");
         }
 
-        ServerLogger::logInfo("Metrics functionality not yet implemented");
-        // TODO: Add metrics routes when they are implemented
-        // pImpl->server->addRoute(std::make_unique<SystemMetricsRoute>());
-        // pImpl->server->addRoute(std::make_unique<CompletionMetricsRoute>());
+        KOLOSAL_LOG_INFO("Enabling Prometheus metrics endpoint at /metrics, memory report at /debug/memory and profiler at /debug/profile");
+        Metrics::instance().enable();
+        pImpl->server->addRoute(std::make_unique<MetricsRoute>());
+        pImpl->server->addRoute(std::make_unique<MemoryRoute>());
+        pImpl->server->addRoute(std::make_unique<ProfileRoute>());
+    }
+
+    void ServerAPI::enableModelSharing()
+    {
+        if (!pImpl->server)
+        {
+            throw std::runtime_error("Server not initialized - call init() first");
+        }
+
+        KOLOSAL_LOG_INFO("Sharing downloaded models with peers at /v1/model-files/");
+        pImpl->server->addRoute(std::make_unique<ModelFilesRoute>());
     }
 
     void ServerAPI::enableSearch(const SearchConfig &config)
@@ -176,10 +295,68 @@ namespace kolosal
             throw std::runtime_error("Server not initialized - call init() first");
         }
 
-        ServerLogger::logInfo("Enabling internet search endpoint");
+        KOLOSAL_LOG_INFO("Enabling internet search endpoint");
         pImpl->server->addRoute(std::make_unique<InternetSearchRoute>(config));
     }
 
+    void ServerAPI::enableCluster(const ClusterConfig &config)
+    {
+        if (!pImpl->server)
+        {
+            throw std::runtime_error("Server not initialized - call init() first");
+        }
+
+        ClusterRouter::instance().start(config);
+        if (config.enabled && config.share_rate_limits)
+            ClusterRouter::instance().shareRateLimits(&pImpl->server->getAuthMiddleware().getRateLimiter());
+        DrainManager::instance().configure(config);
+        pImpl->server->addRoute(std::make_unique<ClusterRoute>());
+        pImpl->server->addRoute(std::make_unique<MigrationRoute>());
+    }
+
+    void ServerAPI::enableDisaggregation(const DisaggregationConfig &config)
+    {
+        if (!pImpl->server)
+        {
+            throw std::runtime_error("Server not initialized - call init() first");
+        }
+
+        RemotePrefill::instance().configure(config);
+        if (config.role == "prefill")
+        {
+            KOLOSAL_LOG_INFO("Serving prompt prefills to decode nodes at /v1/internal/prefill");
+            pImpl->server->addRoute(std::make_unique<PrefillRoute>());
+        }
+    }
+
+    void ServerAPI::enableTracing(const TracingConfig &config)
+    {
+        if (config.server_timing)
+        {
+            KOLOSAL_LOG_INFO("Reporting request stage timings in Server-Timing headers");
+            tracing::set_server_timing(true);
+        }
+        if (config.enabled)
+        {
+            KOLOSAL_LOG_INFO("Enabling request tracing (sample rate %.4f)", config.sample_rate);
+            tracing::start(config);
+        }
+    }
+
+    void ServerAPI::enableAccessLog(const AccessLogConfig &config)
+    {
+        KOLOSAL_LOG_INFO("Writing %s access log to %s (sample rate %.4f)", config.format.c_str(),
+                              config.file.c_str(), config.sample_rate);
+        access_log::start(config);
+    }
+
+    void ServerAPI::enableTrafficCapture(const TrafficCaptureConfig &config)
+    {
+        KOLOSAL_LOG_INFO("Capturing %s traffic to %s (sample rate %.4f)", config.anonymize ? "anonymized" : "raw",
+                              config.file.c_str(), config.sample_rate);
+        traffic_capture::start(config);
+    }
+
     NodeManager &ServerAPI::getNodeManager()
     {
         return *pImpl->nodeManager;
@@ -6,6 +6,7 @@
 #include <fstream>
 #include <thread>
 #include <filesystem>
+#include <set>
 
 #ifdef _WIN32
 #include <windows.h>
@@ -21,6 +22,17 @@
 
 namespace kolosal
 {
+    // KV cache types understood by the inference engine
+    static bool isValidCacheType(const std::string &type)
+    {
+        for (const char *name : {"f32", "f16", "bf16", "q8_0", "q5_1", "q5_0", "q4_1", "q4_0", "auto"})
+        {
+            if (type == name)
+                return true;
+        }
+        return false;
+    }
+
 #ifdef __APPLE__
     // Helper function to detect if we're running from a macOS app bundle
     static bool isRunningFromAppBundle()
@@ -106,6 +118,66 @@ namespace kolosal
 #endif
     }
 
+    // Absolute path of an engine library from the config. On Linux a bare file name that is
+    // not found next to the config is also looked up in the standard library directories
+    // (packaged installs put the engines in /usr/lib).
+    static std::string resolveEngineLibraryPath(const std::string &rawLibPath, const std::string &engineName)
+    {
+        std::string resolved = ServerConfig::makeAbsolutePath(rawLibPath);
+
+#ifndef _WIN32
+        // If the resolved path still does not exist AND the original path was just a filename
+        // (common for packaged Linux installs placing libs in /usr/lib), search standard lib dirs.
+        try {
+            auto pathExists = std::filesystem::exists(resolved);
+            bool isSimpleName = (rawLibPath.find('/') == std::string::npos && rawLibPath.find('\\') == std::string::npos);
+            if (!pathExists && isSimpleName) {
+                // Candidate search directories (ordered by likelihood)
+                std::vector<std::filesystem::path> candidates;
+
+                // Derive prefix from executable path if possible (/usr/bin -> /usr/lib)
+                char execPathBuf[PATH_MAX];
+#ifdef __APPLE__
+                // Not used here (Linux specific case) but keep structure consistent
+#elif defined(__linux__)
+                ssize_t len = readlink("/proc/self/exe", execPathBuf, sizeof(execPathBuf) - 1);
+                if (len != -1) {
+                    execPathBuf[len] = '\0';
+                    std::filesystem::path exePath(execPathBuf);
+                    auto exeDir = exePath.parent_path();
+                    if (!exeDir.empty()) {
+                        candidates.push_back(exeDir);                    // /usr/bin
+                        candidates.push_back(exeDir.parent_path()/"lib"); // /usr/lib (if exeDir is /usr/bin)
+                    }
+                }
+#endif
+                // Standard library locations
+                candidates.push_back("/usr/lib");
+                candidates.push_back("/usr/local/lib");
+                candidates.push_back("/usr/lib64");
+                candidates.push_back("/lib");
+                candidates.push_back("/lib64");
+                candidates.push_back("/opt/kolosal/lib");
+
+                for (const auto &dir : candidates) {
+                    if (dir.empty()) continue;
+                    std::filesystem::path candidate = dir / rawLibPath;
+                    if (std::filesystem::exists(candidate)) {
+                        KOLOSAL_LOG_INFO("Resolved engine library '" + rawLibPath + "' to '" + candidate.string() + "'");
+                        resolved = candidate.string();
+                        break;
+                    }
+                }
+            }
+        } catch (const std::exception &e) {
+            KOLOSAL_LOG_INFO(std::string("Engine library resolution warning for '") + engineName + "': " + e.what());
+        }
+#else
+        (void)engineName;
+#endif // _WIN32
+        return resolved;
+    }
+
     /**
      * @brief Convert a relative path to an absolute path with fallback to executable directory
      * @param path The path to convert (can be relative or already absolute)
@@ -170,7 +242,7 @@ namespace kolosal
                     for (const auto& searchPath : searchPaths) {
                         std::filesystem::path candidatePath(searchPath);
                         if (std::filesystem::exists(candidatePath)) {
-                            ServerLogger::instance().info("Found path using app bundle search: " + candidatePath.string());
+                            KOLOSAL_LOG_INFO("Found path using app bundle search: " + candidatePath.string());
                             return candidatePath.string();
                         }
                     }
@@ -179,12 +251,12 @@ namespace kolosal
                     // Standard relative to executable path
                     std::filesystem::path execRelativePath = executablePath / fsPath;
                     if (std::filesystem::exists(execRelativePath)) {
-                        ServerLogger::instance().info("Found path relative to executable: " + execRelativePath.string());
+                        KOLOSAL_LOG_INFO("Found path relative to executable: " + execRelativePath.string());
                         return execRelativePath.string();
                     }
                 }
             } catch (const std::exception& e) {
-                ServerLogger::instance().info("Failed to get executable path: " + std::string(e.what()));
+                KOLOSAL_LOG_INFO("Failed to get executable path: " + std::string(e.what()));
             }
             
             // If file doesn't exist in either location, return the absolute path anyway
@@ -193,7 +265,7 @@ namespace kolosal
             
         } catch (const std::filesystem::filesystem_error& e) {
             // If filesystem operations fail, return the original path
-            ServerLogger::instance().info("Warning: Failed to convert path to absolute: " + path + " - " + e.what());
+            KOLOSAL_LOG_INFO("Warning: Failed to convert path to absolute: " + path + " - " + e.what());
             return path;
         }
     }
@@ -250,10 +322,10 @@ namespace kolosal
             if (systemFile.good()) {
                 systemFile.close();
                 if (loadFromFile(systemPath)) {
-                    ServerLogger::instance().info("Loaded configuration from " + systemPath);
+                    KOLOSAL_LOG_INFO("Loaded configuration from " + systemPath);
                     currentConfigFilePath = systemPath;
-                    ServerLogger::instance().info("Stored config file path: " + currentConfigFilePath);
-                    ServerLogger::instance().info("ServerConfig instance address during load: " + std::to_string(reinterpret_cast<uintptr_t>(this)));
+                    KOLOSAL_LOG_INFO("Stored config file path: " + currentConfigFilePath);
+                    KOLOSAL_LOG_INFO("ServerConfig instance address during load: " + std::to_string(reinterpret_cast<uintptr_t>(this)));
                     configLoaded = true;
                     break;
                 }
@@ -265,10 +337,10 @@ namespace kolosal
         if (systemFile.good()) {
             systemFile.close();
             if (loadFromFile("/etc/kolosal/config.yaml")) {
-                ServerLogger::instance().info("Loaded configuration from /etc/kolosal/config.yaml");
+                KOLOSAL_LOG_INFO("Loaded configuration from /etc/kolosal/config.yaml");
                 currentConfigFilePath = "/etc/kolosal/config.yaml"; // Store exact path used
-                ServerLogger::instance().info("Stored config file path: " + currentConfigFilePath);
-                ServerLogger::instance().info("ServerConfig instance address during load: " + std::to_string(reinterpret_cast<uintptr_t>(this)));
+                KOLOSAL_LOG_INFO("Stored config file path: " + currentConfigFilePath);
+                KOLOSAL_LOG_INFO("ServerConfig instance address during load: " + std::to_string(reinterpret_cast<uintptr_t>(this)));
                 configLoaded = true;
             }
         }
@@ -280,11 +352,11 @@ namespace kolosal
             if (yamlFile.good()) {
                 yamlFile.close();
                 if (loadFromFile("config.yaml")) {
-                    ServerLogger::instance().info("Loaded configuration from config.yaml");
+                    KOLOSAL_LOG_INFO("Loaded configuration from config.yaml");
                     // For relative paths, store the absolute path to ensure we can always find it later
                     currentConfigFilePath = std::filesystem::absolute("config.yaml").string();
-                    ServerLogger::instance().info("Stored config file path: " + currentConfigFilePath);
-                    ServerLogger::instance().info("ServerConfig instance address during load: " + std::to_string(reinterpret_cast<uintptr_t>(this)));
+                    KOLOSAL_LOG_INFO("Stored config file path: " + currentConfigFilePath);
+                    KOLOSAL_LOG_INFO("ServerConfig instance address during load: " + std::to_string(reinterpret_cast<uintptr_t>(this)));
                     configLoaded = true;
                 }
             }
@@ -296,11 +368,11 @@ namespace kolosal
             if (jsonFile.good()) {
                 jsonFile.close();
                 if (loadFromFile("config.json")) {
-                    ServerLogger::instance().info("Loaded configuration from config.json");
+                    KOLOSAL_LOG_INFO("Loaded configuration from config.json");
                     // For relative paths, store the absolute path to ensure we can always find it later
                     currentConfigFilePath = std::filesystem::absolute("config.json").string();
-                    ServerLogger::instance().info("Stored config file path: " + currentConfigFilePath);
-                    ServerLogger::instance().info("ServerConfig instance address during load: " + std::to_string(reinterpret_cast<uintptr_t>(this)));
+                    KOLOSAL_LOG_INFO("Stored config file path: " + currentConfigFilePath);
+                    KOLOSAL_LOG_INFO("ServerConfig instance address during load: " + std::to_string(reinterpret_cast<uintptr_t>(this)));
                     configLoaded = true;
                 }
             }
@@ -322,10 +394,10 @@ namespace kolosal
                 if (userFile.good()) {
                     userFile.close();
                     if (loadFromFile(userConfigPath)) {
-                        ServerLogger::instance().info("Loaded configuration from " + userConfigPath);
+                        KOLOSAL_LOG_INFO("Loaded configuration from " + userConfigPath);
                         currentConfigFilePath = userConfigPath; // Store exact path used
-                        ServerLogger::instance().info("Stored config file path: " + currentConfigFilePath);
-                        ServerLogger::instance().info("ServerConfig instance address during load: " + std::to_string(reinterpret_cast<uintptr_t>(this)));
+                        KOLOSAL_LOG_INFO("Stored config file path: " + currentConfigFilePath);
+                        KOLOSAL_LOG_INFO("ServerConfig instance address during load: " + std::to_string(reinterpret_cast<uintptr_t>(this)));
                         configLoaded = true;
                     }
                 }
@@ -339,10 +411,10 @@ namespace kolosal
                 if (userFile.good()) {
                     userFile.close();
                     if (loadFromFile(userConfigPath)) {
-                        ServerLogger::instance().info("Loaded configuration from " + userConfigPath);
+                        KOLOSAL_LOG_INFO("Loaded configuration from " + userConfigPath);
                         currentConfigFilePath = userConfigPath; // Store exact path used
-                        ServerLogger::instance().info("Stored config file path: " + currentConfigFilePath);
-                        ServerLogger::instance().info("ServerConfig instance address during load: " + std::to_string(reinterpret_cast<uintptr_t>(this)));
+                        KOLOSAL_LOG_INFO("Stored config file path: " + currentConfigFilePath);
+                        KOLOSAL_LOG_INFO("ServerConfig instance address during load: " + std::to_string(reinterpret_cast<uintptr_t>(this)));
                         configLoaded = true;
                     }
                 }
@@ -356,10 +428,10 @@ namespace kolosal
                 if (userFile.good()) {
                     userFile.close();
                     if (loadFromFile(userConfigPath)) {
-                        ServerLogger::instance().info("Loaded configuration from " + userConfigPath);
+                        KOLOSAL_LOG_INFO("Loaded configuration from " + userConfigPath);
                         currentConfigFilePath = userConfigPath; // Store exact path used
-                        ServerLogger::instance().info("Stored config file path: " + currentConfigFilePath);
-                        ServerLogger::instance().info("ServerConfig instance address during load: " + std::to_string(reinterpret_cast<uintptr_t>(this)));
+                        KOLOSAL_LOG_INFO("Stored config file path: " + currentConfigFilePath);
+                        KOLOSAL_LOG_INFO("ServerConfig instance address during load: " + std::to_string(reinterpret_cast<uintptr_t>(this)));
                         configLoaded = true;
                     }
                 }
@@ -368,7 +440,7 @@ namespace kolosal
         }
         
         if (!configLoaded) {
-            ServerLogger::instance().info("No configuration file found, using default settings");
+            KOLOSAL_LOG_INFO("No configuration file found, using default settings");
         }
 
         // Process command line arguments (they can override config file settings)
@@ -398,9 +470,9 @@ namespace kolosal
                 } else {
                     currentConfigFilePath = std::filesystem::absolute(configFile).string(); // Convert relative to absolute
                 }
-                ServerLogger::instance().info("Loaded configuration from " + configFile);
-                ServerLogger::instance().info("Stored config file path: " + currentConfigFilePath);
-                ServerLogger::instance().info("ServerConfig instance address during load: " + std::to_string(reinterpret_cast<uintptr_t>(this)));
+                KOLOSAL_LOG_INFO("Loaded configuration from " + configFile);
+                KOLOSAL_LOG_INFO("Stored config file path: " + currentConfigFilePath);
+                KOLOSAL_LOG_INFO("ServerConfig instance address during load: " + std::to_string(reinterpret_cast<uintptr_t>(this)));
             }
 
             // Logging options
@@ -416,6 +488,28 @@ namespace kolosal
             {
                 enableAccessLog = true;
             }
+            else if (arg == "--access-log-file" && i + 1 < argc)
+            {
+                enableAccessLog = true;
+                accessLog.file = argv[++i];
+            }
+            else if (arg == "--access-log-format" && i + 1 < argc)
+            {
+                accessLog.format = argv[++i];
+            }
+            else if (arg == "--access-log-sample-rate" && i + 1 < argc)
+            {
+                accessLog.sample_rate = std::stod(argv[++i]);
+            }
+            else if (arg == "--capture-traffic" && i + 1 < argc)
+            {
+                trafficCapture.enabled = true;
+                trafficCapture.file = argv[++i];
+            }
+            else if (arg == "--capture-sample-rate" && i + 1 < argc)
+            {
+                trafficCapture.sample_rate = std::stod(argv[++i]);
+            }
 
             // Authentication options
             else if (arg == "--disable-auth")
@@ -444,6 +538,10 @@ namespace kolosal
             {
                 auth.rateLimiter.windowSize = std::chrono::seconds(std::stoi(argv[++i]));
             }
+            else if ((arg == "--rate-limit-per-key") && i + 1 < argc)
+            {
+                auth.rateLimiter.apiKeyMaxRequests = std::stoul(argv[++i]);
+            }
             else if (arg == "--disable-rate-limit")
             {
                 auth.rateLimiter.enabled = false;
@@ -673,19 +771,19 @@ namespace kolosal
                         std::error_code ec;
                         std::filesystem::copy_file(currentConfigFilePath, userConfigPath, std::filesystem::copy_options::overwrite_existing, ec);
                         if (ec) {
-                            ServerLogger::instance().info("Config migration copy failed: " + ec.message());
+                            KOLOSAL_LOG_INFO("Config migration copy failed: " + ec.message());
                         } else {
-                            ServerLogger::instance().info("Migrated config from '" + currentConfigFilePath + "' to user path '" + userConfigPath + "'");
+                            KOLOSAL_LOG_INFO("Migrated config from '" + currentConfigFilePath + "' to user path '" + userConfigPath + "'");
                         }
                     }
                     // Point current config path to user-writable location regardless of copy success
                     currentConfigFilePath = userConfigPath;
                 } catch (const std::exception& e) {
-                    ServerLogger::instance().info(std::string("Config migration skipped due to error: ") + e.what());
+                    KOLOSAL_LOG_INFO(std::string("Config migration skipped due to error: ") + e.what());
                 }
             }
         } catch (const std::exception& e) {
-            ServerLogger::instance().info(std::string("Config migration wrapper error: ") + e.what());
+            KOLOSAL_LOG_INFO(std::string("Config migration wrapper error: ") + e.what());
         }
 
         return validate();
@@ -705,6 +803,48 @@ namespace kolosal
                     host = server["host"].as<std::string>();
                 if (server["idle_timeout"])
                     idleTimeout = std::chrono::seconds(server["idle_timeout"].as<int>());
+                if (server["io_threads"])
+                    ioThreads = server["io_threads"].as<int>();
+                if (server["accept_threads"])
+                    acceptThreads = server["accept_threads"].as<int>();
+                if (server["health_port"])
+                    healthPort = server["health_port"].as<int>();
+                if (server["upgrade_drain_timeout"])
+                    upgradeDrainTimeout = server["upgrade_drain_timeout"].as<int>();
+                if (server["worker_threads"])
+                    workerThreads = server["worker_threads"].as<int>();
+                if (server["max_worker_threads"])
+                    maxWorkerThreads = server["max_worker_threads"].as<int>();
+                if (server["keep_alive_timeout"])
+                    keepAliveTimeout = server["keep_alive_timeout"].as<int>();
+                if (server["max_keep_alive_requests"])
+                    maxKeepAliveRequests = server["max_keep_alive_requests"].as<int>();
+                if (server["model_memory_budget_mb"])
+                    modelMemoryBudgetMb = server["model_memory_budget_mb"].as<int>();
+                if (server["min_free_memory_mb"])
+                    minFreeMemoryMb = server["min_free_memory_mb"].as<int>();
+                if (server["preload_models"])
+                    preloadModels = server["preload_models"].as<bool>();
+                if (server["hibernate_memory_mb"])
+                    hibernateMemoryMb = server["hibernate_memory_mb"].as<int>();
+                if (server["startup_load_concurrency"])
+                    startupLoadConcurrency = server["startup_load_concurrency"].as<int>();
+                if (server["stream_body_threshold_mb"])
+                    streamBodyThresholdMb = server["stream_body_threshold_mb"].as<int>();
+                if (server["max_body_mb"])
+                    maxBodyMb = server["max_body_mb"].as<int>();
+                if (server["max_decompressed_body_mb"])
+                    maxDecompressedBodyMb = server["max_decompressed_body_mb"].as<int>();
+                if (server["compression_level"])
+                    compressionLevel = server["compression_level"].as<int>();
+                if (server["compression_min_bytes"])
+                    compressionMinBytes = server["compression_min_bytes"].as<int>();
+                if (server["gpu_sample_interval"])
+                    gpuSampleIntervalSeconds = server["gpu_sample_interval"].as<int>();
+                if (server["config_watch_interval"])
+                    configWatchIntervalSeconds = server["config_watch_interval"].as<int>();
+                if (server["unix_socket"])
+                    unixSocket = server["unix_socket"].as<std::string>();
                 if (server["allow_public_access"])
                     allowPublicAccess = server["allow_public_access"].as<bool>();
                 if (server["allow_internet_access"])
@@ -723,8 +863,43 @@ namespace kolosal
                     logLevel = logging["level"].as<std::string>();
                 if (logging["file"])
                     logFile = logging["file"].as<std::string>();
-                if (logging["access_log"])
+                if (logging["access_log"] && logging["access_log"].IsScalar())
+                {
                     enableAccessLog = logging["access_log"].as<bool>();
+                }
+                else if (logging["access_log"] && logging["access_log"].IsMap())
+                {
+                    auto accessLogConfig = logging["access_log"];
+                    enableAccessLog = accessLogConfig["enabled"] ? accessLogConfig["enabled"].as<bool>() : true;
+                    if (accessLogConfig["file"])
+                        accessLog.file = accessLogConfig["file"].as<std::string>();
+                    if (accessLogConfig["format"])
+                        accessLog.format = accessLogConfig["format"].as<std::string>();
+                    if (accessLogConfig["sample_rate"])
+                        accessLog.sample_rate = accessLogConfig["sample_rate"].as<double>();
+                    if (accessLogConfig["always_log_errors"])
+                        accessLog.always_log_errors = accessLogConfig["always_log_errors"].as<bool>();
+                    if (accessLogConfig["max_file_mb"])
+                        accessLog.max_file_mb = accessLogConfig["max_file_mb"].as<int>();
+                    if (accessLogConfig["max_files"])
+                        accessLog.max_files = accessLogConfig["max_files"].as<int>();
+                }
+                if (logging["traffic_capture"])
+                {
+                    auto captureConfig = logging["traffic_capture"];
+                    if (captureConfig["enabled"])
+                        trafficCapture.enabled = captureConfig["enabled"].as<bool>();
+                    if (captureConfig["file"])
+                        trafficCapture.file = captureConfig["file"].as<std::string>();
+                    if (captureConfig["sample_rate"])
+                        trafficCapture.sample_rate = captureConfig["sample_rate"].as<double>();
+                    if (captureConfig["anonymize"])
+                        trafficCapture.anonymize = captureConfig["anonymize"].as<bool>();
+                    if (captureConfig["max_body_kb"])
+                        trafficCapture.max_body_kb = captureConfig["max_body_kb"].as<int>();
+                    if (captureConfig["max_file_mb"])
+                        trafficCapture.max_file_mb = captureConfig["max_file_mb"].as<int>();
+                }
                 if (logging["quiet_mode"])
                     quietMode = logging["quiet_mode"].as<bool>();
                 if (logging["show_request_details"])
@@ -760,6 +935,52 @@ namespace kolosal
                         auth.rateLimiter.maxRequests = rl["max_requests"].as<size_t>();
                     if (rl["window_size"])
                         auth.rateLimiter.windowSize = std::chrono::seconds(rl["window_size"].as<int>());
+                    if (rl["api_key_max_requests"])
+                        auth.rateLimiter.apiKeyMaxRequests = rl["api_key_max_requests"].as<size_t>();
+                }
+
+                // Token quotas
+                if (authConfig["token_quota"])
+                {
+                    auto tq = authConfig["token_quota"];
+                    if (tq["enabled"])
+                        auth.tokenQuota.enabled = tq["enabled"].as<bool>();
+                    if (tq["tokens_per_minute"])
+                        auth.tokenQuota.tokensPerMinute = tq["tokens_per_minute"].as<size_t>();
+                    if (tq["models"] && tq["models"].IsMap())
+                    {
+                        auth.tokenQuota.modelTokensPerMinute.clear();
+                        for (const auto &model : tq["models"])
+                        {
+                            auth.tokenQuota.modelTokensPerMinute[model.first.as<std::string>()] = model.second.as<size_t>();
+                        }
+                    }
+                }
+
+                // Tenant scheduling
+                if (authConfig["tenant_scheduling"])
+                {
+                    auto ts = authConfig["tenant_scheduling"];
+                    auto readShare = [](const YAML::Node &node, auth::TenantShares::Share &share)
+                    {
+                        if (node["weight"])
+                            share.weight = node["weight"].as<float>();
+                        if (node["max_slots"])
+                            share.maxSlots = node["max_slots"].as<int>();
+                    };
+                    if (ts["enabled"])
+                        auth.tenantScheduling.enabled = ts["enabled"].as<bool>();
+                    readShare(ts, auth.tenantScheduling.defaults);
+                    if (ts["api_keys"] && ts["api_keys"].IsMap())
+                    {
+                        auth.tenantScheduling.apiKeys.clear();
+                        for (const auto &key : ts["api_keys"])
+                        {
+                            auth::TenantShares::Share share;
+                            readShare(key.second, share);
+                            auth.tenantScheduling.apiKeys[key.first.as<std::string>()] = share;
+                        }
+                    }
                 }
 
                 // CORS
@@ -823,6 +1044,10 @@ namespace kolosal
                     search.default_language = searchConfig["default_language"].as<std::string>();
                 if (searchConfig["default_category"])
                     search.default_category = searchConfig["default_category"].as<std::string>();
+                if (searchConfig["cache_ttl_seconds"])
+                    search.cache_ttl_seconds = searchConfig["cache_ttl_seconds"].as<int>();
+                if (searchConfig["cache_max_entries"])
+                    search.cache_max_entries = searchConfig["cache_max_entries"].as<int>();
             }
 
             // Load database configuration
@@ -872,6 +1097,14 @@ namespace kolosal
                         database.qdrant.connectionTimeout = qdrantConfig["connection_timeout"].as<int>();
                     if (qdrantConfig["embedding_batch_size"])
                         database.qdrant.embeddingBatchSize = qdrantConfig["embedding_batch_size"].as<int>();
+                    if (qdrantConfig["http2"])
+                        database.qdrant.http2 = qdrantConfig["http2"].as<bool>();
+                    if (qdrantConfig["replicas"])
+                        database.qdrant.replicas = qdrantConfig["replicas"].as<std::vector<std::string>>();
+                    if (qdrantConfig["hedge"])
+                        database.qdrant.hedge = qdrantConfig["hedge"].as<bool>();
+                    if (qdrantConfig["hedge_min_delay_ms"])
+                        database.qdrant.hedgeMinDelayMs = qdrantConfig["hedge_min_delay_ms"].as<int>();
                 }
                 
                 // FAISS configuration
@@ -894,8 +1127,174 @@ namespace kolosal
                         database.faiss.useGPU = faissConfig["use_gpu"].as<bool>();
                     if (faissConfig["gpu_device"])
                         database.faiss.gpuDevice = faissConfig["gpu_device"].as<int>();
+                    if (faissConfig["gpu_mode"])
+                        database.faiss.gpuMode = faissConfig["gpu_mode"].as<std::string>();
+                    if (faissConfig["gpu_devices"])
+                        database.faiss.gpuDevices = faissConfig["gpu_devices"].as<std::vector<int>>();
+                    if (faissConfig["gpu_sync_points"])
+                        database.faiss.gpuSyncPoints = faissConfig["gpu_sync_points"].as<int>();
                     if (faissConfig["metric_type"])
                         database.faiss.metricType = faissConfig["metric_type"].as<std::string>();
+                    if (faissConfig["wal_sync_ms"])
+                        database.faiss.walSyncMs = faissConfig["wal_sync_ms"].as<int>();
+                    if (faissConfig["checkpoint_interval_s"])
+                        database.faiss.checkpointIntervalSec = faissConfig["checkpoint_interval_s"].as<int>();
+                    if (faissConfig["checkpoint_wal_mb"])
+                        database.faiss.checkpointWalMB = faissConfig["checkpoint_wal_mb"].as<int>();
+                    if (faissConfig["delta_merge_points"])
+                        database.faiss.deltaMergePoints = faissConfig["delta_merge_points"].as<int>();
+                    if (faissConfig["auto_index_type"])
+                        database.faiss.autoIndexType = faissConfig["auto_index_type"].as<std::string>();
+                    if (faissConfig["auto_index_threshold"])
+                        database.faiss.autoIndexThreshold = faissConfig["auto_index_threshold"].as<int>();
+                    if (faissConfig["recall_target"])
+                        database.faiss.recallTarget = faissConfig["recall_target"].as<float>();
+                    if (faissConfig["ef_search"])
+                        database.faiss.efSearch = faissConfig["ef_search"].as<int>();
+                    if (faissConfig["tombstone_compact_ratio"])
+                        database.faiss.tombstoneCompactRatio = faissConfig["tombstone_compact_ratio"].as<float>();
+                    if (faissConfig["mmap_index"])
+                        database.faiss.mmapIndex = faissConfig["mmap_index"].as<bool>();
+                    if (faissConfig["disk_rerank_factor"])
+                        database.faiss.diskRerankFactor = faissConfig["disk_rerank_factor"].as<int>();
+                    if (faissConfig["exact_rerank"])
+                        database.faiss.exactRerank = faissConfig["exact_rerank"].as<bool>();
+                    if (faissConfig["text_compression"])
+                        database.faiss.textCompression = faissConfig["text_compression"].as<std::string>();
+                    if (faissConfig["collections"] && faissConfig["collections"].IsMap())
+                    {
+                        for (const auto &entry : faissConfig["collections"])
+                        {
+                            DatabaseConfig::FaissConfig::CollectionConfig collection;
+                            const auto &node = entry.second;
+                            if (node["index_type"])
+                                collection.indexType = node["index_type"].as<std::string>();
+                            if (node["metric_type"])
+                                collection.metricType = node["metric_type"].as<std::string>();
+                            if (node["dimensions"])
+                                collection.dimensions = node["dimensions"].as<int>();
+                            if (node["nlist"])
+                                collection.nlist = node["nlist"].as<int>();
+                            if (node["nprobe"])
+                                collection.nprobe = node["nprobe"].as<int>();
+                            if (node["ef_search"])
+                                collection.efSearch = node["ef_search"].as<int>();
+                            if (node["gpu_mode"])
+                                collection.gpuMode = node["gpu_mode"].as<std::string>();
+                            if (node["text_compression"])
+                                collection.textCompression = node["text_compression"].as<std::string>();
+                            database.faiss.collections[entry.first.as<std::string>()] = collection;
+                        }
+                    }
+                }
+                
+                // Shards of the vector store
+                if (databaseConfig["shards"] && databaseConfig["shards"].IsSequence())
+                {
+                    database.shards.clear();
+                    for (const auto &node : databaseConfig["shards"])
+                    {
+                        DatabaseConfig::ShardConfig shard;
+                        if (node["index_path"])
+                            shard.indexPath = node["index_path"].as<std::string>();
+                        if (node["host"])
+                            shard.host = node["host"].as<std::string>();
+                        if (node["port"])
+                            shard.port = node["port"].as<int>();
+                        if (node["api_key"])
+                            shard.apiKey = node["api_key"].as<std::string>();
+                        if (node["replicas"])
+                            shard.replicas = node["replicas"].as<std::vector<std::string>>();
+                        database.shards.push_back(shard);
+                    }
+                }
+                
+                // Lexical (BM25) index configuration
+                if (databaseConfig["lexical"])
+                {
+                    auto lexicalConfig = databaseConfig["lexical"];
+                    if (lexicalConfig["enabled"])
+                        database.lexical.enabled = lexicalConfig["enabled"].as<bool>();
+                    if (lexicalConfig["k1"])
+                        database.lexical.k1 = lexicalConfig["k1"].as<float>();
+                    if (lexicalConfig["b"])
+                        database.lexical.b = lexicalConfig["b"].as<float>();
+                }
+                
+                // Ingestion pipeline configuration
+                if (databaseConfig["ingestion"])
+                {
+                    auto ingestionConfig = databaseConfig["ingestion"];
+                    if (ingestionConfig["embed_workers"])
+                        database.ingestion.embedWorkers = ingestionConfig["embed_workers"].as<int>();
+                    if (ingestionConfig["upsert_workers"])
+                        database.ingestion.upsertWorkers = ingestionConfig["upsert_workers"].as<int>();
+                    if (ingestionConfig["queue_depth"])
+                        database.ingestion.queueDepth = ingestionConfig["queue_depth"].as<int>();
+                    if (ingestionConfig["background_yield_ms"])
+                        database.ingestion.backgroundYieldMs = ingestionConfig["background_yield_ms"].as<int>();
+                    if (ingestionConfig["dedup"])
+                    {
+                        auto dedupConfig = ingestionConfig["dedup"];
+                        if (dedupConfig["enabled"])
+                            database.ingestion.dedup.enabled = dedupConfig["enabled"].as<bool>();
+                        if (dedupConfig["threshold"])
+                            database.ingestion.dedup.threshold = dedupConfig["threshold"].as<double>();
+                        if (dedupConfig["shingle_words"])
+                            database.ingestion.dedup.shingleWords = dedupConfig["shingle_words"].as<int>();
+                        if (dedupConfig["num_hashes"])
+                            database.ingestion.dedup.numHashes = dedupConfig["num_hashes"].as<int>();
+                    }
+                }
+                
+                // Embedding cache configuration
+                if (databaseConfig["embedding_cache"])
+                {
+                    auto cacheConfig = databaseConfig["embedding_cache"];
+                    if (cacheConfig["enabled"])
+                        database.embeddingCache.enabled = cacheConfig["enabled"].as<bool>();
+                    if (cacheConfig["memory_mb"])
+                        database.embeddingCache.memoryMb = cacheConfig["memory_mb"].as<int>();
+                    if (cacheConfig["path"] && !cacheConfig["path"].as<std::string>().empty())
+                        database.embeddingCache.path = ServerConfig::makeAbsolutePath(cacheConfig["path"].as<std::string>());
+                    if (cacheConfig["disk_mb"])
+                        database.embeddingCache.diskMb = cacheConfig["disk_mb"].as<int>();
+                }
+
+                // Parse result cache configuration
+                if (databaseConfig["parse_cache"])
+                {
+                    auto cacheConfig = databaseConfig["parse_cache"];
+                    if (cacheConfig["enabled"])
+                        database.parseCache.enabled = cacheConfig["enabled"].as<bool>();
+                    if (cacheConfig["path"] && !cacheConfig["path"].as<std::string>().empty())
+                        database.parseCache.path = ServerConfig::makeAbsolutePath(cacheConfig["path"].as<std::string>());
+                    if (cacheConfig["disk_mb"])
+                        database.parseCache.diskMb = cacheConfig["disk_mb"].as<int>();
+                }
+
+                // Precomputed document-chunk KV
+                if (databaseConfig["chunk_kv"])
+                {
+                    auto chunkKvConfig = databaseConfig["chunk_kv"];
+                    if (chunkKvConfig["model"])
+                        database.chunkKv.model = chunkKvConfig["model"].as<std::string>();
+                    if (chunkKvConfig["on_ingest"])
+                        database.chunkKv.onIngest = chunkKvConfig["on_ingest"].as<bool>();
+                    if (chunkKvConfig["min_retrievals"])
+                        database.chunkKv.minRetrievals = chunkKvConfig["min_retrievals"].as<int>();
+                }
+
+                // Following another server's collection
+                if (databaseConfig["replication"])
+                {
+                    auto replicationConfig = databaseConfig["replication"];
+                    if (replicationConfig["source"])
+                        database.replication.source = replicationConfig["source"].as<std::string>();
+                    if (replicationConfig["api_key"])
+                        database.replication.apiKey = replicationConfig["api_key"].as<std::string>();
+                    if (replicationConfig["poll_ms"])
+                        database.replication.pollMs = replicationConfig["poll_ms"].as<int>();
                 }
             }
 
@@ -927,6 +1326,8 @@ namespace kolosal
                         model.mainGpuId = modelConfig["main_gpu_id"].as<int>();
                     if (modelConfig["inference_engine"])
                         model.inferenceEngine = modelConfig["inference_engine"].as<std::string>();
+                    if (modelConfig["sha256"])
+                        model.sha256 = modelConfig["sha256"].as<std::string>();
                     if (modelConfig["load_params"])
                     {
                         auto params = modelConfig["load_params"];
@@ -936,10 +1337,42 @@ namespace kolosal
                             model.loadParams.n_keep = params["n_keep"].as<int>();
                         if (params["use_mmap"])
                             model.loadParams.use_mmap = params["use_mmap"].as<bool>();
+                        if (params["prefetch_weights"])
+                            model.loadParams.prefetch_weights = params["prefetch_weights"].as<bool>();
+                        if (params["huge_pages"])
+                            model.loadParams.huge_pages = params["huge_pages"].as<std::string>();
+                        if (params["repack_cache_mb"])
+                            model.loadParams.repack_cache_mb = params["repack_cache_mb"].as<int>();
                         if (params["use_mlock"])
                             model.loadParams.use_mlock = params["use_mlock"].as<bool>();
                         if (params["n_parallel"])
                             model.loadParams.n_parallel = params["n_parallel"].as<int>();
+                        if (params["n_replicas"])
+                            model.loadParams.n_replicas = params["n_replicas"].as<int>();
+                        if (params["embedding_contexts"])
+                            model.loadParams.embedding_contexts = params["embedding_contexts"].as<int>();
+                        if (params["embedding_batch_window_us"])
+                            model.loadParams.embedding_batch_window_us = params["embedding_batch_window_us"].as<int>();
+                        if (params["n_prefix_cache"])
+                            model.loadParams.n_prefix_cache = params["n_prefix_cache"].as<int>();
+                        if (params["prefix_cache_dir"])
+                            model.loadParams.prefix_cache_dir = params["prefix_cache_dir"].as<std::string>();
+                        if (params["prefix_cache_save_seconds"])
+                            model.loadParams.prefix_cache_save_seconds = params["prefix_cache_save_seconds"].as<int>();
+                        if (params["chunk_cache_mb"])
+                            model.loadParams.chunk_cache_mb = params["chunk_cache_mb"].as<int>();
+                        if (params["preempt_swap_mb"])
+                            model.loadParams.preempt_swap_mb = params["preempt_swap_mb"].as<int>();
+                        if (params["kv_block_tokens"])
+                            model.loadParams.kv_block_tokens = params["kv_block_tokens"].as<int>();
+                        if (params["max_seq_ctx"])
+                            model.loadParams.max_seq_ctx = params["max_seq_ctx"].as<int>();
+                        if (params["max_queued_jobs"])
+                            model.loadParams.max_queued_jobs = params["max_queued_jobs"].as<int>();
+                        if (params["max_queued_tokens"])
+                            model.loadParams.max_queued_tokens = params["max_queued_tokens"].as<int>();
+                        if (params["profile_steps"])
+                            model.loadParams.profile_steps = params["profile_steps"].as<int>();
                         if (params["cont_batching"])
                             model.loadParams.cont_batching = params["cont_batching"].as<bool>();
                         if (params["warmup"])
@@ -950,6 +1383,61 @@ namespace kolosal
                             model.loadParams.n_batch = params["n_batch"].as<int>();
                         if (params["n_ubatch"])
                             model.loadParams.n_ubatch = params["n_ubatch"].as<int>();
+                        if (params["draft_model_path"])
+                            model.loadParams.draft_model_path = params["draft_model_path"].as<std::string>();
+                        if (params["n_draft"])
+                            model.loadParams.n_draft = params["n_draft"].as<int>();
+                        if (params["prompt_lookup"])
+                            model.loadParams.prompt_lookup = params["prompt_lookup"].as<bool>();
+                        if (params["n_threads"])
+                            model.loadParams.n_threads = params["n_threads"].as<int>();
+                        if (params["cpu_cores"])
+                            model.loadParams.cpu_cores = params["cpu_cores"].as<std::string>();
+                        if (params["numa_node"])
+                            model.loadParams.numa_node = params["numa_node"].as<int>();
+                        if (params["cache_type_k"])
+                            model.loadParams.cache_type_k = params["cache_type_k"].as<std::string>();
+                        if (params["cache_type_v"])
+                            model.loadParams.cache_type_v = params["cache_type_v"].as<std::string>();
+                        if (params["fit_vram"])
+                            model.loadParams.fit_vram = params["fit_vram"].as<bool>();
+                        if (params["moe_offload"])
+                            model.loadParams.moe_offload = params["moe_offload"].as<std::string>();
+                        if (params["autotune"])
+                            model.loadParams.autotune = params["autotune"].as<bool>();
+                        if (params["autotune_cache"])
+                            model.loadParams.autotune_cache = params["autotune_cache"].as<std::string>();
+                        if (params["kv_host_cache_mb"])
+                            model.loadParams.kv_host_cache_mb = params["kv_host_cache_mb"].as<int>();
+                        if (params["kv_disk_cache_mb"])
+                            model.loadParams.kv_disk_cache_mb = params["kv_disk_cache_mb"].as<int>();
+                        if (params["kv_disk_cache_dir"])
+                            model.loadParams.kv_disk_cache_dir = params["kv_disk_cache_dir"].as<std::string>();
+                        if (params["n_step_tokens"])
+                            model.loadParams.n_step_tokens = params["n_step_tokens"].as<int>();
+                        if (params["prefill_share"])
+                            model.loadParams.prefill_share = params["prefill_share"].as<float>();
+                        if (params["slo_ttft_ms"])
+                            model.loadParams.slo_ttft_ms = params["slo_ttft_ms"].as<float>();
+                        if (params["slo_tpot_ms"])
+                            model.loadParams.slo_tpot_ms = params["slo_tpot_ms"].as<float>();
+                        if (params["lora_adapters"] && params["lora_adapters"].IsSequence())
+                        {
+                            model.loadParams.lora_adapters.clear();
+                            for (const auto &adapterNode : params["lora_adapters"])
+                            {
+                                LoraAdapterInfo adapter;
+                                if (adapterNode["name"])
+                                    adapter.name = adapterNode["name"].as<std::string>();
+                                if (adapterNode["path"])
+                                    adapter.path = adapterNode["path"].as<std::string>();
+                                if (adapterNode["scale"])
+                                    adapter.scale = adapterNode["scale"].as<float>();
+                                model.loadParams.lora_adapters.push_back(adapter);
+                            }
+                        }
+                        if (params["lora_max_loaded"])
+                            model.loadParams.lora_max_loaded = params["lora_max_loaded"].as<int>();
                     }
 
                     models.push_back(model);
@@ -965,59 +1453,20 @@ namespace kolosal
                     InferenceEngineConfig engine;
                     if (engineConfig["name"])
                         engine.name = engineConfig["name"].as<std::string>();
-                    if (engineConfig["library_path"]) {
-                        // Preserve the raw path for smarter resolution
-                        std::string rawLibPath = engineConfig["library_path"].as<std::string>();
-                        engine.library_path = ServerConfig::makeAbsolutePath(rawLibPath);
-
-#ifndef _WIN32
-                        // If the resolved path still does not exist AND the original path was just a filename
-                        // (common for packaged Linux installs placing libs in /usr/lib), search standard lib dirs.
-                        try {
-                            auto pathExists = std::filesystem::exists(engine.library_path);
-                            bool isSimpleName = (rawLibPath.find('/') == std::string::npos && rawLibPath.find('\\') == std::string::npos);
-                            if (!pathExists && isSimpleName) {
-                                // Candidate search directories (ordered by likelihood)
-                                std::vector<std::filesystem::path> candidates;
-
-                                // Derive prefix from executable path if possible (/usr/bin -> /usr/lib)
-                                char execPathBuf[PATH_MAX];
-#ifdef __APPLE__
-                                // Not used here (Linux specific case) but keep structure consistent
-#elif defined(__linux__)
-                                ssize_t len = readlink("/proc/self/exe", execPathBuf, sizeof(execPathBuf) - 1);
-                                if (len != -1) {
-                                    execPathBuf[len] = '\0';
-                                    std::filesystem::path exePath(execPathBuf);
-                                    auto exeDir = exePath.parent_path();
-                                    if (!exeDir.empty()) {
-                                        candidates.push_back(exeDir);                    // /usr/bin
-                                        candidates.push_back(exeDir.parent_path()/"lib"); // /usr/lib (if exeDir is /usr/bin)
-                                    }
-                                }
-#endif
-                                // Standard library locations
-                                candidates.push_back("/usr/lib");
-                                candidates.push_back("/usr/local/lib");
-                                candidates.push_back("/usr/lib64");
-                                candidates.push_back("/lib");
-                                candidates.push_back("/lib64");
-                                candidates.push_back("/opt/kolosal/lib");
-
-                                for (const auto &dir : candidates) {
-                                    if (dir.empty()) continue;
-                                    std::filesystem::path candidate = dir / rawLibPath;
-                                    if (std::filesystem::exists(candidate)) {
-                                        ServerLogger::instance().info("Resolved engine library '" + rawLibPath + "' to '" + candidate.string() + "'");
-                                        engine.library_path = candidate.string();
-                                        break;
-                                    }
-                                }
-                            }
-                        } catch (const std::exception &e) {
-                            ServerLogger::instance().info(std::string("Engine library resolution warning for '") + engine.name + "': " + e.what());
+                    if (engineConfig["library_path"])
+                        engine.library_path = resolveEngineLibraryPath(engineConfig["library_path"].as<std::string>(), engine.name);
+                    if (engineConfig["variants"])
+                    {
+                        for (const auto &variantNode : engineConfig["variants"])
+                        {
+                            if (!variantNode["library_path"])
+                                continue;
+                            InferenceEngineVariant variant;
+                            variant.library_path = resolveEngineLibraryPath(variantNode["library_path"].as<std::string>(), engine.name);
+                            if (variantNode["features"])
+                                variant.features = variantNode["features"].as<std::vector<std::string>>();
+                            engine.variants.push_back(std::move(variant));
                         }
-#endif // _WIN32
                     }
                     if (engineConfig["version"])
                         engine.version = engineConfig["version"].as<std::string>();
@@ -1027,7 +1476,7 @@ namespace kolosal
                         engine.load_on_startup = engineConfig["load_on_startup"].as<bool>();
 
                     // Only add engines with valid name and library path
-                    if (!engine.name.empty() && !engine.library_path.empty())
+                    if (!engine.name.empty() && (!engine.library_path.empty() || !engine.variants.empty()))
                     {
                         inferenceEngines.push_back(engine);
                     }
@@ -1085,6 +1534,219 @@ namespace kolosal
                     search.default_engine = searchConfig["default_engine"].as<std::string>();
                 if (searchConfig["api_key"])
                     search.api_key = searchConfig["api_key"].as<std::string>();
+                if (searchConfig["cache_ttl_seconds"])
+                    search.cache_ttl_seconds = searchConfig["cache_ttl_seconds"].as<int>();
+                if (searchConfig["cache_max_entries"])
+                    search.cache_max_entries = searchConfig["cache_max_entries"].as<int>();
+            }
+
+            // Load TLS configuration
+            if (config["tls"])
+            {
+                auto tlsConfig = config["tls"];
+                if (tlsConfig["enabled"])
+                    tls.enabled = tlsConfig["enabled"].as<bool>();
+                if (tlsConfig["cert_file"])
+                    tls.cert_file = tlsConfig["cert_file"].as<std::string>();
+                if (tlsConfig["key_file"])
+                    tls.key_file = tlsConfig["key_file"].as<std::string>();
+                if (tlsConfig["kernel_offload"])
+                    tls.kernel_offload = tlsConfig["kernel_offload"].as<bool>();
+                if (tlsConfig["session_tickets"])
+                    tls.session_tickets = tlsConfig["session_tickets"].as<bool>();
+                if (tlsConfig["session_cache_size"])
+                    tls.session_cache_size = tlsConfig["session_cache_size"].as<int>();
+                if (tlsConfig["session_timeout_seconds"])
+                    tls.session_timeout_seconds = tlsConfig["session_timeout_seconds"].as<int>();
+            }
+
+            // Load tracing configuration
+            if (config["tracing"])
+            {
+                auto tracingConfig = config["tracing"];
+                if (tracingConfig["enabled"])
+                    tracing.enabled = tracingConfig["enabled"].as<bool>();
+                if (tracingConfig["sample_rate"])
+                    tracing.sample_rate = tracingConfig["sample_rate"].as<double>();
+                if (tracingConfig["file"])
+                    tracing.file = tracingConfig["file"].as<std::string>();
+                if (tracingConfig["otlp_endpoint"])
+                    tracing.otlp_endpoint = tracingConfig["otlp_endpoint"].as<std::string>();
+                if (tracingConfig["service_name"])
+                    tracing.service_name = tracingConfig["service_name"].as<std::string>();
+                if (tracingConfig["server_timing"])
+                    tracing.server_timing = tracingConfig["server_timing"].as<bool>();
+            }
+
+            // Load response cache configuration
+            if (config["response_cache"])
+            {
+                auto responseCacheConfig = config["response_cache"];
+                if (responseCacheConfig["enabled"])
+                    responseCache.enabled = responseCacheConfig["enabled"].as<bool>();
+                if (responseCacheConfig["ttl_seconds"])
+                    responseCache.ttl_seconds = responseCacheConfig["ttl_seconds"].as<int>();
+                if (responseCacheConfig["memory_mb"])
+                    responseCache.memory_mb = responseCacheConfig["memory_mb"].as<int>();
+                if (responseCacheConfig["max_entry_kb"])
+                    responseCache.max_entry_kb = responseCacheConfig["max_entry_kb"].as<int>();
+                if (responseCacheConfig["semantic"])
+                {
+                    auto semanticConfig = responseCacheConfig["semantic"];
+                    if (semanticConfig["enabled"])
+                        responseCache.semantic.enabled = semanticConfig["enabled"].as<bool>();
+                    if (semanticConfig["embedding_model"])
+                        responseCache.semantic.embedding_model = semanticConfig["embedding_model"].as<std::string>();
+                    if (semanticConfig["threshold"])
+                        responseCache.semantic.threshold = semanticConfig["threshold"].as<float>();
+                    if (semanticConfig["max_entries"])
+                        responseCache.semantic.max_entries = semanticConfig["max_entries"].as<int>();
+                }
+            }
+
+            // Load batch API configuration
+            if (config["batch"])
+            {
+                auto batchConfig = config["batch"];
+                if (batchConfig["enabled"])
+                    batch.enabled = batchConfig["enabled"].as<bool>();
+                if (batchConfig["directory"])
+                    batch.directory = batchConfig["directory"].as<std::string>();
+                if (batchConfig["max_file_mb"])
+                    batch.max_file_mb = batchConfig["max_file_mb"].as<int>();
+                if (batchConfig["reserved_slots"])
+                    batch.reserved_slots = batchConfig["reserved_slots"].as<int>();
+                if (batchConfig["max_in_flight"])
+                    batch.max_in_flight = batchConfig["max_in_flight"].as<int>();
+            }
+
+            // Load async job configuration
+            if (config["jobs"])
+            {
+                auto jobsConfig = config["jobs"];
+                if (jobsConfig["enabled"])
+                    jobs.enabled = jobsConfig["enabled"].as<bool>();
+                if (jobsConfig["max_running"])
+                    jobs.max_running = jobsConfig["max_running"].as<int>();
+                if (jobsConfig["max_queued"])
+                    jobs.max_queued = jobsConfig["max_queued"].as<int>();
+                if (jobsConfig["result_ttl_seconds"])
+                    jobs.result_ttl_seconds = jobsConfig["result_ttl_seconds"].as<int>();
+                if (jobsConfig["webhook_secret"])
+                    jobs.webhook_secret = jobsConfig["webhook_secret"].as<std::string>();
+                if (jobsConfig["webhook_timeout_seconds"])
+                    jobs.webhook_timeout_seconds = jobsConfig["webhook_timeout_seconds"].as<int>();
+                if (jobsConfig["webhook_retries"])
+                    jobs.webhook_retries = jobsConfig["webhook_retries"].as<int>();
+            }
+
+            // Load cluster configuration
+            if (config["cluster"])
+            {
+                auto clusterConfig = config["cluster"];
+                if (clusterConfig["enabled"])
+                    cluster.enabled = clusterConfig["enabled"].as<bool>();
+                if (clusterConfig["node_id"])
+                    cluster.node_id = clusterConfig["node_id"].as<std::string>();
+                if (clusterConfig["advertise_url"])
+                    cluster.advertise_url = clusterConfig["advertise_url"].as<std::string>();
+                if (clusterConfig["peers"] && clusterConfig["peers"].IsSequence())
+                    cluster.peers = clusterConfig["peers"].as<std::vector<std::string>>();
+                if (clusterConfig["api_key"])
+                    cluster.api_key = clusterConfig["api_key"].as<std::string>();
+                if (clusterConfig["heartbeat_ms"])
+                    cluster.heartbeat_ms = clusterConfig["heartbeat_ms"].as<int>();
+                if (clusterConfig["stale_after_ms"])
+                    cluster.stale_after_ms = clusterConfig["stale_after_ms"].as<int>();
+                if (clusterConfig["prefix_chars"])
+                    cluster.prefix_chars = clusterConfig["prefix_chars"].as<int>();
+                if (clusterConfig["virtual_nodes"])
+                    cluster.virtual_nodes = clusterConfig["virtual_nodes"].as<int>();
+                if (clusterConfig["load_factor"])
+                    cluster.load_factor = clusterConfig["load_factor"].as<double>();
+                if (clusterConfig["proxy_timeout_seconds"])
+                    cluster.proxy_timeout_seconds = clusterConfig["proxy_timeout_seconds"].as<int>();
+                if (clusterConfig["drain_grace_seconds"])
+                    cluster.drain_grace_seconds = clusterConfig["drain_grace_seconds"].as<int>();
+                if (clusterConfig["drain_timeout_seconds"])
+                    cluster.drain_timeout_seconds = clusterConfig["drain_timeout_seconds"].as<int>();
+                if (clusterConfig["share_rate_limits"])
+                    cluster.share_rate_limits = clusterConfig["share_rate_limits"].as<bool>();
+            }
+
+            // Load disaggregated prefill configuration
+            if (config["disaggregation"])
+            {
+                auto disaggregationConfig = config["disaggregation"];
+                if (disaggregationConfig["role"])
+                    disaggregation.role = disaggregationConfig["role"].as<std::string>();
+                if (disaggregationConfig["prefill_nodes"] && disaggregationConfig["prefill_nodes"].IsSequence())
+                    disaggregation.prefill_nodes = disaggregationConfig["prefill_nodes"].as<std::vector<std::string>>();
+                if (disaggregationConfig["min_prompt_tokens"])
+                    disaggregation.min_prompt_tokens = disaggregationConfig["min_prompt_tokens"].as<int>();
+                if (disaggregationConfig["api_key"])
+                    disaggregation.api_key = disaggregationConfig["api_key"].as<std::string>();
+                if (disaggregationConfig["timeout_seconds"])
+                    disaggregation.timeout_seconds = disaggregationConfig["timeout_seconds"].as<int>();
+            }
+
+            // Load model aliases routed by context length
+            if (config["model_aliases"] && config["model_aliases"].IsMap())
+            {
+                for (const auto &entry : config["model_aliases"])
+                {
+                    std::vector<std::string> variants;
+                    for (const auto &variant : entry.second)
+                        variants.push_back(variant.as<std::string>());
+                    modelAliases[entry.first.as<std::string>()] = variants;
+                }
+            }
+
+            // Load handler capacity partitions
+            if (config["bulkheads"])
+            {
+                auto readLimits = [](const YAML::Node &node, std::map<std::string, BulkheadConfig::Limit> &limits)
+                {
+                    if (!node || !node.IsMap())
+                        return;
+                    for (const auto &entry : node)
+                    {
+                        BulkheadConfig::Limit limit;
+                        if (entry.second["max_concurrent"])
+                            limit.max_concurrent = entry.second["max_concurrent"].as<int>();
+                        if (entry.second["max_queued"])
+                            limit.max_queued = entry.second["max_queued"].as<int>();
+                        limits[entry.first.as<std::string>()] = limit;
+                    }
+                };
+                readLimits(config["bulkheads"]["classes"], bulkheads.classes);
+                readLimits(config["bulkheads"]["models"], bulkheads.models);
+            }
+
+            // Load download scheduling configuration
+            if (config["downloads"])
+            {
+                auto downloadsConfig = config["downloads"];
+                if (downloadsConfig["max_concurrent"])
+                    downloads.max_concurrent = downloadsConfig["max_concurrent"].as<int>();
+                if (downloadsConfig["max_bytes_per_second"])
+                    downloads.max_bytes_per_second = downloadsConfig["max_bytes_per_second"].as<long long>();
+                if (downloadsConfig["per_download_bytes_per_second"])
+                    downloads.per_download_bytes_per_second = downloadsConfig["per_download_bytes_per_second"].as<long long>();
+                if (downloadsConfig["connections"])
+                    downloads.connections = downloadsConfig["connections"].as<int>();
+                if (downloadsConfig["progress_interval_ms"])
+                    downloads.progress_interval_ms = downloadsConfig["progress_interval_ms"].as<int>();
+                if (downloadsConfig["peers"] && downloadsConfig["peers"].IsSequence())
+                    downloads.peers = downloadsConfig["peers"].as<std::vector<std::string>>();
+                if (downloadsConfig["mirrors"] && downloadsConfig["mirrors"].IsSequence())
+                    downloads.mirrors = downloadsConfig["mirrors"].as<std::vector<std::string>>();
+                if (downloadsConfig["cache_dir"])
+                    downloads.cache_dir = downloadsConfig["cache_dir"].as<std::string>();
+                if (downloadsConfig["peer_api_key"])
+                    downloads.peer_api_key = downloadsConfig["peer_api_key"].as<std::string>();
+                if (downloadsConfig["serve_to_peers"])
+                    downloads.serve_to_peers = downloadsConfig["serve_to_peers"].as<bool>();
             }
 
             return validate();
@@ -1096,119 +1758,441 @@ namespace kolosal
         }
     }
 
-    bool ServerConfig::saveToFile(const std::string &configFile) const
+    std::string ServerConfig::toYaml() const
     {
-        try
+        YAML::Node config; // Server settings
+        config["server"]["port"] = port;
+        config["server"]["host"] = host;
+        config["server"]["idle_timeout"] = static_cast<int>(idleTimeout.count());
+        config["server"]["io_threads"] = ioThreads;
+        config["server"]["accept_threads"] = acceptThreads;
+        config["server"]["health_port"] = healthPort;
+        config["server"]["upgrade_drain_timeout"] = upgradeDrainTimeout;
+        config["server"]["worker_threads"] = workerThreads;
+        config["server"]["max_worker_threads"] = maxWorkerThreads;
+        config["server"]["keep_alive_timeout"] = keepAliveTimeout;
+        config["server"]["max_keep_alive_requests"] = maxKeepAliveRequests;
+        config["server"]["model_memory_budget_mb"] = modelMemoryBudgetMb;
+        config["server"]["min_free_memory_mb"] = minFreeMemoryMb;
+        config["server"]["preload_models"] = preloadModels;
+        config["server"]["hibernate_memory_mb"] = hibernateMemoryMb;
+        config["server"]["startup_load_concurrency"] = startupLoadConcurrency;
+        config["server"]["stream_body_threshold_mb"] = streamBodyThresholdMb;
+        config["server"]["max_body_mb"] = maxBodyMb;
+        config["server"]["max_decompressed_body_mb"] = maxDecompressedBodyMb;
+        config["server"]["compression_level"] = compressionLevel;
+        config["server"]["compression_min_bytes"] = compressionMinBytes;
+        config["server"]["gpu_sample_interval"] = gpuSampleIntervalSeconds;
+        config["server"]["config_watch_interval"] = configWatchIntervalSeconds;
+        if (!unixSocket.empty())
+            config["server"]["unix_socket"] = unixSocket;
+        config["server"]["allow_public_access"] = allowPublicAccess;
+        config["server"]["allow_internet_access"] = allowInternetAccess;            // Logging settings
+        config["logging"]["level"] = logLevel;
+        config["logging"]["file"] = logFile;
+        config["logging"]["access_log"]["enabled"] = enableAccessLog;
+        config["logging"]["access_log"]["file"] = accessLog.file;
+        config["logging"]["access_log"]["format"] = accessLog.format;
+        config["logging"]["access_log"]["sample_rate"] = accessLog.sample_rate;
+        config["logging"]["access_log"]["always_log_errors"] = accessLog.always_log_errors;
+        config["logging"]["access_log"]["max_file_mb"] = accessLog.max_file_mb;
+        config["logging"]["access_log"]["max_files"] = accessLog.max_files;
+        config["logging"]["traffic_capture"]["enabled"] = trafficCapture.enabled;
+        config["logging"]["traffic_capture"]["file"] = trafficCapture.file;
+        config["logging"]["traffic_capture"]["sample_rate"] = trafficCapture.sample_rate;
+        config["logging"]["traffic_capture"]["anonymize"] = trafficCapture.anonymize;
+        config["logging"]["traffic_capture"]["max_body_kb"] = trafficCapture.max_body_kb;
+        config["logging"]["traffic_capture"]["max_file_mb"] = trafficCapture.max_file_mb;
+        config["logging"]["quiet_mode"] = quietMode;
+        config["logging"]["show_request_details"] = showRequestDetails;
+
+        // Authentication settings
+        config["auth"]["enabled"] = auth.enableAuth;
+        config["auth"]["require_api_key"] = auth.requireApiKey;
+        config["auth"]["api_key_header"] = auth.apiKeyHeader;
+        config["auth"]["api_keys"] = auth.allowedApiKeys;
+        config["auth"]["rate_limit"]["enabled"] = auth.rateLimiter.enabled;
+        config["auth"]["rate_limit"]["max_requests"] = auth.rateLimiter.maxRequests;
+        config["auth"]["rate_limit"]["window_size"] = static_cast<int>(auth.rateLimiter.windowSize.count());
+        config["auth"]["rate_limit"]["api_key_max_requests"] = auth.rateLimiter.apiKeyMaxRequests;
+        config["auth"]["token_quota"]["enabled"] = auth.tokenQuota.enabled;
+        config["auth"]["token_quota"]["tokens_per_minute"] = auth.tokenQuota.tokensPerMinute;
+        for (const auto &model : auth.tokenQuota.modelTokensPerMinute)
+            config["auth"]["token_quota"]["models"][model.first] = model.second;
+        config["auth"]["tenant_scheduling"]["enabled"] = auth.tenantScheduling.enabled;
+        config["auth"]["tenant_scheduling"]["weight"] = auth.tenantScheduling.defaults.weight;
+        config["auth"]["tenant_scheduling"]["max_slots"] = auth.tenantScheduling.defaults.maxSlots;
+        for (const auto &key : auth.tenantScheduling.apiKeys)
         {
-            YAML::Node config; // Server settings
-            config["server"]["port"] = port;
-            config["server"]["host"] = host;
-            config["server"]["idle_timeout"] = static_cast<int>(idleTimeout.count());
-            config["server"]["allow_public_access"] = allowPublicAccess;
-            config["server"]["allow_internet_access"] = allowInternetAccess;            // Logging settings
-            config["logging"]["level"] = logLevel;
-            config["logging"]["file"] = logFile;
-            config["logging"]["access_log"] = enableAccessLog;
-            config["logging"]["quiet_mode"] = quietMode;
-            config["logging"]["show_request_details"] = showRequestDetails;
-
-            // Authentication settings
-            config["auth"]["enabled"] = auth.enableAuth;
-            config["auth"]["require_api_key"] = auth.requireApiKey;
-            config["auth"]["api_key_header"] = auth.apiKeyHeader;
-            config["auth"]["api_keys"] = auth.allowedApiKeys;
-            config["auth"]["rate_limit"]["enabled"] = auth.rateLimiter.enabled;
-            config["auth"]["rate_limit"]["max_requests"] = auth.rateLimiter.maxRequests;
-            config["auth"]["rate_limit"]["window_size"] = static_cast<int>(auth.rateLimiter.windowSize.count());
-            config["auth"]["cors"]["enabled"] = auth.cors.enabled;
-            config["auth"]["cors"]["allow_credentials"] = auth.cors.allowCredentials;
-            config["auth"]["cors"]["max_age"] = auth.cors.maxAge;            config["auth"]["cors"]["allowed_origins"] = auth.cors.allowedOrigins;
-            config["auth"]["cors"]["allowed_methods"] = auth.cors.allowedMethods;
-            config["auth"]["cors"]["allowed_headers"] = auth.cors.allowedHeaders;
-            
-            // Search configuration
-            config["search"]["enabled"] = search.enabled;
-            config["search"]["searxng_url"] = search.searxng_url;
-            config["search"]["timeout"] = search.timeout;
-            config["search"]["max_results"] = search.max_results;
-            config["search"]["default_engine"] = search.default_engine;
-            config["search"]["api_key"] = search.api_key;
-            config["search"]["enable_safe_search"] = search.enable_safe_search;
-            config["search"]["default_format"] = search.default_format;
-            config["search"]["default_language"] = search.default_language;
-            config["search"]["default_category"] = search.default_category;
-
-            // Database configuration
-            config["database"]["vector_database"] = (database.vectorDatabase == DatabaseConfig::VectorDatabase::FAISS) ? "faiss" : "qdrant";
-            // Persist the retrieval embedding model ID for both backends
-            config["database"]["retrieval_embedding_model"] = database.retrievalEmbeddingModelId;
-            
-            config["database"]["qdrant"]["enabled"] = database.qdrant.enabled;
-            config["database"]["qdrant"]["host"] = database.qdrant.host;
-            config["database"]["qdrant"]["port"] = database.qdrant.port;
-            config["database"]["qdrant"]["collection_name"] = database.qdrant.collectionName;
-            config["database"]["qdrant"]["default_embedding_model"] = database.qdrant.defaultEmbeddingModel;
-            config["database"]["qdrant"]["timeout"] = database.qdrant.timeout;
-            config["database"]["qdrant"]["api_key"] = database.qdrant.apiKey;
-            config["database"]["qdrant"]["max_connections"] = database.qdrant.maxConnections;
-            config["database"]["qdrant"]["connection_timeout"] = database.qdrant.connectionTimeout;
-            config["database"]["qdrant"]["embedding_batch_size"] = database.qdrant.embeddingBatchSize;
-            
-            config["database"]["faiss"]["index_type"] = database.faiss.indexType;
-            config["database"]["faiss"]["index_path"] = database.faiss.indexPath;
-            config["database"]["faiss"]["dimensions"] = database.faiss.dimensions;
-            config["database"]["faiss"]["normalize_vectors"] = database.faiss.normalizeVectors;
-            config["database"]["faiss"]["nlist"] = database.faiss.nlist;
-            config["database"]["faiss"]["nprobe"] = database.faiss.nprobe;
-            config["database"]["faiss"]["use_gpu"] = database.faiss.useGPU;
-            config["database"]["faiss"]["gpu_device"] = database.faiss.gpuDevice;
-            config["database"]["faiss"]["metric_type"] = database.faiss.metricType;
-
-            // Models
-            for (const auto &model : models)
-            {
-                YAML::Node modelNode;
-                modelNode["id"] = model.id;
-                modelNode["path"] = ServerConfig::makeAbsolutePath(model.path);  // Convert to absolute path
-                modelNode["type"] = model.type;
-                modelNode["load_immediately"] = model.loadImmediately;
-                modelNode["main_gpu_id"] = model.mainGpuId;
-                modelNode["inference_engine"] = model.inferenceEngine;
-                modelNode["load_params"]["n_ctx"] = model.loadParams.n_ctx;
-                modelNode["load_params"]["n_keep"] = model.loadParams.n_keep;
-                modelNode["load_params"]["use_mmap"] = model.loadParams.use_mmap;
-                modelNode["load_params"]["use_mlock"] = model.loadParams.use_mlock;
-                modelNode["load_params"]["n_parallel"] = model.loadParams.n_parallel;
-                modelNode["load_params"]["cont_batching"] = model.loadParams.cont_batching;
-                modelNode["load_params"]["warmup"] = model.loadParams.warmup;
-                modelNode["load_params"]["n_gpu_layers"] = model.loadParams.n_gpu_layers;
-                modelNode["load_params"]["n_batch"] = model.loadParams.n_batch;
-                modelNode["load_params"]["n_ubatch"] = model.loadParams.n_ubatch;
-                config["models"].push_back(modelNode);
-            }
-
-            // Inference engines
-            for (const auto &engine : inferenceEngines)
-            {
-                YAML::Node engineNode;
-                engineNode["name"] = engine.name;
-                engineNode["library_path"] = ServerConfig::makeAbsolutePath(engine.library_path);  // Convert to absolute path
-                engineNode["version"] = engine.version;
-                engineNode["description"] = engine.description;
-                engineNode["load_on_startup"] = engine.load_on_startup;
-                config["inference_engines"].push_back(engineNode);
-            }
+            config["auth"]["tenant_scheduling"]["api_keys"][key.first]["weight"] = key.second.weight;
+            config["auth"]["tenant_scheduling"]["api_keys"][key.first]["max_slots"] = key.second.maxSlots;
+        }
+        config["auth"]["cors"]["enabled"] = auth.cors.enabled;
+        config["auth"]["cors"]["allow_credentials"] = auth.cors.allowCredentials;
+        config["auth"]["cors"]["max_age"] = auth.cors.maxAge;            config["auth"]["cors"]["allowed_origins"] = auth.cors.allowedOrigins;
+        config["auth"]["cors"]["allowed_methods"] = auth.cors.allowedMethods;
+        config["auth"]["cors"]["allowed_headers"] = auth.cors.allowedHeaders;
+        
+        // Search configuration
+        config["search"]["enabled"] = search.enabled;
+        config["search"]["searxng_url"] = search.searxng_url;
+        config["search"]["timeout"] = search.timeout;
+        config["search"]["max_results"] = search.max_results;
+        config["search"]["default_engine"] = search.default_engine;
+        config["search"]["api_key"] = search.api_key;
+        config["search"]["enable_safe_search"] = search.enable_safe_search;
+        config["search"]["default_format"] = search.default_format;
+        config["search"]["default_language"] = search.default_language;
+        config["search"]["default_category"] = search.default_category;
+        config["search"]["cache_ttl_seconds"] = search.cache_ttl_seconds;
+        config["search"]["cache_max_entries"] = search.cache_max_entries;
+
+        // TLS configuration
+        config["tls"]["enabled"] = tls.enabled;
+        config["tls"]["cert_file"] = tls.cert_file;
+        config["tls"]["key_file"] = tls.key_file;
+        config["tls"]["kernel_offload"] = tls.kernel_offload;
+        config["tls"]["session_tickets"] = tls.session_tickets;
+        config["tls"]["session_cache_size"] = tls.session_cache_size;
+        config["tls"]["session_timeout_seconds"] = tls.session_timeout_seconds;
+
+        // Tracing configuration
+        config["tracing"]["enabled"] = tracing.enabled;
+        config["tracing"]["sample_rate"] = tracing.sample_rate;
+        config["tracing"]["file"] = tracing.file;
+        config["tracing"]["otlp_endpoint"] = tracing.otlp_endpoint;
+        config["tracing"]["service_name"] = tracing.service_name;
+        config["tracing"]["server_timing"] = tracing.server_timing;
+
+        config["response_cache"]["enabled"] = responseCache.enabled;
+        config["response_cache"]["ttl_seconds"] = responseCache.ttl_seconds;
+        config["response_cache"]["memory_mb"] = responseCache.memory_mb;
+        config["response_cache"]["max_entry_kb"] = responseCache.max_entry_kb;
+        config["response_cache"]["semantic"]["enabled"] = responseCache.semantic.enabled;
+        config["response_cache"]["semantic"]["embedding_model"] = responseCache.semantic.embedding_model;
+        config["response_cache"]["semantic"]["threshold"] = responseCache.semantic.threshold;
+        config["response_cache"]["semantic"]["max_entries"] = responseCache.semantic.max_entries;
+
+        config["batch"]["enabled"] = batch.enabled;
+        config["batch"]["directory"] = batch.directory;
+        config["batch"]["max_file_mb"] = batch.max_file_mb;
+        config["batch"]["reserved_slots"] = batch.reserved_slots;
+        config["batch"]["max_in_flight"] = batch.max_in_flight;
+
+        config["jobs"]["enabled"] = jobs.enabled;
+        config["jobs"]["max_running"] = jobs.max_running;
+        config["jobs"]["max_queued"] = jobs.max_queued;
+        config["jobs"]["result_ttl_seconds"] = jobs.result_ttl_seconds;
+        config["jobs"]["webhook_secret"] = jobs.webhook_secret;
+        config["jobs"]["webhook_timeout_seconds"] = jobs.webhook_timeout_seconds;
+        config["jobs"]["webhook_retries"] = jobs.webhook_retries;
+
+        config["cluster"]["enabled"] = cluster.enabled;
+        config["cluster"]["node_id"] = cluster.node_id;
+        config["cluster"]["advertise_url"] = cluster.advertise_url;
+        for (const auto &peer : cluster.peers)
+            config["cluster"]["peers"].push_back(peer);
+        config["cluster"]["api_key"] = cluster.api_key;
+        config["cluster"]["heartbeat_ms"] = cluster.heartbeat_ms;
+        config["cluster"]["stale_after_ms"] = cluster.stale_after_ms;
+        config["cluster"]["prefix_chars"] = cluster.prefix_chars;
+        config["cluster"]["virtual_nodes"] = cluster.virtual_nodes;
+        config["cluster"]["load_factor"] = cluster.load_factor;
+        config["cluster"]["proxy_timeout_seconds"] = cluster.proxy_timeout_seconds;
+        config["cluster"]["drain_grace_seconds"] = cluster.drain_grace_seconds;
+        config["cluster"]["drain_timeout_seconds"] = cluster.drain_timeout_seconds;
+        config["cluster"]["share_rate_limits"] = cluster.share_rate_limits;
+
+        config["disaggregation"]["role"] = disaggregation.role;
+        for (const auto &node : disaggregation.prefill_nodes)
+            config["disaggregation"]["prefill_nodes"].push_back(node);
+        config["disaggregation"]["min_prompt_tokens"] = disaggregation.min_prompt_tokens;
+        config["disaggregation"]["api_key"] = disaggregation.api_key;
+        config["disaggregation"]["timeout_seconds"] = disaggregation.timeout_seconds;
+
+        // Model aliases
+        for (const auto &entry : modelAliases)
+        {
+            for (const auto &variant : entry.second)
+                config["model_aliases"][entry.first].push_back(variant);
+        }
 
-            // Default inference engine
-            if (!defaultInferenceEngine.empty())
-            {
-                config["default_inference_engine"] = defaultInferenceEngine;
+        // Handler capacity partitions
+        for (const auto &entry : bulkheads.classes)
+        {
+            config["bulkheads"]["classes"][entry.first]["max_concurrent"] = entry.second.max_concurrent;
+            config["bulkheads"]["classes"][entry.first]["max_queued"] = entry.second.max_queued;
+        }
+        for (const auto &entry : bulkheads.models)
+        {
+            config["bulkheads"]["models"][entry.first]["max_concurrent"] = entry.second.max_concurrent;
+            config["bulkheads"]["models"][entry.first]["max_queued"] = entry.second.max_queued;
+        }
+
+        // Download scheduling configuration
+        config["downloads"]["max_concurrent"] = downloads.max_concurrent;
+        config["downloads"]["max_bytes_per_second"] = downloads.max_bytes_per_second;
+        config["downloads"]["per_download_bytes_per_second"] = downloads.per_download_bytes_per_second;
+        config["downloads"]["connections"] = downloads.connections;
+        config["downloads"]["progress_interval_ms"] = downloads.progress_interval_ms;
+        for (const auto &peer : downloads.peers)
+            config["downloads"]["peers"].push_back(peer);
+        for (const auto &mirror : downloads.mirrors)
+            config["downloads"]["mirrors"].push_back(mirror);
+        if (!downloads.cache_dir.empty())
+            config["downloads"]["cache_dir"] = downloads.cache_dir;
+        if (!downloads.peer_api_key.empty())
+            config["downloads"]["peer_api_key"] = downloads.peer_api_key;
+        config["downloads"]["serve_to_peers"] = downloads.serve_to_peers;
+
+        // Database configuration
+        config["database"]["vector_database"] = (database.vectorDatabase == DatabaseConfig::VectorDatabase::FAISS) ? "faiss" : "qdrant";
+        // Persist the retrieval embedding model ID for both backends
+        config["database"]["retrieval_embedding_model"] = database.retrievalEmbeddingModelId;
+        
+        config["database"]["qdrant"]["enabled"] = database.qdrant.enabled;
+        config["database"]["qdrant"]["host"] = database.qdrant.host;
+        config["database"]["qdrant"]["port"] = database.qdrant.port;
+        config["database"]["qdrant"]["collection_name"] = database.qdrant.collectionName;
+        config["database"]["qdrant"]["default_embedding_model"] = database.qdrant.defaultEmbeddingModel;
+        config["database"]["qdrant"]["timeout"] = database.qdrant.timeout;
+        config["database"]["qdrant"]["api_key"] = database.qdrant.apiKey;
+        config["database"]["qdrant"]["max_connections"] = database.qdrant.maxConnections;
+        config["database"]["qdrant"]["connection_timeout"] = database.qdrant.connectionTimeout;
+        config["database"]["qdrant"]["embedding_batch_size"] = database.qdrant.embeddingBatchSize;
+        config["database"]["qdrant"]["http2"] = database.qdrant.http2;
+        config["database"]["qdrant"]["replicas"] = database.qdrant.replicas;
+        config["database"]["qdrant"]["hedge"] = database.qdrant.hedge;
+        config["database"]["qdrant"]["hedge_min_delay_ms"] = database.qdrant.hedgeMinDelayMs;
+        
+        config["database"]["faiss"]["index_type"] = database.faiss.indexType;
+        config["database"]["faiss"]["index_path"] = database.faiss.indexPath;
+        config["database"]["faiss"]["dimensions"] = database.faiss.dimensions;
+        config["database"]["faiss"]["normalize_vectors"] = database.faiss.normalizeVectors;
+        config["database"]["faiss"]["nlist"] = database.faiss.nlist;
+        config["database"]["faiss"]["nprobe"] = database.faiss.nprobe;
+        config["database"]["faiss"]["use_gpu"] = database.faiss.useGPU;
+        config["database"]["faiss"]["gpu_device"] = database.faiss.gpuDevice;
+        config["database"]["faiss"]["gpu_mode"] = database.faiss.gpuMode;
+        if (!database.faiss.gpuDevices.empty())
+            config["database"]["faiss"]["gpu_devices"] = database.faiss.gpuDevices;
+        config["database"]["faiss"]["gpu_sync_points"] = database.faiss.gpuSyncPoints;
+        config["database"]["faiss"]["metric_type"] = database.faiss.metricType;
+        config["database"]["faiss"]["wal_sync_ms"] = database.faiss.walSyncMs;
+        config["database"]["faiss"]["checkpoint_interval_s"] = database.faiss.checkpointIntervalSec;
+        config["database"]["faiss"]["checkpoint_wal_mb"] = database.faiss.checkpointWalMB;
+        config["database"]["faiss"]["delta_merge_points"] = database.faiss.deltaMergePoints;
+        config["database"]["faiss"]["auto_index_type"] = database.faiss.autoIndexType;
+        config["database"]["faiss"]["auto_index_threshold"] = database.faiss.autoIndexThreshold;
+        config["database"]["faiss"]["recall_target"] = database.faiss.recallTarget;
+        config["database"]["faiss"]["ef_search"] = database.faiss.efSearch;
+        config["database"]["faiss"]["tombstone_compact_ratio"] = database.faiss.tombstoneCompactRatio;
+        config["database"]["faiss"]["mmap_index"] = database.faiss.mmapIndex;
+        config["database"]["faiss"]["disk_rerank_factor"] = database.faiss.diskRerankFactor;
+        config["database"]["faiss"]["exact_rerank"] = database.faiss.exactRerank;
+        config["database"]["faiss"]["text_compression"] = database.faiss.textCompression;
+        for (const auto &[name, collection] : database.faiss.collections)
+        {
+            YAML::Node node;
+            if (!collection.indexType.empty())
+                node["index_type"] = collection.indexType;
+            if (!collection.metricType.empty())
+                node["metric_type"] = collection.metricType;
+            if (collection.dimensions > 0)
+                node["dimensions"] = collection.dimensions;
+            if (collection.nlist > 0)
+                node["nlist"] = collection.nlist;
+            if (collection.nprobe > 0)
+                node["nprobe"] = collection.nprobe;
+            if (collection.efSearch > 0)
+                node["ef_search"] = collection.efSearch;
+            if (!collection.gpuMode.empty())
+                node["gpu_mode"] = collection.gpuMode;
+            if (!collection.textCompression.empty())
+                node["text_compression"] = collection.textCompression;
+            config["database"]["faiss"]["collections"][name] = node;
+        }
+        
+        for (const auto &shard : database.shards)
+        {
+            YAML::Node node(YAML::NodeType::Map);
+            if (!shard.indexPath.empty())
+                node["index_path"] = shard.indexPath;
+            if (!shard.host.empty())
+                node["host"] = shard.host;
+            if (shard.port > 0)
+                node["port"] = shard.port;
+            if (!shard.apiKey.empty())
+                node["api_key"] = shard.apiKey;
+            if (!shard.replicas.empty())
+                node["replicas"] = shard.replicas;
+            config["database"]["shards"].push_back(node);
+        }
+        
+        config["database"]["lexical"]["enabled"] = database.lexical.enabled;
+        config["database"]["lexical"]["k1"] = database.lexical.k1;
+        config["database"]["lexical"]["b"] = database.lexical.b;
+        
+        config["database"]["ingestion"]["embed_workers"] = database.ingestion.embedWorkers;
+        config["database"]["ingestion"]["upsert_workers"] = database.ingestion.upsertWorkers;
+        config["database"]["ingestion"]["queue_depth"] = database.ingestion.queueDepth;
+        config["database"]["ingestion"]["background_yield_ms"] = database.ingestion.backgroundYieldMs;
+        config["database"]["ingestion"]["dedup"]["enabled"] = database.ingestion.dedup.enabled;
+        config["database"]["ingestion"]["dedup"]["threshold"] = database.ingestion.dedup.threshold;
+        config["database"]["ingestion"]["dedup"]["shingle_words"] = database.ingestion.dedup.shingleWords;
+        config["database"]["ingestion"]["dedup"]["num_hashes"] = database.ingestion.dedup.numHashes;
+        
+        config["database"]["embedding_cache"]["enabled"] = database.embeddingCache.enabled;
+        config["database"]["embedding_cache"]["memory_mb"] = database.embeddingCache.memoryMb;
+        config["database"]["embedding_cache"]["path"] = database.embeddingCache.path;
+        config["database"]["embedding_cache"]["disk_mb"] = database.embeddingCache.diskMb;
+
+        config["database"]["parse_cache"]["enabled"] = database.parseCache.enabled;
+        config["database"]["parse_cache"]["path"] = database.parseCache.path;
+        config["database"]["parse_cache"]["disk_mb"] = database.parseCache.diskMb;
+
+        config["database"]["chunk_kv"]["model"] = database.chunkKv.model;
+        config["database"]["chunk_kv"]["on_ingest"] = database.chunkKv.onIngest;
+        config["database"]["chunk_kv"]["min_retrievals"] = database.chunkKv.minRetrievals;
+
+        config["database"]["replication"]["source"] = database.replication.source;
+        config["database"]["replication"]["api_key"] = database.replication.apiKey;
+        config["database"]["replication"]["poll_ms"] = database.replication.pollMs;
+
+        // Models
+        for (const auto &model : models)
+        {
+            YAML::Node modelNode;
+            modelNode["id"] = model.id;
+            modelNode["path"] = ServerConfig::makeAbsolutePath(model.path);  // Convert to absolute path
+            modelNode["type"] = model.type;
+            modelNode["load_immediately"] = model.loadImmediately;
+            modelNode["main_gpu_id"] = model.mainGpuId;
+            modelNode["inference_engine"] = model.inferenceEngine;
+            if (!model.sha256.empty())
+                modelNode["sha256"] = model.sha256;
+            modelNode["load_params"]["n_ctx"] = model.loadParams.n_ctx;
+            modelNode["load_params"]["n_keep"] = model.loadParams.n_keep;
+            modelNode["load_params"]["use_mmap"] = model.loadParams.use_mmap;
+            modelNode["load_params"]["prefetch_weights"] = model.loadParams.prefetch_weights;
+            if (model.loadParams.huge_pages != "off")
+                modelNode["load_params"]["huge_pages"] = model.loadParams.huge_pages;
+            if (model.loadParams.repack_cache_mb > 0)
+                modelNode["load_params"]["repack_cache_mb"] = model.loadParams.repack_cache_mb;
+            modelNode["load_params"]["use_mlock"] = model.loadParams.use_mlock;
+            modelNode["load_params"]["n_parallel"] = model.loadParams.n_parallel;
+            modelNode["load_params"]["n_replicas"] = model.loadParams.n_replicas;
+            if (model.loadParams.embedding_contexts != 1)
+                modelNode["load_params"]["embedding_contexts"] = model.loadParams.embedding_contexts;
+            if (model.loadParams.embedding_batch_window_us > 0)
+                modelNode["load_params"]["embedding_batch_window_us"] = model.loadParams.embedding_batch_window_us;
+            modelNode["load_params"]["n_prefix_cache"] = model.loadParams.n_prefix_cache;
+            if (!model.loadParams.prefix_cache_dir.empty())
+                modelNode["load_params"]["prefix_cache_dir"] = model.loadParams.prefix_cache_dir;
+            modelNode["load_params"]["prefix_cache_save_seconds"] = model.loadParams.prefix_cache_save_seconds;
+            modelNode["load_params"]["chunk_cache_mb"] = model.loadParams.chunk_cache_mb;
+            modelNode["load_params"]["preempt_swap_mb"] = model.loadParams.preempt_swap_mb;
+            modelNode["load_params"]["kv_block_tokens"] = model.loadParams.kv_block_tokens;
+            modelNode["load_params"]["max_seq_ctx"] = model.loadParams.max_seq_ctx;
+            modelNode["load_params"]["max_queued_jobs"] = model.loadParams.max_queued_jobs;
+            modelNode["load_params"]["max_queued_tokens"] = model.loadParams.max_queued_tokens;
+            modelNode["load_params"]["profile_steps"] = model.loadParams.profile_steps;
+            modelNode["load_params"]["cont_batching"] = model.loadParams.cont_batching;
+            modelNode["load_params"]["warmup"] = model.loadParams.warmup;
+            modelNode["load_params"]["n_gpu_layers"] = model.loadParams.n_gpu_layers;
+            modelNode["load_params"]["n_batch"] = model.loadParams.n_batch;
+            modelNode["load_params"]["n_ubatch"] = model.loadParams.n_ubatch;
+            modelNode["load_params"]["n_step_tokens"] = model.loadParams.n_step_tokens;
+            if (!model.loadParams.draft_model_path.empty())
+            {
+                modelNode["load_params"]["draft_model_path"] = model.loadParams.draft_model_path;
+            }
+            if (!model.loadParams.draft_model_path.empty() || model.loadParams.prompt_lookup)
+            {
+                modelNode["load_params"]["n_draft"] = model.loadParams.n_draft;
+            }
+            if (model.loadParams.prompt_lookup)
+            {
+                modelNode["load_params"]["prompt_lookup"] = true;
+            }
+            modelNode["load_params"]["prefill_share"] = model.loadParams.prefill_share;
+            if (model.loadParams.slo_ttft_ms > 0.0f)
+                modelNode["load_params"]["slo_ttft_ms"] = model.loadParams.slo_ttft_ms;
+            if (model.loadParams.slo_tpot_ms > 0.0f)
+                modelNode["load_params"]["slo_tpot_ms"] = model.loadParams.slo_tpot_ms;
+            modelNode["load_params"]["n_threads"] = model.loadParams.n_threads;
+            if (!model.loadParams.cpu_cores.empty())
+                modelNode["load_params"]["cpu_cores"] = model.loadParams.cpu_cores;
+            modelNode["load_params"]["numa_node"] = model.loadParams.numa_node;
+            modelNode["load_params"]["cache_type_k"] = model.loadParams.cache_type_k;
+            modelNode["load_params"]["cache_type_v"] = model.loadParams.cache_type_v;
+            modelNode["load_params"]["fit_vram"] = model.loadParams.fit_vram;
+            if (model.loadParams.moe_offload != "off")
+                modelNode["load_params"]["moe_offload"] = model.loadParams.moe_offload;
+            if (model.loadParams.autotune)
+                modelNode["load_params"]["autotune"] = true;
+            if (!model.loadParams.autotune_cache.empty())
+                modelNode["load_params"]["autotune_cache"] = model.loadParams.autotune_cache;
+            modelNode["load_params"]["kv_host_cache_mb"] = model.loadParams.kv_host_cache_mb;
+            modelNode["load_params"]["kv_disk_cache_mb"] = model.loadParams.kv_disk_cache_mb;
+            if (!model.loadParams.kv_disk_cache_dir.empty())
+                modelNode["load_params"]["kv_disk_cache_dir"] = model.loadParams.kv_disk_cache_dir;
+            if (!model.loadParams.lora_adapters.empty())
+            {
+                for (const auto &adapter : model.loadParams.lora_adapters)
+                {
+                    YAML::Node adapterNode;
+                    adapterNode["name"] = adapter.name;
+                    adapterNode["path"] = adapter.path;
+                    adapterNode["scale"] = adapter.scale;
+                    modelNode["load_params"]["lora_adapters"].push_back(adapterNode);
+                }
+                modelNode["load_params"]["lora_max_loaded"] = model.loadParams.lora_max_loaded;
             }
+            config["models"].push_back(modelNode);
+        }
 
-            // Feature flags
-            config["features"]["health_check"] = enableHealthCheck;
-            config["features"]["metrics"] = enableMetrics;
+        // Inference engines
+        for (const auto &engine : inferenceEngines)
+        {
+            YAML::Node engineNode;
+            engineNode["name"] = engine.name;
+            if (!engine.library_path.empty())
+                engineNode["library_path"] = ServerConfig::makeAbsolutePath(engine.library_path);  // Convert to absolute path
+            for (const auto &variant : engine.variants)
+            {
+                YAML::Node variantNode;
+                variantNode["library_path"] = ServerConfig::makeAbsolutePath(variant.library_path);
+                for (const auto &feature : variant.features)
+                    variantNode["features"].push_back(feature);
+                engineNode["variants"].push_back(variantNode);
+            }
+            engineNode["version"] = engine.version;
+            engineNode["description"] = engine.description;
+            engineNode["load_on_startup"] = engine.load_on_startup;
+            config["inference_engines"].push_back(engineNode);
+        }
+
+        // Default inference engine
+        if (!defaultInferenceEngine.empty())
+        {
+            config["default_inference_engine"] = defaultInferenceEngine;
+        }
+
+        // Feature flags
+        config["features"]["health_check"] = enableHealthCheck;
+        config["features"]["metrics"] = enableMetrics;
 
+        YAML::Emitter out;
+        out << config;
+        return out.c_str();
+    }
+
+    bool ServerConfig::saveToFile(const std::string &configFile) const
+    {
+        try
+        {
+            const std::string yaml = toYaml();
             std::ofstream file(configFile);
             if (!file.is_open())
             {
@@ -1216,7 +2200,7 @@ namespace kolosal
                 return false;
             }
 
-            file << config;
+            file << yaml;
             return true;
         }
         catch (const std::exception &e)
@@ -1249,6 +2233,245 @@ namespace kolosal
             return false;
         }
 
+        if (modelMemoryBudgetMb < 0 || minFreeMemoryMb < 0 || hibernateMemoryMb < 0)
+        {
+            std::cerr << "Error: model_memory_budget_mb, min_free_memory_mb and hibernate_memory_mb cannot be negative" << std::endl;
+            return false;
+        }
+        if (startupLoadConcurrency < 0)
+        {
+            std::cerr << "Error: startup_load_concurrency cannot be negative" << std::endl;
+            return false;
+        }
+        if (streamBodyThresholdMb < 0)
+        {
+            std::cerr << "Error: stream_body_threshold_mb cannot be negative" << std::endl;
+            return false;
+        }
+        if (healthPort < 0 || healthPort > 65535)
+        {
+            std::cerr << "Error: health_port must be between 0 and 65535" << std::endl;
+            return false;
+        }
+        if (maxBodyMb < 0)
+        {
+            std::cerr << "Error: max_body_mb cannot be negative" << std::endl;
+            return false;
+        }
+        if (maxDecompressedBodyMb < 0)
+        {
+            std::cerr << "Error: max_decompressed_body_mb cannot be negative" << std::endl;
+            return false;
+        }
+        if (compressionLevel < 0 || compressionLevel > 9)
+        {
+            std::cerr << "Error: compression_level must be between 0 and 9" << std::endl;
+            return false;
+        }
+        if (tls.enabled && (tls.cert_file.empty() || tls.key_file.empty()))
+        {
+            std::cerr << "Error: tls needs both cert_file and key_file" << std::endl;
+            return false;
+        }
+        if (tls.session_cache_size < 0 || tls.session_timeout_seconds <= 0)
+        {
+            std::cerr << "Error: tls session_cache_size must be >= 0 and session_timeout_seconds > 0" << std::endl;
+            return false;
+        }
+        if (tracing.sample_rate < 0.0 || tracing.sample_rate > 1.0)
+        {
+            std::cerr << "Error: tracing sample_rate must be between 0 and 1" << std::endl;
+            return false;
+        }
+        if (accessLog.sample_rate < 0.0 || accessLog.sample_rate > 1.0)
+        {
+            std::cerr << "Error: access_log sample_rate must be between 0 and 1" << std::endl;
+            return false;
+        }
+        if (accessLog.format != "ndjson" && accessLog.format != "binary")
+        {
+            std::cerr << "Error: access_log format must be 'ndjson' or 'binary'" << std::endl;
+            return false;
+        }
+        if (trafficCapture.sample_rate < 0.0 || trafficCapture.sample_rate > 1.0)
+        {
+            std::cerr << "Error: traffic_capture sample_rate must be between 0 and 1" << std::endl;
+            return false;
+        }
+        if (trafficCapture.enabled && trafficCapture.file.empty())
+        {
+            std::cerr << "Error: traffic_capture file cannot be empty" << std::endl;
+            return false;
+        }
+        if (trafficCapture.max_body_kb < 0 || trafficCapture.max_file_mb < 0)
+        {
+            std::cerr << "Error: traffic_capture max_body_kb and max_file_mb cannot be negative" << std::endl;
+            return false;
+        }
+        if (responseCache.ttl_seconds < 0 || responseCache.memory_mb < 0 || responseCache.max_entry_kb < 0)
+        {
+            std::cerr << "Error: response_cache ttl_seconds, memory_mb and max_entry_kb must not be negative" << std::endl;
+            return false;
+        }
+        if (responseCache.semantic.enabled)
+        {
+            if (responseCache.semantic.embedding_model.empty())
+            {
+                std::cerr << "Error: response_cache semantic needs an embedding_model" << std::endl;
+                return false;
+            }
+            if (responseCache.semantic.threshold <= 0.0f || responseCache.semantic.threshold > 1.0f ||
+                responseCache.semantic.max_entries <= 0)
+            {
+                std::cerr << "Error: response_cache semantic threshold must be in (0, 1] and max_entries positive" << std::endl;
+                return false;
+            }
+        }
+        if (batch.enabled && batch.directory.empty())
+        {
+            std::cerr << "Error: batch directory must not be empty" << std::endl;
+            return false;
+        }
+        if (batch.max_file_mb <= 0 || batch.reserved_slots < 0 || batch.max_in_flight <= 0)
+        {
+            std::cerr << "Error: batch max_file_mb and max_in_flight must be positive, reserved_slots not negative" << std::endl;
+            return false;
+        }
+        if (jobs.max_running <= 0 || jobs.max_queued <= 0 || jobs.result_ttl_seconds <= 0 ||
+            jobs.webhook_timeout_seconds <= 0 || jobs.webhook_retries < 0)
+        {
+            std::cerr << "Error: jobs max_running, max_queued, result_ttl_seconds and webhook_timeout_seconds must be positive, "
+                      << "webhook_retries not negative" << std::endl;
+            return false;
+        }
+        if (cluster.enabled && cluster.advertise_url.empty())
+        {
+            std::cerr << "Error: cluster advertise_url is required when the cluster is enabled" << std::endl;
+            return false;
+        }
+        if (cluster.heartbeat_ms <= 0 || cluster.stale_after_ms < cluster.heartbeat_ms || cluster.prefix_chars <= 0 ||
+            cluster.virtual_nodes <= 0 || cluster.load_factor < 1.0 || cluster.proxy_timeout_seconds <= 0)
+        {
+            std::cerr << "Error: cluster heartbeat_ms, prefix_chars, virtual_nodes and proxy_timeout_seconds must be positive, "
+                         "stale_after_ms at least heartbeat_ms and load_factor at least 1" << std::endl;
+            return false;
+        }
+        if (cluster.drain_grace_seconds < 0 || cluster.drain_timeout_seconds < cluster.drain_grace_seconds)
+        {
+            std::cerr << "Error: cluster drain_grace_seconds must not be negative and drain_timeout_seconds "
+                         "must be at least drain_grace_seconds" << std::endl;
+            return false;
+        }
+        if (disaggregation.role != "combined" && disaggregation.role != "prefill" && disaggregation.role != "decode")
+        {
+            std::cerr << "Error: disaggregation role must be 'combined', 'prefill' or 'decode'" << std::endl;
+            return false;
+        }
+        if (disaggregation.role == "decode" && disaggregation.prefill_nodes.empty())
+        {
+            std::cerr << "Error: disaggregation prefill_nodes is required for the decode role" << std::endl;
+            return false;
+        }
+        if (disaggregation.min_prompt_tokens < 0 || disaggregation.timeout_seconds <= 0)
+        {
+            std::cerr << "Error: disaggregation min_prompt_tokens must not be negative and timeout_seconds must be positive" << std::endl;
+            return false;
+        }
+        if (enableAccessLog && accessLog.file.empty())
+        {
+            std::cerr << "Error: access_log file cannot be empty" << std::endl;
+            return false;
+        }
+        if (accessLog.max_file_mb < 0 || accessLog.max_files < 0)
+        {
+            std::cerr << "Error: access_log max_file_mb and max_files cannot be negative" << std::endl;
+            return false;
+        }
+        if (compressionMinBytes < 0)
+        {
+            std::cerr << "Error: compression_min_bytes cannot be negative" << std::endl;
+            return false;
+        }
+        if (gpuSampleIntervalSeconds < 0)
+        {
+            std::cerr << "Error: gpu_sample_interval cannot be negative" << std::endl;
+            return false;
+        }
+        if (configWatchIntervalSeconds < 0)
+        {
+            std::cerr << "Error: config_watch_interval cannot be negative" << std::endl;
+            return false;
+        }
+        for (const auto &entry : modelAliases)
+        {
+            if (entry.second.empty())
+            {
+                std::cerr << "Error: Model alias '" << entry.first << "' has no variants" << std::endl;
+                return false;
+            }
+            for (const auto &model : models)
+            {
+                if (model.id == entry.first)
+                {
+                    std::cerr << "Error: Model alias '" << entry.first << "' is also a model ID" << std::endl;
+                    return false;
+                }
+            }
+        }
+        for (const auto &entry : bulkheads.classes)
+        {
+            if (entry.first != "chat" && entry.first != "embeddings" && entry.first != "retrieval" &&
+                entry.first != "parsing" && entry.first != "admin")
+            {
+                std::cerr << "Error: Unknown bulkhead class '" << entry.first
+                          << "' (expected chat, embeddings, retrieval, parsing or admin)" << std::endl;
+                return false;
+            }
+        }
+        for (const auto *limits : {&bulkheads.classes, &bulkheads.models})
+        {
+            for (const auto &entry : *limits)
+            {
+                if (entry.second.max_concurrent < 1 || entry.second.max_queued < 0)
+                {
+                    std::cerr << "Error: Bulkhead '" << entry.first
+                              << "' needs max_concurrent of at least 1 and a non-negative max_queued" << std::endl;
+                    return false;
+                }
+            }
+        }
+        if (downloads.max_concurrent < 1)
+        {
+            std::cerr << "Error: downloads max_concurrent must be at least 1" << std::endl;
+            return false;
+        }
+        if (downloads.max_bytes_per_second < 0 || downloads.per_download_bytes_per_second < 0 || downloads.connections < 0)
+        {
+            std::cerr << "Error: downloads bandwidth caps and connections cannot be negative" << std::endl;
+            return false;
+        }
+        if (downloads.progress_interval_ms < 1)
+        {
+            std::cerr << "Error: downloads progress_interval_ms must be at least 1" << std::endl;
+            return false;
+        }
+        for (const auto &base : downloads.peers)
+        {
+            if (base.rfind("http://", 0) != 0 && base.rfind("https://", 0) != 0)
+            {
+                std::cerr << "Error: downloads peer must be an http(s) URL: " << base << std::endl;
+                return false;
+            }
+        }
+        for (const auto &base : downloads.mirrors)
+        {
+            if (base.rfind("http://", 0) != 0 && base.rfind("https://", 0) != 0)
+            {
+                std::cerr << "Error: downloads mirror must be an http(s) URL: " << base << std::endl;
+                return false;
+            }
+        }
+
         // Validate models
         for (const auto &model : models)
         {
@@ -1287,12 +2510,150 @@ namespace kolosal
                 std::cerr << "Error: Invalid n_ubatch for model " << model.id << ": must be between 1 and n_batch (" << model.loadParams.n_batch << ")" << std::endl;
                 return false;
             }
+
+            if (model.loadParams.n_step_tokens < 0 || model.loadParams.n_step_tokens > model.loadParams.n_batch)
+            {
+                std::cerr << "Error: Invalid n_step_tokens for model " << model.id << ": must be between 0 and n_batch (" << model.loadParams.n_batch << ")" << std::endl;
+                return false;
+            }
+
+            if (model.loadParams.n_draft < 0 || model.loadParams.n_draft > 64)
+            {
+                std::cerr << "Error: Invalid n_draft for model " << model.id << ": must be between 0 and 64" << std::endl;
+                return false;
+            }
+
+            if (model.loadParams.n_threads < 0 || model.loadParams.numa_node < -1)
+            {
+                std::cerr << "Error: Invalid CPU settings for model " << model.id << ": n_threads must be >= 0 and numa_node >= -1" << std::endl;
+                return false;
+            }
+
+            const std::string &hugePages = model.loadParams.huge_pages;
+            if (hugePages != "off" && hugePages != "thp" && hugePages != "2m" && hugePages != "1g")
+            {
+                std::cerr << "Error: Invalid huge_pages for model " << model.id << ": must be one of off, thp, 2m, 1g" << std::endl;
+                return false;
+            }
+
+            if (model.loadParams.repack_cache_mb < 0)
+            {
+                std::cerr << "Error: Invalid repack_cache_mb for model " << model.id << ": cannot be negative" << std::endl;
+                return false;
+            }
+
+            const std::string &moeOffload = model.loadParams.moe_offload;
+            if (moeOffload != "off" && moeOffload != "all" && moeOffload != "auto")
+            {
+                std::cerr << "Error: Invalid moe_offload for model " << model.id << ": must be one of off, all, auto" << std::endl;
+                return false;
+            }
+
+            if (!isValidCacheType(model.loadParams.cache_type_k) || !isValidCacheType(model.loadParams.cache_type_v))
+            {
+                std::cerr << "Error: Invalid KV cache type for model " << model.id << ": must be one of f32, f16, bf16, q8_0, q5_1, q5_0, q4_1, q4_0, auto" << std::endl;
+                return false;
+            }
+
+            if (model.loadParams.kv_host_cache_mb < 0 || model.loadParams.kv_disk_cache_mb < 0)
+            {
+                std::cerr << "Error: Invalid KV session cache budget for model " << model.id << ": must be non-negative" << std::endl;
+                return false;
+            }
+
+            if (model.loadParams.prefill_share <= 0.0f || model.loadParams.prefill_share > 1.0f)
+            {
+                std::cerr << "Error: Invalid prefill_share for model " << model.id << ": must be in (0, 1]" << std::endl;
+                return false;
+            }
+
+            if (model.loadParams.slo_ttft_ms < 0.0f || model.loadParams.slo_tpot_ms < 0.0f)
+            {
+                std::cerr << "Error: slo_ttft_ms and slo_tpot_ms for model " << model.id << " cannot be negative" << std::endl;
+                return false;
+            }
+
+            if (model.loadParams.lora_max_loaded < 0)
+            {
+                std::cerr << "Error: Invalid lora_max_loaded for model " << model.id << ": must be non-negative" << std::endl;
+                return false;
+            }
+
+            std::set<std::string> loraNames;
+            for (const auto &adapter : model.loadParams.lora_adapters)
+            {
+                if (adapter.name.empty() || adapter.path.empty() || !loraNames.insert(adapter.name).second)
+                {
+                    std::cerr << "Error: Invalid LoRA adapter for model " << model.id << ": each needs a unique name and a path" << std::endl;
+                    return false;
+                }
+            }
             
             if (model.loadParams.n_parallel <= 0 || model.loadParams.n_parallel > 16)
             {
                 std::cerr << "Error: Invalid n_parallel for model " << model.id << ": must be between 1 and 16" << std::endl;
                 return false;
             }
+
+            if (model.loadParams.n_replicas <= 0 || model.loadParams.n_replicas > 16)
+            {
+                std::cerr << "Error: Invalid n_replicas for model " << model.id << ": must be between 1 and 16" << std::endl;
+                return false;
+            }
+
+            if (model.loadParams.embedding_contexts <= 0 || model.loadParams.embedding_contexts > 16)
+            {
+                std::cerr << "Error: Invalid embedding_contexts for model " << model.id << ": must be between 1 and 16" << std::endl;
+                return false;
+            }
+
+            if (model.loadParams.embedding_batch_window_us < 0 || model.loadParams.embedding_batch_window_us > 100000)
+            {
+                std::cerr << "Error: Invalid embedding_batch_window_us for model " << model.id << ": must be between 0 and 100000" << std::endl;
+                return false;
+            }
+
+            if (model.loadParams.n_prefix_cache < 0 || model.loadParams.n_prefix_cache > 16)
+            {
+                std::cerr << "Error: Invalid n_prefix_cache for model " << model.id << ": must be between 0 and 16" << std::endl;
+                return false;
+            }
+
+            if (model.loadParams.prefix_cache_save_seconds < 0)
+            {
+                std::cerr << "Error: Invalid prefix_cache_save_seconds for model " << model.id << ": must be non-negative" << std::endl;
+                return false;
+            }
+
+            if (model.loadParams.chunk_cache_mb < 0)
+            {
+                std::cerr << "Error: Invalid chunk_cache_mb for model " << model.id << ": must be non-negative" << std::endl;
+                return false;
+            }
+
+            if (model.loadParams.preempt_swap_mb < 0)
+            {
+                std::cerr << "Error: Invalid preempt_swap_mb for model " << model.id << ": must be non-negative" << std::endl;
+                return false;
+            }
+
+            if (model.loadParams.kv_block_tokens < 0 || model.loadParams.max_seq_ctx < 0)
+            {
+                std::cerr << "Error: Invalid kv_block_tokens or max_seq_ctx for model " << model.id << ": must be non-negative" << std::endl;
+                return false;
+            }
+
+            if (model.loadParams.max_queued_jobs < 0 || model.loadParams.max_queued_tokens < 0)
+            {
+                std::cerr << "Error: max_queued_jobs and max_queued_tokens for model " << model.id << " cannot be negative" << std::endl;
+                return false;
+            }
+
+            if (model.loadParams.profile_steps < 0 || model.loadParams.profile_steps > 100000)
+            {
+                std::cerr << "Error: profile_steps for model " << model.id << " must be between 0 and 100000" << std::endl;
+                return false;
+            }
             
             if (model.loadParams.n_gpu_layers < 0 || model.loadParams.n_gpu_layers > 1000)
             {
@@ -1314,6 +2675,16 @@ namespace kolosal
             return false;
         }
 
+        // Validate tenant scheduling
+        bool validShares = auth.tenantScheduling.defaults.weight > 0.0f && auth.tenantScheduling.defaults.maxSlots >= 0;
+        for (const auto &key : auth.tenantScheduling.apiKeys)
+            validShares = validShares && key.second.weight > 0.0f && key.second.maxSlots >= 0;
+        if (!validShares)
+        {
+            std::cerr << "Error: Tenant scheduling weights must be positive and max_slots non-negative" << std::endl;
+            return false;
+        }
+
         return true;
     }
 
@@ -1326,11 +2697,25 @@ namespace kolosal
         std::cout << "  Public Access: " << (allowPublicAccess ? "Enabled" : "Disabled") << std::endl;
         std::cout << "  Internet Access: " << (allowInternetAccess ? "Enabled" : "Disabled") << std::endl;
         std::cout << "  Idle Timeout: " << idleTimeout.count() << "s" << std::endl;
+        std::cout << "  I/O Threads: " << (ioThreads > 0 ? std::to_string(ioThreads) : "auto") << std::endl;
+        std::cout << "  Accept Threads: " << (acceptThreads > 0 ? std::to_string(acceptThreads) : "auto") << std::endl;
+        std::cout << "  Health Probe Port: " << (healthPort > 0 ? std::to_string(healthPort) : "main port") << std::endl;
+        std::cout << "  Worker Threads: " << (workerThreads > 0 ? std::to_string(workerThreads) : "auto")
+                  << " (max " << maxWorkerThreads << ")" << std::endl;
+        std::cout << "  Keep-Alive: " << (keepAliveTimeout > 0 ? std::to_string(keepAliveTimeout) + "s, " + std::to_string(maxKeepAliveRequests) + " requests" : "Disabled") << std::endl;
+        std::cout << "  Stream Request Bodies: " << (streamBodyThresholdMb > 0 ? "from " + std::to_string(streamBodyThresholdMb) + " MB" : "Disabled") << std::endl;
+        std::cout << "  Max Request Body: " << (maxBodyMb > 0 ? std::to_string(maxBodyMb) + " MB" : "Unlimited") << std::endl;
+        std::cout << "  Max Decompressed Request Body: " << (maxDecompressedBodyMb > 0 ? std::to_string(maxDecompressedBodyMb) + " MB" : "Unlimited") << std::endl;
+        std::cout << "  Response Compression: " << (compressionLevel > 0 ? "level " + std::to_string(compressionLevel) + ", from " + std::to_string(compressionMinBytes) + " bytes" : "Disabled") << std::endl;
+        std::cout << "  Model Memory Budget: " << (modelMemoryBudgetMb > 0 ? std::to_string(modelMemoryBudgetMb) + " MB" : "Unlimited")
+                  << " (min free " << minFreeMemoryMb << " MB, preload " << (preloadModels ? "on" : "off")
+                  << ", hibernate " << (hibernateMemoryMb > 0 ? std::to_string(hibernateMemoryMb) + " MB" : "off") << ")" << std::endl;
 
         std::cout << "\nLogging:" << std::endl;
         std::cout << "  Level: " << logLevel << std::endl;
         std::cout << "  File: " << (logFile.empty() ? "Console" : logFile) << std::endl;
-        std::cout << "  Access Log: " << (enableAccessLog ? "Enabled" : "Disabled") << std::endl;
+        std::cout << "  Access Log: " << (enableAccessLog ? accessLog.file + " (" + accessLog.format + ", sampling " + std::to_string(accessLog.sample_rate) + ")" : "Disabled") << std::endl;
+        std::cout << "  Traffic Capture: " << (trafficCapture.enabled ? trafficCapture.file + " (sampling " + std::to_string(trafficCapture.sample_rate) + (trafficCapture.anonymize ? ", anonymized)" : ")") : "Disabled") << std::endl;
 
         std::cout << "\nAuthentication:" << std::endl;
         std::cout << "  Auth: " << (auth.enableAuth ? "Enabled" : "Disabled") << std::endl;
@@ -1340,6 +2725,23 @@ namespace kolosal
         {
             std::cout << "    Max Requests: " << auth.rateLimiter.maxRequests << std::endl;
             std::cout << "    Window: " << auth.rateLimiter.windowSize.count() << "s" << std::endl;
+            if (auth.rateLimiter.apiKeyMaxRequests > 0)
+                std::cout << "    Max Requests per API Key: " << auth.rateLimiter.apiKeyMaxRequests << std::endl;
+        }
+        std::cout << "  Token Quota: " << (auth.tokenQuota.enabled ? "Enabled" : "Disabled") << std::endl;
+        if (auth.tokenQuota.enabled)
+        {
+            std::cout << "    Tokens per Minute: " << auth.tokenQuota.tokensPerMinute << std::endl;
+            for (const auto &model : auth.tokenQuota.modelTokensPerMinute)
+                std::cout << "    Tokens per Minute (" << model.first << "): " << model.second << std::endl;
+        }
+        std::cout << "  Tenant Scheduling: " << (auth.tenantScheduling.enabled ? "Enabled" : "Disabled") << std::endl;
+        if (auth.tenantScheduling.enabled)
+        {
+            std::cout << "    Default Weight: " << auth.tenantScheduling.defaults.weight << std::endl;
+            if (auth.tenantScheduling.defaults.maxSlots > 0)
+                std::cout << "    Default Max Slots: " << auth.tenantScheduling.defaults.maxSlots << std::endl;
+            std::cout << "    API Keys with Own Share: " << auth.tenantScheduling.apiKeys.size() << std::endl;
         }
         std::cout << "  CORS: " << (auth.cors.enabled ? "Enabled" : "Disabled") << std::endl;
         if (auth.cors.enabled)
@@ -1382,6 +2784,15 @@ namespace kolosal
         std::cout << "\nFeatures:" << std::endl;
         std::cout << "  Health Check: " << (enableHealthCheck ? "Enabled" : "Disabled") << std::endl;
         std::cout << "  Metrics: " << (enableMetrics ? "Enabled" : "Disabled") << std::endl;
+        std::cout << "  TLS: " << (tls.enabled ? "Enabled, " + tls.cert_file : "Disabled") << std::endl;
+        std::cout << "  Tracing: " << (tracing.enabled ? "Enabled, sampling " + std::to_string(tracing.sample_rate) : "Disabled") << std::endl;
+        std::cout << "  Server-Timing: " << (tracing.server_timing ? "Enabled" : "Disabled") << std::endl;
+        std::cout << "  Batch API: " << (batch.enabled ? "Enabled, " + batch.directory : "Disabled") << std::endl;
+        std::cout << "  Cluster: " << (cluster.enabled ? "Enabled, " + std::to_string(cluster.peers.size()) + " peer(s)" : "Disabled") << std::endl;
+        std::cout << "  Prefill/decode role: " << disaggregation.role << std::endl;
+        std::cout << "  Response Cache: " << (responseCache.enabled ? "Enabled, " + std::to_string(responseCache.memory_mb) + " MB" : "Disabled") << std::endl;
+        if (responseCache.semantic.enabled)
+            std::cout << "  Semantic Cache: " << responseCache.semantic.embedding_model << ", similarity >= " << responseCache.semantic.threshold << std::endl;
         std::cout << "====================================" << std::endl;
     }
 
@@ -1400,7 +2811,12 @@ namespace kolosal
         std::cout << "  Logging:\n";
         std::cout << "    --log-level LEVEL         Log level: DEBUG, INFO, WARN, ERROR (default: INFO)\n";
         std::cout << "    --log-file FILE           Log to file instead of console\n";
-        std::cout << "    --enable-access-log       Enable HTTP access logging\n\n";
+        std::cout << "    --enable-access-log       Enable HTTP access logging\n";
+        std::cout << "    --access-log-file <path>  Access log file (default: access.log)\n";
+        std::cout << "    --access-log-format <f>   Access log format: ndjson, binary\n";
+        std::cout << "    --access-log-sample-rate <r> Share of successful requests logged (0-1)\n";
+        std::cout << "    --capture-traffic <path>  Capture sampled requests for replay to this file\n";
+        std::cout << "    --capture-sample-rate <r> Share of requests captured (0-1, default: 0.01)\n\n";
 
         std::cout << "  Authentication:\n";
         std::cout << "    --disable-auth            Disable all authentication\n";
@@ -1411,6 +2827,7 @@ namespace kolosal
         std::cout << "  Rate Limiting:\n";
         std::cout << "    --rate-limit N            Maximum requests per window (default: 100)\n";
         std::cout << "    --rate-window SEC         Rate limit window in seconds (default: 60)\n";
+        std::cout << "    --rate-limit-per-key N    Maximum requests per API key per window (default: 0, off)\n";
         std::cout << "    --disable-rate-limit      Disable rate limiting\n\n";
 
         std::cout << "  CORS:\n";
@@ -1495,12 +2912,12 @@ namespace kolosal
 
     bool ServerConfig::saveToCurrentFile() const
     {
-        ServerLogger::instance().info("saveToCurrentFile called. currentConfigFilePath: '" + currentConfigFilePath + "'");
-        ServerLogger::instance().info("ServerConfig instance address: " + std::to_string(reinterpret_cast<uintptr_t>(this)));
+        KOLOSAL_LOG_INFO("saveToCurrentFile called. currentConfigFilePath: '" + currentConfigFilePath + "'");
+        KOLOSAL_LOG_INFO("ServerConfig instance address: " + std::to_string(reinterpret_cast<uintptr_t>(this)));
         
         if (currentConfigFilePath.empty())
         {
-            ServerLogger::instance().info("currentConfigFilePath is empty, using fallback logic");
+            KOLOSAL_LOG_INFO("currentConfigFilePath is empty, using fallback logic");
             
             // If no config file was loaded, try to determine a reasonable default location
             // based on the same priority order used during loading
@@ -1530,7 +2947,7 @@ namespace kolosal
             
             // Try each candidate path in order
             for (const auto& path : candidatePaths) {
-                ServerLogger::instance().info("Trying fallback path: " + path);
+                KOLOSAL_LOG_INFO("Trying fallback path: " + path);
                 try {
                     // Create directory if it doesn't exist
                     std::filesystem::path filePath(path);
@@ -1544,11 +2961,11 @@ namespace kolosal
                     std::ofstream testFile(path, std::ios::app);
                     if (testFile.is_open()) {
                         testFile.close();
-                        ServerLogger::instance().info("No config file path available, using fallback: " + path);
+                        KOLOSAL_LOG_INFO("No config file path available, using fallback: " + path);
                         return saveToFile(path);
                     }
                 } catch (const std::exception& e) {
-                    ServerLogger::instance().info("Cannot write to " + path + ": " + e.what());
+                    KOLOSAL_LOG_INFO("Cannot write to " + path + ": " + e.what());
                     continue;
                 }
             }
@@ -1557,7 +2974,7 @@ namespace kolosal
             return false;
         }
         
-        ServerLogger::instance().info("Saving to current config file: " + currentConfigFilePath);
+        KOLOSAL_LOG_INFO("Saving to current config file: " + currentConfigFilePath);
         return saveToFile(currentConfigFilePath);
     }
 
@@ -0,0 +1,411 @@
+#include "kolosal/sharded_vector_database.hpp"
+#include <algorithm>
+#include <queue>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+
+namespace kolosal
+{
+
+namespace
+{
+    using ShardCalls = std::vector<std::pair<size_t, std::future<VectorResult>>>;
+
+    uint64_t fnv1a(const std::string& text)
+    {
+        uint64_t hash = 1469598103934665603ULL;
+        for (unsigned char c : text)
+        {
+            hash ^= c;
+            hash *= 1099511628211ULL;
+        }
+        // Generated ids share long prefixes; a splitmix round spreads them evenly over the shards
+        hash ^= hash >> 30;
+        hash *= 0xbf58476d1ce4e5b9ULL;
+        hash ^= hash >> 27;
+        hash *= 0x94d049bb133111ebULL;
+        hash ^= hash >> 31;
+        return hash;
+    }
+
+    // Runs fn on the thread that waits for the result
+    template <typename F>
+    std::future<VectorResult> whenWaited(F&& fn)
+    {
+        return std::async(std::launch::deferred, std::forward<F>(fn));
+    }
+
+    VectorResult waitFor(size_t shard, std::future<VectorResult>& call)
+    {
+        try
+        {
+            return call.get();
+        }
+        catch (const std::exception& ex)
+        {
+            VectorResult result;
+            result.status_code = 500;
+            result.error_message = "Shard " + std::to_string(shard) + ": " + ex.what();
+            return result;
+        }
+    }
+
+    // Folds a shard's outcome into the combined one; the first failure decides the error
+    void accumulate(VectorResult& combined, size_t shard, VectorResult& result)
+    {
+        combined.successful_ids.insert(combined.successful_ids.end(), result.successful_ids.begin(), result.successful_ids.end());
+        combined.failed_ids.insert(combined.failed_ids.end(), result.failed_ids.begin(), result.failed_ids.end());
+        if (!result.success && combined.success)
+        {
+            combined.success = false;
+            combined.status_code = result.status_code;
+            combined.error_message = result.error_message.rfind("Shard ", 0) == 0 ?
+                result.error_message : "Shard " + std::to_string(shard) + ": " + result.error_message;
+        }
+    }
+
+    VectorResult waitForAll(ShardCalls& calls)
+    {
+        VectorResult combined;
+        combined.success = true;
+        for (auto& [shard, call] : calls)
+        {
+            VectorResult result = waitFor(shard, call);
+            accumulate(combined, shard, result);
+        }
+        return combined;
+    }
+
+    // Moves the points of a search, getPoints or scroll response out of it; Qdrant scrolls
+    // nest them under "points"
+    nlohmann::json resultPoints(nlohmann::json& response_data)
+    {
+        if (!response_data.contains("result"))
+        {
+            return nlohmann::json::array();
+        }
+        auto& result = response_data["result"];
+        if (result.is_array())
+        {
+            return std::move(result);
+        }
+        if (result.is_object() && result.contains("points") && result["points"].is_array())
+        {
+            return std::move(result["points"]);
+        }
+        return nlohmann::json::array();
+    }
+
+    std::string nextPageOffset(const nlohmann::json& response_data)
+    {
+        nlohmann::json next;
+        if (response_data.contains("next_page_offset"))
+        {
+            next = response_data["next_page_offset"];
+        }
+        else if (response_data.contains("result") && response_data["result"].is_object() &&
+                 response_data["result"].contains("next_page_offset"))
+        {
+            next = response_data["result"]["next_page_offset"];
+        }
+        return next.is_string() ? next.get<std::string>() :
+               next.is_number() ? std::to_string(next.get<int64_t>()) : std::string();
+    }
+
+    // K-way merge of per-shard hit lists, each ranked by descending score; the hits are moved
+    // out of the lists
+    nlohmann::json mergeHits(std::vector<nlohmann::json>& lists, int limit)
+    {
+        using Head = std::tuple<float, size_t, size_t>;  // score, list, position
+        auto worse = [](const Head& a, const Head& b) { return std::get<0>(a) < std::get<0>(b); };
+        std::priority_queue<Head, std::vector<Head>, decltype(worse)> heads(worse);
+        for (size_t list = 0; list < lists.size(); ++list)
+        {
+            if (lists[list].is_array() && !lists[list].empty())
+            {
+                heads.emplace(lists[list][0].value("score", 0.0f), list, 0);
+            }
+        }
+
+        nlohmann::json merged = nlohmann::json::array();
+        while (!heads.empty() && static_cast<int>(merged.size()) < limit)
+        {
+            const auto [score, list, position] = heads.top();
+            heads.pop();
+            merged.push_back(std::move(lists[list][position]));
+            if (position + 1 < lists[list].size())
+            {
+                heads.emplace(lists[list][position + 1].value("score", 0.0f), list, position + 1);
+            }
+        }
+        return merged;
+    }
+}
+
+ShardedVectorDatabase::ShardedVectorDatabase(std::vector<std::unique_ptr<IVectorDatabase>> shards)
+    : shards_(std::move(shards))
+{
+    if (shards_.empty())
+    {
+        throw std::invalid_argument("A sharded vector database needs at least one shard");
+    }
+}
+
+size_t ShardedVectorDatabase::shardFor(const std::string& point_id) const
+{
+    return static_cast<size_t>(fnv1a(point_id) % shards_.size());
+}
+
+std::future<VectorResult> ShardedVectorDatabase::testConnection()
+{
+    ShardCalls calls;
+    for (size_t shard = 0; shard < shards_.size(); ++shard)
+    {
+        calls.emplace_back(shard, shards_[shard]->testConnection());
+    }
+    return whenWaited([calls = std::move(calls)]() mutable { return waitForAll(calls); });
+}
+
+std::future<VectorResult> ShardedVectorDatabase::createCollection(const std::string& collection_name, int vector_size, const std::string& distance)
+{
+    // Shards added since the collection was created get it too; the others already have it
+    ShardCalls exists;
+    for (size_t shard = 0; shard < shards_.size(); ++shard)
+    {
+        exists.emplace_back(shard, shards_[shard]->collectionExists(collection_name));
+    }
+    return whenWaited([this, exists = std::move(exists), collection_name, vector_size, distance]() mutable {
+        ShardCalls calls;
+        for (auto& [shard, call] : exists)
+        {
+            if (!waitFor(shard, call).success)
+            {
+                calls.emplace_back(shard, shards_[shard]->createCollection(collection_name, vector_size, distance));
+            }
+        }
+        return waitForAll(calls);
+    });
+}
+
+std::future<VectorResult> ShardedVectorDatabase::collectionExists(const std::string& collection_name)
+{
+    ShardCalls calls;
+    for (size_t shard = 0; shard < shards_.size(); ++shard)
+    {
+        calls.emplace_back(shard, shards_[shard]->collectionExists(collection_name));
+    }
+    return whenWaited([calls = std::move(calls)]() mutable { return waitForAll(calls); });
+}
+
+std::future<VectorResult> ShardedVectorDatabase::upsertPoints(const std::string& collection_name, const std::vector<VectorPoint>& points)
+{
+    std::vector<std::vector<VectorPoint>> routed(shards_.size());
+    for (const auto& point : points)
+    {
+        routed[shardFor(point.id)].push_back(point);
+    }
+
+    ShardCalls calls;
+    for (size_t shard = 0; shard < shards_.size(); ++shard)
+    {
+        if (!routed[shard].empty())
+        {
+            calls.emplace_back(shard, shards_[shard]->upsertPoints(collection_name, routed[shard]));
+        }
+    }
+    return whenWaited([calls = std::move(calls)]() mutable { return waitForAll(calls); });
+}
+
+std::future<VectorResult> ShardedVectorDatabase::deletePoints(const std::string& collection_name, const std::vector<std::string>& point_ids)
+{
+    std::vector<std::vector<std::string>> routed(shards_.size());
+    for (const auto& id : point_ids)
+    {
+        routed[shardFor(id)].push_back(id);
+    }
+
+    ShardCalls calls;
+    for (size_t shard = 0; shard < shards_.size(); ++shard)
+    {
+        if (!routed[shard].empty())
+        {
+            calls.emplace_back(shard, shards_[shard]->deletePoints(collection_name, routed[shard]));
+        }
+    }
+    return whenWaited([calls = std::move(calls)]() mutable { return waitForAll(calls); });
+}
+
+std::future<VectorResult> ShardedVectorDatabase::getPoints(const std::string& collection_name, const std::vector<std::string>& point_ids)
+{
+    std::vector<std::vector<std::string>> routed(shards_.size());
+    for (const auto& id : point_ids)
+    {
+        routed[shardFor(id)].push_back(id);
+    }
+
+    ShardCalls calls;
+    for (size_t shard = 0; shard < shards_.size(); ++shard)
+    {
+        if (!routed[shard].empty())
+        {
+            calls.emplace_back(shard, shards_[shard]->getPoints(collection_name, routed[shard]));
+        }
+    }
+    return whenWaited([calls = std::move(calls)]() mutable {
+        VectorResult combined;
+        combined.success = true;
+        combined.response_data["result"] = nlohmann::json::array();
+        for (auto& [shard, call] : calls)
+        {
+            VectorResult result = waitFor(shard, call);
+            accumulate(combined, shard, result);
+            for (auto& point : resultPoints(result.response_data))
+            {
+                combined.response_data["result"].push_back(std::move(point));
+            }
+        }
+        return combined;
+    });
+}
+
+std::future<VectorResult> ShardedVectorDatabase::search(const std::string& collection_name, const std::vector<float>& query_vector, int limit, float score_threshold, const VectorSearchParams& params)
+{
+    // Any shard may hold the whole top-k, so each is asked for all of it
+    ShardCalls calls;
+    for (size_t shard = 0; shard < shards_.size(); ++shard)
+    {
+        calls.emplace_back(shard, shards_[shard]->search(collection_name, query_vector, limit, score_threshold, params));
+    }
+    return whenWaited([calls = std::move(calls), limit]() mutable {
+        VectorResult combined;
+        combined.success = true;
+        std::vector<nlohmann::json> lists;
+        for (auto& [shard, call] : calls)
+        {
+            VectorResult result = waitFor(shard, call);
+            accumulate(combined, shard, result);
+            lists.push_back(resultPoints(result.response_data));
+        }
+        if (combined.success)
+        {
+            combined.response_data["result"] = mergeHits(lists, limit);
+        }
+        return combined;
+    });
+}
+
+std::future<VectorResult> ShardedVectorDatabase::searchBatch(const std::string& collection_name, const std::vector<std::vector<float>>& query_vectors, int limit, float score_threshold, const VectorSearchParams& params)
+{
+    ShardCalls calls;
+    for (size_t shard = 0; shard < shards_.size(); ++shard)
+    {
+        calls.emplace_back(shard, shards_[shard]->searchBatch(collection_name, query_vectors, limit, score_threshold, params));
+    }
+    return whenWaited([calls = std::move(calls), queries = query_vectors.size(), limit]() mutable {
+        VectorResult combined;
+        combined.success = true;
+        std::vector<nlohmann::json> results;
+        for (auto& [shard, call] : calls)
+        {
+            VectorResult result = waitFor(shard, call);
+            accumulate(combined, shard, result);
+            results.push_back(resultPoints(result.response_data));
+        }
+        if (!combined.success)
+        {
+            return combined;
+        }
+
+        combined.response_data["result"] = nlohmann::json::array();
+        std::vector<nlohmann::json> lists(results.size());
+        for (size_t query = 0; query < queries; ++query)
+        {
+            for (size_t shard = 0; shard < results.size(); ++shard)
+            {
+                lists[shard] = query < results[shard].size() ? std::move(results[shard][query]) : nlohmann::json::array();
+            }
+            combined.response_data["result"].push_back(mergeHits(lists, limit));
+        }
+        return combined;
+    });
+}
+
+std::future<VectorResult> ShardedVectorDatabase::scrollPoints(const std::string& collection_name, int limit, const std::string& offset, bool with_payload, const nlohmann::json& filter)
+{
+    size_t shard = 0;
+    std::string shard_offset;
+    if (!offset.empty())
+    {
+        const size_t colon = offset.find(':');
+        try
+        {
+            shard = colon == std::string::npos ? shards_.size() : std::stoul(offset.substr(0, colon));
+        }
+        catch (const std::exception&)
+        {
+            shard = shards_.size();
+        }
+        if (shard >= shards_.size())
+        {
+            VectorResult invalid;
+            invalid.status_code = 400;
+            invalid.error_message = "Invalid scroll offset '" + offset + "'";
+            std::promise<VectorResult> ready;
+            ready.set_value(std::move(invalid));
+            return ready.get_future();
+        }
+        shard_offset = offset.substr(colon + 1);
+    }
+
+    // Pages come from one shard at a time; empty shards are skipped so a page is only empty at the end
+    return whenWaited([this, collection_name, limit, shard, shard_offset, with_payload, filter]() mutable {
+        VectorResult page;
+        page.success = true;
+        page.response_data["result"] = nlohmann::json::array();
+        while (shard < shards_.size())
+        {
+            VectorResult result = shards_[shard]->scrollPoints(collection_name, limit, shard_offset, with_payload, filter).get();
+            if (!result.success)
+            {
+                accumulate(page, shard, result);
+                return page;
+            }
+            const std::string next = nextPageOffset(result.response_data);
+            nlohmann::json points = resultPoints(result.response_data);
+            if (points.empty())
+            {
+                shard_offset = next;
+                if (next.empty())
+                {
+                    ++shard;
+                }
+                continue;
+            }
+
+            page.response_data["result"] = std::move(points);
+            if (!next.empty())
+            {
+                page.response_data["next_page_offset"] = std::to_string(shard) + ":" + next;
+            }
+            else if (shard + 1 < shards_.size())
+            {
+                page.response_data["next_page_offset"] = std::to_string(shard + 1) + ":";
+            }
+            return page;
+        }
+        return page;
+    });
+}
+
+nlohmann::json ShardedVectorDatabase::memoryUsage() const
+{
+    nlohmann::json shards = nlohmann::json::array();
+    for (const auto& shard : shards_)
+    {
+        shards.push_back(shard->memoryUsage());
+    }
+    return {{"shards", shards}};
+}
+
+} // namespace kolosal
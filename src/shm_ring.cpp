@@ -0,0 +1,167 @@
+#include "kolosal/shm_ring.hpp"
+
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <map>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace kolosal
+{
+
+    namespace
+    {
+        constexpr char kMagic[8] = {'K', 'L', 'S', 'H', 'M', 'R', 'G', '1'};
+        constexpr uint32_t kVersion = 1;
+        constexpr uint64_t kAlignment = 64;
+
+        static_assert(std::atomic<uint64_t>::is_always_lock_free, "ring counters must be lock-free to be shared");
+
+        // Only plain names, so a request cannot point the server at arbitrary paths
+        bool validName(const std::string &name)
+        {
+            if (name.size() < 2 || name.size() > 200 || name[0] != '/')
+                return false;
+            for (size_t i = 1; i < name.size(); ++i)
+            {
+                const char c = name[i];
+                if (!(std::isalnum(static_cast<unsigned char>(c)) || c == '-' || c == '_' || c == '.'))
+                    return false;
+            }
+            return true;
+        }
+
+        std::atomic<uint64_t> &counterAt(void *base, size_t offset)
+        {
+            return *reinterpret_cast<std::atomic<uint64_t> *>(static_cast<char *>(base) + offset);
+        }
+
+        std::mutex g_ringsMutex;
+        std::map<std::string, std::shared_ptr<ShmRing>> g_rings;
+    }
+
+    std::shared_ptr<ShmRing> ShmRing::attach(const std::string &name, std::string &error)
+    {
+        if (!validName(name))
+        {
+            error = "Shared-memory ring name must be '/' followed by letters, digits, '.', '-' or '_'";
+            return nullptr;
+        }
+
+        std::lock_guard<std::mutex> lock(g_ringsMutex);
+        auto it = g_rings.find(name);
+        if (it != g_rings.end())
+            return it->second;
+
+#ifdef _WIN32
+        error = "Shared-memory rings are not supported on this platform";
+        return nullptr;
+#else
+        const int fd = shm_open(name.c_str(), O_RDWR, 0);
+        if (fd == -1)
+        {
+            error = "Cannot open shared-memory ring '" + name + "': " + std::strerror(errno);
+            return nullptr;
+        }
+        struct stat st {};
+        if (fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(kHeaderBytes))
+        {
+            close(fd);
+            error = "Shared-memory ring '" + name + "' is too small";
+            return nullptr;
+        }
+        const size_t size = static_cast<size_t>(st.st_size);
+        void *base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (base == MAP_FAILED)
+        {
+            error = "Cannot map shared-memory ring '" + name + "': " + std::strerror(errno);
+            return nullptr;
+        }
+
+        const char *header = static_cast<const char *>(base);
+        uint32_t version = 0;
+        uint64_t capacity = 0;
+        std::memcpy(&version, header + 8, sizeof(version));
+        std::memcpy(&capacity, header + 16, sizeof(capacity));
+        if (std::memcmp(header, kMagic, sizeof(kMagic)) != 0 || version != kVersion)
+        {
+            munmap(base, size);
+            error = "'" + name + "' is not a version 1 shared-memory ring";
+            return nullptr;
+        }
+        if (capacity == 0 || capacity % kAlignment != 0 || capacity > size - kHeaderBytes)
+        {
+            munmap(base, size);
+            error = "Shared-memory ring '" + name + "' has an invalid capacity";
+            return nullptr;
+        }
+
+        std::shared_ptr<ShmRing> ring(new ShmRing());
+        ring->base_ = base;
+        ring->mappedBytes_ = size;
+        ring->capacity_ = capacity;
+        g_rings.emplace(name, ring);
+        return ring;
+#endif
+    }
+
+    ShmRing::~ShmRing()
+    {
+#ifndef _WIN32
+        if (base_)
+            munmap(base_, mappedBytes_);
+#endif
+    }
+
+    bool ShmRing::write(const std::vector<std::pair<const void *, size_t>> &parts, Placement &placed)
+    {
+        uint64_t bytes = 0;
+        for (const auto &part : parts)
+            bytes += part.second;
+        if (bytes == 0 || bytes > capacity_)
+            return false;
+
+        std::lock_guard<std::mutex> lock(writeMutex_);
+        std::atomic<uint64_t> &head = counterAt(base_, 24);
+        std::atomic<uint64_t> &tail = counterAt(base_, 32);
+
+        const uint64_t produced = head.load(std::memory_order_relaxed);
+        const uint64_t consumed = tail.load(std::memory_order_acquire);
+        if (consumed > produced || produced - consumed > capacity_)
+            return false;   // The client wrote a tail we never produced
+
+        // Align the start, and skip to the beginning of the ring rather than wrap a record
+        uint64_t start = (produced + kAlignment - 1) / kAlignment * kAlignment;
+        uint64_t position = start % capacity_;
+        if (position + bytes > capacity_)
+        {
+            start += capacity_ - position;
+            position = 0;
+        }
+        const uint64_t end = start + bytes;
+        if (end - consumed > capacity_)
+            return false;
+
+        char *out = static_cast<char *>(base_) + kHeaderBytes + position;
+        for (const auto &part : parts)
+        {
+            std::memcpy(out, part.first, part.second);
+            out += part.second;
+        }
+        head.store(end, std::memory_order_release);
+
+        placed.offset = kHeaderBytes + position;
+        placed.bytes = bytes;
+        placed.end = end;
+        return true;
+    }
+
+} // namespace kolosal
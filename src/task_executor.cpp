@@ -0,0 +1,132 @@
+#include "kolosal/task_executor.hpp"
+#include "kolosal/logger.hpp"
+
+#include <algorithm>
+#include <exception>
+
+namespace kolosal
+{
+
+    namespace
+    {
+        thread_local bool tlsExecutorWorker = false;
+    }
+
+    TaskExecutor::TaskExecutor(size_t threads, size_t maxQueued)
+        : maxQueued_(std::max<size_t>(maxQueued, 1))
+    {
+        threads = std::max<size_t>(threads, 1);
+        threads_.reserve(threads);
+        for (size_t i = 0; i < threads; ++i)
+        {
+            threads_.emplace_back(&TaskExecutor::workerLoop, this);
+        }
+    }
+
+    TaskExecutor::~TaskExecutor()
+    {
+        shutdown();
+    }
+
+    TaskExecutor &TaskExecutor::instance()
+    {
+        // Half the cores, but a few threads at least: most retrieval tasks block on
+        // embedding jobs or vector DB round trips rather than burn CPU
+        static TaskExecutor executor(
+            std::clamp<size_t>(std::thread::hardware_concurrency() / 2, 2, 8), 256);
+        return executor;
+    }
+
+    bool TaskExecutor::onWorkerThread()
+    {
+        return tlsExecutorWorker;
+    }
+
+    bool TaskExecutor::tryEnqueue(std::function<void()> task)
+    {
+        // A worker waiting on its own sub-task would deadlock once every worker does it
+        if (tlsExecutorWorker)
+            return false;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (stop_ || tasks_.size() >= maxQueued_)
+                return false;
+            tasks_.push_back(std::move(task));
+        }
+        cv_.notify_one();
+        return true;
+    }
+
+    void TaskExecutor::shutdown()
+    {
+        std::vector<std::thread> toJoin;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (stop_ && threads_.empty())
+                return;
+            stop_ = true;
+            toJoin.swap(threads_);
+        }
+        cv_.notify_all();
+
+        for (auto &t : toJoin)
+        {
+            if (t.joinable())
+                t.join();
+        }
+    }
+
+    TaskExecutor::Stats TaskExecutor::stats() const
+    {
+        Stats s;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            s.threads = threads_.size();
+            s.busy = busy_;
+            s.queued = tasks_.size();
+        }
+        s.maxQueued = maxQueued_;
+        s.completed = completed_.load(std::memory_order_relaxed);
+        s.ranInline = ranInline_.load(std::memory_order_relaxed);
+        return s;
+    }
+
+    void TaskExecutor::workerLoop()
+    {
+        tlsExecutorWorker = true;
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true)
+        {
+            cv_.wait(lock, [this]
+                     { return stop_ || !tasks_.empty(); });
+            if (tasks_.empty())
+                return; // stop_ set and queue drained
+
+            std::function<void()> task = std::move(tasks_.front());
+            tasks_.pop_front();
+            ++busy_;
+            lock.unlock();
+
+            // packaged_task captures exceptions for the future; this only guards the wrapper
+            try
+            {
+                task();
+            }
+            catch (const std::exception &ex)
+            {
+                KOLOSAL_LOG_ERROR("Unhandled exception in background task: %s", ex.what());
+            }
+            catch (...)
+            {
+                KOLOSAL_LOG_ERROR("Unhandled unknown exception in background task");
+            }
+            completed_.fetch_add(1, std::memory_order_relaxed);
+
+            lock.lock();
+            --busy_;
+        }
+    }
+
+} // namespace kolosal
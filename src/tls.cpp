@@ -0,0 +1,363 @@
+#include "kolosal/tls.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <stdexcept>
+
+#ifdef KOLOSAL_WITH_TLS
+#include <openssl/bio.h>
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+#endif
+
+namespace kolosal
+{
+
+    namespace
+    {
+        std::atomic<uint64_t> g_handshakes{0};
+        std::atomic<uint64_t> g_resumed{0};
+        std::atomic<uint64_t> g_failed{0};
+        std::atomic<uint64_t> g_kernelSend{0};
+        std::atomic<uint64_t> g_kernelRecv{0};
+
+        // Small responses are gathered into one record instead of one per slice
+        constexpr size_t kCoalesceBytes = 16384;
+
+#ifdef KOLOSAL_WITH_TLS
+        // The oldest queued OpenSSL error as text; the queue is cleared
+        std::string opensslError(const char *fallback)
+        {
+            const unsigned long code = ERR_get_error();
+            std::string text = fallback;
+            if (code != 0)
+            {
+                char buffer[256];
+                ERR_error_string_n(code, buffer, sizeof(buffer));
+                text = buffer;
+            }
+            ERR_clear_error();
+            return text;
+        }
+
+        // Waits until the socket can take the retry an SSL call asked for
+        bool waitSocket(SocketType sock, bool forWrite, int timeoutMs)
+        {
+#ifdef _WIN32
+            WSAPOLLFD pfd{sock, static_cast<SHORT>(forWrite ? POLLWRNORM : POLLRDNORM), 0};
+            return WSAPoll(&pfd, 1, timeoutMs) > 0;
+#else
+            struct pollfd pfd{sock, static_cast<short>(forWrite ? POLLOUT : POLLIN), 0};
+            int ready;
+            do
+            {
+                ready = poll(&pfd, 1, timeoutMs);
+            } while (ready < 0 && errno == EINTR);
+            return ready > 0;
+#endif
+        }
+
+        void setWouldBlock()
+        {
+#ifdef _WIN32
+            WSASetLastError(WSAEWOULDBLOCK);
+#else
+            errno = EAGAIN;
+#endif
+        }
+
+        // Only HTTP/1.1 is spoken; clients that offer ALPN get it confirmed
+        int selectAlpn(SSL *, const unsigned char **out, unsigned char *outlen, const unsigned char *in,
+                       unsigned int inlen, void *)
+        {
+            static const unsigned char kHttp11[] = {8, 'h', 't', 't', 'p', '/', '1', '.', '1'};
+            unsigned char *selected = nullptr;
+            if (SSL_select_next_proto(&selected, outlen, kHttp11, sizeof(kHttp11), in, inlen) != OPENSSL_NPN_NEGOTIATED)
+                return SSL_TLSEXT_ERR_NOACK;
+            *out = selected;
+            return SSL_TLSEXT_ERR_OK;
+        }
+#endif
+    } // namespace
+
+    TlsConnection::TlsConnection(ssl_st *ssl, SocketType sock)
+        : ssl_(ssl), sock_(sock)
+    {
+    }
+
+    TlsConnection::~TlsConnection()
+    {
+#ifdef KOLOSAL_WITH_TLS
+        SSL_free(ssl_);
+#endif
+    }
+
+    TlsConnection::Step TlsConnection::handshake()
+    {
+#ifdef KOLOSAL_WITH_TLS
+        std::lock_guard<std::mutex> lock(mutex_);
+        ERR_clear_error();
+        const int result = SSL_do_handshake(ssl_);
+        if (result == 1)
+        {
+            // OpenSSL switches a direction to kTLS once its keys are set, if the kernel accepts the cipher
+            kernelSend_ = BIO_get_ktls_send(SSL_get_wbio(ssl_));
+            kernelRecv_ = BIO_get_ktls_recv(SSL_get_rbio(ssl_));
+            return Step::Done;
+        }
+        switch (SSL_get_error(ssl_, result))
+        {
+        case SSL_ERROR_WANT_READ:
+            return Step::WantRead;
+        case SSL_ERROR_WANT_WRITE:
+            return Step::WantWrite;
+        default:
+            error_ = opensslError("connection closed during the handshake");
+            return Step::Failed;
+        }
+#else
+        error_ = "built without TLS support";
+        return Step::Failed;
+#endif
+    }
+
+    bool TlsConnection::resumed() const
+    {
+#ifdef KOLOSAL_WITH_TLS
+        std::lock_guard<std::mutex> lock(mutex_);
+        return SSL_session_reused(ssl_) == 1;
+#else
+        return false;
+#endif
+    }
+
+    bool TlsConnection::write(http_internal::IoSlice *slices, size_t count)
+    {
+#ifdef KOLOSAL_WITH_TLS
+        size_t total = 0;
+        for (size_t i = 0; i < count; ++i)
+            total += slices[i].size;
+
+        thread_local std::string gathered;
+        http_internal::IoSlice single;
+        if (count > 1 && total <= kCoalesceBytes)
+        {
+            gathered.clear();
+            for (size_t i = 0; i < count; ++i)
+                gathered.append(slices[i].data, slices[i].size);
+            single = {gathered.data(), gathered.size()};
+            slices = &single;
+            count = 1;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (size_t i = 0; i < count; ++i)
+        {
+            const char *data = slices[i].data;
+            size_t left = slices[i].size;
+            while (left > 0)
+            {
+                ERR_clear_error();
+                size_t written = 0;
+                const int result = SSL_write_ex(ssl_, data, left, &written);
+                if (result == 1)
+                {
+                    data += written;
+                    left -= written;
+                    continue;
+                }
+                const int error = SSL_get_error(ssl_, result);
+                if ((error == SSL_ERROR_WANT_WRITE || error == SSL_ERROR_WANT_READ) &&
+                    waitSocket(sock_, error == SSL_ERROR_WANT_WRITE, http_internal::kSendWaitMs))
+                    continue;
+                ERR_clear_error();
+                return false;
+            }
+        }
+        return true;
+#else
+        (void)slices;
+        (void)count;
+        return false;
+#endif
+    }
+
+    long TlsConnection::read(char *data, size_t size)
+    {
+#ifdef KOLOSAL_WITH_TLS
+        std::lock_guard<std::mutex> lock(mutex_);
+        ERR_clear_error();
+        size_t received = 0;
+        const int result = SSL_read_ex(ssl_, data, size, &received);
+        if (result == 1)
+            return static_cast<long>(received);
+        switch (SSL_get_error(ssl_, result))
+        {
+        case SSL_ERROR_ZERO_RETURN:
+            return 0;
+        case SSL_ERROR_WANT_READ:
+        case SSL_ERROR_WANT_WRITE:
+            // Non-blocking socket drained, or the receive timeout of a blocking one expired
+            setWouldBlock();
+            return -1;
+        case SSL_ERROR_SYSCALL:
+            // errno comes from the failed socket call
+            ERR_clear_error();
+            return -1;
+        default:
+            ERR_clear_error();
+#ifndef _WIN32
+            errno = EPROTO;
+#endif
+            return -1;
+        }
+#else
+        (void)data;
+        (void)size;
+        return -1;
+#endif
+    }
+
+    bool TlsConnection::hasBuffered() const
+    {
+#ifdef KOLOSAL_WITH_TLS
+        std::lock_guard<std::mutex> lock(mutex_);
+        return SSL_pending(ssl_) > 0;
+#else
+        return false;
+#endif
+    }
+
+    void TlsConnection::shutdown()
+    {
+#ifdef KOLOSAL_WITH_TLS
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (SSL_is_init_finished(ssl_))
+            SSL_shutdown(ssl_);
+        ERR_clear_error();
+#endif
+    }
+
+    TlsContext::TlsContext(const TlsOptions &options)
+    {
+#ifdef KOLOSAL_WITH_TLS
+        ctx_ = SSL_CTX_new(TLS_server_method());
+        if (!ctx_)
+            throw std::runtime_error("Cannot create TLS context: " + opensslError("out of memory"));
+        auto fail = [this](const std::string &what)
+        {
+            const std::string reason = what + ": " + opensslError("unknown error");
+            SSL_CTX_free(ctx_);
+            ctx_ = nullptr;
+            throw std::runtime_error(reason);
+        };
+
+        if (SSL_CTX_use_certificate_chain_file(ctx_, options.certFile.c_str()) != 1)
+            fail("Cannot load TLS certificate " + options.certFile);
+        if (SSL_CTX_use_PrivateKey_file(ctx_, options.keyFile.c_str(), SSL_FILETYPE_PEM) != 1)
+            fail("Cannot load TLS key " + options.keyFile);
+        if (SSL_CTX_check_private_key(ctx_) != 1)
+            fail("TLS key " + options.keyFile + " does not match the certificate");
+
+        SSL_CTX_set_min_proto_version(ctx_, TLS1_2_VERSION);
+        // A peer that drops the connection without close_notify reads as closed, like plain TCP
+        SSL_CTX_set_options(ctx_, SSL_OP_IGNORE_UNEXPECTED_EOF | SSL_OP_CIPHER_SERVER_PREFERENCE);
+        // Idle keep-alive connections do not keep their record buffers
+        SSL_CTX_set_mode(ctx_, SSL_MODE_RELEASE_BUFFERS);
+        SSL_CTX_set_alpn_select_cb(ctx_, selectAlpn, nullptr);
+
+        // Resumption skips the certificate and key exchange: tickets need no server state, the
+        // cache serves clients resuming by session ID (and TLS 1.3 tickets when they are off)
+        static const unsigned char kSessionContext[] = "kolosal";
+        SSL_CTX_set_session_id_context(ctx_, kSessionContext, sizeof(kSessionContext) - 1);
+        SSL_CTX_set_timeout(ctx_, std::max(options.sessionTimeoutSeconds, 1));
+        if (options.sessionCacheSize > 0)
+        {
+            SSL_CTX_set_session_cache_mode(ctx_, SSL_SESS_CACHE_SERVER);
+            SSL_CTX_sess_set_cache_size(ctx_, options.sessionCacheSize);
+        }
+        else
+        {
+            SSL_CTX_set_session_cache_mode(ctx_, SSL_SESS_CACHE_OFF);
+        }
+        if (!options.sessionTickets)
+            SSL_CTX_set_options(ctx_, SSL_OP_NO_TICKET);
+
+        if (options.kernelOffload)
+        {
+#ifdef SSL_OP_ENABLE_KTLS
+            SSL_CTX_set_options(ctx_, SSL_OP_ENABLE_KTLS);
+#endif
+            // AES-GCM first: every kTLS kernel implements it, ChaCha20 only from Linux 5.11
+            SSL_CTX_set_ciphersuites(ctx_, "TLS_AES_128_GCM_SHA256:TLS_AES_256_GCM_SHA384:TLS_CHACHA20_POLY1305_SHA256");
+        }
+#else
+        (void)options;
+        throw std::runtime_error("TLS requested but the server was built without OpenSSL");
+#endif
+    }
+
+    TlsContext::~TlsContext()
+    {
+#ifdef KOLOSAL_WITH_TLS
+        SSL_CTX_free(ctx_);
+#endif
+    }
+
+    std::unique_ptr<TlsConnection> TlsContext::accept(SocketType sock) const
+    {
+#ifdef KOLOSAL_WITH_TLS
+        SSL *ssl = SSL_new(ctx_);
+        if (!ssl)
+            return nullptr;
+        if (SSL_set_fd(ssl, static_cast<int>(sock)) != 1)
+        {
+            SSL_free(ssl);
+            return nullptr;
+        }
+        SSL_set_accept_state(ssl);
+        return std::make_unique<TlsConnection>(ssl, sock);
+#else
+        (void)sock;
+        return nullptr;
+#endif
+    }
+
+    bool TlsContext::available()
+    {
+#ifdef KOLOSAL_WITH_TLS
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    TlsStats TlsContext::stats()
+    {
+        TlsStats stats;
+        stats.handshakes = g_handshakes.load(std::memory_order_relaxed);
+        stats.resumed = g_resumed.load(std::memory_order_relaxed);
+        stats.failed = g_failed.load(std::memory_order_relaxed);
+        stats.kernelSend = g_kernelSend.load(std::memory_order_relaxed);
+        stats.kernelRecv = g_kernelRecv.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+    void TlsContext::recordHandshake(const TlsConnection &connection)
+    {
+        g_handshakes.fetch_add(1, std::memory_order_relaxed);
+        if (connection.resumed())
+            g_resumed.fetch_add(1, std::memory_order_relaxed);
+        if (connection.kernelSend())
+            g_kernelSend.fetch_add(1, std::memory_order_relaxed);
+        if (connection.kernelRecv())
+            g_kernelRecv.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void TlsContext::recordFailure()
+    {
+        g_failed.fetch_add(1, std::memory_order_relaxed);
+    }
+
+} // namespace kolosal
@@ -0,0 +1,508 @@
+#include "kolosal/tracing.hpp"
+#include "kolosal/logger.hpp"
+#include "inference_interface.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <curl/curl.h>
+#include <json.hpp>
+
+using json = nlohmann::json;
+
+namespace kolosal
+{
+    namespace tracing
+    {
+
+        namespace
+        {
+            constexpr size_t kBatchSpans = 512;      // Export as soon as this many spans are queued
+            constexpr size_t kMaxQueuedSpans = 16384; // Beyond this spans are dropped rather than stall requests
+            constexpr auto kFlushInterval = std::chrono::seconds(1);
+
+            struct SpanRecord
+            {
+                std::string traceId;
+                std::string spanId;
+                std::string parentSpanId;
+                std::string name;
+                SpanKind kind = SpanKind::Internal;
+                uint64_t startNs = 0;
+                uint64_t endNs = 0;
+                json attributes = json::array();
+                bool error = false;
+                std::string statusMessage;
+            };
+
+            std::mt19937_64 &rng()
+            {
+                thread_local std::mt19937_64 engine(std::random_device{}() ^
+                                                    std::hash<std::thread::id>{}(std::this_thread::get_id()));
+                return engine;
+            }
+
+            std::string randomHex(size_t bytes)
+            {
+                static const char kDigits[] = "0123456789abcdef";
+                std::string out;
+                out.reserve(bytes * 2);
+                while (out.size() < bytes * 2)
+                {
+                    uint64_t value = rng()();
+                    for (int i = 0; i < 16 && out.size() < bytes * 2; ++i, value >>= 4)
+                        out.push_back(kDigits[value & 0xf]);
+                }
+                return out;
+            }
+
+            bool isLowerHex(const std::string &s, size_t pos, size_t len)
+            {
+                if (pos + len > s.size())
+                    return false;
+                bool nonZero = false;
+                for (size_t i = pos; i < pos + len; ++i)
+                {
+                    const char c = s[i];
+                    if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f')))
+                        return false;
+                    nonZero |= c != '0';
+                }
+                return nonZero;
+            }
+
+            uint64_t unixNanosNow()
+            {
+                return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                                 std::chrono::system_clock::now().time_since_epoch())
+                                                 .count());
+            }
+
+            // Engine timestamps are steady_clock; anchor them to the wall clock at export time
+            uint64_t unixNanosFromSteadyMicros(int64_t steadyUs)
+            {
+                const int64_t nowUs = std::chrono::duration_cast<std::chrono::microseconds>(
+                                          std::chrono::steady_clock::now().time_since_epoch())
+                                          .count();
+                return unixNanosNow() - static_cast<uint64_t>(std::max<int64_t>(0, nowUs - steadyUs)) * 1000;
+            }
+
+            json attribute(const char *key, const std::string &value)
+            {
+                return {{"key", key}, {"value", {{"stringValue", value}}}};
+            }
+
+            json attribute(const char *key, int64_t value)
+            {
+                return {{"key", key}, {"value", {{"intValue", std::to_string(value)}}}};
+            }
+
+            size_t discardBody(char *, size_t size, size_t nmemb, void *)
+            {
+                return size * nmemb;
+            }
+
+            // Batches finished spans on a background thread and writes them out as OTLP/JSON
+            class Exporter
+            {
+            public:
+                static Exporter &instance()
+                {
+                    static Exporter exporter;
+                    return exporter;
+                }
+
+                void start(const TracingConfig &config)
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    if (running_.load())
+                        return;
+                    config_ = config;
+                    if (!config_.file.empty())
+                    {
+                        file_.open(config_.file, std::ios::app);
+                        if (!file_)
+                            KOLOSAL_LOG_WARNING("Could not open trace file %s", config_.file.c_str());
+                    }
+                    if (!config_.otlp_endpoint.empty())
+                    {
+                        const std::string suffix = "/v1/traces";
+                        std::string &url = config_.otlp_endpoint;
+                        if (url.size() < suffix.size() || url.compare(url.size() - suffix.size(), suffix.size(), suffix) != 0)
+                        {
+                            if (!url.empty() && url.back() == '/')
+                                url.pop_back();
+                            url += suffix;
+                        }
+                    }
+                    stopping_ = false;
+                    running_.store(true);
+                    worker_ = std::thread(&Exporter::run, this);
+                }
+
+                void stop()
+                {
+                    {
+                        std::lock_guard<std::mutex> lock(mutex_);
+                        if (!running_.load())
+                            return;
+                        running_.store(false);
+                        stopping_ = true;
+                    }
+                    cv_.notify_all();
+                    if (worker_.joinable())
+                        worker_.join();
+                    if (file_.is_open())
+                        file_.close();
+                }
+
+                bool running() const { return running_.load(std::memory_order_relaxed); }
+                double sampleRate() const { return config_.sample_rate; }
+
+                void submit(SpanRecord &&span)
+                {
+                    bool notify = false;
+                    {
+                        std::lock_guard<std::mutex> lock(mutex_);
+                        if (queue_.size() >= kMaxQueuedSpans)
+                        {
+                            ++dropped_;
+                            return;
+                        }
+                        queue_.push_back(std::move(span));
+                        notify = queue_.size() >= kBatchSpans;
+                    }
+                    if (notify)
+                        cv_.notify_one();
+                }
+
+            private:
+                void run()
+                {
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    while (true)
+                    {
+                        cv_.wait_for(lock, kFlushInterval, [this]
+                                     { return stopping_ || queue_.size() >= kBatchSpans; });
+                        std::vector<SpanRecord> batch(std::make_move_iterator(queue_.begin()),
+                                                      std::make_move_iterator(queue_.end()));
+                        queue_.clear();
+                        const uint64_t dropped = std::exchange(dropped_, 0);
+                        const bool last = stopping_;
+                        lock.unlock();
+
+                        if (dropped > 0)
+                            KOLOSAL_LOG_WARNING("Tracing dropped %llu spans, exporter is falling behind",
+                                                     static_cast<unsigned long long>(dropped));
+                        if (!batch.empty())
+                            exportBatch(batch);
+
+                        lock.lock();
+                        if (last)
+                            break;
+                    }
+                }
+
+                void exportBatch(const std::vector<SpanRecord> &batch)
+                {
+                    json spans = json::array();
+                    for (const auto &span : batch)
+                    {
+                        json entry = {
+                            {"traceId", span.traceId},
+                            {"spanId", span.spanId},
+                            {"name", span.name},
+                            {"kind", static_cast<int>(span.kind)},
+                            {"startTimeUnixNano", std::to_string(span.startNs)},
+                            {"endTimeUnixNano", std::to_string(span.endNs)},
+                            {"attributes", span.attributes}};
+                        if (!span.parentSpanId.empty())
+                            entry["parentSpanId"] = span.parentSpanId;
+                        if (span.error)
+                            entry["status"] = {{"code", 2}, {"message", span.statusMessage}};
+                        spans.push_back(std::move(entry));
+                    }
+                    const json request = {
+                        {"resourceSpans", json::array({{
+                            {"resource", {{"attributes", json::array({attribute("service.name", config_.service_name)})}}},
+                            {"scopeSpans", json::array({{
+                                {"scope", {{"name", "kolosal-server"}}},
+                                {"spans", std::move(spans)}}})}}})}};
+                    const std::string body = request.dump();
+
+                    if (file_.is_open())
+                    {
+                        file_ << body << '\n';
+                        file_.flush();
+                    }
+                    if (!config_.otlp_endpoint.empty())
+                        post(body);
+                }
+
+                void post(const std::string &body)
+                {
+                    CURL *curl = curl_easy_init();
+                    if (!curl)
+                        return;
+                    struct curl_slist *headers = curl_slist_append(nullptr, "Content-Type: application/json");
+                    curl_easy_setopt(curl, CURLOPT_URL, config_.otlp_endpoint.c_str());
+                    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+                    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, body.c_str());
+                    curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, static_cast<long>(body.size()));
+                    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, discardBody);
+                    curl_easy_setopt(curl, CURLOPT_TIMEOUT, 5L);
+                    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+                    const CURLcode res = curl_easy_perform(curl);
+                    long status = 0;
+                    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status);
+                    if (res != CURLE_OK || status >= 300)
+                    {
+                        KOLOSAL_LOG_WARNING("Trace export to %s failed: %s", config_.otlp_endpoint.c_str(),
+                                                 res != CURLE_OK ? curl_easy_strerror(res) : ("HTTP " + std::to_string(status)).c_str());
+                    }
+                    curl_slist_free_all(headers);
+                    curl_easy_cleanup(curl);
+                }
+
+                TracingConfig config_;
+                std::ofstream file_;
+                std::atomic<bool> running_{false};
+                bool stopping_ = false;
+                std::deque<SpanRecord> queue_;
+                uint64_t dropped_ = 0;
+                std::mutex mutex_;
+                std::condition_variable cv_;
+                std::thread worker_;
+            };
+
+            thread_local TraceContext t_context;
+
+            std::atomic<bool> g_serverTiming{false};
+            // Stages the current request finished, for Server-Timing; names are literals
+            thread_local std::vector<std::pair<const char *, double>> t_timings;
+            thread_local std::chrono::steady_clock::time_point t_requestStart;
+
+            double elapsedMs(std::chrono::steady_clock::time_point since)
+            {
+                return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - since).count();
+            }
+
+            SpanRecord childOf(const TraceContext &parent, const char *name, uint64_t startNs, uint64_t endNs)
+            {
+                SpanRecord span;
+                span.traceId = parent.traceId;
+                span.parentSpanId = parent.spanId;
+                span.spanId = randomHex(8);
+                span.name = name;
+                span.startNs = startNs;
+                span.endNs = std::max(startNs, endNs);
+                return span;
+            }
+        } // namespace
+
+        struct Span::Data
+        {
+            SpanRecord record;
+            std::string previousSpanId;
+        };
+
+        void start(const TracingConfig &config)
+        {
+            Exporter::instance().start(config);
+        }
+
+        void stop()
+        {
+            Exporter::instance().stop();
+        }
+
+        bool enabled()
+        {
+            return Exporter::instance().running();
+        }
+
+        void set_server_timing(bool enabled)
+        {
+            g_serverTiming.store(enabled, std::memory_order_relaxed);
+        }
+
+        void add_timing(const char *name, double ms)
+        {
+            if (!t_context.timed)
+                return;
+            for (auto &stage : t_timings)
+            {
+                if (stage.first == name || std::strcmp(stage.first, name) == 0)
+                {
+                    stage.second = std::max(stage.second, ms);
+                    return;
+                }
+            }
+            t_timings.emplace_back(name, ms);
+        }
+
+        std::string server_timing()
+        {
+            if (!t_context.timed)
+                return std::string();
+            std::string value;
+            char entry[96];
+            for (const auto &[name, ms] : t_timings)
+            {
+                std::snprintf(entry, sizeof(entry), "%s;dur=%.3f, ", name, ms);
+                value += entry;
+            }
+            std::snprintf(entry, sizeof(entry), "total;dur=%.3f", elapsedMs(t_requestStart));
+            value += entry;
+            return value;
+        }
+
+        const TraceContext &begin_request(const std::string *traceparent)
+        {
+            t_context = TraceContext();
+            t_timings.clear();
+            if (g_serverTiming.load(std::memory_order_relaxed))
+            {
+                t_context.timed = true;
+                t_requestStart = std::chrono::steady_clock::now();
+            }
+            if (!enabled())
+                return t_context;
+
+            // version "00": 00-<32 hex trace id>-<16 hex parent id>-<2 hex flags>
+            if (traceparent && traceparent->size() >= 55 && (*traceparent)[2] == '-' && (*traceparent)[35] == '-' &&
+                (*traceparent)[52] == '-' && traceparent->compare(0, 2, "ff") != 0 &&
+                isLowerHex(*traceparent, 36, 16) && isLowerHex(*traceparent, 3, 32))
+            {
+                t_context.traceId = traceparent->substr(3, 32);
+                t_context.spanId = traceparent->substr(36, 16);
+                const int flags = std::stoi(traceparent->substr(53, 2), nullptr, 16);
+                t_context.sampled = (flags & 0x01) != 0;
+                return t_context;
+            }
+
+            t_context.traceId = randomHex(16);
+            t_context.sampled = std::uniform_real_distribution<double>(0.0, 1.0)(rng()) < Exporter::instance().sampleRate();
+            return t_context;
+        }
+
+        void end_request()
+        {
+            t_context = TraceContext();
+            t_timings.clear();
+        }
+
+        const TraceContext &current()
+        {
+            return t_context;
+        }
+
+        Span::Span(const char *name, SpanKind kind)
+        {
+            if (t_context.timed && kind == SpanKind::Internal)
+            {
+                timingName_ = name;
+                timingStart_ = std::chrono::steady_clock::now();
+            }
+            if (!t_context.sampled || !enabled())
+                return;
+            data_ = new Data{childOf(t_context, name, unixNanosNow(), 0), t_context.spanId};
+            data_->record.kind = kind;
+            t_context.spanId = data_->record.spanId;
+        }
+
+        Span::~Span()
+        {
+            if (timingName_)
+                add_timing(timingName_, elapsedMs(timingStart_));
+            if (!data_)
+                return;
+            data_->record.endNs = unixNanosNow();
+            t_context.spanId = data_->previousSpanId;
+            Exporter::instance().submit(std::move(data_->record));
+            delete data_;
+        }
+
+        void Span::setAttribute(const char *key, const std::string &value)
+        {
+            if (data_)
+                data_->record.attributes.push_back(attribute(key, value));
+        }
+
+        void Span::setAttribute(const char *key, int64_t value)
+        {
+            if (data_)
+                data_->record.attributes.push_back(attribute(key, value));
+        }
+
+        void Span::setError(const std::string &message)
+        {
+            if (!data_)
+                return;
+            data_->record.error = true;
+            data_->record.statusMessage = message;
+        }
+
+        void record_job(const JobTiming &timing, int jobId)
+        {
+            const TraceContext &parent = current();
+            if (parent.timed && timing.submitted_us != 0)
+            {
+                const int64_t nowUs = std::chrono::duration_cast<std::chrono::microseconds>(
+                                          std::chrono::steady_clock::now().time_since_epoch())
+                                          .count();
+                const int64_t scheduled = timing.scheduled_us ? timing.scheduled_us : nowUs;
+                add_timing("queue", (scheduled - timing.submitted_us) / 1000.0);
+                if (timing.first_token_us)
+                {
+                    const int64_t end = timing.last_token_us ? timing.last_token_us : nowUs;
+                    add_timing("prefill", (timing.first_token_us - scheduled) / 1000.0);
+                    add_timing("decode", (end - timing.first_token_us) / 1000.0);
+                }
+            }
+            if (!parent.sampled || !enabled() || timing.submitted_us == 0)
+                return;
+
+            const uint64_t submitted = unixNanosFromSteadyMicros(timing.submitted_us);
+            const uint64_t scheduled = timing.scheduled_us ? unixNanosFromSteadyMicros(timing.scheduled_us) : unixNanosNow();
+            const uint64_t firstToken = timing.first_token_us ? unixNanosFromSteadyMicros(timing.first_token_us) : 0;
+            const uint64_t end = timing.last_token_us ? unixNanosFromSteadyMicros(timing.last_token_us) : unixNanosNow();
+
+            SpanRecord job = childOf(parent, "inference.job", submitted, end);
+            job.attributes.push_back(attribute("job.id", static_cast<int64_t>(jobId)));
+            job.attributes.push_back(attribute("job.decode_steps", static_cast<int64_t>(timing.decode_steps)));
+            const TraceContext jobContext{parent.traceId, job.spanId, true};
+
+            SpanRecord queue = childOf(jobContext, "inference.queue", submitted, scheduled);
+            queue.attributes.push_back(attribute("tokenize_us", static_cast<int64_t>(timing.tokenize_ms * 1000)));
+            queue.attributes.push_back(attribute("grammar_us", static_cast<int64_t>(timing.grammar_ms * 1000)));
+            Exporter::instance().submit(std::move(queue));
+
+            if (firstToken)
+            {
+                SpanRecord prefill = childOf(jobContext, "inference.prefill", scheduled, firstToken);
+                prefill.attributes.push_back(attribute("session_us", static_cast<int64_t>(timing.session_ms * 1000)));
+                prefill.attributes.push_back(attribute("decode_us", static_cast<int64_t>(timing.prefill_ms * 1000)));
+                Exporter::instance().submit(std::move(prefill));
+
+                SpanRecord decode = childOf(jobContext, "inference.decode", firstToken, end);
+                decode.attributes.push_back(attribute("decode_us", static_cast<int64_t>(timing.decode_ms * 1000)));
+                decode.attributes.push_back(attribute("sample_us", static_cast<int64_t>(timing.sample_ms * 1000)));
+                Exporter::instance().submit(std::move(decode));
+            }
+
+            Exporter::instance().submit(std::move(job));
+        }
+
+    } // namespace tracing
+} // namespace kolosal
@@ -0,0 +1,346 @@
+#include "kolosal/traffic_capture.hpp"
+#include "kolosal/logger.hpp"
+#include "kolosal/sha256.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <json.hpp>
+#include <zlib.h>
+
+using json = nlohmann::json;
+
+namespace kolosal
+{
+    namespace traffic_capture
+    {
+
+        namespace
+        {
+            constexpr size_t kBatchRecords = 256;      // Write as soon as this many records are queued
+            constexpr size_t kMaxQueuedRecords = 16384; // Beyond this records are dropped rather than stall requests
+            constexpr auto kFlushInterval = std::chrono::seconds(1);
+
+            // Body fields that steer the request rather than carry user text; kept as they are
+            const char *const kStructuralFields[] = {"model", "role", "type", "encoding_format", "search_mode",
+                                                     "fusion", "mode", "format", "collection_name", "tool_choice"};
+
+            struct PendingRecord
+            {
+                CaptureRecord record;
+                std::string body;
+                bool hasBody = false;
+                std::string apiKey;
+            };
+
+            double uniform()
+            {
+                thread_local std::mt19937_64 engine(std::random_device{}() ^
+                                                    std::hash<std::thread::id>{}(std::this_thread::get_id()));
+                return std::uniform_real_distribution<double>(0.0, 1.0)(engine);
+            }
+
+            uint64_t splitmix64(uint64_t value)
+            {
+                value += 0x9e3779b97f4a7c15ull;
+                value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ull;
+                value = (value ^ (value >> 27)) * 0x94d049bb133111ebull;
+                return value ^ (value >> 31);
+            }
+
+            bool isWordByte(unsigned char c)
+            {
+                return std::isalnum(c) || c >= 0x80;
+            }
+
+            uint64_t hashApiKey(const std::string &apiKey)
+            {
+                if (apiKey.empty())
+                    return 0;
+                Sha256 sha;
+                sha.update(apiKey.data(), apiKey.size());
+                return std::stoull(sha.hexDigest().substr(0, 16), nullptr, 16);
+            }
+
+            std::string hex64(uint64_t value)
+            {
+                static const char kDigits[] = "0123456789abcdef";
+                std::string out(16, '0');
+                for (int i = 15; i >= 0; --i, value >>= 4)
+                    out[i] = kDigits[value & 0xf];
+                return out;
+            }
+
+            void anonymizeJson(json &value, uint64_t key)
+            {
+                if (value.is_string())
+                {
+                    value = anonymize_text(value.get_ref<const std::string &>(), key);
+                }
+                else if (value.is_array())
+                {
+                    for (auto &element : value)
+                        anonymizeJson(element, key);
+                }
+                else if (value.is_object())
+                {
+                    for (auto it = value.begin(); it != value.end(); ++it)
+                    {
+                        if (it.value().is_string() &&
+                            std::find(std::begin(kStructuralFields), std::end(kStructuralFields), it.key()) != std::end(kStructuralFields))
+                            continue;
+                        anonymizeJson(it.value(), key);
+                    }
+                }
+            }
+
+            // Batches sampled records on a background thread; one compressed write per batch
+            class Writer
+            {
+            public:
+                static Writer &instance()
+                {
+                    static Writer writer;
+                    return writer;
+                }
+
+                void start(const TrafficCaptureConfig &config)
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    if (running_.load())
+                        return;
+                    config_ = config;
+                    // A fresh key per run: the same text maps to the same words only within one capture
+                    key_ = splitmix64(std::random_device{}() ^
+                                      static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count()));
+                    file_ = gzopen(config_.file.c_str(), "ab");
+                    if (!file_)
+                    {
+                        KOLOSAL_LOG_WARNING("Could not open traffic capture file %s", config_.file.c_str());
+                        return;
+                    }
+                    full_ = false;
+                    stopping_ = false;
+                    running_.store(true);
+                    worker_ = std::thread(&Writer::run, this);
+                }
+
+                void stop()
+                {
+                    {
+                        std::lock_guard<std::mutex> lock(mutex_);
+                        if (!running_.load())
+                            return;
+                        running_.store(false);
+                        stopping_ = true;
+                    }
+                    cv_.notify_all();
+                    if (worker_.joinable())
+                        worker_.join();
+                    gzclose(file_);
+                    file_ = nullptr;
+                }
+
+                bool running() const { return running_.load(std::memory_order_relaxed); }
+
+                bool sampled() const
+                {
+                    return config_.sample_rate >= 1.0 || (config_.sample_rate > 0.0 && uniform() < config_.sample_rate);
+                }
+
+                size_t maxBodyBytes() const { return static_cast<size_t>(std::max(config_.max_body_kb, 0)) * 1024; }
+
+                void submit(PendingRecord &&record)
+                {
+                    bool notify = false;
+                    {
+                        std::lock_guard<std::mutex> lock(mutex_);
+                        if (queue_.size() >= kMaxQueuedRecords)
+                        {
+                            ++dropped_;
+                            return;
+                        }
+                        queue_.push_back(std::move(record));
+                        notify = queue_.size() >= kBatchRecords;
+                    }
+                    if (notify)
+                        cv_.notify_one();
+                }
+
+            private:
+                void run()
+                {
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    while (true)
+                    {
+                        cv_.wait_for(lock, kFlushInterval, [this]
+                                     { return stopping_ || queue_.size() >= kBatchRecords; });
+                        std::vector<PendingRecord> batch(std::make_move_iterator(queue_.begin()),
+                                                         std::make_move_iterator(queue_.end()));
+                        queue_.clear();
+                        const uint64_t dropped = std::exchange(dropped_, 0);
+                        const bool last = stopping_;
+                        lock.unlock();
+
+                        if (dropped > 0)
+                            KOLOSAL_LOG_WARNING("Traffic capture dropped %llu records, writer is falling behind",
+                                                     static_cast<unsigned long long>(dropped));
+                        if (!batch.empty() && !full_)
+                            writeBatch(batch);
+
+                        lock.lock();
+                        if (last)
+                            break;
+                    }
+                }
+
+                void writeBatch(std::vector<PendingRecord> &batch)
+                {
+                    std::string buffer;
+                    for (auto &pending : batch)
+                    {
+                        buffer += toJson(pending).dump(-1, ' ', false, json::error_handler_t::replace);
+                        buffer += '\n';
+                    }
+                    // A sync flush per batch keeps everything written so far readable if the process dies
+                    if (gzwrite(file_, buffer.data(), static_cast<unsigned>(buffer.size())) <= 0 ||
+                        gzflush(file_, Z_SYNC_FLUSH) != Z_OK)
+                    {
+                        KOLOSAL_LOG_WARNING("Writing traffic capture file %s failed", config_.file.c_str());
+                        return;
+                    }
+
+                    const uint64_t maxSize = static_cast<uint64_t>(std::max(config_.max_file_mb, 0)) * 1024 * 1024;
+                    std::error_code ec;
+                    if (maxSize > 0 && std::filesystem::file_size(config_.file, ec) >= maxSize && !ec)
+                    {
+                        // A capture is a bounded sample; later records are discarded rather than rotated
+                        full_ = true;
+                        KOLOSAL_LOG_INFO("Traffic capture file %s reached %d MB, capture stopped", config_.file.c_str(),
+                                              config_.max_file_mb);
+                    }
+                }
+
+                json toJson(PendingRecord &pending) const
+                {
+                    const CaptureRecord &record = pending.record;
+                    json j = {
+                        {"ts_us", record.timestampUs},
+                        {"latency_us", record.latencyUs},
+                        {"status", record.status},
+                        {"method", record.method},
+                        {"path", record.path},
+                        {"route", record.route},
+                        {"bytes_in", record.bytesIn},
+                        {"bytes_out", record.bytesOut}};
+                    if (!record.contentType.empty())
+                        j["content_type"] = record.contentType;
+                    if (const uint64_t hash = hashApiKey(pending.apiKey))
+                        j["api_key_hash"] = hex64(hash);
+                    if (pending.hasBody)
+                    {
+                        // Only JSON bodies are kept; uploads and other bodies are replayed by size alone
+                        json body = json::parse(pending.body, nullptr, false);
+                        if (!body.is_discarded())
+                        {
+                            if (config_.anonymize)
+                                anonymizeJson(body, key_);
+                            j["body"] = std::move(body);
+                        }
+                    }
+                    return j;
+                }
+
+                TrafficCaptureConfig config_;
+                uint64_t key_ = 0;
+                gzFile file_ = nullptr;
+                bool full_ = false;
+                std::atomic<bool> running_{false};
+                bool stopping_ = false;
+                std::deque<PendingRecord> queue_;
+                uint64_t dropped_ = 0;
+                std::mutex mutex_;
+                std::condition_variable cv_;
+                std::thread worker_;
+            };
+        } // namespace
+
+        void start(const TrafficCaptureConfig &config)
+        {
+            Writer::instance().start(config);
+        }
+
+        void stop()
+        {
+            Writer::instance().stop();
+        }
+
+        bool enabled()
+        {
+            return Writer::instance().running();
+        }
+
+        void finish_request(CaptureRecord &&record, const std::string *body, std::string apiKey)
+        {
+            Writer &writer = Writer::instance();
+            if (!writer.running() || !writer.sampled())
+                return;
+            PendingRecord pending{std::move(record), std::string(), false, std::move(apiKey)};
+            if (body && !body->empty() && body->size() <= writer.maxBodyBytes())
+            {
+                pending.body = *body;
+                pending.hasBody = true;
+            }
+            writer.submit(std::move(pending));
+        }
+
+        std::string anonymize_text(const std::string &text, uint64_t key)
+        {
+            static const char kConsonants[] = "bcdfghjklmnprstvwz";
+            static const char kVowels[] = "aeiou";
+            std::string out = text;
+            size_t i = 0;
+            while (i < out.size())
+            {
+                if (!isWordByte(static_cast<unsigned char>(out[i])))
+                {
+                    ++i;
+                    continue;
+                }
+                size_t end = i;
+                uint64_t hash = 0xcbf29ce484222325ull ^ key;   // FNV-1a over the word, keyed
+                while (end < out.size() && isWordByte(static_cast<unsigned char>(out[end])))
+                {
+                    hash = (hash ^ static_cast<unsigned char>(out[end])) * 0x100000001b3ull;
+                    ++end;
+                }
+                // Alternating consonants and vowels read as words, so they tokenize more like the original
+                for (size_t pos = i; pos < end; ++pos)
+                {
+                    const unsigned char c = static_cast<unsigned char>(out[pos]);
+                    const uint64_t bits = splitmix64(hash + pos - i);
+                    if (std::isdigit(c))
+                    {
+                        out[pos] = static_cast<char>('0' + bits % 10);
+                        continue;
+                    }
+                    const char letter = (pos - i) % 2 == 0 ? kConsonants[bits % (sizeof(kConsonants) - 1)]
+                                                           : kVowels[bits % (sizeof(kVowels) - 1)];
+                    out[pos] = std::isupper(c) ? static_cast<char>(std::toupper(static_cast<unsigned char>(letter))) : letter;
+                }
+                i = end;
+            }
+            return out;
+        }
+
+    } // namespace traffic_capture
+} // namespace kolosal
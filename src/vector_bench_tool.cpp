@@ -0,0 +1,690 @@
+// Measures recall and latency of FAISS index configurations on real vectors.
+//
+//   kolosal-vector-bench --vectors <dump> [options]
+//   kolosal-vector-bench --corpus <texts> --model <embedding model id> --config <server yaml> [options]
+//
+// Every candidate is built the way a FAISS collection builds its main index and
+// compared with an exact Flat search of the same metric.
+
+#include "kolosal/faiss_client.hpp"
+#include "kolosal/faiss_vector_file.hpp"
+#include "kolosal/local_client.hpp"
+#include "kolosal/logger.hpp"
+#include "kolosal/node_manager.h"
+#include "kolosal/server_config.hpp"
+
+#include <faiss/Index.h>
+#include <faiss/IndexFlat.h>
+#include <faiss/IndexHNSW.h>
+#include <faiss/IndexIVF.h>
+#include <faiss/index_factory.h>
+#include <faiss/index_io.h>
+#include <faiss/impl/io.h>
+#include <faiss/utils/distances.h>
+
+#include <yaml-cpp/yaml.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <vector>
+#include <json.hpp>
+
+using json = nlohmann::json;
+using kolosal::ServerConfig;
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    void printUsage()
+    {
+        std::cerr << "Usage: kolosal-vector-bench (--vectors <file> | --corpus <file> --model <id> --config <yaml>) [options]\n"
+                  << "  --vectors <file>       vector dump: .fvecs, or NDJSON of arrays / {\"vector\": [...]} objects\n"
+                  << "  --corpus <file>        one text per line, embedded with --model from --config's models\n"
+                  << "  --config <yaml>        server config; its database.faiss settings are the candidates' defaults\n"
+                  << "  --save-vectors <file>  write the embedded corpus as .fvecs for later runs\n"
+                  << "  --candidates <yaml>    index configurations to compare (default: the configured one)\n"
+                  << "  --queries <file>       query vectors (default: --num-queries vectors held out of the dump)\n"
+                  << "  --num-queries <n>      held-out queries (default 1000)\n"
+                  << "  --k <n>                results per query and recall@k (default 10)\n"
+                  << "  --work-dir <dir>       where DiskIVFPQ and exact_rerank candidates write their vectors file (default: temp dir)\n"
+                  << "  --format table|json    table (default) or one JSON object per result on stdout\n";
+    }
+
+    struct Vectors
+    {
+        int dims = 0;
+        std::vector<float> data;
+
+        size_t count() const { return dims > 0 ? data.size() / dims : 0; }
+        const float* row(size_t i) const { return data.data() + i * dims; }
+
+        bool append(const std::vector<float>& vector, std::string& error)
+        {
+            if (vector.empty())
+                return true;
+            if (dims == 0)
+                dims = static_cast<int>(vector.size());
+            if (static_cast<int>(vector.size()) != dims)
+            {
+                error = "vector of " + std::to_string(vector.size()) + " dimensions among " + std::to_string(dims) + "-dimensional ones";
+                return false;
+            }
+            data.insert(data.end(), vector.begin(), vector.end());
+            return true;
+        }
+    };
+
+    bool readFvecs(const std::string& path, Vectors& out, std::string& error)
+    {
+        std::ifstream in(path, std::ios::binary);
+        if (!in)
+        {
+            error = "cannot open " + path;
+            return false;
+        }
+        int32_t dims = 0;
+        std::vector<float> vector;
+        while (in.read(reinterpret_cast<char*>(&dims), sizeof(dims)))
+        {
+            if (dims <= 0 || dims > (1 << 16))
+            {
+                error = path + " is not an .fvecs file";
+                return false;
+            }
+            vector.resize(dims);
+            if (!in.read(reinterpret_cast<char*>(vector.data()), dims * sizeof(float)))
+            {
+                error = path + " ends inside a vector";
+                return false;
+            }
+            if (!out.append(vector, error))
+                return false;
+        }
+        return true;
+    }
+
+    bool readNdjson(const std::string& path, Vectors& out, std::string& error)
+    {
+        std::ifstream in(path);
+        if (!in)
+        {
+            error = "cannot open " + path;
+            return false;
+        }
+        std::string line;
+        size_t number = 0;
+        while (std::getline(in, line))
+        {
+            ++number;
+            if (line.find_first_not_of(" \t\r") == std::string::npos)
+                continue;
+            try
+            {
+                const json j = json::parse(line);
+                const json& vector = j.is_object() ? j.at("vector") : j;
+                if (!out.append(vector.get<std::vector<float>>(), error))
+                {
+                    error = path + ":" + std::to_string(number) + ": " + error;
+                    return false;
+                }
+            }
+            catch (const std::exception& ex)
+            {
+                error = path + ":" + std::to_string(number) + ": " + ex.what();
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool readVectors(const std::string& path, Vectors& out, std::string& error)
+    {
+        const bool fvecs = std::filesystem::path(path).extension() == ".fvecs";
+        if (!(fvecs ? readFvecs(path, out, error) : readNdjson(path, out, error)))
+            return false;
+        if (out.count() == 0)
+        {
+            error = path + " holds no vectors";
+            return false;
+        }
+        return true;
+    }
+
+    bool writeFvecs(const std::string& path, const Vectors& vectors)
+    {
+        std::ofstream out(path, std::ios::binary);
+        const int32_t dims = vectors.dims;
+        for (size_t i = 0; i < vectors.count() && out; ++i)
+        {
+            out.write(reinterpret_cast<const char*>(&dims), sizeof(dims));
+            out.write(reinterpret_cast<const char*>(vectors.row(i)), dims * sizeof(float));
+        }
+        return static_cast<bool>(out);
+    }
+
+    // Embeds every non-empty line of the corpus with a model from the server config
+    bool embedCorpus(const std::string& path, const std::string& modelId, Vectors& out, std::string& error)
+    {
+        auto& config = ServerConfig::getInstance();
+        auto model = std::find_if(config.models.begin(), config.models.end(),
+                                  [&modelId](const kolosal::ModelConfig& m) { return m.id == modelId; });
+        if (model == config.models.end())
+        {
+            error = "model '" + modelId + "' is not in the config";
+            return false;
+        }
+        if (!std::filesystem::exists(model->path))
+        {
+            error = "model file " + model->path + " not found; download it by starting the server once";
+            return false;
+        }
+
+        std::ifstream in(path);
+        if (!in)
+        {
+            error = "cannot open " + path;
+            return false;
+        }
+        std::vector<std::string> texts;
+        for (std::string line; std::getline(in, line);)
+        {
+            if (line.find_first_not_of(" \t\r") != std::string::npos)
+                texts.push_back(line);
+        }
+
+        kolosal::NodeManager nodeManager;
+        if (!nodeManager.addEmbeddingEngine(model->id, model->path.c_str(), model->loadParams, model->mainGpuId))
+        {
+            error = "failed to load embedding model '" + modelId + "'";
+            return false;
+        }
+        kolosal::LocalClient client(nodeManager);
+
+        constexpr size_t kBatch = 64;
+        size_t failed = 0;
+        const auto started = Clock::now();
+        for (size_t begin = 0; begin < texts.size(); begin += kBatch)
+        {
+            const size_t end = std::min(texts.size(), begin + kBatch);
+            auto results = client.embed(model->id, std::vector<std::string>(texts.begin() + begin, texts.begin() + end), false).get();
+            for (const auto& result : results)
+            {
+                if (result.hasError)
+                    ++failed;
+                else if (!out.append(result.embedding, error))
+                    return false;
+            }
+            std::cerr << "\rEmbedded " << end << "/" << texts.size() << std::flush;
+        }
+        const double seconds = std::chrono::duration<double>(Clock::now() - started).count();
+        std::cerr << "\rEmbedded " << out.count() << " texts in " << seconds << " s";
+        if (failed > 0)
+            std::cerr << " (" << failed << " failed)";
+        std::cerr << "\n";
+        if (out.count() == 0)
+        {
+            error = "no text of " + path + " could be embedded";
+            return false;
+        }
+        return true;
+    }
+
+    // One index configuration; the nprobe or efSearch values are searched on the same build
+    struct Candidate
+    {
+        std::string indexType;
+        std::string metricType;
+        bool normalizeVectors = true;
+        int nlist = 0;
+        std::vector<int> nprobe;
+        std::vector<int> efSearch;
+        int diskRerankFactor = 4;
+        bool exactRerank = false;
+    };
+
+    std::vector<int> intList(const YAML::Node& node, int fallback)
+    {
+        std::vector<int> values;
+        if (node && node.IsSequence())
+        {
+            for (const auto& value : node)
+                values.push_back(value.as<int>());
+        }
+        else if (node)
+        {
+            values.push_back(node.as<int>());
+        }
+        if (values.empty())
+            values.push_back(fallback);
+        return values;
+    }
+
+    Candidate candidateFrom(const YAML::Node& node, const kolosal::DatabaseConfig::FaissConfig& defaults)
+    {
+        Candidate c;
+        c.indexType = node["index_type"] ? node["index_type"].as<std::string>() : defaults.indexType;
+        if (c.indexType == "Auto")
+            c.indexType = defaults.autoIndexType;
+        c.metricType = node["metric_type"] ? node["metric_type"].as<std::string>() : defaults.metricType;
+        c.normalizeVectors = node["normalize_vectors"] ? node["normalize_vectors"].as<bool>() : defaults.normalizeVectors;
+        c.nlist = node["nlist"] ? node["nlist"].as<int>() : defaults.nlist;
+        c.nprobe = intList(node["nprobe"], defaults.nprobe);
+        c.efSearch = intList(node["ef_search"], defaults.efSearch);
+        c.diskRerankFactor = node["disk_rerank_factor"] ? node["disk_rerank_factor"].as<int>() : defaults.diskRerankFactor;
+        c.exactRerank = node["exact_rerank"] ? node["exact_rerank"].as<bool>() : defaults.exactRerank;
+        return c;
+    }
+
+    bool isIvf(const std::string& type) { return type.rfind("IVF", 0) == 0 || type == "DiskIVFPQ"; }
+    bool isHnsw(const std::string& type) { return type.rfind("HNSW", 0) == 0; }
+
+    // Base and query vectors as one metric sees them, with their exact top-k
+    struct Prepared
+    {
+        faiss::MetricType metric = faiss::METRIC_INNER_PRODUCT;
+        Vectors base;
+        Vectors queries;
+        std::vector<faiss::idx_t> truth;
+    };
+
+    void normalizeRows(Vectors& vectors)
+    {
+        if (vectors.count() > 0)
+            faiss::fvec_renorm_L2(vectors.dims, vectors.count(), vectors.data.data());
+    }
+
+    Prepared prepare(const Vectors& base, const Vectors& queries, faiss::MetricType metric, bool normalize, int k)
+    {
+        Prepared p;
+        p.metric = metric;
+        p.base = base;
+        p.queries = queries;
+        if (normalize)
+        {
+            normalizeRows(p.base);
+            normalizeRows(p.queries);
+        }
+        faiss::IndexFlat exact(base.dims, metric);
+        exact.add(static_cast<faiss::idx_t>(p.base.count()), p.base.data.data());
+        std::vector<float> distances(p.queries.count() * k);
+        p.truth.resize(p.queries.count() * k);
+        exact.search(static_cast<faiss::idx_t>(p.queries.count()), p.queries.data.data(), k, distances.data(), p.truth.data());
+        return p;
+    }
+
+    // Counts the bytes of a serialized index, which is close to what it holds in memory
+    struct CountingWriter : faiss::IOWriter
+    {
+        size_t bytes = 0;
+        size_t operator()(const void*, size_t size, size_t nitems) override
+        {
+            bytes += size * nitems;
+            return nitems;
+        }
+    };
+
+    struct Measurement
+    {
+        std::string label;
+        int nlist = 0;
+        int nprobe = 0;
+        int efSearch = 0;
+        double recall = 0.0;
+        double qps = 0.0;
+        double p50Ms = 0.0;
+        double p99Ms = 0.0;
+        double buildSeconds = 0.0;
+        double memoryMB = 0.0;
+    };
+
+    // Re-scores DiskIVFPQ (or exact_rerank) candidates with the exact vectors read back from the vectors file
+    void rerankFromDisk(const kolosal::FaissVectorFile& file, const Prepared& p, const float* query, int k,
+                        std::vector<faiss::idx_t>& candidates, faiss::idx_t* out)
+    {
+        candidates.erase(std::remove(candidates.begin(), candidates.end(), faiss::idx_t(-1)), candidates.end());
+        std::vector<float> exact(candidates.size() * p.base.dims);
+        file.read(candidates.data(), candidates.size(), exact.data());
+        std::vector<std::pair<float, faiss::idx_t>> scored;
+        for (size_t i = 0; i < candidates.size(); ++i)
+        {
+            const float* vector = exact.data() + i * p.base.dims;
+            scored.emplace_back(p.metric == faiss::METRIC_L2 ? -faiss::fvec_L2sqr(query, vector, p.base.dims)
+                                                             : faiss::fvec_inner_product(query, vector, p.base.dims),
+                                candidates[i]);
+        }
+        const size_t keep = std::min<size_t>(k, scored.size());
+        std::partial_sort(scored.begin(), scored.begin() + keep, scored.end(),
+                          [](const auto& a, const auto& b) { return a.first > b.first; });
+        for (int i = 0; i < k; ++i)
+            out[i] = i < static_cast<int>(keep) ? scored[i].second : -1;
+    }
+
+    std::vector<Measurement> run(const Candidate& c, const Prepared& p, int k, const std::filesystem::path& workDir)
+    {
+        const size_t n = p.base.count();
+        const int dims = p.base.dims;
+        const bool quantized = c.indexType == "IVFPQ" || c.indexType.find("SQ") != std::string::npos;
+        const bool disk = c.indexType == "DiskIVFPQ" || (c.exactRerank && quantized);
+        // Never more lists than the data can train, as in a collection rebuild
+        const int nlist = isIvf(c.indexType) ? std::clamp(c.nlist, 1, std::max(1, static_cast<int>(n / 39))) : 0;
+
+        const auto started = Clock::now();
+        const std::string description = kolosal::FaissClient::indexFactoryString(c.indexType, dims, std::max(nlist, 1));
+        std::unique_ptr<faiss::Index> index(faiss::index_factory(dims, description.c_str(), p.metric));
+        if (!index->is_trained)
+        {
+            const size_t sample = std::min(n, std::clamp<size_t>(static_cast<size_t>(nlist) * 64, 10000, 262144));
+            std::vector<float> training;
+            training.reserve(sample * dims);
+            for (size_t i = 0; i < sample; ++i)
+            {
+                const float* row = p.base.row(i * n / sample);
+                training.insert(training.end(), row, row + dims);
+            }
+            index->train(static_cast<faiss::idx_t>(sample), training.data());
+        }
+        index->add(static_cast<faiss::idx_t>(n), p.base.data.data());
+
+        kolosal::FaissVectorFile file;
+        const auto vectorsPath = workDir / ("kolosal-vector-bench-" + std::to_string(Clock::now().time_since_epoch().count()) + ".vectors");
+        if (disk)
+        {
+            bool created = false;
+            std::string error;
+            std::filesystem::remove(vectorsPath);
+            std::vector<int64_t> ids(n);
+            for (size_t i = 0; i < n; ++i)
+                ids[i] = static_cast<int64_t>(i);
+            if (!file.open(vectorsPath, dims, created, error) || !file.write(ids.data(), p.base.data.data(), n, error) ||
+                !file.sync(error))
+            {
+                throw std::runtime_error("vectors file " + vectorsPath.string() + ": " + error);
+            }
+        }
+        const double buildSeconds = std::chrono::duration<double>(Clock::now() - started).count();
+
+        CountingWriter writer;
+        faiss::write_index(index.get(), &writer);
+
+        std::vector<int> sweep = isIvf(c.indexType) ? c.nprobe : isHnsw(c.indexType) ? c.efSearch : std::vector<int>{0};
+        std::vector<Measurement> measurements;
+        const size_t nq = p.queries.count();
+        const int fetch = disk ? k * std::max(c.diskRerankFactor, 1) : k;
+        for (int value : sweep)
+        {
+            faiss::SearchParametersIVF ivf;
+            faiss::SearchParametersHNSW hnsw;
+            const faiss::SearchParameters* params = nullptr;
+            if (isIvf(c.indexType))
+            {
+                ivf.nprobe = std::clamp(value, 1, nlist);
+                params = &ivf;
+            }
+            else if (isHnsw(c.indexType))
+            {
+                hnsw.efSearch = std::max(value, k);
+                params = &hnsw;
+            }
+
+            std::vector<float> distances(fetch);
+            std::vector<faiss::idx_t> labels(fetch);
+            std::vector<faiss::idx_t> found(nq * k);
+            std::vector<double> latencies;
+            latencies.reserve(nq);
+            for (size_t q = 0; q < nq; ++q)
+            {
+                const float* query = p.queries.row(q);
+                const auto begin = Clock::now();
+                index->search(1, query, fetch, distances.data(), labels.data(), params);
+                if (disk)
+                    rerankFromDisk(file, p, query, k, labels, found.data() + q * k);
+                else
+                    std::copy(labels.begin(), labels.begin() + k, found.begin() + q * k);
+                latencies.push_back(std::chrono::duration<double, std::milli>(Clock::now() - begin).count());
+                labels.resize(fetch);
+            }
+
+            // recall@k: share of the exact top-k each query got back
+            const size_t relevant = std::min<size_t>(k, p.base.count());
+            double recall = 0.0;
+            for (size_t q = 0; q < nq; ++q)
+            {
+                std::unordered_set<faiss::idx_t> truth(p.truth.begin() + q * k, p.truth.begin() + q * k + relevant);
+                size_t hits = 0;
+                for (int i = 0; i < k; ++i)
+                    hits += truth.count(found[q * k + i]);
+                recall += static_cast<double>(hits) / relevant;
+            }
+
+            double total = 0.0;
+            for (double ms : latencies)
+                total += ms;
+            std::sort(latencies.begin(), latencies.end());
+            auto percentile = [&latencies](double fraction)
+            {
+                const size_t rank = static_cast<size_t>(std::ceil(fraction * latencies.size()));
+                return latencies[std::min(latencies.size(), std::max<size_t>(rank, 1)) - 1];
+            };
+
+            Measurement m;
+            m.label = c.indexType + " " + c.metricType + (c.normalizeVectors && p.metric == faiss::METRIC_INNER_PRODUCT ? " norm" : "") +
+                      (disk && c.indexType != "DiskIVFPQ" ? " rerank" : "");
+            m.nlist = nlist;
+            m.nprobe = isIvf(c.indexType) ? ivf.nprobe : 0;
+            m.efSearch = isHnsw(c.indexType) ? hnsw.efSearch : 0;
+            m.recall = recall / nq;
+            m.qps = total > 0.0 ? nq * 1000.0 / total : 0.0;
+            m.p50Ms = percentile(0.50);
+            m.p99Ms = percentile(0.99);
+            m.buildSeconds = buildSeconds;
+            m.memoryMB = writer.bytes / (1024.0 * 1024.0);
+            measurements.push_back(m);
+        }
+
+        if (disk)
+        {
+            file.close();
+            std::filesystem::remove(vectorsPath);
+        }
+        return measurements;
+    }
+
+    void printTableHeader(int k)
+    {
+        std::printf("%-22s %6s %7s %9s %9s %9s %9s %9s %9s %9s\n", "index", "nlist", "nprobe", "ef_search",
+                    ("recall@" + std::to_string(k)).c_str(), "QPS", "p50 ms", "p99 ms", "build s", "index MB");
+    }
+
+    void printRow(const Measurement& m)
+    {
+        std::printf("%-22s %6d %7d %9d %9.4f %9.1f %9.3f %9.3f %9.2f %9.1f\n", m.label.c_str(), m.nlist, m.nprobe,
+                    m.efSearch, m.recall, m.qps, m.p50Ms, m.p99Ms, m.buildSeconds, m.memoryMB);
+        std::fflush(stdout);
+    }
+
+    void printJson(const Measurement& m, int k)
+    {
+        json j = {{"index", m.label},          {"nlist", m.nlist},       {"nprobe", m.nprobe},
+                  {"ef_search", m.efSearch},   {"k", k},                 {"recall", m.recall},
+                  {"qps", m.qps},              {"p50_ms", m.p50Ms},      {"p99_ms", m.p99Ms},
+                  {"build_s", m.buildSeconds}, {"index_mb", m.memoryMB}};
+        std::cout << j.dump() << std::endl;
+    }
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    std::string vectorsFile, corpusFile, model, configFile, saveVectors, candidatesFile, queriesFile;
+    std::string workDir = std::filesystem::temp_directory_path().string();
+    size_t numQueries = 1000;
+    int k = 10;
+    bool asJson = false;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (arg == "--vectors" && hasValue)
+            vectorsFile = argv[++i];
+        else if (arg == "--corpus" && hasValue)
+            corpusFile = argv[++i];
+        else if (arg == "--model" && hasValue)
+            model = argv[++i];
+        else if (arg == "--config" && hasValue)
+            configFile = argv[++i];
+        else if (arg == "--save-vectors" && hasValue)
+            saveVectors = argv[++i];
+        else if (arg == "--candidates" && hasValue)
+            candidatesFile = argv[++i];
+        else if (arg == "--queries" && hasValue)
+            queriesFile = argv[++i];
+        else if (arg == "--num-queries" && hasValue)
+            numQueries = std::stoul(argv[++i]);
+        else if (arg == "--k" && hasValue)
+            k = std::max(1, std::stoi(argv[++i]));
+        else if (arg == "--work-dir" && hasValue)
+            workDir = argv[++i];
+        else if (arg == "--format" && hasValue)
+            asJson = std::string(argv[++i]) == "json";
+        else
+        {
+            printUsage();
+            return arg == "--help" || arg == "-h" ? 0 : 1;
+        }
+    }
+    if (vectorsFile.empty() == corpusFile.empty() || (!corpusFile.empty() && (model.empty() || configFile.empty())))
+    {
+        printUsage();
+        return 1;
+    }
+
+    ServerLogger::instance().setQuietMode(true);
+    if (!configFile.empty())
+    {
+        ServerConfig config;
+        if (!config.loadFromFile(configFile))
+        {
+            std::cerr << "Failed to load " << configFile << "\n";
+            return 1;
+        }
+        ServerConfig::setInstance(config);
+    }
+    const auto& defaults = ServerConfig::getInstance().database.faiss;
+
+    std::string error;
+    Vectors base;
+    if (!(vectorsFile.empty() ? embedCorpus(corpusFile, model, base, error) : readVectors(vectorsFile, base, error)))
+    {
+        std::cerr << "Error: " << error << "\n";
+        return 1;
+    }
+    if (!saveVectors.empty() && !writeFvecs(saveVectors, base))
+    {
+        std::cerr << "Error: cannot write " << saveVectors << "\n";
+        return 1;
+    }
+
+    Vectors queries;
+    queries.dims = base.dims;
+    if (!queriesFile.empty())
+    {
+        queries.dims = 0;
+        if (!readVectors(queriesFile, queries, error))
+        {
+            std::cerr << "Error: " << error << "\n";
+            return 1;
+        }
+        if (queries.dims != base.dims)
+        {
+            std::cerr << "Error: queries have " << queries.dims << " dimensions, the vectors " << base.dims << "\n";
+            return 1;
+        }
+    }
+    else
+    {
+        // Hold evenly spaced vectors out of the base so no query finds itself
+        const size_t n = base.count();
+        const size_t nq = std::min(numQueries, n / 2);
+        Vectors kept;
+        kept.dims = base.dims;
+        size_t next = 0;
+        for (size_t i = 0; i < n; ++i)
+        {
+            Vectors& to = next < nq && i == next * n / nq ? queries : kept;
+            if (&to == &queries)
+                ++next;
+            to.data.insert(to.data.end(), base.row(i), base.row(i) + base.dims);
+        }
+        base = std::move(kept);
+    }
+    if (queries.count() == 0 || base.count() == 0)
+    {
+        std::cerr << "Error: need at least two vectors to benchmark\n";
+        return 1;
+    }
+
+    std::vector<Candidate> candidates;
+    try
+    {
+        if (candidatesFile.empty())
+        {
+            candidates.push_back(candidateFrom(YAML::Node(YAML::NodeType::Map), defaults));
+        }
+        else
+        {
+            const YAML::Node root = YAML::LoadFile(candidatesFile);
+            const YAML::Node list = root["candidates"] ? root["candidates"] : root;
+            for (const auto& node : list)
+                candidates.push_back(candidateFrom(node, defaults));
+        }
+    }
+    catch (const std::exception& ex)
+    {
+        std::cerr << "Error: " << candidatesFile << ": " << ex.what() << "\n";
+        return 1;
+    }
+
+    std::cerr << base.count() << " vectors of " << base.dims << " dimensions, " << queries.count() << " queries, "
+              << candidates.size() << " candidate(s)\n";
+    if (!asJson)
+        printTableHeader(k);
+
+    // Ground truth is shared by every candidate with the same metric and normalization
+    std::map<std::pair<int, bool>, Prepared> prepared;
+    int status = 0;
+    for (const auto& candidate : candidates)
+    {
+        const faiss::MetricType metric = candidate.metricType == "L2" ? faiss::METRIC_L2 : faiss::METRIC_INNER_PRODUCT;
+        const bool normalize = candidate.normalizeVectors && metric == faiss::METRIC_INNER_PRODUCT;
+        const auto key = std::make_pair(static_cast<int>(metric), normalize);
+        try
+        {
+            auto it = prepared.find(key);
+            if (it == prepared.end())
+                it = prepared.emplace(key, prepare(base, queries, metric, normalize, k)).first;
+            for (const auto& m : run(candidate, it->second, k, workDir))
+            {
+                if (asJson)
+                    printJson(m, k);
+                else
+                    printRow(m);
+            }
+        }
+        catch (const std::exception& ex)
+        {
+            std::cerr << "Error: " << candidate.indexType << ": " << ex.what() << "\n";
+            status = 1;
+        }
+    }
+    return status;
+}
@@ -0,0 +1,421 @@
+#include "kolosal/vector_math.hpp"
+#include "kolosal/hardware_features.hpp"
+#include "kolosal/logger.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define KOLOSAL_VECMATH_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#define KOLOSAL_VECMATH_AVX2
+#define KOLOSAL_VECMATH_AVX512
+#else
+#define KOLOSAL_VECMATH_AVX2 __attribute__((target("avx2,fma,f16c")))
+#define KOLOSAL_VECMATH_AVX512 __attribute__((target("avx512f,avx2,fma,f16c")))
+#endif
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace kolosal {
+namespace vecmath {
+
+    namespace {
+
+        // ---- Baseline: SSE2 on x86-64 and NEON on ARM are always there ----
+
+        float dotBase(const float* a, const float* b, size_t n)
+        {
+            size_t i = 0;
+            float sum = 0.0f;
+#if defined(KOLOSAL_VECMATH_X86)
+            __m128 acc0 = _mm_setzero_ps();
+            __m128 acc1 = _mm_setzero_ps();
+            for (; i + 8 <= n; i += 8)
+            {
+                acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+                acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+            }
+            __m128 lanes = _mm_add_ps(acc0, acc1);
+            lanes = _mm_add_ps(lanes, _mm_movehl_ps(lanes, lanes));
+            lanes = _mm_add_ss(lanes, _mm_shuffle_ps(lanes, lanes, 1));
+            sum = _mm_cvtss_f32(lanes);
+#elif defined(__ARM_NEON)
+            float32x4_t acc0 = vdupq_n_f32(0.0f);
+            float32x4_t acc1 = vdupq_n_f32(0.0f);
+            for (; i + 8 <= n; i += 8)
+            {
+                acc0 = vmlaq_f32(acc0, vld1q_f32(a + i), vld1q_f32(b + i));
+                acc1 = vmlaq_f32(acc1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+            }
+            float32x4_t lanes = vaddq_f32(acc0, acc1);
+            float32x2_t pair = vadd_f32(vget_low_f32(lanes), vget_high_f32(lanes));
+            sum = vget_lane_f32(vpadd_f32(pair, pair), 0);
+#endif
+            for (; i < n; ++i)
+                sum += a[i] * b[i];
+            return sum;
+        }
+
+        void scaleBase(float* v, size_t n, float factor)
+        {
+            for (size_t i = 0; i < n; ++i)
+                v[i] *= factor;
+        }
+
+        uint16_t floatToHalf(float value)
+        {
+            uint32_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            const uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000u);
+            const uint32_t absBits = bits & 0x7fffffffu;
+
+            if (absBits >= 0x7f800000u) // Inf or NaN
+                return sign | 0x7c00u | (absBits > 0x7f800000u ? 0x200u : 0u);
+            if (absBits >= 0x477ff000u) // Rounds past the largest half
+                return sign | 0x7c00u;
+            if (absBits < 0x38800000u) // Subnormal half (or zero)
+            {
+                const float scaled = std::fabs(value) * 16777216.0f; // 2^24, one unit per subnormal step
+                return sign | static_cast<uint16_t>(std::nearbyint(scaled));
+            }
+
+            uint32_t half = (absBits - 0x38000000u) >> 13;
+            const uint32_t rest = absBits & 0x1fffu;
+            if (rest > 0x1000u || (rest == 0x1000u && (half & 1u)))
+                ++half;
+            return sign | static_cast<uint16_t>(half);
+        }
+
+        float halfToFloat(uint16_t value)
+        {
+            const uint32_t sign = static_cast<uint32_t>(value & 0x8000u) << 16;
+            const uint32_t exponent = (value >> 10) & 0x1fu;
+            const uint32_t mantissa = value & 0x3ffu;
+            uint32_t bits;
+            if (exponent == 0x1fu) // Inf or NaN
+                bits = sign | 0x7f800000u | (mantissa << 13);
+            else if (exponent == 0) // Subnormal half (or zero)
+            {
+                const float magnitude = static_cast<float>(mantissa) / 16777216.0f; // 2^-24 per step
+                std::memcpy(&bits, &magnitude, sizeof(bits));
+                bits |= sign;
+            }
+            else
+                bits = sign | ((exponent + 112u) << 23) | (mantissa << 13);
+            float result;
+            std::memcpy(&result, &bits, sizeof(result));
+            return result;
+        }
+
+        int8_t floatToInt8(float value)
+        {
+            return static_cast<int8_t>(std::lround(std::clamp(value, -1.0f, 1.0f) * 127.0f));
+        }
+
+        void toHalfBase(const float* in, size_t n, uint16_t* out)
+        {
+            size_t i = 0;
+#if defined(__aarch64__)
+            for (; i + 4 <= n; i += 4)
+                vst1_u16(out + i, vreinterpret_u16_f16(vcvt_f16_f32(vld1q_f32(in + i))));
+#endif
+            for (; i < n; ++i)
+                out[i] = floatToHalf(in[i]);
+        }
+
+        void fromHalfBase(const uint16_t* in, size_t n, float* out)
+        {
+            size_t i = 0;
+#if defined(__aarch64__)
+            for (; i + 4 <= n; i += 4)
+                vst1q_f32(out + i, vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(in + i))));
+#endif
+            for (; i < n; ++i)
+                out[i] = halfToFloat(in[i]);
+        }
+
+        void toInt8Base(const float* in, size_t n, int8_t* out)
+        {
+            size_t i = 0;
+#if defined(__aarch64__)
+            // vcvtaq rounds halves away from zero, as lround does
+            const float32x4_t lo = vdupq_n_f32(-1.0f);
+            const float32x4_t hi = vdupq_n_f32(1.0f);
+            for (; i + 8 <= n; i += 8)
+            {
+                const int32x4_t a = vcvtaq_s32_f32(vmulq_n_f32(vminq_f32(vmaxq_f32(vld1q_f32(in + i), lo), hi), 127.0f));
+                const int32x4_t b = vcvtaq_s32_f32(vmulq_n_f32(vminq_f32(vmaxq_f32(vld1q_f32(in + i + 4), lo), hi), 127.0f));
+                vst1_s8(out + i, vmovn_s16(vcombine_s16(vmovn_s32(a), vmovn_s32(b))));
+            }
+#endif
+            for (; i < n; ++i)
+                out[i] = floatToInt8(in[i]);
+        }
+
+#ifdef KOLOSAL_VECMATH_X86
+        // ---- AVX2 + FMA + F16C ----
+
+        KOLOSAL_VECMATH_AVX2 float dotAvx2(const float* a, const float* b, size_t n)
+        {
+            size_t i = 0;
+            __m256 acc0 = _mm256_setzero_ps();
+            __m256 acc1 = _mm256_setzero_ps();
+            for (; i + 16 <= n; i += 16)
+            {
+                acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+                acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), acc1);
+            }
+            if (i + 8 <= n)
+            {
+                acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+                i += 8;
+            }
+            acc0 = _mm256_add_ps(acc0, acc1);
+            __m128 lanes = _mm_add_ps(_mm256_castps256_ps128(acc0), _mm256_extractf128_ps(acc0, 1));
+            lanes = _mm_add_ps(lanes, _mm_movehl_ps(lanes, lanes));
+            lanes = _mm_add_ss(lanes, _mm_shuffle_ps(lanes, lanes, 1));
+            float sum = _mm_cvtss_f32(lanes);
+            for (; i < n; ++i)
+                sum += a[i] * b[i];
+            return sum;
+        }
+
+        KOLOSAL_VECMATH_AVX2 void scaleAvx2(float* v, size_t n, float factor)
+        {
+            size_t i = 0;
+            const __m256 f = _mm256_set1_ps(factor);
+            for (; i + 8 <= n; i += 8)
+                _mm256_storeu_ps(v + i, _mm256_mul_ps(_mm256_loadu_ps(v + i), f));
+            for (; i < n; ++i)
+                v[i] *= factor;
+        }
+
+        KOLOSAL_VECMATH_AVX2 void toHalfAvx2(const float* in, size_t n, uint16_t* out)
+        {
+            size_t i = 0;
+            for (; i + 8 <= n; i += 8)
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i),
+                                 _mm256_cvtps_ph(_mm256_loadu_ps(in + i), _MM_FROUND_TO_NEAREST_INT));
+            for (; i < n; ++i)
+                out[i] = floatToHalf(in[i]);
+        }
+
+        KOLOSAL_VECMATH_AVX2 void fromHalfAvx2(const uint16_t* in, size_t n, float* out)
+        {
+            size_t i = 0;
+            for (; i + 8 <= n; i += 8)
+                _mm256_storeu_ps(out + i, _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i))));
+            for (; i < n; ++i)
+                out[i] = halfToFloat(in[i]);
+        }
+
+        KOLOSAL_VECMATH_AVX2 void toInt8Avx2(const float* in, size_t n, int8_t* out)
+        {
+            size_t i = 0;
+            const __m256 lo = _mm256_set1_ps(-1.0f);
+            const __m256 hi = _mm256_set1_ps(1.0f);
+            const __m256 scale = _mm256_set1_ps(127.0f);
+            const __m256 half = _mm256_set1_ps(0.5f);
+            const __m256 signBit = _mm256_set1_ps(-0.0f);
+            for (; i + 8 <= n; i += 8)
+            {
+                const __m256 x = _mm256_mul_ps(_mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(in + i), lo), hi), scale);
+                // Truncate, then step one away from zero when the dropped fraction is at least a half
+                const __m256 whole = _mm256_round_ps(x, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+                const __m256 fraction = _mm256_andnot_ps(signBit, _mm256_sub_ps(x, whole));
+                const __m256 step = _mm256_and_ps(_mm256_cmp_ps(fraction, half, _CMP_GE_OQ),
+                                                  _mm256_or_ps(hi, _mm256_and_ps(x, signBit)));
+                const __m256i ints = _mm256_cvttps_epi32(_mm256_add_ps(whole, step));
+                const __m128i words = _mm_packs_epi32(_mm256_castsi256_si128(ints), _mm256_extracti128_si256(ints, 1));
+                _mm_storel_epi64(reinterpret_cast<__m128i*>(out + i), _mm_packs_epi16(words, words));
+            }
+            for (; i < n; ++i)
+                out[i] = floatToInt8(in[i]);
+        }
+
+        // ---- AVX-512F: tails are handled with masked loads and stores ----
+
+        KOLOSAL_VECMATH_AVX512 __mmask16 tailMask(size_t remaining)
+        {
+            return static_cast<__mmask16>((1u << remaining) - 1u);
+        }
+
+        KOLOSAL_VECMATH_AVX512 float dotAvx512(const float* a, const float* b, size_t n)
+        {
+            size_t i = 0;
+            __m512 acc0 = _mm512_setzero_ps();
+            __m512 acc1 = _mm512_setzero_ps();
+            for (; i + 32 <= n; i += 32)
+            {
+                acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), acc0);
+                acc1 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i + 16), _mm512_loadu_ps(b + i + 16), acc1);
+            }
+            if (i + 16 <= n)
+            {
+                acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), acc0);
+                i += 16;
+            }
+            if (i < n)
+            {
+                const __mmask16 m = tailMask(n - i);
+                acc1 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(m, a + i), _mm512_maskz_loadu_ps(m, b + i), acc1);
+            }
+            return _mm512_reduce_add_ps(_mm512_add_ps(acc0, acc1));
+        }
+
+        KOLOSAL_VECMATH_AVX512 void scaleAvx512(float* v, size_t n, float factor)
+        {
+            size_t i = 0;
+            const __m512 f = _mm512_set1_ps(factor);
+            for (; i + 16 <= n; i += 16)
+                _mm512_storeu_ps(v + i, _mm512_mul_ps(_mm512_loadu_ps(v + i), f));
+            if (i < n)
+            {
+                const __mmask16 m = tailMask(n - i);
+                _mm512_mask_storeu_ps(v + i, m, _mm512_mul_ps(_mm512_maskz_loadu_ps(m, v + i), f));
+            }
+        }
+
+        KOLOSAL_VECMATH_AVX512 void toHalfAvx512(const float* in, size_t n, uint16_t* out)
+        {
+            size_t i = 0;
+            for (; i + 16 <= n; i += 16)
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i),
+                                    _mm512_cvtps_ph(_mm512_loadu_ps(in + i), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC));
+            for (; i < n; ++i)
+                out[i] = floatToHalf(in[i]);
+        }
+
+        KOLOSAL_VECMATH_AVX512 void fromHalfAvx512(const uint16_t* in, size_t n, float* out)
+        {
+            size_t i = 0;
+            for (; i + 16 <= n; i += 16)
+                _mm512_storeu_ps(out + i, _mm512_cvtph_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i))));
+            for (; i < n; ++i)
+                out[i] = halfToFloat(in[i]);
+        }
+
+        KOLOSAL_VECMATH_AVX512 void toInt8Avx512(const float* in, size_t n, int8_t* out)
+        {
+            const __m512 lo = _mm512_set1_ps(-1.0f);
+            const __m512 hi = _mm512_set1_ps(1.0f);
+            const __m512 scale = _mm512_set1_ps(127.0f);
+            const __m512 half = _mm512_set1_ps(0.5f);
+            const __m512i signBit = _mm512_set1_epi32(static_cast<int>(0x80000000u));
+            for (size_t i = 0; i < n; i += 16)
+            {
+                const __mmask16 m = n - i >= 16 ? static_cast<__mmask16>(0xffff) : tailMask(n - i);
+                const __m512 x = _mm512_mul_ps(_mm512_min_ps(_mm512_max_ps(_mm512_maskz_loadu_ps(m, in + i), lo), hi), scale);
+                const __m512 whole = _mm512_roundscale_ps(x, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+                const __mmask16 roundsUp = _mm512_cmp_ps_mask(_mm512_abs_ps(_mm512_sub_ps(x, whole)), half, _CMP_GE_OQ);
+                const __m512 step = _mm512_castsi512_ps(_mm512_or_si512(
+                    _mm512_castps_si512(hi), _mm512_and_si512(_mm512_castps_si512(x), signBit)));
+                const __m512i ints = _mm512_cvttps_epi32(_mm512_mask_add_ps(whole, roundsUp, whole, step));
+                _mm512_mask_cvtsepi32_storeu_epi8(out + i, m, ints);
+            }
+        }
+#endif
+
+        struct Kernels
+        {
+            const char* name;
+            float (*dot)(const float*, const float*, size_t);
+            void (*scale)(float*, size_t, float);
+            void (*toHalf)(const float*, size_t, uint16_t*);
+            void (*fromHalf)(const uint16_t*, size_t, float*);
+            void (*toInt8)(const float*, size_t, int8_t*);
+        };
+
+        Kernels selectKernels()
+        {
+#ifdef KOLOSAL_VECMATH_X86
+            const HardwareFeatures& host = HardwareFeatures::host();
+            if (host.supportsAll({"avx512", "avx2", "fma", "f16c"}))
+                return {"avx512", dotAvx512, scaleAvx512, toHalfAvx512, fromHalfAvx512, toInt8Avx512};
+            if (host.supportsAll({"avx2", "fma", "f16c"}))
+                return {"avx2", dotAvx2, scaleAvx2, toHalfAvx2, fromHalfAvx2, toInt8Avx2};
+            return {"sse2", dotBase, scaleBase, toHalfBase, fromHalfBase, toInt8Base};
+#elif defined(__ARM_NEON)
+            return {"neon", dotBase, scaleBase, toHalfBase, fromHalfBase, toInt8Base};
+#else
+            return {"scalar", dotBase, scaleBase, toHalfBase, fromHalfBase, toInt8Base};
+#endif
+        }
+
+        const Kernels& kernels()
+        {
+            static const Kernels selected = [] {
+                Kernels k = selectKernels();
+                KOLOSAL_LOG_DEBUG("Vector kernels: %s", k.name);
+                return k;
+            }();
+            return selected;
+        }
+
+    } // namespace
+
+    float dot(const float* a, const float* b, size_t n)
+    {
+        return kernels().dot(a, b, n);
+    }
+
+    float norm(const float* v, size_t n)
+    {
+        return std::sqrt(kernels().dot(v, v, n));
+    }
+
+    void norms(const float* rows, size_t count, size_t dims, float* out)
+    {
+        const Kernels& k = kernels();
+        for (size_t i = 0; i < count; ++i)
+        {
+            const float* row = rows + i * dims;
+            out[i] = std::sqrt(k.dot(row, row, dims));
+        }
+    }
+
+    float normalize(float* v, size_t n)
+    {
+        const Kernels& k = kernels();
+        const float length = std::sqrt(k.dot(v, v, n));
+        if (length > 0.0f)
+            k.scale(v, n, 1.0f / length);
+        return length;
+    }
+
+    float cosine(const float* a, const float* b, size_t n)
+    {
+        const Kernels& k = kernels();
+        const float normA = k.dot(a, a, n);
+        const float normB = k.dot(b, b, n);
+        if (normA == 0.0f || normB == 0.0f)
+            return 0.0f;
+        return k.dot(a, b, n) / (std::sqrt(normA) * std::sqrt(normB));
+    }
+
+    void toHalf(const float* in, size_t n, uint16_t* out)
+    {
+        kernels().toHalf(in, n, out);
+    }
+
+    void fromHalf(const uint16_t* in, size_t n, float* out)
+    {
+        kernels().fromHalf(in, n, out);
+    }
+
+    void toInt8(const float* in, size_t n, int8_t* out)
+    {
+        kernels().toInt8(in, n, out);
+    }
+
+    const char* isa()
+    {
+        return kernels().name;
+    }
+
+} // namespace vecmath
+} // namespace kolosal
@@ -0,0 +1,365 @@
+#include "kolosal/websocket.hpp"
+#include "kolosal/utils.hpp"
+#include "base64.hpp"
+
+#include <json.hpp>
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <poll.h>
+#endif
+
+namespace kolosal
+{
+
+    namespace
+    {
+        constexpr uint8_t kContinuation = 0x0;
+        constexpr uint8_t kText = 0x1;
+        constexpr uint8_t kBinary = 0x2;
+        constexpr uint8_t kClose = 0x8;
+        constexpr uint8_t kPing = 0x9;
+        constexpr uint8_t kPong = 0xA;
+
+        // SHA-1 (FIPS 180-4), only for the handshake's Sec-WebSocket-Accept
+        std::string sha1(const std::string &input)
+        {
+            uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+            std::string data = input;
+            const uint64_t bits = static_cast<uint64_t>(input.size()) * 8;
+            data.push_back(static_cast<char>(0x80));
+            while (data.size() % 64 != 56)
+                data.push_back('\0');
+            for (int i = 7; i >= 0; --i)
+                data.push_back(static_cast<char>((bits >> (8 * i)) & 0xff));
+
+            auto rotl = [](uint32_t x, int n) { return (x << n) | (x >> (32 - n)); };
+            for (size_t block = 0; block < data.size(); block += 64)
+            {
+                uint32_t w[80];
+                for (int i = 0; i < 16; ++i)
+                {
+                    const auto *p = reinterpret_cast<const unsigned char *>(data.data() + block + i * 4);
+                    w[i] = (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+                }
+                for (int i = 16; i < 80; ++i)
+                    w[i] = rotl(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+                uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+                for (int i = 0; i < 80; ++i)
+                {
+                    uint32_t f, k;
+                    if (i < 20)
+                        f = (b & c) | (~b & d), k = 0x5A827999;
+                    else if (i < 40)
+                        f = b ^ c ^ d, k = 0x6ED9EBA1;
+                    else if (i < 60)
+                        f = (b & c) | (b & d) | (c & d), k = 0x8F1BBCDC;
+                    else
+                        f = b ^ c ^ d, k = 0xCA62C1D6;
+                    const uint32_t t = rotl(a, 5) + f + e + k + w[i];
+                    e = d;
+                    d = c;
+                    c = rotl(b, 30);
+                    b = a;
+                    a = t;
+                }
+                h[0] += a;
+                h[1] += b;
+                h[2] += c;
+                h[3] += d;
+                h[4] += e;
+            }
+
+            std::string digest;
+            for (uint32_t word : h)
+                for (int i = 3; i >= 0; --i)
+                    digest.push_back(static_cast<char>((word >> (8 * i)) & 0xff));
+            return digest;
+        }
+
+        std::string lowercase(std::string text)
+        {
+            std::transform(text.begin(), text.end(), text.begin(),
+                           [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+            return text;
+        }
+
+        std::string headerValue(const std::map<std::string, std::string> &headers, const char *name)
+        {
+            auto it = headers.find(name);
+            return it != headers.end() ? it->second : std::string();
+        }
+
+        // 0 on timeout, 1 once readable, -1 if the socket failed
+        int waitReadable(SocketType sock, int timeoutMs)
+        {
+            // TLS may already hold decrypted bytes that poll() cannot see
+            if (auto channel = http_internal::SecureChannels::instance().find(sock); channel && channel->hasBuffered())
+                return 1;
+#ifdef _WIN32
+            WSAPOLLFD pfd{sock, POLLRDNORM, 0};
+            int ready = WSAPoll(&pfd, 1, timeoutMs);
+#else
+            struct pollfd pfd{sock, POLLIN, 0};
+            int ready = poll(&pfd, 1, timeoutMs);
+            if (ready < 0 && errno == EINTR)
+                return 0;
+#endif
+            return ready < 0 ? -1 : (ready > 0 ? 1 : 0);
+        }
+    }
+
+    bool WebSocket::upgrade(SocketType sock, const std::map<std::string, std::string> &headers)
+    {
+        auto reject = [sock](int status, const std::string &message, std::map<std::string, std::string> extra)
+        {
+            nlohmann::json jError = {{"error", {{"message", message}, {"type", "invalid_request_error"}, {"param", nullptr}, {"code", nullptr}}}};
+            extra["Content-Type"] = "application/json";
+            send_response(sock, status, jError.dump(), extra);
+            return false;
+        };
+
+        if (lowercase(headerValue(headers, "upgrade")).find("websocket") == std::string::npos ||
+            lowercase(headerValue(headers, "connection")).find("upgrade") == std::string::npos)
+        {
+            return reject(426, "This endpoint only accepts WebSocket connections", {{"Upgrade", "websocket"}});
+        }
+        if (headerValue(headers, "sec-websocket-version") != "13")
+        {
+            return reject(426, "Unsupported WebSocket version", {{"Sec-WebSocket-Version", "13"}});
+        }
+        const std::string key = headerValue(headers, "sec-websocket-key");
+        if (key.empty())
+        {
+            return reject(400, "Missing Sec-WebSocket-Key header", {});
+        }
+
+        static const std::string kGuid = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+        std::string head = "HTTP/1.1 101 Switching Protocols\r\n"
+                           "Upgrade: websocket\r\n"
+                           "Connection: Upgrade\r\n"
+                           "Sec-WebSocket-Accept: " +
+                           base64::encode(sha1(key + kGuid)) + "\r\n\r\n";
+
+        // The connection is never handed back for another HTTP request
+        kolosal::http_internal::begin_response_tracking(false);
+        kolosal::http_internal::g_response_status = 101;
+        kolosal::http_internal::IoSlice slice{head.data(), head.size()};
+        return kolosal::http_internal::send_all(sock, &slice, 1);
+    }
+
+    WebSocket::WebSocket(SocketType sock, size_t maxMessageBytes)
+        : sock_(sock), maxMessageBytes_(maxMessageBytes), lastReceived_(std::chrono::steady_clock::now())
+    {
+    }
+
+    WebSocket::Status WebSocket::receive(std::string &message, int timeoutMs)
+    {
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(std::max(timeoutMs, 0));
+        while (open_)
+        {
+            const Parse parsed = parseFrame(message);
+            if (parsed == Parse::Message)
+                return Status::Message;
+            if (parsed == Parse::Failed)
+                break;
+
+            const auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+            const int ready = waitReadable(sock_, static_cast<int>(std::max<int64_t>(remaining.count(), 0)));
+            if (ready == 0)
+                return Status::Timeout;
+
+            char chunk[16384];
+            const int received = ready > 0 ? static_cast<int>(http_internal::socket_recv(sock_, chunk, sizeof(chunk))) : -1;
+            if (received <= 0)
+            {
+                open_ = false;
+                break;
+            }
+            buffer_.append(chunk, static_cast<size_t>(received));
+            lastReceived_ = std::chrono::steady_clock::now();
+        }
+        return Status::Closed;
+    }
+
+    WebSocket::Parse WebSocket::parseFrame(std::string &message)
+    {
+        while (true)
+        {
+            if (buffer_.size() < 2)
+                return Parse::NeedMore;
+            const auto *bytes = reinterpret_cast<const unsigned char *>(buffer_.data());
+            const bool fin = (bytes[0] & 0x80) != 0;
+            const uint8_t opcode = bytes[0] & 0x0F;
+            const bool control = (opcode & 0x8) != 0;
+
+            // No extensions are negotiated, and every client frame must be masked
+            if ((bytes[0] & 0x70) != 0 || (bytes[1] & 0x80) == 0)
+            {
+                close(kProtocolError, "Malformed frame");
+                return Parse::Failed;
+            }
+
+            uint64_t length = bytes[1] & 0x7F;
+            size_t headerBytes = 2;
+            if (length == 126)
+            {
+                if (buffer_.size() < 4)
+                    return Parse::NeedMore;
+                length = (uint64_t(bytes[2]) << 8) | bytes[3];
+                headerBytes = 4;
+            }
+            else if (length == 127)
+            {
+                if (buffer_.size() < 10)
+                    return Parse::NeedMore;
+                // RFC 6455 requires the most significant bit of a 64-bit length to be 0
+                if (bytes[2] & 0x80)
+                {
+                    close(kProtocolError, "Malformed frame");
+                    return Parse::Failed;
+                }
+                length = 0;
+                for (int i = 0; i < 8; ++i)
+                    length = (length << 8) | bytes[2 + i];
+                headerBytes = 10;
+            }
+            if (control && (length > 125 || !fin))
+            {
+                close(kProtocolError, "Malformed control frame");
+                return Parse::Failed;
+            }
+            // Compared by subtraction: a peer-supplied length added to anything can wrap
+            if (!control && (fragments_.size() > maxMessageBytes_ || length > maxMessageBytes_ - fragments_.size()))
+            {
+                close(kMessageTooBig, "Message too big");
+                return Parse::Failed;
+            }
+            if (buffer_.size() < headerBytes + 4 || length > buffer_.size() - headerBytes - 4)
+                return Parse::NeedMore;
+
+            const unsigned char *mask = bytes + headerBytes;
+            std::string payload(buffer_, headerBytes + 4, static_cast<size_t>(length));
+            for (size_t i = 0; i < payload.size(); ++i)
+                payload[i] = static_cast<char>(payload[i] ^ mask[i % 4]);
+            buffer_.erase(0, headerBytes + 4 + static_cast<size_t>(length));
+
+            switch (opcode)
+            {
+            case kClose:
+            {
+                // Echo the peer's status code, as the closing handshake asks
+                uint16_t code = kNormalClosure;
+                if (payload.size() >= 2)
+                    code = static_cast<uint16_t>((uint8_t(payload[0]) << 8) | uint8_t(payload[1]));
+                close(code);
+                return Parse::Failed;
+            }
+            case kPing:
+                sendFrame(kPong, payload);
+                break;
+            case kPong:
+                break;
+            case kContinuation:
+                if (messageOpcode_ == 0)
+                {
+                    close(kProtocolError, "Unexpected continuation frame");
+                    return Parse::Failed;
+                }
+                fragments_ += payload;
+                if (fin)
+                {
+                    message = std::move(fragments_);
+                    fragments_.clear();
+                    messageOpcode_ = 0;
+                    return Parse::Message;
+                }
+                break;
+            case kText:
+            case kBinary:
+                if (messageOpcode_ != 0)
+                {
+                    close(kProtocolError, "Expected a continuation frame");
+                    return Parse::Failed;
+                }
+                if (fin)
+                {
+                    message = std::move(payload);
+                    return Parse::Message;
+                }
+                messageOpcode_ = opcode;
+                fragments_ = std::move(payload);
+                break;
+            default:
+                close(kProtocolError, "Unknown opcode");
+                return Parse::Failed;
+            }
+        }
+    }
+
+    bool WebSocket::sendFrame(uint8_t opcode, std::string_view payload)
+    {
+        if (!open_)
+            return false;
+
+        // Server frames are unmasked; the length takes 7, 7+16 or 7+64 bits
+        unsigned char header[10];
+        size_t headerBytes = 2;
+        header[0] = static_cast<unsigned char>(0x80 | opcode);
+        if (payload.size() < 126)
+        {
+            header[1] = static_cast<unsigned char>(payload.size());
+        }
+        else if (payload.size() <= 0xFFFF)
+        {
+            header[1] = 126;
+            header[2] = static_cast<unsigned char>(payload.size() >> 8);
+            header[3] = static_cast<unsigned char>(payload.size());
+            headerBytes = 4;
+        }
+        else
+        {
+            header[1] = 127;
+            for (int i = 0; i < 8; ++i)
+                header[2 + i] = static_cast<unsigned char>(static_cast<uint64_t>(payload.size()) >> (8 * (7 - i)));
+            headerBytes = 10;
+        }
+
+        kolosal::http_internal::IoSlice slices[] = {
+            {reinterpret_cast<const char *>(header), headerBytes},
+            {payload.data(), payload.size()}};
+        if (!kolosal::http_internal::send_all(sock_, slices, 2))
+        {
+            open_ = false;
+            return false;
+        }
+        return true;
+    }
+
+    bool WebSocket::sendText(std::string_view text)
+    {
+        return sendFrame(kText, text);
+    }
+
+    bool WebSocket::ping()
+    {
+        return sendFrame(kPing, {});
+    }
+
+    void WebSocket::close(uint16_t code, std::string_view reason)
+    {
+        if (!open_)
+            return;
+        std::string payload;
+        payload.push_back(static_cast<char>(code >> 8));
+        payload.push_back(static_cast<char>(code & 0xff));
+        payload.append(reason.substr(0, 123));
+        sendFrame(kClose, payload);
+        open_ = false;
+    }
+
+} // namespace kolosal
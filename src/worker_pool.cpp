@@ -0,0 +1,164 @@
+#include "kolosal/worker_pool.hpp"
+#include "kolosal/logger.hpp"
+#include "kolosal/cpu_profiler.hpp"
+
+#include <algorithm>
+#include <exception>
+
+namespace kolosal
+{
+
+    WorkerPool::WorkerPool(size_t minThreads, size_t maxThreads, std::chrono::seconds idleTimeout)
+        : idleTimeout_(idleTimeout),
+          minThreads_(minThreads),
+          maxThreads_(std::max<size_t>(std::max<size_t>(maxThreads, minThreads), 1))
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (size_t i = 0; i < minThreads_; ++i)
+        {
+            spawnWorkerLocked();
+        }
+    }
+
+    WorkerPool::~WorkerPool()
+    {
+        shutdown();
+    }
+
+    bool WorkerPool::submit(std::function<void()> task)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stop_)
+            return false;
+
+        reapFinishedLocked();
+        tasks_.push_back(std::move(task));
+
+        // Grow only when the queued work outnumbers the idle workers
+        if (tasks_.size() > idle_ && threads_.size() < maxThreads_)
+        {
+            spawnWorkerLocked();
+        }
+        cv_.notify_one();
+        return true;
+    }
+
+    void WorkerPool::shutdown()
+    {
+        std::vector<std::thread> toJoin;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (stop_ && threads_.empty() && finished_.empty())
+                return;
+            stop_ = true;
+            for (auto &entry : threads_)
+            {
+                toJoin.push_back(std::move(entry.second));
+            }
+            threads_.clear();
+            for (auto &t : finished_)
+            {
+                toJoin.push_back(std::move(t));
+            }
+            finished_.clear();
+        }
+        cv_.notify_all();
+
+        for (auto &t : toJoin)
+        {
+            if (t.joinable())
+                t.join();
+        }
+    }
+
+    size_t WorkerPool::threadCount() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return threads_.size();
+    }
+
+    size_t WorkerPool::busyCount() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return busy_;
+    }
+
+    size_t WorkerPool::queuedCount() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return tasks_.size();
+    }
+
+    void WorkerPool::spawnWorkerLocked()
+    {
+        // The new thread blocks on mutex_ until it has been inserted into threads_
+        std::thread t(&WorkerPool::workerLoop, this);
+        auto id = t.get_id();
+        threads_.emplace(id, std::move(t));
+    }
+
+    void WorkerPool::reapFinishedLocked()
+    {
+        // Retired workers release the lock right before returning, so these joins are short
+        for (auto &t : finished_)
+        {
+            if (t.joinable())
+                t.join();
+        }
+        finished_.clear();
+    }
+
+    void WorkerPool::workerLoop()
+    {
+        CpuProfiler::nameThread("kolosal-worker");
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true)
+        {
+            if (tasks_.empty())
+            {
+                if (stop_)
+                    return;
+
+                ++idle_;
+                bool woke = cv_.wait_for(lock, idleTimeout_, [this]
+                                         { return stop_ || !tasks_.empty(); });
+                --idle_;
+
+                if (!woke && threads_.size() > minThreads_)
+                {
+                    // Retire this surplus worker; it is joined by the next submit() or shutdown()
+                    auto it = threads_.find(std::this_thread::get_id());
+                    if (it != threads_.end())
+                    {
+                        finished_.push_back(std::move(it->second));
+                        threads_.erase(it);
+                    }
+                    return;
+                }
+                continue;
+            }
+
+            std::function<void()> task = std::move(tasks_.front());
+            tasks_.pop_front();
+            ++busy_;
+            lock.unlock();
+
+            try
+            {
+                task();
+            }
+            catch (const std::exception &ex)
+            {
+                KOLOSAL_LOG_ERROR("Unhandled exception in worker task: %s", ex.what());
+            }
+            catch (...)
+            {
+                KOLOSAL_LOG_ERROR("Unhandled unknown exception in worker task");
+            }
+
+            lock.lock();
+            --busy_;
+        }
+    }
+
+} // namespace kolosal